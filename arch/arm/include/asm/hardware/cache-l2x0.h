@@ -103,10 +103,16 @@
 
 #define L2X0_ADDR_FILTER_EN		1
 
+#define L2X0_EVENT_CNT_CTRL_ENABLE	(1 << 0)
+#define L2X0_EVENT_CNT_CFG_SRC_SHIFT	2
+#define L2X0_EVENT_CNT_CFG_SRC_MASK	0xf
+#define L2X0_EVENT_CNT_CFG_SRC_DISABLED	0
+
 #define REV_PL310_R2P0				4
 
 #ifndef __ASSEMBLY__
 extern void __init l2x0_init(void __iomem *base, u32 aux_val, u32 aux_mask);
+extern void l2x0_set_way_op_threshold(u32 size);
 #if defined(CONFIG_CACHE_L2X0) && defined(CONFIG_OF)
 extern int l2x0_of_init(u32 aux_val, u32 aux_mask);
 #else
@@ -116,6 +122,12 @@ static inline int l2x0_of_init(u32 aux_val, u32 aux_mask)
 }
 #endif
 
+#ifdef CONFIG_CACHE_L2X0_PMU
+extern void l2x0_pmu_register(void __iomem *base, u32 part);
+#else
+static inline void l2x0_pmu_register(void __iomem *base, u32 part) {}
+#endif
+
 struct l2x0_regs {
 	unsigned long phy_base;
 	unsigned long aux_ctrl;
@@ -0,0 +1,27 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * NEON may be used by kernel code between kernel_neon_begin() and
+ * kernel_neon_end(), which disable preemption and must not be called
+ * from interrupt context.  The NEON code itself has to live in its own
+ * compilation unit built with -mfpu=neon: GCC may emit NEON instructions
+ * anywhere in such a unit, including before kernel_neon_begin().
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
@@ -22,11 +22,15 @@
 #define __ASM_OUTERCACHE_H
 
 #include <linux/types.h>
+#include <linux/dma-direction.h>
+
+struct scatterlist;
 
 struct outer_cache_fns {
 	void (*inv_range)(unsigned long, unsigned long);
 	void (*clean_range)(unsigned long, unsigned long);
 	void (*flush_range)(unsigned long, unsigned long);
+	void (*sync_sg)(struct scatterlist *, int, enum dma_data_direction);
 	void (*flush_all)(void);
 	void (*inv_all)(void);
 	void (*disable)(void);
@@ -57,6 +61,20 @@ static inline void outer_flush_range(phys_addr_t start, phys_addr_t end)
 		outer_cache.flush_range(start, end);
 }
 
+/*
+ * Clean (DMA_TO_DEVICE), invalidate (DMA_FROM_DEVICE) or flush every
+ * entry of a scatterlist in one call.  Returns false if the outer cache
+ * has no batched operation and the caller has to fall back to ranges.
+ */
+static inline bool outer_sync_sg(struct scatterlist *sg, int nents,
+				 enum dma_data_direction dir)
+{
+	if (!outer_cache.sync_sg)
+		return false;
+	outer_cache.sync_sg(sg, nents, dir);
+	return true;
+}
+
 static inline void outer_flush_all(void)
 {
 	if (outer_cache.flush_all)
@@ -89,6 +107,11 @@ static inline void outer_clean_range(phys_addr_t start, phys_addr_t end)
 { }
 static inline void outer_flush_range(phys_addr_t start, phys_addr_t end)
 { }
+static inline bool outer_sync_sg(struct scatterlist *sg, int nents,
+				 enum dma_data_direction dir)
+{
+	return true;
+}
 static inline void outer_flush_all(void) { }
 static inline void outer_inv_all(void) { }
 static inline void outer_disable(void) { }
@@ -96,10 +96,10 @@ static struct omap_board_data uart3_board_data __initdata = {
 	.pads_cnt = ARRAY_SIZE(uart4_pads),
 };*/
 
+/* WiLink BT/FM/GPS */
 static struct omap_uart_port_info uart2_info __initdata = {
-	.dma_enabled = 0,
+	.dma_enabled = 1,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = 3 * HZ,
 	.autosuspend_timeout = DEFAULT_UART_AUTOSUSPEND_DELAY,
 };
@@ -107,7 +107,6 @@ static struct omap_uart_port_info uart2_info __initdata = {
 static struct omap_uart_port_info uart3_info __initdata = {
 	.dma_enabled = 0,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = 3 * HZ,
 	.autosuspend_timeout = DEFAULT_UART_AUTOSUSPEND_DELAY,
 };
@@ -115,7 +114,6 @@ static struct omap_uart_port_info uart3_info __initdata = {
 static struct omap_uart_port_info uart4_info __initdata = {
 	.dma_enabled = 0,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = 3 * HZ,
 	.autosuspend_timeout = DEFAULT_UART_AUTOSUSPEND_DELAY,
 };
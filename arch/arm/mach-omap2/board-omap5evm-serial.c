@@ -132,7 +132,6 @@ static struct omap_board_data uart5_board_data __initdata = {
 static struct omap_uart_port_info uart1_info __initdata = {
 	.dma_enabled = 0,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = (3 * HZ),
 	.autosuspend_timeout = 3000,
 };
@@ -140,15 +139,14 @@ static struct omap_uart_port_info uart1_info __initdata = {
 static struct omap_uart_port_info uart3_info __initdata = {
 	.dma_enabled = 0,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = (3 * HZ),
 	.autosuspend_timeout = 3000,
 };
 
+/* WiLink BT/FM/GPS */
 static struct omap_uart_port_info uart5_info __initdata = {
-	.dma_enabled = 0,
+	.dma_enabled = 1,
 	.dma_rx_buf_size = 4096,
-	.dma_rx_poll_rate = 1,
 	.dma_rx_timeout = (3 * HZ),
 	.rts_mux_driver_control = 1,
 	.autosuspend_timeout = 3000,
@@ -1694,6 +1694,16 @@ static struct clk ocp2scp3_ick = {
 	.recalc		= &followparent_recalc,
 };
 
+static struct clk rng_ick = {
+	.name		= "rng_ick",
+	.ops		= &clkops_omap2_dflt,
+	.enable_reg	= OMAP54XX_CM_L4SEC_RNG_CLKCTRL,
+	.enable_bit	= OMAP54XX_MODULEMODE_HWCTRL,
+	.clkdm_name	= "l4sec_clkdm",
+	.parent		= &l4_root_clk_div,
+	.recalc		= &followparent_recalc,
+};
+
 static struct clk dss_32khz_clk = {
 	.name		= "dss_32khz_clk",
 	.parent		= &sys_32k_ck,
@@ -2778,6 +2788,7 @@ static struct clk_lookup omap54xx_clks[] = {
 	CLKDEV_INIT("usbhs_omap",	"usbhost_ick",		&dummy_ck),
 	CLKDEV_INIT("usbhs_omap",	"usbtll_fck",		&dummy_ck),
 	CLKDEV_INIT("omap_wdt",	"ick",				&dummy_ck),
+	CLKDEV_INIT("omap_rng",	"ick",				&rng_ick),
 	CLKDEV_INIT("omap_timer.1",	"32k_ck",		&sys_32k_ck),
 	CLKDEV_INIT("omap_timer.2",	"32k_ck",		&sys_32k_ck),
 	CLKDEV_INIT("omap_timer.3",	"32k_ck",		&sys_32k_ck),
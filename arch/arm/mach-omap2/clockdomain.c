@@ -26,9 +26,13 @@
 #include <linux/io.h>
 
 #include <linux/bitops.h>
+#include <linux/sched.h>
+
+#include <trace/events/power.h>
 
 #include <plat/clock.h>
 #include "clockdomain.h"
+#include "pm.h"
 
 /* clkdm_list contains all registered struct clockdomains */
 static LIST_HEAD(clkdm_list);
@@ -846,6 +850,7 @@ void clkdm_allow_idle(struct clockdomain *clkdm)
 	clkdm->_flags |= _CLKDM_FLAG_HWSUP_ENABLED;
 	clkdm->_flags &= ~_CLKDM_FLAG_FORCE_NO_SLEEP;
 
+	trace_clock_domain_idle(clkdm->name, 1, smp_processor_id());
 	arch_clkdm->clkdm_allow_idle(clkdm);
 	pwrdm_wait_transition(clkdm->pwrdm.ptr);
 	pwrdm_state_high2low_counter_update(clkdm->pwrdm.ptr);
@@ -883,6 +888,7 @@ void clkdm_deny_idle(struct clockdomain *clkdm)
 	spin_lock_irqsave(&clkdm->lock, flags);
 	clkdm->_flags &= ~_CLKDM_FLAG_HWSUP_ENABLED;
 	clkdm->_flags |= _CLKDM_FLAG_FORCE_NO_SLEEP;
+	trace_clock_domain_idle(clkdm->name, 0, smp_processor_id());
 	arch_clkdm->clkdm_deny_idle(clkdm);
 	pwrdm_wait_transition(clkdm->pwrdm.ptr);
 	pwrdm_state_low2high_counter_update(clkdm->pwrdm.ptr);
@@ -935,8 +941,10 @@ static int clkdm_usecount_inc(struct clockdomain *clkdm)
 
 	usecount = atomic_inc_return(&clkdm->usecount);
 
-	if (usecount == 1)
+	if (usecount == 1) {
+		pm_dbg_clkdm_usecount(clkdm, true);
 		pwrdm_usecount_inc(clkdm->pwrdm.ptr);
+	}
 
 	return usecount;
 }
@@ -967,23 +975,28 @@ static int clkdm_usecount_dec(struct clockdomain *clkdm)
 	}
 
 	usecount = atomic_read(&clkdm->usecount);
-	if (usecount == 0)
+	if (usecount == 0) {
+		pm_dbg_clkdm_usecount(clkdm, false);
 		pwrdm_usecount_dec(clkdm->pwrdm.ptr);
+	}
 
 	return usecount;
 }
 
 static int _clkdm_clk_hwmod_enable(struct clockdomain *clkdm,
-					struct omap_hwmod *oh)
+				   struct omap_hwmod *oh, const char *user)
 {
 	unsigned long flags, usecount = 0;
+	s64 start = 0;
 
 	if (!clkdm || !arch_clkdm || !arch_clkdm->clkdm_clk_enable)
 		return -EINVAL;
 
 	if ((oh && oh->prcm.omap4.modulemode == MODULEMODE_SWCTRL) ||
-	    (clkdm->flags && !(clkdm->flags & CLKDM_CAN_ENABLE_AUTO)))
+	    (clkdm->flags && !(clkdm->flags & CLKDM_CAN_ENABLE_AUTO))) {
 		usecount = clkdm_usecount_inc(clkdm);
+		trace_clock_domain_usecount(clkdm->name, user, usecount);
+	}
 
 	/*
 	 * For arch's with no autodeps, clkcm_clk_enable
@@ -996,21 +1009,29 @@ static int _clkdm_clk_hwmod_enable(struct clockdomain *clkdm,
 	if (clkdm->flags & CLKDM_SKIP_MANUAL_TRANS)
 		return 0;
 
+	/* only the first user actually has to wait for the clkdm to wake */
+	if (usecount == 1)
+		start = sched_clock();
+
 	spin_lock_irqsave(&clkdm->lock, flags);
 	arch_clkdm->clkdm_clk_enable(clkdm);
 	pwrdm_wait_transition(clkdm->pwrdm.ptr);
 	pwrdm_state_low2high_counter_update(clkdm->pwrdm.ptr);
 	spin_unlock_irqrestore(&clkdm->lock, flags);
 
+	if (start)
+		pm_dbg_clkdm_wakeup(clkdm, start);
+
 	pr_debug("clockdomain: clkdm %s: enabled\n", clkdm->name);
 
 	return 0;
 }
 
 static int _clkdm_clk_hwmod_disable(struct clockdomain *clkdm,
-					struct omap_hwmod *oh)
+				    struct omap_hwmod *oh, const char *user)
 {
 	unsigned long flags;
+	int usecount;
 
 	if (!clkdm || !arch_clkdm || !arch_clkdm->clkdm_clk_disable)
 		return -EINVAL;
@@ -1022,7 +1043,9 @@ static int _clkdm_clk_hwmod_disable(struct clockdomain *clkdm,
 			return -ERANGE;
 		}
 
-		if (clkdm_usecount_dec(clkdm) > 0)
+		usecount = clkdm_usecount_dec(clkdm);
+		trace_clock_domain_usecount(clkdm->name, user, usecount);
+		if (usecount > 0)
 			return 0;
 	}
 
@@ -1065,7 +1088,7 @@ int clkdm_clk_enable(struct clockdomain *clkdm, struct clk *clk)
 	if (!clk)
 		return -EINVAL;
 
-	return _clkdm_clk_hwmod_enable(clkdm, NULL);
+	return _clkdm_clk_hwmod_enable(clkdm, NULL, clk->name);
 }
 
 /**
@@ -1091,7 +1114,7 @@ int clkdm_clk_disable(struct clockdomain *clkdm, struct clk *clk)
 	if (!clk)
 		return -EINVAL;
 
-	return _clkdm_clk_hwmod_disable(clkdm, NULL);
+	return _clkdm_clk_hwmod_disable(clkdm, NULL, clk->name);
 }
 
 /**
@@ -1123,7 +1146,7 @@ int clkdm_hwmod_enable(struct clockdomain *clkdm, struct omap_hwmod *oh)
 	if (!oh)
 		return -EINVAL;
 
-	return _clkdm_clk_hwmod_enable(clkdm, oh);
+	return _clkdm_clk_hwmod_enable(clkdm, oh, oh->name);
 }
 
 /**
@@ -1154,6 +1177,6 @@ int clkdm_hwmod_disable(struct clockdomain *clkdm, struct omap_hwmod *oh)
 	if (!oh)
 		return -EINVAL;
 
-	return _clkdm_clk_hwmod_disable(clkdm, oh);
+	return _clkdm_clk_hwmod_disable(clkdm, oh, oh->name);
 }
 
@@ -108,6 +108,12 @@ struct clkdm_dep {
  * @sleepdep_srcs: Clockdomains that can be told to keep this clkdm from inact
  * @usecount: Usecount tracking
  * @node: list_head to link all clockdomains together
+ * @timer: (PM_DEBUG) sched_clock() of the last usecount 0 <-> 1 transition
+ * @active_time: (PM_DEBUG) total ns spent with a non-zero usecount
+ * @idle_time: (PM_DEBUG) total ns spent with a zero usecount
+ * @wakeups: (PM_DEBUG) number of software wakeups of the clkdm
+ * @wakeup_lat: (PM_DEBUG) total ns the wakeups took
+ * @wakeup_lat_max: (PM_DEBUG) longest wakeup in ns
  *
  * @prcm_partition should be a macro from mach-omap2/prcm44xx.h (OMAP4 only)
  * @cm_inst should be a macro ending in _INST from the OMAP4 CM instance
@@ -133,6 +139,14 @@ struct clockdomain {
 	atomic_t usecount;
 	struct list_head node;
 	spinlock_t lock;
+#ifdef CONFIG_PM_DEBUG
+	s64 timer;
+	s64 active_time;
+	s64 idle_time;
+	u32 wakeups;
+	s64 wakeup_lat;
+	s64 wakeup_lat_max;
+#endif
 };
 
 /**
@@ -17,6 +17,8 @@
 #include <linux/errno.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/init.h>
+#include <linux/slab.h>
 
 #include "iomap.h"
 #include "common.h"
@@ -546,8 +548,85 @@ static void omap4_cm_part_restore(struct omap4_cm_regs *cm_reg, int size,
 	}
 }
 
+/*
+ * The registers of the tables above, flattened into their addresses once
+ * at boot, so that device off entry and exit are a plain loop of reads
+ * and writes.  The order is the same as the tables'.
+ */
+struct omap4_cm_batch_reg {
+	void __iomem *addr;
+	u32 val;
+};
+
+static struct omap4_cm_batch_reg *cm_batch;
+static int cm_batch_size;
+
+static int __init omap4_cm_batch_add(struct omap4_cm_regs *cm_reg, int size,
+				     u8 partition, int n)
+{
+	u32 i, j;
+
+	for (i = 0; i < size; i++, cm_reg++)
+		for (j = 0; j < cm_reg->no_reg; j++, n++)
+			if (cm_batch)
+				cm_batch[n].addr = omap4_cminst_inst_reg_addr(
+					partition, cm_reg->mod_off,
+					cm_reg->reg[j].offset);
+	return n;
+}
+
+static int __init omap4_cm_batch_fill(void)
+{
+	int n;
+
+	if (cpu_is_omap44xx()) {
+		n = omap4_cm_batch_add(omap4_cm1_regs,
+				       ARRAY_SIZE(omap4_cm1_regs),
+				       OMAP4430_CM1_PARTITION, 0);
+		n = omap4_cm_batch_add(omap4_cm2_regs,
+				       ARRAY_SIZE(omap4_cm2_regs),
+				       OMAP4430_CM2_PARTITION, n);
+	} else {
+		n = omap4_cm_batch_add(omap4_cm1_regs,
+				       ARRAY_SIZE(omap4_cm1_regs),
+				       OMAP54XX_CM_CORE_AON_PARTITION, 0);
+		n = omap4_cm_batch_add(omap5_cm2_regs,
+				       ARRAY_SIZE(omap5_cm2_regs),
+				       OMAP54XX_CM_CORE_PARTITION, n);
+	}
+
+	return n;
+}
+
+static int __init omap4_cm_batch_init(void)
+{
+	int n;
+
+	if (!cpu_is_omap44xx() && !cpu_is_omap54xx())
+		return 0;
+
+	/* first pass counts, second pass fills in the addresses */
+	n = omap4_cm_batch_fill();
+	cm_batch = kcalloc(n, sizeof(*cm_batch), GFP_KERNEL);
+	if (!cm_batch)
+		return -ENOMEM;
+	omap4_cm_batch_fill();
+	cm_batch_size = n;
+
+	return 0;
+}
+late_initcall(omap4_cm_batch_init);
+
 void omap4_cm_prepare_off(void)
 {
+	int i;
+
+	if (cm_batch_size) {
+		for (i = 0; i < cm_batch_size; i++)
+			cm_batch[i].val = __raw_readl(cm_batch[i].addr);
+		return;
+	}
+
 	if (cpu_is_omap44xx()) {
 		omap4_cm_part_save(omap4_cm1_regs,
 				   ARRAY_SIZE(omap4_cm1_regs),
@@ -568,6 +647,14 @@ void omap4_cm_prepare_off(void)
 
 void omap4_cm_resume_off(void)
 {
+	int i;
+
+	if (cm_batch_size) {
+		for (i = 0; i < cm_batch_size; i++)
+			__raw_writel(cm_batch[i].val, cm_batch[i].addr);
+		return;
+	}
+
 	if (cpu_is_omap44xx()) {
 		omap4_cm_part_restore(omap4_cm1_regs,
 				      ARRAY_SIZE(omap4_cm1_regs),
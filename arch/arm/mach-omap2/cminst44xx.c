@@ -102,6 +102,15 @@ static bool _is_module_ready(u8 part, u16 inst, s16 cdoffs, u16 clkctrl_offs)
 
 /* Public functions */
 
+/* Address of a register in a CM instance, for callers batching accesses */
+void __iomem *omap4_cminst_inst_reg_addr(u8 part, s16 inst, u16 idx)
+{
+	BUG_ON(part >= OMAP4_MAX_PRCM_PARTITIONS ||
+	       part == OMAP4430_INVALID_PRCM_PARTITION ||
+	       !_cm_bases[part]);
+	return _cm_bases[part] + inst + idx;
+}
+
 /* Read a register in a CM instance */
 u32 omap4_cminst_read_inst_reg(u8 part, s16 inst, u16 idx)
 {
@@ -279,11 +279,16 @@ static inline void omap_mpuss_timer_init(void)
 
 #if defined(CONFIG_ARCH_OMAP4) || defined(CONFIG_ARCH_OMAP5)
 extern bool omap_wakeupgen_check_interrupts(char *report_string);
+extern void omap_wakeupgen_log_wakeup_reasons(void);
 #else
 static inline bool omap_wakeupgen_check_interrupts(char *report_string)
 {
 	return false;
 }
+
+static inline void omap_wakeupgen_log_wakeup_reasons(void)
+{
+}
 #endif
 
 
@@ -15,6 +15,11 @@
 #include <linux/cpu_pm.h>
 #include <linux/export.h>
 #include <linux/clockchips.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/proc-fns.h>
 
@@ -63,6 +68,112 @@ static struct clockdomain *cpu_clkdm[NR_CPUS];
 static atomic_t abort_barrier;
 static bool cpu_done[NR_CPUS];
 
+/*
+ * The menu governor predicts the idle time of each CPU on its own, but
+ * the MPU and CORE states only pay off if the cluster as a whole stays
+ * idle long enough. Each CPU publishes its own prediction (the next
+ * timer, or the typical interval between interrupt wakeups if recent
+ * wakeups mostly came before the timer) when it enters a coupled state,
+ * and CPU0 demotes the cluster state to the deepest one the shortest of
+ * these predictions covers.
+ */
+#define OMAP4_IDLE_HISTORY	8
+
+struct omap4_idle_history {
+	u32 irq_us[OMAP4_IDLE_HISTORY];	/* last idle periods ended early */
+	unsigned int next;
+	u8 early;			/* one bit per wakeup, 1 if early */
+	u32 timer_us;
+	u32 predict_us;
+	ktime_t entry;
+};
+
+static DEFINE_PER_CPU(struct omap4_idle_history, omap4_idle_history);
+
+/* Residency histogram bucket upper bounds, in us */
+static const u32 omap4_idle_buckets[] = { 100, 500, 1000, 5000, 20000, ~0 };
+#define OMAP4_IDLE_BUCKETS	ARRAY_SIZE(omap4_idle_buckets)
+
+struct omap4_idle_stats {
+	u32 entries[ARRAY_SIZE(omap4_idle_data)];
+	u32 aborts[ARRAY_SIZE(omap4_idle_data)];
+	u32 demotions[ARRAY_SIZE(omap4_idle_data)];
+	u32 hist[ARRAY_SIZE(omap4_idle_data)][OMAP4_IDLE_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct omap4_idle_stats, omap4_idle_stats);
+
+/* Start an idle period on this CPU and publish its predicted length */
+static void omap4_idle_predict(struct omap4_idle_history *h)
+{
+	u32 predict, sum = 0;
+	int i;
+
+	h->entry = ktime_get();
+	h->timer_us = min_t(s64, ktime_to_us(tick_nohz_get_sleep_length()),
+			    UINT_MAX);
+	predict = h->timer_us;
+
+	if (hweight8(h->early) >= OMAP4_IDLE_HISTORY / 2) {
+		for (i = 0; i < OMAP4_IDLE_HISTORY; i++)
+			sum += h->irq_us[i];
+		predict = min(predict, sum / OMAP4_IDLE_HISTORY);
+	}
+
+	h->predict_us = predict;
+	smp_wmb();
+}
+
+/* End the idle period started by omap4_idle_predict(), return its length */
+static u32 omap4_idle_update(struct omap4_idle_history *h)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), h->entry));
+	bool early = us < h->timer_us - h->timer_us / 8;
+
+	h->early = (h->early << 1) | early;
+	if (early) {
+		h->irq_us[h->next] = us;
+		h->next = (h->next + 1) % OMAP4_IDLE_HISTORY;
+	}
+
+	return us;
+}
+
+static void omap4_idle_account(int index, u32 us, bool abort)
+{
+	struct omap4_idle_stats *st = &__get_cpu_var(omap4_idle_stats);
+	int i;
+
+	st->entries[index]++;
+	if (abort)
+		st->aborts[index]++;
+	for (i = 0; us > omap4_idle_buckets[i]; i++)
+		;
+	st->hist[index][i]++;
+}
+
+/*
+ * Pick the deepest coupled state up to @index that the predicted idle
+ * time of all the online CPUs covers. C2 is the shallowest coupled state
+ * and is always allowed.
+ */
+static int omap4_idle_cluster_state(struct cpuidle_driver *drv, int index)
+{
+	u32 predict = ~0;
+	int cpu;
+
+	smp_rmb();
+	for_each_online_cpu(cpu)
+		predict = min(predict,
+			      per_cpu(omap4_idle_history, cpu).predict_us);
+
+	while (index > 1 && (drv->states[index].disable ||
+			     drv->states[index].target_residency > predict))
+		index--;
+
+	return index;
+}
+
 /**
  * omap4_enter_idle_coupled_[simple/coupled] - OMAP4 cpuidle entry functions
  * @dev: cpuidle device
@@ -77,8 +188,12 @@ static int omap4_enter_idle_simple(struct cpuidle_device *dev,
 				   struct cpuidle_driver *drv,
 				   int index)
 {
+	struct omap4_idle_history *h = &__get_cpu_var(omap4_idle_history);
+
 	local_fiq_disable();
+	omap4_idle_predict(h);
 	omap_do_wfi();
+	omap4_idle_account(index, omap4_idle_update(h), false);
 	local_fiq_enable();
 
 	return index;
@@ -91,11 +206,15 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 			struct cpuidle_driver *drv,
 			int index)
 {
-	struct omap4_idle_statedata *cx = &omap4_idle_data[index];
+	struct omap4_idle_statedata *cx;
+	struct omap4_idle_history *h = &__get_cpu_var(omap4_idle_history);
 	int cpu_id = smp_processor_id();
+	int state = index;
 	u32 mpuss_context_lost = 0;
+	bool abort = true;
 
 	local_fiq_disable();
+	omap4_idle_predict(h);
 
 	/*
 	 * CPU0 has to wait and stay ON until CPU1 is OFF state.
@@ -120,6 +239,15 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 		}
 	}
 
+	/* CPU1 is off and its prediction published, decide for the cluster */
+	if (dev->cpu == 0) {
+		state = omap4_idle_cluster_state(drv, index);
+		if (state != index)
+			__get_cpu_var(omap4_idle_stats).demotions[index]++;
+	}
+	cx = &omap4_idle_data[state];
+	abort = false;
+
 	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &cpu_id);
 
 	/*
@@ -148,6 +276,9 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 	cpu_done[dev->cpu] = true;
 
 	mpuss_context_lost = omap_mpuss_read_prev_context_state();
+	if (pwrdm_power_state_le(cx->mpu_state, PWRDM_POWER_OSWR) &&
+	    !mpuss_context_lost)
+		abort = true;
 
 	omap_set_pwrdm_state(mpu_pd, PWRDM_POWER_ON);
 	omap_set_pwrdm_state(core_pd, PWRDM_POWER_ON);
@@ -208,9 +339,15 @@ fail:
 	cpuidle_coupled_parallel_barrier(dev, &abort_barrier);
 	cpu_done[dev->cpu] = false;
 
+	/* the cluster state is chosen and accounted by CPU0 */
+	if (dev->cpu == 0)
+		omap4_idle_account(state, omap4_idle_update(h), abort);
+	else
+		omap4_idle_update(h);
+
 	local_fiq_enable();
 
-	return index;
+	return state;
 }
 
 static DEFINE_PER_CPU(struct cpuidle_device, omap4_idle_dev);
@@ -219,6 +356,8 @@ static struct cpuidle_driver omap4_idle_driver = {
 	.name				= "omap4_idle",
 	.owner				= THIS_MODULE,
 	.en_core_tk_irqen		= 1,
+	/* rough per CPU estimates, in mW */
+	.power_specified		= 1,
 	.states = {
 		{
 			/* C1 - CPU0 ON + CPU1 ON + MPU ON + CORE ON*/
@@ -226,6 +365,7 @@ static struct cpuidle_driver omap4_idle_driver = {
 			.target_residency = 5,
 			.flags = CPUIDLE_FLAG_TIME_VALID,
 			.enter = omap4_enter_idle_simple,
+			.power_usage = 40,
 			.name = "C1",
 			.desc = "MPUSS ON CORE ON",
 			.disable = 0,
@@ -236,6 +376,7 @@ static struct cpuidle_driver omap4_idle_driver = {
 			.target_residency = 350,
 			.flags = CPUIDLE_FLAG_TIME_VALID | CPUIDLE_FLAG_COUPLED,
 			.enter = omap4_enter_idle_coupled,
+			.power_usage = 10,
 			.name = "C2",
 			.desc = "MPUSS INA CORE INA",
 			.disable = 0,
@@ -246,6 +387,7 @@ static struct cpuidle_driver omap4_idle_driver = {
 			.target_residency = 960,
 			.flags = CPUIDLE_FLAG_TIME_VALID | CPUIDLE_FLAG_COUPLED,
 			.enter = omap4_enter_idle_coupled,
+			.power_usage = 4,
 			.name = "C3",
 			.desc = "MPUSS CSWR CORE CSWR",
 			.disable = 0,
@@ -256,6 +398,7 @@ static struct cpuidle_driver omap4_idle_driver = {
 			.target_residency = 1100,
 			.flags = CPUIDLE_FLAG_TIME_VALID | CPUIDLE_FLAG_COUPLED,
 			.enter = omap4_enter_idle_coupled,
+			.power_usage = 2,
 			.name = "C4",
 			.desc = "MPUSS OSWR CORE OSWR",
 			.disable = 0,
@@ -265,6 +408,64 @@ static struct cpuidle_driver omap4_idle_driver = {
 	.safe_state_index = 0,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int omap4_idle_stats_show(struct seq_file *s, void *unused)
+{
+	int i, j, cpu;
+
+	seq_printf(s, "%-4s %10s %10s %10s", "", "entries", "aborts",
+		   "demoted");
+	for (j = 0; j < OMAP4_IDLE_BUCKETS - 1; j++)
+		seq_printf(s, "  <%-8u", omap4_idle_buckets[j]);
+	seq_printf(s, " %10s\n", "longer");
+
+	for (i = 0; i < omap4_idle_driver.state_count; i++) {
+		u32 entries = 0, aborts = 0, demotions = 0;
+		u32 hist[OMAP4_IDLE_BUCKETS] = { 0 };
+
+		for_each_possible_cpu(cpu) {
+			struct omap4_idle_stats *st =
+					&per_cpu(omap4_idle_stats, cpu);
+
+			entries += st->entries[i];
+			aborts += st->aborts[i];
+			demotions += st->demotions[i];
+			for (j = 0; j < OMAP4_IDLE_BUCKETS; j++)
+				hist[j] += st->hist[i][j];
+		}
+
+		seq_printf(s, "%-4s %10u %10u %10u",
+			   omap4_idle_driver.states[i].name,
+			   entries, aborts, demotions);
+		for (j = 0; j < OMAP4_IDLE_BUCKETS; j++)
+			seq_printf(s, " %10u", hist[j]);
+		seq_printf(s, "\n");
+	}
+
+	return 0;
+}
+
+static int omap4_idle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap4_idle_stats_show, NULL);
+}
+
+static const struct file_operations omap4_idle_stats_fops = {
+	.open		= omap4_idle_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init omap4_idle_debugfs_init(void)
+{
+	debugfs_create_file("cpuidle44xx", S_IRUGO, NULL, NULL,
+			    &omap4_idle_stats_fops);
+}
+#else
+static inline void omap4_idle_debugfs_init(void) { }
+#endif
+
 /**
  * omap4_idle_init - Init routine for OMAP4 idle
  *
@@ -308,5 +509,7 @@ int __init omap4_idle_init(void)
 		}
 	}
 
+	omap4_idle_debugfs_init();
+
 	return 0;
 }
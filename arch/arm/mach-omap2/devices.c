@@ -729,6 +729,7 @@ static int __init omap_mcspi_init(struct omap_hwmod *oh, void *unused)
 	}
 
 	pdata->num_cs = mcspi_attrib->num_chipselect;
+	pdata->context_lost = omap_pm_dev_context_lost;
 	switch (oh->class->rev) {
 	case OMAP2_MCSPI_REV:
 	case OMAP3_MCSPI_REV:
@@ -1117,6 +1118,14 @@ static struct omap_device_pm_latency omap_cam_latency[] = {
 	}
 };
 
+static void __init omap_init_elm(void)
+{
+	if (!cpu_is_omap44xx())
+		return;
+
+	omap_init_dev("elm", NULL, 0);
+}
+
 static void __init omap_init_fdif(void)
 {
 	if (!cpu_is_omap44xx() && !cpu_is_omap54xx())
@@ -1229,6 +1238,7 @@ static int __init omap2_init_devices(void)
 	omap_init_aes();
 	omap_init_vout();
 	omap_init_ocp2scp();
+	omap_init_elm();
 	omap_init_fdif();
 	omap_init_sl2if();
 	omap_init_iss();
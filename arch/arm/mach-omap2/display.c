@@ -351,6 +351,7 @@ int __init omap_display_init(struct omap_dss_board_info *board_data)
 	board_data->dsi_enable_pads = omap_dsi_enable_pads;
 	board_data->dsi_disable_pads = omap_dsi_disable_pads;
 	board_data->get_context_loss_count = omap_pm_get_dev_context_loss_count;
+	board_data->context_lost = omap_pm_dev_context_lost;
 
 	omap_display_device.dev.platform_data = board_data;
 
@@ -22,6 +22,8 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/pm_qos.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 #include <linux/power/smartreflex.h>
 #include <plat/common.h>
 #include <plat/omap_device.h>
@@ -33,6 +35,8 @@
 #include "pm.h"
 #include "abb.h"
 
+#include <trace/events/dvfs.h>
+
 /**
  * DOC: Introduction
  * =================
@@ -143,12 +147,38 @@ struct omap_dev_user_list {
  * @node:	The list head entry
  * @clk:	frequency control clock for this dev
  * @user_lock:	The lock for plist manipulation
+ * @req_rate:	last rate asked for with omap_device_scale(), 0 if none
+ * @floor_rate:	rate set with omap_device_scale_floor(), 0 if none
+ * @dvfs_info:	the vdd this device belongs to
+ * @opp_nb:	OPP change notifier, invalidates the cached lookups
+ * @opp_gen:	incremented on every change of the OPP table of @dev
+ * @cache_gen:	value of @opp_gen the cached lookups were made at
+ * @cache_rate:	last rate looked up, and its voltage in @cache_rate_volt
+ * @cache_rate_volt: voltage of the OPP for @cache_rate
+ * @cache_volt:	last voltage looked up, and its rate in @cache_freq
+ * @cache_freq:	rate of the highest OPP at @cache_volt
+ * @async_rate:	rate queued with omap_device_scale_async()
+ * @async_pending: @async_rate waits for the next batched transition
  */
 struct omap_vdd_dev_list {
 	struct device *dev;
 	struct list_head node;
 	struct clk *clk;
 	spinlock_t user_lock; /* spinlock for plist */
+	unsigned long req_rate;
+	unsigned long floor_rate;
+	struct omap_vdd_dvfs_info *dvfs_info;
+
+	struct notifier_block opp_nb;
+	atomic_t opp_gen;
+	int cache_gen;
+	unsigned long cache_rate;
+	unsigned long cache_rate_volt;
+	unsigned long cache_volt;
+	unsigned long cache_freq;
+
+	unsigned long async_rate;
+	bool async_pending;
 };
 
 /**
@@ -162,6 +192,29 @@ struct omap_vdd_user_list {
 	struct plist_node node;
 };
 
+/* Transition latency histogram bucket upper bounds, in us */
+static const u32 dvfs_lat_buckets[] = { 100, 250, 500, 1000, 2500, 5000, ~0 };
+#define DVFS_LAT_BUCKETS	ARRAY_SIZE(dvfs_lat_buckets)
+
+/**
+ * struct omap_vdd_dvfs_stats - The per vdd transition statistics
+ * @transitions: number of transitions of the vdd
+ * @requests:	number of requests served by these transitions
+ * @superseded:	asynchronous requests replaced before being served
+ * @lat_max_us:	longest transition
+ * @lat_hist:	transition latency histogram, see dvfs_lat_buckets
+ *
+ * Protected by omap_dvfs_lock, except for @superseded which is protected
+ * by dvfs_async_lock.
+ */
+struct omap_vdd_dvfs_stats {
+	u32 transitions;
+	u32 requests;
+	u32 superseded;
+	u32 lat_max_us;
+	u32 lat_hist[DVFS_LAT_BUCKETS];
+};
+
 /**
  * struct omap_vdd_dvfs_info - The per vdd dvfs info
  * @node:	list node for vdd_dvfs_info list
@@ -169,6 +222,8 @@ struct omap_vdd_user_list {
  * @vdd_user_list: The vdd user list
  * @voltdm:	Voltage domains for which dvfs info stored
  * @dev_list:	Device list maintained per domain
+ * @async_work:	runs the batched transition for omap_device_scale_async()
+ * @stats:	transition statistics
  *
  * This is a fundamental structure used to store all the required
  * DVFS related information for a vdd.
@@ -180,6 +235,9 @@ struct omap_vdd_dvfs_info {
 	struct plist_head vdd_user_list;
 	struct voltagedomain *voltdm;
 	struct list_head dev_list;
+
+	struct delayed_work async_work;
+	struct omap_vdd_dvfs_stats stats;
 };
 
 static LIST_HEAD(omap_dvfs_info_list);
@@ -192,6 +250,17 @@ static struct pm_qos_request omap_dvfs_pm_qos_handle;
 /* DVFS suspend status*/
 static bool dvfs_suspended;
 
+/*
+ * Asynchronous requests are held for this long before the transition
+ * runs, so that requests arriving close together (MPU, GPU, IVA during
+ * a multimedia burst) are served by a single transition of the vdd.
+ * Requests queued while a transition is in progress are batched anyway.
+ */
+static u32 dvfs_batch_window_ms;
+
+/* Protects the async_* fields of the device lists */
+static DEFINE_SPINLOCK(dvfs_async_lock);
+
 /* Dvfs scale helper function */
 static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 		struct omap_vdd_dvfs_info *tdvfs_info);
@@ -240,6 +309,29 @@ static struct omap_vdd_dvfs_info *_dev_to_dvfs_info(struct device *dev)
 	return NULL;
 }
 
+/**
+ * _dev_to_dev_list() - Locate the dev_list entry of a device
+ * @dev:	dev to search for
+ *
+ * Returns NULL on failure.
+ */
+static struct omap_vdd_dev_list *_dev_to_dev_list(struct device *dev)
+{
+	struct omap_vdd_dvfs_info *dvfs_info;
+	struct omap_vdd_dev_list *temp_dev;
+
+	dvfs_info = _dev_to_dvfs_info(dev);
+	if (!dvfs_info)
+		return NULL;
+
+	list_for_each_entry(temp_dev, &dvfs_info->dev_list, node) {
+		if (temp_dev->dev == dev)
+			return temp_dev;
+	}
+
+	return NULL;
+}
+
 /**
  * _voltdm_to_dvfs_info() - Locate a dvfs_info given a voltdm pointer
  * @voltdm:	voltdm to search for
@@ -324,6 +416,91 @@ static struct opp *_volt_to_opp_floor(struct device *dev, unsigned long volt)
 }
 
 /* rest of the helper functions */
+/* Drop the cached OPP lookups of @temp_dev if its OPP table changed */
+static void _dev_cache_sync(struct omap_vdd_dev_list *temp_dev)
+{
+	int gen = atomic_read(&temp_dev->opp_gen);
+
+	if (temp_dev->cache_gen == gen)
+		return;
+
+	temp_dev->cache_gen = gen;
+	temp_dev->cache_rate = 0;
+	temp_dev->cache_volt = 0;
+}
+
+/**
+ * _rate_to_volt() - Find the voltage needed for a device rate
+ * @temp_dev:	the device
+ * @rate:	the rate looked for, rounded up to the next OPP
+ *
+ * Must be called with omap_dvfs_lock held. Returns 0 if there is no OPP
+ * for @rate.
+ */
+static unsigned long _rate_to_volt(struct omap_vdd_dev_list *temp_dev,
+				   unsigned long rate)
+{
+	struct opp *opp;
+	unsigned long freq = rate, volt = 0;
+
+	_dev_cache_sync(temp_dev);
+	if (temp_dev->cache_rate && temp_dev->cache_rate == rate)
+		return temp_dev->cache_rate_volt;
+
+	rcu_read_lock();
+	opp = opp_find_freq_ceil(temp_dev->dev, &freq);
+	if (!IS_ERR(opp))
+		volt = opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	if (volt) {
+		temp_dev->cache_rate = rate;
+		temp_dev->cache_rate_volt = volt;
+	}
+	return volt;
+}
+
+/**
+ * _volt_to_freq() - Find the highest device rate for a voltage
+ * @temp_dev:	the device
+ * @volt:	the nominal voltage of the vdd
+ *
+ * Must be called with omap_dvfs_lock held. Returns 0 if the device has no
+ * OPP at or below @volt.
+ */
+static unsigned long _volt_to_freq(struct omap_vdd_dev_list *temp_dev,
+				   unsigned long volt)
+{
+	struct opp *opp;
+	unsigned long freq = 0;
+
+	_dev_cache_sync(temp_dev);
+	if (temp_dev->cache_volt && temp_dev->cache_volt == volt)
+		return temp_dev->cache_freq;
+
+	rcu_read_lock();
+	opp = _volt_to_opp_floor(temp_dev->dev, volt);
+	if (!IS_ERR(opp))
+		freq = opp_get_freq(opp);
+	rcu_read_unlock();
+
+	if (freq) {
+		temp_dev->cache_volt = volt;
+		temp_dev->cache_freq = freq;
+	}
+	return freq;
+}
+
+static int _dev_opp_notify(struct notifier_block *nb, unsigned long event,
+			   void *data)
+{
+	struct omap_vdd_dev_list *temp_dev =
+		container_of(nb, struct omap_vdd_dev_list, opp_nb);
+
+	atomic_inc(&temp_dev->opp_gen);
+	return NOTIFY_OK;
+}
+
 /**
  * _add_vdd_user() - Add a voltage request
  * @dvfs_info:	omap_vdd_dvfs_info pointer for the required vdd
@@ -443,11 +620,20 @@ static int _dep_scan_table(struct device *dev,
 		return -EINVAL;
 	}
 
-	/* Now scan through the the dep table for a match */
-	for (i = 0; i < dep_info->nr_dep_entries; i++) {
-		if (dep_table[i].main_vdd_volt == main_volt) {
-			dep_volt = dep_table[i].dep_vdd_volt;
-			break;
+	/* The tables are static, the last match is good until main_volt moves */
+	if (dep_info->_main_volt == main_volt) {
+		dep_volt = dep_info->_dep_volt;
+	} else {
+		/* Now scan through the the dep table for a match */
+		for (i = 0; i < dep_info->nr_dep_entries; i++) {
+			if (dep_table[i].main_vdd_volt == main_volt) {
+				dep_volt = dep_table[i].dep_vdd_volt;
+				break;
+			}
+		}
+		if (dep_volt) {
+			dep_info->_main_volt = main_volt;
+			dep_info->_dep_volt = dep_volt;
 		}
 	}
 	if (!dep_volt) {
@@ -592,6 +778,7 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	struct omap_vdd_dev_list *temp_dev;
 	struct plist_node *node;
 	int ret = 0;
+	bool volt_started = false;
 	struct voltagedomain *voltdm;
 	struct omap_volt_data *new_vdata;
 	struct omap_volt_data *curr_vdata;
@@ -632,11 +819,31 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	/* Make a decision to scale dependent domain based on nominal voltage */
 	if (omap_get_nominal_voltage(new_vdata) >
 					omap_get_nominal_voltage(curr_vdata)) {
+		/*
+		 * Our own ramp does not need to wait for the dependent
+		 * domains, only our frequencies do: let it run alongside
+		 * theirs. ABB has to be switched around the ramp, so domains
+		 * with ABB stay strictly sequential.
+		 */
+		if (!voltdm->abb && curr_volt < new_volt) {
+			trace_dvfs_voltage(voltdm->name, curr_volt, new_volt);
+			ret = voltdm_scale_start(voltdm, new_vdata);
+			if (ret) {
+				dev_err(target_dev,
+					"%s: Unable to scale the %s to %ld volt\n",
+					__func__, voltdm->name, new_volt);
+				goto out;
+			}
+			volt_started = true;
+		}
+
 		ret = _dep_scale_domains(target_dev, voltdm->dep_vdd_info);
 		if (ret) {
 			dev_err(target_dev,
 				"%s: Error(%d)scale dependent with %ld volt\n",
 				__func__, ret, new_volt);
+			if (volt_started)
+				voltdm_scale_finish(voltdm);
 			goto fail;
 		}
 	}
@@ -651,12 +858,18 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 		}
 	}
 
+	if (!volt_started)
+		trace_dvfs_voltage(voltdm->name, curr_volt, new_volt);
+
 	/* Now decide on switching OPP */
 	if (curr_volt == new_volt) {
 		volt_scale_dir = DVFS_VOLT_SCALE_NONE;
 	} else if (curr_volt < new_volt) {
 
-		ret = voltdm_scale(voltdm, new_vdata);
+		if (volt_started)
+			ret = voltdm_scale_finish(voltdm);
+		else
+			ret = voltdm_scale(voltdm, new_vdata);
 		if (ret) {
 			dev_err(target_dev,
 				"%s: Unable to scale the %s to %ld volt\n",
@@ -687,25 +900,21 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 			tdvfs_info->dev_list.prev : tdvfs_info->dev_list.next;
 	while (dev_list != &tdvfs_info->dev_list) {
 		struct device *dev;
-		struct opp *opp;
-		unsigned long freq = 0;
+		unsigned long freq, old_freq;
 		int r;
 
 		temp_dev = list_entry(dev_list, struct omap_vdd_dev_list, node);
 		dev = temp_dev->dev;
-		rcu_read_lock();
-		opp = _volt_to_opp_floor(dev,
-					 omap_get_nominal_voltage(new_vdata));
-		if (!IS_ERR(opp))
-			freq = opp_get_freq(opp);
-		rcu_read_unlock();
+		freq = _volt_to_freq(temp_dev,
+				     omap_get_nominal_voltage(new_vdata));
 		if (!freq) {
 			dev_err(dev, "%s: can't find freq for voltage %lu\n",
 				__func__, omap_get_nominal_voltage(new_vdata));
 			goto next;
 		}
 
-		if (freq == clk_get_rate(temp_dev->clk)) {
+		old_freq = clk_get_rate(temp_dev->clk);
+		if (freq == old_freq) {
 			dev_dbg(dev, "%s: Already at the requested rate %ld\n",
 				__func__, freq);
 			goto next;
@@ -716,6 +925,9 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 			dev_err(dev, "%s: clk set rate frq=%ld failed(%d)\n",
 				__func__, freq, r);
 			ret = r;
+		} else {
+			trace_dvfs_frequency(voltdm->name, dev_name(dev),
+					     old_freq, freq);
 		}
 next:
 		dev_list = (volt_scale_dir == DVFS_VOLT_SCALE_DOWN) ?
@@ -735,8 +947,14 @@ next:
 		}
 	}
 
-	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir)
-		voltdm_scale(voltdm, new_vdata);
+	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir) {
+		/* as on the way up, overlap our ramp with the dependents' */
+		if (!voltdm->abb && omap_get_nominal_voltage(new_vdata) <
+				omap_get_nominal_voltage(curr_vdata))
+			volt_started = !voltdm_scale_start(voltdm, new_vdata);
+		else
+			voltdm_scale(voltdm, new_vdata);
+	}
 
 	if (voltdm->abb && omap_get_nominal_voltage(new_vdata) <
 			omap_get_nominal_voltage(curr_vdata)) {
@@ -752,6 +970,9 @@ next:
 		_dep_scale_domains(target_dev, voltdm->dep_vdd_info);
 	}
 
+	if (volt_started && DVFS_VOLT_SCALE_DOWN == volt_scale_dir)
+		voltdm_scale_finish(voltdm);
+
 	/* Ensure that current voltage data pointer points to new volt */
 	if (volt_scale_dir == DVFS_VOLT_SCALE_NONE &&
 	    omap_get_nominal_voltage(new_vdata) !=
@@ -783,48 +1004,207 @@ out:
  * DVFS transitions will be prohibited and omap_device_scale()
  * will return -EPERM.
  *
- * suspend = fasle will restore normal DVFS work.
+ * suspend = fasle will restore normal DVFS work, and run the asynchronous
+ * requests that were queued in the meantime.
  */
 void omap_dvfs_suspend(bool suspend)
 {
+	struct omap_vdd_dvfs_info *dvfs_info;
+
 	mutex_lock(&omap_dvfs_lock);
 	dvfs_suspended = suspend;
+	if (!suspend)
+		list_for_each_entry(dvfs_info, &omap_dvfs_info_list, node)
+			queue_delayed_work(system_freezable_wq,
+					   &dvfs_info->async_work, 0);
 	mutex_unlock(&omap_dvfs_lock);
 }
 
 /**
- * omap_device_scale() - Set a new rate at which the device is to operate
- * @target_dev:	pointer to the device that is to be scaled
- * @rate:	the rnew rate for the device.
+ * _omap_device_request() - Record the voltage request for a device rate
+ * @temp_dev:	the device that is to be scaled
+ * @rate:	the new rate for the device.
  *
- * This API gets the device opp table associated with this device and
- * tries putting the device to the requested rate and the voltage domain
- * associated with the device to the voltage corresponding to the
- * requested rate. Since multiple devices can be assocciated with a
- * voltage domain this API finds out the possible voltage the
- * voltage domain can enter and then decides on the final device
- * rate.
+ * Adds the voltage @rate needs to the requests of the vdd of @temp_dev and
+ * of its dependent vdds. The transition itself is left to the caller.
  *
- * IMPORTANT NOTE: This API assumes that there is ONLY one requestor per
- * target device. If there are multiple an abstraction API needs to be
- * created on a need basis to consolidate and arbitrate among requestors
- * and provide a singular request to this API.
- *
- * Return 0 on success else the error value
+ * Must be called with omap_dvfs_lock held. Return 0 on success else the
+ * error value
  */
-int omap_device_scale(struct device *target_dev, unsigned long rate)
+static int _omap_device_request(struct omap_vdd_dev_list *temp_dev,
+				unsigned long rate)
 {
-	struct opp *opp;
-	unsigned long volt, freq = rate;
-	struct omap_vdd_dvfs_info *tdvfs_info;
-	struct platform_device *pdev;
-	struct omap_device *od;
-	int ret = 0;
+	struct omap_vdd_dvfs_info *tdvfs_info = temp_dev->dvfs_info;
+	struct device *target_dev = temp_dev->dev;
+	unsigned long volt;
+	int ret;
+
+	volt = _rate_to_volt(temp_dev, rate);
+	if (!volt) {
+		dev_err(target_dev, "%s: Unable to find OPP for freq%ld\n",
+			__func__, rate);
+		return -ENODEV;
+	}
+
 	/*
 	 * For our internal tracking system - the request and target devices
 	 * are the same
 	 */
-	struct device *req_dev = target_dev;
+	ret = _add_vdd_user(tdvfs_info, target_dev, volt);
+	if (ret) {
+		dev_err(target_dev, "%s: failed %d[f=%ld, v=%ld]\n",
+			__func__, ret, rate, volt);
+		return ret;
+	}
+
+	/* Check for any dep domains and add the user request */
+	ret = _dep_scan_domains(target_dev,
+			tdvfs_info->voltdm->dep_vdd_info, volt);
+	if (ret)
+		dev_err(target_dev,
+			"%s: Error in scan domains for vdd_%s\n",
+			__func__, tdvfs_info->voltdm->name);
+	return ret;
+}
+
+/**
+ * _dvfs_take_async() - Record the queued asynchronous requests of a vdd
+ * @dvfs_info:	the vdd
+ *
+ * The requests are served by the next transition of the vdd, whoever
+ * triggers it. Must be called with omap_dvfs_lock held.
+ *
+ * Returns the number of requests taken.
+ */
+static int _dvfs_take_async(struct omap_vdd_dvfs_info *dvfs_info)
+{
+	struct omap_vdd_dev_list *temp_dev;
+	unsigned long flags, rate;
+	bool pending;
+	int n = 0;
+
+	list_for_each_entry(temp_dev, &dvfs_info->dev_list, node) {
+		spin_lock_irqsave(&dvfs_async_lock, flags);
+		pending = temp_dev->async_pending;
+		rate = temp_dev->async_rate;
+		temp_dev->async_pending = false;
+		spin_unlock_irqrestore(&dvfs_async_lock, flags);
+
+		if (!pending)
+			continue;
+
+		temp_dev->req_rate = rate;
+		if (!_omap_device_request(temp_dev,
+					  max(rate, temp_dev->floor_rate)))
+			n++;
+	}
+
+	return n;
+}
+
+/**
+ * _dvfs_scale_timed() - _dvfs_scale() accounted in the vdd statistics
+ * @req_dev:	Device requesting the scale
+ * @target_dev:	Device requesting to be scaled
+ * @tdvfs_info:	omap_vdd_dvfs_info pointer for the target domain
+ * @requests:	number of requests served by this transition
+ */
+static int _dvfs_scale_timed(struct device *req_dev,
+			     struct device *target_dev,
+			     struct omap_vdd_dvfs_info *tdvfs_info,
+			     int requests)
+{
+	struct omap_vdd_dvfs_stats *stats = &tdvfs_info->stats;
+	ktime_t start = ktime_get();
+	u32 us;
+	int ret, i;
+
+	/* I would like CPU to be active always at this point */
+	omap_dvfs_pm_qos_handle.dev = target_dev;
+	pm_qos_update_request(&omap_dvfs_pm_qos_handle, 0);
+
+	ret = _dvfs_scale(req_dev, target_dev, tdvfs_info);
+
+	/* Remove the latency requirement */
+	pm_qos_update_request(&omap_dvfs_pm_qos_handle, PM_QOS_DEFAULT_VALUE);
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	stats->transitions++;
+	stats->requests += requests;
+	stats->lat_max_us = max(stats->lat_max_us, us);
+	for (i = 0; us > dvfs_lat_buckets[i]; i++)
+		;
+	stats->lat_hist[i]++;
+
+	return ret;
+}
+
+/**
+ * _omap_device_scale() - Scale a device and its voltage domain
+ * @temp_dev:	the device that is to be scaled
+ *
+ * Scales the device to the highest of its request and floor. Asynchronous
+ * requests queued on the same vdd are served by the same transition.
+ * Must be called with omap_dvfs_lock held.
+ *
+ * Return 0 on success else the error value
+ */
+static int _omap_device_scale(struct omap_vdd_dev_list *temp_dev)
+{
+	struct omap_vdd_dvfs_info *tdvfs_info = temp_dev->dvfs_info;
+	struct device *target_dev = temp_dev->dev;
+	unsigned long rate;
+	int ret, n;
+
+	n = _dvfs_take_async(tdvfs_info);
+
+	rate = max(temp_dev->req_rate, temp_dev->floor_rate);
+	ret = _omap_device_request(temp_dev, rate);
+	if (ret)
+		return ret;
+
+	/* Do the actual scaling */
+	ret = _dvfs_scale_timed(target_dev, target_dev, tdvfs_info, n + 1);
+	if (ret) {
+		dev_err(target_dev, "%s:scale by %pF failed %d[f=%ld]\n",
+			__func__, (void *)_RET_IP_, ret, rate);
+		_remove_vdd_user(tdvfs_info, target_dev);
+	}
+
+	return ret;
+}
+
+static void _dvfs_async_work(struct work_struct *work)
+{
+	struct omap_vdd_dvfs_info *dvfs_info =
+		container_of(work, struct omap_vdd_dvfs_info, async_work.work);
+	struct device *target_dev;
+	int n, ret;
+
+	mutex_lock(&omap_dvfs_lock);
+
+	/* omap_dvfs_suspend() requeues us on resume */
+	if (dvfs_suspended)
+		goto out;
+
+	n = _dvfs_take_async(dvfs_info);
+	if (!n)
+		goto out;
+
+	target_dev = _dvfs_info_to_dev(dvfs_info);
+	ret = _dvfs_scale_timed(target_dev, target_dev, dvfs_info, n);
+	if (ret)
+		pr_err("%s: vdd_%s batched scale failed %d\n", __func__,
+		       dvfs_info->voltdm->name, ret);
+out:
+	mutex_unlock(&omap_dvfs_lock);
+}
+
+/* Common checks of omap_device_scale() and omap_device_scale_floor() */
+static int _omap_device_scale_check(struct device *target_dev)
+{
+	struct platform_device *pdev;
+	struct omap_device *od;
 
 	pdev = container_of(target_dev, struct platform_device, dev);
 	if (IS_ERR_OR_NULL(pdev)) {
@@ -843,6 +1223,40 @@ int omap_device_scale(struct device *target_dev, unsigned long rate)
 		return -EBUSY;
 	}
 
+	return 0;
+}
+
+/**
+ * omap_device_scale() - Set a new rate at which the device is to operate
+ * @target_dev:	pointer to the device that is to be scaled
+ * @rate:	the rnew rate for the device.
+ *
+ * This API gets the device opp table associated with this device and
+ * tries putting the device to the requested rate and the voltage domain
+ * associated with the device to the voltage corresponding to the
+ * requested rate. Since multiple devices can be assocciated with a
+ * voltage domain this API finds out the possible voltage the
+ * voltage domain can enter and then decides on the final device
+ * rate.
+ *
+ * IMPORTANT NOTE: This API assumes that there is ONLY one requestor per
+ * target device. If there are multiple an abstraction API needs to be
+ * created on a need basis to consolidate and arbitrate among requestors
+ * and provide a singular request to this API. The only arbitration done
+ * here is against the floor set with omap_device_scale_floor().
+ *
+ * Return 0 on success else the error value
+ */
+int omap_device_scale(struct device *target_dev, unsigned long rate)
+{
+	struct omap_vdd_dev_list *temp_dev;
+	unsigned long flags;
+	int ret;
+
+	ret = _omap_device_scale_check(target_dev);
+	if (ret)
+		return ret;
+
 	/* Lock me to ensure cross domain scaling is secure */
 	mutex_lock(&omap_dvfs_lock);
 
@@ -853,63 +1267,143 @@ int omap_device_scale(struct device *target_dev, unsigned long rate)
 		return -EPERM;
 	}
 
-	/* I would like CPU to be active always at this point */
-	omap_dvfs_pm_qos_handle.dev = target_dev;
-	pm_qos_update_request(&omap_dvfs_pm_qos_handle, 0);
+	temp_dev = _dev_to_dev_list(target_dev);
+	if (!temp_dev) {
+		dev_err(target_dev, "%s: %pF no vdd! (freq%ld)\n",
+			__func__, (void *)_RET_IP_, rate);
+		mutex_unlock(&omap_dvfs_lock);
+		return -ENODEV;
+	}
 
-	rcu_read_lock();
-	opp = opp_find_freq_ceil(target_dev, &freq);
-	if (IS_ERR(opp)) {
-		rcu_read_unlock();
-		dev_err(target_dev, "%s: %pF Unable to find OPP for freq%ld\n",
+	/* this request is newer than any still queued for the device */
+	spin_lock_irqsave(&dvfs_async_lock, flags);
+	temp_dev->async_pending = false;
+	spin_unlock_irqrestore(&dvfs_async_lock, flags);
+
+	temp_dev->req_rate = rate;
+	ret = _omap_device_scale(temp_dev);
+
+	mutex_unlock(&omap_dvfs_lock);
+	return ret;
+}
+EXPORT_SYMBOL(omap_device_scale);
+
+/**
+ * omap_device_scale_async() - Queue a new rate for a device
+ * @target_dev:	pointer to the device that is to be scaled
+ * @rate:	the new rate for the device.
+ *
+ * Same as omap_device_scale(), but the transition is left to a work item,
+ * which serves all the requests queued on the voltage domain of the device
+ * with a single transition. A request replaces any request for the same
+ * device still in the queue. For requestors that cannot or need not wait
+ * for the voltage to ramp; errors of the transition are only logged.
+ *
+ * Can be called from any context. Return 0 if the request was queued
+ * else the error value
+ */
+int omap_device_scale_async(struct device *target_dev, unsigned long rate)
+{
+	struct omap_vdd_dev_list *temp_dev;
+	unsigned long flags;
+	int ret;
+
+	ret = _omap_device_scale_check(target_dev);
+	if (ret)
+		return ret;
+
+	/* device lists only grow, and only at registration */
+	temp_dev = _dev_to_dev_list(target_dev);
+	if (!temp_dev) {
+		dev_err(target_dev, "%s: %pF no vdd! (freq%ld)\n",
 			__func__, (void *)_RET_IP_, rate);
-		ret = -ENODEV;
-		goto out;
+		return -ENODEV;
 	}
-	volt = opp_get_voltage(opp);
-	rcu_read_unlock();
 
-	tdvfs_info = _dev_to_dvfs_info(target_dev);
-	if (IS_ERR_OR_NULL(tdvfs_info)) {
-		dev_err(target_dev, "%s: %pF no vdd![f=%ld, v=%ld]\n",
-			__func__, (void *)_RET_IP_, freq, volt);
-		ret = -ENODEV;
+	spin_lock_irqsave(&dvfs_async_lock, flags);
+	if (temp_dev->async_pending)
+		temp_dev->dvfs_info->stats.superseded++;
+	temp_dev->async_rate = rate;
+	temp_dev->async_pending = true;
+	spin_unlock_irqrestore(&dvfs_async_lock, flags);
+
+	queue_delayed_work(system_freezable_wq, &temp_dev->dvfs_info->async_work,
+			   msecs_to_jiffies(dvfs_batch_window_ms));
+	return 0;
+}
+EXPORT_SYMBOL(omap_device_scale_async);
+
+/**
+ * omap_device_scale_floor() - Set a minimum rate for a device
+ * @target_dev:	pointer to the device that is to be scaled
+ * @floor:	the minimum rate for the device, 0 to drop the floor.
+ *
+ * Keeps @target_dev at or above @floor whatever its regular requestor
+ * asks for with omap_device_scale(), e.g. for a short boost on user
+ * input. When the floor is dropped the device goes back to the rate last
+ * requested with omap_device_scale(), or to the rate it was running at
+ * when the floor was set if there was no such request.
+ *
+ * Return 0 on success else the error value
+ */
+int omap_device_scale_floor(struct device *target_dev, unsigned long floor)
+{
+	struct omap_vdd_dev_list *temp_dev;
+	int ret;
+
+	ret = _omap_device_scale_check(target_dev);
+	if (ret)
+		return ret;
+
+	mutex_lock(&omap_dvfs_lock);
+
+	if (dvfs_suspended) {
+		ret = -EPERM;
 		goto out;
 	}
 
-	ret = _add_vdd_user(tdvfs_info, req_dev, volt);
-	if (ret) {
-		dev_err(target_dev, "%s: %pF failed %d[f=%ld, v=%ld]\n",
-			__func__, (void *)_RET_IP_, ret, freq, volt);
+	temp_dev = _dev_to_dev_list(target_dev);
+	if (!temp_dev) {
+		dev_err(target_dev, "%s: not registered for dvfs\n", __func__);
+		ret = -ENODEV;
 		goto out;
 	}
 
-	/* Check for any dep domains and add the user request */
-	ret = _dep_scan_domains(target_dev,
-			tdvfs_info->voltdm->dep_vdd_info, volt);
-	if (ret) {
-		dev_err(target_dev,
-			"%s: Error in scan domains for vdd_%s\n",
-			__func__, tdvfs_info->voltdm->name);
+	if (temp_dev->floor_rate == floor)
 		goto out;
-	}
 
-	/* Do the actual scaling */
-	ret = _dvfs_scale(req_dev, target_dev, tdvfs_info);
-	if (ret) {
-		dev_err(target_dev, "%s:scale by %pF failed %d[f=%ld, v=%ld]\n",
-			__func__, (void *)_RET_IP_, ret, freq, volt);
-		_remove_vdd_user(tdvfs_info, target_dev);
-		/* Fall through */
-	}
-	/* Fall through */
+	if (!temp_dev->req_rate)
+		temp_dev->req_rate = clk_get_rate(temp_dev->clk);
+	temp_dev->floor_rate = floor;
+
+	ret = _omap_device_scale(temp_dev);
 out:
-	/* Remove the latency requirement */
-	pm_qos_update_request(&omap_dvfs_pm_qos_handle, PM_QOS_DEFAULT_VALUE);
 	mutex_unlock(&omap_dvfs_lock);
 	return ret;
 }
-EXPORT_SYMBOL(omap_device_scale);
+EXPORT_SYMBOL(omap_device_scale_floor);
+
+/**
+ * omap_device_get_rate() - Get the rate a dvfs device is running at
+ * @target_dev:	pointer to the device
+ *
+ * Returns the current rate of the clock @target_dev was registered with,
+ * or 0 if it is not registered for dvfs.
+ */
+unsigned long omap_device_get_rate(struct device *target_dev)
+{
+	struct omap_vdd_dev_list *temp_dev;
+	unsigned long rate = 0;
+
+	mutex_lock(&omap_dvfs_lock);
+	temp_dev = _dev_to_dev_list(target_dev);
+	if (temp_dev)
+		rate = clk_get_rate(temp_dev->clk);
+	mutex_unlock(&omap_dvfs_lock);
+
+	return rate;
+}
+EXPORT_SYMBOL(omap_device_get_rate);
 
 #ifdef CONFIG_PM_DEBUG
 static int dvfs_dump_vdd(struct seq_file *sf, void *unused)
@@ -1029,6 +1523,45 @@ static const struct file_operations debugdvfs_fops = {
 	.release = single_release,
 };
 
+static int dvfs_dump_stats(struct seq_file *sf, void *unused)
+{
+	struct omap_vdd_dvfs_info *dvfs_info = sf->private;
+	struct omap_vdd_dvfs_stats *stats = &dvfs_info->stats;
+	unsigned long flags;
+	u32 superseded;
+	int i;
+
+	spin_lock_irqsave(&dvfs_async_lock, flags);
+	superseded = stats->superseded;
+	spin_unlock_irqrestore(&dvfs_async_lock, flags);
+
+	mutex_lock(&omap_dvfs_lock);
+	seq_printf(sf, "transitions: %u\n", stats->transitions);
+	seq_printf(sf, "requests:    %u\n", stats->requests);
+	seq_printf(sf, "superseded:  %u\n", superseded);
+	seq_printf(sf, "max latency: %uus\n", stats->lat_max_us);
+	seq_printf(sf, "latency histogram:\n");
+	for (i = 0; i < DVFS_LAT_BUCKETS - 1; i++)
+		seq_printf(sf, "  <%5uus: %u\n", dvfs_lat_buckets[i],
+			   stats->lat_hist[i]);
+	seq_printf(sf, "  longer:  %u\n", stats->lat_hist[i]);
+	mutex_unlock(&omap_dvfs_lock);
+
+	return 0;
+}
+
+static int dvfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dvfs_dump_stats, inode->i_private);
+}
+
+static const struct file_operations dvfs_stats_fops = {
+	.open = dvfs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static struct dentry *dvfsdebugfs_dir;
 
 static void dvfs_dbg_init(struct omap_vdd_dvfs_info *dvfs_info)
@@ -1036,8 +1569,13 @@ static void dvfs_dbg_init(struct omap_vdd_dvfs_info *dvfs_info)
 	struct dentry *ddir;
 
 	/* create a base dir */
-	if (!dvfsdebugfs_dir)
+	if (!dvfsdebugfs_dir) {
 		dvfsdebugfs_dir = debugfs_create_dir("dvfs", NULL);
+		if (!IS_ERR_OR_NULL(dvfsdebugfs_dir))
+			debugfs_create_u32("batch_window_ms", S_IRUGO | S_IWUSR,
+					   dvfsdebugfs_dir,
+					   &dvfs_batch_window_ms);
+	}
 	if (IS_ERR_OR_NULL(dvfsdebugfs_dir)) {
 		WARN_ONCE("%s: Unable to create base DVFS dir\n", __func__);
 		return;
@@ -1057,6 +1595,8 @@ static void dvfs_dbg_init(struct omap_vdd_dvfs_info *dvfs_info)
 
 	debugfs_create_file("info", S_IRUGO, ddir,
 			    (void *)dvfs_info, &debugdvfs_fops);
+	debugfs_create_file("stats", S_IRUGO, ddir,
+			    (void *)dvfs_info, &dvfs_stats_fops);
 }
 #else				/* CONFIG_PM_DEBUG */
 static inline void dvfs_dbg_init(struct omap_vdd_dvfs_info *dvfs_info)
@@ -1375,6 +1915,7 @@ int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 {
 	struct omap_vdd_dev_list *temp_dev;
 	struct omap_vdd_dvfs_info *dvfs_info;
+	struct srcu_notifier_head *opp_nh;
 	struct clk *clk = NULL;
 	struct voltagedomain *voltdm;
 	int ret = 0;
@@ -1419,6 +1960,8 @@ int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 		/* Init the device list */
 		INIT_LIST_HEAD(&dvfs_info->dev_list);
 
+		INIT_DELAYED_WORK(&dvfs_info->async_work, _dvfs_async_work);
+
 		list_add(&dvfs_info->node, &omap_dvfs_info_list);
 
 		dvfs_dbg_init(dvfs_info);
@@ -1453,6 +1996,16 @@ int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 
 	temp_dev->dev = dev;
 	temp_dev->clk = clk;
+	temp_dev->dvfs_info = dvfs_info;
+
+	/* Cached OPP lookups are dropped whenever the OPP table changes */
+	temp_dev->opp_nb.notifier_call = _dev_opp_notify;
+	rcu_read_lock();
+	opp_nh = opp_get_notifier(dev);
+	rcu_read_unlock();
+	if (!IS_ERR(opp_nh))
+		srcu_notifier_chain_register(opp_nh, &temp_dev->opp_nb);
+
 	list_add_tail(&temp_dev->node, &dvfs_info->dev_list);
 
 	/* Simpler to have a single request for all domains */
@@ -49,6 +49,10 @@
 #define GPMC_ECC_CONTROL	0x1f8
 #define GPMC_ECC_SIZE_CONFIG	0x1fc
 #define GPMC_ECC1_RESULT        0x200
+#define GPMC_BCH_RESULT0	0x240	/* + 0x10 * sector */
+#define GPMC_BCH_RESULT1	0x244
+#define GPMC_BCH_RESULT2	0x248
+#define GPMC_BCH_RESULT3	0x24c
 
 /* GPMC ECC control settings */
 #define GPMC_ECC_CTRL_ECCCLEAR		0x100
@@ -63,6 +67,13 @@
 #define GPMC_ECC_CTRL_ECCREG8		0x008
 #define GPMC_ECC_CTRL_ECCREG9		0x009
 
+/* GPMC BCH engine settings */
+#define GPMC_ECC_CONFIG_BCH		(1 << 16)
+#define GPMC_ECC_CONFIG_BCH8		(1 << 12)
+#define GPMC_BCH_WRAPMODE_READ		1	/* data, ecc, pad */
+#define GPMC_BCH_WRAPMODE_WRITE		6	/* data only */
+#define GPMC_BCH_MAX_SECTORS		8
+
 #define GPMC_CS0_OFFSET		0x60
 #define GPMC_CS_SIZE		0x30
 
@@ -939,3 +950,117 @@ int gpmc_calculate_ecc(int cs, const u_char *dat, u_char *ecc_code)
 	return 0;
 }
 EXPORT_SYMBOL_GPL(gpmc_calculate_ecc);
+
+/**
+ * gpmc_enable_hwecc_bch - enable the BCH engine for a page access
+ * @cs: chip select number
+ * @mode: GPMC_ECC_READ or GPMC_ECC_WRITE
+ * @dev_width: 0 for 8-bit, 1 for 16-bit device
+ * @nsectors: number of 512 byte sectors covered by this access
+ * @nerrors: 4 or 8, the BCH correction capability
+ *
+ * On write the engine encodes the data only.  On read it also runs over the
+ * ecc bytes read back from the spare area, so that the result registers hold
+ * the syndrome (zero for a clean sector) rather than a fresh ecc.  The read
+ * layout is BCH_ECC_BYTES(nerrors) of ecc per sector, then padding up to
+ * BCH_ECC_OOB_BYTES(nerrors); all sector data must be read before the spare.
+ */
+int gpmc_enable_hwecc_bch(int cs, int mode, int dev_width, int nsectors,
+			  int nerrors)
+{
+	unsigned int val, wr_mode, size0, size1;
+
+	if (nerrors != 4 && nerrors != 8)
+		return -EINVAL;
+	if (nsectors < 1 || nsectors > GPMC_BCH_MAX_SECTORS)
+		return -EINVAL;
+
+	/* check if ecc module is in used */
+	if (gpmc_ecc_used != -EINVAL)
+		return -EINVAL;
+
+	gpmc_ecc_used = cs;
+
+	/* sizes are in nibbles: ecc proper, then the pad up to the oob slot */
+	if (mode == GPMC_ECC_READ) {
+		wr_mode = GPMC_BCH_WRAPMODE_READ;
+		size0 = nerrors == 8 ? 26 : 13;
+		size1 = nerrors == 8 ? 2 : 3;
+	} else {
+		wr_mode = GPMC_BCH_WRAPMODE_WRITE;
+		size0 = 0;
+		size1 = 32;
+	}
+
+	gpmc_write_reg(GPMC_ECC_CONTROL, GPMC_ECC_CTRL_ECCCLEAR);
+	gpmc_write_reg(GPMC_ECC_SIZE_CONFIG, (size1 << 22) | (size0 << 12));
+
+	val = GPMC_ECC_CONFIG_BCH | (wr_mode << 8) | (dev_width << 7) |
+		(((nsectors - 1) & 0x7) << 4) | (cs << 1) | 0x1;
+	if (nerrors == 8)
+		val |= GPMC_ECC_CONFIG_BCH8;
+	gpmc_write_reg(GPMC_ECC_CONFIG, val);
+
+	gpmc_write_reg(GPMC_ECC_CONTROL,
+			GPMC_ECC_CTRL_ECCCLEAR | GPMC_ECC_CTRL_ECCREG1);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(gpmc_enable_hwecc_bch);
+
+/**
+ * gpmc_calculate_ecc_bch - read back the BCH engine result
+ * @cs: chip select number
+ * @nsectors: number of sectors, as passed to gpmc_enable_hwecc_bch()
+ * @nerrors: 4 or 8, as passed to gpmc_enable_hwecc_bch()
+ * @ecc_code: BCH_ECC_OOB_BYTES(nerrors) bytes per sector
+ *
+ * Each sector's result is stored most significant byte first, the order it
+ * is written to the spare area and the order the ELM expects a syndrome in.
+ * Trailing pad bytes are zeroed.
+ */
+int gpmc_calculate_ecc_bch(int cs, int nsectors, int nerrors, u_char *ecc_code)
+{
+	u32 r0, r1, r2, r3;
+	int i;
+
+	if (gpmc_ecc_used != cs)
+		return -EINVAL;
+
+	for (i = 0; i < nsectors; i++) {
+		r0 = gpmc_read_reg(GPMC_BCH_RESULT0 + i * 0x10);
+		r1 = gpmc_read_reg(GPMC_BCH_RESULT1 + i * 0x10);
+
+		if (nerrors == 8) {
+			r2 = gpmc_read_reg(GPMC_BCH_RESULT2 + i * 0x10);
+			r3 = gpmc_read_reg(GPMC_BCH_RESULT3 + i * 0x10);
+			*ecc_code++ = r3;
+			*ecc_code++ = r2 >> 24;
+			*ecc_code++ = r2 >> 16;
+			*ecc_code++ = r2 >> 8;
+			*ecc_code++ = r2;
+			*ecc_code++ = r1 >> 24;
+			*ecc_code++ = r1 >> 16;
+			*ecc_code++ = r1 >> 8;
+			*ecc_code++ = r1;
+			*ecc_code++ = r0 >> 24;
+			*ecc_code++ = r0 >> 16;
+			*ecc_code++ = r0 >> 8;
+			*ecc_code++ = r0;
+			*ecc_code++ = 0;
+		} else {
+			/* 52 bits, left aligned in 7 bytes */
+			*ecc_code++ = r1 >> 12;
+			*ecc_code++ = r1 >> 4;
+			*ecc_code++ = ((r1 & 0xf) << 4) | ((r0 >> 28) & 0xf);
+			*ecc_code++ = r0 >> 20;
+			*ecc_code++ = r0 >> 12;
+			*ecc_code++ = r0 >> 4;
+			*ecc_code++ = (r0 & 0xf) << 4;
+			*ecc_code++ = 0;
+		}
+	}
+
+	gpmc_ecc_used = -EINVAL;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(gpmc_calculate_ecc_bch);
@@ -0,0 +1,319 @@
+/*
+ * OMAP touch input boost
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * A touch is the start of a frame the user is waiting for.  Rather than
+ * letting each governor ramp up on its own once the load shows up, the
+ * CPU (through the interactive governor), the L3/EMIF bandwidth (through
+ * PM QoS) and the GPU (through a dvfs floor) are raised together as soon
+ * as the touch is reported, and held for boost_ms after the last event.
+ * The time from the first touch to the first frame displayed after it is
+ * recorded so that the boost settings can be tuned against it.
+ */
+
+#define pr_fmt(fmt) "%s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/input.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/cpufreq.h>
+#include <linux/pm_qos.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <plat/omap_device.h>
+#include <plat/dvfs.h>
+#include <plat/input_boost.h>
+
+static unsigned int boost_ms = 80;
+module_param(boost_ms, uint, 0644);
+MODULE_PARM_DESC(boost_ms, "how long to boost after the last touch event");
+
+/* KiB/s, the OMAP4 L3 is raised to 200MHz for 800000 */
+static unsigned int core_tput = 800000;
+module_param(core_tput, uint, 0644);
+MODULE_PARM_DESC(core_tput, "memory throughput requested while boosted");
+
+static unsigned long gpu_rate = 307200000;
+module_param(gpu_rate, ulong, 0644);
+MODULE_PARM_DESC(gpu_rate, "minimum GPU rate while boosted, 0 to disable");
+
+struct input_boost {
+	spinlock_t lock;
+	bool active;
+	unsigned long until;		/* jiffies */
+	ktime_t touch;			/* first touch of a pending frame */
+	bool pending;
+
+	/* orders a release against the next boost */
+	struct mutex work_lock;
+	struct work_struct on_work;
+	struct delayed_work off_work;
+	struct pm_qos_request qos;
+	struct device *gpu;
+
+	/* protected by lock */
+	u32 boosts;
+	u32 frames;
+	u32 lat_us;
+	u32 lat_avg_us;
+	u32 lat_max_us;
+};
+
+static struct input_boost *boost;
+
+static void input_boost_on(struct work_struct *work)
+{
+	struct input_boost *b = container_of(work, struct input_boost,
+					     on_work);
+
+	mutex_lock(&b->work_lock);
+	cpufreq_interactive_boostpulse(boost_ms * USEC_PER_MSEC);
+	pm_qos_update_request(&b->qos, core_tput);
+	if (b->gpu && gpu_rate)
+		omap_device_scale_floor(b->gpu, gpu_rate);
+
+	schedule_delayed_work(&b->off_work, msecs_to_jiffies(boost_ms));
+	mutex_unlock(&b->work_lock);
+}
+
+static void input_boost_off(struct work_struct *work)
+{
+	struct input_boost *b = container_of(work, struct input_boost,
+					     off_work.work);
+	unsigned long flags;
+	long left;
+
+	mutex_lock(&b->work_lock);
+	spin_lock_irqsave(&b->lock, flags);
+	left = (long)(b->until - jiffies);
+	if (left > 0) {
+		spin_unlock_irqrestore(&b->lock, flags);
+		/* still touching, renew the cpufreq pulse and check back */
+		cpufreq_interactive_boostpulse(boost_ms * USEC_PER_MSEC);
+		schedule_delayed_work(&b->off_work, left);
+		goto unlock;
+	}
+	b->active = false;
+	spin_unlock_irqrestore(&b->lock, flags);
+
+	pm_qos_update_request(&b->qos, PM_QOS_DEFAULT_VALUE);
+	if (b->gpu)
+		omap_device_scale_floor(b->gpu, 0);
+unlock:
+	mutex_unlock(&b->work_lock);
+}
+
+static void input_boost_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	struct input_boost *b = handle->handler->private;
+	unsigned long flags;
+
+	if (type != EV_ABS && type != EV_KEY)
+		return;
+
+	spin_lock_irqsave(&b->lock, flags);
+	if (!b->pending) {
+		/* from the touch interrupt, if the driver timestamps frames */
+		b->touch = handle->dev->timestamp.tv64 ?
+			handle->dev->timestamp : ktime_get();
+		b->pending = true;
+	}
+	b->until = jiffies + msecs_to_jiffies(boost_ms);
+	if (!b->active) {
+		b->active = true;
+		b->boosts++;
+		schedule_work(&b->on_work);
+	}
+	spin_unlock_irqrestore(&b->lock, flags);
+}
+
+/**
+ * omap_input_boost_frame() - report that a frame reached the display
+ *
+ * Closes the touch to display latency measurement of the first frame
+ * following a touch. Can be called from any context.
+ */
+void omap_input_boost_frame(void)
+{
+	struct input_boost *b = boost;
+	unsigned long flags;
+	u32 us;
+
+	if (!b)
+		return;
+
+	spin_lock_irqsave(&b->lock, flags);
+	if (!b->pending)
+		goto unlock;
+
+	b->pending = false;
+	us = (u32)ktime_to_us(ktime_sub(ktime_get(), b->touch));
+	b->lat_us = us;
+	b->lat_max_us = max(b->lat_max_us, us);
+	b->lat_avg_us = b->frames ? (b->lat_avg_us * 7 + us) / 8 : us;
+	b->frames++;
+unlock:
+	spin_unlock_irqrestore(&b->lock, flags);
+}
+EXPORT_SYMBOL(omap_input_boost_frame);
+
+static int input_boost_connect(struct input_handler *handler,
+			       struct input_dev *dev,
+			       const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int ret;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "input_boost";
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err_register;
+
+	ret = input_open_device(handle);
+	if (ret)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return ret;
+}
+
+static void input_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id input_boost_ids[] = {
+	/* multi-touch touchscreens */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	/* single touch touchscreens and touchpads */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+	},
+	{ },
+};
+
+static struct input_handler input_boost_handler = {
+	.event		= input_boost_event,
+	.connect	= input_boost_connect,
+	.disconnect	= input_boost_disconnect,
+	.name		= "input_boost",
+	.id_table	= input_boost_ids,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int input_boost_stats_show(struct seq_file *s, void *unused)
+{
+	struct input_boost *b = s->private;
+	unsigned long flags;
+	u32 boosts, frames, lat_us, lat_avg_us, lat_max_us;
+
+	spin_lock_irqsave(&b->lock, flags);
+	boosts = b->boosts;
+	frames = b->frames;
+	lat_us = b->lat_us;
+	lat_avg_us = b->lat_avg_us;
+	lat_max_us = b->lat_max_us;
+	spin_unlock_irqrestore(&b->lock, flags);
+
+	seq_printf(s, "boosts:          %u\n", boosts);
+	seq_printf(s, "frames:          %u\n", frames);
+	seq_printf(s, "latency (us):    %u\n", lat_us);
+	seq_printf(s, "latency avg/max: %u/%u\n", lat_avg_us, lat_max_us);
+	return 0;
+}
+
+static int input_boost_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, input_boost_stats_show, inode->i_private);
+}
+
+static const struct file_operations input_boost_stats_fops = {
+	.open = input_boost_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init input_boost_debugfs_init(struct input_boost *b)
+{
+	debugfs_create_file("input_boost", 0444, NULL, b,
+			    &input_boost_stats_fops);
+}
+#else
+static inline void input_boost_debugfs_init(struct input_boost *b) { }
+#endif
+
+static int __init omap_input_boost_init(void)
+{
+	struct input_boost *b;
+	int ret;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (!b)
+		return -ENOMEM;
+
+	spin_lock_init(&b->lock);
+	mutex_init(&b->work_lock);
+	INIT_WORK(&b->on_work, input_boost_on);
+	INIT_DELAYED_WORK(&b->off_work, input_boost_off);
+	pm_qos_add_request(&b->qos, PM_QOS_MEMORY_THROUGHPUT,
+			   PM_QOS_MEMORY_THROUGHPUT_DEFAULT_VALUE);
+
+	b->gpu = omap_device_get_by_hwmod_name("gpu");
+	if (IS_ERR(b->gpu)) {
+		pr_warn("no gpu device, not boosting the GPU\n");
+		b->gpu = NULL;
+	}
+
+	input_boost_handler.private = b;
+	ret = input_register_handler(&input_boost_handler);
+	if (ret) {
+		pr_err("unable to register input handler (%d)\n", ret);
+		pm_qos_remove_request(&b->qos);
+		kfree(b);
+		return ret;
+	}
+
+	boost = b;
+	input_boost_debugfs_init(b);
+
+	return 0;
+}
+late_initcall(omap_input_boost_init);
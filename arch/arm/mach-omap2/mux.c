@@ -34,6 +34,7 @@
 #include <linux/uaccess.h>
 #include <linux/irq.h>
 #include <linux/interrupt.h>
+#include <linux/suspend.h>
 
 
 #include <plat/omap_hwmod.h>
@@ -449,6 +450,7 @@ static bool omap_hwmod_mux_scan_wakeups(struct omap_hwmod_mux_info *hmux,
 
 		handled_irqs |= 1 << irq;
 
+		log_wakeup_reason(mpu_irqs[irq].irq);
 		generic_handle_irq(mpu_irqs[irq].irq);
 	}
 
@@ -43,6 +43,7 @@
 #include <linux/linkage.h>
 #include <linux/smp.h>
 #include <linux/clk.h>
+#include <linux/sched.h>
 
 #include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
@@ -92,6 +93,26 @@ extern void omap4_cpu_resume(void);
 extern int omap5_finish_suspend(unsigned long cpu_state);
 extern void omap5_cpu_resume(void);
 
+#ifdef CONFIG_PM_DEBUG
+/*
+ * Accumulate the time spent since *stamp in a device off stage.  Only
+ * CPU0 gets here with the other CPU off, so no locking.  sched_clock()
+ * runs off the 32k counter and keeps working with timekeeping suspended.
+ */
+static inline void device_off_stage_done(int stage, u64 *stamp)
+{
+	u64 now = sched_clock();
+
+	omap4_device_off_stage_stat[stage].ns += now - *stamp;
+	omap4_device_off_stage_stat[stage].count++;
+	*stamp = now;
+}
+#else
+static inline void device_off_stage_done(int stage, u64 *stamp)
+{
+}
+#endif
+
 static DEFINE_PER_CPU(struct omap4_cpu_pm_info, omap4_pm_info);
 static struct powerdomain *mpuss_pd, *core_pd;
 static void __iomem *sar_base;
@@ -449,6 +470,7 @@ int omap_enter_lowpower(unsigned int cpu, unsigned int power_state)
 	unsigned int save_state = 0;
 	unsigned int wakeup_cpu;
 	int ret;
+	u64 stamp = 0;
 	s16 dev_inst = cpu_is_omap44xx() ? OMAP4430_PRM_DEVICE_INST :
 			   OMAP54XX_PRM_DEVICE_INST;
 
@@ -521,11 +543,15 @@ int omap_enter_lowpower(unsigned int cpu, unsigned int power_state)
 	mpuss_clear_prev_logic_pwrst();
 	if (pwrdm_read_device_off_state()) {
 		/* Save the device context to SAR RAM */
+		stamp = sched_clock();
 		ret = omap_sar_save();
 		if (ret)
 			goto sar_save_failed;
+		device_off_stage_done(DEVICE_OFF_SAR_SAVE, &stamp);
 		omap4_cm_prepare_off();
+		device_off_stage_done(DEVICE_OFF_CM_SAVE, &stamp);
 		omap4_dpll_prepare_off();
+		device_off_stage_done(DEVICE_OFF_DPLL_SAVE, &stamp);
 		save_ivahd_tesla_regs();
 		save_l3instr_regs();
 		save_state = 3;
@@ -573,8 +599,11 @@ abort_suspend:
 	    pwrdm_read_prev_pwrst(core_pd) == PWRDM_POWER_OFF) {
 		/* Reconfigure the trim settings as well */
 		omap_trim_configure();
+		stamp = sched_clock();
 		omap4_dpll_resume_off();
+		device_off_stage_done(DEVICE_OFF_DPLL_RESTORE, &stamp);
 		omap4_cm_resume_off();
+		device_off_stage_done(DEVICE_OFF_CM_RESTORE, &stamp);
 #ifdef CONFIG_PM_DEBUG
 		omap4_device_off_counter++;
 #endif
@@ -25,6 +25,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/cpu_pm.h>
+#include <linux/suspend.h>
 
 #include <asm/hardware/gic.h>
 
@@ -531,6 +532,37 @@ quit_search:
 	return ret;
 }
 
+/**
+ * omap_wakeupgen_log_wakeup_reasons() - report what woke the MPU up
+ *
+ * To be called right after the wakeup from suspend, before interrupts
+ * are enabled: every GIC SPI pending then is a wakeup reason.  The PRCM
+ * interrupt is left to the PRCM handler, which knows which of its events
+ * (or I/O pads) fired.
+ */
+void omap_wakeupgen_log_wakeup_reasons(void)
+{
+	int i, irq;
+	u32 gica;
+
+	for (i = 0; i < spi_irq_banks - 1; i++) {
+		gica = gic_readl(GIC_DIST_PENDING_SET, i + 1);
+
+		/* see omap_wakeupgen_check_interrupts() */
+		if (i == 0 && cpu_is_omap44xx() &&
+		    (omap_type() == OMAP2_DEVICE_TYPE_GP))
+			gica &= ~(1 << 8);
+
+		while (gica) {
+			/* Since we skip GIC PPI and SGI, base 32 */
+			irq = 32 + i * 32 + __ffs(gica);
+			gica &= gica - 1;
+			if (irq != OMAP44XX_IRQ_PRCM)
+				log_wakeup_reason(irq);
+		}
+	}
+}
+
 /*
  * Continue initialise the wakeupgen initialization after sar
  * is initialized
@@ -10,6 +10,7 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/dma-contiguous.h>
 #include <linux/ion.h>
 #include <linux/memblock.h>
 #include <linux/omap_ion.h>
@@ -69,6 +70,49 @@ void __init omap4_register_ion(void)
 	platform_device_register(&omap4_ion_device);
 }
 
+#ifdef CONFIG_ION_OMAP_TILER_CMA
+static struct device omap4_ion_tiler_dev;
+static struct device omap4_ion_nonsecure_tiler_dev;
+
+/*
+ * The TILER heaps only ever need their memory as pages to pin into the
+ * container, so rather than taking it away from the kernel for good it is
+ * declared as CMA areas and migrated out when a buffer is allocated.  The
+ * areas are placed by memblock, so the board bases are not used.
+ */
+static int __init omap4_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	struct device *dev;
+	int ret;
+
+	if (heap->type != OMAP_ION_HEAP_TYPE_TILER)
+		return -EINVAL;
+
+	if (heap->id == OMAP_ION_HEAP_TILER)
+		dev = &omap4_ion_tiler_dev;
+	else if (heap->id == OMAP_ION_HEAP_NONSECURE_TILER)
+		dev = &omap4_ion_nonsecure_tiler_dev;
+	else
+		return -EINVAL;
+
+	ret = dma_declare_contiguous(dev, heap->size, 0, 0);
+	if (ret) {
+		pr_err("CMA reservation of %x for %s failed: %d\n",
+		       heap->size, heap->name, ret);
+		return ret;
+	}
+
+	heap->base = 0;
+	heap->priv = dev;
+	return 0;
+}
+#else
+static inline int omap4_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	return -EINVAL;
+}
+#endif
+
 void __init omap4_ion_init(void)
 {
 	int i;
@@ -77,6 +121,8 @@ void __init omap4_ion_init(void)
 	for (i = 0; i < omap4_ion_data.nr; i++)
 		if (omap4_ion_data.heaps[i].type == ION_HEAP_TYPE_CARVEOUT ||
 		    omap4_ion_data.heaps[i].type == OMAP_ION_HEAP_TYPE_TILER) {
+			if (!omap4_ion_reserve_cma(&omap4_ion_data.heaps[i]))
+				continue;
 			ret = memblock_remove(omap4_ion_data.heaps[i].base,
 					      omap4_ion_data.heaps[i].size);
 			if (ret)
@@ -10,6 +10,7 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/dma-contiguous.h>
 #include <linux/ion.h>
 #include <linux/memblock.h>
 #include <linux/omap_ion.h>
@@ -72,6 +73,44 @@ void __init omap5_register_ion(void)
 	platform_device_register(&omap5_ion_device);
 }
 
+#ifdef CONFIG_ION_OMAP_TILER_CMA
+static struct device omap5_ion_tiler_dev;
+static struct device omap5_ion_nonsecure_tiler_dev;
+
+/* TILER heaps backed by CMA areas, as on OMAP4 */
+static int __init omap5_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	struct device *dev;
+	int ret;
+
+	if (heap->type != OMAP_ION_HEAP_TYPE_TILER)
+		return -EINVAL;
+
+	if (heap->id == OMAP_ION_HEAP_TILER)
+		dev = &omap5_ion_tiler_dev;
+	else if (heap->id == OMAP_ION_HEAP_NONSECURE_TILER)
+		dev = &omap5_ion_nonsecure_tiler_dev;
+	else
+		return -EINVAL;
+
+	ret = dma_declare_contiguous(dev, heap->size, 0, 0);
+	if (ret) {
+		pr_err("CMA reservation of %x for %s failed: %d\n",
+		       heap->size, heap->name, ret);
+		return ret;
+	}
+
+	heap->base = 0;
+	heap->priv = dev;
+	return 0;
+}
+#else
+static inline int omap5_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	return -EINVAL;
+}
+#endif
+
 void __init omap5_ion_init(void)
 {
 	int i;
@@ -80,6 +119,8 @@ void __init omap5_ion_init(void)
 	for (i = 0; i < omap5_ion_data.nr; i++)
 		if (omap5_ion_data.heaps[i].type == ION_HEAP_TYPE_CARVEOUT ||
 		    omap5_ion_data.heaps[i].type == OMAP_ION_HEAP_TYPE_TILER) {
+			if (!omap5_ion_reserve_cma(&omap5_ion_data.heaps[i]))
+				continue;
 			ret = memblock_remove(omap5_ion_data.heaps[i].base,
 					      omap5_ion_data.heaps[i].size);
 			if (ret)
@@ -87,5 +128,4 @@ void __init omap5_ion_init(void)
 				       omap5_ion_data.heaps[i].size,
 				       omap5_ion_data.heaps[i].base);
 		}
-
 }
@@ -49,7 +49,7 @@ struct omap_device_pm_latency omap_gcxxx_latency[] = {
 
 static int gcxxx_scale_dev(struct device *dev, unsigned long val)
 {
-	return omap_device_scale(dev, val);
+	return omap_device_scale_async(dev, val);
 }
 
 static int gcxxx_set_l3_bw(struct device *dev, unsigned long val)
@@ -133,6 +133,8 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
@@ -140,6 +142,7 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/dcache.h>
 
 #include "common.h"
 #include <plat/cpu.h>
@@ -167,6 +170,20 @@
 /* omap_hwmod_list contains all registered struct omap_hwmods */
 static LIST_HEAD(omap_hwmod_list);
 
+/*
+ * Registered hwmods are also hashed by name and by class name, so that
+ * the lookups done for every device at boot and from omap_device do not
+ * walk all of omap_hwmod_list.  Buckets keep the registration order.
+ */
+#define HWMOD_HASH_BITS			7
+#define HWMOD_HASH_SIZE			(1 << HWMOD_HASH_BITS)
+static struct list_head omap_hwmod_name_hash[HWMOD_HASH_SIZE];
+static struct list_head omap_hwmod_class_hash[HWMOD_HASH_SIZE];
+static bool omap_hwmod_hash_inited;
+
+/* Number of slowest hwmods named in the boot-time setup report */
+#define HWMOD_SETUP_REPORT_CNT		5
+
 struct hwmod_ops {
 	void	(*hwmod_update_context_lost)(struct omap_hwmod *oh);
 	int	(*hwmod_get_context_lost)(struct omap_hwmod *oh);
@@ -1193,6 +1210,33 @@ static void _shutdown_sysc(struct omap_hwmod *oh)
 	_write_sysconfig(v, oh);
 }
 
+/**
+ * _hash - return the lookup hash bucket index for a hwmod or class name
+ * @name: name to hash
+ */
+static u32 _hash(const char *name)
+{
+	return hash_32(full_name_hash((const unsigned char *)name,
+				      strlen(name)), HWMOD_HASH_BITS);
+}
+
+/**
+ * _init_hash - initialize the name and class lookup hash tables
+ *
+ * Called before the first hwmod is registered.  No return value.
+ */
+static void _init_hash(void)
+{
+	int i;
+
+	for (i = 0; i < HWMOD_HASH_SIZE; i++) {
+		INIT_LIST_HEAD(&omap_hwmod_name_hash[i]);
+		INIT_LIST_HEAD(&omap_hwmod_class_hash[i]);
+	}
+
+	omap_hwmod_hash_inited = true;
+}
+
 /**
  * _lookup - find an omap_hwmod by name
  * @name: find an omap_hwmod by name
@@ -1205,7 +1249,11 @@ static struct omap_hwmod *_lookup(const char *name)
 
 	oh = NULL;
 
-	list_for_each_entry(temp_oh, &omap_hwmod_list, node) {
+	if (!omap_hwmod_hash_inited)
+		return NULL;
+
+	list_for_each_entry(temp_oh, &omap_hwmod_name_hash[_hash(name)],
+			    _name_node) {
 		if (!strcmp(name, temp_oh->name)) {
 			oh = temp_oh;
 			break;
@@ -1986,10 +2034,13 @@ static int _setup(struct omap_hwmod *oh, void *data)
 {
 	int i, r;
 	u8 postsetup_state;
+	ktime_t start, reset_start;
 
 	if (oh->_state != _HWMOD_STATE_CLKS_INITED)
 		return 0;
 
+	start = ktime_get();
+
 	/* Set iclk autoidle mode */
 	if (oh->slaves_cnt > 0) {
 		for (i = 0; i < oh->slaves_cnt; i++) {
@@ -2018,7 +2069,7 @@ static int _setup(struct omap_hwmod *oh, void *data)
 	 * expected.
 	 */
 	if ((oh->flags & HWMOD_INIT_NO_RESET) && oh->rst_lines_cnt == 1)
-		return 0;
+		goto out;
 
 	r = _enable(oh);
 	if (r) {
@@ -2026,11 +2077,14 @@ static int _setup(struct omap_hwmod *oh, void *data)
 		pr_warning("omap_hwmod: %s: cannot be enabled (%d)\n",
 			   oh->name, oh->_state);
 #endif
-		return 0;
+		goto out;
 	}
 
-	if (!(oh->flags & HWMOD_INIT_NO_RESET))
+	if (!(oh->flags & HWMOD_INIT_NO_RESET)) {
+		reset_start = ktime_get();
 		_reset(oh);
+		oh->_reset_us = ktime_us_delta(ktime_get(), reset_start);
+	}
 
 	postsetup_state = oh->_postsetup_state;
 	if (postsetup_state == _HWMOD_STATE_UNKNOWN)
@@ -2060,6 +2114,9 @@ static int _setup(struct omap_hwmod *oh, void *data)
 		WARN(1, "hwmod: %s: unknown postsetup state %d! defaulting to enabled\n",
 		     oh->name, postsetup_state);
 
+out:
+	oh->_setup_us = ktime_us_delta(ktime_get(), start);
+
 	return 0;
 }
 
@@ -2090,6 +2147,9 @@ static int __init _register(struct omap_hwmod *oh)
 
 	pr_debug("omap_hwmod: %s: registering\n", oh->name);
 
+	if (!omap_hwmod_hash_inited)
+		_init_hash();
+
 	if (_lookup(oh->name))
 		return -EEXIST;
 
@@ -2100,6 +2160,9 @@ static int __init _register(struct omap_hwmod *oh)
 		oh->_int_flags |= _HWMOD_NO_MPU_PORT;
 
 	list_add_tail(&oh->node, &omap_hwmod_list);
+	list_add_tail(&oh->_name_node, &omap_hwmod_name_hash[_hash(oh->name)]);
+	list_add_tail(&oh->_class_node,
+		      &omap_hwmod_class_hash[_hash(oh->class->name)]);
 
 	spin_lock_init(&oh->_lock);
 
@@ -2419,6 +2482,32 @@ static const struct file_operations omap_hwmod_dbg_fops = {
 	.release	= single_release,
 };
 
+static int omap_hwmod_dbg_setup_time_show(struct seq_file *s, void *unused)
+{
+	struct omap_hwmod *oh;
+
+	seq_printf(s, "%-20s %10s %10s\n", "name", "setup(us)", "reset(us)");
+	list_for_each_entry(oh, &omap_hwmod_list, node)
+		seq_printf(s, "%-20s %10u %10u\n", oh->name, oh->_setup_us,
+			   oh->_reset_us);
+
+	return 0;
+}
+
+static int omap_hwmod_dbg_setup_time_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, omap_hwmod_dbg_setup_time_show,
+			   inode->i_private);
+}
+
+static const struct file_operations omap_hwmod_dbg_setup_time_fops = {
+	.open		= omap_hwmod_dbg_setup_time_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void __init omap_hwmod_dbg_init(void)
 {
 	omap_hwmod_dbg_dir = debugfs_create_dir("omap_hwmod", NULL);
@@ -2427,11 +2516,54 @@ static void __init omap_hwmod_dbg_init(void)
 
 	(void)debugfs_create_file("state", S_IRUGO, omap_hwmod_dbg_dir,
 					NULL, &omap_hwmod_dbg_fops);
+	(void)debugfs_create_file("setup_time", S_IRUGO, omap_hwmod_dbg_dir,
+					NULL, &omap_hwmod_dbg_setup_time_fops);
 }
 
 #endif	/* CONFIG_DEBUG_FS */
 
 
+/**
+ * _report_setup_time - log how long hwmod setup and reset took at boot
+ *
+ * Logs the total time spent in _setup() and in the resets it does, and
+ * names the slowest hwmods.  No return value.
+ */
+static void __init _report_setup_time(void)
+{
+	struct omap_hwmod *slowest[HWMOD_SETUP_REPORT_CNT] = { NULL };
+	struct omap_hwmod *oh;
+	u32 setup_us = 0, reset_us = 0;
+	int cnt = 0, i, j;
+
+	list_for_each_entry(oh, &omap_hwmod_list, node) {
+		if (!oh->_setup_us)
+			continue;
+
+		cnt++;
+		setup_us += oh->_setup_us;
+		reset_us += oh->_reset_us;
+
+		for (i = 0; i < HWMOD_SETUP_REPORT_CNT; i++) {
+			if (!slowest[i] || oh->_setup_us > slowest[i]->_setup_us)
+				break;
+		}
+		if (i == HWMOD_SETUP_REPORT_CNT)
+			continue;
+		for (j = HWMOD_SETUP_REPORT_CNT - 1; j > i; j--)
+			slowest[j] = slowest[j - 1];
+		slowest[i] = oh;
+	}
+
+	pr_info("omap_hwmod: set up %d hwmods in %u us, %u us of it in reset\n",
+		cnt, setup_us, reset_us);
+
+	for (i = 0; i < HWMOD_SETUP_REPORT_CNT && slowest[i]; i++)
+		pr_info("omap_hwmod: %s: setup %u us, reset %u us\n",
+			slowest[i]->name, slowest[i]->_setup_us,
+			slowest[i]->_reset_us);
+}
+
 /**
  * omap_hwmod_setup - do some post-clock framework initialization
  *
@@ -2460,6 +2592,8 @@ static int __init omap_hwmod_setup_all(void)
 
 	omap_hwmod_for_each(_setup, NULL);
 
+	_report_setup_time();
+
 #ifdef CONFIG_DEBUG_FS
 	omap_hwmod_dbg_init();
 #endif
@@ -2986,7 +3120,11 @@ int omap_hwmod_for_each_by_class(const char *classname,
 	pr_debug("omap_hwmod: %s: looking for modules of class %s\n",
 		 __func__, classname);
 
-	list_for_each_entry(temp_oh, &omap_hwmod_list, node) {
+	if (!omap_hwmod_hash_inited)
+		return 0;
+
+	list_for_each_entry(temp_oh, &omap_hwmod_class_hash[_hash(classname)],
+			    _class_node) {
 		if (!strcmp(temp_oh->class->name, classname)) {
 			pr_debug("omap_hwmod: %s: %s: calling callback fn\n",
 				 __func__, temp_oh->name);
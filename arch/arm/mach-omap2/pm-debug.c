@@ -24,6 +24,7 @@
 #include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 
@@ -40,6 +41,7 @@
 #include "powerdomain-private.h"
 
 u32 omap4_device_off_counter;
+struct device_off_stage_stat omap4_device_off_stage_stat[DEVICE_OFF_STAGES];
 u32 enable_off_mode;
 u32 wakeup_timer_seconds;
 u32 wakeup_timer_milliseconds;
@@ -56,6 +58,7 @@ enum {
 	DEBUG_FILE_COUNTERS = 0,
 	DEBUG_FILE_TIMERS,
 	DEBUG_FILE_USECOUNT,
+	DEBUG_FILE_RESIDENCY,
 };
 
 static const char pwrdm_state_names[][PWRDM_MAX_PWRSTS] = {
@@ -67,6 +70,8 @@ static const char pwrdm_state_names[][PWRDM_MAX_PWRSTS] = {
 
 void pm_dbg_update_time(struct powerdomain *pwrdm, int prev)
 {
+	int idx = _PWRDM_STATE_COUNT_IDX(prev);
+	int bin;
 	s64 t;
 
 	if (!pm_dbg_init_done)
@@ -75,11 +80,49 @@ void pm_dbg_update_time(struct powerdomain *pwrdm, int prev)
 	/* Update timer for previous state */
 	t = sched_clock();
 
-	pwrdm->state_timer[_PWRDM_STATE_COUNT_IDX(prev)] += t - pwrdm->timer;
+	pwrdm->state_timer[idx] += t - pwrdm->timer;
+
+	bin = fls64(div_u64(t - pwrdm->timer, NSEC_PER_USEC) >> 6);
+	if (bin >= PWRDM_RESIDENCY_BINS)
+		bin = PWRDM_RESIDENCY_BINS - 1;
+	pwrdm->state_hist[idx][bin]++;
 
 	pwrdm->timer = t;
 }
 
+/*
+ * The clockdomain statistics are updated without a lock from the clock
+ * and hwmod enable paths, so they are a close estimate, not exact.
+ */
+void pm_dbg_clkdm_usecount(struct clockdomain *clkdm, bool active)
+{
+	s64 t;
+
+	if (!pm_dbg_init_done)
+		return;
+
+	t = sched_clock();
+	if (active)
+		clkdm->idle_time += t - clkdm->timer;
+	else
+		clkdm->active_time += t - clkdm->timer;
+	clkdm->timer = t;
+}
+
+void pm_dbg_clkdm_wakeup(struct clockdomain *clkdm, s64 start)
+{
+	s64 lat;
+
+	if (!pm_dbg_init_done)
+		return;
+
+	lat = sched_clock() - start;
+	clkdm->wakeups++;
+	clkdm->wakeup_lat += lat;
+	if (lat > clkdm->wakeup_lat_max)
+		clkdm->wakeup_lat_max = lat;
+}
+
 static int pwrdm_dbg_show_counter(struct powerdomain *pwrdm, void *user)
 {
 	struct seq_file *s = (struct seq_file *)user;
@@ -135,6 +178,60 @@ static int pwrdm_dbg_show_timer(struct powerdomain *pwrdm, void *user)
 	return 0;
 }
 
+static int pwrdm_dbg_show_residency(struct powerdomain *pwrdm, void *user)
+{
+	struct seq_file *s = user;
+	int i, j;
+
+	if (strcmp(pwrdm->name, "emu_pwrdm") == 0 ||
+		strcmp(pwrdm->name, "wkup_pwrdm") == 0 ||
+		strncmp(pwrdm->name, "dpll", 4) == 0)
+		return 0;
+
+	for (i = 0; i < PWRDM_MAX_PWRSTS; i++) {
+		if (!pwrdm->state_counter[i])
+			continue;
+		seq_printf(s, "%s:%s", pwrdm->name, pwrdm_state_names[i]);
+		for (j = 0; j < PWRDM_RESIDENCY_BINS; j++)
+			seq_printf(s, " %u", pwrdm->state_hist[i][j]);
+		seq_printf(s, "\n");
+	}
+
+	return 0;
+}
+
+static int clkdm_dbg_show_residency(struct clockdomain *clkdm, void *user)
+{
+	struct seq_file *s = user;
+	s64 active = clkdm->active_time, idle = clkdm->idle_time;
+
+	/* account the time spent in the current state too */
+	if (atomic_read(&clkdm->usecount))
+		active += sched_clock() - clkdm->timer;
+	else
+		idle += sched_clock() - clkdm->timer;
+
+	seq_printf(s, "%s,active:%lld,idle:%lld,wakeups:%u", clkdm->name,
+		   active, idle, clkdm->wakeups);
+	if (clkdm->wakeups)
+		seq_printf(s, ",wakeup_avg_ns:%llu,wakeup_max_ns:%lld",
+			   div_u64(clkdm->wakeup_lat, clkdm->wakeups),
+			   clkdm->wakeup_lat_max);
+	seq_printf(s, "\n");
+
+	return 0;
+}
+
+static int pm_dbg_show_residency(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "# powerdomain:state, stays of <64us, <128us, ... "
+		   "<1048576us, longer\n");
+	pwrdm_for_each(pwrdm_dbg_show_residency, s);
+	seq_printf(s, "# clockdomain, ns with and without users\n");
+	clkdm_for_each(clkdm_dbg_show_residency, s);
+	return 0;
+}
+
 static struct voltagedomain *parent_voltdm;
 static struct powerdomain *parent_pwrdm;
 static struct clockdomain *parent_clkdm;
@@ -244,8 +341,28 @@ static int pm_dbg_show_counters(struct seq_file *s, void *unused)
 {
 	pwrdm_for_each(pwrdm_dbg_show_counter, s);
 
-	if (cpu_is_omap44xx() || cpu_is_omap54xx())
+	if (cpu_is_omap44xx() || cpu_is_omap54xx()) {
+		static const char * const stage_names[DEVICE_OFF_STAGES] = {
+			[DEVICE_OFF_SAR_SAVE]		= "sar_save",
+			[DEVICE_OFF_CM_SAVE]		= "cm_save",
+			[DEVICE_OFF_DPLL_SAVE]		= "dpll_save",
+			[DEVICE_OFF_DPLL_RESTORE]	= "dpll_restore",
+			[DEVICE_OFF_CM_RESTORE]		= "cm_restore",
+		};
+		int i;
+
 		seq_printf(s, "DEVICE-OFF:%d\n", omap4_device_off_counter);
+		for (i = 0; i < DEVICE_OFF_STAGES; i++) {
+			struct device_off_stage_stat *st =
+				&omap4_device_off_stage_stat[i];
+
+			if (!st->count)
+				continue;
+			seq_printf(s, "DEVICE-OFF:%s:count:%u,avg_ns:%llu\n",
+				   stage_names[i], st->count,
+				   div_u64(st->ns, st->count));
+		}
+	}
 
 	return 0;
 }
@@ -265,6 +382,9 @@ static int pm_dbg_open(struct inode *inode, struct file *file)
 	case DEBUG_FILE_COUNTERS:
 		return single_open(file, pm_dbg_show_counters,
 			&inode->i_private);
+	case DEBUG_FILE_RESIDENCY:
+		return single_open(file, pm_dbg_show_residency,
+			&inode->i_private);
 	case DEBUG_FILE_TIMERS:
 	default:
 		return single_open(file, pm_dbg_show_timers,
@@ -313,6 +433,7 @@ static int __init pwrdms_setup(struct powerdomain *pwrdm, void *dir)
 
 	for (i = 0; i < 4; i++)
 		pwrdm->state_timer[i] = 0;
+	memset(pwrdm->state_hist, 0, sizeof(pwrdm->state_hist));
 
 	pwrdm->timer = t;
 
@@ -327,6 +448,13 @@ static int __init pwrdms_setup(struct powerdomain *pwrdm, void *dir)
 	return 0;
 }
 
+static int __init clkdms_setup(struct clockdomain *clkdm, void *unused)
+{
+	clkdm->timer = sched_clock();
+
+	return 0;
+}
+
 static int option_get(void *data, u64 *val)
 {
 	u32 *option = data;
@@ -373,8 +501,11 @@ static int __init pm_dbg_init(void)
 		d, (void *)DEBUG_FILE_TIMERS, &debug_fops);
 	(void) debugfs_create_file("usecount", S_IRUGO,
 		d, (void *)DEBUG_FILE_USECOUNT, &debug_fops);
+	(void) debugfs_create_file("residency", S_IRUGO,
+		d, (void *)DEBUG_FILE_RESIDENCY, &debug_fops);
 
 	pwrdm_for_each(pwrdms_setup, (void *)d);
+	clkdm_for_each(clkdms_setup, NULL);
 
 	(void) debugfs_create_file("enable_off_mode", S_IRUGO | S_IWUSR, d,
 				   &enable_off_mode, &pm_dbg_option_fops);
@@ -113,8 +113,25 @@ extern int omap3_pm_set_suspend_state(struct powerdomain *pwrdm, int state);
 
 struct clk;
 
+/* Stages of OMAP4/5 device off entry and exit timed for pm-debug */
+enum {
+	DEVICE_OFF_SAR_SAVE,
+	DEVICE_OFF_CM_SAVE,
+	DEVICE_OFF_DPLL_SAVE,
+	DEVICE_OFF_DPLL_RESTORE,
+	DEVICE_OFF_CM_RESTORE,
+	DEVICE_OFF_STAGES,
+};
+
+struct device_off_stage_stat {
+	u64 ns;
+	u32 count;
+};
+
 #ifdef CONFIG_PM_DEBUG
 extern u32 enable_off_mode;
+extern struct device_off_stage_stat
+	omap4_device_off_stage_stat[DEVICE_OFF_STAGES];
 extern void pm_dbg_dump_pwrdm(struct powerdomain *pwrdm);
 extern void pm_dbg_dump_voltdm(struct voltagedomain *voltdm);
 #else
@@ -125,8 +142,14 @@ static inline void pm_dbg_dump_voltdm(struct voltagedomain *voltdm) { }
 
 #if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
 extern void pm_dbg_update_time(struct powerdomain *pwrdm, int prev);
+extern void pm_dbg_clkdm_usecount(struct clockdomain *clkdm, bool active);
+extern void pm_dbg_clkdm_wakeup(struct clockdomain *clkdm, s64 start);
 #else
 #define pm_dbg_update_time(pwrdm, prev) do {} while (0);
+static inline void pm_dbg_clkdm_usecount(struct clockdomain *clkdm,
+					 bool active) { }
+static inline void pm_dbg_clkdm_wakeup(struct clockdomain *clkdm,
+				       s64 start) { }
 #endif /* CONFIG_PM_DEBUG */
 
 /* 24xx */
@@ -222,6 +222,7 @@ static int omap4_5_pm_suspend(void)
 	 * More details can be found in OMAP4430 TRM section 4.3.4.2.
 	 */
 	omap_enter_lowpower(cpu_id, PWRDM_POWER_OFF);
+	omap_wakeupgen_log_wakeup_reasons();
 
 	/* Restore next powerdomain state */
 	list_for_each_entry(pwrst, &pwrst_list, node) {
@@ -247,6 +248,8 @@ static int omap4_5_pm_suspend(void)
 				power_state_names[prev_state],
 				power_state_names[curr_state],
 				power_state_names[pwrst->saved_state]);
+			/* list the modules that kept it from idling */
+			pm_dbg_dump_pwrdm(pwrst->pwrdm);
 			ret = -1;
 		}
 		/*
@@ -195,6 +195,7 @@ static inline void _pwrdm_state_counter_update(struct powerdomain *pwrdm,
 {
 
 	pwrdm->state_counter[_PWRDM_STATE_COUNT_IDX(state)]++;
+	trace_power_domain_state(pwrdm->name, state, smp_processor_id());
 	if ((state == PWRDM_POWER_OSWR) ||
 	    (state == PWRDM_POWER_OFF))
 		_update_logic_membank_counters(pwrdm);
@@ -243,6 +244,12 @@ static int _pwrdm_state_switch(struct powerdomain *pwrdm, int flag)
 			/* transition to a higher power state occurred*/
 			_pwrdm_state_counter_update(pwrdm, current_state);
 
+			if (_pwrdm_state_compare_int(prev_state, next_state,
+						     PWRDM_COMPARE_PWRST_GT))
+				trace_power_domain_missed(pwrdm->name,
+							  next_state,
+							  prev_state);
+
 			if (pwrdm->high2low_transition_enable) {
 				/*
 				 * This flag will be set only if the
@@ -36,6 +36,13 @@
 
 #define PWRDM_MAX_PWRSTS	4
 
+/*
+ * Residency histogram bins: bin 0 counts stays shorter than 64us, bin n
+ * counts stays of [64us << (n - 1), 64us << n), the last bin everything
+ * longer.
+ */
+#define PWRDM_RESIDENCY_BINS	16
+
 /* Maximum number of power domain states - including OSWR */
 #define PWRDM_MAX_POWER_PWRSTS	6
 
@@ -147,6 +154,7 @@ struct powerdomain {
 #ifdef CONFIG_PM_DEBUG
 	s64 timer;
 	s64 state_timer[PWRDM_MAX_PWRSTS];
+	u32 state_hist[PWRDM_MAX_PWRSTS][PWRDM_RESIDENCY_BINS];
 #endif
 	const s32 wakeup_lat[PWRDM_MAX_POWER_PWRSTS];
 	struct plist_head wkup_lat_plist_head;
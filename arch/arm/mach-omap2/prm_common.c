@@ -23,6 +23,7 @@
 #include <linux/irq.h>
 #include <linux/interrupt.h>
 #include <linux/slab.h>
+#include <linux/suspend.h>
 
 #include <plat/common.h>
 #include <plat/prcm.h>
@@ -121,12 +122,16 @@ static void omap_prcm_irq_handler(unsigned int irq, struct irq_desc *desc)
 		 */
 
 		/* Serve priority events first */
-		for_each_set_bit(virtirq, priority_pending, nr_irqs)
+		for_each_set_bit(virtirq, priority_pending, nr_irqs) {
+			log_wakeup_reason(prcm_irq_setup->base_irq + virtirq);
 			generic_handle_irq(prcm_irq_setup->base_irq + virtirq);
+		}
 
 		/* Serve normal events next */
-		for_each_set_bit(virtirq, pending, nr_irqs)
+		for_each_set_bit(virtirq, pending, nr_irqs) {
+			log_wakeup_reason(prcm_irq_setup->base_irq + virtirq);
 			generic_handle_irq(prcm_irq_setup->base_irq + virtirq);
+		}
 	}
 	if (chip->irq_ack)
 		chip->irq_ack(&desc->irq_data);
@@ -14,9 +14,13 @@
 #include <linux/pm_qos.h>
 #include <linux/sched.h>
 #include <linux/suspend.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kobject.h>
 #include <linux/power/smartreflex.h>
 #include <plat/cpu.h>
 #include <plat/dvfs.h>
+#include <mach/id.h>
 #include "voltage.h"
 
 /**
@@ -99,6 +103,14 @@
  * on a periodic basis. For distros that may choose not to do the recommended
  * periodic recalibration, instead choose to perform boot time calibration,
  * kconfig configuration option is provided to do so.
+ *
+ * With recalibration enabled, the calibrated voltages can also be saved
+ * across reboots: /sys/power/sr_calib_cache lists them, and writing the
+ * saved list back early in boot applies them to the OPPs which are not
+ * calibrated yet, so these don't need a calibration on their first use.
+ * Entries of another chip or older than the recalibration delay are
+ * ignored, and the next recalibration is brought forward to replace the
+ * cached voltages with measured ones.
  */
 
  /* TODO: should be possible to make these computed values based on config. */
@@ -112,6 +124,28 @@
  */
 #define SRP5_MAX_CHECK_VPTRANS_US	20
 
+/**
+ * struct sr_classp5_opp - per OPP calibration history
+ * @calib_time:	get_seconds() when the voltage was measured, 0 if never
+ * @cached:	volt_calibrated was restored from the calibration cache
+ * @prev_uv:	previous calibrated voltage, measured or cached
+ * @calibrations: number of completed calibrations
+ * @triggers:	calibration loop triggers summed over all calibrations
+ * @oscillations: calibrations which gave up on oscillations
+ * @last_msecs:	duration of the last calibration
+ * @last_delta_uv: last calibrated voltage minus the previous one
+ */
+struct sr_classp5_opp {
+	unsigned long calib_time;
+	bool cached;
+	u32 prev_uv;
+	u32 calibrations;
+	u32 triggers;
+	u32 oscillations;
+	u32 last_msecs;
+	int last_delta_uv;
+};
+
 /**
  * struct sr_classp5_calib_data - data meant to be used by calibration work
  * @work:	calibration work
@@ -124,6 +158,11 @@
  *			consumed by the work item.
  * @work_active:	have we scheduled a work item?
  * @qos:		pm qos handle
+ * @calib_start:	jiffies when the current calibration was scheduled
+ * @opps:		calibration history, indexed like voltdm->volt_data
+ * @nr_opps:		number of entries in @opps
+ * @stats:		debugfs file with the calibration history
+ * @node:		entry in classp5_list
  */
 struct sr_classp5_calib_data {
 	struct delayed_work work;
@@ -134,8 +173,49 @@ struct sr_classp5_calib_data {
 	unsigned long u_volt_samples[SRP5_STABLE_SAMPLES];
 	bool work_active;
 	struct pm_qos_request qos;
+	unsigned long calib_start;
+	struct sr_classp5_opp *opps;
+	int nr_opps;
+	struct dentry *stats;
+	struct list_head node;
 };
 
+/* all initialized domains, protected by omap_dvfs_lock */
+static LIST_HEAD(classp5_list);
+
+static struct sr_classp5_opp *sr_classp5_opp(
+		struct sr_classp5_calib_data *work_data,
+		struct omap_volt_data *vdata)
+{
+	int idx = vdata - work_data->sr->voltdm->volt_data;
+
+	if (idx < 0 || idx >= work_data->nr_opps)
+		return NULL;
+
+	return &work_data->opps[idx];
+}
+
+/* called with omap_dvfs_lock held once a calibration for @vdata is over */
+static void sr_classp5_calib_done(struct sr_classp5_calib_data *work_data,
+				  struct omap_volt_data *vdata)
+{
+	struct sr_classp5_opp *opp = sr_classp5_opp(work_data, vdata);
+
+	if (!opp)
+		return;
+
+	opp->calibrations++;
+	opp->triggers += work_data->num_calib_triggers;
+	if (work_data->num_calib_triggers == SRP5_MAX_TRIGGERS)
+		opp->oscillations++;
+	opp->last_msecs = jiffies_to_msecs(jiffies - work_data->calib_start);
+	opp->last_delta_uv = opp->prev_uv ?
+		(int)vdata->volt_calibrated - (int)opp->prev_uv : 0;
+	opp->prev_uv = vdata->volt_calibrated;
+	opp->calib_time = get_seconds();
+	opp->cached = false;
+}
+
 /**
  * sr_classp5_notify() - isr notifier for status events
  * @sr:		SmartReflex for which we were triggered
@@ -437,6 +517,7 @@ done_calib:
 		volt_data->volt_calibrated, volt_data->volt_dynamic_nominal,
 		volt_data->volt_margin, u_volt_margin);
 
+	sr_classp5_calib_done(work_data, volt_data);
 	work_data->work_active = false;
 
 	/* Calibration done, Remove qos req */
@@ -607,6 +688,150 @@ static void __init sr_classp5_recal_register_sleep_pm_notifier(void)
 	register_pm_notifier(&sr_classp5_recal_sleep_pm_notifier);
 }
 
+/*
+ * Cached voltages are only trusted until the next recalibration would
+ * have been due, and are then replaced as soon as possible.
+ */
+#define SRP5_CACHE_VERIFY_DELAY_MS	(10 * 60 * 1000)
+
+static char sr_classp5_die_id[33];
+
+static ssize_t sr_calib_cache_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	struct sr_classp5_calib_data *work_data;
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&omap_dvfs_lock);
+	list_for_each_entry(work_data, &classp5_list, node) {
+		struct voltagedomain *voltdm = work_data->sr->voltdm;
+
+		for (i = 0; i < work_data->nr_opps; i++) {
+			struct omap_volt_data *vdata = &voltdm->volt_data[i];
+			struct sr_classp5_opp *opp = &work_data->opps[i];
+
+			if (!vdata->volt_calibrated || !opp->calib_time)
+				continue;
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 "%s %s %u %u %lu\n",
+					 sr_classp5_die_id, voltdm->name,
+					 vdata->volt_nominal,
+					 vdata->volt_calibrated,
+					 opp->calib_time);
+		}
+	}
+	mutex_unlock(&omap_dvfs_lock);
+
+	return len;
+}
+
+/* apply one line of the cache, called with omap_dvfs_lock held */
+static int sr_classp5_cache_apply(const char *line)
+{
+	struct sr_classp5_calib_data *work_data;
+	unsigned long calib_time, now = get_seconds();
+	unsigned long max_age =
+		CONFIG_OMAP_SR_CLASS1_P5_RECALIBRATION_DELAY / MSEC_PER_SEC;
+	char die_id[33], name[16];
+	u32 nominal, calibrated;
+	int i;
+
+	if (sscanf(line, "%32s %15s %u %u %lu", die_id, name, &nominal,
+		   &calibrated, &calib_time) != 5)
+		return -EINVAL;
+
+	/* calibrated on another chip, or aged since */
+	if (strcmp(die_id, sr_classp5_die_id) || calib_time > now ||
+	    now - calib_time > max_age)
+		return 0;
+
+	list_for_each_entry(work_data, &classp5_list, node) {
+		struct voltagedomain *voltdm = work_data->sr->voltdm;
+
+		if (strcmp(voltdm->name, name))
+			continue;
+
+		for (i = 0; i < work_data->nr_opps; i++) {
+			struct omap_volt_data *vdata = &voltdm->volt_data[i];
+			struct sr_classp5_opp *opp = &work_data->opps[i];
+
+			if (vdata->volt_nominal != nominal)
+				continue;
+			/* a measurement, done or on its way, wins */
+			if (!calibrated || calibrated > nominal ||
+			    vdata->volt_calibrated ||
+			    (work_data->work_active &&
+			     work_data->vdata == vdata))
+				return 0;
+
+			vdata->volt_calibrated = calibrated;
+			vdata->volt_dynamic_nominal =
+				omap_get_dyn_nominal(vdata);
+			opp->calib_time = calib_time;
+			opp->prev_uv = calibrated;
+			opp->cached = true;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t sr_calib_cache_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t n)
+{
+	const char *line = buf, *end = buf + n;
+	unsigned long delay;
+	int applied = 0, r = 0;
+
+	mutex_lock(&omap_dvfs_lock);
+	while (line < end) {
+		r = sr_classp5_cache_apply(line);
+		if (r < 0)
+			break;
+		applied += r;
+		line = strnchr(line, end - line, '\n');
+		if (!line)
+			break;
+		line++;
+	}
+	mutex_unlock(&omap_dvfs_lock);
+
+	if (!applied)
+		return r < 0 ? r : n;
+
+	pr_info("%s: %d calibrated voltages restored\n", __func__, applied);
+
+	/* get the cached voltages measured again, off the boot path */
+	delay = msecs_to_jiffies(SRP5_CACHE_VERIFY_DELAY_MS);
+	if (recal_scheduled &&
+	    time_after(next_recal_time, jiffies + delay)) {
+		cancel_delayed_work_sync(&recal_work);
+		next_recal_time = jiffies + delay;
+		schedule_delayed_work(&recal_work, delay);
+	}
+
+	return r < 0 ? r : n;
+}
+
+static struct kobj_attribute sr_calib_cache_attr =
+	__ATTR(sr_calib_cache, 0644, sr_calib_cache_show,
+	       sr_calib_cache_store);
+
+static void __init sr_classp5_cache_init(void)
+{
+	struct omap_die_id odi;
+
+	omap_get_die_id(&odi);
+	snprintf(sr_classp5_die_id, sizeof(sr_classp5_die_id),
+		 "%08x%08x%08x%08x", odi.id_3, odi.id_2, odi.id_1, odi.id_0);
+
+	if (sysfs_create_file(power_kobj, &sr_calib_cache_attr.attr))
+		pr_warning("%s: unable to create sr_calib_cache\n", __func__);
+}
+
 static void sr_classp5_recal_init(void)
 {
 	unsigned long delay;
@@ -617,6 +842,7 @@ static void sr_classp5_recal_init(void)
 	schedule_delayed_work(&recal_work, delay);
 	next_recal_time = jiffies + delay;
 	sr_classp5_recal_register_sleep_pm_notifier();
+	sr_classp5_cache_init();
 	recal_scheduled = true;
 	pr_info("SmartReflex Recalibration delay = %dms\n",
 		CONFIG_OMAP_SR_CLASS1_P5_RECALIBRATION_DELAY);
@@ -654,6 +880,7 @@ static int sr_classp5_calibration_schedule(struct omap_sr *sr)
 	work_data->vdata = volt_data;
 	work_data->work_active = true;
 	work_data->num_calib_triggers = 0;
+	work_data->calib_start = jiffies;
 	/* Dont interrupt me until calibration is complete */
 	pm_qos_update_request(&work_data->qos, 0);
 	/* program the workqueue and leave it to calibrate offline.. */
@@ -837,6 +1064,41 @@ static int sr_classp5_configure(struct omap_sr *sr)
 	return sr_configure_errgen(sr);
 }
 
+static int sr_classp5_stats_show(struct seq_file *s, void *unused)
+{
+	struct sr_classp5_calib_data *work_data = s->private;
+	struct omap_volt_data *vdata = work_data->sr->voltdm->volt_data;
+	int i;
+
+	mutex_lock(&omap_dvfs_lock);
+	for (i = 0; i < work_data->nr_opps; i++) {
+		struct sr_classp5_opp *opp = &work_data->opps[i];
+
+		seq_printf(s, "%u: calib=%u%s calibrations=%u triggers=%u "
+			   "oscillations=%u last_ms=%u last_delta_uv=%d\n",
+			   vdata[i].volt_nominal, vdata[i].volt_calibrated,
+			   opp->cached && vdata[i].volt_calibrated ?
+			   " (cached)" : "", opp->calibrations,
+			   opp->triggers, opp->oscillations, opp->last_msecs,
+			   opp->last_delta_uv);
+	}
+	mutex_unlock(&omap_dvfs_lock);
+
+	return 0;
+}
+
+static int sr_classp5_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sr_classp5_stats_show, inode->i_private);
+}
+
+static const struct file_operations sr_classp5_stats_fops = {
+	.open		= sr_classp5_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /**
  * sr_classp5_init() - class p5 init
  * @sr:			SR to init
@@ -872,6 +1134,21 @@ static int sr_classp5_init(struct omap_sr *sr, void *class_priv_data)
 
 	work_data->sr = sr;
 
+	while (sr->voltdm->volt_data[work_data->nr_opps].volt_nominal)
+		work_data->nr_opps++;
+	work_data->opps = kcalloc(work_data->nr_opps,
+				  sizeof(struct sr_classp5_opp), GFP_KERNEL);
+	if (!work_data->opps) {
+		kfree(work_data);
+		return -ENOMEM;
+	}
+	list_add_tail(&work_data->node, &classp5_list);
+	if (sr->voltdm->debug_dir)
+		work_data->stats = debugfs_create_file("calib_stats", S_IRUGO,
+						sr->voltdm->debug_dir,
+						work_data,
+						&sr_classp5_stats_fops);
+
 	INIT_DELAYED_WORK_DEFERRABLE(&work_data->work, sr_classp5_calib_work);
 	*voltdm_cdata = (void *)work_data;
 	pm_qos_add_request(&work_data->qos, PM_QOS_CPU_DMA_LATENCY,
@@ -926,6 +1203,9 @@ static int sr_classp5_deinit(struct omap_sr *sr, void *class_priv_data)
 	voltdm_reset(voltdm);
 	pm_qos_remove_request(&work_data->qos);
 
+	debugfs_remove(work_data->stats);
+	list_del(&work_data->node);
+	kfree(work_data->opps);
 	kfree(work_data);
 	*voltdm_cdata = NULL;
 
@@ -110,7 +110,7 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 		      u8 *target_vsel, u8 *current_vsel)
 {
 	struct omap_vc_channel *vc;
-	u32 vc_cmdval;
+	u32 vc_cmdval, smps_steps;
 
 	if (IS_ERR_OR_NULL(voltdm)) {
 		pr_err("%s bad voldm\n", __func__);
@@ -171,10 +171,27 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 	*current_vsel = voltdm->read(voltdm->vp->voltage);
 
 	/* Setting the ON voltage to the new target voltage */
-	vc_cmdval = voltdm->read(vc->cmdval_reg);
-	vc_cmdval &= ~vc->common->cmd_on_mask;
+	vc_cmdval = vc->cmdval & ~vc->common->cmd_on_mask;
 	vc_cmdval |= (*target_vsel << vc->common->cmd_on_shift);
 	voltdm->write(vc_cmdval, vc->cmdval_reg);
+	vc->cmdval = vc_cmdval;
+
+	/*
+	 * Work out everything omap_vc_post_scale() needs now, so that the
+	 * tail of a transition is a single register write once it settled.
+	 * SMPS slew rate / step size. 2us added as buffer.
+	 */
+	smps_steps = abs(*target_vsel - *current_vsel);
+	voltdm->xfer.settle_us = DIV_ROUND_UP(smps_steps *
+					      voltdm->pmic->step_size,
+					      voltdm->pmic->slew_rate) + 2;
+	voltdm->xfer.cmdval = (*target_vsel << vc->common->cmd_on_shift) |
+			      (*target_vsel << vc->common->cmd_onlp_shift) |
+			      vc->setup_voltage_common;
+	voltdm->xfer.target_v = target_v;
+	voltdm->xfer.target_volt = target_volt;
+	voltdm->xfer.target_vsel = *target_vsel;
+	voltdm->xfer.current_vsel = *current_vsel;
 
 	voltdm->vc_param->on = target_volt;
 
@@ -183,15 +200,15 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 	return 0;
 }
 
+/*
+ * Called once the transition settled: the SMPS slew time was already
+ * waited for by voltdm_xfer_wait() and the command value was computed by
+ * omap_vc_pre_scale().
+ */
 void omap_vc_post_scale(struct voltagedomain *voltdm,
-			unsigned long target_volt,
-			struct omap_volt_data *target_vdata,
-			u8 target_vsel, u8 current_vsel)
+			struct omap_volt_data *target_vdata)
 {
 	struct omap_vc_channel *vc;
-	u32 smps_steps = 0, smps_delay = 0;
-	u8 on_vsel, onlp_vsel;
-	u32 val;
 
 	if (IS_ERR_OR_NULL(voltdm)) {
 		pr_err("%s bad voldm\n", __func__);
@@ -210,39 +227,25 @@ void omap_vc_post_scale(struct voltagedomain *voltdm,
 		return;
 	}
 
-	/* Check if sufficient pmic info is available for this vdd */
-	if (!voltdm->pmic) {
-		pr_err("%s: Insufficient pmic info to scale the vdd_%s\n",
-		       __func__, voltdm->name);
-		return;
-	}
-
 	if (!voltdm->write) {
 		pr_err("%s: No write API for accessing vdd_%s regs\n",
 		       __func__, voltdm->name);
 		return;
 	}
 
-	smps_steps = abs(target_vsel - current_vsel);
-	/* SMPS slew rate / step size. 2us added as buffer. */
-	smps_delay = DIV_ROUND_UP(smps_steps * voltdm->pmic->step_size,
-				  voltdm->pmic->slew_rate) + 2;
-	udelay(smps_delay);
-
 	voltdm->curr_volt = target_vdata;
 
 	/* Set up the on voltage for wakeup from lp and OFF */
-	onlp_vsel = target_vsel;
-	on_vsel = target_vsel;
-	val = (on_vsel << vc->common->cmd_on_shift) |
-	       (onlp_vsel << vc->common->cmd_onlp_shift) |
-	       vc->setup_voltage_common;
-	voltdm->write(val, vc->cmdval_reg);
+	voltdm->write(voltdm->xfer.cmdval, vc->cmdval_reg);
+	vc->cmdval = voltdm->xfer.cmdval;
 }
 
-/* vc_bypass_scale - VC bypass method of voltage scaling */
-int omap_vc_bypass_scale(struct voltagedomain *voltdm,
-				struct omap_volt_data *target_v)
+/*
+ * vc_bypass_scale_start - VC bypass method of voltage scaling, send the
+ * command to the PMIC and return without waiting for the SMPS to slew
+ */
+int omap_vc_bypass_scale_start(struct voltagedomain *voltdm,
+			       struct omap_volt_data *target_v)
 {
 	struct omap_vc_channel *vc;
 	u32 loop_cnt = 0, retries_cnt = 0;
@@ -306,11 +309,37 @@ int omap_vc_bypass_scale(struct voltagedomain *voltdm,
 		vc_bypass_value = voltdm->read(vc_bypass_val_reg);
 	}
 
-	omap_vc_post_scale(voltdm, target_volt, target_v, target_vsel,
-			   current_vsel);
+	/* the PMIC acked the command, only its slew time is left */
+	voltdm_xfer_issued(voltdm, true);
+	return 0;
+}
+
+/* vc_bypass_scale_finish - wait for a bypass command to settle */
+int omap_vc_bypass_scale_finish(struct voltagedomain *voltdm)
+{
+	int ret;
+
+	ret = voltdm_xfer_wait(voltdm);
+	if (ret)
+		return ret;
+
+	omap_vc_post_scale(voltdm, voltdm->xfer.target_v);
 	return 0;
 }
 
+/* vc_bypass_scale - VC bypass method of voltage scaling */
+int omap_vc_bypass_scale(struct voltagedomain *voltdm,
+			 struct omap_volt_data *target_v)
+{
+	int ret;
+
+	ret = omap_vc_bypass_scale_start(voltdm, target_v);
+	if (ret)
+		return ret;
+
+	return omap_vc_bypass_scale_finish(voltdm);
+}
+
 static int omap_vc_bypass_send_value(struct voltagedomain *voltdm,
 		struct omap_vc_channel *vc, u8 sa, u8 reg, u32 data)
 {
@@ -866,6 +895,7 @@ void __init omap_vc_init_channel(struct voltagedomain *voltdm)
 	       (onlp_vsel << vc->common->cmd_onlp_shift) |
 	       vc->setup_voltage_common;
 	voltdm->write(val, vc->cmdval_reg);
+	vc->cmdval = val;
 	vc->cfg_channel |= vc_cfg_bits->cmd;
 
 	/* Channel configuration */
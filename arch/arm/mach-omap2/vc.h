@@ -71,6 +71,7 @@ struct omap_vc_common {
  * @setup_time: setup time (in sys_clk cycles) of regulator for this channel
  * @cfg_channel: current value of VC channel configuration register
  * @setup_voltage_common: voltage command reg value for RET and OFF mode
+ * @cmdval: last value written to @cmdval_reg, saves reading it back
  * @i2c_high_speed: whether or not to use I2C high-speed mode
  *
  * @common: pointer to VC common data for this platform
@@ -93,6 +94,7 @@ struct omap_vc_channel {
 	u16 cmd_reg_addr;
 	u8 cfg_channel;
 	u32 setup_voltage_common;
+	u32 cmdval;
 	bool i2c_high_speed;
 
 	/* register access data */
@@ -148,11 +150,12 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 		      struct omap_volt_data *target_vdata,
 		      u8 *target_vsel, u8 *current_vsel);
 void omap_vc_post_scale(struct voltagedomain *voltdm,
-			unsigned long target_volt,
-			struct omap_volt_data *target_vdata,
-			u8 target_vsel, u8 current_vsel);
+			struct omap_volt_data *target_vdata);
 int omap_vc_bypass_scale(struct voltagedomain *voltdm,
 			struct omap_volt_data *target_v);
+int omap_vc_bypass_scale_start(struct voltagedomain *voltdm,
+			       struct omap_volt_data *target_v);
+int omap_vc_bypass_scale_finish(struct voltagedomain *voltdm);
 int omap_vc_bypass_send_i2c_msg(struct voltagedomain *voltdm,
 		u8 slave_addr, u8 reg_addr, u8 data);
 #endif
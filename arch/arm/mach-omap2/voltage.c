@@ -44,8 +44,14 @@
 #include "vp.h"
 #include "abb.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/dvfs.h>
+
 static LIST_HEAD(voltdm_list);
 
+/* protects the issued/done state of all in-flight transitions */
+static DEFINE_SPINLOCK(voltdm_xfer_lock);
+
 /* Public functions */
 /**
  * omap_voltage_get_curr_vdata() - Gets the current non-auto-compensated voltage
@@ -77,16 +83,116 @@ int voltdm_unregister_notifier(struct voltagedomain *voltdm,
 }
 
 
+/*
+ * Note the completion of every VP transfer in flight. Whoever is busy
+ * waiting does this for all domains, so a domain whose TRANXDONE came in
+ * while another one was being waited on counts its settle time from
+ * there rather than from when it is finished.
+ */
+static void _voltdm_xfer_poll(void)
+{
+	struct voltagedomain *voltdm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&voltdm_xfer_lock, flags);
+	list_for_each_entry(voltdm, &voltdm_list, node) {
+		struct omap_voltdm_xfer *xfer = &voltdm->xfer;
+
+		if (!xfer->issued || xfer->done)
+			continue;
+
+		/* stamp after the read: the stamp must not predate the event */
+		if (omap_vp_is_transdone(voltdm)) {
+			xfer->t_done = ktime_get();
+			xfer->done = true;
+		}
+	}
+	spin_unlock_irqrestore(&voltdm_xfer_lock, flags);
+}
+
+static bool _voltdm_xfer_done(struct voltagedomain *voltdm)
+{
+	unsigned long flags;
+	bool done;
+
+	spin_lock_irqsave(&voltdm_xfer_lock, flags);
+	done = voltdm->xfer.done;
+	spin_unlock_irqrestore(&voltdm_xfer_lock, flags);
+
+	return done;
+}
+
 /**
- * voltdm_scale() - API to scale voltage of a particular voltage domain.
+ * voltdm_xfer_issued() - note that a voltage command was handed to the HW
+ * @voltdm:	voltage domain the command is for
+ * @done:	the command already reached the PMIC (VC bypass), otherwise
+ *		it is complete once the VP reports TRANXDONE
+ */
+void voltdm_xfer_issued(struct voltagedomain *voltdm, bool done)
+{
+	struct omap_voltdm_xfer *xfer = &voltdm->xfer;
+	unsigned long flags;
+
+	spin_lock_irqsave(&voltdm_xfer_lock, flags);
+	xfer->t_issue = ktime_get();
+	xfer->t_done = xfer->t_issue;
+	xfer->done = done;
+	xfer->issued = true;
+	spin_unlock_irqrestore(&voltdm_xfer_lock, flags);
+}
+
+/**
+ * voltdm_xfer_wait() - wait for an issued voltage command to settle
+ * @voltdm:	voltage domain to wait for
+ *
+ * Waits for the command to reach the PMIC and then for the SMPS slew time
+ * computed by omap_vc_pre_scale(), counted from when the command was first
+ * seen to be complete. Returns -ETIMEDOUT if the command never completed,
+ * in which case the full slew time is still waited for.
+ */
+int voltdm_xfer_wait(struct voltagedomain *voltdm)
+{
+	struct omap_voltdm_xfer *xfer = &voltdm->xfer;
+	unsigned long flags;
+	ktime_t deadline;
+	int timeout = 0, ret = 0;
+
+	while (!_voltdm_xfer_done(voltdm)) {
+		if (timeout++ >= VP_TRANXDONE_TIMEOUT) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		udelay(1);
+		_voltdm_xfer_poll();
+	}
+
+	spin_lock_irqsave(&voltdm_xfer_lock, flags);
+	deadline = ktime_add_us(xfer->done ? xfer->t_done : ktime_get(),
+				xfer->settle_us);
+	xfer->issued = false;
+	spin_unlock_irqrestore(&voltdm_xfer_lock, flags);
+
+	while (ktime_us_delta(deadline, ktime_get()) > 0) {
+		udelay(1);
+		_voltdm_xfer_poll();
+	}
+
+	return ret;
+}
+
+/**
+ * voltdm_scale_start() - start scaling a voltage domain
  * @voltdm: pointer to the voltage domain which is to be scaled.
- * @target_volt: The target voltage of the voltage domain
+ * @target_v: The target voltage of the voltage domain
  *
- * This API should be called by the kernel to do the voltage scaling
- * for a particular voltage domain during DVFS.
+ * Issues the voltage change and returns without waiting for the PMIC to
+ * slew, so that the caller can start other domains or do other work in
+ * the meantime. Every successful call must be paired with
+ * voltdm_scale_finish() before the domain is scaled again; on failure the
+ * transition is already over.
  */
-int voltdm_scale(struct voltagedomain *voltdm,
-			struct omap_volt_data *target_v)
+int voltdm_scale_start(struct voltagedomain *voltdm,
+		       struct omap_volt_data *target_v)
 {
 	int ret;
 	struct omap_voltage_notifier notify;
@@ -103,19 +209,99 @@ int voltdm_scale(struct voltagedomain *voltdm,
 		return -ENODATA;
 	}
 
+	if (voltdm->xfer.pending) {
+		pr_err("%s: vdd_%s is already being scaled\n",
+			__func__, voltdm->name);
+		return -EBUSY;
+	}
+
 	notify.voltdm = voltdm;
 	notify.target_volt = target_volt;
 	srcu_notifier_call_chain(&voltdm->change_notify_list,
 				 OMAP_VOLTAGE_PRECHANGE, (void *)&notify);
 
-	ret = voltdm->scale(voltdm, target_v);
+	voltdm->xfer.old_volt =
+		omap_get_operation_voltage(voltdm->curr_volt);
+
+	/* without a split scale method the change is over on return */
+	if (voltdm->scale_start && voltdm->scale_finish)
+		ret = voltdm->scale_start(voltdm, target_v);
+	else
+		ret = voltdm->scale(voltdm, target_v);
+
+	if (ret) {
+		notify.op_result = ret;
+		srcu_notifier_call_chain(&voltdm->change_notify_list,
+					 OMAP_VOLTAGE_POSTCHANGE,
+					 (void *)&notify);
+		return ret;
+	}
+
+	voltdm->xfer.pending = true;
+	return 0;
+}
+
+/**
+ * voltdm_scale_finish() - wait for a voltage domain to reach its new voltage
+ * @voltdm: pointer to the voltage domain being scaled.
+ *
+ * Completes the change started by voltdm_scale_start().
+ */
+int voltdm_scale_finish(struct voltagedomain *voltdm)
+{
+	int ret = 0;
+	struct omap_voltage_notifier notify;
+	struct omap_voltdm_xfer *xfer;
+
+	if (!voltdm || IS_ERR(voltdm)) {
+		pr_warning("%s: VDD specified does not exist!\n", __func__);
+		return -EINVAL;
+	}
+
+	xfer = &voltdm->xfer;
+	if (!xfer->pending) {
+		pr_err("%s: vdd_%s is not being scaled\n",
+			__func__, voltdm->name);
+		return -EINVAL;
+	}
 
+	if (voltdm->scale_start && voltdm->scale_finish) {
+		ret = voltdm->scale_finish(voltdm);
+		trace_dvfs_voltage_settle(voltdm->name, xfer->old_volt,
+				xfer->target_volt,
+				ktime_us_delta(xfer->t_done, xfer->t_issue),
+				ktime_us_delta(ktime_get(), xfer->t_issue));
+	}
+
+	notify.voltdm = voltdm;
+	notify.target_volt = xfer->target_volt;
 	notify.op_result = ret;
+	xfer->pending = false;
 	srcu_notifier_call_chain(&voltdm->change_notify_list,
 				 OMAP_VOLTAGE_POSTCHANGE, (void *)&notify);
 	return ret;
 }
 
+/**
+ * voltdm_scale() - API to scale voltage of a particular voltage domain.
+ * @voltdm: pointer to the voltage domain which is to be scaled.
+ * @target_volt: The target voltage of the voltage domain
+ *
+ * This API should be called by the kernel to do the voltage scaling
+ * for a particular voltage domain during DVFS.
+ */
+int voltdm_scale(struct voltagedomain *voltdm,
+			struct omap_volt_data *target_v)
+{
+	int ret;
+
+	ret = voltdm_scale_start(voltdm, target_v);
+	if (ret)
+		return ret;
+
+	return voltdm_scale_finish(voltdm);
+}
+
 /**
  * voltdm_reset() - Resets the voltage of a particular voltage domain
  *		    to that of the current OPP.
@@ -254,9 +440,13 @@ void omap_change_voltscale_method(struct voltagedomain *voltdm,
 	switch (voltscale_method) {
 	case VOLTSCALE_VPFORCEUPDATE:
 		voltdm->scale = omap_vp_forceupdate_scale;
+		voltdm->scale_start = omap_vp_forceupdate_start;
+		voltdm->scale_finish = omap_vp_forceupdate_finish;
 		return;
 	case VOLTSCALE_VCBYPASS:
 		voltdm->scale = omap_vc_bypass_scale;
+		voltdm->scale_start = omap_vc_bypass_scale_start;
+		voltdm->scale_finish = omap_vc_bypass_scale_finish;
 		return;
 	default:
 		pr_warning("%s: Trying to change the method of voltage scaling"
@@ -419,6 +609,8 @@ int __init omap_voltage_late_init(void)
 
 		if (voltdm->vc) {
 			voltdm->scale = omap_vc_bypass_scale;
+			voltdm->scale_start = omap_vc_bypass_scale_start;
+			voltdm->scale_finish = omap_vc_bypass_scale_finish;
 			omap_vc_init_channel(voltdm);
 		}
 
@@ -427,6 +619,8 @@ int __init omap_voltage_late_init(void)
 
 		if (voltdm->vp) {
 			voltdm->scale = omap_vp_forceupdate_scale;
+			voltdm->scale_start = omap_vp_forceupdate_start;
+			voltdm->scale_finish = omap_vp_forceupdate_finish;
 			omap_vp_init(voltdm);
 		}
 
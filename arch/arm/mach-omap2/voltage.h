@@ -17,6 +17,7 @@
 #include <linux/notifier.h>
 #include <linux/err.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 #include <mach/common.h>
 #include <plat/voltage.h>
@@ -53,6 +54,42 @@ struct omap_vfsm_instance {
 	u8 voltsetup_off_reg;
 };
 
+/**
+ * struct omap_voltdm_xfer - state of an in-flight voltage transition
+ * @pending: between voltdm_scale_start() and voltdm_scale_finish()
+ * @target_v: voltage the domain is headed to
+ * @target_volt: operational voltage of @target_v at the time of the request
+ * @old_volt: operational voltage the transition started from
+ * @cmdval: VC command value (on/onlp/ret/off) to program once settled
+ * @vpconfig: VP config to restore once the force update is over
+ * @target_vsel: vsel sent to the PMIC
+ * @current_vsel: vsel the PMIC was at before the transition
+ * @settle_us: time the SMPS needs to slew once it received the command
+ * @issued: set once the command is handed to the VP/VC
+ * @done: set once the command was seen to have reached the PMIC
+ * @t_issue: when the command was handed to the VP/VC
+ * @t_done: when @done was first observed
+ *
+ * Filled in by voltdm_scale_start() and consumed by voltdm_scale_finish().
+ * @done and @t_done may be set by whoever polls the VP first, so they
+ * are only touched under the voltage layer's transition lock.
+ */
+struct omap_voltdm_xfer {
+	bool pending;
+	struct omap_volt_data *target_v;
+	unsigned long target_volt;
+	unsigned long old_volt;
+	u32 cmdval;
+	u32 vpconfig;
+	u8 target_vsel;
+	u8 current_vsel;
+	u32 settle_us;
+	bool issued;
+	bool done;
+	ktime_t t_issue;
+	ktime_t t_done;
+};
+
 /* Dynamic nominal voltage margin common for OMAP3630 and OMAP4 */
 #define OMAP3PLUS_DYNAMIC_NOMINAL_MARGIN_UV	50000
 
@@ -72,11 +109,14 @@ struct omap_vfsm_instance {
  * @sleep: function to call once the domain enters idle
  * @wakeup: function to call once the domain wakes up from idle
  * @scale: function used to scale the voltage of the voltagedomain
+ * @scale_start: issue a voltage change without waiting for it to settle
+ * @scale_finish: wait for the change issued by @scale_start to settle
  * @nominal_volt: current nominal voltage for this voltage domain
  * @volt_data: voltage table having the distinct voltages supported
  *             by the domain and other associated per voltage data.
  * @change_notify_list: notifiers that need to be told on pre and post change
  * @auto_ret: does voltage domain can use auto_ret feature
+ * @xfer: in-flight transition between @scale_start and @scale_finish
  */
 struct voltagedomain {
 	char *name;
@@ -107,6 +147,9 @@ struct voltagedomain {
 	int (*wakeup) (struct voltagedomain *voltdm);
 	int (*scale) (struct voltagedomain *voltdm,
 				struct omap_volt_data *target_volt);
+	int (*scale_start) (struct voltagedomain *voltdm,
+				struct omap_volt_data *target_volt);
+	int (*scale_finish) (struct voltagedomain *voltdm);
 	struct omap_volt_data *curr_volt;
 	struct omap_volt_data *volt_data;
 	struct omap_vdd_dep_info *dep_vdd_info;
@@ -115,6 +158,7 @@ struct voltagedomain {
 	/* spinlock for voltage usecount */
 	spinlock_t lock;
 	bool auto_ret;
+	struct omap_voltdm_xfer xfer;
 };
 
 /* Min and max voltages from OMAP perspective */
@@ -221,12 +265,16 @@ struct omap_vdd_dep_volt {
  * @dep_table		: Table containing the dependent vdd voltage
  *			  corresponding to every main vdd voltage.
  * @nr_dep_entries	: number of dependency voltage entries
+ * @_main_volt		: internal, last main vdd voltage looked up
+ * @_dep_volt		: internal, dependent voltage found for @_main_volt
  */
 struct omap_vdd_dep_info {
 	char *name;
 	struct voltagedomain *_dep_voltdm;
 	struct omap_vdd_dep_volt *dep_table;
 	int nr_dep_entries;
+	unsigned long _main_volt;
+	unsigned long _dep_volt;
 };
 
 void omap_voltage_get_volttable(struct voltagedomain *voltdm,
@@ -256,6 +304,8 @@ int voltdm_for_each_pwrdm(struct voltagedomain *voltdm,
 			  int (*fn)(struct voltagedomain *voltdm,
 				    struct powerdomain *pwrdm));
 void voltdm_reset(struct voltagedomain *voltdm);
+void voltdm_xfer_issued(struct voltagedomain *voltdm, bool done);
+int voltdm_xfer_wait(struct voltagedomain *voltdm);
 
 int __init __init_volt_domain_notifier_list(struct voltagedomain **voltdms);
 
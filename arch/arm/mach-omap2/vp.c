@@ -286,8 +286,11 @@ do {									\
 } while (0)
 
 
-/* VP force update method of voltage scaling */
-int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
+/*
+ * VP force update method of voltage scaling, first half: hand the new
+ * voltage to the VP and return while the VC sends it to the PMIC.
+ */
+int omap_vp_forceupdate_start(struct voltagedomain *voltdm,
 			      struct omap_volt_data *target_v)
 {
 	struct omap_vp_instance *vp;
@@ -355,35 +358,48 @@ int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 	}
 
 	vpconfig = _vp_set_init_voltage(voltdm, target_volt);
+	voltdm->xfer.vpconfig = vpconfig;
 
 	/* Force update of voltage */
 	voltdm->write(vpconfig | vp->common->vpconfig_forceupdate,
 		      voltdm->vp->vpconfig);
 
+	/* TRANXDONE is now ours to wait for */
+	voltdm_xfer_issued(voltdm, false);
+
+	return 0;
+}
+
+/*
+ * VP force update method of voltage scaling, second half: wait for the
+ * transfer started by omap_vp_forceupdate_start() and for the SMPS to slew.
+ */
+int omap_vp_forceupdate_finish(struct voltagedomain *voltdm)
+{
+	struct omap_vp_instance *vp = voltdm->vp;
+	struct omap_voltdm_xfer *xfer = &voltdm->xfer;
+	int timeout = 0;
+
 	/*
-	 * Wait for TransactionDone. Typical latency is <200us.
-	 * Depends on SMPSWAITTIMEMIN/MAX and voltage change
+	 * Wait for TransactionDone and the SMPS slew time after it. Typical
+	 * latency is <200us, depends on SMPSWAITTIMEMIN/MAX and voltage
+	 * change. Transitions of other domains are tracked while we wait.
 	 */
-	timeout = 0;
-	omap_test_timeout(vp->common->ops->check_txdone(vp->id),
-			  VP_TRANXDONE_TIMEOUT, timeout);
-	if (timeout >= VP_TRANXDONE_TIMEOUT)
+	if (voltdm_xfer_wait(voltdm))
 		_vp_controlled_err(vp, voltdm,
 			"%s: vdd_%s TRANXDONE timeout exceeded. "
 			"TRANXDONE never got set after the voltage update. "
 			"target volt=%ld, target vsel=0x%02x, "
 			"current_vsel=0x%02x\n",
-			__func__, voltdm->name, target_volt,
-			target_vsel, current_vsel);
+			__func__, voltdm->name, xfer->target_volt,
+			xfer->target_vsel, xfer->current_vsel);
 
-	omap_vc_post_scale(voltdm, target_volt, target_v,
-			   target_vsel, current_vsel);
+	omap_vc_post_scale(voltdm, xfer->target_v);
 
 	/*
 	 * Disable TransactionDone interrupt , clear all status, clear
 	 * control registers
 	 */
-	timeout = 0;
 	while (timeout++ < VP_TRANXDONE_TIMEOUT) {
 		vp->common->ops->clear_txdone(vp->id);
 		if (!vp->common->ops->check_txdone(vp->id))
@@ -396,15 +412,28 @@ int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 			"%s: vdd_%s TRANXDONE timeout exceeded while"
 			"trying to clear the TRANXDONE status. target volt=%ld,"
 			"target vsel=0x%02x, current_vsel=0x%02x\n",
-			__func__, voltdm->name, target_volt,
-			target_vsel, current_vsel);
+			__func__, voltdm->name, xfer->target_volt,
+			xfer->target_vsel, xfer->current_vsel);
 
 	/* Clear force bit */
-	voltdm->write(vpconfig, vp->vpconfig);
+	voltdm->write(xfer->vpconfig, vp->vpconfig);
 
 	return 0;
 }
 
+/* VP force update method of voltage scaling */
+int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
+			      struct omap_volt_data *target_v)
+{
+	int ret;
+
+	ret = omap_vp_forceupdate_start(voltdm, target_v);
+	if (ret)
+		return ret;
+
+	return omap_vp_forceupdate_finish(voltdm);
+}
+
 /**
  * omap_vp_enable() - API to enable a particular VP
  * @voltdm:	pointer to the VDD whose VP is to be enabled.
@@ -157,6 +157,9 @@ void omap_vp_enable(struct voltagedomain *voltdm);
 void omap_vp_disable(struct voltagedomain *voltdm);
 int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 			      struct omap_volt_data *target_v);
+int omap_vp_forceupdate_start(struct voltagedomain *voltdm,
+			      struct omap_volt_data *target_v);
+int omap_vp_forceupdate_finish(struct voltagedomain *voltdm);
 int omap_vp_update_errorgain(struct voltagedomain *voltdm,
 			     struct omap_volt_data *volt_data);
 unsigned long omap_vp_get_curr_volt(struct voltagedomain *voltdm);
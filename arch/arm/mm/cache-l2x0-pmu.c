@@ -0,0 +1,350 @@
+/*
+ * L2C-310 (PL310) event counters as a perf PMU.
+ *
+ * The controller has two 32-bit event counters which saturate rather than
+ * wrap and have no usable overflow interrupt on all integrations, so they
+ * are only offered for counting (no sampling) and are folded into the perf
+ * counts by a periodic hrtimer before they can saturate.
+ *
+ * The counters are shared by all CPUs: events are system-wide and must be
+ * opened on CPU 0, e.g. "perf stat -a -C 0 -e l2c_310/event=0x2/".
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) "l2c_310 pmu: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/io.h>
+#include <linux/hrtimer.h>
+#include <linux/perf_event.h>
+
+#include <asm/hardware/cache-l2x0.h>
+
+#define PMU_NR_COUNTERS		2
+#define L2X0_PMU_CPU		0
+#define L2X0_PMU_EVENT_MAX	0xf
+#define L2X0_PMU_POLL_MS	1000
+
+static void __iomem *l2x0_pmu_base;
+static struct perf_event *events[PMU_NR_COUNTERS];
+static struct hrtimer l2x0_pmu_hrtimer;
+static ktime_t l2x0_pmu_poll_period;
+
+/*
+ * Counter 0 and 1 registers sit in reverse order, 4 bytes apart:
+ * CNT0_CFG at 0x208 and CNT1_CFG at 0x204, likewise for the values.
+ */
+static void l2x0_pmu_counter_config_write(int idx, u32 val)
+{
+	writel_relaxed(val, l2x0_pmu_base + L2X0_EVENT_CNT0_CFG - 4 * idx);
+}
+
+static u32 l2x0_pmu_counter_read(int idx)
+{
+	return readl_relaxed(l2x0_pmu_base + L2X0_EVENT_CNT0_VAL - 4 * idx);
+}
+
+static void l2x0_pmu_counter_write(int idx, u32 val)
+{
+	writel_relaxed(val, l2x0_pmu_base + L2X0_EVENT_CNT0_VAL - 4 * idx);
+}
+
+static void __l2x0_pmu_enable(void)
+{
+	u32 val = readl_relaxed(l2x0_pmu_base + L2X0_EVENT_CNT_CTRL);
+
+	val |= L2X0_EVENT_CNT_CTRL_ENABLE;
+	writel_relaxed(val, l2x0_pmu_base + L2X0_EVENT_CNT_CTRL);
+}
+
+static void __l2x0_pmu_disable(void)
+{
+	u32 val = readl_relaxed(l2x0_pmu_base + L2X0_EVENT_CNT_CTRL);
+
+	val &= ~L2X0_EVENT_CNT_CTRL_ENABLE;
+	writel_relaxed(val, l2x0_pmu_base + L2X0_EVENT_CNT_CTRL);
+}
+
+static int l2x0_pmu_num_active(void)
+{
+	int i, cnt = 0;
+
+	for (i = 0; i < PMU_NR_COUNTERS; i++)
+		if (events[i])
+			cnt++;
+
+	return cnt;
+}
+
+static void l2x0_pmu_enable(struct pmu *pmu)
+{
+	if (!l2x0_pmu_num_active())
+		return;
+
+	__l2x0_pmu_enable();
+}
+
+static void l2x0_pmu_disable(struct pmu *pmu)
+{
+	if (!l2x0_pmu_num_active())
+		return;
+
+	__l2x0_pmu_disable();
+}
+
+static void l2x0_pmu_event_read(struct perf_event *event)
+{
+	struct hw_perf_event *hw = &event->hw;
+	u64 prev_count, new_count;
+
+	do {
+		prev_count = local64_read(&hw->prev_count);
+		new_count = l2x0_pmu_counter_read(hw->idx);
+	} while (local64_xchg(&hw->prev_count, new_count) != prev_count);
+
+	local64_add((new_count - prev_count) & 0xffffffffULL, &event->count);
+
+	if (new_count == 0xffffffff)
+		pr_warn_ratelimited("counter %d saturated\n", hw->idx);
+}
+
+/* Counter values can only be written while counting is disabled. */
+static void l2x0_pmu_event_configure(struct perf_event *event)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	local64_set(&hw->prev_count, 0);
+	l2x0_pmu_counter_write(hw->idx, 0);
+}
+
+static enum hrtimer_restart l2x0_pmu_poll(struct hrtimer *hrtimer)
+{
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	__l2x0_pmu_disable();
+
+	for (i = 0; i < PMU_NR_COUNTERS; i++) {
+		struct perf_event *event = events[i];
+
+		if (!event)
+			continue;
+
+		l2x0_pmu_event_read(event);
+		l2x0_pmu_event_configure(event);
+	}
+
+	__l2x0_pmu_enable();
+	local_irq_restore(flags);
+
+	hrtimer_forward_now(hrtimer, l2x0_pmu_poll_period);
+	return HRTIMER_RESTART;
+}
+
+static void l2x0_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	if (WARN_ON_ONCE(!(event->hw.state & PERF_HES_STOPPED)))
+		return;
+
+	if (flags & PERF_EF_RELOAD)
+		WARN_ON_ONCE(!(hw->state & PERF_HES_UPTODATE));
+
+	hw->state = 0;
+
+	l2x0_pmu_event_configure(event);
+	l2x0_pmu_counter_config_write(hw->idx,
+			hw->config_base << L2X0_EVENT_CNT_CFG_SRC_SHIFT);
+}
+
+static void l2x0_pmu_event_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	if (WARN_ON_ONCE(event->hw.state & PERF_HES_STOPPED))
+		return;
+
+	l2x0_pmu_counter_config_write(hw->idx,
+					L2X0_EVENT_CNT_CFG_SRC_DISABLED);
+
+	hw->state |= PERF_HES_STOPPED;
+
+	if (flags & PERF_EF_UPDATE) {
+		l2x0_pmu_event_read(event);
+		hw->state |= PERF_HES_UPTODATE;
+	}
+}
+
+static int l2x0_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hw = &event->hw;
+	int idx;
+
+	for (idx = 0; idx < PMU_NR_COUNTERS; idx++)
+		if (!events[idx])
+			break;
+
+	if (idx == PMU_NR_COUNTERS)
+		return -EAGAIN;
+
+	/* Pin the timer to CPU 0 along with the events it polls. */
+	if (!l2x0_pmu_num_active())
+		hrtimer_start(&l2x0_pmu_hrtimer, l2x0_pmu_poll_period,
+				HRTIMER_MODE_REL_PINNED);
+
+	events[idx] = event;
+	hw->idx = idx;
+
+	hw->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		l2x0_pmu_event_start(event, 0);
+
+	return 0;
+}
+
+static void l2x0_pmu_event_del(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	l2x0_pmu_event_stop(event, PERF_EF_UPDATE);
+
+	events[hw->idx] = NULL;
+	hw->idx = -1;
+
+	if (!l2x0_pmu_num_active())
+		hrtimer_cancel(&l2x0_pmu_hrtimer);
+}
+
+static bool l2x0_pmu_group_is_valid(struct perf_event *event)
+{
+	struct pmu *pmu = event->pmu;
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	int num_hw = 0;
+
+	if (leader->pmu == pmu)
+		num_hw++;
+	else if (!is_software_event(leader))
+		return false;
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (sibling->pmu == pmu)
+			num_hw++;
+		else if (!is_software_event(sibling))
+			return false;
+	}
+
+	/* a new sibling is not on the leader's list yet */
+	if (event != leader)
+		num_hw++;
+
+	return num_hw <= PMU_NR_COUNTERS;
+}
+
+static int l2x0_pmu_event_init(struct perf_event *event)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) ||
+	    (event->attach_state & PERF_ATTACH_TASK))
+		return -EOPNOTSUPP;
+
+	if (event->cpu != L2X0_PMU_CPU)
+		return -EINVAL;
+
+	if (event->attr.exclude_user || event->attr.exclude_kernel ||
+	    event->attr.exclude_hv || event->attr.exclude_idle)
+		return -EINVAL;
+
+	if (!event->attr.config || event->attr.config > L2X0_PMU_EVENT_MAX)
+		return -EINVAL;
+
+	if (!l2x0_pmu_group_is_valid(event))
+		return -EINVAL;
+
+	hw->config_base = event->attr.config;
+
+	return 0;
+}
+
+/*
+ * Event sources, see the L2C-310 TRM "Event Counter Configuration":
+ * 0x1 CO, 0x2 DRHIT, 0x3 DRREQ, 0x4 DWHIT, 0x5 DWREQ, 0x6 DWTREQ,
+ * 0x7 IRHIT, 0x8 IRREQ, 0x9 WA, 0xa IPFALLOC, 0xb EPFHIT, 0xc EPFALLOC,
+ * 0xd SRRCVD, 0xe SRCONF, 0xf EPFRCVD.
+ */
+PMU_FORMAT_ATTR(event, "config:0-3");
+
+static struct attribute *l2x0_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	NULL,
+};
+
+static struct attribute_group l2x0_pmu_format_attr_group = {
+	.name = "format",
+	.attrs = l2x0_pmu_format_attrs,
+};
+
+static const struct attribute_group *l2x0_pmu_attr_groups[] = {
+	&l2x0_pmu_format_attr_group,
+	NULL,
+};
+
+static struct pmu l2x0_pmu = {
+	.attr_groups	= l2x0_pmu_attr_groups,
+	.pmu_enable	= l2x0_pmu_enable,
+	.pmu_disable	= l2x0_pmu_disable,
+	.event_init	= l2x0_pmu_event_init,
+	.add		= l2x0_pmu_event_add,
+	.del		= l2x0_pmu_event_del,
+	.start		= l2x0_pmu_event_start,
+	.stop		= l2x0_pmu_event_stop,
+	.read		= l2x0_pmu_event_read,
+};
+
+void __init l2x0_pmu_register(void __iomem *base, u32 part)
+{
+	/* Only the L2C-310 has these counters at these offsets */
+	if ((part & L2X0_CACHE_ID_PART_MASK) != L2X0_CACHE_ID_PART_L310)
+		return;
+
+	l2x0_pmu_base = base;
+}
+
+static int __init l2x0_pmu_init(void)
+{
+	int ret;
+
+	if (!l2x0_pmu_base)
+		return 0;
+
+	__l2x0_pmu_disable();
+	l2x0_pmu_counter_config_write(0, L2X0_EVENT_CNT_CFG_SRC_DISABLED);
+	l2x0_pmu_counter_config_write(1, L2X0_EVENT_CNT_CFG_SRC_DISABLED);
+
+	l2x0_pmu_poll_period = ktime_set(L2X0_PMU_POLL_MS / MSEC_PER_SEC,
+			(L2X0_PMU_POLL_MS % MSEC_PER_SEC) * NSEC_PER_MSEC);
+	hrtimer_init(&l2x0_pmu_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	l2x0_pmu_hrtimer.function = l2x0_pmu_poll;
+
+	ret = perf_pmu_register(&l2x0_pmu, "l2c_310", -1);
+	if (ret) {
+		pr_err("failed to register: %d\n", ret);
+		return ret;
+	}
+
+	pr_info("registered %d counters\n", PMU_NR_COUNTERS);
+
+	return 0;
+}
+device_initcall(l2x0_pmu_init);
@@ -22,6 +22,11 @@
 #include <linux/io.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/hash.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kallsyms.h>
 
 #include <asm/cacheflush.h>
 #include <asm/hardware/cache-l2x0.h>
@@ -36,6 +41,16 @@ static u32 l2x0_cache_id;
 static unsigned int l2x0_sets;
 static unsigned int l2x0_ways;
 static unsigned long sync_reg_offset = L2X0_CACHE_SYNC;
+static u32 l2x0_way_op_threshold;	/* Range size to switch to way ops */
+
+/*
+ * Line operations are atomic on a PL310 and need no serialisation
+ * against each other, so unless an erratum workaround has to bracket
+ * them with debug register writes they run without l2x0_lock and all
+ * CPUs can maintain their own ranges in parallel.
+ */
+static bool l2x0_line_ops_lockless;
+static bool l2x0_debug_errata;	/* Revision needs the debug workarounds */
 
 static inline bool is_pl310_rev(int rev)
 {
@@ -93,10 +108,26 @@ static inline void l2x0_inv_line(unsigned long addr)
 #if defined(CONFIG_PL310_ERRATA_588369) || defined(CONFIG_PL310_ERRATA_727915)
 static inline void debug_writel(unsigned long val)
 {
-	if (outer_cache.set_debug)
+	if (l2x0_debug_errata && outer_cache.set_debug)
 		outer_cache.set_debug(val);
 }
 
+/* 588369 is fixed in r2p0 and 727915 only affects r2p0 */
+static bool __init pl310_needs_debug_errata(void)
+{
+	u32 rtl = l2x0_cache_id & L2X0_CACHE_ID_RTL_MASK;
+
+#ifdef CONFIG_PL310_ERRATA_588369
+	if (rtl <= L2X0_CACHE_ID_RTL_R1P0)
+		return true;
+#endif
+#ifdef CONFIG_PL310_ERRATA_727915
+	if (rtl == L2X0_CACHE_ID_RTL_R2P0)
+		return true;
+#endif
+	return false;
+}
+
 static void pl310_set_debug(unsigned long val)
 {
 	writel_relaxed(val, l2x0_base + L2X0_DEBUG_CTRL);
@@ -107,6 +138,11 @@ static inline void debug_writel(unsigned long val)
 {
 }
 
+static inline bool pl310_needs_debug_errata(void)
+{
+	return false;
+}
+
 #define pl310_set_debug	NULL
 #endif
 
@@ -218,12 +254,102 @@ static void l2x0_inv_all(void)
 	raw_spin_unlock_irqrestore(&l2x0_lock, flags);
 }
 
-static void l2x0_inv_range(unsigned long start, unsigned long end)
+#ifdef CONFIG_DEBUG_FS
+enum {
+	L2X0_STAT_INV,
+	L2X0_STAT_CLEAN,
+	L2X0_STAT_FLUSH,
+	L2X0_STAT_NR,
+};
+
+/*
+ * Maintenance statistics keyed by the caller of the outer_cache hook.
+ * Slots are claimed on first use; callers that find no free slot are
+ * accounted in the last, anonymous one.
+ */
+#define L2X0_STATS_BITS		5
+#define L2X0_STATS_SLOTS	(1 << L2X0_STATS_BITS)
+#define L2X0_STATS_PROBE	4
+
+struct l2x0_caller_stats {
+	unsigned long ip;
+	atomic_t ops[L2X0_STAT_NR];
+	atomic_t way_ops;
+	atomic64_t bytes;
+};
+
+static struct l2x0_caller_stats l2x0_stats[L2X0_STATS_SLOTS + 1];
+
+static struct l2x0_caller_stats *l2x0_stats_slot(unsigned long ip)
+{
+	unsigned long hash = hash_long(ip, L2X0_STATS_BITS);
+	int i;
+
+	for (i = 0; i < L2X0_STATS_PROBE; i++) {
+		struct l2x0_caller_stats *st;
+		unsigned long old;
+
+		st = &l2x0_stats[(hash + i) & (L2X0_STATS_SLOTS - 1)];
+		old = ACCESS_ONCE(st->ip);
+		if (old == ip)
+			return st;
+		if (!old && (!cmpxchg(&st->ip, 0, ip) || st->ip == ip))
+			return st;
+	}
+
+	return &l2x0_stats[L2X0_STATS_SLOTS];
+}
+
+static void l2x0_stats_add(int op, unsigned long ip, unsigned long size,
+			   bool way)
+{
+	struct l2x0_caller_stats *st = l2x0_stats_slot(ip);
+
+	atomic_inc(&st->ops[op]);
+	if (way)
+		atomic_inc(&st->way_ops);
+	atomic64_add(size, &st->bytes);
+}
+#else
+static inline void l2x0_stats_add(int op, unsigned long ip,
+				  unsigned long size, bool way)
+{
+}
+#endif
+
+static inline void l2x0_range_lock(unsigned long *flags)
+{
+	if (!l2x0_line_ops_lockless)
+		raw_spin_lock_irqsave(&l2x0_lock, *flags);
+}
+
+static inline void l2x0_range_unlock(unsigned long flags)
+{
+	if (!l2x0_line_ops_lockless)
+		raw_spin_unlock_irqrestore(&l2x0_lock, flags);
+}
+
+/* Let others at the lock between blocks of a long locked range */
+static inline void l2x0_range_relax(unsigned long *flags)
+{
+	if (!l2x0_line_ops_lockless) {
+		raw_spin_unlock_irqrestore(&l2x0_lock, *flags);
+		raw_spin_lock_irqsave(&l2x0_lock, *flags);
+	}
+}
+
+static inline bool l2x0_use_way_op(unsigned long size)
+{
+	return size >= l2x0_way_op_threshold;
+}
+
+static void __l2x0_inv_range(unsigned long start, unsigned long end,
+			     bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
-	raw_spin_lock_irqsave(&l2x0_lock, flags);
+	l2x0_range_lock(&flags);
 	if (start & (CACHE_LINE_SIZE - 1)) {
 		start &= ~(CACHE_LINE_SIZE - 1);
 		debug_writel(0x03);
@@ -247,27 +373,22 @@ static void l2x0_inv_range(unsigned long start, unsigned long end)
 			start += CACHE_LINE_SIZE;
 		}
 
-		if (blk_end < end) {
-			raw_spin_unlock_irqrestore(&l2x0_lock, flags);
-			raw_spin_lock_irqsave(&l2x0_lock, flags);
-		}
+		if (blk_end < end)
+			l2x0_range_relax(&flags);
 	}
 	cache_wait(base + L2X0_INV_LINE_PA, 1);
-	cache_sync();
-	raw_spin_unlock_irqrestore(&l2x0_lock, flags);
+	if (sync)
+		cache_sync();
+	l2x0_range_unlock(flags);
 }
 
-static void l2x0_clean_range(unsigned long start, unsigned long end)
+static void __l2x0_clean_range(unsigned long start, unsigned long end,
+			       bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
-	if ((end - start) >= l2x0_size) {
-		l2x0_clean_all();
-		return;
-	}
-
-	raw_spin_lock_irqsave(&l2x0_lock, flags);
+	l2x0_range_lock(&flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
 		unsigned long blk_end = start + min(end - start, 4096UL);
@@ -277,27 +398,22 @@ static void l2x0_clean_range(unsigned long start, unsigned long end)
 			start += CACHE_LINE_SIZE;
 		}
 
-		if (blk_end < end) {
-			raw_spin_unlock_irqrestore(&l2x0_lock, flags);
-			raw_spin_lock_irqsave(&l2x0_lock, flags);
-		}
+		if (blk_end < end)
+			l2x0_range_relax(&flags);
 	}
 	cache_wait(base + L2X0_CLEAN_LINE_PA, 1);
-	cache_sync();
-	raw_spin_unlock_irqrestore(&l2x0_lock, flags);
+	if (sync)
+		cache_sync();
+	l2x0_range_unlock(flags);
 }
 
-static void l2x0_flush_range(unsigned long start, unsigned long end)
+static void __l2x0_flush_range(unsigned long start, unsigned long end,
+			       bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
-	if ((end - start) >= l2x0_size) {
-		l2x0_flush_all();
-		return;
-	}
-
-	raw_spin_lock_irqsave(&l2x0_lock, flags);
+	l2x0_range_lock(&flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
 		unsigned long blk_end = start + min(end - start, 4096UL);
@@ -309,14 +425,105 @@ static void l2x0_flush_range(unsigned long start, unsigned long end)
 		}
 		debug_writel(0x00);
 
-		if (blk_end < end) {
-			raw_spin_unlock_irqrestore(&l2x0_lock, flags);
-			raw_spin_lock_irqsave(&l2x0_lock, flags);
-		}
+		if (blk_end < end)
+			l2x0_range_relax(&flags);
 	}
 	cache_wait(base + L2X0_CLEAN_INV_LINE_PA, 1);
-	cache_sync();
-	raw_spin_unlock_irqrestore(&l2x0_lock, flags);
+	if (sync)
+		cache_sync();
+	l2x0_range_unlock(flags);
+}
+
+static void l2x0_inv_range(unsigned long start, unsigned long end)
+{
+	/* Never by way: that would discard other dirty lines too */
+	l2x0_stats_add(L2X0_STAT_INV, _RET_IP_, end - start, false);
+	__l2x0_inv_range(start, end, true);
+}
+
+static void l2x0_clean_range(unsigned long start, unsigned long end)
+{
+	if (l2x0_use_way_op(end - start)) {
+		l2x0_stats_add(L2X0_STAT_CLEAN, _RET_IP_, end - start, true);
+		l2x0_clean_all();
+		return;
+	}
+
+	l2x0_stats_add(L2X0_STAT_CLEAN, _RET_IP_, end - start, false);
+	__l2x0_clean_range(start, end, true);
+}
+
+static void l2x0_flush_range(unsigned long start, unsigned long end)
+{
+	if (l2x0_use_way_op(end - start)) {
+		l2x0_stats_add(L2X0_STAT_FLUSH, _RET_IP_, end - start, true);
+		l2x0_flush_all();
+		return;
+	}
+
+	l2x0_stats_add(L2X0_STAT_FLUSH, _RET_IP_, end - start, false);
+	__l2x0_flush_range(start, end, true);
+}
+
+/*
+ * Maintain every entry of a scatterlist with a single cache sync at the
+ * end, or with one way operation once the list adds up to the way-op
+ * threshold.  The direction selects the operation as for the DMA API.
+ */
+static void l2x0_sync_sg(struct scatterlist *sgl, int nents,
+			 enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	unsigned long total = 0;
+	int op, i;
+
+	switch (dir) {
+	case DMA_TO_DEVICE:
+		op = L2X0_STAT_CLEAN;
+		break;
+	case DMA_FROM_DEVICE:
+		op = L2X0_STAT_INV;
+		break;
+	default:
+		op = L2X0_STAT_FLUSH;
+		break;
+	}
+
+	for_each_sg(sgl, sg, nents, i)
+		total += sg->length;
+
+	if (op != L2X0_STAT_INV && l2x0_use_way_op(total)) {
+		l2x0_stats_add(op, _RET_IP_, total, true);
+		if (op == L2X0_STAT_CLEAN)
+			l2x0_clean_all();
+		else
+			l2x0_flush_all();
+		return;
+	}
+
+	l2x0_stats_add(op, _RET_IP_, total, false);
+	for_each_sg(sgl, sg, nents, i) {
+		unsigned long start = sg_phys(sg);
+		unsigned long end = start + sg->length;
+		bool last = i == nents - 1;
+
+		if (op == L2X0_STAT_CLEAN)
+			__l2x0_clean_range(start, end, last);
+		else if (op == L2X0_STAT_INV)
+			__l2x0_inv_range(start, end, last);
+		else
+			__l2x0_flush_range(start, end, last);
+	}
+}
+
+/*
+ * Set the range size from which clean and flush operate on the whole
+ * cache by way instead of line by line.  Defaults to the cache size;
+ * SoCs may lower it with this after l2x0_init().
+ */
+void l2x0_set_way_op_threshold(u32 size)
+{
+	l2x0_way_op_threshold = size;
 }
 
 static void l2x0_disable(void)
@@ -376,6 +583,9 @@ void __init l2x0_init(void __iomem *base, u32 aux_val, u32 aux_mask)
 		sync_reg_offset = L2X0_DUMMY_REG;
 #endif
 		outer_cache.set_debug = pl310_set_debug;
+		l2x0_debug_errata = pl310_needs_debug_errata();
+		l2x0_line_ops_lockless = IS_ENABLED(CONFIG_CACHE_PL310) &&
+					 !pl310_needs_debug_errata();
 		break;
 	case L2X0_CACHE_ID_PART_L210:
 		l2x0_ways = (aux >> 13) & 0xf;
@@ -397,6 +607,7 @@ void __init l2x0_init(void __iomem *base, u32 aux_val, u32 aux_mask)
 	way_size = SZ_1K << (way_size + 3);
 	l2x0_size = l2x0_ways * way_size;
 	l2x0_sets = way_size / CACHE_LINE_SIZE;
+	l2x0_way_op_threshold = l2x0_size;
 
 	/*
 	 * Check if l2x0 controller is already enabled.
@@ -421,6 +632,7 @@ void __init l2x0_init(void __iomem *base, u32 aux_val, u32 aux_mask)
 	outer_cache.inv_range = l2x0_inv_range;
 	outer_cache.clean_range = l2x0_clean_range;
 	outer_cache.flush_range = l2x0_flush_range;
+	outer_cache.sync_sg = l2x0_sync_sg;
 	outer_cache.sync = l2x0_cache_sync;
 	outer_cache.flush_all = l2x0_flush_all;
 	outer_cache.inv_all = l2x0_inv_all;
@@ -429,6 +641,10 @@ void __init l2x0_init(void __iomem *base, u32 aux_val, u32 aux_mask)
 	printk(KERN_INFO "%s cache controller enabled\n", type);
 	printk(KERN_INFO "l2x0: %d ways, CACHE_ID 0x%08x, AUX_CTRL 0x%08x, Cache size: %d B\n",
 			l2x0_ways, l2x0_cache_id, aux, l2x0_size);
+	if (l2x0_line_ops_lockless)
+		printk(KERN_INFO "l2x0: lockless line operations\n");
+
+	l2x0_pmu_register(l2x0_base, l2x0_cache_id);
 }
 
 #ifdef CONFIG_OF
@@ -629,3 +845,74 @@ int __init l2x0_of_init(u32 aux_val, u32 aux_mask)
 	return 0;
 }
 #endif
+
+#ifdef CONFIG_DEBUG_FS
+static int l2x0_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "line ops:         %s\n",
+		   l2x0_line_ops_lockless ? "lockless" : "locked");
+	seq_printf(s, "way op threshold: %u\n", l2x0_way_op_threshold);
+	seq_printf(s, "%-40s %8s %8s %8s %8s %12s\n", "caller",
+		   "inv", "clean", "flush", "way", "bytes");
+
+	for (i = 0; i <= L2X0_STATS_SLOTS; i++) {
+		struct l2x0_caller_stats *st = &l2x0_stats[i];
+		char name[KSYM_SYMBOL_LEN];
+
+		if (i < L2X0_STATS_SLOTS && !st->ip)
+			continue;
+		if (!atomic64_read(&st->bytes) && !atomic_read(&st->way_ops) &&
+		    !atomic_read(&st->ops[L2X0_STAT_INV]) &&
+		    !atomic_read(&st->ops[L2X0_STAT_CLEAN]) &&
+		    !atomic_read(&st->ops[L2X0_STAT_FLUSH]))
+			continue;
+
+		if (st->ip)
+			sprint_symbol(name, st->ip);
+		else
+			strcpy(name, "(other)");
+
+		seq_printf(s, "%-40s %8d %8d %8d %8d %12llu\n", name,
+			   atomic_read(&st->ops[L2X0_STAT_INV]),
+			   atomic_read(&st->ops[L2X0_STAT_CLEAN]),
+			   atomic_read(&st->ops[L2X0_STAT_FLUSH]),
+			   atomic_read(&st->way_ops),
+			   (unsigned long long)atomic64_read(&st->bytes));
+	}
+
+	return 0;
+}
+
+static int l2x0_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, l2x0_stats_show, inode->i_private);
+}
+
+static const struct file_operations l2x0_stats_fops = {
+	.open		= l2x0_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init l2x0_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	if (!l2x0_base)
+		return 0;
+
+	dir = debugfs_create_dir("l2x0", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_file("stats", S_IRUGO, dir, NULL, &l2x0_stats_fops);
+	debugfs_create_u32("way_op_threshold", S_IRUGO | S_IWUSR, dir,
+			   &l2x0_way_op_threshold);
+
+	return 0;
+}
+late_initcall(l2x0_debugfs_init);
+#endif
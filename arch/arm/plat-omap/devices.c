@@ -18,6 +18,7 @@
 #include <linux/memblock.h>
 
 #include <mach/hardware.h>
+#include <mach/irqs.h>
 #include <asm/mach-types.h>
 #include <asm/mach/map.h>
 #include <asm/memblock.h>
@@ -94,6 +95,21 @@ static struct resource rng_resources[] = {
 	},
 };
 
+/* OMAP4 and OMAP5 have the same RNG module, at the same address */
+#define	OMAP44XX_RNG_BASE	0x48090000
+
+static struct resource omap4_rng_resources[] = {
+	{
+		.start		= OMAP44XX_RNG_BASE,
+		.end		= OMAP44XX_RNG_BASE + 0x1fff,
+		.flags		= IORESOURCE_MEM,
+	},
+	{
+		.start		= OMAP44XX_IRQ_RNG,
+		.flags		= IORESOURCE_IRQ,
+	},
+};
+
 static struct platform_device omap_rng_device = {
 	.name		= "omap_rng",
 	.id		= -1,
@@ -103,6 +119,14 @@ static struct platform_device omap_rng_device = {
 
 static void omap_init_rng(void)
 {
+	if (cpu_is_omap44xx() || cpu_is_omap54xx()) {
+		/* the secure side owns the RNG on HS devices */
+		if (omap_type() != OMAP2_DEVICE_TYPE_GP)
+			return;
+		omap_rng_device.resource = omap4_rng_resources;
+		omap_rng_device.num_resources = ARRAY_SIZE(omap4_rng_resources);
+	}
+
 	(void) platform_device_register(&omap_rng_device);
 }
 #else
@@ -47,6 +47,13 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			bool early_callback,
 			void (*cb_fn)(void *, int), void *cb_arg);
 
+struct sync_fence;
+int dsscomp_gralloc_queue_fence(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			struct sync_fence *acquire,
+			struct sync_fence **release,
+			void (*cb_fn)(void *, int), void *cb_arg);
+
 void dsscomp_set_platform_data(struct dsscomp_platform_data *data);
 
 #endif
@@ -21,6 +21,9 @@ extern struct mutex omap_dvfs_lock;
 int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 				char *clk_name);
 int omap_device_scale(struct device *target_dev, unsigned long rate);
+int omap_device_scale_floor(struct device *target_dev, unsigned long floor);
+int omap_device_scale_async(struct device *target_dev, unsigned long rate);
+unsigned long omap_device_get_rate(struct device *target_dev);
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
 	return mutex_is_locked(&omap_dvfs_lock);
@@ -39,6 +42,20 @@ static inline int omap_device_scale(struct device *target_dev,
 {
 	return 0;
 }
+static inline int omap_device_scale_floor(struct device *target_dev,
+					  unsigned long floor)
+{
+	return 0;
+}
+static inline int omap_device_scale_async(struct device *target_dev,
+					  unsigned long rate)
+{
+	return 0;
+}
+static inline unsigned long omap_device_get_rate(struct device *target_dev)
+{
+	return 0;
+}
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
 	return false;
@@ -0,0 +1,48 @@
+/*
+ * OMAP4 Error Location Module
+ *
+ * Copyright (C) 2012 Texas Instruments
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARCH_OMAP_ELM_H
+#define __ASM_ARCH_OMAP_ELM_H
+
+#define ELM_MAX_VECTORS		8	/* syndromes decoded per page */
+#define ELM_MAX_ERRORS		16
+
+/**
+ * struct elm_errorvec - result of decoding one sector's syndrome
+ * @error_reported:	set by the caller for sectors that need decoding
+ * @error_uncorrectable: more errors than the BCH level can locate
+ * @error_count:	number of valid entries in @error_loc
+ * @error_loc:		bit positions of the errors, counted from the last
+ *			bit of the codeword
+ */
+struct elm_errorvec {
+	bool error_reported;
+	bool error_uncorrectable;
+	int error_count;
+	int error_loc[ELM_MAX_ERRORS];
+};
+
+#if defined(CONFIG_MTD_NAND_OMAP_BCH)
+extern bool omap_elm_present(void);
+extern int omap_elm_decode_page(int nerrors, const u8 *syndrome, int nvecs,
+				struct elm_errorvec *err_vec);
+#else
+static inline bool omap_elm_present(void)
+{
+	return false;
+}
+
+static inline int omap_elm_decode_page(int nerrors, const u8 *syndrome,
+				       int nvecs, struct elm_errorvec *err_vec)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
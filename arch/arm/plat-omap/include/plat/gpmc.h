@@ -92,8 +92,15 @@ enum omap_ecc {
 	OMAP_ECC_HAMMING_CODE_HW, /* gpmc to detect the error */
 		/* 1-bit ecc: stored at beginning of spare area as romcode */
 	OMAP_ECC_HAMMING_CODE_HW_ROMCODE, /* gpmc method & romcode layout */
+		/* 4/8-bit ecc: gpmc BCH engine, located by the ELM */
+	OMAP_ECC_BCH4_CODE_HW,
+	OMAP_ECC_BCH8_CODE_HW,
 };
 
+/* BCH ecc bytes per 512 byte sector, and their slot in the spare area */
+#define BCH_ECC_BYTES(nerrors)		((nerrors) == 8 ? 13 : 7)
+#define BCH_ECC_OOB_BYTES(nerrors)	((nerrors) == 8 ? 14 : 8)
+
 /*
  * Note that all values in this struct are in nanoseconds except sync_clk
  * (which is in picoseconds), while the register values are in gpmc_fck cycles.
@@ -157,4 +164,7 @@ extern int gpmc_nand_write(int cs, int cmd, int wval);
 
 int gpmc_enable_hwecc(int cs, int mode, int dev_width, int ecc_size);
 int gpmc_calculate_ecc(int cs, const u_char *dat, u_char *ecc_code);
+int gpmc_enable_hwecc_bch(int cs, int mode, int dev_width, int nsectors,
+			  int nerrors);
+int gpmc_calculate_ecc_bch(int cs, int nsectors, int nerrors, u_char *ecc_code);
 #endif
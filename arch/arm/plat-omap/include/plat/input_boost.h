@@ -0,0 +1,20 @@
+/*
+ * OMAP touch input boost
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ARCH_ARM_PLAT_OMAP_INPUT_BOOST_H
+#define __ARCH_ARM_PLAT_OMAP_INPUT_BOOST_H
+
+#ifdef CONFIG_OMAP_INPUT_BOOST
+void omap_input_boost_frame(void);
+#else
+static inline void omap_input_boost_frame(void) { }
+#endif
+
+#endif
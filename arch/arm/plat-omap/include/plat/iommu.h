@@ -61,6 +61,11 @@ struct omap_iommu {
 	union iommu_qos	qos_request;
 	int secure_mode;	/* secure mode enabled flag */
 	void *secure_ttb;	/* ttb address to be used in secure mode */
+
+	/* page table entries by MMU_CAM_PGSZ_*, under page_table_lock */
+	unsigned long	nr_map[4];
+	unsigned long	nr_unmap[4];
+	unsigned long	nr_tlb_flush;	/* tlb scans for invalidation, racy */
 };
 
 struct cr_regs {
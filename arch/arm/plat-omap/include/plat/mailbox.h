@@ -8,6 +8,8 @@
 #include <linux/interrupt.h>
 #include <linux/device.h>
 #include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
 
 typedef u32 mbox_msg_t;
 struct omap_mbox;
@@ -50,6 +52,37 @@ struct omap_mbox_queue {
 	struct tasklet_struct	tasklet;
 	struct omap_mbox	*mbox;
 	bool full;
+	ktime_t			stamp;
+};
+
+/**
+ * struct omap_mbox_stats - per mailbox traffic statistics
+ * @tx_direct: messages written straight to the hardware fifo
+ * @tx_queued: messages that had to wait in the tx queue
+ * @tx_dropped: messages refused because the tx queue was full
+ * @txq_max: deepest the tx queue has been (in messages)
+ * @tx_lat_avg_us: average time to drain the tx queue once it is used
+ * @tx_lat_max_us: longest time to drain the tx queue
+ * @rx_atomic: messages consumed by atomic clients from the irq handler
+ * @rx_deferred: messages delivered to the blocking clients
+ * @rx_overflow: times the rx queue filled up and rx had to be throttled
+ * @rxq_max: deepest the rx queue has been (in messages)
+ * @rx_lat_avg_us: average delay between the irq and the blocking delivery
+ * @rx_lat_max_us: longest delay between the irq and the blocking delivery
+ */
+struct omap_mbox_stats {
+	u32 tx_direct;
+	u32 tx_queued;
+	u32 tx_dropped;
+	u32 txq_max;
+	u32 tx_lat_avg_us;
+	u32 tx_lat_max_us;
+	u32 rx_atomic;
+	u32 rx_deferred;
+	u32 rx_overflow;
+	u32 rxq_max;
+	u32 rx_lat_avg_us;
+	u32 rx_lat_max_us;
 };
 
 struct omap_mbox {
@@ -61,7 +94,9 @@ struct omap_mbox {
 	void			*priv;
 	int			use_count;
 	struct blocking_notifier_head   notifier;
+	struct atomic_notifier_head	atomic_notifier;
 	unsigned int		pm_constraint;
+	struct omap_mbox_stats	stats;
 };
 
 int omap_mbox_msg_send(struct omap_mbox *, mbox_msg_t msg);
@@ -70,6 +105,11 @@ void omap_mbox_init_seq(struct omap_mbox *);
 struct omap_mbox *omap_mbox_get(const char *, struct notifier_block *nb);
 void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb);
 
+int omap_mbox_register_atomic(struct omap_mbox *mbox,
+						struct notifier_block *nb);
+void omap_mbox_unregister_atomic(struct omap_mbox *mbox,
+						struct notifier_block *nb);
+
 int omap_mbox_register(struct device *parent, struct omap_mbox **);
 int omap_mbox_unregister(struct device *parent);
 
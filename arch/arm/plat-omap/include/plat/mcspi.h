@@ -7,9 +7,14 @@
 
 #define OMAP4_MCSPI_REG_OFFSET 0x100
 
+struct device;
+
 struct omap2_mcspi_platform_config {
 	unsigned short	num_cs;
 	unsigned int regs_offset;
+	/* pump messages from a SCHED_FIFO thread */
+	bool rt;
+	bool (*context_lost)(struct device *dev);
 };
 
 struct omap2_mcspi_dev_attr {
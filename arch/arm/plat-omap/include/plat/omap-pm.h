@@ -346,6 +346,16 @@ unsigned long omap_pm_cpu_get_freq(void);
  */
 int omap_pm_get_dev_context_loss_count(struct device *dev);
 
+/**
+ * omap_pm_dev_context_lost - did dev lose its context while idle?
+ * @dev: struct device *
+ *
+ * For use in the driver's runtime_resume callback, instead of keeping the
+ * context loss count around.  Returns false only if the device is known
+ * to still have its context since it was last idled.
+ */
+bool omap_pm_dev_context_lost(struct device *dev);
+
 void omap_pm_enable_off_mode(void);
 void omap_pm_disable_off_mode(void);
 
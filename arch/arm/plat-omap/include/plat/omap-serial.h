@@ -54,6 +54,9 @@
 
 #define OMAP_UART_DMA_CH_FREE	-1
 
+/* The RX DMA ring interrupts every 1/OMAP_UART_RX_DMA_PERIODS of its size */
+#define OMAP_UART_RX_DMA_PERIODS	4
+
 /*
  * (Errata i659) - From OMAP4430 ES 2.0 onwards set
  * tx_threshold while using UART in DMA Mode
@@ -83,7 +86,6 @@ struct omap_uart_port_info {
 	unsigned int		dma_rx_buf_size;
 	unsigned int		dma_rx_timeout;
 	unsigned int		autosuspend_timeout;
-	unsigned int		dma_rx_poll_rate;
 	unsigned		rts_mux_driver_control:1;
 
 	int (*get_context_loss_count)(struct device *);
@@ -93,11 +95,25 @@ struct omap_uart_port_info {
 	void (*rts_mux_write)(u16 val, int num);
 };
 
+struct uart_omap_dma_stats {
+	u64			rx_bytes;	/* received through the ring */
+	u64			tx_bytes;
+	unsigned long		rx_irqs;	/* ring period interrupts */
+	unsigned long		rx_flushes;	/* UART RX timeouts */
+	unsigned long		tx_irqs;
+	unsigned long		tx_chained;	/* wrapped transfers sent at once */
+	unsigned long		rx_active;	/* jiffies the ring ran */
+	u64			cpu_ns;		/* time spent moving DMA data */
+};
+
 struct uart_omap_dma {
 	u8			uart_dma_tx;
 	u8			uart_dma_rx;
 	int			rx_dma_channel;
 	int			tx_dma_channel;
+	/* second half of a transfer that wraps around the xmit buffer */
+	int			tx_dma_channel2;
+	bool			tx_chained;
 	dma_addr_t		rx_buf_dma_phys;
 	dma_addr_t		tx_buf_dma_phys;
 	unsigned int		uart_base;
@@ -106,17 +122,19 @@ struct uart_omap_dma {
 	 * comes from port structure.
 	 */
 	unsigned char		*rx_buf;
-	unsigned int		prev_rx_dma_pos;
+	/* offset in rx_buf of the first byte not yet passed to the tty */
+	unsigned int		rx_tail;
 	int			tx_buf_size;
 	int			tx_dma_used;
 	int			rx_dma_used;
 	spinlock_t		tx_lock;
 	spinlock_t		rx_lock;
-	/* timer to poll activity on rx dma */
+	/* stops rx dma after rx_timeout jiffies without data */
 	struct timer_list	rx_timer;
+	unsigned long		rx_start;
 	unsigned int		rx_buf_size;
-	unsigned int		rx_poll_rate;
 	unsigned int		rx_timeout;
+	struct uart_omap_dma_stats stats;
 };
 
 struct uart_omap_port {
@@ -48,6 +48,9 @@ extern struct dev_pm_domain omap_device_pm_domain;
 #define OMAP_DEVICE_SUSPENDED BIT(0)
 #define OMAP_DEVICE_NO_IDLE_ON_SUSPEND BIT(1)
 
+/* max number of suppliers and consumers tracked for async suspend/resume */
+#define OMAP_DEVICE_MAX_DEPS		4
+
 /**
  * struct omap_device - omap_device wrapper for platform_devices
  * @pdev: platform_device
@@ -60,6 +63,10 @@ extern struct dev_pm_domain omap_device_pm_domain;
  * @_dev_wakeup_lat_limit: dev wakeup latency limit in nsec - set by OMAP PM
  * @_state: one of OMAP_DEVICE_STATE_* (see above)
  * @flags: device flags
+ * @suppliers: devices that must be resumed before and suspended after this one
+ * @consumers: devices that depend on this one, the reverse of @suppliers
+ * @suppliers_cnt: number of entries used in @suppliers
+ * @consumers_cnt: number of entries used in @consumers
  *
  * Integrates omap_hwmod data into Linux platform_device.
  *
@@ -78,6 +85,14 @@ struct omap_device {
 	u8				hwmods_cnt;
 	u8				_state;
 	u8                              flags;
+	struct omap_device		*suppliers[OMAP_DEVICE_MAX_DEPS];
+	struct omap_device		*consumers[OMAP_DEVICE_MAX_DEPS];
+	u8				suppliers_cnt;
+	u8				consumers_cnt;
+	int				context_loss_cnt;
+	bool				context_lost;
+	unsigned int			ctx_restores;
+	unsigned int			ctx_restores_skipped;
 };
 
 /* Device driver interface (call via platform_data fn ptrs) */
@@ -86,9 +101,13 @@ int omap_device_enable(struct platform_device *pdev);
 int omap_device_idle(struct platform_device *pdev);
 int omap_device_runtime_resume_helper(struct device *dev);
 int omap_device_runtime_suspend_helper(struct device *dev);
+bool omap_device_context_lost(struct platform_device *pdev);
 
 int omap_device_shutdown(struct platform_device *pdev);
 
+int omap_device_add_supplier(struct platform_device *pdev,
+			     struct platform_device *supplier);
+
 /* Core code interface */
 
 struct platform_device *omap_device_build(const char *pdev_name, int pdev_id,
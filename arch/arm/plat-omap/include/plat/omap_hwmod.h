@@ -526,6 +526,10 @@ struct omap_hwmod_class {
  * @flags: hwmod flags (documented below)
  * @_lock: spinlock serializing operations on this hwmod
  * @node: list node for hwmod list (internal use)
+ * @_name_node: list node for the hwmod name hash (internal use)
+ * @_class_node: list node for the hwmod class name hash (internal use)
+ * @_setup_us: time the boot-time _setup() took, in microseconds
+ * @_reset_us: time the boot-time reset took, in microseconds
  *
  * @main_clk refers to this module's "main clock," which for our
  * purposes is defined as "the functional clock needed for register
@@ -559,6 +563,10 @@ struct omap_hwmod {
 	void __iomem			*_mpu_rt_va;
 	spinlock_t			_lock;
 	struct list_head		node;
+	struct list_head		_name_node;
+	struct list_head		_class_node;
+	u32				_setup_us;
+	u32				_reset_us;
 	u16				flags;
 	u8				_mpu_port_index;
 	u8				response_lat;
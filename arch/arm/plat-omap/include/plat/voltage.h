@@ -45,6 +45,9 @@ struct voltagedomain;
 struct voltagedomain *voltdm_lookup(const char *name);
 int voltdm_scale(struct voltagedomain *voltdm,
 		 struct omap_volt_data *target_volt);
+int voltdm_scale_start(struct voltagedomain *voltdm,
+		       struct omap_volt_data *target_volt);
+int voltdm_scale_finish(struct voltagedomain *voltdm);
 struct omap_volt_data *omap_voltage_get_curr_vdata(struct voltagedomain *voltdm);
 
 #endif
@@ -22,6 +22,29 @@
 #define __OMAP_VRAM_H__
 
 #include <linux/types.h>
+#include <linux/list.h>
+
+/*
+ * A user of VRAM.  Usage is accounted per client.  Allocations made with
+ * data may be moved by the allocator to fight fragmentation, see
+ * omap_vram_alloc_client().
+ */
+struct omap_vram_client {
+	const char *name;
+	int (*prepare_move)(void *data, unsigned long paddr);
+	void (*finish_move)(void *data, unsigned long paddr);
+
+	/* maintained by the allocator */
+	struct list_head list;
+	size_t used;
+	unsigned allocs;
+	unsigned moves;
+};
+
+extern int omap_vram_register_client(struct omap_vram_client *client);
+extern void omap_vram_unregister_client(struct omap_vram_client *client);
+extern int omap_vram_alloc_client(struct omap_vram_client *client,
+		size_t size, unsigned long *paddr, void *data);
 
 extern int omap_vram_add_region(unsigned long paddr, size_t size);
 extern int omap_vram_free(unsigned long paddr, size_t size);
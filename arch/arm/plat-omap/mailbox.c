@@ -33,6 +33,8 @@
 #include <linux/pm.h>
 #include <linux/pm_runtime.h>
 #include <linux/pm_qos.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <plat/mailbox.h>
 
@@ -139,6 +141,15 @@ static inline int is_mbox_irq(struct omap_mbox *mbox, omap_mbox_irq_t irq)
 	return mbox->ops->is_irq(mbox, irq);
 }
 
+/* fold a new latency sample into a 1/8 weight moving average */
+static void mbox_stats_latency(u32 *avg, u32 *max, ktime_t since)
+{
+	u32 us = ktime_us_delta(ktime_get(), since);
+
+	*avg = *avg ? (*avg * 7 + us) / 8 : us;
+	*max = max(*max, us);
+}
+
 /*
  * message sender
  */
@@ -156,30 +167,47 @@ static int __mbox_poll_for_space(struct omap_mbox *mbox)
 	return ret;
 }
 
+/*
+ * Can be called from any context, including the rx callback of an atomic
+ * client. As long as nothing is queued and the hardware fifo has room the
+ * message is written right away, otherwise it is queued behind the others
+ * and sent by the tasklet.
+ */
 int omap_mbox_msg_send(struct omap_mbox *mbox, mbox_msg_t msg)
 {
 	struct omap_mbox_queue *mq = mbox->txq;
+	unsigned long flags;
 	int ret = 0, len;
+	u32 depth;
 
-	spin_lock_bh(&mq->lock);
+	spin_lock_irqsave(&mq->lock, flags);
 
 	if (kfifo_avail(&mq->fifo) < sizeof(msg)) {
+		mbox->stats.tx_dropped++;
 		ret = -ENOMEM;
 		goto out;
 	}
 
-	if (kfifo_is_empty(&mq->fifo) && !__mbox_poll_for_space(mbox)) {
-		mbox_fifo_write(mbox, msg);
-		goto out;
+	if (kfifo_is_empty(&mq->fifo)) {
+		if (!mbox_fifo_full(mbox)) {
+			mbox_fifo_write(mbox, msg);
+			mbox->stats.tx_direct++;
+			goto out;
+		}
+		mq->stamp = ktime_get();
 	}
 
 	len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 	WARN_ON(len != sizeof(msg));
 
+	mbox->stats.tx_queued++;
+	depth = kfifo_len(&mq->fifo) / sizeof(msg);
+	mbox->stats.txq_max = max(mbox->stats.txq_max, depth);
+
 	tasklet_schedule(&mbox->txq->tasklet);
 
 out:
-	spin_unlock_bh(&mq->lock);
+	spin_unlock_irqrestore(&mq->lock, flags);
 	return ret;
 }
 EXPORT_SYMBOL(omap_mbox_msg_send);
@@ -191,17 +219,28 @@ static void mbox_tx_tasklet(unsigned long tx_data)
 	mbox_msg_t msg;
 	int ret;
 
+	/* we are the only reader, senders only write directly when empty */
 	while (kfifo_len(&mq->fifo)) {
 		if (__mbox_poll_for_space(mbox)) {
 			omap_mbox_enable_irq(mbox, IRQ_TX);
 			break;
 		}
 
+		/*
+		 * the last message must hit the hardware before a sender can
+		 * see the queue empty, or the two could be reordered
+		 */
+		spin_lock_irq(&mq->lock);
 		ret = kfifo_out(&mq->fifo, (unsigned char *)&msg,
 								sizeof(msg));
 		WARN_ON(ret != sizeof(msg));
 
 		mbox_fifo_write(mbox, msg);
+
+		if (kfifo_is_empty(&mq->fifo))
+			mbox_stats_latency(&mbox->stats.tx_lat_avg_us,
+					&mbox->stats.tx_lat_max_us, mq->stamp);
+		spin_unlock_irq(&mq->lock);
 	}
 }
 
@@ -215,10 +254,15 @@ static void mbox_rx_work(struct work_struct *work)
 	mbox_msg_t msg;
 	int len;
 
+	if (kfifo_len(&mq->fifo))
+		mbox_stats_latency(&mq->mbox->stats.rx_lat_avg_us,
+				&mq->mbox->stats.rx_lat_max_us, mq->stamp);
+
 	while (kfifo_len(&mq->fifo) >= sizeof(msg)) {
 		len = kfifo_out(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 		WARN_ON(len != sizeof(msg));
 
+		mq->mbox->stats.rx_deferred++;
 		blocking_notifier_call_chain(&mq->mbox->notifier, len,
 								(void *)msg);
 		spin_lock_irq(&mq->lock);
@@ -244,20 +288,36 @@ static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 {
 	struct omap_mbox_queue *mq = mbox->rxq;
 	mbox_msg_t msg;
-	int len;
+	int len, ret;
+	u32 depth;
 
 	while (!mbox_fifo_empty(mbox)) {
 		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg))) {
 			omap_mbox_disable_irq(mbox, IRQ_RX);
 			mq->full = true;
+			mbox->stats.rx_overflow++;
 			goto nomem;
 		}
 
 		msg = mbox_fifo_read(mbox);
 
+		/* atomic clients returning NOTIFY_STOP consume the message */
+		ret = atomic_notifier_call_chain(&mbox->atomic_notifier,
+						sizeof(msg), (void *)msg);
+		if (ret & NOTIFY_STOP_MASK) {
+			mbox->stats.rx_atomic++;
+			goto next;
+		}
+
+		if (kfifo_is_empty(&mq->fifo))
+			mq->stamp = ktime_get();
+
 		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 		WARN_ON(len != sizeof(msg));
 
+		depth = kfifo_len(&mq->fifo) / sizeof(msg);
+		mbox->stats.rxq_max = max(mbox->stats.rxq_max, depth);
+next:
 		if (mbox->ops->type == OMAP_MBOX_TYPE1)
 			break;
 	}
@@ -265,7 +325,8 @@ static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 	/* no more messages in the fifo. clear IRQ source. */
 	ack_mbox_irq(mbox, IRQ_RX);
 nomem:
-	schedule_work(&mbox->rxq->work);
+	if (!kfifo_is_empty(&mq->fifo))
+		queue_work(system_highpri_wq, &mbox->rxq->work);
 }
 
 static irqreturn_t mbox_interrupt(int irq, void *p)
@@ -431,6 +492,29 @@ void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb)
 }
 EXPORT_SYMBOL(omap_mbox_put);
 
+/**
+ * omap_mbox_register_atomic() - get received messages from the irq handler
+ * @mbox: a mailbox obtained with omap_mbox_get()
+ * @nb: notifier called in hard irq context for every received message
+ *
+ * The notifier gets the message as its data argument, and must return
+ * NOTIFY_STOP for the messages it handles; anything else is passed on to
+ * the clients registered with omap_mbox_get(), from process context.
+ */
+int omap_mbox_register_atomic(struct omap_mbox *mbox,
+						struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&mbox->atomic_notifier, nb);
+}
+EXPORT_SYMBOL(omap_mbox_register_atomic);
+
+void omap_mbox_unregister_atomic(struct omap_mbox *mbox,
+						struct notifier_block *nb)
+{
+	atomic_notifier_chain_unregister(&mbox->atomic_notifier, nb);
+}
+EXPORT_SYMBOL(omap_mbox_unregister_atomic);
+
 int omap_mbox_enable(struct omap_mbox *mbox)
 {
 	return pm_runtime_get_sync(mbox->dev->parent);
@@ -445,6 +529,64 @@ EXPORT_SYMBOL(omap_mbox_disable);
 
 static struct class omap_mbox_class = { .name = "mbox", };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *mbox_debugfs_dir;
+
+static int mbox_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_mbox *mbox = s->private;
+	struct omap_mbox_stats *st = &mbox->stats;
+
+	seq_printf(s, "tx direct:    %u\n", st->tx_direct);
+	seq_printf(s, "tx queued:    %u\n", st->tx_queued);
+	seq_printf(s, "tx dropped:   %u\n", st->tx_dropped);
+	seq_printf(s, "txq max:      %u\n", st->txq_max);
+	seq_printf(s, "tx latency:   %u us avg, %u us max\n",
+				st->tx_lat_avg_us, st->tx_lat_max_us);
+	seq_printf(s, "rx atomic:    %u\n", st->rx_atomic);
+	seq_printf(s, "rx deferred:  %u\n", st->rx_deferred);
+	seq_printf(s, "rx overflow:  %u\n", st->rx_overflow);
+	seq_printf(s, "rxq max:      %u\n", st->rxq_max);
+	seq_printf(s, "rx latency:   %u us avg, %u us max\n",
+				st->rx_lat_avg_us, st->rx_lat_max_us);
+	return 0;
+}
+
+static int mbox_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mbox_stats_show, inode->i_private);
+}
+
+static const struct file_operations mbox_stats_fops = {
+	.open = mbox_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mbox_debugfs_init(void)
+{
+	int i;
+
+	mbox_debugfs_dir = debugfs_create_dir("mailbox", NULL);
+	if (IS_ERR_OR_NULL(mbox_debugfs_dir))
+		return;
+
+	for (i = 0; mboxes[i]; i++)
+		debugfs_create_file(mboxes[i]->name, 0444, mbox_debugfs_dir,
+					mboxes[i], &mbox_stats_fops);
+}
+
+static void mbox_debugfs_exit(void)
+{
+	debugfs_remove_recursive(mbox_debugfs_dir);
+	mbox_debugfs_dir = NULL;
+}
+#else
+static inline void mbox_debugfs_init(void) { }
+static inline void mbox_debugfs_exit(void) { }
+#endif
+
 int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 {
 	int ret;
@@ -464,8 +606,10 @@ int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 		}
 
 		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->notifier);
+		ATOMIC_INIT_NOTIFIER_HEAD(&mbox->atomic_notifier);
 	}
 
+	mbox_debugfs_init();
 	pm_runtime_enable(parent);
 
 	return 0;
@@ -484,6 +628,8 @@ int omap_mbox_unregister(struct device *parent)
 	if (!mboxes)
 		return -EINVAL;
 
+	mbox_debugfs_exit();
+
 	for (i = 0; mboxes[i]; i++)
 		device_unregister(mboxes[i]->dev);
 
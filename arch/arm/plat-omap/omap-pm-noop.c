@@ -345,6 +345,17 @@ int omap_pm_get_dev_context_loss_count(struct device *dev)
 	return count;
 }
 
+bool omap_pm_dev_context_lost(struct device *dev)
+{
+	if (WARN_ON(!dev))
+		return true;
+
+	if (dev->pm_domain != &omap_device_pm_domain)
+		return true;
+
+	return omap_device_context_lost(to_platform_device(dev));
+}
+
 #else
 
 int omap_pm_get_dev_context_loss_count(struct device *dev)
@@ -352,6 +363,11 @@ int omap_pm_get_dev_context_loss_count(struct device *dev)
 	return dummy_context_loss_counter;
 }
 
+bool omap_pm_dev_context_lost(struct device *dev)
+{
+	return true;
+}
+
 #endif
 
 /* Should be called before clk framework init */
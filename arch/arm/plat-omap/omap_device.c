@@ -87,6 +87,8 @@
 #include <linux/io.h>
 #include <linux/clk.h>
 #include <linux/clkdev.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/pm_runtime.h>
 #include <linux/of.h>
 #include <linux/notifier.h>
@@ -102,6 +104,7 @@
 #define IGNORE_WAKEUP_LAT		1
 
 static int omap_early_device_register(struct platform_device *pdev);
+static void _add_hwmod_suppliers(struct omap_device *od);
 
 static struct omap_device_pm_latency omap_default_latency[] = {
 	{
@@ -757,6 +760,7 @@ struct platform_device __init *omap_device_build_ss(const char *pdev_name, int p
 		goto odbs_exit2;
 
 	omap_opp_register(&pdev->dev, ohs[0]->name);
+	_add_hwmod_suppliers(od);
 
 	return pdev;
 
@@ -771,6 +775,70 @@ odbs_exit:
 	return ERR_PTR(ret);
 }
 
+/**
+ * omap_device_add_supplier - order suspend/resume of two omap_devices
+ * @pdev: the consumer
+ * @supplier: device that @pdev needs to be functional
+ *
+ * With async suspend/resume only the parent of a device is waited for.
+ * This makes @pdev resume after @supplier, and @supplier suspend after
+ * @pdev, for dependencies that are not visible in the device tree such
+ * as a DSS submodule on the DSS core.  Returns 0, or -EINVAL if the two
+ * devices are the same, already depend on each other the other way round
+ * or if there is no room left to track the dependency.
+ */
+int omap_device_add_supplier(struct platform_device *pdev,
+			     struct platform_device *supplier)
+{
+	struct omap_device *od = to_omap_device(pdev);
+	struct omap_device *sod = to_omap_device(supplier);
+	int i;
+
+	if (!od || !sod || od == sod)
+		return -EINVAL;
+
+	for (i = 0; i < od->suppliers_cnt; i++)
+		if (od->suppliers[i] == sod)
+			return 0;
+	/* a cycle would keep both devices waiting for each other */
+	for (i = 0; i < od->consumers_cnt; i++)
+		if (od->consumers[i] == sod)
+			return -EINVAL;
+
+	if (od->suppliers_cnt == OMAP_DEVICE_MAX_DEPS ||
+	    sod->consumers_cnt == OMAP_DEVICE_MAX_DEPS) {
+		dev_warn(&pdev->dev, "too many dependencies, %s not added\n",
+			 dev_name(&supplier->dev));
+		return -EINVAL;
+	}
+
+	od->suppliers[od->suppliers_cnt++] = sod;
+	sod->consumers[sod->consumers_cnt++] = od;
+
+	return 0;
+}
+
+/*
+ * An omap_device depends on the omap_devices of the interconnects or
+ * modules that initiate the accesses to it, if they have been built.
+ */
+static void _add_hwmod_suppliers(struct omap_device *od)
+{
+	int i, j;
+
+	for (i = 0; i < od->hwmods_cnt; i++) {
+		struct omap_hwmod *oh = od->hwmods[i];
+
+		for (j = 0; j < oh->slaves_cnt; j++) {
+			struct omap_hwmod *master = oh->slaves[j]->master;
+
+			if (master && master->od && master->od != od)
+				omap_device_add_supplier(od->pdev,
+							 master->od->pdev);
+		}
+	}
+}
+
 /**
  * omap_early_device_register - register an omap_device as an early platform
  * device.
@@ -819,6 +887,30 @@ int omap_device_runtime_resume(struct device *dev)
 #endif
 
 #ifdef CONFIG_SUSPEND
+static int _od_suspend(struct device *dev)
+{
+	struct omap_device *od = to_omap_device(to_platform_device(dev));
+	int i;
+
+	if (od)
+		for (i = 0; i < od->consumers_cnt; i++)
+			device_pm_wait_for_dev(dev, &od->consumers[i]->pdev->dev);
+
+	return platform_pm_suspend(dev);
+}
+
+static int _od_resume(struct device *dev)
+{
+	struct omap_device *od = to_omap_device(to_platform_device(dev));
+	int i;
+
+	if (od)
+		for (i = 0; i < od->suppliers_cnt; i++)
+			device_pm_wait_for_dev(dev, &od->suppliers[i]->pdev->dev);
+
+	return platform_pm_resume(dev);
+}
+
 static int _od_suspend_noirq(struct device *dev)
 {
 	struct platform_device *pdev = to_platform_device(dev);
@@ -866,6 +958,8 @@ static int _od_resume_noirq(struct device *dev)
 	return pm_generic_resume_noirq(dev);
 }
 #else
+#define _od_suspend platform_pm_suspend
+#define _od_resume platform_pm_resume
 #define _od_suspend_noirq NULL
 #define _od_resume_noirq NULL
 #endif
@@ -876,6 +970,8 @@ struct dev_pm_domain omap_device_pm_domain = {
 				   omap_device_runtime_resume,
 				   _od_runtime_idle)
 		USE_PLATFORM_PM_SLEEP_OPS
+		.suspend = _od_suspend,
+		.resume = _od_resume,
 		.suspend_noirq = _od_suspend_noirq,
 		.resume_noirq = _od_resume_noirq,
 	}
@@ -894,6 +990,9 @@ int omap_device_register(struct platform_device *pdev)
 	pr_debug("omap_device: %s: registering\n", pdev->name);
 
 	pdev->dev.pm_domain = &omap_device_pm_domain;
+#ifdef CONFIG_OMAP_DEVICE_ASYNC_PM
+	device_enable_async_suspend(&pdev->dev);
+#endif
 	return platform_device_add(pdev);
 }
 
@@ -933,6 +1032,15 @@ int omap_device_enable(struct platform_device *pdev)
 
 	ret = _omap_device_activate(od, IGNORE_WAKEUP_LAT);
 
+	/*
+	 * Enabling the clockdomain has updated the powerdomain counters by
+	 * now, so this tells whether the registers survived the idle.
+	 */
+	od->context_lost = od->_state != OMAP_DEVICE_STATE_IDLE ||
+		!od->hwmods_cnt ||
+		omap_hwmod_get_context_loss_count(od->hwmods[0]) !=
+			od->context_loss_cnt;
+
 	od->dev_wakeup_lat = 0;
 	od->_dev_wakeup_lat_limit = UINT_MAX;
 	od->_state = OMAP_DEVICE_STATE_ENABLED;
@@ -969,11 +1077,39 @@ int omap_device_idle(struct platform_device *pdev)
 
 	ret = _omap_device_deactivate(od, USE_WAKEUP_LAT);
 
+	if (od->hwmods_cnt)
+		od->context_loss_cnt =
+			omap_hwmod_get_context_loss_count(od->hwmods[0]);
 	od->_state = OMAP_DEVICE_STATE_IDLE;
 
 	return ret;
 }
 
+/**
+ * omap_device_context_lost - did the device lose context while idle?
+ * @pdev: struct platform_device * of the device being resumed
+ *
+ * Meant for the runtime_resume callback of drivers, which can skip
+ * restoring their registers when this returns false.  Returns true if
+ * the powerdomain of the device's primary hwmod lost logic or memory
+ * context since the device was last idled, or if that is not known.
+ */
+bool omap_device_context_lost(struct platform_device *pdev)
+{
+	struct omap_device *od = to_omap_device(pdev);
+
+	if (!od)
+		return true;
+
+	if (od->context_lost)
+		od->ctx_restores++;
+	else
+		od->ctx_restores_skipped++;
+
+	return od->context_lost;
+}
+EXPORT_SYMBOL(omap_device_context_lost);
+
 /**
  * omap_device_runtime_resume_helper - unidle omap_device
  * @dev: struct device * to resume
@@ -1306,6 +1442,51 @@ static struct notifier_block platform_nb = {
 	.notifier_call = _omap_device_notifier_call,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int _od_context_show_one(struct device *dev, void *data)
+{
+	struct seq_file *s = data;
+	struct omap_device *od;
+
+	if (dev->pm_domain != &omap_device_pm_domain)
+		return 0;
+
+	od = to_omap_device(to_platform_device(dev));
+	if (od && (od->ctx_restores || od->ctx_restores_skipped))
+		seq_printf(s, "%-24s %10u %10u\n", dev_name(dev),
+			   od->ctx_restores, od->ctx_restores_skipped);
+
+	return 0;
+}
+
+static int omap_device_context_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "%-24s %10s %10s\n", "device", "restored", "skipped");
+	return bus_for_each_dev(&platform_bus_type, NULL, s,
+				_od_context_show_one);
+}
+
+static int omap_device_context_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_device_context_show, NULL);
+}
+
+static const struct file_operations omap_device_context_fops = {
+	.open		= omap_device_context_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap_device_debugfs_init(void)
+{
+	debugfs_create_file("omap_device_context", S_IRUGO, NULL, NULL,
+			    &omap_device_context_fops);
+	return 0;
+}
+late_initcall(omap_device_debugfs_init);
+#endif
+
 static int __init omap_device_init(void)
 {
 	int ret;
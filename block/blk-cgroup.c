@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 #include "blk-cgroup.h"
 #include <linux/genhd.h>
+#include <linux/math64.h>
 
 #define MAX_KEY_LEN 100
 
@@ -570,6 +571,33 @@ static void blkio_reset_stats_cpu(struct blkio_group *blkg)
 	}
 }
 
+/**
+ * blkiocg_update_read_latency - account a read completion of @blkcg
+ * @blkcg: group the read was issued from, it has a latency target
+ * @us: time from the queueing of the read to its completion
+ *
+ * Returns true if the read missed the latency target of the group.
+ */
+bool blkiocg_update_read_latency(struct blkio_cgroup *blkcg, unsigned long us)
+{
+	struct blkio_latency_stats *stats = &blkcg->read_latency;
+	unsigned long flags;
+	bool missed;
+
+	spin_lock_irqsave(&blkcg->lock, flags);
+	missed = us > blkcg->read_latency_target;
+	stats->reads++;
+	stats->total += us;
+	if (us > stats->max)
+		stats->max = us;
+	if (missed)
+		stats->missed++;
+	spin_unlock_irqrestore(&blkcg->lock, flags);
+
+	return missed;
+}
+EXPORT_SYMBOL_GPL(blkiocg_update_read_latency);
+
 static int
 blkiocg_reset_stats(struct cgroup *cgroup, struct cftype *cftype, u64 val)
 {
@@ -619,6 +647,7 @@ blkiocg_reset_stats(struct cgroup *cgroup, struct cftype *cftype, u64 val)
 		blkio_reset_stats_cpu(blkg);
 	}
 
+	memset(&blkcg->read_latency, 0, sizeof(blkcg->read_latency));
 	spin_unlock_irq(&blkcg->lock);
 	return 0;
 }
@@ -1233,6 +1262,23 @@ static int blkio_read_blkg_stats(struct blkio_cgroup *blkcg,
 }
 
 /* All map kind of cgroup file get serviced by this function */
+static int blkio_read_latency_stats(struct blkio_cgroup *blkcg,
+				    struct cgroup_map_cb *cb)
+{
+	struct blkio_latency_stats stats;
+
+	spin_lock_irq(&blkcg->lock);
+	stats = blkcg->read_latency;
+	spin_unlock_irq(&blkcg->lock);
+
+	cb->fill(cb, "reads", stats.reads);
+	cb->fill(cb, "avg_us", stats.reads ?
+		 div64_u64(stats.total, stats.reads) : 0);
+	cb->fill(cb, "max_us", stats.max);
+	cb->fill(cb, "missed", stats.missed);
+	return 0;
+}
+
 static int blkiocg_file_read_map(struct cgroup *cgrp, struct cftype *cft,
 				struct cgroup_map_cb *cb)
 {
@@ -1269,6 +1315,8 @@ static int blkiocg_file_read_map(struct cgroup *cgrp, struct cftype *cft,
 		case BLKIO_PROP_io_queued:
 			return blkio_read_blkg_stats(blkcg, cft, cb,
 						BLKIO_STAT_QUEUED, 1, 0);
+		case BLKIO_PROP_read_latency:
+			return blkio_read_latency_stats(blkcg, cb);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 		case BLKIO_PROP_unaccounted_time:
 			return blkio_read_blkg_stats(blkcg, cft, cb,
@@ -1350,6 +1398,8 @@ static u64 blkiocg_file_read_u64 (struct cgroup *cgrp, struct cftype *cft) {
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return (u64)blkcg->weight;
+		case BLKIO_PROP_read_latency_target:
+			return (u64)blkcg->read_latency_target;
 		}
 		break;
 	default:
@@ -1372,6 +1422,11 @@ blkiocg_file_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return blkio_weight_write(blkcg, val);
+		case BLKIO_PROP_read_latency_target:
+			if (val > UINT_MAX)
+				return -EINVAL;
+			blkcg->read_latency_target = (unsigned int)val;
+			return 0;
 		}
 		break;
 	default:
@@ -1445,6 +1500,19 @@ struct cftype blkio_files[] = {
 				BLKIO_PROP_io_queued),
 		.read_map = blkiocg_file_read_map,
 	},
+	{
+		.name = "read_latency_target",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_read_latency_target),
+		.read_u64 = blkiocg_file_read_u64,
+		.write_u64 = blkiocg_file_write_u64,
+	},
+	{
+		.name = "read_latency",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_read_latency),
+		.read_map = blkiocg_file_read_map,
+	},
 	{
 		.name = "reset_stats",
 		.write_u64 = blkiocg_reset_stats,
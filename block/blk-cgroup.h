@@ -99,6 +99,8 @@ enum blkcg_file_name_prop {
 	BLKIO_PROP_idle_time,
 	BLKIO_PROP_empty_time,
 	BLKIO_PROP_dequeue,
+	BLKIO_PROP_read_latency_target,
+	BLKIO_PROP_read_latency,
 };
 
 /* cgroup files owned by throttle policy */
@@ -111,12 +113,23 @@ enum blkcg_file_name_throtl {
 	BLKIO_THROTL_io_serviced,
 };
 
+/* Read latencies of the groups with a target, in us */
+struct blkio_latency_stats {
+	uint64_t reads;
+	uint64_t total;
+	uint64_t max;
+	uint64_t missed;
+};
+
 struct blkio_cgroup {
 	struct cgroup_subsys_state css;
 	unsigned int weight;
+	/* reads should complete within this many us, 0 for no target */
+	unsigned int read_latency_target;
 	spinlock_t lock;
 	struct hlist_head blkg_list;
 	struct list_head policy_list; /* list of blkio_policy_node */
+	struct blkio_latency_stats read_latency;
 };
 
 struct blkio_group_stats {
@@ -327,6 +340,8 @@ void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 		struct blkio_group *curr_blkg, bool direction, bool sync);
 void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
 					bool direction, bool sync);
+bool blkiocg_update_read_latency(struct blkio_cgroup *blkcg,
+				 unsigned long us);
 #else
 struct cgroup;
 static inline struct blkio_cgroup *
@@ -360,5 +375,7 @@ static inline void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 		struct blkio_group *curr_blkg, bool direction, bool sync) {}
 static inline void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
 						bool direction, bool sync) {}
+static inline bool blkiocg_update_read_latency(struct blkio_cgroup *blkcg,
+					       unsigned long us) { return false; }
 #endif
 #endif /* _BLK_CGROUP_H */
@@ -0,0 +1,475 @@
+/*
+ *  ROW (Read Over Write) i/o scheduler, for flash devices.
+ *
+ *  Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include "blk-cgroup.h"
+
+/*
+ * See Documentation/block/row-iosched.txt
+ */
+static const int writes_starved = 4;	/* max read dispatches before writes */
+static const int write_expire = HZ;	/* max time before a write is dispatched */
+static const int write_batch = 16;	/* writes dispatched in a row */
+
+enum row_queue_type {
+	ROWQ_URGENT,		/* synchronous metadata */
+	ROWQ_READ,
+	ROWQ_SYNC_WRITE,
+	ROWQ_WRITE,
+	ROWQ_MAX,
+};
+
+struct row_queue_stats {
+	unsigned int dispatched;
+	unsigned int completed;
+	u64 total_us;		/* from insertion to completion */
+	unsigned int max_us;
+};
+
+struct row_data {
+	struct request_queue *q;
+
+	/*
+	 * run time data
+	 */
+	struct list_head fifo_list[ROWQ_MAX];
+	unsigned int batching;		/* writes dispatched in this batch */
+	int write_quota;		/* write batch the reads can afford */
+	int starved_batch;		/* the batch was due, don't yield */
+	unsigned int starved;		/* reads dispatched while writes wait */
+	struct row_queue_stats stats[ROWQ_MAX];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int writes_starved;
+	int write_expire;
+	int write_batch;
+	int urgent;
+};
+
+/*
+ * The elevator owns the private fields of the requests it holds: the
+ * first one is the group of a read with a latency target, if any, with
+ * the queue of the request in its low bits, the second one the time
+ * the request was queued.
+ */
+#define ROW_RQ_QUEUE_MASK	3UL
+#define row_rq_queue(rq)	\
+	((unsigned long) (rq)->elv.priv[0] & ROW_RQ_QUEUE_MASK)
+#define row_rq_start_us(rq)	((unsigned long) (rq)->elv.priv[1])
+
+static unsigned long row_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+static enum row_queue_type row_classify(struct row_data *rd,
+					struct request *rq)
+{
+	if (rd->urgent && rq_is_sync(rq) &&
+	    (rq->cmd_flags & (REQ_META | REQ_PRIO)))
+		return ROWQ_URGENT;
+
+	if (rq_data_dir(rq) == READ)
+		return ROWQ_READ;
+
+	return rq_is_sync(rq) ? ROWQ_SYNC_WRITE : ROWQ_WRITE;
+}
+
+static void row_add_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	enum row_queue_type qt = row_classify(rd, rq);
+
+	BUILD_BUG_ON(ROWQ_MAX > ROW_RQ_QUEUE_MASK + 1);
+	rq->elv.priv[0] = (void *) ((unsigned long) rq->elv.priv[0] | qt);
+	rq->elv.priv[1] = (void *) row_now_us();
+
+	/* only writes expire, reads are always served first */
+	rq_set_fifo_time(rq, jiffies + rd->write_expire);
+	list_add_tail(&rq->queuelist, &rd->fifo_list[qt]);
+}
+
+static void
+row_merged_requests(struct request_queue *q, struct request *req,
+		    struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    row_rq_queue(req) == row_rq_queue(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	rq_fifo_clear(next);
+}
+
+#ifdef CONFIG_ROW_GROUP_IOSCHED
+static struct blkio_cgroup *row_rq_blkcg(struct request *rq)
+{
+	return (void *) ((unsigned long) rq->elv.priv[0] & ~ROW_RQ_QUEUE_MASK);
+}
+
+/*
+ * Reads from a group with a latency target hold a reference on the
+ * group until they are freed.
+ */
+static int
+row_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct blkio_cgroup *blkcg;
+
+	rq->elv.priv[0] = NULL;
+	if (rq_data_dir(rq) != READ)
+		return 0;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	if (blkcg && blkcg->read_latency_target && css_tryget(&blkcg->css))
+		rq->elv.priv[0] = blkcg;
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static void row_put_request(struct request *rq)
+{
+	struct blkio_cgroup *blkcg = row_rq_blkcg(rq);
+
+	if (blkcg)
+		css_put(&blkcg->css);
+}
+
+static int row_batch_size(struct row_data *rd)
+{
+	return min(rd->write_batch, rd->write_quota);
+}
+
+/*
+ * The write batches shrink by half each time a read misses the latency
+ * target of its group, and grow back one request at a time while the
+ * targets are met.
+ */
+static void
+row_update_read_latency(struct row_data *rd, struct request *rq,
+			unsigned long us)
+{
+	struct blkio_cgroup *blkcg = row_rq_blkcg(rq);
+
+	if (!blkcg)
+		return;
+
+	if (blkiocg_update_read_latency(blkcg, us))
+		rd->write_quota = max(row_batch_size(rd) / 2, 1);
+	else if (rd->write_quota < rd->write_batch)
+		rd->write_quota++;
+}
+
+#else
+static inline void
+row_update_read_latency(struct row_data *rd, struct request *rq,
+			unsigned long us)
+{
+}
+
+static inline int row_batch_size(struct row_data *rd)
+{
+	return rd->write_batch;
+}
+#endif
+
+static int row_writes_pending(struct row_data *rd)
+{
+	return !list_empty(&rd->fifo_list[ROWQ_SYNC_WRITE]) ||
+	       !list_empty(&rd->fifo_list[ROWQ_WRITE]);
+}
+
+static int row_queue_expired(struct row_data *rd, enum row_queue_type qt)
+{
+	struct request *rq;
+
+	if (list_empty(&rd->fifo_list[qt]))
+		return 0;
+
+	rq = rq_entry_fifo(rd->fifo_list[qt].next);
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Synchronous writes go first, unless the oldest asynchronous one has
+ * been waiting for too long.
+ */
+static enum row_queue_type row_write_queue(struct row_data *rd)
+{
+	if (list_empty(&rd->fifo_list[ROWQ_SYNC_WRITE]) ||
+	    row_queue_expired(rd, ROWQ_WRITE))
+		return ROWQ_WRITE;
+
+	return ROWQ_SYNC_WRITE;
+}
+
+/*
+ * Urgent requests go first, then reads. A write batch starts once
+ * writes_starved reads went ahead of pending writes, when a write
+ * expired or when there is nothing else to do, and dispatches up to
+ * write_batch writes in a row so that the driver can pack them. Reads
+ * only interrupt the batches that were not due.
+ */
+static int row_dispatch_requests(struct request_queue *q, int force)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	const int reads = !list_empty(&rd->fifo_list[ROWQ_READ]);
+	const int writes = row_writes_pending(rd);
+	enum row_queue_type qt;
+	struct request *rq;
+
+	if (!list_empty(&rd->fifo_list[ROWQ_URGENT])) {
+		qt = ROWQ_URGENT;
+		goto dispatch_request;
+	}
+
+	if (writes && rd->batching && rd->batching < row_batch_size(rd) &&
+	    (rd->starved_batch || !reads))
+		goto dispatch_writes;
+	rd->batching = 0;
+
+	if (writes) {
+		if (rd->starved >= rd->writes_starved ||
+		    row_queue_expired(rd, ROWQ_SYNC_WRITE) ||
+		    row_queue_expired(rd, ROWQ_WRITE)) {
+			rd->starved_batch = 1;
+			goto start_batch;
+		}
+		if (!reads) {
+			rd->starved_batch = 0;
+			goto start_batch;
+		}
+	}
+
+	if (reads) {
+		if (writes)
+			rd->starved++;
+		qt = ROWQ_READ;
+		goto dispatch_request;
+	}
+
+	return 0;
+
+start_batch:
+	rd->starved = 0;
+dispatch_writes:
+	rd->batching++;
+	qt = row_write_queue(rd);
+
+dispatch_request:
+	rq = rq_entry_fifo(rd->fifo_list[qt].next);
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(q, rq);
+	rd->stats[qt].dispatched++;
+
+	return 1;
+}
+
+static void row_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	struct row_queue_stats *stats = &rd->stats[row_rq_queue(rq)];
+	unsigned int us = row_now_us() - row_rq_start_us(rq);
+
+	stats->completed++;
+	stats->total_us += us;
+	if (us > stats->max_us)
+		stats->max_us = us;
+
+	row_update_read_latency(rd, rq, us);
+}
+
+static void row_exit_queue(struct elevator_queue *e)
+{
+	struct row_data *rd = e->elevator_data;
+	int i;
+
+	for (i = 0; i < ROWQ_MAX; i++)
+		BUG_ON(!list_empty(&rd->fifo_list[i]));
+
+	kfree(rd);
+}
+
+/*
+ * initialize elevator private data (row_data).
+ */
+static void *row_init_queue(struct request_queue *q)
+{
+	struct row_data *rd;
+	int i;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	rd->q = q;
+	for (i = 0; i < ROWQ_MAX; i++)
+		INIT_LIST_HEAD(&rd->fifo_list[i]);
+	rd->writes_starved = writes_starved;
+	rd->write_expire = write_expire;
+	rd->write_batch = write_batch;
+	rd->write_quota = write_batch;
+	rd->urgent = 1;
+	return rd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+row_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+row_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return row_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(row_writes_starved_show, rd->writes_starved, 0);
+SHOW_FUNCTION(row_write_expire_show, rd->write_expire, 1);
+SHOW_FUNCTION(row_write_batch_show, rd->write_batch, 0);
+SHOW_FUNCTION(row_urgent_show, rd->urgent, 0);
+SHOW_FUNCTION(row_write_quota_show, row_batch_size(rd), 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data;							\
+	int ret = row_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(row_writes_starved_store, &rd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(row_write_expire_store, &rd->write_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(row_write_batch_store, &rd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(row_urgent_store, &rd->urgent, 0, 1, 0);
+#undef STORE_FUNCTION
+
+static ssize_t
+row_stats_show(struct row_data *rd, enum row_queue_type qt, char *page)
+{
+	struct row_queue_stats stats;
+
+	spin_lock_irq(rd->q->queue_lock);
+	stats = rd->stats[qt];
+	spin_unlock_irq(rd->q->queue_lock);
+
+	return sprintf(page, "%u %u %llu %u\n", stats.dispatched,
+		       stats.completed, stats.completed ?
+		       div_u64(stats.total_us, stats.completed) : 0,
+		       stats.max_us);
+}
+
+#define STATS_FUNCTION(__FUNC, __QUEUE)					\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	return row_stats_show(e->elevator_data, __QUEUE, page);		\
+}
+STATS_FUNCTION(row_urgent_stats_show, ROWQ_URGENT);
+STATS_FUNCTION(row_read_stats_show, ROWQ_READ);
+STATS_FUNCTION(row_sync_write_stats_show, ROWQ_SYNC_WRITE);
+STATS_FUNCTION(row_write_stats_show, ROWQ_WRITE);
+#undef STATS_FUNCTION
+
+#define ROW_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
+				      row_##name##_store)
+#define ROW_STATS_ATTR(name) \
+	__ATTR(name##_stats, S_IRUGO, row_##name##_stats_show, NULL)
+
+static struct elv_fs_entry row_attrs[] = {
+	ROW_ATTR(writes_starved),
+	ROW_ATTR(write_expire),
+	ROW_ATTR(write_batch),
+	ROW_ATTR(urgent),
+	__ATTR(write_quota, S_IRUGO, row_write_quota_show, NULL),
+	ROW_STATS_ATTR(urgent),
+	ROW_STATS_ATTR(read),
+	ROW_STATS_ATTR(sync_write),
+	ROW_STATS_ATTR(write),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_row = {
+	.ops = {
+		.elevator_merge_req_fn =	row_merged_requests,
+		.elevator_dispatch_fn =		row_dispatch_requests,
+		.elevator_add_req_fn =		row_add_request,
+		.elevator_completed_req_fn =	row_completed_request,
+#ifdef CONFIG_ROW_GROUP_IOSCHED
+		.elevator_set_req_fn =		row_set_request,
+		.elevator_put_req_fn =		row_put_request,
+#endif
+		.elevator_init_fn =		row_init_queue,
+		.elevator_exit_fn =		row_exit_queue,
+	},
+
+	.elevator_attrs = row_attrs,
+	.elevator_name = "row",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init row_init(void)
+{
+	return elv_register(&iosched_row);
+}
+
+static void __exit row_exit(void)
+{
+	elv_unregister(&iosched_row);
+}
+
+module_init(row_init);
+module_exit(row_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ROW (Read Over Write) IO scheduler");
@@ -54,8 +54,10 @@ struct chksum_desc_ctx {
 };
 
 /*
- * Steps through buffer one byte at at time, calculates reflected
- * crc using table.
+ * The CRC itself is lib/crc32's __crc32c_le(), slice by 8 unless
+ * CONFIG_CRC32_SLICEBY8 was deselected.  It copes with any alignment,
+ * so no alignmask: the shash layer would otherwise bounce unaligned
+ * buffers through a copy first.
  */
 
 static int chksum_init(struct shash_desc *desc)
@@ -147,7 +149,7 @@ static struct shash_alg alg = {
 		.cra_driver_name	=	"crc32c-generic",
 		.cra_priority		=	100,
 		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
-		.cra_alignmask		=	3,
+		.cra_alignmask		=	0,
 		.cra_ctxsize		=	sizeof(struct chksum_ctx),
 		.cra_module		=	THIS_MODULE,
 		.cra_init		=	crc32c_cra_init,
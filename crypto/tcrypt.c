@@ -64,7 +64,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "lz4", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -475,6 +475,34 @@ out:
 	crypto_free_hash(tfm);
 }
 
+/*
+ * Speed test every registered implementation of @algo, to compare the
+ * generic code with arch specific and hardware drivers on a given SoC.
+ */
+static void test_hash_speed_all(const char *algo, unsigned int sec,
+				struct hash_speed *speed)
+{
+	static char names[8][CRYPTO_MAX_ALG_NAME];
+	struct crypto_alg *q;
+	int i, n = 0;
+
+	down_read(&crypto_alg_sem);
+	list_for_each_entry(q, &crypto_alg_list, cra_list) {
+		if (n == ARRAY_SIZE(names))
+			break;
+		if (crypto_is_larval(q) || (q->cra_flags & CRYPTO_ALG_DEAD) ||
+		    strcmp(q->cra_name, algo))
+			continue;
+		strlcpy(names[n++], q->cra_driver_name, CRYPTO_MAX_ALG_NAME);
+	}
+	up_read(&crypto_alg_sem);
+
+	if (!n)
+		printk(KERN_ERR "no implementation of %s registered\n", algo);
+	for (i = 0; i < n; i++)
+		test_hash_speed(names[i], sec, speed);
+}
+
 struct tcrypt_result {
 	struct completion completion;
 	int err;
@@ -1153,6 +1181,10 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4309(ccm(aes))");
 		break;
 
+	case 46:
+		ret += tcrypt_test("lz4");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1414,6 +1446,10 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed_all("crc32c", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -23,13 +23,16 @@
 #include <asm/dma-contiguous.h>
 
 #include <linux/memblock.h>
+#include <linux/debugfs.h>
 #include <linux/err.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/page-isolation.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/mm_types.h>
+#include <linux/seq_file.h>
 #include <linux/dma-contiguous.h>
 
 #ifndef SZ_1M
@@ -40,6 +43,14 @@ struct cma {
 	unsigned long	base_pfn;
 	unsigned long	count;
 	unsigned long	*bitmap;
+
+	/* allocation statistics, protected by cma_mutex */
+	unsigned long	allocs;
+	unsigned long	fails;
+	unsigned long	busy_retries;
+	unsigned long	alloc_pages;
+	u64		alloc_time_ns;
+	u64		alloc_time_max_ns;
 };
 
 struct cma *dma_contiguous_default_area;
@@ -137,6 +148,9 @@ void __init dma_contiguous_reserve(phys_addr_t limit)
 
 static DEFINE_MUTEX(cma_mutex);
 
+static struct cma *cma_areas[MAX_CMA_AREAS];
+static unsigned cma_area_count;
+
 static __init int cma_activate_area(unsigned long base_pfn, unsigned long count)
 {
 	unsigned long pfn = base_pfn;
@@ -168,7 +182,7 @@ static __init struct cma *cma_create_area(unsigned long base_pfn,
 
 	pr_debug("%s(base %08lx, count %lx)\n", __func__, base_pfn, count);
 
-	cma = kmalloc(sizeof *cma, GFP_KERNEL);
+	cma = kzalloc(sizeof *cma, GFP_KERNEL);
 	if (!cma)
 		return ERR_PTR(-ENOMEM);
 
@@ -183,6 +197,8 @@ static __init struct cma *cma_create_area(unsigned long base_pfn,
 	if (ret)
 		goto error;
 
+	cma_areas[cma_area_count++] = cma;
+
 	pr_debug("%s: returned %p\n", __func__, (void *)cma);
 	return cma;
 
@@ -300,6 +316,22 @@ err:
 	return base;
 }
 
+/* Called with cma_mutex held, @start is when the caller came in. */
+static void cma_account(struct cma *cma, int count, ktime_t start, bool ok)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (ok) {
+		cma->allocs++;
+		cma->alloc_pages += count;
+	} else {
+		cma->fails++;
+	}
+	cma->alloc_time_ns += ns;
+	if (ns > cma->alloc_time_max_ns)
+		cma->alloc_time_max_ns = ns;
+}
+
 /**
  * dma_alloc_from_contiguous() - allocate pages from contiguous area
  * @dev:   Pointer to device for which the allocation is performed.
@@ -316,6 +348,7 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 {
 	unsigned long mask, pfn, pageno, start = 0;
 	struct cma *cma = dev_get_cma_area(dev);
+	ktime_t start_time;
 	int ret;
 
 	if (!cma || !cma->count)
@@ -332,6 +365,7 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 
 	mask = (1 << align) - 1;
 
+	start_time = ktime_get();
 	mutex_lock(&cma_mutex);
 
 	for (;;) {
@@ -352,15 +386,18 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 		}
 		pr_debug("%s(): memory range at %p is busy, retrying\n",
 			 __func__, pfn_to_page(pfn));
+		cma->busy_retries++;
 		/* try again with a bit different memory target */
 		start = pageno + mask + 1;
 	}
 
+	cma_account(cma, count, start_time, true);
 	mutex_unlock(&cma_mutex);
 
 	pr_debug("%s(): returned %p\n", __func__, pfn_to_page(pfn));
 	return pfn_to_page(pfn);
 error:
+	cma_account(cma, count, start_time, false);
 	mutex_unlock(&cma_mutex);
 	return NULL;
 }
@@ -400,3 +437,56 @@ bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 
 	return true;
 }
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Every allocation has to migrate whatever movable pages the page
+ * allocator put in the range, the time it takes is what the users of an
+ * area pay for not having a carveout.
+ */
+static int cma_stats_show(struct seq_file *s, void *unused)
+{
+	unsigned i;
+
+	seq_printf(s, "%-10s %8s %8s %8s %8s %8s %10s %10s %10s\n",
+		   "base", "pages", "used", "allocs", "fails", "retries",
+		   "allocated", "avg_us", "max_us");
+
+	mutex_lock(&cma_mutex);
+	for (i = 0; i < cma_area_count; i++) {
+		struct cma *cma = cma_areas[i];
+		u32 calls = cma->allocs + cma->fails;
+		u64 avg = calls ? div_u64(cma->alloc_time_ns, calls) : 0;
+
+		seq_printf(s, "0x%08lx %8lu %8d %8lu %8lu %8lu %10lu "
+			   "%10llu %10llu\n",
+			   (unsigned long)PFN_PHYS(cma->base_pfn), cma->count,
+			   bitmap_weight(cma->bitmap, cma->count),
+			   cma->allocs, cma->fails, cma->busy_retries,
+			   cma->alloc_pages, div_u64(avg, NSEC_PER_USEC),
+			   div_u64(cma->alloc_time_max_ns, NSEC_PER_USEC));
+	}
+	mutex_unlock(&cma_mutex);
+
+	return 0;
+}
+
+static int cma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_stats_show, inode->i_private);
+}
+
+static const struct file_operations cma_stats_fops = {
+	.open = cma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init cma_debugfs_init(void)
+{
+	debugfs_create_file("cma", 0444, NULL, NULL, &cma_stats_fops);
+	return 0;
+}
+late_initcall(cma_debugfs_init);
+#endif
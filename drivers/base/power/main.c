@@ -29,6 +29,7 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/wakelock.h>
 
 #include "../base.h"
 #include "power.h"
@@ -570,6 +571,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t calltime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -631,7 +633,10 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
 
  End:
+	calltime = ktime_get();
 	error = dpm_run_callback(callback, dev, state, info);
+	if (callback && state.event == PM_EVENT_RESUME)
+		suspend_time_device_resumed(dev, calltime);
 	dev->power.is_suspended = false;
 
  Unlock:
@@ -735,6 +740,8 @@ void dpm_resume(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+	if (state.event == PM_EVENT_RESUME)
+		suspend_time_resume_done();
 }
 
 /**
@@ -1070,7 +1077,13 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	if (pm_runtime_barrier(dev) && device_may_wakeup(dev))
 		pm_wakeup_event(dev, 0);
 
-	if (pm_wakeup_pending()) {
+	/*
+	 * A suspend wake lock taken now would only make the "power" device
+	 * fail suspend_noirq, after every other device has been suspended
+	 * and before all of them are resumed again.  Give up right away.
+	 */
+	if (pm_wakeup_pending() || (state.event == PM_EVENT_SUSPEND &&
+				    has_wake_lock(WAKE_LOCK_SUSPEND))) {
 		async_error = -EBUSY;
 		goto Complete;
 	}
@@ -2,8 +2,32 @@
 
 #ifdef CONFIG_PM_RUNTIME
 
+#define PM_AUTOSUSPEND_BINS	16
+
+/*
+ * Idle gaps, from power.last_busy to the next resume request, of a device
+ * whose autosuspend delay is tuned by the PM core.  gaps[i] counts the gaps
+ * of [2^(i-1), 2^i) ms, gaps[0] those under 1 ms.  Protected by power.lock.
+ */
+struct pm_autosuspend_stats {
+	bool		adaptive;
+	int		min_delay;		/* ms */
+	int		max_delay;		/* ms */
+	unsigned long	sampled_busy;		/* last_busy of the last gap */
+	unsigned int	gaps[PM_AUTOSUSPEND_BINS];
+	unsigned int	window;			/* gaps since the last tuning */
+	unsigned long	covered;		/* gaps the delay bridged */
+	unsigned long	suspended;		/* gaps that cost a suspend */
+	unsigned long	short_suspends;		/* ... undone within min_delay */
+	unsigned long	adjustments;
+	unsigned long	resumes;
+	u64		resume_ns;
+	u64		resume_max_ns;
+};
+
 extern void pm_runtime_init(struct device *dev);
 extern void pm_runtime_remove(struct device *dev);
+extern int pm_runtime_autosuspend_adaptive(struct device *dev, bool enable);
 
 #else /* !CONFIG_PM_RUNTIME */
 
@@ -9,7 +9,10 @@
 
 #include <linux/sched.h>
 #include <linux/export.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/pm_runtime.h>
+#include <linux/slab.h>
 #include <trace/events/rpm.h>
 #include "power.h"
 
@@ -124,6 +127,109 @@ unsigned long pm_runtime_autosuspend_expiration(struct device *dev)
 }
 EXPORT_SYMBOL_GPL(pm_runtime_autosuspend_expiration);
 
+/*
+ * Adaptive autosuspend: every PM_AUTOSUSPEND_WINDOW idle gaps, the delay is
+ * set, within the bounds given by the driver, to the value that would have
+ * cost the least over the recent gaps.  A gap shorter than the delay costs
+ * its length in time spent active and idle; a longer one costs the delay
+ * plus a suspend/resume cycle, counted as min_delay plus the average resume
+ * time.  Older gaps are then halved, so the tuning follows changes in the
+ * usage pattern.
+ */
+#define PM_AUTOSUSPEND_WINDOW	32
+
+static unsigned int rpm_gap_mid(unsigned int bin)
+{
+	return bin ? (3 << bin) / 4 : 0;
+}
+
+static u64 rpm_autosuspend_cost(struct pm_autosuspend_stats *st,
+				unsigned int delay, unsigned int penalty)
+{
+	u64 cost = 0;
+	unsigned int i, mid;
+
+	for (i = 0; i < PM_AUTOSUSPEND_BINS; i++) {
+		mid = rpm_gap_mid(i);
+		if (mid < delay)
+			cost += (u64)st->gaps[i] * mid;
+		else
+			cost += (u64)st->gaps[i] * (delay + penalty);
+	}
+
+	return cost;
+}
+
+static void rpm_autosuspend_tune(struct device *dev,
+				 struct pm_autosuspend_stats *st)
+{
+	unsigned int delay, best = st->max_delay, penalty = st->min_delay;
+	u64 cost, best_cost = ULLONG_MAX;
+
+	if (st->resumes)
+		penalty += div_u64(div_u64(st->resume_ns, st->resumes),
+				   NSEC_PER_MSEC);
+
+	/* min_delay, the powers of two in between, max_delay */
+	for (delay = st->min_delay; ; delay = min_t(unsigned int,
+			st->max_delay, roundup_pow_of_two(delay + 1))) {
+		cost = rpm_autosuspend_cost(st, delay, penalty);
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = delay;
+		}
+		if (delay >= st->max_delay)
+			break;
+	}
+
+	if (best != dev->power.autosuspend_delay) {
+		dev->power.autosuspend_delay = best;
+		st->adjustments++;
+	}
+}
+
+/*
+ * Account the idle gap ending with this resume request, once per
+ * power.last_busy.  Called from rpm_resume() with power.lock held.
+ */
+static void rpm_autosuspend_sample(struct device *dev)
+{
+	struct pm_autosuspend_stats *st = dev->power.autosuspend_stats;
+	unsigned long last_busy = dev->power.last_busy;
+	unsigned int ms, i;
+
+	if (!st || !dev->power.use_autosuspend || last_busy == st->sampled_busy)
+		return;
+
+	if (dev->power.runtime_status == RPM_ACTIVE) {
+		/* only a gap if the autosuspend timer is running */
+		if (!dev->power.timer_expires)
+			return;
+		st->covered++;
+	} else if (dev->power.runtime_status == RPM_SUSPENDED) {
+		st->suspended++;
+	} else {
+		return;
+	}
+
+	st->sampled_busy = last_busy;
+	ms = jiffies_to_msecs(jiffies - last_busy);
+	if (dev->power.runtime_status == RPM_SUSPENDED &&
+	    ms < dev->power.autosuspend_delay + st->min_delay)
+		st->short_suspends++;
+	st->gaps[ms ? min(fls(ms), PM_AUTOSUSPEND_BINS - 1) : 0]++;
+
+	if (++st->window < PM_AUTOSUSPEND_WINDOW)
+		return;
+	st->window = 0;
+
+	if (st->adaptive && dev->power.autosuspend_delay >= 0)
+		rpm_autosuspend_tune(dev, st);
+
+	for (i = 0; i < PM_AUTOSUSPEND_BINS; i++)
+		st->gaps[i] -= st->gaps[i] / 2;
+}
+
 /**
  * rpm_check_suspend_allowed - Test whether a device may be suspended.
  * @dev: Device to test.
@@ -573,7 +679,9 @@ static int rpm_resume(struct device *dev, int rpmflags)
 	__releases(&dev->power.lock) __acquires(&dev->power.lock)
 {
 	int (*callback)(struct device *);
+	struct pm_autosuspend_stats *st;
 	struct device *parent = NULL;
+	u64 start = 0;
 	int retval = 0;
 
 	trace_rpm_resume(dev, rpmflags);
@@ -599,6 +707,8 @@ static int rpm_resume(struct device *dev, int rpmflags)
 	if (!dev->power.timer_autosuspends)
 		pm_runtime_deactivate_timer(dev);
 
+	rpm_autosuspend_sample(dev);
+
 	if (dev->power.runtime_status == RPM_ACTIVE) {
 		retval = 1;
 		goto out;
@@ -727,7 +837,18 @@ static int rpm_resume(struct device *dev, int rpmflags)
 	if (!callback && dev->driver && dev->driver->pm)
 		callback = dev->driver->pm->runtime_resume;
 
+	st = dev->power.autosuspend_stats;
+	if (st)
+		start = ktime_to_ns(ktime_get());
+
 	retval = rpm_callback(callback, dev);
+	if (st && !retval) {
+		start = ktime_to_ns(ktime_get()) - start;
+		st->resumes++;
+		st->resume_ns += start;
+		if (start > st->resume_max_ns)
+			st->resume_max_ns = start;
+	}
 	if (retval) {
 		__update_runtime_status(dev, RPM_SUSPENDED);
 		pm_runtime_cancel_pending(dev);
@@ -1324,6 +1445,69 @@ void pm_runtime_set_autosuspend_delay(struct device *dev, int delay)
 }
 EXPORT_SYMBOL_GPL(pm_runtime_set_autosuspend_delay);
 
+/**
+ * pm_runtime_set_autosuspend_bounds - Let the PM core tune autosuspend_delay.
+ * @dev: Device to handle.
+ * @min_delay: Shortest autosuspend delay to use, in milliseconds.
+ * @max_delay: Longest autosuspend delay to use, in milliseconds.
+ *
+ * Record the device's idle gaps and periodically retune its
+ * power.autosuspend_delay between @min_delay and @max_delay (see
+ * rpm_autosuspend_tune()).  @min_delay is also what one suspend/resume
+ * cycle of the device is assumed to be worth in idle time, so it should be
+ * the shortest delay that is worth suspending for.  The value set with
+ * pm_runtime_set_autosuspend_delay() is used until enough gaps are known.
+ */
+int pm_runtime_set_autosuspend_bounds(struct device *dev, int min_delay,
+				      int max_delay)
+{
+	struct pm_autosuspend_stats *new = NULL;
+
+	if (min_delay < 0 || max_delay < min_delay)
+		return -EINVAL;
+
+	if (!dev->power.autosuspend_stats) {
+		new = kzalloc(sizeof(*new), GFP_KERNEL);
+		if (!new)
+			return -ENOMEM;
+	}
+
+	spin_lock_irq(&dev->power.lock);
+	if (!dev->power.autosuspend_stats) {
+		dev->power.autosuspend_stats = new;
+		new = NULL;
+	}
+	dev->power.autosuspend_stats->min_delay = min_delay;
+	dev->power.autosuspend_stats->max_delay = max_delay;
+	dev->power.autosuspend_stats->adaptive = true;
+	spin_unlock_irq(&dev->power.lock);
+
+	kfree(new);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(pm_runtime_set_autosuspend_bounds);
+
+/**
+ * pm_runtime_autosuspend_adaptive - Turn autosuspend_delay tuning on or off.
+ * @dev: Device to handle.
+ * @enable: Whether the PM core may change power.autosuspend_delay.
+ *
+ * Return -EIO if the driver did not set bounds for the delay.
+ */
+int pm_runtime_autosuspend_adaptive(struct device *dev, bool enable)
+{
+	int ret = 0;
+
+	spin_lock_irq(&dev->power.lock);
+	if (dev->power.autosuspend_stats)
+		dev->power.autosuspend_stats->adaptive = enable;
+	else
+		ret = -EIO;
+	spin_unlock_irq(&dev->power.lock);
+
+	return ret;
+}
+
 /**
  * __pm_runtime_use_autosuspend - Set a device's use_autosuspend flag.
  * @dev: Device to handle.
@@ -1385,6 +1569,8 @@ void pm_runtime_init(struct device *dev)
  */
 void pm_runtime_remove(struct device *dev)
 {
+	struct pm_autosuspend_stats *st;
+
 	__pm_runtime_disable(dev, false);
 
 	/* Change the status back to 'suspended' to match the initial status. */
@@ -1392,6 +1578,12 @@ void pm_runtime_remove(struct device *dev)
 		pm_runtime_set_suspended(dev);
 	if (dev->power.irq_safe && dev->parent)
 		pm_runtime_put_sync(dev->parent);
+
+	spin_lock_irq(&dev->power.lock);
+	st = dev->power.autosuspend_stats;
+	dev->power.autosuspend_stats = NULL;
+	spin_unlock_irq(&dev->power.lock);
+	kfree(st);
 }
 
 /**
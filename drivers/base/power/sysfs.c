@@ -9,6 +9,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/atomic.h>
 #include <linux/jiffies.h>
+#include <linux/math64.h>
 #include "power.h"
 
 /*
@@ -218,6 +219,66 @@ static ssize_t autosuspend_delay_ms_store(struct device *dev,
 static DEVICE_ATTR(autosuspend_delay_ms, 0644, autosuspend_delay_ms_show,
 		autosuspend_delay_ms_store);
 
+static ssize_t autosuspend_adaptive_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct pm_autosuspend_stats *st = dev->power.autosuspend_stats;
+
+	if (!st)
+		return -EIO;
+	return sprintf(buf, "%d\n", st->adaptive);
+}
+
+static ssize_t autosuspend_adaptive_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t n)
+{
+	bool enable;
+	int ret;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+
+	ret = pm_runtime_autosuspend_adaptive(dev, enable);
+	return ret ? ret : n;
+}
+
+static DEVICE_ATTR(autosuspend_adaptive, 0644, autosuspend_adaptive_show,
+		autosuspend_adaptive_store);
+
+static ssize_t autosuspend_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct pm_autosuspend_stats *st;
+	char *p = buf;
+	int i;
+
+	spin_lock_irq(&dev->power.lock);
+	st = dev->power.autosuspend_stats;
+	if (!st) {
+		spin_unlock_irq(&dev->power.lock);
+		return -EIO;
+	}
+
+	p += sprintf(p, "bounds_ms: %d %d\n", st->min_delay, st->max_delay);
+	p += sprintf(p, "covered: %lu\nsuspended: %lu\nshort_suspends: %lu\n",
+		     st->covered, st->suspended, st->short_suspends);
+	p += sprintf(p, "adjustments: %lu\n", st->adjustments);
+	p += sprintf(p, "resumes: %lu\nresume_avg_us: %llu\n"
+		     "resume_max_us: %llu\n", st->resumes,
+		     st->resumes ? div_u64(div_u64(st->resume_ns, st->resumes),
+					   NSEC_PER_USEC) : 0,
+		     div_u64(st->resume_max_ns, NSEC_PER_USEC));
+	p += sprintf(p, "gaps_ms:");
+	for (i = 0; i < PM_AUTOSUSPEND_BINS; i++)
+		p += sprintf(p, " %u", st->gaps[i]);
+	p += sprintf(p, "\n");
+	spin_unlock_irq(&dev->power.lock);
+
+	return p - buf;
+}
+
+static DEVICE_ATTR(autosuspend_stats, 0444, autosuspend_stats_show, NULL);
+
 static ssize_t pm_qos_latency_show(struct device *dev,
 				   struct device_attribute *attr, char *buf)
 {
@@ -508,6 +569,8 @@ static struct attribute *runtime_attrs[] = {
 	&dev_attr_runtime_suspended_time.attr,
 	&dev_attr_runtime_active_time.attr,
 	&dev_attr_autosuspend_delay_ms.attr,
+	&dev_attr_autosuspend_adaptive.attr,
+	&dev_attr_autosuspend_stats.attr,
 #endif /* CONFIG_PM_RUNTIME */
 	NULL,
 };
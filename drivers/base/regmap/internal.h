@@ -77,6 +77,10 @@ struct regmap {
 	void *cache;
 	u32 cache_dirty;
 
+	/* cached reads, and non-volatile reads that had to go to the HW */
+	u32 cache_hits;
+	u32 cache_misses;
+
 	struct reg_default *patch;
 	int patch_regs;
 };
@@ -98,6 +102,8 @@ bool regmap_precious(struct regmap *map, unsigned int reg);
 
 int _regmap_write(struct regmap *map, unsigned int reg,
 		  unsigned int val);
+int _regmap_raw_write(struct regmap *map, unsigned int reg,
+		      const void *val, size_t val_len);
 
 #ifdef CONFIG_DEBUG_FS
 extern void regmap_debugfs_initcall(void);
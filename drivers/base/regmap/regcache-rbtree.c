@@ -364,16 +364,79 @@ static int regcache_rbtree_write(struct regmap *map, unsigned int reg,
 	return 0;
 }
 
+static int regcache_rbtree_sync_block(struct regmap *map,
+				      struct regcache_rbtree_node *rbnode,
+				      unsigned int start, unsigned int end)
+{
+	size_t val_bytes = map->format.val_bytes;
+	unsigned int i, val;
+	void *buf = NULL;
+	int ret = 0;
+
+	/*
+	 * Write a run of adjacent registers in one bus transfer when the
+	 * format allows raw writes, rather than one transfer each.
+	 */
+	if (end - start > 1 && !map->format.format_write)
+		buf = kmalloc((end - start) * val_bytes, GFP_KERNEL);
+
+	if (buf) {
+		for (i = start; i < end; i++) {
+			val = regcache_rbtree_get_register(rbnode, i,
+						map->cache_word_size);
+			map->format.format_val(buf + (i - start) * val_bytes,
+					       val);
+		}
+
+		map->cache_bypass = 1;
+		ret = _regmap_raw_write(map, rbnode->base_reg + start, buf,
+					(end - start) * val_bytes);
+		map->cache_bypass = 0;
+		kfree(buf);
+		if (ret == 0)
+			dev_dbg(map->dev, "Synced registers %#x-%#x\n",
+				rbnode->base_reg + start,
+				rbnode->base_reg + end - 1);
+		return ret;
+	}
+
+	for (i = start; i < end; i++) {
+		val = regcache_rbtree_get_register(rbnode, i,
+						   map->cache_word_size);
+		map->cache_bypass = 1;
+		ret = _regmap_write(map, rbnode->base_reg + i, val);
+		map->cache_bypass = 0;
+		if (ret)
+			return ret;
+		dev_dbg(map->dev, "Synced register %#x, value %#x\n",
+			rbnode->base_reg + i, val);
+	}
+
+	return 0;
+}
+
+static bool regcache_rbtree_sync_skip(struct regmap *map, unsigned int reg,
+				      unsigned int val)
+{
+	int ret;
+
+	/* Is this the hardware default?  If so skip. */
+	ret = regcache_lookup_reg(map, reg);
+	if (ret >= 0 && val == map->reg_defaults[ret].def)
+		return true;
+
+	return !regmap_writeable(map, reg);
+}
+
 static int regcache_rbtree_sync(struct regmap *map, unsigned int min,
 				unsigned int max)
 {
 	struct regcache_rbtree_ctx *rbtree_ctx;
 	struct rb_node *node;
 	struct regcache_rbtree_node *rbnode;
-	unsigned int regtmp;
 	unsigned int val;
 	int ret;
-	int i, base, end;
+	int i, base, end, start;
 
 	rbtree_ctx = map->cache;
 	for (node = rb_first(&rbtree_ctx->root); node; node = rb_next(node)) {
@@ -396,23 +459,31 @@ static int regcache_rbtree_sync(struct regmap *map, unsigned int min,
 		else
 			end = rbnode->blklen;
 
-		for (i = base; i < end; i++) {
-			regtmp = rbnode->base_reg + i;
-			val = regcache_rbtree_get_register(rbnode, i,
-							   map->cache_word_size);
+		/* start of the pending run of registers to write, or -1 */
+		start = -1;
+		for (i = base; i <= end; i++) {
+			bool skip = true;
+
+			if (i < end) {
+				val = regcache_rbtree_get_register(rbnode, i,
+						map->cache_word_size);
+				skip = regcache_rbtree_sync_skip(map,
+						rbnode->base_reg + i, val);
+			}
 
-			/* Is this the hardware default?  If so skip. */
-			ret = regcache_lookup_reg(map, regtmp);
-			if (ret >= 0 && val == map->reg_defaults[ret].def)
+			if (!skip) {
+				if (start < 0)
+					start = i;
 				continue;
+			}
 
-			map->cache_bypass = 1;
-			ret = _regmap_write(map, regtmp, val);
-			map->cache_bypass = 0;
-			if (ret)
-				return ret;
-			dev_dbg(map->dev, "Synced register %#x, value %#x\n",
-				regtmp, val);
+			if (start >= 0) {
+				ret = regcache_rbtree_sync_block(map, rbnode,
+								 start, i);
+				if (ret)
+					return ret;
+				start = -1;
+			}
 		}
 	}
 
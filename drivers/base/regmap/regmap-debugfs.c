@@ -268,6 +268,10 @@ void regmap_debugfs_init(struct regmap *map)
 				    &map->cache_dirty);
 		debugfs_create_bool("cache_bypass", 0400, map->debugfs,
 				    &map->cache_bypass);
+		debugfs_create_u32("cache_hits", 0400, map->debugfs,
+				   &map->cache_hits);
+		debugfs_create_u32("cache_misses", 0400, map->debugfs,
+				   &map->cache_misses);
 	}
 }
 
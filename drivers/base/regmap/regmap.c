@@ -383,6 +383,7 @@ int regmap_reinit_cache(struct regmap *map, const struct regmap_config *config)
 
 	return ret;
 }
+EXPORT_SYMBOL_GPL(regmap_reinit_cache);
 
 /**
  * regmap_exit(): Free a previously allocated register map
@@ -396,8 +397,8 @@ void regmap_exit(struct regmap *map)
 }
 EXPORT_SYMBOL_GPL(regmap_exit);
 
-static int _regmap_raw_write(struct regmap *map, unsigned int reg,
-			     const void *val, size_t val_len)
+int _regmap_raw_write(struct regmap *map, unsigned int reg,
+		      const void *val, size_t val_len)
 {
 	u8 *u8 = map->work_buf;
 	void *buf;
@@ -656,8 +657,12 @@ static int _regmap_read(struct regmap *map, unsigned int reg,
 
 	if (!map->cache_bypass) {
 		ret = regcache_read(map, reg, val);
-		if (ret == 0)
+		if (ret == 0) {
+			map->cache_hits++;
 			return 0;
+		}
+		if (!regmap_volatile(map, reg))
+			map->cache_misses++;
 	}
 
 	if (!map->format.parse_val)
@@ -41,6 +41,9 @@
 #include <linux/miscdevice.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/random.h>
 #include <asm/uaccess.h>
 
 
@@ -53,7 +56,13 @@ static struct hwrng *current_rng;
 static LIST_HEAD(rng_list);
 static DEFINE_MUTEX(rng_mutex);
 static int data_avail;
-static u8 *rng_buffer;
+static u8 *rng_buffer, *rng_fillbuf;
+static struct task_struct *hwrng_fill;
+
+static unsigned short default_quality; /* = 0; default to "off" */
+module_param(default_quality, ushort, 0644);
+MODULE_PARM_DESC(default_quality,
+		 "default entropy content of hwrng per mill, for RNGs that don't say");
 
 static size_t rng_buffer_size(void)
 {
@@ -62,6 +71,8 @@ static size_t rng_buffer_size(void)
 
 static inline int hwrng_init(struct hwrng *rng)
 {
+	if (hwrng_fill)
+		wake_up_process(hwrng_fill);
 	if (!rng->init)
 		return 0;
 	return rng->init(rng);
@@ -101,6 +112,64 @@ static inline int rng_get_data(struct hwrng *rng, u8 *buffer, size_t size,
 	return 0;
 }
 
+static inline unsigned int rng_quality(struct hwrng *rng)
+{
+	return min_t(unsigned int, rng->quality ? : default_quality, 1000);
+}
+
+/*
+ * Feed the input pool from the current RNG.  add_hwgenerator_randomness()
+ * holds us off while the pool is full enough, so the rate follows the
+ * pool's entropy level: flat out while readers of /dev/random are
+ * starved, at the rate entropy is drawn afterwards.  RNGs whose quality
+ * is unknown are not used.
+ */
+static int hwrng_fillfn(void *unused)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned int quality;
+		int rc;
+
+		try_to_freeze();
+
+		mutex_lock(&rng_mutex);
+		if (!current_rng || !rng_quality(current_rng)) {
+			set_current_state(TASK_INTERRUPTIBLE);
+			mutex_unlock(&rng_mutex);
+			if (!kthread_should_stop())
+				schedule();
+			__set_current_state(TASK_RUNNING);
+			continue;
+		}
+		quality = rng_quality(current_rng);
+		rc = rng_get_data(current_rng, rng_fillbuf,
+				  rng_buffer_size(), 1);
+		mutex_unlock(&rng_mutex);
+
+		if (rc <= 0) {
+			pr_warn(PFX "no data available\n");
+			schedule_timeout_interruptible(10 * HZ);
+			continue;
+		}
+
+		add_hwgenerator_randomness((void *)rng_fillbuf, rc,
+					   rc * 8 * quality / 1000);
+	}
+
+	return 0;
+}
+
+static void start_khwrngd(void)
+{
+	hwrng_fill = kthread_run(hwrng_fillfn, NULL, "hwrng");
+	if (IS_ERR(hwrng_fill)) {
+		pr_err(PFX "hwrng_fill thread creation failed\n");
+		hwrng_fill = NULL;
+	}
+}
+
 static ssize_t rng_dev_read(struct file *filp, char __user *buf,
 			    size_t size, loff_t *offp)
 {
@@ -319,6 +388,11 @@ int hwrng_register(struct hwrng *rng)
 		if (!rng_buffer)
 			goto out_unlock;
 	}
+	if (!rng_fillbuf) {
+		rng_fillbuf = kmalloc(rng_buffer_size(), GFP_KERNEL);
+		if (!rng_fillbuf)
+			goto out_unlock;
+	}
 
 	/* Must not register two RNGs with the same name. */
 	err = -EEXIST;
@@ -348,6 +422,9 @@ int hwrng_register(struct hwrng *rng)
 	}
 	INIT_LIST_HEAD(&rng->list);
 	list_add_tail(&rng->list, &rng_list);
+
+	if (!hwrng_fill)
+		start_khwrngd();
 out_unlock:
 	mutex_unlock(&rng_mutex);
 out:
@@ -357,6 +434,7 @@ EXPORT_SYMBOL_GPL(hwrng_register);
 
 void hwrng_unregister(struct hwrng *rng)
 {
+	struct task_struct *fill = NULL;
 	int err;
 
 	mutex_lock(&rng_mutex);
@@ -373,10 +451,17 @@ void hwrng_unregister(struct hwrng *rng)
 				current_rng = NULL;
 		}
 	}
-	if (list_empty(&rng_list))
+	if (list_empty(&rng_list)) {
 		unregister_miscdev();
+		fill = hwrng_fill;
+		hwrng_fill = NULL;
+	}
 
 	mutex_unlock(&rng_mutex);
+
+	/* outside rng_mutex, which the thread takes */
+	if (fill)
+		kthread_stop(fill);
 }
 EXPORT_SYMBOL_GPL(hwrng_unregister);
 
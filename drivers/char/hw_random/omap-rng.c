@@ -23,6 +23,7 @@
 #include <linux/platform_device.h>
 #include <linux/hw_random.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
 
 #include <asm/io.h>
 
@@ -46,9 +47,42 @@
 #define RNG_SYSSTATUS		0x44		/* System status
 							[0] = RESETDONE */
 
+/*
+ * OMAP4 and OMAP5 have a different module: a set of free running
+ * oscillators (FROs) feeding a post processor, which hands out 64 bits
+ * at a time.  FROs that get locked onto each other are detected and
+ * shut down; too many of them raise an interrupt.
+ */
+#define RNG_OUTPUT_L_REG	0x00
+#define RNG_OUTPUT_H_REG	0x04
+#define RNG_STATUS_REG		0x08
+#define RNG_INTMASK_REG		0x0c
+#define RNG_INTACK_REG		0x10
+#define RNG_CONTROL_REG		0x14
+#define RNG_CONFIG_REG_4	0x18
+#define RNG_ALARMCNT_REG	0x1c
+#define RNG_FROENABLE_REG	0x20
+#define RNG_FRODETUNE_REG	0x24
+#define RNG_ALARMMASK_REG	0x28
+#define RNG_ALARMSTOP_REG	0x2c
+#define RNG_REV_REG_4		0x1fe0
+#define RNG_SYSCONFIG_REG_4	0x1fe4
+
+#define RNG_STATUS_READY		(1 << 0)
+#define RNG_STATUS_SHUTDOWN_OFLO	(1 << 1)
+#define RNG_CONTROL_ENABLE_TRNG		(1 << 10)
+#define RNG_CONTROL_STARTUP_CYCLES	(0xff << 16)
+#define RNG_CONFIG_MIN_REFIL_CYCLES	(0x21 << 0)
+#define RNG_CONFIG_MAX_REFIL_CYCLES	(0x22 << 16)
+#define RNG_ALARMCNT_ALARM_THRESHOLD	(0xff << 0)
+#define RNG_ALARMCNT_SHUTDOWN_THRESHOLD	(0x4 << 16)
+#define RNG_FRO_MASK			0xffffff
+#define RNG_SYSCONFIG_AUTOIDLE		(1 << 0)
+
 static void __iomem *rng_base;
 static struct clk *rng_ick;
 static struct platform_device *rng_dev;
+static int rng_irq = -1;
 
 static inline u32 omap_rng_read_reg(int reg)
 {
@@ -91,6 +125,123 @@ static struct hwrng omap_rng_ops = {
 	.data_read	= omap_rng_data_read,
 };
 
+static int omap4_rng_data_ready(bool wait)
+{
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		if (omap_rng_read_reg(RNG_STATUS_REG) & RNG_STATUS_READY)
+			return 1;
+		if (!wait)
+			break;
+		/* a refill takes at most MAX_REFIL_CYCLES * 256 FRO samples */
+		udelay(10);
+	}
+	return 0;
+}
+
+static int omap4_rng_read(struct hwrng *rng, void *data, size_t max,
+			  bool wait)
+{
+	u32 *buf = data;
+	size_t len = 0;
+
+	while (max - len >= 8) {
+		/* only wait for the first word, return what's there after */
+		if (!omap4_rng_data_ready(wait && !len))
+			break;
+		*buf++ = omap_rng_read_reg(RNG_OUTPUT_L_REG);
+		*buf++ = omap_rng_read_reg(RNG_OUTPUT_H_REG);
+		omap_rng_write_reg(RNG_INTACK_REG, RNG_STATUS_READY);
+		len += 8;
+	}
+
+	return len;
+}
+
+/*
+ * The post processor output is whitened but not otherwise vouched for;
+ * only credit half of it to the input pool.
+ */
+static struct hwrng omap4_rng_ops = {
+	.name		= "omap4",
+	.read		= omap4_rng_read,
+	.quality	= 500,
+};
+
+static void omap4_rng_enable(void)
+{
+	/* the boot loader or ROM code may have started it already */
+	if (omap_rng_read_reg(RNG_CONTROL_REG) & RNG_CONTROL_ENABLE_TRNG)
+		return;
+
+	omap_rng_write_reg(RNG_CONFIG_REG_4, RNG_CONFIG_MIN_REFIL_CYCLES |
+			   RNG_CONFIG_MAX_REFIL_CYCLES);
+	omap_rng_write_reg(RNG_ALARMCNT_REG, RNG_ALARMCNT_ALARM_THRESHOLD |
+			   RNG_ALARMCNT_SHUTDOWN_THRESHOLD);
+	omap_rng_write_reg(RNG_FRODETUNE_REG, 0);
+	omap_rng_write_reg(RNG_FROENABLE_REG, RNG_FRO_MASK);
+	omap_rng_write_reg(RNG_SYSCONFIG_REG_4, RNG_SYSCONFIG_AUTOIDLE);
+	if (rng_irq >= 0)
+		omap_rng_write_reg(RNG_INTMASK_REG, RNG_STATUS_SHUTDOWN_OFLO);
+	omap_rng_write_reg(RNG_CONTROL_REG, RNG_CONTROL_STARTUP_CYCLES |
+			   RNG_CONTROL_ENABLE_TRNG);
+}
+
+static void omap4_rng_disable(void)
+{
+	omap_rng_write_reg(RNG_INTMASK_REG, 0);
+	omap_rng_write_reg(RNG_CONTROL_REG, 0);
+}
+
+/*
+ * Too many FROs were shut down: detune the ones that were, so they no
+ * longer lock onto their neighbours, and turn them all back on.
+ */
+static irqreturn_t omap4_rng_irq(int irq, void *dev_id)
+{
+	u32 enabled, detune;
+
+	omap_rng_write_reg(RNG_ALARMMASK_REG, 0);
+	omap_rng_write_reg(RNG_ALARMSTOP_REG, 0);
+
+	enabled = omap_rng_read_reg(RNG_FROENABLE_REG);
+	detune = omap_rng_read_reg(RNG_FRODETUNE_REG);
+	detune |= ~enabled & RNG_FRO_MASK;
+	omap_rng_write_reg(RNG_FRODETUNE_REG, detune);
+	omap_rng_write_reg(RNG_FROENABLE_REG, RNG_FRO_MASK);
+
+	omap_rng_write_reg(RNG_INTACK_REG, RNG_STATUS_SHUTDOWN_OFLO);
+
+	return IRQ_HANDLED;
+}
+
+static inline bool omap_rng_is_omap4(void)
+{
+	return cpu_is_omap44xx() || cpu_is_omap54xx();
+}
+
+static inline struct hwrng *omap_rng_hwrng(void)
+{
+	return omap_rng_is_omap4() ? &omap4_rng_ops : &omap_rng_ops;
+}
+
+static void omap_rng_enable(void)
+{
+	if (omap_rng_is_omap4())
+		omap4_rng_enable();
+	else
+		omap_rng_write_reg(RNG_MASK_REG, 0x1);
+}
+
+static void omap_rng_disable(void)
+{
+	if (omap_rng_is_omap4())
+		omap4_rng_disable();
+	else
+		omap_rng_write_reg(RNG_MASK_REG, 0x0);
+}
+
 static int __devinit omap_rng_probe(struct platform_device *pdev)
 {
 	struct resource *res;
@@ -103,7 +254,7 @@ static int __devinit omap_rng_probe(struct platform_device *pdev)
 	if (rng_dev)
 		return -EBUSY;
 
-	if (cpu_is_omap24xx()) {
+	if (cpu_is_omap24xx() || omap_rng_is_omap4()) {
 		rng_ick = clk_get(&pdev->dev, "ick");
 		if (IS_ERR(rng_ick)) {
 			dev_err(&pdev->dev, "Could not get rng_ick\n");
@@ -132,25 +283,44 @@ static int __devinit omap_rng_probe(struct platform_device *pdev)
 		goto err_ioremap;
 	}
 
-	ret = hwrng_register(&omap_rng_ops);
+	if (omap_rng_is_omap4()) {
+		rng_irq = platform_get_irq(pdev, 0);
+		if (rng_irq >= 0) {
+			ret = request_irq(rng_irq, omap4_rng_irq, 0,
+					  dev_name(&pdev->dev), NULL);
+			if (ret) {
+				dev_warn(&pdev->dev, "no FRO alarm irq: %d\n",
+					 ret);
+				rng_irq = -1;
+			}
+		}
+	}
+
+	omap_rng_enable();
+
+	ret = hwrng_register(omap_rng_hwrng());
 	if (ret)
 		goto err_register;
 
 	dev_info(&pdev->dev, "OMAP Random Number Generator ver. %02x\n",
-		omap_rng_read_reg(RNG_REV_REG));
-	omap_rng_write_reg(RNG_MASK_REG, 0x1);
+		omap_rng_read_reg(omap_rng_is_omap4() ? RNG_REV_REG_4 :
+				  RNG_REV_REG) & 0xff);
 
 	rng_dev = pdev;
 
 	return 0;
 
 err_register:
+	omap_rng_disable();
+	if (rng_irq >= 0)
+		free_irq(rng_irq, NULL);
+	rng_irq = -1;
 	iounmap(rng_base);
 	rng_base = NULL;
 err_ioremap:
 	release_mem_region(res->start, resource_size(res));
 err_region:
-	if (cpu_is_omap24xx()) {
+	if (cpu_is_omap24xx() || omap_rng_is_omap4()) {
 		clk_disable(rng_ick);
 		clk_put(rng_ick);
 	}
@@ -161,13 +331,16 @@ static int __exit omap_rng_remove(struct platform_device *pdev)
 {
 	struct resource *res = dev_get_drvdata(&pdev->dev);
 
-	hwrng_unregister(&omap_rng_ops);
+	hwrng_unregister(omap_rng_hwrng());
 
-	omap_rng_write_reg(RNG_MASK_REG, 0x0);
+	omap_rng_disable();
+	if (rng_irq >= 0)
+		free_irq(rng_irq, NULL);
+	rng_irq = -1;
 
 	iounmap(rng_base);
 
-	if (cpu_is_omap24xx()) {
+	if (cpu_is_omap24xx() || omap_rng_is_omap4()) {
 		clk_disable(rng_ick);
 		clk_put(rng_ick);
 	}
@@ -182,13 +355,13 @@ static int __exit omap_rng_remove(struct platform_device *pdev)
 
 static int omap_rng_suspend(struct platform_device *pdev, pm_message_t message)
 {
-	omap_rng_write_reg(RNG_MASK_REG, 0x0);
+	omap_rng_disable();
 	return 0;
 }
 
 static int omap_rng_resume(struct platform_device *pdev)
 {
-	omap_rng_write_reg(RNG_MASK_REG, 0x1);
+	omap_rng_enable();
 	return 0;
 }
 
@@ -215,7 +388,7 @@ static struct platform_driver omap_rng_driver = {
 
 static int __init omap_rng_init(void)
 {
-	if (!cpu_is_omap16xx() && !cpu_is_omap24xx())
+	if (!cpu_is_omap16xx() && !cpu_is_omap24xx() && !omap_rng_is_omap4())
 		return -ENODEV;
 
 	return platform_driver_register(&omap_rng_driver);
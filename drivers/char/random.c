@@ -255,6 +255,7 @@
 #include <linux/fips.h>
 #include <linux/ptrace.h>
 #include <linux/kmemcheck.h>
+#include <linux/kthread.h>
 
 #ifdef CONFIG_GENERIC_HARDIRQS
 # include <linux/irq.h>
@@ -299,6 +300,29 @@ static int random_write_wakeup_thresh = 128;
 
 static int trickle_thresh __read_mostly = INPUT_POOL_WORDS * 28;
 
+/*
+ * Entropy credited by each kind of source since boot, and when the
+ * pools first became usable, for /proc/sys/kernel/random/entropy_sources.
+ */
+enum {
+	ENTROPY_SRC_INPUT,
+	ENTROPY_SRC_DISK,
+	ENTROPY_SRC_INTERRUPT,
+	ENTROPY_SRC_HWRNG,
+	ENTROPY_SRC_USER,
+	ENTROPY_SRC_NR,
+};
+
+static atomic_long_t entropy_src_bits[ENTROPY_SRC_NR];
+static unsigned long input_pool_ready_jiffies;
+static unsigned long nonblocking_pool_ready_jiffies;
+
+static inline void account_entropy(int src, int nbits)
+{
+	if (nbits > 0)
+		atomic_long_add(nbits, &entropy_src_bits[src]);
+}
+
 static DEFINE_PER_CPU(int, trickle_count);
 
 /*
@@ -609,8 +633,11 @@ retry:
 
 	if (!r->initialized && nbits > 0) {
 		r->entropy_total += nbits;
-		if (r->entropy_total > 128)
+		if (r->entropy_total > 128) {
 			r->initialized = 1;
+			if (r == &nonblocking_pool)
+				nonblocking_pool_ready_jiffies = jiffies ?: 1;
+		}
 	}
 
 	trace_credit_entropy_bits(r->name, nbits, entropy_count,
@@ -618,6 +645,8 @@ retry:
 
 	/* should we wake readers? */
 	if (r == &input_pool && entropy_count >= random_read_wakeup_thresh) {
+		if (!input_pool_ready_jiffies)
+			input_pool_ready_jiffies = jiffies ?: 1;
 		wake_up_interruptible(&random_read_wait);
 		kill_fasync(&fasync, SIGIO, POLL_IN);
 	}
@@ -667,7 +696,8 @@ static struct timer_rand_state input_timer_state;
  * keyboard scan codes, and 256 upwards for interrupts.
  *
  */
-static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
+static void add_timer_randomness(struct timer_rand_state *state, unsigned num,
+				 int src)
 {
 	struct {
 		long jiffies;
@@ -694,6 +724,8 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 	 */
 
 	if (!state->dont_count_entropy) {
+		int nbits;
+
 		delta = sample.jiffies - state->last_time;
 		state->last_time = sample.jiffies;
 
@@ -719,8 +751,9 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 		 * Round down by 1 bit on general principles,
 		 * and limit entropy entimate to 12 bits.
 		 */
-		credit_entropy_bits(&input_pool,
-				    min_t(int, fls(delta>>1), 11));
+		nbits = min_t(int, fls(delta>>1), 11);
+		credit_entropy_bits(&input_pool, nbits);
+		account_entropy(src, nbits);
 	}
 out:
 	preempt_enable();
@@ -738,7 +771,8 @@ void add_input_randomness(unsigned int type, unsigned int code,
 	DEBUG_ENT("input event\n");
 	last_value = value;
 	add_timer_randomness(&input_timer_state,
-			     (type << 4) ^ code ^ (code >> 4) ^ value);
+			     (type << 4) ^ code ^ (code >> 4) ^ value,
+			     ENTROPY_SRC_INPUT);
 }
 EXPORT_SYMBOL_GPL(add_input_randomness);
 
@@ -784,6 +818,7 @@ void add_interrupt_randomness(int irq, int irq_flags)
 			fast_pool->last_timer_intr = 0;
 	}
 	credit_entropy_bits(r, 1);
+	account_entropy(ENTROPY_SRC_INTERRUPT, 1);
 }
 
 #ifdef CONFIG_BLOCK
@@ -795,10 +830,29 @@ void add_disk_randomness(struct gendisk *disk)
 	DEBUG_ENT("disk event %d:%d\n",
 		  MAJOR(disk_devt(disk)), MINOR(disk_devt(disk)));
 
-	add_timer_randomness(disk->random, 0x100 + disk_devt(disk));
+	add_timer_randomness(disk->random, 0x100 + disk_devt(disk),
+			     ENTROPY_SRC_DISK);
 }
 #endif
 
+/*
+ * Interface for the hw_random core to feed the input pool from a
+ * hardware RNG, crediting @entropy bits for the @count bytes.  Sleeps
+ * while the pool holds at least random_write_wakeup_thresh bits, so
+ * that the hardware is read as fast as the pool is drained and no
+ * faster.  The caller is expected to be a kthread.
+ */
+void add_hwgenerator_randomness(const char *buffer, size_t count,
+				size_t entropy)
+{
+	wait_event_interruptible(random_write_wait, kthread_should_stop() ||
+			input_pool.entropy_count < random_write_wakeup_thresh);
+	mix_pool_bytes(&input_pool, buffer, count, NULL);
+	credit_entropy_bits(&input_pool, entropy);
+	account_entropy(ENTROPY_SRC_HWRNG, entropy);
+}
+EXPORT_SYMBOL_GPL(add_hwgenerator_randomness);
+
 /*********************************************************************
  *
  * Entropy extraction routines
@@ -1261,6 +1315,7 @@ static long random_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		if (get_user(ent_count, p))
 			return -EFAULT;
 		credit_entropy_bits(&input_pool, ent_count);
+		account_entropy(ENTROPY_SRC_USER, ent_count);
 		return 0;
 	case RNDADDENTROPY:
 		if (!capable(CAP_SYS_ADMIN))
@@ -1276,6 +1331,7 @@ static long random_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		if (retval < 0)
 			return retval;
 		credit_entropy_bits(&input_pool, ent_count);
+		account_entropy(ENTROPY_SRC_USER, ent_count);
 		return 0;
 	case RNDZAPENTCNT:
 	case RNDCLEARPOOL:
@@ -1382,6 +1438,45 @@ static int proc_do_uuid(ctl_table *table, int write,
 	return proc_dostring(&fake_table, write, buffer, lenp, ppos);
 }
 
+static unsigned int ready_msecs(unsigned long j)
+{
+	return j ? jiffies_to_msecs(j - INITIAL_JIFFIES) : 0;
+}
+
+/*
+ * Bits credited by each kind of source, and the time since boot in ms
+ * at which /dev/random first had data and /dev/urandom was seeded (0 if
+ * not yet), one per line.
+ */
+static int proc_do_entropy_sources(ctl_table *table, int write,
+			void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	static const char * const names[ENTROPY_SRC_NR] = {
+		[ENTROPY_SRC_INPUT]	= "input",
+		[ENTROPY_SRC_DISK]	= "disk",
+		[ENTROPY_SRC_INTERRUPT]	= "interrupt",
+		[ENTROPY_SRC_HWRNG]	= "hwrng",
+		[ENTROPY_SRC_USER]	= "user",
+	};
+	ctl_table fake_table;
+	char buf[256];
+	int i, len = 0;
+
+	for (i = 0; i < ENTROPY_SRC_NR; i++)
+		len += scnprintf(buf + len, sizeof(buf) - len, "%s %ld\n",
+				 names[i],
+				 atomic_long_read(&entropy_src_bits[i]));
+	len += scnprintf(buf + len, sizeof(buf) - len,
+			 "input_ready_ms %u\nnonblocking_ready_ms %u",
+			 ready_msecs(input_pool_ready_jiffies),
+			 ready_msecs(nonblocking_pool_ready_jiffies));
+
+	fake_table.data = buf;
+	fake_table.maxlen = sizeof(buf);
+
+	return proc_dostring(&fake_table, write, buffer, lenp, ppos);
+}
+
 static int sysctl_poolsize = INPUT_POOL_WORDS * 32;
 ctl_table random_table[] = {
 	{
@@ -1429,6 +1524,11 @@ ctl_table random_table[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_do_uuid,
 	},
+	{
+		.procname	= "entropy_sources",
+		.mode		= 0444,
+		.proc_handler	= proc_do_entropy_sources,
+	},
 	{ }
 };
 #endif 	/* CONFIG_SYSCTL */
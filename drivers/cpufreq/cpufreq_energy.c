@@ -0,0 +1,524 @@
+/*
+ *  drivers/cpufreq/cpufreq_energy.c
+ *
+ *  Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Every tick, the task it is accounted to is charged the energy its CPU
+ * used over the tick: the power the platform gave for the current CPU
+ * frequency times the tick length.  The same energy is added up per CPU
+ * and frequency, and the energy spent in each idle state is derived from
+ * the cpuidle residency and the power of the state.
+ *
+ * /proc/<pid>/energy and /proc/<pid>/task/<tid>/energy give the estimate
+ * for a process and a thread, /proc/uid_energy for each uid (including
+ * the tasks that are gone) and /proc/cpu_energy the per frequency and per
+ * idle state figures.  All the energies are in uJ.
+ *
+ * The tick also adds its length to the time its uid has spent at the
+ * current frequency.  These times are kept in a per CPU hash, under the
+ * lock the tick already takes, so the accounting never touches another
+ * CPU's cache lines; /proc/uid_time_in_state sums them up for all the uids
+ * in one read, in clock_t units like cpufreq's time_in_state.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/cpufreq_energy.h>
+#include <linux/cpuidle.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
+
+#define UID_HASH_BITS	6
+
+struct cpufreq_energy_cpu {
+	spinlock_t lock;
+	int index;
+	u64 *time_us;
+	u64 *energy_uj;
+	struct hlist_head uid_hash[1 << UID_HASH_BITS];
+	int uid_count;
+};
+
+/* time a uid has spent at each frequency on one CPU */
+struct cpufreq_energy_uid_time {
+	struct hlist_node hash;
+	uid_t uid;
+	u64 time_us[0];
+};
+
+/* energy of the tasks released so far */
+struct cpufreq_energy_uid {
+	struct list_head link;
+	uid_t uid;
+	u64 energy_uj;
+};
+
+struct cpufreq_energy_sample {
+	uid_t uid;
+	u64 energy_uj;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_energy_cpu, cpufreq_energy_cpu);
+static struct cpufreq_power_table *power_table;
+static int power_count;
+
+static DEFINE_SPINLOCK(uid_lock);
+static LIST_HEAD(uid_list);
+static int uid_count;
+
+/* the table is sorted by frequency, pick the first entry at or above @freq */
+static int cpufreq_energy_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < power_count - 1; i++)
+		if (power_table[i].frequency >= freq)
+			break;
+
+	return i;
+}
+
+/* this function should only be called while ec->lock is held */
+static struct cpufreq_energy_uid_time *
+cpufreq_energy_uid_time(struct cpufreq_energy_cpu *ec, uid_t uid)
+{
+	struct hlist_head *head = &ec->uid_hash[hash_32(uid, UID_HASH_BITS)];
+	struct cpufreq_energy_uid_time *ut;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(ut, node, head, hash)
+		if (ut->uid == uid)
+			return ut;
+
+	/* uids are few and long lived, the entries are never freed */
+	ut = kzalloc(sizeof(*ut) + power_count * sizeof(ut->time_us[0]),
+		     GFP_ATOMIC);
+	if (!ut)
+		return NULL;
+	ut->uid = uid;
+	hlist_add_head(&ut->hash, head);
+	ec->uid_count++;
+	return ut;
+}
+
+void cpufreq_energy_account(struct task_struct *p, cputime_t cputime)
+{
+	struct cpufreq_energy_cpu *ec;
+	struct cpufreq_energy_uid_time *ut;
+	unsigned long flags;
+	uid_t uid;
+	u64 us, uj;
+
+	if (!ACCESS_ONCE(power_table))
+		return;
+	smp_rmb();
+
+	us = cputime_to_usecs(cputime);
+	uid = task_uid(p);
+	ec = &__get_cpu_var(cpufreq_energy_cpu);
+
+	spin_lock_irqsave(&ec->lock, flags);
+	uj = div_u64(us * power_table[ec->index].power, 1000);
+	ec->time_us[ec->index] += us;
+	ec->energy_uj[ec->index] += uj;
+	ut = cpufreq_energy_uid_time(ec, uid);
+	if (ut)
+		ut->time_us[ec->index] += us;
+	spin_unlock_irqrestore(&ec->lock, flags);
+
+	p->cpu_energy += uj;
+}
+
+static struct cpufreq_energy_uid *find_uid(uid_t uid)
+{
+	struct cpufreq_energy_uid *entry;
+
+	list_for_each_entry(entry, &uid_list, link)
+		if (entry->uid == uid)
+			return entry;
+
+	return NULL;
+}
+
+/* called from release_task(): keep the energy of @p for its uid */
+void cpufreq_energy_task_release(struct task_struct *p)
+{
+	struct cpufreq_energy_uid *entry;
+	unsigned long flags;
+	uid_t uid;
+
+	if (!p->cpu_energy)
+		return;
+
+	uid = task_uid(p);
+
+	spin_lock_irqsave(&uid_lock, flags);
+	entry = find_uid(uid);
+	if (!entry) {
+		entry = kzalloc(sizeof(*entry), GFP_ATOMIC);
+		if (!entry)
+			goto out;
+		entry->uid = uid;
+		list_add_tail(&entry->link, &uid_list);
+		uid_count++;
+	}
+	entry->energy_uj += p->cpu_energy;
+out:
+	spin_unlock_irqrestore(&uid_lock, flags);
+}
+
+static int cpufreq_energy_notifier(struct notifier_block *nb,
+				   unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct cpufreq_energy_cpu *ec;
+	unsigned long flags;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	ec = &per_cpu(cpufreq_energy_cpu, freq->cpu);
+	spin_lock_irqsave(&ec->lock, flags);
+	ec->index = cpufreq_energy_index(freq->new);
+	spin_unlock_irqrestore(&ec->lock, flags);
+
+	return 0;
+}
+
+static struct notifier_block cpufreq_energy_notifier_block = {
+	.notifier_call = cpufreq_energy_notifier,
+};
+
+/**
+ * cpufreq_energy_register_table() - set the power model of the CPUs
+ * @table: power drawn by a busy CPU at each frequency, lowest first
+ * @count: number of entries in @table
+ *
+ * @table is copied. Only one table can be registered, it applies to all
+ * the CPUs.
+ *
+ * Returns 0 on success, -EBUSY if a table is already registered.
+ */
+int cpufreq_energy_register_table(const struct cpufreq_power_table *table,
+				  int count)
+{
+	struct cpufreq_power_table *copy;
+	int cpu, ret;
+
+	if (!table || count <= 0)
+		return -EINVAL;
+
+	if (power_table)
+		return -EBUSY;
+
+	copy = kmemdup(table, count * sizeof(*table), GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_energy_cpu *ec = &per_cpu(cpufreq_energy_cpu, cpu);
+
+		ec->time_us = kcalloc(count, sizeof(*ec->time_us), GFP_KERNEL);
+		ec->energy_uj = kcalloc(count, sizeof(*ec->energy_uj),
+					GFP_KERNEL);
+		if (!ec->time_us || !ec->energy_uj) {
+			ret = -ENOMEM;
+			goto err;
+		}
+	}
+
+	power_count = count;
+	for_each_possible_cpu(cpu)
+		per_cpu(cpufreq_energy_cpu, cpu).index =
+			cpufreq_energy_index(cpufreq_quick_get(cpu));
+
+	ret = cpufreq_register_notifier(&cpufreq_energy_notifier_block,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		goto err;
+
+	smp_wmb();
+	power_table = copy;
+
+	return 0;
+err:
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_energy_cpu *ec = &per_cpu(cpufreq_energy_cpu, cpu);
+
+		kfree(ec->time_us);
+		kfree(ec->energy_uj);
+		ec->time_us = NULL;
+		ec->energy_uj = NULL;
+	}
+	power_count = 0;
+	kfree(copy);
+	return ret;
+}
+
+static int cpufreq_energy_sample_cmp(const void *a, const void *b)
+{
+	const struct cpufreq_energy_sample *sa = a, *sb = b;
+
+	if (sa->uid < sb->uid)
+		return -1;
+	return sa->uid > sb->uid;
+}
+
+static int uid_energy_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_energy_sample *samples;
+	struct cpufreq_energy_uid *entry;
+	struct task_struct *g, *t;
+	unsigned long flags;
+	int i, n = 0, max;
+
+	/* a few spare entries for the tasks forked meanwhile */
+	max = nr_threads + ACCESS_ONCE(uid_count) + 64;
+	samples = vmalloc(max * sizeof(*samples));
+	if (!samples)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&uid_lock, flags);
+	list_for_each_entry(entry, &uid_list, link) {
+		if (n == max)
+			break;
+		samples[n].uid = entry->uid;
+		samples[n++].energy_uj = entry->energy_uj;
+	}
+	spin_unlock_irqrestore(&uid_lock, flags);
+
+	rcu_read_lock();
+	do_each_thread(g, t) {
+		if (n == max)
+			goto done;
+		samples[n].uid = task_uid(t);
+		samples[n++].energy_uj = t->cpu_energy;
+	} while_each_thread(g, t);
+done:
+	rcu_read_unlock();
+
+	sort(samples, n, sizeof(*samples), cpufreq_energy_sample_cmp, NULL);
+
+	seq_printf(m, "uid energy_uJ\n");
+	for (i = 0; i < n; i++) {
+		uid_t uid = samples[i].uid;
+		u64 energy = 0;
+
+		for (; i < n && samples[i].uid == uid; i++)
+			energy += samples[i].energy_uj;
+		i--;
+
+		seq_printf(m, "%u %llu\n", uid, energy);
+	}
+
+	vfree(samples);
+	return 0;
+}
+
+static int uid_energy_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_energy_show, NULL);
+}
+
+static const struct file_operations uid_energy_fops = {
+	.open		= uid_energy_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+struct cpufreq_energy_time_sample {
+	uid_t uid;
+	u64 *time_us;
+};
+
+static int cpufreq_energy_time_sample_cmp(const void *a, const void *b)
+{
+	const struct cpufreq_energy_time_sample *sa = a, *sb = b;
+
+	if (sa->uid < sb->uid)
+		return -1;
+	return sa->uid > sb->uid;
+}
+
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_energy_time_sample *samples;
+	struct cpufreq_energy_uid_time *ut;
+	struct hlist_node *node;
+	unsigned long flags;
+	int cpu, i, j, n = 0, max = 0;
+	u64 *times, *sum;
+
+	if (!power_table)
+		return 0;
+
+	/* a few spare entries for the uids showing up meanwhile */
+	for_each_possible_cpu(cpu)
+		max += ACCESS_ONCE(per_cpu(cpufreq_energy_cpu, cpu).uid_count);
+	max += 16;
+
+	samples = vmalloc(max * sizeof(*samples));
+	times = vmalloc((max + 1) * power_count * sizeof(*times));
+	if (!samples || !times) {
+		vfree(samples);
+		vfree(times);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_energy_cpu *ec = &per_cpu(cpufreq_energy_cpu, cpu);
+
+		spin_lock_irqsave(&ec->lock, flags);
+		for (i = 0; i < ARRAY_SIZE(ec->uid_hash) && n < max; i++) {
+			hlist_for_each_entry(ut, node, &ec->uid_hash[i], hash) {
+				if (n == max)
+					break;
+				samples[n].uid = ut->uid;
+				samples[n].time_us = times + n * power_count;
+				memcpy(samples[n].time_us, ut->time_us,
+				       power_count * sizeof(*times));
+				n++;
+			}
+		}
+		spin_unlock_irqrestore(&ec->lock, flags);
+	}
+
+	sort(samples, n, sizeof(*samples), cpufreq_energy_time_sample_cmp,
+	     NULL);
+
+	seq_printf(m, "uid:");
+	for (j = 0; j < power_count; j++)
+		seq_printf(m, " %u", power_table[j].frequency);
+	seq_putc(m, '\n');
+
+	sum = times + max * power_count;
+	for (i = 0; i < n; i++) {
+		uid_t uid = samples[i].uid;
+
+		memset(sum, 0, power_count * sizeof(*sum));
+		for (; i < n && samples[i].uid == uid; i++)
+			for (j = 0; j < power_count; j++)
+				sum[j] += samples[i].time_us[j];
+		i--;
+
+		seq_printf(m, "%u:", uid);
+		for (j = 0; j < power_count; j++)
+			seq_printf(m, " %llu",
+				   div_u64(sum[j] * USER_HZ, USEC_PER_SEC));
+		seq_putc(m, '\n');
+	}
+
+	vfree(times);
+	vfree(samples);
+	return 0;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_time_in_state_show, NULL);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#ifdef CONFIG_CPU_IDLE
+static void cpu_energy_show_idle(struct seq_file *m, int cpu)
+{
+	struct cpuidle_driver *drv = cpuidle_get_driver();
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, cpu);
+	int i;
+
+	/* without power figures the cpuidle core makes them up */
+	if (!drv || !dev || !drv->power_specified)
+		return;
+
+	for (i = 0; i < drv->state_count; i++) {
+		u64 time = dev->states_usage[i].time;
+
+		seq_printf(m, "  %-8s %12llu %12llu\n", drv->states[i].name,
+			   time, div_u64(time * drv->states[i].power_usage,
+					 1000));
+	}
+}
+#else
+static inline void cpu_energy_show_idle(struct seq_file *m, int cpu) { }
+#endif
+
+static int cpu_energy_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	if (!power_table)
+		return 0;
+
+	seq_printf(m, "%-10s %12s %12s\n", "state", "time_us", "energy_uJ");
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_energy_cpu *ec = &per_cpu(cpufreq_energy_cpu, cpu);
+		unsigned long flags;
+		u64 time, energy;
+
+		seq_printf(m, "cpu%d\n", cpu);
+		for (i = 0; i < power_count; i++) {
+			spin_lock_irqsave(&ec->lock, flags);
+			time = ec->time_us[i];
+			energy = ec->energy_uj[i];
+			spin_unlock_irqrestore(&ec->lock, flags);
+
+			seq_printf(m, "  %-8u %12llu %12llu\n",
+				   power_table[i].frequency, time, energy);
+		}
+		cpu_energy_show_idle(m, cpu);
+	}
+
+	return 0;
+}
+
+static int cpu_energy_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpu_energy_show, NULL);
+}
+
+static const struct file_operations cpu_energy_fops = {
+	.open		= cpu_energy_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cpufreq_energy_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(cpufreq_energy_cpu, cpu).lock);
+
+	proc_create("uid_energy", S_IRUGO, NULL, &uid_energy_fops);
+	proc_create("cpu_energy", S_IRUGO, NULL, &cpu_energy_fops);
+	proc_create("uid_time_in_state", S_IRUGO, NULL,
+		    &uid_time_in_state_fops);
+
+	return 0;
+}
+core_initcall(cpufreq_energy_init);
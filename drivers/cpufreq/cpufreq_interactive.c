@@ -44,9 +44,11 @@ struct cpufreq_interactive_cpuinfo {
 	u64 time_in_idle_timestamp;
 	u64 cputime_speedadj;
 	u64 cputime_speedadj_timestamp;
+	spinlock_t target_freq_lock; /* serializes target_freq updates */
 	struct cpufreq_policy *policy;
 	struct cpufreq_frequency_table *freq_table;
 	unsigned int target_freq;
+	unsigned int last_load;		/* load of the last evaluation */
 	unsigned int floor_freq;
 	u64 floor_validate_time;
 	u64 hispeed_validate_time;
@@ -109,6 +111,15 @@ static u64 boostpulse_endtime;
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
 static int timer_slack_val = DEFAULT_TIMER_SLACK;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Non-zero means the load is the demand of the tasks queued on a CPU, as
+ * tracked by the scheduler, and the speed is re-evaluated as soon as tasks
+ * wake up on or migrate to the CPU instead of at the next sample.
+ */
+static int use_sched_load_val;
+#endif
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
 
@@ -267,37 +278,26 @@ static u64 update_load(int cpu)
 	return now;
 }
 
-static void cpufreq_interactive_timer(unsigned long data)
+/*
+ * Pick the speed for a CPU running at loadadjfreq (its load in percent
+ * times the speed it ran at).  Returns true if the evaluation has to be
+ * retried later, e.g. because the floor is still being held.
+ */
+static bool cpufreq_interactive_evaluate(
+	int cpu, struct cpufreq_interactive_cpuinfo *pcpu, u64 now,
+	unsigned int loadadjfreq)
 {
-	u64 now;
-	unsigned int delta_time;
-	u64 cputime_speedadj;
 	int cpu_load;
-	struct cpufreq_interactive_cpuinfo *pcpu =
-		&per_cpu(cpuinfo, data);
 	unsigned int new_freq;
-	unsigned int loadadjfreq;
 	unsigned int index;
 	unsigned long flags;
 	bool boosted;
+	bool retry = true;
+	bool changed = false;
 
-	if (!down_read_trylock(&pcpu->enable_sem))
-		return;
-	if (!pcpu->governor_enabled)
-		goto exit;
-
-	spin_lock_irqsave(&pcpu->load_lock, flags);
-	now = update_load(data);
-	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
-	cputime_speedadj = pcpu->cputime_speedadj;
-	spin_unlock_irqrestore(&pcpu->load_lock, flags);
-
-	if (WARN_ON_ONCE(!delta_time))
-		goto rearm;
-
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
 	cpu_load = loadadjfreq / pcpu->target_freq;
+	pcpu->last_load = cpu_load;
 	boosted = boost_val || now < boostpulse_endtime;
 
 	if (cpu_load >= go_hispeed_load || boosted) {
@@ -317,9 +317,9 @@ static void cpufreq_interactive_timer(unsigned long data)
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time < above_hispeed_delay_val) {
 		trace_cpufreq_interactive_notyet(
-			data, cpu_load, pcpu->target_freq,
+			cpu, cpu_load, pcpu->target_freq,
 			pcpu->policy->cur, new_freq);
-		goto rearm;
+		goto unlock;
 	}
 
 	pcpu->hispeed_validate_time = now;
@@ -328,8 +328,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 					   new_freq, CPUFREQ_RELATION_L,
 					   &index)) {
 		pr_warn_once("timer %d: cpufreq_frequency_table_target error\n",
-			     (int) data);
-		goto rearm;
+			     cpu);
+		goto unlock;
 	}
 
 	new_freq = pcpu->freq_table[index].frequency;
@@ -341,9 +341,9 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (new_freq < pcpu->floor_freq) {
 		if (now - pcpu->floor_validate_time < min_sample_time) {
 			trace_cpufreq_interactive_notyet(
-				data, cpu_load, pcpu->target_freq,
+				cpu, cpu_load, pcpu->target_freq,
 				pcpu->policy->cur, new_freq);
-			goto rearm;
+			goto unlock;
 		}
 	}
 
@@ -360,23 +360,83 @@ static void cpufreq_interactive_timer(unsigned long data)
 		pcpu->floor_validate_time = now;
 	}
 
+	retry = false;
+
 	if (pcpu->target_freq == new_freq) {
 		trace_cpufreq_interactive_already(
-			data, cpu_load, pcpu->target_freq,
+			cpu, cpu_load, pcpu->target_freq,
 			pcpu->policy->cur, new_freq);
-		goto rearm_if_notmax;
+		goto unlock;
 	}
 
-	trace_cpufreq_interactive_target(data, cpu_load, pcpu->target_freq,
+	trace_cpufreq_interactive_target(cpu, cpu_load, pcpu->target_freq,
 					 pcpu->policy->cur, new_freq);
 
 	pcpu->target_freq = new_freq;
-	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
-	cpumask_set_cpu(data, &speedchange_cpumask);
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
-	wake_up_process(speedchange_task);
+	changed = true;
+
+unlock:
+	spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
+
+	if (changed) {
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		cpumask_set_cpu(cpu, &speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+		wake_up_process(speedchange_task);
+	}
+
+	return retry;
+}
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/* loadadjfreq of a CPU according to the scheduler, at least @demand */
+static unsigned int sched_loadadjfreq(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu,
+	unsigned long demand)
+{
+	u64 loadadjfreq;
+
+	demand = max(demand, sched_get_cpu_demand(cpu));
+	demand = min(demand, SCHED_DEMAND_SCALE);
+	loadadjfreq = (u64)demand * pcpu->policy->cur * 100;
+	return (unsigned int)(loadadjfreq >> SCHED_DEMAND_SHIFT);
+}
+#endif
+
+static void cpufreq_interactive_timer(unsigned long data)
+{
+	u64 now;
+	unsigned int delta_time;
+	u64 cputime_speedadj;
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		&per_cpu(cpuinfo, data);
+	unsigned int loadadjfreq;
+	unsigned long flags;
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	spin_lock_irqsave(&pcpu->load_lock, flags);
+	now = update_load(data);
+	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
+	cputime_speedadj = pcpu->cputime_speedadj;
+	spin_unlock_irqrestore(&pcpu->load_lock, flags);
+
+	if (WARN_ON_ONCE(!delta_time))
+		goto rearm;
+
+	do_div(cputime_speedadj, delta_time);
+	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	if (use_sched_load_val)
+		loadadjfreq = sched_loadadjfreq(pcpu, data, 0);
+#endif
+
+	if (cpufreq_interactive_evaluate(data, pcpu, now, loadadjfreq))
+		goto rearm;
 
-rearm_if_notmax:
 	/*
 	 * Already set max speed and don't see a need to change that,
 	 * wait until next idle to re-evaluate, don't need timer.
@@ -408,6 +468,18 @@ static void cpufreq_interactive_idle_start(void)
 
 	pending = timer_pending(&pcpu->cpu_timer);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/*
+	 * The scheduler load of a CPU going idle is known, so settle its
+	 * speed now; the timers are only needed if the floor holds it up.
+	 */
+	if (use_sched_load_val && pcpu->target_freq != pcpu->policy->min)
+		cpufreq_interactive_evaluate(smp_processor_id(), pcpu,
+					     ktime_to_us(ktime_get()),
+					     sched_loadadjfreq(pcpu,
+						smp_processor_id(), 0));
+#endif
+
 	if (pcpu->target_freq != pcpu->policy->min) {
 		/*
 		 * Entering idle while not at lowest speed.  On some
@@ -579,6 +651,41 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static int cpufreq_interactive_sched_notifier(
+	struct notifier_block *nb, unsigned long event, void *data)
+{
+	struct sched_freq_event *ev = data;
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, ev->cpu);
+	unsigned int loadadjfreq;
+
+	if (!use_sched_load_val)
+		return NOTIFY_DONE;
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return NOTIFY_DONE;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	loadadjfreq = sched_loadadjfreq(pcpu, ev->cpu, ev->demand);
+
+	/* a wakeup only matters if it takes the CPU above its target load */
+	if (event == SCHED_FREQ_WAKEUP &&
+	    loadadjfreq <= pcpu->target_freq *
+			   freq_to_targetload(pcpu->target_freq))
+		goto exit;
+
+	cpufreq_interactive_evaluate(ev->cpu, pcpu, ktime_to_us(ktime_get()),
+				     loadadjfreq);
+exit:
+	up_read(&pcpu->enable_sem);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_interactive_sched_nb = {
+	.notifier_call = cpufreq_interactive_sched_notifier,
+};
+#endif
+
 static ssize_t show_target_loads(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
@@ -836,6 +943,61 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 	return count;
 }
 
+/**
+ * cpufreq_interactive_boostpulse() - boost all CPUs to hispeed_freq
+ * @duration_us: how long to hold at least hispeed_freq
+ *
+ * In-kernel equivalent of a write to boostpulse, for callers that know
+ * a burst of work is coming (e.g. on input events).  A pending longer
+ * pulse is not shortened.  Can be called from atomic context.
+ *
+ * Returns -ENODEV if the governor is not in use.
+ */
+int cpufreq_interactive_boostpulse(unsigned int duration_us)
+{
+	u64 endtime;
+
+	if (!active_count)
+		return -ENODEV;
+
+	endtime = ktime_to_us(ktime_get()) + duration_us;
+	if (endtime > boostpulse_endtime)
+		boostpulse_endtime = endtime;
+	trace_cpufreq_interactive_boost("pulse");
+	cpufreq_interactive_boost();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_interactive_boostpulse);
+
+/**
+ * cpufreq_interactive_is_busy() - is the system under interactive load
+ *
+ * True while a boost is active or the last evaluated load of an online
+ * CPU reached go_hispeed_load.  Meant for background work, like ksmd, to
+ * stay out of the way.
+ */
+bool cpufreq_interactive_is_busy(void)
+{
+	int cpu;
+
+	if (!active_count)
+		return false;
+
+	if (boost_val || ktime_to_us(ktime_get()) < boostpulse_endtime)
+		return true;
+
+	for_each_online_cpu(cpu) {
+		struct cpufreq_interactive_cpuinfo *pcpu =
+			&per_cpu(cpuinfo, cpu);
+
+		if (pcpu->governor_enabled &&
+		    pcpu->last_load >= go_hispeed_load)
+			return true;
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(cpufreq_interactive_is_busy);
+
 static struct global_attr boostpulse =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse);
 
@@ -862,6 +1024,31 @@ static ssize_t store_boostpulse_duration(
 
 define_one_global_rw(boostpulse_duration);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static ssize_t show_use_sched_load(
+	struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", use_sched_load_val);
+}
+
+static ssize_t store_use_sched_load(
+	struct kobject *kobj, struct attribute *attr, const char *buf,
+	size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	use_sched_load_val = !!val;
+	return count;
+}
+
+define_one_global_rw(use_sched_load);
+#endif
+
 static struct attribute *interactive_attributes[] = {
 	&target_loads_attr.attr,
 	&hispeed_freq_attr.attr,
@@ -873,6 +1060,9 @@ static struct attribute *interactive_attributes[] = {
 	&boost.attr,
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	&use_sched_load.attr,
+#endif
 	NULL,
 };
 
@@ -965,6 +1155,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		register_sched_freq_notifier(&cpufreq_interactive_sched_nb);
+#endif
 		mutex_unlock(&gov_lock);
 		break;
 
@@ -984,6 +1177,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			return 0;
 		}
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		unregister_sched_freq_notifier(&cpufreq_interactive_sched_nb);
+#endif
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
@@ -1024,6 +1220,7 @@ static int __init cpufreq_interactive_init(void)
 		init_timer(&pcpu->cpu_slack_timer);
 		pcpu->cpu_slack_timer.function = cpufreq_interactive_nop_timer;
 		spin_lock_init(&pcpu->load_lock);
+		spin_lock_init(&pcpu->target_freq_lock);
 		init_rwsem(&pcpu->enable_sem);
 	}
 
@@ -24,7 +24,10 @@
 #include <linux/io.h>
 #include <linux/opp.h>
 #include <linux/cpu.h>
+#include <linux/cpufreq_energy.h>
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
 #include <linux/thermal_framework.h>
 #include <linux/omap4_duty_cycle.h>
 
@@ -375,6 +378,14 @@ static int cpufreq_apply_cooling(struct thermal_dev *dev, int cooling_level)
 		new_cooling_level = case_cooling_level;
 
 		omap_thermal_step_freq(&policy, case_cooling_level);
+	} else if (IS_ENABLED(CONFIG_OMAP_POWER_GOVERNOR)) {
+		/* the power governor asks for an absolute number of steps */
+		new_cooling_level = cpu_cooling_level;
+
+		if (new_cooling_level)
+			omap_thermal_step_freq(&policy, new_cooling_level);
+		else
+			omap_thermal_step_freq_up(&policy);
 	} else {
 		new_cooling_level = cpu_cooling_level;
 
@@ -511,6 +522,48 @@ static void __exit omap_duty_cooling_exit(void) { }
 
 #endif
 
+#ifdef CONFIG_CPU_FREQ_ENERGY
+/* rough dynamic power coefficient of one core, in uW/(MHz.V^2) */
+#define OMAP_CPU_CAPACITANCE	300
+
+/* power model for the energy accounting, c.f.V^2 at each OPP */
+static void __cpuinit omap_cpufreq_energy_init(void)
+{
+	struct cpufreq_power_table *table;
+	struct opp *opp;
+	unsigned long freq;
+	u64 mv;
+	int i, count;
+
+	count = 0;
+	while (freq_table[count].frequency != CPUFREQ_TABLE_END)
+		count++;
+
+	table = kcalloc(count, sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return;
+
+	rcu_read_lock();
+	for (i = 0; i < count; i++) {
+		freq = freq_table[i].frequency * 1000;
+		opp = opp_find_freq_exact(mpu_dev, freq, true);
+		mv = IS_ERR(opp) ? 0 : opp_get_voltage(opp) / 1000;
+		table[i].frequency = freq_table[i].frequency;
+		table[i].power = div_u64(OMAP_CPU_CAPACITANCE *
+					 (freq / 1000000) * mv * mv,
+					 1000000000);
+	}
+	rcu_read_unlock();
+
+	if (cpufreq_energy_register_table(table, count) == -ENOMEM)
+		dev_warn(mpu_dev, "%s: no energy accounting\n", __func__);
+
+	kfree(table);
+}
+#else
+static inline void omap_cpufreq_energy_init(void) { }
+#endif
+
 static int __cpuinit omap_cpu_init(struct cpufreq_policy *policy)
 {
 	int result = 0;
@@ -549,6 +602,8 @@ static int __cpuinit omap_cpu_init(struct cpufreq_policy *policy)
 	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
 		max_freq = max(freq_table[i].frequency, max_freq);
 
+	omap_cpufreq_energy_init();
+
 	/*
 	 * On OMAP SMP configuartion, both processors share the voltage
 	 * and clock. So both CPUs needs to be scaled together and hence
@@ -90,7 +90,8 @@ struct omap_aes_reqctx {
 	unsigned long mode;
 };
 
-#define OMAP_AES_QUEUE_LENGTH	1
+/* dm-crypt queues a bio's worth of sector sized requests at once */
+#define OMAP_AES_QUEUE_LENGTH	32
 #define OMAP_AES_CACHE_SIZE	0
 
 struct omap_aes_dev {
@@ -115,6 +116,7 @@ struct omap_aes_dev {
 	size_t				in_offset;
 	struct scatterlist		*out_sg;
 	size_t				out_offset;
+	int				nents;	/* mapped, FLAGS_FAST */
 
 	size_t			buflen;
 	void			*buf_in;
@@ -470,53 +472,81 @@ static int omap_aes_crypt_dma(struct crypto_tfm *tfm, dma_addr_t dma_addr_in,
 	return 0;
 }
 
-static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
+/*
+ * Number of entries covering @total bytes if the source and destination
+ * lists can be handed to the DMA as they are: pairwise of the same length,
+ * in whole AES blocks and word aligned.  0 if they need the bounce buffers.
+ */
+static int omap_aes_sg_fast(struct scatterlist *in, struct scatterlist *out,
+			    size_t total)
+{
+	int nents = 0;
+
+	while (total) {
+		if (!in || !out || in->length != out->length ||
+		    !IS_ALIGNED(in->length, AES_BLOCK_SIZE) ||
+		    !IS_ALIGNED(in->offset, sizeof(u32)) ||
+		    !IS_ALIGNED(out->offset, sizeof(u32)))
+			return 0;
+
+		total -= min_t(size_t, total, in->length);
+		in = sg_next(in);
+		out = sg_next(out);
+		nents++;
+	}
+
+	return nents;
+}
+
+/* map the whole request once, the DMA then goes through it entry by entry */
+static int omap_aes_dma_map(struct omap_aes_dev *dd)
 {
-	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(
-					crypto_ablkcipher_reqtfm(dd->req));
-	int err, fast = 0, in, out;
-	size_t count;
-	dma_addr_t addr_in, addr_out;
+	int nents = omap_aes_sg_fast(dd->in_sg, dd->out_sg, dd->total);
 
-	pr_debug("total: %d\n", dd->total);
+	dd->flags &= ~FLAGS_FAST;
+	if (!nents)
+		return 0;
 
-	if (sg_is_last(dd->in_sg) && sg_is_last(dd->out_sg)) {
-		/* check for alignment */
-		in = IS_ALIGNED((u32)dd->in_sg->offset, sizeof(u32));
-		out = IS_ALIGNED((u32)dd->out_sg->offset, sizeof(u32));
+	if (!dma_map_sg(dd->dev, dd->in_sg, nents, DMA_TO_DEVICE)) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		return -EINVAL;
+	}
 
-		fast = in && out;
+	if (!dma_map_sg(dd->dev, dd->out_sg, nents, DMA_FROM_DEVICE)) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		dma_unmap_sg(dd->dev, dd->in_sg, nents, DMA_TO_DEVICE);
+		return -EINVAL;
 	}
 
-	if (fast)  {
-		count = min(dd->total, sg_dma_len(dd->in_sg));
-		count = min(count, sg_dma_len(dd->out_sg));
+	dd->nents = nents;
+	dd->flags |= FLAGS_FAST;
 
-		if (count != dd->total) {
-			pr_err("request length != buffer length\n");
-			return -EINVAL;
-		}
+	return 0;
+}
 
-		pr_debug("fast\n");
+static void omap_aes_dma_unmap(struct omap_aes_dev *dd)
+{
+	if (!(dd->flags & FLAGS_FAST))
+		return;
 
-		err = dma_map_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-		if (!err) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			return -EINVAL;
-		}
+	dma_unmap_sg(dd->dev, dd->req->dst, dd->nents, DMA_FROM_DEVICE);
+	dma_unmap_sg(dd->dev, dd->req->src, dd->nents, DMA_TO_DEVICE);
+}
 
-		err = dma_map_sg(dd->dev, dd->out_sg, 1, DMA_FROM_DEVICE);
-		if (!err) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-			return -EINVAL;
-		}
+static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
+{
+	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(
+					crypto_ablkcipher_reqtfm(dd->req));
+	size_t count;
+	dma_addr_t addr_in, addr_out;
 
-		addr_in = sg_dma_address(dd->in_sg);
-		addr_out = sg_dma_address(dd->out_sg);
+	pr_debug("total: %d\n", dd->total);
 
-		dd->flags |= FLAGS_FAST;
+	if (dd->flags & FLAGS_FAST) {
+		count = min_t(size_t, dd->total, sg_dma_len(dd->in_sg));
 
+		addr_in = sg_dma_address(dd->in_sg);
+		addr_out = sg_dma_address(dd->out_sg);
 	} else {
 		/* use cache buffers */
 		count = sg_copy(&dd->in_sg, &dd->in_offset, dd->buf_in,
@@ -524,30 +554,19 @@ static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 
 		addr_in = dd->dma_addr_in;
 		addr_out = dd->dma_addr_out;
-
-		dd->flags &= ~FLAGS_FAST;
-
 	}
 
 	dd->total -= count;
 
-	err = omap_aes_crypt_dma(tfm, addr_in, addr_out, count);
-	if (err) {
-		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_TO_DEVICE);
-	}
-
-	return err;
+	return omap_aes_crypt_dma(tfm, addr_in, addr_out, count);
 }
 
-static void omap_aes_finish_req(struct omap_aes_dev *dd, int err)
+static void omap_aes_finish_req(struct omap_aes_dev *dd,
+				struct ablkcipher_request *req, int err)
 {
-	struct ablkcipher_request *req = dd->req;
-
 	pr_debug("err: %d\n", err);
 
 	clk_disable(dd->iclk);
-	dd->flags &= ~FLAGS_BUSY;
 
 	req->base.complete(&req->base, err);
 }
@@ -565,8 +584,8 @@ static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
 	omap_stop_dma(dd->dma_lch_out);
 
 	if (dd->flags & FLAGS_FAST) {
-		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_FROM_DEVICE);
-		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
+		dd->in_sg = sg_next(dd->in_sg);
+		dd->out_sg = sg_next(dd->out_sg);
 	} else {
 		dma_sync_single_for_device(dd->dev, dd->dma_addr_out,
 					   dd->dma_size, DMA_FROM_DEVICE);
@@ -630,11 +649,15 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	ctx->dd = dd;
 
 	err = omap_aes_write_ctrl(dd);
+	if (!err)
+		err = omap_aes_dma_map(dd);
 	if (!err)
 		err = omap_aes_crypt_dma_start(dd);
 	if (err) {
 		/* aes_task will not finish it, so do it here */
-		omap_aes_finish_req(dd, err);
+		omap_aes_dma_unmap(dd);
+		dd->flags &= ~FLAGS_BUSY;
+		omap_aes_finish_req(dd, req, err);
 		tasklet_schedule(&dd->queue_task);
 	}
 
@@ -644,6 +667,7 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 static void omap_aes_done_task(unsigned long data)
 {
 	struct omap_aes_dev *dd = (struct omap_aes_dev *)data;
+	struct ablkcipher_request *req = dd->req;
 	int err;
 
 	pr_debug("enter\n");
@@ -658,8 +682,16 @@ static void omap_aes_done_task(unsigned long data)
 			return; /* DMA started. Not fininishing. */
 	}
 
-	omap_aes_finish_req(dd, err);
+	omap_aes_dma_unmap(dd);
+
+	/*
+	 * Start the next queued request before completing this one, so the
+	 * engine works while the owner of the request (dm-crypt, typically)
+	 * processes the result and queues more.
+	 */
+	dd->flags &= ~FLAGS_BUSY;
 	omap_aes_handle_queue(dd, NULL);
+	omap_aes_finish_req(dd, req, err);
 
 	pr_debug("exit\n");
 }
@@ -0,0 +1,1102 @@
+/*
+ * OMAP sDMA DMAengine support
+ *
+ * Copyright (C) 2012 Texas Instruments
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The channels here are virtual: a logical channel is only taken from the
+ * pool shared with the legacy arch/arm/plat-omap/dma.c clients while a
+ * channel has descriptors in flight, and handed back as soon as it goes
+ * idle.  Idle memcpy channels held by net_dma or async_tx therefore do not
+ * starve omap-serial, mcspi, omap_hsmmc and friends.
+ */
+#include <linux/debugfs.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/omap-dma.h>
+#include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+
+#include <plat/dma.h>
+
+#include "dmaengine.h"
+
+#define OMAP_DMA_CHANNELS	32
+/* element (CEN) and frame (CFN) counters are 24 and 16 bits wide */
+#define OMAP_DMA_MAX_EN		0xffffff
+#define OMAP_DMA_MAX_FN		0xffff
+/* how soon to look again for a free logical channel */
+#define OMAP_DMA_RETRY_MS	2
+
+#define OMAP_DMA_ERR_IRQS	(OMAP2_DMA_TRANS_ERR_IRQ | \
+				 OMAP2_DMA_SECURE_ERR_IRQ | \
+				 OMAP2_DMA_SUPERVISOR_ERR_IRQ | \
+				 OMAP2_DMA_MISALIGNED_ERR_IRQ)
+
+struct omap_dmadev {
+	struct dma_device	ddev;
+	spinlock_t		lock;
+	/* channels waiting for a logical channel, protected by lock */
+	struct list_head	pending;
+	struct timer_list	retry;
+	struct dentry		*debugfs;
+};
+
+struct omap_sg {
+	dma_addr_t		addr;	/* memory side; source for memcpy */
+	dma_addr_t		dst;	/* memcpy destination */
+	u32			en;	/* elements per frame */
+	u32			fn;	/* frames */
+};
+
+struct omap_desc {
+	struct dma_async_tx_descriptor tx;
+	struct list_head	node;
+
+	enum dma_transfer_direction dir;
+	dma_addr_t		dev_addr;
+	bool			cyclic;
+	size_t			period_len;
+	size_t			size;
+
+	u16			fi;	/* packet size, for packet sync */
+	u8			es;	/* OMAP_DMA_DATA_TYPE_xxx */
+	u8			sync_mode;
+	u8			sync_type;
+	unsigned		sglen;
+	struct omap_sg		sg[0];
+};
+
+struct omap_chan {
+	struct dma_chan		chan;
+	struct tasklet_struct	task;
+	struct dma_slave_config	cfg;
+	unsigned		dma_sig;
+
+	/* protected by omap_dmadev lock */
+	struct list_head	node;
+
+	spinlock_t		lock;
+
+	/* protected by lock */
+	struct list_head	desc_submitted;
+	struct list_head	desc_issued;
+	struct list_head	desc_completed;
+	struct list_head	desc_unacked;
+	struct omap_desc	*desc;		/* the one on the hardware */
+	unsigned		sgidx;
+	unsigned		periods;	/* cyclic periods not reported */
+	int			dma_ch;		/* logical channel or -1 */
+	bool			linked;		/* dma_ch linked to itself */
+	bool			paused;
+
+	/* statistics, protected by lock */
+	u64			stat_bytes;
+	unsigned long		stat_descs;
+	unsigned long		stat_waits;	/* no logical channel free */
+	u64			busy_ns;
+	u64			busy_since;	/* 0 while idle */
+	u64			stats_since;
+};
+
+static const unsigned es_bytes[] = {
+	[OMAP_DMA_DATA_TYPE_S8] = 1,
+	[OMAP_DMA_DATA_TYPE_S16] = 2,
+	[OMAP_DMA_DATA_TYPE_S32] = 4,
+};
+
+static struct omap_dmadev *to_omap_dma_dev(struct dma_device *d)
+{
+	return container_of(d, struct omap_dmadev, ddev);
+}
+
+static struct omap_chan *to_omap_dma_chan(struct dma_chan *c)
+{
+	return container_of(c, struct omap_chan, chan);
+}
+
+static struct omap_desc *to_omap_dma_desc(struct dma_async_tx_descriptor *t)
+{
+	return container_of(t, struct omap_desc, tx);
+}
+
+static u64 omap_dma_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static void omap_dma_desc_free(struct list_head *head)
+{
+	struct omap_desc *d, *n;
+
+	list_for_each_entry_safe(d, n, head, node) {
+		list_del(&d->node);
+		kfree(d);
+	}
+}
+
+/* memcpy clients hand over mapped buffers, as with the other engines */
+static void omap_dma_unmap(struct omap_chan *c, struct omap_desc *d)
+{
+	struct device *dev = c->chan.device->dev;
+	unsigned long flags = d->tx.flags;
+
+	if (d->dir != DMA_MEM_TO_MEM)
+		return;
+
+	if (!(flags & DMA_COMPL_SKIP_DEST_UNMAP)) {
+		if (flags & DMA_COMPL_DEST_UNMAP_SINGLE)
+			dma_unmap_single(dev, d->sg[0].dst, d->size,
+					 DMA_FROM_DEVICE);
+		else
+			dma_unmap_page(dev, d->sg[0].dst, d->size,
+				       DMA_FROM_DEVICE);
+	}
+	if (!(flags & DMA_COMPL_SKIP_SRC_UNMAP)) {
+		if (flags & DMA_COMPL_SRC_UNMAP_SINGLE)
+			dma_unmap_single(dev, d->sg[0].addr, d->size,
+					 DMA_TO_DEVICE);
+		else
+			dma_unmap_page(dev, d->sg[0].addr, d->size,
+				       DMA_TO_DEVICE);
+	}
+}
+
+static void omap_dma_callback(int lch, u16 ch_status, void *data);
+
+static void omap_dma_kick_pending(struct omap_dmadev *od)
+{
+	struct omap_chan *c, *n;
+	unsigned long flags;
+
+	spin_lock_irqsave(&od->lock, flags);
+	list_for_each_entry_safe(c, n, &od->pending, node) {
+		list_del_init(&c->node);
+		tasklet_schedule(&c->task);
+	}
+	spin_unlock_irqrestore(&od->lock, flags);
+}
+
+static void omap_dma_retry(unsigned long arg)
+{
+	omap_dma_kick_pending((struct omap_dmadev *)arg);
+}
+
+/* called with c->lock held */
+static int omap_dma_get_lch(struct omap_chan *c)
+{
+	struct omap_dmadev *od = to_omap_dma_dev(c->chan.device);
+	int r;
+
+	r = omap_request_dma(c->dma_sig, dma_chan_name(&c->chan),
+			     omap_dma_callback, c, &c->dma_ch);
+	if (!r)
+		return 0;
+
+	/* the pool is shared with the legacy clients, so poll for it */
+	c->dma_ch = -1;
+	c->stat_waits++;
+	spin_lock(&od->lock);
+	if (list_empty(&c->node))
+		list_add_tail(&c->node, &od->pending);
+	spin_unlock(&od->lock);
+	mod_timer(&od->retry, jiffies + msecs_to_jiffies(OMAP_DMA_RETRY_MS));
+
+	return r;
+}
+
+/* called with c->lock held, the logical channel must be stopped */
+static int omap_dma_release_lch(struct omap_chan *c)
+{
+	int lch = c->dma_ch;
+
+	if (lch < 0)
+		return -1;
+
+	if (c->linked) {
+		omap_dma_unlink_lch(lch, lch);
+		c->linked = false;
+	}
+	c->dma_ch = -1;
+
+	return lch;
+}
+
+static void omap_dma_put_lch(struct omap_dmadev *od, int lch)
+{
+	if (lch < 0)
+		return;
+
+	omap_free_dma(lch);
+	omap_dma_kick_pending(od);
+}
+
+static void omap_dma_start_sg(struct omap_chan *c, struct omap_desc *d,
+	unsigned idx)
+{
+	struct omap_sg *sg = &d->sg[idx];
+	int lch = c->dma_ch;
+
+	switch (d->dir) {
+	case DMA_DEV_TO_MEM:
+		omap_set_dma_dest_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+					 sg->addr, 0, 0);
+		break;
+	case DMA_MEM_TO_DEV:
+		omap_set_dma_src_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+					sg->addr, 0, 0);
+		break;
+	default:
+		omap_set_dma_src_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+					sg->addr, 0, 0);
+		omap_set_dma_dest_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+					 sg->dst, 0, 0);
+		break;
+	}
+
+	omap_set_dma_transfer_params(lch, d->es, sg->en, sg->fn, d->sync_mode,
+				     c->dma_sig, d->sync_type);
+	omap_start_dma(lch);
+}
+
+/*
+ * Put the next issued descriptor on the hardware.  Called with c->lock
+ * held, from the completion interrupt too, so that queued descriptors run
+ * back to back without a trip through the tasklet.
+ */
+static void omap_dma_start_desc(struct omap_chan *c)
+{
+	struct omap_desc *d;
+	int lch;
+
+	if (list_empty(&c->desc_issued) || c->paused) {
+		if (c->busy_since) {
+			c->busy_ns += omap_dma_now() - c->busy_since;
+			c->busy_since = 0;
+		}
+		return;
+	}
+
+	if (c->dma_ch < 0 && omap_dma_get_lch(c))
+		return;
+	lch = c->dma_ch;
+
+	d = list_first_entry(&c->desc_issued, struct omap_desc, node);
+	list_del(&d->node);
+	c->desc = d;
+	c->sgidx = 0;
+	if (!c->busy_since)
+		c->busy_since = omap_dma_now();
+
+	switch (d->dir) {
+	case DMA_DEV_TO_MEM:
+		omap_set_dma_src_params(lch, 0, OMAP_DMA_AMODE_CONSTANT,
+					d->dev_addr, 0, d->fi);
+		omap_set_dma_src_burst_mode(lch, OMAP_DMA_DATA_BURST_DIS);
+		omap_set_dma_dest_burst_mode(lch, OMAP_DMA_DATA_BURST_16);
+		omap_set_dma_dest_data_pack(lch, 1);
+		break;
+	case DMA_MEM_TO_DEV:
+		omap_set_dma_dest_params(lch, 0, OMAP_DMA_AMODE_CONSTANT,
+					 d->dev_addr, 0, d->fi);
+		omap_set_dma_dest_burst_mode(lch, OMAP_DMA_DATA_BURST_DIS);
+		omap_set_dma_src_burst_mode(lch, OMAP_DMA_DATA_BURST_16);
+		omap_set_dma_src_data_pack(lch, 1);
+		break;
+	default:
+		omap_set_dma_src_burst_mode(lch, OMAP_DMA_DATA_BURST_16);
+		omap_set_dma_dest_burst_mode(lch, OMAP_DMA_DATA_BURST_16);
+		omap_set_dma_src_data_pack(lch, 1);
+		omap_set_dma_dest_data_pack(lch, 1);
+		break;
+	}
+
+	if (d->cyclic) {
+		/* the channel reloads itself, every frame is a period */
+		omap_dma_link_lch(lch, lch);
+		c->linked = true;
+		omap_enable_dma_irq(lch, OMAP_DMA_FRAME_IRQ);
+		omap_disable_dma_irq(lch, OMAP_DMA_BLOCK_IRQ);
+	} else {
+		omap_disable_dma_irq(lch, OMAP_DMA_FRAME_IRQ);
+		omap_enable_dma_irq(lch, OMAP_DMA_BLOCK_IRQ);
+	}
+
+	omap_dma_start_sg(c, d, 0);
+}
+
+static void omap_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_chan *c = data;
+	struct omap_desc *d;
+
+	spin_lock(&c->lock);
+
+	d = c->desc;
+	if (!d || lch != c->dma_ch)
+		goto out;
+
+	if ((ch_status & OMAP_DMA_ERR_IRQS) && printk_ratelimit())
+		dev_err(c->chan.device->dev, "%s: error %04x on lch %d\n",
+			dma_chan_name(&c->chan), ch_status, lch);
+
+	if (d->cyclic) {
+		if (ch_status & OMAP_DMA_FRAME_IRQ) {
+			c->periods++;
+			c->stat_bytes += d->period_len;
+			tasklet_schedule(&c->task);
+		}
+		goto out;
+	}
+
+	if (!(ch_status & (OMAP_DMA_BLOCK_IRQ | OMAP_DMA_ERR_IRQS)))
+		goto out;
+
+	/* software-linked sg entries */
+	if (++c->sgidx < d->sglen && !(ch_status & OMAP_DMA_ERR_IRQS)) {
+		omap_dma_start_sg(c, d, c->sgidx);
+		goto out;
+	}
+
+	if (ch_status & OMAP_DMA_ERR_IRQS)
+		omap_stop_dma(lch);
+
+	dma_cookie_complete(&d->tx);
+	list_add_tail(&d->node, &c->desc_completed);
+	c->desc = NULL;
+	c->stat_descs++;
+	c->stat_bytes += d->size;
+
+	omap_dma_start_desc(c);
+	tasklet_schedule(&c->task);
+out:
+	spin_unlock(&c->lock);
+}
+
+/*
+ * Runs the client callbacks, hands an idle logical channel back to the
+ * pool, and starts the channel again once it got one after waiting.
+ */
+static void omap_dma_tasklet(unsigned long arg)
+{
+	struct omap_chan *c = (struct omap_chan *)arg;
+	struct omap_dmadev *od = to_omap_dma_dev(c->chan.device);
+	dma_async_tx_callback cyclic_cb = NULL;
+	void *cyclic_param = NULL;
+	unsigned periods = 0;
+	struct omap_desc *d, *n;
+	unsigned long flags;
+	LIST_HEAD(head);
+	LIST_HEAD(acked);
+	int lch = -1;
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_splice_tail_init(&c->desc_completed, &head);
+
+	if (c->desc && c->desc->cyclic) {
+		periods = c->periods;
+		c->periods = 0;
+		cyclic_cb = c->desc->tx.callback;
+		cyclic_param = c->desc->tx.callback_param;
+	}
+
+	if (!c->desc)
+		omap_dma_start_desc(c);
+	if (!c->desc)
+		lch = omap_dma_release_lch(c);
+
+	list_for_each_entry_safe(d, n, &c->desc_unacked, node)
+		if (async_tx_test_ack(&d->tx))
+			list_move_tail(&d->node, &acked);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	omap_dma_put_lch(od, lch);
+	omap_dma_desc_free(&acked);
+
+	while (cyclic_cb && periods--)
+		cyclic_cb(cyclic_param);
+
+	list_for_each_entry_safe(d, n, &head, node) {
+		list_del(&d->node);
+		omap_dma_unmap(c, d);
+
+		if (d->tx.callback)
+			d->tx.callback(d->tx.callback_param);
+		dma_run_dependencies(&d->tx);
+
+		if (async_tx_test_ack(&d->tx)) {
+			kfree(d);
+		} else {
+			spin_lock_irqsave(&c->lock, flags);
+			list_add_tail(&d->node, &c->desc_unacked);
+			spin_unlock_irqrestore(&c->lock, flags);
+		}
+	}
+}
+
+static int omap_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	unsigned long flags;
+
+	dev_dbg(chan->device->dev, "%s: sig %u\n", dma_chan_name(chan),
+		c->dma_sig);
+
+	spin_lock_irqsave(&c->lock, flags);
+	c->stat_bytes = 0;
+	c->stat_descs = 0;
+	c->stat_waits = 0;
+	c->busy_ns = 0;
+	c->busy_since = 0;
+	c->stats_since = omap_dma_now();
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return 0;
+}
+
+static int omap_dma_terminate_all(struct omap_chan *c)
+{
+	struct omap_dmadev *od = to_omap_dma_dev(c->chan.device);
+	unsigned long flags;
+	LIST_HEAD(head);
+	int lch;
+
+	spin_lock_irqsave(&c->lock, flags);
+
+	list_splice_tail_init(&c->desc_submitted, &head);
+	list_splice_tail_init(&c->desc_issued, &head);
+	if (c->desc) {
+		omap_stop_dma(c->dma_ch);
+		list_add_tail(&c->desc->node, &head);
+		c->desc = NULL;
+	}
+	c->periods = 0;
+	c->paused = false;
+	if (c->busy_since) {
+		c->busy_ns += omap_dma_now() - c->busy_since;
+		c->busy_since = 0;
+	}
+	lch = omap_dma_release_lch(c);
+
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	omap_dma_put_lch(od, lch);
+	omap_dma_desc_free(&head);
+
+	return 0;
+}
+
+static void omap_dma_free_chan_resources(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_dmadev *od = to_omap_dma_dev(chan->device);
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	omap_dma_terminate_all(c);
+	tasklet_kill(&c->task);
+
+	spin_lock_irqsave(&od->lock, flags);
+	list_del_init(&c->node);
+	spin_unlock_irqrestore(&od->lock, flags);
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_splice_tail_init(&c->desc_completed, &head);
+	list_splice_tail_init(&c->desc_unacked, &head);
+	spin_unlock_irqrestore(&c->lock, flags);
+	omap_dma_desc_free(&head);
+
+	c->dma_sig = OMAP_DMA_NO_DEVICE;
+	dev_dbg(chan->device->dev, "%s: freed\n", dma_chan_name(chan));
+}
+
+static size_t omap_dma_active_residue(struct omap_chan *c,
+	struct omap_desc *d)
+{
+	unsigned esb = es_bytes[d->es];
+	size_t residue = 0;
+	dma_addr_t pos;
+	unsigned i;
+
+	if (d->dir == DMA_DEV_TO_MEM)
+		pos = omap_get_dma_dst_pos(c->dma_ch);
+	else
+		pos = omap_get_dma_src_pos(c->dma_ch);
+
+	for (i = c->sgidx; i < d->sglen; i++) {
+		struct omap_sg *sg = &d->sg[i];
+		size_t size = sg->en * sg->fn * esb;
+
+		if (i == c->sgidx && pos >= sg->addr && pos < sg->addr + size)
+			residue += sg->addr + size - pos;
+		else
+			residue += size;
+	}
+
+	return residue;
+}
+
+static enum dma_status omap_dma_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_desc *d;
+	enum dma_status ret;
+	unsigned long flags;
+	size_t residue = 0;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS)
+		return ret;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if (c->desc && c->desc->tx.cookie == cookie) {
+		residue = omap_dma_active_residue(c, c->desc);
+		if (c->paused)
+			ret = DMA_PAUSED;
+	} else {
+		list_for_each_entry(d, &c->desc_issued, node)
+			if (d->tx.cookie == cookie)
+				residue = d->size;
+		list_for_each_entry(d, &c->desc_submitted, node)
+			if (d->tx.cookie == cookie)
+				residue = d->size;
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	dma_set_residue(txstate, residue);
+
+	return ret;
+}
+
+static void omap_dma_issue_pending(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_splice_tail_init(&c->desc_submitted, &c->desc_issued);
+	if (!c->desc)
+		omap_dma_start_desc(c);
+	spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static dma_cookie_t omap_dma_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct omap_chan *c = to_omap_dma_chan(tx->chan);
+	struct omap_desc *d = to_omap_dma_desc(tx);
+	dma_cookie_t cookie;
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	cookie = dma_cookie_assign(tx);
+	list_add_tail(&d->node, &c->desc_submitted);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return cookie;
+}
+
+static struct omap_desc *omap_dma_desc_alloc(struct omap_chan *c,
+	unsigned sglen, unsigned long flags)
+{
+	struct omap_desc *d;
+
+	d = kzalloc(sizeof(*d) + sglen * sizeof(d->sg[0]), GFP_ATOMIC);
+	if (!d)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&d->tx, &c->chan);
+	d->tx.tx_submit = omap_dma_tx_submit;
+	d->tx.flags = flags;
+	d->sglen = sglen;
+
+	return d;
+}
+
+static int omap_dma_slave_params(struct omap_chan *c,
+	enum dma_transfer_direction dir, dma_addr_t *dev_addr, unsigned *es,
+	u32 *burst, u8 *sync_type)
+{
+	enum dma_slave_buswidth width;
+
+	if (dir == DMA_DEV_TO_MEM) {
+		*dev_addr = c->cfg.src_addr;
+		width = c->cfg.src_addr_width;
+		*burst = c->cfg.src_maxburst;
+		*sync_type = OMAP_DMA_SRC_SYNC;
+	} else if (dir == DMA_MEM_TO_DEV) {
+		*dev_addr = c->cfg.dst_addr;
+		width = c->cfg.dst_addr_width;
+		*burst = c->cfg.dst_maxburst;
+		*sync_type = OMAP_DMA_DST_SYNC;
+	} else {
+		return -EINVAL;
+	}
+
+	switch (width) {
+	case DMA_SLAVE_BUSWIDTH_1_BYTE:
+		*es = OMAP_DMA_DATA_TYPE_S8;
+		break;
+	case DMA_SLAVE_BUSWIDTH_2_BYTES:
+		*es = OMAP_DMA_DATA_TYPE_S16;
+		break;
+	case DMA_SLAVE_BUSWIDTH_4_BYTES:
+		*es = OMAP_DMA_DATA_TYPE_S32;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!*burst)
+		*burst = 1;
+
+	return 0;
+}
+
+static struct dma_async_tx_descriptor *omap_dma_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned sglen,
+	enum dma_transfer_direction dir, unsigned long tx_flags, void *context)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct scatterlist *sgent;
+	struct omap_desc *d;
+	dma_addr_t dev_addr;
+	unsigned i, es, frame_bytes;
+	u32 burst;
+	u8 sync_type;
+
+	if (omap_dma_slave_params(c, dir, &dev_addr, &es, &burst,
+				  &sync_type)) {
+		dev_err(chan->device->dev, "%s: bad slave config\n",
+			dma_chan_name(chan));
+		return NULL;
+	}
+
+	d = omap_dma_desc_alloc(c, sglen, tx_flags);
+	if (!d)
+		return NULL;
+
+	d->dir = dir;
+	d->dev_addr = dev_addr;
+	d->es = es;
+	d->sync_type = sync_type;
+	/* every DMA request moves one frame of maxburst elements */
+	d->sync_mode = OMAP_DMA_SYNC_FRAME;
+	frame_bytes = es_bytes[es] * burst;
+
+	for_each_sg(sgl, sgent, sglen, i) {
+		unsigned len = sg_dma_len(sgent);
+
+		if (len % frame_bytes || len / frame_bytes > OMAP_DMA_MAX_FN) {
+			dev_err(chan->device->dev,
+				"%s: sg entry %u of %u bytes not supported\n",
+				dma_chan_name(chan), i, len);
+			kfree(d);
+			return NULL;
+		}
+
+		d->sg[i].addr = sg_dma_address(sgent);
+		d->sg[i].en = burst;
+		d->sg[i].fn = len / frame_bytes;
+		d->size += len;
+	}
+
+	return &d->tx;
+}
+
+static struct dma_async_tx_descriptor *omap_dma_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction dir, void *context)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_desc *d;
+	dma_addr_t dev_addr;
+	unsigned es;
+	u32 burst;
+	u8 sync_type;
+
+	if (omap_dma_slave_params(c, dir, &dev_addr, &es, &burst,
+				  &sync_type)) {
+		dev_err(chan->device->dev, "%s: bad slave config\n",
+			dma_chan_name(chan));
+		return NULL;
+	}
+
+	if (!period_len || period_len % es_bytes[es] ||
+	    buf_len % period_len ||
+	    period_len / es_bytes[es] > OMAP_DMA_MAX_EN ||
+	    buf_len / period_len > OMAP_DMA_MAX_FN) {
+		dev_err(chan->device->dev, "%s: bad cyclic buffer %zu/%zu\n",
+			dma_chan_name(chan), buf_len, period_len);
+		return NULL;
+	}
+
+	d = omap_dma_desc_alloc(c, 1, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!d)
+		return NULL;
+
+	d->dir = dir;
+	d->dev_addr = dev_addr;
+	d->cyclic = true;
+	d->period_len = period_len;
+	d->size = buf_len;
+	d->es = es;
+	d->sync_type = sync_type;
+	if (burst > 1) {
+		d->sync_mode = OMAP_DMA_SYNC_PACKET;
+		d->fi = burst;
+	} else {
+		d->sync_mode = OMAP_DMA_SYNC_ELEMENT;
+	}
+
+	d->sg[0].addr = buf_addr;
+	d->sg[0].en = period_len / es_bytes[es];
+	d->sg[0].fn = buf_len / period_len;
+
+	return &d->tx;
+}
+
+static struct dma_async_tx_descriptor *omap_dma_prep_dma_memcpy(
+	struct dma_chan *chan, dma_addr_t dest, dma_addr_t src, size_t len,
+	unsigned long tx_flags)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_desc *d;
+	unsigned es, i, count, sglen;
+	size_t off = 0;
+
+	if (!len)
+		return NULL;
+
+	if (!((dest | src | len) & 3))
+		es = OMAP_DMA_DATA_TYPE_S32;
+	else if (!((dest | src | len) & 1))
+		es = OMAP_DMA_DATA_TYPE_S16;
+	else
+		es = OMAP_DMA_DATA_TYPE_S8;
+
+	count = len / es_bytes[es];
+	sglen = DIV_ROUND_UP(count, OMAP_DMA_MAX_EN);
+
+	d = omap_dma_desc_alloc(c, sglen, tx_flags);
+	if (!d)
+		return NULL;
+
+	d->dir = DMA_MEM_TO_MEM;
+	d->size = len;
+	d->es = es;
+	d->sync_mode = OMAP_DMA_SYNC_ELEMENT;
+	d->sync_type = OMAP_DMA_DST_SYNC;
+
+	for (i = 0; i < sglen; i++) {
+		u32 en = min_t(u32, count, OMAP_DMA_MAX_EN);
+
+		d->sg[i].addr = src + off;
+		d->sg[i].dst = dest + off;
+		d->sg[i].en = en;
+		d->sg[i].fn = 1;
+		off += en * es_bytes[es];
+		count -= en;
+	}
+
+	return &d->tx;
+}
+
+static int omap_dma_pause(struct omap_chan *c)
+{
+	unsigned long flags;
+	int ret = -EINVAL;
+
+	/* only cyclic transfers can be stopped and restarted in place */
+	spin_lock_irqsave(&c->lock, flags);
+	if (c->desc && c->desc->cyclic) {
+		if (!c->paused) {
+			omap_stop_dma(c->dma_ch);
+			c->paused = true;
+		}
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return ret;
+}
+
+static int omap_dma_resume(struct omap_chan *c)
+{
+	unsigned long flags;
+	int ret = -EINVAL;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if (c->desc && c->desc->cyclic) {
+		if (c->paused) {
+			omap_start_dma(c->dma_ch);
+			c->paused = false;
+		}
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return ret;
+}
+
+static int omap_dma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+	unsigned long arg)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+
+	switch (cmd) {
+	case DMA_SLAVE_CONFIG:
+		c->cfg = *(struct dma_slave_config *)arg;
+		return 0;
+
+	case DMA_TERMINATE_ALL:
+		return omap_dma_terminate_all(c);
+
+	case DMA_PAUSE:
+		return omap_dma_pause(c);
+
+	case DMA_RESUME:
+		return omap_dma_resume(c);
+
+	default:
+		return -ENXIO;
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int omap_dma_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_dmadev *od = s->private;
+	struct dma_chan *chan;
+	u64 now = omap_dma_now();
+
+	seq_printf(s, "%-16s %4s %4s %10s %14s %8s %6s\n", "channel", "sig",
+		   "lch", "descs", "bytes", "waits", "util%");
+
+	list_for_each_entry(chan, &od->ddev.channels, device_node) {
+		struct omap_chan *c = to_omap_dma_chan(chan);
+		unsigned long flags;
+		u64 busy, total;
+		unsigned util = 0;
+
+		if (!chan->client_count)
+			continue;
+
+		spin_lock_irqsave(&c->lock, flags);
+		busy = c->busy_ns;
+		if (c->busy_since)
+			busy += now - c->busy_since;
+		total = now - c->stats_since;
+		if (total >= 100)
+			util = div64_u64(busy, div_u64(total, 100));
+
+		seq_printf(s, "%-16s %4u %4d %10lu %14llu %8lu %6u\n",
+			   dma_chan_name(chan), c->dma_sig, c->dma_ch,
+			   c->stat_descs, c->stat_bytes, c->stat_waits, util);
+		spin_unlock_irqrestore(&c->lock, flags);
+	}
+
+	return 0;
+}
+
+static int omap_dma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_dma_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap_dma_stats_fops = {
+	.open = omap_dma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void omap_dma_debugfs_init(struct omap_dmadev *od)
+{
+	od->debugfs = debugfs_create_dir("omap-dma", NULL);
+	if (IS_ERR_OR_NULL(od->debugfs)) {
+		od->debugfs = NULL;
+		return;
+	}
+	debugfs_create_file("stats", S_IRUGO, od->debugfs, od,
+			    &omap_dma_stats_fops);
+}
+
+static void omap_dma_debugfs_exit(struct omap_dmadev *od)
+{
+	debugfs_remove_recursive(od->debugfs);
+}
+#else
+static inline void omap_dma_debugfs_init(struct omap_dmadev *od) { }
+static inline void omap_dma_debugfs_exit(struct omap_dmadev *od) { }
+#endif
+
+static int omap_dma_chan_init(struct omap_dmadev *od)
+{
+	struct omap_chan *c;
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+
+	c->chan.device = &od->ddev;
+	c->dma_sig = OMAP_DMA_NO_DEVICE;
+	c->dma_ch = -1;
+	spin_lock_init(&c->lock);
+	INIT_LIST_HEAD(&c->node);
+	INIT_LIST_HEAD(&c->desc_submitted);
+	INIT_LIST_HEAD(&c->desc_issued);
+	INIT_LIST_HEAD(&c->desc_completed);
+	INIT_LIST_HEAD(&c->desc_unacked);
+	tasklet_init(&c->task, omap_dma_tasklet, (unsigned long)c);
+	dma_cookie_init(&c->chan);
+
+	list_add_tail(&c->chan.device_node, &od->ddev.channels);
+
+	return 0;
+}
+
+static void omap_dma_free(struct omap_dmadev *od)
+{
+	del_timer_sync(&od->retry);
+
+	while (!list_empty(&od->ddev.channels)) {
+		struct omap_chan *c = list_first_entry(&od->ddev.channels,
+			struct omap_chan, chan.device_node);
+
+		list_del(&c->chan.device_node);
+		tasklet_kill(&c->task);
+		kfree(c);
+	}
+	kfree(od);
+}
+
+static int __devinit omap_dma_probe(struct platform_device *pdev)
+{
+	struct omap_dmadev *od;
+	int rc, i;
+
+	od = kzalloc(sizeof(*od), GFP_KERNEL);
+	if (!od)
+		return -ENOMEM;
+
+	dma_cap_set(DMA_SLAVE, od->ddev.cap_mask);
+	dma_cap_set(DMA_CYCLIC, od->ddev.cap_mask);
+	dma_cap_set(DMA_MEMCPY, od->ddev.cap_mask);
+	od->ddev.device_alloc_chan_resources = omap_dma_alloc_chan_resources;
+	od->ddev.device_free_chan_resources = omap_dma_free_chan_resources;
+	od->ddev.device_tx_status = omap_dma_tx_status;
+	od->ddev.device_issue_pending = omap_dma_issue_pending;
+	od->ddev.device_prep_slave_sg = omap_dma_prep_slave_sg;
+	od->ddev.device_prep_dma_cyclic = omap_dma_prep_dma_cyclic;
+	od->ddev.device_prep_dma_memcpy = omap_dma_prep_dma_memcpy;
+	od->ddev.device_control = omap_dma_control;
+	od->ddev.copy_align = 0;
+	od->ddev.dev = &pdev->dev;
+	INIT_LIST_HEAD(&od->ddev.channels);
+	INIT_LIST_HEAD(&od->pending);
+	spin_lock_init(&od->lock);
+	setup_timer(&od->retry, omap_dma_retry, (unsigned long)od);
+
+	for (i = 0; i < OMAP_DMA_CHANNELS; i++) {
+		rc = omap_dma_chan_init(od);
+		if (rc) {
+			omap_dma_free(od);
+			return rc;
+		}
+	}
+
+	rc = dma_async_device_register(&od->ddev);
+	if (rc) {
+		pr_warn("OMAP-DMA: failed to register slave DMA engine device: %d\n",
+			rc);
+		omap_dma_free(od);
+		return rc;
+	}
+
+	platform_set_drvdata(pdev, od);
+	omap_dma_debugfs_init(od);
+
+	dev_info(&pdev->dev, "OMAP DMA engine driver\n");
+
+	return 0;
+}
+
+static int __devexit omap_dma_remove(struct platform_device *pdev)
+{
+	struct omap_dmadev *od = platform_get_drvdata(pdev);
+
+	omap_dma_debugfs_exit(od);
+	dma_async_device_unregister(&od->ddev);
+	omap_dma_free(od);
+
+	return 0;
+}
+
+static struct platform_driver omap_dma_driver = {
+	.probe	= omap_dma_probe,
+	.remove	= __devexit_p(omap_dma_remove),
+	.driver = {
+		.name = "omap-dma-engine",
+		.owner = THIS_MODULE,
+	},
+};
+
+bool omap_dma_filter_fn(struct dma_chan *chan, void *param)
+{
+	if (chan->device->dev->driver == &omap_dma_driver.driver) {
+		struct omap_chan *c = to_omap_dma_chan(chan);
+		unsigned req = *(unsigned *)param;
+
+		c->dma_sig = req;
+		return true;
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(omap_dma_filter_fn);
+
+static struct platform_device *pdev;
+
+static const struct platform_device_info omap_dma_dev_info = {
+	.name = "omap-dma-engine",
+	.id = -1,
+	.dma_mask = DMA_BIT_MASK(32),
+};
+
+static int omap_dma_init(void)
+{
+	int rc = platform_driver_register(&omap_dma_driver);
+
+	if (rc == 0) {
+		pdev = platform_device_register_full(&omap_dma_dev_info);
+		if (IS_ERR(pdev)) {
+			platform_driver_unregister(&omap_dma_driver);
+			rc = PTR_ERR(pdev);
+		}
+	}
+	return rc;
+}
+subsys_initcall(omap_dma_init);
+
+static void __exit omap_dma_exit(void)
+{
+	platform_device_unregister(pdev);
+	platform_driver_unregister(&omap_dma_driver);
+}
+module_exit(omap_dma_exit);
+
+MODULE_DESCRIPTION("OMAP sDMA DMAengine driver");
+MODULE_LICENSE("GPL v2");
@@ -28,6 +28,8 @@
 #include <linux/gpio.h>
 #include <linux/bitops.h>
 #include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <mach/hardware.h>
 #include <asm/irq.h>
 #include <mach/irqs.h>
@@ -55,6 +57,16 @@ struct gpio_regs {
 	u32 debounce_en;
 };
 
+struct gpio_bank_stats {
+	unsigned long irqs;		/* bank interrupts handled */
+	unsigned long events;		/* line interrupts dispatched */
+	unsigned long restores;		/* context restored after loss */
+	unsigned long restores_skipped;	/* context was still there */
+	unsigned long window_start;	/* jiffies, start of rate window */
+	unsigned long window_irqs;
+	unsigned long irq_rate;		/* bank interrupts in last second */
+};
+
 struct gpio_bank {
 	struct list_head node;
 	void __iomem *base;
@@ -89,6 +101,8 @@ struct gpio_bank {
 	bool is_idle;
 	u32 pending_wakeups;
 	u32 wakeup_enabled;
+	bool wake_edges_forced;
+	struct gpio_bank_stats stats;
 
 	void (*set_dataout)(struct gpio_bank *bank, int gpio, int enable);
 	int (*get_context_loss_count)(struct device *dev);
@@ -465,6 +479,24 @@ static u32 _get_gpio_irqbank_mask(struct gpio_bank *bank)
 	return l;
 }
 
+/*
+ * Same as _get_gpio_irqbank_mask(), from the copy kept in the context.
+ * MPUIO lines are masked by the generic irq chip, which does not update
+ * the context, so go to the register for those.
+ */
+static u32 _get_gpio_irqbank_enabled(struct gpio_bank *bank)
+{
+	u32 l = bank->context.irqenable1;
+	u32 mask = (1 << bank->width) - 1;
+
+	if (bank->is_mpuio)
+		return _get_gpio_irqbank_mask(bank);
+
+	if (bank->regs->irqenable_inv)
+		l = ~l;
+	return l & mask;
+}
+
 static void _enable_gpio_irqbank(struct gpio_bank *bank, int gpio_mask)
 {
 	void __iomem *reg = bank->base;
@@ -673,11 +705,20 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 	if (WARN_ON(!isr_reg))
 		goto exit;
 
+	bank->stats.irqs++;
+	if (time_after_eq(jiffies, bank->stats.window_start + HZ)) {
+		bank->stats.irq_rate = bank->stats.window_irqs;
+		bank->stats.window_irqs = 0;
+		bank->stats.window_start = jiffies;
+	}
+	bank->stats.window_irqs++;
+
 	while (1) {
-		u32 isr_saved, level_mask = 0, edge_mask = 0;
+		u32 isr_saved, level_mask = 0, edge_pending;
 		u32 enabled;
 
-		enabled = _get_gpio_irqbank_mask(bank);
+		/* the enable mask only changes under us through the context */
+		enabled = _get_gpio_irqbank_enabled(bank);
 		isr_saved = isr = (__raw_readl(isr_reg) |
 				   bank->pending_wakeups) & enabled;
 
@@ -686,23 +727,21 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 		if (bank->level_mask)
 			level_mask = bank->level_mask & enabled;
 
-		if (bank->edge_mask)
-			edge_mask = bank->edge_mask & enabled;
 		/*
-		 * For level+edge GPIOs, if module is IDLE, a sWakeup event
-		 * is triggered in which case if irq status is not cleared
-		 * immediately the line is not de-asserted preventing the
-		 * module to IDLE further and resulting it in getting stuck
-		 * in transition when disabled
+		 * Mask-clear-unmask the edge sensitive interrupts before the
+		 * handler(s) are called, so that we don't miss any interrupt
+		 * occurring while executing them.  This also clears them
+		 * early enough for level+edge GPIOs: if the module is IDLE a
+		 * sWakeup event is triggered, and the line must be
+		 * de-asserted for the module to IDLE again, or it gets stuck
+		 * in transition when disabled.
 		 */
-		_clear_gpio_irqbank(bank, isr_saved & edge_mask);
-
-		/* clear edge sensitive interrupts before handler(s) are
-		called so that we don't miss any interrupt occurred while
-		executing them */
-		_disable_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_clear_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_enable_gpio_irqbank(bank, isr_saved & ~level_mask);
+		edge_pending = isr_saved & ~level_mask;
+		if (edge_pending) {
+			_disable_gpio_irqbank(bank, edge_pending);
+			_clear_gpio_irqbank(bank, edge_pending);
+			_enable_gpio_irqbank(bank, edge_pending);
+		}
 
 		/* if there is only edge sensitive GPIO pin interrupts
 		configured, we could unmask GPIO bank interrupt immediately */
@@ -714,13 +753,14 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 		if (!isr)
 			break;
 
-		gpio_irq = bank->irq_base;
-		for (; isr != 0; isr >>= 1, gpio_irq++) {
-			int gpio = irq_to_gpio(bank, gpio_irq);
-
-			if (!(isr & 1))
-				continue;
+		/* only visit the lines that are actually pending */
+		while (isr) {
+			int gpio;
 
+			gpio_index = __ffs(isr);
+			isr &= ~(1 << gpio_index);
+			gpio_irq = bank->irq_base + gpio_index;
+			gpio = irq_to_gpio(bank, gpio_irq);
 			gpio_index = GPIO_INDEX(bank, gpio);
 
 			/*
@@ -733,6 +773,7 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 			if (bank->toggle_mask & (1 << gpio_index))
 				_toggle_gpio_edge_triggering(bank, gpio_index);
 
+			bank->stats.events++;
 			generic_handle_irq(gpio_irq);
 		}
 	}
@@ -1017,6 +1058,7 @@ static void omap_gpio_mod_init(struct gpio_bank *bank)
 
 	_gpio_rmw(base, bank->regs->irqenable, l, bank->regs->irqenable_inv);
 	_gpio_rmw(base, bank->regs->irqstatus, l, !bank->regs->irqenable_inv);
+	bank->context.irqenable1 = bank->regs->irqenable_inv ? l : 0;
 	if (bank->regs->debounce_en)
 		__raw_writel(0, base + bank->regs->debounce_en);
 
@@ -1331,6 +1373,7 @@ static int omap_gpio_pm_idle(struct device *dev)
 	if (wake_hi)
 		__raw_writel(wake_hi | bank->context.risingdetect,
 			     bank->base + bank->regs->risingdetect);
+	bank->wake_edges_forced = wake_low || wake_hi;
 
 	if (!bank->enabled_non_wakeup_gpios)
 		goto update_gpio_context_count;
@@ -1398,16 +1441,23 @@ static int omap_gpio_pm_noidle(struct device *dev)
 	 * generate a PRCM wakeup.  Here we restore the
 	 * pre-runtime_suspend() values for edge triggering.
 	 */
-	__raw_writel(bank->context.fallingdetect,
-		     bank->base + bank->regs->fallingdetect);
-	__raw_writel(bank->context.risingdetect,
-		     bank->base + bank->regs->risingdetect);
+	if (bank->wake_edges_forced) {
+		__raw_writel(bank->context.fallingdetect,
+			     bank->base + bank->regs->fallingdetect);
+		__raw_writel(bank->context.risingdetect,
+			     bank->base + bank->regs->risingdetect);
+		bank->wake_edges_forced = false;
+	}
 
 	if (bank->get_context_loss_count) {
 		context_lost_cnt_after =
 			bank->get_context_loss_count(bank->dev);
-		if (context_lost_cnt_after != bank->context_loss_count)
+		if (context_lost_cnt_after != bank->context_loss_count) {
 			omap_gpio_restore_context(bank);
+			bank->stats.restores++;
+		} else {
+			bank->stats.restores_skipped++;
+		}
 	}
 
 	/*
@@ -1822,6 +1872,53 @@ static struct platform_driver omap_gpio_driver = {
 	},
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int omap_gpio_stats_show(struct seq_file *s, void *unused)
+{
+	struct gpio_bank *bank;
+
+	seq_printf(s, "bank irq  irqs       events     irqs/s  "
+		   "restores   skipped\n");
+	list_for_each_entry(bank, &omap_gpio_list, node) {
+		struct gpio_bank_stats *st = &bank->stats;
+		unsigned long rate = st->irq_rate;
+
+		/* an idle bank has nothing closing its rate window */
+		if (time_after_eq(jiffies, st->window_start + 2 * HZ))
+			rate = 0;
+
+		seq_printf(s, "%-4u %-4u %-10lu %-10lu %-7lu %-10lu %lu\n",
+			   bank->id, bank->irq, st->irqs, st->events, rate,
+			   st->restores, st->restores_skipped);
+	}
+
+	return 0;
+}
+
+static int omap_gpio_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_gpio_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap_gpio_stats_fops = {
+	.open = omap_gpio_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init omap_gpio_debugfs_init(void)
+{
+	if (list_empty(&omap_gpio_list))
+		return 0;
+
+	debugfs_create_file("omap_gpio", S_IRUGO, NULL, NULL,
+			    &omap_gpio_stats_fops);
+	return 0;
+}
+late_initcall(omap_gpio_debugfs_init);
+#endif
+
 /*
  * gpio driver register needs to be done before
  * machine_init functions access gpio APIs.
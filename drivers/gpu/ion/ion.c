@@ -15,6 +15,8 @@
  */
 
 #include <linux/device.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/anon_inodes.h>
@@ -25,6 +27,7 @@
 #include <linux/mm.h>
 #include <linux/mm_types.h>
 #include <linux/rbtree.h>
+#include <linux/scatterlist.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/seq_file.h>
@@ -32,6 +35,9 @@
 #include <linux/debugfs.h>
 
 #include "ion_priv.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/ion.h>
 #define DEBUG
 
 /* this function should only be called while dev->lock is held */
@@ -78,6 +84,12 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	kref_init(&buffer->ref);
 
 	ret = heap->ops->allocate(heap, buffer, len, align, flags);
+	if (ret && (heap->flags & ION_HEAP_FLAG_DEFER_FREE)) {
+		/* give the memory queued for freeing back and try again */
+		if (ion_heap_freelist_drain(heap, 0))
+			ret = heap->ops->allocate(heap, buffer, len, align,
+						  flags);
+	}
 	if (ret) {
 		kfree(buffer);
 		return ERR_PTR(ret);
@@ -87,19 +99,34 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	buffer->cached = false;
 	mutex_init(&buffer->lock);
 	ion_buffer_add(dev, buffer);
+	ion_usage_heap_update(heap, len);
+	trace_ion_alloc_buffer(heap->name, buffer, len);
 	return buffer;
 }
 
-static void ion_buffer_destroy(struct kref *kref)
+void ion_buffer_destroy(struct ion_buffer *buffer)
+{
+	buffer->heap->ops->free(buffer);
+	ion_usage_heap_update(buffer->heap, -(long)buffer->size);
+	kfree(buffer);
+}
+
+static void _ion_buffer_destroy(struct kref *kref)
 {
 	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
 	struct ion_device *dev = buffer->dev;
+	struct ion_heap *heap = buffer->heap;
 
-	buffer->heap->ops->free(buffer);
 	mutex_lock(&dev->lock);
 	rb_erase(&buffer->node, &dev->buffers);
 	mutex_unlock(&dev->lock);
-	kfree(buffer);
+
+	ion_usage_uncharge(buffer);
+	trace_ion_free_buffer(heap->name, buffer, buffer->size);
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_freelist_add(heap, buffer);
+	else
+		ion_buffer_destroy(buffer);
 }
 
 static void ion_buffer_get(struct ion_buffer *buffer)
@@ -109,7 +136,7 @@ static void ion_buffer_get(struct ion_buffer *buffer)
 
 static int ion_buffer_put(struct ion_buffer *buffer)
 {
-	return kref_put(&buffer->ref, ion_buffer_destroy);
+	return kref_put(&buffer->ref, _ion_buffer_destroy);
 }
 
 static struct ion_handle *ion_handle_create(struct ion_client *client,
@@ -240,9 +267,12 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	}
 	mutex_unlock(&dev->lock);
 
-	if (IS_ERR_OR_NULL(buffer))
+	if (IS_ERR_OR_NULL(buffer)) {
+		trace_ion_alloc_fail(len, flags, PTR_ERR(buffer));
 		return ERR_PTR(PTR_ERR(buffer));
+	}
 
+	ion_usage_charge(client, buffer);
 	handle = ion_handle_create(client, buffer);
 
 	if (IS_ERR_OR_NULL(handle))
@@ -504,18 +534,304 @@ struct ion_handle *ion_import_fd(struct ion_client *client, int fd)
 		return ERR_PTR(-EINVAL);
 	}
 	if (file->f_op != &ion_share_fops) {
-		pr_err("%s: imported file is not a shared ion file.\n",
-		       __func__);
-		handle = ERR_PTR(-EINVAL);
-		goto end;
+		/* could be one of our buffers shared as a dma-buf */
+		fput(file);
+		return ion_import_dma_buf(client, fd);
 	}
 	handle = ion_import(client, file->private_data);
-end:
 	fput(file);
 	return handle;
 }
 EXPORT_SYMBOL(ion_import_fd);
 
+/*
+ * dma-buf export of ion buffers.  Each attachment maps the buffer for its
+ * device on the first map_dma_buf and keeps the mapping until it is
+ * detached, so a buffer queued again and again to the same device is
+ * only mapped once.  Cache maintenance of cached buffers is left to
+ * begin/end_cpu_access and ION_IOC_SYNC, as for the other mappings.
+ */
+
+struct ion_dma_buf_attachment {
+	struct sg_table table;
+	enum dma_data_direction dir;
+	bool dma_mapped;	/* table mapped with dma_map_sg() */
+	bool mapped;		/* table set up */
+};
+
+/* map the buffer for dma without a handle, for the dma-buf users */
+static struct scatterlist *ion_buffer_map_dma(struct ion_buffer *buffer)
+{
+	struct scatterlist *sglist;
+
+	mutex_lock(&buffer->lock);
+	if (!buffer->dmap_cnt) {
+		sglist = buffer->heap->ops->map_dma(buffer->heap, buffer);
+		if (IS_ERR_OR_NULL(sglist)) {
+			mutex_unlock(&buffer->lock);
+			return sglist ? sglist : ERR_PTR(-ENOMEM);
+		}
+		buffer->sglist = sglist;
+	}
+	buffer->dmap_cnt++;
+	sglist = buffer->sglist;
+	mutex_unlock(&buffer->lock);
+
+	return sglist;
+}
+
+static void ion_buffer_unmap_dma(struct ion_buffer *buffer)
+{
+	mutex_lock(&buffer->lock);
+	if (!--buffer->dmap_cnt) {
+		buffer->heap->ops->unmap_dma(buffer->heap, buffer);
+		buffer->sglist = NULL;
+	}
+	mutex_unlock(&buffer->lock);
+}
+
+static int ion_dma_buf_attach(struct dma_buf *dmabuf, struct device *dev,
+			      struct dma_buf_attachment *attachment)
+{
+	attachment->priv = kzalloc(sizeof(struct ion_dma_buf_attachment),
+				   GFP_KERNEL);
+	if (!attachment->priv)
+		return -ENOMEM;
+	return 0;
+}
+
+static int ion_dma_buf_map_pages(struct ion_buffer *buffer,
+				 struct dma_buf_attachment *attachment,
+				 struct ion_dma_buf_attachment *a,
+				 enum dma_data_direction dir)
+{
+	struct scatterlist *sglist, *src, *sg;
+	int i, nents = 0, ret;
+
+	sglist = ion_buffer_map_dma(buffer);
+	if (IS_ERR(sglist))
+		return PTR_ERR(sglist);
+
+	for (src = sglist; src; src = sg_next(src))
+		nents++;
+
+	ret = sg_alloc_table(&a->table, nents, GFP_KERNEL);
+	if (ret)
+		goto err_unmap;
+
+	src = sglist;
+	for_each_sg(a->table.sgl, sg, nents, i) {
+		sg_set_page(sg, sg_page(src), src->length, src->offset);
+		src = sg_next(src);
+	}
+
+	if (!dma_map_sg(attachment->dev, a->table.sgl, nents, dir)) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	a->dma_mapped = true;
+
+	return 0;
+
+err_free:
+	sg_free_table(&a->table);
+err_unmap:
+	ion_buffer_unmap_dma(buffer);
+	return ret;
+}
+
+/* carveout and tiler memory is contiguous and has no struct pages */
+static int ion_dma_buf_map_phys(struct ion_buffer *buffer,
+				struct ion_dma_buf_attachment *a)
+{
+	ion_phys_addr_t addr;
+	size_t len;
+	int ret;
+
+	ret = buffer->heap->ops->phys(buffer->heap, buffer, &addr, &len);
+	if (ret)
+		return ret;
+
+	ret = sg_alloc_table(&a->table, 1, GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	a->table.sgl->length = len;
+	sg_dma_address(a->table.sgl) = addr;
+	sg_dma_len(a->table.sgl) = len;
+
+	return 0;
+}
+
+static struct sg_table *ion_map_dma_buf(struct dma_buf_attachment *attachment,
+					enum dma_data_direction dir)
+{
+	struct ion_buffer *buffer = attachment->dmabuf->priv;
+	struct ion_dma_buf_attachment *a = attachment->priv;
+	int ret;
+
+	if (a->mapped)
+		return &a->table;
+
+	if (buffer->heap->ops->map_dma)
+		ret = ion_dma_buf_map_pages(buffer, attachment, a, dir);
+	else if (buffer->heap->ops->phys)
+		ret = ion_dma_buf_map_phys(buffer, a);
+	else
+		ret = -ENODEV;
+	if (ret)
+		return ERR_PTR(ret);
+
+	a->dir = dir;
+	a->mapped = true;
+	return &a->table;
+}
+
+static void ion_unmap_dma_buf(struct dma_buf_attachment *attachment,
+			      struct sg_table *table,
+			      enum dma_data_direction dir)
+{
+	/* the mapping is kept until the attachment goes away */
+}
+
+static void ion_dma_buf_detach(struct dma_buf *dmabuf,
+			       struct dma_buf_attachment *attachment)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+	struct ion_dma_buf_attachment *a = attachment->priv;
+
+	if (a->dma_mapped) {
+		dma_unmap_sg(attachment->dev, a->table.sgl, a->table.nents,
+			     a->dir);
+		ion_buffer_unmap_dma(buffer);
+	}
+	if (a->mapped)
+		sg_free_table(&a->table);
+	kfree(a);
+}
+
+static void ion_dma_buf_release(struct dma_buf *dmabuf)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+
+	ion_buffer_put(buffer);
+}
+
+static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
+					size_t len,
+					enum dma_data_direction dir)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+	void *vaddr;
+
+	if (!buffer->heap->ops->map_kernel)
+		return -ENODEV;
+
+	mutex_lock(&buffer->lock);
+	if (!buffer->kmap_cnt) {
+		vaddr = buffer->heap->ops->map_kernel(buffer->heap, buffer);
+		if (IS_ERR_OR_NULL(vaddr)) {
+			mutex_unlock(&buffer->lock);
+			return vaddr ? PTR_ERR(vaddr) : -ENOMEM;
+		}
+		buffer->vaddr = vaddr;
+	}
+	buffer->kmap_cnt++;
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
+static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
+				       size_t len,
+				       enum dma_data_direction dir)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+
+	mutex_lock(&buffer->lock);
+	if (!--buffer->kmap_cnt) {
+		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
+		buffer->vaddr = NULL;
+	}
+	mutex_unlock(&buffer->lock);
+}
+
+/* only valid between begin_cpu_access and end_cpu_access */
+static void *ion_dma_buf_kmap(struct dma_buf *dmabuf, unsigned long offset)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+
+	if (!buffer->vaddr)
+		return NULL;
+	return buffer->vaddr + offset * PAGE_SIZE;
+}
+
+static void ion_dma_buf_kunmap(struct dma_buf *dmabuf, unsigned long offset,
+			       void *ptr)
+{
+}
+
+static const struct dma_buf_ops dma_buf_ops = {
+	.attach = ion_dma_buf_attach,
+	.detach = ion_dma_buf_detach,
+	.map_dma_buf = ion_map_dma_buf,
+	.unmap_dma_buf = ion_unmap_dma_buf,
+	.release = ion_dma_buf_release,
+	.begin_cpu_access = ion_dma_buf_begin_cpu_access,
+	.end_cpu_access = ion_dma_buf_end_cpu_access,
+	.kmap_atomic = ion_dma_buf_kmap,
+	.kunmap_atomic = ion_dma_buf_kunmap,
+	.kmap = ion_dma_buf_kmap,
+	.kunmap = ion_dma_buf_kunmap,
+};
+
+struct dma_buf *ion_share_dma_buf(struct ion_client *client,
+				  struct ion_handle *handle)
+{
+	struct ion_buffer *buffer;
+	struct dma_buf *dmabuf;
+	bool valid_handle;
+
+	mutex_lock(&client->lock);
+	valid_handle = ion_handle_validate(client, handle);
+	mutex_unlock(&client->lock);
+	if (!valid_handle) {
+		WARN(1, "%s: invalid handle passed to share.\n", __func__);
+		return ERR_PTR(-EINVAL);
+	}
+
+	buffer = handle->buffer;
+	ion_buffer_get(buffer);
+	dmabuf = dma_buf_export(buffer, &dma_buf_ops, buffer->size, O_RDWR);
+	if (IS_ERR(dmabuf))
+		ion_buffer_put(buffer);
+
+	return dmabuf;
+}
+EXPORT_SYMBOL(ion_share_dma_buf);
+
+struct ion_handle *ion_import_dma_buf(struct ion_client *client, int fd)
+{
+	struct dma_buf *dmabuf;
+	struct ion_handle *handle;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return ERR_CAST(dmabuf);
+
+	if (dmabuf->ops != &dma_buf_ops) {
+		pr_err("%s: can not import dmabuf from another exporter\n",
+		       __func__);
+		dma_buf_put(dmabuf);
+		return ERR_PTR(-EINVAL);
+	}
+
+	handle = ion_import(client, dmabuf->priv);
+	dma_buf_put(dmabuf);
+	return handle;
+}
+EXPORT_SYMBOL(ion_import_dma_buf);
+
 static int ion_debug_client_show(struct seq_file *s, void *unused)
 {
 	struct ion_client *client = s->private;
@@ -846,12 +1162,79 @@ err:
 	return ret;
 }
 
+static const struct file_operations ion_share_fops = {
+	.owner		= THIS_MODULE,
+	.release	= ion_share_release,
+	.mmap		= ion_share_mmap,
+};
+
+/*
+ * Checks that @vaddr is where current->mm has the start of @buffer mapped
+ * through an ion fd and that the ranges are inside that mapping, so the
+ * cache operations by virtual address cannot fault.  Called with mmap_sem
+ * held.
+ */
+static bool ion_sync_vaddr_valid(struct ion_buffer *buffer,
+				 unsigned long vaddr,
+				 struct ion_sync_range *ranges, int nr_ranges)
+{
+	struct vm_area_struct *vma = find_vma(current->mm, vaddr);
+	int i;
+
+	if (!vma || vma->vm_start != vaddr || vma->vm_pgoff ||
+	    !vma->vm_file || vma->vm_file->f_op != &ion_share_fops ||
+	    vma->vm_file->private_data != buffer)
+		return false;
+
+	for (i = 0; i < nr_ranges; i++) {
+		if (ranges[i].offset >= buffer->size ||
+		    ranges[i].size > buffer->size - ranges[i].offset)
+			return false;
+		if (ranges[i].offset + ranges[i].size >
+		    vma->vm_end - vma->vm_start)
+			return false;
+	}
+	return true;
+}
+
+static int ion_sync_user(struct ion_handle *handle, unsigned long vaddr,
+			 struct ion_sync_range *ranges, int nr_ranges,
+			 enum dma_data_direction dir)
+{
+	struct ion_buffer *buffer = handle->buffer;
+	int ret = -EINVAL;
+
+	down_read(&current->mm->mmap_sem);
+	if (!ion_sync_vaddr_valid(buffer, vaddr, ranges, nr_ranges)) {
+		pr_err("%s: range not mapped from this buffer\n", __func__);
+		goto out;
+	}
+
+	mutex_lock(&buffer->lock);
+	ret = buffer->heap->ops->sync_user(buffer, vaddr, ranges, nr_ranges,
+					   dir);
+	mutex_unlock(&buffer->lock);
+out:
+	up_read(&current->mm->mmap_sem);
+	return ret;
+}
+
 static int ion_flush_cached(struct ion_handle *handle, size_t size,
 			   unsigned long vaddr)
 {
 	struct ion_buffer *buffer;
 	int ret = -EINVAL;
 
+	if (handle->buffer->heap->ops->sync_user) {
+		struct ion_sync_range range = { .offset = 0, .size = size };
+
+		ret = ion_sync_user(handle, vaddr, &range, 1,
+				    DMA_BIDIRECTIONAL);
+		if (ret)
+			pr_err("%s: failure flushing buffer\n", __func__);
+		return ret;
+	}
+
 	if (!handle->buffer->heap->ops->flush_user) {
 		pr_err("%s: this heap does not define a method for flushing\n",
 				__func__);
@@ -877,6 +1260,15 @@ static int ion_inval_cached(struct ion_handle *handle, size_t size,
 	struct ion_buffer *buffer;
 	int ret = -EINVAL;
 
+	if (handle->buffer->heap->ops->sync_user) {
+		struct ion_sync_range range = { .offset = 0, .size = size };
+
+		ret = ion_sync_user(handle, vaddr, &range, 1, DMA_FROM_DEVICE);
+		if (ret)
+			pr_err("%s: failure invalidating buffer\n", __func__);
+		return ret;
+	}
+
 	if (!handle->buffer->heap->ops->inval_user) {
 		pr_err("%s: this heap does not define a method for invalidating"
 				"\n", __func__);
@@ -896,11 +1288,61 @@ static int ion_inval_cached(struct ion_handle *handle, size_t size,
 	return ret;
 }
 
-static const struct file_operations ion_share_fops = {
-	.owner		= THIS_MODULE,
-	.release	= ion_share_release,
-	.mmap		= ion_share_mmap,
-};
+static int ion_ioctl_sync(struct ion_client *client, struct ion_sync_data *data)
+{
+	struct ion_sync_range *ranges;
+	enum dma_data_direction dir;
+	int ret;
+
+	switch (data->direction) {
+	case ION_SYNC_TO_DEVICE:
+		dir = DMA_TO_DEVICE;
+		break;
+	case ION_SYNC_FROM_DEVICE:
+		dir = DMA_FROM_DEVICE;
+		break;
+	case ION_SYNC_BIDIRECTIONAL:
+		dir = DMA_BIDIRECTIONAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (!data->nr_ranges || data->nr_ranges > ION_SYNC_MAX_RANGES)
+		return -EINVAL;
+
+	ranges = kmalloc(data->nr_ranges * sizeof(*ranges), GFP_KERNEL);
+	if (!ranges)
+		return -ENOMEM;
+	if (copy_from_user(ranges, (void __user *)data->ranges,
+			   data->nr_ranges * sizeof(*ranges))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	mutex_lock(&client->lock);
+	if (!ion_handle_validate(client, data->handle)) {
+		pr_err("%s: invalid handle passed to sync ioctl.\n", __func__);
+		mutex_unlock(&client->lock);
+		ret = -EINVAL;
+		goto out;
+	}
+	/* mmap_sem nests outside client->lock, see ion_share_mmap() */
+	ion_handle_get(data->handle);
+	mutex_unlock(&client->lock);
+
+	if (!data->handle->buffer->heap->ops->sync_user) {
+		pr_err("%s: this heap does not define a method for syncing\n",
+		       __func__);
+		ret = -EINVAL;
+	} else {
+		ret = ion_sync_user(data->handle, data->vaddr, ranges,
+				    data->nr_ranges, dir);
+	}
+	ion_handle_put(data->handle);
+out:
+	kfree(ranges);
+	return ret;
+}
 
 static int ion_ioctl_share(struct file *parent, struct ion_client *client,
 			   struct ion_handle *handle)
@@ -981,6 +1423,25 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			return -EFAULT;
 		break;
 	}
+	case ION_IOC_SHARE_DMA_BUF:
+	{
+		struct ion_fd_data data;
+		struct dma_buf *dmabuf;
+
+		if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+			return -EFAULT;
+		dmabuf = ion_share_dma_buf(client, data.handle);
+		if (IS_ERR(dmabuf))
+			return PTR_ERR(dmabuf);
+		data.fd = dma_buf_fd(dmabuf, O_CLOEXEC);
+		if (data.fd < 0) {
+			dma_buf_put(dmabuf);
+			return data.fd;
+		}
+		if (copy_to_user((void __user *)arg, &data, sizeof(data)))
+			return -EFAULT;
+		break;
+	}
 	case ION_IOC_IMPORT:
 	{
 		struct ion_fd_data data;
@@ -1023,9 +1484,12 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			mutex_unlock(&client->lock);
 			return -EINVAL;
 		}
+		/* mmap_sem may be taken, it nests outside client->lock */
+		ion_handle_get(data.handle);
+		mutex_unlock(&client->lock);
 
 		ret = ion_flush_cached(data.handle, data.size, data.vaddr);
-		mutex_unlock(&client->lock);
+		ion_handle_put(data.handle);
 		if (ret)
 			return ret;
 		if (copy_to_user((void __user *)arg, &data, sizeof(data)))
@@ -1047,9 +1511,12 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			mutex_unlock(&client->lock);
 			return -EINVAL;
 		}
+		/* mmap_sem may be taken, it nests outside client->lock */
+		ion_handle_get(data.handle);
+		mutex_unlock(&client->lock);
 
 		ret = ion_inval_cached(data.handle, data.size, data.vaddr);
-		mutex_unlock(&client->lock);
+		ion_handle_put(data.handle);
 		if (ret)
 			return ret;
 		if (copy_to_user((void __user *)arg, &data, sizeof(data)))
@@ -1057,6 +1524,15 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		break;
 	}
 
+	case ION_IOC_SYNC:
+	{
+		struct ion_sync_data data;
+
+		if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+			return -EFAULT;
+		return ion_ioctl_sync(client, &data);
+	}
+
 	default:
 		return -ENOTTY;
 	}
@@ -1141,6 +1617,14 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 		seq_printf(s, "%16.s %16u %16u\n", client->name, client->pid,
 			   size);
 	}
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE) {
+		seq_printf(s, "%16.s %16u\n", "deferred free",
+			   ion_heap_freelist_size(heap));
+		seq_printf(s, "%16.s %16lu\n", "deferred total",
+			   heap->deferred_count);
+	}
+	seq_printf(s, "%16.s %16ld\n", "total",
+		   atomic_long_read(&heap->used));
 	return 0;
 }
 
@@ -1179,8 +1663,13 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		}
 	}
 
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE &&
+	    ion_heap_init_deferred_free(heap))
+		heap->flags &= ~ION_HEAP_FLAG_DEFER_FREE;
+
 	rb_link_node(&heap->node, parent, p);
 	rb_insert_color(&heap->node, &dev->heaps);
+	ion_usage_heap_init(dev, heap);
 	debugfs_create_file(heap->name, 0664, dev->debug_root, heap,
 			    &debug_heap_fops);
 end:
@@ -1212,6 +1701,8 @@ struct ion_device *ion_device_create(long (*custom_ioctl)
 	idev->debug_root = debugfs_create_dir("ion", NULL);
 	if (IS_ERR_OR_NULL(idev->debug_root))
 		pr_err("ion: failed to create debug files.\n");
+	ion_cache_init(idev);
+	ion_usage_init(idev);
 
 	idev->custom_ioctl = custom_ioctl;
 	idev->buffers = RB_ROOT;
@@ -0,0 +1,183 @@
+/*
+ * drivers/gpu/ion/ion_cache.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cache.h>
+#include <linux/debugfs.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/ion.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/sort.h>
+#include "ion_priv.h"
+
+#include <asm/cacheflush.h>
+#include <asm/outercache.h>
+
+static int ion_sync_range_cmp(const void *a, const void *b)
+{
+	const struct ion_sync_range *ra = a, *rb = b;
+
+	if (ra->offset < rb->offset)
+		return -1;
+	return ra->offset > rb->offset;
+}
+
+/*
+ * Widen the ranges to whole cache lines, then sort and merge them so that
+ * no line is maintained twice.  Returns the new number of ranges.
+ */
+static int ion_sync_coalesce(struct ion_sync_range *ranges, int nr_ranges)
+{
+	int i, n = 0;
+
+	for (i = 0; i < nr_ranges; i++) {
+		unsigned long start = ranges[i].offset & ~(L1_CACHE_BYTES - 1);
+		unsigned long end = ALIGN(ranges[i].offset + ranges[i].size,
+					  L1_CACHE_BYTES);
+
+		ranges[i].offset = start;
+		ranges[i].size = end - start;
+	}
+	sort(ranges, nr_ranges, sizeof(*ranges), ion_sync_range_cmp, NULL);
+
+	for (i = 0; i < nr_ranges; i++) {
+		struct ion_sync_range *prev;
+		unsigned long end;
+
+		if (!ranges[i].size)
+			continue;
+		if (!n) {
+			ranges[n++] = ranges[i];
+			continue;
+		}
+		prev = &ranges[n - 1];
+		if (ranges[i].offset > prev->offset + prev->size) {
+			ranges[n++] = ranges[i];
+			continue;
+		}
+		end = ranges[i].offset + ranges[i].size;
+		if (end > prev->offset + prev->size)
+			prev->size = end - prev->offset;
+	}
+	return n;
+}
+
+static void per_cpu_cache_flush_arm(void *arg)
+{
+	flush_cache_all();
+}
+
+/**
+ * ion_cache_sync_ranges - make parts of a cacheable user mapping coherent
+ * @buffer:		the buffer
+ * @vaddr:		user address @buffer is mapped at, in current->mm
+ * @paddr:		physical address of the start of @buffer
+ * @ranges:		offsets into @buffer to maintain, modified in place
+ * @nr_ranges:		number of entries in @ranges
+ * @dir:		DMA_TO_DEVICE cleans, DMA_FROM_DEVICE invalidates,
+ *			DMA_BIDIRECTIONAL does both
+ *
+ * The caller must have validated the ranges against the buffer and the
+ * mapping and must hold mmap_sem.  Once the ranges add up to more than
+ * the device's sync_threshold the whole cache is flushed instead.
+ */
+void ion_cache_sync_ranges(struct ion_buffer *buffer, unsigned long vaddr,
+			   ion_phys_addr_t paddr, struct ion_sync_range *ranges,
+			   int nr_ranges, enum dma_data_direction dir)
+{
+	struct ion_sync_stats *stats = &buffer->dev->sync_stats;
+	size_t total = 0;
+	int i;
+
+	nr_ranges = ion_sync_coalesce(ranges, nr_ranges);
+	for (i = 0; i < nr_ranges; i++)
+		total += ranges[i].size;
+
+	if (total > buffer->dev->sync_threshold) {
+		on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
+		outer_flush_all();
+		atomic_long_inc(&stats->full);
+		atomic_long_add(total, &stats->full_bytes);
+		return;
+	}
+
+	for (i = 0; i < nr_ranges; i++) {
+		void *start = (void *)(vaddr + ranges[i].offset);
+		ion_phys_addr_t phys = paddr + ranges[i].offset;
+		size_t size = ranges[i].size;
+
+		switch (dir) {
+		case DMA_TO_DEVICE:
+			dmac_map_area(start, size, DMA_TO_DEVICE);
+			outer_clean_range(phys, phys + size);
+			atomic_long_inc(&stats->clean);
+			break;
+		case DMA_FROM_DEVICE:
+			outer_inv_range(phys, phys + size);
+			dmac_unmap_area(start, size, DMA_FROM_DEVICE);
+			atomic_long_inc(&stats->inval);
+			break;
+		default:
+			dmac_flush_range(start, start + size);
+			outer_flush_range(phys, phys + size);
+			atomic_long_inc(&stats->flush);
+			break;
+		}
+	}
+	atomic_long_add(total, &stats->range_bytes);
+}
+
+static int ion_debug_sync_show(struct seq_file *s, void *unused)
+{
+	struct ion_device *dev = s->private;
+	struct ion_sync_stats *stats = &dev->sync_stats;
+
+	seq_printf(s, "threshold:   %u\n", dev->sync_threshold);
+	seq_printf(s, "clean:       %ld\n", atomic_long_read(&stats->clean));
+	seq_printf(s, "invalidate:  %ld\n", atomic_long_read(&stats->inval));
+	seq_printf(s, "flush:       %ld\n", atomic_long_read(&stats->flush));
+	seq_printf(s, "range bytes: %ld\n",
+		   atomic_long_read(&stats->range_bytes));
+	seq_printf(s, "full:        %ld\n", atomic_long_read(&stats->full));
+	seq_printf(s, "full bytes:  %ld\n",
+		   atomic_long_read(&stats->full_bytes));
+	return 0;
+}
+
+static int ion_debug_sync_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_debug_sync_show, inode->i_private);
+}
+
+static const struct file_operations debug_sync_fops = {
+	.open = ion_debug_sync_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void ion_cache_init(struct ion_device *dev)
+{
+	dev->sync_threshold = FULL_CACHE_FLUSH_THRESHOLD;
+	if (IS_ERR_OR_NULL(dev->debug_root))
+		return;
+	debugfs_create_u32("sync_threshold", 0664, dev->debug_root,
+			   &dev->sync_threshold);
+	debugfs_create_file("sync_stats", 0444, dev->debug_root, dev,
+			    &debug_sync_fops);
+}
@@ -111,49 +111,22 @@ static int ion_carveout_heap_map_user(struct ion_heap *heap,
 			       : pgprot_writecombine(vma->vm_page_prot)));
 }
 
-static void per_cpu_cache_flush_arm(void *arg)
+static int ion_carveout_heap_sync_user(struct ion_buffer *buffer,
+				       unsigned long vaddr,
+				       struct ion_sync_range *ranges,
+				       int nr_ranges,
+				       enum dma_data_direction dir)
 {
-	flush_cache_all();
-}
-
-static int ion_carveout_heap_cache_operation(struct ion_buffer *buffer,
-		size_t len, unsigned long vaddr, enum cache_operation cacheop)
-{
-	if (!buffer || !buffer->cached) {
+	if (!buffer->cached) {
 		pr_err("%s(): buffer not mapped as cacheable\n", __func__);
 		return -EINVAL;
 	}
 
-	if (len > FULL_CACHE_FLUSH_THRESHOLD) {
-		on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
-		outer_flush_all();
-		return 0;
-	}
-
-	 __cpuc_coherent_user_range((vaddr) & PAGE_MASK, PAGE_ALIGN(vaddr+len));
-
-	if (cacheop == CACHE_FLUSH)
-		outer_flush_range(buffer->priv_phys, buffer->priv_phys+len);
-	else
-		outer_inv_range(buffer->priv_phys, buffer->priv_phys+len);
-
+	ion_cache_sync_ranges(buffer, vaddr, buffer->priv_phys, ranges,
+			      nr_ranges, dir);
 	return 0;
 }
 
-static int ion_carveout_heap_flush_user(struct ion_buffer *buffer, size_t len,
-			unsigned long vaddr)
-{
-	return ion_carveout_heap_cache_operation(buffer, len,
-			vaddr, CACHE_FLUSH);
-}
-
-static int ion_carveout_heap_inval_user(struct ion_buffer *buffer, size_t len,
-			unsigned long vaddr)
-{
-	return ion_carveout_heap_cache_operation(buffer, len,
-			vaddr, CACHE_INVALIDATE);
-}
-
 static struct ion_heap_ops carveout_heap_ops = {
 	.allocate = ion_carveout_heap_allocate,
 	.free = ion_carveout_heap_free,
@@ -161,8 +134,7 @@ static struct ion_heap_ops carveout_heap_ops = {
 	.map_user = ion_carveout_heap_map_user,
 	.map_kernel = (void *)ion_carveout_heap_map_kernel,
 	.unmap_kernel = ion_carveout_heap_unmap_kernel,
-	.flush_user = ion_carveout_heap_flush_user,
-	.inval_user = ion_carveout_heap_inval_user,
+	.sync_user = ion_carveout_heap_sync_user,
 };
 
 struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
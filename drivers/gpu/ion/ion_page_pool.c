@@ -0,0 +1,160 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include "ion_priv.h"
+
+/*
+ * Write back any dirty lines covering the pages so that devices see the
+ * zeroes without the buffer owner having to do cache maintenance.
+ */
+static void ion_page_pool_sync(struct ion_page_pool *pool, struct page *page)
+{
+	struct scatterlist sg;
+
+	sg_init_table(&sg, 1);
+	sg_set_page(&sg, page, PAGE_SIZE << pool->order, 0);
+	sg_dma_address(&sg) = page_to_phys(page);
+	dma_sync_sg_for_device(NULL, &sg, 1, DMA_BIDIRECTIONAL);
+}
+
+static struct page *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+{
+	struct page *page = alloc_pages(pool->gfp_mask | __GFP_ZERO,
+					pool->order);
+
+	if (!page)
+		return NULL;
+	ion_page_pool_sync(pool, page);
+	return page;
+}
+
+static void ion_page_pool_free_pages(struct ion_page_pool *pool,
+				     struct page *page)
+{
+	__free_pages(page, pool->order);
+}
+
+/* Pages are linked through page->lru while they sit in the pool */
+static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	list_add(&page->lru, &pool->items);
+	pool->count++;
+	mutex_unlock(&pool->mutex);
+}
+
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool->count);
+	page = list_first_entry(&pool->items, struct page, lru);
+	list_del(&page->lru);
+	pool->count--;
+	return page;
+}
+
+/**
+ * ion_page_pool_alloc - get a zeroed, cache clean page block from the pool
+ * @pool:		the pool
+ *
+ * Falls back to the page allocator when the pool is empty.
+ */
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+
+	mutex_lock(&pool->mutex);
+	if (pool->count)
+		page = ion_page_pool_remove(pool);
+	mutex_unlock(&pool->mutex);
+
+	if (!page)
+		page = ion_page_pool_alloc_pages(pool);
+	return page;
+}
+
+/**
+ * ion_page_pool_free - return a page block to the pool
+ * @pool:		the pool
+ * @page:		first page of a block of order pool->order
+ *
+ * The pages are cleared and written back before they are queued so that
+ * ion_page_pool_alloc() can hand them out without any further work.
+ */
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		clear_highpage(page + i);
+	ion_page_pool_sync(pool, page);
+	ion_page_pool_add(pool, page);
+}
+
+/**
+ * ion_page_pool_shrink - release pages held by the pool
+ * @pool:		the pool
+ * @nr_to_scan:		number of order-0 pages to release, 0 to only count
+ *
+ * Returns the number of order-0 pages still held by the pool.
+ */
+int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan)
+{
+	int freed = 0;
+	int count;
+
+	mutex_lock(&pool->mutex);
+	while (freed < nr_to_scan && pool->count) {
+		struct page *page = ion_page_pool_remove(pool);
+
+		mutex_unlock(&pool->mutex);
+		ion_page_pool_free_pages(pool, page);
+		freed += (1 << pool->order);
+		mutex_lock(&pool->mutex);
+	}
+	count = pool->count << pool->order;
+	mutex_unlock(&pool->mutex);
+
+	return count;
+}
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
+{
+	struct ion_page_pool *pool = kmalloc(sizeof(struct ion_page_pool),
+					     GFP_KERNEL);
+	if (!pool)
+		return NULL;
+	pool->count = 0;
+	INIT_LIST_HEAD(&pool->items);
+	mutex_init(&pool->mutex);
+	pool->gfp_mask = gfp_mask;
+	pool->order = order;
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	while (pool->count)
+		ion_page_pool_free_pages(pool, ion_page_pool_remove(pool));
+	kfree(pool);
+}
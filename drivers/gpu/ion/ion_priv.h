@@ -17,15 +17,39 @@
 #ifndef _ION_PRIV_H
 #define _ION_PRIV_H
 
+#include <linux/atomic.h>
+#include <linux/dma-direction.h>
+#include <linux/kobject.h>
 #include <linux/kref.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <linux/ion.h>
 #include <linux/miscdevice.h>
 
 struct ion_mapping;
 
+/**
+ * struct ion_sync_stats - how cache maintenance requests were served
+ * @clean:		ranges cleaned
+ * @inval:		ranges invalidated
+ * @flush:		ranges cleaned and invalidated
+ * @range_bytes:	bytes covered by the range operations
+ * @full:		requests served by flushing the whole cache
+ * @full_bytes:		bytes requested by those
+ */
+struct ion_sync_stats {
+	atomic_long_t clean;
+	atomic_long_t inval;
+	atomic_long_t flush;
+	atomic_long_t range_bytes;
+	atomic_long_t full;
+	atomic_long_t full_bytes;
+};
+
 struct ion_dma_mapping {
 	struct kref ref;
 	struct scatterlist *sglist;
@@ -43,6 +67,10 @@ struct ion_kernel_mapping {
  * @lock:		lock protecting the buffers & heaps trees
  * @heaps:		list of all the heaps in the system
  * @user_clients:	list of all the clients created from userspace
+ * @sync_threshold:	size above which flushing the whole cache is cheaper
+ *			than maintaining the ranges, tunable per SoC
+ * @sync_stats:		cache maintenance statistics
+ * @heaps_kobj:		sysfs directory holding a kobject per heap
  */
 struct ion_device {
 	struct miscdevice dev;
@@ -54,6 +82,9 @@ struct ion_device {
 	struct rb_root user_clients;
 	struct rb_root kernel_clients;
 	struct dentry *debug_root;
+	u32 sync_threshold;
+	struct ion_sync_stats sync_stats;
+	struct kobject *heaps_kobj;
 };
 
 /**
@@ -113,6 +144,8 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
  * struct ion_buffer - metadata for a particular buffer
  * @ref:		refernce count
  * @node:		node in the ion_device buffers tree
+ * @list:		element in the heap's deferred free list once the
+ *			last reference is gone
  * @dev:		back pointer to the ion_device
  * @heap:		back pointer to the heap the buffer came from
  * @flags:		buffer specific flags
@@ -126,10 +159,14 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
  * @vaddr:		the kenrel mapping if kmap_cnt is not zero
  * @dmap_cnt:		number of times the buffer is mapped for dma
  * @sglist:		the scatterlist for the buffer is dmap_cnt is not zero
+ * @tgid:		process the buffer is charged to, 0 if none
 */
 struct ion_buffer {
 	struct kref ref;
-	struct rb_node node;
+	union {
+		struct rb_node node;
+		struct list_head list;
+	};
 	struct ion_device *dev;
 	struct ion_heap *heap;
 	unsigned long flags;
@@ -144,8 +181,16 @@ struct ion_buffer {
 	int dmap_cnt;
 	struct scatterlist *sglist;
 	bool cached;
+	pid_t tgid;
 };
 
+/**
+ * ion_buffer_destroy - hand a buffer back to its heap and free it
+ * @buffer:		a buffer that is no longer referenced or in the
+ *			device's buffer tree
+ */
+void ion_buffer_destroy(struct ion_buffer *buffer);
+
 /**
  * struct ion_heap_ops - ops to operate on a given heap
  * @allocate:		allocate memory
@@ -159,6 +204,8 @@ struct ion_buffer {
  * @map_user		map memory to userspace
  * @flush_user		flush memory if mapped as cacheable
  * @inval_user		invalidate memory if mapped as cacheable
+ * @sync_user		cache maintenance on ranges of a cacheable mapping,
+ *			also used for flush_user and inval_user when set
  */
 struct ion_heap_ops {
 	int (*allocate) (struct ion_heap *heap,
@@ -178,6 +225,9 @@ struct ion_heap_ops {
 			unsigned long vaddr);
 	int (*inval_user) (struct ion_buffer *buffer, size_t len,
 			unsigned long vaddr);
+	int (*sync_user) (struct ion_buffer *buffer, unsigned long vaddr,
+			  struct ion_sync_range *ranges, int nr_ranges,
+			  enum dma_data_direction dir);
 };
 
 /**
@@ -186,10 +236,26 @@ struct ion_heap_ops {
  * @dev:		back pointer to the ion_device
  * @type:		type of heap
  * @ops:		ops struct as above
+ * @flags:		ION_HEAP_FLAG_* flags set by the heap
  * @id:			id of heap, also indicates priority of this heap when
  *			allocating.  These are specified by platform data and
  *			MUST be unique
  * @name:		used for debugging
+ * @free_list:		buffers waiting to be freed, if ION_HEAP_FLAG_DEFER_FREE
+ * @free_list_size:	total size of the buffers on free_list
+ * @free_lock:		protects free_list and free_list_size
+ * @waitqueue:		the deferred free thread waits here for work
+ * @task:		the deferred free thread
+ * @deferred_count:	buffers released through the free list so far
+ * @used:		bytes currently allocated from the heap
+ * @high_wmark:		usage at which pressure is raised, 0 to disable
+ * @low_wmark:		usage at which pressure is cleared again
+ * @pressure:		usage crossed high_wmark and has not yet fallen to
+ *			low_wmark
+ * @pressure_events:	times pressure has been raised
+ * @wmark_lock:		protects the watermarks and pressure state
+ * @kobj:		sysfs entry of the heap under the ion device
+ * @pressure_sd:	the pressure attribute, notified on every change
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -201,10 +267,32 @@ struct ion_heap {
 	struct ion_device *dev;
 	enum ion_heap_type type;
 	struct ion_heap_ops *ops;
+	unsigned long flags;
 	int id;
 	const char *name;
+	struct list_head free_list;
+	size_t free_list_size;
+	spinlock_t free_lock;
+	wait_queue_head_t waitqueue;
+	struct task_struct *task;
+	unsigned long deferred_count;
+	atomic_long_t used;
+	size_t high_wmark;
+	size_t low_wmark;
+	bool pressure;
+	unsigned long pressure_events;
+	spinlock_t wmark_lock;
+	struct kobject kobj;
+	struct sysfs_dirent *pressure_sd;
 };
 
+/*
+ * Buffers released on a heap with ION_HEAP_FLAG_DEFER_FREE are queued and
+ * handed back to the heap from a low priority thread, keeping the heap
+ * free and cache maintenance out of the caller's context.
+ */
+#define ION_HEAP_FLAG_DEFER_FREE (1 << 0)
+
 /**
  * ion_device_create - allocates and returns an ion device
  * @custom_ioctl:	arch specific ioctl function if applicable
@@ -238,6 +326,15 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap);
 struct ion_heap *ion_heap_create(struct ion_platform_heap *);
 void ion_heap_destroy(struct ion_heap *);
 
+/**
+ * functions for the deferred free list of a heap, see
+ * ION_HEAP_FLAG_DEFER_FREE
+ */
+int ion_heap_init_deferred_free(struct ion_heap *heap);
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer);
+size_t ion_heap_freelist_drain(struct ion_heap *heap, size_t size);
+size_t ion_heap_freelist_size(struct ion_heap *heap);
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *);
 void ion_system_heap_destroy(struct ion_heap *);
 
@@ -260,6 +357,32 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  */
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 
+/**
+ * struct ion_page_pool - pagepool struct
+ * @count:		number of blocks in the pool
+ * @items:		list of blocks, linked through page->lru
+ * @mutex:		lock protecting this struct
+ * @gfp_mask:		gfp_mask to use when the pool is empty
+ * @order:		order of the blocks in the pool
+ *
+ * Keeps freed pages around for the next allocation.  Every block in the
+ * pool has been zeroed and written back from the cache, so it can be
+ * handed to a device without further maintenance.
+ */
+struct ion_page_pool {
+	int count;
+	struct list_head items;
+	struct mutex mutex;
+	gfp_t gfp_mask;
+	unsigned int order;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan);
+
 /**
  * Flushing entire cache is more efficient than flushing virtual address
  * range of a buffer whose size is 200Kbytes or higher, since line by
@@ -273,4 +396,19 @@ enum cache_operation {
 	CACHE_FLUSH		= 0x2,
 };
 
+void ion_cache_init(struct ion_device *dev);
+void ion_cache_sync_ranges(struct ion_buffer *buffer, unsigned long vaddr,
+			   ion_phys_addr_t paddr, struct ion_sync_range *ranges,
+			   int nr_ranges, enum dma_data_direction dir);
+
+/**
+ * per-process charging of buffers and per-heap usage watermarks, see
+ * ion_usage.c
+ */
+void ion_usage_init(struct ion_device *dev);
+void ion_usage_heap_init(struct ion_device *dev, struct ion_heap *heap);
+void ion_usage_heap_update(struct ion_heap *heap, long delta);
+void ion_usage_charge(struct ion_client *client, struct ion_buffer *buffer);
+void ion_usage_uncharge(struct ion_buffer *buffer);
+
 #endif /* _ION_PRIV_H */
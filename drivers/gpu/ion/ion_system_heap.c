@@ -22,72 +22,170 @@
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+/*
+ * Buffers are built from the largest blocks the page allocator can give us
+ * without trying hard, so the scatterlists handed to devices stay short.
+ * Freed blocks are kept in per-order pools until the shrinker asks for
+ * them back.
+ */
+static const unsigned int orders[] = {8, 4, 0};
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+static const gfp_t high_order_gfp_flags = (GFP_HIGHUSER | __GFP_NOWARN |
+					   __GFP_NORETRY | __GFP_NO_KSWAPD) &
+					  ~__GFP_WAIT;
+static const gfp_t low_order_gfp_flags = GFP_HIGHUSER | __GFP_NOWARN;
+
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *pools[NUM_ORDERS];
+	struct shrinker shrinker;
+};
+
+struct ion_system_chunk {
+	struct page *page;
+	unsigned int order;
+};
+
+/**
+ * struct ion_system_buffer - the pages backing a system heap buffer
+ * @nents:		number of physically contiguous chunks
+ * @chunks:		the chunks, largest first
+ */
+struct ion_system_buffer {
+	int nents;
+	struct ion_system_chunk chunks[0];
+};
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (order == orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+static struct page *alloc_largest_available(struct ion_system_heap *heap,
+					    unsigned long size,
+					    unsigned int max_order,
+					    unsigned int *order)
+{
+	struct page *page;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (size < (PAGE_SIZE << orders[i]))
+			continue;
+		if (max_order < orders[i])
+			continue;
+
+		page = ion_page_pool_alloc(heap->pools[i]);
+		if (!page)
+			continue;
+		*order = orders[i];
+		return page;
+	}
+	return NULL;
+}
+
+static void free_chunk(struct ion_system_heap *heap,
+		       struct ion_system_chunk *chunk)
+{
+	ion_page_pool_free(heap->pools[order_to_index(chunk->order)],
+			   chunk->page);
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				    struct ion_buffer *buffer,
 				    unsigned long size, unsigned long align,
 				    unsigned long flags)
 {
-	struct page **page_list;
-	int n_pages = PAGE_ALIGN(size) / PAGE_SIZE;
-	const int gfp_mask = GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO;
-	int i = 0;
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer *sys_buffer;
+	struct ion_system_chunk *chunks;
+	unsigned long size_remaining = PAGE_ALIGN(size);
+	unsigned int max_order = orders[0];
+	int n_pages = size_remaining / PAGE_SIZE;
+	int nents = 0;
+	int i;
 
-	page_list = kmalloc(n_pages * sizeof(void *), GFP_KERNEL);
-	if (!page_list)
+	/* there are never more chunks than pages */
+	chunks = kmalloc(n_pages * sizeof(*chunks), GFP_KERNEL);
+	if (!chunks)
 		return -ENOMEM;
 
-	for (i = 0; i < n_pages; i++) {
-		page_list[i] = alloc_page(gfp_mask);
-		if (page_list[i] == NULL)
-			goto out;
+	while (size_remaining > 0) {
+		struct page *page;
+		unsigned int order;
+
+		page = alloc_largest_available(sys_heap, size_remaining,
+					       max_order, &order);
+		if (!page)
+			goto err;
+		chunks[nents].page = page;
+		chunks[nents].order = order;
+		nents++;
+		size_remaining -= PAGE_SIZE << order;
+		max_order = order;
 	}
 
-	buffer->priv_virt = page_list;
-	return 0;
+	sys_buffer = kmalloc(sizeof(*sys_buffer) + nents * sizeof(*chunks),
+			     GFP_KERNEL);
+	if (!sys_buffer)
+		goto err;
+	sys_buffer->nents = nents;
+	memcpy(sys_buffer->chunks, chunks, nents * sizeof(*chunks));
+	kfree(chunks);
 
-out:
-	/* failed on i, so go to i-1 */
-	for (i -= 1; i >= 0; i--)
-		__free_page(page_list[i]);
+	buffer->priv_virt = sys_buffer;
+	return 0;
 
-	kfree(page_list);
+err:
+	for (i = 0; i < nents; i++)
+		free_chunk(sys_heap, &chunks[i]);
+	kfree(chunks);
 	return -ENOMEM;
 }
 
 static void ion_system_heap_free(struct ion_buffer *buffer)
 {
+	struct ion_system_heap *sys_heap = container_of(buffer->heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
 	int i;
-	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
-	struct page **page_list = (struct page **)buffer->priv_virt;
 
-	for (i = 0; i < n_pages; i++)
-		__free_page(page_list[i]);
-	kfree(page_list);
+	for (i = 0; i < sys_buffer->nents; i++)
+		free_chunk(sys_heap, &sys_buffer->chunks[i]);
+	kfree(sys_buffer);
 }
 
 static struct scatterlist *ion_system_heap_map_dma(struct ion_heap *heap,
 					    struct ion_buffer *buffer)
 {
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
 	struct scatterlist *sglist;
-	struct page **page_list = (struct page **)buffer->priv_virt;
 	int i;
-	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
 
-	sglist = vmalloc(n_pages * sizeof(struct scatterlist));
+	sglist = vmalloc(sys_buffer->nents * sizeof(struct scatterlist));
 	if (!sglist)
 		return ERR_PTR(-ENOMEM);
-	memset(sglist, 0, n_pages * sizeof(struct scatterlist));
-	sg_init_table(sglist, n_pages);
-	for (i = 0; i < n_pages; i++)
-		sg_set_page(&sglist[i], page_list[i], PAGE_SIZE, 0);
-	/* XXX do cache maintenance for dma? */
+	sg_init_table(sglist, sys_buffer->nents);
+	for (i = 0; i < sys_buffer->nents; i++)
+		sg_set_page(&sglist[i], sys_buffer->chunks[i].page,
+			    PAGE_SIZE << sys_buffer->chunks[i].order, 0);
+	/* pages come out of the pools already written back */
 	return sglist;
 }
 
 static void ion_system_heap_unmap_dma(struct ion_heap *heap,
 			       struct ion_buffer *buffer)
 {
-	/* XXX undo cache maintenance for dma? */
 	if (buffer->sglist)
 		vfree(buffer->sglist);
 }
@@ -95,10 +193,22 @@ static void ion_system_heap_unmap_dma(struct ion_heap *heap,
 static void *ion_system_heap_map_kernel(struct ion_heap *heap,
 				 struct ion_buffer *buffer)
 {
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
 	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
-	struct page **page_list = (struct page **)buffer->priv_virt;
+	struct page **page_list;
+	void *vaddr;
+	int i, j, k = 0;
 
-	return vm_map_ram(page_list, n_pages, -1, PAGE_KERNEL);
+	page_list = vmalloc(n_pages * sizeof(struct page *));
+	if (!page_list)
+		return NULL;
+	for (i = 0; i < sys_buffer->nents; i++)
+		for (j = 0; j < (1 << sys_buffer->chunks[i].order); j++)
+			page_list[k++] = sys_buffer->chunks[i].page + j;
+
+	vaddr = vm_map_ram(page_list, n_pages, -1, PAGE_KERNEL);
+	vfree(page_list);
+	return vaddr;
 }
 
 static void ion_system_heap_unmap_kernel(struct ion_heap *heap,
@@ -113,27 +223,32 @@ static int ion_system_heap_map_user(struct ion_heap *heap,
 				struct ion_buffer *buffer,
 				struct vm_area_struct *vma)
 {
+	struct ion_system_buffer *sys_buffer = buffer->priv_virt;
 	unsigned long uaddr = vma->vm_start;
 	unsigned long usize = vma->vm_end - vma->vm_start;
-	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
-	struct page **page_list = (struct page **)buffer->priv_virt;
-	int i = 0;
+	int i;
 
-	if (usize > (n_pages << PAGE_SHIFT))
+	if (usize > PAGE_ALIGN(buffer->size))
 		return -EINVAL;
 
-	do {
+	/*
+	 * The chunks are not compound pages, so map them by pfn rather than
+	 * taking references on the tail pages with vm_insert_page().
+	 */
+	for (i = 0; i < sys_buffer->nents && usize > 0; i++) {
+		struct ion_system_chunk *chunk = &sys_buffer->chunks[i];
+		unsigned long len = min_t(unsigned long, usize,
+					  PAGE_SIZE << chunk->order);
 		int ret;
 
-		ret = vm_insert_page(vma, uaddr, page_list[i]);
+		ret = remap_pfn_range(vma, uaddr, page_to_pfn(chunk->page),
+				      len, vma->vm_page_prot);
 		if (ret)
 			return ret;
 
-		uaddr += PAGE_SIZE;
-		usize -= PAGE_SIZE;
-	} while (usize > 0);
-
-	vma->vm_flags |= VM_RESERVED;
+		uaddr += len;
+		usize -= len;
+	}
 
 	return 0;
 }
@@ -148,21 +263,79 @@ static struct ion_heap_ops vmalloc_ops = {
 	.map_user = ion_system_heap_map_user,
 };
 
+static int ion_system_heap_shrink(struct shrinker *shrinker,
+				  struct shrink_control *sc)
+{
+	struct ion_system_heap *sys_heap = container_of(shrinker,
+							struct ion_system_heap,
+							shrinker);
+	int nr_to_scan = sc->nr_to_scan;
+	int nr_total = 0;
+	int i;
+
+	/* buffers waiting to be freed are about to land in the pools */
+	if (nr_to_scan && sys_heap->heap.task)
+		ion_heap_freelist_drain(&sys_heap->heap, 0);
+
+	/* drain the large blocks first, they are the hardest to come by */
+	for (i = NUM_ORDERS - 1; i >= 0; i--) {
+		struct ion_page_pool *pool = sys_heap->pools[i];
+		int before = ion_page_pool_shrink(pool, 0);
+		int after = ion_page_pool_shrink(pool, nr_to_scan);
+
+		nr_to_scan -= min(nr_to_scan, before - after);
+		nr_total += after;
+	}
+
+	return nr_total;
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *heap;
+	int i;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
+	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
-	return heap;
+	heap->heap.ops = &vmalloc_ops;
+	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		gfp_t gfp_flags = low_order_gfp_flags;
+
+		if (orders[i] > 0)
+			gfp_flags = high_order_gfp_flags;
+		heap->pools[i] = ion_page_pool_create(gfp_flags, orders[i]);
+		if (!heap->pools[i])
+			goto err;
+	}
+
+	heap->shrinker.shrink = ion_system_heap_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&heap->shrinker);
+	return &heap->heap;
+
+err:
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (heap->pools[i])
+			ion_page_pool_destroy(heap->pools[i]);
+	kfree(heap);
+	return ERR_PTR(-ENOMEM);
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	int i;
+
+	unregister_shrinker(&sys_heap->shrinker);
+	for (i = 0; i < NUM_ORDERS; i++)
+		ion_page_pool_destroy(sys_heap->pools[i]);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
@@ -214,14 +387,25 @@ static int ion_system_contig_heap_map_user(struct ion_heap *heap,
 
 }
 
+static void *ion_system_contig_heap_map_kernel(struct ion_heap *heap,
+					       struct ion_buffer *buffer)
+{
+	return buffer->priv_virt;
+}
+
+static void ion_system_contig_heap_unmap_kernel(struct ion_heap *heap,
+						struct ion_buffer *buffer)
+{
+}
+
 static struct ion_heap_ops kmalloc_ops = {
 	.allocate = ion_system_contig_heap_allocate,
 	.free = ion_system_contig_heap_free,
 	.phys = ion_system_contig_heap_phys,
 	.map_dma = ion_system_contig_heap_map_dma,
 	.unmap_dma = ion_system_heap_unmap_dma,
-	.map_kernel = ion_system_heap_map_kernel,
-	.unmap_kernel = ion_system_heap_unmap_kernel,
+	.map_kernel = ion_system_contig_heap_map_kernel,
+	.unmap_kernel = ion_system_contig_heap_unmap_kernel,
 	.map_user = ion_system_contig_heap_map_user,
 };
 
@@ -0,0 +1,377 @@
+/*
+ * drivers/gpu/ion/ion_usage.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/export.h>
+#include <linux/ion.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include "ion_priv.h"
+
+/**
+ * struct ion_tgid_usage - ion memory charged to a process
+ * @node:		node in ion_tgid_tree
+ * @tgid:		the thread group the memory is charged to
+ * @comm:		name of the thread group leader at first charge
+ * @size:		bytes currently charged
+ * @peak:		highest value @size has reached
+ * @buffers:		number of buffers currently charged
+ *
+ * A buffer is charged to the process of the client that allocated it and
+ * stays charged there until the last reference to it is dropped, no matter
+ * which processes it is shared with in between.  This is what the
+ * lowmemorykiller wants: killing the allocator is what releases it.
+ */
+struct ion_tgid_usage {
+	struct rb_node node;
+	pid_t tgid;
+	char comm[TASK_COMM_LEN];
+	size_t size;
+	size_t peak;
+	unsigned int buffers;
+};
+
+/* charges may be looked up from the lowmemorykiller, under rcu */
+static struct rb_root ion_tgid_tree = RB_ROOT;
+static DEFINE_SPINLOCK(ion_tgid_lock);
+
+/* this function should only be called while ion_tgid_lock is held */
+static struct ion_tgid_usage *ion_tgid_find(pid_t tgid,
+					    struct ion_tgid_usage *new)
+{
+	struct rb_node **p = &ion_tgid_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct ion_tgid_usage *entry;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct ion_tgid_usage, node);
+
+		if (tgid < entry->tgid)
+			p = &(*p)->rb_left;
+		else if (tgid > entry->tgid)
+			p = &(*p)->rb_right;
+		else
+			return entry;
+	}
+
+	if (!new)
+		return NULL;
+	rb_link_node(&new->node, parent, p);
+	rb_insert_color(&new->node, &ion_tgid_tree);
+	return new;
+}
+
+void ion_usage_charge(struct ion_client *client, struct ion_buffer *buffer)
+{
+	struct ion_tgid_usage *new, *usage;
+
+	/* kernel clients have no process to charge */
+	if (!client->task)
+		return;
+
+	new = kzalloc(sizeof(struct ion_tgid_usage), GFP_KERNEL);
+	if (new) {
+		new->tgid = client->pid;
+		get_task_comm(new->comm, client->task);
+	}
+
+	spin_lock(&ion_tgid_lock);
+	usage = ion_tgid_find(client->pid, new);
+	if (usage) {
+		usage->size += buffer->size;
+		usage->peak = max(usage->peak, usage->size);
+		usage->buffers++;
+		buffer->tgid = client->pid;
+	}
+	spin_unlock(&ion_tgid_lock);
+
+	if (usage != new)
+		kfree(new);
+}
+
+void ion_usage_uncharge(struct ion_buffer *buffer)
+{
+	struct ion_tgid_usage *usage;
+
+	if (!buffer->tgid)
+		return;
+
+	spin_lock(&ion_tgid_lock);
+	usage = ion_tgid_find(buffer->tgid, NULL);
+	if (!WARN_ON(!usage)) {
+		usage->size -= buffer->size;
+		if (!--usage->buffers)
+			rb_erase(&usage->node, &ion_tgid_tree);
+		else
+			usage = NULL;
+	}
+	spin_unlock(&ion_tgid_lock);
+
+	kfree(usage);
+	buffer->tgid = 0;
+}
+
+/**
+ * ion_tgid_usage() - bytes of ion memory charged to a process
+ * @tgid:	the thread group id
+ *
+ * Safe to call from atomic context.
+ */
+size_t ion_tgid_usage(pid_t tgid)
+{
+	struct ion_tgid_usage *usage;
+	size_t size = 0;
+
+	spin_lock(&ion_tgid_lock);
+	usage = ion_tgid_find(tgid, NULL);
+	if (usage)
+		size = usage->size;
+	spin_unlock(&ion_tgid_lock);
+
+	return size;
+}
+EXPORT_SYMBOL(ion_tgid_usage);
+
+static int ion_debug_tgids_show(struct seq_file *s, void *unused)
+{
+	struct rb_node *n;
+
+	spin_lock(&ion_tgid_lock);
+	for (n = rb_first(&ion_tgid_tree); n; n = rb_next(n)) {
+		struct ion_tgid_usage *usage = rb_entry(n,
+						struct ion_tgid_usage, node);
+
+		seq_printf(s, "Name:\t%s\n", usage->comm);
+		seq_printf(s, "Tgid:\t%d\n", usage->tgid);
+		seq_printf(s, "IonBuffers:\t%u\n", usage->buffers);
+		seq_printf(s, "IonMem:\t%8zu kB\n", usage->size >> 10);
+		seq_printf(s, "IonPeak:\t%8zu kB\n\n", usage->peak >> 10);
+	}
+	spin_unlock(&ion_tgid_lock);
+	return 0;
+}
+
+static int ion_debug_tgids_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_debug_tgids_show, inode->i_private);
+}
+
+static const struct file_operations debug_tgids_fops = {
+	.open = ion_debug_tgids_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Heap watermarks.  Once the bytes allocated from a heap reach high_wmark,
+ * the heap's pressure attribute reads 1 and pollers of it are woken; it
+ * drops back to 0, again waking pollers, once usage falls to low_wmark.
+ * A high_wmark of 0 disables the events.
+ */
+void ion_usage_heap_update(struct ion_heap *heap, long delta)
+{
+	size_t used = atomic_long_add_return(delta, &heap->used);
+	bool notify = false;
+
+	spin_lock(&heap->wmark_lock);
+	if (!heap->pressure && heap->high_wmark && used >= heap->high_wmark) {
+		heap->pressure = true;
+		heap->pressure_events++;
+		notify = true;
+	} else if (heap->pressure &&
+		   (!heap->high_wmark || used <= heap->low_wmark)) {
+		heap->pressure = false;
+		notify = true;
+	}
+	spin_unlock(&heap->wmark_lock);
+
+	if (notify && heap->pressure_sd)
+		sysfs_notify_dirent(heap->pressure_sd);
+}
+
+struct ion_heap_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct ion_heap *heap, char *buf);
+	ssize_t (*store)(struct ion_heap *heap, const char *buf, size_t count);
+};
+
+#define to_ion_heap(k) container_of(k, struct ion_heap, kobj)
+#define to_ion_heap_attr(a) container_of(a, struct ion_heap_attribute, attr)
+
+static ssize_t ion_heap_attr_show(struct kobject *kobj, struct attribute *attr,
+				  char *buf)
+{
+	struct ion_heap_attribute *heap_attr = to_ion_heap_attr(attr);
+
+	if (!heap_attr->show)
+		return -EIO;
+	return heap_attr->show(to_ion_heap(kobj), buf);
+}
+
+static ssize_t ion_heap_attr_store(struct kobject *kobj,
+				   struct attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct ion_heap_attribute *heap_attr = to_ion_heap_attr(attr);
+
+	if (!heap_attr->store)
+		return -EIO;
+	return heap_attr->store(to_ion_heap(kobj), buf, count);
+}
+
+static const struct sysfs_ops ion_heap_sysfs_ops = {
+	.show = ion_heap_attr_show,
+	.store = ion_heap_attr_store,
+};
+
+static ssize_t used_show(struct ion_heap *heap, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%ld\n",
+			atomic_long_read(&heap->used));
+}
+
+static ssize_t pressure_show(struct ion_heap *heap, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", heap->pressure);
+}
+
+static ssize_t pressure_events_show(struct ion_heap *heap, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%lu\n", heap->pressure_events);
+}
+
+static ssize_t high_wmark_show(struct ion_heap *heap, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%zu\n", heap->high_wmark);
+}
+
+static ssize_t low_wmark_show(struct ion_heap *heap, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%zu\n", heap->low_wmark);
+}
+
+static ssize_t wmark_store(struct ion_heap *heap, const char *buf,
+			   size_t count, bool high)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&heap->wmark_lock);
+	if (high) {
+		if (val && val < heap->low_wmark)
+			ret = -EINVAL;
+		else
+			heap->high_wmark = val;
+	} else {
+		if (heap->high_wmark && val > heap->high_wmark)
+			ret = -EINVAL;
+		else
+			heap->low_wmark = val;
+	}
+	spin_unlock(&heap->wmark_lock);
+	if (ret)
+		return ret;
+
+	/* the new watermarks may already be crossed */
+	ion_usage_heap_update(heap, 0);
+	return count;
+}
+
+static ssize_t high_wmark_store(struct ion_heap *heap, const char *buf,
+				size_t count)
+{
+	return wmark_store(heap, buf, count, true);
+}
+
+static ssize_t low_wmark_store(struct ion_heap *heap, const char *buf,
+			       size_t count)
+{
+	return wmark_store(heap, buf, count, false);
+}
+
+#define ION_HEAP_ATTR(_name, _mode, _show, _store) \
+	struct ion_heap_attribute ion_heap_attr_##_name = \
+		__ATTR(_name, _mode, _show, _store)
+
+static ION_HEAP_ATTR(used, 0444, used_show, NULL);
+static ION_HEAP_ATTR(pressure, 0444, pressure_show, NULL);
+static ION_HEAP_ATTR(pressure_events, 0444, pressure_events_show, NULL);
+static ION_HEAP_ATTR(high_wmark, 0644, high_wmark_show, high_wmark_store);
+static ION_HEAP_ATTR(low_wmark, 0644, low_wmark_show, low_wmark_store);
+
+static struct attribute *ion_heap_attrs[] = {
+	&ion_heap_attr_used.attr,
+	&ion_heap_attr_pressure.attr,
+	&ion_heap_attr_pressure_events.attr,
+	&ion_heap_attr_high_wmark.attr,
+	&ion_heap_attr_low_wmark.attr,
+	NULL,
+};
+
+static void ion_heap_kobj_release(struct kobject *kobj)
+{
+	/* the heap itself belongs to whoever created it */
+}
+
+static struct kobj_type ion_heap_ktype = {
+	.sysfs_ops = &ion_heap_sysfs_ops,
+	.default_attrs = ion_heap_attrs,
+	.release = ion_heap_kobj_release,
+};
+
+void ion_usage_heap_init(struct ion_device *dev, struct ion_heap *heap)
+{
+	int ret;
+
+	spin_lock_init(&heap->wmark_lock);
+	if (!dev->heaps_kobj)
+		return;
+
+	ret = kobject_init_and_add(&heap->kobj, &ion_heap_ktype,
+				   dev->heaps_kobj, "%s", heap->name);
+	if (ret) {
+		pr_err("%s: failed to add sysfs entry for heap %s\n",
+		       __func__, heap->name);
+		return;
+	}
+	heap->pressure_sd = sysfs_get_dirent(heap->kobj.sd, NULL, "pressure");
+}
+
+void ion_usage_init(struct ion_device *dev)
+{
+	dev->heaps_kobj = kobject_create_and_add("heaps",
+						 &dev->dev.this_device->kobj);
+	if (!dev->heaps_kobj)
+		pr_err("ion: failed to create heaps sysfs directory.\n");
+
+	if (IS_ERR_OR_NULL(dev->debug_root))
+		return;
+	debugfs_create_file("tgids", 0444, dev->debug_root, dev,
+			    &debug_tgids_fops);
+}
@@ -116,6 +116,9 @@ static int omap_ion_probe(struct platform_device *pdev)
 			goto err;
 		}
 		ion_device_add_heap(omap_ion_device, heaps[i]);
+		if (heaps[i]->type == OMAP_ION_HEAP_TYPE_TILER)
+			omap_tiler_heap_debugfs_init(heaps[i],
+						     omap_ion_device->debug_root);
 		pr_info("%s: adding heap %s of type %d with %lx@%x\n",
 			__func__, heap_data->name, heap_data->type,
 			heap_data->base, heap_data->size);
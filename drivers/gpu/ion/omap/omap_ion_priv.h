@@ -19,10 +19,13 @@
 
 #include <linux/types.h>
 
+struct dentry;
+
 int omap_tiler_alloc(struct ion_heap *heap,
 		     struct ion_client *client,
 		     struct omap_ion_tiler_alloc_data *data);
 struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *heap_data);
 void omap_tiler_heap_destroy(struct ion_heap *heap);
+void omap_tiler_heap_debugfs_init(struct ion_heap *heap, struct dentry *root);
 
 #endif /* _LINUX_OMAP_ION_PRIV_H */
@@ -14,13 +14,17 @@
  *
  */
 #include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/dma-contiguous.h>
 #include <linux/err.h>
 #include <linux/genalloc.h>
+#include <linux/highmem.h>
 #include <linux/io.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
 #include <linux/omap_ion.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
@@ -32,10 +36,27 @@
 #include "omap_ion_priv.h"
 #include <asm/cacheflush.h>
 
+/*
+ * Freed 2D containers are kept on a small LRU and handed to the next
+ * allocation with the same format, geometry and flags, which then skips
+ * the tiler reservation, the carveout allocation and the pinning.
+ */
+#define OMAP_TILER_CACHE_MAX	8
+
 struct omap_ion_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
 	ion_phys_addr_t base;
+	struct device *cma_dev;		/* CMA area instead of a pool */
+	struct mutex cache_lock;
+	struct list_head cache;		/* most recently freed first */
+	u32 cache_count;
+	u32 cache_max;
+	u32 cache_pages;
+	u32 cache_hits;
+	u32 cache_misses;
+	struct shrinker shrinker;
+	struct dentry *debug_root;
 };
 
 struct omap_tiler_info {
@@ -52,6 +73,10 @@ struct omap_tiler_info {
 					   first entry onf tiler_addrs */
 	u32 vsize;			/* virtual stride of buffer */
 	u32 vstride;			/* virtual size of buffer */
+	size_t w;			/* requested geometry and flags, the */
+	size_t h;			/* key for reusing the container */
+	unsigned int flags;
+	struct list_head cache_list;	/* on omap_ion_heap.cache once freed */
 };
 
 static int omap_tiler_heap_allocate(struct ion_heap *heap,
@@ -68,6 +93,40 @@ static int omap_tiler_heap_allocate(struct ion_heap *heap,
 	return -EINVAL;
 }
 
+static int omap_tiler_alloc_cma(struct omap_ion_heap *omap_heap,
+				struct omap_tiler_info *info)
+{
+	struct page *page;
+	phys_addr_t addr;
+	int i;
+
+	page = dma_alloc_from_contiguous(omap_heap->cma_dev,
+					 info->n_phys_pages, 0);
+	if (!page) {
+		pr_err("%s: failed to allocate %u pages from CMA\n",
+		       __func__, info->n_phys_pages);
+		return -ENOMEM;
+	}
+
+	/*
+	 * The pages may have been in use through the kernel mapping, don't
+	 * let dirty lines land on top of what the TILER users write.
+	 */
+	for (i = 0; i < info->n_phys_pages; i++) {
+		void *va = kmap_atomic(page + i);
+
+		dmac_flush_range(va, va + PAGE_SIZE);
+		kunmap_atomic(va);
+	}
+	addr = page_to_phys(page);
+	outer_flush_range(addr, addr + info->n_phys_pages * PAGE_SIZE);
+
+	info->lump = true;
+	for (i = 0; i < info->n_phys_pages; i++)
+		info->phys_addrs[i] = addr + i * PAGE_SIZE;
+	return 0;
+}
+
 static int omap_tiler_alloc_carveout(struct ion_heap *heap,
 				     struct omap_tiler_info *info)
 {
@@ -76,6 +135,9 @@ static int omap_tiler_alloc_carveout(struct ion_heap *heap,
 	int ret;
 	ion_phys_addr_t addr;
 
+	if (omap_heap->cma_dev)
+		return omap_tiler_alloc_cma(omap_heap, info);
+
 	addr = gen_pool_alloc(omap_heap->pool, info->n_phys_pages * PAGE_SIZE);
 	if (addr) {
 		info->lump = true;
@@ -109,6 +171,13 @@ static void omap_tiler_free_carveout(struct ion_heap *heap,
 	struct omap_ion_heap *omap_heap = (struct omap_ion_heap *)heap;
 	int i;
 
+	if (omap_heap->cma_dev) {
+		dma_release_from_contiguous(omap_heap->cma_dev,
+				pfn_to_page(__phys_to_pfn(info->phys_addrs[0])),
+				info->n_phys_pages);
+		return;
+	}
+
 	if (info->lump) {
 		gen_pool_free(omap_heap->pool,
 				info->phys_addrs[0],
@@ -120,6 +189,88 @@ static void omap_tiler_free_carveout(struct ion_heap *heap,
 		gen_pool_free(omap_heap->pool, info->phys_addrs[i], PAGE_SIZE);
 }
 
+static bool omap_tiler_has_carveout(struct ion_heap *heap)
+{
+	return (heap->id == OMAP_ION_HEAP_TILER) ||
+	       (heap->id == OMAP_ION_HEAP_NONSECURE_TILER);
+}
+
+static void omap_tiler_destroy_info(struct ion_heap *heap,
+				    struct omap_tiler_info *info)
+{
+	tiler_unpin(info->tiler_handle);
+	tiler_release(info->tiler_handle);
+
+	if (omap_tiler_has_carveout(heap))
+		omap_tiler_free_carveout(heap, info);
+
+	kfree(info);
+}
+
+static struct omap_tiler_info *omap_tiler_cache_get(
+				struct omap_ion_heap *omap_heap,
+				struct omap_ion_tiler_alloc_data *data)
+{
+	struct omap_tiler_info *info;
+
+	if (data->fmt == TILFMT_PAGE)
+		return NULL;
+
+	mutex_lock(&omap_heap->cache_lock);
+	list_for_each_entry(info, &omap_heap->cache, cache_list) {
+		if (info->fmt != data->fmt || info->w != data->w ||
+		    info->h != data->h || info->flags != data->flags)
+			continue;
+		list_del(&info->cache_list);
+		omap_heap->cache_count--;
+		omap_heap->cache_pages -= info->n_phys_pages;
+		omap_heap->cache_hits++;
+		mutex_unlock(&omap_heap->cache_lock);
+		return info;
+	}
+	omap_heap->cache_misses++;
+	mutex_unlock(&omap_heap->cache_lock);
+	return NULL;
+}
+
+/* evicts from the cold end until at most @max entries are left */
+static void omap_tiler_cache_trim(struct omap_ion_heap *omap_heap, u32 max)
+{
+	struct omap_tiler_info *info;
+	LIST_HEAD(evict);
+
+	while (omap_heap->cache_count > max) {
+		info = list_entry(omap_heap->cache.prev,
+				  struct omap_tiler_info, cache_list);
+		list_move(&info->cache_list, &evict);
+		omap_heap->cache_count--;
+		omap_heap->cache_pages -= info->n_phys_pages;
+	}
+	mutex_unlock(&omap_heap->cache_lock);
+
+	while (!list_empty(&evict)) {
+		info = list_first_entry(&evict, struct omap_tiler_info,
+					cache_list);
+		list_del(&info->cache_list);
+		omap_tiler_destroy_info(&omap_heap->heap, info);
+	}
+}
+
+static void omap_tiler_cache_put(struct omap_ion_heap *omap_heap,
+				 struct omap_tiler_info *info)
+{
+	if (info->fmt == TILFMT_PAGE || !omap_heap->cache_max) {
+		omap_tiler_destroy_info(&omap_heap->heap, info);
+		return;
+	}
+
+	mutex_lock(&omap_heap->cache_lock);
+	list_add(&info->cache_list, &omap_heap->cache);
+	omap_heap->cache_count++;
+	omap_heap->cache_pages += info->n_phys_pages;
+	omap_tiler_cache_trim(omap_heap, omap_heap->cache_max);
+}
+
 int omap_tiler_alloc(struct ion_heap *heap,
 		     struct ion_client *client,
 		     struct omap_ion_tiler_alloc_data *data)
@@ -139,6 +290,10 @@ int omap_tiler_alloc(struct ion_heap *heap,
 		return -EINVAL;
 	}
 
+	info = omap_tiler_cache_get((struct omap_ion_heap *)heap, data);
+	if (info)
+		goto got_info;
+
 	if (data->fmt == TILFMT_PAGE) {
 		/* calculate required pages the usual way */
 		n_phys_pages = round_up(data->w, PAGE_SIZE) >> PAGE_SHIFT;
@@ -162,6 +317,9 @@ int omap_tiler_alloc(struct ion_heap *heap,
 	info->phys_addrs = (u32 *)(info + 1);
 	info->tiler_addrs = info->phys_addrs + n_phys_pages;
 	info->fmt = data->fmt;
+	info->w = data->w;
+	info->h = data->h;
+	info->flags = data->flags;
 
 	/* Allocate tiler space
 	   FIXME: we only support PAGE_SIZE alignment right now. */
@@ -217,6 +375,7 @@ int omap_tiler_alloc(struct ion_heap *heap,
 		}
 	}
 
+got_info:
 	data->stride = info->vstride;
 
 	/* create an ion handle  for the allocation */
@@ -225,19 +384,18 @@ int omap_tiler_alloc(struct ion_heap *heap,
 		ret = PTR_ERR(handle);
 		pr_err("%s: failure to allocate handle to manage "
 				"tiler allocation\n", __func__);
-		goto err;
+		omap_tiler_cache_put((struct omap_ion_heap *)heap, info);
+		return ret;
 	}
 
 	buffer = ion_handle_buffer(handle);
-	buffer->size = n_tiler_pages * PAGE_SIZE;
+	buffer->size = info->n_tiler_pages * PAGE_SIZE;
 	buffer->priv_virt = info;
 	data->handle = handle;
 	data->offset = (size_t)(info->tiler_start & ~PAGE_MASK);
 
 	return 0;
 
-err:
-	tiler_unpin(info->tiler_handle);
 err_got_carveout:
 	if ((heap->id == OMAP_ION_HEAP_TILER) ||
 	    (heap->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
@@ -254,15 +412,7 @@ static void omap_tiler_heap_free(struct ion_buffer *buffer)
 {
 	struct omap_tiler_info *info = buffer->priv_virt;
 
-	tiler_unpin(info->tiler_handle);
-	tiler_release(info->tiler_handle);
-
-	if ((buffer->heap->id == OMAP_ION_HEAP_TILER) ||
-	    (buffer->heap->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
-		omap_tiler_free_carveout(buffer->heap, info);
-	}
-
-	kfree(info);
+	omap_tiler_cache_put((struct omap_ion_heap *)buffer->heap, info);
 }
 
 static int omap_tiler_phys(struct ion_heap *heap,
@@ -345,21 +495,14 @@ static int omap_tiler_heap_map_user(struct ion_heap *heap,
 	return ret;
 }
 
-static void per_cpu_cache_flush_arm(void *arg)
-{
-	   flush_cache_all();
-}
-
-static int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
-			unsigned long vaddr, enum cache_operation cacheop)
+static int omap_tiler_heap_sync_user(struct ion_buffer *buffer,
+				     unsigned long vaddr,
+				     struct ion_sync_range *ranges,
+				     int nr_ranges,
+				     enum dma_data_direction dir)
 {
 	struct omap_tiler_info *info;
-	int n_pages;
 
-	if (!buffer) {
-		pr_err("%s(): buffer is NULL\n", __func__);
-		return -EINVAL;
-	}
 	if (!buffer->cached) {
 		pr_err("%s(): buffer not mapped as cacheable\n", __func__);
 		return -EINVAL;
@@ -371,56 +514,87 @@ static int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 		return -EINVAL;
 	}
 
-	n_pages = info->n_tiler_pages;
-	if (len > (n_pages * PAGE_SIZE)) {
-		pr_err("%s(): size to flush is greater than allocated size\n",
-				__func__);
-		return -EINVAL;
-	}
-
 	if (TILER_PIXEL_FMT_PAGE != info->fmt) {
 		pr_err("%s(): only TILER 1D buffers can be cached\n", __func__);
 		return -EINVAL;
 	}
 
-	if (len > FULL_CACHE_FLUSH_THRESHOLD) {
-		on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
-		outer_flush_all();
-		return 0;
-	}
+	ion_cache_sync_ranges(buffer, vaddr, info->tiler_addrs[0], ranges,
+			      nr_ranges, dir);
+	return 0;
+}
 
-	__cpuc_coherent_user_range((vaddr) & PAGE_MASK, PAGE_ALIGN(vaddr+len));
+static struct ion_heap_ops omap_tiler_ops = {
+	.allocate = omap_tiler_heap_allocate,
+	.free = omap_tiler_heap_free,
+	.phys = omap_tiler_phys,
+	.map_user = omap_tiler_heap_map_user,
+	.sync_user = omap_tiler_heap_sync_user,
+};
 
-	if (cacheop == CACHE_FLUSH)
-		outer_flush_range(info->tiler_addrs[0],
-				info->tiler_addrs[0] + len);
-	else
-		outer_inv_range(info->tiler_addrs[0],
-				info->tiler_addrs[0] + len);
+static int omap_tiler_cache_shrink(struct shrinker *shrinker,
+				   struct shrink_control *sc)
+{
+	struct omap_ion_heap *omap_heap = container_of(shrinker,
+						       struct omap_ion_heap,
+						       shrinker);
+
+	if (!sc->nr_to_scan)
+		return omap_heap->cache_pages;
+
+	if (!mutex_trylock(&omap_heap->cache_lock))
+		return -1;
+	omap_tiler_cache_trim(omap_heap, 0);
 	return 0;
 }
 
-static int omap_tiler_heap_flush_user(struct ion_buffer *buffer, size_t len,
-			unsigned long vaddr)
+static int omap_tiler_cache_show(struct seq_file *s, void *unused)
 {
-	return omap_tiler_cache_operation(buffer, len, vaddr, CACHE_FLUSH);
+	struct omap_ion_heap *omap_heap = s->private;
+	u32 lookups;
+
+	mutex_lock(&omap_heap->cache_lock);
+	lookups = omap_heap->cache_hits + omap_heap->cache_misses;
+	seq_printf(s, "entries:  %u / %u\n", omap_heap->cache_count,
+		   omap_heap->cache_max);
+	seq_printf(s, "pages:    %u\n", omap_heap->cache_pages);
+	seq_printf(s, "hits:     %u\n", omap_heap->cache_hits);
+	seq_printf(s, "misses:   %u\n", omap_heap->cache_misses);
+	seq_printf(s, "hit rate: %u%%\n",
+		   lookups ? omap_heap->cache_hits * 100 / lookups : 0);
+	mutex_unlock(&omap_heap->cache_lock);
+	return 0;
 }
 
-static int omap_tiler_heap_inval_user(struct ion_buffer *buffer, size_t len,
-			unsigned long vaddr)
+static int omap_tiler_cache_open(struct inode *inode, struct file *file)
 {
-	return omap_tiler_cache_operation(buffer, len, vaddr, CACHE_INVALIDATE);
+	return single_open(file, omap_tiler_cache_show, inode->i_private);
 }
 
-static struct ion_heap_ops omap_tiler_ops = {
-	.allocate = omap_tiler_heap_allocate,
-	.free = omap_tiler_heap_free,
-	.phys = omap_tiler_phys,
-	.map_user = omap_tiler_heap_map_user,
-	.flush_user = omap_tiler_heap_flush_user,
-	.inval_user = omap_tiler_heap_inval_user,
+static const struct file_operations omap_tiler_cache_fops = {
+	.open = omap_tiler_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
 };
 
+void omap_tiler_heap_debugfs_init(struct ion_heap *heap, struct dentry *root)
+{
+	struct omap_ion_heap *omap_heap = (struct omap_ion_heap *)heap;
+	char name[64];
+
+	if (IS_ERR_OR_NULL(root))
+		return;
+	snprintf(name, sizeof(name), "%s_cache", heap->name);
+	omap_heap->debug_root = debugfs_create_dir(name, root);
+	if (IS_ERR_OR_NULL(omap_heap->debug_root))
+		return;
+	debugfs_create_file("stats", 0444, omap_heap->debug_root, omap_heap,
+			    &omap_tiler_cache_fops);
+	debugfs_create_u32("max", 0644, omap_heap->debug_root,
+			   &omap_heap->cache_max);
+}
+
 struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 {
 	struct omap_ion_heap *heap;
@@ -429,8 +603,11 @@ struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
 
-	if ((data->id == OMAP_ION_HEAP_TILER) ||
-	    (data->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
+	if (data->priv) {
+		/* the board declared a CMA area for this heap */
+		heap->cma_dev = data->priv;
+	} else if ((data->id == OMAP_ION_HEAP_TILER) ||
+		   (data->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
 		heap->pool = gen_pool_create(12, -1);
 		if (!heap->pool) {
 			kfree(heap);
@@ -443,12 +620,24 @@ struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 	heap->heap.type = OMAP_ION_HEAP_TYPE_TILER;
 	heap->heap.name = data->name;
 	heap->heap.id = data->id;
+
+	mutex_init(&heap->cache_lock);
+	INIT_LIST_HEAD(&heap->cache);
+	heap->cache_max = OMAP_TILER_CACHE_MAX;
+	heap->shrinker.shrink = omap_tiler_cache_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&heap->shrinker);
 	return &heap->heap;
 }
 
 void omap_tiler_heap_destroy(struct ion_heap *heap)
 {
 	struct omap_ion_heap *omap_ion_heap = (struct omap_ion_heap *)heap;
+
+	unregister_shrinker(&omap_ion_heap->shrinker);
+	debugfs_remove_recursive(omap_ion_heap->debug_root);
+	mutex_lock(&omap_ion_heap->cache_lock);
+	omap_tiler_cache_trim(omap_ion_heap, 0);
 	if (omap_ion_heap->pool)
 		gen_pool_destroy(omap_ion_heap->pool);
 	kfree(heap);
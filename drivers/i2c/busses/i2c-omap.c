@@ -45,7 +45,13 @@
 #include <linux/i2c-omap.h>
 #include <linux/pm_runtime.h>
 #include <plat/omap_device.h>
+#include <plat/dma.h>
 #include <linux/pm_qos.h>
+#include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 /* I2C controller revisions */
 #define OMAP_I2C_OMAP1_REV_2		0x20
@@ -58,6 +64,18 @@
 /* timeout waiting for the controller to respond */
 #define OMAP_I2C_TIMEOUT (msecs_to_jiffies(1000))
 
+/* The bus is normally free again within a bit time or two of a STOP */
+#define OMAP_I2C_BB_SPIN_US		50
+
+/* Idle the controller only after this long without transfers */
+#define OMAP_I2C_AUTOSUSPEND_DELAY	10	/* ms */
+
+/* Messages longer than the FIFO threshold go through the system DMA */
+#define OMAP_I2C_DMA_BUF_SIZE		PAGE_SIZE
+
+/* Number of slave addresses the bus time is accounted for */
+#define OMAP_I2C_MAX_CLIENTS		16
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -132,6 +150,8 @@ enum {
 #define OMAP_I2C_BUF_RXFIF_CLR	(1 << 14)	/* RX FIFO Clear */
 #define OMAP_I2C_BUF_XDMA_EN	(1 << 7)	/* TX DMA channel enable */
 #define OMAP_I2C_BUF_TXFIF_CLR	(1 << 6)	/* TX FIFO Clear */
+#define OMAP_I2C_BUF_RTRSH_MASK	(0x3f << 8)	/* RX FIFO threshold */
+#define OMAP_I2C_BUF_XTRSH_MASK	(0x3f << 0)	/* TX FIFO threshold */
 
 /* I2C Configuration Register (OMAP_I2C_CON): */
 #define OMAP_I2C_CON_EN		(1 << 15)	/* I2C module enable */
@@ -174,6 +194,13 @@ enum {
 #define I2C_OMAP_ERRATA_I207		(1 << 0)
 #define I2C_OMAP_ERRATA_I462		(1 << 1)
 
+struct omap_i2c_client_stats {
+	u16			addr;
+	unsigned long		xfers;
+	u64			bytes;
+	u64			time_ns;	/* bus held for this client */
+};
+
 struct omap_i2c_dev {
 	struct device		*dev;
 	void __iomem		*base;		/* virtual */
@@ -210,6 +237,20 @@ struct omap_i2c_dev {
 	bool			suspended;	/* if true - I2C device
 						   suspended and can't be
 						   accessible*/
+	bool			autosuspend;
+	u16			bufcfg;		/* BUF_REG outside DMA */
+
+	/* DMA, for messages longer than the FIFO threshold */
+	int			dma_tx_req;	/* -1 if none */
+	int			dma_rx_req;
+	int			dma_ch;
+	u8			*dma_buf;
+	dma_addr_t		dma_buf_phys;
+	dma_addr_t		data_phys;	/* DATA_REG bus address */
+	struct completion	dma_complete;
+
+	struct omap_i2c_client_stats clients[OMAP_I2C_MAX_CLIENTS];
+	struct dentry		*debugfs;
 };
 
 static const u8 reg_map_ip_v1[] = {
@@ -446,6 +487,7 @@ static int omap_i2c_init(struct omap_i2c_dev *dev)
 		buf = (dev->fifo_size - 1) << 8 | OMAP_I2C_BUF_RXFIF_CLR |
 			(dev->fifo_size - 1) | OMAP_I2C_BUF_TXFIF_CLR;
 		omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+		dev->bufcfg = buf;
 	}
 
 	/* Take the I2C module out of reset: */
@@ -483,6 +525,12 @@ static int omap_i2c_init(struct omap_i2c_dev *dev)
 static int omap_i2c_wait_for_bb(struct omap_i2c_dev *dev)
 {
 	unsigned long timeout;
+	int spin = OMAP_I2C_BB_SPIN_US;
+
+	/* don't sleep a whole tick for what takes a few microseconds */
+	while ((omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG) & OMAP_I2C_STAT_BB)
+	       && spin--)
+		udelay(1);
 
 	timeout = jiffies + OMAP_I2C_TIMEOUT;
 	while (omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG) & OMAP_I2C_STAT_BB) {
@@ -521,6 +569,160 @@ static int omap_i2c_bus_clear(struct omap_i2c_dev *dev)
 	return omap_i2c_wait_for_bb(dev);
 }
 
+static void omap_i2c_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	complete(&dev->dma_complete);
+}
+
+/* IE_REG is IRQENABLE_SET on IP v2, bits are cleared through IRQENABLE_CLR */
+static void omap_i2c_mask_irq(struct omap_i2c_dev *dev, u16 mask)
+{
+	if (dev->dtrev == OMAP_I2C_IP_VERSION_2)
+		omap_i2c_write_reg(dev, OMAP_I2C_IP_V2_IRQENABLE_CLR, mask);
+	else
+		omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate & ~mask);
+}
+
+/*
+ * Move the data of @msg with the system DMA, one request per byte, rather
+ * than from the FIFO interrupts.  Only ARDY (or an error) interrupts then,
+ * once the whole message is on the bus.
+ */
+static int omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	bool rd = msg->flags & I2C_M_RD;
+	int req = rd ? dev->dma_rx_req : dev->dma_tx_req;
+	u16 buf;
+	int r;
+
+	if (req < 0 || !dev->dma_buf || msg->len > OMAP_I2C_DMA_BUF_SIZE ||
+	    dev->b_hw || (dev->flags & OMAP_I2C_FLAG_16BIT_DATA_REG))
+		return -EINVAL;
+
+	r = omap_request_dma(req, "I2C DMA", omap_i2c_dma_callback, dev,
+			     &dev->dma_ch);
+	if (r)
+		return r;
+
+	if (rd) {
+		omap_set_dma_src_params(dev->dma_ch, 0, OMAP_DMA_AMODE_CONSTANT,
+					dev->data_phys, 0, 0);
+		omap_set_dma_dest_params(dev->dma_ch, 0,
+					 OMAP_DMA_AMODE_POST_INC,
+					 dev->dma_buf_phys, 0, 0);
+	} else {
+		/* client buffers may be on the stack: bounce them */
+		memcpy(dev->dma_buf, msg->buf, msg->len);
+		omap_set_dma_src_params(dev->dma_ch, 0, OMAP_DMA_AMODE_POST_INC,
+					dev->dma_buf_phys, 0, 0);
+		omap_set_dma_dest_params(dev->dma_ch, 0,
+					 OMAP_DMA_AMODE_CONSTANT,
+					 dev->data_phys, 0, 0);
+	}
+	omap_set_dma_transfer_params(dev->dma_ch, OMAP_DMA_DATA_TYPE_S8,
+				     msg->len, 1, OMAP_DMA_SYNC_ELEMENT, req,
+				     rd ? OMAP_DMA_SRC_SYNC : OMAP_DMA_DST_SYNC);
+
+	buf = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG) &
+		~(OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR);
+	if (rd)
+		buf = (buf & ~OMAP_I2C_BUF_RTRSH_MASK) | OMAP_I2C_BUF_RDMA_EN;
+	else
+		buf = (buf & ~OMAP_I2C_BUF_XTRSH_MASK) | OMAP_I2C_BUF_XDMA_EN;
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+
+	omap_i2c_mask_irq(dev, rd ? (OMAP_I2C_IE_RRDY | OMAP_I2C_IE_RDR) :
+				    (OMAP_I2C_IE_XRDY | OMAP_I2C_IE_XDR));
+
+	dev->buf_len = 0;
+	INIT_COMPLETION(dev->dma_complete);
+	omap_start_dma(dev->dma_ch);
+
+	return 0;
+}
+
+/* Undo omap_i2c_dma_start() or omap_i2c_prefill() */
+static void omap_i2c_restore_fifo(struct omap_i2c_dev *dev)
+{
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, dev->bufcfg);
+	/* data events seen while masked are stale */
+	omap_i2c_write_reg(dev, OMAP_I2C_STAT_REG,
+			   OMAP_I2C_STAT_RRDY | OMAP_I2C_STAT_RDR |
+			   OMAP_I2C_STAT_XRDY | OMAP_I2C_STAT_XDR);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+}
+
+static int omap_i2c_dma_finish(struct omap_i2c_dev *dev, struct i2c_msg *msg,
+			       bool ok)
+{
+	bool rd = msg->flags & I2C_M_RD;
+	int r = 0;
+
+	/* the last bytes read may still be on their way to memory */
+	if (ok && rd && !wait_for_completion_timeout(&dev->dma_complete,
+						     OMAP_I2C_TIMEOUT)) {
+		dev_err(dev->dev, "DMA timed out\n");
+		r = -ETIMEDOUT;
+	}
+
+	omap_stop_dma(dev->dma_ch);
+	omap_free_dma(dev->dma_ch);
+	omap_i2c_restore_fifo(dev);
+
+	if (ok && rd && !r)
+		memcpy(msg->buf, dev->dma_buf, msg->len);
+
+	return r;
+}
+
+/*
+ * A write that fits in the FIFO, typically the register address of a
+ * combined write-then-read, is queued before the START condition.  Only
+ * ARDY then interrupts, and the read can be started right away.
+ */
+static bool omap_i2c_prefill(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	if ((msg->flags & I2C_M_RD) || !dev->fifo_size || dev->b_hw ||
+	    (dev->flags & OMAP_I2C_FLAG_16BIT_DATA_REG) ||
+	    dev->buf_len > dev->fifo_size)
+		return false;
+
+	omap_i2c_mask_irq(dev, OMAP_I2C_IE_XRDY | OMAP_I2C_IE_XDR);
+	while (dev->buf_len) {
+		omap_i2c_write_reg(dev, OMAP_I2C_DATA_REG, *dev->buf++);
+		dev->buf_len--;
+	}
+
+	return true;
+}
+
+static void omap_i2c_account(struct omap_i2c_dev *dev, struct i2c_msg msgs[],
+			     int num, s64 ns)
+{
+	struct omap_i2c_client_stats *st = NULL;
+	int i;
+
+	for (i = 0; i < OMAP_I2C_MAX_CLIENTS; i++) {
+		st = &dev->clients[i];
+		if (!st->xfers) {
+			st->addr = msgs[0].addr;
+			break;
+		}
+		if (st->addr == msgs[0].addr)
+			break;
+	}
+	/* too many clients: the last entry counts for all the others */
+	if (i == OMAP_I2C_MAX_CLIENTS)
+		st->addr = 0xffff;
+
+	st->xfers++;
+	st->time_ns += ns;
+	for (i = 0; i < num; i++)
+		st->bytes += msgs[i].len;
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -529,6 +731,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
 	unsigned long timeout;
+	bool use_dma = false, prefilled = false;
+	int r = 0;
 	u16 w;
 
 	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
@@ -550,6 +754,11 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
 	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
 
+	if (dev->fifo_size && msg->len > dev->fifo_size)
+		use_dma = !omap_i2c_dma_start(dev, msg);
+	else
+		prefilled = omap_i2c_prefill(dev, msg);
+
 	INIT_COMPLETION(dev->cmd_complete);
 	dev->cmd_err = 0;
 
@@ -582,6 +791,10 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			if (time_after(jiffies, delay)) {
 				dev_err(dev->dev, "controller timed out "
 				"waiting for start condition to finish\n");
+				if (use_dma)
+					omap_i2c_dma_finish(dev, msg, false);
+				else if (prefilled)
+					omap_i2c_restore_fifo(dev);
 				return -ETIMEDOUT;
 			}
 			cpu_relax();
@@ -599,6 +812,11 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	timeout = wait_for_completion_timeout(&dev->cmd_complete,
 						OMAP_I2C_TIMEOUT);
 	dev->buf_len = 0;
+	if (use_dma)
+		r = omap_i2c_dma_finish(dev, msg, timeout && !dev->cmd_err);
+	else if (prefilled)
+		omap_i2c_restore_fifo(dev);
+
 	if (timeout == 0) {
 		dev_err(dev->dev, "controller timed out\n");
 		omap_i2c_init(dev);
@@ -606,7 +824,7 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	}
 
 	if (likely(!dev->cmd_err))
-		return 0;
+		return r;
 
 	/* We have an error */
 	if (dev->cmd_err & (OMAP_I2C_STAT_AL | OMAP_I2C_STAT_ROVR |
@@ -637,6 +855,7 @@ static int
 omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
+	ktime_t start;
 	int i;
 	int r;
 
@@ -681,11 +900,14 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	if (dev->latency)
 		pm_qos_update_request(&dev->pm_qos_request, dev->latency);
 
+	start = ktime_get();
 	for (i = 0; i < num; i++) {
 		r = omap_i2c_xfer_msg(adap, &msgs[i], (i == (num - 1)));
 		if (r != 0)
 			break;
 	}
+	omap_i2c_account(dev, msgs, num,
+			 ktime_to_ns(ktime_sub(ktime_get(), start)));
 
 	if (dev->latency)
 		pm_qos_update_request(&dev->pm_qos_request,
@@ -698,7 +920,12 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 out:
 	disable_irq(dev->irq);
 err_pm:
-	pm_runtime_put_sync(dev->dev);
+	if (dev->autosuspend) {
+		pm_runtime_mark_last_busy(dev->dev);
+		pm_runtime_put_autosuspend(dev->dev);
+	} else {
+		pm_runtime_put_sync(dev->dev);
+	}
 	omap_i2c_hwspinlock_unlock(dev);
 	return r;
 }
@@ -1033,6 +1260,95 @@ static const struct of_device_id omap_i2c_of_match[] = {
 MODULE_DEVICE_TABLE(of, omap_i2c_of_match);
 #endif
 
+#ifdef CONFIG_DEBUG_FS
+static int omap_i2c_clients_show(struct seq_file *s, void *unused)
+{
+	struct omap_i2c_dev *dev = s->private;
+	int i;
+
+	i2c_lock_adapter(&dev->adapter);
+	seq_printf(s, "addr   xfers      bytes      time_us\n");
+	for (i = 0; i < OMAP_I2C_MAX_CLIENTS && dev->clients[i].xfers; i++)
+		seq_printf(s, "0x%02x   %-10lu %-10llu %llu\n",
+			   dev->clients[i].addr, dev->clients[i].xfers,
+			   dev->clients[i].bytes,
+			   div_u64(dev->clients[i].time_ns, NSEC_PER_USEC));
+	i2c_unlock_adapter(&dev->adapter);
+
+	return 0;
+}
+
+static int omap_i2c_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_i2c_clients_show, inode->i_private);
+}
+
+static const struct file_operations omap_i2c_clients_fops = {
+	.open = omap_i2c_clients_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *omap_i2c_debugfs_root;
+
+static void omap_i2c_debugfs_init(struct omap_i2c_dev *dev)
+{
+	if (!omap_i2c_debugfs_root)
+		omap_i2c_debugfs_root = debugfs_create_dir("omap_i2c", NULL);
+	if (IS_ERR_OR_NULL(omap_i2c_debugfs_root))
+		return;
+
+	dev->debugfs = debugfs_create_file(dev_name(dev->dev), S_IRUGO,
+					   omap_i2c_debugfs_root, dev,
+					   &omap_i2c_clients_fops);
+}
+
+static void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev)
+{
+	debugfs_remove(dev->debugfs);
+}
+#else
+static inline void omap_i2c_debugfs_init(struct omap_i2c_dev *dev) { }
+static inline void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev) { }
+#endif
+
+static void __devinit omap_i2c_dma_init(struct omap_i2c_dev *dev,
+					struct platform_device *pdev,
+					struct resource *mem)
+{
+	struct resource *res;
+
+	dev->dma_tx_req = -1;
+	dev->dma_rx_req = -1;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "tx");
+	if (!res)
+		return;
+	dev->dma_tx_req = res->start;
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "rx");
+	if (!res) {
+		dev->dma_tx_req = -1;
+		return;
+	}
+	dev->dma_rx_req = res->start;
+
+	dev->data_phys = mem->start +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+	dev->dma_buf = dma_alloc_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+					  &dev->dma_buf_phys, GFP_KERNEL);
+	if (!dev->dma_buf)
+		dev_warn(dev->dev, "no DMA buffer, using the FIFO only\n");
+}
+
+static void omap_i2c_dma_exit(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_buf)
+		dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+				  dev->dma_buf, dev->dma_buf_phys);
+	dev->dma_buf = NULL;
+}
+
 static int __devinit
 omap_i2c_probe(struct platform_device *pdev)
 {
@@ -1092,6 +1408,7 @@ omap_i2c_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, dev);
 	init_completion(&dev->cmd_complete);
+	init_completion(&dev->dma_complete);
 
 	dev->reg_shift = (dev->flags >> OMAP_I2C_FLAG_BUS_SHIFT__SHIFT) & 3;
 
@@ -1100,10 +1417,24 @@ omap_i2c_probe(struct platform_device *pdev)
 	else
 		dev->regs = (u8 *)reg_map_ip_v1;
 
+	omap_i2c_dma_init(dev, pdev, mem);
+
+	/*
+	 * A bus shared with another processor must be released as soon as
+	 * it is done with: only keep a private controller awake a little.
+	 */
+	if (!pdata || !pdata->hwspin_lock_timeout) {
+		dev->autosuspend = true;
+		pm_runtime_set_autosuspend_delay(dev->dev,
+						 OMAP_I2C_AUTOSUSPEND_DELAY);
+		pm_runtime_use_autosuspend(dev->dev);
+	}
 	pm_runtime_enable(dev->dev);
 	r = pm_runtime_get_sync(dev->dev);
-	if (r < 0)
+	if (r < 0) {
+		omap_i2c_dma_exit(dev);
 		return -ENOMEM;
+	}
 
 	dev->pm_qos_request.dev = dev->dev;
 	pm_qos_add_request(&dev->pm_qos_request,
@@ -1181,6 +1512,7 @@ omap_i2c_probe(struct platform_device *pdev)
 	}
 
 	of_i2c_register_devices(adap);
+	omap_i2c_debugfs_init(dev);
 
 	pm_runtime_put(dev->dev);
 
@@ -1194,6 +1526,7 @@ err_unuse_clocks:
 	pm_runtime_disable(&pdev->dev);
 	platform_set_drvdata(pdev, NULL);
 	pm_qos_remove_request(&dev->pm_qos_request);
+	omap_i2c_dma_exit(dev);
 
 	return r;
 }
@@ -1205,6 +1538,7 @@ static int __devexit omap_i2c_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 
+	omap_i2c_debugfs_exit(dev);
 	free_irq(dev->irq, dev);
 	i2c_del_adapter(&dev->adapter);
 	ret = pm_runtime_get_sync(&pdev->dev);
@@ -1212,9 +1546,11 @@ static int __devexit omap_i2c_remove(struct platform_device *pdev)
 		return ret;
 
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 	pm_runtime_put(&pdev->dev);
 	pm_runtime_disable(&pdev->dev);
 	pm_qos_remove_request(&dev->pm_qos_request);
+	omap_i2c_dma_exit(dev);
 	return 0;
 }
 
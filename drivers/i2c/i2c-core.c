@@ -815,6 +815,8 @@ static int __process_new_adapter(struct device_driver *d, void *data)
 	return i2c_do_add_adapter(to_i2c_driver(d), data);
 }
 
+static void i2c_async_work(struct work_struct *work);
+
 static int i2c_register_adapter(struct i2c_adapter *adap)
 {
 	int res = 0;
@@ -840,6 +842,9 @@ static int i2c_register_adapter(struct i2c_adapter *adap)
 	rt_mutex_init(&adap->bus_lock);
 	mutex_init(&adap->userspace_clients_lock);
 	INIT_LIST_HEAD(&adap->userspace_clients);
+	spin_lock_init(&adap->async_lock);
+	INIT_LIST_HEAD(&adap->async_queue);
+	INIT_WORK(&adap->async_work, i2c_async_work);
 
 	/* Set default timeout to 1 second if not already set */
 	if (adap->timeout == 0)
@@ -1047,6 +1052,9 @@ int i2c_del_adapter(struct i2c_adapter *adap)
 		return -EINVAL;
 	}
 
+	/* Let queued asynchronous transfers complete */
+	flush_work_sync(&adap->async_work);
+
 	/* Tell drivers about this removal */
 	mutex_lock(&core_lock);
 	res = bus_for_each_drv(&i2c_bus_type, NULL, adap,
@@ -1366,6 +1374,61 @@ int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 }
 EXPORT_SYMBOL(i2c_transfer);
 
+static void i2c_async_work(struct work_struct *work)
+{
+	struct i2c_adapter *adap = container_of(work, struct i2c_adapter,
+						async_work);
+	struct i2c_async_xfer *xfer;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&adap->async_lock, flags);
+		xfer = NULL;
+		if (!list_empty(&adap->async_queue)) {
+			xfer = list_first_entry(&adap->async_queue,
+						struct i2c_async_xfer, node);
+			list_del(&xfer->node);
+		}
+		spin_unlock_irqrestore(&adap->async_lock, flags);
+		if (!xfer)
+			break;
+
+		xfer->complete(xfer, i2c_transfer(adap, xfer->msgs,
+						  xfer->num));
+	}
+}
+
+/**
+ * i2c_transfer_async - queue a single or combined I2C message
+ * @adap: Handle to I2C bus
+ * @xfer: The messages to transfer, and what to call when they are done
+ *
+ * The transfers queued on an adapter are executed in order, one after
+ * the other, from a workqueue, so that a client needing several of them
+ * (say, from an interrupt handler) neither has to sleep on each one nor
+ * to run a thread of its own.  May be called from any context.
+ *
+ * Returns negative errno if the transfer could not be queued, else 0.
+ */
+int i2c_transfer_async(struct i2c_adapter *adap, struct i2c_async_xfer *xfer)
+{
+	unsigned long flags;
+
+	if (!adap->algo->master_xfer)
+		return -EOPNOTSUPP;
+	if (!xfer->complete || xfer->num <= 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&adap->async_lock, flags);
+	list_add_tail(&xfer->node, &adap->async_queue);
+	spin_unlock_irqrestore(&adap->async_lock, flags);
+
+	queue_work(system_nrt_wq, &adap->async_work);
+
+	return 0;
+}
+EXPORT_SYMBOL(i2c_transfer_async);
+
 /**
  * i2c_master_send - issue a single I2C message in master transmit mode
  * @client: Handle to slave device
@@ -13,11 +13,13 @@
 #define EVDEV_MINOR_BASE	64
 #define EVDEV_MINORS		32
 #define EVDEV_MIN_BUFFER_SIZE	64U
+#define EVDEV_MAX_BUFFER_SIZE	8192U
 #define EVDEV_BUF_PACKETS	8
 
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/input/mt.h>
@@ -26,6 +28,9 @@
 #include <linux/wakelock.h>
 #include "input-compat.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/input.h>
+
 struct evdev {
 	int open;
 	int minor;
@@ -37,6 +42,7 @@ struct evdev {
 	struct mutex mutex;
 	struct device dev;
 	bool exist;
+	unsigned long dropped; /* lost by all clients, under event_lock */
 };
 
 struct evdev_client {
@@ -51,8 +57,9 @@ struct evdev_client {
 	struct evdev *evdev;
 	struct list_head node;
 	int clkid;
+	unsigned int dropped;
 	unsigned int bufsize;
-	struct input_event buffer[];
+	struct input_event *buffer;
 };
 
 static struct evdev *evdev_table[EVDEV_MINORS];
@@ -77,6 +84,8 @@ static void evdev_pass_event(struct evdev_client *client,
 		 * EV_SYN/SYN_DROPPED plus the newest event in the queue.
 		 */
 		client->tail = (client->head - 2) & (client->bufsize - 1);
+		client->dropped += client->bufsize - 1;
+		client->evdev->dropped += client->bufsize - 1;
 
 		client->buffer[client->tail].time = event->time;
 		client->buffer[client->tail].type = EV_SYN;
@@ -105,11 +114,13 @@ static void evdev_event(struct input_handle *handle,
 			unsigned int type, unsigned int code, int value)
 {
 	struct evdev *evdev = handle->private;
+	struct input_dev *dev = handle->dev;
 	struct evdev_client *client;
 	struct input_event event;
-	ktime_t time_mono, time_real;
+	ktime_t now, time_mono, time_real;
 
-	time_mono = ktime_get();
+	now = ktime_get();
+	time_mono = dev->timestamp.tv64 ? dev->timestamp : now;
 	time_real = ktime_sub(time_mono, ktime_get_monotonic_offset());
 
 	event.type = type;
@@ -128,8 +139,12 @@ static void evdev_event(struct input_handle *handle,
 
 	rcu_read_unlock();
 
-	if (type == EV_SYN && code == SYN_REPORT)
+	if (type == EV_SYN && code == SYN_REPORT) {
+		trace_input_frame(dev->name ? dev->name : "",
+				  dev->timestamp.tv64 ?
+				  ktime_to_us(ktime_sub(now, time_mono)) : 0);
 		wake_up_interruptible(&evdev->wait);
+	}
 }
 
 static int evdev_fasync(int fd, struct file *file, int on)
@@ -158,6 +173,26 @@ static int evdev_flush(struct file *file, fl_owner_t id)
 	return retval;
 }
 
+static struct input_event *evdev_alloc_buffer(unsigned int bufsize)
+{
+	size_t size = bufsize * sizeof(struct input_event);
+	struct input_event *buffer;
+
+	buffer = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (!buffer)
+		buffer = vzalloc(size);
+
+	return buffer;
+}
+
+static void evdev_free_buffer(struct input_event *buffer)
+{
+	if (is_vmalloc_addr(buffer))
+		vfree(buffer);
+	else
+		kfree(buffer);
+}
+
 static void evdev_free(struct device *dev)
 {
 	struct evdev *evdev = container_of(dev, struct evdev, dev);
@@ -274,6 +309,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 	evdev_detach_client(evdev, client);
 	if (client->use_wake_lock)
 		wake_lock_destroy(&client->wake_lock);
+	evdev_free_buffer(client->buffer);
 	kfree(client);
 
 	evdev_close_device(evdev);
@@ -315,14 +351,18 @@ static int evdev_open(struct inode *inode, struct file *file)
 
 	bufsize = evdev_compute_buffer_size(evdev->handle.dev);
 
-	client = kzalloc(sizeof(struct evdev_client) +
-				bufsize * sizeof(struct input_event),
-			 GFP_KERNEL);
+	client = kzalloc(sizeof(struct evdev_client), GFP_KERNEL);
 	if (!client) {
 		error = -ENOMEM;
 		goto err_put_evdev;
 	}
 
+	client->buffer = evdev_alloc_buffer(bufsize);
+	if (!client->buffer) {
+		error = -ENOMEM;
+		goto err_free_client_struct;
+	}
+
 	client->clkid = CLOCK_MONOTONIC;
 	client->bufsize = bufsize;
 	spin_lock_init(&client->buffer_lock);
@@ -342,6 +382,8 @@ static int evdev_open(struct inode *inode, struct file *file)
 
  err_free_client:
 	evdev_detach_client(evdev, client);
+	evdev_free_buffer(client->buffer);
+ err_free_client_struct:
 	kfree(client);
  err_put_evdev:
 	put_device(&evdev->dev);
@@ -699,6 +741,56 @@ static int evdev_disable_suspend_block(struct evdev *evdev,
 	return 0;
 }
 
+/*
+ * Replace the client's ring with one of @bufsize events (rounded up to
+ * a power of two). Queued events are carried over, so a reader that
+ * wants a smaller ring than what is pending has to drain it first.
+ */
+static int evdev_set_buffer_size(struct evdev_client *client,
+				 unsigned int bufsize)
+{
+	struct input_event *buffer, *old;
+	unsigned int pending, packet, i;
+
+	if (bufsize < EVDEV_MIN_BUFFER_SIZE || bufsize > EVDEV_MAX_BUFFER_SIZE)
+		return -EINVAL;
+
+	bufsize = roundup_pow_of_two(bufsize);
+	if (bufsize == client->bufsize)
+		return 0;
+
+	buffer = evdev_alloc_buffer(bufsize);
+	if (!buffer)
+		return -ENOMEM;
+
+	spin_lock_irq(&client->buffer_lock);
+
+	pending = (client->head - client->tail) & (client->bufsize - 1);
+	if (pending >= bufsize) {
+		spin_unlock_irq(&client->buffer_lock);
+		evdev_free_buffer(buffer);
+		return -EBUSY;
+	}
+
+	packet = (client->packet_head - client->tail) & (client->bufsize - 1);
+	for (i = 0; i < pending; i++)
+		buffer[i] = client->buffer[(client->tail + i) &
+					   (client->bufsize - 1)];
+
+	old = client->buffer;
+	client->buffer = buffer;
+	client->bufsize = bufsize;
+	client->tail = 0;
+	client->head = pending;
+	client->packet_head = packet;
+
+	spin_unlock_irq(&client->buffer_lock);
+
+	evdev_free_buffer(old);
+
+	return 0;
+}
+
 static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 			   void __user *p, int compat_mode)
 {
@@ -769,6 +861,17 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 		client->clkid = i;
 		return 0;
 
+	case EVIOCGBUFSIZE:
+		return put_user(client->bufsize, ip);
+
+	case EVIOCSBUFSIZE:
+		if (get_user(u, ip))
+			return -EFAULT;
+		return evdev_set_buffer_size(client, u);
+
+	case EVIOCGDROPPED:
+		return put_user(client->dropped, ip);
+
 	case EVIOCGKEYCODE:
 		return evdev_handle_get_keycode(dev, p);
 
@@ -999,6 +1102,29 @@ static void evdev_cleanup(struct evdev *evdev)
 	}
 }
 
+static ssize_t evdev_show_dropped(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct evdev *evdev = container_of(dev, struct evdev, dev);
+
+	return sprintf(buf, "%lu\n", evdev->dropped);
+}
+static DEVICE_ATTR(dropped, S_IRUGO, evdev_show_dropped, NULL);
+
+static struct attribute *evdev_attrs[] = {
+	&dev_attr_dropped.attr,
+	NULL
+};
+
+static const struct attribute_group evdev_attr_group = {
+	.attrs = evdev_attrs,
+};
+
+static const struct attribute_group *evdev_attr_groups[] = {
+	&evdev_attr_group,
+	NULL
+};
+
 /*
  * Create new evdev device. Note that input core serializes calls
  * to connect and disconnect so we don't need to lock evdev_table here.
@@ -1040,6 +1166,7 @@ static int evdev_connect(struct input_handler *handler, struct input_dev *dev,
 	evdev->dev.devt = MKDEV(INPUT_MAJOR, EVDEV_MINOR_BASE + minor);
 	evdev->dev.class = &input_class;
 	evdev->dev.parent = &dev->dev;
+	evdev->dev.groups = evdev_attr_groups;
 	evdev->dev.release = evdev_free;
 	device_initialize(&evdev->dev);
 
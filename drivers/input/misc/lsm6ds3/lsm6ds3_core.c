@@ -98,6 +98,11 @@
 #define LSM6DS3_FIFO_THR_IRQ_MASK		0x08
 #define LSM6DS3_FIFO_PEDO_E_ADDR		0x07
 #define LSM6DS3_FIFO_PEDO_E_MASK		0x80
+#define LSM6DS3_FIFO_STATUS_LEN			4
+#define LSM6DS3_FIFO_PATTERN_MASK		0x03ff
+#define LSM6DS3_FIFO_WORDS_FOR_SAMPLE		3
+#define LSM6DS3_BATCH_MAX_SAMPLES		256
+#define LSM6DS3_EVENTS_FOR_SAMPLE		6
 #define LSM6DS3_FIFO_STEP_C_FREQ		25
 
 /* CUSTOM VALUES FOR ACCEL SENSOR */
@@ -345,6 +350,14 @@ static int lsm6ds3_input_init(struct lsm6ds3_sensor_data *sdata, u16 bustype,
 					(sdata->sindex == LSM6DS3_GYRO)) {
 		__set_bit(INPUT_EVENT_Y, sdata->input_dev->mscbit);
 		__set_bit(INPUT_EVENT_Z, sdata->input_dev->mscbit);
+
+		/*
+		 * evdev sizes client buffers to 8 packets: make room for a
+		 * whole batch so a FIFO flush is not dropped before read().
+		 */
+		input_set_events_per_packet(sdata->input_dev,
+				LSM6DS3_EVENTS_FOR_SAMPLE *
+				LSM6DS3_BATCH_MAX_SAMPLES / 8);
 	}
 
 	err = input_register_device(sdata->input_dev);
@@ -484,6 +497,266 @@ static void poll_function_work(struct work_struct *input_work)
 	}
 }
 
+static u8 lsm6ds3_fifo_decimator(u32 ratio)
+{
+	switch (ratio) {
+	case 0:
+		return 0x00;
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+		return ratio;
+	case 8:
+		return 0x05;
+	case 16:
+		return 0x06;
+	case 32:
+		return 0x07;
+	default:
+		return 0x01;
+	}
+}
+
+static void lsm6ds3_fifo_build_pattern(struct lsm6ds3_data *cdata, u32 *ratio)
+{
+	u32 tick, cycle = max(ratio[LSM6DS3_ACCEL], ratio[LSM6DS3_GYRO]);
+	u8 n = 0;
+
+	/* gyro is data set 1 and accel data set 2 of every FIFO ODR tick */
+	for (tick = 0; tick < cycle; tick++) {
+		if (ratio[LSM6DS3_GYRO] && !(tick % ratio[LSM6DS3_GYRO])) {
+			cdata->fifo_pattern[n] = LSM6DS3_GYRO;
+			cdata->fifo_pattern_tick[n++] = tick;
+		}
+		if (ratio[LSM6DS3_ACCEL] && !(tick % ratio[LSM6DS3_ACCEL])) {
+			cdata->fifo_pattern[n] = LSM6DS3_ACCEL;
+			cdata->fifo_pattern_tick[n++] = tick;
+		}
+	}
+
+	cdata->fifo_pattern_len = n;
+}
+
+static inline bool lsm6ds3_fifo_new_tick(struct lsm6ds3_data *cdata, int slot)
+{
+	return !slot || (cdata->fifo_pattern_tick[slot] !=
+					cdata->fifo_pattern_tick[slot - 1]);
+}
+
+/*
+ * Drain the FIFO and report every sample on its own input device. The newest
+ * ODR tick is stamped with the time of the status read and older ones are
+ * spaced back by the FIFO period, so one flush gives a whole timed batch.
+ */
+static int lsm6ds3_fifo_read(struct lsm6ds3_data *cdata)
+{
+	u8 status[LSM6DS3_FIFO_STATUS_LEN], *data;
+	struct lsm6ds3_sensor_data *sdata;
+	int err, i, j, chunk, samples, slot, first, tick, n_ticks;
+	int64_t now, period;
+	s32 xyz[3];
+
+	err = cdata->tf->read(cdata, LSM6DS3_FIFO_DIFF_L,
+				LSM6DS3_FIFO_STATUS_LEN, status, true);
+	if (err < 0)
+		return err;
+
+	now = lsm6ds3_get_time_ns();
+
+	samples = ((status[0] | (status[1] << 8)) & LSM6DS3_FIFO_DIFF_MASK) /
+					LSM6DS3_FIFO_WORDS_FOR_SAMPLE;
+	if (!samples || !cdata->fifo_pattern_len)
+		return 0;
+
+	first = ((status[2] | (status[3] << 8)) & LSM6DS3_FIFO_PATTERN_MASK) /
+					LSM6DS3_FIFO_WORDS_FOR_SAMPLE;
+	first %= cdata->fifo_pattern_len;
+
+	for (i = 0, n_ticks = 0, slot = first; i < samples; i++) {
+		if (!i || lsm6ds3_fifo_new_tick(cdata, slot))
+			n_ticks++;
+		slot = (slot + 1) % cdata->fifo_pattern_len;
+	}
+
+	period = HZ_TO_PERIOD_NSEC(cdata->fifo_odr);
+	tick = -1;
+	slot = first;
+
+	for (i = 0; i < samples; i += chunk) {
+		chunk = min_t(int, samples - i, LSM6DS3_FIFO_READ_LEN /
+					LSM6DS3_FIFO_ELEMENT_LEN_BYTE);
+
+		err = cdata->tf->read(cdata, LSM6DS3_FIFO_DATA_OUT_L,
+				chunk * LSM6DS3_FIFO_ELEMENT_LEN_BYTE,
+				cdata->fifo_data, true);
+		if (err < 0)
+			return err;
+
+		for (j = 0; j < chunk; j++) {
+			data = &cdata->fifo_data[j *
+					LSM6DS3_FIFO_ELEMENT_LEN_BYTE];
+
+			if (!(i + j) || lsm6ds3_fifo_new_tick(cdata, slot))
+				tick++;
+
+			sdata = &cdata->sensors[cdata->fifo_pattern[slot]];
+			slot = (slot + 1) % cdata->fifo_pattern_len;
+
+			if (sdata->sample_to_discard) {
+				sdata->sample_to_discard--;
+				continue;
+			}
+
+			xyz[0] = (s32)((s16)(data[0] | (data[1] << 8)));
+			xyz[1] = (s32)((s16)(data[2] | (data[3] << 8)));
+			xyz[2] = (s32)((s16)(data[4] | (data[5] << 8)));
+			xyz[0] *= sdata->c_gain;
+			xyz[1] *= sdata->c_gain;
+			xyz[2] *= sdata->c_gain;
+
+			lsm6ds3_report_3axes_event(sdata, xyz,
+				now - (int64_t)(n_ticks - 1 - tick) * period);
+		}
+	}
+
+	return 0;
+}
+
+static enum hrtimer_restart lsm6ds3_fifo_poll_function(struct hrtimer *timer)
+{
+	struct lsm6ds3_data *cdata;
+
+	cdata = container_of(timer, struct lsm6ds3_data, fifo_timer);
+	queue_work(lsm6ds3_workqueue, &cdata->fifo_work);
+
+	return HRTIMER_NORESTART;
+}
+
+static void lsm6ds3_fifo_work(struct work_struct *fifo_work)
+{
+	struct lsm6ds3_data *cdata;
+	int err;
+
+	cdata = container_of(fifo_work, struct lsm6ds3_data, fifo_work);
+
+	mutex_lock(&cdata->lock);
+	if (cdata->fifo_enabled) {
+		hrtimer_start(&cdata->fifo_timer, cdata->fifo_ktime,
+							HRTIMER_MODE_REL);
+
+		err = lsm6ds3_fifo_read(cdata);
+		if (err < 0)
+			dev_err(cdata->dev, "FIFO read failed %d\n", err);
+	}
+	mutex_unlock(&cdata->lock);
+}
+
+/*
+ * Reprogram the FIFO for the enabled sensors that have a max_latency set.
+ * The FIFO runs at the fastest of their ODRs, the others are decimated, and
+ * it is emptied once per the shortest requested latency.
+ */
+static int lsm6ds3_fifo_update(struct lsm6ds3_data *cdata)
+{
+	struct lsm6ds3_sensor_data *sdata;
+	u32 ratio[2] = { 0, 0 }, odr = 0;
+	unsigned int latency = UINT_MAX, max_ms;
+	int err, i;
+
+	mutex_lock(&cdata->lock);
+	if (cdata->fifo_enabled) {
+		/* hand out what was batched with the old configuration */
+		lsm6ds3_fifo_read(cdata);
+		cdata->fifo_enabled = false;
+	}
+	mutex_unlock(&cdata->lock);
+
+	hrtimer_cancel(&cdata->fifo_timer);
+	cancel_work_sync(&cdata->fifo_work);
+
+	mutex_lock(&cdata->lock);
+
+	for (i = LSM6DS3_ACCEL; i <= LSM6DS3_GYRO; i++) {
+		sdata = &cdata->sensors[i];
+		if (!sdata->enabled || !sdata->max_latency_ms)
+			continue;
+
+		/* one flush must fit in a single evdev client buffer */
+		max_ms = LSM6DS3_BATCH_MAX_SAMPLES * 1000 / sdata->c_odr;
+
+		latency = min(latency, min(sdata->max_latency_ms, max_ms));
+		odr = max(odr, sdata->c_odr);
+	}
+
+	for (i = LSM6DS3_ACCEL; odr && (i <= LSM6DS3_GYRO); i++) {
+		sdata = &cdata->sensors[i];
+		if (sdata->enabled && sdata->max_latency_ms)
+			ratio[i] = odr / sdata->c_odr;
+	}
+
+	/* bypass mode also empties the FIFO */
+	err = lsm6ds3_write_data_with_mask(cdata, LSM6DS3_FIFO_MODE_ADDR,
+				LSM6DS3_FIFO_MODE_MASK,
+				LSM6DS3_FIFO_MODE_BYPASS, true);
+	if (err < 0)
+		goto lsm6ds3_fifo_update_mutex_unlock;
+
+	err = lsm6ds3_write_data_with_mask(cdata, LSM6DS3_FIFO_CTRL3_ADDR,
+				LSM6DS3_FIFO_ACCEL_DECIMATOR_MASK,
+				lsm6ds3_fifo_decimator(ratio[LSM6DS3_ACCEL]),
+				true);
+	if (err < 0)
+		goto lsm6ds3_fifo_update_mutex_unlock;
+
+	err = lsm6ds3_write_data_with_mask(cdata, LSM6DS3_FIFO_CTRL3_ADDR,
+				LSM6DS3_FIFO_GYRO_DECIMATOR_MASK,
+				lsm6ds3_fifo_decimator(ratio[LSM6DS3_GYRO]),
+				true);
+	if (err < 0)
+		goto lsm6ds3_fifo_update_mutex_unlock;
+
+	if (!odr) {
+		err = lsm6ds3_write_data_with_mask(cdata,
+				LSM6DS3_FIFO_ODR_ADDR, LSM6DS3_FIFO_ODR_MASK,
+				LSM6DS3_FIFO_ODR_OFF, true);
+		goto lsm6ds3_fifo_update_mutex_unlock;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(lsm6ds3_odr_table.odr_avl); i++) {
+		if (lsm6ds3_odr_table.odr_avl[i].hz == odr)
+			break;
+	}
+	if (i == ARRAY_SIZE(lsm6ds3_odr_table.odr_avl)) {
+		err = -EINVAL;
+		goto lsm6ds3_fifo_update_mutex_unlock;
+	}
+
+	err = lsm6ds3_write_data_with_mask(cdata, LSM6DS3_FIFO_ODR_ADDR,
+				LSM6DS3_FIFO_ODR_MASK,
+				lsm6ds3_odr_table.odr_avl[i].value, true);
+	if (err < 0)
+		goto lsm6ds3_fifo_update_mutex_unlock;
+
+	lsm6ds3_fifo_build_pattern(cdata, ratio);
+
+	err = lsm6ds3_write_data_with_mask(cdata, LSM6DS3_FIFO_MODE_ADDR,
+				LSM6DS3_FIFO_MODE_MASK,
+				LSM6DS3_FIFO_MODE_CONTINUOS, true);
+	if (err < 0)
+		goto lsm6ds3_fifo_update_mutex_unlock;
+
+	cdata->fifo_odr = odr;
+	cdata->fifo_ktime = ktime_set(latency / MSEC_PER_SEC,
+				(latency % MSEC_PER_SEC) * NSEC_PER_MSEC);
+	cdata->fifo_enabled = true;
+	hrtimer_start(&cdata->fifo_timer, cdata->fifo_ktime, HRTIMER_MODE_REL);
+
+lsm6ds3_fifo_update_mutex_unlock:
+	mutex_unlock(&cdata->lock);
+	return (err < 0 ? err : 0);
+}
+
 int lsm6ds3_set_drdy_irq(struct lsm6ds3_sensor_data *sdata, bool state)
 {
 	u8 reg_addr, mask, value;
@@ -741,7 +1014,9 @@ static int lsm6ds3_enable_sensors(struct lsm6ds3_sensor_data *sdata)
 		if (err < 0)
 			return err;
 
-		hrtimer_start(&sdata->hr_timer, sdata->ktime, HRTIMER_MODE_REL);
+		if (!sdata->max_latency_ms)
+			hrtimer_start(&sdata->hr_timer, sdata->ktime,
+							HRTIMER_MODE_REL);
 		sdata->c_odr = lsm6ds3_odr_table.odr_avl[i].hz;
 
 		break;
@@ -808,6 +1083,9 @@ static int lsm6ds3_enable_sensors(struct lsm6ds3_sensor_data *sdata)
 
 	sdata->enabled = true;
 
+	if (sdata->max_latency_ms)
+		return lsm6ds3_fifo_update(sdata->cdata);
+
 	return 0;
 }
 
@@ -899,6 +1177,9 @@ static int lsm6ds3_disable_sensors(struct lsm6ds3_sensor_data *sdata)
 
 	sdata->enabled = false;
 
+	if (sdata->max_latency_ms)
+		return lsm6ds3_fifo_update(sdata->cdata);
+
 	return 0;
 }
 
@@ -967,6 +1248,9 @@ static int lsm6ds3_init_sensors(struct lsm6ds3_data *cdata)
 						&lsm6ds3_poll_function_read;
 	cdata->sensors[LSM6DS3_GYRO].hr_timer.function =
 						&lsm6ds3_poll_function_read;
+	hrtimer_init(&cdata->fifo_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cdata->fifo_timer.function = &lsm6ds3_fifo_poll_function;
+	INIT_WORK(&cdata->fifo_work, lsm6ds3_fifo_work);
 
 	cdata->steps_c = 0;
 	cdata->reset_steps = false;
@@ -1090,6 +1374,9 @@ static int lsm6ds3_set_odr(struct lsm6ds3_sensor_data *sdata, u32 odr)
 
 		sdata->c_odr = lsm6ds3_odr_table.odr_avl[i].hz;
 		enable_irq(sdata->cdata->irq);
+
+		if (sdata->max_latency_ms)
+			err = lsm6ds3_fifo_update(sdata->cdata);
 	} else
 		sdata->c_odr = lsm6ds3_odr_table.odr_avl[i].hz;
 
@@ -1184,6 +1471,51 @@ static ssize_t set_sampling_freq(struct device *dev,
 	return (err < 0 ? err : count);
 }
 
+static ssize_t get_max_latency(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct lsm6ds3_sensor_data *sdata = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", sdata->max_latency_ms);
+}
+
+static ssize_t set_max_latency(struct device *dev,
+				struct device_attribute *attr, const char *buf,
+				size_t count)
+{
+	int err = 0;
+	unsigned int max_latency;
+	struct lsm6ds3_sensor_data *sdata = dev_get_drvdata(dev);
+
+	err = kstrtouint(buf, 10, &max_latency);
+	if (err < 0)
+		return err;
+
+	mutex_lock(&sdata->input_dev->mutex);
+	if (sdata->max_latency_ms == max_latency)
+		goto lsm6ds3_set_max_latency_mutex_unlock;
+
+	if (sdata->enabled) {
+		/* move the sensor between its poll timer and the FIFO */
+		if (max_latency) {
+			cancel_work_sync(&sdata->input_work);
+			hrtimer_cancel(&sdata->hr_timer);
+		} else
+			hrtimer_start(&sdata->hr_timer, sdata->ktime,
+							HRTIMER_MODE_REL);
+	}
+
+	sdata->max_latency_ms = max_latency;
+
+	if (sdata->enabled)
+		err = lsm6ds3_fifo_update(sdata->cdata);
+
+lsm6ds3_set_max_latency_mutex_unlock:
+	mutex_unlock(&sdata->input_dev->mutex);
+
+	return (err < 0 ? err : count);
+}
+
 static ssize_t reset_steps(struct device *dev,
 				struct device_attribute *attr, const char *buf,
 				size_t count)
@@ -1345,6 +1677,8 @@ static DEVICE_ATTR(sampling_freq, S_IWUSR | S_IRUGO |S_IRGRP |S_IXGRP |S_IROTH |
 static DEVICE_ATTR(polling_rate,S_IWUSR | S_IRUGO |S_IRGRP |S_IXGRP |S_IROTH |S_IWOTH, get_polling_rate,
 							set_polling_rate);
 static DEVICE_ATTR(reset_steps, S_IWUSR, NULL, reset_steps);
+static DEVICE_ATTR(max_latency, S_IWUSR | S_IRUGO, get_max_latency,
+							set_max_latency);
 static DEVICE_ATTR(max_delivery_rate, S_IWUSR | S_IRUGO |S_IRGRP |S_IXGRP |S_IROTH |S_IWOTH, get_max_delivery_rate,
 							set_max_delivery_rate);
 static DEVICE_ATTR(sampling_freq_avail, S_IRUGO, get_sampling_frequency_avail,
@@ -1357,6 +1691,7 @@ static struct attribute *lsm6ds3_accel_attribute[] = {
 	&dev_attr_enable.attr,
 	&dev_attr_sampling_freq.attr,
 	&dev_attr_polling_rate.attr,
+	&dev_attr_max_latency.attr,
 	&dev_attr_sampling_freq_avail.attr,
 	&dev_attr_scale_avail.attr,
 	&dev_attr_scale.attr,
@@ -1367,6 +1702,7 @@ static struct attribute *lsm6ds3_gyro_attribute[] = {
 	&dev_attr_enable.attr,
 	&dev_attr_sampling_freq.attr,
 	&dev_attr_polling_rate.attr,
+	&dev_attr_max_latency.attr,
 	&dev_attr_sampling_freq_avail.attr,
 	&dev_attr_scale_avail.attr,
 	&dev_attr_scale.attr,
@@ -1470,6 +1806,7 @@ int lsm6ds3_common_probe(struct lsm6ds3_data *cdata, int irq, u16 bustype)
 	}
 
 	mutex_init(&cdata->lock);
+	cdata->fifo_enabled = false;
 
 dev_err(cdata->dev, "irq = %d .\n",irq);
 	if (irq > 0) {
@@ -1507,6 +1844,7 @@ dev_err(cdata->dev, "irq = %d .\n",irq);
 		sdata->cdata = cdata;
 		sdata->sindex = i;
 		sdata->name = lsm6ds3_sensor_name[i].name;
+		sdata->max_latency_ms = 0;
 		if ((i == LSM6DS3_ACCEL) || (i == LSM6DS3_GYRO)) {
 			sdata->c_odr = lsm6ds3_odr_table.odr_avl[0].hz;
 			sdata->c_gain = lsm6ds3_fs_table[i].fs_avl[0].gain;
@@ -1568,12 +1906,24 @@ EXPORT_SYMBOL(lsm6ds3_common_remove);
 #ifdef CONFIG_PM
 int lsm6ds3_common_suspend(struct lsm6ds3_data *cdata)
 {
+	/*
+	 * The FIFO keeps batching while we sleep. Stop emptying it, the
+	 * second cancel catches a timer re-armed by a work still running.
+	 */
+	hrtimer_cancel(&cdata->fifo_timer);
+	cancel_work_sync(&cdata->fifo_work);
+	hrtimer_cancel(&cdata->fifo_timer);
+
 	return 0;
 }
 EXPORT_SYMBOL(lsm6ds3_common_suspend);
 
 int lsm6ds3_common_resume(struct lsm6ds3_data *cdata)
 {
+	/* deliver what was batched during suspend and restart the timer */
+	if (cdata->fifo_enabled)
+		queue_work(lsm6ds3_workqueue, &cdata->fifo_work);
+
 	return 0;
 }
 EXPORT_SYMBOL(lsm6ds3_common_resume);
@@ -86,6 +86,14 @@ enum {
 #define LSM6DS3_RX_MAX_LENGTH		(500)
 #define LSM6DS3_TX_MAX_LENGTH		(500)
 
+/*
+ * FIFO batching: one pattern entry per data set of a full decimation cycle
+ * (gyro before accel within an ODR tick), and the largest burst we pull out
+ * of FIFO_DATA_OUT in one bus transfer (whole 6 byte samples only).
+ */
+#define LSM6DS3_FIFO_PATTERN_MAX	(64)
+#define LSM6DS3_FIFO_READ_LEN		(480)
+
 #define to_dev(obj) 			container_of(obj, struct device, kobj)
 
 struct reg_rw {
@@ -129,6 +137,9 @@ struct lsm6ds3_sensor_data {
 	struct hrtimer hr_timer;
 	struct work_struct input_work;
 	ktime_t ktime;
+
+	/* 0 = polled, otherwise samples are batched in the FIFO */
+	unsigned int max_latency_ms;
 };
 
 struct lsm6ds3_data {
@@ -147,6 +158,17 @@ struct lsm6ds3_data {
 	struct mutex bank_registers_lock;
 	const struct lsm6ds3_transfer_function *tf;
 	struct lsm6ds3_transfer_buffer tb;
+
+	/* FIFO batching state, protected by lock */
+	bool fifo_enabled;
+	u32 fifo_odr;
+	u8 fifo_pattern_len;
+	u8 fifo_pattern[LSM6DS3_FIFO_PATTERN_MAX];
+	u8 fifo_pattern_tick[LSM6DS3_FIFO_PATTERN_MAX];
+	u8 fifo_data[LSM6DS3_FIFO_READ_LEN];
+	struct hrtimer fifo_timer;
+	struct work_struct fifo_work;
+	ktime_t fifo_ktime;
 };
 
 int lsm6ds3_common_probe(struct lsm6ds3_data *cdata, int irq, u16 bustype);
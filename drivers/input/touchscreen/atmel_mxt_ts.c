@@ -13,6 +13,7 @@
 
 #include <linux/module.h>
 #include <linux/init.h>
+#include <linux/cpufreq.h>
 #include <linux/delay.h>
 #include <linux/firmware.h>
 #include <linux/i2c.h>
@@ -35,6 +36,9 @@
 /* Firmware */
 #define MXT_FW_NAME		"maxtouch.fw"
 
+/* CPU boost asked for on the touch interrupt, ahead of the events */
+#define MXT_BOOST_US		(80 * USEC_PER_MSEC)
+
 /* Registers */
 #define MXT_FAMILY_ID		0x00
 #define MXT_VARIANT_ID		0x01
@@ -258,6 +262,20 @@ struct mxt_data {
 	unsigned int irq;
 	unsigned int max_x;
 	unsigned int max_y;
+
+	/* cached from the object table */
+	u16 T5_address;
+	u8 T5_msg_size;
+	u16 T44_address;
+	u8 T9_reportid_min;
+	u8 T9_reportid_max;
+	u8 max_reportid;
+
+	/* T44 message count followed by up to max_reportid T5 messages */
+	u8 *msg_buf;
+	bool update_input;
+	int single_id;
+	ktime_t timestamp;
 };
 
 static bool mxt_object_readable(unsigned int type)
@@ -513,10 +531,11 @@ static int mxt_write_object(struct mxt_data *data,
 	return mxt_write_reg(data->client, reg + offset, val);
 }
 
-static void mxt_input_report(struct mxt_data *data, int single_id)
+static void mxt_input_report(struct mxt_data *data)
 {
 	struct mxt_finger *finger = data->finger;
 	struct input_dev *input_dev = data->input_dev;
+	int single_id = data->single_id;
 	int status = finger[single_id].status;
 	int finger_num = 0;
 	int id;
@@ -573,7 +592,8 @@ static void mxt_input_touchevent(struct mxt_data *data,
 			dev_dbg(dev, "[%d] released\n", id);
 
 			finger[id].status = MXT_RELEASE;
-			mxt_input_report(data, id);
+			data->single_id = id;
+			data->update_input = true;
 		}
 		return;
 	}
@@ -603,44 +623,101 @@ static void mxt_input_touchevent(struct mxt_data *data,
 	finger[id].area = area;
 	finger[id].pressure = pressure;
 
-	mxt_input_report(data, id);
+	data->single_id = id;
+	data->update_input = true;
 }
 
-static irqreturn_t mxt_interrupt(int irq, void *dev_id)
+static void mxt_proc_message(struct mxt_data *data,
+			     struct mxt_message *message)
+{
+	u8 reportid = message->reportid;
+
+	if (reportid >= data->T9_reportid_min &&
+	    reportid <= data->T9_reportid_max)
+		mxt_input_touchevent(data, message,
+				     reportid - data->T9_reportid_min);
+	else if (reportid != 0xff)
+		mxt_dump_message(&data->client->dev, message);
+}
+
+/*
+ * With a T44 message count object right before T5, read the count and
+ * the first message in one transfer, then all the others in a second
+ * one, rather than one transfer per message.
+ */
+static int mxt_read_and_process_messages(struct mxt_data *data)
+{
+	struct i2c_client *client = data->client;
+	u8 *buf = data->msg_buf;
+	u8 count;
+	int error;
+	int i;
+
+	error = __mxt_read_reg(client, data->T44_address,
+			       data->T5_msg_size + 1, buf);
+	if (error)
+		return error;
+
+	count = buf[0];
+	if (!count)
+		return 0;
+	if (count > data->max_reportid) {
+		dev_warn(&client->dev, "T44 count %d exceeded max\n", count);
+		count = data->max_reportid;
+	}
+
+	mxt_proc_message(data, (struct mxt_message *)(buf + 1));
+	if (count == 1)
+		return 0;
+
+	error = __mxt_read_reg(client, data->T5_address,
+			       data->T5_msg_size * (count - 1), buf + 1);
+	if (error)
+		return error;
+
+	for (i = 0; i < count - 1; i++)
+		mxt_proc_message(data, (struct mxt_message *)
+				 (buf + 1 + i * data->T5_msg_size));
+
+	return 0;
+}
+
+static irqreturn_t mxt_hardirq(int irq, void *dev_id)
 {
 	struct mxt_data *data = dev_id;
-	struct mxt_message message;
-	struct mxt_object *object;
-	struct device *dev = &data->client->dev;
-	int id;
-	u8 reportid;
-	u8 max_reportid;
-	u8 min_reportid;
 
-	do {
-		if (mxt_read_message(data, &message)) {
-			dev_err(dev, "Failed to read message\n");
-			goto end;
-		}
+	data->timestamp = ktime_get();
+	cpufreq_interactive_boostpulse(MXT_BOOST_US);
 
-		reportid = message.reportid;
+	return IRQ_WAKE_THREAD;
+}
 
-		/* whether reportid is thing of MXT_TOUCH_MULTI_T9 */
-		object = mxt_get_object(data, MXT_TOUCH_MULTI_T9);
-		if (!object)
-			goto end;
+static irqreturn_t mxt_interrupt(int irq, void *dev_id)
+{
+	struct mxt_data *data = dev_id;
+	struct mxt_message message;
+	struct device *dev = &data->client->dev;
 
-		max_reportid = object->max_reportid;
-		min_reportid = max_reportid - object->num_report_ids + 1;
-		id = reportid - min_reportid;
+	if (data->msg_buf) {
+		if (mxt_read_and_process_messages(data))
+			dev_err(dev, "Failed to read messages\n");
+	} else {
+		do {
+			if (mxt_read_message(data, &message)) {
+				dev_err(dev, "Failed to read message\n");
+				break;
+			}
+			mxt_proc_message(data, &message);
+		} while (message.reportid != 0xff);
+	}
 
-		if (reportid >= min_reportid && reportid <= max_reportid)
-			mxt_input_touchevent(data, &message, id);
-		else
-			mxt_dump_message(dev, &message);
-	} while (reportid != 0xff);
+	/* one frame, stamped with the time of the interrupt */
+	if (data->update_input) {
+		input_set_timestamp(data->input_dev, data->timestamp);
+		mxt_input_report(data);
+		data->update_input = false;
+	}
 
-end:
 	return IRQ_HANDLED;
 }
 
@@ -793,6 +870,8 @@ static int mxt_get_object_table(struct mxt_data *data)
 	u8 reportid = 0;
 	u8 buf[MXT_OBJECT_SIZE];
 
+	data->T44_address = 0;
+
 	for (i = 0; i < data->info.object_num; i++) {
 		struct mxt_object *object = data->object_table + i;
 
@@ -812,6 +891,34 @@ static int mxt_get_object_table(struct mxt_data *data)
 					(object->instances + 1);
 			object->max_reportid = reportid;
 		}
+
+		switch (object->type) {
+		case MXT_GEN_MESSAGE_T5:
+			data->T5_address = object->start_address;
+			/* without the checksum, which is not asked for */
+			data->T5_msg_size = object->size;
+			break;
+		case MXT_SPT_MESSAGECOUNT_T44:
+			data->T44_address = object->start_address;
+			break;
+		case MXT_TOUCH_MULTI_T9:
+			data->T9_reportid_max = object->max_reportid;
+			data->T9_reportid_min = object->max_reportid -
+				object->num_report_ids *
+				(object->instances + 1) + 1;
+			break;
+		}
+	}
+	data->max_reportid = reportid;
+
+	/* the message buffer only makes sense for contiguous T44 and T5 */
+	if (data->T44_address && data->T44_address + 1 == data->T5_address &&
+	    data->T5_msg_size >= 7 &&
+	    data->T5_msg_size <= sizeof(struct mxt_message)) {
+		data->msg_buf = kcalloc(data->max_reportid + 1,
+					data->T5_msg_size, GFP_KERNEL);
+		if (!data->msg_buf)
+			return -ENOMEM;
 	}
 
 	return 0;
@@ -1036,6 +1143,8 @@ static ssize_t mxt_update_fw_store(struct device *dev,
 
 		kfree(data->object_table);
 		data->object_table = NULL;
+		kfree(data->msg_buf);
+		data->msg_buf = NULL;
 
 		mxt_initialize(data);
 	}
@@ -1154,8 +1263,9 @@ static int __devinit mxt_probe(struct i2c_client *client,
 	if (error)
 		goto err_free_object;
 
-	error = request_threaded_irq(client->irq, NULL, mxt_interrupt,
-			pdata->irqflags, client->dev.driver->name, data);
+	error = request_threaded_irq(client->irq, mxt_hardirq, mxt_interrupt,
+			pdata->irqflags | IRQF_ONESHOT,
+			client->dev.driver->name, data);
 	if (error) {
 		dev_err(&client->dev, "Failed to register interrupt\n");
 		goto err_free_object;
@@ -1181,6 +1291,7 @@ err_unregister_device:
 err_free_irq:
 	free_irq(client->irq, data);
 err_free_object:
+	kfree(data->msg_buf);
 	kfree(data->object_table);
 err_free_mem:
 	input_free_device(input_dev);
@@ -1195,6 +1306,7 @@ static int __devexit mxt_remove(struct i2c_client *client)
 	sysfs_remove_group(&client->dev.kobj, &mxt_attr_group);
 	free_irq(data->irq, data);
 	input_unregister_device(data->input_dev);
+	kfree(data->msg_buf);
 	kfree(data->object_table);
 	kfree(data);
 
@@ -14,6 +14,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/cpufreq.h>
 #include <linux/delay.h>
 #include <linux/earlysuspend.h>
 #include <linux/hrtimer.h>
@@ -25,6 +26,9 @@
 #include <linux/slab.h>
 #include <linux/synaptics_i2c_rmi.h>
 
+/* CPU boost asked for on the touch interrupt, ahead of the events */
+#define SYNAPTICS_BOOST_US	(80 * USEC_PER_MSEC)
+
 static struct workqueue_struct *synaptics_wq;
 
 struct synaptics_ts_data {
@@ -35,6 +39,7 @@ struct synaptics_ts_data {
 	bool has_relative_report;
 	struct hrtimer timer;
 	struct work_struct  work;
+	ktime_t timestamp;
 	uint16_t max[2];
 	int snap_state[2][2];
 	int snap_down_on[2];
@@ -83,7 +88,7 @@ err_page_select_failed:
 	return ret;
 }
 
-static void synaptics_ts_work_func(struct work_struct *work)
+static void synaptics_ts_read(struct synaptics_ts_data *ts)
 {
 	int i;
 	int ret;
@@ -91,9 +96,12 @@ static void synaptics_ts_work_func(struct work_struct *work)
 	struct i2c_msg msg[2];
 	uint8_t start_reg;
 	uint8_t buf[15];
-	struct synaptics_ts_data *ts = container_of(work, struct synaptics_ts_data, work);
 	int buf_len = ts->has_relative_report ? 15 : 13;
 
+	/* events of this frame carry the time of the interrupt */
+	if (ts->use_irq)
+		input_set_timestamp(ts->input_dev, ts->timestamp);
+
 	msg[0].addr = ts->client->addr;
 	msg[0].flags = 0;
 	msg[0].len = 1;
@@ -230,8 +238,13 @@ static void synaptics_ts_work_func(struct work_struct *work)
 			}
 		}
 	}
-	if (ts->use_irq)
-		enable_irq(ts->client->irq);
+}
+
+static void synaptics_ts_work_func(struct work_struct *work)
+{
+	struct synaptics_ts_data *ts = container_of(work, struct synaptics_ts_data, work);
+
+	synaptics_ts_read(ts);
 }
 
 static enum hrtimer_restart synaptics_ts_timer_func(struct hrtimer *timer)
@@ -249,9 +262,20 @@ static irqreturn_t synaptics_ts_irq_handler(int irq, void *dev_id)
 {
 	struct synaptics_ts_data *ts = dev_id;
 
-	/* printk("synaptics_ts_irq_handler\n"); */
-	disable_irq_nosync(ts->client->irq);
-	queue_work(synaptics_wq, &ts->work);
+	ts->timestamp = ktime_get();
+	cpufreq_interactive_boostpulse(SYNAPTICS_BOOST_US);
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * The frame is read from the (SCHED_FIFO) irq thread rather than from
+ * synaptics_wq, whose worker competes with every other normal task.
+ */
+static irqreturn_t synaptics_ts_irq_thread(int irq, void *dev_id)
+{
+	struct synaptics_ts_data *ts = dev_id;
+
+	synaptics_ts_read(ts);
 	return IRQ_HANDLED;
 }
 
@@ -516,7 +540,10 @@ static int synaptics_ts_probe(
 		goto err_input_register_device_failed;
 	}
 	if (client->irq) {
-		ret = request_irq(client->irq, synaptics_ts_irq_handler, irqflags, client->name, ts);
+		ret = request_threaded_irq(client->irq, synaptics_ts_irq_handler,
+					   synaptics_ts_irq_thread,
+					   irqflags | IRQF_ONESHOT,
+					   client->name, ts);
 		if (ret == 0) {
 			ret = i2c_smbus_write_byte_data(ts->client, 0xf1, 0x01); /* enable abs int */
 			if (ret)
@@ -573,13 +600,12 @@ static int synaptics_ts_suspend(struct i2c_client *client, pm_message_t mesg)
 	int ret;
 	struct synaptics_ts_data *ts = i2c_get_clientdata(client);
 
-	if (ts->use_irq)
+	if (ts->use_irq) {
 		disable_irq(client->irq);
-	else
+	} else {
 		hrtimer_cancel(&ts->timer);
-	ret = cancel_work_sync(&ts->work);
-	if (ret && ts->use_irq) /* if work was pending disable-count is now 2 */
-		enable_irq(client->irq);
+		cancel_work_sync(&ts->work);
+	}
 	ret = i2c_smbus_write_byte_data(ts->client, 0xf1, 0); /* disable interrupt */
 	if (ret < 0)
 		printk(KERN_ERR "synaptics_ts_suspend: i2c_smbus_write_byte_data failed\n");
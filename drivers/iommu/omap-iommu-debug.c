@@ -256,6 +256,31 @@ static ssize_t debug_read_mmap(struct file *file, char __user *userbuf,
 	return bytes;
 }
 
+static ssize_t debug_read_pgsize(struct file *file, char __user *userbuf,
+				 size_t count, loff_t *ppos)
+{
+	struct device *dev = file->private_data;
+	struct omap_iommu *obj = dev_to_omap_iommu(dev);
+	static const int pgsz[] = {
+		MMU_CAM_PGSZ_4K, MMU_CAM_PGSZ_64K,
+		MMU_CAM_PGSZ_1M, MMU_CAM_PGSZ_16M,
+	};
+	static const char * const name[] = { "4K", "64K", "1M", "16M" };
+	char buf[MAXCOLUMN * 6], *p = buf;
+	int i;
+
+	p += sprintf(p, "%-4s %10s %10s\n", "size", "map", "unmap");
+
+	spin_lock(&obj->page_table_lock);
+	for (i = 0; i < ARRAY_SIZE(pgsz); i++)
+		p += sprintf(p, "%-4s %10lu %10lu\n", name[i],
+			     obj->nr_map[pgsz[i]], obj->nr_unmap[pgsz[i]]);
+	p += sprintf(p, "tlb flushes: %lu\n", obj->nr_tlb_flush);
+	spin_unlock(&obj->page_table_lock);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, p - buf);
+}
+
 static ssize_t debug_read_mem(struct file *file, char __user *userbuf,
 			      size_t count, loff_t *ppos)
 {
@@ -343,6 +368,7 @@ DEBUG_FOPS_RO(regs);
 DEBUG_FOPS_RO(tlb);
 DEBUG_FOPS(pagetable);
 DEBUG_FOPS_RO(mmap);
+DEBUG_FOPS_RO(pgsize);
 DEBUG_FOPS(mem);
 
 #define __DEBUG_ADD_FILE(attr, mode)					\
@@ -390,6 +416,7 @@ static int iommu_debug_register(struct device *dev, void *data)
 	DEBUG_ADD_FILE_RO(tlb);
 	DEBUG_ADD_FILE(pagetable);
 	DEBUG_ADD_FILE_RO(mmap);
+	DEBUG_ADD_FILE_RO(pgsize);
 	DEBUG_ADD_FILE(mem);
 
 	return 0;
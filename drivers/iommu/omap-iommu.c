@@ -448,13 +448,15 @@ static int prefetch_iotlb_entry(struct omap_iommu *obj, struct iotlb_entry *e)
 }
 
 /**
- * flush_iotlb_page - Clear an iommu tlb entry
+ * flush_iotlb_range - Clear the iommu tlb entries of a range
  * @obj:	target iommu
  * @da:		iommu device virtual address
+ * @len:	length of the range
  *
- * Clear an iommu tlb entry which includes 'da' address.
+ * Clear every iommu tlb entry which overlaps [da, da + len), in a single
+ * pass over the tlb.
  **/
-static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
+static void flush_iotlb_range(struct omap_iommu *obj, u32 da, size_t len)
 {
 	int i;
 	struct cr_regs cr;
@@ -466,6 +468,7 @@ static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
 
 	pm_runtime_get_sync(obj->dev);
 
+	obj->nr_tlb_flush++;
 	for_each_iotlb_cr(obj, obj->nr_tlb_entries, i, cr) {
 		u32 start;
 		size_t bytes;
@@ -476,7 +479,7 @@ static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
 		start = iotlb_cr_to_virt(&cr);
 		bytes = iopgsz_to_bytes(cr.cam & 3);
 
-		if ((start <= da) && (da < start + bytes)) {
+		if ((start < da + len) && (da < start + bytes)) {
 			dev_dbg(obj->dev, "%s: %08x<=%08x(%x)\n",
 				__func__, start, da, bytes);
 			iotlb_load_cr(obj, &cr);
@@ -484,9 +487,6 @@ static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
 		}
 	}
 	pm_runtime_put(obj->dev);
-
-	if (i == obj->nr_tlb_entries)
-		dev_dbg(obj->dev, "%s: no page for %08x\n", __func__, da);
 }
 
 /**
@@ -747,6 +747,8 @@ iopgtable_store_entry_core(struct omap_iommu *obj, struct iotlb_entry *e)
 
 	spin_lock(&obj->page_table_lock);
 	err = fn(obj, e->da, e->pa, prot);
+	if (!err)
+		obj->nr_map[e->pgsz]++;
 	spin_unlock(&obj->page_table_lock);
 
 	return err;
@@ -766,7 +768,7 @@ int omap_iopgtable_store_entry(struct omap_iommu *obj, struct iotlb_entry *e)
 		return -EBUSY;
 	}
 
-	flush_iotlb_page(obj, e->da);
+	flush_iotlb_range(obj, e->da, iopgsz_to_bytes(e->pgsz));
 	err = iopgtable_store_entry_core(obj, e);
 	if (!err)
 		prefetch_iotlb_entry(obj, e);
@@ -824,6 +826,7 @@ static size_t iopgtable_clear_entry_core(struct omap_iommu *obj, u32 da)
 		bytes *= nent;
 		memset(iopte, 0, nent * sizeof(*iopte));
 		flush_iopte_range(iopte, iopte + (nent - 1) * sizeof(*iopte));
+		obj->nr_unmap[bytes_to_iopgsz(bytes)]++;
 
 		/*
 		 * do table walk to check if this table is necessary or not
@@ -843,6 +846,7 @@ static size_t iopgtable_clear_entry_core(struct omap_iommu *obj, u32 da)
 			iopgd = iopgd_offset(obj, (da & IOSUPER_MASK));
 		}
 		bytes *= nent;
+		obj->nr_unmap[bytes_to_iopgsz(bytes)]++;
 	}
 	memset(iopgd, 0, nent * sizeof(*iopgd));
 	flush_iopgd_range(iopgd, iopgd + (nent - 1) * sizeof(*iopgd));
@@ -851,13 +855,19 @@ out:
 }
 
 /**
- * iopgtable_clear_entry - Remove an iommu pte entry
+ * iopgtable_clear_range - Remove the iommu pte entries of a range
  * @obj:	target iommu
- * @da:		iommu device virtual address
+ * @da:		iommu device virtual address, page aligned
+ * @bytes:	length of the range
+ *
+ * Clears whatever entries, of any page size, cover the range and then
+ * invalidates the tlb once for all of them.  Returns the number of bytes
+ * unmapped, which is short of @bytes if a hole was found.
  **/
-static size_t iopgtable_clear_entry(struct omap_iommu *obj, u32 da)
+static size_t
+iopgtable_clear_range(struct omap_iommu *obj, u32 da, size_t bytes)
 {
-	size_t bytes;
+	size_t unmapped = 0;
 
 	if (obj && obj->secure_mode) {
 		WARN_ON(1);
@@ -866,12 +876,19 @@ static size_t iopgtable_clear_entry(struct omap_iommu *obj, u32 da)
 
 	spin_lock(&obj->page_table_lock);
 
-	bytes = iopgtable_clear_entry_core(obj, da);
-	flush_iotlb_page(obj, da);
+	while (unmapped < bytes) {
+		size_t len = iopgtable_clear_entry_core(obj, da + unmapped);
+
+		if (!len)
+			break;
+		unmapped += len;
+	}
+	if (unmapped)
+		flush_iotlb_range(obj, da, unmapped);
 
 	spin_unlock(&obj->page_table_lock);
 
-	return bytes;
+	return unmapped;
 }
 
 static void iopgtable_clear_entry_all(struct omap_iommu *obj)
@@ -1218,7 +1235,7 @@ static size_t omap_iommu_unmap(struct iommu_domain *domain, unsigned long da,
 
 	dev_dbg(dev, "unmapping da 0x%lx size %u\n", da, size);
 
-	return iopgtable_clear_entry(oiommu, da);
+	return iopgtable_clear_range(oiommu, da, size);
 }
 
 static int
@@ -405,20 +405,30 @@ static inline void sgtable_drain_vmalloc(struct sg_table *sgt)
 	BUG_ON(!sgt);
 }
 
-/* create 'da' <-> 'pa' mapping from 'sgt' */
+/*
+ * create 'da' <-> 'pa' mapping from 'sgt'
+ *
+ * Physically contiguous sg entries are mapped as one run, so that
+ * iommu_map() can use 64KB large pages and 1MB/16MB sections wherever
+ * the alignment of both addresses allows it.
+ */
 static int map_iovm_area(struct iommu_domain *domain, struct iovm_struct *new,
 			const struct sg_table *sgt, u32 flags)
 {
-	int err;
-	unsigned int i, j;
+	int err = 0;
+	unsigned int i;
 	struct scatterlist *sg;
 	u32 da = new->da_start;
+	u32 run_da = da, run_pa = 0;
+	size_t run = 0;
 
 	if (!domain || !sgt)
 		return -EINVAL;
 
 	BUG_ON(!sgtable_ok(sgt));
 
+	flags &= ~IOVMF_PGSZ_MASK;
+
 	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
 		u32 pa;
 		size_t bytes;
@@ -426,35 +436,43 @@ static int map_iovm_area(struct iommu_domain *domain, struct iovm_struct *new,
 		pa = sg_phys(sg) - sg->offset;
 		bytes = sg->length + sg->offset;
 
-		flags &= ~IOVMF_PGSZ_MASK;
-
-		if (bytes_to_iopgsz(bytes) < 0)
+		if (bytes_to_iopgsz(bytes) < 0) {
+			err = -EINVAL;
 			goto err_out;
+		}
 
-		pr_debug("%s: [%d] %08x %08x(%x)\n", __func__,
-			 i, da, pa, bytes);
+		if (run && run_pa + run == pa) {
+			run += bytes;
+			da += bytes;
+			continue;
+		}
 
-		err = iommu_map(domain, da, pa, bytes, flags);
-		if (err)
-			goto err_out;
+		if (run) {
+			pr_debug("%s: %08x %08x(%x)\n", __func__,
+				 run_da, run_pa, run);
+			err = iommu_map(domain, run_da, run_pa, run, flags);
+			if (err)
+				goto err_out;
+		}
 
+		run_da = da;
+		run_pa = pa;
+		run = bytes;
 		da += bytes;
 	}
+
+	if (run) {
+		pr_debug("%s: %08x %08x(%x)\n", __func__, run_da, run_pa, run);
+		err = iommu_map(domain, run_da, run_pa, run, flags);
+		if (err)
+			goto err_out;
+	}
 	return 0;
 
 err_out:
-	da = new->da_start;
-
-	for_each_sg(sgt->sgl, sg, i, j) {
-		size_t bytes;
-
-		bytes = sg->length + sg->offset;
-
-		/* ignore failures.. we're already handling one */
-		iommu_unmap(domain, da, bytes);
-
-		da += bytes;
-	}
+	/* ignore failures.. we're already handling one */
+	if (run_da > new->da_start)
+		iommu_unmap(domain, new->da_start, run_da - new->da_start);
 	return err;
 }
 
@@ -472,25 +490,17 @@ static void unmap_iovm_area(struct iommu_domain *domain, struct omap_iommu *obj,
 	BUG_ON(!sgtable_ok(sgt));
 	BUG_ON((!total) || !IS_ALIGNED(total, PAGE_SIZE));
 
-	start = area->da_start;
-	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
-		size_t bytes;
-
-		bytes = sg->length + sg->offset;
-
-		unmapped = iommu_unmap(domain, start, bytes);
-		if (unmapped < bytes)
-			break;
+	for_each_sg(sgt->sgl, sg, sgt->nents, i)
+		BUG_ON(!IS_ALIGNED(sg->length + sg->offset, PAGE_SIZE));
 
-		dev_dbg(obj->dev, "%s: unmap %08x(%x) %08x\n",
-				__func__, start, bytes, area->flags);
+	/* the whole area at once, with a single tlb invalidation */
+	start = area->da_start;
+	unmapped = iommu_unmap(domain, start, total);
 
-		BUG_ON(!IS_ALIGNED(bytes, PAGE_SIZE));
+	dev_dbg(obj->dev, "%s: unmap %08x(%x) %08x\n",
+			__func__, start, unmapped, area->flags);
 
-		total -= bytes;
-		start += bytes;
-	}
-	BUG_ON(total);
+	BUG_ON(unmapped != total);
 }
 
 /* template function for all unmapping */
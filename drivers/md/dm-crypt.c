@@ -20,6 +20,8 @@
 #include <linux/backing-dev.h>
 #include <linux/percpu.h>
 #include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
 #include <asm/unaligned.h>
@@ -43,6 +45,7 @@ struct convert_context {
 	unsigned int idx_in;
 	unsigned int idx_out;
 	sector_t sector;
+	sector_t stats_sector;		/* ctx->sector when conversion began */
 	atomic_t pending;
 };
 
@@ -168,6 +171,17 @@ struct crypt_config {
 	 */
 	unsigned int dmreq_start;
 
+	/*
+	 * Conversion statistics for crypt_status(), indexed by data
+	 * direction.  busy_ns is the time at least one conversion was in
+	 * flight, so sectors / busy_ns is the throughput of the cipher.
+	 */
+	spinlock_t stats_lock;
+	unsigned int stats_inflight[2];
+	ktime_t stats_busy_start[2];
+	u64 stats_busy_ns[2];
+	u64 stats_sectors[2];
+
 	unsigned long flags;
 	unsigned int key_size;
 	unsigned int key_parts;
@@ -760,6 +774,35 @@ static void crypt_alloc_req(struct crypt_config *cc,
 	    kcryptd_async_done, dmreq_of_req(cc, this_cc->req));
 }
 
+static void crypt_stats_start(struct crypt_config *cc,
+			      struct convert_context *ctx)
+{
+	int rw = bio_data_dir(ctx->bio_in);
+	unsigned long flags;
+
+	ctx->stats_sector = ctx->sector;
+
+	spin_lock_irqsave(&cc->stats_lock, flags);
+	if (!cc->stats_inflight[rw]++)
+		cc->stats_busy_start[rw] = ktime_get();
+	spin_unlock_irqrestore(&cc->stats_lock, flags);
+}
+
+/* called when ctx->pending drops to zero, from process or softirq context */
+static void crypt_stats_done(struct crypt_config *cc,
+			     struct convert_context *ctx)
+{
+	int rw = bio_data_dir(ctx->bio_in);
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->stats_lock, flags);
+	cc->stats_sectors[rw] += ctx->sector - ctx->stats_sector;
+	if (!--cc->stats_inflight[rw])
+		cc->stats_busy_ns[rw] += ktime_to_ns(ktime_sub(ktime_get(),
+						cc->stats_busy_start[rw]));
+	spin_unlock_irqrestore(&cc->stats_lock, flags);
+}
+
 /*
  * Encrypt / decrypt data from one bio to another one (can be the same one)
  */
@@ -770,6 +813,7 @@ static int crypt_convert(struct crypt_config *cc,
 	int r;
 
 	atomic_set(&ctx->pending, 1);
+	crypt_stats_start(cc, ctx);
 
 	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
 	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
@@ -1111,6 +1155,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 
 		/* Encryption was already finished, submit io now */
 		if (crypt_finished) {
+			crypt_stats_done(cc, &io->ctx);
 			kcryptd_crypt_write_io_submit(io, 0);
 
 			/*
@@ -1181,8 +1226,10 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	if (r < 0)
 		io->error = -EIO;
 
-	if (atomic_dec_and_test(&io->ctx.pending))
+	if (atomic_dec_and_test(&io->ctx.pending)) {
+		crypt_stats_done(cc, &io->ctx);
 		kcryptd_crypt_read_done(io);
+	}
 
 	crypt_dec_pending(io);
 }
@@ -1211,6 +1258,8 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (!atomic_dec_and_test(&ctx->pending))
 		return;
 
+	crypt_stats_done(cc, ctx);
+
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_done(io);
 	else
@@ -1601,6 +1650,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		return -ENOMEM;
 	}
 	cc->key_size = key_size;
+	spin_lock_init(&cc->stats_lock);
 
 	ti->private = cc;
 	ret = crypt_ctr_cipher(ti, argv[0], argv[1]);
@@ -1746,10 +1796,23 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	u64 busy_ms;
+	int rw;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		result[0] = '\0';
+		spin_lock_irq(&cc->stats_lock);
+		for (rw = READ; rw <= WRITE; rw++) {
+			busy_ms = div_u64(cc->stats_busy_ns[rw], NSEC_PER_MSEC);
+			DMEMIT("%s%s %llu %llu %llu", rw ? " " : "",
+			       rw ? "write" : "read",
+			       (unsigned long long)cc->stats_sectors[rw],
+			       (unsigned long long)busy_ms,
+			       busy_ms ? (unsigned long long)div64_u64(
+					(cc->stats_sectors[rw] >> 1) *
+					MSEC_PER_SEC, busy_ms) : 0ULL);
+		}
+		spin_unlock_irq(&cc->stats_lock);
 		break;
 
 	case STATUSTYPE_TABLE:
@@ -1869,7 +1932,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 11, 0},
+	.version = {1, 12, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -18,6 +18,7 @@
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -62,6 +63,9 @@ struct dm_verity {
 
 	/* starting blocks for each tree level. 0 is the lowest level. */
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
+
+	/* check_at_most_once: one bit per data block, set once verified */
+	unsigned long *validated_blocks;
 };
 
 struct dm_verity_io {
@@ -276,6 +280,30 @@ release_ret_r:
 /*
  * Verify one "dm_verity_io" structure.
  */
+/*
+ * Step over the data of a block that needs no verification.
+ */
+static void verity_skip_block(struct dm_verity *v, struct dm_verity_io *io,
+			      unsigned *vector, unsigned *offset)
+{
+	unsigned todo = 1 << v->data_dev_block_bits;
+
+	do {
+		struct bio_vec *bv;
+		unsigned len;
+
+		BUG_ON(*vector >= io->io_vec_size);
+		bv = &io->io_vec[*vector];
+		len = min(bv->bv_len - *offset, todo);
+		*offset += len;
+		if (likely(*offset == bv->bv_len)) {
+			*offset = 0;
+			(*vector)++;
+		}
+		todo -= len;
+	} while (todo);
+}
+
 static int verity_verify_io(struct dm_verity_io *io)
 {
 	struct dm_verity *v = io->v;
@@ -289,6 +317,12 @@ static int verity_verify_io(struct dm_verity_io *io)
 		int r;
 		unsigned todo;
 
+		if (v->validated_blocks &&
+		    likely(test_bit(io->block + b, v->validated_blocks))) {
+			verity_skip_block(v, io, &vector, &offset);
+			continue;
+		}
+
 		if (likely(v->levels)) {
 			/*
 			 * First, we try to get the requested hash for
@@ -377,6 +411,9 @@ test_block_hash:
 			v->hash_failed = 1;
 			return -EIO;
 		}
+
+		if (v->validated_blocks)
+			set_bit(io->block + b, v->validated_blocks);
 	}
 	BUG_ON(vector != io->io_vec_size);
 	BUG_ON(offset);
@@ -544,6 +581,8 @@ static int verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->validated_blocks)
+			DMEMIT(" 1 check_at_most_once");
 		break;
 	}
 
@@ -616,6 +655,7 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	vfree(v->validated_blocks);
 	kfree(v->salt);
 	kfree(v->root_digest);
 
@@ -646,10 +686,19 @@ static void verity_dtr(struct dm_target *ti)
  *	<algorithm>
  *	<digest>
  *	<salt>		Hex string or "-" if no salt.
+ *	[<#opt_params> <opt_params>]
+ *			check_at_most_once: verify each data block only on
+ *			its first read.
  */
 static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 {
+	static struct dm_arg _args[] = {
+		{0, 1, "Invalid number of feature args"},
+	};
 	struct dm_verity *v;
+	struct dm_arg_set as;
+	const char *opt_string;
+	unsigned opt_params;
 	unsigned num;
 	unsigned long long num_ll;
 	int r;
@@ -671,8 +720,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc != 10) {
-		ti->error = "Invalid argument count: exactly 10 arguments required";
+	if (argc < 10) {
+		ti->error = "Invalid argument count: at least 10 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
@@ -793,6 +842,36 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	argv += 10;
+	argc -= 10;
+
+	/* Optional parameters */
+	if (argc) {
+		as.argc = argc;
+		as.argv = argv;
+
+		r = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
+		if (r)
+			goto bad;
+
+		opt_string = dm_shift_arg(&as);
+
+		if (opt_params == 1 && opt_string &&
+		    !strcasecmp(opt_string, "check_at_most_once")) {
+			v->validated_blocks = vzalloc(BITS_TO_LONGS(
+				v->data_blocks) * sizeof(unsigned long));
+			if (!v->validated_blocks) {
+				ti->error = "Cannot allocate validated block bitmap";
+				r = -ENOMEM;
+				goto bad;
+			}
+		} else if (opt_params) {
+			ti->error = "Invalid feature arguments";
+			r = -EINVAL;
+			goto bad;
+		}
+	}
+
 	v->hash_per_block_bits =
 		fls((1 << v->hash_dev_block_bits) / v->digest_size) - 1;
 
@@ -875,7 +954,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 0, 0},
+	.version	= {1, 1, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
@@ -52,6 +52,13 @@
 #include "omap_voutdef.h"
 #include "omap_vout_vrfb.h"
 
+#ifdef CONFIG_VIDEO_OMAP2_VOUT_TILER
+#include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
+#define omap_vout_is_tiler(addr)	is_tiler_addr(addr)
+#else
+#define omap_vout_is_tiler(addr)	false
+#endif
+
 MODULE_AUTHOR("Texas Instruments");
 MODULE_DESCRIPTION("OMAP Video for Linux Video out driver");
 MODULE_LICENSE("GPL");
@@ -141,6 +148,14 @@ static const struct v4l2_fmtdesc omap_formats[] = {
 		.description = "UYVY, packed",
 		.pixelformat = V4L2_PIX_FMT_UYVY,
 	},
+	{
+		/* Note:  The UV plane follows the Y plane at
+		 *        bytesperline * height, which for ion TILER 2D
+		 *        buffers is the UV block mapped after the Y one
+		 */
+		.description = "NV12 (Y/CbCr 4:2:0)",
+		.pixelformat = V4L2_PIX_FMT_NV12,
+	},
 };
 
 #define NUM_OUTPUT_FORMATS (ARRAY_SIZE(omap_formats))
@@ -189,6 +204,13 @@ static int omap_vout_try_format(struct v4l2_pix_format *pix)
 		pix->colorspace = V4L2_COLORSPACE_SRGB;
 		bpp = RGB32_BPP;
 		break;
+	case V4L2_PIX_FMT_NV12:
+		pix->colorspace = V4L2_COLORSPACE_JPEG;
+		bpp = NV12_BPP;
+		/* keep the stride of the user mapping of the Y plane */
+		pix->bytesperline = max(pix->bytesperline, pix->width);
+		pix->sizeimage = pix->bytesperline * pix->height * 3 / 2;
+		return bpp;
 	}
 	pix->bytesperline = pix->width * bpp;
 	pix->sizeimage = pix->bytesperline * pix->height;
@@ -210,6 +232,15 @@ static u32 omap_vout_uservirt_to_phys(u32 virtp)
 	/* For kernel direct-mapped memory, take the easy way */
 	if (virtp >= PAGE_OFFSET) {
 		physp = virt_to_phys((void *) virtp);
+	} else if (vma && (vma->vm_flags & VM_PFNMAP)) {
+		/* TILER 2D buffers (ion) are mapped page by page, so the
+		   pgoff of the vma does not tell the address */
+		unsigned long pfn;
+
+		down_read(&mm->mmap_sem);
+		if (follow_pfn(vma, virtp, &pfn) == 0)
+			physp = (pfn << PAGE_SHIFT) + (virtp & ~PAGE_MASK);
+		up_read(&mm->mmap_sem);
 	} else if (vma && (vma->vm_flags & VM_IO) && vma->vm_pgoff) {
 		/* this will catch, kernel-allocated, mmaped-to-usermode
 		   addresses */
@@ -307,6 +338,11 @@ static int omap_vout_calculate_offset(struct omap_vout_device *vout)
 			ps = 4;
 		else if (V4L2_PIX_FMT_RGB24 == pix->pixelformat)
 			ps = 3;
+		else if (V4L2_PIX_FMT_NV12 == pix->pixelformat) {
+			/* offset of the Y plane, see omap_vout_frame_addr */
+			vout->line_length = line_length = pix->bytesperline;
+			ps = 1;
+		}
 
 		vout->ps = ps;
 
@@ -355,18 +391,62 @@ static int video_mode_to_dss_mode(struct omap_vout_device *vout)
 	case V4L2_PIX_FMT_BGR32:
 		mode = OMAP_DSS_COLOR_RGBX32;
 		break;
+	case V4L2_PIX_FMT_NV12:
+		mode = OMAP_DSS_COLOR_NV12;
+		break;
 	default:
 		mode = -EINVAL;
 	}
 	return mode;
 }
 
+/*
+ * Get the DSS addresses of the cropped window of a queued frame. TILER
+ * buffers are cropped in their natural view; DISPC derives the rotated and
+ * mirrored views from it, so no VRFB context or extra copy is needed.
+ */
+static u32 omap_vout_frame_addr(struct omap_vout_device *vout, int i,
+		u32 *uv_addr)
+{
+	struct v4l2_rect *crop = &vout->crop;
+	u32 addr = (u32) vout->queued_buf_addr[i];
+	u32 uv = vout->queued_uv_addr[i];
+
+#ifdef CONFIG_VIDEO_OMAP2_VOUT_TILER
+	if (is_tiler_addr(addr)) {
+		struct tiler_view_t view;
+
+		/* crop was validated against pix in s_crop */
+		tilview_create(&view, addr, vout->pix.width, vout->pix.height);
+		tilview_crop(&view, crop->left, crop->top, crop->width,
+				crop->height);
+		addr = view.tsptr;
+
+		if (uv) {
+			tilview_create(&view, uv, vout->pix.width / 2,
+					vout->pix.height / 2);
+			tilview_crop(&view, crop->left / 2, crop->top / 2,
+					crop->width / 2, crop->height / 2);
+			uv = view.tsptr;
+		}
+		*uv_addr = uv;
+		return addr;
+	}
+#endif
+	if (uv)
+		uv += (crop->top / 2) * vout->pix.bytesperline +
+			(crop->left & ~1);
+	*uv_addr = uv;
+
+	return addr + vout->cropped_offset;
+}
+
 /*
  * Setup the overlay
  */
 static int omapvid_setup_overlay(struct omap_vout_device *vout,
 		struct omap_overlay *ovl, int posx, int posy, int outw,
-		int outh, u32 addr)
+		int outh, u32 addr, u32 uv_addr)
 {
 	int ret = 0;
 	struct omap_overlay_info info;
@@ -401,6 +481,7 @@ static int omapvid_setup_overlay(struct omap_vout_device *vout,
 
 	ovl->get_overlay_info(ovl, &info);
 	info.paddr = addr;
+	info.p_uv_addr = (vout->dss_mode == OMAP_DSS_COLOR_NV12) ? uv_addr : 0;
 	info.width = cropwidth;
 	info.height = cropheight;
 	info.color_mode = vout->dss_mode;
@@ -410,10 +491,15 @@ static int omapvid_setup_overlay(struct omap_vout_device *vout,
 	info.out_width = outw;
 	info.out_height = outh;
 	info.global_alpha = vout->win.global_alpha;
-	if (!is_rotation_enabled(vout)) {
+	if (omap_vout_is_tiler(addr)) {
+		info.rotation = vout->rotation;
+		info.rotation_type = OMAP_DSS_ROT_TILER;
+		info.screen_width = 0;
+	} else if (!is_rotation_enabled(vout)) {
 		info.rotation = 0;
 		info.rotation_type = OMAP_DSS_ROT_DMA;
-		info.screen_width = pixwidth;
+		info.screen_width = (vout->dss_mode == OMAP_DSS_COLOR_NV12) ?
+			vout->pix.bytesperline : pixwidth;
 	} else {
 		info.rotation = vout->rotation;
 		info.rotation_type = OMAP_DSS_ROT_VRFB;
@@ -443,7 +529,7 @@ setup_ovl_err:
 /*
  * Initialize the overlay structure
  */
-static int omapvid_init(struct omap_vout_device *vout, u32 addr)
+static int omapvid_init(struct omap_vout_device *vout, u32 addr, u32 uv_addr)
 {
 	int ret = 0, i;
 	struct v4l2_window *win;
@@ -494,7 +580,7 @@ static int omapvid_init(struct omap_vout_device *vout, u32 addr)
 		}
 
 		ret = omapvid_setup_overlay(vout, ovl, posx, posy,
-				outw, outh, addr);
+				outw, outh, addr, uv_addr);
 		if (ret)
 			goto omapvid_init_err;
 	}
@@ -567,7 +653,7 @@ err:
 static void omap_vout_isr(void *arg, unsigned int irqstatus)
 {
 	int ret, fid, mgr_id;
-	u32 addr, irq;
+	u32 addr, uv_addr, irq;
 	struct omap_overlay *ovl;
 	struct timeval timevalue;
 	struct omapvideo_info *ovid;
@@ -624,8 +710,10 @@ static void omap_vout_isr(void *arg, unsigned int irqstatus)
 	}
 
 	vout->first_int = 0;
-	if (list_empty(&vout->dma_queue))
+	if (list_empty(&vout->dma_queue)) {
+		vout->stats.repeated++;
 		goto vout_isr_err;
+	}
 
 	vout->next_frm = list_entry(vout->dma_queue.next,
 			struct videobuf_buffer, queue);
@@ -633,11 +721,13 @@ static void omap_vout_isr(void *arg, unsigned int irqstatus)
 
 	vout->next_frm->state = VIDEOBUF_ACTIVE;
 
-	addr = (unsigned long) vout->queued_buf_addr[vout->next_frm->i]
-		+ vout->cropped_offset;
+	addr = omap_vout_frame_addr(vout, vout->next_frm->i, &uv_addr);
+	vout->stats.frames++;
+	if (omap_vout_is_tiler(addr))
+		vout->stats.tiler_frames++;
 
 	/* First save the configuration in ovelray structure */
-	ret = omapvid_init(vout, addr);
+	ret = omapvid_init(vout, addr, uv_addr);
 	if (ret)
 		printk(KERN_ERR VOUT_NAME
 			"failed to set overlay info\n");
@@ -766,14 +856,22 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 {
 	struct omap_vout_device *vout = q->priv_data;
 	struct omapvideo_info *ovid = &vout->vid_info;
+	u32 uv_offset = 0;
 
 	if (VIDEOBUF_NEEDS_INIT == vb->state) {
 		vb->width = vout->pix.width;
 		vb->height = vout->pix.height;
 		vb->size = vb->width * vb->height * vout->bpp;
+		if (V4L2_PIX_FMT_NV12 == vout->pix.pixelformat)
+			vb->size = vout->pix.sizeimage;
 		vb->field = field;
 	}
 	vb->state = VIDEOBUF_PREPARED;
+
+	if (V4L2_PIX_FMT_NV12 == vout->pix.pixelformat)
+		uv_offset = vout->pix.bytesperline * vout->pix.height;
+	vout->queued_uv_addr[vb->i] = 0;
+
 	/* if user pointer memory mechanism is used, get the physical
 	 * address of the buffer
 	 */
@@ -783,6 +881,10 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 		/* Physical address */
 		vout->queued_buf_addr[vb->i] = (u8 *)
 			omap_vout_uservirt_to_phys(vb->baddr);
+		if (uv_offset)
+			vout->queued_uv_addr[vb->i] =
+				omap_vout_uservirt_to_phys(vb->baddr +
+						uv_offset);
 	} else {
 		u32 addr, dma_addr;
 		unsigned long size;
@@ -796,12 +898,20 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 			v4l2_err(&vout->vid_dev->v4l2_dev, "dma_map_single failed\n");
 
 		vout->queued_buf_addr[vb->i] = (u8 *)vout->buf_phy_addr[vb->i];
+		if (uv_offset)
+			vout->queued_uv_addr[vb->i] =
+				vout->buf_phy_addr[vb->i] + uv_offset;
 	}
 
 	if (ovid->rotation_type == VOUT_ROT_VRFB)
 		return omap_vout_prepare_vrfb(vout, vb);
-	else
-		return 0;
+
+	/* without VRFB only TILER views can be rotated or mirrored */
+	if (ovid->rotation_type == VOUT_ROT_TILER && is_rotation_enabled(vout)
+		&& !omap_vout_is_tiler((u32) vout->queued_buf_addr[vb->i]))
+		return -EINVAL;
+
+	return 0;
 }
 
 /*
@@ -1142,7 +1252,15 @@ static int vidioc_s_fmt_vid_out(struct file *file, void *fh,
 	/* change to samller size is OK */
 
 	bpp = omap_vout_try_format(&f->fmt.pix);
-	f->fmt.pix.sizeimage = f->fmt.pix.width * f->fmt.pix.height * bpp;
+	if (f->fmt.pix.pixelformat == V4L2_PIX_FMT_NV12) {
+		if (!(ovl->supported_modes & OMAP_DSS_COLOR_NV12)) {
+			ret = -EINVAL;
+			goto s_fmt_vid_out_exit;
+		}
+	} else {
+		f->fmt.pix.sizeimage = f->fmt.pix.width * f->fmt.pix.height *
+			bpp;
+	}
 
 	/* try & set the new output format */
 	vout->bpp = bpp;
@@ -1158,7 +1276,7 @@ static int vidioc_s_fmt_vid_out(struct file *file, void *fh,
 	omap_vout_new_format(&vout->pix, &vout->fbuf, &vout->crop, &vout->win);
 
 	/* Save the changes in the overlay strcuture */
-	ret = omapvid_init(vout, 0);
+	ret = omapvid_init(vout, 0, 0);
 	if (ret) {
 		v4l2_err(&vout->vid_dev->v4l2_dev, "failed to change mode\n");
 		goto s_fmt_vid_out_exit;
@@ -1345,6 +1463,23 @@ static int vidioc_queryctrl(struct file *file, void *fh,
 	case V4L2_CID_VFLIP:
 		ret = v4l2_ctrl_query_fill(ctrl, 0, 1, 1, 0);
 		break;
+	case V4L2_CID_OMAP_VOUT_FRAMES:
+		strlcpy(ctrl->name, "Frames Displayed", sizeof(ctrl->name));
+		goto query_stats;
+	case V4L2_CID_OMAP_VOUT_REPEATED:
+		strlcpy(ctrl->name, "Frames Repeated", sizeof(ctrl->name));
+		goto query_stats;
+	case V4L2_CID_OMAP_VOUT_TILER_FRAMES:
+		strlcpy(ctrl->name, "TILER Frames", sizeof(ctrl->name));
+query_stats:
+		ctrl->type = V4L2_CTRL_TYPE_INTEGER;
+		ctrl->minimum = 0;
+		ctrl->maximum = INT_MAX;
+		ctrl->step = 1;
+		ctrl->default_value = 0;
+		ctrl->flags = V4L2_CTRL_FLAG_READ_ONLY |
+			V4L2_CTRL_FLAG_VOLATILE;
+		break;
 	default:
 		ctrl->name[0] = '\0';
 		ret = -EINVAL;
@@ -1379,6 +1514,15 @@ static int vidioc_g_ctrl(struct file *file, void *fh, struct v4l2_control *ctrl)
 	case V4L2_CID_VFLIP:
 		ctrl->value = vout->control[2].value;
 		break;
+	case V4L2_CID_OMAP_VOUT_FRAMES:
+		ctrl->value = vout->stats.frames;
+		break;
+	case V4L2_CID_OMAP_VOUT_REPEATED:
+		ctrl->value = vout->stats.repeated;
+		break;
+	case V4L2_CID_OMAP_VOUT_TILER_FRAMES:
+		ctrl->value = vout->stats.tiler_frames;
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1616,7 +1760,7 @@ static int vidioc_dqbuf(struct file *file, void *fh, struct v4l2_buffer *b)
 static int vidioc_streamon(struct file *file, void *fh, enum v4l2_buf_type i)
 {
 	int ret = 0, j;
-	u32 addr = 0, mask = 0;
+	u32 addr = 0, uv_addr = 0, mask = 0;
 	struct omap_vout_device *vout = fh;
 	struct videobuf_queue *q = &vout->vbq;
 	struct omapvideo_info *ovid = &vout->vid_info;
@@ -1656,8 +1800,8 @@ static int vidioc_streamon(struct file *file, void *fh, enum v4l2_buf_type i)
 		ret = -EINVAL;
 		goto streamon_err1;
 	}
-	addr = (unsigned long) vout->queued_buf_addr[vout->cur_frm->i]
-		+ vout->cropped_offset;
+	addr = omap_vout_frame_addr(vout, vout->cur_frm->i, &uv_addr);
+	memset(&vout->stats, 0, sizeof(vout->stats));
 
 	mask = DISPC_IRQ_VSYNC | DISPC_IRQ_EVSYNC_EVEN | DISPC_IRQ_EVSYNC_ODD
 		| DISPC_IRQ_VSYNC2;
@@ -1679,7 +1823,7 @@ static int vidioc_streamon(struct file *file, void *fh, enum v4l2_buf_type i)
 	}
 
 	/* First save the configuration in ovelray structure */
-	ret = omapvid_init(vout, addr);
+	ret = omapvid_init(vout, addr, uv_addr);
 	if (ret)
 		v4l2_err(&vout->vid_dev->v4l2_dev,
 				"failed to set overlay info\n");
@@ -2043,6 +2187,11 @@ static int __init omap_vout_create_video_devices(struct platform_device *pdev)
 		/* Set VRFB as rotation_type for omap2 and omap3 */
 		if (cpu_is_omap24xx() || cpu_is_omap34xx())
 			vout->vid_info.rotation_type = VOUT_ROT_VRFB;
+#ifdef CONFIG_VIDEO_OMAP2_VOUT_TILER
+		/* and let DISPC rotate TILER views where there is a DMM */
+		else if (dmm_is_available())
+			vout->vid_info.rotation_type = VOUT_ROT_TILER;
+#endif
 
 		/* Setup the default configuration for the video devices
 		 */
@@ -18,6 +18,7 @@
 #define RGB565_BPP      2
 #define RGB24_BPP       3
 #define RGB32_BPP       4
+#define NV12_BPP        1
 #define TILE_SIZE       32
 #define YUYV_VRFB_BPP   2
 #define RGB_VRFB_BPP    1
@@ -73,6 +74,18 @@ enum dss_rotation {
 enum vout_rotaion_type {
 	VOUT_ROT_NONE	= 0,
 	VOUT_ROT_VRFB	= 1,
+	VOUT_ROT_TILER	= 2,
+};
+
+/* Read-only frame statistics, reset on every STREAMON */
+#define V4L2_CID_OMAP_VOUT_FRAMES	(V4L2_CID_PRIVATE_BASE + 0)
+#define V4L2_CID_OMAP_VOUT_REPEATED	(V4L2_CID_PRIVATE_BASE + 1)
+#define V4L2_CID_OMAP_VOUT_TILER_FRAMES	(V4L2_CID_PRIVATE_BASE + 2)
+
+struct omap_vout_stats {
+	u32 frames;		/* frames handed to DISPC */
+	u32 repeated;		/* vsyncs without a new frame queued */
+	u32 tiler_frames;	/* frames scanned out of a TILER view */
 };
 
 /*
@@ -172,9 +185,11 @@ struct omap_vout_device {
 	struct videobuf_buffer *cur_frm, *next_frm;
 	struct list_head dma_queue;
 	u8 *queued_buf_addr[VIDEO_MAX_FRAME];
+	u32 queued_uv_addr[VIDEO_MAX_FRAME];
 	u32 cropped_offset;
 	s32 tv_field1_offset;
 	void *isr_handle;
+	struct omap_vout_stats stats;
 
 	/* Buffer queue variables */
 	struct omap_vout_device *vout;
@@ -24,7 +24,9 @@
  */
 
 #include <asm/cacheflush.h>
+#include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/pagemap.h>
 #include <linux/poll.h>
@@ -266,9 +268,20 @@ static void isp_video_buffer_cleanup(struct isp_video_buffer *buf)
 	if (buf->queue->ops->buffer_cleanup)
 		buf->queue->ops->buffer_cleanup(buf);
 
-	if (!(buf->vm_flags & VM_PFNMAP)) {
-		direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
-			  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
+		  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+	if (buf->dbuf != NULL) {
+		if (buf->dsgt != NULL)
+			dma_buf_unmap_attachment(buf->dba, buf->dsgt,
+						 direction);
+		if (buf->dba != NULL)
+			dma_buf_detach(buf->dbuf, buf->dba);
+		dma_buf_put(buf->dbuf);
+		buf->dsgt = NULL;
+		buf->dba = NULL;
+		buf->dbuf = NULL;
+	} else if (!(buf->vm_flags & VM_PFNMAP)) {
 		dma_unmap_sg(buf->queue->dev, buf->sglist, buf->sglen,
 			     direction);
 	}
@@ -462,6 +475,61 @@ done:
 	return ret;
 }
 
+/*
+ * isp_video_buffer_prepare_dmabuf - Map a DMABUF buffer for the ISP
+ *
+ * The dma-buf must have been looked up by the caller. It is attached to the
+ * ISP device and mapped by its exporter, which is responsible for pinning the
+ * memory and for cache maintenance. The exporter mapping must be physically
+ * contiguous, it is then split in pages the same way VM_PFNMAP buffers are.
+ *
+ * The attachment and mapping are kept until the buffer is cleaned up, so a
+ * dma-buf queued repeatedly is only mapped once.
+ */
+static int isp_video_buffer_prepare_dmabuf(struct isp_video_buffer *buf)
+{
+	enum dma_data_direction direction;
+	struct scatterlist *sg;
+	dma_addr_t next;
+	unsigned int i;
+	int ret;
+
+	if (buf->dbuf == NULL || buf->dbuf->size < buf->vbuf.length)
+		return -EINVAL;
+
+	direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
+		  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+	buf->dba = dma_buf_attach(buf->dbuf, buf->queue->dev);
+	if (IS_ERR(buf->dba)) {
+		ret = PTR_ERR(buf->dba);
+		buf->dba = NULL;
+		return ret;
+	}
+
+	buf->dsgt = dma_buf_map_attachment(buf->dba, direction);
+	if (IS_ERR(buf->dsgt)) {
+		ret = PTR_ERR(buf->dsgt);
+		buf->dsgt = NULL;
+		return ret;
+	}
+
+	next = sg_dma_address(buf->dsgt->sgl);
+	for_each_sg(buf->dsgt->sgl, sg, buf->dsgt->nents, i) {
+		if (sg_dma_address(sg) != next)
+			return -EFAULT;
+		next += sg_dma_len(sg);
+	}
+
+	buf->paddr = sg_dma_address(buf->dsgt->sgl);
+	buf->offset = 0;
+	buf->npages = PAGE_ALIGN(buf->vbuf.length) >> PAGE_SHIFT;
+	buf->pages = NULL;
+	buf->skip_cache = true;
+
+	return isp_video_buffer_sglist_pfnmap(buf);
+}
+
 /*
  * isp_video_buffer_prepare - Make a buffer ready for operation
  *
@@ -507,6 +575,10 @@ static int isp_video_buffer_prepare(struct isp_video_buffer *buf)
 		}
 		break;
 
+	case V4L2_MEMORY_DMABUF:
+		ret = isp_video_buffer_prepare_dmabuf(buf);
+		break;
+
 	default:
 		return -EINVAL;
 	}
@@ -514,7 +586,7 @@ static int isp_video_buffer_prepare(struct isp_video_buffer *buf)
 	if (ret < 0)
 		goto done;
 
-	if (!(buf->vm_flags & VM_PFNMAP)) {
+	if (!(buf->vm_flags & VM_PFNMAP) && buf->dbuf == NULL) {
 		direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
 			  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
 		ret = dma_map_sg(buf->queue->dev, buf->sglist, buf->sglen,
@@ -587,6 +659,117 @@ static int isp_video_buffer_wait(struct isp_video_buffer *buf, int nonblocking)
 		buf->state != ISP_BUF_STATE_ACTIVE);
 }
 
+/* -----------------------------------------------------------------------------
+ * Buffer pool
+ *
+ * When the queue pool size is not zero, USERPTR and DMABUF buffers keep their
+ * memory pinned and their DMA and IOMMU mappings set up when they are queued
+ * with a different memory area. Queuing a memory area that has been prepared
+ * before then just swaps buffer objects behind the buffer index, and only the
+ * cache maintenance is left to be done per frame. This is meant for
+ * applications rotating more buffers than they allocate video buffers.
+ */
+
+static bool isp_video_buffer_match(struct isp_video_buffer *buf,
+				   unsigned long userptr, struct dma_buf *dbuf)
+{
+	if (!buf->prepared)
+		return false;
+
+	return dbuf ? buf->dbuf == dbuf : buf->vbuf.m.userptr == userptr;
+}
+
+/*
+ * isp_video_queue_pool_put - Move a buffer to the pool
+ *
+ * Unprepared buffers hold no resources and are freed. The least recently used
+ * buffers are freed when the pool grows beyond its size.
+ */
+static void isp_video_queue_pool_put(struct isp_video_queue *queue,
+				     struct isp_video_buffer *buf)
+{
+	if (!buf->prepared) {
+		isp_video_buffer_cleanup(buf);
+		kfree(buf);
+		return;
+	}
+
+	list_add(&buf->pool, &queue->pool);
+	queue->pool_count++;
+
+	while (queue->pool_count > queue->pool_size) {
+		buf = list_entry(queue->pool.prev, struct isp_video_buffer,
+				 pool);
+		list_del(&buf->pool);
+		queue->pool_count--;
+		isp_video_buffer_cleanup(buf);
+		kfree(buf);
+	}
+}
+
+/*
+ * isp_video_queue_pool_get - Get a buffer prepared for a memory area
+ *
+ * Return the buffer object to be used for the index of the given buffer,
+ * prepared for the userspace address or dma-buf if found among the idle
+ * buffers or in the pool. The given buffer is moved to the pool or to the index
+ * of the buffer it is exchanged with. If no prepared buffer is found a new,
+ * unprepared, buffer is returned, or the given buffer if allocation fails.
+ *
+ * This function must be called with the queue lock held, and the given buffer
+ * must be idle.
+ */
+static struct isp_video_buffer *
+isp_video_queue_pool_get(struct isp_video_queue *queue,
+			 struct isp_video_buffer *buf, unsigned long userptr,
+			 struct dma_buf *dbuf)
+{
+	unsigned int index = buf->vbuf.index;
+	struct isp_video_buffer *other;
+	unsigned int i;
+
+	for (i = 0; i < queue->count; ++i) {
+		other = queue->buffers[i];
+		if (other == buf || other->state != ISP_BUF_STATE_IDLE ||
+		    !isp_video_buffer_match(other, userptr, dbuf))
+			continue;
+
+		queue->buffers[index] = other;
+		queue->buffers[i] = buf;
+		other->vbuf.index = index;
+		buf->vbuf.index = i;
+		queue->stats.pool_hits++;
+		return other;
+	}
+
+	list_for_each_entry(other, &queue->pool, pool) {
+		if (!isp_video_buffer_match(other, userptr, dbuf))
+			continue;
+
+		list_del(&other->pool);
+		queue->pool_count--;
+		queue->stats.pool_hits++;
+		goto install;
+	}
+
+	other = kzalloc(queue->bufsize, GFP_KERNEL);
+	if (other == NULL)
+		return buf;
+
+	other->vbuf.length = buf->vbuf.length;
+	other->vbuf.type = buf->vbuf.type;
+	other->vbuf.field = buf->vbuf.field;
+	other->vbuf.memory = buf->vbuf.memory;
+	other->queue = queue;
+	init_waitqueue_head(&other->wait);
+
+install:
+	other->vbuf.index = index;
+	queue->buffers[index] = other;
+	isp_video_queue_pool_put(queue, buf);
+	return other;
+}
+
 /* -----------------------------------------------------------------------------
  * Queue management
  */
@@ -623,7 +806,18 @@ static int isp_video_queue_free(struct isp_video_queue *queue)
 		queue->buffers[i] = NULL;
 	}
 
+	while (!list_empty(&queue->pool)) {
+		struct isp_video_buffer *buf =
+			list_first_entry(&queue->pool, struct isp_video_buffer,
+					 pool);
+
+		list_del(&buf->pool);
+		isp_video_buffer_cleanup(buf);
+		kfree(buf);
+	}
+
 	INIT_LIST_HEAD(&queue->queue);
+	queue->pool_count = 0;
 	queue->count = 0;
 	return 0;
 }
@@ -733,6 +927,7 @@ int omap3isp_video_queue_init(struct isp_video_queue *queue,
 			      struct device *dev, unsigned int bufsize)
 {
 	INIT_LIST_HEAD(&queue->queue);
+	INIT_LIST_HEAD(&queue->pool);
 	mutex_init(&queue->lock);
 	spin_lock_init(&queue->irqlock);
 
@@ -842,7 +1037,8 @@ done:
  *
  * Before being enqueued, USERPTR buffers are checked for address changes. If
  * the buffer has a different userspace address, the old memory area is unlocked
- * and the new memory area is locked.
+ * and the new memory area is locked. DMABUF buffers are likewise remapped only
+ * when a different dma-buf is queued.
  */
 int omap3isp_video_queue_qbuf(struct isp_video_queue *queue,
 			      struct v4l2_buffer *vbuf)
@@ -871,6 +1067,11 @@ int omap3isp_video_queue_qbuf(struct isp_video_queue *queue,
 	    vbuf->length < buf->vbuf.length)
 		goto done;
 
+	if (vbuf->memory == V4L2_MEMORY_USERPTR &&
+	    vbuf->m.userptr != buf->vbuf.m.userptr && queue->pool_size)
+		buf = isp_video_queue_pool_get(queue, buf, vbuf->m.userptr,
+					       NULL);
+
 	if (vbuf->memory == V4L2_MEMORY_USERPTR &&
 	    vbuf->m.userptr != buf->vbuf.m.userptr) {
 		isp_video_buffer_cleanup(buf);
@@ -878,11 +1079,43 @@ int omap3isp_video_queue_qbuf(struct isp_video_queue *queue,
 		buf->prepared = 0;
 	}
 
+	if (vbuf->memory == V4L2_MEMORY_DMABUF) {
+		struct dma_buf *dbuf = dma_buf_get(vbuf->m.fd);
+
+		if (IS_ERR(dbuf)) {
+			ret = PTR_ERR(dbuf);
+			goto done;
+		}
+
+		/* Compare the dma-buf and not the file descriptor, a closed
+		 * descriptor number can be reused for a different buffer.
+		 */
+		if (dbuf != buf->dbuf && queue->pool_size)
+			buf = isp_video_queue_pool_get(queue, buf, 0, dbuf);
+
+		if (dbuf == buf->dbuf) {
+			dma_buf_put(dbuf);
+		} else {
+			isp_video_buffer_cleanup(buf);
+			buf->dbuf = dbuf;
+			buf->prepared = 0;
+		}
+		buf->vbuf.m.fd = vbuf->m.fd;
+	}
+
 	if (!buf->prepared) {
+		ktime_t start = ktime_get();
+
 		ret = isp_video_buffer_prepare(buf);
 		if (ret < 0)
 			goto done;
 		buf->prepared = 1;
+
+		buf->prepare_time = ktime_to_us(ktime_sub(ktime_get(), start));
+		queue->stats.prepares++;
+		queue->stats.prepare_time += buf->prepare_time;
+		queue->stats.prepare_time_max =
+			max(queue->stats.prepare_time_max, buf->prepare_time);
 	}
 
 	isp_video_buffer_cache_sync(buf);
@@ -1015,6 +1248,13 @@ void omap3isp_video_queue_streamoff(struct isp_video_queue *queue)
 
 	INIT_LIST_HEAD(&queue->queue);
 
+	if (queue->stats.prepares)
+		dev_dbg(queue->dev, "%u buffer prepares, %llu us avg, %u us max, "
+			"%u pool hits\n", queue->stats.prepares,
+			div_u64(queue->stats.prepare_time,
+				queue->stats.prepares),
+			queue->stats.prepare_time_max, queue->stats.pool_hits);
+
 done:
 	mutex_unlock(&queue->lock);
 }
@@ -86,6 +86,11 @@ struct isp_video_buffer {
 	unsigned int prepared:1;
 	bool skip_cache;
 
+	/* For pooled buffers not assigned to an index. */
+	struct list_head pool;
+	/* Time spent in the last prepare operation, in us. */
+	u32 prepare_time;
+
 	/* For kernel buffers. */
 	void *vaddr;
 
@@ -96,6 +101,11 @@ struct isp_video_buffer {
 	struct page **pages;
 	dma_addr_t paddr;
 
+	/* For DMABUF buffers. */
+	struct dma_buf *dbuf;
+	struct dma_buf_attachment *dba;
+	struct sg_table *dsgt;
+
 	/* For all buffers except VM_PFNMAP. */
 	unsigned int sglen;
 	struct scatterlist *sglist;
@@ -145,6 +155,11 @@ struct isp_video_queue_operations {
  * @irqlock: Spinlock to protect access to the IRQ queue
  * @streaming: Queue state, indicates whether the queue is streaming
  * @queue: List of all queued buffers
+ * @pool_size: Number of prepared USERPTR or DMABUF buffers kept in addition
+ *	to the allocated ones, 0 to disable the buffer pool
+ * @pool: Prepared buffers not assigned to an index, most recent first
+ * @pool_count: Number of buffers in the pool
+ * @stats: Buffer preparation statistics
  */
 struct isp_video_queue {
 	enum v4l2_buf_type type;
@@ -160,6 +175,17 @@ struct isp_video_queue {
 	unsigned int streaming:1;
 
 	struct list_head queue;
+
+	unsigned int pool_size;
+	struct list_head pool;
+	unsigned int pool_count;
+
+	struct {
+		unsigned int prepares;
+		unsigned int pool_hits;
+		u64 prepare_time;
+		u32 prepare_time_max;
+	} stats;
 };
 
 int omap3isp_video_queue_cleanup(struct isp_video_queue *queue);
@@ -26,6 +26,7 @@
  */
 
 #include <linux/dma-mapping.h>
+#include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 
@@ -251,6 +252,40 @@ isp_stat_buf_find_oldest_or_empty(struct ispstat *stat)
 	return __isp_stat_buf_find(stat, 1);
 }
 
+/*
+ * The ring descriptors are read by userspace without locking. The sequence
+ * number is made odd before the module owns a buffer and even once the
+ * statistics are complete, with the data written in between.
+ */
+static void isp_stat_ring_begin(struct ispstat *stat,
+				struct ispstat_buffer *buf)
+{
+	struct omap3isp_stat_ring_buf *desc = &stat->ring->bufs[buf - stat->buf];
+
+	if (!(desc->sequence & 1)) {
+		desc->sequence++;
+		smp_wmb();
+	}
+}
+
+static void isp_stat_ring_end(struct ispstat *stat, struct ispstat_buffer *buf)
+{
+	unsigned int index = buf - stat->buf;
+	struct omap3isp_stat_ring_buf *desc = &stat->ring->bufs[index];
+
+	/* Mapped cached, don't let userspace read stale lines. */
+	if (atomic_read(&stat->mmap_count))
+		isp_stat_buf_sync_for_cpu(stat, buf);
+
+	desc->frame_number = buf->frame_number;
+	desc->buf_size = buf->buf_size;
+	desc->config_counter = buf->config_counter;
+	desc->ts = buf->ts;
+	smp_wmb();
+	desc->sequence += (desc->sequence & 1) ? 1 : 2;
+	stat->ring->latest = index;
+}
+
 static int isp_stat_buf_queue(struct ispstat *stat)
 {
 	if (!stat->active_buf)
@@ -267,6 +302,7 @@ static int isp_stat_buf_queue(struct ispstat *stat)
 	stat->active_buf->config_counter = stat->config_counter;
 	stat->active_buf->frame_number = stat->frame_number;
 	stat->active_buf->empty = 0;
+	isp_stat_ring_end(stat, stat->active_buf);
 	stat->active_buf = NULL;
 
 	return STAT_BUF_DONE;
@@ -282,6 +318,9 @@ static void isp_stat_buf_next(struct ispstat *stat)
 					stat->subdev.name);
 	else
 		stat->active_buf = isp_stat_buf_find_oldest_or_empty(stat);
+
+	if (stat->active_buf)
+		isp_stat_ring_begin(stat, stat->active_buf);
 }
 
 static void isp_stat_buf_release(struct ispstat *stat)
@@ -465,6 +504,8 @@ static int isp_stat_bufs_alloc_dma(struct ispstat *stat, unsigned int size)
 static int isp_stat_bufs_alloc(struct ispstat *stat, u32 size)
 {
 	unsigned long flags;
+	int ret;
+	int i;
 
 	spin_lock_irqsave(&stat->isp->stat_lock, flags);
 
@@ -476,6 +517,12 @@ static int isp_stat_bufs_alloc(struct ispstat *stat, u32 size)
 		return 0;
 	}
 
+	/* Buffers mapped by userspace can't be replaced. */
+	if (atomic_read(&stat->mmap_count)) {
+		spin_unlock_irqrestore(&stat->isp->stat_lock, flags);
+		return -EBUSY;
+	}
+
 	if (stat->state != ISPSTAT_DISABLED || stat->buf_processing) {
 		dev_info(stat->isp->dev,
 			 "%s: trying to allocate memory when busy\n",
@@ -489,11 +536,123 @@ static int isp_stat_bufs_alloc(struct ispstat *stat, u32 size)
 	isp_stat_bufs_free(stat);
 
 	if (IS_COHERENT_BUF(stat))
-		return isp_stat_bufs_alloc_dma(stat, size);
+		ret = isp_stat_bufs_alloc_dma(stat, size);
+	else
+		ret = isp_stat_bufs_alloc_iommu(stat, size);
+	if (ret < 0)
+		return ret;
+
+	stat->ring->num_bufs = STAT_MAX_BUFS;
+	for (i = 0; i < STAT_MAX_BUFS; i++)
+		stat->ring->bufs[i].offset = OMAP3ISP_STAT_RING_DATA +
+					     i * PAGE_ALIGN(size);
+
+	return 0;
+}
+
+static void isp_stat_vm_open(struct vm_area_struct *vma)
+{
+	struct ispstat *stat = vma->vm_private_data;
+
+	atomic_inc(&stat->mmap_count);
+}
+
+static void isp_stat_vm_close(struct vm_area_struct *vma)
+{
+	struct ispstat *stat = vma->vm_private_data;
+
+	atomic_dec(&stat->mmap_count);
+}
+
+static const struct vm_operations_struct isp_stat_vm_ops = {
+	.open = isp_stat_vm_open,
+	.close = isp_stat_vm_close,
+};
+
+static int isp_stat_mmap_bufs(struct ispstat *stat, struct vm_area_struct *vma)
+{
+	unsigned long size = PAGE_ALIGN(stat->buf_alloc_size);
+	unsigned long addr = vma->vm_start;
+	unsigned long off;
+	int ret;
+	int i;
+
+	if (vma->vm_end - vma->vm_start > STAT_MAX_BUFS * size)
+		return -EINVAL;
+
+	if (IS_COHERENT_BUF(stat))
+		vma->vm_page_prot = pgprot_dmacoherent(vma->vm_page_prot);
+
+	for (i = 0; i < STAT_MAX_BUFS && addr < vma->vm_end; i++) {
+		struct ispstat_buffer *buf = &stat->buf[i];
+
+		for (off = 0; off < size && addr < vma->vm_end;
+		     off += PAGE_SIZE, addr += PAGE_SIZE) {
+			if (IS_COHERENT_BUF(stat))
+				ret = remap_pfn_range(vma, addr,
+					(buf->dma_addr + off) >> PAGE_SHIFT,
+					PAGE_SIZE, vma->vm_page_prot);
+			else
+				ret = vm_insert_page(vma, addr,
+					vmalloc_to_page(buf->virt_addr + off));
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * isp_stat_mmap - Map the statistics ring to userspace
+ *
+ * The ring header page is mapped at offset 0, the buffers from offset
+ * OMAP3ISP_STAT_RING_DATA, in separate mappings as coherent buffers can't be
+ * mapped along with normal pages.
+ */
+static int isp_stat_mmap(struct v4l2_subdev *sd, struct vm_area_struct *vma)
+{
+	struct ispstat *stat = v4l2_get_subdevdata(sd);
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	mutex_lock(&stat->ioctl_lock);
+
+	if (!stat->buf_alloc_size) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_RESERVED;
+
+	if (vma->vm_pgoff == 0 && size == PAGE_SIZE)
+		ret = vm_insert_page(vma, vma->vm_start,
+				     virt_to_page(stat->ring));
+	else if (vma->vm_pgoff == OMAP3ISP_STAT_RING_DATA >> PAGE_SHIFT)
+		ret = isp_stat_mmap_bufs(stat, vma);
 	else
-		return isp_stat_bufs_alloc_iommu(stat, size);
+		ret = -EINVAL;
+
+	if (ret < 0)
+		goto done;
+
+	vma->vm_ops = &isp_stat_vm_ops;
+	vma->vm_private_data = stat;
+	isp_stat_vm_open(vma);
+
+done:
+	mutex_unlock(&stat->ioctl_lock);
+	return ret;
 }
 
+static const struct v4l2_subdev_internal_ops isp_stat_internal_ops = {
+	.mmap = isp_stat_mmap,
+};
+
 static void isp_stat_queue_event(struct ispstat *stat, int err)
 {
 	struct video_device *vdev = stat->subdev.devnode;
@@ -504,6 +663,7 @@ static void isp_stat_queue_event(struct ispstat *stat, int err)
 	if (!err) {
 		status->frame_number = stat->frame_number;
 		status->config_counter = stat->config_counter;
+		status->buf_index = stat->ring->latest;
 	} else {
 		status->buf_err = 1;
 	}
@@ -1060,6 +1220,7 @@ static int isp_stat_init_entities(struct ispstat *stat, const char *name,
 	struct media_entity *me = &subdev->entity;
 
 	v4l2_subdev_init(subdev, sd_ops);
+	subdev->internal_ops = &isp_stat_internal_ops;
 	snprintf(subdev->name, V4L2_SUBDEV_NAME_SIZE, "OMAP3 ISP %s", name);
 	subdev->grp_id = 1 << 16;	/* group ID for isp subdevs */
 	subdev->flags |= V4L2_SUBDEV_FL_HAS_EVENTS | V4L2_SUBDEV_FL_HAS_DEVNODE;
@@ -1080,13 +1241,21 @@ int omap3isp_stat_init(struct ispstat *stat, const char *name,
 	if (!stat->buf)
 		return -ENOMEM;
 
+	stat->ring = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!stat->ring) {
+		kfree(stat->buf);
+		return -ENOMEM;
+	}
+
 	isp_stat_buf_clear(stat);
 	mutex_init(&stat->ioctl_lock);
 	atomic_set(&stat->buf_err, 0);
+	atomic_set(&stat->mmap_count, 0);
 
 	ret = isp_stat_init_entities(stat, name, sd_ops);
 	if (ret < 0) {
 		mutex_destroy(&stat->ioctl_lock);
+		free_page((unsigned long)stat->ring);
 		kfree(stat->buf);
 	}
 
@@ -1098,5 +1267,6 @@ void omap3isp_stat_cleanup(struct ispstat *stat)
 	media_entity_cleanup(&stat->subdev.entity);
 	mutex_destroy(&stat->ioctl_lock);
 	isp_stat_bufs_free(stat);
+	free_page((unsigned long)stat->ring);
 	kfree(stat->buf);
 }
@@ -36,7 +36,7 @@
 #include "isp.h"
 #include "ispvideo.h"
 
-#define STAT_MAX_BUFS		5
+#define STAT_MAX_BUFS		OMAP3ISP_STAT_MAX_BUFS
 #define STAT_NEVENTS		8
 
 #define STAT_BUF_DONE		0	/* Buffer is ready */
@@ -126,6 +126,10 @@ struct ispstat {
 	struct ispstat_buffer *buf;
 	struct ispstat_buffer *active_buf;
 	struct ispstat_buffer *locked_buf;
+
+	/* Ring header shared with userspace */
+	struct omap3isp_stat_ring *ring;
+	atomic_t mmap_count;
 };
 
 struct ispstat_generic_config {
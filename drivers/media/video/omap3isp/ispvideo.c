@@ -41,6 +41,10 @@
 #include "ispvideo.h"
 #include "isp.h"
 
+static unsigned int buffer_pool;
+module_param(buffer_pool, uint, 0644);
+MODULE_PARM_DESC(buffer_pool, "Number of prepared USERPTR/DMABUF buffers "
+		 "kept mapped in addition to the requested ones");
 
 /* -----------------------------------------------------------------------------
  * Helper functions
@@ -1214,6 +1218,7 @@ static int isp_video_open(struct file *file)
 	omap3isp_video_queue_init(&handle->queue, video->type,
 				  &isp_video_queue_ops, video->isp->dev,
 				  sizeof(struct isp_buffer));
+	handle->queue.pool_size = buffer_pool;
 
 	memset(&handle->format, 0, sizeof(handle->format));
 	handle->format.type = video->type;
@@ -24,6 +24,14 @@
 static int debug;
 module_param(debug, int, 0644);
 
+/* cache maintenance done and skipped on USERPTR planes, for all queues */
+static unsigned int cache_cleans;
+module_param(cache_cleans, uint, 0444);
+static unsigned int cache_invalidates;
+module_param(cache_invalidates, uint, 0444);
+static unsigned int cache_skipped;
+module_param(cache_skipped, uint, 0444);
+
 #define dprintk(level, fmt, arg...)					\
 	do {								\
 		if (debug >= level)					\
@@ -105,6 +113,36 @@ static void __vb2_buf_userptr_put(struct vb2_buffer *vb)
 	}
 }
 
+/**
+ * __vb2_plane_dmabuf_put() - release memory associated with
+ * a DMABUF shared plane
+ */
+static void __vb2_plane_dmabuf_put(struct vb2_queue *q, struct vb2_plane *p)
+{
+	if (!p->mem_priv)
+		return;
+
+	if (p->dbuf_mapped)
+		call_memop(q, unmap_dmabuf, p->mem_priv);
+
+	call_memop(q, detach_dmabuf, p->mem_priv);
+	dma_buf_put(p->dbuf);
+	memset(p, 0, sizeof *p);
+}
+
+/**
+ * __vb2_buf_dmabuf_put() - release memory associated with
+ * a DMABUF shared buffer
+ */
+static void __vb2_buf_dmabuf_put(struct vb2_buffer *vb)
+{
+	struct vb2_queue *q = vb->vb2_queue;
+	unsigned int plane;
+
+	for (plane = 0; plane < vb->num_planes; ++plane)
+		__vb2_plane_dmabuf_put(q, &vb->planes[plane]);
+}
+
 /**
  * __setup_offsets() - setup unique offsets ("cookies") for every plane in
  * every buffer on the queue
@@ -224,9 +262,11 @@ static void __vb2_free_mem(struct vb2_queue *q, unsigned int buffers)
 		if (!vb)
 			continue;
 
-		/* Free MMAP buffers or release USERPTR buffers */
+		/* Free MMAP buffers or release USERPTR/DMABUF buffers */
 		if (q->memory == V4L2_MEMORY_MMAP)
 			__vb2_buf_mem_free(vb);
+		else if (q->memory == V4L2_MEMORY_DMABUF)
+			__vb2_buf_dmabuf_put(vb);
 		else
 			__vb2_buf_userptr_put(vb);
 	}
@@ -360,6 +400,8 @@ static int __fill_v4l2_buffer(struct vb2_buffer *vb, struct v4l2_buffer *b)
 			b->m.offset = vb->v4l2_planes[0].m.mem_offset;
 		else if (q->memory == V4L2_MEMORY_USERPTR)
 			b->m.userptr = vb->v4l2_planes[0].m.userptr;
+		else if (q->memory == V4L2_MEMORY_DMABUF)
+			b->m.fd = vb->v4l2_planes[0].m.fd;
 	}
 
 	/*
@@ -437,6 +479,20 @@ static int __verify_userptr_ops(struct vb2_queue *q)
 	return 0;
 }
 
+/**
+ * __verify_dmabuf_ops() - verify that all memory operations required for
+ * DMABUF queue type have been provided
+ */
+static int __verify_dmabuf_ops(struct vb2_queue *q)
+{
+	if (!(q->io_modes & VB2_DMABUF) || !q->mem_ops->attach_dmabuf ||
+	    !q->mem_ops->detach_dmabuf  || !q->mem_ops->map_dmabuf ||
+	    !q->mem_ops->unmap_dmabuf)
+		return -EINVAL;
+
+	return 0;
+}
+
 /**
  * __verify_mmap_ops() - verify that all memory operations required for
  * MMAP queue type have been provided
@@ -484,7 +540,8 @@ int vb2_reqbufs(struct vb2_queue *q, struct v4l2_requestbuffers *req)
 	}
 
 	if (req->memory != V4L2_MEMORY_MMAP
-			&& req->memory != V4L2_MEMORY_USERPTR) {
+			&& req->memory != V4L2_MEMORY_USERPTR
+			&& req->memory != V4L2_MEMORY_DMABUF) {
 		dprintk(1, "reqbufs: unsupported memory type\n");
 		return -EINVAL;
 	}
@@ -513,6 +570,11 @@ int vb2_reqbufs(struct vb2_queue *q, struct v4l2_requestbuffers *req)
 		return -EINVAL;
 	}
 
+	if (req->memory == V4L2_MEMORY_DMABUF && __verify_dmabuf_ops(q)) {
+		dprintk(1, "reqbufs: DMABUF for current setup unsupported\n");
+		return -EINVAL;
+	}
+
 	if (req->count == 0 || q->num_buffers != 0 || q->memory != req->memory) {
 		/*
 		 * We already have buffers allocated, so first check if they
@@ -620,7 +682,8 @@ int vb2_create_bufs(struct vb2_queue *q, struct v4l2_create_buffers *create)
 	}
 
 	if (create->memory != V4L2_MEMORY_MMAP
-			&& create->memory != V4L2_MEMORY_USERPTR) {
+			&& create->memory != V4L2_MEMORY_USERPTR
+			&& create->memory != V4L2_MEMORY_DMABUF) {
 		dprintk(1, "%s(): unsupported memory type\n", __func__);
 		return -EINVAL;
 	}
@@ -644,6 +707,11 @@ int vb2_create_bufs(struct vb2_queue *q, struct v4l2_create_buffers *create)
 		return -EINVAL;
 	}
 
+	if (create->memory == V4L2_MEMORY_DMABUF && __verify_dmabuf_ops(q)) {
+		dprintk(1, "%s(): DMABUF for current setup unsupported\n", __func__);
+		return -EINVAL;
+	}
+
 	if (q->num_buffers == VIDEO_MAX_FRAME) {
 		dprintk(1, "%s(): maximum number of buffers already allocated\n",
 			__func__);
@@ -839,6 +907,14 @@ static int __fill_vb2_buffer(struct vb2_buffer *vb, const struct v4l2_buffer *b,
 					b->m.planes[plane].length;
 			}
 		}
+		if (b->memory == V4L2_MEMORY_DMABUF) {
+			for (plane = 0; plane < vb->num_planes; ++plane) {
+				v4l2_planes[plane].m.fd =
+					b->m.planes[plane].m.fd;
+				v4l2_planes[plane].length =
+					b->m.planes[plane].length;
+			}
+		}
 	} else {
 		/*
 		 * Single-planar buffers do not use planes array,
@@ -853,6 +929,11 @@ static int __fill_vb2_buffer(struct vb2_buffer *vb, const struct v4l2_buffer *b,
 			v4l2_planes[0].m.userptr = b->m.userptr;
 			v4l2_planes[0].length = b->length;
 		}
+
+		if (b->memory == V4L2_MEMORY_DMABUF) {
+			v4l2_planes[0].m.fd = b->m.fd;
+			v4l2_planes[0].length = b->length;
+		}
 	}
 
 	vb->v4l2_buf.field = b->field;
@@ -915,6 +996,7 @@ static int __qbuf_userptr(struct vb2_buffer *vb, const struct v4l2_buffer *b)
 			goto err;
 		}
 		vb->planes[plane].mem_priv = mem_priv;
+		vb->planes[plane].cache_state = VB2_CACHE_CPU_DIRTY;
 	}
 
 	/*
@@ -948,6 +1030,116 @@ err:
 	return ret;
 }
 
+/**
+ * __qbuf_dmabuf() - handle qbuf of a DMABUF buffer
+ *
+ * A plane queued again with the same dma-buf keeps its attachment and
+ * mapping, so the exporter is not asked to pin the memory again.
+ */
+static int __qbuf_dmabuf(struct vb2_buffer *vb, const struct v4l2_buffer *b)
+{
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct vb2_queue *q = vb->vb2_queue;
+	void *mem_priv;
+	unsigned int plane;
+	int ret;
+	int write = !V4L2_TYPE_IS_OUTPUT(q->type);
+
+	/* Verify and copy relevant information provided by the userspace */
+	ret = __fill_vb2_buffer(vb, b, planes);
+	if (ret)
+		return ret;
+
+	for (plane = 0; plane < vb->num_planes; ++plane) {
+		struct dma_buf *dbuf = dma_buf_get(planes[plane].m.fd);
+
+		if (IS_ERR_OR_NULL(dbuf)) {
+			dprintk(1, "qbuf: invalid dmabuf fd for plane %d\n",
+				plane);
+			ret = -EINVAL;
+			goto err;
+		}
+
+		/* use DMABUF size if length is not provided */
+		if (planes[plane].length == 0)
+			planes[plane].length = dbuf->size;
+
+		if (planes[plane].length < q->plane_sizes[plane] ||
+		    planes[plane].length > dbuf->size) {
+			dma_buf_put(dbuf);
+			ret = -EINVAL;
+			goto err;
+		}
+
+		/* Skip the plane if already verified */
+		if (dbuf == vb->planes[plane].dbuf &&
+		    vb->v4l2_planes[plane].length == planes[plane].length) {
+			dma_buf_put(dbuf);
+			continue;
+		}
+
+		dprintk(3, "qbuf: buffer for plane %d changed\n", plane);
+
+		/* Release previously acquired memory if present */
+		__vb2_plane_dmabuf_put(q, &vb->planes[plane]);
+		memset(&vb->v4l2_planes[plane], 0, sizeof(struct v4l2_plane));
+
+		/* Acquire each plane's memory */
+		mem_priv = call_memop(q, attach_dmabuf, q->alloc_ctx[plane],
+			dbuf, planes[plane].length, write);
+		if (IS_ERR_OR_NULL(mem_priv)) {
+			dprintk(1, "qbuf: failed to attach dmabuf\n");
+			ret = mem_priv ? PTR_ERR(mem_priv) : -EINVAL;
+			dma_buf_put(dbuf);
+			goto err;
+		}
+
+		vb->planes[plane].dbuf = dbuf;
+		vb->planes[plane].mem_priv = mem_priv;
+	}
+
+	/*
+	 * Map the planes for the device.  The mapping is kept across dqbuf
+	 * until the plane is given another dma-buf or the buffers are freed.
+	 */
+	for (plane = 0; plane < vb->num_planes; ++plane) {
+		if (vb->planes[plane].dbuf_mapped)
+			continue;
+
+		ret = call_memop(q, map_dmabuf, vb->planes[plane].mem_priv);
+		if (ret) {
+			dprintk(1, "qbuf: failed mapping dmabuf "
+				"memory for plane %d\n", plane);
+			goto err;
+		}
+		vb->planes[plane].dbuf_mapped = 1;
+	}
+
+	/*
+	 * Call driver-specific initialization on the newly acquired buffer,
+	 * if provided.
+	 */
+	ret = call_qop(q, buf_init, vb);
+	if (ret) {
+		dprintk(1, "qbuf: buffer initialization failed\n");
+		goto err;
+	}
+
+	/*
+	 * Now that everything is in order, copy relevant information
+	 * provided by userspace.
+	 */
+	for (plane = 0; plane < vb->num_planes; ++plane)
+		vb->v4l2_planes[plane] = planes[plane];
+
+	return 0;
+err:
+	/* In case of errors, release planes that were already acquired */
+	__vb2_buf_dmabuf_put(vb);
+
+	return ret;
+}
+
 /**
  * __qbuf_mmap() - handle qbuf of an MMAP buffer
  */
@@ -968,6 +1160,70 @@ static void __enqueue_in_driver(struct vb2_buffer *vb)
 	q->ops->buf_queue(vb);
 }
 
+/**
+ * __vb2_sync_for_device() - write back CPU caches of a buffer being queued
+ *
+ * Planes are only cleaned if the CPU may have written to them, which is
+ * assumed unless userspace sets V4L2_BUF_FLAG_NO_CACHE_CLEAN. Planes of
+ * capture buffers may then be written by the device.
+ */
+static void __vb2_sync_for_device(struct vb2_buffer *vb)
+{
+	struct vb2_queue *q = vb->vb2_queue;
+	unsigned int plane;
+
+	if (!q->mem_ops->sync_for_device)
+		return;
+
+	for (plane = 0; plane < vb->num_planes; ++plane) {
+		struct vb2_plane *p = &vb->planes[plane];
+
+		if (!(vb->v4l2_buf.flags & V4L2_BUF_FLAG_NO_CACHE_CLEAN))
+			p->cache_state = VB2_CACHE_CPU_DIRTY;
+
+		if (p->cache_state == VB2_CACHE_CPU_DIRTY) {
+			q->mem_ops->sync_for_device(p->mem_priv);
+			cache_cleans++;
+		} else {
+			cache_skipped++;
+		}
+
+		p->cache_state = V4L2_TYPE_IS_OUTPUT(q->type) ?
+				 VB2_CACHE_CLEAN : VB2_CACHE_DEVICE_DIRTY;
+	}
+}
+
+/**
+ * __vb2_sync_for_cpu() - discard stale CPU caches of a buffer being dequeued
+ *
+ * With V4L2_BUF_FLAG_NO_CACHE_INVALIDATE set when queuing the buffer, planes
+ * written by the device stay that way until dequeued without the flag.
+ */
+static void __vb2_sync_for_cpu(struct vb2_buffer *vb)
+{
+	struct vb2_queue *q = vb->vb2_queue;
+	unsigned int plane;
+
+	if (!q->mem_ops->sync_for_cpu)
+		return;
+
+	for (plane = 0; plane < vb->num_planes; ++plane) {
+		struct vb2_plane *p = &vb->planes[plane];
+
+		if (p->cache_state != VB2_CACHE_DEVICE_DIRTY)
+			continue;
+
+		if (vb->v4l2_buf.flags & V4L2_BUF_FLAG_NO_CACHE_INVALIDATE) {
+			cache_skipped++;
+			continue;
+		}
+
+		q->mem_ops->sync_for_cpu(p->mem_priv);
+		p->cache_state = VB2_CACHE_CLEAN;
+		cache_invalidates++;
+	}
+}
+
 static int __buf_prepare(struct vb2_buffer *vb, const struct v4l2_buffer *b)
 {
 	struct vb2_queue *q = vb->vb2_queue;
@@ -980,11 +1236,16 @@ static int __buf_prepare(struct vb2_buffer *vb, const struct v4l2_buffer *b)
 	case V4L2_MEMORY_USERPTR:
 		ret = __qbuf_userptr(vb, b);
 		break;
+	case V4L2_MEMORY_DMABUF:
+		ret = __qbuf_dmabuf(vb, b);
+		break;
 	default:
 		WARN(1, "Invalid queue type\n");
 		ret = -EINVAL;
 	}
 
+	if (!ret && q->memory == V4L2_MEMORY_USERPTR)
+		__vb2_sync_for_device(vb);
 	if (!ret)
 		ret = call_qop(q, buf_prepare, vb);
 	if (ret)
@@ -1329,6 +1590,9 @@ int vb2_dqbuf(struct vb2_queue *q, struct v4l2_buffer *b, bool nonblocking)
 		return ret;
 	}
 
+	if (q->memory == V4L2_MEMORY_USERPTR)
+		__vb2_sync_for_cpu(vb);
+
 	ret = call_qop(q, buf_finish, vb);
 	if (ret) {
 		dprintk(1, "dqbuf: buffer finish failed\n");
@@ -12,24 +12,45 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
 
 #include <media/videobuf2-core.h>
 #include <media/videobuf2-dma-contig.h>
 #include <media/videobuf2-memops.h>
 
+/*
+ * Freed MMAP buffers are kept for reuse by the next allocation of the same
+ * size, so that streaming restarts don't go through dma_alloc_coherent again.
+ */
+static unsigned int recycle = 4;
+module_param(recycle, uint, 0644);
+MODULE_PARM_DESC(recycle, "Number of freed buffers kept per device for reuse");
+
 struct vb2_dc_conf {
 	struct device		*dev;
+	struct mutex		lock;
+	struct list_head	free_bufs;
+	unsigned int		num_free;
 };
 
 struct vb2_dc_buf {
 	struct vb2_dc_conf		*conf;
+	struct list_head		list;
 	void				*vaddr;
 	dma_addr_t			dma_addr;
 	unsigned long			size;
 	struct vm_area_struct		*vma;
+	unsigned long			uaddr;
+	bool				cached;
 	atomic_t			refcount;
 	struct vb2_vmarea_handler	handler;
+
+	/* DMABUF related */
+	struct dma_buf_attachment	*db_attach;
+	struct sg_table			*dma_sgt;
+	enum dma_data_direction		dma_dir;
 };
 
 static void vb2_dma_contig_put(void *buf_priv);
@@ -39,6 +60,19 @@ static void *vb2_dma_contig_alloc(void *alloc_ctx, unsigned long size)
 	struct vb2_dc_conf *conf = alloc_ctx;
 	struct vb2_dc_buf *buf;
 
+	mutex_lock(&conf->lock);
+	list_for_each_entry(buf, &conf->free_bufs, list) {
+		if (buf->size == size) {
+			list_del(&buf->list);
+			conf->num_free--;
+			mutex_unlock(&conf->lock);
+			/* don't hand out the previous owner's data */
+			memset(buf->vaddr, 0, size);
+			goto init;
+		}
+	}
+	mutex_unlock(&conf->lock);
+
 	buf = kzalloc(sizeof *buf, GFP_KERNEL);
 	if (!buf)
 		return ERR_PTR(-ENOMEM);
@@ -55,6 +89,7 @@ static void *vb2_dma_contig_alloc(void *alloc_ctx, unsigned long size)
 	buf->conf = conf;
 	buf->size = size;
 
+init:
 	buf->handler.refcount = &buf->refcount;
 	buf->handler.put = vb2_dma_contig_put;
 	buf->handler.arg = buf;
@@ -68,8 +103,21 @@ static void vb2_dma_contig_put(void *buf_priv)
 {
 	struct vb2_dc_buf *buf = buf_priv;
 
-	if (atomic_dec_and_test(&buf->refcount)) {
-		dma_free_coherent(buf->conf->dev, buf->size, buf->vaddr,
+	struct vb2_dc_conf *conf = buf->conf;
+
+	if (!atomic_dec_and_test(&buf->refcount))
+		return;
+
+	mutex_lock(&conf->lock);
+	if (conf->num_free < recycle) {
+		list_add(&buf->list, &conf->free_bufs);
+		conf->num_free++;
+		buf = NULL;
+	}
+	mutex_unlock(&conf->lock);
+
+	if (buf) {
+		dma_free_coherent(conf->dev, buf->size, buf->vaddr,
 				  buf->dma_addr);
 		kfree(buf);
 	}
@@ -134,10 +182,30 @@ static void *vb2_dma_contig_get_userptr(void *alloc_ctx, unsigned long vaddr,
 	buf->size = size;
 	buf->dma_addr = dma_addr;
 	buf->vma = vma;
+	buf->uaddr = vaddr;
+	buf->cached = vb2_vma_is_cached(vma);
 
 	return buf;
 }
 
+static void vb2_dma_contig_sync_for_device(void *mem_priv)
+{
+	struct vb2_dc_buf *buf = mem_priv;
+
+	if (buf->vma && buf->cached)
+		vb2_sync_contig_userptr(buf->vma, buf->uaddr, buf->dma_addr,
+					buf->size, DMA_TO_DEVICE);
+}
+
+static void vb2_dma_contig_sync_for_cpu(void *mem_priv)
+{
+	struct vb2_dc_buf *buf = mem_priv;
+
+	if (buf->vma && buf->cached)
+		vb2_sync_contig_userptr(buf->vma, buf->uaddr, buf->dma_addr,
+					buf->size, DMA_FROM_DEVICE);
+}
+
 static void vb2_dma_contig_put_userptr(void *mem_priv)
 {
 	struct vb2_dc_buf *buf = mem_priv;
@@ -149,6 +217,101 @@ static void vb2_dma_contig_put_userptr(void *mem_priv)
 	kfree(buf);
 }
 
+static void *vb2_dma_contig_attach_dmabuf(void *alloc_ctx, struct dma_buf *dbuf,
+					  unsigned long size, int write)
+{
+	struct vb2_dc_conf *conf = alloc_ctx;
+	struct vb2_dc_buf *buf;
+	struct dma_buf_attachment *dba;
+
+	if (dbuf->size < size)
+		return ERR_PTR(-EFAULT);
+
+	buf = kzalloc(sizeof *buf, GFP_KERNEL);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+
+	/* create attachment for the dmabuf with the user device */
+	dba = dma_buf_attach(dbuf, conf->dev);
+	if (IS_ERR(dba)) {
+		printk(KERN_ERR "failed to attach dmabuf\n");
+		kfree(buf);
+		return dba;
+	}
+
+	buf->conf = conf;
+	buf->dma_dir = write ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	buf->size = size;
+	buf->db_attach = dba;
+
+	return buf;
+}
+
+static int vb2_dma_contig_map_dmabuf(void *mem_priv)
+{
+	struct vb2_dc_buf *buf = mem_priv;
+	struct sg_table *sgt;
+	struct scatterlist *s;
+	dma_addr_t expected;
+	int i;
+
+	if (WARN_ON(!buf->db_attach))
+		return -EINVAL;
+
+	if (WARN_ON(buf->dma_sgt))
+		return 0;
+
+	/* get the associated scatterlist for this buffer */
+	sgt = dma_buf_map_attachment(buf->db_attach, buf->dma_dir);
+	if (IS_ERR_OR_NULL(sgt)) {
+		printk(KERN_ERR "Error getting dmabuf scatterlist\n");
+		return -EINVAL;
+	}
+
+	/* the DMA engines using this allocator need contiguous memory */
+	expected = sg_dma_address(sgt->sgl);
+	for_each_sg(sgt->sgl, s, sgt->nents, i) {
+		if (sg_dma_address(s) != expected) {
+			printk(KERN_ERR "dmabuf is not contiguous\n");
+			dma_buf_unmap_attachment(buf->db_attach, sgt,
+						 buf->dma_dir);
+			return -EFAULT;
+		}
+		expected += sg_dma_len(s);
+	}
+
+	buf->dma_addr = sg_dma_address(sgt->sgl);
+	buf->dma_sgt = sgt;
+
+	return 0;
+}
+
+static void vb2_dma_contig_unmap_dmabuf(void *mem_priv)
+{
+	struct vb2_dc_buf *buf = mem_priv;
+
+	if (WARN_ON(!buf->db_attach || !buf->dma_sgt))
+		return;
+
+	dma_buf_unmap_attachment(buf->db_attach, buf->dma_sgt, buf->dma_dir);
+
+	buf->dma_addr = 0;
+	buf->dma_sgt = NULL;
+}
+
+static void vb2_dma_contig_detach_dmabuf(void *mem_priv)
+{
+	struct vb2_dc_buf *buf = mem_priv;
+
+	/* if vb2 works correctly you should never detach mapped buffer */
+	if (WARN_ON(buf->dma_sgt))
+		vb2_dma_contig_unmap_dmabuf(buf);
+
+	/* detach this attachment */
+	dma_buf_detach(buf->db_attach->dmabuf, buf->db_attach);
+	kfree(buf);
+}
+
 const struct vb2_mem_ops vb2_dma_contig_memops = {
 	.alloc		= vb2_dma_contig_alloc,
 	.put		= vb2_dma_contig_put,
@@ -157,6 +320,12 @@ const struct vb2_mem_ops vb2_dma_contig_memops = {
 	.mmap		= vb2_dma_contig_mmap,
 	.get_userptr	= vb2_dma_contig_get_userptr,
 	.put_userptr	= vb2_dma_contig_put_userptr,
+	.sync_for_device = vb2_dma_contig_sync_for_device,
+	.sync_for_cpu	= vb2_dma_contig_sync_for_cpu,
+	.attach_dmabuf	= vb2_dma_contig_attach_dmabuf,
+	.detach_dmabuf	= vb2_dma_contig_detach_dmabuf,
+	.map_dmabuf	= vb2_dma_contig_map_dmabuf,
+	.unmap_dmabuf	= vb2_dma_contig_unmap_dmabuf,
 	.num_users	= vb2_dma_contig_num_users,
 };
 EXPORT_SYMBOL_GPL(vb2_dma_contig_memops);
@@ -170,6 +339,8 @@ void *vb2_dma_contig_init_ctx(struct device *dev)
 		return ERR_PTR(-ENOMEM);
 
 	conf->dev = dev;
+	mutex_init(&conf->lock);
+	INIT_LIST_HEAD(&conf->free_bufs);
 
 	return conf;
 }
@@ -177,7 +348,19 @@ EXPORT_SYMBOL_GPL(vb2_dma_contig_init_ctx);
 
 void vb2_dma_contig_cleanup_ctx(void *alloc_ctx)
 {
-	kfree(alloc_ctx);
+	struct vb2_dc_conf *conf = alloc_ctx;
+	struct vb2_dc_buf *buf, *tmp;
+
+	if (IS_ERR_OR_NULL(conf))
+		return;
+
+	list_for_each_entry_safe(buf, tmp, &conf->free_bufs, list) {
+		dma_free_coherent(conf->dev, buf->size, buf->vaddr,
+				  buf->dma_addr);
+		kfree(buf);
+	}
+	mutex_destroy(&conf->lock);
+	kfree(conf);
 }
 EXPORT_SYMBOL_GPL(vb2_dma_contig_cleanup_ctx);
 
@@ -19,6 +19,8 @@
 #include <linux/sched.h>
 #include <linux/file.h>
 
+#include <asm/cacheflush.h>
+
 #include <media/videobuf2-core.h>
 #include <media/videobuf2-memops.h>
 
@@ -136,6 +138,58 @@ int vb2_get_contig_userptr(unsigned long vaddr, unsigned long size,
 }
 EXPORT_SYMBOL_GPL(vb2_get_contig_userptr);
 
+/**
+ * vb2_vma_is_cached() - check whether a userspace mapping is cacheable
+ * @vma:	virtual memory area of the buffer
+ *
+ * Returns false for non-cached and write-combined mappings, which need no
+ * cache maintenance.
+ */
+bool vb2_vma_is_cached(struct vm_area_struct *vma)
+{
+	pgprot_t prot = vma->vm_page_prot;
+
+	return pgprot_val(prot) != pgprot_val(pgprot_noncached(prot)) &&
+	       pgprot_val(prot) != pgprot_val(pgprot_writecombine(prot));
+}
+EXPORT_SYMBOL_GPL(vb2_vma_is_cached);
+
+/**
+ * vb2_sync_contig_userptr() - maintain the cache of contiguous userspace memory
+ * @vma:	locked copy of the vma returned by vb2_get_contig_userptr()
+ * @vaddr:	userspace address of the buffer
+ * @paddr:	physical address of the buffer
+ * @size:	size of the buffer
+ * @dir:	DMA_TO_DEVICE to clean the buffer before the device reads it,
+ *		DMA_FROM_DEVICE to invalidate it after the device wrote it
+ *
+ * Contiguous userspace buffers are usually carved out of the kernel linear
+ * mapping, so the inner cache is maintained through the userspace mapping.
+ * This requires being called in the context of the process owning the
+ * mapping, the whole inner cache is flushed otherwise.
+ */
+void vb2_sync_contig_userptr(struct vm_area_struct *vma, unsigned long vaddr,
+			     dma_addr_t paddr, unsigned long size,
+			     enum dma_data_direction dir)
+{
+#ifdef CONFIG_ARM
+	if (vma->vm_mm != current->mm) {
+		flush_cache_all();
+		outer_flush_range(paddr, paddr + size);
+		return;
+	}
+
+	if (dir == DMA_FROM_DEVICE) {
+		outer_inv_range(paddr, paddr + size);
+		dmac_unmap_area((const void *)vaddr, size, dir);
+	} else {
+		dmac_map_area((const void *)vaddr, size, dir);
+		outer_clean_range(paddr, paddr + size);
+	}
+#endif
+}
+EXPORT_SYMBOL_GPL(vb2_sync_contig_userptr);
+
 /**
  * vb2_mmap_pfn_range() - map physical pages to userspace
  * @vma:	virtual memory region for the mapping
@@ -41,6 +41,9 @@
 #include <linux/irq.h>
 #include <linux/irqdomain.h>
 #include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/regulator/machine.h>
 
@@ -276,6 +279,8 @@ unsigned int twl_rev(void)
 }
 EXPORT_SYMBOL(twl_rev);
 
+#define TWL_CACHE_REGS	256
+
 /* Structure for each TWL4030/TWL6030 Slave */
 struct twl_client {
 	struct i2c_client *client;
@@ -286,6 +291,17 @@ struct twl_client {
 
 	/* To lock access to xfer_msg */
 	struct mutex xfer_lock;
+
+	/*
+	 * Shadow of the registers a driver declared as not changing
+	 * behind its back, see twl_i2c_cache_regs().  Indexed by the
+	 * slave register address and protected by xfer_lock.
+	 */
+	u8 cache[TWL_CACHE_REGS];
+	DECLARE_BITMAP(cacheable, TWL_CACHE_REGS);
+	DECLARE_BITMAP(cache_valid, TWL_CACHE_REGS);
+	unsigned long cache_hits;
+	unsigned long cache_misses;
 };
 
 static struct twl_client twl_modules[TWL_NUM_SLAVES];
@@ -373,6 +389,95 @@ static struct twl_mapping twl6030_map[] = {
 
 /*----------------------------------------------------------------------*/
 
+static struct twl_client *twl_get_client(u8 mod_no)
+{
+	int sid;
+
+	if (unlikely(mod_no > TWL_MODULE_LAST)) {
+		pr_err("%s: invalid module number %d\n", DRIVER_NAME, mod_no);
+		return ERR_PTR(-EPERM);
+	}
+	if (unlikely(!inuse)) {
+		pr_err("%s: not initialized\n", DRIVER_NAME);
+		return ERR_PTR(-EPERM);
+	}
+	sid = twl_map[mod_no].sid;
+	if (unlikely(sid == SUB_CHIP_ID_INVAL)) {
+		pr_err("%s: module %d is not part of the pmic\n",
+		       DRIVER_NAME, mod_no);
+		return ERR_PTR(-EINVAL);
+	}
+	return &twl_modules[sid];
+}
+
+/*
+ * Register shadow helpers, called with xfer_lock held.  A read is served
+ * from the shadow only when every register it covers is cacheable and
+ * has been read or written since it was declared, and a write of the
+ * values the chip already holds is dropped.
+ */
+static bool twl_cache_lookup(struct twl_client *twl, unsigned addr,
+			     u8 *value, unsigned num)
+{
+	unsigned i;
+
+	if (addr + num > TWL_CACHE_REGS)
+		return false;
+
+	for (i = addr; i < addr + num; i++) {
+		if (!test_bit(i, twl->cache_valid)) {
+			if (test_bit(i, twl->cacheable))
+				twl->cache_misses++;
+			return false;
+		}
+	}
+
+	memcpy(value, &twl->cache[addr], num);
+	twl->cache_hits++;
+	return true;
+}
+
+static bool twl_cache_unchanged(struct twl_client *twl, unsigned addr,
+				const u8 *value, unsigned num)
+{
+	unsigned i;
+
+	if (addr + num > TWL_CACHE_REGS)
+		return false;
+
+	for (i = addr; i < addr + num; i++)
+		if (!test_bit(i, twl->cache_valid))
+			return false;
+
+	if (memcmp(&twl->cache[addr], value, num))
+		return false;
+
+	twl->cache_hits++;
+	return true;
+}
+
+static void twl_cache_fill(struct twl_client *twl, unsigned addr,
+			   const u8 *value, unsigned num)
+{
+	unsigned i;
+
+	for (i = 0; i < num && addr + i < TWL_CACHE_REGS; i++) {
+		if (!test_bit(addr + i, twl->cacheable))
+			continue;
+		twl->cache[addr + i] = value[i];
+		set_bit(addr + i, twl->cache_valid);
+	}
+}
+
+static void twl_cache_drop(struct twl_client *twl, unsigned addr,
+			   unsigned num)
+{
+	unsigned i;
+
+	for (i = 0; i < num && addr + i < TWL_CACHE_REGS; i++)
+		clear_bit(addr + i, twl->cache_valid);
+}
+
 /* Exported Functions */
 
 /**
@@ -390,27 +495,22 @@ static struct twl_mapping twl6030_map[] = {
 int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes)
 {
 	int ret;
-	int sid;
 	struct twl_client *twl;
 	struct i2c_msg *msg;
+	unsigned addr;
 
-	if (unlikely(mod_no > TWL_MODULE_LAST)) {
-		pr_err("%s: invalid module number %d\n", DRIVER_NAME, mod_no);
-		return -EPERM;
-	}
-	if (unlikely(!inuse)) {
-		pr_err("%s: not initialized\n", DRIVER_NAME);
-		return -EPERM;
-	}
-	sid = twl_map[mod_no].sid;
-	if (unlikely(sid == SUB_CHIP_ID_INVAL)) {
-		pr_err("%s: module %d is not part of the pmic\n",
-		       DRIVER_NAME, mod_no);
-		return -EINVAL;
-	}
-	twl = &twl_modules[sid];
+	twl = twl_get_client(mod_no);
+	if (IS_ERR(twl))
+		return PTR_ERR(twl);
+	addr = twl_map[mod_no].base + reg;
 
 	mutex_lock(&twl->xfer_lock);
+	/* nothing to do if the chip already holds these values */
+	if (twl_cache_unchanged(twl, addr, value + 1, num_bytes)) {
+		mutex_unlock(&twl->xfer_lock);
+		return 0;
+	}
+
 	/*
 	 * [MSG1]: fill the register address data
 	 * fill the data Tx buffer
@@ -421,8 +521,12 @@ int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes)
 	msg->flags = 0;
 	msg->buf = value;
 	/* over write the first byte of buffer with the register address */
-	*value = twl_map[mod_no].base + reg;
+	*value = addr;
 	ret = i2c_transfer(twl->client->adapter, twl->xfer_msg, 1);
+	if (ret == 1)
+		twl_cache_fill(twl, addr, value + 1, num_bytes);
+	else
+		twl_cache_drop(twl, addr, num_bytes);
 	mutex_unlock(&twl->xfer_lock);
 
 	/* i2c_transfer returns number of messages transferred */
@@ -452,33 +556,27 @@ int twl_i2c_read(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes)
 {
 	int ret;
 	u8 val;
-	int sid;
 	struct twl_client *twl;
 	struct i2c_msg *msg;
+	unsigned addr;
 
-	if (unlikely(mod_no > TWL_MODULE_LAST)) {
-		pr_err("%s: invalid module number %d\n", DRIVER_NAME, mod_no);
-		return -EPERM;
-	}
-	if (unlikely(!inuse)) {
-		pr_err("%s: not initialized\n", DRIVER_NAME);
-		return -EPERM;
-	}
-	sid = twl_map[mod_no].sid;
-	if (unlikely(sid == SUB_CHIP_ID_INVAL)) {
-		pr_err("%s: module %d is not part of the pmic\n",
-		       DRIVER_NAME, mod_no);
-		return -EINVAL;
-	}
-	twl = &twl_modules[sid];
+	twl = twl_get_client(mod_no);
+	if (IS_ERR(twl))
+		return PTR_ERR(twl);
+	addr = twl_map[mod_no].base + reg;
 
 	mutex_lock(&twl->xfer_lock);
+	if (twl_cache_lookup(twl, addr, value, num_bytes)) {
+		mutex_unlock(&twl->xfer_lock);
+		return 0;
+	}
+
 	/* [MSG1] fill the register address data */
 	msg = &twl->xfer_msg[0];
 	msg->addr = twl->address;
 	msg->len = 1;
 	msg->flags = 0;	/* Read the register value */
-	val = twl_map[mod_no].base + reg;
+	val = addr;
 	msg->buf = &val;
 	/* [MSG2] fill the data rx buffer */
 	msg = &twl->xfer_msg[1];
@@ -487,6 +585,8 @@ int twl_i2c_read(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes)
 	msg->len = num_bytes;	/* only n bytes */
 	msg->buf = value;
 	ret = i2c_transfer(twl->client->adapter, twl->xfer_msg, 2);
+	if (ret == 2)
+		twl_cache_fill(twl, addr, value, num_bytes);
 	mutex_unlock(&twl->xfer_lock);
 
 	/* i2c_transfer returns number of messages transferred */
@@ -536,6 +636,117 @@ int twl_i2c_read_u8(u8 mod_no, u8 *value, u8 reg)
 }
 EXPORT_SYMBOL(twl_i2c_read_u8);
 
+/**
+ * twl_i2c_cache_regs - Declare non-volatile registers in TWL4030/TWL60X0
+ * @mod_no: module number
+ * @reg: first register (just offset will do)
+ * @num_regs: number of registers
+ *
+ * The registers must only change when written through twl_i2c_write*():
+ * control and configuration registers owned by the calling driver, not
+ * status or interrupt registers.  Once a register has been read or
+ * written, further reads of it, and writes that would not change it,
+ * complete without an I2C transfer.
+ *
+ * Returns result of operation - 0 is success
+ */
+int twl_i2c_cache_regs(u8 mod_no, u8 reg, unsigned num_regs)
+{
+	struct twl_client *twl;
+	unsigned addr;
+
+	twl = twl_get_client(mod_no);
+	if (IS_ERR(twl))
+		return PTR_ERR(twl);
+	addr = twl_map[mod_no].base + reg;
+	if (addr + num_regs > TWL_CACHE_REGS)
+		return -EINVAL;
+
+	mutex_lock(&twl->xfer_lock);
+	bitmap_set(twl->cacheable, addr, num_regs);
+	mutex_unlock(&twl->xfer_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(twl_i2c_cache_regs);
+
+/**
+ * twl_i2c_cache_invalidate - Forget the shadow of TWL4030/TWL60X0 registers
+ * @mod_no: module number
+ * @reg: first register (just offset will do)
+ * @num_regs: number of registers
+ *
+ * For drivers that know the chip reset some of their cached registers,
+ * e.g. on a watchdog or fault event.  The next read goes to the chip.
+ */
+void twl_i2c_cache_invalidate(u8 mod_no, u8 reg, unsigned num_regs)
+{
+	struct twl_client *twl;
+
+	twl = twl_get_client(mod_no);
+	if (IS_ERR(twl))
+		return;
+
+	mutex_lock(&twl->xfer_lock);
+	twl_cache_drop(twl, twl_map[mod_no].base + reg, num_regs);
+	mutex_unlock(&twl->xfer_lock);
+}
+EXPORT_SYMBOL(twl_i2c_cache_invalidate);
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *twl_debugfs;
+
+static int twl_cache_show(struct seq_file *s, void *unused)
+{
+	unsigned i;
+
+	for (i = 0; i < TWL_NUM_SLAVES; i++) {
+		struct twl_client *twl = &twl_modules[i];
+
+		if (!twl->client)
+			continue;
+
+		mutex_lock(&twl->xfer_lock);
+		seq_printf(s, "0x%02x: %d regs, %d valid, ",
+			   twl->address,
+			   bitmap_weight(twl->cacheable, TWL_CACHE_REGS),
+			   bitmap_weight(twl->cache_valid, TWL_CACHE_REGS));
+		seq_printf(s, "%lu hits, %lu misses\n",
+			   twl->cache_hits, twl->cache_misses);
+		mutex_unlock(&twl->xfer_lock);
+	}
+
+	return 0;
+}
+
+static int twl_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, twl_cache_show, inode->i_private);
+}
+
+static const struct file_operations twl_cache_fops = {
+	.open		= twl_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void twl_debugfs_init(void)
+{
+	twl_debugfs = debugfs_create_file("twl_i2c_cache", S_IRUGO, NULL,
+					  NULL, &twl_cache_fops);
+}
+
+static void twl_debugfs_exit(void)
+{
+	debugfs_remove(twl_debugfs);
+	twl_debugfs = NULL;
+}
+#else
+static inline void twl_debugfs_init(void) { }
+static inline void twl_debugfs_exit(void) { }
+#endif
+
 /*----------------------------------------------------------------------*/
 
 /**
@@ -1374,7 +1585,10 @@ static int twl_remove(struct i2c_client *client)
 		if (twl->client && twl->client != client)
 			i2c_unregister_device(twl->client);
 		twl_modules[i].client = NULL;
+		bitmap_zero(twl->cacheable, TWL_CACHE_REGS);
+		bitmap_zero(twl->cache_valid, TWL_CACHE_REGS);
 	}
+	twl_debugfs_exit();
 	inuse = false;
 	return 0;
 }
@@ -1521,6 +1735,7 @@ twl_probe(struct i2c_client *client, const struct i2c_device_id *id)
 	}
 
 	inuse = true;
+	twl_debugfs_init();
 
 	/* setup clock framework */
 	if (twl_class_is_4030())
@@ -1367,6 +1367,13 @@ static int __devinit twl6030_gpadc_probe(struct platform_device *pdev)
 	}
 	the_gpadc = gpadc;
 
+	/*
+	 * The RT channel selection is rewritten before every conversion,
+	 * usually with the value it already has.
+	 */
+	twl_i2c_cache_regs(TWL_MODULE_MADC,
+			   twl6030_conversion_methods[TWL6030_GPADC_RT].sel, 3);
+
 	ret = sysfs_create_group(&pdev->dev.kobj, &twl6030_gpadc_group);
 	if (ret)
 		dev_err(&pdev->dev, "could not create sysfs files\n");
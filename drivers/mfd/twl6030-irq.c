@@ -41,6 +41,11 @@
 #include <linux/suspend.h>
 #include <linux/of.h>
 #include <linux/irqdomain.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "twl-core.h"
 
@@ -123,6 +128,35 @@ static bool twl_irq_wake_enabled;
 
 static atomic_t twl6030_wakeirqs = ATOMIC_INIT(0);
 
+/*
+ * INT_MSK_LINE_A..C and INT_MSK_STS_A..C are cached, indexed from
+ * REG_INT_MSK_LINE_A.  twl6030_mask_cache holds the bits masked through
+ * twl6030_interrupt_mask(); on top of that the irq_chip masks the line of
+ * the bits no enabled module IRQ uses (twl6030_chip_enabled, bit n is
+ * module IRQ n).  Registers are only written when their value changes, and
+ * the irq_chip changes are written in one burst from irq_bus_sync_unlock().
+ */
+#define TWL6030_NR_MASK_REGS	6
+
+static DEFINE_MUTEX(twl6030_mask_lock);
+static u8 twl6030_mask_cache[TWL6030_NR_MASK_REGS];
+static u8 twl6030_mask_hw[TWL6030_NR_MASK_REGS];
+static u32 twl6030_chip_enabled;
+static u32 twl6030_module_bits[TWL6030_NR_IRQS];
+
+/* Service time of the PIH thread, and events and wakeups per module */
+static struct {
+	unsigned long	runs;
+	u64		time_ns;
+	u64		time_max_ns;
+	unsigned long	events[TWL6030_NR_IRQS];
+	unsigned long	wakeups[TWL6030_NR_IRQS];
+} twl6030_irq_stats;
+
+/* set on resume, the next PIH interrupt is taken as the wakeup source */
+static bool twl6030_wake_check;
+static unsigned long twl6030_resume_jiffies;
+
 static int twl6030_irq_pm_notifier(struct notifier_block *notifier,
 				   unsigned long pm_event, void *unused)
 {
@@ -146,6 +180,8 @@ static int twl6030_irq_pm_notifier(struct notifier_block *notifier,
 		break;
 
 	case PM_POST_SUSPEND:
+		twl6030_resume_jiffies = jiffies;
+		twl6030_wake_check = true;
 		enable_irq(twl_irq);
 		break;
 
@@ -173,6 +209,15 @@ static irqreturn_t twl6030_irq_thread(int irq, void *devid)
 		u8 bytes[4];
 		u32 int_sts;
 	} sts;
+	bool wakeup = false;
+	ktime_t start = ktime_get();
+	s64 ns;
+
+	/* a PIH interrupt within a second of resume is what woke us up */
+	if (twl6030_wake_check) {
+		twl6030_wake_check = false;
+		wakeup = time_before(jiffies, twl6030_resume_jiffies + HZ);
+	}
 
 	/* read INT_STS_A, B and C in one shot using a burst read */
 	ret = twl_i2c_read(TWL_MODULE_PIH, sts.bytes,
@@ -194,8 +239,13 @@ static irqreturn_t twl6030_irq_thread(int irq, void *devid)
 
 	for (i = 0; sts.int_sts; sts.int_sts >>= 1, i++)
 		if (sts.int_sts & 0x1) {
-			int module_irq = twl6030_irq_base +
-					twl6030_interrupt_mapping[i];
+			int module = twl6030_interrupt_mapping[i];
+			int module_irq = twl6030_irq_base + module;
+
+			twl6030_irq_stats.events[module]++;
+			if (wakeup &&
+			    irqd_is_wakeup_set(irq_get_irq_data(module_irq)))
+				twl6030_irq_stats.wakeups[module]++;
 			handle_nested_irq(module_irq);
 		}
 
@@ -212,6 +262,12 @@ static irqreturn_t twl6030_irq_thread(int irq, void *devid)
 	if (ret)
 		pr_warning("twl6030: I2C error in clearing PIH ISR\n");
 
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	twl6030_irq_stats.runs++;
+	twl6030_irq_stats.time_ns += ns;
+	if (ns > twl6030_irq_stats.time_max_ns)
+		twl6030_irq_stats.time_max_ns = ns;
+
 	return IRQ_HANDLED;
 }
 
@@ -240,32 +296,108 @@ static int twl6030_irq_set_wake(struct irq_data *d, unsigned int on)
 	return 0;
 }
 
-int twl6030_interrupt_unmask(u8 bit_mask, u8 offset)
+/* Value of mask register @i, including what the irq_chip masks */
+static u8 twl6030_mask_value(int i)
 {
+	u32 used = 0;
+	int m;
+
+	if (i >= 3)
+		return twl6030_mask_cache[i];
+
+	for (m = 0; m < TWL6030_NR_IRQS; m++)
+		if (twl6030_chip_enabled & BIT(m))
+			used |= twl6030_module_bits[m];
+	return twl6030_mask_cache[i] | (~used >> (8 * i));
+}
+
+/* Called with twl6030_mask_lock */
+static int twl6030_mask_sync(int i)
+{
+	u8 val = twl6030_mask_value(i);
 	int ret;
-	u8 unmask_value;
-	ret = twl_i2c_read_u8(TWL_MODULE_PIH, &unmask_value,
-			REG_INT_STS_A + offset);
-	unmask_value &= (~(bit_mask));
-	ret |= twl_i2c_write_u8(TWL_MODULE_PIH, unmask_value,
-			REG_INT_STS_A + offset); /* unmask INT_MSK_A/B/C */
+
+	if (val == twl6030_mask_hw[i])
+		return 0;
+
+	ret = twl_i2c_write_u8(TWL_MODULE_PIH, val, REG_INT_MSK_LINE_A + i);
+	if (!ret)
+		twl6030_mask_hw[i] = val;
 	return ret;
 }
-EXPORT_SYMBOL(twl6030_interrupt_unmask);
 
-int twl6030_interrupt_mask(u8 bit_mask, u8 offset)
+static int twl6030_interrupt_update(u8 bit_mask, u8 offset, bool mask)
 {
+	int i = offset - REG_INT_MSK_LINE_A;
 	int ret;
-	u8 mask_value;
-	ret = twl_i2c_read_u8(TWL_MODULE_PIH, &mask_value,
-			REG_INT_STS_A + offset);
-	mask_value |= (bit_mask);
-	ret |= twl_i2c_write_u8(TWL_MODULE_PIH, mask_value,
-			REG_INT_STS_A + offset); /* mask INT_MSK_A/B/C */
+
+	if (offset < REG_INT_MSK_LINE_A || i >= TWL6030_NR_MASK_REGS)
+		return -EINVAL;
+
+	mutex_lock(&twl6030_mask_lock);
+	if (mask)
+		twl6030_mask_cache[i] |= bit_mask;
+	else
+		twl6030_mask_cache[i] &= ~bit_mask;
+	ret = twl6030_mask_sync(i);
+	mutex_unlock(&twl6030_mask_lock);
+
 	return ret;
 }
+
+int twl6030_interrupt_unmask(u8 bit_mask, u8 offset)
+{
+	return twl6030_interrupt_update(bit_mask, offset, false);
+}
+EXPORT_SYMBOL(twl6030_interrupt_unmask);
+
+int twl6030_interrupt_mask(u8 bit_mask, u8 offset)
+{
+	return twl6030_interrupt_update(bit_mask, offset, true);
+}
 EXPORT_SYMBOL(twl6030_interrupt_mask);
 
+/*
+ * irq_chip mask/unmask only update twl6030_chip_enabled, under the bus
+ * lock taken by the genirq core; the line masks are written when it is
+ * released.
+ */
+static void twl6030_irq_mask(struct irq_data *d)
+{
+	twl6030_chip_enabled &= ~BIT(d->irq - twl6030_irq_base);
+}
+
+static void twl6030_irq_unmask(struct irq_data *d)
+{
+	twl6030_chip_enabled |= BIT(d->irq - twl6030_irq_base);
+}
+
+static void twl6030_irq_bus_lock(struct irq_data *d)
+{
+	mutex_lock(&twl6030_mask_lock);
+}
+
+static void twl6030_irq_bus_sync_unlock(struct irq_data *d)
+{
+	u8 line[4];
+	int i, ret;
+
+	for (i = 0; i < 3; i++)
+		line[i + 1] = twl6030_mask_value(i);
+
+	if (memcmp(&line[1], twl6030_mask_hw, 3)) {
+		ret = twl_i2c_write(TWL_MODULE_PIH, line,
+				    REG_INT_MSK_LINE_A, 3);
+		if (ret)
+			pr_warning("twl6030: I2C error %d writing line masks\n",
+				   ret);
+		else
+			memcpy(twl6030_mask_hw, &line[1], 3);
+	}
+
+	mutex_unlock(&twl6030_mask_lock);
+}
+
 int twl6030_mmc_card_detect_config(void)
 {
 	int ret;
@@ -347,6 +479,57 @@ int twl6030_mmc_card_detect(struct device *dev, int slot)
 }
 EXPORT_SYMBOL(twl6030_mmc_card_detect);
 
+#ifdef CONFIG_DEBUG_FS
+static int twl6030_irq_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "runs %lu\navg_us %llu\nmax_us %llu\n",
+		   twl6030_irq_stats.runs,
+		   twl6030_irq_stats.runs ?
+		   div_u64(div_u64(twl6030_irq_stats.time_ns,
+				   twl6030_irq_stats.runs), NSEC_PER_USEC) : 0,
+		   div_u64(twl6030_irq_stats.time_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "irq   events     wakeups\n");
+	for (i = 0; i < TWL6030_NR_IRQS; i++)
+		if (twl6030_irq_stats.events[i])
+			seq_printf(s, "%-5d %-10lu %lu\n", twl6030_irq_base + i,
+				   twl6030_irq_stats.events[i],
+				   twl6030_irq_stats.wakeups[i]);
+
+	return 0;
+}
+
+static int twl6030_irq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, twl6030_irq_stats_show, inode->i_private);
+}
+
+static const struct file_operations twl6030_irq_stats_fops = {
+	.open = twl6030_irq_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *twl6030_irq_debugfs;
+
+static void twl6030_irq_debugfs_init(void)
+{
+	twl6030_irq_debugfs = debugfs_create_file("twl6030_irq", S_IRUGO,
+						  NULL, NULL,
+						  &twl6030_irq_stats_fops);
+}
+
+static void twl6030_irq_debugfs_exit(void)
+{
+	debugfs_remove(twl6030_irq_debugfs);
+}
+#else
+static inline void twl6030_irq_debugfs_init(void) { }
+static inline void twl6030_irq_debugfs_exit(void) { }
+#endif
+
 int twl6030_init_irq(struct device *dev, int irq_num, unsigned long features)
 {
 	struct			device_node *node = dev->of_node;
@@ -376,6 +559,11 @@ int twl6030_init_irq(struct device *dev, int irq_num, unsigned long features)
 	mask[2] = 0xFF;
 	mask[3] = 0xFF;
 
+	for (i = 0; i < 24; i++)
+		twl6030_module_bits[twl6030_interrupt_mapping[i]] |= BIT(i);
+	/* VBUS is also reported through the CHRG_CTRL bit, see above */
+	twl6030_module_bits[USB_PRES_INTR_OFFSET] |= BIT(20);
+
 	/* mask all int lines */
 	status = twl_i2c_write(TWL_MODULE_PIH, mask, REG_INT_MSK_LINE_A, 3);
 	/* mask all int sts */
@@ -386,6 +574,10 @@ int twl6030_init_irq(struct device *dev, int irq_num, unsigned long features)
 		dev_err(dev, "I2C err writing TWL_MODULE_PIH: %d\n", status);
 		return status;
 	}
+	memset(twl6030_mask_cache, 0xff, sizeof(twl6030_mask_cache));
+	memset(twl6030_mask_hw, 0xff, sizeof(twl6030_mask_hw));
+	/* module IRQs start disabled */
+	twl6030_chip_enabled = 0;
 
 	twl6030_irq_base = irq_base;
 	twl6030_irq_end = irq_end;
@@ -398,6 +590,11 @@ int twl6030_init_irq(struct device *dev, int irq_num, unsigned long features)
 	twl6030_irq_chip.name = "twl6030";
 	twl6030_irq_chip.irq_set_type = NULL;
 	twl6030_irq_chip.irq_set_wake = twl6030_irq_set_wake;
+	twl6030_irq_chip.irq_mask = twl6030_irq_mask;
+	twl6030_irq_chip.irq_disable = twl6030_irq_mask;
+	twl6030_irq_chip.irq_unmask = twl6030_irq_unmask;
+	twl6030_irq_chip.irq_bus_lock = twl6030_irq_bus_lock;
+	twl6030_irq_chip.irq_bus_sync_unlock = twl6030_irq_bus_sync_unlock;
 
 	for (i = irq_base; i < irq_end; i++) {
 		irq_set_chip_and_handler(i, &twl6030_irq_chip,
@@ -419,6 +616,7 @@ int twl6030_init_irq(struct device *dev, int irq_num, unsigned long features)
 
 	twl_irq = irq_num;
 	register_pm_notifier(&twl6030_irq_pm_notifier_block);
+	twl6030_irq_debugfs_init();
 	return irq_base;
 
 fail_irq:
@@ -433,6 +631,7 @@ int twl6030_exit_irq(void)
 	int	i;
 
 	unregister_pm_notifier(&twl6030_irq_pm_notifier_block);
+	twl6030_irq_debugfs_exit();
 
 	if (!twl6030_irq_base) {
 		pr_err("twl6030: can't yet clean up IRQs?\n");
@@ -137,6 +137,9 @@ struct pwm_device *pwm_request(int pwm_id, const char *label)
 	pwm->label = label;
 	pwm->pwm_id = pwm_id;
 
+	/* Both control registers are only ever changed by this driver */
+	twl_i2c_cache_regs(TWL6030_MODULE_ID1, LED_PWM_CTRL1, 2);
+
 	/* Configure PWM */
 	val = PWM_CTRL2_DIS_PD | PWM_CTRL2_CURR_02 | PWM_CTRL2_SRC_VAC |
 		PWM_CTRL2_MODE_HW;
@@ -41,6 +41,41 @@
 #define VIBRACTRL_MEMBER(reg) ((reg == TWL6040_REG_VIBCTLL) ? 0 : 1)
 #define TWL6040_NUM_SUPPLIES	(2)
 
+static bool twl6040_readable_reg(struct device *dev, unsigned int reg)
+{
+	/* Register 0 is not readable */
+	if (!reg)
+		return false;
+	return true;
+}
+
+static bool twl6040_volatile_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case TWL6040_REG_INTID:
+	case TWL6040_REG_STATUS:
+	/* changed by the power sequencer on AUDPWRON transitions */
+	case TWL6040_REG_NCPCTL:
+	case TWL6040_REG_LDOCTL:
+	case TWL6040_REG_HPPLLCTL:
+	case TWL6040_REG_LPPLLCTL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static struct regmap_config twl6040_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.max_register = TWL6040_REG_STATUS, /* 0x2e */
+
+	.readable_reg = twl6040_readable_reg,
+	.volatile_reg = twl6040_volatile_reg,
+
+	.cache_type = REGCACHE_RBTREE,
+};
+
 int twl6040_reg_read(struct twl6040 *twl6040, unsigned int reg)
 {
 	int ret;
@@ -79,6 +114,28 @@ int twl6040_reg_write(struct twl6040 *twl6040, unsigned int reg, u8 val)
 }
 EXPORT_SYMBOL(twl6040_reg_write);
 
+/*
+ * Write count adjacent registers starting at reg in a single I2C
+ * transfer.  The register cache is updated as for twl6040_reg_write().
+ */
+int twl6040_reg_bulk_write(struct twl6040 *twl6040, unsigned int reg,
+			   const u8 *val, size_t count)
+{
+	unsigned int i;
+	int ret;
+
+	mutex_lock(&twl6040->io_mutex);
+	ret = regmap_raw_write(twl6040->regmap, reg, val, count);
+	for (i = reg; i < reg + count; i++)
+		if (i == TWL6040_REG_VIBCTLL || i == TWL6040_REG_VIBCTLR)
+			twl6040->vibra_ctrl_cache[VIBRACTRL_MEMBER(i)] =
+				val[i - reg];
+	mutex_unlock(&twl6040->io_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(twl6040_reg_bulk_write);
+
 int twl6040_set_bits(struct twl6040 *twl6040, unsigned int reg, u8 mask)
 {
 	int ret;
@@ -397,6 +454,14 @@ int twl6040_power(struct twl6040 *twl6040, int on)
 			twl6040_power_down(twl6040);
 		}
 
+		/*
+		 * The registers in the VDD domain are back to their reset
+		 * values, drop the cache rather than trust it.
+		 */
+		mutex_lock(&twl6040->io_mutex);
+		regmap_reinit_cache(twl6040->regmap, &twl6040_regmap_config);
+		mutex_unlock(&twl6040->io_mutex);
+
 		/* disable current PLL's reference clock */
 		twl6040_set_pll_input(twl6040, twl6040->pll, 0);
 
@@ -636,22 +701,6 @@ static void twl6040_fill_codec_resources(struct twl6040 *twl6040)
 	twl6040_codec_rsrc[2].end = base + TWL6040_IRQ_HF;
 }
 
-static bool twl6040_readable_reg(struct device *dev, unsigned int reg)
-{
-	/* Register 0 is not readable */
-	if (!reg)
-		return false;
-	return true;
-}
-
-static struct regmap_config twl6040_regmap_config = {
-	.reg_bits = 8,
-	.val_bits = 8,
-	.max_register = TWL6040_REG_STATUS, /* 0x2e */
-
-	.readable_reg = twl6040_readable_reg,
-};
-
 static int __devinit twl6040_probe(struct i2c_client *client,
 				     const struct i2c_device_id *id)
 {
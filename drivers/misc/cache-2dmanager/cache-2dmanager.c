@@ -23,18 +23,63 @@ static void per_cpu_cache_flush_arm(void *arg)
 	flush_cache_all();
 }
 
+/*
+ * Bytes of cache a set of regions covers: a line that is not a multiple
+ * of the cache line size still costs whole cache lines.
+ */
+static unsigned long c2dm_footprint(int count, struct c2dmrgn rgns[])
+{
+	unsigned long size = 0;
+	int rgn;
+
+	for (rgn = 0; rgn < count; rgn++)
+		size += ALIGN(rgns[rgn].span, L1_CACHE_BYTES) *
+			rgns[rgn].lines;
+
+	return size;
+}
+
+/*
+ * A region whose lines follow each other without a gap can be maintained
+ * as a single range.  Clean and flush may also bridge gaps smaller than
+ * a cache line, since the lines in between are only written back; an
+ * invalidate must not touch bytes outside the region.
+ */
+static bool c2dm_contiguous(struct c2dmrgn *rgn, int dir)
+{
+	size_t gap;
+
+	if (rgn->lines <= 1)
+		return true;
+	if (rgn->stride < 0 || (size_t)rgn->stride < rgn->span)
+		return false;
+
+	gap = rgn->stride - rgn->span;
+	return !gap || (dir != DMA_FROM_DEVICE && gap < L1_CACHE_BYTES);
+}
+
+static void c2dm_l1range(char *start, size_t size, int dir)
+{
+	if (dir == DMA_BIDIRECTIONAL)
+		cpu_cache.dma_flush_range(start, start + size);
+	else
+		cpu_cache.dma_map_area(start, size, dir);
+}
+
 void c2dm_l1cache(int count,		/* number of regions */
 		struct c2dmrgn rgns[],	/* array of regions */
 		int dir)		/* cache operation */
 {
-	unsigned long size = 0;
 	int rgn;
-	for (rgn = 0; rgn < count; rgn++)
-		size += rgns[rgn].span * rgns[rgn].lines;
 
 	/* If the total size of the caller's request exceeds the threshold,
 	 * we can perform the operation on the entire cache instead.
 	 *
+	 * Operations by address are broadcast to the other cores by the
+	 * hardware, while the whole cache can only be flushed by set/way on
+	 * each core in turn through an IPI.  The break-even point therefore
+	 * grows with the number of cores that have to take part.
+	 *
 	 * If the caller requests a clean larger than the threshold, we want
 	 * to clean all.  But this function does not exist in the L1 cache
 	 * routines. So we use flush all.
@@ -45,7 +90,8 @@ void c2dm_l1cache(int count,		/* number of regions */
 	 * can be catastrophic.  So we must clean the entire cache before we
 	 * invalidate it. Flush all cleans and invalidates in one operation.
 	 */
-	if (size >= L1THRESHOLD) {
+	if (c2dm_footprint(count, rgns) >=
+	    L1THRESHOLD * num_online_cpus()) {
 		switch (dir) {
 		case DMA_TO_DEVICE:
 			/* Use clean all when available */
@@ -57,23 +103,29 @@ void c2dm_l1cache(int count,		/* number of regions */
 			on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
 			break;
 		}
-	} else {
-		int rgn;
-		for (rgn = 0; rgn < count; rgn++) {
-			int line;
-			char *start = rgns[rgn].start;
-			for (line = 0; line < rgns[rgn].lines; line++) {
-				if (dir == DMA_BIDIRECTIONAL)
-					cpu_cache.dma_flush_range(
-						start,
-						start + rgns[rgn].span);
-				else
-					cpu_cache.dma_map_area(
-						start,
-						rgns[rgn].span,
-						dir);
-				start += rgns[rgn].stride;
-			}
+		return;
+	}
+
+	for (rgn = 0; rgn < count; rgn++) {
+		int line;
+		char *start = rgns[rgn].start;
+
+		if (!rgns[rgn].lines)
+			continue;
+
+		if (c2dm_contiguous(&rgns[rgn], dir)) {
+			size_t size = rgns[rgn].span;
+
+			if (rgns[rgn].lines > 1)
+				size += rgns[rgn].stride *
+					(rgns[rgn].lines - 1);
+			c2dm_l1range(start, size, dir);
+			continue;
+		}
+
+		for (line = 0; line < rgns[rgn].lines; line++) {
+			c2dm_l1range(start, rgns[rgn].span, dir);
+			start += rgns[rgn].stride;
 		}
 	}
 }
@@ -99,18 +151,58 @@ static u32 virt2phys(u32 usr)
 	return 0;
 }
 
+/*
+ * Physically contiguous pieces of a region are collected here and handed
+ * to the outer cache as one range, so that a surface in contiguous
+ * memory costs one range operation and one cache sync rather than one
+ * per line and page.
+ */
+struct c2dm_l2batch {
+	unsigned long start;
+	unsigned long end;
+	int dir;
+};
+
+static void c2dm_l2flush(struct c2dm_l2batch *b)
+{
+	if (b->start == b->end)
+		return;
+
+	switch (b->dir) {
+	case DMA_TO_DEVICE:
+		outer_clean_range(b->start, b->end);
+		break;
+	case DMA_FROM_DEVICE:
+		outer_inv_range(b->start, b->end);
+		break;
+	case DMA_BIDIRECTIONAL:
+		outer_flush_range(b->start, b->end);
+		break;
+	}
+	b->start = b->end = 0;
+}
+
+static void c2dm_l2add(struct c2dm_l2batch *b, unsigned long phys,
+		       unsigned long size)
+{
+	if (b->start != b->end && phys == b->end) {
+		b->end += size;
+		return;
+	}
+
+	c2dm_l2flush(b);
+	b->start = phys;
+	b->end = phys + size;
+}
+
 void c2dm_l2cache(int count,		/* number of regions */
 		struct c2dmrgn rgns[],	/* array of regions */
 		int dir)		/* cache operation */
 {
-
-	unsigned long size = 0;
+	struct c2dm_l2batch batch = { .dir = dir };
 	int rgn;
 
-	for (rgn = 0; rgn < count; rgn++)
-		size += rgns[rgn].span * rgns[rgn].lines;
-
-	if (size >= L2THRESHOLD) {
+	if (c2dm_footprint(count, rgns) >= L2THRESHOLD) {
 		switch (dir) {
 		case DMA_TO_DEVICE:
 			/* Use clean all when available */
@@ -131,21 +223,31 @@ void c2dm_l2cache(int count,		/* number of regions */
 		unsigned long page_begin, end, offset,
 			pageremain, lineremain;
 		unsigned long phys, opsize;
+		size_t span, lines;
+		long stride;
 		int page_num;
 
 		/* beginning virtual address of each line */
 		start = (unsigned long)rgns[rgn].start;
+		span = rgns[rgn].span;
+		lines = rgns[rgn].lines;
+		stride = rgns[rgn].stride;
 
-		for (i = 0; i < rgns[rgn].lines; i++) {
+		/* walk a dense region as a single line */
+		if (lines > 1 && c2dm_contiguous(&rgns[rgn], dir)) {
+			span += stride * (lines - 1);
+			lines = 1;
+		}
+
+		for (i = 0; i < lines; i++) {
 
-			linestart = start + (i * rgns[rgn].stride);
+			linestart = start + (i * stride);
 
 			/* beginning of the page for the new line */
 			page_begin = linestart & PAGE_MASK;
 
 			/* end of the new line */
-			end = (unsigned long)linestart +
-				rgns[rgn].span;
+			end = (unsigned long)linestart + span;
 
 			page_num = DIV_ROUND_UP(
 				end-page_begin, PAGE_SIZE);
@@ -159,7 +261,7 @@ void c2dm_l2cache(int count,		/* number of regions */
 
 			/* keep track of how much of the line remains
 			   to be copied */
-			lineremain = rgns[rgn].span;
+			lineremain = span;
 
 			for (j = 0; j < page_num; j++) {
 
@@ -167,23 +269,9 @@ void c2dm_l2cache(int count,		/* number of regions */
 					lineremain : pageremain;
 
 				phys = virt2phys(page_begin);
-				if (phys) {
-					phys = phys + offset;
-					switch (dir) {
-					case DMA_TO_DEVICE:
-						outer_clean_range(
-							phys, phys + opsize);
-						break;
-					case DMA_FROM_DEVICE:
-						outer_inv_range(
-							phys, phys + opsize);
-						break;
-					case DMA_BIDIRECTIONAL:
-						outer_flush_range(
-							phys, phys + opsize);
-						break;
-					}
-				}
+				if (phys)
+					c2dm_l2add(&batch, phys + offset,
+						   opsize);
 
 				lineremain -= opsize;
 				/* Move to next page */
@@ -204,5 +292,23 @@ void c2dm_l2cache(int count,		/* number of regions */
 			}
 		}
 	}
+	c2dm_l2flush(&batch);
 }
 EXPORT_SYMBOL(c2dm_l2cache);
+
+void c2dm_cache(int count, struct c2dmrgn rgns[], int dir)
+{
+	switch (dir) {
+	case DMA_FROM_DEVICE:
+		c2dm_l2cache(count, rgns, dir);
+		c2dm_l1cache(count, rgns, dir);
+		break;
+
+	case DMA_TO_DEVICE:
+	case DMA_BIDIRECTIONAL:
+		c2dm_l1cache(count, rgns, dir);
+		c2dm_l2cache(count, rgns, dir);
+		break;
+	}
+}
+EXPORT_SYMBOL(c2dm_cache);
@@ -26,7 +26,14 @@
 #include <misc/jedec_ddr.h>
 #include <linux/notifier.h>
 #include <linux/pm.h>
+#include <linux/perf_event.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/clk.h>
 #include <mach/common.h>
+#include <plat/cpu.h>
 #include "emif.h"
 
 /**
@@ -52,6 +59,24 @@
  *				frequency in effect at the moment)
  * @plat_data:			Pointer to saved platform data.
  * @debugfs_root:		dentry to the root folder for EMIF in debugfs
+ * @pmu:			perf PMU for the two performance counters
+ * @pmu_name:			name @pmu is registered under
+ * @pmu_events:			events currently using each counter
+ * @pmu_hrtimer:		folds the counters into the perf counts before
+ *				they can wrap
+ * @temp_band:			temperature band whose timings are programmed
+ * @temp_band_changes:		number of times @temp_band changed
+ * @lp_load:			which low-power entry timeout is in use
+ * @lp_since:			jiffies when @lp_load was last changed
+ * @lp_time:			jiffies spent with each timeout in use
+ * @lp_switches:		number of changes of @lp_load after sampling
+ * @lp_util:			data bus utilisation of the last sample, in
+ *				per mille
+ * @lp_sampling:		counter 2 is set up for data bus cycles and
+ *				@lp_last_* hold a baseline
+ * @lp_last_time:		time counter at the last sample
+ * @lp_last_active:		data bus active counter at the last sample
+ * @lp_work:			samples the counters every EMIF_LP_SAMPLE_MS
  */
 struct emif_data {
 	u8				duplicate;
@@ -66,6 +91,23 @@ struct emif_data {
 	struct emif_regs		*curr_regs;
 	struct emif_platform_data	*plat_data;
 	struct dentry			*debugfs_root;
+#ifdef CONFIG_PERF_EVENTS
+	struct pmu			pmu;
+	char				pmu_name[8];
+	struct perf_event		*pmu_events[2];
+	struct hrtimer			pmu_hrtimer;
+#endif
+	enum emif_temp_band		temp_band;
+	unsigned long			temp_band_changes;
+	enum emif_lp_load		lp_load;
+	unsigned long			lp_since;
+	unsigned long			lp_time[EMIF_LP_LOADS];
+	unsigned long			lp_switches;
+	u32				lp_util;
+	bool				lp_sampling;
+	u32				lp_last_time;
+	u32				lp_last_active;
+	struct delayed_work		lp_work;
 };
 
 static struct emif_data *emif1;
@@ -74,6 +116,29 @@ static unsigned long	irq_state;
 static u32		t_ck; /* DDR clock period in ps */
 static LIST_HEAD(device_list);
 
+/* time the shadow registers take from pre-change to FREQ_UPDATE done */
+static ktime_t		dvfs_start;
+static unsigned long	dvfs_count;
+static s64		dvfs_last_ns;
+static s64		dvfs_max_ns;
+
+static bool adaptive_lp = true;
+module_param(adaptive_lp, bool, 0644);
+MODULE_PARM_DESC(adaptive_lp,
+	"Pick the low-power entry timeout from the measured DDR load");
+
+static const char * const emif_temp_band_names[EMIF_TEMP_BANDS] = {
+	[EMIF_TEMP_BAND_NOMINAL]	= "nominal",
+	[EMIF_TEMP_BAND_DERATE_REFRESH]	= "derated refresh",
+	[EMIF_TEMP_BAND_DERATE_TIMINGS]	= "derated refresh and timings",
+};
+
+static const char * const emif_lp_load_names[EMIF_LP_LOADS] = {
+	[EMIF_LP_LOAD_BY_FREQ]	= "by frequency",
+	[EMIF_LP_LOAD_IDLE]	= "idle",
+	[EMIF_LP_LOAD_BUSY]	= "busy",
+};
+
 static void do_emif_regdump_show(struct seq_file *s, struct emif_data *emif,
 	struct emif_regs *regs)
 {
@@ -83,10 +148,17 @@ static void do_emif_regdump_show(struct seq_file *s, struct emif_data *emif,
 	seq_printf(s, "EMIF register cache dump for %dMHz\n",
 		regs->freq/1000000);
 
-	seq_printf(s, "ref_ctrl_shdw\t: 0x%08x\n", regs->ref_ctrl_shdw);
-	seq_printf(s, "sdram_tim1_shdw\t: 0x%08x\n", regs->sdram_tim1_shdw);
+	seq_printf(s, "ref_ctrl_shdw\t: 0x%08x\n",
+		regs->temp[EMIF_TEMP_BAND_NOMINAL].ref_ctrl_shdw);
+	seq_printf(s, "sdram_tim1_shdw\t: 0x%08x\n",
+		regs->temp[EMIF_TEMP_BAND_NOMINAL].sdram_tim1_shdw);
 	seq_printf(s, "sdram_tim2_shdw\t: 0x%08x\n", regs->sdram_tim2_shdw);
-	seq_printf(s, "sdram_tim3_shdw\t: 0x%08x\n", regs->sdram_tim3_shdw);
+	seq_printf(s, "sdram_tim3_shdw\t: 0x%08x\n",
+		regs->temp[EMIF_TEMP_BAND_NOMINAL].sdram_tim3_shdw);
+	seq_printf(s, "pwr_mgmt_ctrl_shdw\t: 0x%08x idle 0x%08x busy 0x%08x\n",
+		regs->pwr_mgmt_ctrl_shdw[EMIF_LP_LOAD_BY_FREQ],
+		regs->pwr_mgmt_ctrl_shdw[EMIF_LP_LOAD_IDLE],
+		regs->pwr_mgmt_ctrl_shdw[EMIF_LP_LOAD_BUSY]);
 
 	if (ip_rev == EMIF_4D) {
 		seq_printf(s, "read_idle_ctrl_shdw_normal\t: 0x%08x\n",
@@ -102,11 +174,11 @@ static void do_emif_regdump_show(struct seq_file *s, struct emif_data *emif,
 
 	if (type == DDR_TYPE_LPDDR2_S2 || type == DDR_TYPE_LPDDR2_S4) {
 		seq_printf(s, "ref_ctrl_shdw_derated\t: 0x%08x\n",
-			regs->ref_ctrl_shdw_derated);
+			regs->temp[EMIF_TEMP_BAND_DERATE_REFRESH].ref_ctrl_shdw);
 		seq_printf(s, "sdram_tim1_shdw_derated\t: 0x%08x\n",
-			regs->sdram_tim1_shdw_derated);
+			regs->temp[EMIF_TEMP_BAND_DERATE_TIMINGS].sdram_tim1_shdw);
 		seq_printf(s, "sdram_tim3_shdw_derated\t: 0x%08x\n",
-			regs->sdram_tim3_shdw_derated);
+			regs->temp[EMIF_TEMP_BAND_DERATE_TIMINGS].sdram_tim3_shdw);
 	}
 }
 
@@ -198,6 +270,306 @@ static void __exit emif_debugfs_exit(struct emif_data *emif)
 	emif->debugfs_root = NULL;
 }
 
+/*
+ * The two EMIF performance counters as a perf PMU. The counters are
+ * free running 32-bit and shared by every initiator on the L3, so
+ * events are counting only and system-wide, opened on CPU 0:
+ *
+ *	perf stat -a -C 0 -e emif1/event=0x2/,emif1/event=0x3/
+ *
+ * event:	0x0 SDRAM accesses, 0x1 activates, 0x2 reads, 0x3 writes,
+ *		0x4-0x7 cycles a command/wdata/rdata/return FIFO was full,
+ *		0x8 priority elevations, 0x9 cycles a command was pending,
+ *		0xa cycles the data bus was active
+ * mconnid:	L3 master connection ID to count for, with mconnid_en=1,
+ *		so that DDR traffic can be split between MPU, DSS, GPU...
+ */
+#define EMIF_PMU_NR_COUNTERS	2
+#define EMIF_PMU_CPU		0
+#define EMIF_PMU_EVENT_MAX	0xa
+#define EMIF_PMU_POLL_MS	1000
+
+#define EMIF_PMU_EVENT(config)		((config) & 0xf)
+#define EMIF_PMU_MCONNID(config)	(((config) >> 8) & 0xff)
+#define EMIF_PMU_MCONNID_EN(config)	(((config) >> 16) & 0x1)
+
+#define to_emif_data(p)	container_of(p, struct emif_data, pmu)
+
+static u32 emif_pmu_counter_read(struct emif_data *emif, int idx)
+{
+	return readl(emif->base + (idx ? EMIF_PERFORMANCE_COUNTER_2 :
+					 EMIF_PERFORMANCE_COUNTER_1));
+}
+
+static void emif_pmu_counter_config(struct emif_data *emif, int idx,
+	u64 config)
+{
+	void __iomem *base = emif->base;
+	u32 cfg, sel;
+
+	cfg = readl(base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+	sel = readl(base + EMIF_PERFORMANCE_COUNTER_MASTER_REGION_SELECT);
+
+	if (!idx) {
+		cfg &= ~(CNTR1_MCONNID_EN_MASK | CNTR1_REGION_EN_MASK |
+			 CNTR1_CFG_MASK);
+		cfg |= EMIF_PMU_EVENT(config) << CNTR1_CFG_SHIFT;
+		cfg |= EMIF_PMU_MCONNID_EN(config) << CNTR1_MCONNID_EN_SHIFT;
+		sel &= ~MCONNID1_MASK;
+		sel |= EMIF_PMU_MCONNID(config) << MCONNID1_SHIFT;
+	} else {
+		cfg &= ~(CNTR2_MCONNID_EN_MASK | CNTR2_REGION_EN_MASK |
+			 CNTR2_CFG_MASK);
+		cfg |= EMIF_PMU_EVENT(config) << CNTR2_CFG_SHIFT;
+		cfg |= EMIF_PMU_MCONNID_EN(config) << CNTR2_MCONNID_EN_SHIFT;
+		sel &= ~MCONNID2_MASK;
+		sel |= EMIF_PMU_MCONNID(config) << MCONNID2_SHIFT;
+	}
+
+	writel(sel, base + EMIF_PERFORMANCE_COUNTER_MASTER_REGION_SELECT);
+	writel(cfg, base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+}
+
+#ifdef CONFIG_PERF_EVENTS
+static bool emif_pmu_counter_busy(struct emif_data *emif, int idx)
+{
+	return emif->pmu_events[idx] != NULL;
+}
+
+static void emif_pmu_event_read(struct perf_event *event)
+{
+	struct emif_data *emif = to_emif_data(event->pmu);
+	struct hw_perf_event *hw = &event->hw;
+	u64 prev_count, new_count;
+
+	do {
+		prev_count = local64_read(&hw->prev_count);
+		new_count = emif_pmu_counter_read(emif, hw->idx);
+	} while (local64_cmpxchg(&hw->prev_count, prev_count, new_count) !=
+								prev_count);
+
+	local64_add((new_count - prev_count) & 0xffffffffULL, &event->count);
+}
+
+static int emif_pmu_num_active(struct emif_data *emif)
+{
+	int i, cnt = 0;
+
+	for (i = 0; i < EMIF_PMU_NR_COUNTERS; i++)
+		if (emif->pmu_events[i])
+			cnt++;
+
+	return cnt;
+}
+
+static ktime_t emif_pmu_poll_period(void)
+{
+	return ktime_set(EMIF_PMU_POLL_MS / MSEC_PER_SEC,
+			 (EMIF_PMU_POLL_MS % MSEC_PER_SEC) * NSEC_PER_MSEC);
+}
+
+static enum hrtimer_restart emif_pmu_poll(struct hrtimer *hrtimer)
+{
+	struct emif_data *emif = container_of(hrtimer, struct emif_data,
+					      pmu_hrtimer);
+	int i;
+
+	for (i = 0; i < EMIF_PMU_NR_COUNTERS; i++)
+		if (emif->pmu_events[i] &&
+		    !(emif->pmu_events[i]->hw.state & PERF_HES_STOPPED))
+			emif_pmu_event_read(emif->pmu_events[i]);
+
+	hrtimer_forward_now(hrtimer, emif_pmu_poll_period());
+	return HRTIMER_RESTART;
+}
+
+static void emif_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct emif_data *emif = to_emif_data(event->pmu);
+	struct hw_perf_event *hw = &event->hw;
+
+	if (WARN_ON_ONCE(!(hw->state & PERF_HES_STOPPED)))
+		return;
+
+	hw->state = 0;
+
+	emif_pmu_counter_config(emif, hw->idx, hw->config_base);
+	local64_set(&hw->prev_count, emif_pmu_counter_read(emif, hw->idx));
+}
+
+static void emif_pmu_event_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hw = &event->hw;
+
+	if (hw->state & PERF_HES_STOPPED)
+		return;
+
+	/* The counters cannot be stopped, just stop accumulating them */
+	if (flags & PERF_EF_UPDATE) {
+		emif_pmu_event_read(event);
+		hw->state |= PERF_HES_UPTODATE;
+	}
+
+	hw->state |= PERF_HES_STOPPED;
+}
+
+static int emif_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct emif_data *emif = to_emif_data(event->pmu);
+	struct hw_perf_event *hw = &event->hw;
+	int idx;
+
+	for (idx = 0; idx < EMIF_PMU_NR_COUNTERS; idx++)
+		if (!emif->pmu_events[idx])
+			break;
+
+	if (idx == EMIF_PMU_NR_COUNTERS)
+		return -EAGAIN;
+
+	if (!emif_pmu_num_active(emif))
+		hrtimer_start(&emif->pmu_hrtimer, emif_pmu_poll_period(),
+			      HRTIMER_MODE_REL_PINNED);
+
+	emif->pmu_events[idx] = event;
+	hw->idx = idx;
+	hw->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		emif_pmu_event_start(event, 0);
+
+	return 0;
+}
+
+static void emif_pmu_event_del(struct perf_event *event, int flags)
+{
+	struct emif_data *emif = to_emif_data(event->pmu);
+	struct hw_perf_event *hw = &event->hw;
+
+	emif_pmu_event_stop(event, PERF_EF_UPDATE);
+
+	emif->pmu_events[hw->idx] = NULL;
+	hw->idx = -1;
+
+	if (!emif_pmu_num_active(emif))
+		hrtimer_cancel(&emif->pmu_hrtimer);
+}
+
+static bool emif_pmu_group_is_valid(struct perf_event *event)
+{
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	int num_hw = 0;
+
+	if (leader->pmu == event->pmu)
+		num_hw++;
+	else if (!is_software_event(leader))
+		return false;
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (sibling->pmu == event->pmu)
+			num_hw++;
+		else if (!is_software_event(sibling))
+			return false;
+	}
+
+	if (event != leader)
+		num_hw++;
+
+	return num_hw <= EMIF_PMU_NR_COUNTERS;
+}
+
+static int emif_pmu_event_init(struct perf_event *event)
+{
+	struct perf_event_attr *attr = &event->attr;
+
+	if (attr->type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) ||
+	    (event->attach_state & PERF_ATTACH_TASK))
+		return -EOPNOTSUPP;
+
+	if (event->cpu != EMIF_PMU_CPU)
+		return -EINVAL;
+
+	if (attr->exclude_user || attr->exclude_kernel ||
+	    attr->exclude_hv || attr->exclude_idle)
+		return -EINVAL;
+
+	if (EMIF_PMU_EVENT(attr->config) > EMIF_PMU_EVENT_MAX)
+		return -EINVAL;
+
+	if (!emif_pmu_group_is_valid(event))
+		return -EINVAL;
+
+	event->hw.config_base = attr->config;
+
+	return 0;
+}
+
+PMU_FORMAT_ATTR(event, "config:0-3");
+PMU_FORMAT_ATTR(mconnid, "config:8-15");
+PMU_FORMAT_ATTR(mconnid_en, "config:16");
+
+static struct attribute *emif_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	&format_attr_mconnid.attr,
+	&format_attr_mconnid_en.attr,
+	NULL,
+};
+
+static struct attribute_group emif_pmu_format_attr_group = {
+	.name = "format",
+	.attrs = emif_pmu_format_attrs,
+};
+
+static const struct attribute_group *emif_pmu_attr_groups[] = {
+	&emif_pmu_format_attr_group,
+	NULL,
+};
+
+static void __init_or_module emif_pmu_init(struct emif_data *emif, int id)
+{
+	int ret;
+
+	hrtimer_init(&emif->pmu_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	emif->pmu_hrtimer.function = emif_pmu_poll;
+
+	emif->pmu.attr_groups	= emif_pmu_attr_groups;
+	emif->pmu.event_init	= emif_pmu_event_init;
+	emif->pmu.add		= emif_pmu_event_add;
+	emif->pmu.del		= emif_pmu_event_del;
+	emif->pmu.start		= emif_pmu_event_start;
+	emif->pmu.stop		= emif_pmu_event_stop;
+	emif->pmu.read		= emif_pmu_event_read;
+
+	snprintf(emif->pmu_name, sizeof(emif->pmu_name), "emif%d", id);
+
+	ret = perf_pmu_register(&emif->pmu, emif->pmu_name, -1);
+	if (ret)
+		dev_warn(emif->dev, "perf PMU registration failed: %d\n",
+			 ret);
+}
+
+static void __exit emif_pmu_exit(struct emif_data *emif)
+{
+	perf_pmu_unregister(&emif->pmu);
+}
+#else
+static inline bool emif_pmu_counter_busy(struct emif_data *emif, int idx)
+{
+	return false;
+}
+
+static inline void emif_pmu_init(struct emif_data *emif, int id)
+{
+}
+
+static inline void emif_pmu_exit(struct emif_data *emif)
+{
+}
+#endif /* CONFIG_PERF_EVENTS */
+
 /*
  * Calculate the period of DDR clock from frequency value
  */
@@ -331,6 +703,180 @@ static void do_freq_update(void)
 	}
 }
 
+/*
+ * Adaptive low-power entry. Counter 2 counts the cycles the data bus was
+ * active, which against the free running time counter gives the DDR
+ * utilisation over the last EMIF_LP_SAMPLE_MS. A mostly idle bus gets the
+ * short power timeout so that self-refresh is entered sooner, a busy one
+ * the long performance timeout so that it is not entered and left again
+ * between bursts. While perf has an event on counter 2 the current choice
+ * is kept; sampling resumes once it is released.
+ *
+ * Called with emif_lock held.
+ */
+static void emif_lp_set_load(struct emif_data *emif, enum emif_lp_load load)
+{
+	void __iomem	*base = emif->base;
+	unsigned long	now = jiffies;
+	u32		timeouts, ctrl, mask;
+
+	emif->lp_time[emif->lp_load] += now - emif->lp_since;
+	emif->lp_since = now;
+
+	if (load == emif->lp_load)
+		return;
+	emif->lp_load = load;
+	emif->lp_switches++;
+
+	/* without registers for this frequency the next DVFS applies it */
+	if (!emif->curr_regs)
+		return;
+
+	timeouts = emif->curr_regs->pwr_mgmt_ctrl_shdw[load];
+	writel(timeouts, base + EMIF_POWER_MANAGEMENT_CTRL_SHDW);
+
+	/* only the timeouts take effect now, the mode is left as it is */
+	mask = CS_TIM_MASK | SR_TIM_MASK | PD_TIM_MASK;
+	ctrl = readl(base + EMIF_POWER_MANAGEMENT_CONTROL) & ~mask;
+	writel(ctrl | (timeouts & mask), base + EMIF_POWER_MANAGEMENT_CONTROL);
+}
+
+static void emif_lp_sample(struct work_struct *work)
+{
+	struct emif_data	*emif = container_of(to_delayed_work(work),
+						struct emif_data, lp_work);
+	enum emif_lp_load	load = emif->lp_load;
+	u32			time, active, d_time, d_active;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&emif_lock, flags);
+
+	if (!adaptive_lp) {
+		emif->lp_sampling = false;
+		load = EMIF_LP_LOAD_BY_FREQ;
+		goto out;
+	}
+
+	if (emif_pmu_counter_busy(emif, 1)) {
+		emif->lp_sampling = false;
+		goto out;
+	}
+
+	time = readl(emif->base + EMIF_PERFORMANCE_COUNTER_TIME);
+	if (!emif->lp_sampling) {
+		emif_pmu_counter_config(emif, 1,
+					EMIF_PERF_CNT_CFG_DATA_BUS_ACTIVE);
+		emif->lp_last_active = emif_pmu_counter_read(emif, 1);
+		emif->lp_last_time = time;
+		emif->lp_sampling = true;
+		goto out;
+	}
+
+	active = emif_pmu_counter_read(emif, 1);
+	d_time = time - emif->lp_last_time;
+	d_active = active - emif->lp_last_active;
+	emif->lp_last_time = time;
+	emif->lp_last_active = active;
+	if (!d_time)
+		goto out;
+
+	emif->lp_util = min_t(u32, div_u64((u64)d_active * 1000, d_time),
+			      1000);
+	if (emif->lp_util < EMIF_LP_IDLE_PERMILLE)
+		load = EMIF_LP_LOAD_IDLE;
+	else if (emif->lp_util > EMIF_LP_BUSY_PERMILLE)
+		load = EMIF_LP_LOAD_BUSY;
+
+out:
+	emif_lp_set_load(emif, load);
+	spin_unlock_irqrestore(&emif_lock, flags);
+
+	schedule_delayed_work(&emif->lp_work,
+			      msecs_to_jiffies(EMIF_LP_SAMPLE_MS));
+}
+
+/* Low-power entry timeout, in DDR cycles, encoded in @pwr_mgmt_ctrl */
+static u32 get_lp_timeout_cycles(struct emif_data *emif, u32 pwr_mgmt_ctrl)
+{
+	u32 val;
+
+	switch (emif->lpmode) {
+	case EMIF_LP_MODE_CLOCK_STOP:
+		val = (pwr_mgmt_ctrl & CS_TIM_MASK) >> CS_TIM_SHIFT;
+		break;
+	case EMIF_LP_MODE_SELF_REFRESH:
+		val = (pwr_mgmt_ctrl & SR_TIM_MASK) >> SR_TIM_SHIFT;
+		break;
+	case EMIF_LP_MODE_PWR_DN:
+		val = (pwr_mgmt_ctrl & PD_TIM_MASK) >> PD_TIM_SHIFT;
+		break;
+	default:
+		return 0;
+	}
+
+	/* The register holds "log2(timeout) - 3" */
+	return val ? 1 << (val + 3) : 0;
+}
+
+/* Where the timings and timeouts stand, and what they have cost */
+static int emif_lp_stats_show(struct seq_file *s, void *unused)
+{
+	struct emif_data	*emif = s->private;
+	unsigned long		lp_time[EMIF_LP_LOADS], flags;
+	u32			pwr_mgmt[EMIF_LP_LOADS], freq = 0;
+	enum emif_lp_load	load;
+	int			i;
+
+	spin_lock_irqsave(&emif_lock, flags);
+	emif_lp_set_load(emif, emif->lp_load);
+	load = emif->lp_load;
+	memcpy(lp_time, emif->lp_time, sizeof(lp_time));
+	if (emif->curr_regs) {
+		freq = emif->curr_regs->freq;
+		memcpy(pwr_mgmt, emif->curr_regs->pwr_mgmt_ctrl_shdw,
+		       sizeof(pwr_mgmt));
+	}
+	spin_unlock_irqrestore(&emif_lock, flags);
+
+	seq_printf(s, "temperature band\t: %s (MR4=%d), %lu changes\n",
+		   emif_temp_band_names[emif->temp_band],
+		   emif->temperature_level, emif->temp_band_changes);
+	seq_printf(s, "lp timeout\t\t: %s%s, %lu switches\n",
+		   emif_lp_load_names[load],
+		   adaptive_lp ? "" : " (adaptive off)", emif->lp_switches);
+	seq_printf(s, "data bus utilisation\t: %u.%u%%\n",
+		   emif->lp_util / 10, emif->lp_util % 10);
+
+	for (i = 0; i < EMIF_LP_LOADS; i++) {
+		seq_printf(s, "  %-12s\t: %u ms", emif_lp_load_names[i],
+			   jiffies_to_msecs(lp_time[i]));
+		if (freq) {
+			u32 cycles = get_lp_timeout_cycles(emif, pwr_mgmt[i]);
+
+			seq_printf(s, ", timeout %u cycles (%llu ns @ %uMHz)",
+				   cycles, div_u64((u64)cycles * NSEC_PER_SEC,
+						   freq), freq / 1000000);
+		}
+		seq_printf(s, "\n");
+	}
+
+	seq_printf(s, "dvfs transitions\t: %lu, last %lld us, max %lld us\n",
+		   dvfs_count, div_s64(dvfs_last_ns, NSEC_PER_USEC),
+		   div_s64(dvfs_max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int emif_lp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emif_lp_stats_show, inode->i_private);
+}
+
+static const struct file_operations emif_lp_stats_fops = {
+	.open			= emif_lp_stats_open,
+	.read			= seq_read,
+	.release		= single_release,
+};
+
 /* Find addressing table entry based on the device's type and density */
 static const struct lpddr2_addressing *get_addressing_table(
 	const struct ddr_device_info *device_info)
@@ -748,7 +1294,8 @@ static u32 get_ext_phy_ctrl_4_intelliphy_4d5(void)
 		fifo_we_slave_ratio << 13;
 }
 
-static u32 get_pwr_mgmt_ctrl(u32 freq, struct emif_data *emif, u32 ip_rev)
+static u32 get_pwr_mgmt_ctrl(u32 freq, struct emif_data *emif, u32 ip_rev,
+		enum emif_lp_load load)
 {
 	u32 pwr_mgmt_ctrl	= 0, timeout;
 	u32 lpmode		= EMIF_LP_MODE_SELF_REFRESH;
@@ -771,8 +1318,13 @@ static u32 get_pwr_mgmt_ctrl(u32 freq, struct emif_data *emif, u32 ip_rev)
 			freq_threshold  = cust_cfgs->lpmode_freq_threshold;
 	}
 
-	/* Timeout based on DDR frequency */
-	timeout = freq >= freq_threshold ? timeout_perf : timeout_pwr;
+	/* Timeout based on the measured load, failing that DDR frequency */
+	if (load == EMIF_LP_LOAD_BUSY)
+		timeout = timeout_perf;
+	else if (load == EMIF_LP_LOAD_IDLE)
+		timeout = timeout_pwr;
+	else
+		timeout = freq >= freq_threshold ? timeout_perf : timeout_pwr;
 
 	/* The value to be set in register is "log2(timeout) - 3" */
 	if (timeout < 16) {
@@ -879,7 +1431,7 @@ static void setup_registers(struct emif_data *emif, struct emif_regs *regs)
 
 	writel(regs->sdram_tim2_shdw, base + EMIF_SDRAM_TIMING_2_SHDW);
 	writel(regs->phy_ctrl_1_shdw, base + EMIF_DDR_PHY_CTRL_1_SHDW);
-	writel(regs->pwr_mgmt_ctrl_shdw,
+	writel(regs->pwr_mgmt_ctrl_shdw[emif->lp_load],
 	       base + EMIF_POWER_MANAGEMENT_CTRL_SHDW);
 
 	/* Settings specific for EMIF4D5 */
@@ -929,6 +1481,25 @@ static void setup_volt_sensitive_regs(struct emif_data *emif,
 	}
 }
 
+/* Map the MR4 temperature level onto the band of timings it needs */
+static enum emif_temp_band get_temp_band(struct emif_data *emif)
+{
+	u32 type = emif->plat_data->device_info->type;
+
+	/* No de-rating for non-lpddr2 devices */
+	if (type != DDR_TYPE_LPDDR2_S2 && type != DDR_TYPE_LPDDR2_S4)
+		return EMIF_TEMP_BAND_NOMINAL;
+
+	switch (emif->temperature_level) {
+	case SDRAM_TEMP_HIGH_DERATE_REFRESH:
+		return EMIF_TEMP_BAND_DERATE_REFRESH;
+	case SDRAM_TEMP_HIGH_DERATE_REFRESH_AND_TIMINGS:
+		return EMIF_TEMP_BAND_DERATE_TIMINGS;
+	default:
+		return EMIF_TEMP_BAND_NOMINAL;
+	}
+}
+
 /*
  * setup_temperature_sensitive_regs() - set the timings for temperature
  * sensitive registers. This happens once at initialisation time based
@@ -936,37 +1507,26 @@ static void setup_volt_sensitive_regs(struct emif_data *emif,
  * alert interrupt. Temperature alert can happen when the temperature
  * increases or drops. So this function can have the effect of either
  * derating the timings or going back to nominal values.
+ *
+ * All bands are precomputed with the rest of the registers for a
+ * frequency, so this only copies one set into the shadow registers; the
+ * caller's FREQ_UPDATE then switches all three over at once.
  */
 static void setup_temperature_sensitive_regs(struct emif_data *emif,
 		struct emif_regs *regs)
 {
-	u32		tim1, tim3, ref_ctrl, type;
-	void __iomem	*base = emif->base;
-	u32		temperature;
-
-	type = emif->plat_data->device_info->type;
-
-	tim1 = regs->sdram_tim1_shdw;
-	tim3 = regs->sdram_tim3_shdw;
-	ref_ctrl = regs->ref_ctrl_shdw;
-
-	/* No de-rating for non-lpddr2 devices */
-	if (type != DDR_TYPE_LPDDR2_S2 && type != DDR_TYPE_LPDDR2_S4)
-		goto out;
+	void __iomem		*base = emif->base;
+	enum emif_temp_band	band = get_temp_band(emif);
+	struct emif_temp_regs	*t = &regs->temp[band];
 
-	temperature = emif->temperature_level;
-	if (temperature == SDRAM_TEMP_HIGH_DERATE_REFRESH) {
-		ref_ctrl = regs->ref_ctrl_shdw_derated;
-	} else if (temperature == SDRAM_TEMP_HIGH_DERATE_REFRESH_AND_TIMINGS) {
-		tim1 = regs->sdram_tim1_shdw_derated;
-		tim3 = regs->sdram_tim3_shdw_derated;
-		ref_ctrl = regs->ref_ctrl_shdw_derated;
+	if (band != emif->temp_band) {
+		emif->temp_band = band;
+		emif->temp_band_changes++;
 	}
 
-out:
-	writel(tim1, base + EMIF_SDRAM_TIMING_1_SHDW);
-	writel(tim3, base + EMIF_SDRAM_TIMING_3_SHDW);
-	writel(ref_ctrl, base + EMIF_SDRAM_REFRESH_CTRL_SHDW);
+	writel(t->sdram_tim1_shdw, base + EMIF_SDRAM_TIMING_1_SHDW);
+	writel(t->sdram_tim3_shdw, base + EMIF_SDRAM_TIMING_3_SHDW);
+	writel(t->ref_ctrl_shdw, base + EMIF_SDRAM_REFRESH_CTRL_SHDW);
 }
 
 static irqreturn_t handle_temp_alert(void __iomem *base, struct emif_data *emif)
@@ -1167,7 +1727,7 @@ static void __init_or_module emif_onetime_settings(struct emif_data *emif)
 	 * value for a conservative timeout setting
 	 */
 	pwr_mgmt_ctrl = get_pwr_mgmt_ctrl(1000000000, emif,
-			emif->plat_data->ip_rev);
+			emif->plat_data->ip_rev, EMIF_LP_LOAD_BY_FREQ);
 	emif->lpmode = (pwr_mgmt_ctrl & LP_MODE_MASK) >> LP_MODE_SHIFT;
 
 	/* First update the time in shadow register */
@@ -1397,6 +1957,8 @@ error:
 	return NULL;
 }
 
+static void emif_precompute_boot_regs(struct emif_data *emif);
+
 static int __init_or_module emif_probe(struct platform_device *pdev)
 {
 	struct emif_data	*emif;
@@ -1439,6 +2001,7 @@ static int __init_or_module emif_probe(struct platform_device *pdev)
 
 	emif_onetime_settings(emif);
 	emif_debugfs_init(emif);
+	emif_pmu_init(emif, pdev->id);
 	disable_and_clear_all_interrupts(emif);
 	setup_interrupts(emif, irq);
 
@@ -1454,6 +2017,18 @@ static int __init_or_module emif_probe(struct platform_device *pdev)
 		 */
 	}
 
+	emif_precompute_boot_regs(emif);
+
+	if (emif->debugfs_root)
+		debugfs_create_file("lp_stats", S_IRUGO, emif->debugfs_root,
+				    emif, &emif_lp_stats_fops);
+
+	emif->lp_since = jiffies;
+	INIT_DELAYED_WORK_DEFERRABLE(&emif->lp_work, emif_lp_sample);
+	if (emif->lpmode != EMIF_LP_MODE_DISABLE)
+		schedule_delayed_work(&emif->lp_work,
+				      msecs_to_jiffies(EMIF_LP_SAMPLE_MS));
+
 	dev_info(&pdev->dev, "%s: device configured with addr = %p and IRQ%d\n",
 		__func__, emif->base, irq);
 
@@ -1466,6 +2041,8 @@ static int __exit emif_remove(struct platform_device *pdev)
 {
 	struct emif_data *emif = platform_get_drvdata(pdev);
 
+	cancel_delayed_work_sync(&emif->lp_work);
+	emif_pmu_exit(emif);
 	emif_debugfs_exit(emif);
 
 	return 0;
@@ -1475,6 +2052,7 @@ static void emif_shutdown(struct platform_device *pdev)
 {
 	struct emif_data	*emif = platform_get_drvdata(pdev);
 
+	cancel_delayed_work_sync(&emif->lp_work);
 	disable_and_clear_all_interrupts(emif);
 }
 
@@ -1490,6 +2068,8 @@ static int get_emif_reg_values(struct emif_data *emif, u32 freq,
 	struct emif_data		*emif_for_calc;
 	struct device			*dev;
 	const struct emif_custom_configs *custom_configs;
+	struct emif_temp_regs		*nominal;
+	int				load;
 
 	dev = emif->dev;
 	/*
@@ -1516,12 +2096,13 @@ static int get_emif_reg_values(struct emif_data *emif, u32 freq,
 
 	set_ddr_clk_period(freq);
 
-	regs->ref_ctrl_shdw = get_sdram_ref_ctrl_shdw(freq, addressing);
-	regs->sdram_tim1_shdw = get_sdram_tim_1_shdw(timings, min_tck,
+	nominal = &regs->temp[EMIF_TEMP_BAND_NOMINAL];
+	nominal->ref_ctrl_shdw = get_sdram_ref_ctrl_shdw(freq, addressing);
+	nominal->sdram_tim1_shdw = get_sdram_tim_1_shdw(timings, min_tck,
 			addressing, ip_rev);
 	regs->sdram_tim2_shdw = get_sdram_tim_2_shdw(timings, min_tck,
 			addressing, type, ip_rev);
-	regs->sdram_tim3_shdw = get_sdram_tim_3_shdw(timings, min_tck,
+	nominal->sdram_tim3_shdw = get_sdram_tim_3_shdw(timings, min_tck,
 		addressing, type, ip_rev, EMIF_NORMAL_TIMINGS);
 
 	cl = get_cl(emif);
@@ -1539,9 +2120,10 @@ static int get_emif_reg_values(struct emif_data *emif, u32 freq,
 	}
 
 	/* Only timeout values in pwr_mgmt_ctrl_shdw register */
-	regs->pwr_mgmt_ctrl_shdw =
-		get_pwr_mgmt_ctrl(freq, emif_for_calc, ip_rev) &
-		(CS_TIM_MASK | SR_TIM_MASK | PD_TIM_MASK);
+	for (load = 0; load < EMIF_LP_LOADS; load++)
+		regs->pwr_mgmt_ctrl_shdw[load] =
+			get_pwr_mgmt_ctrl(freq, emif_for_calc, ip_rev, load) &
+			(CS_TIM_MASK | SR_TIM_MASK | PD_TIM_MASK);
 
 	if (ip_rev & EMIF_4D) {
 		regs->read_idle_ctrl_shdw_normal =
@@ -1557,15 +2139,23 @@ static int get_emif_reg_values(struct emif_data *emif, u32 freq,
 			get_dll_calib_ctrl_shdw(DDR_VOLTAGE_RAMPING);
 	}
 
+	/* Bands the device can't report fall back to nominal timings */
+	regs->temp[EMIF_TEMP_BAND_DERATE_REFRESH] = *nominal;
+	regs->temp[EMIF_TEMP_BAND_DERATE_TIMINGS] = *nominal;
+
 	if (type == DDR_TYPE_LPDDR2_S2 || type == DDR_TYPE_LPDDR2_S4) {
-		regs->ref_ctrl_shdw_derated = get_sdram_ref_ctrl_shdw(freq / 4,
+		u32 ref_ctrl_derated = get_sdram_ref_ctrl_shdw(freq / 4,
 			addressing);
+		struct emif_temp_regs *derated;
 
-		regs->sdram_tim1_shdw_derated =
-			get_sdram_tim_1_shdw_derated(timings, min_tck,
-				addressing, ip_rev);
+		regs->temp[EMIF_TEMP_BAND_DERATE_REFRESH].ref_ctrl_shdw =
+			ref_ctrl_derated;
 
-		regs->sdram_tim3_shdw_derated = get_sdram_tim_3_shdw(timings,
+		derated = &regs->temp[EMIF_TEMP_BAND_DERATE_TIMINGS];
+		derated->ref_ctrl_shdw = ref_ctrl_derated;
+		derated->sdram_tim1_shdw = get_sdram_tim_1_shdw_derated(timings,
+			min_tck, addressing, ip_rev);
+		derated->sdram_tim3_shdw = get_sdram_tim_3_shdw(timings,
 			min_tck, addressing, type, ip_rev,
 			EMIF_DERATED_TIMINGS);
 	}
@@ -1697,6 +2287,37 @@ static int volt_notify_handling(struct notifier_block *nb,
 	return 0;
 }
 
+/*
+ * The first DVFS transition would otherwise have to compute the timings
+ * of the frequency the bootloader left the DDR at. Do it now and start
+ * from them, so that the temperature and low-power handling also have
+ * registers to work with before any transition.
+ */
+static void emif_precompute_boot_regs(struct emif_data *emif)
+{
+	struct emif_regs	*regs;
+	struct clk		*clk;
+	unsigned long		rate, flags;
+
+	clk = clk_get(NULL, "dpll_core_m2_ck");
+	if (IS_ERR(clk))
+		return;
+	rate = clk_get_rate(clk);
+	clk_put(clk);
+
+	/* DDR Clock = core_dpll_m2 / 2 on OMAP4 */
+	if (cpu_is_omap44xx())
+		rate >>= 1;
+
+	regs = get_regs(emif, rate);
+	if (!regs)
+		return;
+
+	spin_lock_irqsave(&emif_lock, flags);
+	emif->curr_regs = regs;
+	spin_unlock_irqrestore(&emif_lock, flags);
+}
+
 static void do_freq_pre_notify_handling(struct emif_data *emif, u32 new_freq)
 {
 	struct emif_regs *regs;
@@ -1755,8 +2376,16 @@ static void freq_pre_notify_handling(u32 new_freq)
 	 * for temperature events. Otherwise, there could be race
 	 * conditions that could result in incorrect EMIF timings for
 	 * a given frequency
+	 *
+	 * Timings for a frequency not seen before are computed and cached
+	 * first, so that only the shadow register writes are done with
+	 * interrupts off.
 	 */
+	list_for_each_entry(emif, &device_list, node)
+		get_regs(emif, new_freq);
+
 	spin_lock_irqsave(&emif_lock, irq_state);
+	dvfs_start = ktime_get();
 
 	list_for_each_entry(emif, &device_list, node)
 		do_freq_pre_notify_handling(emif, new_freq);
@@ -1781,10 +2410,16 @@ static void do_freq_post_notify_handling(struct emif_data *emif)
 static void freq_post_notify_handling(void)
 {
 	struct emif_data *emif;
+	s64 ns;
 
 	list_for_each_entry(emif, &device_list, node)
 		do_freq_post_notify_handling(emif);
 
+	ns = ktime_to_ns(ktime_sub(ktime_get(), dvfs_start));
+	dvfs_count++;
+	dvfs_last_ns = ns;
+	dvfs_max_ns = max(dvfs_max_ns, ns);
+
 	/*
 	 * Lock is done in pre-notify handler. See freq_pre_notify_handling()
 	 * for more details
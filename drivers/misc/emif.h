@@ -75,6 +75,16 @@
 #define EMIF_LP_MODE_TIMEOUT_POWER			512
 #define EMIF_LP_MODE_FREQ_THRESHOLD			400000000
 
+/*
+ * Adaptive low-power entry: the data bus utilisation is sampled from the
+ * performance counters and the power timeout is used below IDLE_PERMILLE,
+ * the performance timeout above BUSY_PERMILLE.
+ */
+#define EMIF_LP_SAMPLE_MS				200
+#define EMIF_LP_IDLE_PERMILLE				50
+#define EMIF_LP_BUSY_PERMILLE				150
+#define EMIF_PERF_CNT_CFG_DATA_BUS_ACTIVE		0xa
+
 /* DDR_PHY_CTRL_1 values for EMIF4D - ATTILA PHY combination */
 #define EMIF_DDR_PHY_CTRL_1_BASE_VAL_ATTILAPHY		0x049FF000
 #define EMIF_DLL_SLAVE_DLY_CTRL_400_MHZ_ATTILAPHY	0x41
@@ -558,6 +568,31 @@
 #define READ_LATENCY_SHDW_MASK				(0x1f << 0)
 
 #ifndef __ASSEMBLY__
+/*
+ * Temperature bands, from the MR4 refresh rate, that each have their own
+ * precomputed refresh and AC timing registers
+ */
+enum emif_temp_band {
+	EMIF_TEMP_BAND_NOMINAL,
+	EMIF_TEMP_BAND_DERATE_REFRESH,
+	EMIF_TEMP_BAND_DERATE_TIMINGS,
+	EMIF_TEMP_BANDS
+};
+
+struct emif_temp_regs {
+	u32 ref_ctrl_shdw;
+	u32 sdram_tim1_shdw;
+	u32 sdram_tim3_shdw;
+};
+
+/* Low-power entry timeouts selected from the measured DDR load */
+enum emif_lp_load {
+	EMIF_LP_LOAD_BY_FREQ,
+	EMIF_LP_LOAD_IDLE,
+	EMIF_LP_LOAD_BUSY,
+	EMIF_LP_LOADS
+};
+
 /*
  * Structure containing shadow of important registers in EMIF
  * The calculation function fills in this structure to be later used for
@@ -565,14 +600,9 @@
  */
 struct emif_regs {
 	u32 freq;
-	u32 ref_ctrl_shdw;
-	u32 ref_ctrl_shdw_derated;
-	u32 sdram_tim1_shdw;
-	u32 sdram_tim1_shdw_derated;
+	struct emif_temp_regs temp[EMIF_TEMP_BANDS];
 	u32 sdram_tim2_shdw;
-	u32 sdram_tim3_shdw;
-	u32 sdram_tim3_shdw_derated;
-	u32 pwr_mgmt_ctrl_shdw;
+	u32 pwr_mgmt_ctrl_shdw[EMIF_LP_LOADS];
 	union {
 		u32 read_idle_ctrl_shdw_normal;
 		u32 dll_calib_ctrl_shdw_normal;
@@ -381,19 +381,82 @@ void callbackfreesurface(void *callbackinfo)
  * Temporary buffer management.
  */
 
+static enum bverror free_temp_index(enum gctempbuffer index, bool schedule)
+{
+	enum bverror bverror;
+	struct gccontext *gccontext = get_context();
+	struct gccallbackinfo *gccallbackinfo;
+	struct gcicallbackarm gcicallbackarm;
+
+	/* Is the buffer allocated? */
+	if (gccontext->tmpbuffdesc[index] == NULL) {
+		bverror = BVERR_NONE;
+		goto exit;
+	}
+
+	/* Unmap the buffer. */
+	bverror = bv_unmap(gccontext->tmpbuffdesc[index]);
+	if (bverror != BVERR_NONE)
+		goto exit;
+
+	/* Cannot be mapped. */
+	if (gccontext->tmpbuffdesc[index]->map != NULL) {
+		BVSETERROR(BVERR_OOM, "temporary buffer is still mapped");
+		goto exit;
+	}
+
+	/* Free the buffer. */
+	if (schedule) {
+		bverror = get_callbackinfo(&gccallbackinfo);
+		if (bverror != BVERR_NONE) {
+			BVSETERROR(BVERR_OOM,
+				   "callback allocation failed");
+			goto exit;
+		}
+
+		gccallbackinfo->info.freesurface.desc
+			= gccontext->tmpbuffdesc[index];
+		gccallbackinfo->info.freesurface.ptr
+			= gccontext->tmpbuff[index];
+		gcicallbackarm.callback = callbackfreesurface;
+		gcicallbackarm.callbackparam = gccallbackinfo;
+
+		/* Schedule to free the buffer. */
+		gc_callback_wrapper(&gcicallbackarm);
+
+		/* Error? */
+		if (gcicallbackarm.gcerror != GCERR_NONE) {
+			BVSETERROR(BVERR_OOM, "unable to schedule callback");
+			goto exit;
+		}
+	} else {
+		/* Free the buffer immediately. */
+		free_surface(gccontext->tmpbuffdesc[index],
+			     gccontext->tmpbuff[index]);
+	}
+
+	/* Reset the buffer descriptor. */
+	gccontext->tmpbuffdesc[index] = NULL;
+	gccontext->tmpbuff[index] = NULL;
+
+exit:
+	return bverror;
+}
+
 enum bverror allocate_temp(struct bvbltparams *bvbltparams,
+			   enum gctempbuffer index,
 			   unsigned int size)
 {
 	enum bverror bverror;
 	struct gccontext *gccontext = get_context();
 
-	GCENTER(GCZONE_TEMP);
+	GCENTERARG(GCZONE_TEMP, "index = %d\n", index);
 
 	/* Existing buffer too small? */
-	if ((gccontext->tmpbuffdesc != NULL) &&
-	    (gccontext->tmpbuffdesc->length < size)) {
+	if ((gccontext->tmpbuffdesc[index] != NULL) &&
+	    (gccontext->tmpbuffdesc[index]->length < size)) {
 		GCDBG(GCZONE_TEMP, "freeing current buffer.\n");
-		bverror = free_temp(true);
+		bverror = free_temp_index(index, true);
 		if (bverror != BVERR_NONE) {
 			bvbltparams->errdesc = gccontext->bverrorstr;
 			goto exit;
@@ -401,10 +464,10 @@ enum bverror allocate_temp(struct bvbltparams *bvbltparams,
 	}
 
 	/* Allocate new buffer if necessary. */
-	if ((size > 0) && (gccontext->tmpbuffdesc == NULL)) {
+	if ((size > 0) && (gccontext->tmpbuffdesc[index] == NULL)) {
 		/* Allocate temporary surface. */
-		bverror = allocate_surface(&gccontext->tmpbuffdesc,
-					   &gccontext->tmpbuff,
+		bverror = allocate_surface(&gccontext->tmpbuffdesc[index],
+					   &gccontext->tmpbuff[index],
 					   size);
 		if (bverror != BVERR_NONE) {
 			bvbltparams->errdesc = gccontext->bverrorstr;
@@ -412,14 +475,14 @@ enum bverror allocate_temp(struct bvbltparams *bvbltparams,
 		}
 
 		GCDBG(GCZONE_TEMP, "buffdesc @ 0x%08X\n",
-		      gccontext->tmpbuffdesc);
+		      gccontext->tmpbuffdesc[index]);
 		GCDBG(GCZONE_TEMP, "allocated @ 0x%08X\n",
-		      gccontext->tmpbuff);
+		      gccontext->tmpbuff[index]);
 		GCDBG(GCZONE_TEMP, "size = %d\n",
 		      size);
 
 		/* Map the buffer explicitly. */
-		bverror = bv_map(gccontext->tmpbuffdesc);
+		bverror = bv_map(gccontext->tmpbuffdesc[index]);
 		if (bverror != BVERR_NONE) {
 			bvbltparams->errdesc = gccontext->bverrorstr;
 			goto exit;
@@ -436,60 +499,15 @@ exit:
 
 enum bverror free_temp(bool schedule)
 {
-	enum bverror bverror;
-	struct gccontext *gccontext = get_context();
-	struct gccallbackinfo *gccallbackinfo;
-	struct gcicallbackarm gcicallbackarm;
-
-	/* Is the buffer allocated? */
-	if (gccontext->tmpbuffdesc == NULL) {
-		bverror = BVERR_NONE;
-		goto exit;
-	}
-
-	/* Unmap the buffer. */
-	bverror = bv_unmap(gccontext->tmpbuffdesc);
-	if (bverror != BVERR_NONE)
-		goto exit;
-
-	/* Cannot be mapped. */
-	if (gccontext->tmpbuffdesc->map != NULL) {
-		BVSETERROR(BVERR_OOM, "temporary buffer is still mapped");
-		goto exit;
-	}
-
-	/* Free the buffer. */
-	if (schedule) {
-		bverror = get_callbackinfo(&gccallbackinfo);
-		if (bverror != BVERR_NONE) {
-			BVSETERROR(BVERR_OOM,
-				   "callback allocation failed");
-			goto exit;
-		}
-
-		gccallbackinfo->info.freesurface.desc = gccontext->tmpbuffdesc;
-		gccallbackinfo->info.freesurface.ptr = gccontext->tmpbuff;
-		gcicallbackarm.callback = callbackfreesurface;
-		gcicallbackarm.callbackparam = gccallbackinfo;
-
-		/* Schedule to free the buffer. */
-		gc_callback_wrapper(&gcicallbackarm);
+	enum bverror bverror = BVERR_NONE;
+	int index;
 
-		/* Error? */
-		if (gcicallbackarm.gcerror != GCERR_NONE) {
-			BVSETERROR(BVERR_OOM, "unable to schedule callback");
-			goto exit;
-		}
-	} else {
-		/* Free the buffer immediately. */
-		free_surface(gccontext->tmpbuffdesc, gccontext->tmpbuff);
+	for (index = 0; index < GC_TEMP_COUNT; index += 1) {
+		bverror = free_temp_index(index, schedule);
+		if (bverror != BVERR_NONE)
+			break;
 	}
 
-	/* Reset the buffer descriptor. */
-	gccontext->tmpbuffdesc = NULL;
-	gccontext->tmpbuff = NULL;
-
-exit:
 	return bverror;
 }
 
@@ -1134,6 +1152,8 @@ static enum bverror do_op(struct bvbltparams *bvbltparams,
 	enum bverror bverror = BVERR_NONE;
 	struct gcsurface *dstinfo;
 	int sw, sh, dw, dh;
+	enum gcbv_optype optype;
+	unsigned int bytes;
 
 	GCDBG(GCZONE_BLIT, "processing source %d.\n", srcinfo->index + 1);
 
@@ -1224,23 +1244,48 @@ static enum bverror do_op(struct bvbltparams *bvbltparams,
 	GCDBG(GCZONE_BLIT, "  srcsize %dx%d.\n", sw, sh);
 	GCDBG(GCZONE_BLIT, "  dstsize %dx%d.\n", dw, dh);
 
+	dstinfo = &gcbatch->dstinfo;
+
 	if ((sw == 0) || (sh == 0)) {
 		GCDBG(GCZONE_BLIT, "  empty source, skipping.\n");
+		optype = GCBV_OP_COUNT;
 	} else if ((dw == 0) || (dh == 0)) {
 		GCDBG(GCZONE_BLIT, "  empty destination, skipping.\n");
+		optype = GCBV_OP_COUNT;
 	} else if ((sw == 1) && (sh == 1) && (srcinfo->buf.desc->virtaddr)) {
 		GCDBG(GCZONE_BLIT, "  op: fill.\n");
 		bverror = do_fill(bvbltparams, gcbatch, srcinfo);
+		optype = GCBV_OP_FILL;
 	} else if ((sw == dw) && (sh == dh)) {
 		GCDBG(GCZONE_BLIT, "  op: bitblit.\n");
 		bverror = do_blit(bvbltparams, gcbatch, srcinfo);
+
+		if (srcinfo->angle != dstinfo->angle)
+			optype = GCBV_OP_ROTATE;
+		else if ((srcinfo->format.format != dstinfo->format.format) ||
+			 (srcinfo->format.swizzle != dstinfo->format.swizzle))
+			optype = GCBV_OP_CONVERT;
+		else
+			optype = GCBV_OP_COPY;
 	} else {
 		GCDBG(GCZONE_BLIT, "  op: filter.\n");
 		bverror = do_filter(bvbltparams, gcbatch, srcinfo);
+		optype = GCBV_OP_FILTER;
+	}
+
+	/* Account for the operation; blending reads the destination. */
+	if ((bverror == BVERR_NONE) && (optype != GCBV_OP_COUNT)) {
+		bytes = dw * dh * dstinfo->format.bitspp / 8;
+		if (srcinfo->gca != NULL)
+			bytes *= 2;
+		if (optype != GCBV_OP_FILL)
+			bytes += sw * sh * srcinfo->format.bitspp / 8;
+
+		gcbatch->opmask |= 1 << optype;
+		gcbv_debug_op(optype, dw * dh, bytes);
 	}
 
 	/* Reset dirty flags. */
-	dstinfo = &gcbatch->dstinfo;
 	dstinfo->surfdirty = false;
 	dstinfo->rectdirty = false;
 	dstinfo->cliprectdirty = false;
@@ -2001,17 +2046,32 @@ enum bverror bv_blt(struct bvbltparams *bvbltparams)
 		gcicommit.gcerror = GCERR_NONE;
 		gcicommit.entrypipe = GCPIPE_2D;
 		gcicommit.exitpipe = GCPIPE_2D;
+		gcicommit.fence = (gcbatch->fence != NULL);
 
 		INIT_LIST_HEAD(&gcicommit.buffer);
 		list_splice_init(&gcbatch->buffer, &gcicommit.buffer);
 
 		GCDBG(GCZONE_BLIT, "submitting the batch.\n");
-		gc_commit_wrapper(&gcicommit);
+		if (gcicommit.asynchronous || !gcbv_debug_profiling()) {
+			gc_commit_wrapper(&gcicommit);
+		} else {
+			struct gcprofile gcprofile;
+			ktime_t start = ktime_get();
+
+			gc_commit_profile(&gcicommit, &gcprofile);
+			if (gcicommit.gcerror == GCERR_NONE)
+				gcbv_debug_batch(gcbatch->opmask, &gcprofile,
+					ktime_to_us(ktime_sub(ktime_get(),
+							      start)));
+		}
 
 		/* Move the lists back to the batch. */
 		list_splice_init(&gcicommit.buffer, &gcbatch->buffer);
 		list_splice_init(&gcicommit.unmap, &gcbatch->unmap);
 
+		if (gcbatch->fence != NULL)
+			*gcbatch->fence = gcicommit.syncfence;
+
 		/* Error? */
 		if (gcicommit.gcerror != GCERR_NONE) {
 			switch (gcicommit.gcerror) {
@@ -2043,6 +2103,194 @@ exit:
 	return bverror;
 }
 
+/*******************************************************************************
+ * Vectored blit.
+ */
+
+static bool same_geom(struct bvsurfgeom *geom1, struct bvsurfgeom *geom2)
+{
+	if (geom1 == geom2)
+		return true;
+
+	if ((geom1 == NULL) || (geom2 == NULL))
+		return false;
+
+	return (geom1->format == geom2->format) &&
+	       (geom1->width == geom2->width) &&
+	       (geom1->height == geom2->height) &&
+	       (geom1->orientation == geom2->orientation) &&
+	       (geom1->virtstride == geom2->virtstride);
+}
+
+static unsigned long rect_changes(struct bvrect *rect1, struct bvrect *rect2,
+				  unsigned long origin, unsigned long size)
+{
+	unsigned long changes = 0;
+
+	if ((rect1->left != rect2->left) || (rect1->top != rect2->top))
+		changes |= origin;
+
+	if ((rect1->width != rect2->width) || (rect1->height != rect2->height))
+		changes |= size;
+
+	return changes;
+}
+
+/* Determine BVBATCH_* flags describing what has changed between two
+ * consecutive blits of a batch. */
+static unsigned long batch_changes(struct bvbltparams *prev,
+				   struct bvbltparams *next)
+{
+	unsigned long changes = 0;
+
+	/* A different operation may use the sources differently; make the
+	 * parser start from scratch. */
+	if (((prev->flags ^ next->flags) & BVFLAG_OP_MASK) ||
+	    memcmp(&prev->op, &next->op, sizeof(union bvop)))
+		return 0x7FFFFFFF;
+
+	if ((prev->flags ^ next->flags) & ~BVFLAG_BATCH_MASK)
+		changes |= BVBATCH_MISCFLAGS;
+
+	if (prev->colorkey != next->colorkey)
+		changes |= BVBATCH_KEY;
+
+	if (memcmp(&prev->globalalpha, &next->globalalpha,
+		   sizeof(union bvalpha)))
+		changes |= BVBATCH_ALPHA;
+
+	if (prev->dithermode != next->dithermode)
+		changes |= BVBATCH_DITHER;
+
+	if (prev->scalemode != next->scalemode)
+		changes |= BVBATCH_SCALE;
+
+	if ((prev->dstdesc != next->dstdesc) ||
+	    !same_geom(prev->dstgeom, next->dstgeom))
+		changes |= BVBATCH_DST;
+
+	if ((prev->src1.desc != next->src1.desc) ||
+	    !same_geom(prev->src1geom, next->src1geom))
+		changes |= BVBATCH_SRC1;
+
+	if ((prev->src2.desc != next->src2.desc) ||
+	    !same_geom(prev->src2geom, next->src2geom))
+		changes |= BVBATCH_SRC2;
+
+	if ((prev->mask.desc != next->mask.desc) ||
+	    !same_geom(prev->maskgeom, next->maskgeom))
+		changes |= BVBATCH_MASK;
+
+	changes |= rect_changes(&prev->dstrect, &next->dstrect,
+				BVBATCH_DSTRECT_ORIGIN,
+				BVBATCH_DSTRECT_SIZE);
+	changes |= rect_changes(&prev->src1rect, &next->src1rect,
+				BVBATCH_SRC1RECT_ORIGIN,
+				BVBATCH_SRC1RECT_SIZE);
+	changes |= rect_changes(&prev->src2rect, &next->src2rect,
+				BVBATCH_SRC2RECT_ORIGIN,
+				BVBATCH_SRC2RECT_SIZE);
+	changes |= rect_changes(&prev->maskrect, &next->maskrect,
+				BVBATCH_MASKRECT_ORIGIN,
+				BVBATCH_MASKRECT_SIZE);
+	changes |= rect_changes(&prev->cliprect, &next->cliprect,
+				BVBATCH_CLIPRECT_ORIGIN,
+				BVBATCH_CLIPRECT_SIZE);
+
+	return changes;
+}
+
+/* Execute a number of blits as a single batch: the surfaces are validated
+ * and mapped once, only the parameters that change between the blits are
+ * parsed again, and the whole array is submitted as one command buffer.
+ * The batch flags of the entries are ignored; BVFLAG_ASYNC and the
+ * callback of the last queued entry apply to the entire batch. Queuing
+ * stops at the first failing entry; the blits before it still execute.
+ * If fence is not NULL, the batch is submitted asynchronously and a sync
+ * fence signaled on its completion is returned there, or NULL if nothing
+ * was submitted. */
+enum bverror gcbv_blt_batch(struct bvbltparams **bvbltparams,
+			    unsigned int count, struct sync_fence **fence)
+{
+	enum bverror bverror = BVERR_NONE;
+	struct bvbltparams *prev = NULL, *next = NULL;
+	struct bvbltparams end;
+	struct bvbatch *batch = NULL;
+	enum bverror enderror;
+	unsigned int i;
+
+	GCENTERARG(GCZONE_BLIT, "count = %d\n", count);
+
+	if (fence != NULL)
+		*fence = NULL;
+
+	if (count == 0)
+		goto exit;
+
+	/* A single blit is its own batch, unless it needs a fence. */
+	if ((count == 1) && (fence == NULL)) {
+		next = bvbltparams[0];
+		next->flags = (next->flags & ~BVFLAG_BATCH_MASK)
+			    | BVFLAG_BATCH_NONE;
+		bverror = bv_blt(next);
+		goto exit;
+	}
+
+	/* Queue the blits. */
+	for (i = 0; i < count; i += 1) {
+		next = bvbltparams[i];
+		next->flags &= ~BVFLAG_BATCH_MASK;
+
+		if (prev == NULL) {
+			next->flags |= BVFLAG_BATCH_BEGIN;
+			next->batch = NULL;
+		} else {
+			next->flags |= BVFLAG_BATCH_CONTINUE;
+			next->batch = batch;
+			next->batchflags = batch_changes(prev, next);
+		}
+
+		bverror = bv_blt(next);
+
+		if (prev == NULL)
+			batch = next->batch;
+
+		if (bverror != BVERR_NONE) {
+			GCERR("blit %d of %d failed (%d).\n",
+			      i, count, bverror);
+			break;
+		}
+
+		prev = next;
+	}
+
+	if (batch == NULL)
+		goto exit;
+
+	/* Submit what has been queued. Ending without a blit keeps the
+	 * end of the batch independent of the last entry succeeding. */
+	end = (prev != NULL) ? *prev : *next;
+	end.flags = (end.flags & ~BVFLAG_BATCH_MASK) | BVFLAG_BATCH_END;
+	end.batchflags = BVBATCH_ENDNOP;
+	end.batch = batch;
+	if (fence != NULL) {
+		end.flags |= BVFLAG_ASYNC;
+		((struct gcbatch *) batch)->fence = fence;
+	}
+
+	enderror = bv_blt(&end);
+	if (bverror == BVERR_NONE) {
+		bverror = enderror;
+		next->errdesc = end.errdesc;
+	}
+
+exit:
+	GCEXITARG(GCZONE_BLIT, "bv%s = %d\n",
+		  (bverror == BVERR_NONE) ? "result" : "error", bverror);
+	return bverror;
+}
+EXPORT_SYMBOL(gcbv_blt_batch);
+
 enum bverror bv_cache(struct bvcopparams *copparams)
 {
 	enum bverror bverror = BVERR_NONE;
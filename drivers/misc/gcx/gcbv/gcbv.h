@@ -166,6 +166,42 @@ struct gcfiltercache {
 	struct list_head list;			/* gcfilterkernel */
 };
 
+/* Kernel arrays of the VR engine; the shared array is used by the
+ * separable (two pass) filter and overlaps the other two. */
+enum gckernelarray {
+	GC_KERNEL_SHARED,
+	GC_KERNEL_HORIZONTAL,
+	GC_KERNEL_VERTICAL,
+
+	/* Number of kernel arrays. */
+	GC_KERNEL_COUNT
+};
+
+/* Kernel currently loaded into one of the arrays. */
+struct gckernelstate {
+	bool valid;
+	enum gcfiltertype type;
+	unsigned int kernelsize;
+	unsigned int scalefactor;
+};
+
+
+/*******************************************************************************
+ * Temporary buffers.
+ */
+
+enum gctempbuffer {
+	/* Intermediate image of the separable filter. */
+	GC_TEMP_TWOPASS,
+
+	/* Ping-pong intermediates of the multi-pass downscale. */
+	GC_TEMP_PRESCALE0,
+	GC_TEMP_PRESCALE1,
+
+	/* Number of temporary buffers. */
+	GC_TEMP_COUNT
+};
+
 
 /*******************************************************************************
  * Global data structure.
@@ -211,9 +247,9 @@ struct gccontext {
 	struct gcfilterkernel *loadedfilter;	/* gcfilterkernel */
 	struct gcfiltercache filtercache[GC_FILTER_COUNT][GC_TAP_COUNT];
 
-	/* Temporary buffer descriptor. */
-	struct bvbuffdesc *tmpbuffdesc;
-	void *tmpbuff;
+	/* Temporary buffer descriptors. */
+	struct bvbuffdesc *tmpbuffdesc[GC_TEMP_COUNT];
+	void *tmpbuff[GC_TEMP_COUNT];
 };
 
 
@@ -455,6 +491,9 @@ struct gcfilter {
 	/* Scale factors. */
 	unsigned int horscalefactor;
 	unsigned int verscalefactor;
+
+	/* Kernels loaded by this batch so far. */
+	struct gckernelstate loaded[GC_KERNEL_COUNT];
 };
 
 /* Batch header. */
@@ -485,6 +524,9 @@ struct gcbatch {
 	int dstoffsetX;
 	int dstoffsetY;
 
+	/* Mask of operation types (1 << gcbv_optype) in the batch. */
+	unsigned int opmask;
+
 #if GCDEBUG_ENABLE
 	/* Rectangle validation storage. */
 	struct bvrect prevdstrect;
@@ -502,6 +544,10 @@ struct gcbatch {
 	/* Scheduled implicit unmappings (gcschedunmap). */
 	struct list_head unmap;
 
+	/* If not NULL, the batch is submitted with a fence that is returned
+	 * here; NULL is returned if the submission failed. */
+	struct sync_fence **fence;
+
 	/* Batch linked list (gcbatch). */
 	struct list_head link;
 };
@@ -572,6 +618,7 @@ enum bverror claim_buffer(struct bvbltparams *bvbltparams,
 
 /* Temporary buffer management. */
 enum bverror allocate_temp(struct bvbltparams *bvbltparams,
+			   enum gctempbuffer index,
 			   unsigned int size);
 enum bverror free_temp(bool schedule);
 
@@ -0,0 +1,327 @@
+/*
+ * gcbvbench.c
+ *
+ * Copyright (C) 2010-2011 Vivante Corporation.
+ *
+ * This package is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * THIS PACKAGE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Reading the "bench" debugfs file runs a fixed set of synchronous blits
+ * (copy, fill, format conversion, 90 degree rotation, 2x filter and an 8:1
+ * thumbnail downscale) on surfaces of several sizes and reports the wall
+ * time and busy GPU cycles per operation.  Fill and copy results are
+ * verified against the CPU; the downscale is also timed on the CPU with a
+ * box filter for comparison.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include "gcbv.h"
+
+#define BENCH_ITERATIONS	10
+#define BENCH_PATTERN		0x80402010
+#define BENCH_MAX_SOURCE	2048
+
+struct bench_surface {
+	struct bvbuffdesc *desc;
+	void *buff;
+	struct bvsurfgeom geom;
+};
+
+struct bench_case {
+	const char *name;
+	enum gcbv_optype optype;
+	enum ocdformat srcformat;
+	unsigned int srcbpp;
+	int orientation;
+	unsigned int scale;
+	unsigned int shrink;
+	bool check;
+};
+
+static const struct bench_case bench_cases[] = {
+	{ "copy",    GCBV_OP_COPY,    OCDFMT_ARGB24, 4,  0, 1, 1, true  },
+	{ "fill",    GCBV_OP_FILL,    OCDFMT_ARGB24, 4,  0, 1, 1, true  },
+	{ "convert", GCBV_OP_CONVERT, OCDFMT_RGB16,  2,  0, 1, 1, false },
+	{ "rotate",  GCBV_OP_ROTATE,  OCDFMT_ARGB24, 4, 90, 1, 1, false },
+	{ "filter",  GCBV_OP_FILTER,  OCDFMT_ARGB24, 4,  0, 2, 1, false },
+	{ "thumb",   GCBV_OP_FILTER,  OCDFMT_ARGB24, 4,  0, 1, 8, false },
+};
+
+static const struct {
+	unsigned int width;
+	unsigned int height;
+} bench_sizes[] = {
+	{   64,   64 },
+	{  256,  256 },
+	{  512,  512 },
+	{ 1280,  720 },
+};
+
+static GCDEFINE_LOCK(bench_lock);
+
+static enum bverror bench_alloc(struct bench_surface *surface,
+				enum ocdformat format, unsigned int bpp,
+				unsigned int width, unsigned int height)
+{
+	enum bverror bverror;
+
+	bverror = allocate_surface(&surface->desc, &surface->buff,
+				   width * height * bpp);
+	if (bverror != BVERR_NONE)
+		return bverror;
+
+	bverror = bv_map(surface->desc);
+	if (bverror != BVERR_NONE) {
+		free_surface(surface->desc, surface->buff);
+		surface->desc = NULL;
+		return bverror;
+	}
+
+	memset(&surface->geom, 0, sizeof(surface->geom));
+	surface->geom.structsize = sizeof(surface->geom);
+	surface->geom.format = format;
+	surface->geom.width = width;
+	surface->geom.height = height;
+	surface->geom.virtstride = width * bpp;
+
+	return BVERR_NONE;
+}
+
+static void bench_free(struct bench_surface *surface)
+{
+	if (surface->desc == NULL)
+		return;
+
+	bv_unmap(surface->desc);
+	free_surface(surface->desc, surface->buff);
+	surface->desc = NULL;
+}
+
+static void bench_cacheop(struct bench_surface *surface,
+			  enum bvcacheop cacheop)
+{
+	struct c2dmrgn rgn;
+
+	rgn.start = surface->buff;
+	rgn.span = surface->geom.virtstride;
+	rgn.lines = surface->geom.height;
+	rgn.stride = surface->geom.virtstride;
+
+	gcbvcacheop(1, &rgn, cacheop);
+}
+
+static void bench_params(struct bvbltparams *bvbltparams,
+			 struct bench_surface *src,
+			 struct bench_surface *dst)
+{
+	memset(bvbltparams, 0, sizeof(*bvbltparams));
+	bvbltparams->structsize = sizeof(*bvbltparams);
+	bvbltparams->flags = BVFLAG_ROP;
+	bvbltparams->op.rop = 0xCCCC;
+	bvbltparams->scalemode = BVSCALE_FASTEST;
+
+	bvbltparams->src1.desc = src->desc;
+	bvbltparams->src1geom = &src->geom;
+	bvbltparams->src1rect.width = src->geom.width;
+	bvbltparams->src1rect.height = src->geom.height;
+
+	bvbltparams->dstdesc = dst->desc;
+	bvbltparams->dstgeom = &dst->geom;
+	bvbltparams->dstrect.width = dst->geom.width;
+	bvbltparams->dstrect.height = dst->geom.height;
+}
+
+static bool bench_check(struct bench_surface *src,
+			struct bench_surface *dst, bool fill)
+{
+	unsigned int *srcpixel = src->buff;
+	unsigned int *dstpixel = dst->buff;
+	unsigned int i, count;
+
+	count = dst->geom.width * dst->geom.height;
+	for (i = 0; i < count; i++)
+		if (dstpixel[i] != srcpixel[fill ? 0 : i])
+			return false;
+
+	return true;
+}
+
+/* Software reference for the downscale: average each shrink x shrink
+ * block of the source. */
+static void bench_cpu_shrink(struct bench_surface *src,
+			     struct bench_surface *dst, unsigned int shrink)
+{
+	unsigned int *srcpixel = src->buff;
+	unsigned int *dstpixel = dst->buff;
+	unsigned int count = shrink * shrink;
+	unsigned int sum[4];
+	unsigned int x, y, i, j, c, pixel;
+
+	for (y = 0; y < dst->geom.height; y++) {
+		for (x = 0; x < dst->geom.width; x++) {
+			memset(sum, 0, sizeof(sum));
+
+			for (j = 0; j < shrink; j++)
+				for (i = 0; i < shrink; i++) {
+					pixel = srcpixel[(y * shrink + j)
+						* src->geom.width
+						+ x * shrink + i];
+					for (c = 0; c < 4; c++)
+						sum[c] += (pixel >> (c * 8))
+							& 0xFF;
+				}
+
+			pixel = 0;
+			for (c = 0; c < 4; c++)
+				pixel |= (sum[c] / count) << (c * 8);
+
+			dstpixel[y * dst->geom.width + x] = pixel;
+		}
+	}
+}
+
+static void bench_run(struct seq_file *s, const struct bench_case *bench,
+		      unsigned int width, unsigned int height)
+{
+	struct bench_surface src = { NULL }, dst = { NULL };
+	struct bvbltparams bvbltparams;
+	struct gcbv_opstats before[GCBV_OP_COUNT], after[GCBV_OP_COUNT];
+	unsigned int srcwidth, srcheight;
+	unsigned int *pixel;
+	unsigned long long cycles, us;
+	ktime_t start;
+	enum bverror bverror;
+	unsigned int i;
+	bool valid = true;
+
+	/* Rotation is only measured on square surfaces. */
+	if ((bench->orientation != 0) && (width != height))
+		return;
+
+	if (bench->optype == GCBV_OP_FILL) {
+		srcwidth = 1;
+		srcheight = 1;
+	} else {
+		srcwidth = width * bench->shrink / bench->scale;
+		srcheight = height * bench->shrink / bench->scale;
+	}
+
+	/* Keep the downscale sources to a sane size. */
+	if ((srcwidth > BENCH_MAX_SOURCE) || (srcheight > BENCH_MAX_SOURCE))
+		return;
+
+	bverror = bench_alloc(&src, bench->srcformat, bench->srcbpp,
+			      srcwidth, srcheight);
+	if (bverror != BVERR_NONE)
+		goto exit;
+
+	bverror = bench_alloc(&dst, OCDFMT_ARGB24, 4, width, height);
+	if (bverror != BVERR_NONE)
+		goto exit;
+
+	dst.geom.orientation = bench->orientation;
+
+	pixel = src.buff;
+	for (i = 0; i < srcwidth * srcheight * bench->srcbpp / 4; i++)
+		pixel[i] = BENCH_PATTERN + i;
+
+	bench_cacheop(&src, DMA_TO_DEVICE);
+	bench_params(&bvbltparams, &src, &dst);
+
+	gcbv_debug_get_ops(before);
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		bverror = bv_blt(&bvbltparams);
+		if (bverror != BVERR_NONE)
+			goto exit;
+	}
+
+	gcbv_debug_get_ops(after);
+
+	if (bench->check) {
+		bench_cacheop(&dst, DMA_FROM_DEVICE);
+		valid = bench_check(&src, &dst,
+				    bench->optype == GCBV_OP_FILL);
+	}
+
+	cycles = after[bench->optype].cycles - before[bench->optype].cycles;
+	us = after[bench->optype].us - before[bench->optype].us;
+
+	seq_printf(s, "%8s %5ux%-5u %10llu %12llu %s\n",
+		   bench->name, width, height,
+		   div_u64(us, BENCH_ITERATIONS),
+		   div_u64(cycles, BENCH_ITERATIONS),
+		   bench->check ? (valid ? "ok" : "FAIL") : "-");
+
+	if (bench->shrink > 1) {
+		start = ktime_get();
+		for (i = 0; i < BENCH_ITERATIONS; i++)
+			bench_cpu_shrink(&src, &dst, bench->shrink);
+		us = ktime_us_delta(ktime_get(), start);
+
+		seq_printf(s, "%8s %5ux%-5u %10llu %12s %s\n",
+			   "cpu", width, height,
+			   div_u64(us, BENCH_ITERATIONS), "-", "-");
+	}
+
+exit:
+	if (bverror != BVERR_NONE)
+		seq_printf(s, "%8s %5ux%-5u failed (%d)\n",
+			   bench->name, width, height, bverror);
+
+	bench_free(&dst);
+	bench_free(&src);
+}
+
+static int bench_show(struct seq_file *s, void *data)
+{
+	bool profiling;
+	unsigned int i, j;
+
+	GCLOCK(&bench_lock);
+
+	/* Batch timing is only collected while profiling is enabled. */
+	profiling = gcbv_debug_profiling();
+	gcbv_debug_set_profiling(true);
+
+	seq_printf(s, "%8s %11s %10s %12s %s\n",
+		   "op", "size", "us", "cycles", "check");
+
+	for (i = 0; i < ARRAY_SIZE(bench_cases); i++)
+		for (j = 0; j < ARRAY_SIZE(bench_sizes); j++)
+			bench_run(s, &bench_cases[i],
+				  bench_sizes[j].width,
+				  bench_sizes[j].height);
+
+	gcbv_debug_set_profiling(profiling);
+
+	GCUNLOCK(&bench_lock);
+
+	return 0;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, 0);
+}
+
+static const struct file_operations fops_bench = {
+	.open = bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void gcbv_bench_init(struct dentry *debug_root)
+{
+	debugfs_create_file("bench", 0444, debug_root, NULL, &fops_bench);
+}
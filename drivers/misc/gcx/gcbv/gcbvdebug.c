@@ -14,6 +14,7 @@
 
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
 #include "gcbv.h"
 
 static struct dentry *debug_root;
@@ -198,6 +199,116 @@ static const struct file_operations fops_blt_stats = {
 
 /*****************************************************************************/
 
+static const char * const op_names[GCBV_OP_COUNT] = {
+	"copy", "fill", "filter", "rotate", "convert"
+};
+
+static DEFINE_SPINLOCK(op_lock);
+static struct gcbv_opstats op_stats[GCBV_OP_COUNT];
+static struct gcbv_opstats mixed_stats;
+static u32 op_profile;
+
+void gcbv_debug_op(enum gcbv_optype optype, unsigned int pixels,
+		   unsigned int bytes)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&op_lock, flags);
+	op_stats[optype].count++;
+	op_stats[optype].pixels += pixels;
+	op_stats[optype].bytes += bytes;
+	spin_unlock_irqrestore(&op_lock, flags);
+}
+
+bool gcbv_debug_profiling(void)
+{
+	return op_profile != 0;
+}
+
+void gcbv_debug_set_profiling(bool enable)
+{
+	op_profile = enable;
+}
+
+void gcbv_debug_batch(unsigned int opmask, struct gcprofile *gcprofile,
+		      unsigned long long us)
+{
+	struct gcbv_opstats *stats;
+	unsigned long flags;
+
+	if (opmask == 0)
+		return;
+
+	/* Time can only be attributed to batches of a single type. */
+	if (opmask & (opmask - 1))
+		stats = &mixed_stats;
+	else
+		stats = &op_stats[__ffs(opmask)];
+
+	spin_lock_irqsave(&op_lock, flags);
+	stats->batches++;
+	stats->cycles += gcprofile->cycles - gcprofile->idle;
+	stats->us += us;
+	spin_unlock_irqrestore(&op_lock, flags);
+}
+
+void gcbv_debug_get_ops(struct gcbv_opstats *opstats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&op_lock, flags);
+	memcpy(opstats, op_stats, sizeof(op_stats));
+	spin_unlock_irqrestore(&op_lock, flags);
+}
+
+static void op_stats_print(struct seq_file *s, const char *name,
+			   struct gcbv_opstats *stats)
+{
+	seq_printf(s, "%8s: %10llu %12llu %14llu %8llu %14llu %10llu\n",
+		   name, stats->count, stats->pixels, stats->bytes,
+		   stats->batches, stats->cycles, stats->us);
+}
+
+static int op_stats_show(struct seq_file *s, void *data)
+{
+	struct gcbv_opstats stats[GCBV_OP_COUNT];
+	struct gcbv_opstats mixed;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&op_lock, flags);
+	memcpy(stats, op_stats, sizeof(op_stats));
+	mixed = mixed_stats;
+	memset(op_stats, 0, sizeof(op_stats));
+	memset(&mixed_stats, 0, sizeof(mixed_stats));
+	spin_unlock_irqrestore(&op_lock, flags);
+
+	seq_printf(s, "%8s  %10s %12s %14s %8s %14s %10s\n",
+		   "op", "count", "pixels", "bytes",
+		   "batches", "cycles", "us");
+
+	for (i = 0; i < GCBV_OP_COUNT; i++)
+		op_stats_print(s, op_names[i], &stats[i]);
+
+	op_stats_print(s, "mixed", &mixed);
+
+	return 0;
+}
+
+static int op_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, op_stats_show, 0);
+}
+
+static const struct file_operations fops_op_stats = {
+	.open = op_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*****************************************************************************/
+
 void gcbv_debug_init(void)
 {
 	debug_root = debugfs_create_dir("gcbv", NULL);
@@ -208,6 +319,11 @@ void gcbv_debug_init(void)
 			    &fops_blt_stats);
 	debugfs_create_file("batch_finalize_reason", 0664, debug_root, NULL,
 			    &fops_bfr);
+	debugfs_create_file("op_stats", 0664, debug_root, NULL,
+			    &fops_op_stats);
+	debugfs_create_bool("profile", 0664, debug_root, &op_profile);
+
+	gcbv_bench_init(debug_root);
 }
 
 void gcbv_debug_shutdown(void)
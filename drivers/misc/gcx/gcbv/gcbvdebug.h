@@ -15,6 +15,8 @@
 #ifndef GCBVDEBUG_H
 #define GCBVDEBUG_H
 
+struct dentry;
+
 void gcbv_debug_init(void);
 void gcbv_debug_shutdown(void);
 
@@ -23,4 +25,45 @@ void gcbv_debug_finalize_batch(unsigned int reason);
 void gcbv_debug_blt(int srccount, int dstWidth, int dstHeight);
 void gcbv_debug_scaleblt(bool scalex, bool scaley, bool singlepass);
 
+/* Operation types tracked by the per-operation counters. */
+enum gcbv_optype {
+	GCBV_OP_COPY,
+	GCBV_OP_FILL,
+	GCBV_OP_FILTER,
+	GCBV_OP_ROTATE,
+	GCBV_OP_CONVERT,
+	GCBV_OP_COUNT
+};
+
+struct gcbv_opstats {
+	/* Operations and destination pixels processed. */
+	unsigned long long count;
+	unsigned long long pixels;
+
+	/* Estimated memory traffic in bytes. */
+	unsigned long long bytes;
+
+	/* Profiled batches containing only this operation type with
+	 * their busy GPU cycles and wall time in microseconds. */
+	unsigned long long batches;
+	unsigned long long cycles;
+	unsigned long long us;
+};
+
+void gcbv_debug_op(enum gcbv_optype optype, unsigned int pixels,
+		   unsigned int bytes);
+bool gcbv_debug_profiling(void);
+void gcbv_debug_set_profiling(bool enable);
+void gcbv_debug_batch(unsigned int opmask, struct gcprofile *gcprofile,
+		      unsigned long long us);
+void gcbv_debug_get_ops(struct gcbv_opstats *opstats);
+
+#if defined(CONFIG_GCBV_BENCH)
+void gcbv_bench_init(struct dentry *debug_root);
+#else
+static inline void gcbv_bench_init(struct dentry *debug_root)
+{
+}
+#endif
+
 #endif
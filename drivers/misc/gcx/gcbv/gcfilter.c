@@ -83,6 +83,13 @@ GCDBG_FILTERDEF(filter, GCZONE_NONE,
 #define GC_CACHELINE_ALIGN_16	(GC_BITS_PER_CACHELINE / 16 - 1)
 #define GC_CACHELINE_ALIGN_32	(GC_BITS_PER_CACHELINE / 32 - 1)
 
+/* Multi-pass downscale: the largest ratio a pass may reduce an axis by,
+ * the kernel the intermediate passes use and the width of the strips
+ * they render so that the source each strip reads stays in the cache. */
+#define GC_PRESCALE_MAX_RATIO	2
+#define GC_PRESCALE_KERNELSIZE	5
+#define GC_PRESCALE_STRIP	128
+
 enum gcscaletype {
 	GC_SCALE_OPF,
 	GC_SCALE_HOR,
@@ -485,6 +492,12 @@ static void calculate_sync_filter(struct gcfilterkernel *gcfilterkernel)
  * Loads a filter into the GPU.
  */
 
+static const struct gccmdldstate *kernelarraystate[GC_KERNEL_COUNT] = {
+	&gcmofilterkernel_shared_ldst,
+	&gcmofilterkernel_horizontal_ldst,
+	&gcmofilterkernel_vertical_ldst,
+};
+
 static enum bverror load_filter(struct bvbltparams *bvbltparams,
 				struct gcbatch *batch,
 				enum gcfiltertype type,
@@ -492,10 +505,11 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 				unsigned int scalefactor,
 				unsigned int srcsize,
 				unsigned int dstsize,
-				struct gccmdldstate arraystate)
+				enum gckernelarray array)
 {
 	enum bverror bverror = BVERR_NONE;
 	struct gccontext *gccontext = get_context();
+	struct gckernelstate *loaded = batch->op.filter.loaded;
 	struct gcfiltercache *filtercache;
 	struct list_head *filterlist;
 	struct list_head *filterhead;
@@ -507,7 +521,16 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 	GCDBG(GCZONE_KERNEL, "dstsize = %d\n", dstsize);
 	GCDBG(GCZONE_KERNEL, "scalefactor = 0x%08X\n", scalefactor);
 
-	/* Is the filter already loaded? */
+	/* Has this batch already loaded the same kernel into the array? */
+	if (loaded[array].valid &&
+	    (loaded[array].type == type) &&
+	    (loaded[array].kernelsize == kernelsize) &&
+	    (loaded[array].scalefactor == scalefactor)) {
+		GCDBG(GCZONE_KERNEL, "filter already in array %d.\n", array);
+		goto exit;
+	}
+
+	/* Is the filter already computed? */
 	if ((gccontext->loadedfilter != NULL) &&
 	    (gccontext->loadedfilter->type == type) &&
 	    (gccontext->loadedfilter->kernelsize == kernelsize) &&
@@ -589,7 +612,7 @@ load:
 	if (bverror != BVERR_NONE)
 		goto exit;
 
-	gcmofilterkernel->kernelarray_ldst = arraystate;
+	gcmofilterkernel->kernelarray_ldst = *kernelarraystate[array];
 	memcpy(&gcmofilterkernel->kernelarray,
 	       gcfilterkernel->kernelarray,
 	       sizeof(gcfilterkernel->kernelarray));
@@ -597,6 +620,19 @@ load:
 	/* Set the filter. */
 	gccontext->loadedfilter = gcfilterkernel;
 
+	/* The shared array overlaps the directional ones. */
+	if (array == GC_KERNEL_SHARED) {
+		loaded[GC_KERNEL_HORIZONTAL].valid = false;
+		loaded[GC_KERNEL_VERTICAL].valid = false;
+	} else {
+		loaded[GC_KERNEL_SHARED].valid = false;
+	}
+
+	loaded[array].valid = true;
+	loaded[array].type = type;
+	loaded[array].kernelsize = kernelsize;
+	loaded[array].scalefactor = scalefactor;
+
 exit:
 	return bverror;
 }
@@ -872,6 +908,245 @@ exit:
 }
 
 
+/*******************************************************************************
+ * Multi-pass downscale.
+ */
+
+static inline bool need_prescale(unsigned int srcsize, unsigned int dstsize)
+{
+	return srcsize > dstsize * GC_PRESCALE_MAX_RATIO;
+}
+
+static enum bverror prescale(struct bvbltparams *bvbltparams,
+			     struct gcbatch *batch,
+			     struct gcsurface *srcinfo,
+			     struct gcsurface *outinfo,
+			     unsigned int dstwidth,
+			     unsigned int dstheight)
+{
+	enum bverror bverror = BVERR_NONE;
+	struct gccontext *gccontext = get_context();
+	struct gcfilter *gcfilter;
+	struct gcsurface passinfo;
+	struct gcsurface *passsrc, *passdst;
+	struct bvbuffmap *srcmap = NULL;
+	struct bvbuffmap *dstmap = NULL;
+	struct gcmovrconfigex *gcmovrconfigex;
+	struct gcalpha *gca;
+	unsigned char srcglobalpremul;
+	struct gcrect dstrect;
+	enum gctempbuffer index;
+	unsigned int srcwidth, srcheight;
+	unsigned int passwidth, passheight;
+	unsigned int alignmask, tmpsize;
+	unsigned int srcx, srcy;
+	unsigned int x;
+	int passcount, pass;
+
+	GCENTER(GCZONE_FILTER);
+
+	/* Get a shortcut to the filter properties. */
+	gcfilter = &batch->op.filter;
+
+	/* The intermediate passes only resample, blending is left to the
+	 * final pass. */
+	gca = srcinfo->gca;
+	srcglobalpremul = srcinfo->srcglobalpremul;
+	srcinfo->gca = NULL;
+	srcinfo->srcglobalpremul
+		= GCREG_COLOR_MULTIPLY_MODES_SRC_GLOBAL_PREMULTIPLY_DISABLE;
+
+	/* The whole source rectangle is reduced, validate it. */
+	if (!valid_rect(srcinfo, &srcinfo->rect.orig)) {
+		BVSETBLTERROR((srcinfo->index == 0)
+					? BVERR_SRC1RECT
+					: BVERR_SRC2RECT,
+			      "invalid source rectangle.");
+		goto exit;
+	}
+
+	srcwidth  = srcinfo->rect.orig.right  - srcinfo->rect.orig.left;
+	srcheight = srcinfo->rect.orig.bottom - srcinfo->rect.orig.top;
+
+	/* Count the passes needed to bring the ratio down to what
+	 * a single pass can filter. */
+	passcount = 0;
+	passwidth = srcwidth;
+	passheight = srcheight;
+	while (need_prescale(passwidth, dstwidth) ||
+	       need_prescale(passheight, dstheight)) {
+		if (need_prescale(passwidth, dstwidth))
+			passwidth = DIV_ROUND_UP(passwidth,
+						 GC_PRESCALE_MAX_RATIO);
+		if (need_prescale(passheight, dstheight))
+			passheight = DIV_ROUND_UP(passheight,
+						  GC_PRESCALE_MAX_RATIO);
+		passcount += 1;
+	}
+
+	GCDBG(GCZONE_TYPE, "prescale in %d pass(es)\n", passcount);
+
+	/* Map the source. */
+	bverror = do_map(srcinfo->buf.desc, batch, &srcmap);
+	if (bverror != BVERR_NONE) {
+		bvbltparams->errdesc = gccontext->bverrorstr;
+		goto exit;
+	}
+
+	/* Set kernel size. */
+	bverror = claim_buffer(bvbltparams, batch,
+			       sizeof(struct gcmovrconfigex),
+			       (void **) &gcmovrconfigex);
+	if (bverror != BVERR_NONE)
+		goto exit;
+
+	gcmovrconfigex->config_ldst = gcmovrconfigex_config_ldst;
+	gcmovrconfigex->config.raw = ~0U;
+	gcmovrconfigex->config.reg.kernelsize = GC_PRESCALE_KERNELSIZE;
+	gcmovrconfigex->config.reg.mask_kernelsize
+		= GCREG_VR_CONFIG_EX_MASK_FILTER_TAP_ENABLED;
+
+	passsrc = srcinfo;
+	for (pass = 0; pass < passcount; pass += 1) {
+		/* Alternate the intermediate surfaces so that the last
+		 * pass lands in the output one. */
+		if (((passcount - pass) & 1) != 0) {
+			passdst = outinfo;
+			index = GC_TEMP_PRESCALE0;
+		} else {
+			passdst = &passinfo;
+			index = GC_TEMP_PRESCALE1;
+		}
+
+		passwidth = need_prescale(srcwidth, dstwidth)
+			  ? DIV_ROUND_UP(srcwidth, GC_PRESCALE_MAX_RATIO)
+			  : srcwidth;
+		passheight = need_prescale(srcheight, dstheight)
+			   ? DIV_ROUND_UP(srcheight, GC_PRESCALE_MAX_RATIO)
+			   : srcheight;
+
+		GCDBG(GCZONE_FILTER, "pass %d: %dx%d --> %dx%d\n",
+		      pass, srcwidth, srcheight, passwidth, passheight);
+
+		/* Describe the intermediate surface. */
+		memset(passdst, 0, sizeof(struct gcsurface));
+		passdst->index = srcinfo->index;
+		passdst->mirror = GCREG_MIRROR_NONE;
+		passdst->rop = 0xCC;
+		passdst->srcglobalpremul
+			= GCREG_COLOR_MULTIPLY_MODES_SRC_GLOBAL_PREMULTIPLY_DISABLE;
+
+		if (srcinfo->format.type == BVFMT_YUV)
+			parse_format(bvbltparams, OCDFMT_YUYV,
+				     &passdst->format);
+		else
+			passdst->format = srcinfo->format;
+
+		alignmask = GC_BITS_PER_CACHELINE / passdst->format.bitspp - 1;
+
+		passdst->width = passwidth;
+		passdst->height = passheight;
+		passdst->physwidth = (passwidth + alignmask) & ~alignmask;
+		passdst->physheight = passheight;
+		passdst->stride1 = (passdst->physwidth
+				 *  passdst->format.bitspp) / 8;
+
+		passdst->rect.orig.left = 0;
+		passdst->rect.orig.top = 0;
+		passdst->rect.orig.right = passwidth;
+		passdst->rect.orig.bottom = passheight;
+		passdst->rect.clip = passdst->rect.orig;
+		passdst->rect.adj = passdst->rect.orig;
+
+		tmpsize = passdst->stride1 * passdst->physheight;
+		tmpsize += GC_BYTES_PER_CACHELINE;
+		tmpsize = (tmpsize + ~PAGE_MASK) & PAGE_MASK;
+		GCDBG(GCZONE_FILTER, "tmp stride = %d\n", passdst->stride1);
+		GCDBG(GCZONE_FILTER, "tmp size (bytes) = %d\n", tmpsize);
+
+		/* Allocate and map the intermediate buffer. */
+		bverror = allocate_temp(bvbltparams, index, tmpsize);
+		if (bverror != BVERR_NONE)
+			goto exit;
+
+		passdst->buf.desc = gccontext->tmpbuffdesc[index];
+		bverror = do_map(passdst->buf.desc, batch, &dstmap);
+		if (bverror != BVERR_NONE) {
+			bvbltparams->errdesc = gccontext->bverrorstr;
+			goto exit;
+		}
+
+		passdst->bytealign1 = (get_pixel_offset(passdst, 0)
+				    * (int) passdst->format.bitspp) / 8;
+
+		/* Load the kernels. */
+		gcfilter->horscalefactor = get_scale_factor(srcwidth,
+							    passwidth);
+		gcfilter->verscalefactor = get_scale_factor(srcheight,
+							    passheight);
+
+		bverror = load_filter(bvbltparams, batch,
+				      GC_FILTER_SYNC,
+				      GC_PRESCALE_KERNELSIZE,
+				      gcfilter->horscalefactor,
+				      srcwidth, passwidth,
+				      GC_KERNEL_HORIZONTAL);
+		if (bverror != BVERR_NONE)
+			goto exit;
+
+		bverror = load_filter(bvbltparams, batch,
+				      GC_FILTER_SYNC,
+				      GC_PRESCALE_KERNELSIZE,
+				      gcfilter->verscalefactor,
+				      srcheight, passheight,
+				      GC_KERNEL_VERTICAL);
+		if (bverror != BVERR_NONE)
+			goto exit;
+
+		/* Render the pass in vertical strips. */
+		srcy = (passsrc->rect.orig.top << 16) + 0x00008000;
+		for (x = 0; x < passwidth; x += GC_PRESCALE_STRIP) {
+			dstrect.left = x;
+			dstrect.top = 0;
+			dstrect.right = min(x + GC_PRESCALE_STRIP, passwidth);
+			dstrect.bottom = passheight;
+
+			srcx = (passsrc->rect.orig.left << 16)
+			     + x * gcfilter->horscalefactor + 0x00008000;
+
+			bverror = startvr(bvbltparams, batch,
+					  srcmap, dstmap, passsrc, passdst,
+					  srcx, srcy, &dstrect,
+					  ROT_ANGLE_0, ROT_ANGLE_0,
+					  GC_SCALE_OPF);
+			if (bverror != BVERR_NONE)
+				goto exit;
+		}
+
+		passsrc = passdst;
+		srcmap = dstmap;
+		srcwidth = passwidth;
+		srcheight = passheight;
+	}
+
+	/* Hand the blending over to the final pass. */
+	outinfo->gca = gca;
+	outinfo->globalcolorenable = srcinfo->globalcolorenable;
+	outinfo->globalcolor = srcinfo->globalcolor;
+	outinfo->srcglobalpremul = srcglobalpremul;
+	outinfo->srcglobalmode = srcinfo->srcglobalmode;
+	outinfo->dstglobalmode = srcinfo->dstglobalmode;
+
+exit:
+	srcinfo->gca = gca;
+	srcinfo->srcglobalpremul = srcglobalpremul;
+
+	GCEXITARG(GCZONE_FILTER, "bv%s = %d\n",
+		  (bverror == BVERR_NONE) ? "result" : "error", bverror);
+	return bverror;
+}
+
+
 /*******************************************************************************
  * Main fiter entry.
  */
@@ -885,6 +1160,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 
 	struct gcfilter *gcfilter;
 	struct gcsurface *dstinfo;
+	struct gcsurface preinfo;
 
 	bool scalex, scaley;
 	bool singlepass, twopass;
@@ -1024,6 +1300,29 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 	GCDBG(GCZONE_FILTER, "adjusted input dst size: %dx%d\n",
 	      dstwidth, dstheight);
 
+	/* The kernel only spans a few source pixels, so a large downscale
+	 * skips most of the source and aliases. Reduce the source in
+	 * intermediate passes first and continue from the reduced image. */
+	if ((max(gcfilter->horkernelsize, gcfilter->verkernelsize) > 1) &&
+	    (angle == ROT_ANGLE_0) &&
+	    (srcinfo->mirror == GCREG_MIRROR_NONE) &&
+	    (need_prescale(srcwidth, dstwidth) ||
+	     need_prescale(srcheight, dstheight))) {
+		bverror = prescale(bvbltparams, batch, srcinfo, &preinfo,
+				   dstwidth, dstheight);
+		if (bverror != BVERR_NONE)
+			goto exit;
+
+		srcinfo = &preinfo;
+		srcorig = &srcinfo->rect.orig;
+		srcclip = &srcinfo->rect.clip;
+
+		srcwidth  = srcorig->right  - srcorig->left;
+		srcheight = srcorig->bottom - srcorig->top;
+		GCDBG(GCZONE_FILTER, "prescaled src size: %dx%d\n",
+		      srcwidth, srcheight);
+	}
+
 	/* Determine the data path. */
 	scalex = (srcwidth  != dstwidth);
 	scaley = (srcheight != dstheight);
@@ -1170,7 +1469,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 				      gcfilter->horkernelsize,
 				      gcfilter->horscalefactor,
 				      srcwidth, dstwidth,
-				      gcmofilterkernel_horizontal_ldst);
+				      GC_KERNEL_HORIZONTAL);
 		if (bverror != BVERR_NONE)
 			goto exit;
 
@@ -1180,7 +1479,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 				      gcfilter->verkernelsize,
 				      gcfilter->verscalefactor,
 				      srcheight, dstheight,
-				      gcmofilterkernel_vertical_ldst);
+				      GC_KERNEL_VERTICAL);
 		if (bverror != BVERR_NONE)
 			goto exit;
 
@@ -1336,12 +1635,12 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 		GCDBG(GCZONE_FILTER, "tmp size (bytes) = %d\n", tmpsize);
 
 		/* Allocate the temporary buffer. */
-		bverror = allocate_temp(bvbltparams, tmpsize);
+		bverror = allocate_temp(bvbltparams, GC_TEMP_TWOPASS, tmpsize);
 		if (bverror != BVERR_NONE)
 			goto exit;
 
 		/* Map the temporary buffer. */
-		tmpinfo.buf.desc = gccontext->tmpbuffdesc;
+		tmpinfo.buf.desc = gccontext->tmpbuffdesc[GC_TEMP_TWOPASS];
 		bverror = do_map(tmpinfo.buf.desc, batch, &tmpmap);
 		if (bverror != BVERR_NONE) {
 			bvbltparams->errdesc = gccontext->bverrorstr;
@@ -1365,7 +1664,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 				      gcfilter->verkernelsize,
 				      gcfilter->verscalefactor,
 				      srcheight, dstheight,
-				      gcmofilterkernel_shared_ldst);
+				      GC_KERNEL_SHARED);
 		if (bverror != BVERR_NONE)
 			goto exit;
 
@@ -1418,7 +1717,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 				      gcfilter->horkernelsize,
 				      gcfilter->horscalefactor,
 				      srcwidth, dstwidth,
-				      gcmofilterkernel_shared_ldst);
+				      GC_KERNEL_SHARED);
 		if (bverror != BVERR_NONE)
 			goto exit;
 
@@ -1449,7 +1748,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 					      gcfilter->horkernelsize,
 					      gcfilter->horscalefactor,
 					      srcwidth, dstwidth,
-					      gcmofilterkernel_shared_ldst);
+					      GC_KERNEL_SHARED);
 			if (bverror != BVERR_NONE)
 				goto exit;
 
@@ -1468,7 +1767,7 @@ enum bverror do_filter(struct bvbltparams *bvbltparams,
 					      gcfilter->verkernelsize,
 					      gcfilter->verscalefactor,
 					      srcheight, dstheight,
-					      gcmofilterkernel_shared_ldst);
+					      GC_KERNEL_SHARED);
 			if (bverror != BVERR_NONE)
 				goto exit;
 
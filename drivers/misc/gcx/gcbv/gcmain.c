@@ -213,18 +213,9 @@ enum bverror gcbvcacheop(int count, struct c2dmrgn rgn[],
 	switch (cacheop) {
 
 	case DMA_FROM_DEVICE:
-		c2dm_l2cache(count, rgn, cacheop);
-		c2dm_l1cache(count, rgn, cacheop);
-		break;
-
 	case DMA_TO_DEVICE:
-		c2dm_l1cache(count, rgn, cacheop);
-		c2dm_l2cache(count, rgn, cacheop);
-		break;
-
 	case DMA_BIDIRECTIONAL:
-		c2dm_l1cache(count, rgn, cacheop);
-		c2dm_l2cache(count, rgn, cacheop);
+		c2dm_cache(count, rgn, cacheop);
 		break;
 
 	default:
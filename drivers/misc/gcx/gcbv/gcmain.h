@@ -20,6 +20,7 @@
 #include <linux/vmalloc.h>
 #include <linux/dma-mapping.h>
 #include <linux/list.h>
+#include <linux/ktime.h>
 #include <linux/gcx.h>
 #include <linux/gcioctl.h>
 #include <linux/gccore.h>
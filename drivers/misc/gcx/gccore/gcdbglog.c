@@ -1841,6 +1841,7 @@ void gc_dump_mmu(struct gcdbgfilter *filter, unsigned int zone,
 
 	GCDUMPARENAS(zone, "vacant arenas", &gcmmucontext->vacant);
 	GCDUMPARENAS(zone, "allocated arenas", &gcmmucontext->allocated);
+	GCDUMPARENAS(zone, "cached arenas", &gcmmucontext->cached);
 
 	gc_dump_string(filter, zone,
 		       "*** MMU DUMP ***\n");
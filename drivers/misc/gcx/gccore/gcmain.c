@@ -512,7 +512,76 @@ void gc_caps(struct gcicaps *gcicaps)
 	gcicaps->gcerror = GCERR_NONE;
 }
 
-void gc_commit(struct gcicommit *gcicommit, bool fromuser)
+/* Sample GPU activity since the previous sample and restart the counters.
+ * Counters can only be accessed while the GPU is powered; the sample is
+ * zeroed otherwise. */
+static void sample_profile(struct gccorecontext *gccorecontext,
+			   struct gcprofile *gcprofile)
+{
+	GCLOCK(&gccorecontext->powerlock);
+
+	if (gccorecontext->gcpower == GCPWR_ON) {
+		gcprofile->cycles = gc_read_reg(GC_TOTAL_CYCLES_Address);
+		gcprofile->idle = gc_read_reg(GC_TOTAL_IDLE_CYCLES_Address);
+		gcprofile->reads = gc_read_reg(GC_TOTAL_READS_Address);
+		gcprofile->writes = gc_read_reg(GC_TOTAL_WRITES_Address);
+
+		/* Writing the cycle counter resets the idle counter too. */
+		gc_write_reg(GC_TOTAL_CYCLES_Address, 0);
+		gc_write_reg(GC_RESET_MEM_COUNTERS_Address, 1);
+		gc_write_reg(GC_RESET_MEM_COUNTERS_Address, 0);
+	} else {
+		memset(gcprofile, 0, sizeof(struct gcprofile));
+	}
+
+	GCUNLOCK(&gccorecontext->powerlock);
+}
+
+/* Signal the fence of a completed commit. */
+static void signal_fence(void *callbackparam)
+{
+	struct gccorecontext *gccorecontext = callbackparam;
+
+	sw_sync_timeline_inc(gccorecontext->timeline, 1);
+}
+
+/* Schedule a fence to be signaled when the GPU reaches the current point
+ * of the queue. Commits retire in order, so fence values do too. */
+static enum gcerror create_fence(struct gccorecontext *gccorecontext,
+				 struct gcmmucontext *gcmmucontext,
+				 struct sync_fence **fence)
+{
+	enum gcerror gcerror;
+	struct sync_pt *pt;
+
+	if (gccorecontext->timeline == NULL)
+		return GCERR_CMD_FENCE;
+
+	pt = sw_sync_pt_create(gccorecontext->timeline,
+			       gccorecontext->fenceseqno + 1);
+	if (pt == NULL)
+		return GCERR_CMD_FENCE;
+
+	*fence = sync_fence_create("gcx", pt);
+	if (*fence == NULL) {
+		sync_pt_free(pt);
+		return GCERR_CMD_FENCE;
+	}
+
+	gcerror = gcqueue_callback(gccorecontext, gcmmucontext,
+				   signal_fence, gccorecontext);
+	if (gcerror != GCERR_NONE) {
+		sync_fence_put(*fence);
+		*fence = NULL;
+		return gcerror;
+	}
+
+	gccorecontext->fenceseqno += 1;
+	return GCERR_NONE;
+}
+
+static void commit(struct gcicommit *gcicommit, bool fromuser,
+		   struct gcprofile *gcprofile)
 {
 	struct gccorecontext *gccorecontext = &g_context;
 	struct gcmmucontext *gcmmucontext;
@@ -526,6 +595,8 @@ void gc_commit(struct gcicommit *gcicommit, bool fromuser)
 
 	GCENTER(GCZONE_COMMIT);
 
+	gcicommit->syncfence = NULL;
+
 	GCLOCK(&gccorecontext->mmucontextlock);
 
 	/* Validate pipe values. */
@@ -633,6 +704,14 @@ void gc_commit(struct gcicommit *gcicommit, bool fromuser)
 			goto exit;
 	}
 
+	/* Add the fence. */
+	if (gcicommit->fence) {
+		gcicommit->gcerror = create_fence(gccorecontext, gcmmucontext,
+						  &gcicommit->syncfence);
+		if (gcicommit->gcerror != GCERR_NONE)
+			goto exit;
+	}
+
 	/* Process unmappings. */
 	list_for_each(head, &gcicommit->unmap) {
 		gcschedunmap = list_entry(head, struct gcschedunmap, link);
@@ -647,15 +726,46 @@ void gc_commit(struct gcicommit *gcicommit, bool fromuser)
 	gcicommit->gcerror = gcqueue_execute(gccorecontext, false,
 					     gcicommit->asynchronous);
 
+	/* Sample the counters while the GPU is still awake. */
+	if ((gcprofile != NULL) && (gcicommit->gcerror == GCERR_NONE))
+		sample_profile(gccorecontext, gcprofile);
+
 exit:
+	/* The fence still signals, but the caller does not get it. */
+	if ((gcicommit->gcerror != GCERR_NONE) &&
+	    (gcicommit->syncfence != NULL)) {
+		sync_fence_put(gcicommit->syncfence);
+		gcicommit->syncfence = NULL;
+	}
+
 	GCUNLOCK(&gccorecontext->mmucontextlock);
 
 	GCEXITARG(GCZONE_COMMIT, "gc%s = 0x%08X\n",
 		(gcicommit->gcerror == GCERR_NONE) ? "result" : "error",
 		gcicommit->gcerror);
 }
+
+void gc_commit(struct gcicommit *gcicommit, bool fromuser)
+{
+	commit(gcicommit, fromuser, NULL);
+}
 EXPORT_SYMBOL(gc_commit);
 
+void gc_commit_profile(struct gcicommit *gcicommit,
+		       struct gcprofile *gcprofile)
+{
+	memset(gcprofile, 0, sizeof(struct gcprofile));
+
+	/* The counters only cover the commit once it has finished. */
+	if (gcicommit->asynchronous) {
+		commit(gcicommit, false, NULL);
+		return;
+	}
+
+	commit(gcicommit, false, gcprofile);
+}
+EXPORT_SYMBOL(gc_commit_profile);
+
 void gc_map(struct gcimap *gcimap, bool fromuser)
 {
 	struct gccorecontext *gccorecontext = &g_context;
@@ -1028,6 +1138,11 @@ static int gc_init(struct gccorecontext *gccorecontext)
 		goto fail;
 	}
 
+	/* Create the fence timeline; fences are not available without it. */
+	gccorecontext->timeline = sw_sync_timeline_create("gcx");
+	if (gccorecontext->timeline == NULL)
+		GCERR("failed to create fence timeline.\n");
+
 	/* Create debugfs entry. */
 	gc_debug_init();
 
@@ -1050,6 +1165,11 @@ static void gc_exit(struct gccorecontext *gccorecontext)
 		/* Stop command queue thread. */
 		gcqueue_stop(gccorecontext);
 
+		if (gccorecontext->timeline != NULL) {
+			sync_timeline_destroy(&gccorecontext->timeline->obj);
+			gccorecontext->timeline = NULL;
+		}
+
 		/* Destroy MMU. */
 		destroy_mmu_context(gccorecontext);
 		gcmmu_exit(gccorecontext);
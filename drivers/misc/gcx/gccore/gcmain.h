@@ -17,6 +17,7 @@
 
 #include <linux/gcx.h>
 #include <linux/gccore.h>
+#include <linux/sw_sync.h>
 #include "gcmmu.h"
 
 #define GC_DEV_NAME	"gccore"
@@ -91,6 +92,11 @@ struct gccorecontext {
 	int opp_count;
 	unsigned long *opp_freqs;
 	unsigned long  cur_freq;
+
+	/* Fence timeline; advances as fenced commits complete, in order.
+	 * fenceseqno is the value of the most recently created fence. */
+	struct sw_sync_timeline *timeline;
+	unsigned int fenceseqno;
 };
 
 
@@ -398,6 +398,283 @@ static void release_physical_pages(struct gcmmuarena *arena)
 	}
 }
 
+/*******************************************************************************
+ * Mapping cache.
+ */
+
+/* Free the page table entries and the address range of an arena that has
+ * already been taken off the allocated or cached list. */
+static void free_arena(struct gccorecontext *gccorecontext,
+		       struct gcmmucontext *gcmmucontext,
+		       struct gcmmuarena *allocated)
+{
+	struct gcmmu *gcmmu = &gccorecontext->gcmmu;
+	struct list_head *allochead, *prevhead, *nexthead;
+	struct gcmmuarena *prevvacant, *nextvacant = NULL;
+	struct gcmmustlb *slave;
+	unsigned int *stlblogical;
+	union gcmmuloc index;
+	unsigned int i, freed, count;
+
+	allochead = &allocated->link;
+
+	/*
+	 * Free slave tables.
+	 */
+
+	index.absolute = allocated->start.absolute;
+	slave = &gcmmucontext->slave[index.loc.mtlb];
+	count = allocated->count;
+
+	while (count > 0) {
+		/* Determine the number of entries freed. */
+		freed = GCMMU_STLB_ENTRY_NUM - index.loc.stlb;
+		if (freed > count)
+			freed = count;
+
+		GCDBG(GCZONE_MAPPING, "freeing %d pages at %d.%d\n",
+			freed, index.loc.mtlb, index.loc.stlb);
+
+		/* Free slave entries. */
+		stlblogical = &slave->logical[index.loc.stlb];
+		for (i = 0; i < freed; i += 1)
+			*stlblogical++ = GCMMU_STLB_ENTRY_VACANT;
+
+		/* Flush CPU cache. */
+		gc_flush_region(slave->physical, slave->logical,
+				index.loc.stlb * sizeof(unsigned int),
+				freed * sizeof(unsigned int));
+
+		/* Advance. */
+		slave += 1;
+		index.absolute += freed;
+		count -= freed;
+	}
+
+	/*
+	 * Delete page cache for the arena.
+	 */
+
+	release_physical_pages(allocated);
+
+	/*
+	 * Find point of insertion and free the arena.
+	 */
+
+	GCDBG(GCZONE_MAPPING,
+		"looking for the point of insertion.\n");
+
+	list_for_each(nexthead, &gcmmucontext->vacant) {
+		nextvacant = list_entry(nexthead, struct gcmmuarena, link);
+		if (nextvacant->start.absolute >= allocated->end.absolute) {
+			GCDBG(GCZONE_MAPPING, "  point of insertion found.\n");
+			break;
+		}
+	}
+
+	/* Get the previous vacant entry. */
+	prevhead = nexthead->prev;
+
+	/* Merge the area back into vacant list. */
+	if (siblings(&gcmmucontext->vacant, prevhead, allochead)) {
+		if (siblings(&gcmmucontext->vacant, allochead, nexthead)) {
+			prevvacant = list_entry(prevhead, struct gcmmuarena,
+						link);
+
+			GCDBG(GCZONE_MAPPING, "merging three arenas:\n");
+
+			GCDUMPARENA(GCZONE_ARENA, "previous arena", prevvacant);
+			GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
+			GCDUMPARENA(GCZONE_ARENA, "next arena", nextvacant);
+
+			/* Merge all three arenas. */
+			prevvacant->count += allocated->count;
+			prevvacant->count += nextvacant->count;
+			prevvacant->end.absolute = nextvacant->end.absolute;
+
+			/* Free the merged arenas. */
+			GCLOCK(&gcmmu->lock);
+			list_move(allochead, &gcmmu->vacarena);
+			list_move(nexthead, &gcmmu->vacarena);
+			GCUNLOCK(&gcmmu->lock);
+		} else {
+			prevvacant = list_entry(prevhead, struct gcmmuarena,
+						link);
+
+			GCDBG(GCZONE_MAPPING, "merging with the previous:\n");
+
+			GCDUMPARENA(GCZONE_ARENA, "previous arena", prevvacant);
+			GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
+
+			/* Merge with the previous. */
+			prevvacant->count += allocated->count;
+			prevvacant->end.absolute = allocated->end.absolute;
+
+			/* Free the merged arena. */
+			GCLOCK(&gcmmu->lock);
+			list_move(allochead, &gcmmu->vacarena);
+			GCUNLOCK(&gcmmu->lock);
+		}
+	} else if (siblings(&gcmmucontext->vacant, allochead, nexthead)) {
+		GCDBG(GCZONE_MAPPING, "merged with the next:\n");
+
+		GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
+		GCDUMPARENA(GCZONE_ARENA, "next arena", nextvacant);
+
+		/* Merge with the next arena. */
+		nextvacant->start.absolute = allocated->start.absolute;
+		nextvacant->count += allocated->count;
+
+		/* Free the merged arena. */
+		GCLOCK(&gcmmu->lock);
+		list_move(allochead, &gcmmu->vacarena);
+		GCUNLOCK(&gcmmu->lock);
+	} else {
+		GCDBG(GCZONE_MAPPING,
+		      "nothing to merge with, inserting in between:\n");
+		GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
+
+		/* Neighbor vacant arenas are not siblings, can't merge. */
+		list_move(allochead, prevhead);
+	}
+
+	/* Invalidate the MMU. */
+	gcmmucontext->dirty = true;
+}
+
+/* Mark user memory arenas overlapping the range as stale. */
+static void mark_stale(struct list_head *arenalist,
+		       unsigned long start, unsigned long end)
+{
+	struct gcmmuarena *arena;
+	unsigned long base;
+
+	list_for_each_entry(arena, arenalist, link) {
+		if (arena->pages == NULL)
+			continue;
+
+		base = (unsigned long) arena->logical;
+		if ((base < end) &&
+		    (base + arena->count * GCMMU_PAGE_SIZE > start))
+			arena->stale = true;
+	}
+}
+
+static void gcmmu_invalidate_range_start(struct mmu_notifier *mn,
+					 struct mm_struct *mm,
+					 unsigned long start,
+					 unsigned long end)
+{
+	struct gcmmucontext *gcmmucontext;
+
+	gcmmucontext = container_of(mn, struct gcmmucontext, notifier);
+
+	/* The context lock may be held while faulting the client pages in,
+	 * only the list lock can be taken here. */
+	spin_lock(&gcmmucontext->cachelock);
+	mark_stale(&gcmmucontext->allocated, start, end);
+	mark_stale(&gcmmucontext->cached, start, end);
+	spin_unlock(&gcmmucontext->cachelock);
+}
+
+static void gcmmu_release(struct mmu_notifier *mn, struct mm_struct *mm)
+{
+	gcmmu_invalidate_range_start(mn, mm, 0, ~0UL);
+}
+
+static const struct mmu_notifier_ops gcmmu_notifier_ops = {
+	.release = gcmmu_release,
+	.invalidate_range_start = gcmmu_invalidate_range_start,
+};
+
+/* Find a cached arena mapping the same memory and move it back to the
+ * allocated list; called with the context lock held. */
+static struct gcmmuarena *find_cached(struct gcmmucontext *gcmmucontext,
+				      struct gcmmuphysmem *mem)
+{
+	struct gcmmuarena *arena;
+	struct gcmmustlb *slave;
+	union gcmmuloc index;
+	unsigned int i;
+
+	spin_lock(&gcmmucontext->cachelock);
+
+	list_for_each_entry(arena, &gcmmucontext->cached, link) {
+		if (arena->stale || (arena->count != mem->count) ||
+		    ((arena->address & GCMMU_OFFSET_MASK) !=
+		     (mem->offset & GCMMU_OFFSET_MASK)))
+			continue;
+
+		if (mem->pages == NULL) {
+			/* User memory is matched by its address; the
+			 * notifier takes care of the address space
+			 * changing underneath. */
+			if (!arena->physical &&
+			    (arena->logical == (void *) mem->base) &&
+			    (current->mm == gcmmucontext->mm))
+				goto found;
+
+			continue;
+		}
+
+		if (!arena->physical)
+			continue;
+
+		/* Physical memory is matched by the page table contents. */
+		index.absolute = arena->start.absolute;
+		for (i = 0; i < mem->count; i += 1) {
+			slave = &gcmmucontext->slave[index.loc.mtlb];
+			if ((slave->logical[index.loc.stlb] ^ mem->pages[i])
+			    & GCMMU_STLB_ADDRESS_MASK)
+				break;
+
+			index.absolute += 1;
+		}
+
+		if (i == mem->count)
+			goto found;
+	}
+
+	spin_unlock(&gcmmucontext->cachelock);
+	return NULL;
+
+found:
+	list_move(&arena->link, &gcmmucontext->allocated);
+	spin_unlock(&gcmmucontext->cachelock);
+
+	gcmmucontext->cachedcount -= 1;
+	return arena;
+}
+
+/* Free stale cached arenas and the least recently used ones above the
+ * limit; called with the context lock held. */
+static void trim_cache(struct gccorecontext *gccorecontext,
+		       struct gcmmucontext *gcmmucontext,
+		       unsigned int limit)
+{
+	struct gcmmuarena *arena, *temp;
+	unsigned int count = 0;
+	bool evict;
+
+	list_for_each_entry_safe(arena, temp, &gcmmucontext->cached, link) {
+		spin_lock(&gcmmucontext->cachelock);
+		evict = arena->stale || (count >= limit);
+		if (evict)
+			list_del_init(&arena->link);
+		spin_unlock(&gcmmucontext->cachelock);
+
+		if (!evict) {
+			count += 1;
+			continue;
+		}
+
+		GCDUMPARENA(GCZONE_ARENA, "evicting cached arena", arena);
+		free_arena(gccorecontext, gcmmucontext, arena);
+		gcmmucontext->cachedcount -= 1;
+	}
+}
+
+
 /*******************************************************************************
  * MMU management API.
  */
@@ -491,6 +768,8 @@ enum gcerror gcmmu_create_context(struct gccorecontext *gccorecontext,
 	/* Initialize arena lists. */
 	INIT_LIST_HEAD(&gcmmucontext->vacant);
 	INIT_LIST_HEAD(&gcmmucontext->allocated);
+	INIT_LIST_HEAD(&gcmmucontext->cached);
+	spin_lock_init(&gcmmucontext->cachelock);
 
 	/* Mark context as dirty. */
 	gcmmucontext->dirty = true;
@@ -573,7 +852,17 @@ enum gcerror gcmmu_destroy_context(struct gccorecontext *gccorecontext,
 	if (gcerror != GCERR_NONE)
 		goto exit;
 
-	/* Free allocated arenas. */
+	/* Stop tracking the client address space. */
+	if (gcmmucontext->mm != NULL) {
+		mmu_notifier_unregister(&gcmmucontext->notifier,
+					gcmmucontext->mm);
+		gcmmucontext->mm = NULL;
+	}
+
+	/* Free allocated and cached arenas. */
+	list_splice_init(&gcmmucontext->cached, &gcmmucontext->allocated);
+	gcmmucontext->cachedcount = 0;
+
 	while (!list_empty(&gcmmucontext->allocated)) {
 		head = gcmmucontext->allocated.next;
 		arena = list_entry(head, struct gcmmuarena, link);
@@ -791,12 +1080,29 @@ enum gcerror gcmmu_map(struct gccorecontext *gccorecontext,
 	GCLOCK(&gcmmucontext->lock);
 	locked = true;
 
+	GCDBG(GCZONE_MAPPING, "mapping (%d) pages\n", mem->count);
+
 	/*
-	 * Find available sufficient arena.
+	 * Reuse a cached mapping of the same memory.
 	 */
 
-	GCDBG(GCZONE_MAPPING, "mapping (%d) pages\n", mem->count);
+	trim_cache(gccorecontext, gcmmucontext, GCMMU_CACHE_SIZE);
+
+	vacant = find_cached(gcmmucontext, mem);
+	if (vacant != NULL) {
+		mem->pagesize = GCMMU_PAGE_SIZE;
+		*mapped = vacant;
+
+		GCDBG(GCZONE_MAPPING, "reused %d bytes at 0x%08X\n",
+			vacant->size, vacant->address);
+		goto exit;
+	}
 
+	/*
+	 * Find available sufficient arena.
+	 */
+
+retry:
 	list_for_each(arenahead, &gcmmucontext->vacant) {
 		vacant = list_entry(arenahead, struct gcmmuarena, link);
 		if (vacant->count >= mem->count)
@@ -804,6 +1110,12 @@ enum gcerror gcmmu_map(struct gccorecontext *gccorecontext,
 	}
 
 	if (arenahead == &gcmmucontext->vacant) {
+		/* Give the cached address space back and try again. */
+		if (gcmmucontext->cachedcount != 0) {
+			trim_cache(gccorecontext, gcmmucontext, 0);
+			goto retry;
+		}
+
 		gcerror = GCERR_MMU_OOM;
 		goto exit;
 	}
@@ -816,9 +1128,25 @@ enum gcerror gcmmu_map(struct gccorecontext *gccorecontext,
 
 	/* Reset page array. */
 	vacant->pages = NULL;
+	vacant->logical = NULL;
+	vacant->physical = (mem->pages != NULL);
+	vacant->stale = false;
 
 	/* No page array given? */
 	if (mem->pages == NULL) {
+		/* Track the client address space to be able to reuse the
+		 * mapping later. */
+		if ((gcmmucontext->mm == NULL) && (current->mm != NULL)) {
+			gcmmucontext->notifier.ops = &gcmmu_notifier_ops;
+			if (mmu_notifier_register(&gcmmucontext->notifier,
+						  current->mm) == 0)
+				gcmmucontext->mm = current->mm;
+		}
+
+		/* Memory of a foreign address space isn't tracked. */
+		if (current->mm != gcmmucontext->mm)
+			vacant->stale = true;
+
 		/* Allocate physical address array. */
 		parray_alloc = kmalloc(mem->count * sizeof(pte_t *),
 					GFP_KERNEL);
@@ -915,7 +1243,9 @@ enum gcerror gcmmu_map(struct gccorecontext *gccorecontext,
 	GCDUMPARENA(GCZONE_ARENA, "allocated arena", vacant);
 
 	/* Move the vacant arena to the list of allocated arenas. */
+	spin_lock(&gcmmucontext->cachelock);
 	list_move(&vacant->link, &gcmmucontext->allocated);
+	spin_unlock(&gcmmucontext->cachelock);
 
 	/* Set page size. */
 	mem->pagesize = GCMMU_PAGE_SIZE;
@@ -965,13 +1295,9 @@ enum gcerror gcmmu_unmap(struct gccorecontext *gccorecontext,
 {
 	enum gcerror gcerror = GCERR_NONE;
 	bool locked = false;
-	struct gcmmu *gcmmu = &gccorecontext->gcmmu;
-	struct list_head *allochead, *prevhead, *nexthead;
-	struct gcmmuarena *allocated, *prevvacant, *nextvacant = NULL;
-	struct gcmmustlb *slave;
-	unsigned int *stlblogical;
-	union gcmmuloc index;
-	unsigned int i, freed, count;
+	bool cache;
+	struct list_head *allochead;
+	struct gcmmuarena *allocated;
 
 	GCENTER(GCZONE_MAPPING);
 
@@ -1008,127 +1334,25 @@ enum gcerror gcmmu_unmap(struct gccorecontext *gccorecontext,
 	GCDBG(GCZONE_MAPPING, "  arena size = %d\n", allocated->size);
 
 	/*
-	 * Free slave tables.
-	 */
-
-	index.absolute = allocated->start.absolute;
-	slave = &gcmmucontext->slave[index.loc.mtlb];
-	count = allocated->count;
-
-	while (count > 0) {
-		/* Determine the number of entries freed. */
-		freed = GCMMU_STLB_ENTRY_NUM - index.loc.stlb;
-		if (freed > count)
-			freed = count;
-
-		GCDBG(GCZONE_MAPPING, "freeing %d pages at %d.%d\n",
-			freed, index.loc.mtlb, index.loc.stlb);
-
-		/* Free slave entries. */
-		stlblogical = &slave->logical[index.loc.stlb];
-		for (i = 0; i < freed; i += 1)
-			*stlblogical++ = GCMMU_STLB_ENTRY_VACANT;
-
-		/* Flush CPU cache. */
-		gc_flush_region(slave->physical, slave->logical,
-				index.loc.stlb * sizeof(unsigned int),
-				freed * sizeof(unsigned int));
-
-		/* Advance. */
-		slave += 1;
-		index.absolute += freed;
-		count -= freed;
-	}
-
-	/*
-	 * Delete page cache for the arena.
-	 */
-
-	release_physical_pages(allocated);
-
-	/*
-	 * Find point of insertion and free the arena.
+	 * Keep the mapping around for reuse if possible.
 	 */
 
-	GCDBG(GCZONE_MAPPING,
-		"looking for the point of insertion.\n");
-
-	list_for_each(nexthead, &gcmmucontext->vacant) {
-		nextvacant = list_entry(nexthead, struct gcmmuarena, link);
-		if (nextvacant->start.absolute >= allocated->end.absolute) {
-			GCDBG(GCZONE_MAPPING, "  point of insertion found.\n");
-			break;
-		}
-	}
-
-	/* Get the previous vacant entry. */
-	prevhead = nexthead->prev;
-
-	/* Merge the area back into vacant list. */
-	if (siblings(&gcmmucontext->vacant, prevhead, allochead)) {
-		if (siblings(&gcmmucontext->vacant, allochead, nexthead)) {
-			prevvacant = list_entry(prevhead, struct gcmmuarena,
-						link);
-
-			GCDBG(GCZONE_MAPPING, "merging three arenas:\n");
-
-			GCDUMPARENA(GCZONE_ARENA, "previous arena", prevvacant);
-			GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
-			GCDUMPARENA(GCZONE_ARENA, "next arena", nextvacant);
-
-			/* Merge all three arenas. */
-			prevvacant->count += allocated->count;
-			prevvacant->count += nextvacant->count;
-			prevvacant->end.absolute = nextvacant->end.absolute;
-
-			/* Free the merged arenas. */
-			GCLOCK(&gcmmu->lock);
-			list_move(allochead, &gcmmu->vacarena);
-			list_move(nexthead, &gcmmu->vacarena);
-			GCUNLOCK(&gcmmu->lock);
-		} else {
-			prevvacant = list_entry(prevhead, struct gcmmuarena,
-						link);
-
-			GCDBG(GCZONE_MAPPING, "merging with the previous:\n");
-
-			GCDUMPARENA(GCZONE_ARENA, "previous arena", prevvacant);
-			GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
-
-			/* Merge with the previous. */
-			prevvacant->count += allocated->count;
-			prevvacant->end.absolute = allocated->end.absolute;
-
-			/* Free the merged arena. */
-			GCLOCK(&gcmmu->lock);
-			list_move(allochead, &gcmmu->vacarena);
-			GCUNLOCK(&gcmmu->lock);
-		}
-	} else if (siblings(&gcmmucontext->vacant, allochead, nexthead)) {
-		GCDBG(GCZONE_MAPPING, "merged with the next:\n");
-
-		GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
-		GCDUMPARENA(GCZONE_ARENA, "next arena", nextvacant);
-
-		/* Merge with the next arena. */
-		nextvacant->start.absolute = allocated->start.absolute;
-		nextvacant->count += allocated->count;
-
-		/* Free the merged arena. */
-		GCLOCK(&gcmmu->lock);
-		list_move(allochead, &gcmmu->vacarena);
-		GCUNLOCK(&gcmmu->lock);
-	} else {
-		GCDBG(GCZONE_MAPPING,
-		      "nothing to merge with, inserting in between:\n");
-		GCDUMPARENA(GCZONE_ARENA, "allocated arena", allocated);
-
-		/* Neighbor vacant arenas are not siblings, can't merge. */
-		list_move(allochead, prevhead);
+	spin_lock(&gcmmucontext->cachelock);
+	list_del_init(allochead);
+	cache = (GCMMU_CACHE_SIZE > 0) && !allocated->stale &&
+		(allocated->physical || (allocated->pages != NULL));
+	if (cache)
+		list_add(allochead, &gcmmucontext->cached);
+	spin_unlock(&gcmmucontext->cachelock);
+
+	if (cache) {
+		GCDBG(GCZONE_MAPPING, "arena cached.\n");
+		gcmmucontext->cachedcount += 1;
+		trim_cache(gccorecontext, gcmmucontext, GCMMU_CACHE_SIZE);
+		goto exit;
 	}
 
-	/* Invalidate the MMU. */
-	gcmmucontext->dirty = true;
+	free_arena(gccorecontext, gcmmucontext, allocated);
 
 	/* Dump tables. */
 	GCDUMPMMU(GCZONE_DUMPUNMAP, gcmmucontext);
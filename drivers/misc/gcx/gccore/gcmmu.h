@@ -16,6 +16,8 @@
 #define GCMMU_H
 
 #include <linux/gccore.h>
+#include <linux/mmu_notifier.h>
+#include <linux/spinlock.h>
 #include "gcmem.h"
 #include "gcqueue.h"
 
@@ -102,6 +104,11 @@
  * which is equal to 256 assuming 4KB page size. */
 #define GCMMU_STLB_PREALLOC_COUNT	(GCMMU_MTLB_ENTRY_NUM / 4)
 
+/* Number of unmapped buffers per context that are kept mapped so that
+ * they can be remapped without rebuilding the page tables. Set to 0 to
+ * disable the mapping cache. */
+#define GCMMU_CACHE_SIZE		32
+
 
 /*******************************************************************************
  * MMU structures.
@@ -140,6 +147,13 @@ struct gcmmuarena {
 	/* Page descriptor array. */
 	struct page **pages;
 
+	/* Set if the arena was mapped from a physical page array. */
+	bool physical;
+
+	/* Set if the client memory backing the arena was unmapped or
+	 * remapped; the arena can no longer be reused. */
+	bool stale;
+
 	/* Prev/next arena. */
 	struct list_head link;
 };
@@ -208,6 +222,18 @@ struct gcmmucontext {
 	struct list_head vacant;
 	struct list_head allocated;
 
+	/* Unmapped arenas kept for reuse, most recently used first. */
+	struct list_head cached;
+	unsigned int cachedcount;
+
+	/* Protects membership of the allocated and cached lists and the
+	 * stale flags of their arenas against the MMU notifier. */
+	spinlock_t cachelock;
+
+	/* Notifier for the address space user memory is mapped from. */
+	struct mmu_notifier notifier;
+	struct mm_struct *mm;
+
 	/* Driver instance has only one set of command buffers that must be
 	 * mapped the same exact way in all clients. This array stores
 	 * pointers to arena structures of mapped storage buffers. */
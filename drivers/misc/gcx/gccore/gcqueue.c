@@ -18,6 +18,9 @@
 #include <asm/cacheflush.h>
 #include "gcmain.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/gcx.h>
+
 #define GCZONE_NONE		0
 #define GCZONE_ALL		(~0U)
 #define GCZONE_INIT		(1 << 0)
@@ -85,6 +88,10 @@ GCDBG_FILTERDEF(queue, GCZONE_NONE,
 /* Minimum available space requirement. */
 #define GC_MIN_THRESHOLD	((int) (GC_TAIL_RESERVE + 200))
 
+/* Number of synchronous buffer interrupts the ISR collects before waking
+ * up the command buffer thread to recycle the buffers. */
+#define GC_INT_BATCH		8
+
 /* Event assignment. */
 #define GC_SIG_BUS_ERROR	31
 #define GC_SIG_MMU_ERROR	30
@@ -120,6 +127,7 @@ static irqreturn_t gcisr(int irq, void *_gccorecontext)
 
 	/* Log interrupt data. */
 	gc_debug_cache_gpu_status_from_irq(triggered);
+	trace_gcx_complete(triggered);
 
 	/* Bus error? */
 	if ((triggered & GC_SIG_MASK_BUS_ERROR) != 0) {
@@ -134,10 +142,29 @@ static irqreturn_t gcisr(int irq, void *_gccorecontext)
 	}
 
 	/* Command buffer event? */
-	if (triggered != 0)
+	if (triggered != 0) {
+		unsigned int stallint = ACCESS_ONCE(gcqueue->stallint);
+		unsigned int stallmask;
+
 		atomic_add(triggered, &gcqueue->triggered);
 
+		/* Release the synchronous caller directly. */
+		stallmask = (stallint == ~0U) ? 0 : (1 << stallint);
+		if (((triggered & stallmask) != 0) &&
+		    (xchg(&gcqueue->stallint, ~0U) == stallint)) {
+			complete(&gcqueue->stall);
+
+			/* Nothing else to do for the thread but recycling
+			 * the buffer, which can wait for a few more. */
+			if ((triggered == stallmask) &&
+			    (atomic_inc_return(&gcqueue->deferred)
+							< GC_INT_BATCH))
+				return IRQ_HANDLED;
+		}
+	}
+
 	/* Release the command buffer thread. */
+	atomic_set(&gcqueue->deferred, 0);
 	complete(&gcqueue->ready);
 
 	/* IRQ handled. */
@@ -294,6 +321,13 @@ static void event_completion(struct gcevent *gcevent, unsigned int *flags)
 	GCEXIT(GCZONE_EVENT);
 }
 
+/* Synchronous buffer event; the ISR has released the caller already. */
+static void event_stall(struct gcevent *gcevent, unsigned int *flags)
+{
+	GCENTER(GCZONE_EVENT);
+	GCEXIT(GCZONE_EVENT);
+}
+
 /* Callback event. */
 static void event_callback(struct gcevent *gcevent, unsigned int *flags)
 {
@@ -543,6 +577,7 @@ static int gccmdthread(void *_gccorecontext)
 	unsigned int i, triggered, ints2process, intmask;
 	struct list_head *head;
 	struct gccmdbuf *headcmdbuf;
+	LIST_HEAD(done);
 	unsigned int flags;
 	unsigned int dmapc, pc1, pc2;
 
@@ -629,7 +664,7 @@ static int gccmdthread(void *_gccorecontext)
 				      "buffer has no interrupt.\n");
 
 				/* Free the entry. */
-				gcqueue_free_cmdbuf(gcqueue, headcmdbuf, NULL);
+				list_move_tail(head, &done);
 				continue;
 			}
 
@@ -661,17 +696,31 @@ static int gccmdthread(void *_gccorecontext)
 			/* Free the interrupt. */
 			free_interrupt(gcqueue, headcmdbuf->interrupt);
 
-			/* Execute events if any and free the entry. */
-			gcqueue_free_cmdbuf(gcqueue, headcmdbuf, &flags);
+			/* Retire the entry. */
+			list_move_tail(head, &done);
 		}
 
 		GCUNLOCK(&gcqueue->queuelock);
 
+		/* Execute events if any and free the retired entries. Done
+		 * outside of the queue lock so that new submissions do not
+		 * have to wait for the event handlers. */
+		while (!list_empty(&done)) {
+			headcmdbuf = list_first_entry(&done, struct gccmdbuf,
+						      link);
+			gcqueue_free_cmdbuf(gcqueue, headcmdbuf, &flags);
+		}
+
 		/* Bus error? */
 		if (try_wait_for_completion(&gcqueue->buserror)) {
 			GCERR("bus error detected.\n");
 			GCGPUSTATUS();
 
+			/* Release the synchronous caller the ISR will not
+			 * hear about anymore. */
+			if (xchg(&gcqueue->stallint, ~0U) != ~0U)
+				complete(&gcqueue->stall);
+
 			GCLOCK(&gcqueue->queuelock);
 
 			/* Execute all pending events. */
@@ -965,6 +1014,8 @@ enum gcerror gcqueue_start(struct gccorecontext *gccorecontext)
 	init_completion(&gcqueue->ready);
 	init_completion(&gcqueue->stop);
 	init_completion(&gcqueue->stall);
+	gcqueue->stallint = ~0U;
+	atomic_set(&gcqueue->deferred, 0);
 
 	/* Initialize error signals. */
 	init_completion(&gcqueue->mmuerror);
@@ -1476,6 +1527,7 @@ enum gcerror gcqueue_execute(struct gccorecontext *gccorecontext,
 	struct gcevent *gcevent;
 	struct gccmdbuf *gccmdbuf;
 	struct list_head *head;
+	bool fastpath = false;
 
 	GCENTERARG(GCZONE_EXEC, "context = 0x%08X, asynchronous = %d\n",
 		   (unsigned int) gccorecontext, asynchronous);
@@ -1575,17 +1627,25 @@ enum gcerror gcqueue_execute(struct gccorecontext *gccorecontext,
 	if (!asynchronous) {
 		GCDBG(GCZONE_EXEC, "appending stall event.\n");
 
+		/* A buffer with no other events can be completed by the ISR
+		 * without going through the command buffer thread. */
+		fastpath = list_empty(&gccmdbuf->events);
+
 		/* Add stall event. */
 		gcerror = gcqueue_alloc_event(gcqueue, &gcevent);
 		if (gcerror != GCERR_NONE)
 			goto exit;
 
 		/* Initialize the event and add to the list. */
-		gcevent->handler = event_completion;
-		gcevent->event.completion.completion = &gcqueue->stall;
+		if (fastpath) {
+			gcevent->handler = event_stall;
+		} else {
+			gcevent->handler = event_completion;
+			gcevent->event.completion.completion = &gcqueue->stall;
+		}
 		list_add_tail(&gcevent->link, &gccmdbuf->events);
-		GCDBG(GCZONE_EXEC, "stall completion 0x%08X.\n",
-		      (unsigned int) gcevent->event.completion.completion);
+		GCDBG(GCZONE_EXEC, "stall completion 0x%08X (fast = %d).\n",
+		      (unsigned int) &gcqueue->stall, fastpath);
 	}
 
 	/* If the buffer has no events, don't allocate an interrupt for it. */
@@ -1601,9 +1661,17 @@ enum gcerror gcqueue_execute(struct gccorecontext *gccorecontext,
 		gcmoterminator->u1.done.signal.reg.id = gccmdbuf->interrupt;
 		gcmoterminator->u1.done.signal.reg.pe
 						= GCREG_EVENT_PE_SRC_ENABLE;
+
+		/* Arm the ISR before the buffer can reach the GPU. */
+		if (fastpath) {
+			gcqueue->stallint = gccmdbuf->interrupt;
+			smp_wmb();
+		}
 	}
 
 	/* Append the current command buffer to the queue. */
+	trace_gcx_submit(gccmdbuf->physical, gccmdbuf->size,
+			 gccmdbuf->interrupt, asynchronous);
 	append_cmdbuf(gccorecontext, gcqueue);
 
 	/* Wait for completion. */
@@ -155,6 +155,14 @@ struct gcqueue {
 	/* Stall completion; used to imitate synchronous behaviour. */
 	struct completion stall;
 
+	/* Interrupt of the synchronous buffer the ISR completes the stall
+	 * for directly, ~0U if none. */
+	unsigned int stallint;
+
+	/* Number of interrupts the command buffer thread was not woken up
+	 * for yet. */
+	atomic_t deferred;
+
 	/* Error signals. */
 	struct completion mmuerror;
 	struct completion buserror;
@@ -23,6 +23,8 @@
 #include <plat/cpu.h>
 #include <linux/dma-mapping.h>
 #include <linux/platform_device.h>
+#include <linux/file.h>
+#include <linux/sync.h>
 #include <linux/gcx.h>
 #include <linux/gccore.h>
 #include <linux/cache-2dmanager.h>
@@ -632,6 +634,24 @@ static int gc_commit_wrapper(struct gcicommit *gcicommit)
 	/* Call the core driver. */
 	gc_commit(&cpcommit, true);
 
+	/* Hand the fence over to the caller. */
+	if (cpcommit.syncfence != NULL) {
+		cpcommit.fencefd = get_unused_fd();
+		if (cpcommit.fencefd < 0) {
+			GCERR("failed to allocate fence descriptor.\n");
+			sync_fence_put(cpcommit.syncfence);
+			cpcommit.gcerror = GCERR_CMD_FENCE;
+		} else if (put_user(cpcommit.fencefd, &gcicommit->fencefd)) {
+			GCERR("failed to write data.\n");
+			put_unused_fd(cpcommit.fencefd);
+			sync_fence_put(cpcommit.syncfence);
+			ret = -EFAULT;
+		} else {
+			sync_fence_install(cpcommit.syncfence,
+					   cpcommit.fencefd);
+		}
+	}
+
 exit:
 	if (copy_to_user(&gcicommit->gcerror, &cpcommit.gcerror,
 			 sizeof(enum gcerror))) {
@@ -726,22 +746,7 @@ static int gc_cache_wrapper(struct gcicache *gcicache)
 		goto exit;
 	}
 
-	switch (cpcache.dir) {
-	case DMA_FROM_DEVICE:
-		c2dm_l2cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		c2dm_l1cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		break;
-
-	case DMA_TO_DEVICE:
-		c2dm_l1cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		c2dm_l2cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		break;
-
-	case DMA_BIDIRECTIONAL:
-		c2dm_l1cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		c2dm_l2cache(cpcache.count, cpcache.rgn, cpcache.dir);
-		break;
-	}
+	c2dm_cache(cpcache.count, cpcache.rgn, cpcache.dir);
 
 exit:
 	GCEXIT(GCZONE_CACHE);
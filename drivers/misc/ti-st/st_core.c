@@ -27,6 +27,7 @@
 
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
+#include <asm/unaligned.h>
 
 #include <linux/ti_wilink_st.h>
 
@@ -102,6 +103,9 @@ int st_int_write(struct st_data_s *st_gdata,
  */
 void st_send_frame(unsigned char chnl_id, struct st_data_s *st_gdata)
 {
+	struct st_rx_stats *stats;
+	unsigned int len;
+
 	pr_debug(" %s(prot:%d) ", __func__, chnl_id);
 
 	if (unlikely
@@ -109,9 +113,15 @@ void st_send_frame(unsigned char chnl_id, struct st_data_s *st_gdata)
 	     || st_gdata->is_registered[chnl_id] == false)) {
 		pr_err("chnl_id %d not registered, no data to send?\n",
 			   chnl_id);
+		if (st_gdata != NULL)
+			st_gdata->rx_stats[chnl_id].dropped++;
 		kfree_skb(st_gdata->rx_skb);
 		return;
 	}
+
+	stats = &st_gdata->rx_stats[chnl_id];
+	len = st_gdata->rx_skb->len;
+
 	/* this cannot fail
 	 * this shouldn't take long
 	 * - should be just skb_queue_tail for the
@@ -123,11 +133,15 @@ void st_send_frame(unsigned char chnl_id, struct st_data_s *st_gdata)
 			(st_gdata->list[chnl_id]->priv_data, st_gdata->rx_skb)
 			     != 0)) {
 			pr_err(" proto stack %d's ->recv failed\n", chnl_id);
+			stats->dropped++;
 			kfree_skb(st_gdata->rx_skb);
 			return;
 		}
+		stats->frames++;
+		stats->bytes += len;
 	} else {
 		pr_err(" proto stack %d's ->recv null\n", chnl_id);
+		stats->dropped++;
 		kfree_skb(st_gdata->rx_skb);
 	}
 	return;
@@ -179,6 +193,7 @@ static inline int st_check_data_len(struct st_data_s *st_gdata,
 		 */
 		pr_err("Data length is too large len %d room %d\n", len,
 			   room);
+		st_gdata->rx_stats[chnl_id].dropped++;
 		kfree_skb(st_gdata->rx_skb);
 	} else {
 		/* Packet header has non-zero payload length and
@@ -224,6 +239,56 @@ static inline void st_wakeup_ack(struct st_data_s *st_gdata,
 	st_tx_wakeup(st_gdata);
 }
 
+/**
+ * st_recv_whole_frame - copy out a frame held entirely in the tty buffer
+ *	@ptr points at the channel byte. When header and payload of the
+ *	frame are all within @count bytes, the frame goes to the protocol
+ *	driver with a single copy and the caller skips the rx state machine.
+ *	Returns the number of bytes consumed, 0 to fall back to the
+ *	byte-wise path (split frame, or one needing its error handling).
+ */
+static inline long st_recv_whole_frame(struct st_data_s *st_gdata,
+	const unsigned char *ptr, long count)
+{
+	struct st_proto_s *proto = st_gdata->list[*ptr];
+	const unsigned char *plen;
+	unsigned int payload_len, frame_len;
+	struct sk_buff *skb;
+
+	if (count <= proto->hdr_len)
+		return 0;
+
+	plen = ptr + 1 + proto->offset_len_in_hdr;
+	if (proto->len_size == 1)
+		payload_len = *plen;
+	else if (proto->len_size == 2)
+		payload_len = get_unaligned_le16(plen);
+	else
+		return 0;
+
+	frame_len = proto->hdr_len + payload_len;
+	if (frame_len >= count ||
+		frame_len > proto->max_frame_size - proto->reserve)
+		return 0;
+
+	skb = alloc_skb(proto->max_frame_size, GFP_ATOMIC);
+	if (!skb)
+		return 0;
+
+	skb_reserve(skb, proto->reserve);
+	/* next 2 required for BT only */
+	skb->cb[0] = *ptr; /*pkt_type*/
+	skb->cb[1] = 0; /*incoming*/
+	memcpy(skb_put(skb, frame_len), ptr + 1, frame_len);
+
+	st_gdata->rx_stats[*ptr].whole++;
+	st_gdata->rx_skb = skb;
+	st_send_frame(*ptr, st_gdata);
+	st_gdata->rx_skb = NULL;
+
+	return frame_len + 1;
+}
+
 /**
  * st_int_recv - ST's internal receive function.
  *	Decodes received RAW data and forwards to corresponding
@@ -239,6 +304,7 @@ void st_int_recv(void *disc_data,
 	struct st_proto_s *proto;
 	unsigned short payload_len = 0;
 	int len = 0, type = 0;
+	long whole;
 	unsigned char *plen;
 	struct st_data_s *st_gdata = (struct st_data_s *)disc_data;
 	unsigned long flags;
@@ -357,13 +423,24 @@ void st_int_recv(void *disc_data,
 				pr_err("chip/interface misbehavior: "
 						"dropping frame starting "
 						"with 0x%02x\n", type);
+				st_gdata->rx_junk += count;
 				goto done;
 			}
+
+			whole = st_recv_whole_frame(st_gdata, ptr, count);
+			if (whole) {
+				ptr += whole;
+				count -= whole;
+				continue;
+			}
+
 			st_gdata->rx_skb = alloc_skb(
 					st_gdata->list[type]->max_frame_size,
 					GFP_ATOMIC);
-			if (!st_gdata->rx_skb)
+			if (!st_gdata->rx_skb) {
+				st_gdata->rx_stats[type].dropped++;
 				goto done;
+			}
 
 			skb_reserve(st_gdata->rx_skb,
 					st_gdata->list[type]->reserve);
@@ -508,6 +585,27 @@ void kim_st_list_protocols(struct st_data_s *st_gdata, void *buf)
 			st_gdata->is_registered[0x09] == true ? 'R' : 'U');
 }
 
+void kim_st_rx_stats(struct st_data_s *st_gdata, void *buf)
+{
+	struct st_rx_stats *stats;
+	unsigned long flags;
+	int i;
+
+	seq_printf(buf, "chnl   frames      bytes      whole    dropped\n");
+
+	spin_lock_irqsave(&st_gdata->lock, flags);
+	for (i = 0; i < ST_MAX_CHANNELS; i++) {
+		stats = &st_gdata->rx_stats[i];
+		if (!stats->frames && !stats->dropped)
+			continue;
+		seq_printf(buf, "0x%02x %8lu %10lu %10lu %10lu\n", i,
+				stats->frames, stats->bytes, stats->whole,
+				stats->dropped);
+	}
+	seq_printf(buf, "junk bytes %lu\n", st_gdata->rx_junk);
+	spin_unlock_irqrestore(&st_gdata->lock, flags);
+}
+
 /********************************************************************/
 /*
  * functions called from protocol stack drivers
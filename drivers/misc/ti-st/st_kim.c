@@ -567,6 +567,13 @@ static int show_list(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int show_rx_stats(struct seq_file *s, void *unused)
+{
+	struct kim_data_s *kim_gdata = (struct kim_data_s *)s->private;
+	kim_st_rx_stats(kim_gdata->core_data, s);
+	return 0;
+}
+
 static ssize_t show_install(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -681,6 +688,11 @@ static int kim_list_open(struct inode *i, struct file *f)
 	return single_open(f, show_list, i->i_private);
 }
 
+static int kim_rx_stats_open(struct inode *i, struct file *f)
+{
+	return single_open(f, show_rx_stats, i->i_private);
+}
+
 static const struct file_operations version_debugfs_fops = {
 	/* version info */
 	.open = kim_version_open,
@@ -695,6 +707,13 @@ static const struct file_operations list_debugfs_fops = {
 	.llseek = seq_lseek,
 	.release = single_release,
 };
+static const struct file_operations rx_stats_debugfs_fops = {
+	/* per channel receive counters */
+	.open = kim_rx_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 
 /**********************************************************************/
 /* functions called from platform device driver subsystem
@@ -775,6 +794,8 @@ static int kim_probe(struct platform_device *pdev)
 				kim_gdata, &version_debugfs_fops);
 	debugfs_create_file("protocols", S_IRUGO, kim_debugfs_dir,
 				kim_gdata, &list_debugfs_fops);
+	debugfs_create_file("rx_stats", S_IRUGO, kim_debugfs_dir,
+				kim_gdata, &rx_stats_debugfs_fops);
 	pr_info(" debugfs entries created ");
 	return 0;
 }
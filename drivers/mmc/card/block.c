@@ -34,6 +34,8 @@
 #include <linux/delay.h>
 #include <linux/capability.h>
 #include <linux/compat.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/ioctl.h>
 #include <linux/mmc/card.h>
@@ -76,6 +78,46 @@ static int max_devices;
 static DECLARE_BITMAP(dev_use, 256);
 static DECLARE_BITMAP(name_use, 256);
 
+#define mmc_req_rel_wr(req)	(((req->cmd_flags & REQ_FUA) || \
+				  (req->cmd_flags & REQ_META)) && \
+				  (rq_data_dir(req) == WRITE))
+#define PACKED_CMD_VER		0x01
+#define PACKED_CMD_WR		0x02
+#define MMC_CMD23_ARG_PACKED	(1 << 30)
+
+#define MMC_PACKED_NR_IDX	-1
+#define MMC_PACKED_NR_ZERO	0
+#define MMC_PACKED_NR_SINGLE	1
+
+/* why the packing of a write stopped */
+enum mmc_blk_packed_stop {
+	MMC_PACKED_STOP_MAX_ENTRIES,
+	MMC_PACKED_STOP_EMPTY_QUEUE,
+	MMC_PACKED_STOP_DIRECTION,
+	MMC_PACKED_STOP_FLUSH_DISCARD,
+	MMC_PACKED_STOP_REL_WR,
+	MMC_PACKED_STOP_SECTORS,
+	MMC_PACKED_STOP_SEGMENTS,
+	MMC_PACKED_STOP_NR,
+};
+
+static const char * const mmc_blk_packed_stop_names[MMC_PACKED_STOP_NR] = {
+	[MMC_PACKED_STOP_MAX_ENTRIES]	= "max entries",
+	[MMC_PACKED_STOP_EMPTY_QUEUE]	= "empty queue",
+	[MMC_PACKED_STOP_DIRECTION]	= "read",
+	[MMC_PACKED_STOP_FLUSH_DISCARD]	= "flush or discard",
+	[MMC_PACKED_STOP_REL_WR]	= "reliable write",
+	[MMC_PACKED_STOP_SECTORS]	= "max sectors",
+	[MMC_PACKED_STOP_SEGMENTS]	= "max segments",
+};
+
+struct mmc_blk_packed_stats {
+	/* writes sent by number of requests, 1 is a write sent alone */
+	unsigned long	packs[MMC_PACKED_MAX_ENTRIES + 1];
+	unsigned long	stop[MMC_PACKED_STOP_NR];
+	unsigned long	failures;
+};
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -88,6 +130,7 @@ struct mmc_blk_data {
 	unsigned int	flags;
 #define MMC_BLK_CMD23	(1 << 0)	/* Can do SET_BLOCK_COUNT for multiblock */
 #define MMC_BLK_REL_WR	(1 << 1)	/* MMC Reliable write support */
+#define MMC_BLK_PACKED_CMD	(1 << 2)	/* MMC packed command support */
 
 	unsigned int	usage;
 	unsigned int	read_only;
@@ -108,6 +151,9 @@ struct mmc_blk_data {
 	struct device_attribute force_ro;
 	struct device_attribute power_ro_lock;
 	int	area_type;
+
+	struct mmc_blk_packed_stats packed_stats;
+	struct dentry	*packed_stats_dentry;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -199,6 +245,7 @@ static ssize_t power_ro_lock_store(struct device *dev,
 	card = md->queue.card;
 
 	mmc_claim_host(card->host);
+	mmc_stop_bkops(card);
 
 	ret = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BOOT_WP,
 				card->ext_csd.boot_ro_lock |
@@ -432,6 +479,7 @@ static int mmc_blk_ioctl_cmd(struct block_device *bdev,
 	mrq.cmd = &cmd;
 
 	mmc_claim_host(card->host);
+	mmc_stop_bkops(card);
 
 	if (idata->ic.is_acmd) {
 		err = mmc_app_cmd(card->host, card);
@@ -1092,6 +1140,86 @@ static int mmc_blk_err_check(struct mmc_card *card,
 	return MMC_BLK_SUCCESS;
 }
 
+static inline void mmc_blk_clear_packed(struct mmc_queue_req *mqrq)
+{
+	struct mmc_packed *packed = mqrq->packed;
+
+	BUG_ON(!packed);
+
+	mqrq->cmd_type = MMC_PACKED_NONE;
+	packed->nr_entries = MMC_PACKED_NR_ZERO;
+	packed->idx_failure = MMC_PACKED_NR_IDX;
+	packed->retries = 0;
+	packed->blocks = 0;
+}
+
+/*
+ * On top of the checks of a regular write, a card that failed a packed
+ * command raises an exception event, and tells in EXT_CSD whether the
+ * failure can be pinned on one of the packed requests.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	struct request *req = mq_rq->req;
+	struct mmc_packed *packed = mq_rq->packed;
+	struct mmc_blk_data *md = req->rq_disk->private_data;
+	int err, check;
+	u32 status;
+	u8 *ext_csd;
+
+	BUG_ON(!packed);
+
+	packed->retries--;
+	check = mmc_blk_err_check(card, areq);
+	err = get_card_status(card, &status, 0);
+	if (err) {
+		pr_err("%s: error %d sending status command\n",
+		       req->rq_disk->disk_name, err);
+		return MMC_BLK_ABORT;
+	}
+
+	if (!(status & R1_EXCEPTION_EVENT))
+		return check;
+
+	ext_csd = kzalloc(512, GFP_KERNEL);
+	if (!ext_csd) {
+		pr_err("%s: unable to allocate buffer for ext_csd\n",
+		       req->rq_disk->disk_name);
+		return MMC_BLK_ABORT;
+	}
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (err) {
+		pr_err("%s: error %d sending ext_csd\n",
+		       req->rq_disk->disk_name, err);
+		check = MMC_BLK_ABORT;
+		goto free;
+	}
+
+	if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_GENERIC_ERROR)) {
+		if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_INDEXED_ERROR) {
+			/* the index the card reports is 1 based */
+			packed->idx_failure =
+				ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+			check = MMC_BLK_PARTIAL;
+		}
+		md->packed_stats.failures++;
+		pr_err("%s: packed cmd failed, nr %u, sectors %u, failure index: %d\n",
+		       req->rq_disk->disk_name, packed->nr_entries,
+		       packed->blocks, packed->idx_failure);
+	}
+free:
+	kfree(ext_csd);
+
+	return check;
+}
+
 static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 			       struct mmc_card *card,
 			       int disable_multi,
@@ -1246,10 +1374,222 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+/*
+ * Pull the writes queued behind @req into its packed list, as long as
+ * they fit in one packed command. Returns the number of requests packed,
+ * 0 when @req is to be sent alone.
+ */
+static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct request *cur = req, *next = NULL;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_blk_packed_stats *stats = &md->packed_stats;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	bool en_rel_wr = card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN;
+	unsigned int req_sectors = 0, phys_segments = 0;
+	unsigned int max_blk_count, max_phys_segs;
+	enum mmc_blk_packed_stop stop;
+	bool put_back = true;
+	u8 max_packed_rw = 0;
+	u8 reqs = 0;
+
+	if (!(md->flags & MMC_BLK_PACKED_CMD))
+		goto no_packed;
+
+	if ((rq_data_dir(cur) == WRITE) &&
+	    mmc_host_packed_wr(card->host))
+		max_packed_rw = min_t(unsigned int,
+				      card->ext_csd.max_packed_writes,
+				      MMC_PACKED_MAX_ENTRIES);
+
+	if (max_packed_rw == 0)
+		goto no_packed;
+
+	if (mmc_req_rel_wr(cur) &&
+	    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr) {
+		stop = MMC_PACKED_STOP_REL_WR;
+		goto no_packed_write;
+	}
+
+	mmc_blk_clear_packed(mqrq);
+
+	max_blk_count = min(card->host->max_blk_count,
+			    queue_max_hw_sectors(q));
+	if (unlikely(max_blk_count > 0xffff))
+		max_blk_count = 0xffff;
+
+	max_phys_segs = queue_max_segments(q);
+	req_sectors += blk_rq_sectors(cur);
+	phys_segments += cur->nr_phys_segments;
+
+	/* the header block */
+	req_sectors++;
+	phys_segments++;
+
+	do {
+		if (reqs >= max_packed_rw - 1) {
+			stop = MMC_PACKED_STOP_MAX_ENTRIES;
+			put_back = false;
+			break;
+		}
+
+		spin_lock_irq(q->queue_lock);
+		next = blk_fetch_request(q);
+		spin_unlock_irq(q->queue_lock);
+		if (!next) {
+			stop = MMC_PACKED_STOP_EMPTY_QUEUE;
+			put_back = false;
+			break;
+		}
+
+		if (next->cmd_flags & REQ_DISCARD ||
+		    next->cmd_flags & REQ_FLUSH) {
+			stop = MMC_PACKED_STOP_FLUSH_DISCARD;
+			break;
+		}
+
+		if (rq_data_dir(cur) != rq_data_dir(next)) {
+			stop = MMC_PACKED_STOP_DIRECTION;
+			break;
+		}
+
+		if (mmc_req_rel_wr(next) &&
+		    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr) {
+			stop = MMC_PACKED_STOP_REL_WR;
+			break;
+		}
+
+		req_sectors += blk_rq_sectors(next);
+		if (req_sectors > max_blk_count) {
+			stop = MMC_PACKED_STOP_SECTORS;
+			break;
+		}
+
+		phys_segments += next->nr_phys_segments;
+		if (phys_segments > max_phys_segs) {
+			stop = MMC_PACKED_STOP_SEGMENTS;
+			break;
+		}
+
+		list_add_tail(&next->queuelist, &mqrq->packed->list);
+		cur = next;
+		reqs++;
+	} while (1);
+
+	if (put_back) {
+		spin_lock_irq(q->queue_lock);
+		blk_requeue_request(q, next);
+		spin_unlock_irq(q->queue_lock);
+	}
+
+	if (reqs > 0) {
+		list_add(&req->queuelist, &mqrq->packed->list);
+		mqrq->packed->nr_entries = ++reqs;
+		mqrq->packed->retries = reqs;
+		stats->stop[stop]++;
+		stats->packs[reqs]++;
+		return reqs;
+	}
+
+no_packed_write:
+	stats->stop[stop]++;
+	stats->packs[1]++;
+no_packed:
+	mqrq->cmd_type = MMC_PACKED_NONE;
+	return 0;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_packed *packed = mqrq->packed;
+	bool do_rel_wr, do_data_tag;
+	u32 *packed_cmd_hdr;
+	u8 i = 1;
+
+	BUG_ON(!packed);
+
+	mqrq->cmd_type = MMC_PACKED_WRITE;
+	packed->blocks = 0;
+	packed->idx_failure = MMC_PACKED_NR_IDX;
+
+	packed_cmd_hdr = packed->cmd_hdr;
+	memset(packed_cmd_hdr, 0, sizeof(packed->cmd_hdr));
+	packed_cmd_hdr[0] = (packed->nr_entries << 16) |
+		(PACKED_CMD_WR << 8) | PACKED_CMD_VER;
+
+	/*
+	 * Argument for each entry of packed group
+	 */
+	list_for_each_entry(prq, &packed->list, queuelist) {
+		do_rel_wr = mmc_req_rel_wr(prq) && (md->flags & MMC_BLK_REL_WR);
+		do_data_tag = (card->ext_csd.data_tag_unit_size) &&
+			(prq->cmd_flags & REQ_META) &&
+			(blk_rq_bytes(prq) >= card->ext_csd.data_tag_unit_size);
+		/* Argument of CMD23 */
+		packed_cmd_hdr[(i * 2)] =
+			(do_rel_wr ? (1 << 31) : 0) |
+			(do_data_tag ? (1 << 29) : 0) |
+			blk_rq_sectors(prq);
+		/* Argument of CMD25 */
+		packed_cmd_hdr[((i * 2)) + 1] =
+			mmc_card_blockaddr(card) ?
+			blk_rq_pos(prq) : blk_rq_pos(prq) << 9;
+		packed->blocks += blk_rq_sectors(prq);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	/* the header block is sent with the data */
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (packed->blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = packed->blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
 static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 			   struct mmc_blk_request *brq, struct request *req,
 			   int ret)
 {
+	struct mmc_queue_req *mq_rq;
+
+	mq_rq = container_of(brq, struct mmc_queue_req, brq);
+
 	/*
 	 * If this is an SD card and we're writing, we can first
 	 * mark the known good sectors as ok.
@@ -1267,7 +1607,7 @@ static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 			ret = __blk_end_request(req, 0, blocks << 9);
 			spin_unlock_irq(&md->lock);
 		}
-	} else {
+	} else if (!mmc_packed_cmd(mq_rq->cmd_type)) {
 		spin_lock_irq(&md->lock);
 		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
@@ -1275,6 +1615,90 @@ static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 	return ret;
 }
 
+/*
+ * Complete the packed requests up to the failed one, if any. Returns 1
+ * when the failed request and the ones after it are to be sent again.
+ */
+static int mmc_blk_end_packed_req(struct mmc_blk_data *md,
+				  struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct mmc_packed *packed = mq_rq->packed;
+	int idx = packed->idx_failure, i = 0;
+
+	BUG_ON(!packed);
+
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.next);
+		if (idx == i) {
+			/* retry from error index */
+			packed->nr_entries -= idx;
+			mq_rq->req = prq;
+
+			if (packed->nr_entries == MMC_PACKED_NR_SINGLE) {
+				list_del_init(&prq->queuelist);
+				mmc_blk_clear_packed(mq_rq);
+			}
+			return 1;
+		}
+		list_del_init(&prq->queuelist);
+		spin_lock_irq(&md->lock);
+		__blk_end_request(prq, 0, blk_rq_bytes(prq));
+		spin_unlock_irq(&md->lock);
+		i++;
+	}
+
+	mmc_blk_clear_packed(mq_rq);
+	return 0;
+}
+
+static void mmc_blk_abort_packed_req(struct mmc_blk_data *md,
+				     struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct mmc_packed *packed = mq_rq->packed;
+
+	BUG_ON(!packed);
+
+	spin_lock_irq(&md->lock);
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.next);
+		list_del_init(&prq->queuelist);
+		if (mmc_card_removed(md->queue.card))
+			prq->cmd_flags |= REQ_QUIET;
+		__blk_end_request(prq, -EIO, blk_rq_bytes(prq));
+	}
+	spin_unlock_irq(&md->lock);
+
+	mmc_blk_clear_packed(mq_rq);
+}
+
+/*
+ * Give the requests packed behind the first one back to the queue, the
+ * first one is then sent alone.
+ */
+static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
+				      struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct request_queue *q = mq->queue;
+	struct mmc_packed *packed = mq_rq->packed;
+
+	BUG_ON(!packed);
+
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.prev);
+		list_del_init(&prq->queuelist);
+		if (!list_empty(&packed->list)) {
+			spin_lock_irq(q->queue_lock);
+			blk_requeue_request(q, prq);
+			spin_unlock_irq(q->queue_lock);
+		}
+	}
+
+	mmc_blk_clear_packed(mq_rq);
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -1285,13 +1709,21 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	struct mmc_queue_req *mq_rq;
 	struct request *req;
 	struct mmc_async_req *areq;
+	u8 reqs = 0;
 
 	if (!rqc && !mq->mqrq_prev->req)
 		return 0;
 
+	if (rqc)
+		reqs = mmc_blk_prep_packed_list(mq, rqc);
+
 	do {
 		if (rqc) {
-			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			if (reqs >= 2)
+				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
+							    card, mq);
+			else
+				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
 		} else
 			areq = NULL;
@@ -1312,6 +1744,12 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			 * A block was successfully transferred.
 			 */
 			mmc_blk_reset_success(md, type);
+
+			if (mmc_packed_cmd(mq_rq->cmd_type)) {
+				ret = mmc_blk_end_packed_req(md, mq_rq);
+				break;
+			}
+
 			spin_lock_irq(&md->lock);
 			ret = __blk_end_request(req, 0,
 						brq->data.bytes_xfered);
@@ -1377,27 +1815,46 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		}
 
 		if (ret) {
-			/*
-			 * In case of a incomplete request
-			 * prepare it again and resend.
-			 */
-			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
-			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+			if (mmc_packed_cmd(mq_rq->cmd_type)) {
+				if (!mq_rq->packed->retries)
+					goto cmd_abort;
+				mmc_blk_packed_hdr_wrq_prep(mq_rq, card, mq);
+				mmc_start_req(card->host,
+					      &mq_rq->mmc_active, NULL);
+			} else {
+				/*
+				 * In case of a incomplete request
+				 * prepare it again and resend.
+				 */
+				mmc_blk_rw_rq_prep(mq_rq, card,
+						   disable_multi, mq);
+				mmc_start_req(card->host,
+					      &mq_rq->mmc_active, NULL);
+			}
 		}
 	} while (ret);
 
 	return 1;
 
  cmd_abort:
-	spin_lock_irq(&md->lock);
-	if (mmc_card_removed(card))
-		req->cmd_flags |= REQ_QUIET;
-	while (ret)
-		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
-	spin_unlock_irq(&md->lock);
+	if (mmc_packed_cmd(mq_rq->cmd_type)) {
+		mmc_blk_abort_packed_req(md, mq_rq);
+	} else {
+		spin_lock_irq(&md->lock);
+		if (mmc_card_removed(card))
+			req->cmd_flags |= REQ_QUIET;
+		while (ret)
+			ret = __blk_end_request(req, -EIO,
+						blk_rq_cur_bytes(req));
+		spin_unlock_irq(&md->lock);
+	}
 
  start_new_req:
 	if (rqc) {
+		/* the packed requests behind rqc go back to the queue */
+		if (mmc_packed_cmd(mq->mqrq_cur->cmd_type))
+			mmc_blk_revert_packed_req(mq, mq->mqrq_cur);
+
 		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
 	}
@@ -1423,9 +1880,11 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 #endif
 
-	if (req && !mq->mqrq_prev->req)
+	if (req && !mq->mqrq_prev->req) {
 		/* claim host only for the first request */
 		mmc_claim_host(card->host);
+		mmc_stop_bkops(card);
+	}
 
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
@@ -1457,9 +1916,11 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 out:
-	if (!req)
+	if (!req) {
 		/* release host only when there are no more requests */
 		mmc_release_host(card->host);
+		mmc_start_delayed_bkops(card);
+	}
 	return ret;
 }
 
@@ -1477,6 +1938,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 					      int area_type)
 {
 	struct mmc_blk_data *md;
+	unsigned int flush = 0;
 	int devidx, ret;
 
 	devidx = find_first_zero_bit(dev_use, max_devices);
@@ -1567,7 +2029,27 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 	    ((card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN) ||
 	     card->ext_csd.rel_sectors)) {
 		md->flags |= MMC_BLK_REL_WR;
-		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
+		flush |= REQ_FLUSH | REQ_FUA;
+	}
+
+	/*
+	 * With the volatile cache on, barriers need the flushes even if
+	 * FUA can't be done with reliable writes, the block layer then
+	 * follows FUA writes with a flush.
+	 */
+	if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl & 1)
+		flush |= REQ_FLUSH;
+
+	if (flush)
+		blk_queue_flush(md->queue.queue, flush);
+
+	if (mmc_card_mmc(card) &&
+	    (area_type == MMC_BLK_DATA_AREA_MAIN) &&
+	    (md->flags & MMC_BLK_CMD23) &&
+	    card->ext_csd.packed_event_en &&
+	    card->ext_csd.data_sector_size == 512) {
+		if (!mmc_packed_init(&md->queue, card))
+			md->flags |= MMC_BLK_PACKED_CMD;
 	}
 
 	return md;
@@ -1659,6 +2141,84 @@ static int mmc_blk_alloc_parts(struct mmc_card *card, struct mmc_blk_data *md)
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int mmc_blk_packed_stats_show(struct seq_file *m, void *unused)
+{
+	struct mmc_blk_data *md = m->private;
+	struct mmc_blk_packed_stats *stats = &md->packed_stats;
+	unsigned long writes = 0, reqs = 0;
+	int i;
+
+	for (i = 1; i <= MMC_PACKED_MAX_ENTRIES; i++) {
+		writes += stats->packs[i];
+		reqs += stats->packs[i] * i;
+	}
+
+	seq_printf(m, "writes: %lu, requests: %lu, ratio: %lu.%02lu\n",
+		   writes, reqs, writes ? reqs / writes : 0,
+		   writes ? (reqs % writes) * 100 / writes : 0);
+	seq_printf(m, "failures: %lu\n", stats->failures);
+
+	seq_printf(m, "requests per write:\n");
+	for (i = 1; i <= MMC_PACKED_MAX_ENTRIES; i++)
+		if (stats->packs[i])
+			seq_printf(m, "  %2d: %lu\n", i, stats->packs[i]);
+
+	seq_printf(m, "packing stopped on:\n");
+	for (i = 0; i < MMC_PACKED_STOP_NR; i++)
+		seq_printf(m, "  %-16s %lu\n", mmc_blk_packed_stop_names[i],
+			   stats->stop[i]);
+
+	return 0;
+}
+
+static int mmc_blk_packed_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_blk_packed_stats_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t mmc_blk_packed_stats_write(struct file *file,
+					  const char __user *buf,
+					  size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct mmc_blk_data *md = m->private;
+
+	memset(&md->packed_stats, 0, sizeof(md->packed_stats));
+	return count;
+}
+
+static const struct file_operations mmc_blk_packed_stats_fops = {
+	.open		= mmc_blk_packed_stats_open,
+	.read		= seq_read,
+	.write		= mmc_blk_packed_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mmc_blk_packed_stats_init(struct mmc_blk_data *md)
+{
+	struct mmc_card *card = md->queue.card;
+
+	if (!(md->flags & MMC_BLK_PACKED_CMD) || !card->debugfs_root)
+		return;
+
+	md->packed_stats_dentry = debugfs_create_file("packed_stats",
+			S_IRUSR | S_IWUSR, card->debugfs_root, md,
+			&mmc_blk_packed_stats_fops);
+}
+
+static void mmc_blk_packed_stats_exit(struct mmc_blk_data *md)
+{
+	debugfs_remove(md->packed_stats_dentry);
+	md->packed_stats_dentry = NULL;
+}
+#else
+static inline void mmc_blk_packed_stats_init(struct mmc_blk_data *md) { }
+static inline void mmc_blk_packed_stats_exit(struct mmc_blk_data *md) { }
+#endif
+
 static void mmc_blk_remove_req(struct mmc_blk_data *md)
 {
 	struct mmc_card *card;
@@ -1671,6 +2231,7 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 					card->ext_csd.boot_ro_lockable)
 				device_remove_file(disk_to_dev(md->disk),
 					&md->power_ro_lock);
+			mmc_blk_packed_stats_exit(md);
 
 			/* Stop new requests from getting into the queue */
 			del_gendisk(md->disk);
@@ -1678,6 +2239,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 
 		/* Then flush out any already in there */
 		mmc_cleanup_queue(&md->queue);
+		if (md->flags & MMC_BLK_PACKED_CMD)
+			mmc_packed_clean(&md->queue);
 		mmc_blk_put(md);
 	}
 }
@@ -1731,6 +2294,8 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 		if (ret)
 			goto power_ro_lock_fail;
 	}
+
+	mmc_blk_packed_stats_init(md);
 	return ret;
 
 power_ro_lock_fail:
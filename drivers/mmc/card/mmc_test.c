@@ -18,6 +18,8 @@
 #include <linux/scatterlist.h>
 #include <linux/swap.h>		/* For nr_free_buffer_pages() */
 #include <linux/list.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
@@ -38,6 +40,18 @@
  */
 #define TEST_AREA_MAX_SIZE (128 * 1024 * 1024)
 
+/*
+ * Latency tests time individual I/O operations of MMC_TEST_LAT_SZ bytes and
+ * stop after MMC_TEST_LAT_SAMPLES operations or MMC_TEST_LAT_SECS seconds,
+ * whichever comes first.
+ */
+#define MMC_TEST_LAT_SZ		4096
+#define MMC_TEST_LAT_SAMPLES	8192
+#define MMC_TEST_LAT_SECS	10
+
+/* 4KiB blocks written per journal transaction, before the commit block */
+#define MMC_TEST_JOURNAL_BLOCKS	4
+
 /**
  * struct mmc_test_pages - pages allocated by 'alloc_pages()'.
  * @page: first page in the allocation
@@ -100,6 +114,30 @@ struct mmc_test_transfer_result {
 	unsigned int iops;
 };
 
+/**
+ * struct mmc_test_latency_result - latency distribution for latency tests.
+ * @link: double-linked list
+ * @name: what was measured
+ * @count: number of operations timed
+ * @sectors: amount of sectors transferred by one operation
+ * @min: fastest operation (in microseconds)
+ * @p50: median (in microseconds)
+ * @p99: 99th percentile (in microseconds)
+ * @p999: 99.9th percentile (in microseconds)
+ * @max: slowest operation (in microseconds)
+ */
+struct mmc_test_latency_result {
+	struct list_head link;
+	const char *name;
+	unsigned int count;
+	unsigned int sectors;
+	u32 min;
+	u32 p50;
+	u32 p99;
+	u32 p999;
+	u32 max;
+};
+
 /**
  * struct mmc_test_general_result - results for tests.
  * @link: double-linked list
@@ -107,6 +145,7 @@ struct mmc_test_transfer_result {
  * @testcase: number of test case
  * @result: result of test run
  * @tr_lst: transfer measurements if any as mmc_test_transfer_result
+ * @lat_lst: latency measurements if any as mmc_test_latency_result
  */
 struct mmc_test_general_result {
 	struct list_head link;
@@ -114,6 +153,7 @@ struct mmc_test_general_result {
 	int testcase;
 	int result;
 	struct list_head tr_lst;
+	struct list_head lat_lst;
 };
 
 /**
@@ -136,6 +176,8 @@ struct mmc_test_dbgfs_file {
  * @highmem: buffer for highmem tests
  * @area: information for performance tests
  * @gr: pointer to results of current testcase
+ * @lat: per operation latencies of latency tests (in microseconds)
+ * @lat_cnt: number of entries used in @lat
  */
 struct mmc_test_card {
 	struct mmc_card	*card;
@@ -147,6 +189,8 @@ struct mmc_test_card {
 #endif
 	struct mmc_test_area		area;
 	struct mmc_test_general_result	*gr;
+	u32				*lat;
+	unsigned int			lat_cnt;
 };
 
 enum mmc_test_prep_media {
@@ -591,6 +635,101 @@ static void mmc_test_print_avg_rate(struct mmc_test_card *test, uint64_t bytes,
 	mmc_test_save_transfer_result(test, count, sectors, ts, rate, iops);
 }
 
+/*
+ * Start a new latency measurement.
+ */
+static void mmc_test_lat_reset(struct mmc_test_card *test)
+{
+	test->lat_cnt = 0;
+}
+
+/*
+ * Record the latency of one operation.
+ */
+static void mmc_test_lat_add(struct mmc_test_card *test, struct timespec *ts1,
+			     struct timespec *ts2)
+{
+	struct timespec ts = timespec_sub(*ts2, *ts1);
+	uint64_t us = timespec_to_ns(&ts);
+
+	do_div(us, NSEC_PER_USEC);
+	if (test->lat_cnt < MMC_TEST_LAT_SAMPLES)
+		test->lat[test->lat_cnt++] = min_t(uint64_t, us, UINT_MAX);
+}
+
+/*
+ * Whether enough operations have been timed since ts0.
+ */
+static bool mmc_test_lat_done(struct mmc_test_card *test, struct timespec *ts0)
+{
+	struct timespec ts1, ts;
+
+	if (test->lat_cnt >= MMC_TEST_LAT_SAMPLES)
+		return true;
+
+	getnstimeofday(&ts1);
+	ts = timespec_sub(ts1, *ts0);
+	return ts.tv_sec >= MMC_TEST_LAT_SECS;
+}
+
+static int mmc_test_lat_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Nearest-rank percentile, in tenths of a percent, of the sorted latencies.
+ */
+static u32 mmc_test_lat_pct(struct mmc_test_card *test, unsigned int permille)
+{
+	unsigned int rank = DIV_ROUND_UP(test->lat_cnt * permille, 1000);
+
+	return test->lat[rank ? rank - 1 : 0];
+}
+
+/*
+ * Print the latency distribution and save it for the "latency" file.
+ */
+static void mmc_test_print_latency(struct mmc_test_card *test,
+				   const char *name, unsigned int sectors)
+{
+	struct mmc_test_latency_result *lr;
+	unsigned int cnt = test->lat_cnt;
+	u32 p50, p99, p999;
+
+	if (!cnt)
+		return;
+
+	sort(test->lat, cnt, sizeof(u32), mmc_test_lat_cmp, NULL);
+	p50 = mmc_test_lat_pct(test, 500);
+	p99 = mmc_test_lat_pct(test, 990);
+	p999 = mmc_test_lat_pct(test, 999);
+
+	pr_info("%s: %s: %u x %u sectors latency min %u p50 %u p99 %u "
+		"p99.9 %u max %u us\n", mmc_hostname(test->card->host), name,
+		cnt, sectors, test->lat[0], p50, p99, p999, test->lat[cnt - 1]);
+
+	if (!test->gr)
+		return;
+
+	lr = kmalloc(sizeof(struct mmc_test_latency_result), GFP_KERNEL);
+	if (!lr)
+		return;
+
+	lr->name = name;
+	lr->count = cnt;
+	lr->sectors = sectors;
+	lr->min = test->lat[0];
+	lr->p50 = p50;
+	lr->p99 = p99;
+	lr->p999 = p999;
+	lr->max = test->lat[cnt - 1];
+
+	list_add_tail(&lr->link, &test->gr->lat_lst);
+}
+
 /*
  * Return the card size in sectors.
  */
@@ -1919,32 +2058,41 @@ static unsigned int mmc_test_rnd_num(unsigned int rnd_cnt)
 	return (r * rnd_cnt) >> 15;
 }
 
-static int mmc_test_rnd_perf(struct mmc_test_card *test, int write, int print,
-			     unsigned long sz)
+/*
+ * Pick a random address of ssz sectors in the second quarter of the card,
+ * never in the same erase unit twice in a row.
+ */
+static unsigned int mmc_test_rnd_addr(struct mmc_test_card *test,
+				      unsigned int ssz, unsigned int *last_ea)
 {
-	unsigned int dev_addr, cnt, rnd_addr, range1, range2, last_ea = 0, ea;
-	unsigned int ssz;
-	struct timespec ts1, ts2, ts;
-	int ret;
-
-	ssz = sz >> 9;
+	unsigned int rnd_addr, range1, range2, ea;
 
 	rnd_addr = mmc_test_capacity(test->card) / 4;
 	range1 = rnd_addr / test->card->pref_erase;
 	range2 = range1 / ssz;
 
+	ea = mmc_test_rnd_num(range1);
+	if (ea == *last_ea)
+		ea -= 1;
+	*last_ea = ea;
+	return rnd_addr + test->card->pref_erase * ea +
+	       ssz * mmc_test_rnd_num(range2);
+}
+
+static int mmc_test_rnd_perf(struct mmc_test_card *test, int write, int print,
+			     unsigned long sz)
+{
+	unsigned int dev_addr, cnt, last_ea = 0;
+	struct timespec ts1, ts2, ts;
+	int ret;
+
 	getnstimeofday(&ts1);
 	for (cnt = 0; cnt < UINT_MAX; cnt++) {
 		getnstimeofday(&ts2);
 		ts = timespec_sub(ts2, ts1);
 		if (ts.tv_sec >= 10)
 			break;
-		ea = mmc_test_rnd_num(range1);
-		if (ea == last_ea)
-			ea -= 1;
-		last_ea = ea;
-		dev_addr = rnd_addr + test->card->pref_erase * ea +
-			   ssz * mmc_test_rnd_num(range2);
+		dev_addr = mmc_test_rnd_addr(test, sz >> 9, &last_ea);
 		ret = mmc_test_area_io(test, sz, dev_addr, write, 0, 0);
 		if (ret)
 			return ret;
@@ -2330,6 +2478,236 @@ static int mmc_test_profile_sglen_r_nonblock_perf(struct mmc_test_card *test)
 	return mmc_test_rw_multiple_sg_len(test, &test_data);
 }
 
+/*
+ * Prepare for latency tests.  Erase and fill the test area.
+ */
+static int mmc_test_area_prepare_latency(struct mmc_test_card *test)
+{
+	int ret;
+
+	test->lat = vmalloc(MMC_TEST_LAT_SAMPLES * sizeof(u32));
+	if (!test->lat)
+		return -ENOMEM;
+
+	ret = mmc_test_area_prepare_fill(test);
+	if (ret) {
+		vfree(test->lat);
+		test->lat = NULL;
+	}
+	return ret;
+}
+
+static int mmc_test_area_cleanup_latency(struct mmc_test_card *test)
+{
+	vfree(test->lat);
+	test->lat = NULL;
+	return mmc_test_area_cleanup(test);
+}
+
+/*
+ * Random 4KiB I/O latency over the second quarter of the card.
+ */
+static int mmc_test_rnd_latency(struct mmc_test_card *test, int write)
+{
+	unsigned int ssz = MMC_TEST_LAT_SZ >> 9, dev_addr, last_ea = 0;
+	struct timespec ts0, ts1, ts2;
+	int ret;
+
+	mmc_test_lat_reset(test);
+	getnstimeofday(&ts0);
+	while (!mmc_test_lat_done(test, &ts0)) {
+		dev_addr = mmc_test_rnd_addr(test, ssz, &last_ea);
+		getnstimeofday(&ts1);
+		ret = mmc_test_area_io(test, MMC_TEST_LAT_SZ, dev_addr, write,
+				       0, 0);
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_lat_add(test, &ts1, &ts2);
+	}
+	mmc_test_print_latency(test, write ? "rnd_write" : "rnd_read", ssz);
+	return 0;
+}
+
+static int mmc_test_rnd_read_latency(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_latency(test, 0);
+}
+
+static int mmc_test_rnd_write_latency(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_latency(test, 1);
+}
+
+/*
+ * Random 4KiB read latency while the card absorbs a sustained stream of
+ * maximum sized sequential writes to the test area.  Only one request can be
+ * outstanding, so every read is queued behind one write; this is what a
+ * foreground read sees while the page cache is being written back.
+ */
+static int mmc_test_mixed_latency(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int ssz = MMC_TEST_LAT_SZ >> 9, dev_addr, last_ea = 0;
+	unsigned int wr_addr = t->dev_addr, wr_cnt = 0;
+	struct timespec ts0, ts1, ts2;
+	int ret;
+
+	mmc_test_lat_reset(test);
+	getnstimeofday(&ts0);
+	while (!mmc_test_lat_done(test, &ts0)) {
+		ret = mmc_test_area_io(test, t->max_tfr, wr_addr, 1, 0, 0);
+		if (ret)
+			return ret;
+		wr_cnt++;
+		wr_addr += t->max_tfr >> 9;
+		if (wr_addr + (t->max_tfr >> 9) > t->dev_addr + (t->max_sz >> 9))
+			wr_addr = t->dev_addr;
+
+		dev_addr = mmc_test_rnd_addr(test, ssz, &last_ea);
+		getnstimeofday(&ts1);
+		ret = mmc_test_area_io(test, MMC_TEST_LAT_SZ, dev_addr, 0, 0, 0);
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_lat_add(test, &ts1, &ts2);
+	}
+	getnstimeofday(&ts2);
+	mmc_test_print_avg_rate(test, t->max_tfr, wr_cnt, &ts0, &ts2);
+	mmc_test_print_latency(test, "rnd_read_under_write", ssz);
+	return 0;
+}
+
+/*
+ * Journal commit latency.  Each transaction appends MMC_TEST_JOURNAL_BLOCKS
+ * 4KiB blocks to a circular log in the test area, flushes the cache, writes
+ * the commit block and flushes again, as a journalling file system does for
+ * every fsync() when barriers are on.  The whole transaction is timed.
+ */
+static int mmc_test_journal_latency(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int ssz = MMC_TEST_LAT_SZ >> 9, log_addr = t->dev_addr, i;
+	struct timespec ts0, ts1, ts2;
+	int ret;
+
+	mmc_test_lat_reset(test);
+	getnstimeofday(&ts0);
+	while (!mmc_test_lat_done(test, &ts0)) {
+		getnstimeofday(&ts1);
+		for (i = 0; i <= MMC_TEST_JOURNAL_BLOCKS; i++) {
+			if (i == MMC_TEST_JOURNAL_BLOCKS) {
+				ret = mmc_flush_cache(test->card);
+				if (ret)
+					return ret;
+			}
+			ret = mmc_test_area_io(test, MMC_TEST_LAT_SZ, log_addr,
+					       1, 0, 0);
+			if (ret)
+				return ret;
+			log_addr += ssz;
+			if (log_addr + ssz > t->dev_addr + (t->max_sz >> 9))
+				log_addr = t->dev_addr;
+		}
+		ret = mmc_flush_cache(test->card);
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_lat_add(test, &ts1, &ts2);
+	}
+	mmc_test_print_latency(test, "journal_commit",
+			       (MMC_TEST_JOURNAL_BLOCKS + 1) * ssz);
+	return 0;
+}
+
+/*
+ * Random 4KiB write latency within the test area.
+ */
+static int mmc_test_area_rnd_write_latency(struct mmc_test_card *test,
+					   const char *name)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int ssz = MMC_TEST_LAT_SZ >> 9, dev_addr;
+	struct timespec ts0, ts1, ts2;
+	int ret;
+
+	mmc_test_lat_reset(test);
+	getnstimeofday(&ts0);
+	while (!mmc_test_lat_done(test, &ts0)) {
+		dev_addr = t->dev_addr +
+			   ssz * mmc_test_rnd_num(t->max_sz / MMC_TEST_LAT_SZ);
+		getnstimeofday(&ts1);
+		ret = mmc_test_area_io(test, MMC_TEST_LAT_SZ, dev_addr, 1, 0, 0);
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_lat_add(test, &ts1, &ts2);
+	}
+	mmc_test_print_latency(test, name, ssz);
+	return 0;
+}
+
+/*
+ * Random 4KiB write latency on a completely written test area, then again
+ * once the area has been discarded (and optionally sanitized).  The time the
+ * discard itself took is reported as a transfer of the whole area.
+ */
+static int mmc_test_discard_latency(struct mmc_test_card *test, int sanitize)
+{
+	struct mmc_test_area *t = &test->area;
+	struct timespec ts1, ts2;
+	unsigned int arg;
+	int ret;
+
+	if (!mmc_can_erase(test->card))
+		return RESULT_UNSUP_HOST;
+
+	if (sanitize && !mmc_can_sanitize(test->card))
+		return RESULT_UNSUP_CARD;
+
+	if (mmc_can_discard(test->card))
+		arg = MMC_DISCARD_ARG;
+	else if (mmc_can_trim(test->card))
+		arg = MMC_TRIM_ARG;
+	else
+		arg = MMC_ERASE_ARG;
+
+	ret = mmc_test_area_io_seq(test, t->max_tfr, t->dev_addr, 1, 0, 0,
+				   t->max_sz / t->max_tfr, false, 0);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_area_rnd_write_latency(test, sanitize ?
+					      "before_sanitize" :
+					      "before_discard");
+	if (ret)
+		return ret;
+
+	getnstimeofday(&ts1);
+	ret = mmc_erase(test->card, t->dev_addr, t->max_sz >> 9, arg);
+	if (!ret && sanitize)
+		ret = mmc_switch(test->card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_SANITIZE_START, 1, 0);
+	if (ret)
+		return ret;
+	getnstimeofday(&ts2);
+	mmc_test_print_rate(test, t->max_sz, &ts1, &ts2);
+
+	return mmc_test_area_rnd_write_latency(test, sanitize ?
+					       "after_sanitize" :
+					       "after_discard");
+}
+
+static int mmc_test_discard_write_latency(struct mmc_test_card *test)
+{
+	return mmc_test_discard_latency(test, 0);
+}
+
+static int mmc_test_sanitize_write_latency(struct mmc_test_card *test)
+{
+	return mmc_test_discard_latency(test, 1);
+}
+
 /*
  * eMMC hardware reset.
  */
@@ -2682,6 +3060,48 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.name = "eMMC hardware reset",
 		.run = mmc_test_hw_reset,
 	},
+
+	{
+		.name = "Random 4KiB read latency",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_rnd_read_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
+
+	{
+		.name = "Random 4KiB write latency",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_rnd_write_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
+
+	{
+		.name = "Random 4KiB read latency under sustained write",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_mixed_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
+
+	{
+		.name = "Journal commit latency",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_journal_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
+
+	{
+		.name = "Random 4KiB write latency before and after discard",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_discard_write_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
+
+	{
+		.name = "Random 4KiB write latency before and after sanitize",
+		.prepare = mmc_test_area_prepare_latency,
+		.run = mmc_test_sanitize_write_latency,
+		.cleanup = mmc_test_area_cleanup_latency,
+	},
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -2722,6 +3142,7 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 			GFP_KERNEL);
 		if (gr) {
 			INIT_LIST_HEAD(&gr->tr_lst);
+			INIT_LIST_HEAD(&gr->lat_lst);
 
 			/* Assign data what we know already */
 			gr->card = test->card;
@@ -2791,6 +3212,7 @@ static void mmc_test_free_result(struct mmc_card *card)
 
 	list_for_each_entry_safe(gr, grs, &mmc_test_result, link) {
 		struct mmc_test_transfer_result *tr, *trs;
+		struct mmc_test_latency_result *lr, *lrs;
 
 		if (card && gr->card != card)
 			continue;
@@ -2800,6 +3222,11 @@ static void mmc_test_free_result(struct mmc_card *card)
 			kfree(tr);
 		}
 
+		list_for_each_entry_safe(lr, lrs, &gr->lat_lst, link) {
+			list_del(&lr->link);
+			kfree(lr);
+		}
+
 		list_del(&gr->link);
 		kfree(gr);
 	}
@@ -2932,6 +3359,47 @@ static const struct file_operations mmc_test_fops_testlist = {
 	.release	= single_release,
 };
 
+/*
+ * One line per latency measurement of the last run, times in microseconds:
+ * <test> <name> <count> <sectors> <min> <p50> <p99> <p99.9> <max>
+ */
+static int mtf_latency_show(struct seq_file *sf, void *data)
+{
+	struct mmc_card *card = (struct mmc_card *)sf->private;
+	struct mmc_test_general_result *gr;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry(gr, &mmc_test_result, link) {
+		struct mmc_test_latency_result *lr;
+
+		if (gr->card != card)
+			continue;
+
+		list_for_each_entry(lr, &gr->lat_lst, link)
+			seq_printf(sf, "%d %s %u %u %u %u %u %u %u\n",
+				gr->testcase + 1, lr->name, lr->count,
+				lr->sectors, lr->min, lr->p50, lr->p99,
+				lr->p999, lr->max);
+	}
+
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+static int mtf_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtf_latency_show, inode->i_private);
+}
+
+static const struct file_operations mmc_test_fops_latency = {
+	.open		= mtf_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void mmc_test_free_dbgfs_file(struct mmc_card *card)
 {
 	struct mmc_test_dbgfs_file *df, *dfs;
@@ -2997,6 +3465,11 @@ static int mmc_test_register_dbgfs_file(struct mmc_card *card)
 	if (ret)
 		goto err;
 
+	ret = __mmc_test_register_dbgfs_file(card, "latency", S_IRUGO,
+		&mmc_test_fops_latency);
+	if (ret)
+		goto err;
+
 err:
 	mutex_unlock(&mmc_test_lock);
 
@@ -241,6 +241,8 @@ struct mmc_card *mmc_alloc_card(struct mmc_host *host, struct device_type *type)
 		return ERR_PTR(-ENOMEM);
 
 	card->host = host;
+	INIT_DELAYED_WORK(&card->bkops_info.dw, mmc_bkops_work);
+	card->bkops_info.delay_ms = MMC_BKOPS_DELAY_MS;
 
 	device_initialize(&card->dev);
 
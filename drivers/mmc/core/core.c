@@ -354,6 +354,15 @@ struct mmc_async_req *mmc_start_req(struct mmc_host *host,
 	if (host->areq) {
 		mmc_wait_for_req_done(host, host->areq->mrq);
 		err = host->areq->err_check(host->card, host->areq);
+		/*
+		 * The card raises an exception event once its BKOPS
+		 * can't wait any longer.
+		 */
+		if (host->card && mmc_card_mmc(host->card) &&
+		    ((mmc_resp_type(host->areq->mrq->cmd) == MMC_RSP_R1) ||
+		     (mmc_resp_type(host->areq->mrq->cmd) == MMC_RSP_R1B)) &&
+		    (host->areq->mrq->cmd->resp[0] & R1_EXCEPTION_EVENT))
+			mmc_start_bkops(host->card, true);
 	}
 
 	if (!err && areq)
@@ -450,6 +459,156 @@ out:
 }
 EXPORT_SYMBOL(mmc_interrupt_hpi);
 
+/**
+ *	mmc_read_bkops_status - read the BKOPS urgency level of a card
+ *	@card: MMC card to check
+ *
+ *	Updates card->ext_csd.raw_bkops_status.
+ */
+int mmc_read_bkops_status(struct mmc_card *card)
+{
+	int err;
+	u8 *ext_csd;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	mmc_claim_host(card->host);
+	err = mmc_send_ext_csd(card, ext_csd);
+	mmc_release_host(card->host);
+	if (!err)
+		card->ext_csd.raw_bkops_status = ext_csd[EXT_CSD_BKOPS_STATUS];
+
+	kfree(ext_csd);
+	return err;
+}
+EXPORT_SYMBOL(mmc_read_bkops_status);
+
+/**
+ *	mmc_start_bkops - start BKOPS if the card needs them
+ *	@card: MMC card to start BKOPS on
+ *	@from_exception: the card raised an urgent BKOPS exception
+ *
+ *	From an exception, the BKOPS are only started when urgent and are
+ *	waited for. Otherwise they are left running, until the card is
+ *	done or until mmc_stop_bkops() interrupts them.
+ */
+void mmc_start_bkops(struct mmc_card *card, bool from_exception)
+{
+	struct mmc_bkops_info *bkops = &card->bkops_info;
+	unsigned int timeout;
+	int err;
+
+	BUG_ON(!card);
+
+	if (!card->ext_csd.bkops_en || mmc_card_doing_bkops(card))
+		return;
+
+	mmc_claim_host(card->host);
+
+	/* a request came in while we were waiting for the host */
+	if (!from_exception && bkops->cancel)
+		goto out;
+
+	err = mmc_read_bkops_status(card);
+	if (err) {
+		pr_err("%s: Failed to read bkops status: %d\n",
+		       mmc_hostname(card->host), err);
+		goto out;
+	}
+
+	bkops->level[min_t(u8, card->ext_csd.raw_bkops_status, 3)]++;
+	if (!card->ext_csd.raw_bkops_status)
+		goto out;
+
+	if (from_exception &&
+	    card->ext_csd.raw_bkops_status < EXT_CSD_BKOPS_LEVEL_2)
+		goto out;
+
+	timeout = from_exception ? MMC_BKOPS_MAX_TIMEOUT : 0;
+	bkops->start = ktime_get();
+	err = __mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BKOPS_START,
+			   1, timeout, from_exception);
+	if (err) {
+		pr_warning("%s: Error %d starting bkops\n",
+			   mmc_hostname(card->host), err);
+		goto out;
+	}
+
+	if (from_exception) {
+		bkops->urgent++;
+		bkops->time_us += ktime_us_delta(ktime_get(), bkops->start);
+	} else {
+		bkops->starts++;
+		mmc_card_set_doing_bkops(card);
+	}
+out:
+	mmc_release_host(card->host);
+}
+EXPORT_SYMBOL(mmc_start_bkops);
+
+void mmc_bkops_work(struct work_struct *work)
+{
+	struct mmc_card *card = container_of(work, struct mmc_card,
+					     bkops_info.dw.work);
+
+	mmc_start_bkops(card, false);
+}
+
+/**
+ *	mmc_start_delayed_bkops - start BKOPS once the card is idle
+ *	@card: MMC card to start BKOPS on
+ *
+ *	Called when the last request to @card completed. Without HPI the
+ *	next request could not interrupt the BKOPS, they are then left to
+ *	the urgent exception.
+ */
+void mmc_start_delayed_bkops(struct mmc_card *card)
+{
+	struct mmc_bkops_info *bkops = &card->bkops_info;
+
+	if (!card->ext_csd.bkops_en || !card->ext_csd.hpi_en ||
+	    mmc_card_doing_bkops(card))
+		return;
+
+	bkops->cancel = false;
+	mmc_schedule_delayed_work(&bkops->dw,
+				  msecs_to_jiffies(bkops->delay_ms));
+}
+EXPORT_SYMBOL(mmc_start_delayed_bkops);
+
+/**
+ *	mmc_stop_bkops - make way for a request
+ *	@card: MMC card to stop BKOPS on
+ *
+ *	Cancels the BKOPS not started yet and interrupts the running ones
+ *	with HPI. Must be called with the host claimed, before sending a
+ *	request to @card.
+ */
+int mmc_stop_bkops(struct mmc_card *card)
+{
+	struct mmc_bkops_info *bkops = &card->bkops_info;
+	int err;
+
+	BUG_ON(!card);
+
+	bkops->cancel = true;
+	cancel_delayed_work(&bkops->dw);
+
+	if (!mmc_card_doing_bkops(card))
+		return 0;
+
+	err = mmc_interrupt_hpi(card);
+	/* the card may have been done already */
+	bkops->time_us += ktime_us_delta(ktime_get(), bkops->start);
+	bkops->hpi++;
+	mmc_card_clr_doing_bkops(card);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_stop_bkops);
+
 /**
  *	mmc_wait_for_cmd - start a command and wait for completion
  *	@host: MMC host to start command
@@ -1247,6 +1406,20 @@ void mmc_power_off(struct mmc_host *host)
 	mmc_host_clk_release(host);
 }
 
+/*
+ * Power cycle the card and bring it back up at 3.3V signalling, keeping
+ * the OCR that was selected for it.
+ */
+void mmc_power_cycle(struct mmc_host *host)
+{
+	u32 ocr = host->ocr;
+
+	mmc_power_off(host);
+	host->ocr = ocr;
+	mmc_power_up(host);
+	mmc_set_signal_voltage(host, MMC_SIGNAL_VOLTAGE_330, false);
+}
+
 /*
  * Cleanup when the last reference to the bus operator is dropped.
  */
@@ -276,6 +276,7 @@ static int mmc_ext_csd_open(struct inode *inode, struct file *filp)
 	}
 
 	mmc_claim_host(card->host);
+	mmc_stop_bkops(card);
 	err = mmc_send_ext_csd(card, ext_csd);
 	mmc_release_host(card->host);
 	if (err)
@@ -318,6 +319,36 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+static int mmc_bkops_show(struct seq_file *s, void *unused)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_bkops_info *bkops = &card->bkops_info;
+
+	seq_printf(s, "enabled:\t%d\n", card->ext_csd.bkops_en);
+	seq_printf(s, "running:\t%d\n", !!mmc_card_doing_bkops(card));
+	seq_printf(s, "last status:\t%u\n", card->ext_csd.raw_bkops_status);
+	seq_printf(s, "status 0-3:\t%u %u %u %u\n", bkops->level[0],
+		   bkops->level[1], bkops->level[2], bkops->level[3]);
+	seq_printf(s, "idle starts:\t%u\n", bkops->starts);
+	seq_printf(s, "urgent starts:\t%u\n", bkops->urgent);
+	seq_printf(s, "interrupted:\t%u\n", bkops->hpi);
+	seq_printf(s, "time (us):\t%llu\n", bkops->time_us);
+
+	return 0;
+}
+
+static int mmc_bkops_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_bkops_show, inode->i_private);
+}
+
+static const struct file_operations mmc_dbg_bkops_fops = {
+	.open		= mmc_bkops_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -350,6 +381,15 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && card->ext_csd.bkops) {
+		if (!debugfs_create_file("bkops", S_IRUSR, root, card,
+					&mmc_dbg_bkops_fops))
+			goto err;
+		if (!debugfs_create_u32("bkops_delay_ms", S_IRUSR | S_IWUSR,
+					root, &card->bkops_info.delay_ms))
+			goto err;
+	}
+
 	return;
 
 err:
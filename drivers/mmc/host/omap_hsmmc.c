@@ -23,6 +23,8 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/platform_device.h>
 #include <linux/timer.h>
 #include <linux/clk.h>
@@ -138,9 +140,14 @@
 #define ADMA_XFER_INT		(1 << 3)
 #define AC12_SCLK_SEL		(1 << 23)
 #define AC12_UHSMC_MASK		(7 << 16)
+#define AC12_UHSMC_SDR12	(0 << 16)
+#define AC12_UHSMC_SDR25	(1 << 16)
 #define AC12_UHSMC_SDR50	(2 << 16)
 #define AC12_UHSMC_SDR104	(3 << 16)
+#define AC12_UHSMC_DDR50	(4 << 16)
 #define CAPA2_TSDR50		(1 << 13)
+#define CAPA2_TCRT_SHIFT	8
+#define CAPA2_TCRT_MASK		(0xF << CAPA2_TCRT_SHIFT)
 #define CAPA2_SDR104		(1 << 1)
 #define DLL_LOCK		(1 << 0)
 #define DLL_CALIB		(1 << 1)
@@ -156,6 +163,8 @@
 #define DMA_TABLE_NUM_ENTRIES	1024
 #define ADMA_TABLE_SZ \
 	(DMA_TABLE_NUM_ENTRIES * sizeof(struct adma_desc_table))
+/* one table for the running transfer, one for the request being prepared */
+#define ADMA_TABLE_NUM		2
 
 #define SDMA_XFER	1
 #define ADMA_XFER	2
@@ -171,6 +180,8 @@
 
 
 #define MMC_AUTOSUSPEND_DELAY	100
+#define MMC_AUTOSUSPEND_MIN_DELAY	20
+#define MMC_AUTOSUSPEND_MAX_DELAY	1000
 #define MMC_TIMEOUT_MS		20
 #define MMC_FSM_RESET_US	100
 #define MAX_PHASE_DELAY		0x7F
@@ -182,6 +193,12 @@
 
 #define EMMC_HSDDR_SD_SDR25_MAX	52000000
 #define SD_SDR50_MAX_FREQ	104000000
+/* Re-tuning period when CAPA2 does not give a usable one */
+#define OMAP_HSMMC_RETUNE_SECS	64
+
+#define OMAP_HSMMC_UHS_CAPS	(MMC_CAP_UHS_SDR12 | MMC_CAP_UHS_SDR25 | \
+				 MMC_CAP_UHS_SDR50 | MMC_CAP_UHS_SDR104 | \
+				 MMC_CAP_UHS_DDR50)
 
 #define AUTO_CMD12		(1 << 0)	/* Auto CMD12 support */
 
@@ -208,6 +225,18 @@
 struct omap_hsmmc_next {
 	unsigned int	dma_len;
 	s32		cookie;
+	int		adma_idx;
+	s64		setup_ns;
+};
+
+/* data transfer statistics, protected by irq_lock */
+struct omap_hsmmc_stats {
+	u32		reqs;		/* data requests completed */
+	u32		prepared;	/* mapped and set up by pre_req */
+	u64		bytes;
+	u64		xfer_ns;	/* from the data setup to the last block */
+	u64		setup_ns;	/* mapping and ADMA table, request path */
+	u64		pre_setup_ns;	/* same, done by pre_req */
 };
 
 struct adma_desc_table {
@@ -248,6 +277,7 @@ struct omap_hsmmc_host {
 	int			dma_type, dma_ch;
 	struct adma_desc_table	*adma_table;
 	dma_addr_t		phy_adma_table;
+	int			adma_idx;	/* table of the current request */
 	int			dma_line_tx, dma_line_rx;
 	int			slot_id;
 	int			got_dbclk;
@@ -265,7 +295,12 @@ struct omap_hsmmc_host {
 	int			tuning_fsrc;
 	u32			tuning_uhsmc;
 	u32			tuning_opcode;
+	struct timer_list	retune_timer;
+	unsigned int		retune_period;	/* seconds */
+	int			retune_needed;
 	struct omap_hsmmc_next	next_data;
+	ktime_t			xfer_start;
+	struct omap_hsmmc_stats	stats;
 
 	struct	omap_mmc_platform_data	*pdata;
 };
@@ -276,6 +311,8 @@ static u32 ref_tuning[16] = { 0x00FF0FFF, 0xCCC3CCFF, 0xFFCC3CC3, 0xEFFEFFFE,
 				0xFDFFFDFF, 0xFFBFFFDF, 0xFFF7FFBB, 0xDE7B7FF7,
 				};
 
+static int omap_execute_tuning(struct mmc_host *mmc, u32 opcode);
+
 static inline int omap_hsmmc_set_dll(struct omap_hsmmc_host *host, int count)
 {
 	u32 dll;
@@ -736,6 +773,67 @@ static void omap_hsmmc_set_bus_width(struct omap_hsmmc_host *host)
 	}
 }
 
+/* Re-tune on the next request rather than from the timer */
+static void omap_hsmmc_retune_timer(unsigned long data)
+{
+	struct omap_hsmmc_host *host = (struct omap_hsmmc_host *)data;
+
+	host->retune_needed = 1;
+}
+
+static void omap_hsmmc_stop_retune(struct omap_hsmmc_host *host)
+{
+	del_timer(&host->retune_timer);
+	host->retune_needed = 0;
+}
+
+/*
+ * Program the UHS-I mode of the SD slots.  Once SDR50/SDR104 have been
+ * tuned the mode belongs to omap_execute_tuning()/omap_hsmmc_restore_dll().
+ */
+static void omap_hsmmc_set_uhs_mode(struct omap_hsmmc_host *host)
+{
+	struct mmc_ios *ios = &host->mmc->ios;
+	u32 ac12, dll, uhsmc;
+
+	if (!(host->mmc->caps & OMAP_HSMMC_UHS_CAPS))
+		return;
+
+	switch (ios->timing) {
+	case MMC_TIMING_UHS_SDR25:
+		uhsmc = AC12_UHSMC_SDR25;
+		break;
+	case MMC_TIMING_UHS_SDR50:
+		uhsmc = AC12_UHSMC_SDR50;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+		uhsmc = AC12_UHSMC_SDR104;
+		break;
+	case MMC_TIMING_UHS_DDR50:
+		uhsmc = AC12_UHSMC_DDR50;
+		break;
+	default:
+		uhsmc = AC12_UHSMC_SDR12;
+		break;
+	}
+
+	if (uhsmc == AC12_UHSMC_SDR50 || uhsmc == AC12_UHSMC_SDR104) {
+		if (host->tuning_done)
+			return;
+	} else if (host->tuning_done) {
+		/* left the tuned modes, go back to the fixed sampling clock */
+		host->tuning_done = 0;
+		omap_hsmmc_stop_retune(host);
+		dll = OMAP_HSMMC_READ(host->base, DLL);
+		dll &= ~(DLL_FORCE_VALUE | DLL_SWT);
+		OMAP_HSMMC_WRITE(host->base, DLL, dll);
+	}
+
+	ac12 = OMAP_HSMMC_READ(host->base, AC12);
+	ac12 &= ~(AC12_UHSMC_MASK | AC12_SCLK_SEL);
+	OMAP_HSMMC_WRITE(host->base, AC12, ac12 | uhsmc);
+}
+
 static void omap_hsmmc_set_bus_mode(struct omap_hsmmc_host *host)
 {
 	struct mmc_ios *ios = &host->mmc->ios;
@@ -818,6 +916,8 @@ static int omap_hsmmc_context_restore(struct omap_hsmmc_host *host)
 
 	omap_hsmmc_set_bus_width(host);
 
+	omap_hsmmc_set_uhs_mode(host);
+
 	omap_hsmmc_set_clock(host);
 
 	omap_hsmmc_set_bus_mode(host);
@@ -974,7 +1074,9 @@ omap_hsmmc_start_command(struct omap_hsmmc_host *host, struct mmc_command *cmd,
 		cmdtype = 0x3;
 
 	cmdreg = (cmd->opcode << 24) | (resptype << 16) | (cmdtype << 22);
-	if ((host->flags & AUTO_CMD12) && mmc_op_multi(cmd->opcode))
+	/* the card stops on its own after a CMD23 bounded transfer */
+	if ((host->flags & AUTO_CMD12) && mmc_op_multi(cmd->opcode) &&
+	    !host->mrq->sbc)
 		cmdreg |= ACEN_ACMD12;
 
 	if (data) {
@@ -1052,15 +1154,23 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 			omap_hsmmc_get_dma_dir(host, data));
 
-	if (!data->error)
+	if (!data->error) {
 		data->bytes_xfered += data->blocks * (data->blksz);
-	else
+
+		spin_lock(&host->irq_lock);
+		host->stats.reqs++;
+		host->stats.bytes += data->bytes_xfered;
+		host->stats.xfer_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							     host->xfer_start));
+		spin_unlock(&host->irq_lock);
+	} else
 		data->bytes_xfered = 0;
 
-	if (data->stop && ((!(host->flags & AUTO_CMD12)) || data->error)) {
+	if (data->stop && (data->error ||
+	    (!(host->flags & AUTO_CMD12) && !data->mrq->sbc))) {
 		omap_hsmmc_start_command(host, data->stop, NULL);
 	} else {
-		if (data->stop)
+		if (data->stop && !data->mrq->sbc)
 			data->stop->resp[0] = OMAP_HSMMC_READ(host->base,
 							RSP76);
 		omap_hsmmc_request_done(host, data->mrq);
@@ -1108,6 +1218,17 @@ omap_hsmmc_cmd_done(struct omap_hsmmc_host *host, struct mmc_command *cmd)
 			cmd->resp[0] = OMAP_HSMMC_READ(host->base, RSP10);
 		}
 	}
+	/* the core does not set sbc->mrq */
+	if (cmd == host->mrq->sbc) {
+		/* the data is already set up, go on with the transfer */
+		if (!cmd->error) {
+			omap_hsmmc_start_command(host, host->mrq->cmd,
+						 host->mrq->data);
+			return;
+		}
+		omap_hsmmc_request_done(host, host->mrq);
+		return;
+	}
 	if ((host->data == NULL && !host->response_busy) || cmd->error)
 		omap_hsmmc_request_done(host, cmd->mrq);
 }
@@ -1255,6 +1376,9 @@ static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 				int err = (status & DATA_TIMEOUT) ?
 						-ETIMEDOUT : -EILSEQ;
 
+				/* the sampling point may have drifted */
+				if ((status & DATA_CRC) && host->tuning_done)
+					host->retune_needed = 1;
 				if (host->data)
 					omap_hsmmc_dma_cleanup(host, err);
 				else
@@ -1461,6 +1585,7 @@ static irqreturn_t omap_hsmmc_detect(int irq, void *dev_id)
 		mmc_detect_change(host->mmc, (HZ * 200) / 1000);
 	} else {
 		host->tuning_done = 0;
+		omap_hsmmc_stop_retune(host);
 	/*
 	 * Because of OMAP4 Silicon errata (i705), we have to turn off the
 	 * PBIAS and VMMC for SD card as soon as we get card disconnect
@@ -1573,11 +1698,70 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	}
 }
 
+static struct adma_desc_table *
+omap_hsmmc_adma_table(struct omap_hsmmc_host *host, int idx)
+{
+	return host->adma_table + idx * DMA_TABLE_NUM_ENTRIES;
+}
+
+/*
+ * Fill an ADMA table with the @dma_len mapped segments of @data, each
+ * split into rows of at most ADMA_MAX_XFER_PER_ROW bytes.
+ */
+static int omap_hsmmc_build_adma_table(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       unsigned int dma_len,
+				       struct adma_desc_table *pdesc)
+{
+	struct scatterlist *sg;
+	unsigned int bytes = 0;
+	int i, n = 0;
+
+	for_each_sg(data->sg, sg, dma_len, i) {
+		dma_addr_t addr = sg_dma_address(sg);
+		unsigned int len = sg_dma_len(sg);
+
+		bytes += len;
+		while (len) {
+			unsigned int row = min_t(unsigned int, len,
+						 ADMA_MAX_XFER_PER_ROW);
+
+			if (WARN_ON(n == DMA_TABLE_NUM_ENTRIES))
+				return -EINVAL;
+
+			pdesc[n].addr = addr;
+			pdesc[n].length = row;
+			pdesc[n].attr = ADMA_XFER_DESC | ADMA_XFER_VALID;
+			addr += row;
+			len -= row;
+			n++;
+		}
+	}
+
+	if (!n)
+		return -EINVAL;
+
+	/* Setup last entry to terminate */
+	pdesc[n - 1].attr |= ADMA_XFER_END;
+	WARN_ON(bytes != data->blocks * data->blksz);
+	dev_dbg(mmc_dev(host->mmc),
+		"ADMA table has %d entries from %d sglist\n", n, dma_len);
+	return n;
+}
+
+/*
+ * Map @data and, with ADMA, build its descriptor table. From pre_req
+ * (@next set) this is done while the previous request is still on the
+ * bus, into the table it is not using.
+ */
 static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 				       struct mmc_data *data,
 				       struct omap_hsmmc_next *next)
 {
-	int dma_len;
+	int dma_len, adma_idx, ret;
+	unsigned long flags;
+	ktime_t start;
+	s64 setup_ns;
 
 	if (!next && data->host_cookie &&
 	    data->host_cookie != host->next_data.cookie) {
@@ -1590,24 +1774,53 @@ static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 	/* Check if next job is already prepared */
 	if (next ||
 	    (!next && data->host_cookie != host->next_data.cookie)) {
+		start = ktime_get();
 		dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
 				     data->sg_len,
 				     omap_hsmmc_get_dma_dir(host, data));
+		if (dma_len == 0)
+			return -EINVAL;
 
+		adma_idx = next ? host->adma_idx ^ 1 : host->adma_idx;
+		if (host->dma_type == ADMA_XFER) {
+			ret = omap_hsmmc_build_adma_table(host, data, dma_len,
+					omap_hsmmc_adma_table(host, adma_idx));
+			if (ret < 0) {
+				dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+					     data->sg_len,
+					     omap_hsmmc_get_dma_dir(host, data));
+				return ret;
+			}
+		}
+		setup_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 	} else {
 		dma_len = host->next_data.dma_len;
+		adma_idx = host->next_data.adma_idx;
+		setup_ns = host->next_data.setup_ns;
 		host->next_data.dma_len = 0;
 	}
 
-
 	if (dma_len == 0)
 		return -EINVAL;
 
 	if (next) {
 		next->dma_len = dma_len;
+		next->adma_idx = adma_idx;
+		next->setup_ns = setup_ns;
 		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+		return 0;
+	}
+
+	host->dma_len = dma_len;
+	host->adma_idx = adma_idx;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	if (data->host_cookie) {
+		host->stats.prepared++;
+		host->stats.pre_setup_ns += setup_ns;
 	} else
-		host->dma_len = dma_len;
+		host->stats.setup_ns += setup_ns;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
 
 	return 0;
 }
@@ -1657,63 +1870,19 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 	return 0;
 }
 
-static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
-		struct mmc_request *req, struct adma_desc_table *pdesc)
+static int omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host,
+					  struct mmc_request *req)
 {
-	int i, j, dmalen;
-	int splitseg, xferaddr;
-	int numblocks = 0;
-	dma_addr_t dmaaddr;
-	struct mmc_data *data = req->data;
-	int ret = 0;
+	int ret;
 
-	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	ret = omap_hsmmc_pre_dma_transfer(host, req->data, NULL);
 	if (ret)
 		return ret;
-	for (i = 0, j = 0; i < host->dma_len; i++) {
-		dmaaddr = sg_dma_address(data->sg + i);
-		dmalen = sg_dma_len(data->sg + i);
-		numblocks += dmalen / data->blksz;
-
-		if (dmalen <= ADMA_MAX_XFER_PER_ROW) {
-			pdesc[i + j].length = dmalen;
-			pdesc[i + j].addr = dmaaddr;
-			pdesc[i + j].attr = (ADMA_XFER_DESC |
-				ADMA_XFER_VALID);
-		} else {
-			/* Each descriptor row can only support
-			 * transfer upto ADMA_MAX_XFER_PER_ROW.
-			 * If the current segment is bigger, it has to be
-			 * split to multiple ADMA table entries.
-			 */
-			xferaddr = 0;
-			do {
-				splitseg = min(dmalen, ADMA_MAX_XFER_PER_ROW);
-				dmalen -= splitseg;
-				pdesc[i + j].length = splitseg;
-				pdesc[i + j].addr =
-					dmaaddr + xferaddr;
-				xferaddr += splitseg;
-				pdesc[i + j].attr = (ADMA_XFER_DESC |
-					ADMA_XFER_VALID);
-				j++;
-			} while (dmalen);
-			j--; /* Compensate for i++ */
-		}
-	}
-	/* Setup last entry to terminate */
-	pdesc[i + j - 1].attr |= ADMA_XFER_END;
-	WARN_ON((i + j - 1) > DMA_TABLE_NUM_ENTRIES);
-	dev_dbg(mmc_dev(host->mmc),
-		"ADMA table has %d entries from %d sglist\n",
-		i + j, host->dma_len);
-	return numblocks;
-}
 
-static void omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host)
-{
 	wmb();
-	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, host->phy_adma_table);
+	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, host->phy_adma_table +
+			 host->adma_idx * ADMA_TABLE_SZ);
+	return 0;
 }
 
 static void set_data_timeout(struct omap_hsmmc_host *host,
@@ -1759,8 +1928,7 @@ static void set_data_timeout(struct omap_hsmmc_host *host,
 static int
 omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 {
-	int ret;
-	int numblks;
+	int ret = 0;
 
 	host->data = req->data;
 
@@ -1778,20 +1946,16 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 	OMAP_HSMMC_WRITE(host->base, BLK, (req->data->blksz)
 					| (req->data->blocks << 16));
 	set_data_timeout(host, req->data->timeout_ns, req->data->timeout_clks);
+	host->xfer_start = ktime_get();
 
-	if (host->dma_type == SDMA_XFER) {
+	if (host->dma_type == SDMA_XFER)
 		ret = omap_hsmmc_start_sdma_transfer(host, req);
-		if (ret != 0) {
-			dev_dbg(mmc_dev(host->mmc), "MMC start dma failure\n");
-			return ret;
-		}
-	} else if (host->dma_type == ADMA_XFER) {
-		numblks = mmc_populate_adma_desc_table(host,
-				req, host->adma_table);
-		WARN_ON(numblks != req->data->blocks);
-		omap_hsmmc_start_adma_transfer(host);
-	}
-	return 0;
+	else if (host->dma_type == ADMA_XFER)
+		ret = omap_hsmmc_start_adma_transfer(host, req);
+	if (ret)
+		dev_dbg(mmc_dev(host->mmc), "MMC start dma failure\n");
+
+	return ret;
 }
 
 static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
@@ -1875,6 +2039,13 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 		return;
 	}
 
+	if (host->retune_needed) {
+		err = omap_execute_tuning(mmc, host->tuning_opcode);
+		if (err)
+			dev_warn(mmc_dev(host->mmc),
+				"re-tuning failed: %d\n", err);
+	}
+
 	host->mrq = req;
 	err = omap_hsmmc_prepare_data(host, req);
 	if (err) {
@@ -1886,7 +2057,10 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 		return;
 	}
 
-	omap_hsmmc_start_command(host, req->cmd, req->data);
+	if (req->sbc)
+		omap_hsmmc_start_command(host, req->sbc, NULL);
+	else
+		omap_hsmmc_start_command(host, req->cmd, req->data);
 }
 
 /* Routine to configure clock values. Exposed API to core */
@@ -1920,6 +2094,8 @@ static void omap_hsmmc_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 
 	omap_hsmmc_set_bus_width(host);
 
+	omap_hsmmc_set_uhs_mode(host);
+
 	if (host->pdata->controller_flags & OMAP_HSMMC_SUPPORTS_DUAL_VOLT) {
 		/* Only MMC1 can interface at 3V without some flavor
 		 * of external transceiver; but they all handle 1.8V.
@@ -2047,6 +2223,7 @@ static int omap_execute_tuning(struct mmc_host *mmc, u32 opcode)
 
 	host  = mmc_priv(mmc);
 	host->tuning_done = 0;
+	host->retune_needed = 0;
 	/* clock tuning is not needed for upto 52MHz */
 	if (ios->clock <= EMMC_HSDDR_SD_SDR25_MAX)
 		return 0;
@@ -2063,8 +2240,11 @@ static int omap_execute_tuning(struct mmc_host *mmc, u32 opcode)
 	 * Capabilities register.
 	 */
 	if (ios->clock <= SD_SDR50_MAX_FREQ) {
-		if (!(capa2 & CAPA2_TSDR50))
+		if (!(capa2 & CAPA2_TSDR50)) {
+			OMAP_HSMMC_WRITE(host->base, AC12,
+					ac12 | AC12_UHSMC_SDR50);
 			return 0;
+		}
 		ac12 |= AC12_UHSMC_SDR50;
 	} else
 		ac12 |= AC12_UHSMC_SDR104;
@@ -2166,6 +2346,7 @@ static int omap_execute_tuning(struct mmc_host *mmc, u32 opcode)
 
 	if (note_index == 0xFF) {
 		dev_err(mmc_dev(host->mmc), "Unable to find match\n");
+		err = -EIO;
 		goto tuning_error;
 	}
 
@@ -2178,7 +2359,6 @@ manual_tuning:
 		dll = OMAP_HSMMC_READ(host->base, DLL);
 		dll &= ~DLL_SWT;
 		OMAP_HSMMC_WRITE(host->base, DLL, dll);
-		count = 2 * (max_index + (max_window >> 1));
 		if (omap_hsmmc_set_dll(host, count)) {
 			err = -EIO;
 			goto tuning_error;
@@ -2188,6 +2368,9 @@ manual_tuning:
 					& AC12_UHSMC_MASK);
 		host->tuning_opcode = opcode;
 		host->tuning_done = 1;
+		/* the sampling point drifts with temperature */
+		mod_timer(&host->retune_timer,
+			  jiffies + host->retune_period * HZ);
 		omap_hsmmc_reset_controller_fsm(host, SRD);
 		omap_hsmmc_reset_controller_fsm(host, SRC);
 		return 0;
@@ -2218,9 +2401,9 @@ static int omap_start_signal_voltage_switch(struct mmc_host *mmc,
 	u32 value = 0;
 	unsigned long timeout;
 	unsigned long notimeout = 0;
+	int ret = 0;
 
-	if (!(mmc->caps & (MMC_CAP_UHS_SDR12 |
-			MMC_CAP_UHS_SDR25 | MMC_CAP_UHS_DDR50)))
+	if (!(mmc->caps & OMAP_HSMMC_UHS_CAPS))
 		return 0;
 
 	host  = mmc_priv(mmc);
@@ -2275,9 +2458,14 @@ static int omap_start_signal_voltage_switch(struct mmc_host *mmc,
 		value |= SDBP;
 		OMAP_HSMMC_WRITE(host->base, HCTL, value);
 
-		mmc_slot(host).set_power(host->dev, host->slot_id,
+		ret = mmc_slot(host).set_power(host->dev, host->slot_id,
 						 1, VDD_165_195);
-		dev_dbg(mmc_dev(host->mmc), "i/o voltage switch to 1.8v\n\n");
+		if (ret)
+			dev_err(mmc_dev(host->mmc),
+				"PBIAS switch to 1.8v failed: %d\n", ret);
+		else
+			dev_dbg(mmc_dev(host->mmc),
+				"i/o voltage switch to 1.8v\n\n");
 	}
 
 	if (mmc_slot(host).clk_pull_up)
@@ -2298,8 +2486,10 @@ static int omap_start_signal_voltage_switch(struct mmc_host *mmc,
 		usleep_range(100, 200);
 		value = OMAP_HSMMC_READ(host->base, PSTATE);
 	} while (!time_after(jiffies, timeout));
-	if (!notimeout)
+	if (!notimeout) {
 		dev_err(mmc_dev(host->mmc), "timeout wait for clev 1\n");
+		ret = -EAGAIN;
+	}
 
 	notimeout = 0;
 	timeout = jiffies + msecs_to_jiffies(50);
@@ -2311,12 +2501,27 @@ static int omap_start_signal_voltage_switch(struct mmc_host *mmc,
 		usleep_range(100, 200);
 		value = OMAP_HSMMC_READ(host->base, PSTATE);
 	} while (!time_after(jiffies, timeout));
-	if (!notimeout)
+	if (!notimeout) {
 		dev_err(mmc_dev(host->mmc), "timeout wait for dlev 1\n");
+		ret = -EAGAIN;
+	}
 
 	value = OMAP_HSMMC_READ(host->base, CON);
 	OMAP_HSMMC_WRITE(host->base, CON, (value & ~(CLKEXTFREE | PADEN)));
 
+	/*
+	 * The card is stuck between the two levels: go back to 3V on our
+	 * side and let the core power cycle it and retry without S18R.
+	 */
+	if (ret) {
+		ios->signal_voltage = MMC_SIGNAL_VOLTAGE_330;
+		omap_hsmmc_conf_bus_power(host);
+		value = OMAP_HSMMC_READ(host->base, AC12);
+		OMAP_HSMMC_WRITE(host->base, AC12,
+				value & ~OMAP_V1V8_SIGEN_V1V8);
+		return -EAGAIN;
+	}
+
 	return 0;
 }
 
@@ -2390,11 +2595,74 @@ static const struct file_operations mmc_regs_fops = {
 	.release        = single_release,
 };
 
+static int omap_hsmmc_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *mmc = s->private;
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct omap_hsmmc_stats stats;
+	unsigned long flags;
+	u64 kbps = 0;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	stats = host->stats;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	if (stats.xfer_ns)
+		kbps = div64_u64(stats.bytes * (NSEC_PER_SEC / 1024),
+				 stats.xfer_ns);
+
+	seq_printf(s, "dma:\t\t%s\n", host->dma_type == ADMA_XFER ? "adma" :
+		   host->dma_type == SDMA_XFER ? "sdma" : "none");
+	seq_printf(s, "requests:\t%u\n", stats.reqs);
+	seq_printf(s, "prepared:\t%u\n", stats.prepared);
+	seq_printf(s, "bytes:\t\t%llu\n", stats.bytes);
+	seq_printf(s, "xfer time (us):\t%llu\n",
+		   div_u64(stats.xfer_ns, NSEC_PER_USEC));
+	seq_printf(s, "throughput:\t%llu KiB/s\n", kbps);
+	seq_printf(s, "setup (us):\t%llu\n",
+		   div_u64(stats.setup_ns, NSEC_PER_USEC));
+	seq_printf(s, "pre setup (us):\t%llu\n",
+		   div_u64(stats.pre_setup_ns, NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int omap_hsmmc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_hsmmc_stats_show, inode->i_private);
+}
+
+static ssize_t omap_hsmmc_stats_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct omap_hsmmc_host *host = mmc_priv(s->private);
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	memset(&host->stats, 0, sizeof(host->stats));
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations mmc_stats_fops = {
+	.open           = omap_hsmmc_stats_open,
+	.read           = seq_read,
+	.write          = omap_hsmmc_stats_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static void omap_hsmmc_debugfs(struct mmc_host *mmc)
 {
-	if (mmc->debugfs_root)
+	if (mmc->debugfs_root) {
 		debugfs_create_file("regs", S_IRUSR, mmc->debugfs_root,
 			mmc, &mmc_regs_fops);
+		debugfs_create_file("xfer_stats", S_IRUSR | S_IWUSR,
+			mmc->debugfs_root, mmc, &mmc_stats_fops);
+	}
 }
 
 #else
@@ -2469,6 +2737,7 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 	struct resource *res;
 	int ret, irq;
 	int ctrlr_caps = 0;
+	u32 tcrt;
 	const struct of_device_id *match;
 
 	match = of_match_device(of_match_ptr(omap_mmc_of_match), &pdev->dev);
@@ -2552,6 +2821,8 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 
 	spin_lock_init(&host->irq_lock);
 	init_completion(&host->buf_ready);
+	setup_timer(&host->retune_timer, omap_hsmmc_retune_timer,
+		    (unsigned long)host);
 
 	host->fclk = clk_get(&pdev->dev, "fck");
 	if (IS_ERR(host->fclk)) {
@@ -2571,10 +2842,20 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 	pm_runtime_enable(host->dev);
 	pm_runtime_get_sync(host->dev);
 	pm_runtime_set_autosuspend_delay(host->dev, MMC_AUTOSUSPEND_DELAY);
+	pm_runtime_set_autosuspend_bounds(host->dev, MMC_AUTOSUSPEND_MIN_DELAY,
+					  MMC_AUTOSUSPEND_MAX_DELAY);
 	pm_runtime_use_autosuspend(host->dev);
 
 	omap_hsmmc_context_save(host);
 
+	/* CAPA2 gives the re-tuning period as 2^(n - 1) seconds, n = 1..11 */
+	tcrt = (OMAP_HSMMC_READ(host->base, CAPA2) & CAPA2_TCRT_MASK) >>
+		CAPA2_TCRT_SHIFT;
+	if (tcrt >= 1 && tcrt <= 11)
+		host->retune_period = 1 << (tcrt - 1);
+	else
+		host->retune_period = OMAP_HSMMC_RETUNE_SECS;
+
 	if (cpu_is_omap2430()) {
 		host->dbclk = clk_get(&pdev->dev, "mmchsdb_fck");
 		/*
@@ -2598,7 +2879,8 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 		 * due to unset conherency mask
 		 */
 		host->adma_table = dma_alloc_coherent(NULL,
-			ADMA_TABLE_SZ, &host->phy_adma_table, 0);
+			ADMA_TABLE_SZ * ADMA_TABLE_NUM,
+			&host->phy_adma_table, 0);
 		if (host->adma_table != NULL)
 			host->dma_type = ADMA_XFER;
 	}
@@ -2750,7 +3032,7 @@ err_irq:
 	host->fclk = NULL;
 err1:
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLE_SZ * ADMA_TABLE_NUM,
 			host->adma_table, host->phy_adma_table);
 	iounmap(host->base);
 err_ioremap:
@@ -2770,6 +3052,7 @@ static int __devexit omap_hsmmc_remove(struct platform_device *pdev)
 
 	pm_runtime_get_sync(host->dev);
 	mmc_remove_host(host->mmc);
+	del_timer_sync(&host->retune_timer);
 	if (host->use_reg)
 		omap_hsmmc_reg_put(host);
 	if (host->pdata->cleanup)
@@ -2778,7 +3061,7 @@ static int __devexit omap_hsmmc_remove(struct platform_device *pdev)
 	if (mmc_slot(host).card_detect_irq)
 		free_irq(mmc_slot(host).card_detect_irq, host);
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLE_SZ * ADMA_TABLE_NUM,
 			host->adma_table, host->phy_adma_table);
 	pm_runtime_put_sync(host->dev);
 	pm_runtime_disable(host->dev);
@@ -2835,6 +3118,10 @@ static int omap_hsmmc_suspend(struct device *dev)
 		}
 		goto err;
 	}
+	del_timer_sync(&host->retune_timer);
+	/* a card kept powered is not tuned again by the core */
+	host->retune_needed = host->tuning_done &&
+			(host->mmc->pm_flags & MMC_PM_KEEP_POWER);
 	host->tuning_done = 0;
 
 	if (!(host->mmc->pm_flags & MMC_PM_KEEP_POWER)) {
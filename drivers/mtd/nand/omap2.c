@@ -20,10 +20,15 @@
 #include <linux/mtd/partitions.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <plat/dma.h>
 #include <plat/gpmc.h>
 #include <plat/nand.h>
+#include <plat/elm.h>
 
 #define	DRIVER_NAME	"omap2-nand"
 #define	OMAP_NAND_TIMEOUT_MS	5000
@@ -108,6 +113,11 @@ static struct nand_bbt_descr bb_descrip_flashbased = {
 	.pattern = scan_ff_pattern,
 };
 
+struct omap_nand_stats {
+	unsigned long	ops;
+	u64		bytes;
+	u64		ns;
+};
 
 struct omap_nand_info {
 	struct nand_hw_control		controller;
@@ -127,8 +137,29 @@ struct omap_nand_info {
 	} iomode;
 	u_char				*buf;
 	int					buf_len;
+
+	/* a posted dma write, finished by omap_nand_dma_wait() */
+	bool				dma_pending;
+	dma_addr_t			dma_addr;
+	unsigned int			dma_len;
+
+	/* BCH with ELM: correction level and sectors per engine run */
+	int				bch_nerrors;
+	int				bch_sectors;
+
+	/* mtd level throughput */
+	int (*mtd_read)(struct mtd_info *mtd, loff_t from, size_t len,
+			size_t *retlen, u_char *buf);
+	int (*mtd_write)(struct mtd_info *mtd, loff_t to, size_t len,
+			 size_t *retlen, const u_char *buf);
+	spinlock_t			stats_lock;
+	struct omap_nand_stats		rd_stats, wr_stats;
+	unsigned long			elm_decodes;
+	struct dentry			*debugfs;
 };
 
+static void omap_nand_dma_wait(struct omap_nand_info *info);
+
 /**
  * omap_hwcontrol - hardware specific access to control-lines
  * @mtd: MTD device structure
@@ -145,6 +176,8 @@ static void omap_hwcontrol(struct mtd_info *mtd, int cmd, unsigned int ctrl)
 	struct omap_nand_info *info = container_of(mtd,
 					struct omap_nand_info, mtd);
 
+	omap_nand_dma_wait(info);
+
 	if (cmd != NAND_CMD_NONE) {
 		if (ctrl & NAND_CLE)
 			gpmc_nand_write(info->gpmc_cs, GPMC_NAND_COMMAND, cmd);
@@ -337,12 +370,44 @@ static void omap_nand_dma_cb(int lch, u16 ch_status, void *data)
 	complete((struct completion *) data);
 }
 
+/*
+ * omap_nand_dma_wait: finish the outstanding dma transfer, if any
+ * @info: nand device
+ *
+ * Writes are posted: the transfer is left running when write_buf returns
+ * and only waited for here, before the controller is next touched by a
+ * command, an ecc engine access or another transfer.
+ */
+static void omap_nand_dma_wait(struct omap_nand_info *info)
+{
+	unsigned long tim, limit;
+
+	if (!info->dma_pending)
+		return;
+
+	wait_for_completion(&info->comp);
+	tim = 0;
+	limit = (loops_per_jiffy * msecs_to_jiffies(OMAP_NAND_TIMEOUT_MS));
+	while (gpmc_read_status(GPMC_PREFETCH_COUNT) && (tim++ < limit))
+		cpu_relax();
+
+	/* disable and stop the PFPW engine */
+	gpmc_prefetch_reset(info->gpmc_cs);
+
+	dma_unmap_single(&info->pdev->dev, info->dma_addr, info->dma_len,
+			 DMA_TO_DEVICE);
+	info->dma_pending = false;
+}
+
 /*
  * omap_nand_dma_transfer: configer and start dma transfer
  * @mtd: MTD device structure
  * @addr: virtual address in RAM of source/destination
  * @len: number of data bytes to be transferred
  * @is_write: flag for read/write operation
+ *
+ * Reads complete before returning; writes are posted, see
+ * omap_nand_dma_wait().
  */
 static inline int omap_nand_dma_transfer(struct mtd_info *mtd, void *addr,
 					unsigned int len, int is_write)
@@ -361,6 +426,8 @@ static inline int omap_nand_dma_transfer(struct mtd_info *mtd, void *addr,
 	 */
 	int buf_len = len >> 6;
 
+	omap_nand_dma_wait(info);
+
 	if (addr >= high_memory) {
 		struct page *p1;
 
@@ -408,6 +475,13 @@ static inline int omap_nand_dma_transfer(struct mtd_info *mtd, void *addr,
 
 	omap_start_dma(info->dma_ch);
 
+	if (is_write) {
+		info->dma_addr = dma_addr;
+		info->dma_len = len;
+		info->dma_pending = true;
+		return 0;
+	}
+
 	/* setup and start DMA using dma_addr */
 	wait_for_completion(&info->comp);
 	tim = 0;
@@ -439,6 +513,10 @@ out_copy:
  */
 static void omap_read_buf_dma_pref(struct mtd_info *mtd, u_char *buf, int len)
 {
+	struct omap_nand_info *info = container_of(mtd,
+					struct omap_nand_info, mtd);
+
+	omap_nand_dma_wait(info);
 	if (len <= mtd->oobsize)
 		omap_read_buf_pref(mtd, buf, len);
 	else
@@ -455,9 +533,13 @@ static void omap_read_buf_dma_pref(struct mtd_info *mtd, u_char *buf, int len)
 static void omap_write_buf_dma_pref(struct mtd_info *mtd,
 					const u_char *buf, int len)
 {
-	if (len <= mtd->oobsize)
+	struct omap_nand_info *info = container_of(mtd,
+					struct omap_nand_info, mtd);
+
+	if (len <= mtd->oobsize) {
+		omap_nand_dma_wait(info);
 		omap_write_buf_pref(mtd, buf, len);
-	else
+	} else
 		/* start transfer in DMA mode */
 		omap_nand_dma_transfer(mtd, (u_char *) buf, len, 0x1);
 }
@@ -843,6 +925,8 @@ static int omap_calculate_ecc(struct mtd_info *mtd, const u_char *dat,
 {
 	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
 							mtd);
+
+	omap_nand_dma_wait(info);
 	return gpmc_calculate_ecc(info->gpmc_cs, dat, ecc_code);
 }
 
@@ -858,9 +942,233 @@ static void omap_enable_hwecc(struct mtd_info *mtd, int mode)
 	struct nand_chip *chip = mtd->priv;
 	unsigned int dev_width = (chip->options & NAND_BUSWIDTH_16) ? 1 : 0;
 
+	omap_nand_dma_wait(info);
 	gpmc_enable_hwecc(info->gpmc_cs, mode, dev_width, info->nand.ecc.size);
 }
 
+/**
+ * omap_enable_hwecc_bch - start the BCH engine
+ * @mtd: MTD device structure
+ * @mode: Read/Write mode
+ *
+ * Writes go through nand_write_page_hwecc() a sector at a time; reads
+ * through omap_read_page_bch(), which runs the engine over the whole page.
+ */
+static void omap_enable_hwecc_bch(struct mtd_info *mtd, int mode)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	struct nand_chip *chip = mtd->priv;
+	unsigned int dev_width = (chip->options & NAND_BUSWIDTH_16) ? 1 : 0;
+
+	omap_nand_dma_wait(info);
+	info->bch_sectors = mode == NAND_ECC_READ ? chip->ecc.steps : 1;
+	gpmc_enable_hwecc_bch(info->gpmc_cs, mode, dev_width,
+			      info->bch_sectors, info->bch_nerrors);
+}
+
+/**
+ * omap_calculate_ecc_bch - read the BCH code (write) or syndrome (read)
+ * @mtd: MTD device structure
+ * @dat: unused, the engine saw the data on the bus
+ * @ecc_code: ecc.bytes per sector run
+ */
+static int omap_calculate_ecc_bch(struct mtd_info *mtd, const u_char *dat,
+				  u_char *ecc_code)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+
+	omap_nand_dma_wait(info);
+	return gpmc_calculate_ecc_bch(info->gpmc_cs, info->bch_sectors,
+				      info->bch_nerrors, ecc_code);
+}
+
+static bool omap_bch_erased(const u_char *ecc, int len)
+{
+	while (len--)
+		if (*ecc++ != 0xff)
+			return false;
+	return true;
+}
+
+/**
+ * omap_correct_data_bch - fix the bit errors the ELM locates
+ * @mtd: MTD device structure
+ * @dat: page data, bch_sectors sectors of it
+ * @read_ecc: ecc read from the spare area
+ * @syndrome: syndromes from omap_calculate_ecc_bch()
+ *
+ * Sectors with a zero syndrome are clean and sectors whose ecc reads back
+ * as all 0xff are erased; everything else goes to the ELM in one batch.
+ * Returns the number of corrected bits, or -1 if any sector is beyond
+ * repair.
+ */
+static int omap_correct_data_bch(struct mtd_info *mtd, u_char *dat,
+				 u_char *read_ecc, u_char *syndrome)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	int eccbytes = info->nand.ecc.bytes;
+	int codebits = (512 + BCH_ECC_BYTES(info->bch_nerrors)) * 8;
+	struct elm_errorvec err_vec[ELM_MAX_VECTORS];
+	bool any = false;
+	int i, j, stat = 0;
+
+	memset(err_vec, 0, sizeof(err_vec));
+	for (i = 0; i < info->bch_sectors; i++) {
+		if (omap_bch_erased(read_ecc + i * eccbytes, eccbytes) ||
+		    !memchr_inv(syndrome + i * eccbytes, 0, eccbytes))
+			continue;
+		err_vec[i].error_reported = true;
+		any = true;
+	}
+	if (!any)
+		return 0;
+
+	info->elm_decodes++;
+	if (omap_elm_decode_page(info->bch_nerrors, syndrome,
+				 info->bch_sectors, err_vec))
+		return -1;
+
+	for (i = 0; i < info->bch_sectors; i++) {
+		if (!err_vec[i].error_reported)
+			continue;
+		if (err_vec[i].error_uncorrectable)
+			return -1;
+
+		for (j = 0; j < err_vec[i].error_count; j++) {
+			/* bch4 codes are padded by a nibble to whole bytes */
+			int pos = err_vec[i].error_loc[j] +
+				(info->bch_nerrors == 4 ? 4 : 0);
+			int byte = (codebits - pos - 1) / 8;
+
+			/* errors in the ecc bytes themselves need no fixing */
+			if (byte < 512)
+				dat[i * 512 + byte] ^= 1 << (pos % 8);
+		}
+		stat += err_vec[i].error_count;
+	}
+	return stat;
+}
+
+/**
+ * omap_read_page_bch - read a page with the BCH engine in syndrome mode
+ * @mtd: MTD device structure
+ * @chip: NAND chip structure
+ * @buf: page data
+ * @page: page number
+ *
+ * The engine has to see each sector's ecc right after the whole page's
+ * data, so the ecc is read back with a column change before the syndromes
+ * are collected; the full spare area is then read for the caller.
+ */
+static int omap_read_page_bch(struct mtd_info *mtd, struct nand_chip *chip,
+			      uint8_t *buf, int page)
+{
+	uint8_t *ecc_calc = chip->buffers->ecccalc;
+	uint8_t *ecc_code = chip->buffers->ecccode;
+	uint32_t *eccpos = chip->ecc.layout->eccpos;
+	int stat;
+
+	chip->ecc.hwctl(mtd, NAND_ECC_READ);
+	chip->read_buf(mtd, buf, mtd->writesize);
+	chip->cmdfunc(mtd, NAND_CMD_RNDOUT, mtd->writesize + eccpos[0], -1);
+	chip->read_buf(mtd, ecc_code, chip->ecc.total);
+	chip->ecc.calculate(mtd, buf, ecc_calc);
+
+	chip->cmdfunc(mtd, NAND_CMD_RNDOUT, mtd->writesize, -1);
+	chip->read_buf(mtd, chip->oob_poi, mtd->oobsize);
+
+	stat = chip->ecc.correct(mtd, buf, ecc_code, ecc_calc);
+	if (stat < 0)
+		mtd->ecc_stats.failed++;
+	else
+		mtd->ecc_stats.corrected += stat;
+	return 0;
+}
+
+static void omap_nand_account(struct omap_nand_info *info,
+			      struct omap_nand_stats *st, size_t bytes,
+			      ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&info->stats_lock);
+	st->ops++;
+	st->bytes += bytes;
+	st->ns += ns;
+	spin_unlock(&info->stats_lock);
+}
+
+static int omap_nand_mtd_read(struct mtd_info *mtd, loff_t from, size_t len,
+			      size_t *retlen, u_char *buf)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = info->mtd_read(mtd, from, len, retlen, buf);
+	omap_nand_account(info, &info->rd_stats, *retlen, start);
+	return ret;
+}
+
+static int omap_nand_mtd_write(struct mtd_info *mtd, loff_t to, size_t len,
+			       size_t *retlen, const u_char *buf)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = info->mtd_write(mtd, to, len, retlen, buf);
+	omap_nand_account(info, &info->wr_stats, *retlen, start);
+	return ret;
+}
+
+static void omap_nand_show_stats(struct seq_file *s, const char *name,
+				 struct omap_nand_stats *st)
+{
+	u64 us = div_u64(st->ns, NSEC_PER_USEC);
+
+	seq_printf(s, "%s: %lu ops, %llu bytes, %llu us, %llu KiB/s\n", name,
+		   st->ops, st->bytes, us,
+		   us ? div64_u64(st->bytes * USEC_PER_SEC, us) >> 10 : 0);
+}
+
+static int omap_nand_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_nand_info *info = s->private;
+	struct omap_nand_stats rd, wr;
+
+	spin_lock(&info->stats_lock);
+	rd = info->rd_stats;
+	wr = info->wr_stats;
+	spin_unlock(&info->stats_lock);
+
+	omap_nand_show_stats(s, "read", &rd);
+	omap_nand_show_stats(s, "write", &wr);
+	seq_printf(s, "ecc: %u corrected, %u failed\n",
+		   info->mtd.ecc_stats.corrected, info->mtd.ecc_stats.failed);
+	if (info->bch_nerrors)
+		seq_printf(s, "elm: bch%d, %lu pages decoded\n",
+			   info->bch_nerrors, info->elm_decodes);
+	return 0;
+}
+
+static int omap_nand_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_nand_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap_nand_stats_fops = {
+	.open		= omap_nand_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /**
  * omap_wait - wait until the command is done
  * @mtd: MTD device structure
@@ -881,6 +1189,8 @@ static int omap_wait(struct mtd_info *mtd, struct nand_chip *chip)
 	unsigned long timeo = jiffies;
 	int status = NAND_STATUS_FAIL, state = this->state;
 
+	omap_nand_dma_wait(info);
+
 	if (state == FL_ERASING)
 		timeo += (HZ * 400) / 1000;
 	else
@@ -946,6 +1256,8 @@ static int __devinit omap_nand_probe(struct platform_device *pdev)
 
 	spin_lock_init(&info->controller.lock);
 	init_waitqueue_head(&info->controller.wq);
+	spin_lock_init(&info->stats_lock);
+	info->dma_ch = -1;
 
 	info->pdev = pdev;
 
@@ -1063,6 +1375,24 @@ static int __devinit omap_nand_probe(struct platform_device *pdev)
 		info->nand.ecc.hwctl            = omap_enable_hwecc;
 		info->nand.ecc.correct          = omap_correct_data;
 		info->nand.ecc.mode             = NAND_ECC_HW;
+	} else if ((pdata->ecc_opt == OMAP_ECC_BCH4_CODE_HW) ||
+		(pdata->ecc_opt == OMAP_ECC_BCH8_CODE_HW)) {
+		if (!omap_elm_present()) {
+			dev_err(&pdev->dev, "BCH ecc needs the ELM\n");
+			err = -ENODEV;
+			goto out_release_mem_region;
+		}
+		info->bch_nerrors = pdata->ecc_opt == OMAP_ECC_BCH8_CODE_HW ?
+					8 : 4;
+		info->nand.ecc.bytes            = BCH_ECC_OOB_BYTES(
+							info->bch_nerrors);
+		info->nand.ecc.size             = 512;
+		info->nand.ecc.strength         = info->bch_nerrors;
+		info->nand.ecc.calculate        = omap_calculate_ecc_bch;
+		info->nand.ecc.hwctl            = omap_enable_hwecc_bch;
+		info->nand.ecc.correct          = omap_correct_data_bch;
+		info->nand.ecc.read_page        = omap_read_page_bch;
+		info->nand.ecc.mode             = NAND_ECC_HW;
 	}
 
 	/* DIP switches on some boards change between 8 and 16 bit
@@ -1096,12 +1426,42 @@ static int __devinit omap_nand_probe(struct platform_device *pdev)
 		info->nand.ecc.layout = &omap_oobinfo;
 	}
 
+	/* BCH ecc follows the bad block marker, one slot per sector */
+	if (info->bch_nerrors) {
+		int steps = info->mtd.writesize / info->nand.ecc.size;
+
+		offset = 2;
+		omap_oobinfo.eccbytes = info->nand.ecc.bytes * steps;
+		if (steps > ELM_MAX_VECTORS ||
+		    offset + omap_oobinfo.eccbytes > info->mtd.oobsize) {
+			dev_err(&pdev->dev, "no room for bch%d in the oob\n",
+				info->bch_nerrors);
+			err = -EINVAL;
+			goto out_release_mem_region;
+		}
+		for (i = 0; i < omap_oobinfo.eccbytes; i++)
+			omap_oobinfo.eccpos[i] = i + offset;
+
+		omap_oobinfo.oobfree->offset = offset + omap_oobinfo.eccbytes;
+		omap_oobinfo.oobfree->length = info->mtd.oobsize -
+					(offset + omap_oobinfo.eccbytes);
+
+		info->nand.ecc.layout = &omap_oobinfo;
+	}
+
 	/* second phase scan */
 	if (nand_scan_tail(&info->mtd)) {
 		err = -ENXIO;
 		goto out_release_mem_region;
 	}
 
+	info->mtd_read = info->mtd._read;
+	info->mtd._read = omap_nand_mtd_read;
+	info->mtd_write = info->mtd._write;
+	info->mtd._write = omap_nand_mtd_write;
+	info->debugfs = debugfs_create_file(dev_name(&pdev->dev), S_IRUGO,
+					    NULL, info, &omap_nand_stats_fops);
+
 	mtd_device_parse_register(&info->mtd, NULL, NULL, pdata->parts,
 				  pdata->nr_parts);
 
@@ -1124,6 +1484,8 @@ static int omap_nand_remove(struct platform_device *pdev)
 							mtd);
 
 	platform_set_drvdata(pdev, NULL);
+	debugfs_remove(info->debugfs);
+	omap_nand_dma_wait(info);
 	if (info->dma_ch != -1)
 		omap_free_dma(info->dma_ch);
 
@@ -0,0 +1,282 @@
+/*
+ * OMAP4 Error Location Module
+ *
+ * The ELM takes the BCH syndrome the GPMC computed while a page was read
+ * back and returns the bit positions of the errors, which spares the cpu
+ * the Berlekamp-Massey and Chien search steps of BCH decoding.  Up to eight
+ * syndromes, one per 512 byte sector, are decoded in parallel in page mode.
+ *
+ * Copyright (C) 2012 Texas Instruments
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
+#include <linux/pm_runtime.h>
+#include <asm/unaligned.h>
+
+#include <plat/gpmc.h>
+#include <plat/elm.h>
+
+#define ELM_SYSCONFIG			0x010
+#define ELM_IRQSTATUS			0x018
+#define ELM_IRQENABLE			0x01c
+#define ELM_LOCATION_CONFIG		0x020
+#define ELM_PAGE_CTRL			0x080
+#define ELM_SYNDROME_FRAGMENT_0		0x400
+#define ELM_SYNDROME_FRAGMENT_6		0x418
+#define ELM_LOCATION_STATUS		0x800
+#define ELM_ERROR_LOCATION_0		0x880
+
+#define ELM_INTR_PAGE_VALID		BIT(8)
+#define ELM_BCH_LEVEL_4			0
+#define ELM_BCH_LEVEL_8			1
+#define ELM_ECC_SIZE			(0x7ff << 16)
+#define ELM_SYNDROME_VALID		BIT(16)
+#define ELM_ECC_CORRECTABLE		BIT(8)
+#define ELM_ECC_NB_ERRORS_MASK		0x1f
+#define ELM_ERROR_LOCATION_MASK		0x1fff
+
+#define ELM_SYNDROME_STRIDE		0x40
+#define ELM_LOCATION_STRIDE		0x100
+#define ELM_TIMEOUT_MS			100
+
+struct omap_elm {
+	struct device		*dev;
+	void __iomem		*base;
+	int			irq;
+	struct completion	done;
+	struct mutex		lock;		/* one page decode at a time */
+};
+
+static struct omap_elm *omap_elm;
+
+static inline u32 elm_read_reg(struct omap_elm *elm, u16 idx)
+{
+	return __raw_readl(elm->base + idx);
+}
+
+static inline void elm_write_reg(struct omap_elm *elm, u16 idx, u32 val)
+{
+	__raw_writel(val, elm->base + idx);
+}
+
+/* syndrome bytes are most significant first, as the GPMC hands them out */
+static void elm_load_syndrome(struct omap_elm *elm, int nerrors, int vec,
+			      const u8 *ecc)
+{
+	u16 off = ELM_SYNDROME_FRAGMENT_0 + ELM_SYNDROME_STRIDE * vec;
+
+	if (nerrors == 8) {
+		elm_write_reg(elm, off, get_unaligned_be32(&ecc[9]));
+		elm_write_reg(elm, off + 4, get_unaligned_be32(&ecc[5]));
+		elm_write_reg(elm, off + 8, get_unaligned_be32(&ecc[1]));
+		elm_write_reg(elm, off + 12, ecc[0]);
+	} else {
+		/* 52 bits, left aligned in 7 bytes */
+		elm_write_reg(elm, off, (get_unaligned_be32(&ecc[3]) >> 4) |
+				((ecc[2] & 0xf) << 28));
+		elm_write_reg(elm, off + 4, get_unaligned_be32(&ecc[0]) >> 12);
+	}
+}
+
+static irqreturn_t omap_elm_isr(int irq, void *dev_id)
+{
+	struct omap_elm *elm = dev_id;
+	u32 status = elm_read_reg(elm, ELM_IRQSTATUS);
+
+	if (!(status & ELM_INTR_PAGE_VALID))
+		return IRQ_NONE;
+
+	elm_write_reg(elm, ELM_IRQSTATUS, ELM_INTR_PAGE_VALID);
+	complete(&elm->done);
+	return IRQ_HANDLED;
+}
+
+/**
+ * omap_elm_present - whether an ELM has been probed
+ */
+bool omap_elm_present(void)
+{
+	return omap_elm != NULL;
+}
+EXPORT_SYMBOL_GPL(omap_elm_present);
+
+/**
+ * omap_elm_decode_page - locate the errors of up to eight sectors
+ * @nerrors: BCH level, 4 or 8
+ * @syndrome: BCH_ECC_OOB_BYTES(@nerrors) bytes of syndrome per sector
+ * @nvecs: number of sectors
+ * @err_vec: per sector results; only sectors with error_reported set are
+ *	decoded, the others are left alone
+ *
+ * Sleeps until the ELM has processed all requested sectors.
+ */
+int omap_elm_decode_page(int nerrors, const u8 *syndrome, int nvecs,
+			 struct elm_errorvec *err_vec)
+{
+	struct omap_elm *elm = omap_elm;
+	u32 page_ctrl = 0, status;
+	int i, j, ret = 0;
+
+	if (!elm)
+		return -ENODEV;
+	if ((nerrors != 4 && nerrors != 8) || nvecs > ELM_MAX_VECTORS)
+		return -EINVAL;
+
+	for (i = 0; i < nvecs; i++)
+		if (err_vec[i].error_reported)
+			page_ctrl |= BIT(i);
+	if (!page_ctrl)
+		return 0;
+
+	mutex_lock(&elm->lock);
+	pm_runtime_get_sync(elm->dev);
+
+	elm_write_reg(elm, ELM_LOCATION_CONFIG, ELM_ECC_SIZE |
+		(nerrors == 8 ? ELM_BCH_LEVEL_8 : ELM_BCH_LEVEL_4));
+	elm_write_reg(elm, ELM_PAGE_CTRL, page_ctrl);
+
+	INIT_COMPLETION(elm->done);
+	elm_write_reg(elm, ELM_IRQSTATUS, ELM_INTR_PAGE_VALID);
+	elm_write_reg(elm, ELM_IRQENABLE, ELM_INTR_PAGE_VALID);
+
+	for (i = 0; i < nvecs; i++)
+		if (page_ctrl & BIT(i))
+			elm_load_syndrome(elm, nerrors, i,
+				syndrome + i * BCH_ECC_OOB_BYTES(nerrors));
+
+	/* kick all the loaded vectors */
+	for (i = 0; i < nvecs; i++) {
+		u16 off = ELM_SYNDROME_FRAGMENT_6 + ELM_SYNDROME_STRIDE * i;
+
+		if (page_ctrl & BIT(i))
+			elm_write_reg(elm, off, elm_read_reg(elm, off) |
+					ELM_SYNDROME_VALID);
+	}
+
+	if (!wait_for_completion_timeout(&elm->done,
+				msecs_to_jiffies(ELM_TIMEOUT_MS))) {
+		dev_err(elm->dev, "timeout locating errors\n");
+		ret = -ETIMEDOUT;
+	}
+	elm_write_reg(elm, ELM_IRQENABLE, 0);
+
+	for (i = 0; !ret && i < nvecs; i++) {
+		u16 off = ELM_ERROR_LOCATION_0 + ELM_LOCATION_STRIDE * i;
+
+		if (!(page_ctrl & BIT(i)))
+			continue;
+
+		status = elm_read_reg(elm,
+				ELM_LOCATION_STATUS + ELM_LOCATION_STRIDE * i);
+		if (!(status & ELM_ECC_CORRECTABLE)) {
+			err_vec[i].error_uncorrectable = true;
+			continue;
+		}
+
+		err_vec[i].error_count = status & ELM_ECC_NB_ERRORS_MASK;
+		for (j = 0; j < err_vec[i].error_count; j++)
+			err_vec[i].error_loc[j] = elm_read_reg(elm,
+				off + 4 * j) & ELM_ERROR_LOCATION_MASK;
+	}
+
+	elm_write_reg(elm, ELM_PAGE_CTRL, 0);
+	pm_runtime_put(elm->dev);
+	mutex_unlock(&elm->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(omap_elm_decode_page);
+
+static int __devinit omap_elm_probe(struct platform_device *pdev)
+{
+	struct omap_elm *elm;
+	struct resource *res;
+	int ret;
+
+	if (omap_elm)
+		return -EBUSY;
+
+	elm = kzalloc(sizeof(*elm), GFP_KERNEL);
+	if (!elm)
+		return -ENOMEM;
+
+	elm->dev = &pdev->dev;
+	mutex_init(&elm->lock);
+	init_completion(&elm->done);
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	elm->irq = platform_get_irq(pdev, 0);
+	if (!res || elm->irq < 0) {
+		dev_err(&pdev->dev, "no resources\n");
+		ret = -ENODEV;
+		goto err_free;
+	}
+
+	elm->base = ioremap(res->start, resource_size(res));
+	if (!elm->base) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	ret = request_irq(elm->irq, omap_elm_isr, 0, dev_name(&pdev->dev),
+			  elm);
+	if (ret) {
+		dev_err(&pdev->dev, "can't get irq %d\n", elm->irq);
+		goto err_unmap;
+	}
+
+	pm_runtime_enable(&pdev->dev);
+	platform_set_drvdata(pdev, elm);
+	omap_elm = elm;
+
+	return 0;
+
+err_unmap:
+	iounmap(elm->base);
+err_free:
+	kfree(elm);
+	return ret;
+}
+
+static int __devexit omap_elm_remove(struct platform_device *pdev)
+{
+	struct omap_elm *elm = platform_get_drvdata(pdev);
+
+	omap_elm = NULL;
+	pm_runtime_disable(&pdev->dev);
+	free_irq(elm->irq, elm);
+	iounmap(elm->base);
+	kfree(elm);
+	platform_set_drvdata(pdev, NULL);
+	return 0;
+}
+
+static struct platform_driver omap_elm_driver = {
+	.probe		= omap_elm_probe,
+	.remove		= __devexit_p(omap_elm_remove),
+	.driver		= {
+		.name	= "elm",
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init omap_elm_init(void)
+{
+	return platform_driver_register(&omap_elm_driver);
+}
+/* before the nand driver, which checks for us at probe time */
+subsys_initcall(omap_elm_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("OMAP4 ELM driver for BCH error location");
@@ -149,7 +149,14 @@ sdioh_attach(osl_t *osh, void *bar0, uint irq)
 	sd->sd_blockmode = TRUE;
 	sd->use_client_ints = TRUE;
 	sd->client_block_size[0] = 64;
+#ifdef BCMSDIOH_TXGLOM
+	/* Packet chains go out in one scatter-gather CMD53 if the host takes them */
+	sd->use_rxchain = (gInstance->func[1]->card->host->max_segs >=
+	                   SDIOH_SDMMC_MAX_SG_ENTRIES);
+#else
 	sd->use_rxchain = FALSE;
+#endif
+	sg_init_table(sd->sg_list, SDIOH_SDMMC_MAX_SG_ENTRIES);
 
 	gInstance->sd = sd;
 
@@ -917,7 +924,7 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 	for (pnext = pkt; pnext; pnext = PKTNEXT(sd->osh, pnext))
 		ttl_len += PKTLEN(sd->osh, pnext);
 
-	if (!sd->use_rxchain || ttl_len <= sd->client_block_size[func]) {
+	if (!sd->use_rxchain || ttl_len < sd->client_block_size[func]) {
 		blk_num = 0;
 		dma_len = 0;
 	} else {
@@ -950,15 +957,15 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 				pkt = pnext;
 			}
 
-			sg_set_buf(&sd->sg_list[SGCount++],
-				(uint8*)PKTDATA(sd->osh, pnext),
-				pkt_len);
-
 			if (SGCount >= SDIOH_SDMMC_MAX_SG_ENTRIES) {
 				sd_err(("%s: sg list entries exceed limit\n",
 					__FUNCTION__));
 				return (SDIOH_API_RC_FAIL);
 			}
+
+			sg_set_buf(&sd->sg_list[SGCount++],
+				(uint8*)PKTDATA(sd->osh, pnext),
+				pkt_len);
 		}
 
 		mmc_dat.sg = sd->sg_list;
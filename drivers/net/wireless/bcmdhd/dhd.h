@@ -449,6 +449,14 @@ extern void dhd_os_sdunlock_sndup_rxq(dhd_pub_t * pub);
 extern void dhd_os_sdlock_eventq(dhd_pub_t * pub);
 extern void dhd_os_sdunlock_eventq(dhd_pub_t * pub);
 extern bool dhd_os_check_hang(dhd_pub_t *dhdp, int ifidx, int ret);
+#ifdef DHD_NAPI
+struct bcmstrbuf;
+extern void dhd_os_napi_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
+#endif /* DHD_NAPI */
+#ifdef DHD_WAKE_FILTER
+struct bcmstrbuf;
+extern void dhd_os_wake_filter_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
+#endif /* DHD_WAKE_FILTER */
 
 #ifdef PNO_SUPPORT
 extern int dhd_pno_enable(dhd_pub_t *dhd, int pfn_enabled);
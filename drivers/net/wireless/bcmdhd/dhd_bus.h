@@ -97,6 +97,12 @@ extern void *dhd_bus_pub(struct dhd_bus *bus);
 extern void *dhd_bus_txq(struct dhd_bus *bus);
 extern uint dhd_bus_hdrlen(struct dhd_bus *bus);
 
+#ifdef BCMSDIOH_TXGLOM
+/* Tx superframes: whether the host side can send them, turn them on/off */
+extern bool dhd_bus_txglom_capable(dhd_pub_t *dhdp);
+extern void dhd_bus_txglom_enable(dhd_pub_t *dhdp, bool enable);
+#endif /* BCMSDIOH_TXGLOM */
+
 
 #define DHD_SET_BUS_STATE_DOWN(_bus)  do { \
 	(_bus)->dhd->busstate = DHD_BUS_DOWN; \
@@ -249,6 +249,16 @@ dhd_dump(dhd_pub_t *dhdp, char *buf, int buflen)
 	/* Add any bus info */
 	dhd_bus_dump(dhdp, strbuf);
 
+#ifdef DHD_NAPI
+	bcm_bprintf(strbuf, "\n");
+	dhd_os_napi_dump(dhdp, strbuf);
+#endif /* DHD_NAPI */
+
+#ifdef DHD_WAKE_FILTER
+	bcm_bprintf(strbuf, "\n");
+	dhd_os_wake_filter_dump(dhdp, strbuf);
+#endif /* DHD_WAKE_FILTER */
+
 	return (!strbuf->size ? BCME_BUFTOOSHORT : 0);
 }
 
@@ -70,6 +70,17 @@
 #include <dhd_bta.h>
 #endif
 
+#ifdef DHD_WAKE_FILTER
+#ifndef PKT_FILTER_SUPPORT
+#error DHD_WAKE_FILTER requires PKT_FILTER_SUPPORT
+#endif /* !PKT_FILTER_SUPPORT */
+#include <linux/suspend.h>
+#include <linux/ipv6.h>
+#include <net/tcp.h>
+#include <net/udp.h>
+#include <proto/bcmip.h>
+#endif /* DHD_WAKE_FILTER */
+
 #ifdef WLMEDIA_HTSF
 #include <linux/time.h>
 #include <htsf.h>
@@ -223,6 +234,34 @@ static uint32 maxdelay = 0, tspktcnt = 0, maxdelaypktno = 0;
 #endif  /* WLMEDIA_HTSF */
 
 /* Local private structure (extension of pub) */
+#ifdef DHD_NAPI
+/* Batch size histogram buckets: 1, 2-3, 4-7, ... 64 and more */
+#define DHD_NAPI_HIST_BUCKETS	7
+#endif /* DHD_NAPI */
+
+#ifdef DHD_WAKE_FILTER
+#define DHD_WF_MAX_PORTS	32	/* more and the unicast filter is kept */
+#define DHD_WF_FILTER_BASE	200	/* pktfilter ids, 100 is the unicast one */
+#define DHD_WF_WAKE_WINDOW_MS	1000	/* first frame this soon after resume */
+
+typedef struct dhd_wf_port {
+	uint16 port;
+	uint8 proto;		/* IP_PROT_TCP or IP_PROT_UDP */
+	uint8 ipv6;
+} dhd_wf_port_t;
+
+enum {
+	DHD_WF_WAKE_TCP,	/* to a port in the filter set */
+	DHD_WF_WAKE_UDP,
+	DHD_WF_WAKE_CLOSED,	/* tcp/udp to a port not in the set */
+	DHD_WF_WAKE_ARP,
+	DHD_WF_WAKE_BCMC,
+	DHD_WF_WAKE_EVENT,	/* dongle event */
+	DHD_WF_WAKE_OTHER,
+	DHD_WF_WAKE_MAX
+};
+#endif /* DHD_WAKE_FILTER */
+
 typedef struct dhd_info {
 #if defined(CONFIG_WIRELESS_EXT)
 	wl_iw_t		iw;		/* wireless extensions state (must be first) */
@@ -295,6 +334,32 @@ typedef struct dhd_info {
 	bool rpcth_timer_active;
 	bool fdaggr;
 #endif
+#ifdef DHD_NAPI
+	/* Receive frames are handed from the DPC to a NAPI poll for GRO */
+	struct napi_struct napi;
+	bool napi_enabled;
+	struct sk_buff_head rx_napi_queue;	/* filled by the DPC */
+	struct sk_buff_head rx_napi_process;	/* poll private */
+	uint32 napi_polls;
+	uint32 napi_pkts;
+	uint32 napi_max_batch;
+	uint32 napi_budget_hits;
+	uint32 napi_hist[DHD_NAPI_HIST_BUCKETS];	/* polls by batch size */
+#endif /* DHD_NAPI */
+#ifdef DHD_WAKE_FILTER
+	/* Port filters installed for the length of a kernel suspend */
+	struct notifier_block wf_pm_notifier;
+	dhd_wf_port_t wf_ports[DHD_WF_MAX_PORTS];
+	int wf_nports;
+	bool wf_armed;
+	bool wf_wake_pending;		/* classify the next received frame */
+	unsigned long wf_resume_time;	/* jiffies */
+	uint32 wf_suspends;
+	uint32 wf_fallbacks;		/* suspends with the unicast filter */
+	uint32 wf_wakes[DHD_WF_WAKE_MAX];
+	uint8 wf_last_proto;
+	uint16 wf_last_port;
+#endif /* DHD_WAKE_FILTER */
 } dhd_info_t;
 
 
@@ -330,6 +395,18 @@ module_param_string(nvram_path, nvram_path, MOD_PARAM_PATHLEN, 0);
 uint dhd_watchdog_ms = 0;
 module_param(dhd_watchdog_ms, uint, 0);
 
+#ifdef DHD_NAPI
+/* Receive frames delivered per NAPI poll */
+uint dhd_napi_weight = 64;
+module_param(dhd_napi_weight, uint, 0);
+#endif /* DHD_NAPI */
+
+#ifdef DHD_WAKE_FILTER
+/* Derive the suspend packet filters from the local sockets */
+uint dhd_wake_filter = TRUE;
+module_param(dhd_wake_filter, uint, 0644);
+#endif /* DHD_WAKE_FILTER */
+
 #if defined(DHD_DEBUG)
 /* Console poll interval */
 uint dhd_console_ms = 0;
@@ -541,6 +618,298 @@ static void dhd_set_packet_filter(int value, dhd_pub_t *dhd)
 #endif
 }
 
+#ifdef DHD_WAKE_FILTER
+/*
+ * While the kernel is suspended the dongle should only wake us for a port
+ * somebody uses.  Right before suspend the TCP and UDP socket tables are
+ * walked and each local port of a listening or established TCP socket or a
+ * bound UDP socket gets a unicast pattern filter; those replace the catch
+ * all unicast filter until resume.  If there are more ports than filters,
+ * the unicast filter simply stays.
+ */
+static int
+dhd_wf_add_port(dhd_wf_port_t *ports, int n, uint8 proto, uint8 ipv6, uint16 port)
+{
+	int i;
+
+	if (n > DHD_WF_MAX_PORTS)
+		return n;
+	for (i = 0; i < n; i++)
+		if (ports[i].port == port && ports[i].proto == proto &&
+		    ports[i].ipv6 == ipv6)
+			return n;
+	if (n < DHD_WF_MAX_PORTS) {
+		ports[n].port = port;
+		ports[n].proto = proto;
+		ports[n].ipv6 = ipv6;
+	}
+	return n + 1;
+}
+
+static int
+dhd_wf_add_sock(dhd_wf_port_t *ports, int n, struct sock *sk, uint8 proto,
+	struct net *net)
+{
+	uint16 port = inet_sk(sk)->inet_num;
+
+	if (!port || !net_eq(sock_net(sk), net))
+		return n;
+	if (sk->sk_family == AF_INET6) {
+		n = dhd_wf_add_port(ports, n, proto, 1, port);
+		if (ipv6_only_sock(sk))
+			return n;
+	}
+	return dhd_wf_add_port(ports, n, proto, 0, port);
+}
+
+/* Returns the number of distinct ports, DHD_WF_MAX_PORTS + 1 on overflow */
+static int
+dhd_wf_collect(dhd_wf_port_t *ports, struct net *net)
+{
+	struct inet_hashinfo *hi = &tcp_hashinfo;
+	struct hlist_nulls_node *node;
+	struct sock *sk;
+	int i, n = 0;
+
+	for (i = 0; i < INET_LHTABLE_SIZE; i++) {
+		struct inet_listen_hashbucket *ilb = &hi->listening_hash[i];
+
+		spin_lock_bh(&ilb->lock);
+		sk_nulls_for_each(sk, node, &ilb->head)
+			n = dhd_wf_add_sock(ports, n, sk, IP_PROT_TCP, net);
+		spin_unlock_bh(&ilb->lock);
+	}
+
+	for (i = 0; i <= hi->ehash_mask && n <= DHD_WF_MAX_PORTS; i++) {
+		struct inet_ehash_bucket *head = &hi->ehash[i];
+		spinlock_t *lock = inet_ehash_lockp(hi, i);
+
+		if (hlist_nulls_empty(&head->chain))
+			continue;
+		spin_lock_bh(lock);
+		sk_nulls_for_each(sk, node, &head->chain)
+			if (sk->sk_state == TCP_ESTABLISHED)
+				n = dhd_wf_add_sock(ports, n, sk, IP_PROT_TCP, net);
+		spin_unlock_bh(lock);
+	}
+
+	for (i = 0; i <= udp_table.mask && n <= DHD_WF_MAX_PORTS; i++) {
+		struct udp_hslot *hslot = &udp_table.hash[i];
+
+		if (hlist_nulls_empty(&hslot->head))
+			continue;
+		spin_lock_bh(&hslot->lock);
+		sk_nulls_for_each(sk, node, &hslot->head)
+			n = dhd_wf_add_sock(ports, n, sk, IP_PROT_UDP, net);
+		spin_unlock_bh(&hslot->lock);
+	}
+
+	return n;
+}
+
+/* "<id> 0 0 0 <mask> <pattern>", matching from the ethernet header on */
+static void
+dhd_wf_filter_str(char *buf, int len, int id, const dhd_wf_port_t *p)
+{
+	uint8 mask[ETHER_HDR_LEN + IPV6_MIN_HLEN + 4];
+	uint8 pattern[sizeof(mask)];
+	int i, off, plen;
+
+	memset(mask, 0, sizeof(mask));
+	memset(pattern, 0, sizeof(pattern));
+
+	/* unicast only, like the catch all filter */
+	mask[0] = 0x01;
+	mask[ETHER_TYPE_OFFSET] = mask[ETHER_TYPE_OFFSET + 1] = 0xff;
+	if (p->ipv6) {
+		hton16_ua_store(ETHER_TYPE_IPV6, &pattern[ETHER_TYPE_OFFSET]);
+		mask[ETHER_HDR_LEN + IPV6_NEXT_HDR_OFFSET] = 0xff;
+		pattern[ETHER_HDR_LEN + IPV6_NEXT_HDR_OFFSET] = p->proto;
+		off = ETHER_HDR_LEN + IPV6_MIN_HLEN;
+	} else {
+		hton16_ua_store(ETHER_TYPE_IP, &pattern[ETHER_TYPE_OFFSET]);
+		/* no IP options, so the ports are at a fixed offset */
+		mask[ETHER_HDR_LEN + IPV4_VER_HL_OFFSET] = 0xff;
+		pattern[ETHER_HDR_LEN + IPV4_VER_HL_OFFSET] = 0x45;
+		mask[ETHER_HDR_LEN + IPV4_PROT_OFFSET] = 0xff;
+		pattern[ETHER_HDR_LEN + IPV4_PROT_OFFSET] = p->proto;
+		off = ETHER_HDR_LEN + IPV4_OPTIONS_OFFSET;
+	}
+	/* destination port, the same place for TCP and UDP */
+	mask[off + 2] = mask[off + 3] = 0xff;
+	hton16_ua_store(p->port, &pattern[off + 2]);
+	plen = off + 4;
+
+	i = snprintf(buf, len, "%d 0 0 0 0x", id);
+	for (off = 0; off < plen; off++)
+		i += snprintf(buf + i, len - i, "%02x", mask[off]);
+	i += snprintf(buf + i, len - i, " 0x");
+	for (off = 0; off < plen; off++)
+		i += snprintf(buf + i, len - i, "%02x", pattern[off]);
+}
+
+static void
+dhd_wf_arm(dhd_info_t *dhd)
+{
+	dhd_pub_t *dhdp = &dhd->pub;
+	char filter[2 * 2 * (ETHER_HDR_LEN + IPV6_MIN_HLEN + 4) + 32];
+	int i, n;
+
+	dhd->wf_suspends++;
+	n = dhd_wf_collect(dhd->wf_ports, dev_net(dhd->iflist[0]->net));
+	if (n == 0 || n > DHD_WF_MAX_PORTS) {
+		DHD_TRACE(("%s: %d ports, keeping the unicast filter\n", __FUNCTION__, n));
+		dhd->wf_nports = 0;
+		dhd->wf_fallbacks++;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		dhd_wf_filter_str(filter, sizeof(filter), DHD_WF_FILTER_BASE + i,
+			&dhd->wf_ports[i]);
+		dhd_pktfilter_offload_set(dhdp, filter);
+		dhd_pktfilter_offload_enable(dhdp, filter, 1, dhd_master_mode);
+	}
+	dhd->wf_nports = n;
+
+	/* the port filters are in, now the catch all can go */
+	for (i = 0; i < dhdp->pktfilter_count; i++)
+		dhd_pktfilter_offload_enable(dhdp, dhdp->pktfilter[i], 0,
+			dhd_master_mode);
+	dhd->wf_armed = TRUE;
+}
+
+static void
+dhd_wf_disarm(dhd_info_t *dhd)
+{
+	dhd_pub_t *dhdp = &dhd->pub;
+	char iovbuf[32];
+	uint32 id;
+	int i;
+
+	if (!dhd->wf_armed)
+		return;
+
+	for (i = 0; i < dhdp->pktfilter_count; i++)
+		dhd_pktfilter_offload_enable(dhdp, dhdp->pktfilter[i], 1,
+			dhd_master_mode);
+	for (i = 0; i < dhd->wf_nports; i++) {
+		id = htod32(DHD_WF_FILTER_BASE + i);
+		bcm_mkiovar("pkt_filter_delete", (char *)&id, 4, iovbuf, sizeof(iovbuf));
+		dhd_wl_ioctl_cmd(dhdp, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
+	}
+	dhd->wf_armed = FALSE;
+}
+
+static int
+dhd_wf_pm_callback(struct notifier_block *nfb, unsigned long action, void *ignored)
+{
+	dhd_info_t *dhd = container_of(nfb, dhd_info_t, wf_pm_notifier);
+	dhd_pub_t *dhdp = &dhd->pub;
+
+	switch (action) {
+	case PM_SUSPEND_PREPARE:
+		/* only on top of the early suspend unicast filter */
+		if (dhd_wake_filter && dhd_pkt_filter_enable && dhdp->up &&
+		    dhdp->early_suspended && !dhdp->dhcp_in_progress &&
+		    dhd->iflist[0] && dhd->iflist[0]->net) {
+			DHD_OS_WAKE_LOCK(dhdp);
+			dhd_wf_arm(dhd);
+			DHD_OS_WAKE_UNLOCK(dhdp);
+		}
+		break;
+	case PM_POST_SUSPEND:
+		if (dhd->wf_armed) {
+			DHD_OS_WAKE_LOCK(dhdp);
+			dhd->wf_resume_time = jiffies;
+			dhd->wf_wake_pending = TRUE;
+			dhd_wf_disarm(dhd);
+			DHD_OS_WAKE_UNLOCK(dhdp);
+		}
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+/*
+ * Nothing tells us what woke the host, so the first frame received shortly
+ * after resume is taken for the reason.  @skb starts at the ethernet header.
+ */
+static void
+dhd_wf_count_wake(dhd_info_t *dhd, struct sk_buff *skb)
+{
+	uint8 *eth = skb->data;
+	uint8 *ip = eth + ETHER_HDR_LEN;
+	int len = skb->len - ETHER_HDR_LEN;
+	uint16 type = ntoh16_ua(eth + ETHER_TYPE_OFFSET);
+	int reason = DHD_WF_WAKE_OTHER;
+	int hlen = 0, i;
+	uint8 proto = 0, ipv6 = 0;
+	uint16 port;
+
+	dhd->wf_wake_pending = FALSE;
+	if (time_after(jiffies, dhd->wf_resume_time +
+	               msecs_to_jiffies(DHD_WF_WAKE_WINDOW_MS)))
+		return;
+
+	if (type == ETHER_TYPE_BRCM) {
+		reason = DHD_WF_WAKE_EVENT;
+	} else if (ETHER_ISMULTI(eth)) {
+		reason = DHD_WF_WAKE_BCMC;
+	} else if (type == ETHER_TYPE_ARP) {
+		reason = DHD_WF_WAKE_ARP;
+	} else if (type == ETHER_TYPE_IP && len >= IPV4_OPTIONS_OFFSET) {
+		proto = IPV4_PROT(ip);
+		hlen = IPV4_HLEN(ip);
+	} else if (type == ETHER_TYPE_IPV6 && len >= IPV6_MIN_HLEN) {
+		proto = IPV6_PROT(ip);
+		hlen = IPV6_MIN_HLEN;
+		ipv6 = 1;
+	}
+
+	if ((proto == IP_PROT_TCP || proto == IP_PROT_UDP) && len >= hlen + 4) {
+		port = ntoh16_ua(ip + hlen + 2);
+		reason = DHD_WF_WAKE_CLOSED;
+		for (i = 0; i < dhd->wf_nports; i++) {
+			if (dhd->wf_ports[i].port == port &&
+			    dhd->wf_ports[i].proto == proto &&
+			    dhd->wf_ports[i].ipv6 == ipv6) {
+				reason = proto == IP_PROT_TCP ?
+					DHD_WF_WAKE_TCP : DHD_WF_WAKE_UDP;
+				break;
+			}
+		}
+		dhd->wf_last_proto = proto;
+		dhd->wf_last_port = port;
+	}
+
+	dhd->wf_wakes[reason]++;
+}
+
+void
+dhd_os_wake_filter_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
+{
+	dhd_info_t *dhd = (dhd_info_t *)dhdp->info;
+	int i;
+
+	bcm_bprintf(strbuf, "wake filter %s suspends %u fallbacks %u ports %d:",
+	            dhd->wf_armed ? "armed" : "idle", dhd->wf_suspends,
+	            dhd->wf_fallbacks, dhd->wf_nports);
+	for (i = 0; i < dhd->wf_nports; i++)
+		bcm_bprintf(strbuf, " %s%s/%u",
+		            dhd->wf_ports[i].proto == IP_PROT_TCP ? "tcp" : "udp",
+		            dhd->wf_ports[i].ipv6 ? "6" : "",
+		            dhd->wf_ports[i].port);
+	bcm_bprintf(strbuf, "\nwakes tcp %u udp %u closed %u arp %u bcmc %u "
+	            "event %u other %u last %u/%u\n",
+	            dhd->wf_wakes[DHD_WF_WAKE_TCP], dhd->wf_wakes[DHD_WF_WAKE_UDP],
+	            dhd->wf_wakes[DHD_WF_WAKE_CLOSED], dhd->wf_wakes[DHD_WF_WAKE_ARP],
+	            dhd->wf_wakes[DHD_WF_WAKE_BCMC], dhd->wf_wakes[DHD_WF_WAKE_EVENT],
+	            dhd->wf_wakes[DHD_WF_WAKE_OTHER], dhd->wf_last_proto,
+	            dhd->wf_last_port);
+}
+#endif /* DHD_WAKE_FILTER */
+
 #if defined(CONFIG_HAS_EARLYSUSPEND)
 static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 {
@@ -1430,6 +1799,109 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 	}
 }
 
+#ifdef DHD_NAPI
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, napi);
+	struct sk_buff *skb;
+	unsigned long flags;
+	int work = 0;
+	int bucket;
+
+	while (work < budget) {
+		skb = __skb_dequeue(&dhd->rx_napi_process);
+		if (skb == NULL) {
+			/* Take over whatever the DPC queued meanwhile */
+			spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+			skb_queue_splice_tail_init(&dhd->rx_napi_queue,
+				&dhd->rx_napi_process);
+			spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+			if (skb_queue_empty(&dhd->rx_napi_process))
+				break;
+			continue;
+		}
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work) {
+		dhd->napi_polls++;
+		dhd->napi_pkts += work;
+		if (work > dhd->napi_max_batch)
+			dhd->napi_max_batch = work;
+		bucket = min(fls(work) - 1, DHD_NAPI_HIST_BUCKETS - 1);
+		dhd->napi_hist[bucket]++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* The DPC may have queued frames before napi_complete() */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	} else
+		dhd->napi_budget_hits++;
+
+	return work;
+}
+
+static void
+dhd_napi_rx(dhd_info_t *dhd, struct sk_buff_head *rxq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+	skb_queue_splice_tail_init(rxq, &dhd->rx_napi_queue);
+	spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+
+	if (in_interrupt()) {
+		napi_schedule(&dhd->napi);
+	} else {
+		/* Run the poll when bottom halves are enabled again */
+		local_bh_disable();
+		napi_schedule(&dhd->napi);
+		local_bh_enable();
+	}
+}
+
+static void
+dhd_napi_init(dhd_info_t *dhd, struct net_device *net)
+{
+	netif_napi_add(net, &dhd->napi, dhd_napi_poll, dhd_napi_weight);
+	napi_enable(&dhd->napi);
+	dhd->napi_enabled = TRUE;
+}
+
+static void
+dhd_napi_deinit(dhd_info_t *dhd)
+{
+	if (!dhd->napi_enabled)
+		return;
+
+	dhd->napi_enabled = FALSE;
+	napi_disable(&dhd->napi);
+	netif_napi_del(&dhd->napi);
+	skb_queue_purge(&dhd->rx_napi_process);
+	skb_queue_purge(&dhd->rx_napi_queue);
+}
+
+void
+dhd_os_napi_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
+{
+	dhd_info_t *dhd = (dhd_info_t *)dhdp->info;
+	int i;
+
+	bcm_bprintf(strbuf, "napi weight %u polls %u pkts %u avg %u max %u "
+	            "budget_hits %u\n", dhd_napi_weight, dhd->napi_polls, dhd->napi_pkts,
+	            dhd->napi_polls ? dhd->napi_pkts / dhd->napi_polls : 0,
+	            dhd->napi_max_batch, dhd->napi_budget_hits);
+	bcm_bprintf(strbuf, "napi batch histogram:");
+	for (i = 0; i < DHD_NAPI_HIST_BUCKETS; i++)
+		bcm_bprintf(strbuf, " %u", dhd->napi_hist[i]);
+	bcm_bprintf(strbuf, "\n");
+}
+#endif /* DHD_NAPI */
+
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 {
@@ -1442,7 +1914,11 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	dhd_if_t *ifp;
 	wl_event_msg_t event;
 	int tout = DHD_PACKET_TIMEOUT_MS;
+#ifdef DHD_NAPI
+	struct sk_buff_head rxq;
 
+	__skb_queue_head_init(&rxq);
+#endif /* DHD_NAPI */
 
 	BCM_REFERENCE(tout);
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
@@ -1529,6 +2005,11 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		skb->data = eth;
 		skb->len = len;
 
+#ifdef DHD_WAKE_FILTER
+		if (dhd->wf_wake_pending)
+			dhd_wf_count_wake(dhd, skb);
+#endif /* DHD_WAKE_FILTER */
+
 #ifdef WLMEDIA_HTSF
 		dhd_htsf_addrxts(dhdp, pktbuf);
 #endif
@@ -1565,6 +2046,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		dhdp->dstats.rx_bytes += skb->len;
 		dhdp->rx_packets++; /* Local count */
 
+#ifdef DHD_NAPI
+		if (dhd->napi_enabled) {
+			/* The whole chain (glom) goes up in one poll */
+			__skb_queue_tail(&rxq, skb);
+		} else
+#endif /* DHD_NAPI */
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1585,6 +2072,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) */
 		}
 	}
+#ifdef DHD_NAPI
+	if (!skb_queue_empty(&rxq))
+		dhd_napi_rx(dhd, &rxq);
+#endif /* DHD_NAPI */
 	DHD_OS_WAKE_LOCK_TIMEOUT_ENABLE(dhdp, tout);
 }
 
@@ -2715,6 +3206,10 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	spin_lock_init(&dhd->sdlock);
 	spin_lock_init(&dhd->txqlock);
 	spin_lock_init(&dhd->dhd_lock);
+#ifdef DHD_NAPI
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	skb_queue_head_init(&dhd->rx_napi_process);
+#endif /* DHD_NAPI */
 
 	/* Initialize Wakelock stuff */
 	spin_lock_init(&dhd->wakelock_spinlock);
@@ -2819,6 +3314,11 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	dhd_state |= DHD_ATTACH_STATE_EARLYSUSPEND_DONE;
 #endif
 
+#ifdef DHD_WAKE_FILTER
+	dhd->wf_pm_notifier.notifier_call = dhd_wf_pm_callback;
+	register_pm_notifier(&dhd->wf_pm_notifier);
+#endif /* DHD_WAKE_FILTER */
+
 #ifdef ARP_OFFLOAD_SUPPORT
 	dhd->pend_ipaddr = 0;
 	register_inetaddr_notifier(&dhd_notifier);
@@ -3154,6 +3654,20 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 	bcm_mkiovar("bus:txglomalign", (char *)&dongle_align, 4, iovbuf, sizeof(iovbuf));
 	dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
 
+#ifdef BCMSDIOH_TXGLOM
+	/* Glom tx frames into one transfer if the dongle takes them */
+	if (dhd_bus_txglom_capable(dhd)) {
+		uint32 rxglom = 1;
+
+		bcm_mkiovar("bus:rxglom", (char *)&rxglom, 4, iovbuf, sizeof(iovbuf));
+		if ((ret = dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf),
+			TRUE, 0)) < 0)
+			DHD_INFO(("%s: dongle does not take tx glom %d\n", __FUNCTION__, ret));
+		dhd_bus_txglom_enable(dhd, ret >= 0);
+		ret = 0;
+	}
+#endif /* BCMSDIOH_TXGLOM */
+
 	/* disable glom option for some chips */
 	chipID = (uint16)dhd_bus_chip_id(dhd);
 	if  ((chipID == BCM4330_CHIP_ID) || (chipID == BCM4329_CHIP_ID)) {
@@ -3565,6 +4079,10 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 		DHD_ERROR(("couldn't register the net device, err %d\n", err));
 		goto fail;
 	}
+#ifdef DHD_NAPI
+	if (ifidx == 0)
+		dhd_napi_init(dhd, net);
+#endif /* DHD_NAPI */
 	printf("Broadcom Dongle Host Driver: register interface [%s]"
 		" MAC: %.2x:%.2x:%.2x:%.2x:%.2x:%.2x\n",
 		net->name,
@@ -3648,6 +4166,11 @@ void dhd_detach(dhd_pub_t *dhdp)
 	unregister_inetaddr_notifier(&dhd_notifier);
 #endif /* ARP_OFFLOAD_SUPPORT */
 
+#ifdef DHD_WAKE_FILTER
+	if (dhd->wf_pm_notifier.notifier_call)
+		unregister_pm_notifier(&dhd->wf_pm_notifier);
+#endif /* DHD_WAKE_FILTER */
+
 #if defined(CONFIG_HAS_EARLYSUSPEND)
 	if (dhd->dhd_state & DHD_ATTACH_STATE_EARLYSUSPEND_DONE) {
 		if (dhd->early_suspend.suspend)
@@ -3691,6 +4214,9 @@ void dhd_detach(dhd_pub_t *dhdp)
 #endif
 		{
 			if (ifp->net) {
+#ifdef DHD_NAPI
+				dhd_napi_deinit(dhd);
+#endif /* DHD_NAPI */
 				unregister_netdev(ifp->net);
 				free_netdev(ifp->net);
 				ifp->net = NULL;
@@ -83,6 +83,13 @@
 
 #define DHD_TXMINMAX	1	/* Max tx frames if rx still pending */
 
+#ifdef BCMSDIOH_TXGLOM
+#define DHD_TXGLOM_DEF	10	/* Default for max tx frames in one superframe */
+#define DHD_TXGLOM_MAX	16	/* Tx superframe frames, must fit the host sg list */
+#define DHD_TXGLOM_PADLEN	(512 + DHD_SDALIGN)	/* Pad to a block multiple */
+#endif /* BCMSDIOH_TXGLOM */
+#define DHD_RXGLOM_SG	31	/* Rx subframes read straight into a chain */
+
 #define MEMBLOCK	2048		/* Block size used for downloading of dongle image */
 #define MAX_NVRAMBUF_SIZE	4096	/* max nvram buf size */
 #define MAX_DATA_BUF	(32 * 1024)	/* Must be large enough to hold biggest possible glom */
@@ -96,10 +103,23 @@
 
 /* Total length of frame header for dongle protocol */
 #define SDPCM_HDRLEN	(SDPCM_FRAMETAG_LEN + SDPCM_SWHEADER_LEN)
+
+/* Tx superframe header extension, between the frame tag and the sw header:
+ * frame length and last frame flag, then the padding that follows the frame.
+ */
+#define SDPCM_HWEXT_LEN		8
+#define SDPCM_HDRLEN_TXGLOM	(SDPCM_HDRLEN + SDPCM_HWEXT_LEN)
+#define SDPCM_HWEXT_LASTFRM	(1 << 24)
+#define SDPCM_HWEXT_PAD_SHIFT	16
+#ifdef BCMSDIOH_TXGLOM
+#define SDPCM_TXGLOM_RESERVE	SDPCM_HWEXT_LEN	/* Headroom for the extension */
+#else
+#define SDPCM_TXGLOM_RESERVE	0
+#endif
 #ifdef SDTEST
-#define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TEST_HDRLEN + DHD_SDALIGN)
+#define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TEST_HDRLEN + DHD_SDALIGN + SDPCM_TXGLOM_RESERVE)
 #else
-#define SDPCM_RESERVE	(SDPCM_HDRLEN + DHD_SDALIGN)
+#define SDPCM_RESERVE	(SDPCM_HDRLEN + DHD_SDALIGN + SDPCM_TXGLOM_RESERVE)
 #endif
 
 /* Space for header read, limit for data packets */
@@ -259,6 +279,11 @@ typedef struct dhd_bus {
 	int32		sd_mode;		/* Mode control to bus driver */
 	int32		sd_rxchain;		/* If bcmsdh api accepts PKT chains */
 	bool		use_rxchain;		/* If dhd should use PKT chains */
+	bool		txglom_enable;		/* Dongle takes tx superframes */
+#ifdef BCMSDIOH_TXGLOM
+	uint		txglomsize;		/* Max frames in a tx superframe */
+	void		*txglom_pad;		/* Tail of a tx superframe */
+#endif /* BCMSDIOH_TXGLOM */
 	bool		sleeping;		/* Is SDIO bus sleeping? */
 	uint		rxflow_mode;		/* Rx flow control mode */
 	bool		rxflow;			/* Is rx flow control on */
@@ -310,6 +335,9 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		/* Failed deglom attempts */
 	uint		rxglomframes;		/* Number of glom frames (superframes) */
 	uint		rxglompkts;		/* Number of packets from glom frames */
+	uint		rxglomcopy;		/* Glom frames too long for a chain read */
+	uint		txglomframes;		/* Number of tx superframes */
+	uint		txglompkts;		/* Number of packets in tx superframes */
 	uint		f2rxhdrs;		/* Number of header reads */
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
@@ -1334,6 +1362,198 @@ dhd_enable_oob_intr(struct dhd_bus *bus, bool enable)
 }
 #endif /* defined(OOB_INTR_ONLY) */
 
+#ifdef BCMSDIOH_TXGLOM
+/* Sends cnt packets as one superframe, in a single scatter-gather CMD53.
+ * Each frame carries the header extension telling the dongle where it
+ * ends and is padded so the next one starts aligned; with more than one
+ * frame the pad packet rounds the superframe up to a block multiple.
+ */
+/* Assumes: (a) header space already there, (b) caller holds lock */
+/* The packets are always consumed */
+static int
+dhdsdio_txglom(dhd_bus_t *bus, void **pkts, uint cnt, uint chan)
+{
+	int ret = BCME_OK;
+	osl_t *osh;
+	uint8 *frame;
+	uint16 len, pad;
+	uint16 pad1[DHD_TXGLOM_MAX], pad2[DHD_TXGLOM_MAX];
+	uint32 swheader, hwext;
+	uint totlen = 0;
+	uint retries = 0;
+	bcmsdh_info_t *sdh;
+	void *pkt, *new;
+	uint i;
+
+	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
+
+	ASSERT(cnt && (cnt <= DHD_TXGLOM_MAX));
+
+	sdh = bus->sdh;
+	osh = bus->dhd->osh;
+	bzero(pad1, sizeof(pad1));
+	bzero(pad2, sizeof(pad2));
+
+	if (bus->dhd->dongle_reset) {
+		ret = BCME_NOTREADY;
+		goto done;
+	}
+
+	/* Make room for the extension and the alignment padding */
+	for (i = 0; i < cnt; i++) {
+		pkt = pkts[i];
+		frame = (uint8*)PKTDATA(osh, pkt) - SDPCM_HWEXT_LEN;
+		pad = SDPCM_HWEXT_LEN + ((uintptr)frame % DHD_SDALIGN);
+		len = (uint16)PKTLEN(osh, pkt) + pad;
+
+		if ((PKTHEADROOM(osh, pkt) < pad) ||
+		    (PKTTAILROOM(osh, pkt) < (ROUNDUP(len, DHD_SDALIGN) - len))) {
+			DHD_INFO(("%s: insufficient room %d/%d for %d pad\n", __FUNCTION__,
+			          (int)PKTHEADROOM(osh, pkt), (int)PKTTAILROOM(osh, pkt), pad));
+			bus->dhd->tx_realloc++;
+			new = PKTGET(osh, (PKTLEN(osh, pkt) + SDPCM_HWEXT_LEN +
+			             2 * DHD_SDALIGN), TRUE);
+			if (!new) {
+				DHD_ERROR(("%s: couldn't allocate new %d-byte packet\n",
+				           __FUNCTION__, PKTLEN(osh, pkt) + SDPCM_HWEXT_LEN +
+				           2 * DHD_SDALIGN));
+				ret = BCME_NOMEM;
+				goto done;
+			}
+
+			PKTALIGN(osh, new, PKTLEN(osh, pkt) + SDPCM_HWEXT_LEN, DHD_SDALIGN);
+			bcopy(PKTDATA(osh, pkt), (uint8*)PKTDATA(osh, new) + SDPCM_HWEXT_LEN,
+			      PKTLEN(osh, pkt));
+			PKTFREE(osh, pkt, TRUE);
+			pkts[i] = pkt = new;
+			pad1[i] = SDPCM_HWEXT_LEN;
+		} else {
+			PKTPUSH(osh, pkt, pad);
+			pad1[i] = pad;
+		}
+		ASSERT(((uintptr)PKTDATA(osh, pkt) % DHD_SDALIGN) == 0);
+
+		len = (uint16)PKTLEN(osh, pkt);
+		pad2[i] = ROUNDUP(len, DHD_SDALIGN) - len;
+		PKTSETLEN(osh, pkt, len + pad2[i]);
+		totlen += len + pad2[i];
+
+		if (i)
+			PKTSETNEXT(osh, pkts[i - 1], pkt);
+	}
+
+	/* Round the superframe up to the next SDIO block */
+	pad = (cnt > 1) ? (ROUNDUP(totlen, bus->blocksize) - totlen) : 0;
+	if (pad) {
+		ASSERT(pad <= DHD_TXGLOM_PADLEN);
+		PKTSETLEN(osh, bus->txglom_pad, pad);
+		PKTSETNEXT(osh, pkts[cnt - 1], bus->txglom_pad);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		pkt = pkts[i];
+		frame = (uint8*)PKTDATA(osh, pkt);
+		len = (uint16)PKTLEN(osh, pkt) - pad2[i];
+		bzero(frame, pad1[i] + SDPCM_HDRLEN);
+
+		/* Hardware tag: 2 byte len followed by 2 byte ~len check (all LE) */
+		*(uint16*)frame = htol16(len);
+		*(((uint16*)frame) + 1) = htol16(~len);
+
+		/* Hardware extension: the length again, last frame, padding after */
+		hwext = len;
+		if (i == cnt - 1) {
+			hwext |= SDPCM_HWEXT_LASTFRM;
+			pad2[i] += pad;
+		}
+		htol32_ua_store(hwext, frame + SDPCM_FRAMETAG_LEN);
+		htol32_ua_store((uint32)pad2[i] << SDPCM_HWEXT_PAD_SHIFT,
+		                frame + SDPCM_FRAMETAG_LEN + sizeof(hwext));
+		if (i == cnt - 1)
+			pad2[i] -= pad;
+
+		/* Software tag: channel, sequence number, data offset */
+		swheader = ((chan << SDPCM_CHANNEL_SHIFT) & SDPCM_CHANNEL_MASK) |
+		        ((bus->tx_seq + i) % SDPCM_SEQUENCE_WRAP) |
+		        (((pad1[i] + SDPCM_HDRLEN) << SDPCM_DOFFSET_SHIFT) & SDPCM_DOFFSET_MASK);
+		htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN + SDPCM_HWEXT_LEN);
+		htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + SDPCM_HWEXT_LEN +
+		                sizeof(swheader));
+
+#ifdef DHD_DEBUG
+		if (PKTPRIO(pkt) < ARRAYSIZE(tx_packets)) {
+			tx_packets[PKTPRIO(pkt)]++;
+		}
+		if (DHD_HDRS_ON())
+			prhex("TxHdr", frame, MIN(len, 24));
+#endif
+	}
+
+	do {
+		ret = dhd_bcmsdh_send_buf(bus, bcmsdh_cur_sbwad(sdh), SDIO_FUNC_2, F2SYNC,
+		                          PKTDATA(osh, pkts[0]), totlen + pad, pkts[0],
+		                          NULL, NULL);
+		bus->f2txdata++;
+		ASSERT(ret != BCME_PENDING);
+
+		if (ret == BCME_NODEVICE) {
+			DHD_ERROR(("%s: Device asleep already\n", __FUNCTION__));
+		} else if (ret < 0) {
+			/* On failure, abort the command and terminate the frame */
+			DHD_INFO(("%s: sdio error %d, abort command and terminate frame.\n",
+			          __FUNCTION__, ret));
+			bus->tx_sderrs++;
+
+			bcmsdh_abort(sdh, SDIO_FUNC_2);
+			bcmsdh_cfg_write(sdh, SDIO_FUNC_1, SBSDIO_FUNC1_FRAMECTRL,
+			                 SFC_WF_TERM, NULL);
+			bus->f1regdata++;
+
+			for (i = 0; i < 3; i++) {
+				uint8 hi, lo;
+				hi = bcmsdh_cfg_read(sdh, SDIO_FUNC_1,
+				                     SBSDIO_FUNC1_WFRAMEBCHI, NULL);
+				lo = bcmsdh_cfg_read(sdh, SDIO_FUNC_1,
+				                     SBSDIO_FUNC1_WFRAMEBCLO, NULL);
+				bus->f1regdata += 2;
+				if ((hi == 0) && (lo == 0))
+					break;
+			}
+		}
+		if (ret == 0) {
+			bus->tx_seq = (bus->tx_seq + cnt) % SDPCM_SEQUENCE_WRAP;
+			if (cnt > 1) {
+				bus->txglomframes++;
+				bus->txglompkts += cnt;
+			}
+		}
+	} while ((ret < 0) && retrydata && retries++ < TXRETRIES);
+
+done:
+	for (i = 0; i < cnt; i++) {
+		pkt = pkts[i];
+
+		/* restore pkt buffer pointer before calling tx complete routine */
+		PKTSETNEXT(osh, pkt, NULL);
+		PKTSETLEN(osh, pkt, PKTLEN(osh, pkt) - pad2[i]);
+		PKTPULL(osh, pkt, SDPCM_HDRLEN + pad1[i]);
+#ifdef PROP_TXSTATUS
+		if (bus->dhd->wlfc_state) {
+			dhd_os_sdunlock(bus->dhd);
+			dhd_wlfc_txcomplete(bus->dhd, pkt, ret == 0);
+			dhd_os_sdlock(bus->dhd);
+		} else {
+#endif /* PROP_TXSTATUS */
+		dhd_txcomplete(bus->dhd, pkt, ret != 0);
+		PKTFREE(osh, pkt, TRUE);
+#ifdef PROP_TXSTATUS
+		}
+#endif
+	}
+	return ret;
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 /* Writes a HW/SW header into the packet and sends it. */
 /* Assumes: (a) header space already there, (b) caller holds lock */
 static int
@@ -1359,6 +1579,14 @@ dhdsdio_txpkt(dhd_bus_t *bus, void *pkt, uint chan, bool free_pkt)
 	sdh = bus->sdh;
 	osh = bus->dhd->osh;
 
+#ifdef BCMSDIOH_TXGLOM
+	/* Once the dongle takes superframes every frame needs the extension */
+	if (bus->txglom_enable) {
+		ASSERT(free_pkt);
+		return dhdsdio_txglom(bus, &pkt, 1, chan);
+	}
+#endif /* BCMSDIOH_TXGLOM */
+
 	if (bus->dhd->dongle_reset) {
 		ret = BCME_NOTREADY;
 		goto done;
@@ -1667,20 +1895,52 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 
 	/* Send frames until the limit or some other event */
 	for (cnt = 0; (cnt < maxframes) && DATAOK(bus); cnt++) {
-		dhd_os_sdlock_txq(bus->dhd);
-		if ((pkt = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL) {
+#ifdef BCMSDIOH_TXGLOM
+		if (bus->txglom_enable) {
+			void *pkts[DHD_TXGLOM_MAX];
+			uint i, n;
+
+			/* Glom what is queued, within the window the dongle offers */
+			n = MIN(maxframes - cnt, bus->txglomsize);
+			n = MIN(n, (uint8)(bus->tx_max - bus->tx_seq) - 1);
+
+			datalen = 0;
+			dhd_os_sdlock_txq(bus->dhd);
+			for (i = 0; i < n; i++) {
+				if ((pkts[i] = pktq_mdeq(&bus->txq, tx_prec_map,
+				                         &prec_out)) == NULL)
+					break;
+				datalen += PKTLEN(bus->dhd->osh, pkts[i]) - SDPCM_HDRLEN;
+			}
 			dhd_os_sdunlock_txq(bus->dhd);
-			break;
-		}
-		dhd_os_sdunlock_txq(bus->dhd);
-		datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
+			if (i == 0)
+				break;
+			cnt += i - 1;
 
 #ifndef SDTEST
-		ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
+			ret = dhdsdio_txglom(bus, pkts, i, SDPCM_DATA_CHANNEL);
 #else
-		ret = dhdsdio_txpkt(bus, pkt,
-		        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
+			ret = dhdsdio_txglom(bus, pkts, i,
+			        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL));
 #endif
+		} else
+#endif /* BCMSDIOH_TXGLOM */
+		{
+			dhd_os_sdlock_txq(bus->dhd);
+			if ((pkt = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL) {
+				dhd_os_sdunlock_txq(bus->dhd);
+				break;
+			}
+			dhd_os_sdunlock_txq(bus->dhd);
+			datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
+
+#ifndef SDTEST
+			ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
+#else
+			ret = dhdsdio_txpkt(bus, pkt,
+			        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
+#endif
+		}
 		if (ret)
 			bus->dhd->tx_errors++;
 		else
@@ -1716,6 +1976,7 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 	uint retries = 0;
 	bcmsdh_info_t *sdh = bus->sdh;
 	uint8 doff = 0;
+	uint8 hdrlen = bus->txglom_enable ? SDPCM_HDRLEN_TXGLOM : SDPCM_HDRLEN;
 	int ret = -1;
 	int i;
 
@@ -1725,8 +1986,8 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 		return -EIO;
 
 	/* Back the pointer to make a room for bus header */
-	frame = msg - SDPCM_HDRLEN;
-	len = (msglen += SDPCM_HDRLEN);
+	frame = msg - hdrlen;
+	len = (msglen += hdrlen);
 
 	/* Add alignment padding (optional for ctl frames) */
 	if (dhd_alignctl) {
@@ -1734,11 +1995,11 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 			frame -= doff;
 			len += doff;
 			msglen += doff;
-			bzero(frame, doff + SDPCM_HDRLEN);
+			bzero(frame, doff + hdrlen);
 		}
 		ASSERT(doff < DHD_SDALIGN);
 	}
-	doff += SDPCM_HDRLEN;
+	doff += hdrlen;
 
 	/* Round send length to next SDIO block */
 	if (bus->roundup && bus->blocksize && (len > bus->blocksize)) {
@@ -1768,11 +2029,18 @@ dhd_bus_txctl(struct dhd_bus *bus, uchar *msg, uint msglen)
 	*(uint16*)frame = htol16((uint16)msglen);
 	*(((uint16*)frame) + 1) = htol16(~msglen);
 
+	/* A superframe of its own, the roundup is its padding */
+	if (bus->txglom_enable) {
+		htol32_ua_store(msglen | SDPCM_HWEXT_LASTFRM, frame + SDPCM_FRAMETAG_LEN);
+		htol32_ua_store((uint32)(len - msglen) << SDPCM_HWEXT_PAD_SHIFT,
+		                frame + SDPCM_FRAMETAG_LEN + sizeof(uint32));
+	}
+
 	/* Software tag: channel, sequence number, data offset */
 	swheader = ((SDPCM_CONTROL_CHANNEL << SDPCM_CHANNEL_SHIFT) & SDPCM_CHANNEL_MASK)
 	        | bus->tx_seq | ((doff << SDPCM_DOFFSET_SHIFT) & SDPCM_DOFFSET_MASK);
-	htol32_ua_store(swheader, frame + SDPCM_FRAMETAG_LEN);
-	htol32_ua_store(0, frame + SDPCM_FRAMETAG_LEN + sizeof(swheader));
+	htol32_ua_store(swheader, frame + hdrlen - SDPCM_SWHEADER_LEN);
+	htol32_ua_store(0, frame + hdrlen - SDPCM_SWHEADER_LEN + sizeof(swheader));
 
 	if (!TXCTLOK(bus)) {
 		DHD_INFO(("%s: No bus credit bus->tx_max %d, bus->tx_seq %d\n",
@@ -1966,6 +2234,9 @@ enum {
 	IOV_DEVSLEEP,
 	IOV_DEVCAP,
 	IOV_VARS,
+#ifdef BCMSDIOH_TXGLOM
+	IOV_TXGLOMSIZE,
+#endif /* BCMSDIOH_TXGLOM */
 #ifdef SOFTAP
 	IOV_FWPATH
 #endif
@@ -1986,6 +2257,9 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 	{"sdiod_drive",	IOV_SDIOD_DRIVE, 0,	IOVT_UINT32,	0 },
 	{"readahead",	IOV_READAHEAD,	0,	IOVT_BOOL,	0 },
 	{"sdrxchain",	IOV_SDRXCHAIN,	0,	IOVT_BOOL,	0 },
+#ifdef BCMSDIOH_TXGLOM
+	{"txglomsize",	IOV_TXGLOMSIZE,	0,	IOVT_UINT32,	0 },
+#endif /* BCMSDIOH_TXGLOM */
 	{"alignctl",	IOV_ALIGNCTL,	0,	IOVT_BOOL,	0 },
 	{"sdalign",	IOV_SDALIGN,	0,	IOVT_BOOL,	0 },
 	{"devreset",	IOV_DEVRESET,	0,	IOVT_BOOL,	0 },
@@ -2055,8 +2329,10 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->rx_hdrfail, bus->rx_badhdr, bus->rx_badseq);
 	bcm_bprintf(strbuf, "fc_rcvd %d, fc_xoff %d, fc_xon %d\n",
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
-	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d\n",
-	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d, rxglomcopy %d\n",
+	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts, bus->rxglomcopy);
+	bcm_bprintf(strbuf, "txglom %d, txglomframes %d, txglompkts %d\n",
+	            bus->txglom_enable, bus->txglomframes, bus->txglompkts);
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -2074,6 +2350,11 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
 		bcm_bprintf(strbuf, "\n");
 
+		dhd_dump_pct(strbuf, "Tx: glom pct", (100 * bus->txglompkts),
+		             bus->dhd->tx_packets);
+		dhd_dump_pct(strbuf, ", pkts/glom", bus->txglompkts, bus->txglomframes);
+		bcm_bprintf(strbuf, "\n");
+
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
 		dhd_dump_pct(strbuf, ", pkts/f1sd", bus->dhd->tx_packets, bus->f1regdata);
 		dhd_dump_pct(strbuf, ", pkts/sd", bus->dhd->tx_packets,
@@ -2122,7 +2403,8 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rxrtx = bus->rx_toolong = bus->rxc_errors = 0;
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
-	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = bus->rxglomcopy = 0;
+	bus->txglomframes = bus->txglompkts = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -3071,6 +3353,20 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 		dhd_txminmax = (uint)int_val;
 		break;
 
+#ifdef BCMSDIOH_TXGLOM
+	case IOV_GVAL(IOV_TXGLOMSIZE):
+		int_val = (int32)bus->txglomsize;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_TXGLOMSIZE):
+		if ((int_val < 1) || (int_val > DHD_TXGLOM_MAX))
+			bcmerror = BCME_RANGE;
+		else
+			bus->txglomsize = (uint)int_val;
+		break;
+#endif /* BCMSDIOH_TXGLOM */
+
 	case IOV_GVAL(IOV_SERIALCONS):
 		int_val = dhd_serialconsole(bus, FALSE, 0, &bcmerror);
 		if (bcmerror != 0)
@@ -3583,6 +3879,9 @@ dhd_bus_stop(struct dhd_bus *bus, bool enforce_mutex)
 
 	bus->glom = bus->glomd = NULL;
 
+	/* The firmware starts over without tx superframes */
+	bus->txglom_enable = FALSE;
+
 	/* Clear rx control and wake any waiters */
 	bus->rxlen = 0;
 	dhd_os_ioctl_resp_wake(bus->dhd);
@@ -3931,6 +4230,12 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 			totlen += sublen;
 
+			/* Read longer chains than the sg list takes flat, then copy */
+			if (usechain && (num >= DHD_RXGLOM_SG)) {
+				usechain = FALSE;
+				bus->rxglomcopy++;
+			}
+
 			/* For last frame, adjust read len so total is a block multiple */
 			if (!dlen) {
 				sublen += (ROUNDUP(totlen, bus->blocksize) - totlen);
@@ -6231,6 +6536,15 @@ dhdsdio_probe_malloc(dhd_bus_t *bus, osl_t *osh, void *sdh)
 	else
 		bus->dataptr = bus->databuf;
 
+#ifdef BCMSDIOH_TXGLOM
+	/* Zeroes that end tx superframes, failing this just means no glomming */
+	if ((bus->txglom_pad = PKTGET(osh, DHD_TXGLOM_PADLEN, TRUE)) != NULL) {
+		PKTALIGN(osh, bus->txglom_pad, DHD_TXGLOM_PADLEN - DHD_SDALIGN, DHD_SDALIGN);
+		bzero(PKTDATA(osh, bus->txglom_pad), DHD_TXGLOM_PADLEN - DHD_SDALIGN);
+	}
+	bus->txglomsize = DHD_TXGLOM_DEF;
+#endif /* BCMSDIOH_TXGLOM */
+
 	return TRUE;
 
 fail:
@@ -6405,6 +6719,13 @@ dhdsdio_release_malloc(dhd_bus_t *bus, osl_t *osh)
 		bus->databuf = NULL;
 	}
 
+#ifdef BCMSDIOH_TXGLOM
+	if (bus->txglom_pad) {
+		PKTFREE(osh, bus->txglom_pad, TRUE);
+		bus->txglom_pad = NULL;
+	}
+#endif /* BCMSDIOH_TXGLOM */
+
 	if (bus->vars && bus->varsz) {
 		MFREE(osh, bus->vars, bus->varsz);
 		bus->vars = NULL;
@@ -6843,6 +7164,32 @@ dhd_bus_hdrlen(struct dhd_bus *bus)
 	return SDPCM_HDRLEN;
 }
 
+#ifdef BCMSDIOH_TXGLOM
+/* Tx superframes go out in one scatter-gather transfer, padded to a block */
+bool
+dhd_bus_txglom_capable(dhd_pub_t *dhdp)
+{
+	dhd_bus_t *bus = dhdp->bus;
+
+	return (bus->use_rxchain && bus->txglom_pad && bus->blocksize &&
+	        (bus->blocksize <= DHD_TXGLOM_PADLEN - DHD_SDALIGN));
+}
+
+/* Called once the dongle has been told to take superframes, or to stop */
+void
+dhd_bus_txglom_enable(dhd_pub_t *dhdp, bool enable)
+{
+	dhd_bus_t *bus = dhdp->bus;
+
+	dhd_os_sdlock(dhdp);
+	bus->txglom_enable = enable && dhd_bus_txglom_capable(dhdp);
+	dhd_os_sdunlock(dhdp);
+
+	DHD_INFO(("%s: tx glom %s\n", __FUNCTION__,
+	          bus->txglom_enable ? "enabled" : "disabled"));
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 int
 dhd_bus_devreset(dhd_pub_t *dhdp, uint8 flag)
 {
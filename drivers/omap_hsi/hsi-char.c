@@ -57,17 +57,44 @@ static unsigned int channels_map[HSI_MAX_CHAR_DEVS] = { 1 };
 module_param_array(channels_map, uint, &num_channels, S_IRUGO);
 MODULE_PARM_DESC(channels_map, "HSI channels to be probed");
 
+/* Most frames handed to the HSI driver at once in each direction */
+#define HSI_CHAR_MMAP_INFLIGHT	8
+#define HSI_CHAR_MMAP_MAX_SIZE	(512 * 1024)
+
 struct char_queue {
 	struct list_head list;
 	u32 *data;
 	unsigned int count;
 };
 
+/*
+ * The indexes and lengths in ctrl are shared with userspace: they are only
+ * trusted once checked, and the driver works from its own copies.
+ */
+struct hsi_char_mmap {
+	void *vaddr;
+	size_t size;
+	struct hsi_mmap_ctrl *ctrl;
+	unsigned int slot_size;
+	unsigned int tx_slots;
+	unsigned int rx_slots;
+	unsigned int rx_frame;
+	unsigned int tx_offset;
+	unsigned int rx_offset;
+	u32 tx_head;		/* last valid TX head from userspace */
+	u32 tx_submitted;
+	u32 tx_done;
+	u32 rx_tail;		/* last valid RX tail from userspace */
+	u32 rx_posted;
+	u32 rx_done;
+};
+
 struct hsi_char {
 	unsigned int opened;
 	int poll_event;
 	struct list_head rx_queue;
 	struct list_head tx_queue;
+	struct hsi_char_mmap *mmap;
 	spinlock_t lock;	/* Serialize access to driver data and API */
 	struct fasync_struct *async_queue;
 	wait_queue_head_t rx_wait;
@@ -84,6 +111,141 @@ struct hsi_char_priv {
 
 static struct hsi_char hsi_char_data[HSI_MAX_CHAR_DEVS];
 
+/*
+ * Pick up the frames and slots userspace has handed over, and pass them
+ * on to the HSI driver. Called with the hsi_char lock held.
+ */
+static void hsi_char_mmap_kick(int ch)
+{
+	struct hsi_char_mmap *m = hsi_char_data[ch].mmap;
+	struct hsi_mmap_ctrl *ctrl = m->ctrl;
+	unsigned int idx, len;
+	u32 head, tail;
+
+	head = ACCESS_ONCE(ctrl->tx.head);
+	if (head - m->tx_done <= m->tx_slots)
+		m->tx_head = head;
+	tail = ACCESS_ONCE(ctrl->rx.tail);
+	if (m->rx_done - tail <= m->rx_slots)
+		m->rx_tail = tail;
+	/* Read the frame lengths only after the indexes */
+	smp_rmb();
+
+	while ((m->tx_submitted != m->tx_head) &&
+	       (m->tx_submitted - m->tx_done < HSI_CHAR_MMAP_INFLIGHT)) {
+		idx = m->tx_submitted % m->tx_slots;
+		len = ACCESS_ONCE(ctrl->tx.len[idx]);
+		if (!len || (len > m->slot_size) || (len & 3)) {
+			pr_err("%s, ch %d: bad TX frame length %u\n",
+			       __func__, ch, len);
+			/* Stop TX until userspace sees the error */
+			hsi_char_data[ch].poll_event |= POLLERR;
+			m->tx_head = m->tx_submitted;
+			break;
+		}
+		if (if_hsi_write_queue(ch, m->vaddr + m->tx_offset +
+				       idx * m->slot_size, len) < 0)
+			break;	/* retried on the next completion */
+		m->tx_submitted++;
+	}
+
+	while ((m->rx_posted - m->rx_tail < m->rx_slots) &&
+	       (m->rx_posted - m->rx_done < HSI_CHAR_MMAP_INFLIGHT)) {
+		idx = m->rx_posted % m->rx_slots;
+		if (if_hsi_read_queue(ch, m->vaddr + m->rx_offset +
+				      idx * m->slot_size, m->rx_frame) < 0)
+			break;
+		m->rx_posted++;
+	}
+}
+
+/* A frame posted by hsi_char_mmap_kick() completed. Called with the lock */
+static void hsi_char_mmap_done(int ch, struct hsi_event *ev)
+{
+	struct hsi_char_mmap *m = hsi_char_data[ch].mmap;
+	struct hsi_mmap_ctrl *ctrl = m->ctrl;
+
+	if (HSI_EV_TYPE(ev->event) == HSI_EV_IN) {
+		ctrl->rx.len[m->rx_done % m->rx_slots] = ev->count;
+		/* Publish the length before the frame */
+		smp_wmb();
+		ctrl->rx.head = ++m->rx_done;
+	} else {
+		ctrl->tx.tail = ++m->tx_done;
+	}
+
+	hsi_char_mmap_kick(ch);
+}
+
+static int hsi_char_mmap_setup(int ch, struct hsi_mmap_config *cfg)
+{
+	struct hsi_char_mmap *m;
+	size_t size;
+	int ret = 0;
+
+	if ((cfg->slot_size < 4) || (cfg->slot_size & 3) ||
+	    !cfg->tx_slots || (cfg->tx_slots > HSI_MMAP_MAX_SLOTS) ||
+	    !cfg->rx_slots || (cfg->rx_slots > HSI_MMAP_MAX_SLOTS) ||
+	    (cfg->rx_frame < 4) || (cfg->rx_frame & 3) ||
+	    (cfg->rx_frame > cfg->slot_size))
+		return -EINVAL;
+
+	size = PAGE_SIZE + PAGE_ALIGN(cfg->slot_size *
+				      (cfg->tx_slots + cfg->rx_slots));
+	if (size > HSI_CHAR_MMAP_MAX_SIZE)
+		return -EINVAL;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	m->vaddr = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+					    get_order(size));
+	if (!m->vaddr) {
+		kfree(m);
+		return -ENOMEM;
+	}
+
+	m->size = size;
+	m->ctrl = m->vaddr;
+	m->slot_size = cfg->slot_size;
+	m->tx_slots = cfg->tx_slots;
+	m->rx_slots = cfg->rx_slots;
+	m->rx_frame = cfg->rx_frame;
+	m->tx_offset = PAGE_SIZE;
+	m->rx_offset = PAGE_SIZE + cfg->slot_size * cfg->tx_slots;
+	m->ctrl->tx.offset = m->tx_offset;
+	m->ctrl->rx.offset = m->rx_offset;
+
+	spin_lock_bh(&hsi_char_data[ch].lock);
+	if (hsi_char_data[ch].mmap) {
+		ret = -EBUSY;
+	} else {
+		hsi_char_data[ch].mmap = m;
+		hsi_char_data[ch].poll_event &= ~(POLLIN | POLLRDNORM);
+		hsi_char_mmap_kick(ch);
+	}
+	spin_unlock_bh(&hsi_char_data[ch].lock);
+
+	if (ret) {
+		free_pages((unsigned long)m->vaddr, get_order(size));
+		kfree(m);
+		return ret;
+	}
+
+	cfg->size = size;
+	return 0;
+}
+
+static void hsi_char_mmap_free(struct hsi_char_mmap *m)
+{
+	if (!m)
+		return;
+
+	free_pages((unsigned long)m->vaddr, get_order(m->size));
+	kfree(m);
+}
+
 void if_hsi_notify(int ch, struct hsi_event *ev)
 {
 	struct char_queue *entry;
@@ -99,6 +261,14 @@ void if_hsi_notify(int ch, struct hsi_event *ev)
 		return;
 	}
 
+	if (hsi_char_data[ch].mmap && ((HSI_EV_TYPE(ev->event) == HSI_EV_IN) ||
+				       (HSI_EV_TYPE(ev->event) == HSI_EV_OUT))) {
+		hsi_char_mmap_done(ch, ev);
+		spin_unlock(&hsi_char_data[ch].lock);
+		wake_up_interruptible(&hsi_char_data[ch].poll_wait);
+		return;
+	}
+
 	switch (HSI_EV_TYPE(ev->event)) {
 	case HSI_EV_IN:
 		entry = kmalloc(sizeof(*entry), GFP_ATOMIC);
@@ -159,6 +329,7 @@ static int hsi_char_fasync(int fd, struct file *file, int on)
 static unsigned int hsi_char_poll(struct file *file, poll_table *wait)
 {
 	int ch = (int)file->private_data;
+	struct hsi_char_mmap *m;
 	unsigned int ret = 0;
 
 	/*printk(KERN_DEBUG "%s\n", __func__); */
@@ -166,7 +337,18 @@ static unsigned int hsi_char_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &hsi_char_data[ch].poll_wait, wait);
 	poll_wait(file, &hsi_char_data[ch].tx_wait, wait);
 	spin_lock_bh(&hsi_char_data[ch].lock);
-	ret = hsi_char_data[ch].poll_event;
+	m = hsi_char_data[ch].mmap;
+	if (m) {
+		/* poll() is also the doorbell of the mmap ring */
+		hsi_char_mmap_kick(ch);
+		ret = hsi_char_data[ch].poll_event & (POLLPRI | POLLERR);
+		if (m->rx_done != m->rx_tail)
+			ret |= POLLIN | POLLRDNORM;
+		if (m->tx_head - m->tx_done < m->tx_slots)
+			ret |= POLLOUT | POLLWRNORM;
+	} else {
+		ret = hsi_char_data[ch].poll_event;
+	}
 	spin_unlock_bh(&hsi_char_data[ch].lock);
 
 	pr_debug("%s, ret = 0x%x\n", __func__, ret);
@@ -189,6 +371,10 @@ static ssize_t hsi_char_read(struct file *file, char __user *buf,
 	if ((count < 4) || (count & 3))
 		return -EINVAL;
 
+	/* frames go through the ring once it is set up */
+	if (hsi_char_data[ch].mmap)
+		return -EBUSY;
+
 	data = kmalloc(count, GFP_ATOMIC);
 
 	ret = if_hsi_read(ch, data, count);
@@ -278,6 +464,9 @@ static ssize_t hsi_char_write(struct file *file, const char __user *buf,
 	if ((count < 4) || (count & 3))
 		return -EINVAL;
 
+	if (hsi_char_data[ch].mmap)
+		return -EBUSY;
+
 	data = kmalloc(count, GFP_ATOMIC);
 	if (!data) {
 		WARN_ON(1);
@@ -368,6 +557,7 @@ static long  hsi_char_ioctl(struct file *file,
 	unsigned long fclock;
 	struct hsi_rx_config rx_cfg;
 	struct hsi_tx_config tx_cfg;
+	struct hsi_mmap_config mmap_cfg;
 	int ret = 0;
 
 	pr_debug("%s, ch = %d, cmd = 0x%08x\n", __func__, ch, cmd);
@@ -481,6 +671,25 @@ static long  hsi_char_ioctl(struct file *file,
 		if (copy_to_user((void __user *)arg, &fclock, sizeof(state)))
 			ret = -EFAULT;
 		break;
+	case CS_MMAP_SETUP:
+		if (copy_from_user(&mmap_cfg, (void __user *)arg,
+				   sizeof(mmap_cfg)))
+			ret = -EFAULT;
+		else
+			ret = hsi_char_mmap_setup(ch, &mmap_cfg);
+		if (!ret && copy_to_user((void __user *)arg, &mmap_cfg,
+					 sizeof(mmap_cfg)))
+			ret = -EFAULT;
+		break;
+	case CS_MMAP_KICK:
+		spin_lock_bh(&hsi_char_data[ch].lock);
+		if (hsi_char_data[ch].mmap) {
+			hsi_char_data[ch].poll_event &= ~POLLERR;
+			hsi_char_mmap_kick(ch);
+		} else
+			ret = -EINVAL;
+		spin_unlock_bh(&hsi_char_data[ch].lock);
+		break;
 	default:
 		ret = -ENOIOCTLCMD;
 		break;
@@ -489,6 +698,23 @@ static long  hsi_char_ioctl(struct file *file,
 	return ret;
 }
 
+static int hsi_char_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ch = (int)file->private_data;
+	struct hsi_char_mmap *m = hsi_char_data[ch].mmap;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!m)
+		return -EINVAL;
+
+	if (vma->vm_pgoff || (size > m->size))
+		return -EINVAL;
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       virt_to_phys(m->vaddr) >> PAGE_SHIFT, size,
+			       vma->vm_page_prot);
+}
+
 static int hsi_char_open(struct inode *inode, struct file *file)
 {
 	int ret = 0, ch = iminor(inode);
@@ -528,12 +754,15 @@ static int hsi_char_release(struct inode *inode, struct file *file)
 	int ch = (int)file->private_data;
 	struct char_queue *entry;
 	struct list_head *cursor, *next;
+	struct hsi_char_mmap *m;
 
 	pr_debug("%s, ch = %d\n", __func__, ch);
 
 	if_hsi_stop(ch);
 	spin_lock_bh(&hsi_char_data[ch].lock);
 	hsi_char_data[ch].opened--;
+	m = hsi_char_data[ch].mmap;
+	hsi_char_data[ch].mmap = NULL;
 
 	if (!list_empty(&hsi_char_data[ch].rx_queue)) {
 		list_for_each_safe(cursor, next, &hsi_char_data[ch].rx_queue) {
@@ -553,6 +782,9 @@ static int hsi_char_release(struct inode *inode, struct file *file)
 
 	spin_unlock_bh(&hsi_char_data[ch].lock);
 
+	/* The transfers were cancelled by if_hsi_stop() */
+	hsi_char_mmap_free(m);
+
 	return 0;
 }
 
@@ -562,6 +794,7 @@ static const struct file_operations hsi_char_fops = {
 	.write = hsi_char_write,
 	.poll = hsi_char_poll,
 	.unlocked_ioctl = hsi_char_ioctl,
+	.mmap = hsi_char_mmap,
 	.open = hsi_char_open,
 	.release = hsi_char_release,
 	.fasync = hsi_char_fasync,
@@ -583,6 +816,7 @@ static int hsi_char_probe(struct platform_device *pdev)
 		init_waitqueue_head(&hsi_char_data[i].poll_wait);
 		spin_lock_init(&hsi_char_data[i].lock);
 		hsi_char_data[i].opened = 0;
+		hsi_char_data[i].mmap = NULL;
 		INIT_LIST_HEAD(&hsi_char_data[i].rx_queue);
 		INIT_LIST_HEAD(&hsi_char_data[i].tx_queue);
 	}
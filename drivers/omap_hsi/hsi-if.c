@@ -70,6 +70,8 @@ struct if_hsi_channel {
 	unsigned int tx_count;	/* Number of bytes to be written */
 	u32 *rx_data;
 	unsigned int rx_count;	/* Number of bytes to be read */
+	unsigned int tx_pending;	/* Writes in flight */
+	unsigned int rx_pending;	/* Reads in flight */
 	unsigned int opened;
 	unsigned int state;
 	spinlock_t lock; /* Serializes access to channel data */
@@ -114,6 +116,7 @@ static int if_hsi_read_on(int ch, u32 *data, unsigned int count)
 	channel->state |= HSI_CHANNEL_STATE_READING;
 	channel->rx_data = data;
 	channel->rx_count = count;
+	channel->rx_pending = 1;
 	spin_unlock(&channel->lock);
 
 	ret = hsi_read(channel->dev, data, count / 4);
@@ -123,6 +126,35 @@ static int if_hsi_read_on(int ch, u32 *data, unsigned int count)
 	return ret;
 }
 
+/*
+ * Queue a read even if others are pending, the HSI driver queues it behind
+ * the DMA read in progress. Completions are notified in order.
+ */
+int if_hsi_read_queue(int ch, u32 *data, unsigned int count)
+{
+	struct if_hsi_channel *channel;
+	int ret;
+
+	channel = &hsi_iface.channels[ch];
+
+	spin_lock(&channel->lock);
+	channel->state |= HSI_CHANNEL_STATE_READING;
+	channel->rx_data = data;
+	channel->rx_count = count;
+	channel->rx_pending++;
+	spin_unlock(&channel->lock);
+
+	ret = hsi_read(channel->dev, data, count / 4);
+	if (ret < 0) {
+		spin_lock(&channel->lock);
+		if (!--channel->rx_pending)
+			channel->state &= ~HSI_CHANNEL_STATE_READING;
+		spin_unlock(&channel->lock);
+	}
+
+	return ret;
+}
+
 /* HSI char driver read done callback */
 static void if_hsi_read_done(struct hsi_device *dev, unsigned int size)
 {
@@ -132,7 +164,8 @@ static void if_hsi_read_done(struct hsi_device *dev, unsigned int size)
 	channel = &hsi_iface.channels[dev->n_ch];
 	dev_dbg(&channel->dev->device, "%s, ch = %d\n", __func__, dev->n_ch);
 	spin_lock(&channel->lock);
-	channel->state &= ~HSI_CHANNEL_STATE_READING;
+	if (!channel->rx_pending || !--channel->rx_pending)
+		channel->state &= ~HSI_CHANNEL_STATE_READING;
 	ev.event = HSI_EV_IN;
 	ev.data = channel->rx_data;
 	ev.count = 4 * size;	/* Convert size to number of u8, not u32 */
@@ -176,6 +209,7 @@ static int if_hsi_write_on(int ch, u32 *address, unsigned int count)
 
 	channel->tx_data = address;
 	channel->tx_count = count;
+	channel->tx_pending = 1;
 	channel->state |= HSI_CHANNEL_STATE_WRITING;
 	spin_unlock(&channel->lock);
 	dev_dbg(&channel->dev->device, "%s, ch = %d\n", __func__, ch);
@@ -183,6 +217,35 @@ static int if_hsi_write_on(int ch, u32 *address, unsigned int count)
 	return ret;
 }
 
+/*
+ * Queue a write even if others are pending, the HSI driver queues it behind
+ * the DMA write in progress. Completions are notified in order.
+ */
+int if_hsi_write_queue(int ch, u32 *data, unsigned int count)
+{
+	struct if_hsi_channel *channel;
+	int ret;
+
+	channel = &hsi_iface.channels[ch];
+
+	spin_lock(&channel->lock);
+	channel->tx_data = data;
+	channel->tx_count = count;
+	channel->tx_pending++;
+	channel->state |= HSI_CHANNEL_STATE_WRITING;
+	spin_unlock(&channel->lock);
+
+	ret = hsi_write(channel->dev, data, count / 4);
+	if (ret < 0) {
+		spin_lock(&channel->lock);
+		if (!--channel->tx_pending)
+			channel->state &= ~HSI_CHANNEL_STATE_WRITING;
+		spin_unlock(&channel->lock);
+	}
+
+	return ret;
+}
+
 /* HSI char driver write done callback */
 static void if_hsi_write_done(struct hsi_device *dev, unsigned int size)
 {
@@ -193,7 +256,8 @@ static void if_hsi_write_done(struct hsi_device *dev, unsigned int size)
 	dev_dbg(&channel->dev->device, "%s, ch = %d\n", __func__, dev->n_ch);
 
 	spin_lock(&channel->lock);
-	channel->state &= ~HSI_CHANNEL_STATE_WRITING;
+	if (!channel->tx_pending || !--channel->tx_pending)
+		channel->state &= ~HSI_CHANNEL_STATE_WRITING;
 	ev.event = HSI_EV_OUT;
 	ev.data = channel->tx_data;
 	ev.count = 4 * size;	/* Convert size to number of u8, not u32 */
@@ -422,6 +486,7 @@ void if_hsi_cancel_read(int ch)
 		hsi_read_cancel(channel->dev);
 	spin_lock(&channel->lock);
 	channel->state &= ~HSI_CHANNEL_STATE_READING;
+	channel->rx_pending = 0;
 	spin_unlock(&channel->lock);
 }
 
@@ -434,6 +499,7 @@ void if_hsi_cancel_write(int ch)
 		hsi_write_cancel(channel->dev);
 	spin_lock(&channel->lock);
 	channel->state &= ~HSI_CHANNEL_STATE_WRITING;
+	channel->tx_pending = 0;
 	spin_unlock(&channel->lock);
 }
 
@@ -497,6 +563,8 @@ static int if_hsi_closechannel(struct if_hsi_channel *channel)
 	}
 
 	/* Stop any pending read/write */
+	channel->rx_pending = 0;
+	channel->tx_pending = 0;
 	if (channel->state & HSI_CHANNEL_STATE_READING) {
 		channel->state &= ~HSI_CHANNEL_STATE_READING;
 		spin_unlock(&channel->lock);
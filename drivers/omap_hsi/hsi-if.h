@@ -72,6 +72,8 @@ void if_hsi_get_tx_state_port(int ch, bool *state);
 int if_hsi_read(int ch, u32 *data, unsigned int count);
 int if_hsi_poll(int ch);
 int if_hsi_write(int ch, u32 *data, unsigned int count);
+int if_hsi_read_queue(int ch, u32 *data, unsigned int count);
+int if_hsi_write_queue(int ch, u32 *data, unsigned int count);
 
 void if_hsi_cancel_read(int ch);
 void if_hsi_cancel_write(int ch);
@@ -431,6 +431,7 @@ static int __devinit hsi_port_channels_init(struct hsi_port *pport)
 		ch->read_done = NULL;
 		ch->write_done = NULL;
 		ch->port_event = NULL;
+		ch->stats.since = jiffies;
 	}
 
 	return 0;
@@ -450,6 +451,9 @@ static int hsi_port_channels_reset(struct hsi_port *pport)
 		ch->write_data.addr = NULL;
 		ch->write_data.size = 0;
 		ch->write_data.lch = -1;
+		ch->read_queue.count = 0;
+		ch->write_queue.count = 0;
+		ch->write_aggr_count = 0;
 	}
 
 	return 0;
@@ -563,12 +567,16 @@ static int __devinit hsi_request_cawake_irq(struct hsi_port *hsi_p)
 static void hsi_ports_exit(struct hsi_dev *hsi_ctrl, unsigned int max_ports)
 {
 	struct hsi_port *hsi_p;
-	unsigned int i;
+	unsigned int i, ch;
 
 	for (i = 0; i < max_ports; i++) {
 		hsi_p = &hsi_ctrl->hsi_port[i];
 		hsi_mpu_exit(hsi_p);
 		hsi_cawake_exit(hsi_p);
+		for (ch = 0; ch < hsi_p->max_ch; ch++) {
+			kfree(hsi_p->hsi_channel[ch].write_aggr);
+			hsi_p->hsi_channel[ch].write_aggr = NULL;
+		}
 	}
 }
 
@@ -56,6 +56,12 @@
 /* Number of DMA channels when nothing is defined for the device */
 #define HSI_DMA_CHANNEL_DEFAULT		8
 
+/* Transfers that can wait behind the DMA transfer in progress on a channel */
+#define HSI_DMA_QUEUE_LEN		8
+/* Queued writes up to this size are gathered into one DMA transfer */
+#define HSI_DMA_AGGR_FRAME_WORDS	32
+#define HSI_DMA_AGGR_WORDS		128
+
 /* Defines bit number for atomic operations */
 #define HSI_FLAGS_TASKLET_LOCK		0 /* prevents to disable IRQ and */
 					  /* schedule tasklet more than once */
@@ -89,10 +95,60 @@ struct hsi_data {
 	int lch;
 };
 
+/**
+ * struct hsi_queue - HSI buffers waiting for the GDD channel of a HSI channel
+ * @data: the queued buffer descriptors
+ * @head: index of the oldest queued buffer
+ * @count: number of queued buffers
+ */
+struct hsi_queue {
+	struct hsi_data data[HSI_DMA_QUEUE_LEN];
+	u8 head;
+	u8 count;
+};
+
+/**
+ * struct hsi_channel_stats - HSI channel transfer statistics
+ * @since: jiffies when the statistics were last reset
+ * @tx_frames: number of completed writes
+ * @tx_words: number of 32-bit words written
+ * @tx_dma: writes done by the GDD
+ * @tx_chained: writes started from the queue on GDD completion
+ * @tx_aggregated: writes gathered with others into a single GDD transfer
+ * @tx_queue_max: highest number of queued writes
+ * @rx_frames: number of completed reads
+ * @rx_words: number of 32-bit words read
+ * @rx_dma: reads done by the GDD
+ * @rx_chained: reads started from the queue on GDD completion
+ * @rx_queue_max: highest number of queued reads
+ * @irqs: FIFO and GDD interrupts processed for the channel
+ */
+struct hsi_channel_stats {
+	unsigned long since;
+	unsigned long tx_frames;
+	unsigned long long tx_words;
+	unsigned long tx_dma;
+	unsigned long tx_chained;
+	unsigned long tx_aggregated;
+	unsigned int tx_queue_max;
+	unsigned long rx_frames;
+	unsigned long long rx_words;
+	unsigned long rx_dma;
+	unsigned long rx_chained;
+	unsigned int rx_queue_max;
+	unsigned long irqs;
+};
+
 /**
  * struct hsi_channel - HSI channel data
  * @read_data: Incoming HSI buffer descriptor
  * @write_data: Outgoing HSI buffer descriptor
+ * @read_queue: Incoming buffers waiting for the read in progress
+ * @write_queue: Outgoing buffers waiting for the write in progress
+ * @write_aggr: Bounce buffer gathering small queued writes
+ * @write_aggr_size: Sizes of the writes gathered in @write_aggr
+ * @write_aggr_count: Number of writes gathered in @write_aggr, 0 if unused
+ * @stats: Transfer statistics
  * @hsi_port: Reference to port where the channel belongs to
  * @flags: Tracks if channel has been open
  * @channel_number: HSI channel number
@@ -105,6 +161,12 @@ struct hsi_data {
 struct hsi_channel {
 	struct hsi_data read_data;
 	struct hsi_data write_data;
+	struct hsi_queue read_queue;
+	struct hsi_queue write_queue;
+	u32 *write_aggr;
+	unsigned int write_aggr_size[HSI_DMA_QUEUE_LEN];
+	u8 write_aggr_count;
+	struct hsi_channel_stats stats;
 	struct hsi_port *hsi_port;
 	u8 flags;
 	u8 channel_number;
@@ -289,6 +351,10 @@ int hsi_driver_read_dma(struct hsi_channel *hsi_channel, u32 *data,
 			unsigned int count);
 int hsi_driver_write_dma(struct hsi_channel *hsi_channel, u32 *data,
 			 unsigned int count);
+int hsi_driver_queue_read_dma(struct hsi_channel *hsi_channel, u32 *data,
+			      unsigned int count);
+int hsi_driver_queue_write_dma(struct hsi_channel *hsi_channel, u32 *data,
+			       unsigned int count);
 
 int hsi_driver_cancel_read_interrupt(struct hsi_channel *ch);
 int hsi_driver_cancel_write_interrupt(struct hsi_channel *ch);
@@ -241,6 +241,67 @@ static int hsi_debug_gdd_show(struct seq_file *m, void *p)
 	return 0;
 }
 
+static int hsi_debug_port_stats_show(struct seq_file *m, void *p)
+{
+	struct hsi_port *hsi_port = m->private;
+	struct hsi_dev *hsi_ctrl = hsi_port->hsi_controller;
+	struct hsi_channel_stats st;
+	unsigned int ms;
+	int ch;
+
+	seq_printf(m, "%3s %9s %11s %6s %6s %6s %6s %9s %11s %6s %6s %6s %9s"
+		   " %8s %8s\n", "ch", "tx_frames", "tx_words", "dma",
+		   "chain", "aggr", "qmax", "rx_frames", "rx_words", "dma",
+		   "chain", "qmax", "irqs", "tx_KiB/s", "rx_KiB/s");
+
+	for (ch = 0; ch < hsi_port->max_ch; ch++) {
+		spin_lock_bh(&hsi_ctrl->lock);
+		st = hsi_port->hsi_channel[ch].stats;
+		spin_unlock_bh(&hsi_ctrl->lock);
+
+		if (!st.tx_frames && !st.rx_frames)
+			continue;
+
+		ms = jiffies_to_msecs(jiffies - st.since) ? : 1;
+		seq_printf(m, "%3d %9lu %11llu %6lu %6lu %6lu %6u %9lu %11llu"
+			   " %6lu %6lu %6u %9lu %8llu %8llu\n", ch,
+			   st.tx_frames, st.tx_words, st.tx_dma, st.tx_chained,
+			   st.tx_aggregated, st.tx_queue_max, st.rx_frames,
+			   st.rx_words, st.rx_dma, st.rx_chained,
+			   st.rx_queue_max, st.irqs,
+			   div_u64(st.tx_words * 4000, ms) >> 10,
+			   div_u64(st.rx_words * 4000, ms) >> 10);
+	}
+
+	return 0;
+}
+
+static int hsi_port_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hsi_debug_port_stats_show, inode->i_private);
+}
+
+/* Any write resets the statistics of all the channels of the port */
+static ssize_t hsi_port_stats_write(struct file *filep,
+				    const char __user *buff, size_t count,
+				    loff_t *offp)
+{
+	struct seq_file *m = filep->private_data;
+	struct hsi_port *hsi_port = m->private;
+	struct hsi_dev *hsi_ctrl = hsi_port->hsi_controller;
+	int ch;
+
+	spin_lock_bh(&hsi_ctrl->lock);
+	for (ch = 0; ch < hsi_port->max_ch; ch++) {
+		memset(&hsi_port->hsi_channel[ch].stats, 0,
+		       sizeof(hsi_port->hsi_channel[ch].stats));
+		hsi_port->hsi_channel[ch].stats.since = jiffies;
+	}
+	spin_unlock_bh(&hsi_ctrl->lock);
+
+	return count;
+}
+
 static int hsi_port_counters_open(struct inode *inode, struct file *file)
 {
 	file->private_data = inode->i_private;
@@ -457,6 +518,14 @@ static const struct file_operations hsi_port_counters_fops = {
 	.release = hsi_port_counters_release,
 };
 
+static const struct file_operations hsi_port_stats_fops = {
+	.open = hsi_port_stats_open,
+	.read = seq_read,
+	.write = hsi_port_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations hsi_gdd_regs_fops = {
 	.open = hsi_gdd_regs_open,
 	.read = seq_read,
@@ -496,6 +565,9 @@ int __devinit hsi_debug_add_ctrl(struct hsi_dev *hsi_ctrl)
 		debugfs_create_file("counters", S_IRUGO | S_IWUSR, dir,
 				    &hsi_ctrl->hsi_port[i],
 				    &hsi_port_counters_fops);
+		debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir,
+				    &hsi_ctrl->hsi_port[i],
+				    &hsi_port_stats_fops);
 	}
 
 	dir = debugfs_create_dir("gdd", hsi_ctrl->dir);
@@ -19,6 +19,7 @@
  */
 
 #include <linux/dma-mapping.h>
+#include <linux/slab.h>
 #include "hsi_driver.h"
 
 #define HSI_SYNC_WRITE	0
@@ -277,6 +278,191 @@ int hsi_driver_read_dma(struct hsi_channel *hsi_channel, u32 *data,
 	return 0;
 }
 
+static void hsi_queue_push(struct hsi_queue *q, u32 *data, unsigned int size)
+{
+	struct hsi_data *d = &q->data[(q->head + q->count) % HSI_DMA_QUEUE_LEN];
+
+	d->addr = data;
+	d->size = size;
+	d->lch = -1;
+	q->count++;
+}
+
+static struct hsi_data *hsi_queue_peek(struct hsi_queue *q)
+{
+	return q->count ? &q->data[q->head] : NULL;
+}
+
+static void hsi_queue_pop(struct hsi_queue *q)
+{
+	q->head = (q->head + 1) % HSI_DMA_QUEUE_LEN;
+	q->count--;
+}
+
+/**
+ * hsi_driver_queue_write_dma - Queue a write behind the GDD [DMA] write in
+ * progress on the hsi channel.
+ * @hsi_channel - pointer to the hsi_channel to write data to.
+ * @data - 32-bit word pointer to the data.
+ * @size - Number of 32bit words to be transfered.
+ *
+ * The queued write is started on the same GDD logical channel as soon as
+ * the current one completes, without waiting for the write callback.
+ *
+ * hsi_controller lock must be held before calling this function.
+ *
+ * Return 0 on success, -EBUSY if no DMA write is in progress or if the
+ * queue is full.
+ */
+int hsi_driver_queue_write_dma(struct hsi_channel *hsi_channel, u32 *data,
+			       unsigned int size)
+{
+	struct hsi_queue *q = &hsi_channel->write_queue;
+
+	if ((size < 1) || (data == NULL))
+		return -EINVAL;
+
+	if ((hsi_channel->write_data.lch < 0) || (q->count == HSI_DMA_QUEUE_LEN))
+		return -EBUSY;
+
+	/* Small writes are gathered, the bounce buffer is only needed then */
+	if ((size <= HSI_DMA_AGGR_FRAME_WORDS) && !hsi_channel->write_aggr)
+		hsi_channel->write_aggr = kmalloc(HSI_DMA_AGGR_WORDS * 4,
+						  GFP_ATOMIC);
+
+	hsi_queue_push(q, data, size);
+	if (q->count > hsi_channel->stats.tx_queue_max)
+		hsi_channel->stats.tx_queue_max = q->count;
+
+	return 0;
+}
+
+/**
+ * hsi_driver_queue_read_dma - Queue a read behind the GDD [DMA] read in
+ * progress on the hsi channel.
+ * @hsi_channel - pointer to the hsi_channel to read data from.
+ * @data - 32-bit word pointer where to store the incoming data.
+ * @count - Number of 32bit words to be transfered to the buffer.
+ *
+ * hsi_controller lock must be held before calling this function.
+ *
+ * Return 0 on success, -EBUSY if no DMA read is in progress or if the
+ * queue is full.
+ */
+int hsi_driver_queue_read_dma(struct hsi_channel *hsi_channel, u32 *data,
+			      unsigned int count)
+{
+	struct hsi_queue *q = &hsi_channel->read_queue;
+
+	if ((count < 1) || (data == NULL))
+		return -EINVAL;
+
+	if ((hsi_channel->read_data.lch < 0) || (q->count == HSI_DMA_QUEUE_LEN))
+		return -EBUSY;
+
+	hsi_queue_push(q, data, count);
+	if (q->count > hsi_channel->stats.rx_queue_max)
+		hsi_channel->stats.rx_queue_max = q->count;
+
+	return 0;
+}
+
+/* Restart a GDD logical channel that was fully programmed for a transfer */
+static void hsi_gdd_restart(struct hsi_dev *hsi_ctrl, unsigned int lch,
+			    unsigned int reg, dma_addr_t addr,
+			    unsigned int size)
+{
+	void __iomem *base = hsi_ctrl->base;
+
+	hsi_outl(addr, base, reg);
+	hsi_outw(size, base, HSI_GDD_CEN_REG(lch));
+	hsi_outl_or(HSI_GDD_LCH(lch), base, HSI_SYS_GDD_MPU_IRQ_ENABLE_REG);
+	hsi_outw_or(HSI_CCR_ENABLE, base, HSI_GDD_CCR_REG(lch));
+}
+
+/*
+ * Start the next queued write on @lch. Consecutive small writes are copied
+ * into the bounce buffer and sent as one transfer. Returns true if a write
+ * was started.
+ */
+static bool hsi_chain_write_dma(struct hsi_channel *ch, unsigned int lch)
+{
+	struct hsi_dev *hsi_ctrl = ch->hsi_port->hsi_controller;
+	struct hsi_queue *q = &ch->write_queue;
+	struct hsi_data *d = hsi_queue_peek(q);
+	unsigned int size = 0;
+	dma_addr_t src_addr;
+	u32 *data;
+
+	ch->write_aggr_count = 0;
+	if (!d)
+		return false;
+
+	if (ch->write_aggr && (d->size <= HSI_DMA_AGGR_FRAME_WORDS) &&
+	    (q->count > 1)) {
+		while (d && (d->size <= HSI_DMA_AGGR_FRAME_WORDS) &&
+		       (size + d->size <= HSI_DMA_AGGR_WORDS)) {
+			memcpy(ch->write_aggr + size, d->addr, d->size * 4);
+			ch->write_aggr_size[ch->write_aggr_count++] = d->size;
+			size += d->size;
+			hsi_queue_pop(q);
+			d = hsi_queue_peek(q);
+		}
+		data = ch->write_aggr;
+		ch->stats.tx_aggregated += ch->write_aggr_count;
+	} else {
+		data = d->addr;
+		size = d->size;
+		hsi_queue_pop(q);
+	}
+
+	src_addr = dma_map_single(hsi_ctrl->dev, data, size * 4, DMA_TO_DEVICE);
+	if (unlikely(dma_mapping_error(hsi_ctrl->dev, src_addr))) {
+		dev_err(hsi_ctrl->dev, "Failed to create DMA write mapping.\n");
+		ch->write_aggr_count = 0;
+		return false;
+	}
+
+	ch->write_data.addr = data;
+	ch->write_data.size = size;
+	ch->write_data.lch = lch;
+	ch->stats.tx_chained++;
+
+	hsi_gdd_restart(hsi_ctrl, lch, HSI_GDD_CSSA_REG(lch), src_addr, size);
+
+	return true;
+}
+
+/* Start the next queued read on @lch. Returns true if a read was started. */
+static bool hsi_chain_read_dma(struct hsi_channel *ch, unsigned int lch)
+{
+	struct hsi_dev *hsi_ctrl = ch->hsi_port->hsi_controller;
+	struct hsi_queue *q = &ch->read_queue;
+	struct hsi_data *d = hsi_queue_peek(q);
+	dma_addr_t dest_addr;
+
+	if (!d)
+		return false;
+
+	hsi_queue_pop(q);
+	dest_addr = dma_map_single(hsi_ctrl->dev, d->addr, d->size * 4,
+				   DMA_FROM_DEVICE);
+	if (unlikely(dma_mapping_error(hsi_ctrl->dev, dest_addr))) {
+		dev_err(hsi_ctrl->dev, "Failed to create DMA read mapping.\n");
+		return false;
+	}
+
+	ch->read_data.addr = d->addr;
+	ch->read_data.size = d->size;
+	ch->read_data.lch = lch;
+	ch->stats.rx_chained++;
+
+	hsi_gdd_restart(hsi_ctrl, lch, HSI_GDD_CDSA_REG(lch), dest_addr,
+			d->size);
+
+	return true;
+}
+
 /**
  * hsi_driver_cancel_write_dma - Cancel an ongoing GDD [DMA] write for the
  *				specified hsi channel.
@@ -335,6 +521,9 @@ int hsi_driver_cancel_write_dma(struct hsi_channel *hsi_ch)
 		hsi_outl_and(~HSI_BUFSTATE_CHANNEL(channel), hsi_ctrl->base,
 			     buff_offset);
 
+	/* Queued writes are dropped as well */
+	hsi_ch->write_queue.count = 0;
+	hsi_ch->write_aggr_count = 0;
 	hsi_reset_ch_write(hsi_ch);
 	return status_reg & HSI_GDD_LCH(lch) ? 0 : -ECANCELED;
 }
@@ -396,6 +585,7 @@ int hsi_driver_cancel_read_dma(struct hsi_channel *hsi_ch)
 	size = hsi_inw(hsi_ctrl->base, HSI_GDD_CEN_REG(lch)) * 4;
 	dma_unmap_single(hsi_ctrl->dev, dma_h, size, DMA_FROM_DEVICE);
 
+	hsi_ch->read_queue.count = 0;
 	hsi_reset_ch_read(hsi_ch);
 	return status_reg & HSI_GDD_LCH(lch) ? 0 : -ECANCELED;
 }
@@ -453,6 +643,9 @@ static void do_hsi_gdd_lch(struct hsi_dev *hsi_ctrl, unsigned int gdd_lch)
 	dma_addr_t dma_h;
 	size_t size;
 	int fifo, fifo_words_avail;
+	unsigned int done_size[HSI_DMA_QUEUE_LEN];
+	unsigned int done_count, i;
+	bool chained;
 
 	if (hsi_get_info_from_gdd_lch(hsi_ctrl, gdd_lch, &port_i, &channel,
 				      &is_read_path) < 0) {
@@ -471,6 +664,8 @@ static void do_hsi_gdd_lch(struct hsi_dev *hsi_ctrl, unsigned int gdd_lch)
 	gdd_csr = hsi_inw(base, HSI_GDD_CSR_REG(gdd_lch));
 
 	if (!(gdd_csr & HSI_CSR_TOUT)) {
+		ch = hsi_ctrl_get_ch(hsi_ctrl, port, channel);
+		ch->stats.irqs++;
 		if (is_read_path) {	/* Read path */
 			dma_h = hsi_inl(base, HSI_GDD_CDSA_REG(gdd_lch));
 			size = hsi_inw(base, HSI_GDD_CEN_REG(gdd_lch)) * 4;
@@ -478,8 +673,13 @@ static void do_hsi_gdd_lch(struct hsi_dev *hsi_ctrl, unsigned int gdd_lch)
 						DMA_FROM_DEVICE);
 			dma_unmap_single(hsi_ctrl->dev, dma_h, size,
 					 DMA_FROM_DEVICE);
-			ch = hsi_ctrl_get_ch(hsi_ctrl, port, channel);
 			hsi_reset_ch_read(ch);
+			ch->stats.rx_frames++;
+			ch->stats.rx_words += size / 4;
+			ch->stats.rx_dma++;
+
+			/* Keep the GDD busy while the callback runs */
+			chained = hsi_chain_read_dma(ch, gdd_lch);
 
 			dev_dbg(hsi_ctrl->dev, "Calling ch %d read callback (size %d).\n",
 				channel,  size/4);
@@ -487,6 +687,9 @@ static void do_hsi_gdd_lch(struct hsi_dev *hsi_ctrl, unsigned int gdd_lch)
 			ch->read_done(ch->dev, size / 4);
 			spin_lock(&hsi_ctrl->lock);
 
+			if (chained)
+				return;
+
 			/* Check if FIFO is correctly emptied */
 			if (hsi_driver_device_is_hsi(pdev)) {
 				fifo = hsi_fifo_get_id(hsi_ctrl, channel, port);
@@ -512,13 +715,28 @@ static void do_hsi_gdd_lch(struct hsi_dev *hsi_ctrl, unsigned int gdd_lch)
 			size = hsi_inw(base, HSI_GDD_CEN_REG(gdd_lch)) * 4;
 			dma_unmap_single(hsi_ctrl->dev, dma_h, size,
 					 DMA_TO_DEVICE);
-			ch = hsi_ctrl_get_ch(hsi_ctrl, port, channel);
 			hsi_reset_ch_write(ch);
 
-			dev_dbg(hsi_ctrl->dev, "Calling ch %d write callback (size %d).\n",
-				channel, size/4);
+			/* Gathered writes complete one by one */
+			done_count = ch->write_aggr_count;
+			if (done_count)
+				memcpy(done_size, ch->write_aggr_size,
+				       done_count * sizeof(done_size[0]));
+			else
+				done_size[done_count++] = size / 4;
+			ch->stats.tx_frames += done_count;
+			ch->stats.tx_words += size / 4;
+			ch->stats.tx_dma++;
+
+			/* Keep the GDD busy while the callbacks run */
+			hsi_chain_write_dma(ch, gdd_lch);
+
 			spin_unlock(&hsi_ctrl->lock);
-			ch->write_done(ch->dev, size / 4);
+			for (i = 0; i < done_count; i++) {
+				dev_dbg(hsi_ctrl->dev, "Calling ch %d write callback (size %d).\n",
+					channel, done_size[i]);
+				ch->write_done(ch->dev, done_size[i]);
+			}
 			spin_lock(&hsi_ctrl->lock);
 		}
 	} else {
@@ -537,7 +755,6 @@ static u32 hsi_process_dma_event(struct hsi_dev *hsi_ctrl)
 	void __iomem *base = hsi_ctrl->base;
 	unsigned int gdd_lch = 0;
 	u32 status_reg = 0;
-	u32 lch_served = 0;
 	unsigned int gdd_max_count = hsi_ctrl->gdd_chan_count;
 
 	status_reg = hsi_inl(base, HSI_SYS_GDD_MPU_IRQ_STATUS_REG);
@@ -549,15 +766,17 @@ static u32 hsi_process_dma_event(struct hsi_dev *hsi_ctrl)
 
 	for (gdd_lch = 0; gdd_lch < gdd_max_count; gdd_lch++) {
 		if (status_reg & HSI_GDD_LCH(gdd_lch)) {
+			/*
+			 * Acknowledge interrupt for DMA channel before it is
+			 * processed, as a queued transfer may be restarted on
+			 * it and complete before we are done.
+			 */
+			hsi_outl(HSI_GDD_LCH(gdd_lch), base,
+				 HSI_SYS_GDD_MPU_IRQ_STATUS_REG);
 			do_hsi_gdd_lch(hsi_ctrl, gdd_lch);
-			lch_served |= HSI_GDD_LCH(gdd_lch);
 		}
 	}
 
-	/* Acknowledge interrupt for DMA channel */
-	hsi_outl(lch_served, base, HSI_SYS_GDD_MPU_IRQ_STATUS_REG);
-
-
 	return status_reg;
 }
 
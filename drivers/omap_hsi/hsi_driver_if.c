@@ -343,6 +343,8 @@ EXPORT_SYMBOL(hsi_open);
  * A success value only indicates that the request has been accepted.
  * Transfer is only completed when the write_done callback is called.
  *
+ * While a DMA write is in progress up to HSI_DMA_QUEUE_LEN more writes are
+ * queued, and complete in order.
  */
 int hsi_write(struct hsi_device *dev, u32 *addr, unsigned int size)
 {
@@ -373,13 +375,6 @@ int hsi_write(struct hsi_device *dev, u32 *addr, unsigned int size)
 		return -EINVAL;
 	}
 
-	if (ch->write_data.addr != NULL) {
-		dev_err(hsi_ctrl->dev, "# Invalid request - Write operation pending port %d channel %d\n",
-					ch->hsi_port->port_number,
-					ch->channel_number);
-		return -EINVAL;
-	}
-
 	spin_lock_bh(&hsi_ctrl->lock);
 
 	if (hsi_ctrl->clock_change_ongoing) {
@@ -388,6 +383,19 @@ int hsi_write(struct hsi_device *dev, u32 *addr, unsigned int size)
 		return -EAGAIN;
 	}
 
+	/* A DMA write in progress takes the new one in its queue */
+	if (ch->write_data.addr != NULL) {
+		err = hsi_driver_queue_write_dma(ch, addr, size);
+		if (err < 0) {
+			dev_err(hsi_ctrl->dev, "# Invalid request - Write operation pending port %d channel %d\n",
+						ch->hsi_port->port_number,
+						ch->channel_number);
+			err = -EINVAL;
+		}
+		spin_unlock_bh(&hsi_ctrl->lock);
+		return err;
+	}
+
 	if (pm_runtime_suspended(hsi_ctrl->dev) || !hsi_ctrl->clock_enabled)
 		dev_dbg(hsi_ctrl->dev,
 			"hsi_write with HSI clocks OFF, clock_enabled = %d\n",
@@ -429,6 +437,8 @@ EXPORT_SYMBOL(hsi_write);
  * A success value only indicates that the request has been accepted.
  * Data is only available in the buffer when the read_done callback is called.
  *
+ * While a DMA read is in progress up to HSI_DMA_QUEUE_LEN more reads are
+ * queued, and complete in order.
  */
 int hsi_read(struct hsi_device *dev, u32 *addr, unsigned int size)
 {
@@ -474,11 +484,15 @@ int hsi_read(struct hsi_device *dev, u32 *addr, unsigned int size)
 	hsi_clocks_enable_channel(dev->device.parent, ch->channel_number,
 				__func__);
 
+	/* A DMA read in progress takes the new one in its queue */
 	if (ch->read_data.addr != NULL) {
-		dev_err(hsi_ctrl->dev, "# Invalid request - Read operation pending port %d channel %d\n",
-					ch->hsi_port->port_number,
-					ch->channel_number);
-		err = -EINVAL;
+		err = hsi_driver_queue_read_dma(ch, addr, size);
+		if (err < 0) {
+			dev_err(hsi_ctrl->dev, "# Invalid request - Read operation pending port %d channel %d\n",
+						ch->hsi_port->port_number,
+						ch->channel_number);
+			err = -EINVAL;
+		}
 		goto done;
 	}
 
@@ -510,10 +524,11 @@ static int __hsi_write_cancel(struct hsi_channel *ch)
 	int err = -ENODATA;
 	struct hsi_dev *hsi_ctrl = ch->hsi_port->hsi_controller;
 
-	if (ch->write_data.size == 1)
-		err = hsi_driver_cancel_write_interrupt(ch);
-	else if (ch->write_data.size > 1)
+	/* Queued single word writes go through the GDD too */
+	if ((ch->write_data.size > 1) || (ch->write_data.lch >= 0))
 		err = hsi_driver_cancel_write_dma(ch);
+	else if (ch->write_data.size == 1)
+		err = hsi_driver_cancel_write_interrupt(ch);
 	else
 		dev_dbg(hsi_ctrl->dev, "%s : Nothing to cancel %d\n", __func__,
 			ch->write_data.size);
@@ -577,10 +592,10 @@ static int __hsi_read_cancel(struct hsi_channel *ch)
 	int err = -ENODATA;
 	struct hsi_dev *hsi_ctrl = ch->hsi_port->hsi_controller;
 
-	if ((ch->read_data.size == 1) && !(ch->flags & HSI_CH_RX_POLL))
-		err = hsi_driver_cancel_read_interrupt(ch);
-	else if (ch->read_data.size > 1)
+	if ((ch->read_data.size > 1) || (ch->read_data.lch >= 0))
 		err = hsi_driver_cancel_read_dma(ch);
+	else if ((ch->read_data.size == 1) && !(ch->flags & HSI_CH_RX_POLL))
+		err = hsi_driver_cancel_read_interrupt(ch);
 	else
 		dev_dbg(hsi_ctrl->dev, "%s : Nothing to cancel %d\n", __func__,
 			ch->read_data.size);
@@ -442,6 +442,9 @@ static void hsi_do_channel_tx(struct hsi_channel *ch)
 			ch->write_data.addr = NULL;
 		}
 	}
+	ch->stats.tx_frames++;
+	ch->stats.tx_words++;
+	ch->stats.irqs++;
 
 	spin_unlock(&hsi_ctrl->lock);
 	dev_dbg(hsi_ctrl->dev, "Calling ch %d write callback.\n", n_ch);
@@ -509,8 +512,11 @@ static void hsi_do_channel_rx(struct hsi_channel *ch)
 		if (buff_offset >= 0) {
 			data_read = 1;
 			*(ch->read_data.addr) = hsi_inl(base, buff_offset);
+			ch->stats.rx_frames++;
+			ch->stats.rx_words++;
 		}
 	}
+	ch->stats.irqs++;
 
 	hsi_reset_ch_read(ch);
 
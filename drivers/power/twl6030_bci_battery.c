@@ -3404,7 +3404,8 @@ static int __init twl6030_battery_init(void)
 {
 	return platform_driver_register(&twl6030_bci_battery_driver);
 }
-module_init(twl6030_battery_init);
+/* probe waits on GPADC conversions; nothing else at this level needs it */
+device_initcall_async(twl6030_battery_init);
 
 static void __exit twl6030_battery_exit(void)
 {
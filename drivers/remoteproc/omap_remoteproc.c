@@ -32,6 +32,7 @@
 #include <linux/kthread.h>
 #include <linux/slab.h>
 #include <linux/pm_qos.h>
+#include <linux/workqueue.h>
 
 #include <plat/mailbox.h>
 #include <plat/remoteproc.h>
@@ -66,10 +67,33 @@ struct hwspinlock_info {
 	unsigned long *state_va;
 };
 
+/*
+ * Virtqueue notifications for the first OMAP_RPROC_MAX_VQS vrings are
+ * processed by one work item per vring, so a burst of mailbox messages
+ * for the same vring is handled in a single pass. Higher vring indices
+ * fall back to a thread per message.
+ */
+#define OMAP_RPROC_MAX_VQS	8
+
+struct omap_rproc;
+
+/**
+ * struct omap_rproc_vq - deferred processing of a signalled virtqueue
+ * @work: runs rproc_vq_interrupt() for @vqid
+ * @oproc: the remote processor the vring belongs to
+ * @vqid: index of the vring
+ */
+struct omap_rproc_vq {
+	struct work_struct work;
+	struct omap_rproc *oproc;
+	int vqid;
+};
+
 /**
  * struct omap_rproc - omap remote processor state
  * @mbox: omap mailbox handle
  * @nb: notifier block that will be invoked on inbound mailbox messages
+ * @atomic_nb: notifier block handling the frequent messages from the irq
  * @rproc: rproc handle
  * @boot_reg: virtual address of the register where the bootaddr is stored
  * @lat_req: for requesting latency constraints for rproc
@@ -82,11 +106,13 @@ struct hwspinlock_info {
  * @suspended: flag that says if rproc suspended
  * @need_kick: flag that says if vrings need to be kicked on resume
  * @hwlock_info: virtual addresses of hwspinlock states shared by rproc
+ * @vqs: per-vring work items for inbound virtqueue notifications
  *
  */
 struct omap_rproc {
 	struct omap_mbox *mbox;
 	struct notifier_block nb;
+	struct notifier_block atomic_nb;
 	struct rproc *rproc;
 	void __iomem *boot_reg;
 	union oproc_pm_qos lat_req;
@@ -100,6 +126,7 @@ struct omap_rproc {
 	bool suspended;
 	bool need_kick;
 	struct hwspinlock_info hwlock_info;
+	struct omap_rproc_vq vqs[OMAP_RPROC_MAX_VQS];
 };
 
 struct _thread_data {
@@ -120,6 +147,19 @@ static int _vq_interrupt_thread(struct _thread_data *d)
 	return 0;
 }
 
+static void omap_rproc_vq_work(struct work_struct *work)
+{
+	struct omap_rproc_vq *vq = container_of(work, struct omap_rproc_vq,
+						work);
+	struct omap_rproc *oproc = vq->oproc;
+	struct device *dev = oproc->rproc->dev.parent;
+
+	/* messages arriving from now on will queue the work again */
+	if (rproc_vq_interrupt(oproc->rproc, vq->vqid) == IRQ_NONE)
+		dev_dbg(dev, "no message was found in vqid %d\n", vq->vqid);
+	atomic_dec(&oproc->thrd_cnt);
+}
+
 /**
  * omap_rproc_mbox_callback() - inbound mailbox message handler
  * @this: notifier block
@@ -156,11 +196,6 @@ static int omap_rproc_mbox_callback(struct notifier_block *this,
 	case RP_MBOX_ECHO_REPLY:
 		dev_info(dev, "received echo reply from %s\n", name);
 		break;
-	case RP_MBOX_SUSPEND_ACK:
-	case RP_MBOX_SUSPEND_CANCEL:
-		oproc->suspend_acked = msg == RP_MBOX_SUSPEND_ACK;
-		complete(&oproc->pm_comp);
-		break;
 	default:
 		if (msg >= RP_MBOX_END_MSG) {
 			dev_info(dev, "Dropping unknown message %x", msg);
@@ -179,6 +214,42 @@ static int omap_rproc_mbox_callback(struct notifier_block *this,
 	return NOTIFY_DONE;
 }
 
+/**
+ * omap_rproc_mbox_atomic() - inbound mailbox message handler, irq context
+ * @this: notifier block
+ * @index: unused
+ * @data: mailbox payload
+ *
+ * Handles the virtqueue kicks of the vrings that have a work item, and the
+ * suspend handshake, straight from the mailbox interrupt. Everything else
+ * is left to omap_rproc_mbox_callback().
+ */
+static int omap_rproc_mbox_atomic(struct notifier_block *this,
+					unsigned long index, void *data)
+{
+	mbox_msg_t msg = (mbox_msg_t) data;
+	struct omap_rproc *oproc = container_of(this, struct omap_rproc,
+						atomic_nb);
+
+	switch (msg) {
+	case RP_MBOX_SUSPEND_ACK:
+	case RP_MBOX_SUSPEND_CANCEL:
+		oproc->suspend_acked = msg == RP_MBOX_SUSPEND_ACK;
+		complete(&oproc->pm_comp);
+		return NOTIFY_STOP;
+	}
+
+	if (msg >= OMAP_RPROC_MAX_VQS)
+		return NOTIFY_DONE;
+
+	/* already pending work will see this message too */
+	atomic_inc(&oproc->thrd_cnt);
+	if (!schedule_work(&oproc->vqs[msg].work))
+		atomic_dec(&oproc->thrd_cnt);
+
+	return NOTIFY_STOP;
+}
+
 /* kick a virtqueue */
 static void omap_rproc_kick(struct rproc *rproc, int vqid)
 {
@@ -301,6 +372,7 @@ static int omap_rproc_start(struct rproc *rproc)
 		writel(rproc->bootaddr, oproc->boot_reg);
 
 	oproc->nb.notifier_call = omap_rproc_mbox_callback;
+	oproc->atomic_nb.notifier_call = omap_rproc_mbox_atomic;
 
 	/* every omap rproc is assigned a mailbox instance for messaging */
 	oproc->mbox = omap_mbox_get(pdata->mbox_name, &oproc->nb);
@@ -309,6 +381,7 @@ static int omap_rproc_start(struct rproc *rproc)
 		dev_err(dev, "omap_mbox_get failed: %d\n", ret);
 		return ret;
 	}
+	omap_mbox_register_atomic(oproc->mbox, &oproc->atomic_nb);
 
 	/*
 	 * ping the remote processor. this is only for sanity-sake;
@@ -370,6 +443,7 @@ err_timers:
 	}
 
 put_mbox:
+	omap_mbox_unregister_atomic(oproc->mbox, &oproc->atomic_nb);
 	omap_mbox_put(oproc->mbox, &oproc->nb);
 	return ret;
 }
@@ -424,6 +498,7 @@ static int omap_rproc_stop(struct rproc *rproc)
 		timers[i].odt = NULL;
 	}
 
+	omap_mbox_unregister_atomic(oproc->mbox, &oproc->atomic_nb);
 	omap_mbox_put(oproc->mbox, &oproc->nb);
 
 	/* wait untill all threads have finished */
@@ -622,7 +697,7 @@ static int __devinit omap_rproc_probe(struct platform_device *pdev)
 	struct omap_rproc_pdata *pdata = pdev->dev.platform_data;
 	struct omap_rproc *oproc;
 	struct rproc *rproc;
-	int ret;
+	int ret, i;
 
 	ret = dma_set_coherent_mask(&pdev->dev, DMA_BIT_MASK(32));
 	if (ret) {
@@ -641,6 +716,12 @@ static int __devinit omap_rproc_probe(struct platform_device *pdev)
 	oproc->suspend_timeout = pdata->suspend_timeout ? : DEF_SUSPEND_TIMEOUT;
 	init_completion(&oproc->pm_comp);
 
+	for (i = 0; i < OMAP_RPROC_MAX_VQS; i++) {
+		INIT_WORK(&oproc->vqs[i].work, omap_rproc_vq_work);
+		oproc->vqs[i].oproc = oproc;
+		oproc->vqs[i].vqid = i;
+	}
+
 	if (pdata->idle_addr) {
 		oproc->idle = ioremap(pdata->idle_addr, sizeof(u32));
 		if (!oproc->idle)
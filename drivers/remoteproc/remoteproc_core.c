@@ -44,6 +44,9 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/cpu.h>
+#include <linux/ktime.h>
 #include <linux/rproc_drm.h>
 
 #include "remoteproc_internal.h"
@@ -192,6 +195,7 @@ out:
 static int rproc_runtime_resume(struct device *dev)
 {
 	struct rproc *rproc = dev_to_rproc(dev);
+	ktime_t start;
 	int ret = 0;
 
 	dev_dbg(dev, "Enter %s\n", __func__);
@@ -209,6 +213,7 @@ static int rproc_runtime_resume(struct device *dev)
 		return -EAGAIN;
 	}
 
+	start = ktime_get();
 	rproc_activate_iommu(rproc);
 	if (rproc->ops->resume) {
 		ret = rproc->ops->resume(rproc);
@@ -220,6 +225,7 @@ static int rproc_runtime_resume(struct device *dev)
 	}
 
 	rproc->state = RPROC_RUNNING;
+	rproc_pm_resumed(rproc, ktime_us_delta(ktime_get(), start));
 out:
 	return ret;
 }
@@ -242,6 +248,7 @@ static int rproc_runtime_suspend(struct device *dev)
 	rproc_idle_iommu(rproc);
 
 	rproc->state = RPROC_SUSPENDED;
+	rproc_pm_suspended(rproc);
 out:
 	return 0;
 abort:
@@ -524,6 +531,76 @@ exit:
 EXPORT_SYMBOL(rproc_pa_to_da);
 
 
+/*
+ * Segments at least this big are copied by all the online cpus at once;
+ * firmware images are several MB, and a single cpu can't saturate the
+ * memory bandwidth when writing to non-cacheable carveouts.
+ */
+#define RPROC_PARALLEL_COPY_MIN	(512 * 1024)
+
+struct rproc_copy_chunk {
+	struct work_struct work;
+	struct completion done;
+	void *dst;
+	const void *src;
+	size_t len;
+};
+
+static void rproc_copy_work(struct work_struct *work)
+{
+	struct rproc_copy_chunk *chunk = container_of(work,
+					struct rproc_copy_chunk, work);
+
+	memcpy(chunk->dst, chunk->src, chunk->len);
+	complete(&chunk->done);
+}
+
+/* memcpy() that splits big copies among the online cpus */
+static void rproc_memcpy(void *dst, const void *src, size_t len)
+{
+	struct rproc_copy_chunk *chunks;
+	size_t size, offset = 0;
+	int cpu, n = 0, i;
+
+	get_online_cpus();
+
+	if (len < RPROC_PARALLEL_COPY_MIN || num_online_cpus() == 1)
+		goto single;
+
+	chunks = kcalloc(num_online_cpus(), sizeof(*chunks), GFP_KERNEL);
+	if (!chunks)
+		goto single;
+
+	size = ALIGN(DIV_ROUND_UP(len, num_online_cpus()), L1_CACHE_BYTES);
+
+	for_each_online_cpu(cpu) {
+		struct rproc_copy_chunk *chunk = &chunks[n++];
+
+		chunk->dst = dst + offset;
+		chunk->src = src + offset;
+		chunk->len = min(size, len - offset);
+		offset += chunk->len;
+
+		init_completion(&chunk->done);
+		INIT_WORK(&chunk->work, rproc_copy_work);
+		schedule_work_on(cpu, &chunk->work);
+
+		if (offset == len)
+			break;
+	}
+
+	for (i = 0; i < n; i++)
+		wait_for_completion(&chunks[i].done);
+
+	put_online_cpus();
+	kfree(chunks);
+	return;
+
+single:
+	put_online_cpus();
+	memcpy(dst, src, len);
+}
+
 /**
  * rproc_load_segments() - load firmware segments to memory
  * @rproc: remote processor which will be booted using these fw segments
@@ -598,7 +675,7 @@ rproc_load_segments(struct rproc *rproc, const u8 *elf_data, size_t len)
 
 		/* put the segment where the remote processor expects it */
 		if (phdr->p_filesz)
-			memcpy(ptr, elf_data + phdr->p_offset, filesz);
+			rproc_memcpy(ptr, elf_data + phdr->p_offset, filesz);
 
 		/*
 		 * Zero out remaining memory for this segment.
@@ -1737,6 +1814,41 @@ static int rproc_fw_sanity_check(struct rproc *rproc, const struct firmware *fw)
 	return 0;
 }
 
+/* microseconds since *@start, which is moved to now */
+static u32 rproc_elapsed_us(ktime_t *start)
+{
+	ktime_t now = ktime_get();
+	u32 us = ktime_to_us(ktime_sub(now, *start));
+
+	*start = now;
+	return us;
+}
+
+/*
+ * Keep @fw as the cached image of @rproc, so later boots and recoveries
+ * don't need to fetch and copy it again from the filesystem.
+ *
+ * Returns true if @fw is (now) the cached image, in which case the caller
+ * must not release it. rproc->lock must be held.
+ */
+static bool rproc_cache_firmware(struct rproc *rproc, const struct firmware *fw)
+{
+	if (!rproc->cached_fw)
+		rproc->cached_fw = fw;
+
+	return rproc->cached_fw == fw;
+}
+
+/* drop the cached image, e.g. because a new one was installed */
+static void rproc_drop_firmware(struct rproc *rproc)
+{
+	mutex_lock(&rproc->lock);
+	if (rproc->cached_fw)
+		release_firmware(rproc->cached_fw);
+	rproc->cached_fw = NULL;
+	mutex_unlock(&rproc->lock);
+}
+
 /*
  * take a firmware and boot a remote processor with it.
  */
@@ -1744,11 +1856,13 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 {
 	struct device *dev = &rproc->dev;
 	const char *name = rproc->firmware;
+	struct rproc_boot_stats *stats = &rproc->boot_stats;
 	struct elf32_hdr *ehdr;
 	struct resource_table *table;
 	int ret, tablesz, versz;
 	const u8 *version;
 	int smode = rproc_secure_get_mode(rproc);
+	ktime_t start = ktime_get();
 
 	ret = rproc_fw_sanity_check(rproc, fw);
 	if (ret)
@@ -1791,6 +1905,8 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 		}
 	}
 
+	stats->rsc_us = rproc_elapsed_us(&start);
+
 	/* load the ELF segments to memory */
 	ret = rproc_load_segments(rproc, fw->data, fw->size);
 	if (ret) {
@@ -1798,6 +1914,8 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 		goto free_version;
 	}
 
+	stats->load_us = rproc_elapsed_us(&start);
+
 	/* parse the secure sections */
 	ret = rproc_secure_parse_fw(rproc, fw->data);
 	if (ret) {
@@ -1824,6 +1942,8 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 		goto free_version;
 	}
 
+	stats->iommu_us = rproc_elapsed_us(&start);
+
 	/* check and validate secure certificate */
 	rproc_secure_boot(rproc);
 
@@ -1834,6 +1954,8 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 		goto free_version;
 	}
 
+	stats->start_us = rproc_elapsed_us(&start);
+
 	rproc->state = RPROC_RUNNING;
 	pm_runtime_set_active(dev);
 	if (!smode)
@@ -1848,6 +1970,7 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 		pm_runtime_mark_last_busy(dev);
 		pm_runtime_put_autosuspend(dev);
 	}
+	rproc_pm_boot(rproc);
 
 	dev_info(dev, "remote processor %s is now up\n", rproc->name);
 
@@ -1874,10 +1997,16 @@ static void rproc_fw_config_virtio(const struct firmware *fw, void *context)
 	struct rproc *rproc = context;
 	struct resource_table *table;
 	int ret, tablesz;
+	bool cached = false;
 
 	if (rproc_fw_sanity_check(rproc, fw) < 0)
 		goto out;
 
+	/* keep the image for the boot that will follow */
+	mutex_lock(&rproc->lock);
+	cached = rproc_cache_firmware(rproc, fw);
+	mutex_unlock(&rproc->lock);
+
 	/* look for the resource table */
 	table = rproc_find_rsc_table(rproc, fw->data, fw->size, &tablesz);
 	if (!table)
@@ -1889,7 +2018,7 @@ static void rproc_fw_config_virtio(const struct firmware *fw, void *context)
 		goto out;
 
 out:
-	if (fw)
+	if (fw && !cached)
 		release_firmware(fw);
 	/* allow rproc_unregister() contexts, if any, to proceed */
 	complete_all(&rproc->firmware_loading_complete);
@@ -1910,6 +2039,7 @@ int rproc_boot(struct rproc *rproc)
 {
 	const struct firmware *firmware_p;
 	struct device *dev;
+	ktime_t start, phase;
 	int ret;
 
 	if (!rproc) {
@@ -1955,16 +2085,31 @@ int rproc_boot(struct rproc *rproc)
 
 	dev_info(dev, "powering up %s\n", rproc->name);
 
-	/* load firmware */
-	ret = request_firmware(&firmware_p, rproc->firmware, dev);
-	if (ret < 0) {
-		dev_err(dev, "request_firmware failed: %d\n", ret);
-		goto downref_rproc;
+	start = phase = ktime_get();
+	rproc->boot_stats.fw_cached = rproc->cached_fw != NULL;
+
+	/* load firmware, unless it's still around from a previous boot */
+	if (rproc->cached_fw) {
+		firmware_p = rproc->cached_fw;
+	} else {
+		ret = request_firmware(&firmware_p, rproc->firmware, dev);
+		if (ret < 0) {
+			dev_err(dev, "request_firmware failed: %d\n", ret);
+			goto downref_rproc;
+		}
 	}
 
+	rproc->boot_stats.request_us = rproc_elapsed_us(&phase);
+
 	ret = rproc_fw_boot(rproc, firmware_p);
 
-	release_firmware(firmware_p);
+	if (!rproc_cache_firmware(rproc, firmware_p))
+		release_firmware(firmware_p);
+
+	if (!ret) {
+		rproc->boot_stats.total_us = rproc_elapsed_us(&start);
+		rproc->boot_stats.count++;
+	}
 
 downref_rproc:
 	if (ret) {
@@ -2029,6 +2174,7 @@ void rproc_shutdown(struct rproc *rproc)
 	if (rproc->auto_suspend_timeout >= 0)
 		pm_runtime_get_sync(dev);
 
+	rproc_pm_shutdown(rproc);
 	pm_runtime_put_noidle(&rproc->dev);
 	if (smode || !rproc_is_secure(rproc))
 		pm_runtime_disable(&rproc->dev);
@@ -2089,6 +2235,9 @@ void rproc_release(struct kref *kref)
 
 	dev_info(&rproc->dev, "removing %s\n", rproc->name);
 
+	if (rproc->cached_fw)
+		release_firmware(rproc->cached_fw);
+
 	rproc_delete_debug_dir(rproc);
 
 	/*
@@ -2147,6 +2296,12 @@ static int _reset_all_vdev(struct rproc *rproc)
 	list_for_each_entry_safe(rvdev, rvtmp, &rproc->rvdevs, node)
 		rproc_remove_virtio_dev(rvdev);
 
+	/* the cached image, if any, spares us fetching it again */
+	if (rproc->cached_fw) {
+		rproc_fw_config_virtio(rproc->cached_fw, rproc);
+		return 0;
+	}
+
 	/* run rproc_fw_config_virtio to create vdevs again */
 	return request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
 			rproc->firmware, &rproc->dev, GFP_KERNEL,
@@ -2228,6 +2383,9 @@ int rproc_reload(const char *name)
 	}
 
 	dev_info(&rproc->dev, "rproc reloading....\n");
+
+	/* a new image is expected, so don't reuse the cached one */
+	rproc_drop_firmware(rproc);
 	_reset_all_vdev(rproc);
 	return ret;
 }
@@ -2466,6 +2624,7 @@ static struct class rproc_class = {
 	.owner		= THIS_MODULE,
 	.dev_release	= rproc_class_release,
 	.pm		= &rproc_pm_ops,
+	.dev_attrs	= rproc_pm_attrs,
 };
 
 /**
@@ -2568,6 +2727,7 @@ struct rproc *rproc_alloc(struct device *dev, const char *name,
 	INIT_WORK(&rproc->error_handler, rproc_error_handler_work);
 
 	rproc_secure_init(rproc);
+	rproc_pm_init(rproc);
 
 	rproc->state = RPROC_OFFLINE;
 
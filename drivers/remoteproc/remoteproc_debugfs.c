@@ -131,6 +131,73 @@ static const struct file_operations rproc_version_ops = {
 	.llseek = generic_file_llseek,
 };
 
+/* expose the duration of the boot phases via debugfs */
+static ssize_t rproc_boot_stats_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_boot_stats *stats = &rproc->boot_stats;
+	char buf[256];
+	int i;
+
+	i = scnprintf(buf, sizeof(buf),
+		"boots: %u\n"
+		"firmware: %s\n"
+		"request: %u us\n"
+		"resources: %u us\n"
+		"load: %u us\n"
+		"iommu: %u us\n"
+		"start: %u us\n"
+		"total: %u us\n",
+		stats->count, stats->fw_cached ? "cached" : "requested",
+		stats->request_us, stats->rsc_us, stats->load_us,
+		stats->iommu_us, stats->start_us, stats->total_us);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, i);
+}
+
+static const struct file_operations rproc_boot_stats_ops = {
+	.read = rproc_boot_stats_read,
+	.open = simple_open,
+	.llseek = generic_file_llseek,
+};
+
+static ssize_t rproc_pm_stats_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_pm *pm = &rproc->pm;
+	unsigned long flags;
+	char buf[320];
+	int i;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	i = scnprintf(buf, sizeof(buf),
+		"autosuspend delay: %d ms\n"
+		"base delay: %d ms\n"
+		"average idle gap: %u ms\n"
+		"holds: %u%s\n"
+		"suspends: %u\n"
+		"resumes: %u\n"
+		"bounces: %u\n"
+		"resume: %u us\n"
+		"resume average: %u us\n"
+		"resume max: %u us\n",
+		pm->delay, rproc->auto_suspend_timeout, pm->avg_gap,
+		pm->holds, pm->user_hold ? " (user)" : "",
+		pm->suspends, pm->resumes, pm->bounces,
+		pm->resume_us, pm->resume_avg_us, pm->resume_max_us);
+	spin_unlock_irqrestore(&pm->lock, flags);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, i);
+}
+
+static const struct file_operations rproc_pm_stats_ops = {
+	.read = rproc_pm_stats_read,
+	.open = simple_open,
+	.llseek = generic_file_llseek,
+};
+
 /* expose recovery flag via debugfs */
 static ssize_t rproc_recovery_read(struct file *filp, char __user *userbuf,
 						size_t count, loff_t *ppos)
@@ -222,6 +289,10 @@ void rproc_create_debug_dir(struct rproc *rproc)
 					rproc, &rproc_recovery_ops);
 	debugfs_create_file("version", 0400, rproc->dbg_dir,
 					rproc, &rproc_version_ops);
+	debugfs_create_file("boot_stats", 0400, rproc->dbg_dir,
+					rproc, &rproc_boot_stats_ops);
+	debugfs_create_file("pm_stats", 0400, rproc->dbg_dir,
+					rproc, &rproc_pm_stats_ops);
 }
 
 void __init rproc_init_debugfs(void)
@@ -52,6 +52,15 @@ int rproc_secure_get_mode(struct rproc *rproc);
 int rproc_secure_get_ttb(struct rproc *rproc);
 bool rproc_is_secure(struct rproc *rproc);
 
+/* from remoteproc_pm.c */
+extern struct device_attribute rproc_pm_attrs[];
+void rproc_pm_init(struct rproc *rproc);
+void rproc_pm_boot(struct rproc *rproc);
+void rproc_pm_shutdown(struct rproc *rproc);
+void rproc_pm_activity(struct rproc *rproc);
+void rproc_pm_suspended(struct rproc *rproc);
+void rproc_pm_resumed(struct rproc *rproc, u32 us);
+
 /* from remoteproc_debugfs.c */
 void rproc_remove_trace_file(struct dentry *tfile);
 struct dentry *rproc_create_trace_file(const char *name, struct rproc *rproc,
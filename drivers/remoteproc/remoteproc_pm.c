@@ -0,0 +1,297 @@
+/*
+ * Remote Processor Framework - adaptive runtime pm
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt)    "%s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/device.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/pm_runtime.h>
+#include <linux/remoteproc.h>
+
+#include "remoteproc_internal.h"
+
+/*
+ * The autosuspend delay given by the firmware (or the default one) is only
+ * a floor. Messages closer than RPROC_PM_BURST_MS belong to the same burst;
+ * longer gaps between bursts are averaged and the delay is stretched to
+ * twice that average, so that a remote processor serving periodic bursts
+ * (a video clip, a camera preview) stays up between them instead of paying
+ * a suspend and resume every time. Gaps above RPROC_PM_MAX_DELAY_MS are not
+ * worth staying up for, and the floor is used again.
+ */
+#define RPROC_PM_BURST_MS	20
+#define RPROC_PM_MAX_DELAY_MS	10000
+
+#define dev_to_rproc(dev) container_of(dev, struct rproc, dev)
+
+static void rproc_pm_delay_work(struct work_struct *work)
+{
+	struct rproc_pm *pm = container_of(work, struct rproc_pm, work);
+	struct rproc *rproc = container_of(pm, struct rproc, pm);
+	unsigned long flags;
+	int delay;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	delay = pm->delay;
+	spin_unlock_irqrestore(&pm->lock, flags);
+
+	dev_dbg(&rproc->dev, "autosuspend delay %d ms\n", delay);
+	pm_runtime_set_autosuspend_delay(&rproc->dev, delay);
+}
+
+/* pick the autosuspend delay for the current traffic history */
+static int rproc_pm_predict(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+	int base = rproc->auto_suspend_timeout;
+
+	if (!pm->avg_gap || pm->avg_gap * 2 > RPROC_PM_MAX_DELAY_MS)
+		return base;
+
+	return max_t(int, base, pm->avg_gap * 2);
+}
+
+/**
+ * rproc_pm_activity() - account a message exchanged with a remote processor
+ * @rproc: the remote processor
+ *
+ * Feeds the traffic history the autosuspend delay is predicted from, and
+ * marks @rproc as busy. Can be called from any context.
+ */
+void rproc_pm_activity(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	bool update = false;
+	s64 gap;
+	int delay;
+
+	pm_runtime_mark_last_busy(&rproc->dev);
+
+	spin_lock_irqsave(&pm->lock, flags);
+	if (pm->delay < 0)
+		goto unlock;
+
+	gap = ktime_to_ms(ktime_sub(now, pm->last_activity));
+	pm->last_activity = now;
+	if (gap < RPROC_PM_BURST_MS)
+		goto unlock;
+
+	gap = min_t(s64, gap, RPROC_PM_MAX_DELAY_MS * 2);
+	/* moving average with a 1/4 weight for the newest gap */
+	pm->avg_gap = pm->avg_gap ? (pm->avg_gap * 3 + (u32)gap) / 4 : gap;
+
+	/* only bother the pm core about changes over 1/8 */
+	delay = rproc_pm_predict(rproc);
+	if (abs(delay - pm->delay) > pm->delay / 8) {
+		pm->delay = delay;
+		update = true;
+	}
+unlock:
+	spin_unlock_irqrestore(&pm->lock, flags);
+
+	if (update)
+		schedule_work(&pm->work);
+}
+
+/* called by the runtime suspend handler once @rproc is suspended */
+void rproc_pm_suspended(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	pm->suspends++;
+	pm->suspended_at = ktime_get();
+	spin_unlock_irqrestore(&pm->lock, flags);
+}
+
+/* called by the runtime resume handler, @us is how long the resume took */
+void rproc_pm_resumed(struct rproc *rproc, u32 us)
+{
+	struct rproc_pm *pm = &rproc->pm;
+	unsigned long flags;
+	s64 residency;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	residency = ktime_to_ms(ktime_sub(ktime_get(), pm->suspended_at));
+	/* the suspend would have been avoided with twice the delay */
+	if (residency < pm->delay)
+		pm->bounces++;
+
+	pm->resume_us = us;
+	pm->resume_max_us = max(pm->resume_max_us, us);
+	pm->resume_avg_us = pm->resumes ?
+			(pm->resume_avg_us * 7 + us) / 8 : us;
+	pm->resumes++;
+	spin_unlock_irqrestore(&pm->lock, flags);
+}
+
+/**
+ * rproc_pm_boot() - reset the traffic history of a remote processor
+ * @rproc: the remote processor that was just booted
+ *
+ * Must be called with @rproc->lock held, once runtime pm has been set up
+ * for the new boot. Takes the runtime pm reference back for the holds
+ * that were kept over the previous shutdown.
+ */
+void rproc_pm_boot(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	pm->last_activity = ktime_get();
+	pm->avg_gap = 0;
+	pm->delay = rproc->auto_suspend_timeout;
+	spin_unlock_irqrestore(&pm->lock, flags);
+
+	if (pm->holds && !pm->held) {
+		pm_runtime_get_noresume(&rproc->dev);
+		pm->held = true;
+	}
+}
+
+/**
+ * rproc_pm_shutdown() - release the runtime pm state of a remote processor
+ * @rproc: the remote processor being shut down
+ *
+ * Must be called with @rproc->lock held, before runtime pm is disabled.
+ * The holds themselves are kept, and go back into effect on the next boot.
+ */
+void rproc_pm_shutdown(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+
+	cancel_work_sync(&pm->work);
+
+	if (pm->held) {
+		pm_runtime_put_noidle(&rproc->dev);
+		pm->held = false;
+	}
+}
+
+static void __rproc_pm_hold(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+
+	if (pm->holds++ || rproc->state == RPROC_OFFLINE)
+		return;
+
+	/*
+	 * a failure means we are in system suspend, the rproc will be
+	 * resumed on system resume and stay up from there on
+	 */
+	pm_runtime_get_sync(&rproc->dev);
+	pm->held = true;
+}
+
+static void __rproc_pm_release(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+
+	if (WARN_ON(!pm->holds))
+		return;
+
+	if (--pm->holds || !pm->held)
+		return;
+
+	pm->held = false;
+	pm_runtime_mark_last_busy(&rproc->dev);
+	pm_runtime_put_autosuspend(&rproc->dev);
+}
+
+/**
+ * rproc_pm_hold() - keep a remote processor resident
+ * @rproc: the remote processor
+ *
+ * Prevents @rproc from being runtime suspended until rproc_pm_release()
+ * is called, e.g. for the duration of a media session whose traffic is
+ * too irregular for the autosuspend prediction. Holds are counted, and
+ * are kept over shutdowns and recoveries.
+ */
+void rproc_pm_hold(struct rproc *rproc)
+{
+	mutex_lock(&rproc->lock);
+	__rproc_pm_hold(rproc);
+	mutex_unlock(&rproc->lock);
+}
+EXPORT_SYMBOL(rproc_pm_hold);
+
+/**
+ * rproc_pm_release() - drop a hold taken with rproc_pm_hold()
+ * @rproc: the remote processor
+ *
+ * Once the last hold is dropped @rproc is autosuspended again.
+ */
+void rproc_pm_release(struct rproc *rproc)
+{
+	mutex_lock(&rproc->lock);
+	__rproc_pm_release(rproc);
+	mutex_unlock(&rproc->lock);
+}
+EXPORT_SYMBOL(rproc_pm_release);
+
+/* userspace hint: writing 1 to "resident" holds the rproc up, 0 lets it go */
+static ssize_t rproc_resident_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct rproc *rproc = dev_to_rproc(dev);
+
+	return sprintf(buf, "%d\n", rproc->pm.user_hold);
+}
+
+static ssize_t rproc_resident_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct rproc *rproc = dev_to_rproc(dev);
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&rproc->lock);
+	if (val && !rproc->pm.user_hold)
+		__rproc_pm_hold(rproc);
+	else if (!val && rproc->pm.user_hold)
+		__rproc_pm_release(rproc);
+	rproc->pm.user_hold = !!val;
+	mutex_unlock(&rproc->lock);
+
+	return count;
+}
+
+struct device_attribute rproc_pm_attrs[] = {
+	__ATTR(resident, 0644, rproc_resident_show, rproc_resident_store),
+	__ATTR_NULL,
+};
+
+void rproc_pm_init(struct rproc *rproc)
+{
+	struct rproc_pm *pm = &rproc->pm;
+
+	spin_lock_init(&pm->lock);
+	INIT_WORK(&pm->work, rproc_pm_delay_work);
+	pm->delay = -1;
+}
@@ -63,7 +63,7 @@ static void rproc_virtio_notify(struct virtqueue *vq)
 	if (ret < 0)
 		rproc->need_resume = true;
 	rproc->ops->kick(rproc, notifyid);
-	pm_runtime_mark_last_busy(dev);
+	rproc_pm_activity(rproc);
 	pm_runtime_put_autosuspend(dev);
 	mutex_unlock(&rproc->lock);
 }
@@ -94,6 +94,8 @@ irqreturn_t rproc_vq_interrupt(struct rproc *rproc, int notifyid)
 	if (!rvring || !rvring->vq)
 		return IRQ_NONE;
 
+	rproc_pm_activity(rproc);
+
 	return vring_interrupt(0, rvring->vq);
 }
 EXPORT_SYMBOL(rproc_vq_interrupt);
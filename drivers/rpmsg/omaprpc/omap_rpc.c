@@ -16,6 +16,11 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+
 #include "omap_rpc_internal.h"
 
 static struct class *omaprpc_class;
@@ -42,6 +47,85 @@ EXPORT_SYMBOL(omaprpc_debug);
 MODULE_PARM_DESC(debug, "Used to enable debug messages");
 module_param_named(debug, omaprpc_debug, int, 0600);
 
+/*
+ * Time spent marshalling the pointers of a call, translating them on the
+ * way out and restoring them on the way back, in power of two buckets
+ * of microseconds.
+ */
+#define OMAPRPC_MARSHAL_BUCKETS	(12)
+
+static DEFINE_SPINLOCK(omaprpc_stats_lock);
+static unsigned long omaprpc_marshal_hist[OMAPRPC_MARSHAL_BUCKETS];
+static u64 omaprpc_marshal_total_us;
+static unsigned long omaprpc_xlate_hits;
+static unsigned long omaprpc_xlate_misses;
+static struct dentry *omaprpc_dbg;
+
+void omaprpc_stats_xlate(bool hit)
+{
+	spin_lock(&omaprpc_stats_lock);
+	if (hit)
+		omaprpc_xlate_hits++;
+	else
+		omaprpc_xlate_misses++;
+	spin_unlock(&omaprpc_stats_lock);
+}
+
+void omaprpc_stats_marshal(ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = us > 0 ? min(ilog2(us) + 1, OMAPRPC_MARSHAL_BUCKETS - 1)
+			    : 0;
+
+	spin_lock(&omaprpc_stats_lock);
+	omaprpc_marshal_hist[bucket]++;
+	omaprpc_marshal_total_us += us;
+	spin_unlock(&omaprpc_stats_lock);
+}
+
+static int omaprpc_stats_show(struct seq_file *s, void *data)
+{
+	unsigned long hist[OMAPRPC_MARSHAL_BUCKETS], hits, misses, calls = 0;
+	u64 total_us;
+	int i;
+
+	spin_lock(&omaprpc_stats_lock);
+	memcpy(hist, omaprpc_marshal_hist, sizeof(hist));
+	total_us = omaprpc_marshal_total_us;
+	hits = omaprpc_xlate_hits;
+	misses = omaprpc_xlate_misses;
+	spin_unlock(&omaprpc_stats_lock);
+
+	seq_printf(s, "translation cache: %lu hits, %lu misses\n", hits,
+		   misses);
+
+	seq_printf(s, "marshalling time:\n");
+	for (i = 0; i < OMAPRPC_MARSHAL_BUCKETS; i++) {
+		calls += hist[i];
+		if (i == OMAPRPC_MARSHAL_BUCKETS - 1)
+			seq_printf(s, "  >= %5u us: %lu\n", 1 << (i - 1),
+				   hist[i]);
+		else
+			seq_printf(s, "  <  %5u us: %lu\n", 1 << i, hist[i]);
+	}
+	if (calls)
+		seq_printf(s, "  average: %llu us over %lu\n",
+			   div_u64(total_us, calls), calls);
+	return 0;
+}
+
+static int omaprpc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omaprpc_stats_show, inode->i_private);
+}
+
+static const struct file_operations omaprpc_stats_fops = {
+	.open = omaprpc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void omaprpc_print_msg(struct omaprpc_instance_t *rpc,
 			      char *prefix, char buffer[512])
 {
@@ -419,6 +503,7 @@ static long omaprpc_ioctl(struct file *filp,
 					    "OMAPRPC: %s: %d: copy_from_user fail: %d\n",
 					    __func__, _IOC_NR(cmd), ret);
 			}
+			omaprpc_xlate_forget(rpc, data.handle);
 			ion_free(rpc->ion_client, data.handle);
 			if (copy_to_user
 			    ((char __user *)arg, &data, sizeof(data))) {
@@ -481,7 +566,9 @@ static int omaprpc_open(struct inode *inode, struct file *filp)
 	/* Initialize the remember function call list */
 	INIT_LIST_HEAD(&rpc->fxn_list);
 
-#if defined(OMAPRPC_USE_DMABUF)
+#if defined(OMAPRPC_USE_ION)
+	INIT_LIST_HEAD(&rpc->xlate_list);
+#elif defined(OMAPRPC_USE_DMABUF)
 	INIT_LIST_HEAD(&rpc->dma_list);
 #endif
 
@@ -585,6 +672,8 @@ static int omaprpc_release(struct inode *inode, struct file *filp)
 			rpc->ept = NULL;
 		}
 	}
+	/* Unpin the buffers whose translations were kept */
+	omaprpc_xlate_flush(rpc);
 #if defined(OMAPRPC_USE_ION)
 	if (rpc->ion_client) {
 		/* Destroy our local client to ion */
@@ -719,6 +808,8 @@ static ssize_t omaprpc_read(struct file *filp,
 	function = omaprpc_fxn_get(rpc, packet->msg_id);
 	if (function) {
 		if (function->num_translations > 0) {
+			ktime_t start = ktime_get();
+
 			/*
 			 * Untranslate the PA pointers back
 			 * to the ARM ION handles
@@ -726,6 +817,7 @@ static ssize_t omaprpc_read(struct file *filp,
 			ret = omaprpc_xlate_buffers(rpc,
 						    function,
 						    OMAPRPC_RPA_TO_UVA);
+			omaprpc_stats_marshal(start);
 			if (ret < 0)
 				goto failure;
 		}
@@ -759,6 +851,7 @@ static ssize_t omaprpc_write(struct file *filp,
 	struct omaprpc_parameter_t *parameters = NULL;
 	char kbuf[512];
 	int use = 0, ret = 0, param = 0;
+	ktime_t start;
 
 	/* incorrect parameter */
 	if (len < sizeof(struct omaprpc_call_function_t)) {
@@ -817,6 +910,7 @@ static ssize_t omaprpc_write(struct file *filp,
 
 	/* compute the parameter pointer changes last since this will cause the
 	   cache operations */
+	start = ktime_get();
 	parameters = (struct omaprpc_parameter_t *)packet->data;
 	for (param = 0; param < function->num_params; param++) {
 		parameters[param].size = function->params[param].size;
@@ -868,6 +962,7 @@ static ssize_t omaprpc_write(struct file *filp,
 			goto failure;
 		}
 	}
+	omaprpc_stats_marshal(start);
 
 	/* save the function data */
 	ret = omaprpc_fxn_add(rpc, function, rpc->msgId);
@@ -1286,6 +1381,13 @@ static int __init omaprpc_init(void)
 		goto unreg_region;
 	}
 
+	if (debugfs_initialized()) {
+		omaprpc_dbg = debugfs_create_dir(KBUILD_MODNAME, NULL);
+		if (omaprpc_dbg)
+			debugfs_create_file("stats", 0400, omaprpc_dbg, NULL,
+					    &omaprpc_stats_fops);
+	}
+
 	ret = register_rpmsg_driver(&omaprpc_driver);
 	pr_err("OMAPRPC: Registration of OMAPRPC rpmsg service returned %d! ",
 	       ret);
@@ -1304,6 +1406,7 @@ static void __exit omaprpc_fini(void)
 	int major = MAJOR(omaprpc_dev);
 
 	unregister_rpmsg_driver(&omaprpc_driver);
+	debugfs_remove_recursive(omaprpc_dbg);
 	list_for_each_entry_safe(rpcserv, tmp, &omaprpc_services_list, list) {
 		device_destroy(omaprpc_class, MKDEV(major, rpcserv->minor));
 		cdev_del(&rpcserv->cdev);
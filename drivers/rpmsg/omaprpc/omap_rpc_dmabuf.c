@@ -18,20 +18,26 @@
 
 #include "omap_rpc_internal.h"
 
-static void omaprpc_dma_clear(struct omaprpc_instance_t *rpc)
+/* this function should only be called while rpc->lock is held */
+static void omaprpc_dma_drop(struct omaprpc_instance_t *rpc,
+			     struct dma_info_t *dma)
+{
+	OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
+		      "Removing Pinning for FD %u\n", dma->fd);
+	list_del(&dma->list);
+	rpc->num_xlate--;
+	dma_buf_unmap_attachment(dma->attach, dma->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(dma->dbuf, dma->attach);
+	dma_buf_put(dma->dbuf);
+	kfree(dma);
+}
+
+void omaprpc_xlate_flush(struct omaprpc_instance_t *rpc)
 {
 	struct dma_info_t *pos, *n;
 	mutex_lock(&rpc->lock);
-	list_for_each_entry_safe(pos, n, &rpc->dma_list, list) {
-		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
-			      "Removing Pinning for FD %u\n", pos->fd);
-		list_del((struct list_head *)pos);
-		dma_buf_unmap_attachment(pos->attach, pos->sgt,
-					 DMA_BIDIRECTIONAL);
-		dma_buf_detach(pos->dbuf, pos->attach);
-		dma_buf_put(pos->dbuf);
-		kfree(pos);
-	}
+	list_for_each_entry_safe(pos, n, &rpc->dma_list, list)
+		omaprpc_dma_drop(rpc, pos);
 	mutex_unlock(&rpc->lock);
 	return;
 }
@@ -42,6 +48,10 @@ static int omaprpc_dma_add(struct omaprpc_instance_t *rpc,
 	if (dma) {
 		mutex_lock(&rpc->lock);
 		list_add(&dma->list, &rpc->dma_list);
+		/* unpin the least recently used buffer */
+		if (++rpc->num_xlate > OMAPRPC_XLATE_MAX)
+			omaprpc_dma_drop(rpc, list_entry(rpc->dma_list.prev,
+						struct dma_info_t, list));
 		mutex_unlock(&rpc->lock);
 		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
 			      rpc->rpcserv->dev,
@@ -61,18 +71,27 @@ static phys_addr_t omaprpc_pin_buffer(struct omaprpc_instance_t *rpc,
 	OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
 		      rpc->rpcserv->dev, "Pining with FD %u\n", dma->fd);
 	dma->dbuf = dma_buf_get((int)reserved);
-	if (!(IS_ERR(dma->dbuf))) {
-		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
-			      rpc->rpcserv->dev, "DMA_BUF=%p\n", dma->dbuf);
-		dma->attach = dma_buf_attach(dma->dbuf, rpc->rpcserv->dev);
-		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
-			      rpc->rpcserv->dev, "attach=%p\n", dma->attach);
-		dma->sgt = dma_buf_map_attachment(dma->attach,
-						  DMA_BIDIRECTIONAL);
-		omaprpc_dma_add(rpc, dma);
-		return sg_dma_address(dma->sgt->sgl);
-	} else
-		kfree(dma);
+	if (IS_ERR(dma->dbuf))
+		goto free_dma;
+	OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
+		      rpc->rpcserv->dev, "DMA_BUF=%p\n", dma->dbuf);
+	dma->attach = dma_buf_attach(dma->dbuf, rpc->rpcserv->dev);
+	OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
+		      rpc->rpcserv->dev, "attach=%p\n", dma->attach);
+	if (IS_ERR(dma->attach))
+		goto put_dbuf;
+	dma->sgt = dma_buf_map_attachment(dma->attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR_OR_NULL(dma->sgt))
+		goto detach;
+	omaprpc_dma_add(rpc, dma);
+	return sg_dma_address(dma->sgt->sgl);
+
+detach:
+	dma_buf_detach(dma->dbuf, dma->attach);
+put_dbuf:
+	dma_buf_put(dma->dbuf);
+free_dma:
+	kfree(dma);
 	return 0;
 }
 
@@ -80,22 +99,35 @@ static phys_addr_t omaprpc_dma_find(struct omaprpc_instance_t *rpc,
 				    void *reserved)
 {
 	phys_addr_t addr = 0;
-	struct list_head *pos = NULL;
 	struct dma_info_t *node = NULL;
+	struct dma_buf *dbuf;
 	int fd = (int)reserved;
+
+	/* the fd may have been closed and reused for another dma_buf */
+	dbuf = dma_buf_get(fd);
+	if (IS_ERR(dbuf))
+		return 0;
+
 	mutex_lock(&rpc->lock);
-	list_for_each(pos, &rpc->dma_list) {
-		node = (struct dma_info_t *)pos;
+	list_for_each_entry(node, &rpc->dma_list, list) {
 		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
 			      "Looking for FD %u, found FD %u\n", fd, node->fd);
 		if (node->fd == fd) {
-			addr = sg_dma_address(node->sgt->sgl);
+			if (node->dbuf == dbuf) {
+				addr = sg_dma_address(node->sgt->sgl);
+				list_move(&node->list, &rpc->dma_list);
+			} else {
+				omaprpc_dma_drop(rpc, node);
+			}
 			break;
 		}
 	}
 	OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
 		      "Returning Addr %p for FD %u\n", (void *)addr, fd);
 	mutex_unlock(&rpc->lock);
+	dma_buf_put(dbuf);
+
+	omaprpc_stats_xlate(addr != 0);
 	return addr;
 }
 
@@ -146,6 +178,26 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 	return rpa;
 }
 
+/*
+ * Whether the next translation patches the same page of the same parameter,
+ * in which case the page is left mapped for it rather than unmapped and
+ * mapped again.
+ */
+static bool omaprpc_same_page(struct omaprpc_call_function_t *function,
+			      int next, int limit, uint32_t ptr_idx,
+			      uint32_t pri_offset, uint32_t sec_offset)
+{
+	struct omaprpc_param_translation_t *xlate;
+
+	if (next == limit || next < 0 || next >= function->num_translations)
+		return false;
+
+	xlate = &function->translations[next];
+	return xlate->index == ptr_idx &&
+	       ((pri_offset + xlate->offset) >> PAGE_SHIFT) ==
+	       ((pri_offset + sec_offset) >> PAGE_SHIFT);
+}
+
 int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 			  struct omaprpc_call_function_t *function,
 			  int direction)
@@ -209,13 +261,13 @@ int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 
 		/* if the KVA pointer has not been mapped */
 		if (base_ptrs[ptr_idx] == NULL) {
-			size_t start = (pri_offset + sec_offset) & PAGE_MASK;
-			size_t end = PAGE_SIZE;
+			size_t start, end = PAGE_SIZE;
 			int ret = 0;
 
 			/* compute the secondary offset */
 			pri_offset = function->params[ptr_idx].data -
 			    function->params[ptr_idx].base;
+			start = (pri_offset + sec_offset) & PAGE_MASK;
 
 			/* acquire a handle to the dma buf */
 			dbufs[ptr_idx] = dma_buf_get((int)function->
@@ -256,6 +308,9 @@ int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 			}
 		}
 
+		/* the page may still be mapped for the previous translation */
+		pg_offset = ((pri_offset + sec_offset) & (PAGE_SIZE - 1));
+
 		/* if the KVA pointer is not NULL */
 		if (base_ptrs[ptr_idx] != NULL) {
 			if (direction == OMAPRPC_UVA_TO_RPA) {
@@ -411,7 +466,9 @@ unwind:
 			}
 		}
 restart:
-		if (base_ptrs[ptr_idx]) {
+		if (ptr_idx < OMAPRPC_MAX_PARAMETERS && base_ptrs[ptr_idx] &&
+		    !omaprpc_same_page(function, idx + inc, limit, ptr_idx,
+				       pri_offset, sec_offset)) {
 			size_t start = (pri_offset + sec_offset) & PAGE_MASK;
 			size_t end = PAGE_SIZE;
 
@@ -438,12 +495,10 @@ restart:
 			pg_offset = 0;
 		}
 	}
-	if (direction == OMAPRPC_RPA_TO_UVA) {
-		/*
-		 * we're done translating everything, unpin all the translations
-		 * and the parameters
-		 */
-		omaprpc_dma_clear(rpc);
-	}
+	/*
+	 * The buffers stay pinned once the call returns, the next calls
+	 * will most likely reference them again. They are unpinned when
+	 * the instance is released.
+	 */
 	return ret;
 }
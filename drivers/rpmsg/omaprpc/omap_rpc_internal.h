@@ -34,6 +34,7 @@
 #include <linux/sched.h>
 #include <linux/completion.h>
 #include <linux/remoteproc.h>
+#include <linux/ktime.h>
 
 #if defined(CONFIG_RPMSG) || defined(CONFIG_RPMSG_MODULE)
 #include <linux/rpmsg.h>
@@ -100,6 +101,9 @@ extern unsigned int omaprpc_debug;
 
 #define OMAPRPC_ERR(dev, fmt, ...)	dev_err((dev), (fmt), ## __VA_ARGS__)
 
+/* buffers whose translation an instance keeps, most recently used first */
+#define OMAPRPC_XLATE_MAX	(32)
+
 #ifdef CONFIG_PHYS_ADDR_T_64BIT
 typedef u64 virt_addr_t;
 #else
@@ -157,17 +161,44 @@ struct omaprpc_instance_t {
 	u32 core;
 #if defined(OMAPRPC_USE_ION)
 	struct ion_client *ion_client;
+	struct list_head xlate_list;
 #elif defined(OMAPRPC_USE_DMABUF)
 	struct list_head dma_list;
 #endif
+	int num_xlate;
 	u16 msgId;
 	struct list_head fxn_list;
 };
 
+#if defined(OMAPRPC_USE_ION)
+/**
+ * struct omaprpc_xlate_t - The local physical address of a buffer, kept for
+ * the lifetime of the instance so that each call does not have to resolve
+ * it again.
+ * @reserved:	the ion handle, or the fd of a PVR buffer, userspace passes
+ * @handle:	the handle imported for a PVR fd, NULL when @reserved is
+ *		already one of our handles
+ * @buffer:	the ion buffer a PVR fd referred to, to notice fd reuse
+ * @lpa:	local physical address of the start of the buffer
+ * @kmapped:	a kernel mapping is held, so that marshalling a call only
+ *		takes a reference on it
+ */
+struct omaprpc_xlate_t {
+	struct list_head list;
+	void *reserved;
+	struct ion_handle *handle;
+	struct ion_buffer *buffer;
+	phys_addr_t lpa;
+	bool kmapped;
+};
+#endif
+
 #if defined(OMAPRPC_USE_DMABUF)
 /**
  * struct dma_info_t - The DMA Info structure tracks the dma_buf relevant
- * variables.
+ * variables. The attachment stays mapped until the instance is released,
+ * the fd is found to refer to another dma_buf or the entry is the least
+ * recently used of more than OMAPRPC_XLATE_MAX.
  */
 struct dma_info_t {
 	struct list_head list;
@@ -206,6 +237,25 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 				  virt_addr_t uva,
 				  virt_addr_t buva, void *reserved);
 
+/*!
+ * Drops all the translations kept by an instance.
+ */
+void omaprpc_xlate_flush(struct omaprpc_instance_t *rpc);
+
+#if defined(OMAPRPC_USE_ION)
+/*!
+ * Drops the translation of a handle which is about to be freed.
+ */
+void omaprpc_xlate_forget(struct omaprpc_instance_t *rpc, void *reserved);
+#endif
+
+/*!
+ * Accounts a translation cache lookup and the time taken to marshal
+ * the pointers of a call.
+ */
+void omaprpc_stats_xlate(bool hit);
+void omaprpc_stats_marshal(ktime_t start);
+
 /*!
  * Used to recalculate the offset of a buffer and handles cases where Tiler
  * 2d regions are concerned.
@@ -18,6 +18,185 @@
 
 #include "omap_rpc_internal.h"
 
+/* this function should only be called while rpc->lock is held */
+static struct omaprpc_xlate_t *omaprpc_xlate_find(struct omaprpc_instance_t
+						  *rpc, void *reserved)
+{
+	struct omaprpc_xlate_t *xlate;
+
+	list_for_each_entry(xlate, &rpc->xlate_list, list)
+		if (xlate->reserved == reserved)
+			return xlate;
+	return NULL;
+}
+
+/* this function should only be called while rpc->lock is held */
+static void omaprpc_xlate_drop(struct omaprpc_instance_t *rpc,
+			       struct omaprpc_xlate_t *xlate)
+{
+	struct ion_handle *handle = xlate->handle ? xlate->handle :
+				    (struct ion_handle *)xlate->reserved;
+
+	if (xlate->kmapped)
+		ion_unmap_kernel(rpc->ion_client, handle);
+	if (xlate->handle)
+		ion_free(rpc->ion_client, xlate->handle);
+	list_del(&xlate->list);
+	rpc->num_xlate--;
+	kfree(xlate);
+}
+
+void omaprpc_xlate_flush(struct omaprpc_instance_t *rpc)
+{
+	struct omaprpc_xlate_t *xlate, *n;
+
+	mutex_lock(&rpc->lock);
+	list_for_each_entry_safe(xlate, n, &rpc->xlate_list, list)
+		omaprpc_xlate_drop(rpc, xlate);
+	mutex_unlock(&rpc->lock);
+}
+
+void omaprpc_xlate_forget(struct omaprpc_instance_t *rpc, void *reserved)
+{
+	struct omaprpc_xlate_t *xlate;
+
+	mutex_lock(&rpc->lock);
+	xlate = omaprpc_xlate_find(rpc, reserved);
+	if (xlate)
+		omaprpc_xlate_drop(rpc, xlate);
+	mutex_unlock(&rpc->lock);
+}
+
+/* the ion buffer a PVR fd refers to, NULL if it is not one */
+static struct ion_buffer *omaprpc_pvr_buffer(void *reserved)
+{
+	/*
+	 * TODO: need to support 2 ion handles
+	 * per 1 pvr handle (NV12 case)
+	 */
+	struct ion_buffer *ion_buffer = NULL;
+	int num_handles = 1;
+
+	if (omap_ion_share_fd_to_buffers((int)reserved, &ion_buffer,
+					 &num_handles) < 0)
+		return NULL;
+	return ion_buffer;
+}
+
+/*
+ * Resolves the local physical address of the buffer behind reserved, which
+ * is either one of our ion handles or the fd of a PVR buffer wrapping an ion
+ * buffer, and keeps it for the next calls.
+ */
+static struct omaprpc_xlate_t *omaprpc_xlate_new(struct omaprpc_instance_t
+						 *rpc, void *reserved)
+{
+	struct omaprpc_xlate_t *xlate;
+	struct ion_handle *handle;
+	ion_phys_addr_t paddr;
+	size_t unused;
+
+	xlate = kzalloc(sizeof(*xlate), GFP_KERNEL);
+	if (!xlate)
+		return NULL;
+	xlate->reserved = reserved;
+
+	/* is it an ion handle? */
+	handle = (struct ion_handle *)reserved;
+	if (!ion_phys(rpc->ion_client, handle, &paddr, &unused)) {
+		xlate->lpa = (phys_addr_t) paddr;
+		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
+			      "Handle %p is an ION Handle to ARM PA %p\n",
+			      reserved, (void *)xlate->lpa);
+		return xlate;
+	}
+
+	/* is it an pvr buffer wrapping an ion handle? */
+	xlate->buffer = omaprpc_pvr_buffer(reserved);
+	if (xlate->buffer)
+		xlate->handle = ion_import(rpc->ion_client, xlate->buffer);
+	if (!IS_ERR_OR_NULL(xlate->handle) &&
+	    !ion_phys(rpc->ion_client, xlate->handle, &paddr, &unused)) {
+		xlate->lpa = (phys_addr_t) paddr;
+		OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
+			      "FD %d is an PVR Handle to ARM PA %p\n",
+			      (int)reserved, (void *)xlate->lpa);
+		return xlate;
+	}
+
+	if (!IS_ERR_OR_NULL(xlate->handle))
+		ion_free(rpc->ion_client, xlate->handle);
+	kfree(xlate);
+	return NULL;
+}
+
+static phys_addr_t omaprpc_xlate_lpa(struct omaprpc_instance_t *rpc,
+				     void *reserved)
+{
+	struct omaprpc_xlate_t *xlate, *new;
+	phys_addr_t lpa = 0;
+
+	mutex_lock(&rpc->lock);
+	xlate = omaprpc_xlate_find(rpc, reserved);
+	/* an fd may have been closed and reused for another buffer */
+	if (xlate && xlate->handle &&
+	    omaprpc_pvr_buffer(reserved) != xlate->buffer) {
+		omaprpc_xlate_drop(rpc, xlate);
+		xlate = NULL;
+	}
+	if (xlate) {
+		list_move(&xlate->list, &rpc->xlate_list);
+		lpa = xlate->lpa;
+	}
+	mutex_unlock(&rpc->lock);
+
+	omaprpc_stats_xlate(xlate != NULL);
+	if (xlate)
+		return lpa;
+
+	new = omaprpc_xlate_new(rpc, reserved);
+	if (!new)
+		return 0;
+	lpa = new->lpa;
+
+	mutex_lock(&rpc->lock);
+	/* another thread of this instance may have raced us */
+	xlate = omaprpc_xlate_find(rpc, reserved);
+	if (xlate) {
+		if (new->handle)
+			ion_free(rpc->ion_client, new->handle);
+		kfree(new);
+	} else {
+		list_add(&new->list, &rpc->xlate_list);
+		if (++rpc->num_xlate > OMAPRPC_XLATE_MAX)
+			omaprpc_xlate_drop(rpc, list_entry(rpc->xlate_list.prev,
+						struct omaprpc_xlate_t, list));
+	}
+	mutex_unlock(&rpc->lock);
+
+	return lpa;
+}
+
+/*
+ * Holds a kernel mapping of a buffer for as long as its translation is
+ * kept, so that the map and unmap done for every call are only reference
+ * counting rather than a vmap and vunmap of the whole buffer.
+ */
+static void omaprpc_xlate_kmap(struct omaprpc_instance_t *rpc,
+			       struct ion_handle *handle)
+{
+	struct omaprpc_xlate_t *xlate;
+	void *kva;
+
+	mutex_lock(&rpc->lock);
+	xlate = omaprpc_xlate_find(rpc, handle);
+	if (xlate && !xlate->handle && !xlate->kmapped) {
+		kva = ion_map_kernel(rpc->ion_client, handle);
+		xlate->kmapped = !IS_ERR_OR_NULL(kva);
+	}
+	mutex_unlock(&rpc->lock);
+}
+
 static uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
 				       struct omaprpc_param_t *param)
 {
@@ -30,6 +209,9 @@ static uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
 
 	bkva = (uint8_t *) ion_map_kernel(rpc->ion_client,
 					  (struct ion_handle *)param->reserved);
+	if (IS_ERR_OR_NULL(bkva))
+		return NULL;
+	omaprpc_xlate_kmap(rpc, (struct ion_handle *)param->reserved);
 
 	/*
 	 * set the kernel VA equal to the base kernel
@@ -83,64 +265,13 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 	}
 
 	if (reserved) {
-		struct ion_handle *handle;
-		ion_phys_addr_t paddr;
-		size_t unused;
-
-		/* is it an ion handle? */
-		handle = (struct ion_handle *)reserved;
-		if (!ion_phys(rpc->ion_client, handle, &paddr, &unused)) {
-			lpa = (phys_addr_t) paddr;
-			OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
-				      "Handle %p is an ION Handle to ARM PA %p "
-				      "(Uoff=%ld)\n", reserved, (void *)lpa,
-				      uoff);
+		lpa = omaprpc_xlate_lpa(rpc, reserved);
+		if (lpa) {
 			uoff = omaprpc_recalc_off(lpa, uoff);
 			lpa += uoff;
-			goto to_va;
-		} else {
-			/* is it an pvr buffer wrapping an ion handle? */
-
-			/*
-			 * TODO: need to support 2 ion handles
-			 * per 1 pvr handle (NV12 case)
-			 */
-			struct ion_buffer *ion_buffer = NULL;
-			int num_handles = 1;
-			handle = NULL;
-			if (omap_ion_share_fd_to_buffers((int)reserved,
-							 &ion_buffer,
-							 &num_handles) < 0) {
-				goto to_va;
-			}
-			if (ion_buffer) {
-				handle = ion_import(rpc->ion_client,
-						    ion_buffer);
-			}
-			if (handle && !ion_phys(rpc->ion_client, handle,
-						&paddr, &unused)) {
-				lpa = (phys_addr_t) paddr;
-				OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
-					      rpc->rpcserv->dev,
-					      "FD %d is an PVR Handle to ARM PA %p "
-					      "(Uoff=%ld)\n", (int)reserved,
-					      (void *)lpa, uoff);
-				uoff = omaprpc_recalc_off(lpa, uoff);
-				lpa += uoff;
-				goto to_va;
-			}
-			/*
-			 * TODO: need to do some buffer tracking and call
-			 * ion_free when it is no longer being used. this
-			 * will make sure the buffer is not freed while
-			 * we are still using it
-			 */
-			if (handle)
-				ion_free(rpc->ion_client, handle);
 		}
 	}
 
-to_va:
 	/* convert the local physical address to remote physical address */
 	rpa = rpmsg_local_to_remote_pa(rpc, lpa);
 to_end:
@@ -37,6 +37,9 @@
 #include <linux/completion.h>
 #include <linux/remoteproc.h>
 #include <linux/fdtable.h>
+#include <linux/hash.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #ifdef CONFIG_ION_OMAP
 #include <linux/ion.h>
@@ -48,6 +51,10 @@ extern struct ion_device *omap_ion_device;
 /* maximum OMX devices this driver can handle */
 #define MAX_OMX_DEVICES		8
 
+/* buffer translations cached per instance */
+#define OMX_XLATE_HASH_BITS	4
+#define OMX_XLATE_MAX		64
+
 enum rpc_omx_map_info_type {
 	RPC_OMX_MAP_INFO_NONE          = 0,
 	RPC_OMX_MAP_INFO_ONE_BUF       = 1,
@@ -64,8 +71,12 @@ struct rpmsg_omx_service {
 	struct list_head list;
 	struct mutex lock;
 	struct completion comp;
+	struct dentry *dbg_stats;
 #ifdef CONFIG_ION_OMAP
 	struct ion_client *ion_client;
+	/* translation cache counts of instances already released */
+	unsigned long xlate_hits;
+	unsigned long xlate_misses;
 #endif
 };
 
@@ -82,10 +93,26 @@ struct rpmsg_omx_instance {
 #ifdef CONFIG_ION_OMAP
 	struct ion_client *ion_client;
 	struct list_head buffer_list;
+	struct hlist_head xlate[1 << OMX_XLATE_HASH_BITS];
+	int n_xlate;
+	unsigned long xlate_hits;
+	unsigned long xlate_misses;
 #endif
 };
 
 #ifdef CONFIG_ION_OMAP
+/*
+ * Device address of a buffer, as last looked up for a message. Video
+ * codecs reference the same few buffers in every frame, so this saves
+ * the ion and rproc lookups for all but the first message. An entry
+ * stays valid until its buffer is unregistered or the instance released.
+ */
+struct rpmsg_omx_xlate {
+	struct hlist_node node;
+	long buffer;
+	u32 da;
+};
+
 struct rpmsg_buffer {
 	struct list_head next;
 	struct ion_handle *ion_handle;
@@ -99,6 +126,7 @@ struct rpmsg_buffer {
 
 static struct class *rpmsg_omx_class;
 static dev_t rpmsg_omx_dev;
+static struct dentry *rpmsg_omx_dbg;
 
 /* store all remote omx connection services (usually one per remoteproc) */
 static DEFINE_IDR(rpmsg_omx_services);
@@ -232,6 +260,97 @@ _rpmsg_buffer_free(struct rpmsg_omx_instance *omx, struct rpmsg_buffer *buffer)
 	list_del(&buffer->next);
 	kfree(buffer);
 }
+
+static inline struct hlist_head *
+_rpmsg_xlate_bucket(struct rpmsg_omx_instance *omx, long buffer)
+{
+	return &omx->xlate[hash_long(buffer, OMX_XLATE_HASH_BITS)];
+}
+
+/* this function should only be called while omx->lock is held */
+static struct rpmsg_omx_xlate *
+_rpmsg_xlate_find(struct rpmsg_omx_instance *omx, long buffer)
+{
+	struct rpmsg_omx_xlate *xlate;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(xlate, pos, _rpmsg_xlate_bucket(omx, buffer),
+			     node)
+		if (xlate->buffer == buffer)
+			return xlate;
+	return NULL;
+}
+
+static bool _rpmsg_xlate_lookup(struct rpmsg_omx_instance *omx, long buffer,
+				u32 *da)
+{
+	struct rpmsg_omx_xlate *xlate;
+
+	mutex_lock(&omx->lock);
+	xlate = _rpmsg_xlate_find(omx, buffer);
+	if (xlate) {
+		*da = xlate->da;
+		omx->xlate_hits++;
+	} else {
+		omx->xlate_misses++;
+	}
+	mutex_unlock(&omx->lock);
+
+	return xlate != NULL;
+}
+
+static void _rpmsg_xlate_add(struct rpmsg_omx_instance *omx, long buffer,
+			     u32 da)
+{
+	struct rpmsg_omx_xlate *xlate;
+
+	xlate = kmalloc(sizeof(*xlate), GFP_KERNEL);
+	if (!xlate)
+		return;
+	xlate->buffer = buffer;
+	xlate->da = da;
+
+	mutex_lock(&omx->lock);
+	/* a concurrent write may have added it, or the cache is full */
+	if (omx->n_xlate >= OMX_XLATE_MAX || _rpmsg_xlate_find(omx, buffer)) {
+		kfree(xlate);
+	} else {
+		hlist_add_head(&xlate->node, _rpmsg_xlate_bucket(omx, buffer));
+		omx->n_xlate++;
+	}
+	mutex_unlock(&omx->lock);
+}
+
+static void _rpmsg_xlate_remove(struct rpmsg_omx_instance *omx, long buffer)
+{
+	struct rpmsg_omx_xlate *xlate;
+
+	mutex_lock(&omx->lock);
+	xlate = _rpmsg_xlate_find(omx, buffer);
+	if (xlate) {
+		hlist_del(&xlate->node);
+		omx->n_xlate--;
+	}
+	mutex_unlock(&omx->lock);
+
+	kfree(xlate);
+}
+
+static void _rpmsg_xlate_flush(struct rpmsg_omx_instance *omx)
+{
+	struct rpmsg_omx_xlate *xlate;
+	struct hlist_node *pos, *tmp;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omx->xlate); i++) {
+		hlist_for_each_entry_safe(xlate, pos, tmp, &omx->xlate[i],
+					  node) {
+			hlist_del(&xlate->node);
+			kfree(xlate);
+		}
+	}
+	omx->n_xlate = 0;
+}
 #endif
 
 static int _rpmsg_omx_buffer_lookup(struct rpmsg_omx_instance *omx,
@@ -255,6 +374,9 @@ static int _rpmsg_omx_buffer_lookup(struct rpmsg_omx_instance *omx,
 		ion_phys_addr_t paddr;
 		size_t unused;
 
+		if (_rpmsg_xlate_lookup(omx, buffer, va))
+			return 0;
+
 		/* is it an ion handle? */
 		handle = (struct ion_handle *)buffer;
 		if (!ion_phys(omx->ion_client, handle, &paddr, &unused)) {
@@ -275,6 +397,8 @@ static int _rpmsg_omx_buffer_lookup(struct rpmsg_omx_instance *omx,
 		}
 	}
 exit:
+	if (!ret)
+		_rpmsg_xlate_add(omx, buffer, *va);
 #endif
 
 	if (ret)
@@ -564,6 +688,7 @@ long rpmsg_omx_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			return -EFAULT;
 		}
 		buffer = (struct rpmsg_buffer *) data.handle;
+		_rpmsg_xlate_remove(omx, (long)data.handle);
 		if (_rpmsg_buffer_validate(omx, buffer))
 			_rpmsg_buffer_free(omx, buffer);
 		else
@@ -706,9 +831,14 @@ static int rpmsg_omx_release(struct inode *inode, struct file *filp)
 		_rpmsg_buffer_free(omx, buffer);
 	}
 	ion_client_destroy(omx->ion_client);
+	_rpmsg_xlate_flush(omx);
 #endif
 	mutex_lock(&omxserv->lock);
 	list_del(&omx->next);
+#ifdef CONFIG_ION_OMAP
+	omxserv->xlate_hits += omx->xlate_hits;
+	omxserv->xlate_misses += omx->xlate_misses;
+#endif
 	/*
 	 * only destroy ept if omx state != OMX_FAIL. Otherwise, it is not
 	 * needed because it was already destroyed by rpmsg_omx_remove function
@@ -849,6 +979,52 @@ static const struct file_operations rpmsg_omx_fops = {
 	.owner		= THIS_MODULE,
 };
 
+#ifdef CONFIG_ION_OMAP
+static void rpmsg_omx_print_xlate(struct seq_file *s, const char *who,
+				  int entries, unsigned long hits,
+				  unsigned long misses)
+{
+	unsigned long total = hits + misses;
+
+	seq_printf(s, "%-12s %7d %10lu %10lu %5lu%%\n", who, entries, hits,
+		   misses, total ? hits * 100 / total : 0);
+}
+
+static int rpmsg_omx_stats_show(struct seq_file *s, void *data)
+{
+	struct rpmsg_omx_service *omxserv = s->private;
+	struct rpmsg_omx_instance *omx;
+	char who[16];
+
+	seq_printf(s, "%-12s %7s %10s %10s %6s\n", "instance", "entries",
+		   "hits", "misses", "hit");
+
+	mutex_lock(&omxserv->lock);
+	list_for_each_entry(omx, &omxserv->list, next) {
+		snprintf(who, sizeof(who), "0x%x", omx->dst);
+		rpmsg_omx_print_xlate(s, who, omx->n_xlate, omx->xlate_hits,
+				      omx->xlate_misses);
+	}
+	rpmsg_omx_print_xlate(s, "released", 0, omxserv->xlate_hits,
+			      omxserv->xlate_misses);
+	mutex_unlock(&omxserv->lock);
+
+	return 0;
+}
+
+static int rpmsg_omx_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpmsg_omx_stats_show, inode->i_private);
+}
+
+static const struct file_operations rpmsg_omx_stats_ops = {
+	.open = rpmsg_omx_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int _match_omx_service(int id, void *p, void *data)
 {
 	struct rpmsg_omx_service *omxserv = p;
@@ -917,6 +1093,12 @@ static int rpmsg_omx_probe(struct rpmsg_channel *rpdev)
 		dev_err(&rpdev->dev, "device_create failed: %d\n", ret);
 		goto clean_cdev;
 	}
+#ifdef CONFIG_ION_OMAP
+	if (rpmsg_omx_dbg)
+		omxserv->dbg_stats = debugfs_create_file(rpdev->id.name, 0400,
+					rpmsg_omx_dbg, omxserv,
+					&rpmsg_omx_stats_ops);
+#endif
 serv_up:
 	complete_all(&omxserv->comp);
 
@@ -945,6 +1127,7 @@ static void __devexit rpmsg_omx_remove(struct rpmsg_channel *rpdev)
 	dev_info(omxserv->dev, "rpmsg omx driver is removed\n");
 
 	if (rproc->state != RPROC_CRASHED) {
+		debugfs_remove(omxserv->dbg_stats);
 		device_destroy(rpmsg_omx_class, MKDEV(major, omxserv->minor));
 		cdev_del(&omxserv->cdev);
 		mutex_lock(&rpmsg_omx_services_lock);
@@ -1017,6 +1200,9 @@ static int __init init(void)
 		goto unreg_region;
 	}
 
+	if (debugfs_initialized())
+		rpmsg_omx_dbg = debugfs_create_dir(KBUILD_MODNAME, NULL);
+
 	return register_rpmsg_driver(&rpmsg_omx_driver);
 
 unreg_region:
@@ -1029,6 +1215,7 @@ module_init(init);
 static void __exit fini(void)
 {
 	unregister_rpmsg_driver(&rpmsg_omx_driver);
+	debugfs_remove(rpmsg_omx_dbg);
 	class_destroy(rpmsg_omx_class);
 	unregister_chrdev_region(rpmsg_omx_dev, MAX_OMX_DEVICES);
 }
@@ -0,0 +1,199 @@
+/*
+ * Zero-copy rpmsg payloads in buffers shared with a remote processor
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "%s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+#include <linux/remoteproc.h>
+#include <linux/rpmsg.h>
+#include <linux/ion.h>
+
+/* sync the [offset, offset + len) part of @buf for @dir */
+static void rpmsg_shared_sync(struct rpmsg_shared_buf *buf, size_t offset,
+			      size_t len, enum dma_data_direction dir)
+{
+	phys_addr_t pa = buf->pa + offset;
+	struct scatterlist sg;
+
+	if (!buf->cached || !len)
+		return;
+
+	sg_init_table(&sg, 1);
+	sg_set_page(&sg, pfn_to_page(PFN_DOWN(pa)), len, offset_in_page(pa));
+	sg_dma_address(&sg) = pa;
+
+	if (dir == DMA_TO_DEVICE)
+		dma_sync_sg_for_device(NULL, &sg, 1, dir);
+	else
+		dma_sync_sg_for_cpu(NULL, &sg, 1, dir);
+}
+
+/**
+ * rpmsg_shared_buf_init() - prepare a buffer for sharing with a remote
+ * @buf: the buffer state to initialize
+ * @rpdev: the rpmsg channel the buffer will be shared over
+ * @pa: physical address of the buffer
+ * @size: size of the buffer (in bytes)
+ *
+ * The whole buffer must be mapped into the remote processor's address
+ * space (see rproc_pa_to_da()).
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_shared_buf_init(struct rpmsg_shared_buf *buf,
+			  struct rpmsg_channel *rpdev, phys_addr_t pa,
+			  size_t size)
+{
+	struct rproc *rproc = vdev_to_rproc(rpdev->vrp->vdev);
+	u64 da, last;
+	int ret;
+
+	if (!size)
+		return -EINVAL;
+
+	ret = rproc_pa_to_da(rproc, pa, &da);
+	if (ret)
+		return ret;
+
+	/* the remote mapping must be contiguous as well */
+	ret = rproc_pa_to_da(rproc, pa + size - 1, &last);
+	if (ret)
+		return ret;
+	if (last - da != size - 1) {
+		dev_err(&rpdev->dev, "buffer 0x%llx not contiguous on remote\n",
+						(unsigned long long)pa);
+		return -EINVAL;
+	}
+
+	memset(buf, 0, sizeof(*buf));
+	buf->rpdev = rpdev;
+	buf->pa = pa;
+	/* we know it is a 32 bit address */
+	buf->da = (u32)da;
+	buf->size = size;
+	buf->cached = pfn_valid(PFN_DOWN(pa)) &&
+			pfn_valid(PFN_DOWN(pa + size - 1));
+
+	return 0;
+}
+EXPORT_SYMBOL(rpmsg_shared_buf_init);
+
+/**
+ * rpmsg_shared_buf_import() - prepare an ion buffer for sharing with a remote
+ * @buf: the buffer state to initialize
+ * @rpdev: the rpmsg channel the buffer will be shared over
+ * @client: the ion client @handle belongs to
+ * @handle: the ion buffer
+ *
+ * Only physically contiguous ion buffers are supported. The caller keeps
+ * its reference on @handle while the buffer is shared.
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_shared_buf_import(struct rpmsg_shared_buf *buf,
+			    struct rpmsg_channel *rpdev,
+			    struct ion_client *client, struct ion_handle *handle)
+{
+#ifdef CONFIG_ION
+	ion_phys_addr_t pa;
+	size_t size;
+	int ret;
+
+	ret = ion_phys(client, handle, &pa, &size);
+	if (ret)
+		return ret;
+
+	return rpmsg_shared_buf_init(buf, rpdev, pa, size);
+#else
+	return -ENODEV;
+#endif
+}
+EXPORT_SYMBOL(rpmsg_shared_buf_import);
+
+/**
+ * rpmsg_send_shared() - pass a payload by reference to the remote processor
+ * @buf: the shared buffer holding the payload
+ * @src: source address
+ * @dst: destination address
+ * @offset: offset of the payload in @buf
+ * @len: length of the payload
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * Writes the payload back from the CPU caches, hands @buf over to the
+ * remote processor and sends it a RPMSG_HDR_F_SHARED message describing
+ * the payload. Only the small descriptor goes through the rpmsg buffers.
+ *
+ * Returns 0 on success and an appropriate error value on failure, in which
+ * case the CPU still owns @buf.
+ */
+int rpmsg_send_shared(struct rpmsg_shared_buf *buf, u32 src, u32 dst,
+		      size_t offset, size_t len, bool wait)
+{
+	struct rpmsg_shared_desc desc;
+	int ret;
+
+	if (buf->remote)
+		return -EBUSY;
+
+	if (offset > buf->size || len > buf->size - offset)
+		return -EINVAL;
+
+	rpmsg_shared_sync(buf, offset, len, DMA_TO_DEVICE);
+
+	desc.da = buf->da + offset;
+	desc.len = len;
+	desc.reserved = 0;
+
+	buf->offset = offset;
+	buf->len = len;
+	buf->remote = true;
+
+	ret = rpmsg_send_offchannel_flags(buf->rpdev, src, dst, &desc,
+				sizeof(desc), RPMSG_HDR_F_SHARED, wait);
+	if (ret)
+		buf->remote = false;
+
+	return ret;
+}
+EXPORT_SYMBOL(rpmsg_send_shared);
+
+/**
+ * rpmsg_shared_buf_reclaim() - take a shared buffer back from the remote
+ * @buf: the buffer sent with rpmsg_send_shared()
+ *
+ * Must only be called once the remote processor has signalled that it is
+ * done with @buf. Invalidates the CPU caches over the last payload, which
+ * the remote processor may have updated in place.
+ *
+ * Returns 0 on success, or -EINVAL if the remote processor doesn't own @buf.
+ */
+int rpmsg_shared_buf_reclaim(struct rpmsg_shared_buf *buf)
+{
+	if (!buf->remote)
+		return -EINVAL;
+
+	rpmsg_shared_sync(buf, buf->offset, buf->len, DMA_FROM_DEVICE);
+	buf->remote = false;
+
+	return 0;
+}
+EXPORT_SYMBOL(rpmsg_shared_buf_reclaim);
+
+MODULE_DESCRIPTION("rpmsg shared buffers");
+MODULE_LICENSE("GPL v2");
@@ -33,6 +33,8 @@
 #include <linux/wait.h>
 #include <linux/rpmsg.h>
 #include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /*
  * virtio rpmsg bus driver requests
@@ -97,6 +99,15 @@ struct rpmsg_channel_info {
 /* Address 53 is reserved for advertising remote services */
 #define RPMSG_NS_ADDR			(53)
 
+/*
+ * Endpoints may reserve TX buffers for themselves, but at least half of
+ * the TX buffers always remain available to everyone.
+ */
+#define RPMSG_MAX_TX_RESERVED		(RPMSG_NUM_BUFS / 4)
+
+/* max number of rx buffers handed back to the remote processor per kick */
+#define RPMSG_RX_BUDGET			(32)
+
 /* sysfs show configuration fields */
 #define rpmsg_show_attr(field, path, format_string)			\
 static ssize_t								\
@@ -132,6 +143,9 @@ static DEFINE_MUTEX(vprocs_mutex);
  */
 static unsigned int rpmsg_dev_index;
 
+/* debugfs parent dir of the per-vproc statistics */
+static struct dentry *rpmsg_dbg;
+
 static ssize_t modalias_show(struct device *dev,
 			     struct device_attribute *attr, char *buf)
 {
@@ -303,6 +317,63 @@ struct rpmsg_endpoint *rpmsg_create_ept(struct rpmsg_channel *rpdev,
 }
 EXPORT_SYMBOL(rpmsg_create_ept);
 
+/* the part of @ept's reservation that is not currently in flight */
+static inline int rpmsg_tx_unused(struct rpmsg_endpoint *ept)
+{
+	return max(ept->tx_reserved - ept->tx_inflight, 0);
+}
+
+static int __rpmsg_reserve_tx_bufs(struct virtproc_info *vrp,
+				   struct rpmsg_endpoint *ept, int count)
+{
+	int total;
+
+	if (count < 0)
+		return -EINVAL;
+
+	mutex_lock(&vrp->tx_lock);
+
+	total = vrp->tx_reserved - ept->tx_reserved + count;
+	if (total > RPMSG_MAX_TX_RESERVED) {
+		mutex_unlock(&vrp->tx_lock);
+		return -EBUSY;
+	}
+
+	vrp->tx_held -= rpmsg_tx_unused(ept);
+	ept->tx_reserved = count;
+	vrp->tx_held += rpmsg_tx_unused(ept);
+	vrp->tx_reserved = total;
+
+	mutex_unlock(&vrp->tx_lock);
+
+	/* buffers might have been released to other senders */
+	wake_up_interruptible(&vrp->sendq);
+
+	return 0;
+}
+
+/**
+ * rpmsg_reserve_tx_bufs() - reserve tx buffers for an endpoint
+ * @ept: the endpoint messages are sent from
+ * @count: number of tx buffers to reserve, 0 to drop the reservation
+ *
+ * TX buffers are shared by all the endpoints of a remote processor, so
+ * a single endpoint sending at a high rate could otherwise take all of
+ * them. Once reserved, @count buffers are held back from other senders
+ * whenever @ept has less than @count messages in flight.
+ *
+ * Only messages using @ept's address as their source address are
+ * accounted to @ept.
+ *
+ * Returns 0 on success, or -EBUSY if the reservation would leave too
+ * few buffers to the other endpoints.
+ */
+int rpmsg_reserve_tx_bufs(struct rpmsg_endpoint *ept, int count)
+{
+	return __rpmsg_reserve_tx_bufs(ept->rpdev->vrp, ept, count);
+}
+EXPORT_SYMBOL(rpmsg_reserve_tx_bufs);
+
 /**
  * __rpmsg_destroy_ept() - destroy an existing rpmsg endpoint
  * @vrp: virtproc which owns this ept
@@ -321,6 +392,9 @@ __rpmsg_destroy_ept(struct virtproc_info *vrp, struct rpmsg_endpoint *ept)
 	idr_remove(&vrp->endpoints, ept->addr);
 	mutex_unlock(&vrp->endpoints_lock);
 
+	/* give back the tx buffers this ept might have reserved */
+	__rpmsg_reserve_tx_bufs(vrp, ept, 0);
+
 	/* make sure in-flight inbound messages won't invoke cb anymore */
 	mutex_lock(&ept->cb_lock);
 	ept->cb = NULL;
@@ -563,25 +637,81 @@ static int __rpmsg_destroy_channel(struct virtproc_info *vrp,
 	return 0;
 }
 
-/* super simple buffer "allocator" that is just enough for now */
-static void *get_a_tx_buf(struct virtproc_info *vrp)
+static inline int rpmsg_tx_index(struct virtproc_info *vrp, void *msg)
+{
+	return (msg - vrp->sbufs) / RPMSG_BUF_SIZE;
+}
+
+/* number of tx buffers we can hand out right now; tx_lock must be held */
+static inline int rpmsg_tx_free(struct virtproc_info *vrp)
+{
+	return RPMSG_NUM_BUFS / 2 - vrp->last_sbuf + vrp->num_free;
+}
+
+/* return a tx buffer to the free pool, and its owner's share with it */
+static void put_a_tx_buf(struct virtproc_info *vrp, void *msg)
+{
+	int idx = rpmsg_tx_index(vrp, msg);
+	struct rpmsg_endpoint *ept = vrp->sbuf_owner[idx];
+
+	if (ept) {
+		vrp->sbuf_owner[idx] = NULL;
+		vrp->tx_held -= rpmsg_tx_unused(ept);
+		ept->tx_inflight--;
+		vrp->tx_held += rpmsg_tx_unused(ept);
+		kref_put(&ept->refcount, __ept_release);
+	}
+
+	vrp->sbuf_free[vrp->num_free++] = msg;
+}
+
+/*
+ * super simple buffer "allocator" that is just enough for now.
+ *
+ * @ept, if any, is the sending endpoint. Buffers covering the unused
+ * part of all tx reservations are only handed out to their owners.
+ */
+static void *get_a_tx_buf(struct virtproc_info *vrp,
+			  struct rpmsg_endpoint *ept)
 {
 	unsigned int len;
-	void *ret;
+	void *ret = NULL;
+	int held;
 
 	/* support multiple concurrent senders */
 	mutex_lock(&vrp->tx_lock);
 
+	held = (ept && rpmsg_tx_unused(ept)) ? 0 : vrp->tx_held;
+
+	/* recycle the buffers the remote processor is done with */
+	if (rpmsg_tx_free(vrp) <= held) {
+		while ((ret = virtqueue_get_buf(vrp->svq, &len)))
+			put_a_tx_buf(vrp, ret);
+
+		held = (ept && rpmsg_tx_unused(ept)) ? 0 : vrp->tx_held;
+		if (rpmsg_tx_free(vrp) <= held)
+			goto out;
+	}
+
 	/*
 	 * either pick the next unused tx buffer
 	 * (half of our buffers are used for sending messages)
 	 */
 	if (vrp->last_sbuf < RPMSG_NUM_BUFS / 2)
 		ret = vrp->sbufs + RPMSG_BUF_SIZE * vrp->last_sbuf++;
-	/* or recycle a used one */
+	/* or a recycled one */
 	else
-		ret = virtqueue_get_buf(vrp->svq, &len);
+		ret = vrp->sbuf_free[--vrp->num_free];
+
+	if (ept) {
+		vrp->tx_held -= rpmsg_tx_unused(ept);
+		ept->tx_inflight++;
+		vrp->tx_held += rpmsg_tx_unused(ept);
+		kref_get(&ept->refcount);
+		vrp->sbuf_owner[rpmsg_tx_index(vrp, ret)] = ept;
+	}
 
+out:
 	mutex_unlock(&vrp->tx_lock);
 
 	return ret;
@@ -644,12 +774,13 @@ static void rpmsg_downref_sleepers(struct virtproc_info *vrp)
 }
 
 /**
- * rpmsg_send_offchannel_raw() - send a message across to the remote processor
+ * rpmsg_send_offchannel_flags() - send a message across to the remote processor
  * @rpdev: the rpmsg channel
  * @src: source address
  * @dst: destination address
  * @data: payload of message
  * @len: length of payload
+ * @flags: rpmsg_hdr flags (RPMSG_HDR_F_*) describing the payload
  * @wait: indicates whether caller should block in case no TX buffers available
  *
  * This function is the base implementation for all of the rpmsg sending API.
@@ -677,11 +808,12 @@ static void rpmsg_downref_sleepers(struct virtproc_info *vrp)
  *
  * Returns 0 on success and an appropriate error value on failure.
  */
-int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
-					void *data, int len, bool wait)
+int rpmsg_send_offchannel_flags(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+				void *data, int len, u16 flags, bool wait)
 {
 	struct virtproc_info *vrp = rpdev->vrp;
 	struct device *dev = &rpdev->dev;
+	struct rpmsg_endpoint *ept;
 	struct scatterlist sg;
 	struct rpmsg_hdr *msg;
 	unsigned long offset = 0;
@@ -708,10 +840,19 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 		return -EMSGSIZE;
 	}
 
+	/* tx buffers are accounted to the sending endpoint, if it's local */
+	mutex_lock(&vrp->endpoints_lock);
+	ept = idr_find(&vrp->endpoints, src);
+	if (ept)
+		kref_get(&ept->refcount);
+	mutex_unlock(&vrp->endpoints_lock);
+
 	/* grab a buffer */
-	msg = get_a_tx_buf(vrp);
-	if (!msg && !wait)
-		return -ENOMEM;
+	msg = get_a_tx_buf(vrp, ept);
+	if (!msg && !wait) {
+		err = -ENOMEM;
+		goto put_ept;
+	}
 
 	/* no free buffer ? wait for one (but bail after 15 seconds) */
 	while (!msg) {
@@ -725,7 +866,7 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 		 * if later this happens to be required, it'd be easy to add.
 		 */
 		err = wait_event_interruptible_timeout(vrp->sendq,
-					(msg = get_a_tx_buf(vrp)),
+					(msg = get_a_tx_buf(vrp, ept)),
 					msecs_to_jiffies(15000));
 
 		/* disable "tx-complete" interrupts if we're the last sleeper */
@@ -734,12 +875,13 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 		/* timeout ? */
 		if (!err) {
 			dev_err(dev, "timeout waiting for a tx buffer\n");
-			return -ERESTARTSYS;
+			err = -ERESTARTSYS;
+			goto put_ept;
 		}
 	}
 
 	msg->len = len;
-	msg->flags = 0;
+	msg->flags = flags;
 	msg->src = src;
 	msg->dst = dst;
 	msg->reserved = 0;
@@ -767,12 +909,9 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	/* add message to the remote processor's virtqueue */
 	err = virtqueue_add_buf(vrp->svq, &sg, 1, 0, msg, GFP_KERNEL);
 	if (err < 0) {
-		/*
-		 * need to reclaim the buffer here, otherwise it's lost
-		 * (memory won't leak, but rpmsg won't use it again for TX).
-		 * this will wait for a buffer management overhaul.
-		 */
+		/* reclaim the buffer, so it can be used again for TX */
 		dev_err(dev, "virtqueue_add_buf failed: %d\n", err);
+		put_a_tx_buf(vrp, msg);
 		goto out;
 	}
 
@@ -782,31 +921,41 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	err = 0;
 out:
 	mutex_unlock(&vrp->tx_lock);
+put_ept:
+	if (ept)
+		kref_put(&ept->refcount, __ept_release);
 	return err;
 }
+EXPORT_SYMBOL(rpmsg_send_offchannel_flags);
+
+/**
+ * rpmsg_send_offchannel_raw() - send a message across to the remote processor
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @data: payload of message
+ * @len: length of payload
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * Same as rpmsg_send_offchannel_flags(), for messages without flags.
+ */
+int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					void *data, int len, bool wait)
+{
+	return rpmsg_send_offchannel_flags(rpdev, src, dst, data, len, 0, wait);
+}
 EXPORT_SYMBOL(rpmsg_send_offchannel_raw);
 
-/* called when an rx buffer is used, and it's time to digest a message */
-static void rpmsg_recv_done(struct virtqueue *rvq)
+/* digest one inbound message and give its buffer back; rx_lock is held */
+static void rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
+			      struct rpmsg_hdr *msg, unsigned int len)
 {
-	struct rpmsg_hdr *msg;
-	unsigned int len;
 	struct rpmsg_endpoint *ept;
 	struct scatterlist sg;
-	struct virtproc_info *vrp = rvq->vdev->priv;
-	struct device *dev = &rvq->vdev->dev;
 	unsigned long offset = 0;
 	void *sg_addr;
 	int err;
 
-	mutex_lock(&vrp->rx_lock);
-	msg = virtqueue_get_buf(rvq, &len);
-	if (!msg) {
-		mutex_unlock(&vrp->rx_lock);
-		dev_err(dev, "uhm, incoming signal, but no used buffer ?\n");
-		return;
-	}
-
 	dev_dbg(dev, "From: 0x%x, To: 0x%x, Len: %d, Flags: %d, Reserved: %d\n",
 					msg->src, msg->dst, msg->len,
 					msg->flags, msg->reserved);
@@ -821,9 +970,8 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	 */
 	if (len > RPMSG_BUF_SIZE ||
 		msg->len > (len - sizeof(struct rpmsg_hdr))) {
-		mutex_unlock(&vrp->rx_lock);
 		dev_warn(dev, "inbound msg too big: (%d, %d)\n", len, msg->len);
-		return;
+		goto recycle;
 	}
 
 	/* use the dst addr to fetch the callback of the appropriate user */
@@ -852,6 +1000,7 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	} else
 		dev_warn(dev, "msg received with no recepient\n");
 
+recycle:
 	/* use a direct-mapped equivalent virtual address in case of carveout */
 	if (vrp->use_carveout) {
 		offset = ((unsigned long) msg) - ((unsigned long) vrp->rbufs);
@@ -864,15 +1013,61 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 
 	/* add the buffer back to the remote processor's virtqueue */
 	err = virtqueue_add_buf(vrp->rvq, &sg, 0, 1, msg, GFP_KERNEL);
-	if (err < 0) {
-		mutex_unlock(&vrp->rx_lock);
+	if (err < 0)
 		dev_err(dev, "failed to add a virtqueue buffer: %d\n", err);
-		return;
+}
+
+/*
+ * called when rx buffers are used, and it's time to digest messages.
+ *
+ * The rx vring is polled with its callback disabled, so the remote
+ * processor doesn't need to interrupt us for every message of a burst.
+ * Used buffers are handed back in batches of up to RPMSG_RX_BUDGET, with
+ * a single kick each; once a batch is full, other tasks get a chance to
+ * run before polling goes on.
+ */
+static void rpmsg_recv_done(struct virtqueue *rvq)
+{
+	struct rpmsg_hdr *msg;
+	unsigned int len, batch = 0, count = 0;
+	struct virtproc_info *vrp = rvq->vdev->priv;
+	struct device *dev = &rvq->vdev->dev;
+
+	mutex_lock(&vrp->rx_lock);
+	vrp->rx_stats.callbacks++;
+
+	virtqueue_disable_cb(rvq);
+	do {
+		while ((msg = virtqueue_get_buf(rvq, &len))) {
+			rpmsg_recv_single(vrp, dev, msg, len);
+			count++;
+
+			if (++batch < RPMSG_RX_BUDGET)
+				continue;
+
+			/* tell the remote processor about the new rx buffers */
+			virtqueue_kick(rvq);
+			vrp->rx_stats.kicks++;
+			vrp->rx_stats.budget_hits++;
+			batch = 0;
+
+			mutex_unlock(&vrp->rx_lock);
+			cond_resched();
+			mutex_lock(&vrp->rx_lock);
+		}
+		/* poll again if a message slipped in before re-enabling */
+	} while (!virtqueue_enable_cb(rvq));
+
+	if (batch) {
+		virtqueue_kick(rvq);
+		vrp->rx_stats.kicks++;
 	}
+	vrp->rx_stats.msgs += count;
 
-	/* tell the remote processor we added another available rx buffer */
-	virtqueue_kick(vrp->rvq);
 	mutex_unlock(&vrp->rx_lock);
+
+	if (!count)
+		dev_dbg(dev, "uhm, incoming signal, but no used buffer ?\n");
 }
 
 /*
@@ -966,6 +1161,45 @@ static void rpmsg_ns_cb(struct rpmsg_channel *rpdev, void *data, int len,
 	}
 }
 
+static int rpmsg_stats_show(struct seq_file *s, void *data)
+{
+	struct virtproc_info *vrp = s->private;
+	struct rpmsg_rx_stats rx;
+	int free, held, reserved;
+
+	mutex_lock(&vrp->rx_lock);
+	rx = vrp->rx_stats;
+	mutex_unlock(&vrp->rx_lock);
+
+	mutex_lock(&vrp->tx_lock);
+	free = rpmsg_tx_free(vrp);
+	held = vrp->tx_held;
+	reserved = vrp->tx_reserved;
+	mutex_unlock(&vrp->tx_lock);
+
+	seq_printf(s, "rx callbacks:    %lu\n", rx.callbacks);
+	seq_printf(s, "rx messages:     %lu\n", rx.msgs);
+	seq_printf(s, "rx kicks:        %lu\n", rx.kicks);
+	seq_printf(s, "rx budget hits:  %lu\n", rx.budget_hits);
+	seq_printf(s, "tx free:         %d\n", free);
+	seq_printf(s, "tx reserved:     %d\n", reserved);
+	seq_printf(s, "tx held:         %d\n", held);
+
+	return 0;
+}
+
+static int rpmsg_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpmsg_stats_show, inode->i_private);
+}
+
+static const struct file_operations rpmsg_stats_ops = {
+	.open = rpmsg_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int rpmsg_probe(struct virtio_device *vdev)
 {
 	vq_callback_t *vq_cbs[] = { rpmsg_recv_done, rpmsg_xmit_done };
@@ -982,6 +1216,15 @@ static int rpmsg_probe(struct virtio_device *vdev)
 
 	vrp->vdev = vdev;
 
+	vrp->sbuf_free = kcalloc(RPMSG_NUM_BUFS / 2, sizeof(void *),
+				 GFP_KERNEL);
+	vrp->sbuf_owner = kcalloc(RPMSG_NUM_BUFS / 2,
+				  sizeof(struct rpmsg_endpoint *), GFP_KERNEL);
+	if (!vrp->sbuf_free || !vrp->sbuf_owner) {
+		err = -ENOMEM;
+		goto free_vrp;
+	}
+
 	idr_init(&vrp->endpoints);
 	mutex_init(&vrp->endpoints_lock);
 	mutex_init(&vrp->tx_lock);
@@ -1085,6 +1328,14 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	 */
 	/* virtqueue_kick(vrp->rvq); */
 
+	if (rpmsg_dbg) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "vproc%d", vrp->id);
+		vrp->dbg_stats = debugfs_create_file(name, 0400, rpmsg_dbg, vrp,
+							&rpmsg_stats_ops);
+	}
+
 	dev_info(&vdev->dev, "rpmsg host is online\n");
 
 	return 0;
@@ -1105,6 +1356,8 @@ rem_idr:
 	idr_remove(&vprocs, vproc_id);
 	mutex_unlock(&vprocs_mutex);
 free_vrp:
+	kfree(vrp->sbuf_owner);
+	kfree(vrp->sbuf_free);
 	kfree(vrp);
 	return err;
 }
@@ -1119,11 +1372,13 @@ static int rpmsg_remove_device(struct device *dev, void *data)
 static void __devexit rpmsg_remove(struct virtio_device *vdev)
 {
 	struct virtproc_info *vrp = vdev->priv;
-	int ret;
+	int ret, i;
 	unsigned int bufs[2];
 
 	vdev->config->reset(vdev);
 
+	debugfs_remove(vrp->dbg_stats);
+
 	ret = device_for_each_child(&vdev->dev, NULL, rpmsg_remove_device);
 	if (ret)
 		dev_warn(&vdev->dev, "can't remove rpmsg device: %d\n", ret);
@@ -1151,6 +1406,13 @@ static void __devexit rpmsg_remove(struct virtio_device *vdev)
 	idr_remove(&vprocs, vrp->id);
 	mutex_unlock(&vprocs_mutex);
 
+	/* drop the references held by tx buffers that were still in flight */
+	for (i = 0; i < RPMSG_NUM_BUFS / 2; i++)
+		if (vrp->sbuf_owner[i])
+			kref_put(&vrp->sbuf_owner[i]->refcount, __ept_release);
+
+	kfree(vrp->sbuf_owner);
+	kfree(vrp->sbuf_free);
 	kfree(vrp);
 }
 
@@ -1179,9 +1441,13 @@ static int __init rpmsg_init(void)
 
 	idr_init(&vprocs);
 
+	if (debugfs_initialized())
+		rpmsg_dbg = debugfs_create_dir(KBUILD_MODNAME, NULL);
+
 	ret = bus_register(&rpmsg_bus);
 	if (ret) {
 		pr_err("failed to register rpmsg bus: %d\n", ret);
+		debugfs_remove(rpmsg_dbg);
 		return ret;
 	}
 
@@ -1189,6 +1455,7 @@ static int __init rpmsg_init(void)
 	if (ret) {
 		pr_err("failed to register virtio driver: %d\n", ret);
 		bus_unregister(&rpmsg_bus);
+		debugfs_remove(rpmsg_dbg);
 	}
 
 	return ret;
@@ -1202,6 +1469,8 @@ static void __exit rpmsg_fini(void)
 
 	idr_remove_all(&vprocs);
 	idr_destroy(&vprocs);
+
+	debugfs_remove(rpmsg_dbg);
 }
 module_exit(rpmsg_fini);
 
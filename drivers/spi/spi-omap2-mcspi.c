@@ -36,6 +36,10 @@
 #include <linux/pm_runtime.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/spi/spi.h>
 
@@ -119,11 +123,15 @@ struct omap2_mcspi_regs {
 	struct list_head cs;
 };
 
+struct omap2_mcspi_stats {
+	unsigned long		messages;
+	unsigned long		transfers;
+	unsigned long		dma_transfers;
+	u64			bytes;
+	u64			busy_ns;
+};
+
 struct omap2_mcspi {
-	struct work_struct	work;
-	/* lock protects queue and registers */
-	spinlock_t		lock;
-	struct list_head	msg_queue;
 	struct spi_master	*master;
 	/* Virtual base address of the controller */
 	void __iomem		*base;
@@ -131,8 +139,10 @@ struct omap2_mcspi {
 	/* SPI1 has 4 channels, while SPI2 has 2 */
 	struct omap2_mcspi_dma	*dma_channels;
 	struct device		*dev;
-	struct workqueue_struct *wq;
 	struct omap2_mcspi_regs ctx;
+	bool			(*context_lost)(struct device *dev);
+	struct omap2_mcspi_stats stats;
+	struct dentry		*debugfs;
 };
 
 struct omap2_mcspi_cs {
@@ -289,7 +299,8 @@ static int mcspi_wait_for_reg_bit(void __iomem *reg, unsigned long bit)
 }
 
 static unsigned
-omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
+omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer,
+		     bool mapped)
 {
 	struct omap2_mcspi	*mcspi;
 	struct omap2_mcspi_cs	*cs = spi->controller_state;
@@ -331,6 +342,17 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 	}
 
 	if (tx != NULL) {
+		/*
+		 * RX completes after the last word is shifted in, hence after
+		 * TX: a full duplex transfer only needs the RX interrupt.
+		 */
+		if (rx != NULL)
+			omap_disable_dma_irq(mcspi_dma->dma_tx_channel,
+					     OMAP_DMA_BLOCK_IRQ);
+		else
+			omap_enable_dma_irq(mcspi_dma->dma_tx_channel,
+					    OMAP_DMA_BLOCK_IRQ);
+
 		omap_set_dma_transfer_params(mcspi_dma->dma_tx_channel,
 				data_type, element_count, 1,
 				OMAP_DMA_SYNC_ELEMENT,
@@ -374,24 +396,33 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 		omap2_mcspi_set_dma_req(spi, 1, 1);
 	}
 
-	if (tx != NULL) {
+	if (tx != NULL && rx == NULL) {
 		wait_for_completion(&mcspi_dma->dma_tx_completion);
-		dma_unmap_single(&spi->dev, xfer->tx_dma, count, DMA_TO_DEVICE);
+		if (!mapped)
+			dma_unmap_single(&spi->dev, xfer->tx_dma, count,
+					 DMA_TO_DEVICE);
 
 		/* for TX_ONLY mode, be sure all words have shifted out */
-		if (rx == NULL) {
-			if (mcspi_wait_for_reg_bit(chstat_reg,
-						OMAP2_MCSPI_CHSTAT_TXS) < 0)
-				dev_err(&spi->dev, "TXS timed out\n");
-			else if (mcspi_wait_for_reg_bit(chstat_reg,
-						OMAP2_MCSPI_CHSTAT_EOT) < 0)
-				dev_err(&spi->dev, "EOT timed out\n");
-		}
+		if (mcspi_wait_for_reg_bit(chstat_reg,
+					OMAP2_MCSPI_CHSTAT_TXS) < 0)
+			dev_err(&spi->dev, "TXS timed out\n");
+		else if (mcspi_wait_for_reg_bit(chstat_reg,
+					OMAP2_MCSPI_CHSTAT_EOT) < 0)
+			dev_err(&spi->dev, "EOT timed out\n");
 	}
 
 	if (rx != NULL) {
 		wait_for_completion(&mcspi_dma->dma_rx_completion);
-		dma_unmap_single(&spi->dev, xfer->rx_dma, count, DMA_FROM_DEVICE);
+		if (tx != NULL) {
+			/* done in the TX callback otherwise */
+			omap2_mcspi_set_dma_req(spi, 0, 0);
+			if (!mapped)
+				dma_unmap_single(&spi->dev, xfer->tx_dma,
+						 count, DMA_TO_DEVICE);
+		}
+		if (!mapped)
+			dma_unmap_single(&spi->dev, xfer->rx_dma, count,
+					 DMA_FROM_DEVICE);
 		omap2_mcspi_set_enable(spi, 0);
 
 		if (l & OMAP2_MCSPI_CHCONF_TURBO) {
@@ -846,144 +877,120 @@ static void omap2_mcspi_cleanup(struct spi_device *spi)
 	}
 }
 
-static void omap2_mcspi_work(struct work_struct *work)
+/*
+ * We only enable one channel at a time -- the one whose message is at the
+ * head of the queue -- although this controller would gladly arbitrate
+ * among multiple channels.  This corresponds to "single channel" master
+ * mode.  As a side effect, we need to manage the chipselect with the FORCE
+ * bit ... CS != channel enable.
+ */
+static int omap2_mcspi_work(struct omap2_mcspi *mcspi, struct spi_message *m)
 {
-	struct omap2_mcspi	*mcspi;
+	struct spi_device		*spi;
+	struct spi_transfer		*t = NULL;
+	int				cs_active = 0;
+	struct omap2_mcspi_cs		*cs;
+	struct omap2_mcspi_device_config *cd;
+	int				par_override = 0;
+	int				status = 0;
+	u32				chconf;
+
+	spi = m->spi;
+	cs = spi->controller_state;
+	cd = spi->controller_data;
 
-	mcspi = container_of(work, struct omap2_mcspi, work);
-
-	if (omap2_mcspi_enable_clocks(mcspi) < 0)
-		return;
-
-	spin_lock_irq(&mcspi->lock);
-
-	/* We only enable one channel at a time -- the one whose message is
-	 * at the head of the queue -- although this controller would gladly
-	 * arbitrate among multiple channels.  This corresponds to "single
-	 * channel" master mode.  As a side effect, we need to manage the
-	 * chipselect with the FORCE bit ... CS != channel enable.
-	 */
-	while (!list_empty(&mcspi->msg_queue)) {
-		struct spi_message		*m;
-		struct spi_device		*spi;
-		struct spi_transfer		*t = NULL;
-		int				cs_active = 0;
-		struct omap2_mcspi_cs		*cs;
-		struct omap2_mcspi_device_config *cd;
-		int				par_override = 0;
-		int				status = 0;
-		u32				chconf;
-
-		m = container_of(mcspi->msg_queue.next, struct spi_message,
-				 queue);
-
-		list_del_init(&m->queue);
-		spin_unlock_irq(&mcspi->lock);
-
-		spi = m->spi;
-		cs = spi->controller_state;
-		cd = spi->controller_data;
-
-		omap2_mcspi_set_enable(spi, 1);
-		list_for_each_entry(t, &m->transfers, transfer_list) {
-			if (t->tx_buf == NULL && t->rx_buf == NULL && t->len) {
-				status = -EINVAL;
+	omap2_mcspi_set_enable(spi, 1);
+	list_for_each_entry(t, &m->transfers, transfer_list) {
+		if (t->tx_buf == NULL && t->rx_buf == NULL && t->len) {
+			status = -EINVAL;
+			break;
+		}
+		if (par_override || t->speed_hz || t->bits_per_word) {
+			par_override = 1;
+			status = omap2_mcspi_setup_transfer(spi, t);
+			if (status < 0)
 				break;
-			}
-			if (par_override || t->speed_hz || t->bits_per_word) {
-				par_override = 1;
-				status = omap2_mcspi_setup_transfer(spi, t);
-				if (status < 0)
-					break;
-				if (!t->speed_hz && !t->bits_per_word)
-					par_override = 0;
-			}
+			if (!t->speed_hz && !t->bits_per_word)
+				par_override = 0;
+		}
 
-			if (!cs_active) {
-				omap2_mcspi_force_cs(spi, 1);
-				cs_active = 1;
-			}
+		if (!cs_active) {
+			omap2_mcspi_force_cs(spi, 1);
+			cs_active = 1;
+		}
 
-			chconf = mcspi_cached_chconf0(spi);
-			chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
-			chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
+		chconf = mcspi_cached_chconf0(spi);
+		chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
+		chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
 
-			if (t->tx_buf == NULL)
-				chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
-			else if (t->rx_buf == NULL)
-				chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
-
-			if (cd && cd->turbo_mode && t->tx_buf == NULL) {
-				/* Turbo mode is for more than one word */
-				if (t->len > ((cs->word_len + 7) >> 3))
-					chconf |= OMAP2_MCSPI_CHCONF_TURBO;
-			}
+		if (t->tx_buf == NULL)
+			chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
+		else if (t->rx_buf == NULL)
+			chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
 
-			mcspi_write_chconf0(spi, chconf);
+		if (cd && cd->turbo_mode && t->tx_buf == NULL) {
+			/* Turbo mode is for more than one word */
+			if (t->len > ((cs->word_len + 7) >> 3))
+				chconf |= OMAP2_MCSPI_CHCONF_TURBO;
+		}
 
-			if (t->len) {
-				unsigned	count;
+		mcspi_write_chconf0(spi, chconf);
 
-				/* RX_ONLY mode needs dummy data in TX reg */
-				if (t->tx_buf == NULL)
-					__raw_writel(0, cs->base
-							+ OMAP2_MCSPI_TX0);
+		if (t->len) {
+			unsigned	count;
 
-				if (m->is_dma_mapped || t->len >= DMA_MIN_BYTES)
-					count = omap2_mcspi_txrx_dma(spi, t);
-				else
-					count = omap2_mcspi_txrx_pio(spi, t);
-				m->actual_length += count;
+			/* RX_ONLY mode needs dummy data in TX reg */
+			if (t->tx_buf == NULL)
+				__raw_writel(0, cs->base
+						+ OMAP2_MCSPI_TX0);
 
-				if (count != t->len) {
-					status = -EIO;
-					break;
-				}
+			if (m->is_dma_mapped || t->len >= DMA_MIN_BYTES) {
+				count = omap2_mcspi_txrx_dma(spi, t,
+							     m->is_dma_mapped);
+				mcspi->stats.dma_transfers++;
+			} else {
+				count = omap2_mcspi_txrx_pio(spi, t);
 			}
+			m->actual_length += count;
+			mcspi->stats.transfers++;
 
-			if (t->delay_usecs)
-				udelay(t->delay_usecs);
-
-			/* ignore the "leave it on after last xfer" hint */
-			if (t->cs_change) {
-				omap2_mcspi_force_cs(spi, 0);
-				cs_active = 0;
+			if (count != t->len) {
+				status = -EIO;
+				break;
 			}
 		}
 
-		/* Restore defaults if they were overriden */
-		if (par_override) {
-			par_override = 0;
-			status = omap2_mcspi_setup_transfer(spi, NULL);
-		}
+		if (t->delay_usecs)
+			udelay(t->delay_usecs);
 
-		if (cs_active)
+		/* ignore the "leave it on after last xfer" hint */
+		if (t->cs_change) {
 			omap2_mcspi_force_cs(spi, 0);
+			cs_active = 0;
+		}
+	}
 
-		omap2_mcspi_set_enable(spi, 0);
-
-		m->status = status;
-		m->complete(m->context);
-
-		spin_lock_irq(&mcspi->lock);
+	/* Restore defaults if they were overriden */
+	if (par_override) {
+		par_override = 0;
+		status = omap2_mcspi_setup_transfer(spi, NULL);
 	}
 
-	spin_unlock_irq(&mcspi->lock);
+	if (cs_active)
+		omap2_mcspi_force_cs(spi, 0);
 
-	omap2_mcspi_disable_clocks(mcspi);
+	omap2_mcspi_set_enable(spi, 0);
+
+	return status;
 }
 
-static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
+static int omap2_mcspi_check_message(struct spi_message *m)
 {
-	struct omap2_mcspi	*mcspi;
-	unsigned long		flags;
+	struct spi_device	*spi = m->spi;
 	struct spi_transfer	*t;
 
-	m->actual_length = 0;
-	m->status = 0;
-
 	/* reject invalid messages and transfers */
-	if (list_empty(&m->transfers) || !m->complete)
+	if (list_empty(&m->transfers))
 		return -EINVAL;
 	list_for_each_entry(t, &m->transfers, transfer_list) {
 		const void	*tx_buf = t->tx_buf;
@@ -1036,16 +1043,111 @@ static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
 		}
 	}
 
-	mcspi = spi_master_get_devdata(spi->master);
+	return 0;
+}
+
+/*
+ * The SPI core pumps the messages from its own queue and keeps the
+ * controller awake between prepare and unprepare, while messages
+ * keep coming.
+ */
+static int omap2_mcspi_transfer_one_message(struct spi_master *master,
+					    struct spi_message *m)
+{
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
+	ktime_t			start;
+	int			status;
+
+	m->actual_length = 0;
+	status = omap2_mcspi_check_message(m);
+	if (!status) {
+		start = ktime_get();
+		status = omap2_mcspi_work(mcspi, m);
+
+		mcspi->stats.messages++;
+		mcspi->stats.bytes += m->actual_length;
+		mcspi->stats.busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							      start));
+	}
+
+	m->status = status;
+	spi_finalize_current_message(master);
+
+	return 0;
+}
+
+static int omap2_mcspi_prepare_transfer(struct spi_master *master)
+{
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(master);
+	int ret;
+
+	ret = omap2_mcspi_enable_clocks(mcspi);
+	return ret < 0 ? ret : 0;
+}
+
+static int omap2_mcspi_unprepare_transfer(struct spi_master *master)
+{
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(master);
+
+	omap2_mcspi_disable_clocks(mcspi);
+	return 0;
+}
 
-	spin_lock_irqsave(&mcspi->lock, flags);
-	list_add_tail(&m->queue, &mcspi->msg_queue);
-	queue_work(mcspi->wq, &mcspi->work);
-	spin_unlock_irqrestore(&mcspi->lock, flags);
+#ifdef CONFIG_DEBUG_FS
+static int omap2_mcspi_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap2_mcspi *mcspi = s->private;
+	struct omap2_mcspi_stats st = mcspi->stats;
+	u64 busy_ms = div_u64(st.busy_ns, NSEC_PER_MSEC);
+
+	seq_printf(s, "messages %lu\n"
+		   "transfers %lu\n"
+		   "dma_transfers %lu\n"
+		   "bytes %llu\n"
+		   "busy_ms %llu\n"
+		   "throughput_kBps %llu\n",
+		   st.messages, st.transfers, st.dma_transfers, st.bytes,
+		   busy_ms, busy_ms ? div64_u64(st.bytes, busy_ms) : 0);
 
 	return 0;
 }
 
+static int omap2_mcspi_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap2_mcspi_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap2_mcspi_stats_fops = {
+	.open = omap2_mcspi_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *omap2_mcspi_debugfs_root;
+
+static void omap2_mcspi_debugfs_init(struct omap2_mcspi *mcspi)
+{
+	if (!omap2_mcspi_debugfs_root)
+		omap2_mcspi_debugfs_root = debugfs_create_dir("omap2_mcspi",
+							      NULL);
+	if (IS_ERR_OR_NULL(omap2_mcspi_debugfs_root))
+		return;
+
+	mcspi->debugfs = debugfs_create_file(dev_name(mcspi->dev), S_IRUGO,
+					     omap2_mcspi_debugfs_root, mcspi,
+					     &omap2_mcspi_stats_fops);
+}
+
+static void omap2_mcspi_debugfs_exit(struct omap2_mcspi *mcspi)
+{
+	debugfs_remove(mcspi->debugfs);
+}
+#else
+static inline void omap2_mcspi_debugfs_init(struct omap2_mcspi *mcspi) { }
+static inline void omap2_mcspi_debugfs_exit(struct omap2_mcspi *mcspi) { }
+#endif
+
 static int __devinit omap2_mcspi_master_setup(struct omap2_mcspi *mcspi)
 {
 	struct spi_master	*master = mcspi->master;
@@ -1072,7 +1174,8 @@ static int omap_mcspi_runtime_resume(struct device *dev)
 
 	master = dev_get_drvdata(dev);
 	mcspi = spi_master_get_devdata(master);
-	omap2_mcspi_restore_ctx(mcspi);
+	if (!mcspi->context_lost || mcspi->context_lost(dev))
+		omap2_mcspi_restore_ctx(mcspi);
 
 	return 0;
 }
@@ -1120,7 +1223,9 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	master->mode_bits = SPI_CPOL | SPI_CPHA | SPI_CS_HIGH;
 
 	master->setup = omap2_mcspi_setup;
-	master->transfer = omap2_mcspi_transfer;
+	master->prepare_transfer_hardware = omap2_mcspi_prepare_transfer;
+	master->transfer_one_message = omap2_mcspi_transfer_one_message;
+	master->unprepare_transfer_hardware = omap2_mcspi_unprepare_transfer;
 	master->cleanup = omap2_mcspi_cleanup;
 	master->dev.of_node = node;
 
@@ -1132,9 +1237,11 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 		of_property_read_u32(node, "ti,spi-num-cs", &num_cs);
 		master->num_chipselect = num_cs;
 		master->bus_num = bus_num++;
+		master->rt = !!of_find_property(node, "ti,spi-rt", NULL);
 	} else {
 		pdata = pdev->dev.platform_data;
 		master->num_chipselect = pdata->num_cs;
+		master->rt = pdata->rt;
 		if (pdev->id != -1)
 			master->bus_num = pdev->id;
 	}
@@ -1144,12 +1251,7 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 
 	mcspi = spi_master_get_devdata(master);
 	mcspi->master = master;
-
-	mcspi->wq = alloc_workqueue(dev_name(&pdev->dev), WQ_MEM_RECLAIM, 1);
-	if (mcspi->wq == NULL) {
-		status = -ENOMEM;
-		goto free_master;
-	}
+	mcspi->context_lost = pdata->context_lost;
 
 	r = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (r == NULL) {
@@ -1169,10 +1271,7 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	}
 
 	mcspi->dev = &pdev->dev;
-	INIT_WORK(&mcspi->work, omap2_mcspi_work);
 
-	spin_lock_init(&mcspi->lock);
-	INIT_LIST_HEAD(&mcspi->msg_queue);
 	INIT_LIST_HEAD(&mcspi->ctx.cs);
 
 	mcspi->dma_channels = kcalloc(master->num_chipselect,
@@ -1225,6 +1324,8 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	if (status < 0)
 		goto err_spi_register;
 
+	omap2_mcspi_debugfs_init(mcspi);
+
 	return status;
 
 err_spi_register:
@@ -1249,12 +1350,12 @@ static int __devexit omap2_mcspi_remove(struct platform_device *pdev)
 	mcspi = spi_master_get_devdata(master);
 	dma_channels = mcspi->dma_channels;
 
+	omap2_mcspi_debugfs_exit(mcspi);
 	omap2_mcspi_disable_clocks(mcspi);
 	pm_runtime_disable(&pdev->dev);
 
 	spi_unregister_master(master);
 	kfree(dma_channels);
-	destroy_workqueue(mcspi->wq);
 	platform_set_drvdata(pdev, NULL);
 
 	return 0;
@@ -31,6 +31,9 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/compat.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/dma-mapping.h>
 
 #include <linux/spi/spi.h>
 #include <linux/spi/spidev.h>
@@ -83,6 +86,12 @@ struct spidev_data {
 	struct mutex		buf_lock;
 	unsigned		users;
 	u8			*buffer;
+
+	/* optional DMA coherent buffer, mmap()ed by userspace */
+	struct device		*map_dev;
+	void			*map;
+	dma_addr_t		map_dma;
+	size_t			map_size;
 };
 
 static LIST_HEAD(device_list);
@@ -213,6 +222,95 @@ spidev_write(struct file *filp, const char __user *buf,
 	return status;
 }
 
+static const struct vm_operations_struct spidev_vm_ops;
+
+/*
+ * Return the offset of a user buffer in the mmap()ed DMA buffer, or
+ * -EFAULT if it is not entirely inside one of its mappings.  Called
+ * with mmap_sem held.
+ */
+static long spidev_map_offset(struct spidev_data *spidev, u64 addr, u32 len)
+{
+	struct vm_area_struct	*vma;
+	unsigned long		offset;
+
+	vma = find_vma(current->mm, addr);
+	if (!vma || vma->vm_ops != &spidev_vm_ops ||
+	    vma->vm_private_data != spidev || addr < vma->vm_start ||
+	    addr + len > vma->vm_end)
+		return -EFAULT;
+
+	offset = addr - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+	if (offset + len > spidev->map_size)
+		return -EFAULT;
+
+	return offset;
+}
+
+/*
+ * Messages whose buffers all live in the mmap()ed area are handed to the
+ * controller as they are, already DMA mapped, without bounce buffering.
+ * Returns -EFAULT if any of them doesn't, so that the caller copies.
+ */
+static int spidev_message_mapped(struct spidev_data *spidev,
+		struct spi_message *msg, struct spi_transfer *k_xfers,
+		struct spi_ioc_transfer *u_xfers, unsigned n_xfers)
+{
+	struct spi_transfer	*k_tmp;
+	struct spi_ioc_transfer *u_tmp;
+	unsigned		n;
+	long			offset;
+	int			status = 0;
+
+	if (!spidev->map)
+		return -EFAULT;
+
+	down_read(&current->mm->mmap_sem);
+	for (n = n_xfers, k_tmp = k_xfers, u_tmp = u_xfers;
+			n;
+			n--, k_tmp++, u_tmp++) {
+		k_tmp->len = u_tmp->len;
+
+		if (u_tmp->rx_buf) {
+			offset = spidev_map_offset(spidev, u_tmp->rx_buf,
+						   u_tmp->len);
+			if (offset < 0) {
+				status = offset;
+				break;
+			}
+			k_tmp->rx_buf = spidev->map + offset;
+			k_tmp->rx_dma = spidev->map_dma + offset;
+		}
+		if (u_tmp->tx_buf) {
+			offset = spidev_map_offset(spidev, u_tmp->tx_buf,
+						   u_tmp->len);
+			if (offset < 0) {
+				status = offset;
+				break;
+			}
+			k_tmp->tx_buf = spidev->map + offset;
+			k_tmp->tx_dma = spidev->map_dma + offset;
+		}
+
+		k_tmp->cs_change = !!u_tmp->cs_change;
+		k_tmp->bits_per_word = u_tmp->bits_per_word;
+		k_tmp->delay_usecs = u_tmp->delay_usecs;
+		k_tmp->speed_hz = u_tmp->speed_hz;
+		spi_message_add_tail(k_tmp, msg);
+	}
+	up_read(&current->mm->mmap_sem);
+
+	if (status < 0) {
+		/* start over in the bounce buffer */
+		memset(k_xfers, 0, n_xfers * sizeof(*k_xfers));
+		spi_message_init(msg);
+		return status;
+	}
+
+	msg->is_dma_mapped = 1;
+	return spidev_sync(spidev, msg);
+}
+
 static int spidev_message(struct spidev_data *spidev,
 		struct spi_ioc_transfer *u_xfers, unsigned n_xfers)
 {
@@ -229,6 +327,12 @@ static int spidev_message(struct spidev_data *spidev,
 	if (k_xfers == NULL)
 		return -ENOMEM;
 
+	status = spidev_message_mapped(spidev, &msg, k_xfers, u_xfers,
+				       n_xfers);
+	if (status != -EFAULT)
+		goto done;
+	status = -EFAULT;
+
 	/* Construct spi_message, copying any tx data to bounce buffer.
 	 * We walk the array of user-provided transfers, using each one
 	 * to initialize a kernel version of the same transfer.
@@ -532,6 +636,12 @@ static int spidev_release(struct inode *inode, struct file *filp)
 		kfree(spidev->buffer);
 		spidev->buffer = NULL;
 
+		if (spidev->map) {
+			dma_free_coherent(spidev->map_dev, spidev->map_size,
+					  spidev->map, spidev->map_dma);
+			spidev->map = NULL;
+		}
+
 		/* ... after we unbound from the underlying device? */
 		spin_lock_irq(&spidev->spi_lock);
 		dofree = (spidev->spi == NULL);
@@ -545,6 +655,54 @@ static int spidev_release(struct inode *inode, struct file *filp)
 	return status;
 }
 
+static const struct vm_operations_struct spidev_vm_ops = {
+};
+
+/*
+ * Map a DMA coherent buffer of bufsiz bytes, shared by all openers of the
+ * device.  Messages whose buffers are in the mapping skip the copies.
+ */
+static int spidev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct spidev_data	*spidev = filp->private_data;
+	size_t			size = PAGE_ALIGN(bufsiz);
+	unsigned long		len = vma->vm_end - vma->vm_start;
+	struct device		*dev = NULL;
+	int			status;
+
+	if ((vma->vm_pgoff << PAGE_SHIFT) + len > size)
+		return -EINVAL;
+
+	mutex_lock(&spidev->buf_lock);
+	if (!spidev->map) {
+		spin_lock_irq(&spidev->spi_lock);
+		if (spidev->spi)
+			dev = spidev->spi->master->dev.parent;
+		spin_unlock_irq(&spidev->spi_lock);
+		if (!dev) {
+			status = -ESHUTDOWN;
+			goto out;
+		}
+
+		spidev->map = dma_alloc_coherent(dev, size, &spidev->map_dma,
+						 GFP_KERNEL);
+		if (!spidev->map) {
+			status = -ENOMEM;
+			goto out;
+		}
+		spidev->map_dev = dev;
+		spidev->map_size = size;
+	}
+
+	vma->vm_ops = &spidev_vm_ops;
+	vma->vm_private_data = spidev;
+	status = dma_mmap_coherent(spidev->map_dev, vma, spidev->map,
+				   spidev->map_dma, spidev->map_size);
+out:
+	mutex_unlock(&spidev->buf_lock);
+	return status;
+}
+
 static const struct file_operations spidev_fops = {
 	.owner =	THIS_MODULE,
 	/* REVISIT switch to aio primitives, so that userspace
@@ -557,6 +715,7 @@ static const struct file_operations spidev_fops = {
 	.compat_ioctl = spidev_compat_ioctl,
 	.open =		spidev_open,
 	.release =	spidev_release,
+	.mmap =		spidev_mmap,
 	.llseek =	no_llseek,
 };
 
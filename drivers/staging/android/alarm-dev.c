@@ -24,6 +24,8 @@
 #include <linux/uaccess.h>
 #include <linux/alarmtimer.h>
 #include <linux/wakelock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "android_alarm.h"
 
 #define ANDROID_ALARM_PRINT_INFO (1U << 0)
@@ -62,9 +64,16 @@ struct devalarm {
 		struct alarm alrm;
 	} u;
 	enum android_alarm_type type;
+	ktime_t exp;		/* requested, on the alarm's own clock */
+	ktime_t slack;		/* how late it may go off */
+	uint32_t group;		/* alarms of a group go off together */
+	unsigned int fired;
+	unsigned int merged;	/* fired with an earlier alarm of its group */
 };
 
 static struct devalarm alarms[ANDROID_ALARM_TYPE_COUNT];
+static uint32_t alarm_group_seq;
+static uint32_t alarm_fired_group;
 
 
 static int is_wakeup(enum android_alarm_type type)
@@ -85,6 +94,72 @@ static void devalarm_start(struct devalarm *alrm, ktime_t exp)
 }
 
 
+static ktime_t devalarm_now(enum android_alarm_type type)
+{
+	switch (type) {
+	case ANDROID_ALARM_RTC_WAKEUP:
+	case ANDROID_ALARM_RTC:
+		return ktime_get_real();
+	case ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP:
+	case ANDROID_ALARM_ELAPSED_REALTIME:
+		return ktime_get_boottime();
+	default:
+		return ktime_get();
+	}
+}
+
+/*
+ * Group the enabled alarms so that each group goes off at one point that
+ * lies in the window of every member, and start the timers accordingly.
+ * Windows are compared on the boottime clock.  Taking the window that ends
+ * first, every alarm whose window has begun by then joins it and the group
+ * goes off when the last of them begins; repeat for the rest.  An alarm
+ * without slack only groups with windows covering its exact time.
+ * Called with alarm_slock held.
+ */
+static void devalarm_plan(void)
+{
+	ktime_t start[ANDROID_ALARM_TYPE_COUNT], end[ANDROID_ALARM_TYPE_COUNT];
+	ktime_t now[ANDROID_ALARM_TYPE_COUNT], boot = ktime_get_boottime();
+	uint32_t todo = alarm_enabled & ((1U << ANDROID_ALARM_TYPE_COUNT) - 1);
+	ktime_t fire;
+	int i, first;
+
+	for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+		if (!(todo & (1U << i)))
+			continue;
+		now[i] = devalarm_now(i);
+		start[i] = ktime_add(ktime_sub(alarms[i].exp, now[i]), boot);
+		end[i] = ktime_add(start[i], alarms[i].slack);
+	}
+
+	while (todo) {
+		first = -1;
+		for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++)
+			if ((todo & (1U << i)) &&
+			    (first < 0 || end[i].tv64 < end[first].tv64))
+				first = i;
+
+		fire = start[first];
+		for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++)
+			if ((todo & (1U << i)) &&
+			    start[i].tv64 <= end[first].tv64 &&
+			    start[i].tv64 > fire.tv64)
+				fire = start[i];
+
+		alarm_group_seq++;
+		for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+			if (!(todo & (1U << i)) ||
+			    start[i].tv64 > end[first].tv64)
+				continue;
+			todo &= ~(1U << i);
+			alarms[i].group = alarm_group_seq;
+			devalarm_start(&alarms[i],
+				ktime_add(ktime_sub(fire, boot), now[i]));
+		}
+	}
+}
+
 static int devalarm_try_to_cancel(struct devalarm *alrm)
 {
 	int ret;
@@ -109,6 +184,8 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	int rv = 0;
 	unsigned long flags;
 	struct timespec new_alarm_time;
+	struct android_alarm_window new_alarm_window;
+	ktime_t slack;
 	struct timespec new_rtc_time;
 	struct timespec tmp_time;
 	struct rtc_time new_rtc_tm;
@@ -146,9 +223,25 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				wake_unlock(&alarm_wake_lock);
 		}
 		alarm_enabled &= ~alarm_type_mask;
+		/* the rest may no longer have to wait for this one */
+		devalarm_plan();
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
 
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&new_alarm_window, (void __user *)arg,
+		    sizeof(new_alarm_window))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (!timespec_valid(&new_alarm_window.slack)) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		new_alarm_time = new_alarm_window.time;
+		slack = timespec_to_ktime(new_alarm_window.slack);
+		goto from_alarm_window_set;
+
 	case ANDROID_ALARM_SET_OLD:
 	case ANDROID_ALARM_SET_AND_WAIT_OLD:
 		if (get_user(new_alarm_time.tv_sec, (int __user *)arg)) {
@@ -166,12 +259,16 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto err1;
 		}
 from_old_alarm_set:
+		slack = ktime_set(0, 0);
+from_alarm_window_set:
 		spin_lock_irqsave(&alarm_slock, flags);
-		pr_alarm(IO, "alarm %d set %ld.%09ld\n", alarm_type,
-			new_alarm_time.tv_sec, new_alarm_time.tv_nsec);
+		pr_alarm(IO, "alarm %d set %ld.%09ld slack %lld\n", alarm_type,
+			new_alarm_time.tv_sec, new_alarm_time.tv_nsec,
+			ktime_to_ns(slack));
 		alarm_enabled |= alarm_type_mask;
-		devalarm_start(&alarms[alarm_type],
-			timespec_to_ktime(new_alarm_time));
+		alarms[alarm_type].exp = timespec_to_ktime(new_alarm_time);
+		alarms[alarm_type].slack = slack;
+		devalarm_plan();
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		if (ANDROID_ALARM_BASE_CMD(cmd) != ANDROID_ALARM_SET_AND_WAIT(0)
 		    && cmd != ANDROID_ALARM_SET_AND_WAIT_OLD)
@@ -208,6 +305,8 @@ from_old_alarm_set:
 		if (rtc_dev)
 			rv = rtc_set_time(rtc_dev, &new_rtc_tm);
 		spin_lock_irqsave(&alarm_slock, flags);
+		/* realtime windows moved against the boottime ones */
+		devalarm_plan();
 		alarm_pending |= ANDROID_ALARM_TIME_CHANGE_MASK;
 		wake_up(&alarm_wait_queue);
 		spin_unlock_irqrestore(&alarm_slock, flags);
@@ -291,6 +390,10 @@ static void devalarm_triggered(struct devalarm *alarm)
 	pr_alarm(INT, "devalarm_triggered type %d\n", alarm->type);
 	spin_lock_irqsave(&alarm_slock, flags);
 	if (alarm_enabled & alarm_type_mask) {
+		alarm->fired++;
+		if (alarm->group == alarm_fired_group)
+			alarm->merged++;
+		alarm_fired_group = alarm->group;
 		wake_lock_timeout(&alarm_wake_lock, 5 * HZ);
 		alarm_enabled &= ~alarm_type_mask;
 		alarm_pending |= alarm_type_mask;
@@ -318,6 +421,49 @@ static enum alarmtimer_restart devalarm_alarmhandler(struct alarm *alrm,
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+static const char * const devalarm_names[ANDROID_ALARM_TYPE_COUNT] = {
+	[ANDROID_ALARM_RTC_WAKEUP] = "rtc_wakeup",
+	[ANDROID_ALARM_RTC] = "rtc",
+	[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP] = "elapsed_wakeup",
+	[ANDROID_ALARM_ELAPSED_REALTIME] = "elapsed",
+	[ANDROID_ALARM_SYSTEMTIME] = "systemtime",
+};
+
+/* wakeups counts what actually went off: fired less the merged ones */
+static struct dentry *alarm_stats_dentry;
+
+static int alarm_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long flags;
+	int i;
+
+	seq_printf(m, "type            enabled    fired   merged  wakeups"
+		   "     slack_ms\n");
+	spin_lock_irqsave(&alarm_slock, flags);
+	for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++)
+		seq_printf(m, "%-15s %7d %8u %8u %8u %12lld\n",
+			   devalarm_names[i], !!(alarm_enabled & (1U << i)),
+			   alarms[i].fired, alarms[i].merged,
+			   alarms[i].fired - alarms[i].merged,
+			   ktime_to_ns(alarms[i].slack) / NSEC_PER_MSEC);
+	spin_unlock_irqrestore(&alarm_slock, flags);
+	return 0;
+}
+
+static int alarm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alarm_stats_show, NULL);
+}
+
+static const struct file_operations alarm_stats_fops = {
+	.open = alarm_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static const struct file_operations alarm_fops = {
 	.owner = THIS_MODULE,
 	.unlocked_ioctl = alarm_ioctl,
@@ -359,11 +505,18 @@ static int __init alarm_dev_init(void)
 
 	wake_lock_init(&alarm_wake_lock, WAKE_LOCK_SUSPEND, "alarm");
 
+#ifdef CONFIG_DEBUG_FS
+	alarm_stats_dentry = debugfs_create_file("alarm_stats", S_IRUGO, NULL,
+						 NULL, &alarm_stats_fops);
+#endif
 	return 0;
 }
 
 static void  __exit alarm_dev_exit(void)
 {
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(alarm_stats_dentry);
+#endif
 	misc_deregister(&alarm_device);
 	wake_lock_destroy(&alarm_wake_lock);
 }
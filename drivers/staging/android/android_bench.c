@@ -0,0 +1,371 @@
+/*
+ * drivers/staging/android/android_bench.c
+ *
+ * Microbenchmarks for kernel paths that userspace cannot time directly.
+ *
+ * Reading <debugfs>/android_bench/zram runs the zram store and load path
+ * (page compression, zsmalloc allocation and copy in, mapping and
+ * decompression back out) on every online cpu in turn.  Each operation is
+ * timed individually and reported as one line per cpu plus one for all
+ * cpus:
+ *
+ *	<bench> <op> <cpu|all> <count> <mean> <p50> <p90> <p99> <max> <MB/s>
+ *
+ * with times in nanoseconds and throughput in MB of input per second.
+ * tools/android/android_bench prints binder, ion and ashmem results in the
+ * same format and collects these as well.
+ *
+ * Copyright (C) 2012 Texas Instruments
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpumask.h>
+#include <linux/crypto.h>
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+
+#include "../zsmalloc/zsmalloc.h"
+
+#define BENCH_PAGES		64	/* distinct input pages */
+#define BENCH_MIN_ITERATIONS	16
+#define BENCH_MAX_ITERATIONS	65536
+#define BENCH_COMPRESSOR	"lzo"	/* zram's default */
+
+/* zram stores pages that compress worse than this uncompressed */
+#define BENCH_MAX_ZPAGE_SIZE	(PAGE_SIZE / 4 * 3)
+
+enum {
+	ZRAM_OP_COMPRESS,
+	ZRAM_OP_STORE,
+	ZRAM_OP_LOAD,
+	ZRAM_OP_DECOMPRESS,
+	ZRAM_OP_FREE,
+	ZRAM_OP_COUNT,
+};
+
+static const char * const zram_op_names[ZRAM_OP_COUNT] = {
+	[ZRAM_OP_COMPRESS]	= "compress",
+	[ZRAM_OP_STORE]		= "store",
+	[ZRAM_OP_LOAD]		= "load",
+	[ZRAM_OP_DECOMPRESS]	= "decompress",
+	[ZRAM_OP_FREE]		= "free",
+};
+
+static DEFINE_MUTEX(bench_lock);
+static u32 bench_iterations = 1024;
+static struct dentry *bench_root;
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Sorts @ns in place and prints its distribution.  @bytes is the input
+ * consumed by one operation, for the throughput column.
+ */
+static void bench_report(struct seq_file *s, const char *bench,
+			 const char *op, int cpu, u32 *ns, unsigned int n,
+			 size_t bytes)
+{
+	char cpu_name[8];
+	u64 sum = 0, mean;
+	unsigned int i;
+
+	if (!n)
+		return;
+
+	sort(ns, n, sizeof(u32), bench_cmp, NULL);
+	for (i = 0; i < n; i++)
+		sum += ns[i];
+	mean = div_u64(sum, n);
+
+	if (cpu < 0)
+		strcpy(cpu_name, "all");
+	else
+		snprintf(cpu_name, sizeof(cpu_name), "%d", cpu);
+
+	seq_printf(s, "%s %s %s %u %llu %u %u %u %u %llu\n", bench, op,
+		   cpu_name, n, mean, ns[(n - 1) / 2], ns[n * 90 / 100],
+		   ns[n * 99 / 100], ns[n - 1],
+		   mean ? div64_u64((u64)bytes * 1000, mean) : 0);
+}
+
+static inline u32 bench_ns_since(ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return min_t(s64, ns, UINT_MAX);
+}
+
+/*
+ * Something like anonymous memory: runs of zeroes, runs of a repeated byte
+ * and random bytes, which compresses roughly 2:1 with lzo.
+ */
+static void bench_fill_page(u8 *p, struct rnd_state *rnd)
+{
+	unsigned int off = 0, len, i;
+	u32 r;
+
+	while (off < PAGE_SIZE) {
+		r = prandom32(rnd);
+		len = min_t(unsigned int, PAGE_SIZE - off, (r & 63) + 1);
+		switch ((r >> 6) & 3) {
+		case 0:
+			memset(p + off, 0, len);
+			break;
+		case 1:
+			memset(p + off, r >> 24, len);
+			break;
+		default:
+			for (i = 0; i < len; i++)
+				p[off + i] = prandom32(rnd);
+			break;
+		}
+		off += len;
+	}
+}
+
+struct zram_bench {
+	struct crypto_comp *tfm;
+	struct zs_pool *pool;
+	u8 *pages;
+	u8 *buffer;			/* compression output */
+	u8 *out;			/* decompression output */
+	void **handles;
+	unsigned int *clen;
+	u32 *ns[ZRAM_OP_COUNT];
+	unsigned int nr[ZRAM_OP_COUNT];
+	u64 orig_size;
+	u64 compr_size;
+};
+
+/*
+ * One pass on the current cpu.  Pages that do not compress well enough are
+ * compressed and decompressed but, as zram would keep them uncompressed,
+ * not stored in the pool.
+ */
+static int zram_bench_cpu(struct zram_bench *zb, unsigned int iterations)
+{
+	unsigned int i, len, dlen;
+	ktime_t start;
+	u8 *src, *cmem;
+	int ret = 0;
+
+	for (i = 0; i < iterations && !ret; i++) {
+		src = zb->pages + (i % BENCH_PAGES) * PAGE_SIZE;
+		len = 2 * PAGE_SIZE;
+
+		start = ktime_get();
+		ret = crypto_comp_compress(zb->tfm, src, PAGE_SIZE,
+					   zb->buffer, &len);
+		zb->ns[ZRAM_OP_COMPRESS][zb->nr[ZRAM_OP_COMPRESS]++] =
+			bench_ns_since(start);
+		if (ret)
+			break;
+
+		dlen = PAGE_SIZE;
+		start = ktime_get();
+		ret = crypto_comp_decompress(zb->tfm, zb->buffer, len,
+					     zb->out, &dlen);
+		zb->ns[ZRAM_OP_DECOMPRESS][zb->nr[ZRAM_OP_DECOMPRESS]++] =
+			bench_ns_since(start);
+		if (!ret && dlen != PAGE_SIZE)
+			ret = -EIO;
+
+		zb->orig_size += PAGE_SIZE;
+		zb->compr_size += min_t(unsigned int, len, PAGE_SIZE);
+		zb->clen[i] = len;
+		if (ret || len > BENCH_MAX_ZPAGE_SIZE)
+			continue;
+
+		start = ktime_get();
+		zb->handles[i] = zs_malloc(zb->pool, len);
+		if (zb->handles[i]) {
+			cmem = zs_map_object(zb->pool, zb->handles[i]);
+			memcpy(cmem, zb->buffer, len);
+			zs_unmap_object(zb->pool, zb->handles[i]);
+		}
+		zb->ns[ZRAM_OP_STORE][zb->nr[ZRAM_OP_STORE]++] =
+			bench_ns_since(start);
+		if (!zb->handles[i])
+			ret = -ENOMEM;
+	}
+
+	for (i = 0; i < iterations && !ret; i++) {
+		if (!zb->handles[i])
+			continue;
+
+		dlen = PAGE_SIZE;
+		start = ktime_get();
+		cmem = zs_map_object(zb->pool, zb->handles[i]);
+		ret = crypto_comp_decompress(zb->tfm, cmem, zb->clen[i],
+					     zb->out, &dlen);
+		zs_unmap_object(zb->pool, zb->handles[i]);
+		zb->ns[ZRAM_OP_LOAD][zb->nr[ZRAM_OP_LOAD]++] =
+			bench_ns_since(start);
+	}
+
+	for (i = 0; i < iterations; i++) {
+		if (!zb->handles[i])
+			continue;
+
+		start = ktime_get();
+		zs_free(zb->pool, zb->handles[i]);
+		zb->ns[ZRAM_OP_FREE][zb->nr[ZRAM_OP_FREE]++] =
+			bench_ns_since(start);
+		zb->handles[i] = NULL;
+	}
+
+	return ret;
+}
+
+static void zram_bench_free(struct zram_bench *zb)
+{
+	int op;
+
+	for (op = 0; op < ZRAM_OP_COUNT; op++)
+		vfree(zb->ns[op]);
+	vfree(zb->clen);
+	vfree(zb->handles);
+	kfree(zb->out);
+	kfree(zb->buffer);
+	vfree(zb->pages);
+	if (zb->pool)
+		zs_destroy_pool(zb->pool);
+	if (!IS_ERR_OR_NULL(zb->tfm))
+		crypto_free_comp(zb->tfm);
+}
+
+static int zram_bench_show(struct seq_file *s, void *unused)
+{
+	struct zram_bench zb = { NULL };
+	unsigned int iterations, first[ZRAM_OP_COUNT];
+	struct rnd_state rnd;
+	cpumask_var_t saved;
+	int cpu, op, i, ret = -ENOMEM;
+
+	if (!alloc_cpumask_var(&saved, GFP_KERNEL))
+		return -ENOMEM;
+
+	mutex_lock(&bench_lock);
+	get_online_cpus();
+	iterations = clamp_t(u32, bench_iterations, BENCH_MIN_ITERATIONS,
+			     BENCH_MAX_ITERATIONS);
+
+	zb.tfm = crypto_alloc_comp(BENCH_COMPRESSOR, 0, 0);
+	if (IS_ERR(zb.tfm)) {
+		ret = PTR_ERR(zb.tfm);
+		goto out;
+	}
+	zb.pool = zs_create_pool("android_bench", GFP_NOIO | __GFP_HIGHMEM);
+	zb.pages = vmalloc(BENCH_PAGES * PAGE_SIZE);
+	zb.buffer = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	zb.out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	zb.handles = vzalloc(iterations * sizeof(void *));
+	zb.clen = vmalloc(iterations * sizeof(unsigned int));
+	if (!zb.pool || !zb.pages || !zb.buffer || !zb.out || !zb.handles ||
+	    !zb.clen)
+		goto out;
+	for (op = 0; op < ZRAM_OP_COUNT; op++) {
+		zb.ns[op] = vmalloc(num_online_cpus() * iterations *
+				    sizeof(u32));
+		if (!zb.ns[op])
+			goto out;
+	}
+
+	prandom32_seed(&rnd, 42);
+	for (i = 0; i < BENCH_PAGES; i++)
+		bench_fill_page(zb.pages + i * PAGE_SIZE, &rnd);
+
+	seq_printf(s, "# bench op cpu count mean_ns p50_ns p90_ns p99_ns "
+		   "max_ns MB/s\n");
+
+	cpumask_copy(saved, tsk_cpus_allowed(current));
+	for_each_online_cpu(cpu) {
+		ret = set_cpus_allowed_ptr(current, cpumask_of(cpu));
+		if (ret)
+			break;
+
+		memcpy(first, zb.nr, sizeof(first));
+		ret = zram_bench_cpu(&zb, iterations);
+		if (ret)
+			break;
+
+		/* sorted in place per cpu here, and as a whole below */
+		for (op = 0; op < ZRAM_OP_COUNT; op++)
+			bench_report(s, "zram", zram_op_names[op], cpu,
+				     zb.ns[op] + first[op],
+				     zb.nr[op] - first[op], PAGE_SIZE);
+	}
+	set_cpus_allowed_ptr(current, saved);
+	if (ret)
+		goto out;
+
+	for (op = 0; op < ZRAM_OP_COUNT; op++)
+		bench_report(s, "zram", zram_op_names[op], -1, zb.ns[op],
+			     zb.nr[op], PAGE_SIZE);
+	seq_printf(s, "# %s: %llu bytes compressed to %llu\n",
+		   BENCH_COMPRESSOR, zb.orig_size, zb.compr_size);
+
+out:
+	zram_bench_free(&zb);
+	put_online_cpus();
+	mutex_unlock(&bench_lock);
+	free_cpumask_var(saved);
+	return ret;
+}
+
+static int zram_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zram_bench_show, NULL);
+}
+
+static const struct file_operations zram_bench_fops = {
+	.open = zram_bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init android_bench_init(void)
+{
+	bench_root = debugfs_create_dir("android_bench", NULL);
+	if (IS_ERR_OR_NULL(bench_root))
+		return -ENODEV;
+
+	debugfs_create_u32("iterations", 0644, bench_root, &bench_iterations);
+	debugfs_create_file("zram", 0444, bench_root, NULL, &zram_bench_fops);
+	return 0;
+}
+
+static void __exit android_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_root);
+}
+
+module_init(android_bench_init);
+module_exit(android_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Microbenchmarks for Android kernel paths");
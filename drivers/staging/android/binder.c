@@ -18,10 +18,12 @@
 #include <asm/cacheflush.h>
 #include <linux/fdtable.h>
 #include <linux/file.h>
+#include <linux/freezer.h>
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
+#include <linux/mman.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/nsproxy.h>
@@ -33,12 +35,18 @@
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
 
 #include "binder.h"
+#include "binder_alloc.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
 
 static DEFINE_MUTEX(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
-static DEFINE_MUTEX(binder_mmap_lock);
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
@@ -147,7 +155,7 @@ enum binder_stat_types {
 };
 
 struct binder_stats {
-	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
+	int br[_IOC_NR(BR_TRANSACTION_PENDING_FROZEN) + 1];
 	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
@@ -185,6 +193,39 @@ struct binder_transaction_log {
 static struct binder_transaction_log binder_transaction_log;
 static struct binder_transaction_log binder_transaction_log_failed;
 
+/*
+ * Transaction latency histograms.  Bucket 0 counts latencies below
+ * 1us, bucket n latencies of 2^(n-1) to 2^n us, and the last bucket
+ * everything above.  Nothing is sampled unless latency_stats is set.
+ */
+enum binder_latency_types {
+	BINDER_LATENCY_ENQUEUE_TO_WAKEUP,
+	BINDER_LATENCY_WAKEUP_TO_READ,
+	BINDER_LATENCY_REPLY,
+	BINDER_LATENCY_COUNT
+};
+
+/*
+ * Let synchronous transactions from SCHED_FIFO/SCHED_RR callers run
+ * the target thread at the caller's realtime priority.  Nodes can ask
+ * for it individually with FLAT_BINDER_FLAG_INHERIT_RT.
+ */
+static bool binder_inherit_rt = true;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
+
+#define BINDER_LATENCY_BUCKETS	20
+#define BINDER_HOT_COUNT	10
+
+struct binder_latency_stats {
+	unsigned int hist[BINDER_LATENCY_COUNT][BINDER_LATENCY_BUCKETS];
+};
+
+static bool binder_latency_stats_enabled;
+module_param_named(latency_stats, binder_latency_stats_enabled,
+		   bool, S_IWUSR | S_IRUGO);
+
+static DEFINE_PER_CPU(struct binder_latency_stats, binder_latency_stats);
+
 static struct binder_transaction_log_entry *binder_transaction_log_add(
 	struct binder_transaction_log *log)
 {
@@ -199,11 +240,22 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/*
+ * A scheduling policy and a kernel priority, the latter on the
+ * task->prio scale: lower is more important, realtime below
+ * MAX_RT_PRIO, nice values at NICE_TO_PRIO().
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
 struct binder_work {
 	struct list_head entry;
 	enum {
 		BINDER_WORK_TRANSACTION = 1,
 		BINDER_WORK_TRANSACTION_COMPLETE,
+		BINDER_WORK_TRANSACTION_PENDING,
 		BINDER_WORK_NODE,
 		BINDER_WORK_DEAD_BINDER,
 		BINDER_WORK_DEAD_BINDER_AND_CLEAR,
@@ -232,7 +284,10 @@ struct binder_node {
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
 	unsigned min_priority:8;
+	unsigned inherit_rt:1;
 	struct list_head async_todo;
+	unsigned int txn_count;
+	u64 txn_latency;	/* ns from enqueue to read, sampled */
 };
 
 struct binder_ref_death {
@@ -255,23 +310,7 @@ struct binder_ref {
 	int strong;
 	int weak;
 	struct binder_ref_death *death;
-};
-
-struct binder_buffer {
-	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
-	unsigned free:1;
-	unsigned allow_user_free:1;
-	unsigned async_transaction:1;
-	unsigned debug_id:29;
-
-	struct binder_transaction *transaction;
-
-	struct binder_node *target_node;
-	size_t data_size;
-	size_t offsets_size;
-	uint8_t data[0];
+	unsigned int txn_count;
 };
 
 enum binder_deferred_state {
@@ -287,33 +326,30 @@ struct binder_proc {
 	struct rb_root refs_by_desc;
 	struct rb_root refs_by_node;
 	int pid;
-	struct vm_area_struct *vma;
-	struct mm_struct *vma_vm_mm;
 	struct task_struct *tsk;
 	struct files_struct *files;
 	struct hlist_node deferred_work_node;
 	int deferred_work;
-	void *buffer;
-	ptrdiff_t user_buffer_offset;
 
-	struct list_head buffers;
-	struct rb_root free_buffers;
-	struct rb_root allocated_buffers;
-	size_t free_async_space;
-
-	struct page **pages;
-	size_t buffer_size;
-	uint32_t buffer_free;
+	/*
+	 * The buffer allocator has its own lock rather than binder_lock,
+	 * so that the target buffer can be allocated, mapped and filled
+	 * without holding the global lock.
+	 */
+	struct binder_alloc alloc;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	struct binder_latency_stats __percpu *latency;
 	struct list_head delivered_death;
 	int max_threads;
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
+	int tmp_ref;		/* transactions filling a buffer unlocked */
+	int release_pending;	/* release deferred until tmp_ref drops */
 };
 
 enum {
@@ -354,9 +390,11 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	start;		/* enqueue time, if latency_stats is set */
+	int	sg_count;	/* BINDER_TYPE_SG_FD objects to map on read */
 };
 
 static void
@@ -499,434 +537,135 @@ out_unlock:
 	return -EBADF;
 }
 
-static void binder_set_nice(long nice)
+static bool binder_is_rt_policy(unsigned int policy)
 {
-	long min_nice;
-	if (can_nice(current, nice)) {
-		set_user_nice(current, nice);
-		return;
-	}
-	min_nice = 20 - current->signal->rlim[RLIMIT_NICE].rlim_cur;
-	binder_debug(BINDER_DEBUG_PRIORITY_CAP,
-		     "binder: %d: nice value %ld not allowed use "
-		     "%ld instead\n", current->pid, nice, min_nice);
-	set_user_nice(current, min_nice);
-	if (min_nice < 20)
-		return;
-	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
+	return policy == SCHED_FIFO || policy == SCHED_RR;
 }
 
-static size_t binder_buffer_size(struct binder_proc *proc,
-				 struct binder_buffer *buffer)
+static struct binder_priority binder_get_priority(struct task_struct *task)
 {
-	if (list_is_last(&buffer->entry, &proc->buffers))
-		return proc->buffer + proc->buffer_size - (void *)buffer->data;
-	else
-		return (size_t)list_entry(buffer->entry.next,
-			struct binder_buffer, entry) - (size_t)buffer->data;
+	struct binder_priority p;
+
+	if (binder_is_rt_policy(task->policy)) {
+		p.sched_policy = task->policy;
+		p.prio = task->normal_prio;
+	} else {
+		p.sched_policy = SCHED_NORMAL;
+		p.prio = task->static_prio;
+	}
+	return p;
 }
 
-static void binder_insert_free_buffer(struct binder_proc *proc,
-				      struct binder_buffer *new_buffer)
+/*
+ * Switch current to @desired.  With @verify set the request is capped
+ * by current's RLIMIT_RTPRIO and RLIMIT_NICE unless it has
+ * CAP_SYS_NICE; a realtime request without RLIMIT_RTPRIO degrades to
+ * the best nice value allowed.  Restoring a saved priority does not
+ * verify, the thread had that priority before.
+ */
+static void binder_do_set_priority(struct binder_priority desired,
+				   bool verify)
 {
-	struct rb_node **p = &proc->free_buffers.rb_node;
-	struct rb_node *parent = NULL;
-	struct binder_buffer *buffer;
-	size_t buffer_size;
-	size_t new_buffer_size;
+	struct task_struct *task = current;
+	struct binder_priority old = binder_get_priority(task);
+	unsigned int policy = desired.sched_policy;
+	int prio = desired.prio;
 
-	BUG_ON(!new_buffer->free);
+	if (old.sched_policy == policy && old.prio == prio)
+		return;
 
-	new_buffer_size = binder_buffer_size(proc, new_buffer);
+	if (verify && !has_capability_noaudit(task, CAP_SYS_NICE)) {
+		if (binder_is_rt_policy(policy)) {
+			int max_rtprio = min_t(unsigned long,
+					MAX_USER_RT_PRIO - 1,
+					task_rlimit(task, RLIMIT_RTPRIO));
+
+			if (max_rtprio == 0) {
+				policy = SCHED_NORMAL;
+				prio = NICE_TO_PRIO(-20);
+			} else if (MAX_USER_RT_PRIO - 1 - prio > max_rtprio) {
+				prio = MAX_USER_RT_PRIO - 1 - max_rtprio;
+			}
+		}
+		if (!binder_is_rt_policy(policy)) {
+			int min_nice = 20 - min_t(unsigned long, 40,
+					task_rlimit(task, RLIMIT_NICE));
 
-	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "binder: %d: add free buffer, size %zd, "
-		     "at %p\n", proc->pid, new_buffer_size, new_buffer);
+			if (min_nice > 19) {
+				binder_user_error("binder: %d RLIMIT_NICE not "
+						  "set\n", task->pid);
+				return;
+			}
+			if (PRIO_TO_NICE(prio) < min_nice) {
+				binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+					     "binder: %d: nice value %d not "
+					     "allowed use %d instead\n",
+					     task->pid, PRIO_TO_NICE(prio),
+					     min_nice);
+				prio = NICE_TO_PRIO(min_nice);
+			}
+		}
+	}
 
-	while (*p) {
-		parent = *p;
-		buffer = rb_entry(parent, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
+	if (binder_is_rt_policy(policy)) {
+		struct sched_param param = {
+			.sched_priority = MAX_USER_RT_PRIO - 1 - prio,
+		};
 
-		buffer_size = binder_buffer_size(proc, buffer);
+		sched_setscheduler_nocheck(task, policy | SCHED_RESET_ON_FORK,
+					   &param);
+	} else {
+		struct sched_param param = { .sched_priority = 0 };
 
-		if (new_buffer_size < buffer_size)
-			p = &parent->rb_left;
-		else
-			p = &parent->rb_right;
+		if (binder_is_rt_policy(task->policy))
+			sched_setscheduler_nocheck(task,
+					SCHED_NORMAL | SCHED_RESET_ON_FORK,
+					&param);
+		set_user_nice(task, PRIO_TO_NICE(prio));
 	}
-	rb_link_node(&new_buffer->rb_node, parent, p);
-	rb_insert_color(&new_buffer->rb_node, &proc->free_buffers);
+
+	trace_binder_set_priority(task->tgid, task->pid, old.sched_policy,
+				  old.prio, policy, prio, desired.prio);
 }
 
-static void binder_insert_allocated_buffer(struct binder_proc *proc,
-					   struct binder_buffer *new_buffer)
+static void binder_set_priority(struct binder_priority desired)
 {
-	struct rb_node **p = &proc->allocated_buffers.rb_node;
-	struct rb_node *parent = NULL;
-	struct binder_buffer *buffer;
-
-	BUG_ON(new_buffer->free);
-
-	while (*p) {
-		parent = *p;
-		buffer = rb_entry(parent, struct binder_buffer, rb_node);
-		BUG_ON(buffer->free);
-
-		if (new_buffer < buffer)
-			p = &parent->rb_left;
-		else if (new_buffer > buffer)
-			p = &parent->rb_right;
-		else
-			BUG();
-	}
-	rb_link_node(&new_buffer->rb_node, parent, p);
-	rb_insert_color(&new_buffer->rb_node, &proc->allocated_buffers);
+	binder_do_set_priority(desired, true);
 }
 
-static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
-						  void __user *user_ptr)
+static void binder_restore_priority(struct binder_priority desired)
 {
-	struct rb_node *n = proc->allocated_buffers.rb_node;
-	struct binder_buffer *buffer;
-	struct binder_buffer *kern_ptr;
-
-	kern_ptr = user_ptr - proc->user_buffer_offset
-		- offsetof(struct binder_buffer, data);
-
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(buffer->free);
-
-		if (kern_ptr < buffer)
-			n = n->rb_left;
-		else if (kern_ptr > buffer)
-			n = n->rb_right;
-		else
-			return buffer;
-	}
-	return NULL;
+	binder_do_set_priority(desired, false);
 }
 
-static int binder_update_page_range(struct binder_proc *proc, int allocate,
-				    void *start, void *end,
-				    struct vm_area_struct *vma)
+/*
+ * Pick the priority a thread runs @t at on @node: a synchronous call
+ * runs at the caller's priority, realtime included if the node allows
+ * it, but never below the node's minimum; a oneway call only ever gets
+ * raised to the node's minimum.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
 {
-	void *page_addr;
-	unsigned long user_page_addr;
-	struct vm_struct tmp_area;
-	struct page **page;
-	struct mm_struct *mm;
-
-	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "binder: %d: %s pages %p-%p\n", proc->pid,
-		     allocate ? "allocate" : "free", start, end);
-
-	if (end <= start)
-		return 0;
-
-	if (vma)
-		mm = NULL;
-	else
-		mm = get_task_mm(proc->tsk);
-
-	if (mm) {
-		down_write(&mm->mmap_sem);
-		vma = proc->vma;
-		if (vma && mm != proc->vma_vm_mm) {
-			pr_err("binder: %d: vma mm and task mm mismatch\n",
-				proc->pid);
-			vma = NULL;
-		}
-	}
-
-	if (allocate == 0)
-		goto free_range;
-
-	if (vma == NULL) {
-		printk(KERN_ERR "binder: %d: binder_alloc_buf failed to "
-		       "map pages in userspace, no vma\n", proc->pid);
-		goto err_no_vma;
-	}
-
-	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		int ret;
-		struct page **page_array_ptr;
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-
-		BUG_ON(*page);
-		*page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO);
-		if (*page == NULL) {
-			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
-			       "for page at %p\n", proc->pid, page_addr);
-			goto err_alloc_page_failed;
-		}
-		tmp_area.addr = page_addr;
-		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
-		page_array_ptr = page;
-		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
-		if (ret) {
-			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
-			       "to map page at %p in kernel\n",
-			       proc->pid, page_addr);
-			goto err_map_kernel_failed;
-		}
-		user_page_addr =
-			(uintptr_t)page_addr + proc->user_buffer_offset;
-		ret = vm_insert_page(vma, user_page_addr, page[0]);
-		if (ret) {
-			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
-			       "to map page at %lx in userspace\n",
-			       proc->pid, user_page_addr);
-			goto err_vm_insert_page_failed;
-		}
-		/* vm_insert_page does not seem to increment the refcount */
-	}
-	if (mm) {
-		up_write(&mm->mmap_sem);
-		mmput(mm);
-	}
-	return 0;
-
-free_range:
-	for (page_addr = end - PAGE_SIZE; page_addr >= start;
-	     page_addr -= PAGE_SIZE) {
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
-err_vm_insert_page_failed:
-		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-err_map_kernel_failed:
-		__free_page(*page);
-		*page = NULL;
-err_alloc_page_failed:
-		;
-	}
-err_no_vma:
-	if (mm) {
-		up_write(&mm->mmap_sem);
-		mmput(mm);
-	}
-	return -ENOMEM;
-}
-
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
-{
-	struct rb_node *n = proc->free_buffers.rb_node;
-	struct binder_buffer *buffer;
-	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
-	void *has_page_addr;
-	void *end_page_addr;
-	size_t size;
-
-	if (proc->vma == NULL) {
-		printk(KERN_ERR "binder: %d: binder_alloc_buf, no vma\n",
-		       proc->pid);
-		return NULL;
-	}
-
-	size = ALIGN(data_size, sizeof(void *)) +
-		ALIGN(offsets_size, sizeof(void *));
-
-	if (size < data_size || size < offsets_size) {
-		binder_user_error("binder: %d: got transaction with invalid "
-			"size %zd-%zd\n", proc->pid, data_size, offsets_size);
-		return NULL;
-	}
-
-	if (is_async &&
-	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-			     "binder: %d: binder_alloc_buf size %zd"
-			     "failed, no async space left\n", proc->pid, size);
-		return NULL;
-	}
-
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
-		buffer_size = binder_buffer_size(proc, buffer);
+	struct binder_priority desired = t->priority;
+	struct binder_priority node_prio = {
+		.sched_policy = SCHED_NORMAL,
+		.prio = NICE_TO_PRIO((int)node->min_priority),
+	};
 
-		if (size < buffer_size) {
-			best_fit = n;
-			n = n->rb_left;
-		} else if (size > buffer_size)
-			n = n->rb_right;
-		else {
-			best_fit = n;
-			break;
-		}
-	}
-	if (best_fit == NULL) {
-		printk(KERN_ERR "binder: %d: binder_alloc_buf size %zd failed, "
-		       "no address space\n", proc->pid, size);
-		return NULL;
-	}
-	if (n == NULL) {
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_buffer_size(proc, buffer);
+	if (t->flags & TF_ONE_WAY)
+		desired = t->saved_priority;
+	else if (binder_is_rt_policy(desired.sched_policy) &&
+		 !node->inherit_rt && !binder_inherit_rt) {
+		desired.sched_policy = SCHED_NORMAL;
+		desired.prio = NICE_TO_PRIO(0);
 	}
 
-	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "binder: %d: binder_alloc_buf size %zd got buff"
-		     "er %p size %zd\n", proc->pid, size, buffer, buffer_size);
-
-	has_page_addr =
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
-	if (n == NULL) {
-		if (size + sizeof(struct binder_buffer) + 4 >= buffer_size)
-			buffer_size = size; /* no room for other buffers */
-		else
-			buffer_size = size + sizeof(struct binder_buffer);
-	}
-	end_page_addr =
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data + buffer_size);
-	if (end_page_addr > has_page_addr)
-		end_page_addr = has_page_addr;
-	if (binder_update_page_range(proc, 1,
-	    (void *)PAGE_ALIGN((uintptr_t)buffer->data), end_page_addr, NULL))
-		return NULL;
+	if (!binder_is_rt_policy(desired.sched_policy) &&
+	    desired.prio > node_prio.prio)
+		desired = node_prio;
 
-	rb_erase(best_fit, &proc->free_buffers);
-	buffer->free = 0;
-	binder_insert_allocated_buffer(proc, buffer);
-	if (buffer_size != size) {
-		struct binder_buffer *new_buffer = (void *)buffer->data + size;
-		list_add(&new_buffer->entry, &buffer->entry);
-		new_buffer->free = 1;
-		binder_insert_free_buffer(proc, new_buffer);
-	}
-	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "binder: %d: binder_alloc_buf size %zd got "
-		     "%p\n", proc->pid, size, buffer);
-	buffer->data_size = data_size;
-	buffer->offsets_size = offsets_size;
-	buffer->async_transaction = is_async;
-	if (is_async) {
-		proc->free_async_space -= size + sizeof(struct binder_buffer);
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
-			     "binder: %d: binder_alloc_buf size %zd "
-			     "async free %zd\n", proc->pid, size,
-			     proc->free_async_space);
-	}
-
-	return buffer;
-}
-
-static void *buffer_start_page(struct binder_buffer *buffer)
-{
-	return (void *)((uintptr_t)buffer & PAGE_MASK);
-}
-
-static void *buffer_end_page(struct binder_buffer *buffer)
-{
-	return (void *)(((uintptr_t)(buffer + 1) - 1) & PAGE_MASK);
-}
-
-static void binder_delete_free_buffer(struct binder_proc *proc,
-				      struct binder_buffer *buffer)
-{
-	struct binder_buffer *prev, *next = NULL;
-	int free_page_end = 1;
-	int free_page_start = 1;
-
-	BUG_ON(proc->buffers.next == &buffer->entry);
-	prev = list_entry(buffer->entry.prev, struct binder_buffer, entry);
-	BUG_ON(!prev->free);
-	if (buffer_end_page(prev) == buffer_start_page(buffer)) {
-		free_page_start = 0;
-		if (buffer_end_page(prev) == buffer_end_page(buffer))
-			free_page_end = 0;
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-			     "binder: %d: merge free, buffer %p "
-			     "share page with %p\n", proc->pid, buffer, prev);
-	}
-
-	if (!list_is_last(&buffer->entry, &proc->buffers)) {
-		next = list_entry(buffer->entry.next,
-				  struct binder_buffer, entry);
-		if (buffer_start_page(next) == buffer_end_page(buffer)) {
-			free_page_end = 0;
-			if (buffer_start_page(next) ==
-			    buffer_start_page(buffer))
-				free_page_start = 0;
-			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-				     "binder: %d: merge free, buffer"
-				     " %p share page with %p\n", proc->pid,
-				     buffer, prev);
-		}
-	}
-	list_del(&buffer->entry);
-	if (free_page_start || free_page_end) {
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-			     "binder: %d: merge free, buffer %p do "
-			     "not share page%s%s with with %p or %p\n",
-			     proc->pid, buffer, free_page_start ? "" : " end",
-			     free_page_end ? "" : " start", prev, next);
-		binder_update_page_range(proc, 0, free_page_start ?
-			buffer_start_page(buffer) : buffer_end_page(buffer),
-			(free_page_end ? buffer_end_page(buffer) :
-			buffer_start_page(buffer)) + PAGE_SIZE, NULL);
-	}
-}
-
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
-{
-	size_t size, buffer_size;
-
-	buffer_size = binder_buffer_size(proc, buffer);
-
-	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
-
-	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "binder: %d: binder_free_buf %p size %zd buffer"
-		     "_size %zd\n", proc->pid, buffer, size, buffer_size);
-
-	BUG_ON(buffer->free);
-	BUG_ON(size > buffer_size);
-	BUG_ON(buffer->transaction != NULL);
-	BUG_ON((void *)buffer < proc->buffer);
-	BUG_ON((void *)buffer > proc->buffer + proc->buffer_size);
-
-	if (buffer->async_transaction) {
-		proc->free_async_space += size + sizeof(struct binder_buffer);
-
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
-			     "binder: %d: binder_free_buf size %zd "
-			     "async free %zd\n", proc->pid, size,
-			     proc->free_async_space);
-	}
-
-	binder_update_page_range(proc, 0,
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
-		NULL);
-	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &proc->buffers)) {
-		struct binder_buffer *next = list_entry(buffer->entry.next,
-						struct binder_buffer, entry);
-		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
-			binder_delete_free_buffer(proc, next);
-		}
-	}
-	if (proc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = list_entry(buffer->entry.prev,
-						struct binder_buffer, entry);
-		if (prev->free) {
-			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
-			buffer = prev;
-		}
-	}
-	binder_insert_free_buffer(proc, buffer);
+	binder_set_priority(desired);
 }
 
 static struct binder_node *binder_get_node(struct binder_proc *proc,
@@ -1367,12 +1106,17 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 		} break;
 
 		case BINDER_TYPE_FD:
+		case BINDER_TYPE_SG_FD:
 			binder_debug(BINDER_DEBUG_TRANSACTION,
 				     "        fd %ld\n", fp->handle);
 			if (failed_at)
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_SG_PTR:
+			/* the mapping belongs to the receiver */
+			break;
+
 		default:
 			printk(KERN_ERR "binder: transaction release %d bad "
 			       "object type %lx\n", debug_id, fp->type);
@@ -1381,6 +1125,139 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * Called in the context of the receiving thread.  Each BINDER_TYPE_SG_FD
+ * object already carries an fd installed in proc; map the file into the
+ * receiver's address space and drop the fd, so the payload is never
+ * copied through the transaction buffer.
+ */
+static void binder_map_sg_objects(struct binder_proc *proc,
+				  struct binder_transaction *t)
+{
+	struct binder_buffer *buffer = t->buffer;
+	size_t *offp, *off_end;
+
+	offp = (size_t *)(buffer->data + ALIGN(buffer->data_size,
+					       sizeof(void *)));
+	off_end = (void *)offp + buffer->offsets_size;
+	for (; offp < off_end; offp++) {
+		struct flat_binder_object *fp;
+		struct file *file;
+		unsigned long addr;
+
+		if (*offp > buffer->data_size - sizeof(*fp) ||
+		    buffer->data_size < sizeof(*fp))
+			continue;
+		fp = (struct flat_binder_object *)(buffer->data + *offp);
+		if (fp->type != BINDER_TYPE_SG_FD)
+			continue;
+		file = fget(fp->handle);
+		if (file == NULL)
+			continue;
+		addr = vm_mmap(file, 0, (size_t)fp->cookie, PROT_READ,
+			       MAP_SHARED, 0);
+		fput(file);
+		if (IS_ERR_VALUE(addr)) {
+			binder_debug(BINDER_DEBUG_TRANSACTION,
+				     "binder: %d: transaction %d can't map sg fd %ld, %ld\n",
+				     proc->pid, t->debug_id, fp->handle,
+				     (long)addr);
+			continue;
+		}
+		binder_debug(BINDER_DEBUG_TRANSACTION,
+			     "        sg fd %ld -> %lx size %zd\n",
+			     fp->handle, addr, (size_t)fp->cookie);
+		task_close_fd(proc, fp->handle);
+		fp->type = BINDER_TYPE_SG_PTR;
+		fp->binder = (void *)addr;
+	}
+	t->sg_count = 0;
+}
+
+static void binder_latency_add(struct binder_proc *proc,
+			       enum binder_latency_types type, ktime_t delta)
+{
+	s64 us = ktime_to_us(delta);
+	int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= BINDER_LATENCY_BUCKETS)
+		bucket = BINDER_LATENCY_BUCKETS - 1;
+	this_cpu_inc(binder_latency_stats.hist[type][bucket]);
+	if (proc->latency)
+		this_cpu_inc(proc->latency->hist[type][bucket]);
+}
+
+/*
+ * Accounts for transaction t being read by a thread of proc that woke
+ * up at time wake.  If the transaction was queued after the thread
+ * woke up, it did not have to wait for a wakeup at all.
+ */
+static void binder_latency_delivered(struct binder_proc *proc,
+				     struct binder_transaction *t,
+				     ktime_t wake)
+{
+	ktime_t now = ktime_get();
+
+	if (wake.tv64 < t->start.tv64)
+		wake = t->start;
+	binder_latency_add(proc, BINDER_LATENCY_ENQUEUE_TO_WAKEUP,
+			   ktime_sub(wake, t->start));
+	binder_latency_add(proc, BINDER_LATENCY_WAKEUP_TO_READ,
+			   ktime_sub(now, wake));
+	if (t->buffer->target_node)
+		t->buffer->target_node->txn_latency +=
+			ktime_to_ns(ktime_sub(now, t->start));
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	proc->tmp_ref--;
+	if (proc->tmp_ref == 0 && proc->release_pending) {
+		proc->release_pending = 0;
+		binder_defer_work(proc, BINDER_DEFERRED_RELEASE);
+	}
+}
+
+/*
+ * Called without binder_lock.  Allocates the transaction buffer in
+ * target_proc and copies the data and offsets arrays into it.  On
+ * return t->buffer is NULL if the allocation failed.
+ */
+static int binder_transaction_copy_data(struct binder_proc *proc,
+					struct binder_thread *thread,
+					struct binder_proc *target_proc,
+					struct binder_transaction *t,
+					struct binder_transaction_data *tr,
+					int reply)
+{
+	size_t *offp;
+
+	t->buffer = binder_alloc_new_buf(&target_proc->alloc, tr->data_size,
+		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+	if (t->buffer == NULL)
+		return -ENOMEM;
+
+	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
+
+	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+		binder_user_error("binder: %d:%d got transaction with invalid "
+			"data ptr\n", proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
+		binder_user_error("binder: %d:%d got transaction with invalid "
+			"offsets ptr\n", proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
+		binder_user_error("binder: %d:%d got transaction with "
+			"invalid offsets size, %zd\n",
+			proc->pid, thread->pid, tr->offsets_size);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply)
@@ -1396,6 +1273,8 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	bool target_frozen = false;
+	int ret;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1414,7 +1293,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_restore_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1460,6 +1339,8 @@ static void binder_transaction(struct binder_proc *proc,
 				goto err_invalid_target_handle;
 			}
 			target_node = ref->node;
+			if (binder_latency_stats_enabled)
+				ref->txn_count++;
 		} else {
 			target_node = binder_context_mgr_node;
 			if (target_node == NULL) {
@@ -1468,11 +1349,24 @@ static void binder_transaction(struct binder_proc *proc,
 			}
 		}
 		e->to_node = target_node->debug_id;
+		if (binder_latency_stats_enabled)
+			target_node->txn_count++;
 		target_proc = target_node->proc;
 		if (target_proc == NULL) {
 			return_error = BR_DEAD_REPLY;
 			goto err_dead_binder;
 		}
+		/*
+		 * A frozen process can't answer until it is thawed; fail
+		 * calls rather than block the caller, queue oneway ones.
+		 */
+		if (cgroup_freezing(target_proc->tsk)) {
+			if (!(tr->flags & TF_ONE_WAY)) {
+				return_error = BR_FROZEN_REPLY;
+				goto err_frozen_target;
+			}
+			target_frozen = true;
+		}
 		if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
 			struct binder_transaction *tmp;
 			tmp = thread->transaction_stack;
@@ -1487,21 +1381,8 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1545,44 +1426,70 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = proc->tsk->cred->euid;
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
-	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+	t->priority = binder_get_priority(current);
+
+	/*
+	 * Allocating the target buffer and copying the parcel into it is
+	 * the expensive part of a transaction, and touches nothing but
+	 * the target allocator, so do it without binder_lock.  The
+	 * temporary reference keeps target_proc from being released, and
+	 * the node reference keeps target_node alive in the meantime.
+	 */
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	target_proc->tmp_ref++;
+	mutex_unlock(&binder_lock);
+	ret = binder_transaction_copy_data(proc, thread, target_proc, t, tr,
+					   reply);
+	mutex_lock(&binder_lock);
+	binder_proc_dec_tmpref(target_proc);
+
 	if (t->buffer == NULL) {
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"data ptr\n", proc->pid, thread->pid);
+	if (ret) {
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"offsets ptr\n", proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+
+	/*
+	 * Threads may have exited while binder_lock was dropped, so only
+	 * now pick the thread the transaction is delivered to.
+	 */
+	if (reply) {
+		target_thread = in_reply_to->from;
+		if (target_thread == NULL) {
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
+		struct binder_transaction *tmp;
+
+		for (tmp = thread->transaction_stack; tmp; tmp = tmp->from_parent)
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
 	}
-	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
-		binder_user_error("binder: %d:%d got transaction with "
-			"invalid offsets size, %zd\n",
-			proc->pid, thread->pid, tr->offsets_size);
-		return_error = BR_FAILED_REPLY;
-		goto err_bad_offset;
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+	t->to_thread = target_thread;
+
 	off_end = (void *)offp + tr->offsets_size;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
@@ -1608,6 +1515,7 @@ static void binder_transaction(struct binder_proc *proc,
 					goto err_binder_new_node_failed;
 				}
 				node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+				node->inherit_rt = !!(fp->flags & FLAT_BINDER_FLAG_INHERIT_RT);
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 			}
 			if (fp->cookie != node->cookie) {
@@ -1675,7 +1583,8 @@ static void binder_transaction(struct binder_proc *proc,
 			}
 		} break;
 
-		case BINDER_TYPE_FD: {
+		case BINDER_TYPE_FD:
+		case BINDER_TYPE_SG_FD: {
 			int target_fd;
 			struct file *file;
 
@@ -1693,6 +1602,15 @@ static void binder_transaction(struct binder_proc *proc,
 				goto err_fd_not_allowed;
 			}
 
+			if (fp->type == BINDER_TYPE_SG_FD &&
+			    ((size_t)fp->cookie == 0 ||
+			     (size_t)fp->cookie > TASK_SIZE)) {
+				binder_user_error("binder: %d:%d got transaction with bad sg size, %zd\n",
+					proc->pid, thread->pid,
+					(size_t)fp->cookie);
+				return_error = BR_FAILED_REPLY;
+				goto err_fget_failed;
+			}
 			file = fget(fp->handle);
 			if (file == NULL) {
 				binder_user_error("binder: %d:%d got transaction with invalid fd, %ld\n",
@@ -1711,6 +1629,8 @@ static void binder_transaction(struct binder_proc *proc,
 				     "        fd %ld -> %d\n", fp->handle, target_fd);
 			/* TODO: fput? */
 			fp->handle = target_fd;
+			if (fp->type == BINDER_TYPE_SG_FD)
+				t->sg_count++;
 		} break;
 
 		default:
@@ -1723,6 +1643,9 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		if (in_reply_to->start.tv64)
+			binder_latency_add(proc, BINDER_LATENCY_REPLY,
+				ktime_sub(ktime_get(), in_reply_to->start));
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1738,9 +1661,12 @@ static void binder_transaction(struct binder_proc *proc,
 		} else
 			target_node->has_async_transaction = 1;
 	}
+	if (binder_latency_stats_enabled)
+		t->start = ktime_get();
 	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
-	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
+	tcomplete->type = target_frozen ? BINDER_WORK_TRANSACTION_PENDING :
+					  BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
@@ -1757,7 +1683,7 @@ err_bad_offset:
 err_copy_data_failed:
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
-	binder_free_buf(target_proc, t->buffer);
+	binder_alloc_free_buf(&target_proc->alloc, t->buffer);
 err_binder_alloc_buf_failed:
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
@@ -1765,6 +1691,7 @@ err_alloc_tcomplete_failed:
 	kfree(t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 err_alloc_t_failed:
+err_frozen_target:
 err_bad_call_stack:
 err_empty_call_stack:
 err_dead_binder:
@@ -1781,7 +1708,15 @@ err_no_context_mgr_node:
 		*fe = *e;
 	}
 
-	BUG_ON(thread->return_error != BR_OK);
+	/*
+	 * binder_send_failed_reply() may have posted an error to this
+	 * thread while binder_lock was dropped; report that one first.
+	 */
+	if (thread->return_error != BR_OK &&
+	    thread->return_error2 == BR_OK) {
+		thread->return_error2 = thread->return_error;
+		thread->return_error = BR_OK;
+	}
 	if (in_reply_to) {
 		thread->return_error = BR_TRANSACTION_COMPLETE;
 		binder_send_failed_reply(in_reply_to, return_error);
@@ -1939,7 +1874,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(void *);
 
-			buffer = binder_buffer_lookup(proc, data_ptr);
+			buffer = binder_alloc_buffer_lookup(&proc->alloc, data_ptr);
 			if (buffer == NULL) {
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
@@ -1970,7 +1905,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					list_move_tail(buffer->target_node->async_todo.next, &thread->todo);
 			}
 			binder_transaction_buffer_release(proc, buffer, NULL);
-			binder_free_buf(proc, buffer);
+			binder_alloc_free_buf(&proc->alloc, buffer);
 			break;
 		}
 
@@ -2207,6 +2142,7 @@ static int binder_thread_read(struct binder_proc *proc,
 
 	int ret = 0;
 	int wait_for_proc_work;
+	ktime_t wake;
 
 	if (*consumed == 0) {
 		if (put_user(BR_NOOP, (uint32_t __user *)ptr))
@@ -2249,7 +2185,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_restore_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2266,6 +2202,7 @@ retry:
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
+	wake = binder_latency_stats_enabled ? ktime_get() : ktime_set(0, 0);
 
 	if (ret)
 		return ret;
@@ -2293,16 +2230,23 @@ retry:
 		case BINDER_WORK_TRANSACTION: {
 			t = container_of(w, struct binder_transaction, work);
 		} break;
-		case BINDER_WORK_TRANSACTION_COMPLETE: {
-			cmd = BR_TRANSACTION_COMPLETE;
+		case BINDER_WORK_TRANSACTION_COMPLETE:
+		case BINDER_WORK_TRANSACTION_PENDING: {
+			if (w->type == BINDER_WORK_TRANSACTION_PENDING)
+				cmd = BR_TRANSACTION_PENDING_FROZEN;
+			else
+				cmd = BR_TRANSACTION_COMPLETE;
 			if (put_user(cmd, (uint32_t __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(uint32_t);
 
 			binder_stat_br(proc, thread, cmd);
 			binder_debug(BINDER_DEBUG_TRANSACTION_COMPLETE,
-				     "binder: %d:%d BR_TRANSACTION_COMPLETE\n",
-				     proc->pid, thread->pid);
+				     "binder: %d:%d %s\n",
+				     proc->pid, thread->pid,
+				     cmd == BR_TRANSACTION_COMPLETE ?
+				     "BR_TRANSACTION_COMPLETE" :
+				     "BR_TRANSACTION_PENDING_FROZEN");
 
 			list_del(&w->entry);
 			kfree(w);
@@ -2408,17 +2352,16 @@ retry:
 			continue;
 
 		BUG_ON(t->buffer == NULL);
+		if (t->start.tv64 && wake.tv64)
+			binder_latency_delivered(proc, t, wake);
+		if (t->sg_count)
+			binder_map_sg_objects(proc, t);
 		if (t->buffer->target_node) {
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			t->saved_priority = binder_get_priority(current);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2440,7 +2383,7 @@ retry:
 		tr.data_size = t->buffer->data_size;
 		tr.offsets_size = t->buffer->offsets_size;
 		tr.data.ptr.buffer = (void *)t->buffer->data +
-					proc->user_buffer_offset;
+					proc->alloc.user_buffer_offset;
 		tr.data.ptr.offsets = tr.data.ptr.buffer +
 					ALIGN(t->buffer->data_size,
 					    sizeof(void *));
@@ -2519,7 +2462,8 @@ static void binder_release_work(struct list_head *list)
 				binder_stats_deleted(BINDER_STAT_TRANSACTION);
 			}
 		} break;
-		case BINDER_WORK_TRANSACTION_COMPLETE: {
+		case BINDER_WORK_TRANSACTION_COMPLETE:
+		case BINDER_WORK_TRANSACTION_PENDING: {
 			binder_debug(BINDER_DEBUG_DEAD_TRANSACTION,
 				"binder: undelivered TRANSACTION_COMPLETE\n");
 			kfree(w);
@@ -2799,8 +2743,7 @@ static void binder_vma_close(struct vm_area_struct *vma)
 		     proc->pid, vma->vm_start, vma->vm_end,
 		     (vma->vm_end - vma->vm_start) / SZ_1K, vma->vm_flags,
 		     (unsigned long)pgprot_val(vma->vm_page_prot));
-	proc->vma = NULL;
-	proc->vma_vm_mm = NULL;
+	binder_alloc_vma_close(&proc->alloc);
 	binder_defer_work(proc, BINDER_DEFERRED_PUT_FILES);
 }
 
@@ -2812,10 +2755,8 @@ static struct vm_operations_struct binder_vm_ops = {
 static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	int ret;
-	struct vm_struct *area;
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
-	struct binder_buffer *buffer;
 
 	if ((vma->vm_end - vma->vm_start) > SZ_4M)
 		vma->vm_end = vma->vm_start + SZ_4M;
@@ -2832,73 +2773,15 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		goto err_bad_arg;
 	}
 	vma->vm_flags = (vma->vm_flags | VM_DONTCOPY) & ~VM_MAYWRITE;
-
-	mutex_lock(&binder_mmap_lock);
-	if (proc->buffer) {
-		ret = -EBUSY;
-		failure_string = "already mapped";
-		goto err_already_mapped;
-	}
-
-	area = get_vm_area(vma->vm_end - vma->vm_start, VM_IOREMAP);
-	if (area == NULL) {
-		ret = -ENOMEM;
-		failure_string = "get_vm_area";
-		goto err_get_vm_area_failed;
-	}
-	proc->buffer = area->addr;
-	proc->user_buffer_offset = vma->vm_start - (uintptr_t)proc->buffer;
-	mutex_unlock(&binder_mmap_lock);
-
-#ifdef CONFIG_CPU_CACHE_VIPT
-	if (cache_is_vipt_aliasing()) {
-		while (CACHE_COLOUR((vma->vm_start ^ (uint32_t)proc->buffer))) {
-			printk(KERN_INFO "binder_mmap: %d %lx-%lx maps %p bad alignment\n", proc->pid, vma->vm_start, vma->vm_end, proc->buffer);
-			vma->vm_start += PAGE_SIZE;
-		}
-	}
-#endif
-	proc->pages = kzalloc(sizeof(proc->pages[0]) * ((vma->vm_end - vma->vm_start) / PAGE_SIZE), GFP_KERNEL);
-	if (proc->pages == NULL) {
-		ret = -ENOMEM;
-		failure_string = "alloc page array";
-		goto err_alloc_pages_failed;
-	}
-	proc->buffer_size = vma->vm_end - vma->vm_start;
-
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
 
-	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + PAGE_SIZE, vma)) {
-		ret = -ENOMEM;
-		failure_string = "alloc small buf";
-		goto err_alloc_small_buf_failed;
-	}
-	buffer = proc->buffer;
-	INIT_LIST_HEAD(&proc->buffers);
-	list_add(&buffer->entry, &proc->buffers);
-	buffer->free = 1;
-	binder_insert_free_buffer(proc, buffer);
-	proc->free_async_space = proc->buffer_size / 2;
-	barrier();
+	ret = binder_alloc_mmap_handler(&proc->alloc, vma);
+	if (ret)
+		return ret;
 	proc->files = get_files_struct(proc->tsk);
-	proc->vma = vma;
-	proc->vma_vm_mm = vma->vm_mm;
-
-	/*printk(KERN_INFO "binder_mmap: %d %lx-%lx maps %p\n",
-		 proc->pid, vma->vm_start, vma->vm_end, proc->buffer);*/
 	return 0;
 
-err_alloc_small_buf_failed:
-	kfree(proc->pages);
-	proc->pages = NULL;
-err_alloc_pages_failed:
-	mutex_lock(&binder_mmap_lock);
-	vfree(proc->buffer);
-	proc->buffer = NULL;
-err_get_vm_area_failed:
-err_already_mapped:
-	mutex_unlock(&binder_mmap_lock);
 err_bad_arg:
 	printk(KERN_ERR "binder_mmap: %d %lx-%lx %s failed %d\n",
 	       proc->pid, vma->vm_start, vma->vm_end, failure_string, ret);
@@ -2919,7 +2802,9 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	binder_alloc_init(&proc->alloc, current, current->group_leader->pid);
+	proc->latency = alloc_percpu(struct binder_latency_stats);
+	proc->default_priority = binder_get_priority(current);
 	mutex_lock(&binder_lock);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
@@ -2979,10 +2864,10 @@ static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
 	struct binder_transaction *t;
+	struct binder_buffer *buffer;
 	struct rb_node *n;
 	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
 
-	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
 
 	hlist_del(&proc->proc_node);
@@ -3050,9 +2935,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->delivered_death);
 	buffers = 0;
 
-	while ((n = rb_first(&proc->allocated_buffers))) {
-		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
-							rb_node);
+	while ((buffer = binder_alloc_first_allocated(&proc->alloc))) {
 		t = buffer->transaction;
 		if (t) {
 			t->buffer = NULL;
@@ -3062,33 +2945,15 @@ static void binder_deferred_release(struct binder_proc *proc)
 			       proc->pid, t->debug_id);
 			/*BUG();*/
 		}
-		binder_free_buf(proc, buffer);
+		binder_alloc_free_buf(&proc->alloc, buffer);
 		buffers++;
 	}
 
 	binder_stats_deleted(BINDER_STAT_PROC);
 
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			if (proc->pages[i]) {
-				void *page_addr = proc->buffer + i * PAGE_SIZE;
-				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-					     "binder_release: %d: "
-					     "page %d at %p not freed\n",
-					     proc->pid, i,
-					     page_addr);
-				unmap_kernel_range((unsigned long)page_addr,
-					PAGE_SIZE);
-				__free_page(proc->pages[i]);
-				page_count++;
-			}
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
-	}
+	page_count = binder_alloc_deferred_release(&proc->alloc);
 
+	free_percpu(proc->latency);
 	put_task_struct(proc->tsk);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
@@ -3132,8 +2997,12 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_FLUSH)
 			binder_deferred_flush(proc);
 
-		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+		if (defer & BINDER_DEFERRED_RELEASE) {
+			if (proc->tmp_ref)
+				proc->release_pending = 1;
+			else
+				binder_deferred_release(proc); /* frees proc */
+		}
 
 		mutex_unlock(&binder_lock);
 		if (files)
@@ -3159,13 +3028,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3178,15 +3048,6 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 		   t->buffer->data);
 }
 
-static void print_binder_buffer(struct seq_file *m, const char *prefix,
-				struct binder_buffer *buffer)
-{
-	seq_printf(m, "%s %d: %p size %zd:%zd %s\n",
-		   prefix, buffer->debug_id, buffer->data,
-		   buffer->data_size, buffer->offsets_size,
-		   buffer->transaction ? "active" : "delivered");
-}
-
 static void print_binder_work(struct seq_file *m, const char *prefix,
 			      const char *transaction_prefix,
 			      struct binder_work *w)
@@ -3202,6 +3063,9 @@ static void print_binder_work(struct seq_file *m, const char *prefix,
 	case BINDER_WORK_TRANSACTION_COMPLETE:
 		seq_printf(m, "%stransaction complete\n", prefix);
 		break;
+	case BINDER_WORK_TRANSACTION_PENDING:
+		seq_printf(m, "%stransaction pending frozen\n", prefix);
+		break;
 	case BINDER_WORK_NODE:
 		node = container_of(w, struct binder_node, work);
 		seq_printf(m, "%snode work %d: u%p c%p\n",
@@ -3316,9 +3180,7 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
-	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
-		print_binder_buffer(m, "  buffer",
-				    rb_entry(n, struct binder_buffer, rb_node));
+	binder_alloc_print_allocated(m, &proc->alloc);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3347,7 +3209,9 @@ static const char *binder_return_strings[] = {
 	"BR_FINISHED",
 	"BR_DEAD_BINDER",
 	"BR_CLEAR_DEATH_NOTIFICATION_DONE",
-	"BR_FAILED_REPLY"
+	"BR_FAILED_REPLY",
+	"BR_FROZEN_REPLY",
+	"BR_TRANSACTION_PENDING_FROZEN"
 };
 
 static const char *binder_command_strings[] = {
@@ -3430,7 +3294,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 			"  ready threads %d\n"
 			"  free async space %zd\n", proc->requested_threads,
 			proc->requested_threads_started, proc->max_threads,
-			proc->ready_threads, proc->free_async_space);
+			proc->ready_threads, proc->alloc.free_async_space);
 	count = 0;
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n))
 		count++;
@@ -3447,10 +3311,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 	}
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
-	count = 0;
-	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
-		count++;
-	seq_printf(m, "  buffers: %d\n", count);
+	binder_alloc_print_stats(m, &proc->alloc);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3568,6 +3429,135 @@ static int binder_transaction_log_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static const char *binder_latency_strings[] = {
+	"enqueue_to_wakeup",
+	"wakeup_to_read",
+	"reply",
+};
+
+static void print_binder_latency_stats(struct seq_file *m, const char *prefix,
+				       struct binder_latency_stats __percpu *lat)
+{
+	struct binder_latency_stats sum;
+	int cpu, type, i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(binder_latency_strings) !=
+		     BINDER_LATENCY_COUNT);
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct binder_latency_stats *l = per_cpu_ptr(lat, cpu);
+
+		for (type = 0; type < BINDER_LATENCY_COUNT; type++)
+			for (i = 0; i < BINDER_LATENCY_BUCKETS; i++)
+				sum.hist[type][i] += l->hist[type][i];
+	}
+	for (type = 0; type < BINDER_LATENCY_COUNT; type++) {
+		seq_printf(m, "%s%s:", prefix, binder_latency_strings[type]);
+		for (i = 0; i < BINDER_LATENCY_BUCKETS; i++)
+			seq_printf(m, " %u", sum.hist[type][i]);
+		seq_puts(m, "\n");
+	}
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int do_lock = !binder_debug_no_lock;
+	int i;
+
+	seq_puts(m, "binder latency (us):");
+	for (i = 0; i < BINDER_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, " <%u", 1U << i);
+	seq_puts(m, " more\n");
+
+	print_binder_latency_stats(m, "", &binder_latency_stats);
+
+	if (do_lock)
+		mutex_lock(&binder_lock);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (!proc->latency)
+			continue;
+		seq_printf(m, "proc %d\n", proc->pid);
+		print_binder_latency_stats(m, "  ", proc->latency);
+	}
+	if (do_lock)
+		mutex_unlock(&binder_lock);
+	return 0;
+}
+
+/* Keeps the BINDER_HOT_COUNT entries with the highest counts, sorted. */
+static void binder_hot_insert(void **hot, unsigned int *counts,
+			      void *entry, unsigned int count)
+{
+	int i;
+
+	if (!count || count <= counts[BINDER_HOT_COUNT - 1])
+		return;
+	for (i = BINDER_HOT_COUNT - 1; i > 0 && counts[i - 1] < count; i--) {
+		hot[i] = hot[i - 1];
+		counts[i] = counts[i - 1];
+	}
+	hot[i] = entry;
+	counts[i] = count;
+}
+
+static int binder_hot_show(struct seq_file *m, void *unused)
+{
+	void *hot_nodes[BINDER_HOT_COUNT], *hot_refs[BINDER_HOT_COUNT];
+	unsigned int node_counts[BINDER_HOT_COUNT];
+	unsigned int ref_counts[BINDER_HOT_COUNT];
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	struct rb_node *n;
+	int do_lock = !binder_debug_no_lock;
+	int i;
+
+	memset(node_counts, 0, sizeof(node_counts));
+	memset(ref_counts, 0, sizeof(ref_counts));
+
+	if (do_lock)
+		mutex_lock(&binder_lock);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+			struct binder_node *node = rb_entry(n,
+					struct binder_node, rb_node);
+			binder_hot_insert(hot_nodes, node_counts, node,
+					  node->txn_count);
+		}
+		for (n = rb_first(&proc->refs_by_desc); n != NULL;
+		     n = rb_next(n)) {
+			struct binder_ref *ref = rb_entry(n,
+					struct binder_ref, rb_node_desc);
+			binder_hot_insert(hot_refs, ref_counts, ref,
+					  ref->txn_count);
+		}
+	}
+
+	seq_puts(m, "binder hot nodes:\n");
+	for (i = 0; i < BINDER_HOT_COUNT && node_counts[i]; i++) {
+		struct binder_node *node = hot_nodes[i];
+
+		seq_printf(m, "  node %d: proc %d u%p c%p transactions %u "
+			   "avg latency %llu us\n", node->debug_id,
+			   node->proc->pid, node->ptr, node->cookie,
+			   node->txn_count,
+			   div_u64(div_u64(node->txn_latency, NSEC_PER_USEC),
+				   node->txn_count));
+	}
+	seq_puts(m, "binder hot refs:\n");
+	for (i = 0; i < BINDER_HOT_COUNT && ref_counts[i]; i++) {
+		struct binder_ref *ref = hot_refs[i];
+
+		seq_printf(m, "  ref %d: proc %d desc %d node %d "
+			   "transactions %u\n", ref->debug_id, ref->proc->pid,
+			   ref->desc, ref->node->debug_id, ref->txn_count);
+	}
+	if (do_lock)
+		mutex_unlock(&binder_lock);
+	return 0;
+}
+
 static const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -3588,6 +3578,8 @@ BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
+BINDER_DEBUG_ENTRY(hot);
 
 static int __init binder_init(void)
 {
@@ -3628,6 +3620,16 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
+		debugfs_create_file("hot",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_hot_fops);
 	}
 	return ret;
 }
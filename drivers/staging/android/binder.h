@@ -32,11 +32,14 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_SG_FD	= B_PACK_CHARS('s', 'g', '*', B_TYPE_LARGE),
+	BINDER_TYPE_SG_PTR	= B_PACK_CHARS('s', 'p', '*', B_TYPE_LARGE),
 };
 
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	FLAT_BINDER_FLAG_INHERIT_RT = 0x800,
 };
 
 /*
@@ -61,6 +64,17 @@ struct flat_binder_object {
 	void			*cookie;
 };
 
+/*
+ * Large payloads can be passed by reference instead of being copied into
+ * the target's buffer: the sender puts a BINDER_TYPE_SG_FD object with an
+ * ashmem or ion fd in 'handle' and the number of bytes to share in
+ * 'cookie'.  When the transaction is read, the driver maps that much of
+ * the file read-only into the receiver and turns the object into a
+ * BINDER_TYPE_SG_PTR with the mapping address in 'binder'; the receiver
+ * owns the mapping and must munmap it.  If the file cannot be mapped the
+ * object stays a BINDER_TYPE_SG_FD carrying the receiver's fd.
+ */
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses apropriately.
@@ -249,6 +263,19 @@ enum BinderDriverReturnProtocol {
 	 * The the last transaction (either a bcTRANSACTION or
 	 * a bcATTEMPT_ACQUIRE) failed (e.g. out of memory).  No parameters.
 	 */
+
+	BR_FROZEN_REPLY = _IO('r', 18),
+	/*
+	 * The target of the last synchronous transaction is frozen by the
+	 * cgroup freezer; nothing was delivered.  No parameters.
+	 */
+
+	BR_TRANSACTION_PENDING_FROZEN = _IO('r', 19),
+	/*
+	 * Sent instead of BR_TRANSACTION_COMPLETE for a oneway transaction
+	 * to a frozen process; it is queued and delivered once the target
+	 * is thawed.  No parameters.
+	 */
 };
 
 enum BinderDriverCommandProtocol {
@@ -0,0 +1,855 @@
+/* binder_alloc.c
+ *
+ * Android IPC Subsystem
+ *
+ * Copyright (C) 2007-2008 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <asm/cacheflush.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+
+#include "binder_alloc.h"
+
+static DEFINE_MUTEX(binder_alloc_mmap_lock);
+
+enum {
+	BINDER_ALLOC_DEBUG_BUFFER_ALLOC       = 1U << 0,
+	BINDER_ALLOC_DEBUG_BUFFER_ALLOC_ASYNC = 1U << 1,
+};
+static uint32_t binder_alloc_debug_mask;
+module_param_named(debug_mask, binder_alloc_debug_mask,
+		   uint, S_IWUSR | S_IRUGO);
+
+/*
+ * Number of freed pages each process keeps mapped for reuse, and that
+ * are pre-populated when the process maps its binder area.  0 frees
+ * and unmaps pages as soon as no buffer uses them.
+ */
+static int binder_alloc_pool_pages;
+module_param_named(pool_pages, binder_alloc_pool_pages, int,
+		   S_IWUSR | S_IRUGO);
+
+/* Number of freed small buffers each process keeps for reuse */
+static int binder_alloc_small_cache = 32;
+module_param_named(small_cache, binder_alloc_small_cache, int,
+		   S_IWUSR | S_IRUGO);
+
+#define binder_alloc_debug(mask, x...) \
+	do { \
+		if (binder_alloc_debug_mask & mask) \
+			printk(KERN_INFO x); \
+	} while (0)
+
+static size_t binder_buffer_size(struct binder_alloc *alloc,
+				 struct binder_buffer *buffer)
+{
+	if (list_is_last(&buffer->entry, &alloc->buffers))
+		return alloc->buffer + alloc->buffer_size - (void *)buffer->data;
+	else
+		return (size_t)list_entry(buffer->entry.next,
+			struct binder_buffer, entry) - (size_t)buffer->data;
+}
+
+static void binder_insert_free_buffer(struct binder_alloc *alloc,
+				      struct binder_buffer *new_buffer)
+{
+	struct rb_node **p = &alloc->free_buffers.rb_node;
+	struct rb_node *parent = NULL;
+	struct binder_buffer *buffer;
+	size_t buffer_size;
+	size_t new_buffer_size;
+
+	BUG_ON(!new_buffer->free);
+
+	new_buffer_size = binder_buffer_size(alloc, new_buffer);
+
+	binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: add free buffer, size %zd, "
+		     "at %p\n", alloc->pid, new_buffer_size, new_buffer);
+
+	while (*p) {
+		parent = *p;
+		buffer = rb_entry(parent, struct binder_buffer, rb_node);
+		BUG_ON(!buffer->free);
+
+		buffer_size = binder_buffer_size(alloc, buffer);
+
+		if (new_buffer_size < buffer_size)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&new_buffer->rb_node, parent, p);
+	rb_insert_color(&new_buffer->rb_node, &alloc->free_buffers);
+}
+
+static void binder_insert_allocated_buffer(struct binder_alloc *alloc,
+					   struct binder_buffer *new_buffer)
+{
+	struct rb_node **p = &alloc->allocated_buffers.rb_node;
+	struct rb_node *parent = NULL;
+	struct binder_buffer *buffer;
+
+	BUG_ON(new_buffer->free);
+
+	while (*p) {
+		parent = *p;
+		buffer = rb_entry(parent, struct binder_buffer, rb_node);
+		BUG_ON(buffer->free);
+
+		if (new_buffer < buffer)
+			p = &parent->rb_left;
+		else if (new_buffer > buffer)
+			p = &parent->rb_right;
+		else
+			BUG();
+	}
+	rb_link_node(&new_buffer->rb_node, parent, p);
+	rb_insert_color(&new_buffer->rb_node, &alloc->allocated_buffers);
+}
+
+struct binder_buffer *binder_alloc_buffer_lookup(struct binder_alloc *alloc,
+						 void __user *user_ptr)
+{
+	struct rb_node *n;
+	struct binder_buffer *buffer;
+	struct binder_buffer *kern_ptr;
+
+	kern_ptr = user_ptr - alloc->user_buffer_offset
+		- offsetof(struct binder_buffer, data);
+
+	mutex_lock(&alloc->mutex);
+	n = alloc->allocated_buffers.rb_node;
+	while (n) {
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		BUG_ON(buffer->free);
+
+		if (kern_ptr < buffer)
+			n = n->rb_left;
+		else if (kern_ptr > buffer)
+			n = n->rb_right;
+		else
+			break;
+	}
+	mutex_unlock(&alloc->mutex);
+	return n ? buffer : NULL;
+}
+
+/*
+ * Fast path for page ranges that can be satisfied entirely from, or
+ * returned entirely to, the pool of idle mapped pages.  This avoids
+ * taking mmap_sem and touching the page tables at all.
+ */
+static int binder_pool_page_range(struct binder_alloc *alloc, int allocate,
+				  void *start, void *end)
+{
+	void *page_addr;
+	struct binder_lru_page *page;
+
+	if (allocate) {
+		for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+			page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+			if (!page->page_ptr)
+				return 0;
+		}
+		for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+			page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+			BUG_ON(list_empty(&page->lru));
+			list_del_init(&page->lru);
+			alloc->pool_count--;
+		}
+		return 1;
+	}
+
+	if (alloc->pool_count + (end - start) / PAGE_SIZE >
+	    binder_alloc_pool_pages)
+		return 0;
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+		BUG_ON(!page->page_ptr);
+		list_add(&page->lru, &alloc->pool);
+		alloc->pool_count++;
+	}
+	return 1;
+}
+
+static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
+				    void *start, void *end,
+				    struct vm_area_struct *vma)
+{
+	void *page_addr;
+	unsigned long user_page_addr;
+	struct vm_struct tmp_area;
+	struct binder_lru_page *page;
+	struct mm_struct *mm;
+
+	binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: %s pages %p-%p\n", alloc->pid,
+		     allocate ? "allocate" : "free", start, end);
+
+	if (end <= start)
+		return 0;
+
+	if (binder_pool_page_range(alloc, allocate, start, end))
+		return 0;
+
+	if (vma)
+		mm = NULL;
+	else
+		mm = get_task_mm(alloc->tsk);
+
+	if (mm) {
+		down_write(&mm->mmap_sem);
+		vma = alloc->vma;
+		if (vma && mm != alloc->vma_vm_mm) {
+			pr_err("binder: %d: vma mm and task mm mismatch\n",
+				alloc->pid);
+			vma = NULL;
+		}
+	}
+
+	if (allocate == 0)
+		goto free_range;
+
+	if (vma == NULL) {
+		printk(KERN_ERR "binder: %d: binder_alloc_buf failed to "
+		       "map pages in userspace, no vma\n", alloc->pid);
+		goto err_no_vma;
+	}
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		int ret;
+		struct page **page_array_ptr;
+		page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+
+		if (page->page_ptr) {
+			/* idle page left mapped by an earlier free */
+			BUG_ON(list_empty(&page->lru));
+			list_del_init(&page->lru);
+			alloc->pool_count--;
+			continue;
+		}
+		page->page_ptr = alloc_page(GFP_KERNEL | __GFP_HIGHMEM |
+					    __GFP_ZERO);
+		if (page->page_ptr == NULL) {
+			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
+			       "for page at %p\n", alloc->pid, page_addr);
+			goto err_alloc_page_failed;
+		}
+		tmp_area.addr = page_addr;
+		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
+		page_array_ptr = &page->page_ptr;
+		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
+		if (ret) {
+			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
+			       "to map page at %p in kernel\n",
+			       alloc->pid, page_addr);
+			goto err_map_kernel_failed;
+		}
+		user_page_addr =
+			(uintptr_t)page_addr + alloc->user_buffer_offset;
+		ret = vm_insert_page(vma, user_page_addr, page->page_ptr);
+		if (ret) {
+			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
+			       "to map page at %lx in userspace\n",
+			       alloc->pid, user_page_addr);
+			goto err_vm_insert_page_failed;
+		}
+		/* vm_insert_page does not seem to increment the refcount */
+	}
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+	return 0;
+
+free_range:
+	for (page_addr = end - PAGE_SIZE; page_addr >= start;
+	     page_addr -= PAGE_SIZE) {
+		page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+		if (alloc->pool_count < binder_alloc_pool_pages) {
+			list_add(&page->lru, &alloc->pool);
+			alloc->pool_count++;
+			continue;
+		}
+		if (vma)
+			zap_page_range(vma, (uintptr_t)page_addr +
+				alloc->user_buffer_offset, PAGE_SIZE, NULL);
+err_vm_insert_page_failed:
+		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+err_map_kernel_failed:
+		__free_page(page->page_ptr);
+		page->page_ptr = NULL;
+err_alloc_page_failed:
+		;
+	}
+err_no_vma:
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+	return -ENOMEM;
+}
+
+static int binder_small_class(size_t size)
+{
+	int class = 0;
+
+	while (class < BINDER_ALLOC_SMALL_CLASSES - 1 &&
+	       size >= (BINDER_ALLOC_SMALL_MIN << (class + 1)))
+		class++;
+	return class;
+}
+
+static struct binder_buffer *binder_alloc_cached_buf(struct binder_alloc *alloc,
+						     size_t size)
+{
+	struct binder_buffer *buffer;
+	int class;
+
+	if (size > BINDER_ALLOC_SMALL_MAX || !alloc->small_count)
+		return NULL;
+
+	/* every buffer on a class list is at least that class in size */
+	for (class = binder_small_class(size);
+	     class < BINDER_ALLOC_SMALL_CLASSES; class++) {
+		if (size > (BINDER_ALLOC_SMALL_MIN << class))
+			continue;
+		if (list_empty(&alloc->small_free[class]))
+			continue;
+		buffer = list_first_entry(&alloc->small_free[class],
+					  struct binder_buffer, cache_entry);
+		list_del(&buffer->cache_entry);
+		alloc->small_count--;
+		buffer->cached = 0;
+		return buffer;
+	}
+	return NULL;
+}
+
+static void binder_alloc_drain_cache(struct binder_alloc *alloc);
+
+static struct binder_buffer *binder_alloc_best_fit(struct binder_alloc *alloc,
+						   size_t size)
+{
+	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct binder_buffer *buffer;
+	size_t buffer_size;
+	struct rb_node *best_fit = NULL;
+	void *has_page_addr;
+	void *end_page_addr;
+
+	while (n) {
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		BUG_ON(!buffer->free);
+		buffer_size = binder_buffer_size(alloc, buffer);
+
+		if (size < buffer_size) {
+			best_fit = n;
+			n = n->rb_left;
+		} else if (size > buffer_size)
+			n = n->rb_right;
+		else {
+			best_fit = n;
+			break;
+		}
+	}
+	if (best_fit == NULL)
+		return NULL;
+	if (n == NULL) {
+		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
+		buffer_size = binder_buffer_size(alloc, buffer);
+	}
+
+	binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: binder_alloc_buf size %zd got buff"
+		     "er %p size %zd\n", alloc->pid, size, buffer, buffer_size);
+
+	has_page_addr =
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
+	if (n == NULL) {
+		if (size + sizeof(struct binder_buffer) + 4 >= buffer_size)
+			buffer_size = size; /* no room for other buffers */
+		else
+			buffer_size = size + sizeof(struct binder_buffer);
+	}
+	end_page_addr =
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data + buffer_size);
+	if (end_page_addr > has_page_addr)
+		end_page_addr = has_page_addr;
+	if (binder_update_page_range(alloc, 1,
+	    (void *)PAGE_ALIGN((uintptr_t)buffer->data), end_page_addr, NULL))
+		return NULL;
+
+	rb_erase(best_fit, &alloc->free_buffers);
+	buffer->free = 0;
+	if (buffer_size != size) {
+		struct binder_buffer *new_buffer = (void *)buffer->data + size;
+		list_add(&new_buffer->entry, &buffer->entry);
+		new_buffer->free = 1;
+		new_buffer->cached = 0;
+		binder_insert_free_buffer(alloc, new_buffer);
+	}
+	return buffer;
+}
+
+static struct binder_buffer *__binder_alloc_new_buf(struct binder_alloc *alloc,
+						    size_t data_size,
+						    size_t offsets_size,
+						    int is_async)
+{
+	struct binder_buffer *buffer;
+	size_t size;
+
+	if (alloc->vma == NULL) {
+		printk(KERN_ERR "binder: %d: binder_alloc_buf, no vma\n",
+		       alloc->pid);
+		return NULL;
+	}
+
+	size = ALIGN(data_size, sizeof(void *)) +
+		ALIGN(offsets_size, sizeof(void *));
+
+	if (size < data_size || size < offsets_size) {
+		printk(KERN_INFO "binder: %d: got transaction with invalid "
+			"size %zd-%zd\n", alloc->pid, data_size, offsets_size);
+		return NULL;
+	}
+
+	if (is_async &&
+	    alloc->free_async_space < size + sizeof(struct binder_buffer)) {
+		binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: binder_alloc_buf size %zd"
+			     "failed, no async space left\n", alloc->pid, size);
+		return NULL;
+	}
+
+	buffer = binder_alloc_cached_buf(alloc, size);
+	if (buffer == NULL)
+		buffer = binder_alloc_best_fit(alloc, size);
+	if (buffer == NULL && alloc->small_count) {
+		/* cached small buffers may be what fragments the space */
+		binder_alloc_drain_cache(alloc);
+		buffer = binder_alloc_best_fit(alloc, size);
+	}
+	if (buffer == NULL) {
+		printk(KERN_ERR "binder: %d: binder_alloc_buf size %zd failed, "
+		       "no address space\n", alloc->pid, size);
+		return NULL;
+	}
+
+	buffer->allow_user_free = 0;
+	binder_insert_allocated_buffer(alloc, buffer);
+	binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: binder_alloc_buf size %zd got "
+		     "%p\n", alloc->pid, size, buffer);
+	buffer->data_size = data_size;
+	buffer->offsets_size = offsets_size;
+	buffer->async_transaction = is_async;
+	if (is_async) {
+		alloc->free_async_space -= size + sizeof(struct binder_buffer);
+		binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC_ASYNC,
+			     "binder: %d: binder_alloc_buf size %zd "
+			     "async free %zd\n", alloc->pid, size,
+			     alloc->free_async_space);
+	}
+
+	return buffer;
+}
+
+struct binder_buffer *binder_alloc_new_buf(struct binder_alloc *alloc,
+					   size_t data_size,
+					   size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&alloc->mutex);
+	buffer = __binder_alloc_new_buf(alloc, data_size, offsets_size,
+					is_async);
+	mutex_unlock(&alloc->mutex);
+	return buffer;
+}
+
+static void *buffer_start_page(struct binder_buffer *buffer)
+{
+	return (void *)((uintptr_t)buffer & PAGE_MASK);
+}
+
+static void *buffer_end_page(struct binder_buffer *buffer)
+{
+	return (void *)(((uintptr_t)(buffer + 1) - 1) & PAGE_MASK);
+}
+
+static void binder_delete_free_buffer(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer)
+{
+	struct binder_buffer *prev, *next = NULL;
+	int free_page_end = 1;
+	int free_page_start = 1;
+
+	BUG_ON(alloc->buffers.next == &buffer->entry);
+	prev = list_entry(buffer->entry.prev, struct binder_buffer, entry);
+	BUG_ON(!prev->free);
+	if (buffer_end_page(prev) == buffer_start_page(buffer)) {
+		free_page_start = 0;
+		if (buffer_end_page(prev) == buffer_end_page(buffer))
+			free_page_end = 0;
+		binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: merge free, buffer %p "
+			     "share page with %p\n", alloc->pid, buffer, prev);
+	}
+
+	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
+		next = list_entry(buffer->entry.next,
+				  struct binder_buffer, entry);
+		if (buffer_start_page(next) == buffer_end_page(buffer)) {
+			free_page_end = 0;
+			if (buffer_start_page(next) ==
+			    buffer_start_page(buffer))
+				free_page_start = 0;
+			binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+				     "binder: %d: merge free, buffer"
+				     " %p share page with %p\n", alloc->pid,
+				     buffer, prev);
+		}
+	}
+	list_del(&buffer->entry);
+	if (free_page_start || free_page_end) {
+		binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: merge free, buffer %p do "
+			     "not share page%s%s with with %p or %p\n",
+			     alloc->pid, buffer, free_page_start ? "" : " end",
+			     free_page_end ? "" : " start", prev, next);
+		binder_update_page_range(alloc, 0, free_page_start ?
+			buffer_start_page(buffer) : buffer_end_page(buffer),
+			(free_page_end ? buffer_end_page(buffer) :
+			buffer_start_page(buffer)) + PAGE_SIZE, NULL);
+	}
+}
+
+/* Returns the buffer to the free rbtree, merging it with its neighbours. */
+static void binder_release_buf(struct binder_alloc *alloc,
+			       struct binder_buffer *buffer)
+{
+	size_t buffer_size = binder_buffer_size(alloc, buffer);
+
+	binder_update_page_range(alloc, 0,
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
+		NULL);
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
+		struct binder_buffer *next = list_entry(buffer->entry.next,
+						struct binder_buffer, entry);
+		if (next->free) {
+			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_delete_free_buffer(alloc, next);
+		}
+	}
+	if (alloc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = list_entry(buffer->entry.prev,
+						struct binder_buffer, entry);
+		if (prev->free) {
+			binder_delete_free_buffer(alloc, buffer);
+			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(alloc, buffer);
+}
+
+static void binder_alloc_drain_cache(struct binder_alloc *alloc)
+{
+	struct binder_buffer *buffer;
+	int class;
+
+	for (class = 0; class < BINDER_ALLOC_SMALL_CLASSES; class++) {
+		while (!list_empty(&alloc->small_free[class])) {
+			buffer = list_first_entry(&alloc->small_free[class],
+						  struct binder_buffer,
+						  cache_entry);
+			list_del(&buffer->cache_entry);
+			buffer->cached = 0;
+			binder_release_buf(alloc, buffer);
+		}
+	}
+	alloc->small_count = 0;
+}
+
+static void __binder_alloc_free_buf(struct binder_alloc *alloc,
+				    struct binder_buffer *buffer)
+{
+	size_t size, buffer_size;
+
+	buffer_size = binder_buffer_size(alloc, buffer);
+
+	size = ALIGN(buffer->data_size, sizeof(void *)) +
+		ALIGN(buffer->offsets_size, sizeof(void *));
+
+	binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: binder_free_buf %p size %zd buffer"
+		     "_size %zd\n", alloc->pid, buffer, size, buffer_size);
+
+	BUG_ON(buffer->free);
+	BUG_ON(buffer->cached);
+	BUG_ON(size > buffer_size);
+	BUG_ON(buffer->transaction != NULL);
+	BUG_ON((void *)buffer < alloc->buffer);
+	BUG_ON((void *)buffer > alloc->buffer + alloc->buffer_size);
+
+	if (buffer->async_transaction) {
+		alloc->free_async_space += size + sizeof(struct binder_buffer);
+
+		binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC_ASYNC,
+			     "binder: %d: binder_free_buf size %zd "
+			     "async free %zd\n", alloc->pid, size,
+			     alloc->free_async_space);
+	}
+
+	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
+
+	/*
+	 * Keep small buffers, with their pages still mapped, for the next
+	 * small transaction instead of merging them back.
+	 */
+	if (buffer_size >= BINDER_ALLOC_SMALL_MIN &&
+	    buffer_size < 2 * BINDER_ALLOC_SMALL_MAX &&
+	    alloc->small_count < binder_alloc_small_cache) {
+		buffer->cached = 1;
+		list_add(&buffer->cache_entry,
+			 &alloc->small_free[binder_small_class(buffer_size)]);
+		alloc->small_count++;
+		return;
+	}
+	binder_release_buf(alloc, buffer);
+}
+
+void binder_alloc_free_buf(struct binder_alloc *alloc,
+			   struct binder_buffer *buffer)
+{
+	mutex_lock(&alloc->mutex);
+	__binder_alloc_free_buf(alloc, buffer);
+	mutex_unlock(&alloc->mutex);
+}
+
+int binder_alloc_mmap_handler(struct binder_alloc *alloc,
+			      struct vm_area_struct *vma)
+{
+	int ret;
+	struct vm_struct *area;
+	const char *failure_string;
+	struct binder_buffer *buffer;
+	size_t prepopulate;
+	int i;
+
+	mutex_lock(&binder_alloc_mmap_lock);
+	if (alloc->buffer) {
+		ret = -EBUSY;
+		failure_string = "already mapped";
+		goto err_already_mapped;
+	}
+
+	area = get_vm_area(vma->vm_end - vma->vm_start, VM_IOREMAP);
+	if (area == NULL) {
+		ret = -ENOMEM;
+		failure_string = "get_vm_area";
+		goto err_get_vm_area_failed;
+	}
+	alloc->buffer = area->addr;
+	alloc->user_buffer_offset = vma->vm_start - (uintptr_t)alloc->buffer;
+	mutex_unlock(&binder_alloc_mmap_lock);
+
+#ifdef CONFIG_CPU_CACHE_VIPT
+	if (cache_is_vipt_aliasing()) {
+		while (CACHE_COLOUR((vma->vm_start ^ (uint32_t)alloc->buffer))) {
+			printk(KERN_INFO "binder_mmap: %d %lx-%lx maps %p bad alignment\n", alloc->pid, vma->vm_start, vma->vm_end, alloc->buffer);
+			vma->vm_start += PAGE_SIZE;
+		}
+	}
+#endif
+	alloc->pages = kzalloc(sizeof(alloc->pages[0]) * ((vma->vm_end - vma->vm_start) / PAGE_SIZE), GFP_KERNEL);
+	if (alloc->pages == NULL) {
+		ret = -ENOMEM;
+		failure_string = "alloc page array";
+		goto err_alloc_pages_failed;
+	}
+	alloc->buffer_size = vma->vm_end - vma->vm_start;
+	for (i = 0; i < alloc->buffer_size / PAGE_SIZE; i++)
+		INIT_LIST_HEAD(&alloc->pages[i].lru);
+
+	if (binder_update_page_range(alloc, 1, alloc->buffer, alloc->buffer + PAGE_SIZE, vma)) {
+		ret = -ENOMEM;
+		failure_string = "alloc small buf";
+		goto err_alloc_small_buf_failed;
+	}
+
+	/*
+	 * Map the pool up front, so the first transactions do not have
+	 * to.  Failing to do so is not fatal.
+	 */
+	prepopulate = 0;
+	if (binder_alloc_pool_pages > 0)
+		prepopulate = min_t(size_t, binder_alloc_pool_pages,
+				    alloc->buffer_size / PAGE_SIZE - 1);
+	prepopulate *= PAGE_SIZE;
+	if (prepopulate &&
+	    !binder_update_page_range(alloc, 1, alloc->buffer + PAGE_SIZE,
+				      alloc->buffer + PAGE_SIZE + prepopulate,
+				      vma))
+		binder_update_page_range(alloc, 0, alloc->buffer + PAGE_SIZE,
+					 alloc->buffer + PAGE_SIZE + prepopulate,
+					 vma);
+
+	buffer = alloc->buffer;
+	INIT_LIST_HEAD(&alloc->buffers);
+	list_add(&buffer->entry, &alloc->buffers);
+	buffer->free = 1;
+	buffer->cached = 0;
+	binder_insert_free_buffer(alloc, buffer);
+	alloc->free_async_space = alloc->buffer_size / 2;
+	barrier();
+	alloc->vma = vma;
+	alloc->vma_vm_mm = vma->vm_mm;
+
+	return 0;
+
+err_alloc_small_buf_failed:
+	kfree(alloc->pages);
+	alloc->pages = NULL;
+err_alloc_pages_failed:
+	mutex_lock(&binder_alloc_mmap_lock);
+	vfree(alloc->buffer);
+	alloc->buffer = NULL;
+err_get_vm_area_failed:
+err_already_mapped:
+	mutex_unlock(&binder_alloc_mmap_lock);
+	printk(KERN_ERR "binder_mmap: %d %lx-%lx %s failed %d\n",
+	       alloc->pid, vma->vm_start, vma->vm_end, failure_string, ret);
+	return ret;
+}
+
+void binder_alloc_vma_close(struct binder_alloc *alloc)
+{
+	alloc->vma = NULL;
+	alloc->vma_vm_mm = NULL;
+}
+
+struct binder_buffer *binder_alloc_first_allocated(struct binder_alloc *alloc)
+{
+	struct rb_node *n;
+
+	mutex_lock(&alloc->mutex);
+	n = rb_first(&alloc->allocated_buffers);
+	mutex_unlock(&alloc->mutex);
+	return n ? rb_entry(n, struct binder_buffer, rb_node) : NULL;
+}
+
+/*
+ * Frees the whole area once the owning process is gone and no buffers
+ * are allocated any more.  Returns the number of pages that were still
+ * backing buffers.
+ */
+int binder_alloc_deferred_release(struct binder_alloc *alloc)
+{
+	int page_count = 0;
+	int i;
+
+	BUG_ON(alloc->vma);
+	BUG_ON(!RB_EMPTY_ROOT(&alloc->allocated_buffers));
+
+	mutex_lock(&alloc->mutex);
+	binder_alloc_drain_cache(alloc);
+	if (alloc->pages) {
+		for (i = 0; i < alloc->buffer_size / PAGE_SIZE; i++) {
+			struct binder_lru_page *page = &alloc->pages[i];
+			void *page_addr;
+
+			if (!page->page_ptr)
+				continue;
+			page_addr = alloc->buffer + i * PAGE_SIZE;
+			if (list_empty(&page->lru)) {
+				binder_alloc_debug(BINDER_ALLOC_DEBUG_BUFFER_ALLOC,
+					     "binder_release: %d: "
+					     "page %d at %p not freed\n",
+					     alloc->pid, i, page_addr);
+				page_count++;
+			} else
+				list_del_init(&page->lru);
+			unmap_kernel_range((unsigned long)page_addr,
+				PAGE_SIZE);
+			__free_page(page->page_ptr);
+		}
+		alloc->pool_count = 0;
+		kfree(alloc->pages);
+		vfree(alloc->buffer);
+	}
+	mutex_unlock(&alloc->mutex);
+	return page_count;
+}
+
+static void print_binder_buffer(struct seq_file *m, const char *prefix,
+				struct binder_buffer *buffer)
+{
+	seq_printf(m, "%s %d: %p size %zd:%zd %s\n",
+		   prefix, buffer->debug_id, buffer->data,
+		   buffer->data_size, buffer->offsets_size,
+		   buffer->transaction ? "active" : "delivered");
+}
+
+void binder_alloc_print_allocated(struct seq_file *m,
+				  struct binder_alloc *alloc)
+{
+	struct rb_node *n;
+
+	mutex_lock(&alloc->mutex);
+	for (n = rb_first(&alloc->allocated_buffers); n != NULL; n = rb_next(n))
+		print_binder_buffer(m, "  buffer",
+				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&alloc->mutex);
+}
+
+void binder_alloc_print_stats(struct seq_file *m, struct binder_alloc *alloc)
+{
+	struct rb_node *n;
+	int count = 0;
+
+	mutex_lock(&alloc->mutex);
+	for (n = rb_first(&alloc->allocated_buffers); n != NULL; n = rb_next(n))
+		count++;
+	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  cached small buffers: %d\n", alloc->small_count);
+	seq_printf(m, "  pool pages: %d\n", alloc->pool_count);
+	mutex_unlock(&alloc->mutex);
+}
+
+void binder_alloc_init(struct binder_alloc *alloc, struct task_struct *tsk,
+		       int pid)
+{
+	int class;
+
+	mutex_init(&alloc->mutex);
+	alloc->tsk = tsk;
+	alloc->pid = pid;
+	INIT_LIST_HEAD(&alloc->buffers);
+	INIT_LIST_HEAD(&alloc->pool);
+	for (class = 0; class < BINDER_ALLOC_SMALL_CLASSES; class++)
+		INIT_LIST_HEAD(&alloc->small_free[class]);
+}
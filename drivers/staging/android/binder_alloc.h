@@ -0,0 +1,110 @@
+/* binder_alloc.h
+ *
+ * Android IPC Subsystem
+ *
+ * Copyright (C) 2007-2008 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _LINUX_BINDER_ALLOC_H
+#define _LINUX_BINDER_ALLOC_H
+
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+
+struct binder_transaction;
+struct binder_node;
+
+/*
+ * Small transactions are served from per-size-class lists of buffers
+ * whose pages are still mapped, instead of going through the best-fit
+ * search and the page mapping code.  Classes are powers of two from
+ * BINDER_ALLOC_SMALL_MIN up to BINDER_ALLOC_SMALL_MAX.
+ */
+#define BINDER_ALLOC_SMALL_MIN		32
+#define BINDER_ALLOC_SMALL_MAX		256
+#define BINDER_ALLOC_SMALL_CLASSES	4
+
+struct binder_buffer {
+	struct list_head entry; /* free and allocated entries by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head cache_entry; /* cached small entry */
+	};
+	unsigned free:1;
+	unsigned allow_user_free:1;
+	unsigned async_transaction:1;
+	unsigned cached:1;
+	unsigned debug_id:28;
+
+	struct binder_transaction *transaction;
+
+	struct binder_node *target_node;
+	size_t data_size;
+	size_t offsets_size;
+	uint8_t data[0];
+};
+
+struct binder_lru_page {
+	struct list_head lru;	/* on binder_alloc.pool while idle */
+	struct page *page_ptr;
+};
+
+struct binder_alloc {
+	struct mutex mutex;
+	struct task_struct *tsk;
+	int pid;
+	struct vm_area_struct *vma;
+	struct mm_struct *vma_vm_mm;
+	void *buffer;
+	ptrdiff_t user_buffer_offset;
+
+	struct list_head buffers;
+	struct rb_root free_buffers;
+	struct rb_root allocated_buffers;
+	struct list_head small_free[BINDER_ALLOC_SMALL_CLASSES];
+	int small_count;
+	size_t free_async_space;
+
+	struct binder_lru_page *pages;
+	struct list_head pool;	/* mapped pages not backing any buffer */
+	int pool_count;
+	size_t buffer_size;
+};
+
+extern void binder_alloc_init(struct binder_alloc *alloc,
+			      struct task_struct *tsk, int pid);
+extern int binder_alloc_mmap_handler(struct binder_alloc *alloc,
+				     struct vm_area_struct *vma);
+extern void binder_alloc_vma_close(struct binder_alloc *alloc);
+extern struct binder_buffer *binder_alloc_new_buf(struct binder_alloc *alloc,
+						  size_t data_size,
+						  size_t offsets_size,
+						  int is_async);
+extern void binder_alloc_free_buf(struct binder_alloc *alloc,
+				  struct binder_buffer *buffer);
+extern struct binder_buffer *binder_alloc_buffer_lookup(
+		struct binder_alloc *alloc, void __user *user_ptr);
+extern struct binder_buffer *binder_alloc_first_allocated(
+		struct binder_alloc *alloc);
+extern int binder_alloc_deferred_release(struct binder_alloc *alloc);
+extern void binder_alloc_print_allocated(struct seq_file *m,
+					 struct binder_alloc *alloc);
+extern void binder_alloc_print_stats(struct seq_file *m,
+				     struct binder_alloc *alloc);
+
+#endif /* _LINUX_BINDER_ALLOC_H */
@@ -25,26 +25,45 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/*
+ * struct logger_ring - one CPU's share of a log
+ *
+ * Positions are free running byte counts, reduced modulo 'size' only when the
+ * buffer is accessed, and always sit on an entry boundary.  Only writers on
+ * the owning CPU, with preemption disabled, ever move 'head' and 'tail', so
+ * no lock is needed against other writers.  Readers on any CPU copy entries
+ * out locklessly and then check 'tail' to find out whether they were lapped
+ * while copying: a writer publishes the new 'tail' before reusing the space.
+ */
+struct logger_ring {
+	unsigned char		*buffer;/* the ring buffer itself */
+	size_t			size;	/* size of the ring, a power of two */
+	unsigned long		head;	/* end of the newest complete entry */
+	unsigned long		tail;	/* start of the oldest entry */
+	unsigned long		start;	/* new readers start here */
+};
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting.  Writers never take 'mutex'; it
+ * serializes readers, the readers list and the rings' 'start' positions.
  */
 struct logger_log {
-	unsigned char		*buffer;/* the ring buffer itself */
+	struct logger_ring __percpu *rings; /* per-CPU ring buffers */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
-	size_t			w_off;	/* current write head offset */
-	size_t			head;	/* new readers start here */
-	size_t			size;	/* size of the log */
+	struct mutex		mutex;	/* mutex protecting readers */
+	size_t			size;	/* size of the log, all rings */
 };
 
 /*
@@ -56,17 +75,20 @@ struct logger_log {
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
-	size_t			r_off;	/* current read head offset */
+	unsigned long		*r_pos;	/* read position in each CPU's ring */
+	unsigned char		*r_buf;	/* bounce buffer for one entry */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
 };
 
-/* logger_offset - returns index 'n' into the log via (optimized) modulus */
-size_t logger_offset(struct logger_log *log, size_t n)
-{
-	return n & (log->size-1);
-}
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
+/* Smallest per-CPU ring, so that a ring always holds a few entries */
+#define LOGGER_RING_MIN_SIZE	(16 * 1024)
 
+/* Entries up to this size are staged on the writer's stack */
+#define LOGGER_STACK_ENTRY_LEN	256
 
 /*
  * file_get_log - Given a file structure, return the associated log
@@ -91,44 +113,179 @@ static inline struct logger_log *file_get_log(struct file *file)
 		return file->private_data;
 }
 
+/* ring_copy_out - copies 'len' bytes at position 'pos' out of 'ring' */
+static void ring_copy_out(struct logger_ring *ring, unsigned long pos,
+			  void *dst, size_t len)
+{
+	size_t off = pos & (ring->size - 1);
+	size_t n = min(len, ring->size - off);
+
+	memcpy(dst, ring->buffer + off, n);
+	if (n != len)
+		memcpy(dst + n, ring->buffer, len - n);
+}
+
+/* ring_copy_in - copies 'len' bytes into 'ring' at position 'pos' */
+static void ring_copy_in(struct logger_ring *ring, unsigned long pos,
+			 const void *src, size_t len)
+{
+	size_t off = pos & (ring->size - 1);
+	size_t n = min(len, ring->size - off);
+
+	memcpy(ring->buffer + off, src, n);
+	if (n != len)
+		memcpy(ring->buffer, src + n, len - n);
+}
+
 /*
- * get_entry_header - returns a pointer to the logger_entry header within
- * 'log' starting at offset 'off'. A temporary logger_entry 'scratch' must
- * be provided. Typically the return value will be a pointer within
- * 'logger->buf'.  However, a pointer to 'scratch' may be returned if
- * the log entry spans the end and beginning of the circular buffer.
+ * ring_clamp - pulls '*pos' forward to the oldest entry if the writer lapped
+ * it, and returns the current head of 'ring'.
  */
-static struct logger_entry *get_entry_header(struct logger_log *log,
-		size_t off, struct logger_entry *scratch)
+static unsigned long ring_clamp(struct logger_ring *ring, unsigned long *pos)
 {
-	size_t len = min(sizeof(struct logger_entry), log->size - off);
-	if (len != sizeof(struct logger_entry)) {
-		memcpy(((void *) scratch), log->buffer + off, len);
-		memcpy(((void *) scratch) + len, log->buffer,
-			sizeof(struct logger_entry) - len);
-		return scratch;
+	unsigned long head, tail;
+
+	tail = ACCESS_ONCE(ring->tail);
+	smp_rmb();
+	head = ACCESS_ONCE(ring->head);
+	smp_rmb();
+
+	if (head - *pos > head - tail)
+		*pos = tail;
+
+	return head;
+}
+
+/*
+ * ring_pos_valid - after copying data at 'pos' out of 'ring', checks that
+ * the writer did not reuse that space while we were copying.
+ */
+static inline bool ring_pos_valid(struct logger_ring *ring,
+				  unsigned long pos)
+{
+	smp_rmb();
+	return (long) (pos - ACCESS_ONCE(ring->tail)) >= 0;
+}
+
+/*
+ * ring_peek - copies the header of the entry at '*pos' into 'entry'.
+ *
+ * Returns zero on success and -EAGAIN if there is nothing left to read.
+ * '*pos' is pulled forward if the reader was lapped.
+ */
+static int ring_peek(struct logger_ring *ring, unsigned long *pos,
+		     struct logger_entry *entry)
+{
+	unsigned long head;
+
+	do {
+		head = ring_clamp(ring, pos);
+		if (*pos == head)
+			return -EAGAIN;
+		ring_copy_out(ring, *pos, entry, sizeof(struct logger_entry));
+	} while (!ring_pos_valid(ring, *pos));
+
+	/* a valid header always describes an entry that ends by 'head' */
+	WARN_ON(entry->len > LOGGER_ENTRY_MAX_PAYLOAD ||
+		head - *pos < sizeof(struct logger_entry) + entry->len);
+
+	return 0;
+}
+
+/*
+ * ring_write - appends the 'len' byte entry 'entry' to 'ring', dropping the
+ * oldest entries as needed to make room.
+ *
+ * The caller must run on the CPU owning 'ring' with preemption disabled.
+ */
+static void ring_write(struct logger_ring *ring, const void *entry,
+		       size_t len)
+{
+	unsigned long head = ring->head;
+	unsigned long tail = ring->tail;
+
+	if (head + len - tail > ring->size) {
+		do {
+			struct logger_entry scratch;
+
+			ring_copy_out(ring, tail, &scratch,
+				      sizeof(struct logger_entry));
+			tail += sizeof(struct logger_entry) + scratch.len;
+		} while (head + len - tail > ring->size);
+
+		/* readers must see the new tail before we reuse the space */
+		ACCESS_ONCE(ring->tail) = tail;
+		smp_wmb();
 	}
 
-	return (struct logger_entry *) (log->buffer + off);
+	ring_copy_in(ring, head, entry, len);
+
+	/* the entry must be complete before readers can see it */
+	smp_wmb();
+	ACCESS_ONCE(ring->head) = head + len;
+}
+
+/* entry_before - is 'a' older than 'b'? */
+static inline bool entry_before(struct logger_entry *a, struct logger_entry *b)
+{
+	if (a->sec != b->sec)
+		return a->sec < b->sec;
+	return a->nsec < b->nsec;
 }
 
 /*
- * get_entry_msg_len - Grabs the length of the message of the entry
- * starting from from 'off'.
+ * logger_next_entry - finds the oldest entry 'reader' may read, merging the
+ * rings of all CPUs by timestamp.  Copies its header into 'entry' and returns
+ * the CPU whose ring holds it, or -1 if there is nothing to read.  Entries
+ * the reader may not read are skipped.
  *
- * An entry length is 2 bytes (16 bits) in host endian order.
- * In the log, the length does not include the size of the log entry structure.
- * This function returns the size including the log entry structure.
+ * Caller must hold log->mutex.
+ */
+static int logger_next_entry(struct logger_reader *reader,
+			     struct logger_entry *entry)
+{
+	struct logger_log *log = reader->log;
+	uid_t euid = current_euid();
+	int cpu, best = -1;
+
+	for_each_possible_cpu(cpu) {
+		struct logger_ring *ring = per_cpu_ptr(log->rings, cpu);
+		unsigned long *pos = &reader->r_pos[cpu];
+		struct logger_entry scratch;
+		int ret;
+
+		while (!(ret = ring_peek(ring, pos, &scratch))) {
+			if (reader->r_all || scratch.euid == euid)
+				break;
+			*pos += sizeof(struct logger_entry) + scratch.len;
+		}
+		if (ret)
+			continue;
+
+		if (best < 0 || entry_before(&scratch, entry)) {
+			*entry = scratch;
+			best = cpu;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * logger_fetch_entry - copies the 'len' byte entry at the reader's position
+ * in the ring of 'cpu' into its bounce buffer.  Returns false if the writer
+ * lapped the reader in the meantime and the entry is gone.
  *
- * Caller needs to hold log->mutex.
+ * Caller must hold log->mutex.
  */
-static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
+static bool logger_fetch_entry(struct logger_reader *reader, int cpu,
+			       size_t len)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
+	struct logger_ring *ring = per_cpu_ptr(reader->log->rings, cpu);
+	unsigned long pos = reader->r_pos[cpu];
 
-	entry = get_entry_header(log, off, &scratch);
-	return entry->len;
+	ring_copy_out(ring, pos, reader->r_buf, len);
+	return ring_pos_valid(ring, pos);
 }
 
 static size_t get_user_hdr_len(int ver)
@@ -164,79 +321,32 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log_to_user - copies the entry in the reader's bounce buffer, of
+ * exactly 'count' bytes in the reader's ABI version, into the user-space
+ * buffer 'buf'. Returns 'count' on success.
  *
  * Caller must hold log->mutex.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
+static ssize_t do_read_log_to_user(struct logger_reader *reader,
 				   char __user *buf,
 				   size_t count)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
-	size_t len;
-	size_t msg_start;
+	struct logger_entry *entry = (struct logger_entry *) reader->r_buf;
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
 
 	/*
 	 * First, copy the header to userspace, using the version of
 	 * the header requested
 	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
 	if (copy_header_to_user(reader->r_ver, entry, buf))
 		return -EFAULT;
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(log,
-		reader->r_off + sizeof(struct logger_entry));
-
-	/*
-	 * We read from the msg in two disjoint operations. First, we read from
-	 * the current msg head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
-	 */
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
+	/* then the msg, which follows the header in the bounce buffer */
+	if (copy_to_user(buf + hdr_len, reader->r_buf +
+			 sizeof(struct logger_entry), count - hdr_len))
 		return -EFAULT;
 
-	/*
-	 * Second, we read any remaining bytes, starting back at the head of
-	 * the log.
-	 */
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
-
-	reader->r_off = logger_offset(log, reader->r_off +
-		sizeof(struct logger_entry) + count);
-
-	return count + get_user_hdr_len(reader->r_ver);
-}
-
-/*
- * get_next_entry_by_uid - Starting at 'off', returns an offset into
- * 'log->buffer' which contains the first entry readable by 'euid'
- */
-static size_t get_next_entry_by_uid(struct logger_log *log,
-		size_t off, uid_t euid)
-{
-	while (off != log->w_off) {
-		struct logger_entry *entry;
-		struct logger_entry scratch;
-		size_t next_len;
-
-		entry = get_entry_header(log, off, &scratch);
-
-		if (entry->euid == euid)
-			return off;
-
-		next_len = sizeof(struct logger_entry) + entry->len;
-		off = logger_offset(log, off + next_len);
-	}
-
-	return off;
+	return count;
 }
 
 /*
@@ -246,7 +356,7 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  *	- O_NONBLOCK works
  *	- If there are no log entries to read, blocks until log is written to
- *	- Atomically reads exactly one log entry
+ *	- Atomically reads exactly one log entry, the oldest one of all CPUs
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -256,7 +366,9 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
+	struct logger_entry entry;
 	ssize_t ret;
+	int cpu;
 	DEFINE_WAIT(wait);
 
 start:
@@ -265,7 +377,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		ret = (log->w_off == reader->r_off);
+		ret = (logger_next_entry(reader, &entry) < 0);
 		mutex_unlock(&log->mutex);
 		if (!ret)
 			break;
@@ -289,26 +401,29 @@ start:
 
 	mutex_lock(&log->mutex);
 
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	do {
+		/* is there still something to read or did we race? */
+		cpu = logger_next_entry(reader, &entry);
+		if (unlikely(cpu < 0)) {
+			mutex_unlock(&log->mutex);
+			goto start;
+		}
 
-	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
-		goto start;
-	}
+		/* get the size of the next entry */
+		ret = get_user_hdr_len(reader->r_ver) + entry.len;
+		if (count < ret) {
+			ret = -EINVAL;
+			goto out;
+		}
 
-	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
-		ret = -EINVAL;
-		goto out;
-	}
+		/* retry with the new oldest entry if this one got overwritten */
+	} while (!logger_fetch_entry(reader, cpu,
+				     sizeof(struct logger_entry) + entry.len));
 
 	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	ret = do_read_log_to_user(reader, buf, ret);
+	if (ret > 0)
+		reader->r_pos[cpu] += sizeof(struct logger_entry) + entry.len;
 
 out:
 	mutex_unlock(&log->mutex);
@@ -316,191 +431,86 @@ out:
 	return ret;
 }
 
-/*
- * get_next_entry - return the offset of the first valid entry at least 'len'
- * bytes after 'off'.
- *
- * Caller must hold log->mutex.
- */
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
-{
-	size_t count = 0;
-
-	do {
-		size_t nr = sizeof(struct logger_entry) +
-			get_entry_msg_len(log, off);
-		off = logger_offset(log, off + nr);
-		count += nr;
-	} while (count < len);
-
-	return off;
-}
-
-/*
- * is_between - is a < c < b, accounting for wrapping of a, b, and c
- *    positions in the buffer
- *
- * That is, if a<b, check for c between a and b
- * and if a>b, check for c outside (not between) a and b
- *
- * |------- a xxxxxxxx b --------|
- *               c^
- *
- * |xxxxx b --------- a xxxxxxxxx|
- *    c^
- *  or                    c^
- */
-static inline int is_between(size_t a, size_t b, size_t c)
-{
-	if (a < b) {
-		/* is c between a and b? */
-		if (a < c && c <= b)
-			return 1;
-	} else {
-		/* is c outside of b through a? */
-		if (c <= b || a < c)
-			return 1;
-	}
-
-	return 0;
-}
-
-/*
- * fix_up_readers - walk the list of all readers and "fix up" any who were
- * lapped by the writer; also do the same for the default "start head".
- * We do this by "pulling forward" the readers and start head to the first
- * entry after the new write head.
- *
- * The caller needs to hold log->mutex.
- */
-static void fix_up_readers(struct logger_log *log, size_t len)
-{
-	size_t old = log->w_off;
-	size_t new = logger_offset(log, old + len);
-	struct logger_reader *reader;
-
-	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
-
-	list_for_each_entry(reader, &log->readers, list)
-		if (is_between(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
-}
-
-/*
- * do_write_log - writes 'len' bytes from 'buf' to 'log'
- *
- * The caller needs to hold log->mutex.
- */
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
-{
-	size_t len;
-
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
-
-	if (count != len)
-		memcpy(log->buffer, buf + len, count - len);
-
-	log->w_off = logger_offset(log, log->w_off + count);
-
-}
-
-/*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
- */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
-{
-	size_t len;
-
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
-
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
-			return -EFAULT;
-
-	log->w_off = logger_offset(log, log->w_off + count);
-
-	return count;
-}
-
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The entry is assembled off the ring first, as copying from user-space may
+ * sleep, and then appended to this CPU's ring with preemption disabled.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
-	struct logger_entry header;
+	union {
+		struct logger_entry entry;
+		unsigned char buf[LOGGER_STACK_ENTRY_LEN];
+	} small;
+	struct logger_entry *header = &small.entry;
 	struct timespec now;
+	size_t len, count;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.euid = current_euid();
-	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
-	header.hdr_size = sizeof(struct logger_entry);
+	len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 
 	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
+	if (unlikely(!len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	count = sizeof(struct logger_entry) + len;
+	if (count > sizeof(small)) {
+		header = kmalloc(count, GFP_KERNEL);
+		if (!header)
+			return -ENOMEM;
+	}
 
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
+	while (nr_segs-- > 0 && ret < len) {
+		size_t seg;
 
 		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+		seg = min_t(size_t, iov->iov_len, len - ret);
+
+		/*
+		 * Give up on the whole entry if any segment faults, to avoid
+		 * message corruption from missing fragments.
+		 */
+		if (seg && copy_from_user(header->msg + ret, iov->iov_base,
+					  seg)) {
+			ret = -EFAULT;
+			goto out;
 		}
 
 		iov++;
-		ret += nr;
+		ret += seg;
 	}
 
-	mutex_unlock(&log->mutex);
+	header->pid = current->tgid;
+	header->tid = current->pid;
+	header->euid = current_euid();
+	header->len = ret;
+	header->hdr_size = sizeof(struct logger_entry);
 
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	/*
+	 * Take the timestamp on the CPU whose ring the entry goes to, so that
+	 * each ring stays in timestamp order for the merge in logger_read().
+	 */
+	preempt_disable();
+	getnstimeofday(&now);
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+	ring_write(this_cpu_ptr(log->rings), header,
+		   sizeof(struct logger_entry) + ret);
+	preempt_enable();
+
+	/* wake up any blocked readers, pairs with prepare_to_wait() */
+	smp_mb();
+	if (waitqueue_active(&log->wq))
+		wake_up_interruptible(&log->wq);
+
+out:
+	if (header != &small.entry)
+		kfree(header);
 
 	return ret;
 }
@@ -528,10 +538,22 @@ static int logger_open(struct inode *inode, struct file *file)
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader;
 
+		int cpu;
+
 		reader = kmalloc(sizeof(struct logger_reader), GFP_KERNEL);
 		if (!reader)
 			return -ENOMEM;
 
+		reader->r_pos = kcalloc(nr_cpu_ids, sizeof(unsigned long),
+					GFP_KERNEL);
+		reader->r_buf = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->r_pos || !reader->r_buf) {
+			kfree(reader->r_pos);
+			kfree(reader->r_buf);
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
 		reader->r_ver = 1;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
@@ -540,7 +562,8 @@ static int logger_open(struct inode *inode, struct file *file)
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
-		reader->r_off = log->head;
+		for_each_possible_cpu(cpu)
+			reader->r_pos[cpu] = per_cpu_ptr(log->rings, cpu)->start;
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
 
@@ -566,6 +589,8 @@ static int logger_release(struct inode *ignored, struct file *file)
 		list_del(&reader->list);
 		mutex_unlock(&log->mutex);
 
+		kfree(reader->r_pos);
+		kfree(reader->r_buf);
 		kfree(reader);
 	}
 
@@ -585,6 +610,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 {
 	struct logger_reader *reader;
 	struct logger_log *log;
+	struct logger_entry entry;
 	unsigned int ret = POLLOUT | POLLWRNORM;
 
 	if (!(file->f_mode & FMODE_READ))
@@ -596,11 +622,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
-
-	if (log->w_off != reader->r_off)
+	if (logger_next_entry(reader, &entry) >= 0)
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
@@ -624,7 +646,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	struct logger_entry entry;
 	long ret = -EINVAL;
+	int cpu;
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
@@ -639,10 +663,13 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		ret = 0;
+		for_each_possible_cpu(cpu) {
+			unsigned long *pos = &reader->r_pos[cpu];
+
+			ret += ring_clamp(per_cpu_ptr(log->rings, cpu), pos) -
+				*pos;
+		}
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -651,13 +678,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
-		if (!reader->r_all)
-			reader->r_off = get_next_entry_by_uid(log,
-				reader->r_off, current_euid());
-
-		if (log->w_off != reader->r_off)
-			ret = get_user_hdr_len(reader->r_ver) +
-				get_entry_msg_len(log, reader->r_off);
+		if (logger_next_entry(reader, &entry) >= 0)
+			ret = get_user_hdr_len(reader->r_ver) + entry.len;
 		else
 			ret = 0;
 		break;
@@ -666,9 +688,13 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EBADF;
 			break;
 		}
-		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+		for_each_possible_cpu(cpu) {
+			struct logger_ring *ring = per_cpu_ptr(log->rings, cpu);
+
+			ring->start = ACCESS_ONCE(ring->head);
+			list_for_each_entry(reader, &log->readers, list)
+				reader->r_pos[cpu] = ring->start;
+		}
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -707,13 +733,11 @@ static const struct file_operations logger_fops = {
 
 /*
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
- * must be a power of two, and greater than
- * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
+ * is split evenly between the per-CPU rings.  Each ring is rounded down to a
+ * power of two, but is no smaller than LOGGER_RING_MIN_SIZE.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
 static struct logger_log VAR = { \
-	.buffer = _buf_ ## VAR, \
 	.misc = { \
 		.minor = MISC_DYNAMIC_MINOR, \
 		.name = NAME, \
@@ -723,8 +747,6 @@ static struct logger_log VAR = { \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
 	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
-	.w_off = 0, \
-	.head = 0, \
 	.size = SIZE, \
 };
 
@@ -746,19 +768,64 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+static void __init free_log_rings(struct logger_log *log)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(log->rings, cpu)->buffer);
+	free_percpu(log->rings);
+}
+
+static int __init init_log_rings(struct logger_log *log)
+{
+	size_t size;
+	int cpu;
+
+	size = log->size / num_possible_cpus();
+	size = max_t(size_t, rounddown_pow_of_two(size), LOGGER_RING_MIN_SIZE);
+
+	log->rings = alloc_percpu(struct logger_ring);
+	if (!log->rings)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct logger_ring *ring = per_cpu_ptr(log->rings, cpu);
+
+		ring->buffer = vmalloc(size);
+		if (!ring->buffer) {
+			free_log_rings(log);
+			return -ENOMEM;
+		}
+		ring->size = size;
+	}
+	log->size = size * num_possible_cpus();
+
+	return 0;
+}
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	ret = init_log_rings(log);
+	if (unlikely(ret)) {
+		printk(KERN_ERR "logger: failed to allocate buffers "
+		       "for log '%s'!\n", log->misc.name);
+		return ret;
+	}
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
 		       "device for log '%s'!\n", log->misc.name);
+		free_log_rings(log);
 		return ret;
 	}
 
-	printk(KERN_INFO "logger: created %luK log '%s'\n",
-	       (unsigned long) log->size >> 10, log->misc.name);
+	printk(KERN_INFO "logger: created %luK log '%s' (%d rings)\n",
+	       (unsigned long) log->size >> 10, log->misc.name,
+	       num_possible_cpus());
 
 	return 0;
 }
@@ -13,6 +13,14 @@
  * drops below 4096 pages and kill processes with a oom_score_adj value of 0 or
  * higher when the free memory drops below 1024 pages.
  *
+ * Processes are kept in per-oom_score_adj buckets, so choosing a victim
+ * only looks at the highest non-empty buckets. The current pressure level
+ * ("none", "low", "medium" or "critical") is exported in
+ * /sys/kernel/mm/lowmemorykiller/pressure_level, which can be poll()ed.
+ * "low" is reported once free memory is within notify_margin percent of the
+ * largest minfree threshold, letting user-space free memory before the
+ * driver has to kill anything.
+ *
  * The driver considers memory used for caches to be free, but if a large
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
@@ -37,6 +45,13 @@
 #include <linux/sched.h>
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
+#include <linux/bitops.h>
+#include <linux/err.h>
+#include <linux/ion.h>
+#include <linux/kobject.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -62,15 +77,293 @@ static unsigned long lowmem_deathpending_timeout;
 			printk(x);			\
 	} while (0)
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Processes are indexed by oom_score_adj so that picking a victim only
+ * looks at the highest populated buckets instead of every task in the
+ * system.  The fork, exit and oom_score_adj write paths keep the index
+ * current; lowmem_adj_used has a bit set for every non-empty bucket.
+ */
+#define LOWMEM_ADJ_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+#define LOWMEM_SCAN_BATCH	16
+
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+static struct hlist_head lowmem_adj_buckets[LOWMEM_ADJ_BUCKETS];
+static DECLARE_BITMAP(lowmem_adj_used, LOWMEM_ADJ_BUCKETS);
+
+static void __lowmem_adj_index_del(struct signal_struct *sig)
 {
-	struct task_struct *tsk;
+	hlist_del_init(&sig->lmk_node);
+	if (hlist_empty(&lowmem_adj_buckets[sig->lmk_adj]))
+		clear_bit(sig->lmk_adj, lowmem_adj_used);
+}
+
+static void __lowmem_adj_index_add(struct signal_struct *sig)
+{
+	sig->lmk_adj = sig->oom_score_adj - OOM_SCORE_ADJ_MIN;
+	hlist_add_head(&sig->lmk_node, &lowmem_adj_buckets[sig->lmk_adj]);
+	set_bit(sig->lmk_adj, lowmem_adj_used);
+}
+
+void lowmem_adj_index_add(struct task_struct *p)
+{
+	if (p->flags & PF_KTHREAD)
+		return;
+
+	spin_lock(&lowmem_adj_lock);
+	__lowmem_adj_index_add(p->signal);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+void lowmem_adj_index_del(struct signal_struct *sig)
+{
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_unhashed(&sig->lmk_node))
+		__lowmem_adj_index_del(sig);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/*
+ * Called without the task or sighand locks held, after oom_score_adj has
+ * been written.  Processes that already exited (or were never indexed,
+ * like kernel threads) are left alone.
+ */
+void lowmem_adj_index_update(struct signal_struct *sig)
+{
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_unhashed(&sig->lmk_node) &&
+	    sig->lmk_adj != sig->oom_score_adj - OOM_SCORE_ADJ_MIN) {
+		__lowmem_adj_index_del(sig);
+		__lowmem_adj_index_add(sig);
+	}
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/*
+ * Takes a reference on up to LOWMEM_SCAN_BATCH group leaders from the
+ * highest populated bucket below @limit.  The candidates are examined
+ * after lowmem_adj_lock is dropped since task_lock nests outside of it.
+ */
+static int lowmem_collect(unsigned long *limit, unsigned long min,
+			  struct task_struct **batch)
+{
+	struct signal_struct *sig;
+	struct hlist_node *pos;
+	unsigned long idx;
+	int n = 0;
+
+	rcu_read_lock();
+	spin_lock(&lowmem_adj_lock);
+	idx = find_last_bit(lowmem_adj_used, *limit);
+	if (idx < *limit && idx >= min) {
+		hlist_for_each_entry(sig, pos, &lowmem_adj_buckets[idx],
+				     lmk_node) {
+			struct task_struct *tsk;
+
+			tsk = pid_task(sig->leader_pid, PIDTYPE_PID);
+			if (!tsk)
+				continue;
+			get_task_struct(tsk);
+			batch[n++] = tsk;
+			if (n == LOWMEM_SCAN_BATCH)
+				break;
+		}
+		*limit = idx;
+	} else {
+		*limit = 0;
+	}
+	spin_unlock(&lowmem_adj_lock);
+	rcu_read_unlock();
+	return n;
+}
+
+/*
+ * Returns the task to kill with a reference held, NULL if nothing at or
+ * above @min_score_adj is killable, or ERR_PTR(-EBUSY) if an earlier
+ * victim is still releasing its memory.
+ */
+static struct task_struct *lowmem_select(int min_score_adj,
+					 int *selected_tasksize,
+					 int *selected_oom_score_adj)
+{
+	struct task_struct *batch[LOWMEM_SCAN_BATCH];
 	struct task_struct *selected = NULL;
+	unsigned long limit = LOWMEM_ADJ_BUCKETS;
+	unsigned long min = min_score_adj - OOM_SCORE_ADJ_MIN;
+	bool busy = false;
+	int i, n;
+
+	*selected_tasksize = 0;
+	*selected_oom_score_adj = min_score_adj;
+	while (!selected && !busy && limit > min) {
+		n = lowmem_collect(&limit, min, batch);
+
+		rcu_read_lock();
+		for (i = 0; i < n; i++) {
+			struct task_struct *p;
+			int oom_score_adj;
+			int tasksize;
+
+			p = find_lock_task_mm(batch[i]);
+			if (!p)
+				continue;
+
+			if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
+			    time_before_eq(jiffies,
+					   lowmem_deathpending_timeout)) {
+				task_unlock(p);
+				busy = true;
+				break;
+			}
+			oom_score_adj = p->signal->oom_score_adj;
+			if (oom_score_adj < min_score_adj) {
+				task_unlock(p);
+				continue;
+			}
+			tasksize = get_mm_rss(p->mm);
+#ifdef CONFIG_ION
+			/* graphics buffers are freed along with the task too */
+			tasksize += ion_tgid_usage(p->tgid) >> PAGE_SHIFT;
+#endif
+			task_unlock(p);
+			if (tasksize <= 0)
+				continue;
+			if (selected) {
+				if (oom_score_adj < *selected_oom_score_adj)
+					continue;
+				if (oom_score_adj == *selected_oom_score_adj &&
+				    tasksize <= *selected_tasksize)
+					continue;
+				put_task_struct(selected);
+			}
+			get_task_struct(p);
+			selected = p;
+			*selected_tasksize = tasksize;
+			*selected_oom_score_adj = oom_score_adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+				     p->pid, p->comm, oom_score_adj, tasksize);
+		}
+		rcu_read_unlock();
+
+		for (i = 0; i < n; i++)
+			put_task_struct(batch[i]);
+	}
+
+	if (busy) {
+		if (selected)
+			put_task_struct(selected);
+		return ERR_PTR(-EBUSY);
+	}
+	return selected;
+}
+
+/*
+ * The previous victim leaves the index as soon as its last thread starts
+ * exiting, so it is tracked here until it has dropped its mm.
+ */
+static DEFINE_MUTEX(lowmem_kill_lock);
+static struct task_struct *lowmem_deathpending;
+
+static bool lowmem_deathpending_alive(void)
+{
+	struct task_struct *p;
+
+	if (!lowmem_deathpending)
+		return false;
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		rcu_read_lock();
+		p = find_lock_task_mm(lowmem_deathpending);
+		if (p)
+			task_unlock(p);
+		rcu_read_unlock();
+		if (p)
+			return true;
+	}
+	put_task_struct(lowmem_deathpending);
+	lowmem_deathpending = NULL;
+	return false;
+}
+
+/*
+ * Pressure levels reported through /sys/kernel/mm/lowmemorykiller/
+ * pressure_level.  Userspace can poll() the file and start killing on
+ * its own at "low", before the minfree thresholds are reached.
+ */
+enum lowmem_pressure_level {
+	LOWMEM_PRESSURE_NONE,
+	LOWMEM_PRESSURE_LOW,
+	LOWMEM_PRESSURE_MEDIUM,
+	LOWMEM_PRESSURE_CRITICAL,
+};
+
+static const char * const lowmem_pressure_names[] = {
+	"none",
+	"low",
+	"medium",
+	"critical",
+};
+
+static uint32_t lowmem_notify_margin = 25;
+static atomic_t lowmem_pressure = ATOMIC_INIT(LOWMEM_PRESSURE_NONE);
+static struct kobject *lowmem_kobj;
+static struct sysfs_dirent *lowmem_pressure_sd;
+
+static void lowmem_update_pressure(int other_free, int other_file,
+				   int array_size, int match)
+{
+	int level;
+	int margin;
+
+	if (match == 0) {
+		level = LOWMEM_PRESSURE_CRITICAL;
+	} else if (match > 0) {
+		level = LOWMEM_PRESSURE_MEDIUM;
+	} else {
+		level = LOWMEM_PRESSURE_NONE;
+		if (array_size > 0) {
+			margin = lowmem_minfree[array_size - 1] +
+				 lowmem_minfree[array_size - 1] *
+				 lowmem_notify_margin / 100;
+			if (other_free < margin && other_file < margin)
+				level = LOWMEM_PRESSURE_LOW;
+		}
+	}
+
+	if (atomic_xchg(&lowmem_pressure, level) != level) {
+		lowmem_print(3, "lowmem pressure %s, ofree %d %d\n",
+			     lowmem_pressure_names[level], other_free,
+			     other_file);
+		if (lowmem_pressure_sd)
+			sysfs_notify_dirent(lowmem_pressure_sd);
+	}
+}
+
+static ssize_t pressure_level_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n",
+		       lowmem_pressure_names[atomic_read(&lowmem_pressure)]);
+}
+
+static struct kobj_attribute pressure_level_attr = __ATTR_RO(pressure_level);
+
+static struct attribute *lowmem_attrs[] = {
+	&pressure_level_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lowmem_attr_group = {
+	.attrs = lowmem_attrs,
+};
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *selected;
 	int rem = 0;
-	int tasksize;
 	int i;
+	int match = -1;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-	int selected_tasksize = 0;
+	int selected_tasksize;
 	int selected_oom_score_adj;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES);
@@ -85,9 +378,11 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
 			min_score_adj = lowmem_adj[i];
+			match = i;
 			break;
 		}
 	}
+	lowmem_update_pressure(other_free, other_file, array_size, match);
 	if (sc->nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d\n",
 				sc->nr_to_scan, sc->gfp_mask, other_free,
@@ -101,60 +396,35 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
+	/* Someone else is already picking a victim */
+	if (!mutex_trylock(&lowmem_kill_lock))
+		return 0;
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+	if (lowmem_deathpending_alive()) {
+		mutex_unlock(&lowmem_kill_lock);
+		return 0;
+	}
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
-			rcu_read_unlock();
-			return 0;
-		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
+	selected = lowmem_select(min_score_adj, &selected_tasksize,
+				 &selected_oom_score_adj);
+	if (IS_ERR(selected)) {
+		mutex_unlock(&lowmem_kill_lock);
+		return 0;
 	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_score_adj, selected_tasksize);
 		lowmem_deathpending_timeout = jiffies + HZ;
+		lowmem_deathpending = selected;
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
 	}
+	mutex_unlock(&lowmem_kill_lock);
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	rcu_read_unlock();
 	return rem;
 }
 
@@ -165,6 +435,20 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	lowmem_kobj = kobject_create_and_add("lowmemorykiller", mm_kobj);
+	if (lowmem_kobj) {
+		if (sysfs_create_group(lowmem_kobj, &lowmem_attr_group)) {
+			kobject_put(lowmem_kobj);
+			lowmem_kobj = NULL;
+		} else {
+			lowmem_pressure_sd = sysfs_get_dirent(lowmem_kobj->sd,
+							      NULL,
+							      "pressure_level");
+		}
+	}
+	if (!lowmem_kobj)
+		pr_warn("lowmemorykiller: failed to create sysfs nodes\n");
+
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
@@ -172,6 +456,13 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	if (lowmem_deathpending)
+		put_task_struct(lowmem_deathpending);
+	if (lowmem_kobj) {
+		sysfs_put(lowmem_pressure_sd);
+		lowmem_pressure_sd = NULL;
+		kobject_put(lowmem_kobj);
+	}
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -180,6 +471,8 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(notify_margin, lowmem_notify_margin, uint,
+		   S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -12,6 +12,7 @@
  *
  */
 
+#include <linux/crc32.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/errno.h>
@@ -19,10 +20,13 @@
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/list.h>
+#include <linux/lzo.h>
 #include <linux/memblock.h>
 #include <linux/persistent_ram.h>
+#include <linux/random.h>
 #include <linux/rslib.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/vmalloc.h>
 
 struct persistent_ram_buffer {
@@ -108,7 +112,7 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	unsigned int start, unsigned int count)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
-	uint8_t *buffer_end = buffer->data + prz->buffer_size;
+	uint8_t *buffer_end = buffer->data + prz->data_size;
 	uint8_t *block;
 	uint8_t *par;
 	int ecc_block_size = prz->ecc_block_size;
@@ -141,7 +145,9 @@ static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 				  prz->par_header);
 }
 
-static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
+/* Check and correct the ECC blocks covering data[from..to) */
+static void persistent_ram_ecc_range(struct persistent_ram_zone *prz,
+	size_t from, size_t to)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
 	uint8_t *block;
@@ -150,13 +156,13 @@ static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 	if (!prz->ecc)
 		return;
 
-	block = buffer->data;
-	par = prz->par_buffer;
-	while (block < buffer->data + buffer_size(prz)) {
+	block = buffer->data + (from & ~(prz->ecc_block_size - 1));
+	par = prz->par_buffer + (from / prz->ecc_block_size) * prz->ecc_size;
+	while (block < buffer->data + to) {
 		int numerr;
 		int size = prz->ecc_block_size;
-		if (block + size > buffer->data + prz->buffer_size)
-			size = buffer->data + prz->buffer_size - block;
+		if (block + size > buffer->data + prz->data_size)
+			size = buffer->data + prz->data_size - block;
 		numerr = persistent_ram_decode_rs8(prz, block, size, par);
 		if (numerr > 0) {
 			pr_devel("persistent_ram: error in block %p, %d\n",
@@ -172,6 +178,11 @@ static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 	}
 }
 
+static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
+{
+	persistent_ram_ecc_range(prz, 0, buffer_size(prz));
+}
+
 static int persistent_ram_init_ecc(struct persistent_ram_zone *prz,
 	size_t buffer_size)
 {
@@ -249,26 +260,385 @@ static void notrace persistent_ram_update(struct persistent_ram_zone *prz,
 	persistent_ram_update_ecc(prz, start, count);
 }
 
+#define PERSISTENT_RAM_CHUNK_SIZE	4096
+
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS
+/*
+ * A compressed zone keeps only the most recent quarter of its space as
+ * the usual ring.  Every PERSISTENT_RAM_CHUNK_SIZE bytes written to the
+ * ring seal a chunk, which a deferrable work item LZO compresses into
+ * the chunk store behind the ring, well away from the writers.  After a
+ * reset the stored chunks older than the ring contents are expanded in
+ * front of the ring to rebuild the old log.
+ *
+ * Chunk positions are counted in bytes of the stream written to the
+ * ring since boot; the ring holds stream offset X at X % buffer_size.
+ */
+#define PERSISTENT_RAM_STORE_SIG	(0x5a535250) /* PRSZ */
+#define PERSISTENT_RAM_CHUNK_MAGIC	(0x4b4e4843) /* CHNK */
+#define PERSISTENT_RAM_CHUNK_RAW	0x1
+/* The store header is written on every ring write: keep it in its own
+ * ECC block, which is never encoded nor checked. */
+#define PERSISTENT_RAM_STORE_HDR	128
+#define PERSISTENT_RAM_COMPRESS_DELAY	(HZ / 10)
+
+struct persistent_ram_store {
+	uint32_t    sig;
+	uint32_t    generation;
+	uint32_t    written;	/* stream bytes written to the ring */
+	uint32_t    used;	/* high water mark of the chunk area */
+};
+
+struct persistent_ram_chunk {
+	uint32_t    magic;
+	uint32_t    generation;
+	uint32_t    seq;	/* stream [seq * CHUNK_SIZE, +CHUNK_SIZE) */
+	uint16_t    len;
+	uint16_t    flags;
+	uint32_t    crc;
+	uint8_t     data[0];
+};
+
+struct persistent_ram_old_chunk {
+	uint32_t    seq;
+	size_t      offset;
+};
+
+static inline uint8_t *store_data(struct persistent_ram_zone *prz)
+{
+	return prz->buffer->data + prz->store_offset;
+}
+
+static void persistent_ram_copy_ring(struct persistent_ram_zone *prz,
+	void *dst, u32 from, size_t len)
+{
+	size_t pos = from % prz->buffer_size;
+	size_t first = min(len, prz->buffer_size - pos);
+
+	memcpy(dst, prz->buffer->data + pos, first);
+	memcpy(dst + first, prz->buffer->data, len - first);
+}
+
+static void persistent_ram_store_chunk(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_chunk *chunk = prz->comp_buf;
+	size_t len = lzo1x_worst_compress(PERSISTENT_RAM_CHUNK_SIZE);
+	size_t size;
+	int ret;
+
+	chunk->flags = 0;
+	ret = lzo1x_1_compress(prz->chunk_buf, PERSISTENT_RAM_CHUNK_SIZE,
+			       chunk->data, &len, prz->wrkmem);
+	if (ret != LZO_E_OK || len >= PERSISTENT_RAM_CHUNK_SIZE) {
+		memcpy(chunk->data, prz->chunk_buf, PERSISTENT_RAM_CHUNK_SIZE);
+		len = PERSISTENT_RAM_CHUNK_SIZE;
+		chunk->flags = PERSISTENT_RAM_CHUNK_RAW;
+	}
+
+	chunk->magic = PERSISTENT_RAM_CHUNK_MAGIC;
+	chunk->generation = prz->store->generation;
+	chunk->seq = prz->sealed / PERSISTENT_RAM_CHUNK_SIZE;
+	chunk->len = len;
+	chunk->crc = crc32(0, chunk->data, len);
+
+	size = ALIGN(sizeof(*chunk) + len, 4);
+	if (prz->store_pos + size > prz->store_size)
+		prz->store_pos = 0;
+
+	persistent_ram_update(prz, chunk, prz->store_offset + prz->store_pos,
+			      size);
+	prz->store_pos += size;
+	if (prz->store_pos > prz->store->used)
+		prz->store->used = prz->store_pos;
+}
+
+static void persistent_ram_compress_work(struct work_struct *work)
+{
+	struct persistent_ram_zone *prz = container_of(to_delayed_work(work),
+			struct persistent_ram_zone, compress_work);
+	u32 written = atomic_read(&prz->written);
+
+	while (written - prz->sealed >= PERSISTENT_RAM_CHUNK_SIZE) {
+		/* the ring lapped chunks we did not get to in time */
+		if (written - prz->sealed > prz->buffer_size) {
+			prz->sealed = round_up(written - prz->buffer_size,
+					       PERSISTENT_RAM_CHUNK_SIZE);
+			continue;
+		}
+
+		persistent_ram_copy_ring(prz, prz->chunk_buf, prz->sealed,
+					 PERSISTENT_RAM_CHUNK_SIZE);
+		smp_rmb();
+		written = atomic_read(&prz->written);
+		if (written - prz->sealed > prz->buffer_size)
+			continue;
+
+		persistent_ram_store_chunk(prz);
+		prz->sealed += PERSISTENT_RAM_CHUNK_SIZE;
+	}
+
+	schedule_delayed_work(&prz->compress_work,
+			      PERSISTENT_RAM_COMPRESS_DELAY);
+}
+
+static inline void notrace persistent_ram_account(
+	struct persistent_ram_zone *prz, unsigned int count)
+{
+	prz->store->written = atomic_add_return(count, &prz->written);
+}
+
+static struct persistent_ram_chunk *__devinit
+persistent_ram_old_chunk(struct persistent_ram_zone *prz, size_t off,
+	u32 generation, u32 used)
+{
+	struct persistent_ram_chunk *chunk = (void *)store_data(prz) + off;
+
+	if (off + sizeof(*chunk) > used ||
+	    chunk->magic != PERSISTENT_RAM_CHUNK_MAGIC ||
+	    chunk->generation != generation)
+		return NULL;
+
+	if (chunk->len > lzo1x_worst_compress(PERSISTENT_RAM_CHUNK_SIZE) ||
+	    off + sizeof(*chunk) + chunk->len > used)
+		return NULL;
+
+	if ((chunk->flags & PERSISTENT_RAM_CHUNK_RAW) &&
+	    chunk->len != PERSISTENT_RAM_CHUNK_SIZE)
+		return NULL;
+
+	if (crc32(0, chunk->data, chunk->len) != chunk->crc)
+		return NULL;
+
+	return chunk;
+}
+
+static int persistent_ram_old_chunk_cmp(const void *a, const void *b)
+{
+	const struct persistent_ram_old_chunk *ca = a, *cb = b;
+
+	return (s32)(ca->seq - cb->seq);
+}
+
+/*
+ * Walk the chunk area for the valid chunks of the previous boot that are
+ * older than the ring contents, storing them in @list if it is not NULL.
+ * Returns the number of chunks found.
+ */
+static int __devinit persistent_ram_walk_chunks(struct persistent_ram_zone *prz,
+	u32 ring_begin, struct persistent_ram_old_chunk *list)
+{
+	struct persistent_ram_store *store = prz->store;
+	size_t off = 0;
+	int n = 0;
+
+	while (off < store->used) {
+		struct persistent_ram_chunk *chunk;
+
+		chunk = persistent_ram_old_chunk(prz, off, store->generation,
+						 store->used);
+		if (!chunk) {
+			off += 4;
+			continue;
+		}
+
+		if ((s32)(ring_begin - chunk->seq *
+			  PERSISTENT_RAM_CHUNK_SIZE) > 0) {
+			if (list) {
+				list[n].seq = chunk->seq;
+				list[n].offset = off;
+			}
+			n++;
+		}
+		off += ALIGN(sizeof(*chunk) + chunk->len, 4);
+	}
+
+	return n;
+}
+
+/* Collect the chunks to expand, oldest first.  Returns their number. */
+static int __devinit persistent_ram_scan_chunks(struct persistent_ram_zone *prz,
+	size_t ring_bytes, struct persistent_ram_old_chunk **list)
+{
+	struct persistent_ram_store *store = prz->store;
+	u32 ring_begin = store->written - ring_bytes;
+	int n;
+
+	*list = NULL;
+	if (store->sig != PERSISTENT_RAM_STORE_SIG ||
+	    store->used > prz->store_size)
+		return 0;
+
+	persistent_ram_ecc_range(prz, prz->store_offset,
+				 prz->store_offset + store->used);
+
+	n = persistent_ram_walk_chunks(prz, ring_begin, NULL);
+	if (!n)
+		return 0;
+
+	*list = vmalloc(n * sizeof(**list));
+	if (!*list)
+		return 0;
+
+	n = persistent_ram_walk_chunks(prz, ring_begin, *list);
+	sort(*list, n, sizeof(**list), persistent_ram_old_chunk_cmp, NULL);
+
+	return n;
+}
+
+/* Expand the chunks in front of the ring contents, returns bytes used */
+static size_t __devinit persistent_ram_restore_chunks(
+	struct persistent_ram_zone *prz, struct persistent_ram_old_chunk *list,
+	int n, size_t ring_bytes, char *dest)
+{
+	u32 ring_begin = prz->store->written - ring_bytes;
+	char *out = dest;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		struct persistent_ram_chunk *chunk =
+			(void *)store_data(prz) + list[i].offset;
+		u32 older = ring_begin -
+			    list[i].seq * PERSISTENT_RAM_CHUNK_SIZE;
+		size_t len = PERSISTENT_RAM_CHUNK_SIZE;
+		const void *src = chunk->data;
+
+		if (!(chunk->flags & PERSISTENT_RAM_CHUNK_RAW)) {
+			int err = lzo1x_decompress_safe(chunk->data,
+					chunk->len, prz->chunk_buf, &len);
+
+			if (err != LZO_E_OK || len != PERSISTENT_RAM_CHUNK_SIZE)
+				continue;
+			src = prz->chunk_buf;
+		}
+
+		len = min_t(u32, older, PERSISTENT_RAM_CHUNK_SIZE);
+		memcpy(out, src, len);
+		out += len;
+	}
+
+	return out - dest;
+}
+
+static int __devinit
+persistent_ram_init_compress(struct persistent_ram_zone *prz)
+{
+	size_t ring = round_down(prz->data_size / 4, PERSISTENT_RAM_STORE_HDR);
+	size_t store = prz->data_size - ring;
+
+	if (ring < 2 * PERSISTENT_RAM_CHUNK_SIZE ||
+	    store < PERSISTENT_RAM_STORE_HDR + 4 * PERSISTENT_RAM_CHUNK_SIZE) {
+		pr_info("persistent_ram: zone too small to compress\n");
+		return -EINVAL;
+	}
+
+	prz->chunk_buf = kmalloc(PERSISTENT_RAM_CHUNK_SIZE, GFP_KERNEL);
+	prz->comp_buf = kmalloc(sizeof(struct persistent_ram_chunk) +
+			lzo1x_worst_compress(PERSISTENT_RAM_CHUNK_SIZE),
+			GFP_KERNEL);
+	prz->wrkmem = kmalloc(LZO1X_1_MEM_COMPRESS, GFP_KERNEL);
+	if (!prz->chunk_buf || !prz->comp_buf || !prz->wrkmem) {
+		kfree(prz->chunk_buf);
+		kfree(prz->comp_buf);
+		kfree(prz->wrkmem);
+		return -ENOMEM;
+	}
+
+	prz->buffer_size = ring;
+	prz->store = (void *)prz->buffer->data + ring;
+	prz->store_offset = ring + PERSISTENT_RAM_STORE_HDR;
+	prz->store_size = prz->data_size - prz->store_offset;
+	INIT_DELAYED_WORK_DEFERRABLE(&prz->compress_work,
+				     persistent_ram_compress_work);
+	prz->compress = true;
+
+	return 0;
+}
+
+static void __devinit persistent_ram_start_compress(
+	struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_store *store = prz->store;
+
+	if (store->sig == PERSISTENT_RAM_STORE_SIG)
+		store->generation++;
+	else
+		store->generation = get_random_int();
+	store->sig = PERSISTENT_RAM_STORE_SIG;
+	store->written = 0;
+	store->used = 0;
+
+	atomic_set(&prz->written, 0);
+	prz->sealed = 0;
+	prz->store_pos = 0;
+
+	schedule_delayed_work(&prz->compress_work,
+			      PERSISTENT_RAM_COMPRESS_DELAY);
+}
+#else
+struct persistent_ram_old_chunk;
+
+static inline void persistent_ram_account(struct persistent_ram_zone *prz,
+	unsigned int count)
+{
+}
+
+static inline int persistent_ram_scan_chunks(struct persistent_ram_zone *prz,
+	size_t ring_bytes, struct persistent_ram_old_chunk **list)
+{
+	*list = NULL;
+	return 0;
+}
+
+static inline size_t persistent_ram_restore_chunks(
+	struct persistent_ram_zone *prz, struct persistent_ram_old_chunk *list,
+	int n, size_t ring_bytes, char *dest)
+{
+	return 0;
+}
+
+static inline int persistent_ram_init_compress(struct persistent_ram_zone *prz)
+{
+	return -EINVAL;
+}
+
+static inline void persistent_ram_start_compress(
+	struct persistent_ram_zone *prz)
+{
+}
+#endif
+
 static void __devinit
 persistent_ram_save_old(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
+	struct persistent_ram_old_chunk *chunks = NULL;
 	size_t size = buffer_size(prz);
 	size_t start = buffer_start(prz);
+	size_t old = 0;
+	int nr_chunks = 0;
 	char *dest;
 
 	persistent_ram_ecc_old(prz);
 
-	dest = kmalloc(size, GFP_KERNEL);
+	if (prz->compress)
+		nr_chunks = persistent_ram_scan_chunks(prz, size, &chunks);
+
+	dest = vmalloc(nr_chunks * PERSISTENT_RAM_CHUNK_SIZE + size);
 	if (dest == NULL) {
 		pr_err("persistent_ram: failed to allocate buffer\n");
+		vfree(chunks);
 		return;
 	}
 
+	if (nr_chunks)
+		old = persistent_ram_restore_chunks(prz, chunks, nr_chunks,
+						    size, dest);
+	vfree(chunks);
+
 	prz->old_log = dest;
-	prz->old_log_size = size;
-	memcpy(prz->old_log, &buffer->data[start], size - start);
-	memcpy(prz->old_log + size - start, &buffer->data[0], start);
+	prz->old_log_size = old + size;
+	memcpy(prz->old_log + old, &buffer->data[start], size - start);
+	memcpy(prz->old_log + old + size - start, &buffer->data[0], start);
 }
 
 int notrace persistent_ram_write(struct persistent_ram_zone *prz,
@@ -298,6 +668,10 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 
 	persistent_ram_update_header_ecc(prz);
 
+	if (prz->compress)
+		persistent_ram_account(prz, min_t(unsigned int, count,
+						  prz->buffer_size));
+
 	return count;
 }
 
@@ -313,7 +687,7 @@ void *persistent_ram_old(struct persistent_ram_zone *prz)
 
 void persistent_ram_free_old(struct persistent_ram_zone *prz)
 {
-	kfree(prz->old_log);
+	vfree(prz->old_log);
 	prz->old_log = NULL;
 	prz->old_log_size = 0;
 }
@@ -379,7 +753,8 @@ static int __devinit persistent_ram_buffer_init(const char *name,
 }
 
 static  __devinit
-struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
+struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc,
+	bool compress)
 {
 	struct persistent_ram_zone *prz;
 	int ret = -ENOMEM;
@@ -403,6 +778,10 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	if (ret)
 		goto err;
 
+	prz->data_size = prz->buffer_size;
+	if (compress)
+		persistent_ram_init_compress(prz);
+
 	if (prz->buffer->sig == PERSISTENT_RAM_SIG) {
 		if (buffer_size(prz) > prz->buffer_size ||
 		    buffer_start(prz) > buffer_size(prz))
@@ -424,6 +803,9 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	atomic_set(&prz->buffer->start, 0);
 	atomic_set(&prz->buffer->size, 0);
 
+	if (prz->compress)
+		persistent_ram_start_compress(prz);
+
 	return prz;
 err:
 	kfree(prz);
@@ -433,7 +815,18 @@ err:
 struct persistent_ram_zone * __devinit
 persistent_ram_init_ringbuffer(struct device *dev, bool ecc)
 {
-	return __persistent_ram_init(dev, ecc);
+	return __persistent_ram_init(dev, ecc, false);
+}
+
+/*
+ * Like persistent_ram_init_ringbuffer(), but with
+ * CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS the older part of the history
+ * is kept LZO compressed, see persistent_ram_compress_work().
+ */
+struct persistent_ram_zone * __devinit
+persistent_ram_init_compressed(struct device *dev, bool ecc)
+{
+	return __persistent_ram_init(dev, ecc, true);
 }
 
 int __init persistent_ram_early_init(struct persistent_ram *ram)
@@ -55,7 +55,7 @@ static int __devinit ram_console_probe(struct platform_device *pdev)
 	struct ram_console_platform_data *pdata = pdev->dev.platform_data;
 	struct persistent_ram_zone *prz;
 
-	prz = persistent_ram_init_ringbuffer(&pdev->dev, true);
+	prz = persistent_ram_init_compressed(&pdev->dev, true);
 	if (IS_ERR(prz))
 		return PTR_ERR(prz);
 
@@ -22,8 +22,19 @@
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 
+#include <asm/div64.h>
+
 #include "../../../kernel/trace/trace.h"
 
+/*
+ * Records are two words.  The low two bits of ip carry the cpu, those of
+ * the second word the record type:
+ *   REC_CALL	function tracer, parent_ip of the call
+ *   REC_ENTRY	function graph entry, depth in bits 2-7
+ *   REC_RETURN	function graph return, depth in bits 2-7 and the
+ *		duration in microseconds in bits 8-31
+ * and are only expanded to text when the old buffer is read.
+ */
 struct persistent_trace_record {
 	unsigned long ip;
 	unsigned long parent_ip;
@@ -31,6 +42,15 @@ struct persistent_trace_record {
 
 #define REC_SIZE sizeof(struct persistent_trace_record)
 
+#define REC_TYPE_MASK		0x3
+#define REC_CALL		0x0
+#define REC_ENTRY		0x1
+#define REC_RETURN		0x2
+#define REC_DEPTH_SHIFT		2
+#define REC_DEPTH_MASK		0x3f
+#define REC_DURATION_SHIFT	8
+#define REC_DURATION_MAX	((1UL << (32 - REC_DURATION_SHIFT)) - 1)
+
 static struct persistent_ram_zone *persistent_trace;
 
 static int persistent_trace_enabled;
@@ -73,7 +93,8 @@ static void persistent_trace_start(struct trace_array *tr)
 	tracing_reset_online_cpus(tr);
 }
 
-static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
+static void notrace persistent_trace_record(unsigned long ip,
+					      unsigned long word)
 {
 	struct trace_array *tr = persistent_trace_array;
 	struct trace_array_cpu *data;
@@ -100,7 +121,7 @@ static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
 
 	if (likely(disabled == 1)) {
 		rec.ip = ip;
-		rec.parent_ip = parent_ip;
+		rec.parent_ip = word;
 		rec.ip |= cpu;
 		persistent_ram_write(persistent_trace, &rec, sizeof(rec));
 	}
@@ -109,6 +130,11 @@ static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
 	local_irq_restore(flags);
 }
 
+static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
+{
+	persistent_trace_record(ip, parent_ip & ~REC_TYPE_MASK);
+}
+
 static struct ftrace_ops trace_ops __read_mostly = {
 	.func = persistent_trace_call,
 	.flags = FTRACE_OPS_FL_GLOBAL,
@@ -122,6 +148,69 @@ static struct tracer persistent_tracer __read_mostly = {
 	.wait_pipe	= poll_wait_pipe,
 };
 
+#ifdef CONFIG_FUNCTION_GRAPH_TRACER
+static int persistent_graph_entry(struct ftrace_graph_ent *trace)
+{
+	unsigned long depth = min_t(int, trace->depth, REC_DEPTH_MASK);
+
+	persistent_trace_record(trace->func,
+				depth << REC_DEPTH_SHIFT | REC_ENTRY);
+	return 1;
+}
+
+static void persistent_graph_return(struct ftrace_graph_ret *trace)
+{
+	unsigned long depth = min_t(int, trace->depth, REC_DEPTH_MASK);
+	unsigned long long usecs = trace->rettime - trace->calltime;
+
+	do_div(usecs, NSEC_PER_USEC);
+	if (usecs > REC_DURATION_MAX)
+		usecs = REC_DURATION_MAX;
+
+	persistent_trace_record(trace->func,
+				(unsigned long)usecs << REC_DURATION_SHIFT |
+				depth << REC_DEPTH_SHIFT | REC_RETURN);
+}
+
+static int persistent_graph_init(struct trace_array *tr)
+{
+	int ret;
+
+	persistent_trace_array = tr;
+	tr->cpu = get_cpu();
+	put_cpu();
+
+	persistent_trace_enabled = 0;
+	smp_wmb();
+
+	ret = register_ftrace_graph(persistent_graph_return,
+				    persistent_graph_entry);
+	if (ret)
+		return ret;
+
+	smp_wmb();
+	persistent_trace_enabled = 1;
+
+	return 0;
+}
+
+static void persistent_graph_reset(struct trace_array *tr)
+{
+	persistent_trace_enabled = 0;
+	smp_wmb();
+
+	unregister_ftrace_graph();
+}
+
+static struct tracer persistent_graph_tracer __read_mostly = {
+	.name		= "persistent_graph",
+	.init		= persistent_graph_init,
+	.reset		= persistent_graph_reset,
+	.start		= persistent_trace_start,
+	.wait_pipe	= poll_wait_pipe,
+};
+#endif
+
 struct persistent_trace_seq_data {
 	const void *ptr;
 	size_t off;
@@ -174,11 +263,29 @@ int persistent_trace_seq_show(struct seq_file *s, void *v)
 	struct persistent_trace_seq_data *data = v;
 	struct persistent_trace_record *rec;
 
-	rec = (struct persistent_trace_record *)(data->ptr + data->off);
+	unsigned long ip, word, depth;
 
-	seq_printf(s, "%ld %08lx  %08lx  %pf <- %pF\n",
-		rec->ip & 3, rec->ip, rec->parent_ip,
-		(void *)rec->ip, (void *)rec->parent_ip);
+	rec = (struct persistent_trace_record *)(data->ptr + data->off);
+	ip = rec->ip & ~REC_TYPE_MASK;
+	word = rec->parent_ip;
+	depth = (word >> REC_DEPTH_SHIFT) & REC_DEPTH_MASK;
+
+	switch (word & REC_TYPE_MASK) {
+	case REC_ENTRY:
+		seq_printf(s, "%ld %08lx  %*s%pf() {\n", rec->ip & 3, ip,
+			   (int)depth * 2, "", (void *)ip);
+		break;
+	case REC_RETURN:
+		seq_printf(s, "%ld %08lx  %*s} %lu us /* %pf */\n",
+			   rec->ip & 3, ip, (int)depth * 2, "",
+			   word >> REC_DURATION_SHIFT, (void *)ip);
+		break;
+	default:
+		seq_printf(s, "%ld %08lx  %08lx  %pf <- %pF\n",
+			rec->ip & 3, rec->ip, rec->parent_ip,
+			(void *)rec->ip, (void *)rec->parent_ip);
+		break;
+	}
 
 	return 0;
 }
@@ -218,6 +325,12 @@ static int __devinit persistent_trace_probe(struct platform_device *pdev)
 	if (ret)
 		pr_err("persistent_trace: failed to register tracer");
 
+#ifdef CONFIG_FUNCTION_GRAPH_TRACER
+	ret = register_tracer(&persistent_graph_tracer);
+	if (ret)
+		pr_err("persistent_trace: failed to register graph tracer");
+#endif
+
 	if (persistent_ram_old_size(persistent_trace) > 0) {
 		d = debugfs_create_file("persistent_trace", S_IRUGO, NULL,
 			NULL, &persistent_trace_old_fops);
@@ -44,6 +44,23 @@ static int gem_show(struct seq_file *m, void *arg)
 	return 0;
 }
 
+static int gem_stats_show(struct seq_file *m, void *arg)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	int ret;
+
+	ret = mutex_lock_interruptible(&dev->struct_mutex);
+	if (ret)
+		return ret;
+
+	omap_gem_stats_show(m);
+
+	mutex_unlock(&dev->struct_mutex);
+
+	return 0;
+}
+
 static int mm_show(struct seq_file *m, void *arg)
 {
 	struct drm_info_node *node = (struct drm_info_node *) m->private;
@@ -89,6 +106,7 @@ static int fb_show(struct seq_file *m, void *arg)
 /* list of debufs files that are applicable to all devices */
 static struct drm_info_list omap_debugfs_list[] = {
 	{"gem", gem_show, 0},
+	{"gem_stats", gem_stats_show, 0},
 	{"mm", mm_show, 0},
 	{"fb", fb_show, 0},
 };
@@ -96,6 +114,7 @@ static struct drm_info_list omap_debugfs_list[] = {
 /* list of debugfs files that are specific to devices with dmm/tiler */
 static struct drm_info_list omap_dmm_debugfs_list[] = {
 	{"tiler_map", tiler_map_show, 0},
+	{"tiler_stats", tiler_stats_show, 0},
 };
 
 int omap_debugfs_init(struct drm_minor *minor)
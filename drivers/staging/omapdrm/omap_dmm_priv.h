@@ -59,12 +59,12 @@
 #define DMM_IRQSTAT_ERR_UPD_DATA	(1<<6)
 #define DMM_IRQSTAT_ERR_LUT_MISS	(1<<7)
 
-#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQ_STAT_ERR_INV_DSC | \
-				DMM_IRQ_STAT_ERR_INV_DATA | \
-				DMM_IRQ_STAT_ERR_UPD_AREA | \
-				DMM_IRQ_STAT_ERR_UPD_CTRL | \
-				DMM_IRQ_STAT_ERR_UPD_DATA | \
-				DMM_IRQ_STAT_ERR_LUT_MISS)
+#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQSTAT_ERR_INV_DSC | \
+				DMM_IRQSTAT_ERR_INV_DATA | \
+				DMM_IRQSTAT_ERR_UPD_AREA | \
+				DMM_IRQSTAT_ERR_UPD_CTRL | \
+				DMM_IRQSTAT_ERR_UPD_DATA | \
+				DMM_IRQSTAT_ERR_LUT_MISS)
 
 #define DMM_PATSTATUS_READY		(1<<0)
 #define DMM_PATSTATUS_VALID		(1<<1)
@@ -110,6 +110,9 @@ struct pat {
 
 #define DMM_FIXED_RETRY_COUNT 1000
 
+/* a full container refill takes a few ms */
+#define DMM_REFILL_TIMEOUT_MS 50
+
 /* create refill buffer big enough to refill all slots, plus 3 descriptors..
  * 3 descriptors is probably the worst-case for # of 2d-slices in a 1d area,
  * but I guess you don't hit that worst case at the same time as full area
@@ -149,11 +152,26 @@ struct refill_engine {
 	/* offset to lut associated with container */
 	u32 *lut_offset;
 
-	wait_queue_head_t wait_for_refill;
+	/* refill in flight, released from the IRQ handler */
+	bool busy;
+	struct tiler_fence *fence;
+	ktime_t submitted;
 
 	struct list_head idle_node;
 };
 
+struct dmm_stats {
+	u32 refills;
+	u32 errors;
+	u32 timeouts;
+	u32 in_flight;
+	u32 max_in_flight;
+	u32 engine_waits;
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+};
+
 struct dmm {
 	struct device *dev;
 	void __iomem *base;
@@ -165,11 +183,13 @@ struct dmm {
 	void *refill_va;
 	dma_addr_t refill_pa;
 
-	/* refill engines */
+	/* refill engines, engine_lock protects the idle list and stats */
 	struct semaphore engine_sem;
+	spinlock_t engine_lock;
 	struct list_head idle_head;
 	struct refill_engine *engines;
 	int num_engines;
+	struct dmm_stats stats;
 
 	/* container information */
 	int container_width;
@@ -28,6 +28,8 @@
 #include <linux/delay.h>
 #include <linux/mm.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/list.h>
 #include <linux/semaphore.h>
 #include <linux/debugfs.h>
@@ -139,21 +141,68 @@ static int wait_status(struct refill_engine *engine, uint32_t wait_mask)
 	return 0;
 }
 
+/* give the engine back, called with engine_lock held */
+static void dmm_engine_release(struct refill_engine *engine)
+{
+	struct dmm *dmm = engine->dmm;
+
+	list_add(&engine->idle_node, &dmm->idle_head);
+	up(&dmm->engine_sem);
+}
+
+/* end of a refill, called with engine_lock held */
+static void dmm_engine_done(struct refill_engine *engine, int error)
+{
+	struct dmm *dmm = engine->dmm;
+	struct tiler_fence *fence = engine->fence;
+	u32 us = (u32)ktime_us_delta(ktime_get(), engine->submitted);
+
+	dmm->stats.in_flight--;
+	dmm->stats.last_us = us;
+	dmm->stats.total_us += us;
+	if (us > dmm->stats.max_us)
+		dmm->stats.max_us = us;
+	if (error)
+		dmm->stats.errors++;
+
+	engine->busy = false;
+	engine->fence = NULL;
+	if (fence) {
+		if (error)
+			fence->error = error;
+		if (atomic_dec_and_test(&fence->pending))
+			wake_up(&fence->wait);
+	}
+
+	dmm_engine_release(engine);
+}
+
 static irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 {
 	struct dmm *dmm = arg;
 	uint32_t status = readl(dmm->base + DMM_PAT_IRQSTATUS);
+	struct refill_engine *engine;
 	int i;
 
 	/* ack IRQ */
 	writel(status, dmm->base + DMM_PAT_IRQSTATUS);
 
-	for (i = 0; i < dmm->num_engines; i++) {
-		if (status & DMM_IRQSTAT_LST)
-			wake_up_interruptible(&dmm->engines[i].wait_for_refill);
+	spin_lock(&dmm->engine_lock);
+	for (i = 0; dmm->engines && i < dmm->num_engines; i++) {
+		engine = &dmm->engines[i];
+
+		if (engine->busy && (status & DMM_IRQSTAT_ERR_MASK &
+				     ~DMM_IRQSTAT_ERR_LUT_MISS)) {
+			dev_err(dmm->dev, "refill engine %d error 0x%02x\n",
+				i, status & 0xff);
+			dmm_engine_done(engine, -EFAULT);
+		} else if (engine->busy && (status & DMM_IRQSTAT_LST)) {
+			dmm_engine_done(engine, 0);
+		}
 
 		status >>= 8;
 	}
+	spin_unlock(&dmm->engine_lock);
 
 	return IRQ_HANDLED;
 }
@@ -165,17 +214,24 @@ static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
 {
 	struct dmm_txn *txn = NULL;
 	struct refill_engine *engine = NULL;
+	unsigned long flags;
 
-	down(&dmm->engine_sem);
+	/* all the engines busy, the submission waits for one */
+	if (down_trylock(&dmm->engine_sem)) {
+		spin_lock_irqsave(&dmm->engine_lock, flags);
+		dmm->stats.engine_waits++;
+		spin_unlock_irqrestore(&dmm->engine_lock, flags);
+		down(&dmm->engine_sem);
+	}
 
 	/* grab an idle engine */
-	spin_lock(&list_lock);
+	spin_lock_irqsave(&dmm->engine_lock, flags);
 	if (!list_empty(&dmm->idle_head)) {
 		engine = list_entry(dmm->idle_head.next, struct refill_engine,
 					idle_node);
 		list_del(&engine->idle_node);
 	}
-	spin_unlock(&list_lock);
+	spin_unlock_irqrestore(&dmm->engine_lock, flags);
 
 	BUG_ON(!engine);
 
@@ -251,13 +307,15 @@ static int dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 }
 
 /**
- * Commit the DMM transaction.
+ * Commit the DMM transaction. The engine is given back once the refill
+ * is done, from the IRQ handler, which also signals @fence (if any).
  */
-static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
+static int dmm_txn_commit(struct dmm_txn *txn, struct tiler_fence *fence)
 {
 	int ret = 0;
 	struct refill_engine *engine = txn->engine_handle;
 	struct dmm *dmm = engine->dmm;
+	unsigned long flags;
 
 	if (!txn->last_pat) {
 		dev_err(engine->dmm->dev, "need at least one txn\n");
@@ -277,33 +335,73 @@ static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
 		goto cleanup;
 	}
 
+	spin_lock_irqsave(&dmm->engine_lock, flags);
+	engine->busy = true;
+	engine->fence = fence;
+	if (fence)
+		atomic_inc(&fence->pending);
+	engine->submitted = ktime_get();
+	dmm->stats.refills++;
+	if (++dmm->stats.in_flight > dmm->stats.max_in_flight)
+		dmm->stats.max_in_flight = dmm->stats.in_flight;
+	spin_unlock_irqrestore(&dmm->engine_lock, flags);
+
 	/* kick reload */
 	writel(engine->refill_pa,
 		dmm->base + reg[PAT_DESCR][engine->id]);
 
-	if (wait) {
-		if (wait_event_interruptible_timeout(engine->wait_for_refill,
-				wait_status(engine, DMM_PATSTATUS_READY) == 0,
-				msecs_to_jiffies(1)) <= 0) {
-			dev_err(dmm->dev, "timed out waiting for done\n");
-			ret = -ETIMEDOUT;
-		}
-	}
+	return 0;
 
 cleanup:
-	spin_lock(&list_lock);
-	list_add(&engine->idle_node, &dmm->idle_head);
-	spin_unlock(&list_lock);
-
-	up(&omap_dmm->engine_sem);
+	spin_lock_irqsave(&dmm->engine_lock, flags);
+	dmm_engine_release(engine);
+	spin_unlock_irqrestore(&dmm->engine_lock, flags);
 	return ret;
 }
 
+void tiler_fence_init(struct tiler_fence *fence)
+{
+	atomic_set(&fence->pending, 0);
+	fence->error = 0;
+	init_waitqueue_head(&fence->wait);
+}
+EXPORT_SYMBOL(tiler_fence_init);
+
+/**
+ * Wait for all the refills signalling @fence. On timeout the engines still
+ * running are taken back (the next refill on them resets them first).
+ */
+int tiler_fence_wait(struct tiler_fence *fence)
+{
+	struct dmm *dmm = omap_dmm;
+	unsigned long flags;
+	int i;
+
+	if (wait_event_timeout(fence->wait, !atomic_read(&fence->pending),
+			msecs_to_jiffies(DMM_REFILL_TIMEOUT_MS)))
+		return fence->error;
+
+	spin_lock_irqsave(&dmm->engine_lock, flags);
+	for (i = 0; i < dmm->num_engines; i++) {
+		struct refill_engine *engine = &dmm->engines[i];
+
+		if (engine->busy && engine->fence == fence) {
+			dmm->stats.timeouts++;
+			dmm_engine_done(engine, -ETIMEDOUT);
+		}
+	}
+	spin_unlock_irqrestore(&dmm->engine_lock, flags);
+
+	dev_err(dmm->dev, "timed out waiting for done\n");
+	return -ETIMEDOUT;
+}
+EXPORT_SYMBOL(tiler_fence_wait);
+
 /*
  * DMM programming
  */
-static int fill(struct tcm_area *area, struct mem_info *mem, uint32_t npages,
-		uint32_t roll, bool wait)
+static int fill_async(struct tcm_area *area, struct mem_info *mem,
+		uint32_t npages, uint32_t roll, struct tiler_fence *fence)
 {
 	int ret = 0;
 	struct tcm_area slice, area_s;
@@ -331,12 +429,28 @@ static int fill(struct tcm_area *area, struct mem_info *mem, uint32_t npages,
 		roll += tcm_sizeof(slice);
 	}
 
-	ret = dmm_txn_commit(txn, wait);
+	ret = dmm_txn_commit(txn, fence);
 
 fail:
 	return ret;
 }
 
+static int fill(struct tcm_area *area, struct mem_info *mem, uint32_t npages,
+		uint32_t roll, bool wait)
+{
+	struct tiler_fence fence;
+	int ret, err;
+
+	if (!wait)
+		return fill_async(area, mem, npages, roll, NULL);
+
+	tiler_fence_init(&fence);
+	ret = fill_async(area, mem, npages, roll, &fence);
+	err = tiler_fence_wait(&fence);
+
+	return ret ? ret : err;
+}
+
 /*
  * Pin/unpin
  */
@@ -361,6 +475,48 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 }
 EXPORT_SYMBOL(tiler_pin);
 
+int tiler_pin_async(struct tiler_block *block, struct page **pages,
+		uint32_t npages, uint32_t roll, struct tiler_fence *fence)
+{
+	struct mem_info mem;
+
+	mem.type = MEMTYPE_PAGES;
+	mem.pages = pages;
+
+	return fill_async(&block->area, &mem, npages, roll, fence);
+}
+EXPORT_SYMBOL(tiler_pin_async);
+
+/*
+ * Pin several blocks at once: the refills are spread over all the engines
+ * and waited for together. On failure none of the blocks is left pinned.
+ */
+int tiler_pin_batch(struct tiler_pin_req *reqs, int count)
+{
+	struct tiler_fence fence;
+	int i, n, ret = 0, err;
+
+	tiler_fence_init(&fence);
+
+	for (n = 0; n < count; n++) {
+		ret = tiler_pin_async(reqs[n].block, reqs[n].pages,
+				reqs[n].npages, reqs[n].roll, &fence);
+		if (ret)
+			break;
+	}
+
+	err = tiler_fence_wait(&fence);
+	if (!ret)
+		ret = err;
+
+	if (ret)
+		for (i = 0; i < count; i++)
+			tiler_unpin(reqs[i].block);
+
+	return ret;
+}
+EXPORT_SYMBOL(tiler_pin_batch);
+
 int tiler_unpin(struct tiler_block *block)
 {
 	return fill(&block->area, NULL, 0, 0, false);
@@ -381,6 +537,58 @@ int tiler_pin_phys(struct tiler_block *block, u32 *phys_addrs,
 }
 EXPORT_SYMBOL(tiler_pin_phys);
 
+/* limit a copy of a 1D block's area to 'num_pages' slots at 'offset' */
+static int tiler_1d_subarea(struct tiler_block *block, u32 offset,
+			u32 num_pages, struct tcm_area *area)
+{
+	u32 start;
+
+	if (block->area.is2d || offset >= tcm_sizeof(block->area))
+		return -EINVAL;
+
+	*area = block->area;
+	start = area->p0.y * area->tcm->width + area->p0.x + offset;
+	area->p0.x = start % area->tcm->width;
+	area->p0.y = start / area->tcm->width;
+
+	return tcm_1d_limit(area, num_pages);
+}
+
+/*
+ * Pin/unpin only part of a 1D block, leaving the mapping of the rest of the
+ * block alone, so that a block can be shared by several users.
+ */
+int tiler_pin_phys_range(struct tiler_block *block, u32 offset,
+			u32 *phys_addrs, u32 num_pages)
+{
+	struct tcm_area area;
+	struct mem_info mem;
+	int ret;
+
+	ret = tiler_1d_subarea(block, offset, num_pages, &area);
+	if (ret)
+		return ret;
+
+	mem.type = MEMTYPE_CARVEOUT;
+	mem.phys_addrs = phys_addrs;
+
+	return fill(&area, &mem, num_pages, 0, true);
+}
+EXPORT_SYMBOL(tiler_pin_phys_range);
+
+int tiler_unpin_range(struct tiler_block *block, u32 offset, u32 num_pages)
+{
+	struct tcm_area area;
+	int ret;
+
+	ret = tiler_1d_subarea(block, offset, num_pages, &area);
+	if (ret)
+		return ret;
+
+	return fill(&area, NULL, 0, 0, false);
+}
+EXPORT_SYMBOL(tiler_unpin_range);
+
 /*
  * Reserve/release
  */
@@ -809,6 +1017,7 @@ static int omap_dmm_probe(struct platform_device *dev)
 	/* initialize lists */
 	INIT_LIST_HEAD(&omap_dmm->alloc_head);
 	INIT_LIST_HEAD(&omap_dmm->idle_head);
+	spin_lock_init(&omap_dmm->engine_lock);
 
 	/* lookup hwmod data - base address and irq */
 	mem = platform_get_resource(dev, IORESOURCE_MEM, 0);
@@ -932,8 +1141,6 @@ static int omap_dmm_probe(struct platform_device *dev)
 						(REFILL_BUFFER_SIZE * i);
 		omap_dmm->engines[i].refill_pa = omap_dmm->refill_pa +
 						(REFILL_BUFFER_SIZE * i);
-		init_waitqueue_head(&omap_dmm->engines[i].wait_for_refill);
-
 		list_add(&omap_dmm->engines[i].idle_node, &omap_dmm->idle_head);
 	}
 
@@ -1188,16 +1395,47 @@ error:
 	return 0;
 }
 EXPORT_SYMBOL(tiler_map_show);
+
+int tiler_stats_show(struct seq_file *s, void *arg)
+{
+	struct dmm_stats stats;
+	unsigned long flags;
+	u32 done;
+
+	if (!omap_dmm)
+		return 0;
+
+	spin_lock_irqsave(&omap_dmm->engine_lock, flags);
+	stats = omap_dmm->stats;
+	spin_unlock_irqrestore(&omap_dmm->engine_lock, flags);
+
+	seq_printf(s, "engines:        %d\n", omap_dmm->num_engines);
+	seq_printf(s, "refills:        %u\n", stats.refills);
+	seq_printf(s, "errors:         %u\n", stats.errors);
+	seq_printf(s, "timeouts:       %u\n", stats.timeouts);
+	seq_printf(s, "in_flight:      %u\n", stats.in_flight);
+	seq_printf(s, "max_in_flight:  %u\n", stats.max_in_flight);
+	seq_printf(s, "engine_waits:   %u\n", stats.engine_waits);
+	seq_printf(s, "last_us:        %u\n", stats.last_us);
+	seq_printf(s, "max_us:         %u\n", stats.max_us);
+	done = stats.refills - stats.in_flight;
+	seq_printf(s, "avg_us:         %llu\n", done ?
+		   div_u64(stats.total_us, done) : 0);
+
+	return 0;
+}
+EXPORT_SYMBOL(tiler_stats_show);
 #endif
 
 #ifdef CONFIG_PM
 static int omap_dmm_resume(struct device *dev)
 {
 	struct page **pages;
-	struct tcm_area area = {0};
-	int number_slots;
-	struct mem_info mem;
-	int i, j;
+	struct tcm_area area = {0}, band;
+	struct tiler_fence fence;
+	int number_slots, width, height, rows;
+	struct mem_info mem, band_mem;
+	int i, j, y;
 
 	if (!dmm_is_initialized()) {
 		dev_err(dev, "%s: DMM not initialized\n", __func__);
@@ -1213,9 +1451,16 @@ static int omap_dmm_resume(struct device *dev)
 		return -ENOMEM;
 	}
 
-	area.p1.x = omap_dmm->container_width - 1;
-	area.p1.y = omap_dmm->container_height - 1;
+	width = omap_dmm->container_width;
+	height = omap_dmm->container_height;
+	area.p1.x = width - 1;
+	area.p1.y = height - 1;
 	mem.type = MEMTYPE_PAGES;
+	band_mem.type = MEMTYPE_PAGES;
+
+	/* refill bands of rows on all the engines at once */
+	rows = DIV_ROUND_UP(height, omap_dmm->num_engines);
+	tiler_fence_init(&fence);
 
 	for (i = 0; i < omap_dmm->num_lut; i++) {
 		area.tcm = omap_dmm->tcm[i];
@@ -1228,11 +1473,21 @@ static int omap_dmm_resume(struct device *dev)
 				mem.pages[j] = NULL;
 		}
 
-		if (fill(&area, &mem, omap_dmm->container_width *
-				omap_dmm->container_height, 0, true))
-			dev_err(omap_dmm->dev, "refill failed");
+		for (y = 0; y < height; y += rows) {
+			band = area;
+			band.p0.y = y;
+			band.p1.y = min(y + rows, height) - 1;
+			band_mem.pages = mem.pages + y * width;
+
+			if (fill_async(&band, &band_mem,
+					(band.p1.y - y + 1) * width, 0, &fence))
+				dev_err(omap_dmm->dev, "refill failed");
+		}
 	}
 
+	if (tiler_fence_wait(&fence))
+		dev_err(omap_dmm->dev, "refill failed");
+
 	dev_info(omap_dmm->dev, "%s: omap_dmm_resume:PAT entries restored\n",
 			__func__);
 
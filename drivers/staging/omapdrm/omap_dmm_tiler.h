@@ -46,6 +46,21 @@ struct tiler_block {
 						PAGE_SIZE */
 };
 
+/* completion of a set of asynchronous refills */
+struct tiler_fence {
+	atomic_t pending;
+	int error;
+	wait_queue_head_t wait;
+};
+
+/* one block of a batched pin, see tiler_pin() */
+struct tiler_pin_req {
+	struct tiler_block *block;
+	struct page **pages;
+	uint32_t npages;
+	uint32_t roll;
+};
+
 /* bits representing the same slot in DMM-TILER hw-block */
 #define SLOT_WIDTH_BITS         6
 #define SLOT_HEIGHT_BITS        6
@@ -88,6 +103,7 @@ struct tiler_block {
 
 #ifdef CONFIG_DEBUG_FS
 int tiler_map_show(struct seq_file *s, void *arg);
+int tiler_stats_show(struct seq_file *s, void *arg);
 #endif
 
 /* pin/unpin */
@@ -95,6 +111,16 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait);
 int tiler_pin_phys(struct tiler_block *block, u32 *phys_addrs, u32 num_pages);
 int tiler_unpin(struct tiler_block *block);
+int tiler_pin_phys_range(struct tiler_block *block, u32 offset,
+		u32 *phys_addrs, u32 num_pages);
+int tiler_unpin_range(struct tiler_block *block, u32 offset, u32 num_pages);
+int tiler_pin_batch(struct tiler_pin_req *reqs, int count);
+
+/* asynchronous pin */
+void tiler_fence_init(struct tiler_fence *fence);
+int tiler_fence_wait(struct tiler_fence *fence);
+int tiler_pin_async(struct tiler_block *block, struct page **pages,
+		uint32_t npages, uint32_t roll, struct tiler_fence *fence);
 
 /* reserve/release */
 struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w, uint16_t h,
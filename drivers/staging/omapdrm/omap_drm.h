@@ -69,20 +69,32 @@ enum omap_gem_op {
 	OMAP_GEM_WRITE = 0x02,
 };
 
+/* byte range of a buffer accessed by sw, ie. a run of rows of a frame */
+struct drm_omap_gem_region {
+	uint32_t offset;
+	uint32_t size;
+};
+
+#define OMAP_GEM_MAX_REGIONS	256
+
+/* For cached buffers, prep for read invalidates and fini for write cleans
+ * the cpu caches over the regions touched by sw, or over the whole buffer
+ * if nregions is zero.
+ */
 struct drm_omap_gem_cpu_prep {
 	uint32_t handle;		/* buffer handle (in) */
 	uint32_t op;			/* mask of omap_gem_op (in) */
+	uint32_t nregions;		/* number of regions (in) */
+	uint32_t __pad;
+	uint64_t regions;		/* ptr to drm_omap_gem_region array (in) */
 };
 
 struct drm_omap_gem_cpu_fini {
 	uint32_t handle;		/* buffer handle (in) */
 	uint32_t op;			/* mask of omap_gem_op (in) */
-	/* TODO maybe here we pass down info about what regions are touched
-	 * by sw so we can be clever about cache ops?  For now a placeholder,
-	 * set to zero and we just do full buffer flush..
-	 */
-	uint32_t nregions;
+	uint32_t nregions;		/* number of regions (in) */
 	uint32_t __pad;
+	uint64_t regions;		/* ptr to drm_omap_gem_region array (in) */
 };
 
 struct drm_omap_gem_info {
@@ -458,27 +458,65 @@ static int ioctl_gem_new(struct drm_device *dev, void *data,
 			args->flags, &args->handle);
 }
 
+/* copy in the regions passed to cpu_prep/cpu_fini, if any */
+static struct drm_omap_gem_region *get_regions(uint64_t ptr, uint32_t nregions)
+{
+	struct drm_omap_gem_region *regions;
+	size_t size = nregions * sizeof(*regions);
+
+	if (!nregions)
+		return NULL;
+
+	if (nregions > OMAP_GEM_MAX_REGIONS)
+		return ERR_PTR(-EINVAL);
+
+	regions = kmalloc(size, GFP_KERNEL);
+	if (!regions)
+		return ERR_PTR(-ENOMEM);
+
+	if (copy_from_user(regions, (void __user *)(uintptr_t)ptr, size)) {
+		kfree(regions);
+		return ERR_PTR(-EFAULT);
+	}
+
+	return regions;
+}
+
 static int ioctl_gem_cpu_prep(struct drm_device *dev, void *data,
 		struct drm_file *file_priv)
 {
 	struct drm_omap_gem_cpu_prep *args = data;
+	struct drm_omap_gem_region *regions;
 	struct drm_gem_object *obj;
 	int ret;
 
-	VERB("%p:%p: handle=%d, op=%x", dev, file_priv, args->handle, args->op);
+	VERB("%p:%p: handle=%d, op=%x, nregions=%d", dev, file_priv,
+			args->handle, args->op, args->nregions);
+
+	regions = get_regions(args->regions, args->nregions);
+	if (IS_ERR(regions))
+		return PTR_ERR(regions);
 
 	obj = drm_gem_object_lookup(dev, file_priv, args->handle);
 	if (!obj) {
+		kfree(regions);
 		return -ENOENT;
 	}
 
 	ret = omap_gem_op_sync(obj, args->op);
 
+	/* drop stale lines before sw reads what hw wrote: */
+	if (!ret && (args->op & OMAP_GEM_READ)) {
+		ret = omap_gem_cpu_sync(obj, DMA_FROM_DEVICE,
+				regions, args->nregions);
+	}
+
 	if (!ret) {
 		ret = omap_gem_op_start(obj, args->op);
 	}
 
 	drm_gem_object_unreference_unlocked(obj);
+	kfree(regions);
 
 	return ret;
 }
@@ -487,24 +525,35 @@ static int ioctl_gem_cpu_fini(struct drm_device *dev, void *data,
 		struct drm_file *file_priv)
 {
 	struct drm_omap_gem_cpu_fini *args = data;
+	struct drm_omap_gem_region *regions;
 	struct drm_gem_object *obj;
-	int ret;
+	int ret = 0;
 
-	VERB("%p:%p: handle=%d", dev, file_priv, args->handle);
+	VERB("%p:%p: handle=%d, op=%x, nregions=%d", dev, file_priv,
+			args->handle, args->op, args->nregions);
+
+	regions = get_regions(args->regions, args->nregions);
+	if (IS_ERR(regions))
+		return PTR_ERR(regions);
 
 	obj = drm_gem_object_lookup(dev, file_priv, args->handle);
 	if (!obj) {
+		kfree(regions);
 		return -ENOENT;
 	}
 
-	/* XXX flushy, flushy */
-	ret = 0;
+	/* write back what sw wrote before hw reads it: */
+	if (args->op & OMAP_GEM_WRITE) {
+		ret = omap_gem_cpu_sync(obj, DMA_TO_DEVICE,
+				regions, args->nregions);
+	}
 
 	if (!ret) {
 		ret = omap_gem_op_finish(obj, args->op);
 	}
 
 	drm_gem_object_unreference_unlocked(obj);
+	kfree(regions);
 
 	return ret;
 }
@@ -746,7 +795,8 @@ static const struct file_operations omapdriver_fops = {
 
 static struct drm_driver omap_drm_driver = {
 		.driver_features =
-				DRIVER_HAVE_IRQ | DRIVER_MODESET | DRIVER_GEM,
+				DRIVER_HAVE_IRQ | DRIVER_MODESET | DRIVER_GEM |
+				DRIVER_PRIME,
 		.load = dev_load,
 		.unload = dev_unload,
 		.open = dev_open,
@@ -769,6 +819,10 @@ static struct drm_driver omap_drm_driver = {
 		.gem_init_object = omap_gem_init_object,
 		.gem_free_object = omap_gem_free_object,
 		.gem_vm_ops = &omap_gem_vm_ops,
+		.prime_handle_to_fd = drm_gem_prime_handle_to_fd,
+		.prime_fd_to_handle = drm_gem_prime_fd_to_handle,
+		.gem_prime_export = omap_gem_prime_export,
+		.gem_prime_import = omap_gem_prime_import,
 		.dumb_create = omap_gem_dumb_create,
 		.dumb_map_offset = omap_gem_dumb_map_offset,
 		.dumb_destroy = omap_gem_dumb_destroy,
@@ -171,7 +171,7 @@ void omap_framebuffer_update_scanout(struct drm_framebuffer *fb, int x, int y,
  * caller can defer unpin until vblank.
  *
  * Note if this fails (ie. something went very wrong!), all buffers are
- * unpinned, and the caller disables the overlay.  We could have tried
+ * left unpinned, and the caller disables the overlay.  We could have tried
  * to revert back to the previous set of pinned buffers but if things are
  * hosed there is no guarantee that would succeed.
  */
@@ -182,37 +182,32 @@ int omap_framebuffer_replace(struct drm_framebuffer *a,
 	int ret = 0, i, na, nb;
 	struct omap_framebuffer *ofba = to_omap_framebuffer(a);
 	struct omap_framebuffer *ofbb = to_omap_framebuffer(b);
+	struct drm_gem_object *bos[ARRAY_SIZE(ofbb->planes)];
+	dma_addr_t paddrs[ARRAY_SIZE(ofbb->planes)];
 
 	na = a ? drm_format_num_planes(a->pixel_format) : 0;
 	nb = b ? drm_format_num_planes(b->pixel_format) : 0;
 
-	for (i = 0; i < max(na, nb); i++) {
-		struct plane *pa, *pb;
+	for (i = 0; i < na; i++) {
+		unpin(arg, ofba->planes[i].bo);
+		ofba->planes[i].paddr = 0;
+	}
 
-		pa = (i < na) ? &ofba->planes[i] : NULL;
-		pb = (i < nb) ? &ofbb->planes[i] : NULL;
+	if (!nb)
+		return 0;
 
-		if (pa) {
-			unpin(arg, pa->bo);
-			pa->paddr = 0;
-		}
+	/* pin all the planes in one pass, on failure none is pinned */
+	for (i = 0; i < nb; i++)
+		bos[i] = ofbb->planes[i].bo;
 
-		if (pb && !ret)
-			ret = omap_gem_get_paddr(pb->bo, &pb->paddr, true);
-	}
+	ret = omap_gem_get_paddrs(bos, paddrs, nb);
+	if (ret)
+		return ret;
 
-	if (ret) {
-		/* something went wrong.. unpin what has been pinned */
-		for (i = 0; i < nb; i++) {
-			struct plane *pb = &ofba->planes[i];
-			if (pb->paddr) {
-				unpin(arg, pb->bo);
-				pb->paddr = 0;
-			}
-		}
-	}
+	for (i = 0; i < nb; i++)
+		ofbb->planes[i].paddr = paddrs[i];
 
-	return ret;
+	return 0;
 }
 
 struct drm_gem_object *omap_framebuffer_bo(struct drm_framebuffer *fb, int p)
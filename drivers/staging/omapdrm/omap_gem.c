@@ -89,11 +89,22 @@ struct omap_gem_object {
 	/** addresses corresponding to pages in above array */
 	dma_addr_t *addrs;
 
+	/** mapping of an imported dma-buf, if obj->import_attach is set */
+	struct sg_table *sgt;
+
 	/**
 	 * Virtual address, if mapped.
 	 */
 	void *vaddr;
 
+	/**
+	 * Page offset (1d) or usergart chunk (2d) expected to fault next if
+	 * userspace is accessing the buffer sequentially, and the current
+	 * number of pages mapped ahead on a 1d fault.
+	 */
+	pgoff_t next_pgoff;
+	int prefetch;
+
 	/**
 	 * sync-object allocated on demand (if needed)
 	 *
@@ -132,7 +143,7 @@ static uint64_t mmap_offset(struct drm_gem_object *obj);
  * tiler containers are backed by the same PAT.. but I'll leave that
  * for later..
  */
-#define NUM_USERGART_ENTRIES 2
+#define NUM_USERGART_ENTRIES 4
 struct usergart_entry {
 	struct tiler_block *block;	/* the reserved tiler block */
 	dma_addr_t paddr;
@@ -149,6 +160,20 @@ static struct {
 	int last;				/* index of last used entry */
 } *usergart;
 
+/* max # of pages mapped ahead on sequential faults of 1d buffers */
+#define MAX_PREFETCH_PAGES 16
+
+static struct {
+	unsigned long faults_1d;
+	unsigned long faults_2d;
+	unsigned long prefetch_pages;	/* 1d pages mapped ahead */
+	unsigned long prefetch_chunks;	/* 2d chunks mapped ahead */
+	unsigned long evictions;	/* usergart entries evicted */
+	unsigned long syncs;
+	uint64_t clean_bytes;
+	uint64_t inval_bytes;
+} gem_stats;
+
 static void evict_entry(struct drm_gem_object *obj,
 		enum tiler_fmt fmt, struct usergart_entry *entry)
 {
@@ -173,6 +198,7 @@ static void evict_entry(struct drm_gem_object *obj,
 	}
 
 	entry->obj = NULL;
+	gem_stats.evictions++;
 }
 
 /* Evict a buffer from usergart, if it is mapped there */
@@ -322,37 +348,68 @@ static int fault_1d(struct drm_gem_object *obj,
 		struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
-	unsigned long pfn;
-	pgoff_t pgoff;
+	unsigned long pfn, vaddr = (unsigned long)vmf->virtual_address;
+	pgoff_t pgoff, npages;
+	int i, ret;
 
 	/* We don't use vmf->pgoff since that has the fake offset: */
-	pgoff = ((unsigned long)vmf->virtual_address -
-			vma->vm_start) >> PAGE_SHIFT;
+	pgoff = (vaddr - vma->vm_start) >> PAGE_SHIFT;
 
-	if (omap_obj->pages) {
-		pfn = page_to_pfn(omap_obj->pages[pgoff]);
-	} else {
-		BUG_ON(!(omap_obj->flags & OMAP_BO_DMA));
-		pfn = (omap_obj->paddr >> PAGE_SHIFT) + pgoff;
-	}
+	/* if the previous fault was on the page just before, map in a
+	 * growing window of pages ahead of this one:
+	 */
+	if (pgoff == omap_obj->next_pgoff)
+		omap_obj->prefetch = min(omap_obj->prefetch * 2,
+				MAX_PREFETCH_PAGES);
+	else
+		omap_obj->prefetch = 1;
+
+	npages = min_t(pgoff_t, omap_obj->prefetch,
+			(obj->size >> PAGE_SHIFT) - pgoff);
+	npages = min_t(pgoff_t, npages, (vma->vm_end - vaddr) >> PAGE_SHIFT);
 
-	VERB("Inserting %p pfn %lx, pa %lx", vmf->virtual_address,
-			pfn, pfn << PAGE_SHIFT);
+	omap_obj->next_pgoff = pgoff + npages;
+	gem_stats.faults_1d++;
+
+	for (i = 0; i < npages; i++) {
+		if (omap_obj->pages) {
+			pfn = page_to_pfn(omap_obj->pages[pgoff + i]);
+		} else {
+			BUG_ON(!(omap_obj->flags & OMAP_BO_DMA));
+			pfn = (omap_obj->paddr >> PAGE_SHIFT) + pgoff + i;
+		}
+
+		VERB("Inserting %lx pfn %lx, pa %lx", vaddr,
+				pfn, pfn << PAGE_SHIFT);
+
+		ret = vm_insert_mixed(vma, vaddr, pfn);
+
+		/* pages ahead may already be mapped, that is fine: */
+		if (i == 0 && ret)
+			return ret;
+		else if (i > 0 && !ret)
+			gem_stats.prefetch_pages++;
 
-	return vm_insert_mixed(vma, (unsigned long)vmf->virtual_address, pfn);
+		vaddr += PAGE_SIZE;
+	}
+
+	return 0;
 }
 
-/* Special handling for the case of faulting in 2d tiled buffers */
-static int fault_2d(struct drm_gem_object *obj,
-		struct vm_area_struct *vma, struct vm_fault *vmf)
+/* Map one usergart chunk (n rows, one page wide) of a 2d tiled buffer
+ * containing virtual page offset @pgoff into the next usergart entry,
+ * returning the page offset of the first page of the chunk thru @chunk.
+ */
+static int map_chunk_2d(struct drm_gem_object *obj,
+		struct vm_area_struct *vma, pgoff_t pgoff, pgoff_t *chunk)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	struct usergart_entry *entry;
 	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
 	struct page *pages[64];  /* XXX is this too much to have on stack? */
 	unsigned long pfn;
-	pgoff_t pgoff, base_pgoff;
-	void __user *vaddr;
+	pgoff_t base_pgoff;
+	unsigned long vaddr;
 	int i, ret, slots;
 
 	/*
@@ -371,10 +428,6 @@ static int fault_2d(struct drm_gem_object *obj,
 	 */
 	const int m = 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
 
-	/* We don't use vmf->pgoff since that has the fake offset: */
-	pgoff = ((unsigned long)vmf->virtual_address -
-			vma->vm_start) >> PAGE_SHIFT;
-
 	/*
 	 * Actual address we start mapping at is rounded down to previous slot
 	 * boundary in the y direction:
@@ -384,7 +437,7 @@ static int fault_2d(struct drm_gem_object *obj,
 	/* figure out buffer width in slots */
 	slots = omap_obj->width >> usergart[fmt].slot_shift;
 
-	vaddr = vmf->virtual_address - ((pgoff - base_pgoff) << PAGE_SHIFT);
+	vaddr = vma->vm_start + (base_pgoff << PAGE_SHIFT);
 
 	entry = &usergart[fmt].entry[usergart[fmt].last];
 
@@ -403,11 +456,13 @@ static int fault_2d(struct drm_gem_object *obj,
 		int off = pgoff % m;
 		entry->obj_pgoff += off;
 		base_pgoff /= m;
-		slots = min(slots - (off << n_shift), n);
+		slots = clamp(slots - (off << n_shift), 0, n);
 		base_pgoff += off << n_shift;
 		vaddr += off << PAGE_SHIFT;
 	}
 
+	*chunk = entry->obj_pgoff;
+
 	/*
 	 * Map in pages. Beyond the valid pixel part of the buffer, we set
 	 * pages[i] to NULL to get a dummy page mapped in.. if someone
@@ -423,16 +478,16 @@ static int fault_2d(struct drm_gem_object *obj,
 	ret = tiler_pin(entry->block, pages, ARRAY_SIZE(pages), 0, true);
 	if (ret) {
 		dev_err(obj->dev->dev, "failed to pin: %d\n", ret);
+		entry->obj = NULL;
 		return ret;
 	}
 
 	pfn = entry->paddr >> PAGE_SHIFT;
 
-	VERB("Inserting %p pfn %lx, pa %lx", vmf->virtual_address,
-			pfn, pfn << PAGE_SHIFT);
+	VERB("Inserting %lx pfn %lx, pa %lx", vaddr, pfn, pfn << PAGE_SHIFT);
 
 	for (i = n; i > 0; i--) {
-		vm_insert_mixed(vma, (unsigned long)vaddr, pfn);
+		vm_insert_mixed(vma, vaddr, pfn);
 		pfn += usergart[fmt].stride_pfn;
 		vaddr += PAGE_SIZE * m;
 	}
@@ -443,6 +498,57 @@ static int fault_2d(struct drm_gem_object *obj,
 	return 0;
 }
 
+/* The chunk following @chunk in memory order: the next page wide column
+ * of the same slot-row, or the first column of the next slot-row.
+ */
+static pgoff_t next_chunk_2d(struct omap_gem_object *omap_obj, pgoff_t chunk)
+{
+	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
+	const int m = 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
+
+	if ((chunk % m) + 1 < m)
+		return chunk + 1;
+
+	return round_down(chunk, m) + (m << usergart[fmt].height_shift);
+}
+
+/* Special handling for the case of faulting in 2d tiled buffers */
+static int fault_2d(struct drm_gem_object *obj,
+		struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	pgoff_t pgoff, chunk, next;
+	int ret;
+
+	/* We don't use vmf->pgoff since that has the fake offset: */
+	pgoff = ((unsigned long)vmf->virtual_address -
+			vma->vm_start) >> PAGE_SHIFT;
+
+	ret = map_chunk_2d(obj, vma, pgoff, &chunk);
+	if (ret)
+		return ret;
+
+	gem_stats.faults_2d++;
+
+	next = next_chunk_2d(omap_obj, chunk);
+
+	/* if userspace walks the buffer in order, map the following chunk
+	 * into the next usergart entry now rather than taking another fault
+	 * for it.  Failing to do so is not an error for this fault.
+	 */
+	if (chunk == omap_obj->next_pgoff &&
+			next < (vma->vm_end - vma->vm_start) >> PAGE_SHIFT &&
+			next < omap_gem_mmap_size(obj) >> PAGE_SHIFT &&
+			!map_chunk_2d(obj, vma, next, &next)) {
+		gem_stats.prefetch_chunks++;
+		next = next_chunk_2d(omap_obj, next);
+	}
+
+	omap_obj->next_pgoff = next;
+
+	return 0;
+}
+
 /**
  * omap_gem_fault		-	pagefault handler for GEM objects
  * @vma: the VMA of the GEM object
@@ -646,68 +752,144 @@ fail:
 int omap_gem_get_paddr(struct drm_gem_object *obj,
 		dma_addr_t *paddr, bool remap)
 {
-	struct omap_drm_private *priv = obj->dev->dev_private;
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
-	int ret = 0;
+
+	if (remap)
+		return omap_gem_get_paddrs(&obj, paddr, 1);
+
+	if (!(omap_obj->flags & OMAP_BO_DMA))
+		return -EINVAL;
 
 	mutex_lock(&obj->dev->struct_mutex);
+	*paddr = omap_obj->paddr;
+	mutex_unlock(&obj->dev->struct_mutex);
 
-	if (remap && is_shmem(obj) && priv->has_dmm) {
-		if (omap_obj->paddr_cnt == 0) {
-			struct page **pages;
-			uint32_t npages = obj->size >> PAGE_SHIFT;
-			enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
-			struct tiler_block *block;
+	return 0;
+}
 
-			BUG_ON(omap_obj->block);
+/* reserve the TILER block an object gets remapped into */
+static int reserve_block(struct drm_gem_object *obj,
+		struct tiler_pin_req *req)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
+	struct tiler_block *block;
+	struct page **pages;
+	int ret;
 
-			ret = get_pages(obj, &pages);
-			if (ret)
-				goto fail;
+	BUG_ON(omap_obj->block);
 
-			if (omap_obj->flags & OMAP_BO_TILED) {
-				block = tiler_reserve_2d(fmt,
-						omap_obj->width,
-						omap_obj->height, 0);
-			} else {
-				block = tiler_reserve_1d(obj->size);
-			}
+	ret = get_pages(obj, &pages);
+	if (ret)
+		return ret;
 
-			if (IS_ERR(block)) {
-				ret = PTR_ERR(block);
-				dev_err(obj->dev->dev,
-					"could not remap: %d (%d)\n", ret, fmt);
-				goto fail;
-			}
+	if (omap_obj->flags & OMAP_BO_TILED)
+		block = tiler_reserve_2d(fmt, omap_obj->width,
+				omap_obj->height, 0);
+	else
+		block = tiler_reserve_1d(obj->size);
 
-			/* TODO: enable async refill.. */
-			ret = tiler_pin(block, pages, npages,
-					omap_obj->roll, true);
-			if (ret) {
-				tiler_release(block);
-				dev_err(obj->dev->dev,
-						"could not pin: %d\n", ret);
+	if (IS_ERR(block)) {
+		ret = PTR_ERR(block);
+		dev_err(obj->dev->dev, "could not remap: %d (%d)\n", ret, fmt);
+		return ret;
+	}
+
+	req->block = block;
+	req->pages = pages;
+	req->npages = obj->size >> PAGE_SHIFT;
+	req->roll = omap_obj->roll;
+
+	return 0;
+}
+
+/* Get physical addresses for DMA of several objects at once (for example
+ * all the planes of a framebuffer), remapping them in TILER if needed.
+ * The objects which are not mapped yet are pinned in a single pass spread
+ * over all the refill engines. Either all the objects get an address or
+ * none does.  All the objects must belong to the same device.
+ */
+int omap_gem_get_paddrs(struct drm_gem_object **objs,
+		dma_addr_t *paddrs, int count)
+{
+	struct drm_device *dev = objs[0]->dev;
+	struct omap_drm_private *priv = dev->dev_private;
+	struct drm_gem_object **pinned;
+	struct tiler_pin_req *reqs;
+	int i, j, n = 0, ret = 0;
+
+	reqs = kcalloc(count, sizeof(*reqs), GFP_KERNEL);
+	pinned = kcalloc(count, sizeof(*pinned), GFP_KERNEL);
+	if (!reqs || !pinned) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	mutex_lock(&dev->struct_mutex);
+
+	for (i = 0; i < count; i++) {
+		struct drm_gem_object *obj = objs[i];
+		struct omap_gem_object *omap_obj = to_omap_bo(obj);
+
+		if (!(is_shmem(obj) && priv->has_dmm)) {
+			if (!(omap_obj->flags & OMAP_BO_DMA)) {
+				ret = -EINVAL;
 				goto fail;
 			}
+			continue;
+		}
+
+		if (omap_obj->paddr_cnt)
+			continue;
+
+		/* the planes of a framebuffer may share an object */
+		for (j = 0; j < n; j++)
+			if (pinned[j] == obj)
+				break;
+		if (j < n)
+			continue;
 
-			omap_obj->paddr = tiler_ssptr(block);
-			omap_obj->block = block;
+		ret = reserve_block(obj, &reqs[n]);
+		if (ret)
+			goto fail;
+		pinned[n++] = obj;
+	}
 
-			DBG("got paddr: %08x", omap_obj->paddr);
+	if (n) {
+		ret = tiler_pin_batch(reqs, n);
+		if (ret) {
+			dev_err(dev->dev, "could not pin: %d\n", ret);
+			goto fail;
 		}
+	}
 
-		omap_obj->paddr_cnt++;
+	for (i = 0; i < n; i++) {
+		struct omap_gem_object *omap_obj = to_omap_bo(pinned[i]);
 
-		*paddr = omap_obj->paddr;
-	} else if (omap_obj->flags & OMAP_BO_DMA) {
-		*paddr = omap_obj->paddr;
-	} else {
-		ret = -EINVAL;
+		omap_obj->paddr = tiler_ssptr(reqs[i].block);
+		omap_obj->block = reqs[i].block;
+
+		DBG("got paddr: %08x", omap_obj->paddr);
 	}
 
-fail:
-	mutex_unlock(&obj->dev->struct_mutex);
+	for (i = 0; i < count; i++) {
+		struct omap_gem_object *omap_obj = to_omap_bo(objs[i]);
+
+		if (is_shmem(objs[i]) && priv->has_dmm)
+			omap_obj->paddr_cnt++;
+		paddrs[i] = omap_obj->paddr;
+	}
+
+	mutex_unlock(&dev->struct_mutex);
+	goto out;
 
+fail:
+	for (i = 0; i < n; i++)
+		tiler_release(reqs[i].block);
+	mutex_unlock(&dev->struct_mutex);
+out:
+	kfree(pinned);
+	kfree(reqs);
 	return ret;
 }
 
@@ -773,6 +955,11 @@ int omap_gem_get_pages(struct drm_gem_object *obj, struct page ***pages)
 	return ret;
 }
 
+uint32_t omap_gem_flags(struct drm_gem_object *obj)
+{
+	return to_omap_bo(obj)->flags;
+}
+
 /* release pages when DMA no longer being performed */
 int omap_gem_put_pages(struct drm_gem_object *obj)
 {
@@ -850,8 +1037,98 @@ void omap_gem_describe_objects(struct list_head *list, struct seq_file *m)
 
 	seq_printf(m, "Total %d objects, %zu bytes\n", count, size);
 }
+
+void omap_gem_stats_show(struct seq_file *m)
+{
+	seq_printf(m, "faults:       %lu 1d, %lu 2d\n",
+			gem_stats.faults_1d, gem_stats.faults_2d);
+	seq_printf(m, "prefetched:   %lu pages, %lu chunks\n",
+			gem_stats.prefetch_pages, gem_stats.prefetch_chunks);
+	seq_printf(m, "evictions:    %lu\n", gem_stats.evictions);
+	seq_printf(m, "syncs:        %lu\n", gem_stats.syncs);
+	seq_printf(m, "cleaned:      %llu bytes\n", gem_stats.clean_bytes);
+	seq_printf(m, "invalidated:  %llu bytes\n", gem_stats.inval_bytes);
+}
 #endif
 
+/* CPU cache maintenance for cached buffers:
+ */
+
+/* clean (DMA_TO_DEVICE) or invalidate (DMA_FROM_DEVICE) the cpu caches
+ * over a byte range of the backing pages
+ */
+static void sync_range(struct drm_gem_object *obj, struct page **pages,
+		uint32_t offset, uint32_t size, enum dma_data_direction dir)
+{
+	while (size > 0) {
+		struct page *page = pages[offset >> PAGE_SHIFT];
+		uint32_t off = offset & ~PAGE_MASK;
+		uint32_t len = min_t(uint32_t, size, PAGE_SIZE - off);
+		dma_addr_t addr;
+
+		addr = dma_map_page(obj->dev->dev, page, off, len, dir);
+		dma_unmap_page(obj->dev->dev, addr, len, dir);
+
+		offset += len;
+		size -= len;
+	}
+}
+
+/**
+ * omap_gem_cpu_sync - sync cpu caches for sw access to a cached buffer
+ * @obj: the buffer
+ * @dir: DMA_TO_DEVICE after sw writes, DMA_FROM_DEVICE before sw reads
+ * @regions: byte ranges of the buffer accessed by sw
+ * @nregions: number of @regions, or zero for the whole buffer
+ *
+ * Write-combined and uncached buffers, and buffers without backing pages
+ * attached (so not touched by sw yet), need no maintenance.
+ */
+int omap_gem_cpu_sync(struct drm_gem_object *obj, enum dma_data_direction dir,
+		const struct drm_omap_gem_region *regions, uint32_t nregions)
+{
+	struct drm_device *dev = obj->dev;
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	struct drm_omap_gem_region all = { .offset = 0, .size = obj->size };
+	uint64_t bytes = 0;
+	int i;
+
+	if (omap_obj->flags & (OMAP_BO_WC|OMAP_BO_UNCACHED))
+		return 0;
+
+	for (i = 0; i < nregions; i++) {
+		if (regions[i].offset > obj->size ||
+				regions[i].size > obj->size - regions[i].offset)
+			return -EINVAL;
+	}
+
+	if (!nregions) {
+		regions = &all;
+		nregions = 1;
+	}
+
+	mutex_lock(&dev->struct_mutex);
+
+	if (!omap_obj->pages)
+		goto out;
+
+	for (i = 0; i < nregions; i++) {
+		sync_range(obj, omap_obj->pages, regions[i].offset,
+				regions[i].size, dir);
+		bytes += regions[i].size;
+	}
+
+	gem_stats.syncs++;
+	if (dir == DMA_TO_DEVICE)
+		gem_stats.clean_bytes += bytes;
+	else
+		gem_stats.inval_bytes += bytes;
+
+out:
+	mutex_unlock(&dev->struct_mutex);
+	return 0;
+}
+
 /* Buffer Synchronization:
  */
 
@@ -1131,6 +1408,9 @@ void omap_gem_free_object(struct drm_gem_object *obj)
 	 */
 	WARN_ON(omap_obj->paddr_cnt > 0);
 
+	if (obj->import_attach)
+		drm_prime_gem_destroy(obj, omap_obj->sgt);
+
 	/* don't free externally allocated backing memory */
 	if (!(omap_obj->flags & OMAP_BO_EXT_MEM)) {
 		if (omap_obj->pages) {
@@ -1263,6 +1543,29 @@ fail:
 	return NULL;
 }
 
+/* GEM buffer object wrapping a physically contiguous dma-buf imported
+ * from another device
+ */
+struct drm_gem_object *omap_gem_new_import(struct drm_device *dev,
+		struct dma_buf_attachment *attach, struct sg_table *sgt)
+{
+	union omap_gem_size gsize = { .bytes = attach->dmabuf->size };
+	struct omap_gem_object *omap_obj;
+	struct drm_gem_object *obj;
+
+	obj = omap_gem_new(dev, gsize, OMAP_BO_EXT_MEM | OMAP_BO_WC);
+	if (!obj)
+		return NULL;
+
+	omap_obj = to_omap_bo(obj);
+	omap_obj->flags |= OMAP_BO_DMA;
+	omap_obj->paddr = sg_dma_address(sgt->sgl);
+	omap_obj->sgt = sgt;
+	obj->import_attach = attach;
+
+	return obj;
+}
+
 /* init/cleanup.. if DMM is used, we need to set some stuff up.. */
 void omap_gem_init(struct drm_device *dev)
 {
@@ -0,0 +1,285 @@
+/*
+ * drivers/staging/omapdrm/omap_gem_dmabuf.c
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "omap_drv.h"
+
+#include <linux/dma-buf.h>
+#include <linux/highmem.h>
+
+/*
+ * Exporting: the importing devices (camera, video, remote cores) can only
+ * deal with physically contiguous buffers, so the buffer is pinned in
+ * TILER if needed on the first map of an attachment.  The mapping is then
+ * kept until the attachment goes away, so a buffer queued over and over
+ * to the same device is only pinned once.
+ */
+
+static int omap_gem_dmabuf_attach(struct dma_buf *buffer,
+		struct device *dev, struct dma_buf_attachment *attachment)
+{
+	attachment->priv = NULL;
+	return 0;
+}
+
+static struct sg_table *omap_gem_map_dma_buf(
+		struct dma_buf_attachment *attachment,
+		enum dma_data_direction dir)
+{
+	struct drm_gem_object *obj = attachment->dmabuf->priv;
+	struct sg_table *sg = attachment->priv;
+	dma_addr_t paddr;
+	int ret;
+
+	if (sg)
+		return sg;
+
+	sg = kzalloc(sizeof(*sg), GFP_KERNEL);
+	if (!sg)
+		return ERR_PTR(-ENOMEM);
+
+	ret = omap_gem_get_paddr(obj, &paddr, true);
+	if (ret)
+		goto fail_free;
+
+	ret = sg_alloc_table(sg, 1, GFP_KERNEL);
+	if (ret)
+		goto fail_put;
+
+	/* TILER and carveout addresses have no struct page behind them: */
+	sg->sgl->length = obj->size;
+	sg_dma_address(sg->sgl) = paddr;
+	sg_dma_len(sg->sgl) = obj->size;
+
+	attachment->priv = sg;
+
+	return sg;
+
+fail_put:
+	omap_gem_put_paddr(obj);
+fail_free:
+	kfree(sg);
+	return ERR_PTR(ret);
+}
+
+static void omap_gem_unmap_dma_buf(struct dma_buf_attachment *attachment,
+		struct sg_table *sg, enum dma_data_direction dir)
+{
+	/* the mapping lives as long as the attachment */
+}
+
+static void omap_gem_dmabuf_detach(struct dma_buf *buffer,
+		struct dma_buf_attachment *attachment)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct sg_table *sg = attachment->priv;
+
+	if (sg) {
+		omap_gem_put_paddr(obj);
+		sg_free_table(sg);
+		kfree(sg);
+	}
+}
+
+static void omap_gem_dmabuf_release(struct dma_buf *buffer)
+{
+	struct drm_gem_object *obj = buffer->priv;
+
+	/* the export_dma_buf of the object is a weak pointer, drop it
+	 * along with the reference the dma-buf held
+	 */
+	if (obj->export_dma_buf == buffer) {
+		obj->export_dma_buf = NULL;
+		drm_gem_object_unreference_unlocked(obj);
+	}
+}
+
+static int omap_gem_dmabuf_begin_cpu_access(struct dma_buf *buffer,
+		size_t start, size_t len, enum dma_data_direction dir)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct drm_omap_gem_region region = {
+		.offset = start,
+		.size = len,
+	};
+	struct page **pages;
+	int ret;
+
+	/* there is no de-tiled view of the pages of a 2d buffer: */
+	if (omap_gem_flags(obj) & OMAP_BO_TILED)
+		return -ENOMEM;
+
+	ret = omap_gem_get_pages(obj, &pages);
+	if (ret)
+		return ret;
+
+	if (dir == DMA_TO_DEVICE)
+		return 0;
+
+	return omap_gem_cpu_sync(obj, DMA_FROM_DEVICE, &region, 1);
+}
+
+static void omap_gem_dmabuf_end_cpu_access(struct dma_buf *buffer,
+		size_t start, size_t len, enum dma_data_direction dir)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct drm_omap_gem_region region = {
+		.offset = start,
+		.size = len,
+	};
+
+	if (dir != DMA_FROM_DEVICE)
+		omap_gem_cpu_sync(obj, DMA_TO_DEVICE, &region, 1);
+
+	omap_gem_put_pages(obj);
+}
+
+static void *omap_gem_dmabuf_kmap_atomic(struct dma_buf *buffer,
+		unsigned long page_num)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct page **pages;
+
+	/* pages were attached in begin_cpu_access() */
+	omap_gem_get_pages(obj, &pages);
+	if (!pages)
+		return NULL;
+
+	return kmap_atomic(pages[page_num]);
+}
+
+static void omap_gem_dmabuf_kunmap_atomic(struct dma_buf *buffer,
+		unsigned long page_num, void *addr)
+{
+	kunmap_atomic(addr);
+}
+
+static void *omap_gem_dmabuf_kmap(struct dma_buf *buffer,
+		unsigned long page_num)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct page **pages;
+
+	omap_gem_get_pages(obj, &pages);
+	if (!pages)
+		return NULL;
+
+	return kmap(pages[page_num]);
+}
+
+static void omap_gem_dmabuf_kunmap(struct dma_buf *buffer,
+		unsigned long page_num, void *addr)
+{
+	struct drm_gem_object *obj = buffer->priv;
+	struct page **pages;
+
+	omap_gem_get_pages(obj, &pages);
+	kunmap(pages[page_num]);
+}
+
+static const struct dma_buf_ops omap_dmabuf_ops = {
+		.attach = omap_gem_dmabuf_attach,
+		.detach = omap_gem_dmabuf_detach,
+		.map_dma_buf = omap_gem_map_dma_buf,
+		.unmap_dma_buf = omap_gem_unmap_dma_buf,
+		.release = omap_gem_dmabuf_release,
+		.begin_cpu_access = omap_gem_dmabuf_begin_cpu_access,
+		.end_cpu_access = omap_gem_dmabuf_end_cpu_access,
+		.kmap_atomic = omap_gem_dmabuf_kmap_atomic,
+		.kunmap_atomic = omap_gem_dmabuf_kunmap_atomic,
+		.kmap = omap_gem_dmabuf_kmap,
+		.kunmap = omap_gem_dmabuf_kunmap,
+};
+
+struct dma_buf *omap_gem_prime_export(struct drm_device *dev,
+		struct drm_gem_object *obj, int flags)
+{
+	return dma_buf_export(obj, &omap_dmabuf_ops, obj->size, 0600);
+}
+
+/*
+ * Importing: DSS scans out of physically contiguous memory (or TILER), so
+ * only buffers which the exporter maps contiguously for us can be wrapped
+ * in a GEM object.
+ */
+
+static bool sg_is_contiguous(struct sg_table *sgt)
+{
+	struct scatterlist *sg;
+	dma_addr_t next = sg_dma_address(sgt->sgl);
+	int i;
+
+	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
+		if (sg_dma_address(sg) != next)
+			return false;
+		next += sg_dma_len(sg);
+	}
+
+	return true;
+}
+
+struct drm_gem_object *omap_gem_prime_import(struct drm_device *dev,
+		struct dma_buf *buffer)
+{
+	struct dma_buf_attachment *attach;
+	struct drm_gem_object *obj;
+	struct sg_table *sgt;
+	int ret;
+
+	if (buffer->ops == &omap_dmabuf_ops) {
+		obj = buffer->priv;
+		/* is it from our device? */
+		if (obj->dev == dev) {
+			/* the handle holds a reference to the object, not
+			 * to the dma-buf
+			 */
+			drm_gem_object_reference(obj);
+			dma_buf_put(buffer);
+			return obj;
+		}
+	}
+
+	attach = dma_buf_attach(buffer, dev->dev);
+	if (IS_ERR(attach))
+		return ERR_CAST(attach);
+
+	sgt = dma_buf_map_attachment(attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(sgt)) {
+		ret = PTR_ERR(sgt);
+		goto fail_detach;
+	}
+
+	if (!sg_is_contiguous(sgt)) {
+		dev_err(dev->dev, "cannot import non contiguous buffer\n");
+		ret = -EINVAL;
+		goto fail_unmap;
+	}
+
+	obj = omap_gem_new_import(dev, attach, sgt);
+	if (!obj) {
+		ret = -ENOMEM;
+		goto fail_unmap;
+	}
+
+	return obj;
+
+fail_unmap:
+	dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
+fail_detach:
+	dma_buf_detach(buffer, attach);
+	return ERR_PTR(ret);
+}
@@ -62,6 +62,8 @@
 #define FAST_TEMP_MONITORING_RATE_ES1_0	125
 #define AVERAGE_NUMBER			20
 #define SAME_ZONE_CNT			600
+/* the sensor is only sampled this close to a trip point */
+#define POLLING_MARGIN			HYSTERESIS_VALUE
 
 enum governor_instances {
 	OMAP_GOV_CPU_INSTANCE,
@@ -93,6 +95,7 @@ struct omap_governor {
 	int steps;
 	int same_zone_cnt;
 	int is_stable;
+	bool polling;
 	bool enable_debug_print;
 	/* for synchronizing actions */
 	struct mutex mutex;
@@ -295,6 +298,59 @@ static signed hotspot_temp_to_sensor_temp(struct omap_governor *omap_gov,
 				1000) / (1000 + omap_gov->omap_gradient_slope);
 }
 
+/*
+ * Away from the trip points the sensor's alerts are enough to follow the
+ * temperature, and its periodic sampling only wakes the CPU up for nothing.
+ * It is needed while cooling though, for the stability check that lets the
+ * cooling go again.
+ */
+static bool omap_want_polling(struct omap_governor *omap_gov,
+			      struct omap_thermal_zone *zone,
+			      int cpu_temp, int upper)
+{
+	int margin = POLLING_MARGIN;
+
+	if (omap_gov->cooling_level > 0)
+		return true;
+
+	/* no room for an early alert */
+	if (upper - margin <= zone->temp_lower)
+		return true;
+
+	/* do not toggle around the point sampling starts at */
+	if (omap_gov->polling)
+		margin *= 2;
+
+	return cpu_temp >= upper - margin;
+}
+
+static void omap_set_window(struct omap_governor *omap_gov,
+			    struct omap_thermal_zone *zone,
+			    int cpu_temp, int upper)
+{
+	int temp_lower, temp_upper;
+	bool poll = omap_want_polling(omap_gov, zone, cpu_temp, upper);
+
+	/* when not sampling, have the sensor tell us the trip is close */
+	if (!poll)
+		upper -= POLLING_MARGIN;
+
+	temp_lower = hotspot_temp_to_sensor_temp(omap_gov, zone->temp_lower);
+	temp_upper = hotspot_temp_to_sensor_temp(omap_gov, upper);
+	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
+								temp_upper);
+
+	omap_gov->hotspot_temp_lower = temp_lower;
+	omap_gov->hotspot_temp_upper = temp_upper;
+
+	if (poll != omap_gov->polling)
+		pr_debug("%s(%s): sampling %s at %d mC\n", __func__,
+			 omap_gov->thermal_fw.domain_name,
+			 poll ? "on" : "off", cpu_temp);
+	omap_gov->polling = poll;
+	thermal_set_stats_polling(omap_gov->temp_sensor, poll);
+}
+
 static int omap_enter_zone(struct omap_governor *omap_gov,
 				int current_zone,
 				bool in_new_zone,
@@ -302,11 +358,13 @@ static int omap_enter_zone(struct omap_governor *omap_gov,
 				struct list_head *cooling_list, int cpu_temp,
 				int inter_zone_thot)
 {
-	int temp_upper;
-	int temp_lower;
 	int temp_cool_level;
 
 	struct omap_thermal_zone *zone = &omap_gov->zones[current_zone-1];
+
+	if (inter_zone_thot == 0)
+		inter_zone_thot = zone->temp_upper;
+
 	omap_gov->trend =
 		thermal_lookup_trend(omap_gov->temp_sensor->domain_name);
 	omap_gov->bursting = omap_gov->trend > zone->max_trend;
@@ -323,8 +381,14 @@ static int omap_enter_zone(struct omap_governor *omap_gov,
 		omap_gov->is_stable = true;
 
 	if (!in_new_zone && !omap_gov->bursting
-			&& !omap_gov->is_stable)
+			&& !omap_gov->is_stable) {
+		/* an early alert, or the temperature went away from the trip */
+		if (omap_want_polling(omap_gov, zone, cpu_temp,
+				      inter_zone_thot) != omap_gov->polling)
+			omap_set_window(omap_gov, zone, cpu_temp,
+					inter_zone_thot);
 		return 0;
+	}
 
 	if (omap_gov->is_stable) {
 		if ((omap_gov->cooling_level > 0) &&
@@ -379,19 +443,10 @@ static int omap_enter_zone(struct omap_governor *omap_gov,
 		thermal_device_call_all(cooling_list, cool_device,
 				omap_gov->cooling_level);
 
-	if (inter_zone_thot == 0)
-		inter_zone_thot = zone->temp_upper;
-
-	temp_lower = hotspot_temp_to_sensor_temp(omap_gov, zone->temp_lower);
-	temp_upper = hotspot_temp_to_sensor_temp(omap_gov, inter_zone_thot);
-	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
-								temp_upper);
+	omap_set_window(omap_gov, zone, cpu_temp, inter_zone_thot);
 	omap_update_report_rate(omap_gov, omap_gov->temp_sensor,
 							zone->update_rate);
 
-	omap_gov->hotspot_temp_lower = temp_lower;
-	omap_gov->hotspot_temp_upper = temp_upper;
-
 	/* PCB sensor inputs are required only for CPU domain */
 	if ((!strcmp(omap_gov->thermal_fw.domain_name, "cpu")) &&
 		omap_gov->pcb_sensor_available)
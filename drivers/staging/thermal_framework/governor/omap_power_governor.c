@@ -0,0 +1,748 @@
+/*
+ * drivers/staging/thermal_framework/governor/omap_power_governor.c
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+*/
+
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/reboot.h>
+#include <linux/slab.h>
+#include <linux/types.h>
+#include <linux/math64.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <linux/omap_power_governor.h>
+#include <linux/thermal_framework.h>
+
+#include <linux/opp.h>
+#include <plat/omap_device.h>
+#include <plat/dvfs.h>
+
+#define OMAP_SHUTDOWN_TEMP		125000
+#define OMAP_SAFE_TEMP			25000
+#define OMAP_CONTROL_TEMP		95000
+#define OMAP_SWITCH_ON_DELTA		10000
+#define CASE_CONTROL_TEMP		60000
+#define CASE_SWITCH_ON_DELTA		5000
+#define HYSTERESIS_VALUE		5000
+#define SUSTAINABLE_POWER		2000
+#define DIE_K_I				10
+#define CASE_K_I			5
+#define NORMAL_TEMP_MONITORING_RATE	1000
+#define FAST_TEMP_MONITORING_RATE	250
+#define POWER_WEIGHT_DEFAULT		256
+#define POWER_MAX_ACTORS		4
+
+enum governor_instances {
+	OMAP_GOV_CPU_INSTANCE,
+	OMAP_GOV_GPU_INSTANCE,
+	OMAP_GOV_MAX_INSTANCE,
+};
+
+struct omap_power_gov_instance {
+	struct thermal_dev thermal_fw;
+	struct thermal_dev *temp_sensor;
+	int gradient_slope;
+	int gradient_const;
+	int hotspot_temp;
+};
+
+struct omap_power_actor {
+	const char *domain;
+	struct device *dev;
+	int nr_opps;
+	unsigned long *freq;
+	u32 *power;
+	u32 weight;
+	bool controlled;
+	u32 requested;
+	u32 granted;
+	int level;
+};
+
+struct omap_power_pid {
+	u32 control_temp;
+	u32 switch_on_temp;
+	u32 k_po;
+	u32 k_pu;
+	u32 k_i;
+	u32 k_d;
+	s64 err_integral;
+	int prev_err;
+	int temp;
+	u32 power;
+};
+
+struct omap_power_governor {
+	struct omap_power_gov_instance inst[OMAP_GOV_MAX_INSTANCE];
+	struct omap_power_actor actors[POWER_MAX_ACTORS];
+	int nr_actors;
+	struct omap_power_pid die;
+	struct omap_power_pid sys;
+	u32 sustainable_power;
+	u32 budget;
+	bool throttling;
+	struct delayed_work work;
+	/* for synchronizing actions */
+	struct mutex mutex;
+};
+
+static struct omap_power_actor_data omap_power_default_actors[] __initdata = {
+	{ .domain = "cpu", .hwmod = "mpu", .capacitance = 600, },
+	{ .domain = "gpu", .hwmod = "gpu", .capacitance = 1000, },
+	{ .domain = "iva", .hwmod = "iva", .capacitance = 700, },
+};
+
+static struct omap_power_governor_pdata *omap_power_pdata;
+
+static struct omap_power_governor *omap_power_gov;
+
+/**
+ * DOC: Introduction
+ * =================
+ * The OMAP power governor replaces the zones of the On-Die governor with a
+ * closed loop on the hot spot temperature.  Rather than stepping all the
+ * cooling agents down together whenever a zone boundary is crossed, which
+ * makes a sustained load oscillate between full speed and deep throttling,
+ * it computes how much power the device can dissipate and shares it between
+ * the SoC blocks.
+ *
+ * Once the hot spot temperature (computed from the on-die sensors as by the
+ * On-Die governor) goes above the switch on temperature, a PID controller
+ * on the distance to the control temperature gives the power budget, in mW.
+ * When a case sensor is available a second controller runs on the case
+ * temperature and the lower of the two budgets is used.
+ *
+ * Each throttled block is described by the power it draws at each of its
+ * OPPs, either given by the board or estimated from the OPP table as
+ * c.f.V^2.  The budget is split between the blocks in proportion to the
+ * power they draw at their current OPP, budget a block can't use because it
+ * is already at its highest OPP goes to the others, and each block is then
+ * throttled to the highest OPP fitting in its share.  The cooling level
+ * passed to the agents of the block's domain is the number of OPP steps
+ * below the highest one.
+ *
+ * Blocks whose domain has no cooling agent can't be throttled, the power
+ * they draw is taken off the budget before it is shared.
+ */
+
+static u32 omap_power_opp_power(u32 capacitance, unsigned long freq,
+				unsigned long volt)
+{
+	u64 mv = volt / 1000;
+
+	return (u32)div_u64((u64)capacitance * (freq / 1000000) * mv * mv,
+			    1000000000);
+}
+
+static int __init omap_power_actor_init(struct omap_power_actor *actor,
+				const struct omap_power_actor_data *data)
+{
+	struct device *dev;
+	struct opp *opp;
+	unsigned long freq = 0;
+	int i, nr;
+
+	dev = omap_device_get_by_hwmod_name(data->hwmod);
+	if (IS_ERR_OR_NULL(dev))
+		return -ENODEV;
+
+	rcu_read_lock();
+	nr = opp_get_opp_count(dev);
+	rcu_read_unlock();
+	if (nr <= 0)
+		return -ENODEV;
+
+	if (data->power && data->nr_power != nr) {
+		pr_err("%s: %s has %d OPPs but %d power entries\n",
+			__func__, data->hwmod, nr, data->nr_power);
+		return -EINVAL;
+	}
+
+	actor->freq = kcalloc(nr, sizeof(*actor->freq), GFP_KERNEL);
+	actor->power = kcalloc(nr, sizeof(*actor->power), GFP_KERNEL);
+	if (!actor->freq || !actor->power)
+		goto err;
+
+	rcu_read_lock();
+	for (i = 0; i < nr; i++, freq++) {
+		opp = opp_find_freq_ceil(dev, &freq);
+		if (IS_ERR(opp))
+			break;
+		actor->freq[i] = freq;
+		if (data->power)
+			actor->power[i] = data->power[i];
+		else
+			actor->power[i] = omap_power_opp_power(
+				data->capacitance, freq, opp_get_voltage(opp));
+	}
+	rcu_read_unlock();
+	if (i != nr)
+		goto err;
+
+	actor->domain = data->domain;
+	actor->dev = dev;
+	actor->nr_opps = nr;
+	actor->weight = data->weight ? data->weight : POWER_WEIGHT_DEFAULT;
+
+	for (i = 0; i < nr; i++)
+		pr_debug("%s: %s %lu Hz %u mW\n", __func__, data->hwmod,
+			 actor->freq[i], actor->power[i]);
+
+	return 0;
+err:
+	kfree(actor->freq);
+	kfree(actor->power);
+	actor->freq = NULL;
+	actor->power = NULL;
+	return -ENOMEM;
+}
+
+/* index of the OPP a block running at @rate is at */
+static int omap_power_actor_opp(struct omap_power_actor *actor,
+				unsigned long rate)
+{
+	int i;
+
+	for (i = 0; i < actor->nr_opps - 1; i++)
+		if (actor->freq[i] >= rate)
+			break;
+
+	return i;
+}
+
+static u32 omap_power_actor_max(struct omap_power_actor *actor)
+{
+	return actor->power[actor->nr_opps - 1];
+}
+
+static void omap_power_actor_set_level(struct omap_power_actor *actor,
+				       int level)
+{
+	if (actor->level == level)
+		return;
+
+	actor->level = level;
+	if (thermal_cool_domain(actor->domain, level) < 0)
+		pr_debug("%s: no cooling agent for %s\n", __func__,
+			 actor->domain);
+}
+
+/* throttle @actor to the highest OPP fitting in its grant */
+static void omap_power_actor_throttle(struct omap_power_actor *actor)
+{
+	int i;
+
+	for (i = actor->nr_opps - 1; i > 0; i--)
+		if (actor->power[i] <= actor->granted)
+			break;
+
+	omap_power_actor_set_level(actor, actor->nr_opps - 1 - i);
+}
+
+static void omap_power_allocate(struct omap_power_governor *gov, u32 budget)
+{
+	struct omap_power_actor *actor;
+	u64 total_req = 0, extra = 0, headroom = 0;
+	int i;
+
+	for (i = 0; i < gov->nr_actors; i++) {
+		unsigned long rate;
+		u32 power;
+
+		actor = &gov->actors[i];
+		rate = omap_device_get_rate(actor->dev);
+		power = actor->power[omap_power_actor_opp(actor, rate)];
+
+		actor->controlled = !thermal_check_domain(actor->domain);
+		if (!actor->controlled) {
+			actor->requested = actor->granted = power;
+			budget -= min(budget, power);
+			continue;
+		}
+
+		actor->requested = (u32)div_u64((u64)power * actor->weight,
+						POWER_WEIGHT_DEFAULT);
+		total_req += actor->requested;
+	}
+
+	for (i = 0; i < gov->nr_actors; i++) {
+		actor = &gov->actors[i];
+		if (!actor->controlled)
+			continue;
+
+		actor->granted = total_req ? (u32)div64_u64((u64)budget *
+					actor->requested, total_req) : 0;
+		if (actor->granted > omap_power_actor_max(actor)) {
+			extra += actor->granted - omap_power_actor_max(actor);
+			actor->granted = omap_power_actor_max(actor);
+		} else {
+			headroom += omap_power_actor_max(actor) - actor->granted;
+		}
+	}
+
+	for (i = 0; i < gov->nr_actors; i++) {
+		actor = &gov->actors[i];
+		if (!actor->controlled)
+			continue;
+
+		if (extra && headroom)
+			actor->granted += (u32)div64_u64(extra *
+				(omap_power_actor_max(actor) - actor->granted),
+				headroom);
+		omap_power_actor_throttle(actor);
+	}
+
+	gov->budget = budget;
+}
+
+static u32 omap_power_pid(struct omap_power_governor *gov,
+			  struct omap_power_pid *pid, int temp, int period)
+{
+	s64 p, i, d, max_integral;
+	int err;
+
+	pid->temp = temp;
+	err = (int)pid->control_temp - temp;
+
+	/* gains are in mW/C, temperatures in mC */
+	p = div_s64((s64)(err < 0 ? pid->k_po : pid->k_pu) * err, 1000);
+
+	/* the integral term alone never exceeds the sustainable power */
+	pid->err_integral += err;
+	max_integral = pid->k_i ?
+		div_u64((u64)gov->sustainable_power * 1000, pid->k_i) : 0;
+	pid->err_integral = clamp_t(s64, pid->err_integral, -max_integral,
+				    max_integral);
+	i = div_s64((s64)pid->k_i * pid->err_integral, 1000);
+
+	d = div_s64((s64)pid->k_d * (err - pid->prev_err), period);
+	pid->prev_err = err;
+
+	pid->power = clamp_t(s64, gov->sustainable_power + p + i + d, 0,
+			     U32_MAX);
+
+	return pid->power;
+}
+
+static void omap_power_pid_reset(struct omap_power_pid *pid)
+{
+	pid->err_integral = 0;
+	pid->prev_err = 0;
+	pid->power = U32_MAX;
+}
+
+static int omap_power_hotspot_temp(struct omap_power_gov_instance *inst,
+				   int sensor_temp)
+{
+	return sensor_temp + (sensor_temp * inst->gradient_slope / 1000) +
+		inst->gradient_const;
+}
+
+static int omap_power_sensor_temp(struct omap_power_gov_instance *inst,
+				  int hot_spot_temp)
+{
+	return ((hot_spot_temp - inst->gradient_const) * 1000) /
+		(1000 + inst->gradient_slope);
+}
+
+/* hottest hot spot over the domains with a sensor */
+static int omap_power_die_temp(struct omap_power_governor *gov)
+{
+	int i, temp, hot = -ENODEV;
+
+	for (i = 0; i < OMAP_GOV_MAX_INSTANCE; i++) {
+		struct omap_power_gov_instance *inst = &gov->inst[i];
+
+		if (!inst->temp_sensor)
+			continue;
+
+		temp = thermal_request_temp(inst->temp_sensor);
+		if (temp < 0)
+			continue;
+
+		inst->hotspot_temp = omap_power_hotspot_temp(inst, temp);
+		hot = max(hot, inst->hotspot_temp);
+	}
+
+	return hot;
+}
+
+static void omap_power_release(struct omap_power_governor *gov)
+{
+	int i;
+
+	omap_power_pid_reset(&gov->die);
+	omap_power_pid_reset(&gov->sys);
+	for (i = 0; i < gov->nr_actors; i++) {
+		gov->actors[i].granted = 0;
+		omap_power_actor_set_level(&gov->actors[i], 0);
+	}
+	gov->budget = U32_MAX;
+	gov->throttling = false;
+}
+
+static void omap_power_shutdown(int temp)
+{
+	pr_emerg("%s:SHUTDOWN (hot spot temp: %i)\n", __func__, temp);
+
+	kernel_restart(NULL);
+}
+
+static void omap_power_work_fn(struct work_struct *work)
+{
+	struct omap_power_governor *gov = container_of(work,
+				struct omap_power_governor, work.work);
+	int period = NORMAL_TEMP_MONITORING_RATE;
+	int die_temp, case_temp = -ENODEV;
+	u32 budget = U32_MAX;
+
+	mutex_lock(&gov->mutex);
+
+	die_temp = omap_power_die_temp(gov);
+	if (die_temp >= OMAP_SHUTDOWN_TEMP)
+		omap_power_shutdown(die_temp);
+
+	if (!thermal_check_domain("case"))
+		case_temp = thermal_lookup_temp("case");
+
+	if (die_temp < (int)gov->die.switch_on_temp &&
+	    case_temp < (int)gov->sys.switch_on_temp) {
+		if (gov->throttling)
+			omap_power_release(gov);
+		goto out;
+	}
+
+	gov->throttling = true;
+	period = FAST_TEMP_MONITORING_RATE;
+
+	if (die_temp >= 0)
+		budget = omap_power_pid(gov, &gov->die, die_temp, period);
+	if (case_temp >= 0)
+		budget = min(budget, omap_power_pid(gov, &gov->sys, case_temp,
+						    period));
+
+	pr_debug("%s: die %d mC case %d mC budget %u mW\n", __func__,
+		 die_temp, case_temp, budget);
+
+	omap_power_allocate(gov, budget);
+out:
+	mutex_unlock(&gov->mutex);
+
+	queue_delayed_work(system_freezable_wq, &gov->work,
+			   msecs_to_jiffies(period));
+}
+
+static int omap_power_process_temp(struct thermal_dev *gov_dev,
+				   struct list_head *cooling_list,
+				   struct thermal_dev *temp_sensor,
+				   int temp)
+{
+	struct omap_power_gov_instance *inst = container_of(gov_dev,
+			struct omap_power_gov_instance, thermal_fw);
+	struct omap_power_governor *gov = omap_power_gov;
+	int lower, upper;
+	bool kick;
+
+	mutex_lock(&gov->mutex);
+	inst->temp_sensor = temp_sensor;
+	inst->hotspot_temp = omap_power_hotspot_temp(inst, temp);
+
+	pr_debug("%s: received temp %i on %s\n", __func__, temp,
+		 inst->thermal_fw.domain_name);
+
+	/* only the switch on crossing is reported, the loop polls past it */
+	kick = inst->hotspot_temp >= (int)gov->die.switch_on_temp;
+	if (kick) {
+		lower = gov->die.switch_on_temp - HYSTERESIS_VALUE;
+		upper = OMAP_SHUTDOWN_TEMP;
+	} else {
+		lower = OMAP_SAFE_TEMP;
+		upper = gov->die.switch_on_temp;
+	}
+	thermal_device_call(temp_sensor, set_temp_thresh,
+			    omap_power_sensor_temp(inst, lower),
+			    omap_power_sensor_temp(inst, upper));
+	kick = kick && !gov->throttling;
+	mutex_unlock(&gov->mutex);
+
+	if (kick && cancel_delayed_work(&gov->work))
+		queue_delayed_work(system_freezable_wq, &gov->work, 0);
+
+	return 0;
+}
+
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+/* debugfs hooks for omap power gov */
+static int option_get(void *data, u64 *val)
+{
+	u32 *option = data;
+
+	*val = *option;
+
+	return 0;
+}
+
+static int option_set(void *data, u64 val)
+{
+	u32 *option = data;
+
+	mutex_lock(&omap_power_gov->mutex);
+	*option = val;
+	mutex_unlock(&omap_power_gov->mutex);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(omap_power_gov_fops, option_get, NULL, "%llu\n");
+DEFINE_SIMPLE_ATTRIBUTE(omap_power_gov_rw_fops, option_get, option_set,
+			"%llu\n");
+
+static int omap_power_allocation_show(struct seq_file *s, void *unused)
+{
+	struct omap_power_governor *gov = s->private;
+	int i;
+
+	mutex_lock(&gov->mutex);
+	seq_printf(s, "throttling: %d\n", gov->throttling);
+	seq_printf(s, "die: %d mC -> %u mW\n", gov->die.temp, gov->die.power);
+	seq_printf(s, "case: %d mC -> %u mW\n", gov->sys.temp, gov->sys.power);
+	seq_printf(s, "budget: %u mW\n", gov->budget);
+	seq_printf(s, "%-8s %10s %10s %6s\n", "domain", "requested", "granted",
+		   "level");
+	for (i = 0; i < gov->nr_actors; i++) {
+		struct omap_power_actor *actor = &gov->actors[i];
+
+		seq_printf(s, "%-8s %10u %10u %6d%s\n", actor->domain,
+			   actor->requested, actor->granted, actor->level,
+			   actor->controlled ? "" : " (not controlled)");
+	}
+	mutex_unlock(&gov->mutex);
+
+	return 0;
+}
+
+static int omap_power_allocation_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_power_allocation_show, inode->i_private);
+}
+
+static const struct file_operations omap_power_allocation_fops = {
+	.open		= omap_power_allocation_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int omap_power_register_debug_entries(struct thermal_dev *gov_dev,
+					     struct dentry *d)
+{
+	struct omap_power_gov_instance *inst = container_of(gov_dev,
+			struct omap_power_gov_instance, thermal_fw);
+	struct omap_power_governor *gov = omap_power_gov;
+
+	/* the loop is shared by both domains, expose it once */
+	if (inst != &gov->inst[OMAP_GOV_CPU_INSTANCE])
+		return 0;
+
+	/* Read Only - current state of the loop */
+	(void) debugfs_create_file("hotspot_temp",
+			S_IRUGO, d, &gov->die.temp, &omap_power_gov_fops);
+	(void) debugfs_create_file("allocation",
+			S_IRUGO, d, gov, &omap_power_allocation_fops);
+
+	/* Read and Write - tuning of the loop */
+	(void) debugfs_create_file("sustainable_power",
+			S_IRUGO | S_IWUSR, d, &gov->sustainable_power,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("control_temp",
+			S_IRUGO | S_IWUSR, d, &gov->die.control_temp,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("switch_on_temp",
+			S_IRUGO | S_IWUSR, d, &gov->die.switch_on_temp,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("k_po",
+			S_IRUGO | S_IWUSR, d, &gov->die.k_po,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("k_pu",
+			S_IRUGO | S_IWUSR, d, &gov->die.k_pu,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("k_i",
+			S_IRUGO | S_IWUSR, d, &gov->die.k_i,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("k_d",
+			S_IRUGO | S_IWUSR, d, &gov->die.k_d,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("case_control_temp",
+			S_IRUGO | S_IWUSR, d, &gov->sys.control_temp,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("case_switch_on_temp",
+			S_IRUGO | S_IWUSR, d, &gov->sys.switch_on_temp,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("case_k_po",
+			S_IRUGO | S_IWUSR, d, &gov->sys.k_po,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("case_k_pu",
+			S_IRUGO | S_IWUSR, d, &gov->sys.k_pu,
+			&omap_power_gov_rw_fops);
+	(void) debugfs_create_file("case_k_i",
+			S_IRUGO | S_IWUSR, d, &gov->sys.k_i,
+			&omap_power_gov_rw_fops);
+
+	return 0;
+}
+#endif
+
+static struct thermal_dev_ops omap_power_gov_ops = {
+	.process_temp = omap_power_process_temp,
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+	.register_debug_entries = omap_power_register_debug_entries,
+#endif
+};
+
+void omap_power_governor_register_pdata(struct omap_power_governor_pdata *pdata)
+{
+	if (pdata)
+		omap_power_pdata = pdata;
+}
+EXPORT_SYMBOL_GPL(omap_power_governor_register_pdata);
+
+/*
+ * Proportional gains putting the budget to zero twice as fast above the
+ * control temperature as it is raised below.
+ */
+static void __init omap_power_pid_init(struct omap_power_pid *pid,
+				       u32 sustainable_power, int control_temp,
+				       int delta, u32 k_i)
+{
+	pid->control_temp = control_temp;
+	pid->switch_on_temp = control_temp - delta;
+	pid->k_po = sustainable_power * 1000 / delta;
+	pid->k_pu = 2 * sustainable_power * 1000 / delta;
+	pid->k_i = k_i;
+	pid->k_d = 0;
+	omap_power_pid_reset(pid);
+}
+
+static int __init omap_power_governor_init(void)
+{
+	struct omap_power_governor *gov;
+	struct omap_power_actor_data *actors = omap_power_default_actors;
+	int nr_actors = ARRAY_SIZE(omap_power_default_actors);
+	int control_temp = OMAP_CONTROL_TEMP;
+	int case_control_temp = CASE_CONTROL_TEMP;
+	int i;
+
+	gov = kzalloc(sizeof(*gov), GFP_KERNEL);
+	if (!gov) {
+		pr_err("%s:Cannot allocate memory\n", __func__);
+		return -ENOMEM;
+	}
+
+	mutex_init(&gov->mutex);
+	/* idle CPUs don't heat up: no need to wake one just to poll */
+	INIT_DELAYED_WORK_DEFERRABLE(&gov->work, omap_power_work_fn);
+	gov->sustainable_power = SUSTAINABLE_POWER;
+	gov->budget = U32_MAX;
+
+	if (omap_power_pdata) {
+		if (omap_power_pdata->actors && omap_power_pdata->nr_actors) {
+			actors = omap_power_pdata->actors;
+			nr_actors = omap_power_pdata->nr_actors;
+		}
+		if (omap_power_pdata->sustainable_power)
+			gov->sustainable_power =
+				omap_power_pdata->sustainable_power;
+		if (omap_power_pdata->control_temp)
+			control_temp = omap_power_pdata->control_temp;
+		if (omap_power_pdata->case_control_temp)
+			case_control_temp = omap_power_pdata->case_control_temp;
+	}
+
+	omap_power_pid_init(&gov->die, gov->sustainable_power, control_temp,
+			    OMAP_SWITCH_ON_DELTA, DIE_K_I);
+	omap_power_pid_init(&gov->sys, gov->sustainable_power,
+			    case_control_temp, CASE_SWITCH_ON_DELTA, CASE_K_I);
+
+	for (i = 0; i < nr_actors && gov->nr_actors < POWER_MAX_ACTORS; i++) {
+		if (omap_power_actor_init(&gov->actors[gov->nr_actors],
+					  &actors[i])) {
+			pr_warn("%s: not throttling %s\n", __func__,
+				actors[i].hwmod);
+			continue;
+		}
+		gov->nr_actors++;
+	}
+
+	if (!gov->nr_actors) {
+		pr_err("%s: nothing to throttle\n", __func__);
+		kfree(gov);
+		return -ENODEV;
+	}
+
+	omap_power_gov = gov;
+
+	gov->inst[OMAP_GOV_CPU_INSTANCE].thermal_fw.name =
+						"omap_cpu_power_governor";
+	gov->inst[OMAP_GOV_CPU_INSTANCE].thermal_fw.domain_name = "cpu";
+	gov->inst[OMAP_GOV_GPU_INSTANCE].thermal_fw.name =
+						"omap_gpu_power_governor";
+	gov->inst[OMAP_GOV_GPU_INSTANCE].thermal_fw.domain_name = "gpu";
+
+	for (i = 0; i < OMAP_GOV_MAX_INSTANCE; i++) {
+		struct omap_power_gov_instance *inst = &gov->inst[i];
+
+		inst->thermal_fw.dev_ops = &omap_power_gov_ops;
+		thermal_governor_dev_register(&inst->thermal_fw);
+
+		inst->gradient_slope = thermal_get_slope(&inst->thermal_fw,
+							 NULL);
+		inst->gradient_const = thermal_get_offset(&inst->thermal_fw,
+							  NULL);
+
+		pr_info("%s: domain %s slope %d const %d\n", __func__,
+			inst->thermal_fw.domain_name, inst->gradient_slope,
+			inst->gradient_const);
+	}
+
+	queue_delayed_work(system_freezable_wq, &gov->work,
+			   msecs_to_jiffies(NORMAL_TEMP_MONITORING_RATE));
+
+	return 0;
+}
+
+static void __exit omap_power_governor_exit(void)
+{
+	struct omap_power_governor *gov = omap_power_gov;
+	int i;
+
+	cancel_delayed_work_sync(&gov->work);
+
+	for (i = 0; i < OMAP_GOV_MAX_INSTANCE; i++)
+		thermal_governor_dev_unregister(&gov->inst[i].thermal_fw);
+
+	for (i = 0; i < gov->nr_actors; i++) {
+		kfree(gov->actors[i].freq);
+		kfree(gov->actors[i].power);
+	}
+	kfree(gov);
+}
+
+module_init(omap_power_governor_init);
+module_exit(omap_power_governor_exit);
+
+MODULE_DESCRIPTION("OMAP power allocation thermal governor");
+MODULE_LICENSE("GPL");
@@ -17,6 +17,7 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/io.h>
@@ -37,6 +38,7 @@ struct omap_thermal_data {
 	struct mutex thermal_mutex; /* to synchronize PM ops */
 	struct notifier_block pm_notifier;
 	bool enabled;
+	u32 alert_count;	/* wakeups from the talert interrupt */
 };
 
 static void report_temperature_delayed_work_fn(struct work_struct *work)
@@ -204,12 +206,30 @@ int omap_bandgap_report_offset(struct thermal_dev *tdev, const char *rel_name)
 	return therm_data->therm_fw.constant;
 }
 
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+static int omap_bandgap_register_debug_entries(struct thermal_dev *tdev,
+					       struct dentry *d)
+{
+	struct omap_thermal_data *therm_data;
+
+	therm_data = container_of(tdev, struct omap_thermal_data, therm_fw);
+
+	/* compare with the stats poll_count to see who wakes us up */
+	(void) debugfs_create_u32("alert_count", S_IRUGO, d,
+				  &therm_data->alert_count);
+	return 0;
+}
+#endif
+
 static struct thermal_dev_ops omap_sensor_ops = {
 	.report_temp = omap_bandgap_report_temp,
 	.set_temp_thresh = omap_bandgap_set_temp_thresh,
 	.set_temp_report_rate = omap_bandgap_set_measuring_rate,
 	.init_slope = omap_bandgap_report_slope,
-	.init_offset = omap_bandgap_report_offset
+	.init_offset = omap_bandgap_report_offset,
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+	.register_debug_entries = omap_bandgap_register_debug_entries,
+#endif
 };
 
 int omap_thermal_report_temperature(struct omap_bandgap *bg_ptr, int id)
@@ -230,8 +250,10 @@ int omap_thermal_report_temperature(struct omap_bandgap *bg_ptr, int id)
 
 	mutex_lock(&therm_data->thermal_mutex);
 
-	if (therm_data->enabled)
+	if (therm_data->enabled) {
+		therm_data->alert_count++;
 		schedule_work(&therm_data->report_temperature_work);
+	}
 
 	mutex_unlock(&therm_data->thermal_mutex);
 
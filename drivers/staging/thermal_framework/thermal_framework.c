@@ -542,7 +542,8 @@ static int thermal_pm_notifier_cb(struct notifier_block *notifier,
 		cancel_delayed_work_sync(&stats->avg_sensor_temp_work);
 		break;
 	case PM_POST_SUSPEND:
-		schedule_work(&stats->avg_sensor_temp_work.work);
+		if (stats->polling)
+			schedule_work(&stats->avg_sensor_temp_work.work);
 		break;
 	}
 
@@ -841,9 +842,12 @@ static void thermal_average_sensor_temperature_work_fn(struct work_struct *work)
 				avg_sensor_temp_work.work);
 
 	thermal_average_sensor_temperature(stats);
+	stats->poll_count++;
 
-	schedule_delayed_work(&stats->avg_sensor_temp_work,
-		msecs_to_jiffies(stats->avg_period));
+	/* the governor may have stopped the polling from the sample above */
+	if (ACCESS_ONCE(stats->polling))
+		schedule_delayed_work(&stats->avg_sensor_temp_work,
+			msecs_to_jiffies(stats->avg_period));
 }
 
 int thermal_init_stats(struct thermal_dev *tdev, uint avg_period,
@@ -861,6 +865,7 @@ int thermal_init_stats(struct thermal_dev *tdev, uint avg_period,
 	tdev->stats->stable_cnt = STABLE_TREND_COUNT;
 	tdev->stats->is_stable = 1;
 	tdev->stats->pm_notifier = thermal_pm_notifier;
+	tdev->stats->polling = true;
 	mutex_init(&tdev->stats->stats_mutex);
 	INIT_DELAYED_WORK(&tdev->stats->avg_sensor_temp_work,
 			thermal_average_sensor_temperature_work_fn);
@@ -882,6 +887,8 @@ int thermal_init_stats(struct thermal_dev *tdev, uint avg_period,
 	(void) debugfs_create_file("safe_temp_trend",
 		S_IRUGO | S_IWUSR, tdev->debug_dentry, tdev,
 		&safe_temp_trend_fops);
+	(void) debugfs_create_u32("poll_count", S_IRUGO, tdev->debug_dentry,
+		&tdev->stats->poll_count);
 #endif
 	return 0;
 }
@@ -1046,6 +1053,55 @@ int thermal_set_avg_period(struct thermal_dev *temp_sensor, int rate)
 	return 0;
 }
 
+/**
+ * thermal_set_stats_polling() - Start or stop the periodic sampling of a
+ *				 sensor by its stats work.
+ *
+ * @temp_sensor: The thermal sensor device.
+ * @enable: Whether the sensor should be sampled every avg_period ms.
+ *
+ * A governor which gets hardware alerts from the sensor only needs the
+ * periodic samples, and the wakeups they cost, close to its trip points.
+ * When the sampling restarts the averaging window starts over, as the
+ * samples it held are stale by then.  Safe to call from the governor's
+ * process_temp callback.
+ */
+int thermal_set_stats_polling(struct thermal_dev *temp_sensor, bool enable)
+{
+	struct stats_thermal *stats;
+
+	if (!temp_sensor || !temp_sensor->stats)
+		return -ENODEV;
+
+	stats = temp_sensor->stats;
+
+	mutex_lock(&stats->stats_mutex);
+	if (stats->polling == enable) {
+		mutex_unlock(&stats->stats_mutex);
+		return 0;
+	}
+	stats->polling = enable;
+	if (enable) {
+		stats->sample_index = 0;
+		stats->window_sum = 0;
+		stats->acc_is_valid = 0;
+		stats->trend = 0;
+	}
+	mutex_unlock(&stats->stats_mutex);
+
+	/* not the _sync variant, we may be running from the work itself */
+	if (enable)
+		schedule_delayed_work(&stats->avg_sensor_temp_work, 0);
+	else
+		cancel_delayed_work(&stats->avg_sensor_temp_work);
+
+	pr_debug("%s: %s sampling %s\n", __func__, temp_sensor->domain_name,
+		 enable ? "started" : "stopped");
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(thermal_set_stats_polling);
+
 static int thermal_lookup_stats_temp(struct stats_thermal *stats)
 {
 	int tmp;
@@ -1083,6 +1139,10 @@ int thermal_lookup_temp(const char *name)
 		return ret;
 	}
 
+	/* the domain may only have cooling agents or a governor */
+	if (!thermal_domain->temp_sensor)
+		return ret;
+
 	if (thermal_domain->temp_sensor->stats) {
 		struct stats_thermal *stat = thermal_domain->temp_sensor->stats;
 		return thermal_lookup_stats_temp(stat);
@@ -1165,6 +1225,38 @@ int thermal_lookup_offset(const char *name, const char *rel_name)
 }
 EXPORT_SYMBOL_GPL(thermal_lookup_offset);
 
+/**
+ * thermal_cool_domain() - Request a cooling level from all the cooling
+ *			agents of a domain.
+ *
+ * @domain_name: a char pointer to the domain name to look up.
+ * @level: the cooling level to pass to the agents.
+ *
+ * This allows a governor to drive the cooling agents of a domain it does not
+ * receive temperature reports for, e.g. a domain without a sensor.
+ *
+ * Returns the result of the last cool_device call.
+ * ENODEV if the domain does not exist or has no cooling agents.
+ */
+int thermal_cool_domain(const char *domain_name, int level)
+{
+	struct thermal_domain *thermal_domain;
+	int ret = -ENODEV;
+
+	thermal_domain = thermal_domain_find(domain_name);
+	if (!thermal_domain)
+		return ret;
+
+	mutex_lock(&thermal_domain_list_lock);
+	if (!list_empty(&thermal_domain->cooling_agents))
+		ret = thermal_device_call_all(&thermal_domain->cooling_agents,
+					      cool_device, level);
+	mutex_unlock(&thermal_domain_list_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(thermal_cool_domain);
+
 /**
  * thermal_governor_dev_register() - Registration call for thermal domain governors
  *
@@ -24,6 +24,7 @@
 #include <dspbridge/devdefs.h>
 
 #include <linux/idr.h>
+#include <linux/mmu_notifier.h>
 
 /* Bridge Driver Object */
 struct drv_object;
@@ -90,6 +91,11 @@ struct dmm_map_object {
 	u32 num_usr_pgs;
 	struct page **pages;
 	struct bridge_dma_map_info dma_info;
+	u32 map_attr;
+	/* non zero while unmapped by the user but kept in the map cache */
+	u32 idle_seq;
+	/* the user pages changed under the mapping, never reuse it */
+	bool stale;
 };
 
 /* Used for DMM reserved memory accounting */
@@ -138,6 +144,13 @@ struct process_context {
 	struct list_head dmm_map_list;
 	spinlock_t dmm_map_lock;
 
+	/* DMM mappings kept past proc_un_map() for reuse */
+	u32 map_cache_max;
+	u32 map_cache_idle;
+	u32 map_cache_seq;
+	struct mm_struct *mm;
+	struct mmu_notifier mmu_notifier;
+
 	/* DMM reserved memory resources */
 	struct list_head dmm_rsv_list;
 	spinlock_t dmm_rsv_lock;
@@ -563,10 +563,28 @@ extern int proc_reserve_memory(void *hprocessor,
  *      PROC Initialized.
  *  Ensures:
  *  Details:
+ *      Up to CONFIG_TIDSPBRIDGE_MAP_CACHE unmapped buffers stay mapped to
+ *      the DSP, so that mapping the same buffer again at the same address
+ *      costs neither page pinning nor a TLB flush.
  */
 extern int proc_un_map(void *hprocessor, void *map_addr,
 			      struct process_context *pr_ctxt);
 
+/*
+ *  ======== proc_drop_map_cache ========
+ *  Purpose:
+ *      Unmap the buffers proc_un_map() kept mapped to the DSP, and stop
+ *      caching mappings for this process context.
+ *  Parameters:
+ *      pr_ctxt	 :   The process context.
+ *  Requires:
+ *      PROC Initialized.
+ *  Ensures:
+ *  Details:
+ *      Called when the process context is released.
+ */
+extern void proc_drop_map_cache(struct process_context *pr_ctxt);
+
 /*
  *  ======== proc_un_reserve_memory ========
  *  Purpose:
@@ -305,6 +305,29 @@ int dmm_un_map_memory(struct dmm_object *dmm_mgr, u32 addr, u32 *psize)
 	return status;
 }
 
+/*
+ *  ======== dmm_get_reserved_size ========
+ *  Purpose:
+ *      Return the size of the reserved chunk starting at rsv_addr.
+ */
+int dmm_get_reserved_size(struct dmm_object *dmm_mgr, u32 rsv_addr,
+				 u32 *psize)
+{
+	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
+	struct map_page *chunk;
+	int status = 0;
+
+	spin_lock(&dmm_obj->dmm_lock);
+	chunk = get_mapped_region(rsv_addr);
+	if (chunk != NULL && chunk->reserved)
+		*psize = chunk->region_size * PG_SIZE4K;
+	else
+		status = -ENOENT;
+	spin_unlock(&dmm_obj->dmm_lock);
+
+	return status;
+}
+
 /*
  *  ======== dmm_un_reserve_memory ========
  *  Purpose:
@@ -142,6 +142,9 @@ int drv_remove_all_dmm_res_elements(void *process_ctxt)
 	struct dmm_map_object *temp_map, *map_obj;
 	struct dmm_rsv_object *temp_rsv, *rsv_obj;
 
+	/* Unmap what proc_un_map() kept mapped, and stop keeping it */
+	proc_drop_map_cache(ctxt);
+
 	/* Free DMM mapped memory resources */
 	list_for_each_entry_safe(map_obj, temp_map, &ctxt->dmm_map_list, link) {
 		status = proc_un_map(ctxt->processor,
@@ -145,6 +145,7 @@ static int bridge_open(struct inode *ip, struct file *filp)
 	pr_ctxt->res_state = PROC_RES_ALLOCATED;
 	spin_lock_init(&pr_ctxt->dmm_map_lock);
 	INIT_LIST_HEAD(&pr_ctxt->dmm_map_list);
+	pr_ctxt->map_cache_max = CONFIG_TIDSPBRIDGE_MAP_CACHE;
 	spin_lock_init(&pr_ctxt->dmm_rsv_lock);
 	INIT_LIST_HEAD(&pr_ctxt->dmm_rsv_list);
 
@@ -20,6 +20,7 @@
 /* ------------------------------------ Host OS */
 #include <linux/dma-mapping.h>
 #include <linux/scatterlist.h>
+#include <linux/mmu_notifier.h>
 #include <dspbridge/host_os.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
@@ -108,7 +109,8 @@ static char **prepend_envp(char **new_envp, char **envp, s32 envp_elems,
 
 /* remember mapping information */
 static struct dmm_map_object *add_mapping_info(struct process_context *pr_ctxt,
-				u32 mpu_addr, u32 dsp_addr, u32 size)
+				u32 mpu_addr, u32 dsp_addr, u32 size,
+				u32 map_attr)
 {
 	struct dmm_map_object *map_obj;
 
@@ -137,6 +139,7 @@ static struct dmm_map_object *add_mapping_info(struct process_context *pr_ctxt,
 	map_obj->dsp_addr = dsp_addr;
 	map_obj->size = size;
 	map_obj->num_usr_pgs = num_usr_pgs;
+	map_obj->map_attr = map_attr;
 
 	spin_lock(&pr_ctxt->dmm_map_lock);
 	list_add(&map_obj->link, &pr_ctxt->dmm_map_list);
@@ -212,7 +215,9 @@ static struct dmm_map_object *find_containing_mapping(
 						map_obj->mpu_addr,
 						map_obj->dsp_addr,
 						map_obj->size);
-		if (match_containing_map_obj(map_obj, mpu_addr, size)) {
+		/* buffers kept in the map cache are not the user's anymore */
+		if (!map_obj->idle_seq &&
+		    match_containing_map_obj(map_obj, mpu_addr, size)) {
 			pr_debug("%s: match!\n", __func__);
 			goto out;
 		}
@@ -226,6 +231,191 @@ out:
 	return map_obj;
 }
 
+/*
+ * Map cache: codecs map the same buffers for every DSP invocation, so
+ * proc_un_map() leaves up to map_cache_max buffers mapped and a later
+ * proc_map() of the same MPU range at the same DSP address reuses the
+ * mapping without pinning pages or flushing the DSP TLB again. The mmu
+ * notifier marks mappings stale when the user pages behind them change;
+ * stale mappings are torn down lazily, from proc_map()/proc_un_map() with
+ * proc_lock held, as the notifier may be called with mmap_sem taken.
+ */
+static void map_cache_invalidate(struct process_context *pr_ctxt,
+					unsigned long start, unsigned long end)
+{
+	struct dmm_map_object *map_obj;
+
+	spin_lock(&pr_ctxt->dmm_map_lock);
+	list_for_each_entry(map_obj, &pr_ctxt->dmm_map_list, link) {
+		if (map_obj->mpu_addr < end &&
+		    start < map_obj->mpu_addr + map_obj->size)
+			map_obj->stale = true;
+	}
+	spin_unlock(&pr_ctxt->dmm_map_lock);
+}
+
+static void map_cache_mn_release(struct mmu_notifier *mn,
+					struct mm_struct *mm)
+{
+	struct process_context *pr_ctxt =
+		container_of(mn, struct process_context, mmu_notifier);
+
+	map_cache_invalidate(pr_ctxt, 0, ~0UL);
+}
+
+static void map_cache_mn_invalidate_page(struct mmu_notifier *mn,
+					struct mm_struct *mm,
+					unsigned long address)
+{
+	struct process_context *pr_ctxt =
+		container_of(mn, struct process_context, mmu_notifier);
+
+	map_cache_invalidate(pr_ctxt, address, address + PAGE_SIZE);
+}
+
+static void map_cache_mn_invalidate_range_start(struct mmu_notifier *mn,
+					struct mm_struct *mm,
+					unsigned long start, unsigned long end)
+{
+	struct process_context *pr_ctxt =
+		container_of(mn, struct process_context, mmu_notifier);
+
+	map_cache_invalidate(pr_ctxt, start, end);
+}
+
+static const struct mmu_notifier_ops map_cache_mn_ops = {
+	.release = map_cache_mn_release,
+	.invalidate_page = map_cache_mn_invalidate_page,
+	.invalidate_range_start = map_cache_mn_invalidate_range_start,
+};
+
+/* Start tracking the user pages of the process mapping its buffers */
+static void map_cache_attach(struct process_context *pr_ctxt)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (pr_ctxt->mm || !pr_ctxt->map_cache_max || !mm)
+		return;
+
+	pr_ctxt->mmu_notifier.ops = &map_cache_mn_ops;
+	if (mmu_notifier_register(&pr_ctxt->mmu_notifier, mm)) {
+		pr_err("%s: mmu notifier failed, map cache disabled\n",
+		       __func__);
+		pr_ctxt->map_cache_max = 0;
+		return;
+	}
+
+	atomic_inc(&mm->mm_count);
+	pr_ctxt->mm = mm;
+}
+
+/* Take an idle mapping of exactly this buffer out of the cache */
+static bool map_cache_get(struct process_context *pr_ctxt, u32 mpu_addr,
+				u32 dsp_addr, u32 size, u32 map_attr)
+{
+	struct dmm_map_object *map_obj;
+	bool hit = false;
+
+	if (pr_ctxt->mm != current->mm)
+		return false;
+
+	spin_lock(&pr_ctxt->dmm_map_lock);
+	list_for_each_entry(map_obj, &pr_ctxt->dmm_map_list, link) {
+		if (map_obj->idle_seq && !map_obj->stale &&
+		    map_obj->mpu_addr == mpu_addr &&
+		    map_obj->dsp_addr == dsp_addr &&
+		    map_obj->size == size &&
+		    map_obj->map_attr == map_attr) {
+			map_obj->idle_seq = 0;
+			pr_ctxt->map_cache_idle--;
+			hit = true;
+			break;
+		}
+	}
+	spin_unlock(&pr_ctxt->dmm_map_lock);
+
+	return hit;
+}
+
+/* Keep the mapping at dsp_addr for a later proc_map() if possible */
+static bool map_cache_put(struct process_context *pr_ctxt, u32 dsp_addr)
+{
+	struct dmm_map_object *map_obj;
+	bool kept = false;
+
+	if (!pr_ctxt->map_cache_max || pr_ctxt->mm != current->mm)
+		return false;
+
+	spin_lock(&pr_ctxt->dmm_map_lock);
+	list_for_each_entry(map_obj, &pr_ctxt->dmm_map_list, link) {
+		if (!map_obj->idle_seq && map_obj->dsp_addr == dsp_addr) {
+			if (!map_obj->stale) {
+				map_obj->idle_seq = ++pr_ctxt->map_cache_seq;
+				pr_ctxt->map_cache_idle++;
+				kept = true;
+			}
+			break;
+		}
+	}
+	spin_unlock(&pr_ctxt->dmm_map_lock);
+
+	return kept;
+}
+
+static int proc_un_map_locked(struct proc_object *p_proc_object,
+				struct dmm_object *dmm_mgr, u32 map_addr,
+				struct process_context *pr_ctxt);
+
+/*
+ * Unmap the idle mappings that are stale or overlap the DSP range
+ * [va, va + size), then the least recently used ones beyond map_cache_max.
+ */
+static void map_cache_evict(struct proc_object *p_proc_object,
+				struct dmm_object *dmm_mgr,
+				struct process_context *pr_ctxt, u32 va, u32 size)
+{
+	struct dmm_map_object *map_obj, *victim, *oldest;
+	u32 dsp_addr, dsp_va;
+
+	for (;;) {
+		victim = oldest = NULL;
+
+		spin_lock(&pr_ctxt->dmm_map_lock);
+		list_for_each_entry(map_obj, &pr_ctxt->dmm_map_list, link) {
+			if (!map_obj->idle_seq)
+				continue;
+
+			dsp_va = PG_ALIGN_LOW(map_obj->dsp_addr, PG_SIZE4K);
+			if (map_obj->stale || (size && dsp_va < va + size &&
+					va < dsp_va + map_obj->size)) {
+				victim = map_obj;
+				break;
+			}
+
+			if (pr_ctxt->map_cache_idle > pr_ctxt->map_cache_max &&
+			    (!oldest || map_obj->idle_seq < oldest->idle_seq))
+				oldest = map_obj;
+		}
+		if (!victim)
+			victim = oldest;
+		if (victim) {
+			dsp_addr = victim->dsp_addr;
+			victim->idle_seq = 0;
+			pr_ctxt->map_cache_idle--;
+		}
+		spin_unlock(&pr_ctxt->dmm_map_lock);
+
+		if (!victim)
+			break;
+
+		if (proc_un_map_locked(p_proc_object, dmm_mgr, dsp_addr,
+					pr_ctxt)) {
+			pr_err("%s: failed to unmap 0x%x\n", __func__, dsp_addr);
+			break;
+		}
+	}
+}
+
 static int find_first_page_in_cache(struct dmm_map_object *map_obj,
 					unsigned long mpu_addr)
 {
@@ -1297,22 +1487,33 @@ int proc_map(void *hprocessor, void *pmpu_addr, u32 ul_size,
 		status = -EFAULT;
 		goto func_end;
 	}
+	/* Mapped address = MSB of VA | LSB of PA */
+	tmp_addr = (va_align | ((u32) pmpu_addr & (PG_SIZE4K - 1)));
+
 	/* Critical section */
 	mutex_lock(&proc_lock);
 	dmm_get_handle(p_proc_object, &dmm_mgr);
-	if (dmm_mgr)
+	if (dmm_mgr) {
+		map_cache_attach(pr_ctxt);
+		if (map_cache_get(pr_ctxt, pa_align, tmp_addr, size_align,
+				  ul_map_attr)) {
+			*pp_map_addr = (void *) tmp_addr;
+			mutex_unlock(&proc_lock);
+			goto func_end;
+		}
+		/* the DSP range may still hold an idle mapping */
+		map_cache_evict(p_proc_object, dmm_mgr, pr_ctxt, va_align,
+				size_align);
 		status = dmm_map_memory(dmm_mgr, va_align, size_align);
-	else
+	} else {
 		status = -EFAULT;
+	}
 
 	/* Add mapping to the page tables. */
 	if (!status) {
-
-		/* Mapped address = MSB of VA | LSB of PA */
-		tmp_addr = (va_align | ((u32) pmpu_addr & (PG_SIZE4K - 1)));
 		/* mapped memory resource tracking */
 		map_obj = add_mapping_info(pr_ctxt, pa_align, tmp_addr,
-						size_align);
+						size_align, ul_map_attr);
 		if (!map_obj)
 			status = -ENOMEM;
 		else
@@ -1590,6 +1791,39 @@ func_end:
 	return status;
 }
 
+static int proc_un_map_locked(struct proc_object *p_proc_object,
+				struct dmm_object *dmm_mgr, u32 map_addr,
+				struct process_context *pr_ctxt)
+{
+	int status;
+	u32 va_align;
+	u32 size_align;
+
+	va_align = PG_ALIGN_LOW(map_addr, PG_SIZE4K);
+	/*
+	 * Update DMM structures. Get the size to unmap.
+	 * This function returns error if the VA is not mapped
+	 */
+	status = dmm_un_map_memory(dmm_mgr, va_align, &size_align);
+	/* Remove mapping from the page tables. */
+	if (!status) {
+		status = (*p_proc_object->intf_fxns->brd_mem_un_map)
+		    (p_proc_object->bridge_context, va_align, size_align);
+	}
+
+	if (status)
+		return status;
+
+	/*
+	 * A successful unmap should be followed by removal of map_obj
+	 * from dmm_map_list, so that mapped memory resource tracking
+	 * remains uptodate
+	 */
+	remove_mapping_information(pr_ctxt, map_addr, size_align);
+
+	return 0;
+}
+
 /*
  *  ======== proc_un_map ========
  *  Purpose:
@@ -1601,10 +1835,7 @@ int proc_un_map(void *hprocessor, void *map_addr,
 	int status = 0;
 	struct proc_object *p_proc_object = (struct proc_object *)hprocessor;
 	struct dmm_object *dmm_mgr;
-	u32 va_align;
-	u32 size_align;
 
-	va_align = PG_ALIGN_LOW((u32) map_addr, PG_SIZE4K);
 	if (!p_proc_object) {
 		status = -EFAULT;
 		goto func_end;
@@ -1618,28 +1849,11 @@ int proc_un_map(void *hprocessor, void *map_addr,
 
 	/* Critical section */
 	mutex_lock(&proc_lock);
-	/*
-	 * Update DMM structures. Get the size to unmap.
-	 * This function returns error if the VA is not mapped
-	 */
-	status = dmm_un_map_memory(dmm_mgr, (u32) va_align, &size_align);
-	/* Remove mapping from the page tables. */
-	if (!status) {
-		status = (*p_proc_object->intf_fxns->brd_mem_un_map)
-		    (p_proc_object->bridge_context, va_align, size_align);
-	}
-
-	if (status)
-		goto unmap_failed;
-
-	/*
-	 * A successful unmap should be followed by removal of map_obj
-	 * from dmm_map_list, so that mapped memory resource tracking
-	 * remains uptodate
-	 */
-	remove_mapping_information(pr_ctxt, (u32) map_addr, size_align);
-
-unmap_failed:
+	if (map_cache_put(pr_ctxt, (u32) map_addr))
+		map_cache_evict(p_proc_object, dmm_mgr, pr_ctxt, 0, 0);
+	else
+		status = proc_un_map_locked(p_proc_object, dmm_mgr,
+					    (u32) map_addr, pr_ctxt);
 	mutex_unlock(&proc_lock);
 
 func_end:
@@ -1648,6 +1862,31 @@ func_end:
 	return status;
 }
 
+/*
+ *  ======== proc_drop_map_cache ========
+ *  Purpose:
+ *      Unmap the buffers kept mapped by proc_un_map().
+ */
+void proc_drop_map_cache(struct process_context *pr_ctxt)
+{
+	struct proc_object *p_proc_object = pr_ctxt->processor;
+	struct dmm_object *dmm_mgr = NULL;
+
+	mutex_lock(&proc_lock);
+	pr_ctxt->map_cache_max = 0;
+	if (p_proc_object)
+		dmm_get_handle(p_proc_object, &dmm_mgr);
+	if (dmm_mgr)
+		map_cache_evict(p_proc_object, dmm_mgr, pr_ctxt, 0, 0);
+	mutex_unlock(&proc_lock);
+
+	if (pr_ctxt->mm) {
+		mmu_notifier_unregister(&pr_ctxt->mmu_notifier, pr_ctxt->mm);
+		mmdrop(pr_ctxt->mm);
+		pr_ctxt->mm = NULL;
+	}
+}
+
 /*
  *  ======== proc_un_reserve_memory ========
  *  Purpose:
@@ -1660,6 +1899,7 @@ int proc_un_reserve_memory(void *hprocessor, void *prsv_addr,
 	int status = 0;
 	struct proc_object *p_proc_object = (struct proc_object *)hprocessor;
 	struct dmm_rsv_object *rsv_obj;
+	u32 rsv_size;
 
 	if (!p_proc_object) {
 		status = -EFAULT;
@@ -1672,6 +1912,14 @@ int proc_un_reserve_memory(void *hprocessor, void *prsv_addr,
 		goto func_end;
 	}
 
+	/* the chunk goes away, so do the idle mappings in it */
+	if (!dmm_get_reserved_size(dmm_mgr, (u32) prsv_addr, &rsv_size)) {
+		mutex_lock(&proc_lock);
+		map_cache_evict(p_proc_object, dmm_mgr, pr_ctxt,
+				(u32) prsv_addr, rsv_size);
+		mutex_unlock(&proc_lock);
+	}
+
 	status = dmm_un_reserve_memory(dmm_mgr, (u32) prsv_addr);
 	if (status != 0)
 		goto func_end;
@@ -60,8 +60,23 @@
 
 MODULE_LICENSE("GPL");
 
+/*
+ * Per-pool counters.  The win_ pair is a decaying window of admitted puts
+ * and of gets that found their page, its ratio is the estimate of how
+ * likely a page put to an ephemeral pool is to be asked for again.
+ */
+struct zcache_pool_stats {
+	unsigned long puts;
+	unsigned long rejected_puts;
+	unsigned long gets;
+	unsigned long hits;
+	unsigned long win_puts;
+	unsigned long win_hits;
+};
+
 struct zcache_client {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
+	struct zcache_pool_stats pool_stats[MAX_POOLS_PER_CLIENT];
 	struct zs_pool *zspool;
 	bool allocated;
 	atomic_t refcount;
@@ -915,6 +930,69 @@ static struct kobj_attribute zcache_zv_page_count_policy_percent_attr = {
 };
 #endif
 
+/*
+ * Admission of pages into ephemeral (cleancache) pools.  Compressing a
+ * page which is never looked up again is pure overhead, and it pushes out
+ * pages which would be.  Once a pool has seen enough puts, a put is only
+ * accepted while the pool's recent hit ratio is at least
+ * zcache_eph_admit_percent; one put in ZCACHE_ADMIT_SAMPLE is still let
+ * through so that the ratio can recover when the workload changes.
+ * Zero, the default, admits everything.
+ */
+#define ZCACHE_ADMIT_WINDOW	1024
+#define ZCACHE_ADMIT_WARMUP	(ZCACHE_ADMIT_WINDOW / 8)
+#define ZCACHE_ADMIT_SAMPLE	16
+
+static unsigned int zcache_eph_admit_percent;
+
+static bool zcache_eph_admit(struct zcache_pool_stats *st)
+{
+	if (zcache_eph_admit_percent == 0)
+		return true;
+
+	if (st->win_puts >= ZCACHE_ADMIT_WINDOW) {
+		st->win_puts >>= 1;
+		st->win_hits >>= 1;
+	}
+	if (st->win_puts < ZCACHE_ADMIT_WARMUP)
+		return true;
+	if (st->win_hits * 100 >= st->win_puts * zcache_eph_admit_percent)
+		return true;
+	return (st->puts % ZCACHE_ADMIT_SAMPLE) == 0;
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t eph_admit_percent_show(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      char *buf)
+{
+	return sprintf(buf, "%u\n", zcache_eph_admit_percent);
+}
+
+static ssize_t eph_admit_percent_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err || (val > 100))
+		return -EINVAL;
+	zcache_eph_admit_percent = val;
+	return count;
+}
+
+static struct kobj_attribute zcache_eph_admit_percent_attr = {
+		.attr = { .name = "eph_admit_percent", .mode = 0644 },
+		.show = eph_admit_percent_show,
+		.store = eph_admit_percent_store,
+};
+#endif
+
 /*
  * zcache core code starts here
  */
@@ -958,6 +1036,14 @@ out:
 	return pool;
 }
 
+static inline struct zcache_pool_stats *zcache_pool_stats(
+						struct tmem_pool *pool)
+{
+	struct zcache_client *cli = pool->client;
+
+	return &cli->pool_stats[pool->pool_id];
+}
+
 static void zcache_put_pool(struct tmem_pool *pool)
 {
 	struct zcache_client *cli = NULL;
@@ -1481,6 +1567,34 @@ ZCACHE_SYSFS_RO_CUSTOM(zv_curr_dist_counts,
 ZCACHE_SYSFS_RO_CUSTOM(zv_cumul_dist_counts,
 			zv_cumul_dist_counts_show);
 
+/* one line per pool: client pool type puts rejected gets hits */
+static int zcache_pool_stats_show(char *buf)
+{
+	char *p = buf;
+	int c, i;
+
+	for (c = -1; c < MAX_CLIENTS; c++) {
+		struct zcache_client *cli =
+			c < 0 ? &zcache_host : &zcache_clients[c];
+
+		for (i = 0; i < MAX_POOLS_PER_CLIENT; i++) {
+			struct tmem_pool *pool = cli->tmem_pools[i];
+			struct zcache_pool_stats *st = &cli->pool_stats[i];
+
+			if (pool == NULL)
+				continue;
+			if (p - buf > PAGE_SIZE - 80)
+				return p - buf;
+			p += sprintf(p, "%d %d %s %lu %lu %lu %lu\n", c, i,
+				     is_ephemeral(pool) ? "eph" : "pers",
+				     st->puts, st->rejected_puts,
+				     st->gets, st->hits);
+		}
+	}
+	return p - buf;
+}
+ZCACHE_SYSFS_RO_CUSTOM(pool_stats, zcache_pool_stats_show);
+
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
 	&zcache_curr_obj_count_max_attr.attr,
@@ -1514,6 +1628,8 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_zv_max_zsize_attr.attr,
 	&zcache_zv_max_mean_zsize_attr.attr,
 	&zcache_zv_page_count_policy_percent_attr.attr,
+	&zcache_eph_admit_percent_attr.attr,
+	&zcache_pool_stats_attr.attr,
 	NULL,
 };
 
@@ -1566,12 +1682,24 @@ static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 				uint32_t index, struct page *page)
 {
 	struct tmem_pool *pool;
+	struct zcache_pool_stats *st;
 	int ret = -1;
 
 	BUG_ON(!irqs_disabled());
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
 	if (unlikely(pool == NULL))
 		goto out;
+	st = zcache_pool_stats(pool);
+	st->puts++;
+	if (is_ephemeral(pool) && !zcache_eph_admit(st)) {
+		st->rejected_puts++;
+		/* an older copy of the page must not survive the put */
+		if (atomic_read(&pool->obj_count) > 0)
+			(void)tmem_flush_page(pool, oidp, index);
+		zcache_put_pool(pool);
+		goto out;
+	}
+	st->win_puts++;
 	if (!zcache_freeze && zcache_do_preload(pool) == 0) {
 		/* preload does preempt_disable on success */
 		ret = tmem_put(pool, oidp, index, (char *)(page),
@@ -1606,9 +1734,16 @@ static int zcache_get_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 	local_irq_save(flags);
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
 	if (likely(pool != NULL)) {
+		struct zcache_pool_stats *st = zcache_pool_stats(pool);
+
 		if (atomic_read(&pool->obj_count) > 0)
 			ret = tmem_get(pool, oidp, index, (char *)(page),
 					&size, 0, is_ephemeral(pool));
+		st->gets++;
+		if (ret >= 0) {
+			st->hits++;
+			st->win_hits++;
+		}
 		zcache_put_pool(pool);
 	}
 	local_irq_restore(flags);
@@ -1721,6 +1856,7 @@ static int zcache_new_pool(uint16_t cli_id, uint32_t flags)
 	atomic_set(&pool->refcount, 0);
 	pool->client = cli;
 	pool->pool_id = poolid;
+	memset(&cli->pool_stats[poolid], 0, sizeof(cli->pool_stats[poolid]));
 	tmem_new_pool(pool, flags);
 	cli->tmem_pools[poolid] = pool;
 	pr_info("zcache: created %s tmem pool, id=%d, client=%d\n",
@@ -0,0 +1,155 @@
+/*
+ * Compressed RAM block device
+ *
+ * Per-CPU compression streams
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/mm.h>
+
+#include "zcomp.h"
+
+/* Order of the per-stream output buffer; LZO and LZ4 can expand a page */
+#define ZCOMP_BUFFER_ORDER	1
+
+static const char * const backends[] = {
+	"lzo",
+	"lz4",
+	"deflate",
+	NULL
+};
+
+bool zcomp_available(const char *name)
+{
+	int i;
+
+	for (i = 0; backends[i]; i++) {
+		if (!strcmp(name, backends[i]))
+			return crypto_has_comp(name, 0, 0);
+	}
+	return false;
+}
+
+ssize_t zcomp_available_show(const char *cur, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; backends[i]; i++) {
+		if (!crypto_has_comp(backends[i], 0, 0))
+			continue;
+		if (!strcmp(cur, backends[i]))
+			sz += sprintf(buf + sz, "[%s] ", backends[i]);
+		else
+			sz += sprintf(buf + sz, "%s ", backends[i]);
+	}
+	if (sz)
+		sz--;
+	sz += sprintf(buf + sz, "\n");
+	return sz;
+}
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	zstrm = per_cpu_ptr(comp->stream, raw_smp_processor_id());
+	mutex_lock(&zstrm->lock);
+	return zstrm;
+}
+
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	mutex_unlock(&zstrm->lock);
+}
+
+/* Compresses one page from src into zstrm->buffer */
+int zcomp_compress(struct zcomp_strm *zstrm, const unsigned char *src,
+		   size_t *dst_len)
+{
+	unsigned int dlen = PAGE_SIZE << ZCOMP_BUFFER_ORDER;
+	int ret;
+
+	ret = crypto_comp_compress(zstrm->tfm, src, PAGE_SIZE,
+				   zstrm->buffer, &dlen);
+	*dst_len = dlen;
+	return ret;
+}
+
+int zcomp_decompress(struct zcomp_strm *zstrm, const unsigned char *src,
+		     size_t src_len, unsigned char *dst)
+{
+	unsigned int dlen = PAGE_SIZE;
+	int ret;
+
+	ret = crypto_comp_decompress(zstrm->tfm, src, src_len, dst, &dlen);
+	if (!ret && dlen != PAGE_SIZE)
+		ret = -EINVAL;
+	return ret;
+}
+
+void zcomp_destroy(struct zcomp *comp)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_strm *zstrm = per_cpu_ptr(comp->stream, cpu);
+
+		if (zstrm->tfm && !IS_ERR(zstrm->tfm))
+			crypto_free_comp(zstrm->tfm);
+		free_pages((unsigned long)zstrm->buffer, ZCOMP_BUFFER_ORDER);
+	}
+	free_percpu(comp->stream);
+	kfree(comp);
+}
+
+struct zcomp *zcomp_create(const char *name)
+{
+	struct zcomp *comp;
+	int cpu;
+
+	if (!zcomp_available(name))
+		return ERR_PTR(-EINVAL);
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return ERR_PTR(-ENOMEM);
+	strlcpy(comp->name, name, sizeof(comp->name));
+
+	comp->stream = alloc_percpu(struct zcomp_strm);
+	if (!comp->stream) {
+		kfree(comp);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_strm *zstrm = per_cpu_ptr(comp->stream, cpu);
+
+		mutex_init(&zstrm->lock);
+		zstrm->tfm = crypto_alloc_comp(name, 0, 0);
+		zstrm->buffer = (void *)__get_free_pages(
+				GFP_KERNEL | __GFP_ZERO, ZCOMP_BUFFER_ORDER);
+		if (IS_ERR(zstrm->tfm) || !zstrm->buffer) {
+			pr_err("Error allocating %s stream for cpu %d\n",
+				name, cpu);
+			zcomp_destroy(comp);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	return comp;
+}
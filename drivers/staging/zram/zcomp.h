@@ -0,0 +1,52 @@
+/*
+ * Compressed RAM block device
+ *
+ * Per-CPU compression streams
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/crypto.h>
+#include <linux/mutex.h>
+
+#define ZCOMP_DEFAULT		"lzo"
+#define ZCOMP_NAME_LEN		CRYPTO_MAX_ALG_NAME
+
+/*
+ * A stream is a compressor instance and a buffer big enough for the
+ * worst case output of compressing one page.  Each CPU owns one; the
+ * mutex only matters when a task migrates while it holds the stream.
+ */
+struct zcomp_strm {
+	struct mutex lock;
+	struct crypto_comp *tfm;
+	void *buffer;
+};
+
+struct zcomp {
+	struct zcomp_strm __percpu *stream;
+	char name[ZCOMP_NAME_LEN];
+};
+
+extern struct zcomp *zcomp_create(const char *name);
+extern void zcomp_destroy(struct zcomp *comp);
+extern bool zcomp_available(const char *name);
+extern ssize_t zcomp_available_show(const char *cur, char *buf);
+
+extern struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+extern void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+
+extern int zcomp_compress(struct zcomp_strm *zstrm, const unsigned char *src,
+			  size_t *dst_len);
+extern int zcomp_decompress(struct zcomp_strm *zstrm,
+			    const unsigned char *src, size_t src_len,
+			    unsigned char *dst);
+
+#endif
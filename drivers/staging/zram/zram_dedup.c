@@ -0,0 +1,137 @@
+/*
+ * Compressed RAM block device
+ *
+ * Deduplication of identical pages
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* One bucket for every 16 pages of disk, at least 64 */
+#define ZRAM_DEDUP_MIN_BUCKETS	64
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t nr = max_t(size_t, num_pages >> 4, ZRAM_DEDUP_MIN_BUCKETS);
+
+	nr = roundup_pow_of_two(nr);
+	zram->dedup_table = vzalloc(nr * sizeof(*zram->dedup_table));
+	if (!zram->dedup_table)
+		return -ENOMEM;
+	zram->dedup_mask = nr - 1;
+	spin_lock_init(&zram->dedup_lock);
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->dedup_table);
+	zram->dedup_table = NULL;
+}
+
+/*
+ * A checksum match is confirmed by decompressing the candidate into the
+ * stream buffer, which is free at this point of the write path.
+ */
+static bool zram_dedup_match(struct zram *zram, struct zcomp_strm *zstrm,
+			     struct zram_entry *entry, void *mem)
+{
+	unsigned char *cmem;
+	int ret;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle);
+	ret = zcomp_decompress(zstrm, cmem + sizeof(struct zobj_header),
+			       entry->len, zstrm->buffer);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return !ret && !memcmp(zstrm->buffer, mem, PAGE_SIZE);
+}
+
+/*
+ * Looks up a stored object with the same contents as the page at mem
+ * and returns it with an extra reference, or NULL.  The page checksum
+ * is returned in *checksum for a later zram_dedup_insert().
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, struct zcomp_strm *zstrm,
+				   void *mem, u32 *checksum)
+{
+	struct zram_entry *entry;
+	struct hlist_node *pos;
+	u32 csum;
+
+	csum = jhash2(mem, PAGE_SIZE / sizeof(u32), 0);
+	*checksum = csum;
+
+	spin_lock(&zram->dedup_lock);
+	hlist_for_each_entry(entry, pos,
+			     &zram->dedup_table[csum & zram->dedup_mask], node) {
+		if (entry->checksum != csum)
+			continue;
+		if (zram_dedup_match(zram, zstrm, entry, mem)) {
+			entry->refcount++;
+			spin_unlock(&zram->dedup_lock);
+			return entry;
+		}
+	}
+	spin_unlock(&zram->dedup_lock);
+
+	return NULL;
+}
+
+struct zram_entry *zram_dedup_insert(struct zram *zram, void *handle,
+				     u16 len, u32 checksum)
+{
+	struct zram_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	spin_lock(&zram->dedup_lock);
+	hlist_add_head(&entry->node,
+		       &zram->dedup_table[checksum & zram->dedup_mask]);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
+
+/*
+ * Drops a reference.  Returns the compressed size released when this
+ * was the last one, or 0 if the object is still shared.
+ */
+size_t zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	size_t len;
+
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		return 0;
+	}
+	hlist_del(&entry->node);
+	spin_unlock(&zram->dedup_lock);
+
+	len = entry->len;
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+
+	return len;
+}
@@ -25,11 +25,12 @@
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
+#include <linux/completion.h>
 #include <linux/device.h>
+#include <linux/fs.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -89,21 +90,46 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+/* Returns 1 and the fill word if the page is one word repeated */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+static void fill_same(void *ptr, unsigned long element, unsigned int len)
+{
+	unsigned long *p = ptr;
+	unsigned int i;
+
+	if (!element) {
+		memset(ptr, 0, len);
+		return;
+	}
+	for (i = 0; i < len / sizeof(*p); i++)
+		p[i] = element;
+}
+
+/* Resolves a table entry to its zsmalloc handle */
+static void *zram_get_handle(struct zram *zram, u32 index)
+{
+	void *handle = zram->table[index].handle;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return ((struct zram_entry *)handle)->handle;
+	return handle;
+}
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -133,10 +159,179 @@ static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 	zram->disksize &= PAGE_MASK;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Tracks a set of bios and wakes the submitter when all have finished */
+struct zram_bio_batch {
+	atomic_t pending;
+	int error;
+	struct completion done;
+};
+
+static void zram_batch_init(struct zram_bio_batch *batch)
+{
+	atomic_set(&batch->pending, 1);
+	batch->error = 0;
+	init_completion(&batch->done);
+}
+
+static void zram_bio_end_io(struct bio *bio, int err)
+{
+	struct zram_bio_batch *batch = bio->bi_private;
+
+	if (err || !test_bit(BIO_UPTODATE, &bio->bi_flags))
+		batch->error = err ? err : -EIO;
+	bio_put(bio);
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static struct bio *zram_bio_alloc(struct zram *zram,
+				  struct zram_bio_batch *batch,
+				  unsigned long blk, int nr_pages)
+{
+	struct bio *bio = bio_alloc(GFP_NOIO, nr_pages);
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = zram_bio_end_io;
+	bio->bi_private = batch;
+	return bio;
+}
+
+static void zram_batch_submit(struct zram_bio_batch *batch, int rw,
+			      struct bio *bio)
+{
+	atomic_inc(&batch->pending);
+	submit_bio(rw, bio);
+}
+
+static int zram_batch_wait(struct zram_bio_batch *batch)
+{
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+	return batch->error;
+}
+
+/* Blocks are numbered from 1 so that a WB entry never has a NULL handle */
+static unsigned long zram_alloc_block(struct zram *zram)
+{
+	unsigned long blk;
+
+	spin_lock(&zram->bitmap_lock);
+	blk = find_next_zero_bit(zram->bitmap, zram->nr_blocks, 1);
+	if (blk < zram->nr_blocks)
+		set_bit(blk, zram->bitmap);
+	else
+		blk = 0;
+	spin_unlock(&zram->bitmap_lock);
+
+	return blk;
+}
+
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+	spin_lock(&zram->bitmap_lock);
+	clear_bit(blk, zram->bitmap);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+static int zram_bdev_read(struct zram *zram, unsigned long blk,
+			  struct page *page)
+{
+	struct zram_bio_batch batch;
+	struct bio *bio;
+	int ret;
+
+	zram_batch_init(&batch);
+	bio = zram_bio_alloc(zram, &batch, blk, 1);
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+	zram_batch_submit(&batch, READ, bio);
+	ret = zram_batch_wait(&batch);
+	if (ret)
+		pr_err("Backing device read failed! err=%d, block=%lu\n",
+			ret, blk);
+	else
+		zram_stat64_inc(zram, &zram->stats.wb_reads);
+
+	return ret;
+}
+
+/* Reads a written back page into bvec, handling partial I/O */
+static int zram_read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+			       u32 index, int offset)
+{
+	struct page *page;
+	unsigned char *user_mem, *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read(zram, (unsigned long)zram->table[index].handle,
+			     page);
+	if (!ret) {
+		user_mem = kmap_atomic(bvec->bv_page);
+		src = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, src + offset,
+		       bvec->bv_len);
+		kunmap_atomic(src);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(bvec->bv_page);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+/* Any access makes the page hot again */
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	if (zram_test_flag(zram, index, ZRAM_IDLE))
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+}
+#else
+static inline void zram_accessed(struct zram *zram, u32 index) { }
+#endif
+
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_free_block(zram, (unsigned long)handle);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_stat_dec(&zram->stats.pages_wb);
+		goto out;
+	}
+#endif
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram_stat_dec(&zram->stats.pages_same);
+		zram->table[index].handle = NULL;
+		return;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		size_t freed = zram_dedup_put(zram, handle);
+
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		if (freed)
+			zram_stat64_sub(zram, &zram->stats.compr_size, freed);
+		else
+			zram_stat_dec(&zram->stats.dedup_saved);
+		if (zram->table[index].size <= PAGE_SIZE / 2)
+			zram_stat_dec(&zram->stats.good_compress);
+		zram_stat_dec(&zram->stats.pages_stored);
+		zram->table[index].handle = NULL;
+		zram->table[index].size = 0;
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -182,6 +377,18 @@ static void handle_zero_page(struct bio_vec *bvec)
 	flush_dcache_page(page);
 }
 
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
+{
+	struct page *page = bvec->bv_page;
+	void *user_mem;
+
+	user_mem = kmap_atomic(page);
+	fill_same(user_mem + bvec->bv_offset, element, bvec->bv_len);
+	kunmap_atomic(user_mem);
+
+	flush_dcache_page(page);
+}
+
 static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
 				     u32 index, int offset)
 {
@@ -207,9 +414,10 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	void *handle;
 	struct page *page;
 	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
@@ -219,6 +427,13 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_accessed(zram, index);
+		handle_same_page(bvec,
+				 (unsigned long)zram->table[index].handle);
+		return 0;
+	}
+
 	/* Requested page is not present in compressed area */
 	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
@@ -227,6 +442,13 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		return 0;
 	}
 
+	zram_accessed(zram, index);
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram_test_flag(zram, index, ZRAM_WB))
+		return zram_read_from_bdev(zram, bvec, index, offset);
+#endif
+
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		handle_uncompressed_page(zram, bvec, index, offset);
@@ -242,16 +464,16 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		}
 	}
 
+	zstrm = zcomp_strm_find(zram->comp);
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	handle = zram_get_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zcomp_decompress(zstrm, cmem + sizeof(*zheader),
+			       zram->table[index].size, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -259,11 +481,12 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		kfree(uncmem);
 	}
 
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	zs_unmap_object(zram->mem_pool, handle);
 	kunmap_atomic(user_mem);
+	zcomp_strm_release(zram->comp, zstrm);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -274,11 +497,13 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	return 0;
 }
 
+/* Called with zram->lock held for reading */
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
+	void *handle;
 	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	unsigned char *cmem;
 
 	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
@@ -287,22 +512,49 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		fill_same(mem, (unsigned long)zram->table[index].handle,
+			  PAGE_SIZE);
+		return 0;
+	}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		struct page *page = alloc_page(GFP_NOIO);
+
+		if (!page)
+			return -ENOMEM;
+		ret = zram_bdev_read(zram,
+				     (unsigned long)zram->table[index].handle,
+				     page);
+		if (!ret) {
+			cmem = kmap_atomic(page);
+			memcpy(mem, cmem, PAGE_SIZE);
+			kunmap_atomic(cmem);
+		}
+		__free_page(page);
+		return ret;
+	}
+#endif
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	zstrm = zcomp_strm_find(zram->comp);
+	handle = zram_get_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
+	ret = zcomp_decompress(zstrm, cmem + sizeof(*zheader),
+			       zram->table[index].size, mem);
+	zs_unmap_object(zram->mem_pool, handle);
+	zcomp_strm_release(zram->comp, zstrm);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -311,19 +563,27 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * Compression runs on this CPU's stream without zram->lock, so writes
+ * from different CPUs proceed in parallel.  Only the table update at
+ * the end is serialized.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret;
-	u32 store_offset;
 	size_t clen;
-	void *handle;
+	void *handle = NULL;
+	int uncompressed = 0;
+	unsigned long element;
+	u32 checksum = 0;
+	struct zram_entry *entry = NULL;
 	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -336,21 +596,16 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_read(&zram->lock);
 		ret = zram_read_before_write(zram, uncmem, index);
+		up_read(&zram->lock);
 		if (ret) {
 			kfree(uncmem);
 			goto out;
 		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
+	zstrm = zcomp_strm_find(zram->comp);
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec))
@@ -359,26 +614,48 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	/* Pages of one repeated word need no memory beyond the table */
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem);
+		zcomp_strm_release(zram->comp, zstrm);
 		if (is_partial_io(bvec))
 			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
+		down_write(&zram->lock);
+		if (zram->table[index].handle ||
+		    zram_test_flag(zram, index, ZRAM_ZERO))
+			zram_free_page(zram, index);
+		if (element) {
+			zram->table[index].handle = (void *)element;
+			zram_stat_inc(&zram->stats.pages_same);
+			zram_set_flag(zram, index, ZRAM_SAME);
+		} else {
+			zram_stat_inc(&zram->stats.pages_zero);
+			zram_set_flag(zram, index, ZRAM_ZERO);
+		}
+		up_write(&zram->lock);
 		ret = 0;
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	if (zram->use_dedup)
+		entry = zram_dedup_find(zram, zstrm, uncmem, &checksum);
+	if (entry) {
+		kunmap_atomic(user_mem);
+		zcomp_strm_release(zram->comp, zstrm);
+		if (is_partial_io(bvec))
+			kfree(uncmem);
+		zram_stat64_inc(zram, &zram->stats.dedup_hits);
+		clen = entry->len;
+		zram_stat_inc(&zram->stats.dedup_saved);
+		goto store;
+	}
 
+	ret = zcomp_compress(zstrm, uncmem, &clen);
 	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
-		goto out;
+		goto out_release;
 	}
 
 	/*
@@ -393,57 +670,73 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			pr_info("Error allocating memory for "
 				"incompressible page: %u\n", index);
 			ret = -ENOMEM;
-			goto out;
+			goto out_release;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
-		handle = page_store;
-		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
-	}
-
-	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
-	if (!handle) {
-		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
-		goto out;
-	}
-	cmem = zs_map_object(zram->mem_pool, handle);
-
-memstore:
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
-#endif
-
-	memcpy(cmem, src, clen);
-
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		if (is_partial_io(bvec)) {
+			memcpy(cmem, uncmem, PAGE_SIZE);
+		} else {
+			src = kmap_atomic(page);
+			memcpy(cmem, src, PAGE_SIZE);
+			kunmap_atomic(src);
+		}
 		kunmap_atomic(cmem);
-		kunmap_atomic(src);
+		handle = page_store;
+		uncompressed = 1;
 	} else {
+		handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
+		if (!handle) {
+			pr_info("Error allocating memory for compressed "
+				"page: %u, size=%zu\n", index, clen);
+			ret = -ENOMEM;
+			goto out_release;
+		}
+		cmem = zs_map_object(zram->mem_pool, handle);
+		memcpy(cmem + sizeof(*zheader), zstrm->buffer, clen);
 		zs_unmap_object(zram->mem_pool, handle);
 	}
 
-	zram->table[index].handle = handle;
+	zcomp_strm_release(zram->comp, zstrm);
+	if (is_partial_io(bvec))
+		kfree(uncmem);
+
+	/* Without an entry the object is simply not shared */
+	if (zram->use_dedup && !uncompressed)
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+
+store:
+	down_write(&zram->lock);
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	if (zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_ZERO))
+		zram_free_page(zram, index);
+
+	zram->table[index].handle = entry ? (void *)entry : handle;
 	zram->table[index].size = clen;
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	if (entry)
+		zram_set_flag(zram, index, ZRAM_DEDUP);
+	if (uncompressed) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
+	}
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
+	up_write(&zram->lock);
 
 	return 0;
 
+out_release:
+	zcomp_strm_release(zram->comp, zstrm);
+	if (is_partial_io(bvec))
+		kfree(uncmem);
 out:
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
@@ -460,14 +753,240 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static int zram_wb_candidate(struct zram *zram, u32 index, int mode)
+{
+	if (!zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		return 0;
+	if ((mode & ZRAM_WB_HUGE) &&
+	    zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))
+		return 1;
+	if ((mode & ZRAM_WB_IDLE) && zram_test_flag(zram, index, ZRAM_IDLE))
+		return 1;
+	return 0;
+}
+
+/*
+ * Copies up to nr candidate pages, starting at *index, into pages[] and
+ * marks them ZRAM_UNDER_WB.  A write or free of the slot meanwhile
+ * clears that flag, which tells zram_wb_commit() to drop the copy.
+ */
+static int zram_wb_collect(struct zram *zram, size_t *index, int mode,
+			   struct page **pages, u32 *idx,
+			   unsigned long *blks, int nr)
+{
+	size_t nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long blk;
+	void *mem;
+	int n = 0, ret;
+
+	for (; *index < nr_pages && n < nr; (*index)++) {
+		if (!zram_wb_candidate(zram, *index, mode))
+			continue;
+
+		blk = zram_alloc_block(zram);
+		if (!blk) {
+			*index = nr_pages;
+			break;
+		}
+
+		down_write(&zram->lock);
+		ret = -EAGAIN;
+		if (zram_wb_candidate(zram, *index, mode)) {
+			mem = kmap(pages[n]);
+			ret = zram_read_before_write(zram, mem, *index);
+			kunmap(pages[n]);
+			if (!ret)
+				zram_set_flag(zram, *index, ZRAM_UNDER_WB);
+		}
+		up_write(&zram->lock);
+
+		if (ret) {
+			zram_free_block(zram, blk);
+			continue;
+		}
+		idx[n] = *index;
+		blks[n] = blk;
+		n++;
+	}
+
+	return n;
+}
+
+/* Writes pages[0..n) out, merging runs of consecutive blocks into one bio */
+static int zram_wb_submit(struct zram *zram, struct page **pages,
+			  unsigned long *blks, int n)
+{
+	struct zram_bio_batch batch;
+	struct bio *bio = NULL;
+	int i;
+
+	zram_batch_init(&batch);
+	for (i = 0; i < n; i++) {
+		if (bio && blks[i] == blks[i - 1] + 1 &&
+		    bio_add_page(bio, pages[i], PAGE_SIZE, 0) == PAGE_SIZE)
+			continue;
+		if (bio)
+			zram_batch_submit(&batch, WRITE, bio);
+		bio = zram_bio_alloc(zram, &batch, blks[i], n - i);
+		bio_add_page(bio, pages[i], PAGE_SIZE, 0);
+	}
+	if (bio)
+		zram_batch_submit(&batch, WRITE, bio);
+
+	return zram_batch_wait(&batch);
+}
+
+static void zram_wb_commit(struct zram *zram, u32 *idx, unsigned long *blks,
+			   int n, int err)
+{
+	int i;
+
+	down_write(&zram->lock);
+	for (i = 0; i < n; i++) {
+		u32 index = idx[i];
+
+		if (err || !zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_free_block(zram, blks[i]);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram->table[index].handle = (void *)blks[i];
+		zram->table[index].size = 0;
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_stat_inc(&zram->stats.pages_wb);
+		zram_stat_inc(&zram->stats.pages_stored);
+		zram_stat64_inc(zram, &zram->stats.wb_writes);
+	}
+	up_write(&zram->lock);
+}
+
+static void zram_wb_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, wb_work);
+	struct page *pages[ZRAM_WB_BATCH];
+	unsigned long blks[ZRAM_WB_BATCH];
+	u32 idx[ZRAM_WB_BATCH];
+	size_t index = 0;
+	int i, n, nr, mode, ret;
+
+	spin_lock(&zram->bitmap_lock);
+	mode = zram->wb_mode;
+	zram->wb_mode = 0;
+	spin_unlock(&zram->bitmap_lock);
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done || !zram->bdev || !mode)
+		goto out;
+
+	for (nr = 0; nr < ZRAM_WB_BATCH; nr++) {
+		pages[nr] = alloc_page(GFP_KERNEL);
+		if (!pages[nr])
+			break;
+	}
+
+	while (nr) {
+		n = zram_wb_collect(zram, &index, mode, pages, idx, blks, nr);
+		if (!n)
+			break;
+		ret = zram_wb_submit(zram, pages, blks, n);
+		if (ret)
+			pr_err("Writeback failed! err=%d\n", ret);
+		zram_wb_commit(zram, idx, blks, n, ret);
+		if (ret)
+			break;
+		cond_resched();
+	}
+
+	for (i = 0; i < nr; i++)
+		__free_page(pages[i]);
+out:
+	up_read(&zram->init_lock);
+}
+
+/* Queues an asynchronous writeback pass. Called with init_lock held */
+void zram_writeback(struct zram *zram, int mode)
+{
+	spin_lock(&zram->bitmap_lock);
+	zram->wb_mode |= mode;
+	spin_unlock(&zram->bitmap_lock);
+	schedule_work(&zram->wb_work);
+}
+
+void zram_wb_cancel(struct zram *zram)
+{
+	cancel_work_sync(&zram->wb_work);
+}
+
+/* Marks every page held in RAM idle. Called with init_lock held */
+void zram_mark_idle(struct zram *zram)
+{
+	size_t index;
+
+	down_write(&zram->lock);
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		if (zram->table[index].handle &&
+		    !zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+	}
+	up_write(&zram->lock);
+}
+
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	vfree(zram->bitmap);
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_blocks = 0;
+}
+
+/* Called with init_lock held for writing on an uninitialized device */
+int zram_set_backing_dev(struct zram *zram, const char *path)
+{
+	struct block_device *bdev;
+	unsigned long nr_blocks, *bitmap;
+
+	bdev = blkdev_get_by_path(path, FMODE_READ | FMODE_WRITE | FMODE_EXCL,
+				  zram);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	nr_blocks = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = nr_blocks > 1 ?
+		vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long)) : NULL;
+	if (!bitmap) {
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+		return nr_blocks > 1 ? -ENOMEM : -EINVAL;
+	}
+
+	zram_reset_bdev(zram);
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_blocks = nr_blocks;
+	pr_info("Using %s as backing device, %lu blocks\n", path, nr_blocks);
+
+	return 0;
+}
+#else
+static inline void zram_reset_bdev(struct zram *zram) { }
+#endif
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -475,11 +994,85 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
+/* Page is a zsmalloc object that has to be decompressed */
+static int zram_is_compressed(struct zram *zram, u32 index)
+{
+	return zram->table[index].handle &&
+		!zram_test_flag(zram, index, ZRAM_SAME) &&
+		!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED) &&
+		!zram_test_flag(zram, index, ZRAM_WB);
+}
+
+/*
+ * Reads up to ZS_MAP_BATCH full pages.  Compressed ones are mapped with
+ * a single zs_map_objects() call and decompressed on one stream; the
+ * rest go through zram_bvec_read().
+ */
+static int zram_bvec_read_batch(struct zram *zram, struct bio_vec **bvecs,
+				u32 *indices, int nr, struct bio *bio)
+{
+	void *handles[ZS_MAP_BATCH], *cmem[ZS_MAP_BATCH];
+	unsigned char *user_mem[ZS_MAP_BATCH];
+	struct bio_vec *batch[ZS_MAP_BATCH];
+	u32 idx[ZS_MAP_BATCH];
+	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
+	int i, n = 0, ret = 0, err;
+
+	down_read(&zram->lock);
+	for (i = 0; i < nr; i++) {
+		if (!zram_is_compressed(zram, indices[i])) {
+			err = zram_bvec_read(zram, bvecs[i], indices[i], 0, bio);
+			if (err)
+				ret = err;
+			continue;
+		}
+		zram_accessed(zram, indices[i]);
+		batch[n] = bvecs[i];
+		idx[n] = indices[i];
+		handles[n] = zram_get_handle(zram, indices[i]);
+		n++;
+	}
+
+	if (!n)
+		goto out;
+
+	zstrm = zcomp_strm_find(zram->comp);
+	for (i = 0; i < n; i++)
+		user_mem[i] = kmap_atomic(batch[i]->bv_page);
+	zs_map_objects(zram->mem_pool, handles, n, cmem);
+
+	for (i = 0; i < n; i++) {
+		err = zcomp_decompress(zstrm,
+				(unsigned char *)cmem[i] + sizeof(*zheader),
+				zram->table[idx[i]].size, user_mem[i]);
+		if (unlikely(err)) {
+			pr_err("Decompression failed! err=%d, page=%u\n",
+				err, idx[i]);
+			zram_stat64_inc(zram, &zram->stats.failed_reads);
+			ret = err;
+		}
+	}
+
+	zs_unmap_objects(zram->mem_pool, handles, n);
+	for (i = n - 1; i >= 0; i--)
+		kunmap_atomic(user_mem[i]);
+	zcomp_strm_release(zram->comp, zstrm);
+
+	for (i = 0; i < n; i++)
+		flush_dcache_page(batch[i]->bv_page);
+out:
+	up_read(&zram->lock);
+	return ret;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 {
-	int i, offset;
+	int i, offset, nr = 0;
 	u32 index;
 	struct bio_vec *bvec;
+	struct bio_vec *batch[ZS_MAP_BATCH];
+	u32 batch_index[ZS_MAP_BATCH];
 
 	switch (rw) {
 	case READ:
@@ -496,6 +1089,20 @@ static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 	bio_for_each_segment(bvec, bio, i) {
 		int max_transfer_size = PAGE_SIZE - offset;
 
+		/* Whole-page reads are queued and done in batches */
+		if (rw == READ && !is_partial_io(bvec) && !offset) {
+			batch[nr] = bvec;
+			batch_index[nr] = index;
+			if (++nr == ZS_MAP_BATCH) {
+				if (zram_bvec_read_batch(zram, batch,
+						batch_index, nr, bio) < 0)
+					goto out;
+				nr = 0;
+			}
+			update_position(&index, &offset, bvec);
+			continue;
+		}
+
 		if (bvec->bv_len > max_transfer_size) {
 			/*
 			 * zram_bvec_rw() can only make operation on a single
@@ -522,6 +1129,9 @@ static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 		update_position(&index, &offset, bvec);
 	}
 
+	if (nr && zram_bvec_read_batch(zram, batch, batch_index, nr, bio) < 0)
+		goto out;
+
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return;
@@ -583,12 +1193,10 @@ void __zram_reset_device(struct zram *zram)
 
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free the per-CPU compression streams */
+	if (zram->comp)
+		zcomp_destroy(zram->comp);
+	zram->comp = NULL;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
@@ -596,11 +1204,24 @@ void __zram_reset_device(struct zram *zram)
 		if (!handle)
 			continue;
 
-		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
+#ifdef CONFIG_ZRAM_WRITEBACK
+		/* Blocks on the backing device go with the bitmap below */
+		if (zram_test_flag(zram, index, ZRAM_WB))
+			continue;
+#endif
+
+		if (zram_test_flag(zram, index, ZRAM_SAME))
+			continue;
+
+		if (zram_test_flag(zram, index, ZRAM_DEDUP))
+			zram_dedup_put(zram, handle);
+		else if (unlikely(zram_test_flag(zram, index,
+						 ZRAM_UNCOMPRESSED)))
 			__free_page(handle);
 		else
 			zs_free(zram->mem_pool, handle);
 	}
+	zram_dedup_fini(zram);
 
 	vfree(zram->table);
 	zram->table = NULL;
@@ -608,6 +1229,8 @@ void __zram_reset_device(struct zram *zram)
 	zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
+	zram_reset_bdev(zram);
+
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -616,6 +1239,7 @@ void __zram_reset_device(struct zram *zram)
 
 void zram_reset_device(struct zram *zram)
 {
+	zram_wb_cancel(zram);
 	down_write(&zram->init_lock);
 	__zram_reset_device(zram);
 	up_write(&zram->init_lock);
@@ -635,18 +1259,12 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	zram->comp = zcomp_create(zram->compressor);
+	if (IS_ERR(zram->comp)) {
+		pr_err("Error creating %s compression streams\n",
+			zram->compressor);
+		ret = PTR_ERR(zram->comp);
+		zram->comp = NULL;
 		goto fail_no_table;
 	}
 
@@ -670,6 +1288,12 @@ int zram_init_device(struct zram *zram)
 		goto fail;
 	}
 
+	if (zram->use_dedup && zram_dedup_init(zram, num_pages)) {
+		pr_err("Error allocating dedup table\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	zram->init_done = 1;
 	up_write(&zram->init_lock);
 
@@ -708,6 +1332,11 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	strlcpy(zram->compressor, ZCOMP_DEFAULT, sizeof(zram->compressor));
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->bitmap_lock);
+	INIT_WORK(&zram->wb_work, zram_wb_work);
+#endif
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -777,6 +1406,10 @@ static void destroy_device(struct zram *zram)
 
 	if (zram->queue)
 		blk_cleanup_queue(zram->queue);
+
+	/* A backing device may be set on a device that was never used */
+	zram_wb_cancel(zram);
+	zram_reset_bdev(zram);
 }
 
 unsigned int zram_get_num_devices(void)
@@ -15,10 +15,13 @@
 #ifndef _ZRAM_DRV_H_
 #define _ZRAM_DRV_H_
 
+#include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -74,6 +77,21 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* Page is one repeated word; handle holds the word */
+	ZRAM_SAME,
+
+	/* handle points to a shared struct zram_entry */
+	ZRAM_DEDUP,
+
+	/* Page lives on the backing device; handle is the block number */
+	ZRAM_WB,
+
+	/* Page has not been accessed since the last idle marking */
+	ZRAM_IDLE,
+
+	/* Page is being copied to the backing device */
+	ZRAM_UNDER_WB,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -87,6 +105,15 @@ struct table {
 	u8 flags;
 } __attribute__((aligned(4)));
 
+/* A compressed object shared by every slot holding the same page */
+struct zram_entry {
+	struct hlist_node node;	/* in zram->dedup_table */
+	void *handle;
+	u32 checksum;
+	u16 len;
+	int refcount;		/* protected by zram->dedup_lock */
+};
+
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
 	u64 num_reads;		/* failed + successful */
@@ -96,19 +123,31 @@ struct zram_stats {
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of pages filled with one other word */
+	u32 dedup_saved;	/* no. of pages sharing another's object */
+	u64 dedup_hits;		/* writes satisfied by an existing object */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_wb;		/* no. of pages on the backing device */
+	u64 wb_reads;		/* pages read back from backing device */
+	u64 wb_writes;		/* pages written to backing device */
 };
 
+/* writeback_store() modes, may be combined */
+#define ZRAM_WB_HUGE	0x1	/* pages zram stores uncompressed */
+#define ZRAM_WB_IDLE	0x2	/* pages marked idle and not since used */
+
+/* Pages copied to the backing device per round */
+#define ZRAM_WB_BATCH	32
+
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zcomp *comp;	/* per-CPU compression streams */
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	struct rw_semaphore lock; /* protect table against concurrent
+				   * read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -119,6 +158,21 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	char compressor[ZCOMP_NAME_LEN];	/* set before init */
+
+	int use_dedup;			/* set before init */
+	struct hlist_head *dedup_table;
+	unsigned int dedup_mask;
+	spinlock_t dedup_lock;
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct block_device *bdev;	/* optional backing device */
+	unsigned long *bitmap;		/* used blocks, bit 0 is reserved */
+	unsigned long nr_blocks;
+	spinlock_t bitmap_lock;
+	struct work_struct wb_work;
+	int wb_mode;
+#endif
 
 	struct zram_stats stats;
 };
@@ -132,4 +186,21 @@ extern struct attribute_group zram_disk_attr_group;
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
 
+extern int zram_dedup_init(struct zram *zram, size_t num_pages);
+extern void zram_dedup_fini(struct zram *zram);
+extern struct zram_entry *zram_dedup_find(struct zram *zram,
+		struct zcomp_strm *zstrm, void *mem, u32 *checksum);
+extern struct zram_entry *zram_dedup_insert(struct zram *zram, void *handle,
+		u16 len, u32 checksum);
+extern size_t zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+extern int zram_set_backing_dev(struct zram *zram, const char *path);
+extern void zram_mark_idle(struct zram *zram);
+extern void zram_writeback(struct zram *zram, int mode);
+extern void zram_wb_cancel(struct zram *zram);
+#else
+static inline void zram_wb_cancel(struct zram *zram) { }
+#endif
+
 #endif
@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
@@ -27,6 +29,8 @@
 #include <linux/cpumask.h>
 #include <linux/cpu.h>
 #include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 
 #include "zsmalloc.h"
 #include "zsmalloc_int.h"
@@ -43,6 +47,12 @@
 /* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
+/* handles of all pools, see zs_malloc() */
+static struct kmem_cache *zs_handle_cache;
+
+static struct dentry *zs_stat_root;
+static atomic_t zs_pool_id = ATOMIC_INIT(0);
+
 static int is_first_page(struct page *page)
 {
 	return test_bit(PG_private, &page->flags);
@@ -122,6 +132,7 @@ static void insert_zspage(struct page *page, struct size_class *class,
 		list_add_tail(&page->lru, &(*head)->lru);
 
 	*head = page;
+	class->zspages[fullness]++;
 }
 
 static void remove_zspage(struct page *page, struct size_class *class,
@@ -143,6 +154,7 @@ static void remove_zspage(struct page *page, struct size_class *class,
 					struct page, lru);
 
 	list_del_init(&page->lru);
+	class->zspages[fullness]--;
 }
 
 static enum fullness_group fix_fullness_group(struct zs_pool *pool,
@@ -230,30 +242,57 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-/* Encode <page, obj_idx> as a single handle value */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+/* Encode <page, obj_idx> as a single obj value */
+static unsigned long location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
-		return NULL;
+		return 0;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= (obj_idx & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (obj_idx & OBJ_INDEX_MASK);
 
-	return (void *)handle;
+	return obj << OBJ_TAG_BITS;
 }
 
-/* Decode <page, obj_idx> pair from the given object handle */
-static void obj_handle_to_location(void *handle, struct page **page,
+/* Decode <page, obj_idx> pair from the given obj value */
+static void obj_to_location(unsigned long obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	unsigned long hval = (unsigned long)handle;
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*obj_idx = obj & OBJ_INDEX_MASK;
+}
 
-	*page = pfn_to_page(hval >> OBJ_INDEX_BITS);
-	*obj_idx = hval & OBJ_INDEX_MASK;
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle & ~(1UL << HANDLE_PIN_BIT);
+}
+
+/* Called with the object pinned or its class locked */
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	unsigned long pin = *(unsigned long *)handle & (1UL << HANDLE_PIN_BIT);
+
+	*(unsigned long *)handle = obj | pin;
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -330,7 +369,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -341,7 +380,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -396,7 +435,7 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = (void *)location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
 	first_page->objects = class->zspage_order * PAGE_SIZE / class->size;
 
@@ -426,27 +465,316 @@ static struct page *find_get_zspage(struct size_class *class)
 }
 
 
+/* Takes a free slot from first_page and tags it with handle */
+static unsigned long obj_malloc(struct page *first_page,
+				struct size_class *class, unsigned long handle)
+{
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long obj, m_objidx, m_offset;
+
+	obj = (unsigned long)first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page) +
+					m_offset / sizeof(*link);
+	first_page->freelist = (void *)link->next;
+	link->handle = handle | OBJ_ALLOCATED_TAG;
+	kunmap_atomic(link);
+
+	first_page->inuse++;
+	class->objs_inuse++;
+
+	return obj;
+}
+
+/* Returns slot obj to the freelist of its zspage first_page */
+static void obj_free(struct page *first_page, struct size_class *class,
+		     unsigned long obj)
+{
+	struct link_free *link;
+	struct page *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+							+ f_offset);
+	link->next = (unsigned long)first_page->freelist;
+	kunmap_atomic(link);
+	first_page->freelist = (void *)obj;
+
+	first_page->inuse--;
+	class->objs_inuse--;
+}
+
+/* Copies a whole object, which may span pages on either side */
+static void zs_object_copy(struct size_class *class, unsigned long dst,
+			   unsigned long src)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_idx, d_idx, s_off, d_off;
+	int written = 0;
+
+	obj_to_location(src, &s_page, &s_idx);
+	obj_to_location(dst, &d_page, &d_idx);
+	s_off = obj_idx_to_offset(s_page, s_idx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_idx, class->size);
+
+	while (written < class->size) {
+		void *s_addr, *d_addr;
+		int size = class->size - written;
+
+		size = min_t(int, size, PAGE_SIZE - s_off);
+		size = min_t(int, size, PAGE_SIZE - d_off);
+
+		s_addr = kmap_atomic(s_page);
+		d_addr = kmap_atomic(d_page);
+		memcpy(d_addr + d_off, s_addr + s_off, size);
+		kunmap_atomic(d_addr);
+		kunmap_atomic(s_addr);
+
+		written += size;
+		s_off += size;
+		d_off += size;
+		if (s_off >= PAGE_SIZE) {
+			s_page = get_next_page(s_page);
+			s_off = 0;
+		}
+		if (d_off >= PAGE_SIZE) {
+			d_page = get_next_page(d_page);
+			d_off = 0;
+		}
+	}
+}
+
+static struct page *isolate_target_zspage(struct size_class *class)
+{
+	if (class->fullness_list[ZS_ALMOST_FULL])
+		return class->fullness_list[ZS_ALMOST_FULL];
+	return class->fullness_list[ZS_ALMOST_EMPTY];
+}
+
+/*
+ * Moves the objects of src, which is off the fullness lists, into
+ * zspages that are on them.  Returns nonzero if some object could not
+ * be moved, either because it is mapped or because there is no room.
+ * Called with class->lock held.
+ */
+static int migrate_zspage(struct zs_pool *pool, struct size_class *class,
+			  struct page *src)
+{
+	struct page *page = src, *dst = NULL;
+	unsigned long off = 0, idx = 0;
+	int i, busy = 0;
+
+	for (i = 0; i < src->objects; i++, idx++, off += class->size) {
+		unsigned long old_obj, new_obj, handle;
+		struct link_free *link;
+
+		if (off >= PAGE_SIZE) {
+			page = get_next_page(page);
+			off = page->index;
+			idx = 0;
+		}
+
+		link = (struct link_free *)((unsigned char *)kmap_atomic(page)
+								+ off);
+		handle = link->handle;
+		kunmap_atomic(link);
+		if (!(handle & OBJ_ALLOCATED_TAG))
+			continue;
+		handle &= ~OBJ_ALLOCATED_TAG;
+
+		if (!dst || dst->inuse == dst->objects) {
+			if (dst)
+				fix_fullness_group(pool, dst);
+			dst = isolate_target_zspage(class);
+			if (!dst) {
+				busy = 1;
+				break;
+			}
+		}
+
+		if (!trypin_tag(handle)) {
+			busy = 1;
+			continue;
+		}
+
+		old_obj = location_to_obj(page, idx);
+		new_obj = obj_malloc(dst, class, handle);
+		zs_object_copy(class, new_obj, old_obj);
+		record_obj(handle, new_obj);
+		obj_free(src, class, old_obj);
+		unpin_tag(handle);
+	}
+
+	if (dst)
+		fix_fullness_group(pool, dst);
+
+	return busy;
+}
+
+static unsigned long zs_compact_class(struct zs_pool *pool,
+				      struct size_class *class)
+{
+	unsigned long freed = 0;
+	struct page *src;
+	enum fullness_group fg;
+	int busy;
+
+	spin_lock(&class->lock);
+	while ((src = class->fullness_list[ZS_ALMOST_EMPTY])) {
+		/* Keep src out of reach of zs_malloc() and of itself */
+		remove_zspage(src, class, ZS_ALMOST_EMPTY);
+		busy = migrate_zspage(pool, class, src);
+
+		fg = get_fullness_group(src);
+		if (fg == ZS_EMPTY) {
+			set_zspage_mapping(src, class->index, ZS_EMPTY);
+			class->pages_allocated -= class->zspage_order;
+			class->objs_allocated -= src->objects;
+			spin_unlock(&class->lock);
+			free_zspage(src);
+			freed += class->zspage_order;
+			cond_resched();
+			spin_lock(&class->lock);
+		} else {
+			insert_zspage(src, class, fg);
+			set_zspage_mapping(src, class->index, fg);
+		}
+
+		if (busy)
+			break;
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - Free zspages by packing objects into fuller ones
+ * @pool: pool to compact
+ *
+ * Objects are moved out of ZS_ALMOST_EMPTY zspages within each size
+ * class.  Objects that are currently mapped are skipped.  Returns the
+ * number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	unsigned long freed = 0;
+	int i;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += zs_compact_class(pool, &pool->size_class[i]);
+
+	pool->pages_compacted += freed;
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+/* Pages that compacting a class could free, in the best case */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long wasted, per_zspage;
+
+	per_zspage = class->zspage_order * PAGE_SIZE / class->size;
+	wasted = class->objs_allocated - class->objs_inuse;
+
+	return wasted / per_zspage * class->zspage_order;
+}
+
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					    shrinker);
+	unsigned long freeable = 0;
+	int i;
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		freeable += zs_can_compact(&pool->size_class[i]);
+
+	return min_t(unsigned long, freeable, INT_MAX);
+}
+
+static int zs_stats_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+	int i;
+
+	seq_printf(s, "%5s %5s %10s %10s %10s %10s %10s %8s\n",
+		   "class", "size", "almost_full", "almost_empty",
+		   "obj_alloc", "obj_used", "pages_used", "freeable");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+		unsigned long almost_full, almost_empty, alloc, used, freeable;
+		u64 pages;
+
+		spin_lock(&class->lock);
+		almost_full = class->zspages[ZS_ALMOST_FULL];
+		almost_empty = class->zspages[ZS_ALMOST_EMPTY];
+		alloc = class->objs_allocated;
+		used = class->objs_inuse;
+		pages = class->pages_allocated;
+		freeable = zs_can_compact(class);
+		spin_unlock(&class->lock);
+
+		if (!pages)
+			continue;
+		seq_printf(s, "%5d %5d %10lu %10lu %10lu %10lu %10llu %8lu\n",
+			   i, class->size, almost_full, almost_empty, alloc,
+			   used, pages, freeable);
+	}
+	seq_printf(s, "pages compacted: %lu\n", pool->pages_compacted);
+
+	return 0;
+}
+
+static int zs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_show, inode->i_private);
+}
+
+static const struct file_operations zs_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = zs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 				void *pcpu)
 {
-	int cpu = (long)pcpu;
+	int i, cpu = (long)pcpu;
 	struct mapping_area *area;
 
 	switch (action) {
 	case CPU_UP_PREPARE:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
-			break;
-		area->vm = alloc_vm_area(2 * PAGE_SIZE, area->vm_ptes);
-		if (!area->vm)
-			return notifier_from_errno(-ENOMEM);
+		for (i = 0; i < ZS_MAP_BATCH; i++) {
+			if (area->vm[i])
+				continue;
+			area->vm[i] = alloc_vm_area(2 * PAGE_SIZE,
+						    area->vm_ptes[i]);
+			if (!area->vm[i])
+				return notifier_from_errno(-ENOMEM);
+		}
 		break;
 	case CPU_DEAD:
 	case CPU_UP_CANCELED:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
-			free_vm_area(area->vm);
-		area->vm = NULL;
+		for (i = 0; i < ZS_MAP_BATCH; i++) {
+			if (area->vm[i])
+				free_vm_area(area->vm[i]);
+			area->vm[i] = NULL;
+		}
 		break;
 	}
 
@@ -464,12 +792,21 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+	debugfs_remove_recursive(zs_stat_root);
+	if (zs_handle_cache)
+		kmem_cache_destroy(zs_handle_cache);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cache = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					    0, 0, NULL);
+	if (!zs_handle_cache)
+		return -ENOMEM;
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
@@ -514,6 +851,19 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 	pool->flags = flags;
 	pool->name = name;
 
+	pool->shrinker.shrink = zs_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
+	if (zs_stat_root) {
+		char stat_name[32];
+
+		snprintf(stat_name, sizeof(stat_name), "%s%d", name,
+			 atomic_inc_return(&zs_pool_id) - 1);
+		pool->stat_dentry = debugfs_create_file(stat_name, S_IRUGO,
+					zs_stat_root, pool, &zs_stats_fops);
+	}
+
 	return pool;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
@@ -522,6 +872,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	unregister_shrinker(&pool->shrinker);
+	debugfs_remove(pool->stat_dentry);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -542,28 +895,30 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  * zs_malloc - Allocate block of given size from pool.
  * @pool: pool to allocate from
  * @size: size of block to allocate
- * @page: page no. that holds the object
- * @offset: location of object within page
  *
- * On success, <page, offset> identifies block allocated
- * and 0 is returned. On failure, <page, offset> is set to
- * 0 and -ENOMEM is returned.
+ * On success, a handle to the allocated block is returned, which must
+ * be mapped with zs_map_object() to access the block.  On failure,
+ * NULL is returned.
  *
- * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE
+ * will fail.
  */
 void *zs_malloc(struct zs_pool *pool, size_t size)
 {
-	void *obj;
-	struct link_free *link;
+	unsigned long handle, obj;
 	int class_idx;
 	struct size_class *class;
+	struct page *first_page;
 
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return NULL;
 
-	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
+	handle = (unsigned long)kmem_cache_alloc(zs_handle_cache,
+					pool->flags & ~__GFP_HIGHMEM);
+	if (!handle)
 		return NULL;
 
+	size += ZS_HANDLE_SIZE;
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -574,96 +929,91 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			kmem_cache_free(zs_handle_cache, (void *)handle);
 			return NULL;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->zspage_order;
+		class->objs_allocated += first_page->objects;
 	}
 
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	obj = obj_malloc(first_page, class, handle);
+	*(unsigned long *)handle = obj;
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return (void *)handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, void *obj)
+void zs_free(struct zs_pool *pool, void *handle)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
+	unsigned long obj, f_objidx;
 
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	/* Keeps compaction from moving the object under us */
+	pin_tag((unsigned long)handle);
+	obj = handle_to_obj((unsigned long)handle);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = obj;
-
-	first_page->inuse--;
+	obj_free(first_page, class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
-	if (fullness == ZS_EMPTY)
+	if (fullness == ZS_EMPTY) {
 		class->pages_allocated -= class->zspage_order;
+		class->objs_allocated -= first_page->objects;
+	}
 
 	spin_unlock(&class->lock);
+	unpin_tag((unsigned long)handle);
+	kmem_cache_free(zs_handle_cache, handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
-void *zs_map_object(struct zs_pool *pool, void *handle)
+/*
+ * Maps the pinned object into slot of this CPU's mapping area.  Objects
+ * inside one page, the common case for zram, only need kmap_atomic();
+ * the slot's VM area is used for objects that span two pages.
+ */
+static void *__zs_map_object(struct zs_pool *pool, struct mapping_area *area,
+			     int slot, unsigned long handle)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj, obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
 	struct size_class *class;
-	struct mapping_area *area;
-
-	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
 
-	area = &get_cpu_var(zs_map_area);
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
-		area->vm_addr = kmap_atomic(page);
+		area->spans[slot] = 0;
+		area->vm_addr[slot] = kmap_atomic(page);
 	} else {
 		/* this object spans two pages */
 		struct page *nextp;
@@ -671,47 +1021,145 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 		nextp = get_next_page(page);
 		BUG_ON(!nextp);
 
-
-		set_pte(area->vm_ptes[0], mk_pte(page, PAGE_KERNEL));
-		set_pte(area->vm_ptes[1], mk_pte(nextp, PAGE_KERNEL));
+		set_pte(area->vm_ptes[slot][0], mk_pte(page, PAGE_KERNEL));
+		set_pte(area->vm_ptes[slot][1], mk_pte(nextp, PAGE_KERNEL));
 
 		/* We pre-allocated VM area so mapping can never fail */
-		area->vm_addr = area->vm->addr;
+		area->spans[slot] = 1;
+		area->vm_addr[slot] = area->vm[slot]->addr;
 	}
 
-	return area->vm_addr + off;
+	return area->vm_addr[slot] + off + ZS_HANDLE_SIZE;
+}
+
+static void __zs_unmap_object(struct mapping_area *area, int slot)
+{
+	if (!area->spans[slot]) {
+		kunmap_atomic(area->vm_addr[slot]);
+	} else {
+		unsigned long addr = (unsigned long)area->vm_addr[slot];
+
+		set_pte(area->vm_ptes[slot][0], __pte(0));
+		set_pte(area->vm_ptes[slot][1], __pte(0));
+		__flush_tlb_one(addr);
+		__flush_tlb_one(addr + PAGE_SIZE);
+	}
+}
+
+void *zs_map_object(struct zs_pool *pool, void *handle)
+{
+	struct mapping_area *area;
+
+	BUG_ON(!handle);
+
+	/* The object stays where it is until zs_unmap_object() */
+	pin_tag((unsigned long)handle);
+
+	area = &get_cpu_var(zs_map_area);
+	return __zs_map_object(pool, area, 0, (unsigned long)handle);
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
 void zs_unmap_object(struct zs_pool *pool, void *handle)
 {
-	struct page *page;
-	unsigned long obj_idx, off;
-
-	unsigned int class_idx;
-	enum fullness_group fg;
-	struct size_class *class;
 	struct mapping_area *area;
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
-	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
-	class = &pool->size_class[class_idx];
-	off = obj_idx_to_offset(page, obj_idx, class->size);
+	area = &__get_cpu_var(zs_map_area);
+	__zs_unmap_object(area, 0);
+	put_cpu_var(zs_map_area);
+	unpin_tag((unsigned long)handle);
+}
+EXPORT_SYMBOL_GPL(zs_unmap_object);
+
+/* Returns the batch position of the first occurrence of handles[i] */
+static int zs_batch_first(void **handles, int i)
+{
+	int j;
+
+	for (j = 0; j < i; j++) {
+		if (handles[j] == handles[i])
+			return j;
+	}
+	return i;
+}
+
+/*
+ * Pins distinct handles in address order, so two batches sharing
+ * objects cannot deadlock against each other.
+ */
+static void zs_batch_pin(void **handles, int nr, int pin)
+{
+	unsigned long last = 0;
+	int done, i;
+
+	for (done = 0; done < nr; done++) {
+		unsigned long next = ULONG_MAX;
+
+		for (i = 0; i < nr; i++) {
+			unsigned long h = (unsigned long)handles[i];
+
+			if (h > last && h < next)
+				next = h;
+		}
+		if (next == ULONG_MAX)
+			break;
+		if (pin)
+			pin_tag(next);
+		else
+			unpin_tag(next);
+		last = next;
+	}
+}
+
+/**
+ * zs_map_objects - Map several objects at once
+ * @pool: pool the objects belong to
+ * @handles: up to ZS_MAP_BATCH handles, possibly repeated
+ * @nr: number of handles
+ * @addrs: filled with the address of each object
+ *
+ * Like zs_map_object() for each handle, but preemption is disabled and
+ * the handles are resolved only once for the whole batch.  The objects
+ * must be released with zs_unmap_objects() on the same arrays.
+ */
+void zs_map_objects(struct zs_pool *pool, void **handles, int nr,
+		    void **addrs)
+{
+	struct mapping_area *area;
+	int i, first;
+
+	BUG_ON(nr > ZS_MAP_BATCH);
+
+	zs_batch_pin(handles, nr, 1);
+	area = &get_cpu_var(zs_map_area);
+	for (i = 0; i < nr; i++) {
+		first = zs_batch_first(handles, i);
+		if (first < i)
+			addrs[i] = addrs[first];
+		else
+			addrs[i] = __zs_map_object(pool, area, i,
+					(unsigned long)handles[i]);
+	}
+}
+EXPORT_SYMBOL_GPL(zs_map_objects);
+
+void zs_unmap_objects(struct zs_pool *pool, void **handles, int nr)
+{
+	struct mapping_area *area;
+	int i;
 
 	area = &__get_cpu_var(zs_map_area);
-	if (off + class->size <= PAGE_SIZE) {
-		kunmap_atomic(area->vm_addr);
-	} else {
-		set_pte(area->vm_ptes[0], __pte(0));
-		set_pte(area->vm_ptes[1], __pte(0));
-		__flush_tlb_one((unsigned long)area->vm_addr);
-		__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
+	/* kmap_atomic() mappings must be dropped in reverse order */
+	for (i = nr - 1; i >= 0; i--) {
+		if (zs_batch_first(handles, i) == i)
+			__zs_unmap_object(area, i);
 	}
 	put_cpu_var(zs_map_area);
+	zs_batch_pin(handles, nr, 0);
 }
-EXPORT_SYMBOL_GPL(zs_unmap_object);
+EXPORT_SYMBOL_GPL(zs_unmap_objects);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool)
 {
@@ -15,6 +15,9 @@
 
 #include <linux/types.h>
 
+/* Most objects zs_map_objects() can map at once */
+#define ZS_MAP_BATCH	4
+
 struct zs_pool;
 
 struct zs_pool *zs_create_pool(const char *name, gfp_t flags);
@@ -25,7 +28,11 @@ void zs_free(struct zs_pool *pool, void *obj);
 
 void *zs_map_object(struct zs_pool *pool, void *handle);
 void zs_unmap_object(struct zs_pool *pool, void *handle);
+void zs_map_objects(struct zs_pool *pool, void **handles, int nr,
+		    void **addrs);
+void zs_unmap_objects(struct zs_pool *pool, void **handles, int nr);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
+unsigned long zs_compact(struct zs_pool *pool);
 
 #endif
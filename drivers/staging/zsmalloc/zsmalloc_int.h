@@ -14,9 +14,12 @@
 #define _ZS_MALLOC_INT_H_
 
 #include <linux/kernel.h>
+#include <linux/shrinker.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
 
+#include "zsmalloc.h"
+
 /*
  * This must be power of 2 and greater than of equal to sizeof(link_free).
  * These two conditions ensure that any 'struct link_free' itself doesn't
@@ -33,14 +36,21 @@
 #define ZS_MAX_PAGES_PER_ZSPAGE (_AC(1, UL) << ZS_MAX_ZSPAGE_ORDER)
 
 /*
- * Object location (<PFN>, <obj_idx>) is encoded as
- * as single (void *) handle value.
+ * Object location (<PFN>, <obj_idx>) is encoded as a single unsigned
+ * long 'obj' value, shifted left by OBJ_TAG_BITS to leave room for a
+ * tag bit.
  *
  * Note that object index <obj_idx> is relative to system
  * page <PFN> it is stored in, so for each sub-page belonging
  * to a zspage, obj_idx starts with 0.
  *
  * This is made more complicated by various memory models and PAE.
+ *
+ * The handle returned by zs_malloc() points to a word holding the obj
+ * value, so objects can be moved by compaction without the user of
+ * the handle noticing.  Bit 0 of that word pins the object while it is
+ * mapped.  The first word of each allocated object holds its handle
+ * with OBJ_ALLOCATED_TAG set; for free objects it is the freelist link.
  */
 
 #ifndef MAX_PHYSMEM_BITS
@@ -55,9 +65,15 @@
 #endif
 #endif
 #define _PFN_BITS		(MAX_PHYSMEM_BITS - PAGE_SHIFT)
-#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS)
+#define OBJ_TAG_BITS		1
+#define OBJ_ALLOCATED_TAG	1
+#define HANDLE_PIN_BIT		0
+#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS - OBJ_TAG_BITS)
 #define OBJ_INDEX_MASK	((_AC(1, UL) << OBJ_INDEX_BITS) - 1)
 
+/* Space taken at the start of every object by its handle */
+#define ZS_HANDLE_SIZE	(sizeof(unsigned long))
+
 #define MAX(a, b) ((a) >= (b) ? (a) : (b))
 /* ZS_MIN_ALLOC_SIZE must be multiple of ZS_ALIGN */
 #define ZS_MIN_ALLOC_SIZE \
@@ -109,10 +125,12 @@ enum fullness_group {
  */
 static const int fullness_threshold_frac = 4;
 
+/* One slot per object of a zs_map_objects() batch */
 struct mapping_area {
-	struct vm_struct *vm;
-	pte_t *vm_ptes[2];
-	char *vm_addr;
+	struct vm_struct *vm[ZS_MAP_BATCH];
+	pte_t *vm_ptes[ZS_MAP_BATCH][2];
+	char *vm_addr[ZS_MAP_BATCH];
+	int spans[ZS_MAP_BATCH];	/* slot uses vm rather than kmap */
 };
 
 struct size_class {
@@ -130,6 +148,9 @@ struct size_class {
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long objs_allocated;	/* object slots in all zspages */
+	unsigned long objs_inuse;
+	unsigned long zspages[_ZS_NR_FULLNESS_GROUPS];	/* on each list */
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -141,8 +162,12 @@ struct size_class {
  * This must be power of 2 and less than or equal to ZS_ALIGN
  */
 struct link_free {
-	/* Handle of next free chunk (encodes <PFN, obj_idx>) */
-	void *next;
+	union {
+		/* obj value of next free chunk (encodes <PFN, obj_idx>) */
+		unsigned long next;
+		/* handle of the allocated object, with OBJ_ALLOCATED_TAG */
+		unsigned long handle;
+	};
 };
 
 struct zs_pool {
@@ -150,6 +175,11 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	/* compaction */
+	struct shrinker shrinker;
+	unsigned long pages_compacted;
+	struct dentry *stat_dentry;
 };
 
 #endif
@@ -40,6 +40,10 @@
 #include <linux/pm_runtime.h>
 #include <linux/wakelock.h>
 #include <linux/of.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <plat/dma.h>
 #include <plat/dmtimer.h>
@@ -80,8 +84,10 @@ static struct wake_lock omap_serial_wake_lock;
 
 /* Forward declaration of functions */
 static void uart_tx_dma_callback(int lch, u16 ch_status, void *data);
-static void serial_omap_rxdma_poll(unsigned long uart_no);
+static void serial_omap_rxdma_idle(unsigned long uart_no);
 static int serial_omap_start_rxdma(struct uart_omap_port *up);
+static void serial_omap_rx_dma_push(struct uart_omap_port *up);
+static void serial_omap_tx_dma(struct uart_omap_port *up);
 static void serial_omap_mdr1_errataset(struct uart_omap_port *up, u8 mdr1);
 
 static struct workqueue_struct *serial_omap_uart_wq;
@@ -152,14 +158,24 @@ static inline void serial_omap_port_enable(struct uart_omap_port *up)
 
 static void serial_omap_stop_rxdma(struct uart_omap_port *up)
 {
-	if (up->uart_dma.rx_dma_used) {
-		del_timer(&up->uart_dma.rx_timer);
-		omap_stop_dma(up->uart_dma.rx_dma_channel);
-		omap_free_dma(up->uart_dma.rx_dma_channel);
-		up->uart_dma.rx_dma_channel = OMAP_UART_DMA_CH_FREE;
-		up->uart_dma.rx_dma_used = false;
-		serial_omap_port_disable(up);
+	struct uart_omap_dma *dma = &up->uart_dma;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dma->rx_lock, flags);
+	if (!dma->rx_dma_used) {
+		spin_unlock_irqrestore(&dma->rx_lock, flags);
+		return;
 	}
+	del_timer(&dma->rx_timer);
+	omap_stop_dma(dma->rx_dma_channel);
+	omap_dma_unlink_lch(dma->rx_dma_channel, dma->rx_dma_channel);
+	omap_free_dma(dma->rx_dma_channel);
+	dma->rx_dma_channel = OMAP_UART_DMA_CH_FREE;
+	dma->rx_dma_used = false;
+	dma->stats.rx_active += jiffies - dma->rx_start;
+	spin_unlock_irqrestore(&dma->rx_lock, flags);
+
+	serial_omap_port_disable(up);
 }
 
 static void serial_omap_enable_ms(struct uart_port *port)
@@ -183,13 +199,19 @@ static void serial_omap_stop_tx(struct uart_port *port)
 		up->uart_dma.tx_dma_channel != OMAP_UART_DMA_CH_FREE) {
 		/*
 		 * Check if dma is still active. If yes do nothing,
-		 * return. Else stop dma
+		 * return. Else stop dma.  The first channel of a chained
+		 * transfer is idle while the second one runs.
 		 */
-		if (omap_get_dma_active_status(up->uart_dma.tx_dma_channel))
+		if (up->uart_dma.tx_chained ||
+		    omap_get_dma_active_status(up->uart_dma.tx_dma_channel))
 			return;
 		omap_stop_dma(up->uart_dma.tx_dma_channel);
 		omap_free_dma(up->uart_dma.tx_dma_channel);
 		up->uart_dma.tx_dma_channel = OMAP_UART_DMA_CH_FREE;
+		if (up->uart_dma.tx_dma_channel2 != OMAP_UART_DMA_CH_FREE) {
+			omap_free_dma(up->uart_dma.tx_dma_channel2);
+			up->uart_dma.tx_dma_channel2 = OMAP_UART_DMA_CH_FREE;
+		}
 		serial_omap_port_disable(up);
 	}
 
@@ -333,8 +355,6 @@ static void serial_omap_start_tx(struct uart_port *port)
 {
 	struct uart_omap_port *up = (struct uart_omap_port *)port;
 	struct omap_uart_port_info *pdata = up->pdev->dev.platform_data;
-	struct circ_buf *xmit;
-	unsigned int start;
 	int ret = 0;
 
 	if (!up->use_dma) {
@@ -346,11 +366,10 @@ static void serial_omap_start_tx(struct uart_port *port)
 		return;
 	}
 
-	if (up->uart_dma.tx_dma_used)
+	if (up->uart_dma.tx_dma_used ||
+	    uart_circ_empty(&up->port.state->xmit))
 		return;
 
-	xmit = &up->port.state->xmit;
-
 	if (up->uart_dma.tx_dma_channel == OMAP_UART_DMA_CH_FREE) {
 		serial_omap_port_enable(up);
 		ret = omap_request_dma(up->uart_dma.uart_dma_tx,
@@ -363,38 +382,18 @@ static void serial_omap_start_tx(struct uart_port *port)
 			serial_omap_port_disable(up);
 			return;
 		}
+
+		/* without it, a wrapped transfer goes out in two steps */
+		if (omap_request_dma(up->uart_dma.uart_dma_tx,
+				"UART Tx DMA", (void *)uart_tx_dma_callback,
+				up, &(up->uart_dma.tx_dma_channel2)) < 0)
+			up->uart_dma.tx_dma_channel2 = OMAP_UART_DMA_CH_FREE;
 	}
 	spin_lock(&(up->uart_dma.tx_lock));
 	up->uart_dma.tx_dma_used = true;
 	spin_unlock(&(up->uart_dma.tx_lock));
 
-	start = up->uart_dma.tx_buf_dma_phys +
-				(xmit->tail & (UART_XMIT_SIZE - 1));
-
-	up->uart_dma.tx_buf_size = uart_circ_chars_pending(xmit);
-	/*
-	 * It is a circular buffer. See if the buffer has wounded back.
-	 * If yes it will have to be transferred in two separate dma
-	 * transfers
-	 */
-	if (start + up->uart_dma.tx_buf_size >=
-			up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE)
-		up->uart_dma.tx_buf_size =
-			(up->uart_dma.tx_buf_dma_phys +
-			UART_XMIT_SIZE) - start;
-
-	omap_set_dma_dest_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_CONSTANT,
-				up->uart_dma.uart_base, 0, 0);
-	omap_set_dma_src_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_POST_INC, start, 0, 0);
-	omap_set_dma_transfer_params(up->uart_dma.tx_dma_channel,
-				OMAP_DMA_DATA_TYPE_S8,
-				up->uart_dma.tx_buf_size, 1,
-				OMAP_DMA_SYNC_ELEMENT,
-				up->uart_dma.uart_dma_tx, 0);
-	/* FIXME: Cache maintenance needed here? */
-	omap_start_dma(up->uart_dma.tx_dma_channel);
+	serial_omap_tx_dma(up);
 }
 
 static unsigned int check_modem_status(struct uart_omap_port *up)
@@ -436,6 +435,7 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	unsigned int iir, lsr;
 	unsigned int int_id;
 	unsigned long flags;
+	bool rx_flush = false;
 	int ret = IRQ_HANDLED;
 
 	serial_omap_port_enable(up);
@@ -455,12 +455,19 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 		if (!up->use_dma) {
 			if (lsr & UART_LSR_DR)
 				receive_chars(up, &lsr);
-		} else {
-			up->ier &= ~(UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
+		} else if (!up->uart_dma.rx_dma_used) {
 			if ((serial_omap_start_rxdma(up) != 0) &&
 					(lsr & UART_LSR_DR))
 				receive_chars(up, &lsr);
+		} else if (int_id != UART_IIR_RDI) {
+			/*
+			 * The DMA runs at the RX threshold, which is also
+			 * when RDI fires, so that one needs nothing.  A
+			 * timeout or line status interrupt means data is
+			 * left below the threshold: flush the ring, then
+			 * read what is in the FIFO.
+			 */
+			rx_flush = true;
 		}
 	}
 
@@ -468,8 +475,18 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	if (int_id == UART_IIR_THRI)
 		transmit_chars(up);
 
-
 	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	if (rx_flush) {
+		serial_omap_rx_dma_push(up);
+		spin_lock_irqsave(&up->port.lock, flags);
+		up->uart_dma.stats.rx_flushes++;
+		lsr = serial_in(up, UART_LSR);
+		if (lsr & (UART_LSR_DR | UART_LSR_BI))
+			receive_chars(up, &lsr);
+		spin_unlock_irqrestore(&up->port.lock, flags);
+	}
+
 	serial_omap_port_disable(up);
 
 	up->port_activity = jiffies;
@@ -600,7 +617,7 @@ static int serial_omap_startup(struct uart_port *port)
 			(dma_addr_t *)&(up->uart_dma.tx_buf_dma_phys),
 			0);
 		init_timer(&(up->uart_dma.rx_timer));
-		up->uart_dma.rx_timer.function = serial_omap_rxdma_poll;
+		up->uart_dma.rx_timer.function = serial_omap_rxdma_idle;
 		up->uart_dma.rx_timer.data = up->port.line;
 		/* Currently the buffer size is 4KB. Can increase it */
 		up->uart_dma.rx_buf = dma_alloc_coherent(NULL,
@@ -1293,149 +1310,285 @@ static int serial_omap_resume(struct device *dev)
 }
 #endif
 
-static void serial_omap_rxdma_poll(unsigned long uart_no)
+/*
+ * The RX DMA channel is linked to itself, so that it loops over rx_buf
+ * for as long as data comes in, and interrupts at the end of each of
+ * its OMAP_UART_RX_DMA_PERIODS frames.  Data still short of a period is
+ * flushed by the UART RX timeout interrupt, that is after four character
+ * times of silence, so there is no need to poll the DMA position.
+ */
+static void serial_omap_rx_dma_push(struct uart_omap_port *up)
 {
-	struct uart_omap_port *up = ui[uart_no];
-	unsigned int curr_dma_pos, curr_transmitted_size;
-	int ret = 0;
-
-	curr_dma_pos = omap_get_dma_dst_pos(up->uart_dma.rx_dma_channel);
-	if ((curr_dma_pos == up->uart_dma.prev_rx_dma_pos) ||
-			     (curr_dma_pos == 0)) {
-		if (jiffies_to_msecs(jiffies - up->port_activity) <
-						up->uart_dma.rx_timeout) {
-			mod_timer(&up->uart_dma.rx_timer, jiffies +
-				usecs_to_jiffies(up->uart_dma.rx_poll_rate));
-		} else {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
-		return;
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct tty_struct *tty = up->port.state->port.tty;
+	unsigned long flags;
+	unsigned int head;
+	dma_addr_t pos;
+	ktime_t start;
+	int count = 0;
+
+	start = ktime_get();
+	spin_lock_irqsave(&dma->rx_lock, flags);
+	if (!dma->rx_dma_used)
+		goto out;
+
+	/* the position reads 0 until the first byte is written */
+	pos = omap_get_dma_dst_pos(dma->rx_dma_channel);
+	if (pos < dma->rx_buf_dma_phys ||
+	    pos > dma->rx_buf_dma_phys + dma->rx_buf_size)
+		goto out;
+
+	head = pos - dma->rx_buf_dma_phys;
+	if (head < dma->rx_tail) {
+		count += tty_insert_flip_string(tty,
+				dma->rx_buf + dma->rx_tail,
+				dma->rx_buf_size - dma->rx_tail);
+		dma->rx_tail = 0;
 	}
+	count += tty_insert_flip_string(tty, dma->rx_buf + dma->rx_tail,
+					head - dma->rx_tail);
+	dma->rx_tail = head == dma->rx_buf_size ? 0 : head;
+
+	if (count) {
+		up->port.icount.rx += count;
+		dma->stats.rx_bytes += count;
+		mod_timer(&dma->rx_timer, jiffies + dma->rx_timeout);
+	}
+	dma->stats.cpu_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+out:
+	spin_unlock_irqrestore(&dma->rx_lock, flags);
 
-	curr_transmitted_size = curr_dma_pos -
-					up->uart_dma.prev_rx_dma_pos;
-	up->port.icount.rx += curr_transmitted_size;
-	tty_insert_flip_string(up->port.state->port.tty,
-			up->uart_dma.rx_buf +
-			(up->uart_dma.prev_rx_dma_pos -
-			up->uart_dma.rx_buf_dma_phys),
-			curr_transmitted_size);
-	tty_flip_buffer_push(up->port.state->port.tty);
-	up->uart_dma.prev_rx_dma_pos = curr_dma_pos;
-	if (up->uart_dma.rx_buf_size +
-			up->uart_dma.rx_buf_dma_phys == curr_dma_pos) {
-		ret = serial_omap_start_rxdma(up);
-		if (ret < 0) {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
-	} else  {
-		mod_timer(&up->uart_dma.rx_timer, jiffies +
-			usecs_to_jiffies(up->uart_dma.rx_poll_rate));
+	if (count) {
+		wake_lock_timeout(&omap_serial_wake_lock, 1*HZ);
+		tty_flip_buffer_push(tty);
+		up->port_activity = jiffies;
 	}
-	up->port_activity = jiffies;
+}
+
+/*
+ * Nothing was received for rx_timeout jiffies: give the DMA channel back
+ * and let the port idle.  The next character raises an RX interrupt (or
+ * an IO pad wakeup first) which restarts the DMA.
+ */
+static void serial_omap_rxdma_idle(unsigned long uart_no)
+{
+	struct uart_omap_port *up = ui[uart_no];
+
+	serial_omap_rx_dma_push(up);
+	if (timer_pending(&up->uart_dma.rx_timer))
+		return;
+	serial_omap_stop_rxdma(up);
 }
 
 static void uart_rx_dma_callback(int lch, u16 ch_status, void *data)
 {
-	return;
+	struct uart_omap_port *up = (struct uart_omap_port *)data;
+
+	up->uart_dma.stats.rx_irqs++;
+	serial_omap_rx_dma_push(up);
 }
 
 static int serial_omap_start_rxdma(struct uart_omap_port *up)
 {
-	int ret = 0;
+	struct uart_omap_dma *dma = &up->uart_dma;
+	unsigned long flags;
+	int ret;
 
-	if (up->uart_dma.rx_dma_channel == -1) {
-		serial_omap_port_enable(up);
-		ret = omap_request_dma(up->uart_dma.uart_dma_rx,
-				"UART Rx DMA",
-				(void *)uart_rx_dma_callback, up,
-				&(up->uart_dma.rx_dma_channel));
-		if (ret < 0)
-			return ret;
-
-		omap_set_dma_src_params(up->uart_dma.rx_dma_channel, 0,
-				OMAP_DMA_AMODE_CONSTANT,
+	if (dma->rx_dma_used)
+		return 0;
+
+	serial_omap_port_enable(up);
+	ret = omap_request_dma(dma->uart_dma_rx, "UART Rx DMA",
+			(void *)uart_rx_dma_callback, up,
+			&dma->rx_dma_channel);
+	if (ret < 0) {
+		serial_omap_port_disable(up);
+		return ret;
+	}
+
+	omap_set_dma_src_params(dma->rx_dma_channel, 0,
+			OMAP_DMA_AMODE_CONSTANT, dma->uart_base, 0, 0);
+	omap_set_dma_dest_params(dma->rx_dma_channel, 0,
+			OMAP_DMA_AMODE_POST_INC, dma->rx_buf_dma_phys, 0, 0);
+	omap_set_dma_transfer_params(dma->rx_dma_channel,
+			OMAP_DMA_DATA_TYPE_S8,
+			dma->rx_buf_size / OMAP_UART_RX_DMA_PERIODS,
+			OMAP_UART_RX_DMA_PERIODS, OMAP_DMA_SYNC_ELEMENT,
+			dma->uart_dma_rx, 0);
+	omap_enable_dma_irq(dma->rx_dma_channel, OMAP_DMA_FRAME_IRQ);
+	omap_dma_link_lch(dma->rx_dma_channel, dma->rx_dma_channel);
+
+	spin_lock_irqsave(&dma->rx_lock, flags);
+	dma->rx_tail = 0;
+	dma->rx_start = jiffies;
+	dma->rx_dma_used = true;
+	/* rx_buf is coherent, no cache maintenance needed */
+	omap_start_dma(dma->rx_dma_channel);
+	mod_timer(&dma->rx_timer, jiffies + dma->rx_timeout);
+	spin_unlock_irqrestore(&dma->rx_lock, flags);
+
+	return 0;
+}
+
+static void serial_omap_tx_dma_setup(struct uart_omap_port *up, int lch,
+				     dma_addr_t start, int size)
+{
+	omap_set_dma_dest_params(lch, 0, OMAP_DMA_AMODE_CONSTANT,
 				up->uart_dma.uart_base, 0, 0);
-		omap_set_dma_dest_params(up->uart_dma.rx_dma_channel, 0,
-				OMAP_DMA_AMODE_POST_INC,
-				up->uart_dma.rx_buf_dma_phys, 0, 0);
-		omap_set_dma_transfer_params(up->uart_dma.rx_dma_channel,
-				OMAP_DMA_DATA_TYPE_S8,
-				up->uart_dma.rx_buf_size, 1,
+	omap_set_dma_src_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+				start, 0, 0);
+	omap_set_dma_transfer_params(lch, OMAP_DMA_DATA_TYPE_S8, size, 1,
 				OMAP_DMA_SYNC_ELEMENT,
-				up->uart_dma.uart_dma_rx, 0);
-	}
-	up->uart_dma.prev_rx_dma_pos = up->uart_dma.rx_buf_dma_phys;
-	/* FIXME: Cache maintenance needed here? */
-	omap_start_dma(up->uart_dma.rx_dma_channel);
-	mod_timer(&up->uart_dma.rx_timer, jiffies +
-				usecs_to_jiffies(up->uart_dma.rx_poll_rate));
-	up->uart_dma.rx_dma_used = true;
-	return ret;
+				up->uart_dma.uart_dma_tx, 0);
 }
 
-static void serial_omap_continue_tx(struct uart_omap_port *up)
+/*
+ * Send all that is pending in the xmit circular buffer.  When it wraps
+ * around, the part at the start of the buffer is given to a second
+ * channel linked behind the first one, so that both parts go out back
+ * to back and only the second one interrupts.
+ */
+static void serial_omap_tx_dma(struct uart_omap_port *up)
 {
+	struct uart_omap_dma *dma = &up->uart_dma;
 	struct circ_buf *xmit = &up->port.state->xmit;
-	unsigned int start = up->uart_dma.tx_buf_dma_phys
-			+ (xmit->tail & (UART_XMIT_SIZE - 1));
+	unsigned int tail = xmit->tail & (UART_XMIT_SIZE - 1);
+	int pending = uart_circ_chars_pending(xmit);
+	int first = min_t(int, pending, UART_XMIT_SIZE - tail);
 
-	if (uart_circ_empty(xmit))
+	if (!pending)
 		return;
 
-	up->uart_dma.tx_buf_size = uart_circ_chars_pending(xmit);
-	/*
-	 * It is a circular buffer. See if the buffer has wounded back.
-	 * If yes it will have to be transferred in two separate dma
-	 * transfers
-	 */
-	if (start + up->uart_dma.tx_buf_size >=
-			up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE)
-		up->uart_dma.tx_buf_size =
-			(up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE) - start;
-	omap_set_dma_dest_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_CONSTANT,
-				up->uart_dma.uart_base, 0, 0);
-	omap_set_dma_src_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_POST_INC, start, 0, 0);
-	omap_set_dma_transfer_params(up->uart_dma.tx_dma_channel,
-				OMAP_DMA_DATA_TYPE_S8,
-				up->uart_dma.tx_buf_size, 1,
-				OMAP_DMA_SYNC_ELEMENT,
-				up->uart_dma.uart_dma_tx, 0);
-	/* FIXME: Cache maintenance needed here? */
-	omap_start_dma(up->uart_dma.tx_dma_channel);
+	serial_omap_tx_dma_setup(up, dma->tx_dma_channel,
+				 dma->tx_buf_dma_phys + tail, first);
+	dma->tx_buf_size = first;
+
+	if (first < pending && dma->tx_dma_channel2 != OMAP_UART_DMA_CH_FREE) {
+		serial_omap_tx_dma_setup(up, dma->tx_dma_channel2,
+					 dma->tx_buf_dma_phys, pending - first);
+		omap_disable_dma_irq(dma->tx_dma_channel, OMAP_DMA_BLOCK_IRQ);
+		omap_dma_link_lch(dma->tx_dma_channel, dma->tx_dma_channel2);
+		dma->tx_chained = true;
+		dma->tx_buf_size = pending;
+		dma->stats.tx_chained++;
+	}
+
+	/* the xmit buffer is coherent, no cache maintenance needed */
+	omap_start_dma(dma->tx_dma_channel);
 }
 
 static void uart_tx_dma_callback(int lch, u16 ch_status, void *data)
 {
 	struct uart_omap_port *up = (struct uart_omap_port *)data;
+	struct uart_omap_dma *dma = &up->uart_dma;
 	struct circ_buf *xmit = &up->port.state->xmit;
+	unsigned long flags;
+	ktime_t start;
 
-	xmit->tail = (xmit->tail + up->uart_dma.tx_buf_size) & \
-			(UART_XMIT_SIZE - 1);
-	up->port.icount.tx += up->uart_dma.tx_buf_size;
+	/* a chained transfer is done when its second channel is */
+	if (dma->tx_chained && lch != dma->tx_dma_channel2)
+		return;
+
+	start = ktime_get();
+	spin_lock_irqsave(&up->port.lock, flags);
 
-	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
+	omap_stop_dma(dma->tx_dma_channel);
+	if (dma->tx_chained) {
+		omap_dma_unlink_lch(dma->tx_dma_channel, dma->tx_dma_channel2);
+		omap_enable_dma_irq(dma->tx_dma_channel, OMAP_DMA_BLOCK_IRQ);
+		dma->tx_chained = false;
+	}
+
+	xmit->tail = (xmit->tail + dma->tx_buf_size) & (UART_XMIT_SIZE - 1);
+	up->port.icount.tx += dma->tx_buf_size;
+	dma->stats.tx_bytes += dma->tx_buf_size;
+	dma->stats.tx_irqs++;
+
+	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS) {
+		spin_unlock(&up->port.lock);
 		uart_write_wakeup(&up->port);
+		spin_lock(&up->port.lock);
+	}
 
 	if (uart_circ_empty(xmit)) {
-		spin_lock(&(up->uart_dma.tx_lock));
+		spin_lock(&dma->tx_lock);
 		serial_omap_stop_tx(&up->port);
-		up->uart_dma.tx_dma_used = false;
-		spin_unlock(&(up->uart_dma.tx_lock));
+		dma->tx_dma_used = false;
+		spin_unlock(&dma->tx_lock);
 	} else {
-		omap_stop_dma(up->uart_dma.tx_dma_channel);
-		serial_omap_continue_tx(up);
+		serial_omap_tx_dma(up);
 	}
+	dma->stats.cpu_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_unlock_irqrestore(&up->port.lock, flags);
 	up->port_activity = jiffies;
-	return;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *serial_omap_debugfs;
+
+static int serial_omap_dma_stats_show(struct seq_file *s, void *unused)
+{
+	struct uart_omap_port *up = s->private;
+	struct uart_omap_dma_stats *st = &up->uart_dma.stats;
+	unsigned long active = st->rx_active;
+	u64 bytes = st->rx_bytes + st->tx_bytes;
+	unsigned int active_ms;
+
+	if (up->uart_dma.rx_dma_used)
+		active += jiffies - up->uart_dma.rx_start;
+	active_ms = jiffies_to_msecs(active);
+
+	seq_printf(s, "rx_bytes %llu\n"
+		   "tx_bytes %llu\n"
+		   "rx_irqs %lu\n"
+		   "rx_flushes %lu\n"
+		   "tx_irqs %lu\n"
+		   "tx_chained %lu\n"
+		   "rx_active_ms %u\n"
+		   "rx_kbps %llu\n"
+		   "cpu_us %llu\n"
+		   "cpu_ns_per_kb %llu\n",
+		   st->rx_bytes, st->tx_bytes, st->rx_irqs, st->rx_flushes,
+		   st->tx_irqs, st->tx_chained, active_ms,
+		   active_ms ? div_u64(st->rx_bytes * 8, active_ms) : 0,
+		   div_u64(st->cpu_ns, NSEC_PER_USEC),
+		   bytes ? div64_u64(st->cpu_ns * 1024, bytes) : 0);
+
+	return 0;
+}
+
+static int serial_omap_dma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, serial_omap_dma_stats_show, inode->i_private);
+}
+
+static const struct file_operations serial_omap_dma_stats_fops = {
+	.open = serial_omap_dma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void serial_omap_debugfs_add(struct uart_omap_port *up)
+{
+	char name[8];
+
+	if (!serial_omap_debugfs)
+		serial_omap_debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+	if (IS_ERR_OR_NULL(serial_omap_debugfs))
+		return;
+
+	snprintf(name, sizeof(name), OMAP_SERIAL_NAME "%d", up->port.line);
+	debugfs_create_file(name, 0444, serial_omap_debugfs, up,
+			    &serial_omap_dma_stats_fops);
+}
+#else
+static inline void serial_omap_debugfs_add(struct uart_omap_port *up)
+{
+}
+#endif
+
 static void __devinit omap_serial_fill_features_erratas(struct uart_omap_port *up)
 {
 	u32 mvr, scheme;
@@ -1600,13 +1753,15 @@ static int __devinit serial_omap_probe(struct platform_device *pdev)
 		up->uart_dma.uart_dma_tx = dma_tx->start;
 		up->uart_dma.uart_dma_rx = dma_rx->start;
 		up->use_dma = 1;
-		up->uart_dma.rx_buf_size = omap_up_info->dma_rx_buf_size;
+		up->uart_dma.rx_buf_size = rounddown(omap_up_info->dma_rx_buf_size,
+						OMAP_UART_RX_DMA_PERIODS);
 		up->uart_dma.rx_timeout = omap_up_info->dma_rx_timeout;
-		up->uart_dma.rx_poll_rate = omap_up_info->dma_rx_poll_rate;
 		spin_lock_init(&(up->uart_dma.tx_lock));
 		spin_lock_init(&(up->uart_dma.rx_lock));
 		up->uart_dma.tx_dma_channel = OMAP_UART_DMA_CH_FREE;
+		up->uart_dma.tx_dma_channel2 = OMAP_UART_DMA_CH_FREE;
 		up->uart_dma.rx_dma_channel = OMAP_UART_DMA_CH_FREE;
+		serial_omap_debugfs_add(up);
 	}
 
 	up->latency = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE;
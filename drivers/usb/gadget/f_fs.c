@@ -21,6 +21,10 @@
 #include <linux/blkdev.h>
 #include <linux/pagemap.h>
 #include <linux/export.h>
+#include <linux/aio.h>
+#include <linux/mmu_context.h>
+#include <linux/scatterlist.h>
+#include <linux/workqueue.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -745,10 +749,102 @@ static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 	}
 }
 
-static ssize_t ffs_epfile_io(struct file *file,
-			     char __user *buf, size_t len, int read)
+/*
+ * Transfers of at least FFS_ZERO_COPY_MIN bytes go straight between the
+ * user's pages and the controller, through a scatterlist, when the
+ * controller takes those.  The buffer has to start on a packet boundary
+ * so that DMA engines moving whole packets per segment can use it.
+ */
+#define FFS_ZERO_COPY_MIN	(16 * 1024)
+
+struct ffs_user_buf {
+	struct sg_table		sgt;
+	struct page		**pages;
+	int			nr_pages;
+};
+
+static bool ffs_epfile_zero_copy(struct ffs_epfile *epfile, struct usb_ep *ep,
+				 const char __user *buf, size_t len)
+{
+	struct usb_gadget *gadget = epfile->ffs->gadget;
+
+	return len >= FFS_ZERO_COPY_MIN && gadget && gadget->sg_supported &&
+		!epfile->isoc && !((unsigned long)buf % ep->maxpacket);
+}
+
+static int ffs_user_buf_pin(struct ffs_user_buf *ub, char __user *buf,
+			    size_t len, int read)
+{
+	unsigned long addr = (unsigned long)buf;
+	unsigned offset = addr & ~PAGE_MASK;
+	struct scatterlist *sg;
+	int i, ret;
+
+	ub->nr_pages = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+	ub->pages = kmalloc(ub->nr_pages * sizeof *ub->pages, GFP_KERNEL);
+	if (unlikely(!ub->pages))
+		return -ENOMEM;
+
+	/* reading from the host writes to the pages */
+	ret = get_user_pages_fast(addr, ub->nr_pages, read, ub->pages);
+	if (unlikely(ret < ub->nr_pages)) {
+		ub->nr_pages = max(ret, 0);
+		ret = -EFAULT;
+		goto error;
+	}
+
+	ret = sg_alloc_table(&ub->sgt, ub->nr_pages, GFP_KERNEL);
+	if (unlikely(ret))
+		goto error;
+
+	for_each_sg(ub->sgt.sgl, sg, ub->nr_pages, i) {
+		unsigned n = min_t(size_t, PAGE_SIZE - offset, len);
+
+		sg_set_page(sg, ub->pages[i], n, offset);
+		len -= n;
+		offset = 0;
+	}
+	return 0;
+
+error:
+	while (ub->nr_pages--)
+		put_page(ub->pages[ub->nr_pages]);
+	kfree(ub->pages);
+	return ret;
+}
+
+/* Needs process context if dirty is set. */
+static void ffs_user_buf_release(struct ffs_user_buf *ub, bool dirty)
+{
+	int i;
+
+	sg_free_table(&ub->sgt);
+	for (i = 0; i < ub->nr_pages; ++i) {
+		if (dirty)
+			set_page_dirty_lock(ub->pages[i]);
+		put_page(ub->pages[i]);
+	}
+	kfree(ub->pages);
+}
+
+static void ffs_user_buf_to_req(struct ffs_user_buf *ub,
+				struct usb_request *req)
+{
+	req->buf     = NULL;
+	req->sg      = ub->sgt.sgl;
+	req->num_sgs = ub->nr_pages;
+}
+
+/*
+ * Returns -EOPNOTSUPP if the controller turned the scatterlist down, the
+ * caller then goes again with zero_copy unset.
+ */
+static ssize_t __ffs_epfile_io(struct file *file, char __user *buf,
+			       size_t len, int read, bool zero_copy)
 {
 	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_user_buf ub;
+	bool pinned = false;
 	struct ffs_ep *ep;
 	char *data = NULL;
 	ssize_t ret;
@@ -788,8 +884,13 @@ first_try:
 			goto error;
 		}
 
-		/* Allocate & copy */
-		if (!halt && !data) {
+		/* Pin, or allocate & copy */
+		if (!halt && !data && !pinned && zero_copy &&
+		    ffs_epfile_zero_copy(epfile, ep->ep, buf, len) &&
+		    !ffs_user_buf_pin(&ub, buf, len, read))
+			pinned = true;
+
+		if (!halt && !data && !pinned) {
 			data = kzalloc(len, GFP_KERNEL);
 			if (unlikely(!data))
 				return -ENOMEM;
@@ -832,21 +933,28 @@ first_try:
 		struct usb_request *req = ep->req;
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
-		req->buf      = data;
 		req->length   = len;
+		if (pinned) {
+			ffs_user_buf_to_req(&ub, req);
+		} else {
+			req->buf     = data;
+			req->sg      = NULL;
+			req->num_sgs = 0;
+		}
 
 		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
 
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
 		if (unlikely(ret < 0)) {
-			/* nop */
+			if (pinned && ret == -EINVAL)
+				ret = -EOPNOTSUPP;
 		} else if (unlikely(wait_for_completion_interruptible(&done))) {
 			ret = -EINTR;
 			usb_ep_dequeue(ep->ep, req);
 		} else {
 			ret = ep->status;
-			if (read && ret > 0 &&
+			if (read && ret > 0 && !pinned &&
 			    unlikely(copy_to_user(buf, data, ret)))
 				ret = -EFAULT;
 		}
@@ -854,10 +962,23 @@ first_try:
 
 	mutex_unlock(&epfile->mutex);
 error:
+	if (pinned)
+		ffs_user_buf_release(&ub, read && ret > 0);
 	kfree(data);
 	return ret;
 }
 
+static ssize_t ffs_epfile_io(struct file *file,
+			     char __user *buf, size_t len, int read)
+{
+	ssize_t ret;
+
+	ret = __ffs_epfile_io(file, buf, len, read, true);
+	if (unlikely(ret == -EOPNOTSUPP))
+		ret = __ffs_epfile_io(file, buf, len, read, false);
+	return ret;
+}
+
 static ssize_t
 ffs_epfile_write(struct file *file, const char __user *buf, size_t len,
 		 loff_t *ptr)
@@ -875,6 +996,240 @@ ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
 	return ffs_epfile_io(file, buf, len, 1);
 }
 
+/*
+ * Asynchronous I/O: each iocb gets a request of its own, so user space
+ * can keep as many transfers queued on an endpoint as it likes.  Reads
+ * finish from a work item, which copies out or dirties the user pages.
+ */
+struct ffs_aio {
+	struct kiocb		*iocb;
+	struct usb_ep		*ep;
+	struct usb_request	*req;
+	atomic_t		refs;
+	bool			queued;		/* P: ffs_aio_lock */
+
+	bool			read;
+	bool			pinned;
+	bool			dirty;
+	struct ffs_user_buf	ub;
+	char			*data;
+	char __user		*buf;
+	struct mm_struct	*mm;
+
+	unsigned		actual;
+	int			status;
+	struct work_struct	work;
+};
+
+/* Not eps_lock, requests complete with it held when endpoints go down. */
+static DEFINE_SPINLOCK(ffs_aio_lock);
+
+static void ffs_aio_put(struct ffs_aio *aio)
+{
+	if (!atomic_dec_and_test(&aio->refs))
+		return;
+
+	if (aio->pinned)
+		ffs_user_buf_release(&aio->ub, aio->dirty);
+	kfree(aio->data);
+	usb_ep_free_request(aio->ep, aio->req);
+	kfree(aio);
+}
+
+static void ffs_aio_done(struct ffs_aio *aio, long res)
+{
+	struct kiocb *iocb = aio->iocb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ffs_aio_lock, flags);
+	iocb->private = NULL;
+	spin_unlock_irqrestore(&ffs_aio_lock, flags);
+
+	aio_complete(iocb, res, aio->status);
+	ffs_aio_put(aio);
+}
+
+static void ffs_aio_read_work(struct work_struct *work)
+{
+	struct ffs_aio *aio = container_of(work, struct ffs_aio, work);
+	long res = aio->actual;
+
+	if (aio->pinned) {
+		aio->dirty = true;
+	} else {
+		use_mm(aio->mm);
+		if (unlikely(copy_to_user(aio->buf, aio->data, aio->actual)))
+			res = -EFAULT;
+		unuse_mm(aio->mm);
+	}
+
+	ffs_aio_done(aio, res);
+}
+
+static void ffs_aio_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct ffs_aio *aio = req->context;
+
+	ENTER();
+
+	spin_lock(&ffs_aio_lock);
+	aio->queued = false;
+	spin_unlock(&ffs_aio_lock);
+
+	aio->actual = req->actual;
+	aio->status = req->status;
+
+	if (aio->read && req->actual)
+		schedule_work(&aio->work);
+	else
+		ffs_aio_done(aio, req->actual ? req->actual : req->status);
+}
+
+static int ffs_aio_cancel(struct kiocb *iocb, struct io_event *e)
+{
+	struct ffs_aio *aio;
+	int ret = -EINVAL;
+
+	ENTER();
+
+	spin_lock_irq(&ffs_aio_lock);
+	kiocbSetCancelled(iocb);
+	aio = iocb->private;
+	if (aio && aio->queued)
+		atomic_inc(&aio->refs);
+	else
+		aio = NULL;
+	spin_unlock_irq(&ffs_aio_lock);
+
+	if (aio) {
+		ret = usb_ep_dequeue(aio->ep, aio->req);
+		ffs_aio_put(aio);
+	}
+
+	aio_put_req(iocb);
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_rw(struct kiocb *iocb, const struct iovec *iov,
+				 unsigned long nr_segs, int read)
+{
+	struct ffs_epfile *epfile = iocb->ki_filp->private_data;
+	char __user *buf = iov->iov_base;
+	size_t len = iov->iov_len;
+	struct usb_request *req;
+	struct ffs_aio *aio;
+	struct usb_ep *ep;
+	ssize_t ret;
+
+	ENTER();
+
+	/* one request per iocb, so one buffer */
+	if (nr_segs != 1)
+		return -EINVAL;
+
+	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
+		return -ENODEV;
+
+	/* no halting through AIO */
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	if (!epfile->ep)
+		ret = -ENODEV;
+	else if (!read != !epfile->in)
+		ret = -EINVAL;
+	else
+		ret = 0;
+	ep = epfile->ep ? epfile->ep->ep : NULL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+	if (unlikely(ret))
+		return ret;
+
+	aio = kzalloc(sizeof *aio, GFP_KERNEL);
+	if (unlikely(!aio))
+		return -ENOMEM;
+	aio->req = usb_ep_alloc_request(ep, GFP_KERNEL);
+	if (unlikely(!aio->req)) {
+		kfree(aio);
+		return -ENOMEM;
+	}
+
+	atomic_set(&aio->refs, 1);
+	aio->iocb = iocb;
+	aio->ep   = ep;
+	aio->read = read;
+	aio->buf  = buf;
+	aio->mm   = current->mm;
+	INIT_WORK(&aio->work, ffs_aio_read_work);
+
+	req = aio->req;
+	req->length   = len;
+	req->context  = aio;
+	req->complete = ffs_aio_complete;
+
+	if (ffs_epfile_zero_copy(epfile, ep, buf, len) &&
+	    !ffs_user_buf_pin(&aio->ub, buf, len, read)) {
+		aio->pinned = true;
+		ffs_user_buf_to_req(&aio->ub, req);
+	}
+
+	iocb->private = aio;
+	iocb->ki_cancel = ffs_aio_cancel;
+
+	do {
+		if (!aio->pinned) {
+			aio->data = kmalloc(len, GFP_KERNEL);
+			if (unlikely(!aio->data)) {
+				ret = -ENOMEM;
+				break;
+			}
+			if (!read &&
+			    unlikely(copy_from_user(aio->data, buf, len))) {
+				ret = -EFAULT;
+				break;
+			}
+			req->buf = aio->data;
+		}
+
+		aio->queued = true;
+		spin_lock_irq(&epfile->ffs->eps_lock);
+		if (likely(epfile->ep && epfile->ep->ep == ep))
+			ret = usb_ep_queue(ep, req, GFP_ATOMIC);
+		else
+			ret = -ENODEV;
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		if (likely(!ret))
+			return -EIOCBQUEUED;
+		aio->queued = false;
+
+		/* the controller turned the scatterlist down, copy */
+		if (!aio->pinned || ret != -EINVAL)
+			break;
+		ffs_user_buf_release(&aio->ub, false);
+		aio->pinned = false;
+		req->sg = NULL;
+		req->num_sgs = 0;
+	} while (1);
+
+	spin_lock_irq(&ffs_aio_lock);
+	iocb->private = NULL;
+	spin_unlock_irq(&ffs_aio_lock);
+	ffs_aio_put(aio);
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_write(struct kiocb *iocb,
+				    const struct iovec *iov,
+				    unsigned long nr_segs, loff_t pos)
+{
+	return ffs_epfile_aio_rw(iocb, iov, nr_segs, 0);
+}
+
+static ssize_t ffs_epfile_aio_read(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return ffs_epfile_aio_rw(iocb, iov, nr_segs, 1);
+}
+
 static int
 ffs_epfile_open(struct inode *inode, struct file *file)
 {
@@ -948,6 +1303,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
@@ -282,7 +282,9 @@
 #include <linux/fs.h>
 #include <linux/kref.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/limits.h>
+#include <linux/pagemap.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -736,6 +738,34 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Start reading the whole range of a READ command in the background, so
+ * the medium works on it while the buffers already filled are sent.  If
+ * the first page is cached, the page cache's own readahead is ahead of us.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t offset,
+			      u32 amount)
+{
+	struct file		*filp = curlun->filp;
+	struct address_space	*mapping = filp->f_mapping;
+	pgoff_t			index = offset >> PAGE_CACHE_SHIFT;
+	pgoff_t			last;
+	struct page		*page;
+
+	if (offset >= curlun->file_length)
+		return;
+	last = (min(offset + amount, curlun->file_length) - 1) >>
+		PAGE_CACHE_SHIFT;
+
+	page = find_get_page(mapping, index);
+	if (page) {
+		page_cache_release(page);
+		return;
+	}
+	page_cache_sync_readahead(mapping, &filp->f_ra, filp, index,
+				  last - index + 1);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -746,6 +776,7 @@ static int do_read(struct fsg_common *common)
 	loff_t			file_offset, file_offset_tmp;
 	unsigned int		amount;
 	ssize_t			nread;
+	ktime_t			start;
 
 	/*
 	 * Get the starting Logical Block Address and check that it's
@@ -777,6 +808,9 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	curlun->read_cmds++;
+	fsg_lun_readahead(curlun, file_offset, amount_left);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -790,11 +824,14 @@ static int do_read(struct fsg_common *common)
 
 		/* Wait for the next buffer to become available */
 		bh = common->next_buffhd_to_fill;
+		start = ktime_get();
 		while (bh->state != BUF_STATE_EMPTY) {
 			rc = sleep_thread(common);
 			if (rc)
 				return rc;
 		}
+		curlun->read_wait_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							      start));
 
 		/*
 		 * If we were asked to read past the end of file,
@@ -813,9 +850,12 @@ static int do_read(struct fsg_common *common)
 
 		/* Perform the read */
 		file_offset_tmp = file_offset;
+		start = ktime_get();
 		nread = vfs_read(curlun->filp,
 				 (char __user *)bh->buf,
 				 amount, &file_offset_tmp);
+		curlun->read_file_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							      start));
 		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
 		      (unsigned long long)file_offset, (int)nread);
 		if (signal_pending(current))
@@ -832,6 +872,7 @@ static int do_read(struct fsg_common *common)
 		file_offset  += nread;
 		amount_left  -= nread;
 		common->residue -= nread;
+		curlun->read_bytes += nread;
 
 		/*
 		 * Except at the end of the transfer, nread will be
@@ -878,6 +919,7 @@ static int do_write(struct fsg_common *common)
 	unsigned int		amount;
 	ssize_t			nwritten;
 	int			rc;
+	ktime_t			start;
 
 	if (curlun->ro) {
 		curlun->sense_data = SS_WRITE_PROTECTED;
@@ -922,6 +964,7 @@ static int do_write(struct fsg_common *common)
 	file_offset = usb_offset = ((loff_t) lba) << curlun->blkbits;
 	amount_left_to_req = common->data_size_from_cmnd;
 	amount_left_to_write = common->data_size_from_cmnd;
+	curlun->write_cmds++;
 
 	while (amount_left_to_write > 0) {
 
@@ -1006,9 +1049,12 @@ static int do_write(struct fsg_common *common)
 
 			/* Perform the write */
 			file_offset_tmp = file_offset;
+			start = ktime_get();
 			nwritten = vfs_write(curlun->filp,
 					     (char __user *)bh->buf,
 					     amount, &file_offset_tmp);
+			curlun->write_file_ns += ktime_to_ns(
+					ktime_sub(ktime_get(), start));
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 			      (unsigned long long)file_offset, (int)nwritten);
 			if (signal_pending(current))
@@ -1026,6 +1072,7 @@ static int do_write(struct fsg_common *common)
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
+			curlun->write_bytes += nwritten;
 
 			/* If an error occurred, report it and its position */
 			if (nwritten < amount) {
@@ -1046,7 +1093,10 @@ static int do_write(struct fsg_common *common)
 		}
 
 		/* Wait for something to happen */
+		start = ktime_get();
 		rc = sleep_thread(common);
+		curlun->write_wait_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							       start));
 		if (rc)
 			return rc;
 	}
@@ -2687,10 +2737,35 @@ static int fsg_main_thread(void *common_)
 
 /*************************** DEVICE ATTRIBUTES ***************************/
 
+static ssize_t fsg_show_stats(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+
+	return sprintf(buf,
+		       "buffers %u x %u\n"
+		       "read_cmds %lu\n"
+		       "read_bytes %llu\n"
+		       "read_file_ms %llu\n"
+		       "read_wait_ms %llu\n"
+		       "write_cmds %lu\n"
+		       "write_bytes %llu\n"
+		       "write_file_ms %llu\n"
+		       "write_wait_ms %llu\n",
+		       fsg_num_buffers, FSG_BUFLEN,
+		       curlun->read_cmds, curlun->read_bytes,
+		       div_u64(curlun->read_file_ns, NSEC_PER_MSEC),
+		       div_u64(curlun->read_wait_ns, NSEC_PER_MSEC),
+		       curlun->write_cmds, curlun->write_bytes,
+		       div_u64(curlun->write_file_ns, NSEC_PER_MSEC),
+		       div_u64(curlun->write_wait_ns, NSEC_PER_MSEC));
+}
+
 /* Write permission is checked per LUN in store_*() functions. */
 static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
 static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
+static DEVICE_ATTR(stats, 0444, fsg_show_stats, NULL);
 
 
 /****************************** FSG COMMON ******************************/
@@ -2813,6 +2888,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		if (rc)
 			goto error_luns;
 		rc = device_create_file(&curlun->dev, &dev_attr_nofua);
+		if (rc)
+			goto error_luns;
+		rc = device_create_file(&curlun->dev, &dev_attr_stats);
 		if (rc)
 			goto error_luns;
 
@@ -2944,6 +3022,7 @@ static void fsg_common_release(struct kref *ref)
 
 		/* In error recovery common->nluns may be zero. */
 		for (; i; --i, ++lun) {
+			device_remove_file(&lun->dev, &dev_attr_stats);
 			device_remove_file(&lun->dev, &dev_attr_nofua);
 			device_remove_file(&lun->dev, &dev_attr_ro);
 			device_remove_file(&lun->dev, &dev_attr_file);
@@ -30,13 +30,21 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
 #include <linux/usb/ch9.h>
 #include <linux/usb/f_mtp.h>
 
+/* smallest bulk buffer, we fall back to it when memory is short */
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_BULK_BUFFER_MAX        (1024 * 1024)
+#define MTP_TX_BUFFER_INIT_SIZE    131072
+#define MTP_RX_BUFFER_INIT_SIZE    131072
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -50,10 +58,24 @@
 #define STATE_ERROR                 4   /* error from completion routine */
 
 /* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
+#define TX_REQ_INIT 8
+#define TX_REQ_MAX 32
 #define RX_REQ_MAX 2
 #define INTR_REQ_MAX 5
 
+/* taken into account when the function is bound */
+static unsigned int mtp_tx_req_len = MTP_TX_BUFFER_INIT_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "MTP bulk in request size in bytes");
+
+static unsigned int mtp_rx_req_len = MTP_RX_BUFFER_INIT_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "MTP bulk out request size in bytes");
+
+static unsigned int mtp_tx_reqs = TX_REQ_INIT;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of MTP bulk in requests");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -69,6 +91,16 @@
 
 static const char mtp_shortname[] = "mtp_usb";
 
+/* figures of the last file transfer in one direction */
+struct mtp_xfer_stats {
+	int64_t bytes;
+	s64 usecs;
+	/* time spent in vfs_read or vfs_write */
+	s64 vfs_usecs;
+	int result;
+	unsigned count;
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -95,6 +127,11 @@ struct mtp_dev {
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
 
+	/* bulk request sizes and count actually allocated */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned tx_reqs;
+
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
 	 */
@@ -110,6 +147,10 @@ struct mtp_dev {
 	int xfer_result;
 
 	int zlp_maxpacket;
+
+	struct mtp_xfer_stats send_stats;
+	struct mtp_xfer_stats receive_stats;
+	struct dentry *debugfs_root;
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -440,6 +481,16 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
+/*
+ * Out requests get rounded up to the max packet size, keep the buffers a
+ * multiple of it.
+ */
+static unsigned mtp_bulk_req_len(unsigned len)
+{
+	len = clamp_t(unsigned, len, MTP_BULK_BUFFER_SIZE, MTP_BULK_BUFFER_MAX);
+	return rounddown(len, MTP_BULK_BUFFER_SIZE);
+}
+
 static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc,
@@ -488,21 +539,46 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	ep->driver_data = dev;		/* claim the endpoint */
 	dev->ep_intr = ep;
 
-	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	/*
+	 * Now allocate requests for our endpoints. The large buffers might
+	 * not be available, halve them until they are.
+	 */
+	dev->tx_reqs = clamp_t(unsigned, mtp_tx_reqs, 2, TX_REQ_MAX);
+	dev->tx_req_len = mtp_bulk_req_len(mtp_tx_req_len);
+retry_tx:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			dev->tx_req_len /= 2;
+			goto retry_tx;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
+
+	dev->rx_req_len = mtp_bulk_req_len(mtp_rx_req_len);
+retry_rx:
 	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			while (--i >= 0) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			dev->rx_req_len /= 2;
+			goto retry_rx;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
+	DBG(cdev, "%u tx requests of %u bytes, rx requests of %u bytes\n",
+	    dev->tx_reqs, dev->tx_req_len, dev->rx_req_len);
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -530,7 +606,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -656,8 +732,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -694,6 +770,17 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static void mtp_xfer_stats_update(struct mtp_xfer_stats *stats,
+				  int64_t bytes, ktime_t start,
+				  s64 vfs_usecs, int result)
+{
+	stats->bytes = bytes;
+	stats->usecs = ktime_us_delta(ktime_get(), start);
+	stats->vfs_usecs = vfs_usecs;
+	stats->result = result;
+	stats->count++;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -708,6 +795,10 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	unsigned long ra_pages;
+	int64_t sent = 0;
+	ktime_t start, vfs_start;
+	s64 vfs_usecs = 0;
 
 	/* read our parameters */
 	smp_rmb();
@@ -717,6 +808,16 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	/*
+	 * Have the page cache read ahead of what is queued, so the reads
+	 * below overlap with the transfers in flight. This is what
+	 * POSIX_FADV_SEQUENTIAL does, with a window sized to our requests.
+	 */
+	ra_pages = (dev->tx_req_len >> PAGE_CACHE_SHIFT) * 2;
+	if (filp->f_ra.ra_pages < ra_pages)
+		filp->f_ra.ra_pages = ra_pages;
+	start = ktime_get();
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -749,8 +850,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -764,8 +865,10 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 
+		vfs_start = ktime_get();
 		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
 								&offset);
+		vfs_usecs += ktime_us_delta(ktime_get(), vfs_start);
 		if (ret < 0) {
 			r = ret;
 			break;
@@ -783,6 +886,7 @@ static void send_file_work(struct work_struct *data)
 		}
 
 		count -= xfer;
+		sent += xfer;
 
 		/* zero this so we don't try to free it on error exit */
 		req = 0;
@@ -791,6 +895,7 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+	mtp_xfer_stats_update(&dev->send_stats, sent, start, vfs_usecs, r);
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -810,6 +915,9 @@ static void receive_file_work(struct work_struct *data)
 	int ret, cur_buf = 0;
 	int r = 0;
 	unsigned int rem = 0;
+	int64_t received = 0;
+	ktime_t start, vfs_start;
+	s64 vfs_usecs = 0;
 
 	/* read our parameters */
 	smp_rmb();
@@ -818,6 +926,7 @@ static void receive_file_work(struct work_struct *data)
 	count = dev->xfer_file_length;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
+	start = ktime_get();
 
 	while (count > 0 || write_req) {
 		if (count > 0) {
@@ -825,8 +934,8 @@ static void receive_file_work(struct work_struct *data)
 			read_req = dev->rx_req[cur_buf];
 			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
+			read_req->length = (count > dev->rx_req_len
+					? dev->rx_req_len : count);
 
 			/* Pass maxpacket length for RX(out) case:
 			   buffer size is large enough to accomodate */
@@ -846,14 +955,17 @@ static void receive_file_work(struct work_struct *data)
 
 		if (write_req) {
 			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
+			vfs_start = ktime_get();
 			ret = vfs_write(filp, write_req->buf, write_req->actual,
 				&offset);
+			vfs_usecs += ktime_us_delta(ktime_get(), vfs_start);
 			DBG(cdev, "vfs_write %d\n", ret);
 			if (ret != write_req->actual) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
 				break;
 			}
+			received += ret;
 			write_req = NULL;
 		}
 
@@ -886,6 +998,8 @@ static void receive_file_work(struct work_struct *data)
 		}
 	}
 
+	mtp_xfer_stats_update(&dev->receive_stats, received, start,
+			      vfs_usecs, r);
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1341,6 +1455,67 @@ static int mtp_bind_config(struct usb_configuration *c, bool ptp_config)
 	return usb_add_function(c, &dev->function);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static void mtp_stats_show_one(struct seq_file *s, const char *name,
+			       struct mtp_xfer_stats *stats)
+{
+	u64 kbps = 0;
+
+	if (stats->usecs > 0)
+		kbps = div64_u64((u64)stats->bytes * USEC_PER_SEC,
+				 stats->usecs * 1024);
+
+	seq_printf(s, "%s: %u transfers, last %lld bytes in %lld us "
+		   "(%llu KB/s), vfs %lld us, result %d\n",
+		   name, stats->count, stats->bytes, stats->usecs, kbps,
+		   stats->vfs_usecs, stats->result);
+}
+
+static int mtp_stats_show(struct seq_file *s, void *unused)
+{
+	struct mtp_dev *dev = s->private;
+
+	seq_printf(s, "tx: %u requests of %u bytes\n", dev->tx_reqs,
+		   dev->tx_req_len);
+	seq_printf(s, "rx: %u requests of %u bytes\n", RX_REQ_MAX,
+		   dev->rx_req_len);
+	mtp_stats_show_one(s, "send", &dev->send_stats);
+	mtp_stats_show_one(s, "receive", &dev->receive_stats);
+	return 0;
+}
+
+static int mtp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtp_stats_show, inode->i_private);
+}
+
+static const struct file_operations mtp_stats_fops = {
+	.open		= mtp_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mtp_debugfs_init(struct mtp_dev *dev)
+{
+	dev->debugfs_root = debugfs_create_dir("usb_mtp", NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs_root)) {
+		dev->debugfs_root = NULL;
+		return;
+	}
+	debugfs_create_file("stats", S_IRUGO, dev->debugfs_root, dev,
+			    &mtp_stats_fops);
+}
+
+static void mtp_debugfs_remove(struct mtp_dev *dev)
+{
+	debugfs_remove_recursive(dev->debugfs_root);
+}
+#else
+static inline void mtp_debugfs_init(struct mtp_dev *dev) { }
+static inline void mtp_debugfs_remove(struct mtp_dev *dev) { }
+#endif
+
 static int mtp_setup(void)
 {
 	struct mtp_dev *dev;
@@ -1373,6 +1548,7 @@ static int mtp_setup(void)
 	if (ret)
 		goto err2;
 
+	mtp_debugfs_init(dev);
 	return 0;
 
 err2:
@@ -1391,6 +1567,7 @@ static void mtp_cleanup(void)
 	if (!dev)
 		return;
 
+	mtp_debugfs_remove(dev);
 	misc_deregister(&mtp_device);
 	destroy_workqueue(dev->wq);
 	_mtp_dev = NULL;
@@ -85,6 +85,17 @@ static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 	return container_of(f, struct f_rndis, port.func);
 }
 
+/* packets per transfer, 1 turns multi-packet transfers off */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		"most packets the host may send per transfer");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 3;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		"most packets sent to the host per transfer");
+
 /* peak (theoretical) bulk transfer rate in bits-per-second */
 static unsigned int bitrate(struct usb_gadget *g)
 {
@@ -369,14 +380,13 @@ static struct usb_gadget_strings *rndis_strings[] = {
 static struct sk_buff *rndis_add_header(struct gether *port,
 					struct sk_buff *skb)
 {
-	struct sk_buff *skb2;
-
-	skb2 = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type));
-	if (skb2)
-		rndis_add_hdr(skb2);
-
-	dev_kfree_skb_any(skb);
-	return skb2;
+	/* only copies when the stack left too little headroom */
+	if (skb_cow_head(skb, sizeof(struct rndis_packet_msg_type))) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+	rndis_add_hdr(skb);
+	return skb;
 }
 
 static void rndis_response_available(void *_rndis)
@@ -456,6 +466,9 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	if (status < 0)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
+	/* REMOTE_NDIS_INITIALIZE_MSG carries the host's transfer limit */
+	gether_update_dl_max_xfer_size(&rndis->port,
+			rndis_get_dl_max_xfer_size(rndis->config));
 //	spin_unlock(&dev->lock);
 }
 
@@ -595,6 +608,8 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
 			return PTR_ERR(net);
+		gether_update_dl_max_xfer_size(&rndis->port,
+				rndis_get_dl_max_xfer_size(rndis->config));
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
@@ -768,6 +783,7 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis->config = status;
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
+	rndis_set_max_pkt_xfer(rndis->config, rndis->port.ul_max_pkts_per_xfer);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
 	if (rndis->manufacturer && rndis->vendorID &&
@@ -915,6 +931,10 @@ rndis_bind_config_vendor(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.ul_max_pkts_per_xfer =
+		clamp(rndis_ul_max_pkt_per_xfer, 1U, 255U);
+	rndis->port.dl_max_pkts_per_xfer =
+		clamp(rndis_dl_max_pkt_per_xfer, 1U, 255U);
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
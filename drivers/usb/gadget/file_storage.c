@@ -280,6 +280,8 @@ static const char fsg_string_product[] = DRIVER_DESC;
 static const char fsg_string_config[] = "Self-powered";
 static const char fsg_string_interface[] = "Mass Storage";
 
+/* We have our own buflen module parameter */
+#define FSG_NO_BUFLEN_PARAM	1
 
 #include "storage_common.c"
 
@@ -572,6 +572,9 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	if (!params->dev)
 		return -ENOTSUPP;
 
+	/* the most the host takes in one transfer from us */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	r = rndis_add_response(configNr, sizeof(rndis_init_cmplt_type));
 	if (!r)
 		return -ENOMEM;
@@ -585,12 +588,12 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
@@ -902,6 +905,8 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 			rndis_per_dev_params[i].used = 1;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
+			rndis_per_dev_params[i].max_pkt_per_xfer = 1;
+			rndis_per_dev_params[i].dl_max_xfer_size = 0;
 			pr_debug("%s: configNr = %d\n", __func__, i);
 			return i;
 		}
@@ -955,6 +960,24 @@ int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+/* the most packets the host may send us in one transfer */
+void rndis_set_max_pkt_xfer(u8 configNr, u8 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return;
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer =
+		max_pkt_per_xfer ? max_pkt_per_xfer : 1;
+}
+
+/* the longest transfer the host takes from us, 0 before it initialized */
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -1027,26 +1050,58 @@ int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	/*
+	 * A transfer holds one or more packet messages back to back, each
+	 * but the last is queued as a clone sharing the transfer's buffer.
+	 */
+	int queued = 0;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		struct rndis_packet_msg_type *hdr = (void *)skb->data;
+		struct sk_buff *skb2;
+		u32 msg_len, data_offset, data_len;
+
+		msg_len = get_unaligned_le32(&hdr->MessageLength);
+		data_offset = get_unaligned_le32(&hdr->DataOffset);
+		data_len = get_unaligned_le32(&hdr->DataLength);
+
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(&hdr->MessageType)
+				|| msg_len < sizeof(*hdr)) {
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* DataOffset is counted from the DataOffset field */
+		if (msg_len > skb->len || data_offset > msg_len - 8
+				|| data_len > msg_len - 8 - data_offset) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		if (msg_len == skb->len) {
+			skb_pull(skb, data_offset + 8);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset + 8);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+		queued++;
+
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	/* padding after the last message, or a runt */
+	dev_kfree_skb_any(skb);
+	return queued ? 0 : -EINVAL;
 }
 
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
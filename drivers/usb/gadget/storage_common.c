@@ -39,14 +39,18 @@
 
 /*
  * When FSG_BUFFHD_STATIC_BUFFER is defined when this file is included
- * the fsg_buffhd structure's buf field will be an array of FSG_BUFLEN
- * characters rather then a pointer to void.
+ * the fsg_buffhd structure's buf field will be an array of
+ * CONFIG_USB_GADGET_STORAGE_BUFLEN characters rather then a pointer to
+ * void; the buflen module param must not be raised above that then.
  */
 
 /*
  * When USB_GADGET_DEBUG_FILES is defined the module param num_buffers
- * sets the number of pipeline buffers (length of the fsg_buffhd array).
- * The valid range of num_buffers is: num >= 2 && num <= 4.
+ * sets the number of pipeline buffers (length of the fsg_buffhd array)
+ * and buflen the size of each of them, unless FSG_NO_BUFLEN_PARAM is
+ * defined by a user with a buflen param of its own.
+ * The valid range of num_buffers is: num >= 2 && num <= 32, buflen must
+ * be a multiple of 4096 no larger than 131072.
  */
 
 
@@ -206,6 +210,17 @@ struct fsg_lun {
 
 	unsigned int	blkbits;	/* Bits of logical block size of bound block device */
 	unsigned int	blksize;	/* logical block size of bound block device */
+
+	/* Transfer statistics, updated by the worker thread */
+	unsigned long	read_cmds;
+	unsigned long	write_cmds;
+	u64		read_bytes;
+	u64		write_bytes;
+	u64		read_file_ns;	/* spent in vfs_read() */
+	u64		write_file_ns;	/* spent in vfs_write() */
+	u64		read_wait_ns;	/* waiting for a free buffer */
+	u64		write_wait_ns;	/* waiting for data from the host */
+
 	struct device	dev;
 };
 
@@ -227,6 +242,12 @@ static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
 module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
 MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
 
+static unsigned int fsg_buflen = CONFIG_USB_GADGET_STORAGE_BUFLEN;
+#ifndef FSG_NO_BUFLEN_PARAM
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer");
+#endif
+
 #else
 
 /*
@@ -234,21 +255,32 @@ MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
  * 2 is usually enough for good buffering pipeline
  */
 #define fsg_num_buffers	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+#define fsg_buflen	CONFIG_USB_GADGET_STORAGE_BUFLEN
 
 #endif /* CONFIG_USB_DEBUG */
 
-/* check if fsg_num_buffers is within a valid range */
+#define FSG_MAX_NUM_BUFFERS	32
+#define FSG_MAX_BUFLEN		131072
+
+/* check if fsg_num_buffers and fsg_buflen are within a valid range */
 static inline int fsg_num_buffers_validate(void)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
-		return 0;
-	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2 ,4);
-	return -EINVAL;
+	if (fsg_num_buffers < 2 || fsg_num_buffers > FSG_MAX_NUM_BUFFERS) {
+		pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
+		       fsg_num_buffers, 2, FSG_MAX_NUM_BUFFERS);
+		return -EINVAL;
+	}
+	if (fsg_buflen < 4096 || fsg_buflen > FSG_MAX_BUFLEN ||
+	    fsg_buflen % 4096) {
+		pr_err("fsg_buflen %u is not a multiple of 4096 up to %d\n",
+		       fsg_buflen, FSG_MAX_BUFLEN);
+		return -EINVAL;
+	}
+	return 0;
 }
 
-/* Default size of buffer length. */
-#define FSG_BUFLEN	((u32)16384)
+/* Size of buffer length. */
+#define FSG_BUFLEN	((u32)fsg_buflen)
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
@@ -261,7 +293,7 @@ enum fsg_buffer_state {
 
 struct fsg_buffhd {
 #ifdef FSG_BUFFHD_STATIC_BUFFER
-	char				buf[FSG_BUFLEN];
+	char				buf[CONFIG_USB_GADGET_STORAGE_BUFLEN];
 #else
 	void				*buf;
 #endif
@@ -707,6 +739,13 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		goto out;
 	}
 
+	/*
+	 * Let the page cache read ahead at least as far as the buffer
+	 * pipeline reaches, so the medium is busy while the buffers drain.
+	 */
+	if (filp->f_ra.ra_pages < (fsg_num_buffers * FSG_BUFLEN) >> PAGE_SHIFT)
+		filp->f_ra.ra_pages = (fsg_num_buffers * FSG_BUFLEN) >> PAGE_SHIFT;
+
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
@@ -15,7 +15,9 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
+#include <linux/hrtimer.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
@@ -75,6 +77,17 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* multi-packet transfers, see eth_xmit_multi() */
+	bool			multi_pkt_xfer;
+	unsigned		ul_max_pkts_per_xfer;
+	unsigned		dl_max_pkts_per_xfer;
+	unsigned		dl_max_xfer_size;
+	unsigned		tx_req_bufsize;
+	/* partly filled tx request, guarded by req_lock */
+	struct usb_request	*tx_req_hold;
+	unsigned		tx_hold_pkts;
+	struct hrtimer		tx_timer;
 };
 
 /*-------------------------------------------------------------------------*/
@@ -94,6 +107,17 @@ MODULE_PARM_DESC(qmult, "queue length multiplier at high/super speed");
 #define qmult		1
 #endif
 
+/*
+ * Frames are only held back to fill a multi-packet transfer when this many
+ * transfers are already in flight, one of them completing sends it.
+ */
+#define TX_REQ_THRESHOLD	5
+
+static unsigned tx_coalesce_usecs = 200;
+module_param(tx_coalesce_usecs, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_coalesce_usecs,
+		"longest a multi-packet transfer waits for more frames");
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -229,6 +253,9 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	/* one skb takes all the frames of a multi-packet transfer */
+	if (dev->ul_max_pkts_per_xfer > 1)
+		size *= dev->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -453,10 +480,13 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void eth_tx_flush(struct eth_dev *dev, struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
+	struct usb_request *hold = NULL;
 
 	switch (req->status) {
 	default:
@@ -467,16 +497,32 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* multi-packet transfers are counted as they are filled */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	atomic_dec(&dev->tx_qlen);
+	if (dev->multi_pkt_xfer) {
+		req->length = 0;
+		if (!req->status) {
+			hold = dev->tx_req_hold;
+			dev->tx_req_hold = NULL;
+		}
+	}
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	if (hold) {
+		hrtimer_try_to_cancel(&dev->tx_timer);
+		eth_tx_flush(dev, hold);
+	}
 
-	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -486,6 +532,198 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+static int eth_tx_queue(struct eth_dev *dev, struct usb_ep *in,
+			struct usb_request *req)
+{
+	struct gether	*link = dev->port_usb;
+	unsigned	length = req->length;
+	int		retval;
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (link && link->is_fixed &&
+	    length == link->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+
+	/* throttle high/super speed IRQ rate back slightly */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH ||
+				     dev->gadget->speed == USB_SPEED_SUPER)
+			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+	}
+	return retval;
+}
+
+/* send a multi-packet transfer that was held back for more frames */
+static void eth_tx_flush(struct eth_dev *dev, struct usb_request *req)
+{
+	struct usb_ep	*in = NULL;
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (in && !eth_tx_queue(dev, in, req))
+		return;
+
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req->length = 0;
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static enum hrtimer_restart tx_timer_expired(struct hrtimer *timer)
+{
+	struct eth_dev		*dev = container_of(timer, struct eth_dev,
+						    tx_timer);
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_req_hold;
+	dev->tx_req_hold = NULL;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		eth_tx_flush(dev, req);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * With multi-packet transfers (RNDIS) frames are copied back to back into
+ * the buffer of a request.  While few transfers are in flight every frame
+ * is sent right away; under load the request is held until it is full, a
+ * transfer completes or tx_coalesce_usecs pass, which cuts the number of
+ * transfers and interrupts per frame.
+ */
+static netdev_tx_t eth_xmit_multi(struct eth_dev *dev, struct sk_buff *skb,
+				  struct usb_ep *in)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		max_len;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_req_hold;
+	dev->tx_req_hold = NULL;
+	if (!req) {
+		if (list_empty(&dev->tx_reqs)) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			return NETDEV_TX_BUSY;
+		}
+		req = container_of(dev->tx_reqs.next, struct usb_request,
+				   list);
+		list_del(&req->list);
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(net);
+		req->length = 0;
+		dev->tx_hold_pkts = 0;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (!req->buf) {
+		req->buf = kmalloc(dev->tx_req_bufsize, GFP_ATOMIC);
+		if (!req->buf) {
+			dev_kfree_skb_any(skb);
+			goto drop;
+		}
+	}
+	req->context = NULL;
+	req->complete = tx_complete;
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (!skb)
+			goto drop;
+	}
+
+	/* one spare byte for the zlp padding */
+	if (req->length + skb->len > dev->tx_req_bufsize - 1) {
+		dev_kfree_skb_any(skb);
+		goto drop;
+	}
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_hold_pkts++;
+	net->stats.tx_packets++;
+	net->stats.tx_bytes += skb->len;
+	dev_kfree_skb_any(skb);
+
+	/* until the host gave its limit, transfers carry a single frame */
+	max_len = min(dev->tx_req_bufsize - 1, dev->dl_max_xfer_size);
+
+	if (dev->tx_hold_pkts < dev->dl_max_pkts_per_xfer &&
+	    req->length + net->mtu + ETH_HLEN + dev->header_len <= max_len) {
+		/*
+		 * tx_complete() drops tx_qlen and picks up the held request
+		 * under req_lock, so one of the transfers counted here is
+		 * bound to send it.
+		 */
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (atomic_read(&dev->tx_qlen) >= TX_REQ_THRESHOLD) {
+			dev->tx_req_hold = req;
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			if (dev->tx_hold_pkts == 1 && tx_coalesce_usecs)
+				hrtimer_start(&dev->tx_timer,
+					ns_to_ktime(tx_coalesce_usecs *
+						    NSEC_PER_USEC),
+					HRTIMER_MODE_REL);
+			return NETDEV_TX_OK;
+		}
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	}
+
+send:
+	if (!eth_tx_queue(dev, in, req))
+		return NETDEV_TX_OK;
+	net->stats.tx_dropped += dev->tx_hold_pkts;
+	req->length = 0;
+recycle:
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	return NETDEV_TX_OK;
+
+drop:
+	net->stats.tx_dropped++;
+	if (req->length)
+		goto send;
+	goto recycle;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -534,6 +772,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->multi_pkt_xfer)
+		return eth_xmit_multi(dev, skb, in);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -572,41 +813,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	req->buf = skb->data;
 	req->context = skb;
 	req->complete = tx_complete;
-
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
 	req->length = length;
 
-	/* throttle high/super speed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH ||
-				     dev->gadget->speed == USB_SPEED_SUPER)
-			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
-	}
-
+	retval = eth_tx_queue(dev, in, req);
 	if (retval) {
 		dev_kfree_skb_any(skb);
 drop:
@@ -801,6 +1010,8 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_timer.function = tx_timer_expired;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -859,6 +1070,7 @@ void gether_cleanup(void)
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	hrtimer_cancel(&the_dev->tx_timer);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -916,6 +1128,15 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		dev->ul_max_pkts_per_xfer = link->ul_max_pkts_per_xfer;
+		dev->dl_max_pkts_per_xfer = link->dl_max_pkts_per_xfer;
+		dev->multi_pkt_xfer = dev->dl_max_pkts_per_xfer > 1;
+		dev->dl_max_xfer_size = 0;
+		if (dev->multi_pkt_xfer)
+			dev->tx_req_bufsize = dev->dl_max_pkts_per_xfer *
+				(dev->net->mtu + ETH_HLEN + dev->header_len)
+				+ 1;
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -976,13 +1197,21 @@ void gether_disconnect(struct gether *link)
 	 * and forget about the endpoints.
 	 */
 	usb_ep_disable(link->in_ep);
+	hrtimer_cancel(&dev->tx_timer);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_req_hold) {
+		list_add(&dev->tx_req_hold->list, &dev->tx_reqs);
+		dev->tx_req_hold = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		/* multi-packet transfers own their buffers */
+		if (dev->multi_pkt_xfer)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
@@ -1009,9 +1238,29 @@ void gether_disconnect(struct gether *link)
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
+	dev->multi_pkt_xfer = false;
+	dev->ul_max_pkts_per_xfer = 0;
+	dev->dl_max_pkts_per_xfer = 0;
 
 	spin_lock(&dev->lock);
 	dev->port_usb = NULL;
 	link->ioport = NULL;
 	spin_unlock(&dev->lock);
 }
+
+/**
+ * gether_update_dl_max_xfer_size - set the host's multi-packet limit
+ * @link: the USB link, on which gether_connect() was called
+ * @size: largest transfer in bytes the host takes, 0 if not known yet
+ * Context: any
+ *
+ * Transfers to the host carry at most link->dl_max_pkts_per_xfer frames
+ * and @size bytes.  Until this is called they carry a single frame.
+ */
+void gether_update_dl_max_xfer_size(struct gether *link, u32 size)
+{
+	struct eth_dev		*dev = link->ioport;
+
+	if (dev)
+		dev->dl_max_xfer_size = size;
+}
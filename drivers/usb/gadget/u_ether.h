@@ -59,6 +59,14 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/*
+	 * RNDIS can carry several frames per transfer: the most the host
+	 * is allowed to send us (ul) and the most we send it (dl).
+	 * 0 or 1 means one frame per transfer.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -80,6 +88,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 /* connect/disconnect is handled by individual functions */
 struct net_device *gether_connect(struct gether *);
 void gether_disconnect(struct gether *);
+void gether_update_dl_max_xfer_size(struct gether *link, u32 size);
 
 /* Some controllers can't support CDC Ethernet (ECM) ... */
 static inline bool can_support_ecm(struct usb_gadget *gadget)
@@ -41,6 +41,7 @@
 #include <linux/spinlock.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
 #include <linux/slab.h>
 
 #include "musb_core.h"
@@ -106,6 +107,22 @@ static inline void map_dma_buffer(struct musb_request *request,
 	if (!is_dma_capable() || !musb_ep->dma)
 		return;
 
+	/* checked by musb_sg_compatible() */
+	if (request->request.num_sgs) {
+		request->request.num_mapped_sgs = dma_map_sg(
+				musb->controller,
+				request->request.sg,
+				request->request.num_sgs,
+				request->tx
+					? DMA_TO_DEVICE
+					: DMA_FROM_DEVICE);
+		request->sg = request->request.sg;
+		request->sg_left = request->request.num_mapped_sgs;
+		request->sg_start = 0;
+		request->map_state = MUSB_MAPPED;
+		return;
+	}
+
 	/* Check if DMA engine can handle this request.
 	 * DMA code must reject the USB request explicitly.
 	 * Default behaviour is to map the request.
@@ -144,6 +161,18 @@ static inline void unmap_dma_buffer(struct musb_request *request,
 	if (!is_buffer_mapped(request))
 		return;
 
+	if (request->request.num_sgs) {
+		dma_unmap_sg(musb->controller,
+			request->request.sg,
+			request->request.num_sgs,
+			request->tx
+				? DMA_TO_DEVICE
+				: DMA_FROM_DEVICE);
+		request->request.num_mapped_sgs = 0;
+		request->map_state = UN_MAPPED;
+		return;
+	}
+
 	if (request->request.dma == DMA_ADDR_INVALID) {
 		dev_vdbg(musb->controller,
 				"not unmapping a never mapped buffer\n");
@@ -168,6 +197,59 @@ static inline void unmap_dma_buffer(struct musb_request *request,
 	request->map_state = UN_MAPPED;
 }
 
+/*
+ * Requests without a buffer go through DMA one scatterlist segment at a
+ * time, with no PIO fallback.  Every segment but the last must hold whole
+ * packets, so that no packet straddles two segments, and start on a word
+ * boundary for the Mentor engine.
+ */
+static bool musb_sg_compatible(struct musb_ep *musb_ep,
+			struct usb_request *request)
+{
+#ifdef CONFIG_USB_INVENTRA_DMA
+	struct scatterlist	*sg;
+	int			i;
+
+	if (!musb_ep->dma)
+		return false;
+
+	for_each_sg(request->sg, sg, request->num_sgs, i) {
+		if (sg->offset % 4)
+			return false;
+		if (!sg_is_last(sg) && sg->length % musb_ep->packet_sz)
+			return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * DMA address of the next byte of a mapped request, and how many bytes
+ * follow it contiguously.
+ */
+static dma_addr_t musb_req_dma(struct musb_request *req, size_t *len)
+{
+	struct usb_request	*request = &req->request;
+
+	if (!request->num_sgs) {
+		*len = request->length - request->actual;
+		return request->dma + request->actual;
+	}
+
+	while (req->sg_left > 1 &&
+	       request->actual >= req->sg_start + sg_dma_len(req->sg)) {
+		req->sg_start += sg_dma_len(req->sg);
+		req->sg = sg_next(req->sg);
+		req->sg_left--;
+	}
+
+	*len = min(req->sg_start + sg_dma_len(req->sg),
+			request->length) - request->actual;
+	return sg_dma_address(req->sg) + request->actual - req->sg_start;
+}
+
 /*
  * Immediately complete a request.
  *
@@ -373,12 +455,15 @@ static void txstate(struct musb *musb, struct musb_request *req)
 	if (is_buffer_mapped(req)) {
 		struct dma_controller	*c = musb->dma_controller;
 		size_t request_size;
+		dma_addr_t dma_addr;
 
 		/* setup DMA, then program endpoint CSR */
-		request_size = min_t(size_t, request->length - request->actual,
+		dma_addr = musb_req_dma(req, &request_size);
+		request_size = min_t(size_t, request_size,
 					musb_ep->dma->max_len);
 
-		use_dma = (request->dma != DMA_ADDR_INVALID);
+		use_dma = request->num_sgs ||
+			(request->dma != DMA_ADDR_INVALID);
 
 		/* MUSB_TXCSR_P_ISO is still set correctly */
 
@@ -392,7 +477,7 @@ static void txstate(struct musb *musb, struct musb_request *req)
 			use_dma = use_dma && c->channel_program(
 					musb_ep->dma, musb_ep->packet_sz,
 					musb_ep->dma->desired_mode,
-					request->dma + request->actual, request_size);
+					dma_addr, request_size);
 			if (use_dma) {
 				if (musb_ep->dma->desired_mode == 0) {
 					/*
@@ -447,7 +532,7 @@ static void txstate(struct musb *musb, struct musb_request *req)
 		use_dma = use_dma && c->channel_program(
 				musb_ep->dma, musb_ep->packet_sz,
 				0,
-				request->dma + request->actual,
+				dma_addr,
 				request_size);
 		if (!use_dma) {
 			c->channel_release(musb_ep->dma);
@@ -460,12 +545,18 @@ static void txstate(struct musb *musb, struct musb_request *req)
 		use_dma = use_dma && c->channel_program(
 				musb_ep->dma, musb_ep->packet_sz,
 				request->zero,
-				request->dma + request->actual,
+				dma_addr,
 				request_size);
 #endif
 	}
 #endif
 
+	/* scatterlist requests have no buffer for PIO */
+	if (!use_dma && request->num_sgs) {
+		musb_g_giveback(musb_ep, request, -EIO);
+		return;
+	}
+
 	if (!use_dma) {
 		/*
 		 * Unmap the dma buffer back to cpu if dma channel
@@ -776,14 +867,17 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 				}
 
 				if (request->actual < request->length) {
-					int transfer_size = 0;
+					size_t transfer_size = 0;
+					dma_addr_t dma_addr;
+
+					dma_addr = musb_req_dma(req, &transfer_size);
 					if (use_mode_1) {
-						transfer_size = min(request->length - request->actual,
+						transfer_size = min_t(size_t, transfer_size,
 								channel->max_len);
 						musb_ep->dma->desired_mode = 1;
 					} else {
-						transfer_size = min(request->length - request->actual,
-								(unsigned)len);
+						transfer_size = min_t(size_t, transfer_size,
+								len);
 						musb_ep->dma->desired_mode = 0;
 					}
 
@@ -791,8 +885,7 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 							channel,
 							musb_ep->packet_sz,
 							channel->desired_mode,
-							request->dma
-							+ request->actual,
+							dma_addr,
 							transfer_size);
 				}
 
@@ -848,6 +941,12 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 			}
 #endif	/* Mentor's DMA */
 
+			/* scatterlist requests have no buffer for PIO */
+			if (request->num_sgs) {
+				musb_g_giveback(musb_ep, request, -EIO);
+				return;
+			}
+
 			fifo_count = request->length - request->actual;
 			dev_dbg(musb->controller, "%s OUT/RX pio fifo %d/%d, maxpacket %d\n",
 					musb_ep->end_point.name,
@@ -1331,12 +1430,15 @@ static int musb_gadget_queue(struct usb_ep *ep, struct usb_request *req,
 
 	if (!ep || !req)
 		return -EINVAL;
-	if (!req->buf)
+	if (!req->buf && !req->num_sgs)
 		return -ENODATA;
 
 	musb_ep = to_musb_ep(ep);
 	musb = musb_ep->musb;
 
+	if (req->num_sgs && !musb_sg_compatible(musb_ep, req))
+		return -EINVAL;
+
 	request = to_musb_request(req);
 	request->musb = musb;
 
@@ -1906,6 +2008,10 @@ int __devinit musb_gadget_setup(struct musb *musb)
 	musb->g.ops = &musb_gadget_operations;
 	musb->g.max_speed = USB_SPEED_HIGH;
 	musb->g.speed = USB_SPEED_UNKNOWN;
+#ifdef CONFIG_USB_INVENTRA_DMA
+	/* see musb_sg_compatible() */
+	musb->g.sg_supported = is_dma_capable() && musb->dma_controller;
+#endif
 
 	musb->allow_pullup = 1;
 
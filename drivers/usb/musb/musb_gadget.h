@@ -51,6 +51,11 @@ struct musb_request {
 	u8 tx;			/* endpoint direction */
 	u8 epnum;
 	enum buffer_map_state map_state;
+
+	/* scatterlist requests: segment being transferred */
+	struct scatterlist	*sg;
+	unsigned		sg_left;	/* mapped segments from sg on */
+	unsigned		sg_start;	/* offset of sg in the request */
 };
 
 static inline struct musb_request *to_musb_request(struct usb_request *req)
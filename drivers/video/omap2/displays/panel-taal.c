@@ -199,6 +199,8 @@ struct taal_data {
 
 	atomic_t do_update;
 	int channel;
+	/* region of the pending update, sent from the TE interrupt */
+	u16 update_x, update_y, update_w, update_h;
 
 	struct delayed_work te_timeout_work;
 
@@ -1395,8 +1397,9 @@ static irqreturn_t taal_te_isr(int irq, void *data)
 	if (old) {
 		cancel_delayed_work(&td->te_timeout_work);
 
-		r = omap_dsi_update(dssdev, td->channel, taal_framedone_cb,
-				dssdev);
+		r = omap_dsi_update(dssdev, td->channel, td->update_x,
+				td->update_y, td->update_w, td->update_h,
+				taal_framedone_cb, dssdev);
 		if (r)
 			goto err;
 	}
@@ -1441,20 +1444,30 @@ static int taal_update(struct omap_dss_device *dssdev,
 		goto err;
 	}
 
+	/* the window is in panel coordinates, which differ when rotated */
+	if (td->rotate || td->mirror)
+		w = h = 0;
+
+	r = omap_dsi_prepare_update(dssdev, &x, &y, &w, &h);
+	if (r)
+		goto err;
+
 	/* XXX no need to send this every frame, but dsi break if not done */
-	r = taal_set_update_window(td, 0, 0,
-			td->panel_config->timings.x_res,
-			td->panel_config->timings.y_res);
+	r = taal_set_update_window(td, x, y, w, h);
 	if (r)
 		goto err;
 
 	if (td->te_enabled && panel_data->use_ext_te) {
+		td->update_x = x;
+		td->update_y = y;
+		td->update_w = w;
+		td->update_h = h;
 		schedule_delayed_work(&td->te_timeout_work,
 				msecs_to_jiffies(250));
 		atomic_set(&td->do_update, 1);
 	} else {
-		r = omap_dsi_update(dssdev, td->channel, taal_framedone_cb,
-				dssdev);
+		r = omap_dsi_update(dssdev, td->channel, x, y, w, h,
+				taal_framedone_cb, dssdev);
 		if (r)
 			goto err;
 	}
@@ -23,6 +23,8 @@
 #include <linux/jiffies.h>
 #include <linux/ratelimit.h>
 #include <linux/seq_file.h>
+#include <linux/pm_qos.h>
+#include <linux/workqueue.h>
 
 #include <video/omapdss.h>
 
@@ -121,6 +123,14 @@ struct mgr_priv_data {
 	/* If true, a display is enabled using this manager */
 	bool enabled;
 
+	/* If true, the last manual update only covered a part of the display
+	 * and the overlay registers hold cropped configurations */
+	bool partial_update;
+
+	/* If true, the registers for the next manual update have already
+	 * been written by dss_mgr_prepare_update() */
+	bool update_prepared;
+
 	/* callback data for the last 3 states */
 	struct callback_states cb;
 };
@@ -135,6 +145,10 @@ static struct {
 
 	bool irq_enabled;
 	u32 comp_irq_enabled;
+
+	/* memory bandwidth of the composition (KiB/s), lowest fclk (Hz) */
+	unsigned long bandwidth;
+	unsigned long min_fclk;
 } dss_data;
 
 /* propagating callback info between states */
@@ -179,7 +193,13 @@ static spinlock_t data_lock;
 static DEFINE_MUTEX(apply_lock);
 static DECLARE_COMPLETION(extra_updated_completion);
 
+/* L3/EMIF throughput requested for the composition, see dss_bw_work */
+static struct pm_qos_request dss_bw_qos;
+static struct work_struct dss_bw_work;
+static s32 dss_bw_requested;
+
 static void dss_register_vsync_isr(void);
+static void dss_update_bandwidth(void);
 
 static struct ovl_priv_data *get_ovl_priv(struct omap_overlay *ovl)
 {
@@ -191,6 +211,8 @@ static struct mgr_priv_data *get_mgr_priv(struct omap_overlay_manager *mgr)
 	return &dss_data.mgr_priv_data_array[mgr->id];
 }
 
+static void dss_bandwidth_work(struct work_struct *work);
+
 void dss_apply_init(void)
 {
 	const int num_ovls = dss_feat_get_num_ovls();
@@ -198,6 +220,10 @@ void dss_apply_init(void)
 
 	spin_lock_init(&data_lock);
 
+	INIT_WORK(&dss_bw_work, dss_bandwidth_work);
+	pm_qos_add_request(&dss_bw_qos, PM_QOS_MEMORY_THROUGHPUT,
+			   PM_QOS_MEMORY_THROUGHPUT_DEFAULT_VALUE);
+
 	for (i = 0; i < num_ovls; ++i) {
 		struct ovl_priv_data *op;
 
@@ -227,6 +253,12 @@ void dss_apply_init(void)
 	}
 }
 
+void dss_apply_uninit(void)
+{
+	cancel_work_sync(&dss_bw_work);
+	pm_qos_remove_request(&dss_bw_qos);
+}
+
 static bool ovl_manual_update(struct omap_overlay *ovl)
 {
 	return ovl->manager->device->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE;
@@ -575,12 +607,11 @@ int dss_mgr_wait_for_go_ovl(struct omap_overlay *ovl)
 	return r;
 }
 
-static void dss_ovl_write_regs(struct omap_overlay *ovl)
+static int dss_ovl_setup_regs(struct omap_overlay *ovl,
+		struct omap_overlay_info *oi)
 {
 	struct ovl_priv_data *op = get_ovl_priv(ovl);
-	struct omap_overlay_info *oi;
 	bool ilace, replication;
-	struct mgr_priv_data *mp;
 	u16 x_decim, y_decim;
 	bool five_taps = true;
 	int r;
@@ -588,11 +619,6 @@ static void dss_ovl_write_regs(struct omap_overlay *ovl)
 	bool m2m_with_ovl = false;
 	bool m2m_with_mgr = false;
 
-	DSSDBGF("%d", ovl->id);
-
-	if (!op->enabled || !op->info_dirty)
-		return;
-
 	if (dss_has_feature(FEAT_WB)) {
 		/* check if this overlay is source for wb, ignore mgr sources
 		 * here */
@@ -612,8 +638,6 @@ static void dss_ovl_write_regs(struct omap_overlay *ovl)
 		}
 	}
 
-	oi = &op->info;
-
 	replication = dss_use_replication(ovl->manager->device, oi->color_mode);
 
 	ilace = ovl->manager->device->type == OMAP_DISPLAY_TYPE_VENC;
@@ -628,9 +652,23 @@ static void dss_ovl_write_regs(struct omap_overlay *ovl)
 		r = dispc_scaling_decision(ovl->id, oi, op->channel,
 					&x_decim, &y_decim, &five_taps);
 
-	r = r ? : dispc_ovl_setup(ovl->id, oi, ilace,
+	return r ? : dispc_ovl_setup(ovl->id, oi, ilace,
 			replication, x_decim, y_decim, five_taps,
 						m2m_with_ovl || m2m_with_mgr);
+}
+
+static void dss_ovl_write_regs(struct omap_overlay *ovl)
+{
+	struct ovl_priv_data *op = get_ovl_priv(ovl);
+	struct mgr_priv_data *mp;
+	int r;
+
+	DSSDBGF("%d", ovl->id);
+
+	if (!op->enabled || !op->info_dirty)
+		return;
+
+	r = dss_ovl_setup_regs(ovl, &op->info);
 	if (r) {
 		/*
 		 * We can't do much here, as this function can be called from
@@ -1050,33 +1088,215 @@ static void schedule_completion_irq(void)
 	}
 }
 
-void dss_mgr_start_update(struct omap_overlay_manager *mgr)
+/*
+ * An overlay can be cut down to a part of the display only if moving its
+ * base address and shrinking its size gives the same pixels, i.e. it is
+ * not scaled, rotated or mirrored and its pixels are at least a byte wide.
+ */
+static bool dss_ovl_can_crop(struct omap_overlay_info *oi)
 {
-	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+	if (oi->rotation_type != OMAP_DSS_ROT_DMA || oi->rotation ||
+			oi->mirror)
+		return false;
+
+	if ((oi->out_width && oi->out_width != oi->width) ||
+			(oi->out_height && oi->out_height != oi->height))
+		return false;
+
+	switch (oi->color_mode) {
+	case OMAP_DSS_COLOR_CLUT1:
+	case OMAP_DSS_COLOR_CLUT2:
+	case OMAP_DSS_COLOR_CLUT4:
+	case OMAP_DSS_COLOR_NV12:
+	case OMAP_DSS_COLOR_YUV2:
+	case OMAP_DSS_COLOR_UYVY:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static void dss_ovl_get_rect(struct omap_overlay_info *oi,
+		u16 *x, u16 *y, u16 *w, u16 *h)
+{
+	*x = oi->pos_x;
+	*y = oi->pos_y;
+	*w = oi->out_width ? : oi->width;
+	*h = oi->out_height ? : oi->height;
+}
+
+/**
+ * dss_mgr_get_update_region - round a manual update region to what can be sent
+ * @mgr:	manager of a manually updated display
+ * @x, @y, @w, @h:	the damaged region, adjusted in place
+ *
+ * The region is clipped to the display and grown until every overlay that
+ * cannot be cropped is either fully inside or fully outside of it.  The
+ * horizontal bounds are then rounded to even pixels.  A zero sized region
+ * stands for the whole display.
+ */
+void dss_mgr_get_update_region(struct omap_overlay_manager *mgr,
+		u16 *x, u16 *y, u16 *w, u16 *h)
+{
+	struct omap_video_timings *t = &mgr->device->panel.timings;
+	struct omap_overlay *ovl;
 	unsigned long flags;
-	int r;
+	u16 x1, y1, x2, y2;
+	bool grown;
+
+	if (!*w || !*h || *x >= t->x_res || *y >= t->y_res) {
+		*x = *y = 0;
+		*w = t->x_res;
+		*h = t->y_res;
+		return;
+	}
+
+	x1 = *x;
+	y1 = *y;
+	x2 = min_t(u16, *x + *w, t->x_res);
+	y2 = min_t(u16, *y + *h, t->y_res);
 
 	spin_lock_irqsave(&data_lock, flags);
 
-	WARN_ON(mp->updating);
+	do {
+		grown = false;
+
+		list_for_each_entry(ovl, &mgr->overlays, list) {
+			struct ovl_priv_data *op = get_ovl_priv(ovl);
+			u16 ox, oy, ow, oh;
+
+			if (!op->enabled || dss_ovl_can_crop(&op->info))
+				continue;
+
+			dss_ovl_get_rect(&op->info, &ox, &oy, &ow, &oh);
+
+			/* outside of the region or already covered */
+			if (ox >= x2 || oy >= y2 || ox + ow <= x1 ||
+					oy + oh <= y1)
+				continue;
+			if (ox >= x1 && oy >= y1 && ox + ow <= x2 &&
+					oy + oh <= y2)
+				continue;
+
+			x1 = min(x1, ox);
+			y1 = min(y1, oy);
+			x2 = min_t(u16, max_t(u16, x2, ox + ow), t->x_res);
+			y2 = min_t(u16, max_t(u16, y2, oy + oh), t->y_res);
+			grown = true;
+		}
+	} while (grown);
+
+	spin_unlock_irqrestore(&data_lock, flags);
+
+	x1 &= ~1;
+	x2 = min_t(u16, ALIGN(x2, 2), t->x_res);
+
+	*x = x1;
+	*y = y1;
+	*w = x2 - x1;
+	*h = y2 - y1;
+}
+
+/*
+ * Adjust a copy of the overlay configuration so that it only covers the
+ * intersection with the update region, in region relative coordinates.
+ * Returns false if the overlay has nothing to show in the region.
+ */
+static bool dss_ovl_crop_to_region(struct omap_overlay_info *oi,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	u16 ox, oy, ow, oh;
+	u16 x1, y1, x2, y2;
+
+	dss_ovl_get_rect(oi, &ox, &oy, &ow, &oh);
+
+	x1 = max(ox, x);
+	y1 = max(oy, y);
+	x2 = min(ox + ow, x + w);
+	y2 = min(oy + oh, y + h);
+
+	if (x1 >= x2 || y1 >= y2)
+		return false;
+
+	if (dss_ovl_can_crop(oi)) {
+		unsigned ps = dispc_color_mode_to_bpp(oi->color_mode) / 8;
+
+		oi->paddr += ((y1 - oy) * oi->screen_width + (x1 - ox)) * ps;
+		oi->width = x2 - x1;
+		oi->height = y2 - y1;
+		oi->out_width = 0;
+		oi->out_height = 0;
+	} else if (x1 != ox || y1 != oy || x2 != ox + ow || y2 != oy + oh) {
+		/* dss_mgr_get_update_region() was not used for the region */
+		return false;
+	}
+
+	oi->pos_x = x1 - x;
+	oi->pos_y = y1 - y;
+
+	return true;
+}
+
+/*
+ * Program the overlays for a transfer of only a part of the display.  The
+ * cached configurations and the callbacks are left alone, so that the next
+ * full update can restore the registers from them.
+ */
+static void dss_mgr_write_update_region(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+	struct omap_video_timings *t = &mgr->device->panel.timings;
+	struct omap_overlay *ovl;
+	bool partial;
+
+	partial = x || y || w != t->x_res || h != t->y_res;
+	if (!partial && !mp->partial_update)
+		return;
+
+	list_for_each_entry(ovl, &mgr->overlays, list) {
+		struct ovl_priv_data *op = get_ovl_priv(ovl);
+		struct omap_overlay_info oi;
+		bool show;
+
+		if (!op->enabled || op->channel != mgr->id)
+			continue;
+
+		oi = op->info;
+		show = !partial || dss_ovl_crop_to_region(&oi, x, y, w, h);
+
+		if (show && dss_ovl_setup_regs(ovl, &oi)) {
+			DSSERR("dispc_ovl_setup failed for ovl %d in region\n",
+					ovl->id);
+			show = false;
+		}
+
+		dispc_ovl_enable(ovl->id, show);
+	}
+
+	dispc_mgr_set_lcd_size(mgr->id, w, h);
+
+	mp->partial_update = partial;
+}
+
+/* data_lock has to be held by the caller */
+static int dss_mgr_write_update_regs(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+	int r;
 
 	r = dss_check_settings(mgr, mgr->device);
 	if (r) {
 		DSSERR("cannot start manual update: illegal configuration\n");
-		spin_unlock_irqrestore(&data_lock, flags);
-		return;
+		return r;
 	}
 
 	dss_mgr_write_regs(mgr);
 
-	dss_write_regs_common();
-
-	mp->updating = true;
-
-	if (!dss_data.irq_enabled && need_isr())
-		dss_register_vsync_isr();
+	dss_mgr_write_update_region(mgr, x, y, w, h);
 
-	dispc_mgr_enable(mgr->id, true);
+	dss_write_regs_common();
 
 	/* for manually updated displays invoke dsscomp callbacks manually,
 	 * as logic that relays on shadow_dirty flag can't correctly release
@@ -1086,10 +1306,71 @@ void dss_mgr_start_update(struct omap_overlay_manager *mgr)
 	dss_ovl_program_cb(&mp->cb, mgr->id);
 
 	mgr_clear_shadow_dirty(mgr);
+
+	return 0;
+}
+
+/*
+ * dss_mgr_prepare_update - program the next manual update ahead of its start
+ *
+ * Writes the manager and overlay registers for the given region while the
+ * display is still sending the previous frame, so that the later
+ * dss_mgr_start_update(), typically called from the TE interrupt, only has
+ * to enable the output.  Does nothing if DISPC is still pushing pixels for
+ * the previous update; dss_mgr_start_update() then writes the registers
+ * itself.
+ */
+int dss_mgr_prepare_update(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+	unsigned long flags;
+	int r = 0;
+
+	spin_lock_irqsave(&data_lock, flags);
+
+	mp->update_prepared = false;
+
+	if (!dispc_mgr_is_enabled(mgr->id)) {
+		r = dss_mgr_write_update_regs(mgr, x, y, w, h);
+		mp->update_prepared = !r;
+	}
+
+	spin_unlock_irqrestore(&data_lock, flags);
+
+	return r;
+}
+
+void dss_mgr_start_update(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	struct mgr_priv_data *mp = get_mgr_priv(mgr);
+	unsigned long flags;
+
+	spin_lock_irqsave(&data_lock, flags);
+
+	WARN_ON(mp->updating);
+
+	if (!mp->update_prepared &&
+			dss_mgr_write_update_regs(mgr, x, y, w, h)) {
+		spin_unlock_irqrestore(&data_lock, flags);
+		return;
+	}
+
+	mp->update_prepared = false;
+	mp->updating = true;
+
+	if (!dss_data.irq_enabled && need_isr())
+		dss_register_vsync_isr();
+
+	dispc_mgr_enable(mgr->id, true);
+
 	spin_unlock_irqrestore(&data_lock, flags);
 }
 
 static void dss_apply_irq_handler(void *data, u32 mask);
+static void dss_mgr_setup_fifos(struct omap_overlay_manager *mgr,
+		bool use_fifo_merge);
 
 static void dss_register_vsync_isr(void)
 {
@@ -1413,6 +1694,10 @@ int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
 
 	/* Configure manager */
 	omap_dss_mgr_apply_mgr(mgr);
+
+	/* the FIFO thresholds follow the new overlay configuration */
+	dss_mgr_setup_fifos(mgr, dss_data.fifo_merge);
+	dss_update_bandwidth();
 done:
 	spin_unlock_irqrestore(&data_lock, flags);
 
@@ -1581,15 +1866,19 @@ static void dss_ovl_setup_fifo(struct omap_overlay *ovl,
 {
 	struct ovl_priv_data *op = get_ovl_priv(ovl);
 	struct omap_dss_device *dssdev;
+	unsigned long pclk = 0;
 	u32 fifo_low, fifo_high;
 
 	if (!op->enabled && !op->enabling)
 		return;
 
 	dssdev = ovl->manager->device;
+	if (dssdev)
+		pclk = dssdev->panel.timings.pixel_clock;
 
 	dispc_ovl_compute_fifo_thresholds(ovl->id, &fifo_low, &fifo_high,
-			use_fifo_merge, ovl_manual_update(ovl));
+			use_fifo_merge, ovl_manual_update(ovl), &op->info,
+			pclk);
 
 	dss_apply_ovl_fifo_thresholds(ovl, fifo_low, fifo_high);
 }
@@ -1619,6 +1908,91 @@ static void dss_setup_fifos(bool use_fifo_merge)
 		mgr = omap_dss_get_overlay_manager(i);
 		dss_mgr_setup_fifos(mgr, use_fifo_merge);
 	}
+
+	dss_update_bandwidth();
+}
+
+/*
+ * Sum up what the enabled overlays fetch from memory, and the DISPC fclk
+ * their scaling needs.  The bandwidth is requested from the L3/EMIF through
+ * PM QoS, so the interconnect runs at the lowest OPP that still feeds the
+ * display.  Called with data_lock held whenever the FIFOs are set up.
+ */
+static void dss_update_bandwidth(void)
+{
+	const int num_mgrs = omap_dss_get_num_overlay_managers();
+	unsigned long bw = 0, fclk = 0;
+	int i;
+
+	for (i = 0; i < num_mgrs; ++i) {
+		struct omap_overlay_manager *mgr;
+		struct omap_overlay *ovl;
+
+		mgr = omap_dss_get_overlay_manager(i);
+		if (!get_mgr_priv(mgr)->enabled || !mgr->device)
+			continue;
+
+		list_for_each_entry(ovl, &mgr->overlays, list) {
+			struct ovl_priv_data *op = get_ovl_priv(ovl);
+
+			if (!op->enabled && !op->enabling)
+				continue;
+
+			bw += dispc_ovl_bandwidth(&op->info,
+					&mgr->device->panel.timings);
+			fclk = max(fclk, dispc_ovl_min_fclk(mgr->id,
+					&op->info));
+		}
+	}
+
+	dss_data.min_fclk = fclk;
+	if (bw != dss_data.bandwidth) {
+		dss_data.bandwidth = bw;
+		queue_work(system_nrt_wq, &dss_bw_work);
+	}
+}
+
+/* pm_qos_update_request() may sleep, so it cannot go under data_lock */
+static void dss_bandwidth_work(struct work_struct *work)
+{
+	unsigned long flags;
+	s32 bw;
+
+	spin_lock_irqsave(&data_lock, flags);
+	bw = min_t(unsigned long, dss_data.bandwidth, S32_MAX);
+	spin_unlock_irqrestore(&data_lock, flags);
+
+	if (bw == dss_bw_requested)
+		return;
+
+	DSSDBG("composition bandwidth %d KiB/s\n", bw);
+	pm_qos_update_request(&dss_bw_qos, bw);
+	dss_bw_requested = bw;
+}
+
+void dss_dump_bandwidth(struct seq_file *s)
+{
+	unsigned long flags, bw, min_fclk, fclk;
+
+	spin_lock_irqsave(&data_lock, flags);
+	bw = dss_data.bandwidth;
+	min_fclk = dss_data.min_fclk;
+	spin_unlock_irqrestore(&data_lock, flags);
+
+	if (dispc_runtime_get())
+		return;
+	fclk = dispc_fclk_rate();
+	dispc_runtime_put();
+
+	seq_printf(s, "bandwidth\t%lu KiB/s\n", bw);
+	seq_printf(s, "requested\t%d KiB/s\n", dss_bw_requested);
+	seq_printf(s, "l3 target\t%d KiB/s\n",
+			pm_qos_request(PM_QOS_MEMORY_THROUGHPUT));
+	seq_printf(s, "fclk\t\t%lu Hz\n", fclk);
+	seq_printf(s, "fclk needed\t%lu Hz\n", min_fclk);
+	if (fclk >= 100)
+		seq_printf(s, "fclk headroom\t%lu%%\n",
+			min_fclk < fclk ? (fclk - min_fclk) / (fclk / 100) : 0);
 }
 
 static int get_num_used_managers(void)
@@ -1773,6 +2147,7 @@ void dss_mgr_disable(struct omap_overlay_manager *mgr)
 	spin_lock_irqsave(&data_lock, flags);
 
 	mp->updating = false;
+	mp->update_prepared = false;
 	mp->enabled = false;
 
 	fifo_merge = get_use_fifo_merge();
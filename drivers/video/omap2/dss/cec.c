@@ -28,6 +28,11 @@
 #include <linux/mm.h>
 #include <linux/completion.h>
 #include <linux/miscdevice.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/suspend.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <video/omapdss.h>
 #include <linux/switch.h>
 #include <video/cec.h>
@@ -50,15 +55,50 @@
 
 #define HDMI_CORE_CEC_TIMEOUT 200
 
+/* Messages received but not yet read by user space */
+#define CEC_RX_QUEUE_LEN	16
+/* Worst case for the hardware retransmits, as the old polled TX allowed */
+#define CEC_TX_TIMEOUT		4000
+/* How long to hold the system awake for a message received in suspend */
+#define CEC_WAKEUP_HOLD		500
+
 static struct cec_worker_data {
 	struct delayed_work dwork;
 	atomic_t state;
 } cec_work;
 
+struct cec_rx_msg {
+	struct cec_rx_data data;
+	ktime_t stamp;		/* RX interrupt */
+};
+
+struct cec_latency {
+	u32 count;
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+};
+
 static struct cec_t {
-	struct cec_rx_data rx_data;
 	struct switch_dev rx_switch;
 	struct mutex lock;/* Mutex for cec access */
+	struct mutex tx_lock;/* One transmission at a time */
+	spinlock_t irq_lock;/* TX state, RX queue and stats */
+	struct completion tx_done;
+	bool tx_busy;
+	int tx_acked;
+	DECLARE_KFIFO(rx_queue, struct cec_rx_msg, CEC_RX_QUEUE_LEN);
+	wait_queue_head_t rx_wait;
+	ktime_t rx_stamp;
+	bool wake_armed;
+	struct notifier_block pm_nb;
+	struct dentry *debugfs_dir;
+	struct cec_latency tx_latency;
+	struct cec_latency rx_latency;
+	u32 tx_acks;
+	u32 tx_nacks;
+	u32 tx_errors;
+	u32 rx_dropped;
 	struct hdmi_ip_data hdmi_data;
 	struct workqueue_struct *my_workq;
 	struct cec_keyboard_device key_dev;
@@ -81,23 +121,93 @@ static void cec_release_dss(void)
 	hdmi_runtime_put();
 }
 
+static void cec_account(struct cec_latency *lat, ktime_t start)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&cec.irq_lock, flags);
+	lat->last_us = us;
+	lat->max_us = max(lat->max_us, us);
+	lat->total_us += us;
+	lat->count++;
+	spin_unlock_irqrestore(&cec.irq_lock, flags);
+}
+
+/* Messages are queued by cec_rx_worker, no need to wake the hardware */
 int cec_read_rx_cmd(struct cec_rx_data *rx_data)
 {
-	int r = 0;
+	struct cec_rx_msg msg;
 
-	r = cec_request_dss();
-	if (r)
-		return r;
+	if (!kfifo_out_spinlocked(&cec.rx_queue, &msg, 1, &cec.irq_lock))
+		return -EINVAL;
 
-	mutex_lock(&cec.lock);
-	r = cec.hdmi_data.ops->cec_read_rx_cmd(&cec.hdmi_data, rx_data);
-	mutex_unlock(&cec.lock);
+	*rx_data = msg.data;
+	cec_account(&cec.rx_latency, msg.stamp);
 
-	cec_release_dss();
+	return 0;
+}
+EXPORT_SYMBOL(cec_read_rx_cmd);
+
+/*
+ * Send one message and sleep until the hardware has either had it acked or
+ * given up after data->retry_count retransmits; cec_irq_cb() reports which.
+ * Called with the HDMI clocks requested.
+ */
+static int cec_xmit(struct cec_tx_data *data, int *cmd_acked)
+{
+	ktime_t start = ktime_get();
+	unsigned long flags;
+	int r;
+
+	mutex_lock(&cec.tx_lock);
+
+	/* IPs without TX interrupts are still polled */
+	if (!cec.hdmi_data.ops->cec_start_tx) {
+		r = cec.hdmi_data.ops->cec_transmit_cmd(&cec.hdmi_data, data,
+			cmd_acked);
+		goto done;
+	}
+
+	*cmd_acked = -1;
+	INIT_COMPLETION(cec.tx_done);
+	spin_lock_irqsave(&cec.irq_lock, flags);
+	cec.tx_busy = true;
+	spin_unlock_irqrestore(&cec.irq_lock, flags);
+
+	r = cec.hdmi_data.ops->cec_start_tx(&cec.hdmi_data, data);
+	if (!r)
+		wait_for_completion_timeout(&cec.tx_done,
+			msecs_to_jiffies(CEC_TX_TIMEOUT));
+
+	spin_lock_irqsave(&cec.irq_lock, flags);
+	if (cec.tx_busy) {
+		cec.tx_busy = false;
+		if (!r) {
+			pr_err("CEC: no ack / nack sensed in %d ms\n",
+				CEC_TX_TIMEOUT);
+			r = -ETIMEDOUT;
+		}
+	} else {
+		*cmd_acked = cec.tx_acked;
+	}
+	spin_unlock_irqrestore(&cec.irq_lock, flags);
+
+done:
+	if (r) {
+		cec.tx_errors++;
+	} else {
+		if (*cmd_acked == 1)
+			cec.tx_acks++;
+		else
+			cec.tx_nacks++;
+		cec_account(&cec.tx_latency, start);
+	}
+
+	mutex_unlock(&cec.tx_lock);
 
 	return r;
 }
-EXPORT_SYMBOL(cec_read_rx_cmd);
 
 int cec_transmit_cmd(struct cec_tx_data *data, int *cmd_acked)
 {
@@ -108,10 +218,7 @@ int cec_transmit_cmd(struct cec_tx_data *data, int *cmd_acked)
 		if (r)
 			goto error_exit;
 
-		mutex_lock(&cec.lock);
-		r = cec.hdmi_data.ops->cec_transmit_cmd(&cec.hdmi_data, data,
-			cmd_acked);
-		mutex_unlock(&cec.lock);
+		r = cec_xmit(data, cmd_acked);
 
 		cec_release_dss();
 	}
@@ -134,6 +241,10 @@ static int cec_register_device(struct cec_dev *dev)
 	4. report physical address
 	5. check for nacks */
 
+	r = cec_request_dss();
+	if (r)
+		return r;
+
 	if (dev->device_id == CEC_UNREGISTERED_DEVICE) {
 		acked_nacked = 1;
 		dev->phy_addr = cec.phy_address;
@@ -154,16 +265,11 @@ static int cec_register_device(struct cec_dev *dev)
 	tx_data.send_ping = 0x1;
 	tx_data.retry_count = 1;
 
-	r = cec.hdmi_data.ops->cec_transmit_cmd(&cec.hdmi_data, &tx_data,
-		&acked_nacked);
+	r = cec_xmit(&tx_data, &acked_nacked);
 	if (r != 0)
 		pr_err("\nCould not Ping device\n");
 
 no_ping_required:
-	r = cec_request_dss();
-	if (r)
-		return r;
-
 	current_dev = cec.hdmi_data.ops->cec_get_reg_device_list(&cec.hdmi_data);
 
 	/* Check if device is already present */
@@ -186,8 +292,7 @@ no_ping_required:
 		acked_nacked = 0xFF;
 		tx_data.retry_count = 5;
 		tx_data.send_ping = 0;
-		r = cec.hdmi_data.ops->cec_transmit_cmd(&cec.hdmi_data,
-			&tx_data, &acked_nacked);
+		r = cec_xmit(&tx_data, &acked_nacked);
 		if ((acked_nacked != 1) || (r != 0x0)) {
 			/* Restore previous registration */
 			cec.hdmi_data.ops->cec_set_reg_device_list(&cec.hdmi_data,
@@ -287,43 +392,77 @@ static long cec_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
 * CEC driver init/exit
 ******************************************************************************/
 
+static unsigned int cec_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &cec.rx_wait, wait);
+
+	return kfifo_is_empty(&cec.rx_queue) ? 0 : POLLIN | POLLRDNORM;
+}
+
 static const struct file_operations cec_fops = {
 	.owner = THIS_MODULE,
 	.unlocked_ioctl = cec_ioctl,
+	.poll = cec_poll,
 };
 
 static struct miscdevice mdev;
 
+/* UI events should be sent to keyboard driver */
+static bool cec_route_ui_cmd(struct cec_rx_msg *msg)
+{
+	bool pressed;
+
+	if (!cec.route_ui_cmds || !cec.key_dev.key_event)
+		return false;
+
+	if (msg->data.rx_cmd == cec_cmd_u_user_control_pressed)
+		pressed = true;
+	else if (msg->data.rx_cmd == cec_cmd_u_user_control_released)
+		pressed = false;
+	else
+		return false;
+
+	cec.key_dev.key_event(msg->data.rx_operand[0], pressed);
+	cec_account(&cec.rx_latency, msg->stamp);
+
+	return true;
+}
+
 static void cec_rx_worker(struct work_struct *work)
 {
-	int r;
-	char rx_cmd;
+	struct cec_rx_msg msg;
+	unsigned long flags;
+	int i, r;
 
-	/*UI events should be sent to keyboard driver*/
-	if (cec.route_ui_cmds && cec.key_dev.key_event) {
-		r = cec_request_dss();
-		if (r) {
-			pr_err("CEC no clocks\n");
-			return;
-		}
-		mutex_lock(&cec.lock);
-		r = cec.hdmi_data.ops->cec_get_rx_cmd(&cec.hdmi_data, &rx_cmd);
-		if (rx_cmd == cec_cmd_u_user_control_pressed) {
-			r = cec.hdmi_data.ops->cec_read_rx_cmd(&cec.hdmi_data,
-				&cec.rx_data);
-			if (!r)
-				r = cec.key_dev.key_event(cec.rx_data.rx_operand[0],
-					true);
-		} else if (rx_cmd == cec_cmd_u_user_control_released) {
-			r = cec.hdmi_data.ops->cec_read_rx_cmd(&cec.hdmi_data,
-				&cec.rx_data);
-			if (!r)
-				r = cec.key_dev.key_event(cec.rx_data.rx_operand[0],
-					false);
-		}
-		mutex_unlock(&cec.lock);
-		cec_release_dss();
+	r = cec_request_dss();
+	if (r) {
+		pr_err("CEC no clocks\n");
+		return;
+	}
+
+	spin_lock_irqsave(&cec.irq_lock, flags);
+	msg.stamp = cec.rx_stamp;
+	cec.rx_stamp = ktime_set(0, 0);
+	spin_unlock_irqrestore(&cec.irq_lock, flags);
+
+	/* Drain the hardware FIFO so user space never has to touch it */
+	mutex_lock(&cec.lock);
+	for (i = 0; i < CEC_RX_QUEUE_LEN; i++) {
+		if (cec.hdmi_data.ops->cec_read_rx_cmd(&cec.hdmi_data,
+				&msg.data))
+			break;
+
+		if (cec_route_ui_cmd(&msg))
+			continue;
+
+		if (!kfifo_in_spinlocked(&cec.rx_queue, &msg, 1,
+				&cec.irq_lock))
+			cec.rx_dropped++;
 	}
+	mutex_unlock(&cec.lock);
+	cec_release_dss();
+
+	wake_up_interruptible(&cec.rx_wait);
 
 	/* It is still OK to send event to user space for UI commands also
 	 * just to inform them about the cec event*/
@@ -335,13 +474,29 @@ static void cec_rx_worker(struct work_struct *work)
 static void cec_irq_cb(void)
 {
 	u32 cec_rx = 0;
+	int r;
+
+	spin_lock(&cec.irq_lock);
+	if (cec.hdmi_data.ops->cec_tx_status) {
+		/* Always called, it clears the TX status */
+		r = cec.hdmi_data.ops->cec_tx_status(&cec.hdmi_data);
+		if (r != -EINPROGRESS && cec.tx_busy) {
+			cec.tx_acked = r;
+			cec.tx_busy = false;
+			complete(&cec.tx_done);
+		}
+	}
 
 	cec_rx = cec.hdmi_data.ops->cec_int_handler(&cec.hdmi_data);
 	/*if command present in FIFO*/
+	if (cec_rx && !ktime_to_ns(cec.rx_stamp))
+		cec.rx_stamp = ktime_get();
+	spin_unlock(&cec.irq_lock);
+
 	if (cec_rx) {
-		/*UI events should be sent to keyboard driver*/
-		__cancel_delayed_work(&cec_work.dwork);
-		queue_delayed_work(cec.my_workq, &cec_work.dwork, 1);
+		/* Keep the system up to deliver it if it woke us */
+		pm_wakeup_event(mdev.this_device, CEC_WAKEUP_HOLD);
+		queue_delayed_work(cec.my_workq, &cec_work.dwork, 0);
 		/*clear CEC RX interrupts*/
 		cec.hdmi_data.ops->cec_clr_rx_int(&cec.hdmi_data, cec_rx);
 	}
@@ -356,6 +511,14 @@ static void cec_hpd_cb(int phy_addr, int status)
 	cec.phy_address = phy_addr;
 	/* Set it to unregisterd device id */
 	cec.device_id = CEC_UNREGISTERED_DEVICE;
+	/* Whatever is queued came from the previous sink */
+	if (!status) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&cec.irq_lock, flags);
+		kfifo_reset(&cec.rx_queue);
+		spin_unlock_irqrestore(&cec.irq_lock, flags);
+	}
 	mutex_unlock(&cec.lock);
 
 	if (cec.key_dev.connect)
@@ -407,6 +570,79 @@ static void cec_power_on_cb(int status)
 
 	return;
 }
+
+/*
+ * Wake on CEC: when enabled through /sys/class/misc/cec/power/wakeup, keep
+ * the HDMI clocks, which CEC runs from, across suspend and make the HDMI
+ * interrupt a wakeup source, so a remote control press on the TV resumes
+ * the device.
+ */
+static int cec_pm_notifier(struct notifier_block *nb, unsigned long event,
+	void *unused)
+{
+	mutex_lock(&cec.lock);
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		if (!cec.power_on || !device_may_wakeup(mdev.this_device))
+			break;
+		if (cec_request_dss())
+			break;
+		if (hdmi_set_irq_wake(true)) {
+			pr_err("CEC: cannot wake on CEC\n");
+			cec_release_dss();
+			break;
+		}
+		cec.wake_armed = true;
+		break;
+	case PM_POST_SUSPEND:
+		if (!cec.wake_armed)
+			break;
+		hdmi_set_irq_wake(false);
+		cec_release_dss();
+		cec.wake_armed = false;
+		break;
+	}
+	mutex_unlock(&cec.lock);
+
+	return NOTIFY_DONE;
+}
+
+static void cec_print_latency(struct seq_file *s, const char *name,
+	struct cec_latency *lat)
+{
+	seq_printf(s, "%s: count %u last %u us avg %llu us max %u us\n",
+		name, lat->count, lat->last_us,
+		lat->count ? div_u64(lat->total_us, lat->count) : 0,
+		lat->max_us);
+}
+
+static int cec_stats_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cec.irq_lock, flags);
+	cec_print_latency(s, "tx", &cec.tx_latency);
+	cec_print_latency(s, "rx", &cec.rx_latency);
+	seq_printf(s, "tx acked %u nacked %u errors %u\n", cec.tx_acks,
+		cec.tx_nacks, cec.tx_errors);
+	seq_printf(s, "rx queued %u dropped %u\n", kfifo_len(&cec.rx_queue),
+		cec.rx_dropped);
+	spin_unlock_irqrestore(&cec.irq_lock, flags);
+
+	return 0;
+}
+
+static int cec_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cec_stats_show, inode->i_private);
+}
+
+static const struct file_operations cec_stats_fops = {
+	.open		= cec_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 static int __init cec_init(void)
 {
 	int r = -EFAULT;
@@ -423,6 +659,11 @@ static int __init cec_init(void)
 
 	cec.cec_rx_data_valid = 0;
 	cec.power_on = 0;
+	mutex_init(&cec.tx_lock);
+	spin_lock_init(&cec.irq_lock);
+	init_completion(&cec.tx_done);
+	INIT_KFIFO(cec.rx_queue);
+	init_waitqueue_head(&cec.rx_wait);
 	/* Set it to unregisterd device id */
 	cec.device_id = CEC_UNREGISTERED_DEVICE;
 	mdev.minor = MISC_DYNAMIC_MINOR;
@@ -434,6 +675,7 @@ static int __init cec_init(void)
 		pr_err("CEC: Could not add character driver\n");
 		goto err_register;
 	}
+	device_set_wakeup_capable(mdev.this_device, true);
 	pr_debug("register call backs\n");
 	omapdss_hdmi_register_cec_callbacks(&cec_power_on_cb, &cec_irq_cb,
 		&cec_hpd_cb);
@@ -454,6 +696,14 @@ static int __init cec_init(void)
 		pr_err("Keyboard driver not present\n");
 
 	cec.route_ui_cmds = 0;
+
+	cec.pm_nb.notifier_call = cec_pm_notifier;
+	register_pm_notifier(&cec.pm_nb);
+
+	cec.debugfs_dir = debugfs_create_dir("cec", NULL);
+	if (!IS_ERR_OR_NULL(cec.debugfs_dir))
+		debugfs_create_file("stats", S_IRUGO, cec.debugfs_dir, NULL,
+			&cec_stats_fops);
 	return 0;
 
 error_work:
@@ -475,6 +725,8 @@ static void __exit cec_exit(void)
 {
 	pr_debug("cec_exit() %u", jiffies_to_msecs(jiffies));
 
+	debugfs_remove_recursive(cec.debugfs_dir);
+	unregister_pm_notifier(&cec.pm_nb);
 	misc_deregister(&mdev);
 	switch_dev_unregister(&cec.rx_switch);
 	mutex_destroy(&cec.lock);
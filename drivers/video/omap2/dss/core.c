@@ -104,6 +104,16 @@ int dss_get_ctx_loss_count(struct device *dev)
 	return cnt;
 }
 
+bool dss_context_lost(struct device *dev)
+{
+	struct omap_dss_board_info *board_data = core.pdev->dev.platform_data;
+
+	if (!board_data->context_lost)
+		return true;
+
+	return board_data->context_lost(dev);
+}
+
 int dss_dsi_enable_pads(int dsi_id, unsigned lane_mask)
 {
 	struct omap_dss_board_info *board_data = core.pdev->dev.platform_data;
@@ -171,6 +181,10 @@ static int dss_initialize_debugfs(void)
 			&dss_dump_regs, &dss_debug_fops);
 	debugfs_create_file("dispc", S_IRUGO, dss_debugfs_dir,
 			&dispc_dump_regs, &dss_debug_fops);
+	debugfs_create_file("dispc_fifo", S_IRUGO, dss_debugfs_dir,
+			&dispc_dump_fifo, &dss_debug_fops);
+	debugfs_create_file("bandwidth", S_IRUGO, dss_debugfs_dir,
+			&dss_dump_bandwidth, &dss_debug_fops);
 #ifdef CONFIG_OMAP2_DSS_RFBI
 	debugfs_create_file("rfbi", S_IRUGO, dss_debugfs_dir,
 			&rfbi_dump_regs, &dss_debug_fops);
@@ -261,6 +275,8 @@ static int omap_dss_remove(struct platform_device *pdev)
 	for (i = 0; i < pdata->num_devices; ++i)
 		omap_dss_unregister_device(pdata->devices[i]);
 
+	dss_apply_uninit();
+
 	return 0;
 }
 
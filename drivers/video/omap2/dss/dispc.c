@@ -37,6 +37,7 @@
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/ratelimit.h>
+#include <linux/math64.h>
 
 #include <plat/clock.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
@@ -48,9 +49,21 @@
 #include "dss_features.h"
 #include "dispc.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/omapdss.h>
+
 /* DISPC */
 #define DISPC_SZ_REGS			SZ_4K
 
+#define DISPC_IRQ_MASK_UNDERFLOW	(DISPC_IRQ_GFX_FIFO_UNDERFLOW | \
+					 DISPC_IRQ_VID1_FIFO_UNDERFLOW | \
+					 DISPC_IRQ_VID2_FIFO_UNDERFLOW | \
+					 DISPC_IRQ_VID3_FIFO_UNDERFLOW)
+
+#define DISPC_IRQ_MASK_SYNC_LOST	(DISPC_IRQ_SYNC_LOST | \
+					 DISPC_IRQ_SYNC_LOST_DIGIT | \
+					 DISPC_IRQ_SYNC_LOST2)
+
 #define DISPC_IRQ_MASK_ERROR			(DISPC_IRQ_GFX_FIFO_UNDERFLOW | \
 					 DISPC_IRQ_OCP_ERR | \
 					 DISPC_IRQ_VID1_FIFO_UNDERFLOW | \
@@ -60,6 +73,24 @@
 
 #define DISPC_MAX_NR_ISRS		8
 
+/*
+ * Time the FIFO of a pipeline must last while its refill waits for the
+ * interconnect and the DDR. TILER rotated fetches cross a page every few
+ * pixels and wait longer. Every underflow of a pipeline adds a step, up
+ * to DISPC_FIFO_BOOST_MAX.
+ */
+#define DISPC_FIFO_LATENCY_NS		2000
+#define DISPC_FIFO_LATENCY_TILER_NS	4000
+#define DISPC_FIFO_BOOST_NS		1000
+#define DISPC_FIFO_BOOST_MAX		4
+
+static const u32 dispc_fifo_underflow_bits[] = {
+	DISPC_IRQ_GFX_FIFO_UNDERFLOW,
+	DISPC_IRQ_VID1_FIFO_UNDERFLOW,
+	DISPC_IRQ_VID2_FIFO_UNDERFLOW,
+	DISPC_IRQ_VID3_FIFO_UNDERFLOW,
+};
+
 static struct clockdomain *l3_1_clkdm, *l3_2_clkdm;
 
 #define DISPC_ISR_BIT_ONESHOT  0
@@ -97,6 +128,12 @@ static struct {
 
 	u32	fifo_size[MAX_DSS_OVERLAYS];
 
+	/* FIFO underflows, and the latency steps added for them */
+	u32	fifo_underflows[MAX_DSS_OVERLAYS];
+	u32	fifo_underflows_seen[MAX_DSS_OVERLAYS];
+	u32	fifo_boost[MAX_DSS_OVERLAYS];
+	u32	fifo_need[MAX_DSS_OVERLAYS];
+
 	spinlock_t irq_lock;
 	u32 irq_error_mask;
 	struct omap_dispc_isr_data registered_isr[DISPC_MAX_NR_ISRS];
@@ -1160,9 +1197,85 @@ void dispc_enable_fifomerge(bool enable)
 	REG_FLD_MOD(DISPC_CONFIG, enable ? 1 : 0, 14, 14);
 }
 
+/* bytes a pipeline fetches for each pixel it outputs, in 1/16 */
+static u32 dispc_ovl_fetch_rate(const struct omap_overlay_info *oi)
+{
+	u32 out_width = oi->out_width ? : oi->width;
+	u32 out_height = oi->out_height ? : oi->height;
+	u32 rate;
+
+	rate = dispc_color_mode_to_bpp(oi->color_mode) * 2;
+	if (oi->color_mode == OMAP_DSS_COLOR_NV12)
+		rate += rate / 2;	/* the chroma plane */
+
+	/* downscaling reads more than one pixel for each output pixel */
+	if (out_width && oi->width > out_width)
+		rate = rate * oi->width / out_width;
+	if (out_height && oi->height > out_height)
+		rate = rate * oi->height / out_height;
+
+	return rate;
+}
+
+/*
+ * Bytes the FIFO of @plane must hold to cover the refill latency, at the
+ * rate @oi is read at @pclk (kHz). Underflows seen since the last call
+ * make the latency longer.
+ */
+static u32 dispc_ovl_fifo_need(enum omap_plane plane,
+		const struct omap_overlay_info *oi, unsigned long pclk)
+{
+	u32 underflows = ACCESS_ONCE(dispc.fifo_underflows[plane]);
+	u32 latency;
+
+	if (underflows != dispc.fifo_underflows_seen[plane]) {
+		dispc.fifo_underflows_seen[plane] = underflows;
+		if (dispc.fifo_boost[plane] < DISPC_FIFO_BOOST_MAX)
+			dispc.fifo_boost[plane]++;
+	}
+
+	if (oi->rotation_type == OMAP_DSS_ROT_TILER && (oi->rotation & 1))
+		latency = DISPC_FIFO_LATENCY_TILER_NS;
+	else
+		latency = DISPC_FIFO_LATENCY_NS;
+	latency += dispc.fifo_boost[plane] * DISPC_FIFO_BOOST_NS;
+
+	return div_u64((u64)pclk * dispc_ovl_fetch_rate(oi) * latency,
+		       16 * 1000000);
+}
+
+/*
+ * Average memory bandwidth, in KiB/s, @oi needs when shown with timings @t.
+ * The pipeline fetches only for its output area, once per frame.
+ */
+unsigned long dispc_ovl_bandwidth(const struct omap_overlay_info *oi,
+		const struct omap_video_timings *t)
+{
+	u32 out_width = oi->out_width ? : oi->width;
+	u32 out_height = oi->out_height ? : oi->height;
+	u32 htot = t->x_res + t->hfp + t->hsw + t->hbp;
+	u32 vtot = t->y_res + t->vfp + t->vsw + t->vbp;
+	u64 bw;
+
+	if (!htot || !vtot)
+		return 0;
+
+	/* pixel_clock is in kHz */
+	bw = (u64)out_width * out_height * dispc_ovl_fetch_rate(oi) *
+		t->pixel_clock * 1000;
+	bw = div_u64(bw, htot * vtot * 16) >> 10;
+
+	/* 90/270 TILER reads waste about half of each 2D burst */
+	if (oi->rotation_type == OMAP_DSS_ROT_TILER && (oi->rotation & 1))
+		bw *= 2;
+
+	return bw;
+}
+
 void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		u32 *fifo_low, u32 *fifo_high, bool use_fifomerge,
-		bool manual_update)
+		bool manual_update, const struct omap_overlay_info *oi,
+		unsigned long pclk)
 {
 	/*
 	 * All sizes are in bytes. Both the buffer and burst are made of
@@ -1195,9 +1308,22 @@ void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		*fifo_high = total_fifo_size - burst_size;
 	} else {
 		if (cpu_is_omap44xx()) {
-			/* optimization of power consumption for OMAP4 */
+			/*
+			 * optimization of power consumption for OMAP4: refill
+			 * late, unless the pipeline drains the FIFO too fast
+			 * for that
+			 */
 			*fifo_low = (ovl_fifo_size / 2);
 			*fifo_high = total_fifo_size - buf_unit;
+
+			if (oi && pclk) {
+				u32 need = dispc_ovl_fifo_need(plane, oi, pclk);
+
+				dispc.fifo_need[plane] = need;
+				need = roundup(need + burst_size, buf_unit);
+				*fifo_low = min(max(*fifo_low, need),
+						ovl_fifo_size - burst_size);
+			}
 		} else {
 			/* TODO: which should be the numbers for OMAP5?
 			 * Set safest values for now */
@@ -1517,7 +1643,7 @@ static void dispc_ovl_set_rotation_attrs(enum omap_plane plane, u8 rotation,
 	}
 }
 
-static int color_mode_to_bpp(enum omap_color_mode color_mode)
+int dispc_color_mode_to_bpp(enum omap_color_mode color_mode)
 {
 	switch (color_mode) {
 	case OMAP_DSS_COLOR_CLUT1:
@@ -1603,7 +1729,7 @@ static void calc_vrfb_rotation_offset(u8 rotation, bool mirror,
 		ps = 4;
 		break;
 	default:
-		ps = color_mode_to_bpp(color_mode) / 8;
+		ps = dispc_color_mode_to_bpp(color_mode) / 8;
 		break;
 	}
 
@@ -1693,7 +1819,7 @@ static void calc_dma_rotation_offset(u8 rotation, bool mirror,
 		}
 		/* fall through */
 	default:
-		ps = color_mode_to_bpp(color_mode) / 8;
+		ps = dispc_color_mode_to_bpp(color_mode) / 8;
 		break;
 	}
 
@@ -1910,12 +2036,26 @@ static unsigned long calc_fclk(enum omap_channel channel, u16 width,
 	}
 }
 
+/*
+ * Lowest DISPC fclk, in Hz, that can scale @oi on @channel without
+ * predecimation.  Only valid while the manager of @channel is enabled.
+ */
+unsigned long dispc_ovl_min_fclk(enum omap_channel channel,
+		const struct omap_overlay_info *oi)
+{
+	u16 out_width = oi->out_width ? : oi->width;
+	u16 out_height = oi->out_height ? : oi->height;
+
+	return calc_fclk(channel, oi->width, oi->height, out_width,
+			out_height);
+}
+
 int dispc_scaling_decision(enum omap_plane plane, struct omap_overlay_info *oi,
 			enum omap_channel channel,
 			u16 *x_decim, u16 *y_decim, bool *five_taps)
 {
 	const int maxdownscale = dss_feat_get_param_max(FEAT_PARAM_DOWNSCALE);
-	int bpp = color_mode_to_bpp(oi->color_mode);
+	int bpp = dispc_color_mode_to_bpp(oi->color_mode);
 
 	/*
 	 * For now only whole byte formats on OMAP4/5 can be predecimated.
@@ -2290,7 +2430,7 @@ skip_errata:
 	if (oi->rotation_type == OMAP_DSS_ROT_TILER) {
 		struct tiler_view_t view = {0};
 		u16 tiler_width = orig_width, tiler_height = orig_height;
-		int bpp = color_mode_to_bpp(oi->color_mode) / 8;
+		int bpp = dispc_color_mode_to_bpp(oi->color_mode) / 8;
 		/* tiler needs 0-degree width & height */
 		if (oi->rotation & 1)
 			swap(tiler_width, tiler_height);
@@ -2531,7 +2671,7 @@ int dispc_setup_wb(struct writeback_cache_data *wb)
 	pix_inc = 0x1;
 	if ((paddr >= 0x60000000) && (paddr <= 0x7fffffff)) {
 		struct tiler_view_t view = {0};
-		int bpp = color_mode_to_bpp(color_mode) / 8;
+		int bpp = dispc_color_mode_to_bpp(color_mode) / 8;
 
 		/* tiler needs 0-degree width & height */
 		if (rotation & 1)
@@ -3289,6 +3429,20 @@ void dispc_dump_irqs(struct seq_file *s)
 }
 #endif
 
+void dispc_dump_fifo(struct seq_file *s)
+{
+	int i;
+
+	seq_printf(s, "%-6s %8s %10s %6s %8s\n", "plane", "size",
+		   "underflows", "boost", "need");
+	for (i = 0; i < ARRAY_SIZE(dispc_fifo_underflow_bits) &&
+		    i < dss_feat_get_num_ovls(); i++)
+		seq_printf(s, "%-6d %8u %10u %6u %8u\n", i,
+			   dispc_ovl_get_fifo_size(i),
+			   dispc.fifo_underflows[i], dispc.fifo_boost[i],
+			   dispc.fifo_need[i]);
+}
+
 void dispc_dump_regs(struct seq_file *s)
 {
 	int i, j;
@@ -3886,6 +4040,16 @@ static irqreturn_t omap_dispc_irq_handler(int irq, void *arg)
 	if (dss_debug)
 		print_irq_status(irqstatus);
 #endif
+	if (unlikely(irqstatus & DISPC_IRQ_MASK_UNDERFLOW)) {
+		trace_dispc_fifo_underflow(irqstatus &
+					   DISPC_IRQ_MASK_UNDERFLOW);
+		for (i = 0; i < ARRAY_SIZE(dispc_fifo_underflow_bits); i++)
+			if (irqstatus & dispc_fifo_underflow_bits[i])
+				dispc.fifo_underflows[i]++;
+	}
+	if (unlikely(irqstatus & DISPC_IRQ_MASK_SYNC_LOST))
+		trace_dispc_sync_lost(irqstatus & DISPC_IRQ_MASK_SYNC_LOST);
+
 	/* Ack the interrupt. Do it here before clocks are possibly turned
 	 * off */
 	dispc_write_reg(DISPC_IRQSTATUS, irqstatus);
@@ -3952,12 +4116,6 @@ static void dispc_error_worker(struct work_struct *work)
 	int i;
 	u32 errors;
 	unsigned long flags;
-	static const unsigned fifo_underflow_bits[] = {
-		DISPC_IRQ_GFX_FIFO_UNDERFLOW,
-		DISPC_IRQ_VID1_FIFO_UNDERFLOW,
-		DISPC_IRQ_VID2_FIFO_UNDERFLOW,
-		DISPC_IRQ_VID3_FIFO_UNDERFLOW,
-	};
 
 	static const unsigned sync_lost_bits[] = {
 		DISPC_IRQ_SYNC_LOST,
@@ -3978,7 +4136,7 @@ static void dispc_error_worker(struct work_struct *work)
 		ovl = omap_dss_get_overlay(i);
 		if (!ovl)
 			continue;
-		bit = fifo_underflow_bits[i];
+		bit = dispc_fifo_underflow_bits[i];
 
 		if (bit & errors) {
 			DSSERR("FIFO UNDERFLOW on %s, disabling the overlay\n",
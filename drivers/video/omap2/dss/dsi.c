@@ -38,6 +38,7 @@
 #include <linux/slab.h>
 #include <linux/debugfs.h>
 #include <linux/pm_runtime.h>
+#include <linux/math64.h>
 
 #include <video/omapdss.h>
 #include <video/mipi_display.h>
@@ -246,6 +247,18 @@ struct dsi_irq_stats {
 	unsigned cio_irqs[32];
 };
 
+/* frame transfer times, from the start of an update to FRAMEDONE */
+#define DSI_XFER_HIST_BUCKETS	32	/* 1 ms each, last one catches the rest */
+
+struct dsi_xfer_stats {
+	unsigned long last_reset;
+	unsigned count;
+	unsigned errors;
+	u32 min_us, max_us;
+	u64 total_us;
+	unsigned hist[DSI_XFER_HIST_BUCKETS];
+};
+
 struct dsi_isr_tables {
 	struct dsi_isr_data isr_table[DSI_MAX_NR_ISRS];
 	struct dsi_isr_data isr_table_vc[4][DSI_MAX_NR_ISRS];
@@ -317,6 +330,8 @@ struct dsi_data {
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
 	spinlock_t irq_stats_lock;
 	struct dsi_irq_stats irq_stats;
+	ktime_t xfer_start_time;
+	struct dsi_xfer_stats xfer_stats;
 #endif
 	/* DSI PLL Parameter Ranges */
 	unsigned long regm_max, regn_max;
@@ -641,8 +656,43 @@ static void dsi_collect_irq_stats(struct platform_device *dsidev, u32 irqstatus,
 
 	spin_unlock(&dsi->irq_stats_lock);
 }
+
+static void dsi_xfer_stats_mark_start(struct platform_device *dsidev)
+{
+	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
+
+	dsi->xfer_start_time = ktime_get();
+}
+
+static void dsi_collect_xfer_stats(struct platform_device *dsidev, int error)
+{
+	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
+	struct dsi_xfer_stats *st = &dsi->xfer_stats;
+	unsigned long flags;
+	u32 us;
+
+	us = (u32)ktime_to_us(ktime_sub(ktime_get(), dsi->xfer_start_time));
+
+	spin_lock_irqsave(&dsi->irq_stats_lock, flags);
+
+	if (error) {
+		st->errors++;
+	} else {
+		if (st->count == 0 || us < st->min_us)
+			st->min_us = us;
+		if (us > st->max_us)
+			st->max_us = us;
+		st->total_us += us;
+		st->hist[min_t(u32, us / 1000, DSI_XFER_HIST_BUCKETS - 1)]++;
+		st->count++;
+	}
+
+	spin_unlock_irqrestore(&dsi->irq_stats_lock, flags);
+}
 #else
 #define dsi_collect_irq_stats(dsidev, irqstatus, vcstatus, ciostatus)
+#define dsi_xfer_stats_mark_start(dsidev)
+#define dsi_collect_xfer_stats(dsidev, error)
 #endif
 
 static int debug_irq;
@@ -1889,6 +1939,56 @@ static void dsi_dump_dsidev_irqs(struct platform_device *dsidev,
 #undef PIS
 }
 
+static void dsi_dump_dsidev_xfer(struct platform_device *dsidev,
+		struct seq_file *s)
+{
+	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
+	unsigned long flags;
+	struct dsi_xfer_stats stats;
+	int i;
+
+	spin_lock_irqsave(&dsi->irq_stats_lock, flags);
+
+	stats = dsi->xfer_stats;
+	memset(&dsi->xfer_stats, 0, sizeof(dsi->xfer_stats));
+	dsi->xfer_stats.last_reset = jiffies;
+
+	spin_unlock_irqrestore(&dsi->irq_stats_lock, flags);
+
+	seq_printf(s, "period %u ms\n",
+			jiffies_to_msecs(jiffies - stats.last_reset));
+
+	seq_printf(s, "transfers %u, errors %u\n", stats.count, stats.errors);
+
+	if (!stats.count)
+		return;
+
+	seq_printf(s, "min %u us, avg %llu us, max %u us\n", stats.min_us,
+			div_u64(stats.total_us, stats.count), stats.max_us);
+
+	for (i = 0; i < DSI_XFER_HIST_BUCKETS - 1; i++) {
+		if (stats.hist[i])
+			seq_printf(s, "%2d - %2d ms %10u\n", i, i + 1,
+					stats.hist[i]);
+	}
+	if (stats.hist[i])
+		seq_printf(s, "%2d+     ms %10u\n", i, stats.hist[i]);
+}
+
+static void dsi1_dump_xfer(struct seq_file *s)
+{
+	struct platform_device *dsidev = dsi_get_dsidev_from_id(0);
+
+	dsi_dump_dsidev_xfer(dsidev, s);
+}
+
+static void dsi2_dump_xfer(struct seq_file *s)
+{
+	struct platform_device *dsidev = dsi_get_dsidev_from_id(1);
+
+	dsi_dump_dsidev_xfer(dsidev, s);
+}
+
 static void dsi1_dump_irqs(struct seq_file *s)
 {
 	struct platform_device *dsidev = dsi_get_dsidev_from_id(0);
@@ -1912,11 +2012,17 @@ void dsi_create_debugfs_files_irq(struct dentry *debugfs_dir,
 	if (dsidev)
 		debugfs_create_file("dsi1_irqs", S_IRUGO, debugfs_dir,
 			&dsi1_dump_irqs, debug_fops);
+	if (dsidev)
+		debugfs_create_file("dsi1_xfer", S_IRUGO, debugfs_dir,
+			&dsi1_dump_xfer, debug_fops);
 
 	dsidev = dsi_get_dsidev_from_id(1);
 	if (dsidev)
 		debugfs_create_file("dsi2_irqs", S_IRUGO, debugfs_dir,
 			&dsi2_dump_irqs, debug_fops);
+	if (dsidev)
+		debugfs_create_file("dsi2_xfer", S_IRUGO, debugfs_dir,
+			&dsi2_dump_xfer, debug_fops);
 }
 #endif
 
@@ -3799,6 +3905,12 @@ static void dsi_config_blanking_modes(struct omap_dss_device *dssdev)
 	int hsa_blanking_mode = dssdev->panel.dsi_vm_data.hsa_blanking_mode;
 	u32 r;
 
+	/* in burst mode the time saved on the line goes to LP in HFP/BLLP */
+	if (dssdev->panel.dsi_vm_data.burst_mode) {
+		blanking_mode = 0;
+		hfp_blanking_mode = 0;
+	}
+
 	/*
 	 * 0 = TX FIFO packets sent or LPS in corresponding blanking periods
 	 * 1 = Long blanking packets are sent in corresponding blanking periods
@@ -4057,6 +4169,32 @@ static void dsi_proto_timings(struct omap_dss_device *dssdev)
 		tl = DIV_ROUND_UP(4, ndl) + (hsync_end ? hsa : 0) + t_he + hfp +
 			DIV_ROUND_UP(width_bytes + 6, ndl) + hbp;
 
+		/*
+		 * Burst mode: the pixels of a line go out at the full HS rate
+		 * and HFP is stretched so that TL still matches the DISPC line
+		 * period.  The link then rests in LP for the rest of the line.
+		 */
+		if (dssdev->panel.dsi_vm_data.burst_mode) {
+			unsigned long byteclk = dsi_get_txbyteclkhs(dsidev);
+			int tl_dispc;
+
+			tl_dispc = (int)div_u64((u64)byteclk *
+				(timings->x_res + timings->hfp +
+				 timings->hbp + timings->hsw),
+				timings->pixel_clock * 1000);
+
+			if (tl_dispc < tl) {
+				DSSERR("DSI link too slow for burst mode "
+					"(TL %d < %d)\n", tl_dispc, tl);
+			} else if (hfp + tl_dispc - tl > FLD_MASK(11, 0)) {
+				DSSERR("HFP %d too large for burst mode\n",
+					hfp + tl_dispc - tl);
+			} else {
+				hfp += tl_dispc - tl;
+				tl = tl_dispc;
+			}
+		}
+
 		DSSDBG("HBP: %d, HFP: %d, HSA: %d, TL: %d TXBYTECLKHS\n", hbp,
 			hfp, hsync_end ? hsa : 0, tl);
 		DSSDBG("VBP: %d, VFP: %d, VSA: %d, VACT: %d lines\n", vbp, vfp,
@@ -4302,7 +4440,7 @@ void dsi_disable_video_output(struct omap_dss_device *dssdev, int channel)
 EXPORT_SYMBOL(dsi_disable_video_output);
 
 static void dsi_update_screen_dispc(struct omap_dss_device *dssdev,
-		u16 w, u16 h)
+		u16 x, u16 y, u16 w, u16 h)
 {
 	struct platform_device *dsidev = dsi_get_dsidev_from_dssdev(dssdev);
 	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
@@ -4317,7 +4455,7 @@ static void dsi_update_screen_dispc(struct omap_dss_device *dssdev,
 	const unsigned channel = dsi->update_channel;
 	const unsigned line_buf_size = dsi_get_line_buf_size(dsidev);
 
-	DSSDBG("dsi_update_screen_dispc(%dx%d)\n", w, h);
+	DSSDBG("dsi_update_screen_dispc(%d,%d %dx%d)\n", x, y, w, h);
 
 	dsi_vc_config_source(dsidev, channel, DSI_VC_SOURCE_VP);
 
@@ -4360,13 +4498,14 @@ static void dsi_update_screen_dispc(struct omap_dss_device *dssdev,
 	dispc_disable_sidle();
 
 	dsi_perf_mark_start(dsidev);
+	dsi_xfer_stats_mark_start(dsidev);
 
 	r = schedule_delayed_work(&dsi->framedone_timeout_work,
 		msecs_to_jiffies(250));
 	BUG_ON(r == 0);
 	dsi_handle_lcd_en_timing_pre(dssdev, true);
 
-	dss_mgr_start_update(dssdev->manager);
+	dss_mgr_start_update(dssdev->manager, x, y, w, h);
 	dsi_handle_lcd_en_timing_post(dssdev, true);
 
 	if (dsi->te_enabled) {
@@ -4401,6 +4540,8 @@ static void dsi_handle_framedone(struct platform_device *dsidev, int error)
 		REG_FLD_MOD(dsidev, DSI_TIMING2, 1, 15, 15); /* LP_RX_TO */
 	}
 
+	dsi_collect_xfer_stats(dsidev, error);
+
 	dsi->framedone_callback(error, dsi->framedone_data);
 
 	if (!error)
@@ -4443,12 +4584,31 @@ static void dsi_framedone_irq_callback(void *data, u32 mask)
 #endif
 }
 
+/*
+ * Rounds the update region and writes the DISPC configuration for it right
+ * away.  The caller holds the bus lock, so DISPC is done with the previous
+ * frame even though DSI may still be sending it; the following
+ * omap_dsi_update(), usually called from the TE interrupt, then only has to
+ * kick off the transfer.
+ */
+int omap_dsi_prepare_update(struct omap_dss_device *dssdev,
+		u16 *x, u16 *y, u16 *w, u16 *h)
+{
+	if (!dssdev->manager)
+		return -ENODEV;
+
+	dss_mgr_get_update_region(dssdev->manager, x, y, w, h);
+
+	return dss_mgr_prepare_update(dssdev->manager, *x, *y, *w, *h);
+}
+EXPORT_SYMBOL(omap_dsi_prepare_update);
+
 int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
+		u16 x, u16 y, u16 w, u16 h,
 		void (*callback)(int, void *), void *data)
 {
 	struct platform_device *dsidev = dsi_get_dsidev_from_dssdev(dssdev);
 	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
-	u16 dw, dh;
 
 	dsi_perf_mark_setup(dsidev);
 
@@ -4457,13 +4617,11 @@ int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
 	dsi->framedone_callback = callback;
 	dsi->framedone_data = data;
 
-	dssdev->driver->get_resolution(dssdev, &dw, &dh);
-
 #ifdef DEBUG
-	dsi->update_bytes = dw * dh *
+	dsi->update_bytes = w * h *
 		dsi_get_pixel_size(dssdev->panel.dsi_pix_fmt) / 8;
 #endif
-	dsi_update_screen_dispc(dssdev, dw, dh);
+	dsi_update_screen_dispc(dssdev, x, y, w, h);
 
 	return 0;
 }
@@ -5034,6 +5192,7 @@ static int omap_dsihw_probe(struct platform_device *dsidev)
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
 	spin_lock_init(&dsi->irq_stats_lock);
 	dsi->irq_stats.last_reset = jiffies;
+	dsi->xfer_stats.last_reset = jiffies;
 #endif
 
 	mutex_init(&dsi->lock);
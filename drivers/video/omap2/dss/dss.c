@@ -840,7 +840,8 @@ static int dss_runtime_suspend(struct device *dev)
 
 static int dss_runtime_resume(struct device *dev)
 {
-	dss_restore_context();
+	if (dss_context_lost(dev))
+		dss_restore_context();
 	return 0;
 }
 
@@ -200,14 +200,22 @@ struct bus_type *dss_get_bus(void);
 struct regulator *dss_get_vdds_dsi(void);
 struct regulator *dss_get_vdds_sdi(void);
 int dss_get_ctx_loss_count(struct device *dev);
+bool dss_context_lost(struct device *dev);
 int dss_dsi_enable_pads(int dsi_id, unsigned lane_mask);
 void dss_dsi_disable_pads(int dsi_id, unsigned lane_mask);
 
 /* apply */
 void dss_apply_init(void);
+void dss_apply_uninit(void);
+void dss_dump_bandwidth(struct seq_file *s);
 int dss_mgr_wait_for_go(struct omap_overlay_manager *mgr);
 int dss_mgr_wait_for_go_ovl(struct omap_overlay *ovl);
-void dss_mgr_start_update(struct omap_overlay_manager *mgr);
+int dss_mgr_prepare_update(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h);
+void dss_mgr_start_update(struct omap_overlay_manager *mgr,
+		u16 x, u16 y, u16 w, u16 h);
+void dss_mgr_get_update_region(struct omap_overlay_manager *mgr,
+		u16 *x, u16 *y, u16 *w, u16 *h);
 int omap_dss_mgr_apply(struct omap_overlay_manager *mgr);
 /* writeback apply */
 int omap_dss_wb_mgr_apply(struct omap_overlay_manager *mgr,
@@ -437,6 +445,7 @@ void dispc_uninit_platform_driver(void);
 void dispc_dump_clocks(struct seq_file *s);
 void dispc_dump_irqs(struct seq_file *s);
 void dispc_dump_regs(struct seq_file *s);
+void dispc_dump_fifo(struct seq_file *s);
 void dispc_irq_handler(void);
 void dispc_fake_vsync_irq(void);
 
@@ -466,10 +475,16 @@ void dispc_ovl_set_global_mflag(enum omap_plane plane, bool mflag);
 void dispc_ovl_set_fifo_threshold(enum omap_plane plane, u32 low, u32 high);
 void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		u32 *fifo_low, u32 *fifo_high, bool use_fifomerge,
-		bool manual_update);
+		bool manual_update, const struct omap_overlay_info *oi,
+		unsigned long pclk);
+unsigned long dispc_ovl_bandwidth(const struct omap_overlay_info *oi,
+		const struct omap_video_timings *t);
+unsigned long dispc_ovl_min_fclk(enum omap_channel channel,
+		const struct omap_overlay_info *oi);
 int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 		bool ilace, bool replication, int x_decim, int y_decim,
 		bool five_taps, bool source_of_wb);
+int dispc_color_mode_to_bpp(enum omap_color_mode color_mode);
 int dispc_ovl_enable(enum omap_plane plane, bool enable);
 void dispc_ovl_set_channel_out(enum omap_plane plane,
 		enum omap_channel channel);
@@ -587,6 +602,7 @@ int hdmi_notify_hpd(struct omap_dss_device *dssdev, bool hpd);
 void hdmi_get_monspecs(struct omap_dss_device *dssdev);
 void hdmi_inform_hpd_to_cec(int status);
 void hdmi_inform_power_on_to_cec(int status);
+int hdmi_set_irq_wake(bool enable);
 int hdmi_runtime_get(void);
 void hdmi_runtime_put(void);
 struct hdmi_ip_data *get_hdmi_ip_data(void);
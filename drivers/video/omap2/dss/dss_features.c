@@ -870,6 +870,8 @@ static const struct ti_hdmi_ip_ops omap4_hdmi_functions = {
 	.cec_get_rx_cmd			=	ti_hdmi_4xxx_cec_get_rx_cmd,
 	.cec_read_rx_cmd		=	ti_hdmi_4xxx_cec_read_rx_cmd,
 	.cec_transmit_cmd		=	ti_hdmi_4xxx_cec_transmit_cmd,
+	.cec_start_tx			=	ti_hdmi_4xxx_cec_start_tx,
+	.cec_tx_status			=	ti_hdmi_4xxx_cec_tx_status,
 	.power_on_cec			=	ti_hdmi_4xxx_power_on_cec,
 	.power_off_cec			=	ti_hdmi_4xxx_power_off_cec,
 	.cec_int_handler		=	ti_hdmi_4xxx_cec_int_handler,
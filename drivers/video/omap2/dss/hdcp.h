@@ -112,6 +112,7 @@ struct hdcp_wait_control {
 #include <linux/io.h>
 #include <linux/slab.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 
 /***************************/
 /* HW specific definitions */
@@ -209,6 +210,27 @@ enum hdmi_states {
 	HDMI_POWERED_OFF
 };
 
+/* Authentication phases timed in debugfs hdcp/timing */
+enum hdcp_phase {
+	HDCP_PHASE_START,	/* start of frame until authentication starts */
+	HDCP_PHASE_STEP1,	/* BKSV read, An/AKSV write */
+	HDCP_PHASE_R0,		/* R0 delay and R0' check */
+	HDCP_PHASE_KSV_WAIT,	/* repeater assembling its KSV list */
+	HDCP_PHASE_STEP2,	/* KSV list read and V' check */
+	HDCP_PHASE_AUTH,	/* start of frame until authenticated */
+	HDCP_PHASE_USER,	/* each round trip to the user space daemon */
+	HDCP_PHASE_DDC,		/* each DDC transfer */
+	HDCP_PHASE_COUNT
+};
+
+struct hdcp_phase_stats {
+	u32 count;
+	u32 last_us;
+	u32 min_us;
+	u32 max_us;
+	u64 total_us;
+};
+
 struct hdcp_data {
 	void __iomem *deshdcp_base_addr;
 	struct mutex lock;
@@ -238,6 +260,12 @@ struct hdcp_data {
         int auth_state;
         int hpd_low;
         enum hdmi_states hdmi_state;
+	/* TV vsyncs still to go before HDCP_START_FRAME_EVENT, 0 if idle */
+	int vsyncs_left;
+	ktime_t phase_start[HDCP_PHASE_COUNT];
+	struct hdcp_phase_stats phase_stats[HDCP_PHASE_COUNT];
+	u32 auth_failures;
+	struct dentry *debugfs_dir;
 };
 
 extern struct hdcp_data hdcp;
@@ -270,6 +298,7 @@ extern struct hdcp_sha_in sha_input;
 #define HDCP_MAX_DDC_ERR        5
 
 #define HDCP_ENABLE_DELAY       300
+#define HDCP_ENABLE_VSYNCS      7
 #define HDCP_R0_DELAY           110
 #define HDCP_KSV_TIMEOUT_DELAY  5000
 #define HDCP_REAUTH_DELAY       100
@@ -373,6 +402,7 @@ extern struct hdcp_sha_in sha_input;
 /***************************/
 
 int hdcp_user_space_task(int flags);
+void hdcp_phase_done(enum hdcp_phase phase, ktime_t start);
 
 /* 3DES */
 int hdcp_3des_load_key(uint32_t *deshdcp_encrypted_key);
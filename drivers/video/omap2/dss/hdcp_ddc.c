@@ -237,6 +237,8 @@ static int hdcp_ddc_operation(u16 no_bytes, u8 addr, u8 *pdata,
 			      enum ddc_operation operation)
 {
 	mddc_type mddc;
+	ktime_t start = ktime_get();
+	int r;
 
 	mddc.slaveAddr	= HDCPRX_SLV;
 	mddc.offset	= 0;
@@ -256,7 +258,10 @@ static int hdcp_ddc_operation(u16 no_bytes, u8 addr, u8 *pdata,
 					     addr, no_bytes,
 					     jiffies_to_msecs(jiffies));
 
-	return hdcp_start_ddc_transfer(&mddc, operation);
+	r = hdcp_start_ddc_transfer(&mddc, operation);
+	hdcp_phase_done(HDCP_PHASE_DDC, start);
+
+	return r;
 }
 
 /*-----------------------------------------------------------------------------
@@ -99,8 +99,8 @@ static void hdcp_lib_generate_an(u8 *an)
 	WR_FIELD_32(hdcp.hdmi_wp_base_addr + HDMI_IP_CORE_SYSTEM,
 		    HDMI_IP_CORE_SYSTEM__HDCP_CTRL, 3, 3, 0);
 
-	/* Delay of 10 ms */
-	mdelay(10);
+	/* Let An free-run for 10 ms, sleeping rather than spinning */
+	usleep_range(10000, 10500);
 
 	/* Stop AN Gen */
 	WR_FIELD_32(hdcp.hdmi_wp_base_addr + HDMI_IP_CORE_SYSTEM,
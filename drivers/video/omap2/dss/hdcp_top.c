@@ -27,6 +27,9 @@
 #include <linux/completion.h>
 #include <linux/miscdevice.h>
 #include <linux/firmware.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <video/omapdss.h>
 #include "hdcp.h"
 
 struct hdcp_data hdcp;
@@ -66,6 +69,149 @@ struct completion hdcp_comp;
 
 static int hdcp_wait_re_entrance;
 
+/*------------------------------------------------------------------------------
+ * Authentication phase timing
+ *------------------------------------------------------------------------------
+ */
+static const char * const hdcp_phase_names[HDCP_PHASE_COUNT] = {
+	[HDCP_PHASE_START]	= "start",
+	[HDCP_PHASE_STEP1]	= "step1",
+	[HDCP_PHASE_R0]		= "r0",
+	[HDCP_PHASE_KSV_WAIT]	= "ksv_wait",
+	[HDCP_PHASE_STEP2]	= "step2",
+	[HDCP_PHASE_AUTH]	= "auth",
+	[HDCP_PHASE_USER]	= "user",
+	[HDCP_PHASE_DDC]	= "ddc",
+};
+
+void hdcp_phase_done(enum hdcp_phase phase, ktime_t start)
+{
+	struct hdcp_phase_stats *st = &hdcp.phase_stats[phase];
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&hdcp.spinlock, flags);
+	if (!st->count || us < st->min_us)
+		st->min_us = us;
+	if (us > st->max_us)
+		st->max_us = us;
+	st->last_us = us;
+	st->total_us += us;
+	st->count++;
+	spin_unlock_irqrestore(&hdcp.spinlock, flags);
+}
+
+static void hdcp_phase_begin(enum hdcp_phase phase)
+{
+	hdcp.phase_start[phase] = ktime_get();
+}
+
+static bool hdcp_phase_running(enum hdcp_phase phase)
+{
+	return ktime_to_ns(hdcp.phase_start[phase]) != 0;
+}
+
+static void hdcp_phase_end(enum hdcp_phase phase)
+{
+	if (!hdcp_phase_running(phase))
+		return;
+
+	hdcp_phase_done(phase, hdcp.phase_start[phase]);
+	hdcp.phase_start[phase] = ktime_set(0, 0);
+}
+
+static int hdcp_timing_show(struct seq_file *s, void *unused)
+{
+	struct hdcp_phase_stats stats[HDCP_PHASE_COUNT];
+	unsigned long flags;
+	u32 failures;
+	int i;
+
+	spin_lock_irqsave(&hdcp.spinlock, flags);
+	memcpy(stats, hdcp.phase_stats, sizeof(stats));
+	failures = hdcp.auth_failures;
+	spin_unlock_irqrestore(&hdcp.spinlock, flags);
+
+	seq_printf(s, "%-10s %8s %10s %10s %10s %10s\n", "phase", "count",
+		   "last_us", "min_us", "avg_us", "max_us");
+	for (i = 0; i < HDCP_PHASE_COUNT; i++) {
+		struct hdcp_phase_stats *st = &stats[i];
+
+		seq_printf(s, "%-10s %8u %10u %10u %10llu %10u\n",
+			   hdcp_phase_names[i], st->count, st->last_us,
+			   st->min_us, st->count ?
+			   div_u64(st->total_us, st->count) : 0,
+			   st->max_us);
+	}
+	seq_printf(s, "failures %u\n", failures);
+
+	return 0;
+}
+
+static int hdcp_timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hdcp_timing_show, inode->i_private);
+}
+
+static const struct file_operations hdcp_timing_fops = {
+	.open		= hdcp_timing_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*------------------------------------------------------------------------------
+ * Start of frame
+ *
+ * The sink needs the TV output to have been running for a few frames
+ * before it will answer authentication, so rather than guessing with a
+ * fixed delay, HDCP_START_FRAME_EVENT is queued from the dispc interrupt
+ * on the HDCP_ENABLE_VSYNCS'th vsync after the manager was enabled.
+ * HDMI, and with it dispc, stays powered for as long as the wait is
+ * armed: powering it off goes through the HPD low callback, which
+ * disarms it.
+ *------------------------------------------------------------------------------
+ */
+#define HDCP_VSYNC_IRQS (DISPC_IRQ_EVSYNC_EVEN | DISPC_IRQ_EVSYNC_ODD)
+
+static void hdcp_vsync_isr(void *arg, u32 mask)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hdcp.spinlock, flags);
+	if (hdcp.vsyncs_left > 0 && !--hdcp.vsyncs_left) {
+		omap_dispc_unregister_isr_nosync(hdcp_vsync_isr, NULL,
+						 HDCP_VSYNC_IRQS);
+		hdcp.pending_start = hdcp_submit_work(HDCP_START_FRAME_EVENT,
+						      0);
+	}
+	spin_unlock_irqrestore(&hdcp.spinlock, flags);
+}
+
+static void hdcp_stop_vsync_wait(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hdcp.spinlock, flags);
+	if (hdcp.vsyncs_left > 0) {
+		hdcp.vsyncs_left = 0;
+		omap_dispc_unregister_isr_nosync(hdcp_vsync_isr, NULL,
+						 HDCP_VSYNC_IRQS);
+	}
+	spin_unlock_irqrestore(&hdcp.spinlock, flags);
+}
+
+static void hdcp_start_vsync_wait(void)
+{
+	hdcp.vsyncs_left = HDCP_ENABLE_VSYNCS;
+	if (omap_dispc_register_isr(hdcp_vsync_isr, NULL, HDCP_VSYNC_IRQS)) {
+		HDCP_WARN("cannot wait for vsync, using fixed delay");
+		hdcp.vsyncs_left = 0;
+		hdcp.pending_start = hdcp_submit_work(HDCP_START_FRAME_EVENT,
+						      HDCP_ENABLE_DELAY);
+	}
+}
+
 static void hdcp_wq_disable(void)
 {
         printk(KERN_INFO "HDCP: disabled\n");
@@ -84,6 +230,9 @@ static void omap4_hdcp_wq_start_authentication(void)
 
         printk(KERN_INFO "HDCP: authentication start\n");
 
+	hdcp_phase_end(HDCP_PHASE_START);
+	hdcp_phase_begin(HDCP_PHASE_STEP1);
+
 	ip_data = get_hdmi_ip_data();
 
 	if (!ti_hdmi_4xxx_check_rxdet_line(ip_data)) {
@@ -105,6 +254,8 @@ static void omap4_hdcp_wq_start_authentication(void)
         } else if (status != HDCP_OK) {
                 hdcp_wq_authentication_failure();
         } else {
+                hdcp_phase_end(HDCP_PHASE_STEP1);
+                hdcp_phase_begin(HDCP_PHASE_R0);
                 hdcp.hdcp_state = HDCP_WAIT_R0_DELAY;
                 hdcp.auth_state = HDCP_STATE_AUTH_1ST_STEP;
                 hdcp.pending_wq_event = hdcp_submit_work(HDCP_R0_EXP_EVENT,
@@ -127,6 +278,8 @@ static void hdcp_wq_check_r0(void)
                         printk(KERN_INFO "HDCP: authentication step 1 "
                                          "successful - Repeater\n");
 
+                        hdcp_phase_end(HDCP_PHASE_R0);
+                        hdcp_phase_begin(HDCP_PHASE_KSV_WAIT);
                         hdcp.hdcp_state = HDCP_WAIT_KSV_LIST;
                         hdcp.auth_state = HDCP_STATE_AUTH_2ND_STEP;
                 } else {
@@ -134,6 +287,8 @@ static void hdcp_wq_check_r0(void)
                         printk(KERN_INFO "HDCP: authentication step 1 "
                                          "successful - Receiver\n");
 
+                        hdcp_phase_end(HDCP_PHASE_R0);
+                        hdcp_phase_end(HDCP_PHASE_AUTH);
                         hdcp.hdcp_state = HDCP_LINK_INTEGRITY_CHECK;
                         hdcp.auth_state = HDCP_STATE_AUTH_3RD_STEP;
 
@@ -153,6 +308,9 @@ static void hdcp_wq_step2_authentication(void)
         /* KSV list timeout is running and should be canceled */
         hdcp_cancel_work(&hdcp.pending_wq_event);
 
+        hdcp_phase_end(HDCP_PHASE_KSV_WAIT);
+        hdcp_phase_begin(HDCP_PHASE_STEP2);
+
         status = hdcp_lib_step2();
 
         if (status == -HDCP_CANCELLED_AUTH) {
@@ -164,6 +322,9 @@ static void hdcp_wq_step2_authentication(void)
                 printk(KERN_INFO "HDCP: (Repeater) authentication step 2 "
                                  "successful\n");
 
+                hdcp_phase_end(HDCP_PHASE_STEP2);
+                hdcp_phase_end(HDCP_PHASE_AUTH);
+
                 hdcp.hdcp_state = HDCP_LINK_INTEGRITY_CHECK;
                 hdcp.auth_state = HDCP_STATE_AUTH_3RD_STEP;
 
@@ -177,6 +338,16 @@ static void hdcp_wq_step2_authentication(void)
 
 static void hdcp_wq_authentication_failure(void)
 {
+	int i;
+
+	hdcp.auth_failures++;
+
+	/* Drop the partial phase, keep timing reauthentication as a whole */
+	for (i = HDCP_PHASE_START; i < HDCP_PHASE_AUTH; i++)
+		hdcp.phase_start[i] = ktime_set(0, 0);
+	if (!hdcp_phase_running(HDCP_PHASE_AUTH))
+		hdcp_phase_begin(HDCP_PHASE_AUTH);
+
         if (hdcp.hdmi_state == HDMI_STOPPED) {
                 hdcp.auth_state = HDCP_STATE_AUTH_FAILURE;
                 return;
@@ -263,6 +434,9 @@ static void omap4_hdcp_work_queue(struct work_struct *work)
         case HDCP_DISABLED:
                 /* HDCP enable control or re-authentication event */
                 if (event == HDCP_ENABLE_CTL) {
+                        hdcp.phase_start[HDCP_PHASE_START] = ktime_set(0, 0);
+                        hdcp_phase_begin(HDCP_PHASE_AUTH);
+
                         if (hdcp.en_ctrl->nb_retry == 0)
                                 hdcp.retry_cnt = HDCP_INFINITE_REAUTH;
                         else
@@ -397,6 +571,7 @@ static void hdcp_cancel_work(struct delayed_work **work)
 
 int hdcp_user_space_task(int flags)
 {
+	ktime_t start = ktime_get();
         int ret;
 
         HDCP_DBG("Wait for user space task %x\n", flags);
@@ -410,6 +585,8 @@ int hdcp_user_space_task(int flags)
         HDCP_DBG("User space task done %x\n", hdcp.hdcp_down_event);
         hdcp.hdcp_down_event = 0;
 
+	hdcp_phase_done(HDCP_PHASE_USER, start);
+
         return ret;
 }
 
@@ -442,6 +619,7 @@ static void omap4_hdcp_start_frame_cb(void)
         }
 
         /* Cancel any pending work */
+        hdcp_stop_vsync_wait();
         if (hdcp.pending_start)
                 hdcp_cancel_work(&hdcp.pending_start);
         if (hdcp.pending_wq_event)
@@ -450,8 +628,10 @@ static void omap4_hdcp_start_frame_cb(void)
         hdcp.hpd_low = 0;
         hdcp.pending_disable = 0;
         hdcp.retry_cnt = hdcp.en_ctrl->nb_retry;
-        hdcp.pending_start = hdcp_submit_work(HDCP_START_FRAME_EVENT,
-                                                        HDCP_ENABLE_DELAY);
+
+	hdcp_phase_begin(HDCP_PHASE_START);
+	hdcp_phase_begin(HDCP_PHASE_AUTH);
+	hdcp_start_vsync_wait();
 }
 
 static void omap4_hdcp_irq_cb(int status)
@@ -505,6 +685,7 @@ static void omap4_hdcp_irq_cb(int status)
                 hdcp.pending_disable = 1;       /* Used to exit on-going HDCP
                                                  * work */
                 hdcp.hpd_low = 0;               /* Used to cancel HDCP works */
+                hdcp_stop_vsync_wait();
                 if (hdcp.pending_start) {
                         pr_err("cancelling work for pending start\n");
                         hdcp_cancel_work(&hdcp.pending_start);
@@ -1198,6 +1379,11 @@ static int __init hdcp_init(void)
 #ifdef CONFIG_OMAP4_HDCP_SUPPORT
         hdcp_wait_re_entrance = 0;
         init_completion(&hdcp_comp);
+
+	hdcp.debugfs_dir = debugfs_create_dir("hdcp", NULL);
+	if (!IS_ERR_OR_NULL(hdcp.debugfs_dir))
+		debugfs_create_file("timing", S_IRUGO, hdcp.debugfs_dir, NULL,
+				    &hdcp_timing_fops);
 #endif
 
 	hdcp.workqueue = create_singlethread_workqueue("hdcp");
@@ -1238,6 +1424,9 @@ err_runtime:
 	destroy_workqueue(hdcp.workqueue);
 
 err_add_driver:
+#ifdef CONFIG_OMAP4_HDCP_SUPPORT
+	debugfs_remove_recursive(hdcp.debugfs_dir);
+#endif
 	misc_deregister(hdcp.mdev);
 
 	mutex_unlock(&hdcp.lock);
@@ -1276,9 +1465,17 @@ static void __exit hdcp_exit(void)
 	/* Un-register HDCP callbacks to HDMI library */
 	omapdss_hdmi_register_hdcp_callbacks(NULL, NULL, NULL);
 
+#ifdef CONFIG_OMAP4_HDCP_SUPPORT
+	hdcp_stop_vsync_wait();
+#endif
+
 	hdmi_runtime_put();
 
 err_handling:
+#ifdef CONFIG_OMAP4_HDCP_SUPPORT
+	debugfs_remove_recursive(hdcp.debugfs_dir);
+#endif
+
 	misc_deregister(hdcp.mdev);
 	kfree(hdcp.mdev);
 
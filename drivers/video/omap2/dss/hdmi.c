@@ -271,6 +271,15 @@ void hdmi_inform_power_on_to_cec(int status)
 		(*hdmi.hdmi_cec_enable_cb)(status);
 }
 
+/* Let the HDMI interrupt, and with it CEC, wake the system from suspend */
+int hdmi_set_irq_wake(bool enable)
+{
+	if (enable)
+		return enable_irq_wake(hdmi.hdmi_irq);
+
+	return disable_irq_wake(hdmi.hdmi_irq);
+}
+
 u8 *hdmi_read_valid_edid(void)
 {
 	int ret, i;
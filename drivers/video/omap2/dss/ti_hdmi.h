@@ -199,6 +199,12 @@ struct ti_hdmi_ip_ops {
 	int (*cec_transmit_cmd)(struct hdmi_ip_data *ip_data,
 		struct cec_tx_data *data, int *cmd_acked);
 
+	/* interrupt driven transmit, both optional */
+	int (*cec_start_tx)(struct hdmi_ip_data *ip_data,
+		struct cec_tx_data *data);
+
+	int (*cec_tx_status)(struct hdmi_ip_data *ip_data);
+
 	int (*power_on_cec)(struct hdmi_ip_data *ip_data);
 
 	int (*power_off_cec)(struct hdmi_ip_data *ip_data);
@@ -331,6 +337,9 @@ int ti_hdmi_4xxx_cec_read_rx_cmd(struct hdmi_ip_data *ip_data,
 	struct cec_rx_data *rx_data);
 int ti_hdmi_4xxx_cec_transmit_cmd(struct hdmi_ip_data *ip_data,
 	struct cec_tx_data *data, int *cmd_acked);
+int ti_hdmi_4xxx_cec_start_tx(struct hdmi_ip_data *ip_data,
+	struct cec_tx_data *data);
+int ti_hdmi_4xxx_cec_tx_status(struct hdmi_ip_data *ip_data);
 int ti_hdmi_4xxx_power_on_cec(struct hdmi_ip_data *ip_data);
 int ti_hdmi_4xxx_power_off_cec(struct hdmi_ip_data *ip_data);
 int ti_hdmi_4xxx_cec_int_handler(struct hdmi_ip_data *ip_data);
@@ -1097,8 +1097,8 @@ int ti_hdmi_4xxx_cec_get_rx_cmd(struct hdmi_ip_data *ip_data,
 }
 EXPORT_SYMBOL(ti_hdmi_4xxx_cec_get_rx_cmd);
 
-int ti_hdmi_4xxx_cec_transmit_cmd(struct hdmi_ip_data *ip_data,
-		struct cec_tx_data *data, int *cmd_acked)
+int ti_hdmi_4xxx_cec_start_tx(struct hdmi_ip_data *ip_data,
+		struct cec_tx_data *data)
 {
 	int r = -EINVAL;
 	u32 retry = HDMI_CORE_CEC_RETRY;
@@ -1180,7 +1180,7 @@ int ti_hdmi_4xxx_cec_transmit_cmd(struct hdmi_ip_data *ip_data,
 	REG_FLD_MOD(hdmi_core_cec_base(ip_data), HDMI_CEC_TRANSMIT_DATA,
 		0x1, 4, 4);
 
-	goto wait_for_ack_nack;
+	return 0;
 
 send_ping:
 
@@ -1199,60 +1199,81 @@ send_ping:
 		goto error_exit;
 	}
 
-wait_for_ack_nack:
-	pr_debug("cec_transmit_cmd wait for ack\n");
-	retry = HDMI_CEC_TX_CMD_RETRY;
-	*cmd_acked = -1;
-	do {
-		temp = hdmi_read_reg(hdmi_core_cec_base(ip_data),
-			HDMI_CEC_INT_STATUS_0);
-		/* Look for TX change event */
-		if (FLD_GET(temp, 5, 5) != 0) {
-			*cmd_acked = 1;
-			/* Clear interrupt status */
-			REG_FLD_MOD(hdmi_core_cec_base(ip_data),
-				HDMI_CEC_INT_STATUS_0, 0x1, 5, 5);
-			if (FLD_GET(temp, 2, 2) != 0) {
-				/* Clear interrupt status */
-				REG_FLD_MOD(hdmi_core_cec_base(ip_data),
-					HDMI_CEC_INT_STATUS_0, 0x1, 2, 2);
-			}
+	return 0;
 
-			r = 0;
-			break;
-		}
-		/* Wait for re-transmits to expire */
-		temp = hdmi_read_reg(hdmi_core_cec_base(ip_data),
-			HDMI_CEC_INT_STATUS_1);
-		if (FLD_GET(temp, 1, 1) == 0) {
-			/* Wait for 7 mSecs - As per CEC protocol
-			nominal bit period is ~3 msec
-			delay of >= 3 bit period before next attempt
-			*/
-			mdelay(10);
+error_exit:
 
-		} else {
-			/* Nacked ensure to clear the status */
-			temp = FLD_MOD(0x0, 1, 1, 1);
-			hdmi_write_reg(hdmi_core_cec_base(ip_data),
-				HDMI_CEC_INT_STATUS_1, temp);
-			*cmd_acked = 0;
-			r = 0;
-			break;
-		}
-		retry--;
-	} while (retry);
+	return r;
+}
+EXPORT_SYMBOL(ti_hdmi_4xxx_cec_start_tx);
 
-	if (retry == 0x0) {
-		pr_err(KERN_ERR "\nCould not send\n");
-		pr_err(KERN_ERR "\nNo ack / nack sensed\n");
-		pr_err(KERN_ERR "\nResend did not complete in : %d\n",
-			((HDMI_CEC_TX_CMD_RETRY - retry) * 10));
+/*
+ * Returns 1 once the message started by ti_hdmi_4xxx_cec_start_tx() has
+ * been acked, 0 once the hardware gave up retransmitting it, -EINPROGRESS
+ * until then.  The TX status bits are cleared as they are reported, so
+ * this is safe to call from the CEC interrupt.
+ */
+int ti_hdmi_4xxx_cec_tx_status(struct hdmi_ip_data *ip_data)
+{
+	u32 temp;
+
+	temp = hdmi_read_reg(hdmi_core_cec_base(ip_data),
+		HDMI_CEC_INT_STATUS_0);
+	/* Look for TX change event */
+	if (FLD_GET(temp, 5, 5) != 0) {
+		/* Clear TX change and TX FIFO empty status only */
+		hdmi_write_reg(hdmi_core_cec_base(ip_data),
+			HDMI_CEC_INT_STATUS_0, temp & (FLD_MASK(5, 5) |
+			FLD_MASK(2, 2)));
+		return 1;
 	}
 
-error_exit:
+	/* Re-transmits expired */
+	temp = hdmi_read_reg(hdmi_core_cec_base(ip_data),
+		HDMI_CEC_INT_STATUS_1);
+	if (FLD_GET(temp, 1, 1) != 0) {
+		/* Nacked ensure to clear the status */
+		hdmi_write_reg(hdmi_core_cec_base(ip_data),
+			HDMI_CEC_INT_STATUS_1, FLD_MOD(0x0, 1, 1, 1));
+		return 0;
+	}
 
-	return r;
+	return -EINPROGRESS;
+}
+EXPORT_SYMBOL(ti_hdmi_4xxx_cec_tx_status);
+
+int ti_hdmi_4xxx_cec_transmit_cmd(struct hdmi_ip_data *ip_data,
+		struct cec_tx_data *data, int *cmd_acked)
+{
+	u32 retry = HDMI_CEC_TX_CMD_RETRY;
+	int r;
+
+	*cmd_acked = -1;
+
+	r = ti_hdmi_4xxx_cec_start_tx(ip_data, data);
+	if (r)
+		return r;
+
+	pr_debug("cec_transmit_cmd wait for ack\n");
+	do {
+		r = ti_hdmi_4xxx_cec_tx_status(ip_data);
+		if (r != -EINPROGRESS) {
+			*cmd_acked = r;
+			return 0;
+		}
+		/* Wait for 7 mSecs - As per CEC protocol
+		nominal bit period is ~3 msec
+		delay of >= 3 bit period before next attempt
+		*/
+		mdelay(10);
+	} while (--retry);
+
+	pr_err(KERN_ERR "\nCould not send\n");
+	pr_err(KERN_ERR "\nNo ack / nack sensed\n");
+	pr_err(KERN_ERR "\nResend did not complete in : %d\n",
+		HDMI_CEC_TX_CMD_RETRY * 10);
+
+	return -EINVAL;
 }
 EXPORT_SYMBOL(ti_hdmi_4xxx_cec_transmit_cmd);
 
@@ -1321,6 +1342,14 @@ int ti_hdmi_4xxx_power_on_cec(struct hdmi_ip_data *ip_data)
 	REG_FLD_MOD(hdmi_core_cec_base(ip_data), HDMI_CEC_INT_ENABLE_0, 0x1, 1,
 		1);
 
+	/*TX change (acked) event*/
+	REG_FLD_MOD(hdmi_core_cec_base(ip_data), HDMI_CEC_INT_ENABLE_0, 0x1, 5,
+		5);
+
+	/*Retransmit count exceeded (nacked) event*/
+	REG_FLD_MOD(hdmi_core_cec_base(ip_data), HDMI_CEC_INT_ENABLE_1, 0x1, 1,
+		1);
+
 
 	/*Initialize CEC clock divider*/
 	/*CEC needs 2MHz clock hence set the devider to 24 to get
@@ -1369,9 +1398,9 @@ EXPORT_SYMBOL(ti_hdmi_4xxx_cec_int_handler);
 
 int ti_hdmi_4xxx_cec_clr_rx_int(struct hdmi_ip_data *ip_data, int cec_rx)
 {
-	/*clear CEC RX interrupts*/
-	REG_FLD_MOD(hdmi_core_cec_base(ip_data), HDMI_CEC_INT_STATUS_0, cec_rx,
-		1, 0);
+	/*clear CEC RX interrupts, leaving the write-1-to-clear TX bits*/
+	hdmi_write_reg(hdmi_core_cec_base(ip_data), HDMI_CEC_INT_STATUS_0,
+		FLD_VAL(cec_rx, 1, 0));
 	return 0;
 }
 EXPORT_SYMBOL(ti_hdmi_4xxx_cec_clr_rx_int);
@@ -208,6 +208,7 @@
 #define HDMI_CEC_INT_STATUS_1                   0x9c
 #define HDMI_CEC_INT_STATUS_0                   0x98
 #define HDMI_CEC_INT_ENABLE_0                   0x90
+#define HDMI_CEC_INT_ENABLE_1                   0x94
 #define HDMI_CEC_RX_CMD_HEADER                  0xb8
 #define HDMI_CEC_RX_COUNT                       0xB4
 #define HDMI_CEC_RX_CONTROL                     0xB0
@@ -34,6 +34,7 @@
 #include <linux/uaccess.h>
 #include <linux/sched.h>
 #include <linux/syscalls.h>
+#include <linux/math64.h>
 
 #define MODULE_NAME_DSSCOMP	"dsscomp"
 
@@ -473,6 +474,162 @@ static long setup_display(struct dsscomp_dev *cdev,
 		return 0;
 }
 
+static int wb_wait_done(struct dsscomp_dev *cdev, u32 sync_id)
+{
+	struct omap_writeback *wb = omap_dss_get_wb(0);
+	int r = 0;
+
+	dev_dbg(DEV(cdev), "WB_DONE: received sync_id %u, wb sync_id = %u\n",
+		sync_id, wb->wb_done.sync_id);
+	mutex_lock(&wb->lock);
+	if (sync_id > wb->wb_done.sync_id ||
+		(sync_id == wb->wb_done.sync_id &&
+			!wb->wb_done.is_done)) {
+		int attempts = 50;
+		while (attempts--) {
+			mutex_unlock(&wb->lock);
+			r = wait_for_completion_timeout(
+				&wb->wb_done.completion,
+				msecs_to_jiffies(50));
+
+			mutex_lock(&wb->lock);
+			if (r == 0) {
+				r = -ETIMEDOUT;
+				break;
+			}
+
+			if (sync_id <= wb->wb_done.sync_id) {
+				r = 0;
+				break;
+			}
+		}
+		if (attempts < 0) {
+			dev_info(DEV(cdev), "WB_DONE: no frame received\n");
+			r = -ETIMEDOUT;
+		}
+	}
+	mutex_unlock(&wb->lock);
+	return r;
+}
+
+/* WB composition offload statistics */
+static struct {
+	u32 frames;		/* WB passes completed */
+	u32 failed;		/* WB passes that failed or timed out */
+	u32 busy;		/* refused as the WB manager or pipes were used */
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+} wb_stats;
+static DEFINE_MUTEX(wb_mtx);
+
+static void dsscomp_dbg_wb(struct seq_file *s)
+{
+	mutex_lock(&wb_mtx);
+	seq_printf(s, "frames=%u failed=%u busy=%u\n",
+		   wb_stats.frames, wb_stats.failed, wb_stats.busy);
+	seq_printf(s, "last=%uus max=%uus avg=%uus\n", wb_stats.last_us,
+		   wb_stats.max_us, wb_stats.frames ?
+		   (u32) div_u64(wb_stats.total_us, wb_stats.frames) : 0);
+	mutex_unlock(&wb_mtx);
+}
+
+/*
+ * Compose the excess layers on the WB manager into the intermediate buffer,
+ * give the pipes back, then queue the composition for the display.
+ */
+static long wb_compose(struct dsscomp_dev *cdev,
+				struct dsscomp_wb_compose_data *d)
+{
+	struct tiler_pa_info *pas[MAX_OVERLAYS] = { NULL };
+	struct dsscomp_setup_dispc_data *pass;
+	struct omap_overlay_manager *mgr;
+	struct dss2_ovl_info *wb;
+	ktime_t start;
+	u32 i, us;
+	int r;
+
+	if (!cdev->wb_ovl || d->wb.cfg.ix != OMAP_DSS_WB ||
+	    d->num_wb_ovls > ARRAY_SIZE(d->wb_ovls))
+		return -EINVAL;
+
+	mgr = find_dss_mgr(d->wb_mgr.ix);
+	if (!mgr)
+		return -EINVAL;
+
+	pass = kzalloc(sizeof(*pass), GFP_KERNEL);
+	if (!pass)
+		return -ENOMEM;
+
+	mutex_lock(&wb_mtx);
+
+	/* the WB pass can only use pipes no display is scanning out of */
+	r = mgr->device->state == OMAP_DSS_DISPLAY_ACTIVE ? -EBUSY : 0;
+	for (i = 0; !r && i < d->num_wb_ovls; i++) {
+		struct omap_overlay *ovl;
+
+		if (d->wb_ovls[i].cfg.ix >= cdev->num_ovls) {
+			r = -EINVAL;
+			break;
+		}
+		ovl = cdev->ovls[d->wb_ovls[i].cfg.ix];
+		if (ovl->is_enabled(ovl) && ovl->manager != mgr)
+			r = -EBUSY;
+	}
+	if (r) {
+		if (r == -EBUSY)
+			wb_stats.busy++;
+		goto done;
+	}
+
+	pass->sync_id = d->dispc.sync_id;
+	pass->num_mgrs = 1;
+	pass->mgrs[0] = d->wb_mgr;
+	for (i = 0; i < d->num_wb_ovls; i++) {
+		pass->ovls[i] = d->wb_ovls[i];
+		pass->ovls[i].cfg.mgr_ix = d->wb_mgr.ix;
+	}
+	wb = pass->ovls + i;
+	*wb = d->wb;
+	wb->cfg.enabled = true;
+	wb->cfg.mgr_ix = d->wb_mgr.ix;
+	wb->cfg.wb_mode = OMAP_WB_MEM2MEM_MODE;
+	wb->cfg.wb_source = mgr->id;
+	pass->num_ovls = i + 1;
+
+	start = ktime_get();
+	r = dsscomp_gralloc_queue_ioctl(pass, NULL, NULL) ? : wb_wait_done(cdev,
+							pass->sync_id);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	/*
+	 * Disable WB and the pipes on the WB manager even if the pass failed,
+	 * and make sure this is applied before the display claims the pipes.
+	 */
+	pass->ovls[0] = *wb;
+	pass->ovls[0].cfg.enabled = false;
+	pass->num_ovls = 1;
+	dsscomp_gralloc_queue(pass, pas, false, NULL, NULL);
+	dsscomp_flush_mgr(mgr->id);
+
+	if (r) {
+		wb_stats.failed++;
+		goto done;
+	}
+
+	wb_stats.frames++;
+	wb_stats.last_us = us;
+	wb_stats.max_us = max(wb_stats.max_us, us);
+	wb_stats.total_us += us;
+	d->wb_time_us = us;
+
+	r = dsscomp_gralloc_queue_ioctl(&d->dispc, NULL, NULL);
+done:
+	mutex_unlock(&wb_mtx);
+	kfree(pass);
+	return r;
+}
+
 static void fill_cache(struct dsscomp_dev *cdev)
 {
 	unsigned long i;
@@ -546,6 +703,32 @@ static void fill_platform_info(struct dsscomp_dev *cdev)
 	p->fbmem_type = DSSCOMP_FBMEM_TILER2D;
 }
 
+static long queue_fenced(struct dsscomp_fenced_dispc_data *d)
+{
+	struct sync_fence *acquire = NULL, *release = NULL;
+	int r;
+
+	if (d->acquire_fd >= 0) {
+		acquire = sync_fence_fdget(d->acquire_fd);
+		if (!acquire)
+			return -EINVAL;
+	}
+
+	d->release_fd = -1;
+	r = dsscomp_gralloc_queue_ioctl(&d->dispc, acquire, &release);
+
+	if (release) {
+		d->release_fd = r ? -1 : get_unused_fd();
+		if (d->release_fd < 0)
+			sync_fence_put(release);
+		else
+			sync_fence_install(release, d->release_fd);
+	}
+	if (acquire)
+		sync_fence_put(acquire);
+	return r;
+}
+
 static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int r = 0;
@@ -559,6 +742,7 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			struct dss2_ovl_info ovl[MAX_OVERLAYS];
 		} m;
 		struct dsscomp_setup_dispc_data dispc;
+		struct dsscomp_fenced_dispc_data fenced;
 		struct dsscomp_display_info dis;
 		struct dsscomp_check_ovl_data chk;
 		struct dsscomp_setup_display_data sdis;
@@ -580,7 +764,16 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case DSSCIOC_SETUP_DISPC:
 	{
 		r = copy_from_user(&u.dispc, ptr, sizeof(u.dispc)) ? :
-		    dsscomp_gralloc_queue_ioctl(&u.dispc);
+		    dsscomp_gralloc_queue_ioctl(&u.dispc, NULL, NULL);
+		break;
+	}
+	case DSSCIOC_QUEUE_FENCED:
+	{
+		r = copy_from_user(&u.fenced, ptr, sizeof(u.fenced)) ? :
+		    queue_fenced(&u.fenced) ? :
+		    put_user(u.fenced.release_fd,
+			     &((struct dsscomp_fenced_dispc_data __user *)
+			       ptr)->release_fd);
 		break;
 	}
 	case DSSCIOC_QUERY_DISPLAY:
@@ -621,41 +814,27 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	}
 	case DSSCIOC_WB_DONE:
 	{
-		struct omap_writeback *wb = omap_dss_get_wb(0);
 		u32 sync_id;
-		r = copy_from_user(&sync_id, ptr, sizeof(sync_id));
-		if (r)
+		r = copy_from_user(&sync_id, ptr, sizeof(sync_id)) ? :
+		    wb_wait_done(cdev, sync_id);
+		break;
+	}
+	case DSSCIOC_WB_COMPOSE:
+	{
+		struct dsscomp_wb_compose_data *wbc;
+
+		/* too big for the stack */
+		wbc = kmalloc(sizeof(*wbc), GFP_KERNEL);
+		if (!wbc) {
+			r = -ENOMEM;
 			break;
-		dev_dbg(DEV(cdev), "WB_DONE: received sync_id %u, wb sync_id = %u\n",
-			sync_id, wb->wb_done.sync_id);
-		mutex_lock(&wb->lock);
-		if (sync_id > wb->wb_done.sync_id ||
-			(sync_id == wb->wb_done.sync_id &&
-				!wb->wb_done.is_done)) {
-			int attempts = 50;
-			while (attempts--) {
-				mutex_unlock(&wb->lock);
-				r = wait_for_completion_timeout(
-					&wb->wb_done.completion,
-					msecs_to_jiffies(50));
-
-				mutex_lock(&wb->lock);
-				if (r == 0) {
-					r = -ETIMEDOUT;
-					break;
-				}
-
-				if (sync_id <= wb->wb_done.sync_id) {
-					r = 0;
-					break;
-				}
-			}
-			if (attempts < 0) {
-				dev_info(DEV(cdev), "WB_DONE: no frame received\n");
-				r = -ETIMEDOUT;
-			}
 		}
-		mutex_unlock(&wb->lock);
+		r = copy_from_user(wbc, ptr, sizeof(*wbc)) ? :
+		    wb_compose(cdev, wbc) ? :
+		    put_user(wbc->wb_time_us,
+			     &((struct dsscomp_wb_compose_data __user *)
+			       ptr)->wb_time_us);
+		kfree(wbc);
 		break;
 	}
 	default:
@@ -722,6 +901,8 @@ static int dsscomp_probe(struct platform_device *pdev)
 			cdev->dbgfs, dsscomp_dbg_comps, &dsscomp_debug_fops);
 		debugfs_create_file("gralloc", S_IRUGO,
 			cdev->dbgfs, dsscomp_dbg_gralloc, &dsscomp_debug_fops);
+		debugfs_create_file("wb", S_IRUGO,
+			cdev->dbgfs, dsscomp_dbg_wb, &dsscomp_debug_fops);
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
 		debugfs_create_file("log", S_IRUGO,
 			cdev->dbgfs, dsscomp_dbg_events, &dsscomp_debug_fops);
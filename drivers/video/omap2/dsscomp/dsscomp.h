@@ -25,6 +25,7 @@
 #include <linux/miscdevice.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
 #include <linux/hrtimer.h>
 #endif
@@ -93,6 +94,16 @@ enum dsscomp_state {
 	DSSCOMP_STATE_DISPLAYED		= 0xD15504CA,
 };
 
+/* latency points of a composition, accounted per manager */
+enum dsscomp_lat {
+	DSSCOMP_LAT_QUEUE,	/* queued until apply started */
+	DSSCOMP_LAT_APPLY,	/* apply started until GO bit set */
+	DSSCOMP_LAT_GO,		/* GO bit set until programmed */
+	DSSCOMP_LAT_VSYNC,	/* programmed until displayed */
+	DSSCOMP_LAT_CB,		/* DSS callback until handled */
+	DSSCOMP_LAT_NUM,
+};
+
 struct dsscomp {
 	enum dsscomp_state state;
 	/*
@@ -115,6 +126,7 @@ struct dsscomp {
 	void (*extra_cb)(void *data, int status);
 	void *extra_cb_data;
 	bool must_apply;	/* whether composition must be applied */
+	struct sync_fence *acquire;	/* buffers are ready once signaled */
 
 #ifdef CONFIG_DEBUG_FS
 	struct list_head dbg_q;
@@ -122,9 +134,16 @@ struct dsscomp {
 	struct {
 		u32 t, state;
 	} dbg_log[8];
+	ktime_t dbg_lat_t;	/* time of the last latency point */
 #endif
 };
 
+/*
+ * A buffer that is not rendered in time is displayed anyway rather than
+ * stalling the display.
+ */
+#define ACQUIRE_TIMEOUT_MS	1000
+
 struct dsscomp_sync_obj {
 	int state;
 	int fd;
@@ -136,9 +155,12 @@ struct dsscomp_sync_obj {
  */
 int dsscomp_queue_init(struct dsscomp_dev *cdev);
 void dsscomp_queue_exit(void);
+void dsscomp_flush_mgr(u32 ix);
 void dsscomp_gralloc_init(struct dsscomp_dev *cdev);
 void dsscomp_gralloc_exit(void);
-int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d);
+int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d,
+				struct sync_fence *acquire,
+				struct sync_fence **release);
 int dsscomp_wait(struct dsscomp_sync_obj *sync, enum dsscomp_wait_phase phase,
 								int timeout);
 int dsscomp_state_notifier(struct notifier_block *nb,
@@ -161,6 +183,11 @@ static inline u32 tiler1d_slot_size(struct dsscomp_dev *cdev)
 	return pdata->tiler1d_slotsz;
 }
 
+static inline bool dssdev_manually_updated(struct omap_dss_device *dev)
+{
+	return dev->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE;
+}
+
 /*
  * Debug functions
  */
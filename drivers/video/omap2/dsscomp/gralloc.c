@@ -19,13 +19,20 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/dma-buf.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/sw_sync.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
 #include <video/dsscomp.h>
 #include <plat/dsscomp.h>
+#include <plat/input_boost.h>
+#include <plat/vram.h>
 #include "dsscomp.h"
 #include "tiler-utils.h"
 
@@ -33,24 +40,68 @@
 #include <linux/earlysuspend.h>
 #endif
 static bool blanked;
-static bool presentation_mode;
 
 #define NUM_TILER1D_SLOTS 2
-#define MAX_NUM_TILER1D_SLOTS 4
 
-static struct tiler1d_slot {
-	struct list_head q;
+/*
+ * TILER 1D slots are managed as buddies: each reserved slot can be split
+ * into halves, down to TILER1D_SLOT_ORDERS - 1 times, which share the TILER
+ * block of the slot they were split from.  Free slots are kept on a list per
+ * order, and free buddies are merged back in the background.  Allocation
+ * never blocks; callers fall back to scanning out of physical memory when
+ * no slot is free.
+ */
+#define TILER1D_SLOT_ORDERS 2
+
+struct tiler1d_slot {
+	struct list_head q;		/* on free_slots or a gsync's slots */
 	struct tiler_block *block_handle;
+	struct tiler1d_slot *parent;	/* slot this half was split from */
+	struct tiler1d_slot *buddy;	/* other half of parent */
 	u32 phys;
-	u32 size;
+	u32 offset;			/* first page in block_handle */
+	u32 size;			/* in pages */
 	u32 *page_map;
-	short id;
-} slots[MAX_NUM_TILER1D_SLOTS];
-static struct list_head free_slots;
+	u8 order;			/* 0 for a reserved slot */
+	bool free;
+};
+
+static struct tiler1d_slot slots[NUM_TILER1D_SLOTS];
+static struct list_head free_slots[TILER1D_SLOT_ORDERS];
 static struct dsscomp_dev *cdev;
 static DEFINE_MUTEX(mtx);
-static struct semaphore free_slots_sem =
-				__SEMAPHORE_INITIALIZER(free_slots_sem, 0);
+
+static struct {
+	u32 allocs;		/* slots handed out */
+	u32 splits;		/* slots split into buddies */
+	u32 merges;		/* buddies merged back */
+	u32 exhausted;		/* no slot was free */
+	u32 fallbacks;		/* layers scanned out without TILER */
+	u32 dropped;		/* layers that could not be mapped */
+} slot_stats;
+
+static void merge_slots_work(struct work_struct *work);
+static DECLARE_WORK(merge_work, merge_slots_work);
+
+/*
+ * Imported dma-bufs stay attached and mapped after the compositions using
+ * them are released, so that buffers flipped every frame are only looked up
+ * by the exporter once.  Idle mappings are dropped least recently used first
+ * once more than DMABUF_CACHE_SIZE buffers are known.
+ */
+#define DMABUF_CACHE_SIZE 8
+
+struct dsscomp_dmabuf {
+	struct list_head q;		/* on dmabuf_cache, most recent first */
+	struct dma_buf *dbuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	u32 paddr;
+	u32 refs;			/* compositions scanning it out */
+};
+
+static LIST_HEAD(dmabuf_cache);
+static u32 dmabuf_cached;
 
 /* gralloc composition sync object */
 struct dsscomp_gralloc_t {
@@ -58,52 +109,627 @@ struct dsscomp_gralloc_t {
 	void *cb_arg;
 	struct list_head q;
 	struct list_head slots;
+	struct dsscomp_dmabuf *dmabufs[MAX_OVERLAYS];
+	u32 num_dmabufs;
 	atomic_t refs;
 	bool early_callback;
 	bool programmed;
+	u32 seq;			/* release timeline value */
+	ktime_t queued;			/* for clone latency */
+	bool clone_displayed;
 };
 
 /* queued gralloc compositions */
 static LIST_HEAD(flip_queue);
 
+/*
+ * Release fences are points on a timeline that counts the gralloc
+ * compositions.  Compositions may release out of order, but the timeline
+ * only advances past compositions that all have been released, so a
+ * release fence also covers the compositions queued before it.
+ */
+static struct sw_sync_timeline *release_timeline;
+static u32 release_queued;	/* seq of the last queued composition */
+static u32 release_signaled;	/* timeline value */
+
 static u32 ovl_use_mask[MAX_MANAGERS];
 
-static inline bool needs_split(struct tiler1d_slot *slot)
+/*
+ * Manually updated displays are only sent the area that changed since the
+ * previous frame.  Layers are compared by buffer address and configuration,
+ * so a buffer that is redrawn in place is not noticed unless it is on a
+ * framebuffer; partial_update=0 always sends the whole display.
+ */
+static bool partial_update = true;
+module_param(partial_update, bool, 0644);
+
+static struct {
+	u32 ba, uv;
+	struct dss2_ovl_cfg cfg;
+} last_ovls[MAX_OVERLAYS];
+static u32 last_ovl_mask[MAX_MANAGERS];
+static struct dss2_mgr_info last_mgrs[MAX_MANAGERS];
+static bool last_valid[MAX_MANAGERS];
+
+static void add_damage(struct dss2_rect_t *r, struct dss2_rect_t *win)
+{
+	s32 x2, y2;
+
+	if (!win->w || !win->h)
+		return;
+
+	if (!r->w || !r->h) {
+		*r = *win;
+		return;
+	}
+
+	x2 = max(r->x + (s32) r->w, win->x + (s32) win->w);
+	y2 = max(r->y + (s32) r->h, win->y + (s32) win->h);
+	r->x = min(r->x, win->x);
+	r->y = min(r->y, win->y);
+	r->w = x2 - r->x;
+	r->h = y2 - r->y;
+}
+
+/*
+ * Return the part of the display that changed since the last frame queued
+ * to manager @ch, and remember this frame.  Called before any of the layers
+ * are mapped.
+ */
+static struct dss2_rect_t get_damage(struct dsscomp_setup_dispc_data *d,
+		u32 ch, u32 display_ix, struct omap_dss_device *dssdev)
+{
+	struct dss2_rect_t full = {
+		.w = dssdev->panel.timings.x_res,
+		.h = dssdev->panel.timings.y_res,
+	};
+	struct dss2_rect_t damage = { .w = 0 };
+	struct dss2_mgr_info *mi = NULL;
+	u32 mask = 0;
+	s32 x2, y2;
+	bool valid;
+	int i;
+
+	for (i = 0; i < d->num_mgrs; i++)
+		if (d->mgrs[i].ix == display_ix)
+			mi = d->mgrs + i;
+
+	valid = partial_update && mi && last_valid[ch] &&
+		!memcmp(mi, last_mgrs + ch, sizeof(*mi));
+
+	for (i = 0; i < d->num_ovls; i++) {
+		struct dss2_ovl_info *oi = d->ovls + i;
+		u32 ix = oi->cfg.ix;
+
+		if (oi->cfg.mgr_ix != display_ix || ix >= MAX_OVERLAYS)
+			continue;
+		mask |= 1 << ix;
+
+		if ((last_ovl_mask[ch] & (1 << ix)) &&
+		    oi->addressing != OMAP_DSS_BUFADDR_FB &&
+		    last_ovls[ix].ba == oi->ba && last_ovls[ix].uv == oi->uv &&
+		    !memcmp(&last_ovls[ix].cfg, &oi->cfg, sizeof(oi->cfg)))
+			continue;
+
+		if ((last_ovl_mask[ch] & (1 << ix)) &&
+		    last_ovls[ix].cfg.enabled)
+			add_damage(&damage, &last_ovls[ix].cfg.win);
+		if (oi->cfg.enabled)
+			add_damage(&damage, &oi->cfg.win);
+
+		last_ovls[ix].ba = oi->ba;
+		last_ovls[ix].uv = oi->uv;
+		last_ovls[ix].cfg = oi->cfg;
+	}
+
+	/* layers that are gone */
+	for (i = 0; i < MAX_OVERLAYS; i++)
+		if ((last_ovl_mask[ch] & ~mask & (1 << i)) &&
+		    last_ovls[i].cfg.enabled)
+			add_damage(&damage, &last_ovls[i].cfg.win);
+
+	last_ovl_mask[ch] = mask;
+	last_valid[ch] = mi != NULL;
+	if (mi)
+		last_mgrs[ch] = *mi;
+
+	/* clip to the display */
+	x2 = min(damage.x + (s32) damage.w, (s32) full.w);
+	y2 = min(damage.y + (s32) damage.h, (s32) full.h);
+	damage.x = max(damage.x, 0);
+	damage.y = max(damage.y, 0);
+
+	/* nothing is sent for an empty region, so resend everything */
+	if (!valid || damage.x >= x2 || damage.y >= y2)
+		return full;
+
+	damage.w = x2 - damage.x;
+	damage.h = y2 - damage.y;
+	return damage;
+}
+
+/*
+ * Clone mode mirrors the layers queued for display clone_src onto display
+ * clone_dst, scaled to fit and centered, so that user space composes only
+ * once.  The layers are put on free pipes of the clone manager when there
+ * are enough that can scale.  Otherwise (or with clone_wb=1) WB captures
+ * the source manager into a buffer that the clone shows one frame later.
+ * Nothing is cloned while user space drives clone_dst itself, or when it
+ * is not active.  clone_dst=-1 turns cloning off.
+ */
+static int clone_src;
+module_param(clone_src, int, 0644);
+static int clone_dst = -1;
+module_param(clone_dst, int, 0644);
+static bool clone_wb;
+module_param(clone_wb, bool, 0644);
+
+#define CLONE_WB_BUFS	2
+#define CLONE_WB_BPP	4	/* OMAP_DSS_COLOR_RGB24U */
+
+static struct {
+	unsigned long paddr[CLONE_WB_BUFS];
+	size_t size;
+	u32 next;		/* buffer captured into by the next frame */
+	bool valid;		/* the other buffer holds a captured frame */
+
+	/* buffers given up while compositions may still be using them */
+	unsigned long retired[CLONE_WB_BUFS];
+	size_t retired_size;
+	u32 retired_seq;	/* freed once the release timeline gets here */
+} clone_bufs;
+
+static int clone_last_ix = -1;	/* display cloned onto by the last frame */
+
+/* scanned out or written by WB at any time, so never moved */
+static struct omap_vram_client clone_vram_client = {
+	.name = "dsscomp",
+};
+
+static struct {
+	u32 ovl_frames;		/* frames cloned using pipes */
+	u32 wb_frames;		/* frames cloned using WB */
+	u32 dropped;		/* frames not cloned or not displayed */
+	u32 lat_count;
+	u32 lat_min_us, lat_max_us;
+	u64 lat_total_us;
+} clone_stats;
+
+/* mtx must be held */
+static void clone_free_retired(bool force)
+{
+	int i;
+
+	if (!clone_bufs.retired_size ||
+	    (!force && (s32) (release_signaled - clone_bufs.retired_seq) < 0))
+		return;
+
+	for (i = 0; i < CLONE_WB_BUFS; i++)
+		omap_vram_free(clone_bufs.retired[i], clone_bufs.retired_size);
+	clone_bufs.retired_size = 0;
+}
+
+/* mtx must be held */
+static int clone_alloc_bufs(size_t size)
+{
+	int i, r;
+
+	if (clone_bufs.size == size)
+		return 0;
+
+	if (clone_bufs.size) {
+		/* the previous size is still retiring */
+		if (clone_bufs.retired_size)
+			return -EBUSY;
+		memcpy(clone_bufs.retired, clone_bufs.paddr,
+		       sizeof(clone_bufs.retired));
+		clone_bufs.retired_size = clone_bufs.size;
+		clone_bufs.retired_seq = release_queued;
+		clone_bufs.size = 0;
+	}
+
+	for (i = 0; i < CLONE_WB_BUFS; i++) {
+		r = omap_vram_alloc_client(&clone_vram_client, size,
+					   clone_bufs.paddr + i, NULL);
+		if (r) {
+			while (i--)
+				omap_vram_free(clone_bufs.paddr[i], size);
+			return r;
+		}
+	}
+	clone_bufs.size = size;
+	clone_bufs.valid = false;
+	return 0;
+}
+
+static int find_mgr_info(struct dsscomp_setup_dispc_data *d, u32 display_ix)
+{
+	int i;
+
+	for (i = 0; i < d->num_mgrs; i++)
+		if (d->mgrs[i].ix == display_ix)
+			return i;
+	return -1;
+}
+
+/* return the pipes that the clone may use */
+static u32 clone_free_pipes(struct dsscomp_setup_dispc_data *d, u32 dst_ch)
+{
+	u32 used = 1 << OMAP_DSS_GFX;	/* GFX cannot scale */
+	u32 ch;
+	int i;
+
+	for (i = 0; i < d->num_ovls; i++)
+		used |= 1 << d->ovls[i].cfg.ix;
+	for (ch = 0; ch < MAX_MANAGERS; ch++)
+		if (ch != dst_ch)
+			used |= ovl_use_mask[ch];
+
+	return ~used & ((1 << cdev->num_ovls) - 1);
+}
+
+static void clone_scale(struct dss2_rect_t *r, struct dss2_rect_t *out,
+			u32 sw, u32 sh)
+{
+	r->x = out->x + r->x * (s32) out->w / (s32) sw;
+	r->y = out->y + r->y * (s32) out->h / (s32) sh;
+	r->w = r->w * out->w / sw;
+	r->h = r->h * out->h / sh;
+}
+
+/* show the layers of display src_ix on free pipes of display dst_ix */
+static bool clone_layers(struct dsscomp_setup_dispc_data *d, u32 src_ix,
+			 u32 dst_ix, u32 free, struct dss2_rect_t *out,
+			 u32 sw, u32 sh)
+{
+	u32 n = d->num_ovls, need = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (d->ovls[i].cfg.mgr_ix == src_ix &&
+		    d->ovls[i].cfg.ix != OMAP_DSS_WB && d->ovls[i].cfg.enabled)
+			need++;
+
+	if (!need || need > hweight32(free) ||
+	    n + need > ARRAY_SIZE(d->ovls))
+		return false;
+
+	for (i = 0; i < n; i++) {
+		struct dss2_ovl_info *oi = d->ovls + i;
+		struct dss2_ovl_info *c = d->ovls + d->num_ovls;
+
+		if (oi->cfg.mgr_ix != src_ix || oi->cfg.ix == OMAP_DSS_WB ||
+		    !oi->cfg.enabled)
+			continue;
+
+		*c = *oi;
+		c->cfg.ix = ffs(free) - 1;
+		c->cfg.mgr_ix = dst_ix;
+		c->cfg.mflag_en = false;
+		clone_scale(&c->cfg.win, out, sw, sh);
+		/* scan out the same buffer once it is resolved */
+		c->addressing = OMAP_DSS_BUFADDR_OVL_IX;
+		c->ba = i;
+		free &= ~(1 << c->cfg.ix);
+		d->num_ovls++;
+	}
+	return true;
+}
+
+/* capture display src_ix with WB and show the last capture on dst_ix */
+static bool clone_capture(struct dsscomp_setup_dispc_data *d, u32 src_ix,
+			  u32 dst_ix, u32 src_ch, u32 free,
+			  struct dss2_rect_t *out, u32 sw, u32 sh)
+{
+	struct dss2_ovl_info *oi;
+	u32 stride = out->w * CLONE_WB_BPP;
+	int i, r;
+
+	for (i = 0; i < d->num_ovls; i++)
+		if (d->ovls[i].cfg.ix == OMAP_DSS_WB)
+			return false;
+
+	if (!free || d->num_ovls + 2 > ARRAY_SIZE(d->ovls))
+		return false;
+
+	mutex_lock(&mtx);
+	r = clone_alloc_bufs(PAGE_ALIGN(stride * out->h));
+	mutex_unlock(&mtx);
+	if (r)
+		return false;
+
+	oi = d->ovls + d->num_ovls++;
+	memset(oi, 0, sizeof(*oi));
+	oi->cfg.ix = OMAP_DSS_WB;
+	oi->cfg.enabled = true;
+	oi->cfg.mgr_ix = src_ix;
+	oi->cfg.wb_source = src_ch;
+	oi->cfg.wb_mode = OMAP_WB_CAPTURE_MODE;
+	oi->cfg.color_mode = OMAP_DSS_COLOR_RGB24U;
+	oi->cfg.width = out->w;
+	oi->cfg.height = out->h;
+	oi->cfg.stride = stride;
+	oi->cfg.crop.w = sw;
+	oi->cfg.crop.h = sh;
+	oi->cfg.win.w = out->w;
+	oi->cfg.win.h = out->h;
+	oi->addressing = OMAP_DSS_BUFADDR_DIRECT;
+	oi->ba = clone_bufs.paddr[clone_bufs.next];
+
+	if (clone_bufs.valid) {
+		oi = d->ovls + d->num_ovls++;
+		memset(oi, 0, sizeof(*oi));
+		oi->cfg.ix = ffs(free) - 1;
+		oi->cfg.enabled = true;
+		oi->cfg.mgr_ix = dst_ix;
+		oi->cfg.color_mode = OMAP_DSS_COLOR_RGB24U;
+		oi->cfg.global_alpha = 255;
+		oi->cfg.width = out->w;
+		oi->cfg.height = out->h;
+		oi->cfg.stride = stride;
+		oi->cfg.crop.w = out->w;
+		oi->cfg.crop.h = out->h;
+		oi->cfg.win = *out;
+		oi->addressing = OMAP_DSS_BUFADDR_DIRECT;
+		oi->ba = clone_bufs.paddr[clone_bufs.next ^ 1];
+	}
+
+	clone_bufs.next ^= 1;
+	clone_bufs.valid = true;
+	return true;
+}
+
+/*
+ * Add the clone to a gralloc composition.  Returns the display index that
+ * is cloned onto, or -1.  Overlays added here do not need mapping.
+ */
+static int clone_setup(struct dsscomp_setup_dispc_data *d, bool blank)
 {
-	return slot->size == tiler1d_slot_size(cdev) >> PAGE_SHIFT;
+	struct omap_dss_device *src, *dst;
+	struct dss2_rect_t out;
+	u32 src_ix = clone_src, dst_ix = clone_dst, sw, sh, tw, th, free;
+	int mi, r = -1;
+
+	if (blank || clone_dst < 0 || src_ix >= cdev->num_displays ||
+	    dst_ix >= cdev->num_displays || src_ix == dst_ix)
+		goto off;
+
+	src = cdev->displays[src_ix];
+	dst = cdev->displays[dst_ix];
+	if (!src || !dst || !src->manager || !dst->manager ||
+	    dst->state != OMAP_DSS_DISPLAY_ACTIVE)
+		goto off;
+
+	/* user space is driving the clone display */
+	mi = find_mgr_info(d, src_ix);
+	if (mi < 0 || find_mgr_info(d, dst_ix) >= 0)
+		goto off;
+
+	if (d->num_mgrs >= ARRAY_SIZE(d->mgrs))
+		goto drop;
+
+	/* fit the source into the clone keeping its aspect ratio */
+	sw = src->panel.timings.x_res;
+	sh = src->panel.timings.y_res;
+	tw = dst->panel.timings.x_res;
+	th = dst->panel.timings.y_res;
+	if (!sw || !sh || !tw || !th)
+		goto drop;
+	if (tw * sh > th * sw) {
+		out.h = th;
+		out.w = sw * th / sh & ~1;
+	} else {
+		out.w = tw;
+		out.h = sh * tw / sw & ~1;
+	}
+	out.x = (tw - out.w) / 2;
+	out.y = (th - out.h) / 2;
+
+	free = clone_free_pipes(d, dst->manager->id);
+
+	if (!clone_wb && clone_layers(d, src_ix, dst_ix, free, &out, sw, sh)) {
+		clone_stats.ovl_frames++;
+	} else if (!dssdev_manually_updated(src) &&
+		   clone_capture(d, src_ix, dst_ix, src->manager->id, free,
+				 &out, sw, sh)) {
+		clone_stats.wb_frames++;
+	} else {
+		goto drop;
+	}
+
+	/* the clone manager shows the source background */
+	d->mgrs[d->num_mgrs] = d->mgrs[mi];
+	d->mgrs[d->num_mgrs].ix = dst_ix;
+	d->num_mgrs++;
+	r = dst_ix;
+	goto done;
+
+drop:
+	clone_stats.dropped++;
+off:
+	clone_bufs.valid = false;
+
+	/* take the layers off the display that was cloned onto */
+	if (clone_last_ix >= 0 && find_mgr_info(d, clone_last_ix) < 0 &&
+	    d->num_mgrs < ARRAY_SIZE(d->mgrs)) {
+		memset(d->mgrs + d->num_mgrs, 0, sizeof(*d->mgrs));
+		d->mgrs[d->num_mgrs].ix = clone_last_ix;
+		d->mgrs[d->num_mgrs].alpha_blending = true;
+		d->num_mgrs++;
+	}
+done:
+	clone_last_ix = r;
+	return r;
 }
 
-static struct tiler1d_slot *split_slots(struct tiler1d_slot *slot);
-static struct tiler1d_slot *merge_slots(struct tiler1d_slot *slot);
-static struct tiler1d_slot *alloc_tiler_slot(void);
+static struct tiler1d_slot *alloc_tiler_slot(int order);
 
 static void unpin_tiler_blocks(struct list_head *slots)
 {
-	struct tiler1d_slot *slot;
+	struct tiler1d_slot *slot, *slot_;
+
+	/* unpin any tiler memory and free tiler slots */
+	list_for_each_entry_safe(slot, slot_, slots, q) {
+		tiler_unpin_range(slot->block_handle, slot->offset,
+				  slot->size);
+		slot->free = true;
+		list_move(&slot->q, &free_slots[slot->order]);
+	}
 
-	/* unpin any tiler memory */
-	list_for_each_entry(slot, slots, q) {
-		tiler_unpin(slot->block_handle);
-		up(&free_slots_sem);
+	schedule_work(&merge_work);
+}
+
+static void free_dmabuf(struct dsscomp_dmabuf *db)
+{
+	list_del(&db->q);
+	dmabuf_cached--;
+	dma_buf_unmap_attachment(db->attach, db->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(db->dbuf, db->attach);
+	dma_buf_put(db->dbuf);
+	kfree(db);
+}
+
+/*
+ * Get the scan-out mapping of a dma-buf, attaching to it if it is not
+ * cached.  DSS can only scan out physically contiguous or TILER buffers.
+ * Must be called with mtx held, from the context owning the fd.
+ */
+static struct dsscomp_dmabuf *get_dmabuf(int fd)
+{
+	struct dsscomp_dmabuf *db, *db_;
+	struct dma_buf *dbuf;
+	struct scatterlist *sg;
+	dma_addr_t next;
+	int i, r;
+
+	dbuf = dma_buf_get(fd);
+	if (IS_ERR(dbuf))
+		return ERR_CAST(dbuf);
+
+	list_for_each_entry(db, &dmabuf_cache, q) {
+		if (db->dbuf == dbuf) {
+			dma_buf_put(dbuf);
+			goto found;
+		}
 	}
 
-	/* free tiler slots */
-	list_splice_init(slots, &free_slots);
+	list_for_each_entry_safe_reverse(db, db_, &dmabuf_cache, q) {
+		if (dmabuf_cached < DMABUF_CACHE_SIZE)
+			break;
+		if (!db->refs)
+			free_dmabuf(db);
+	}
+
+	db = kzalloc(sizeof(*db), GFP_KERNEL);
+	if (!db) {
+		r = -ENOMEM;
+		goto fail_put;
+	}
+
+	db->attach = dma_buf_attach(dbuf, DEV(cdev));
+	if (IS_ERR(db->attach)) {
+		r = PTR_ERR(db->attach);
+		goto fail_free;
+	}
+
+	db->sgt = dma_buf_map_attachment(db->attach, DMA_TO_DEVICE);
+	if (IS_ERR(db->sgt)) {
+		r = PTR_ERR(db->sgt);
+		goto fail_detach;
+	}
+
+	next = sg_dma_address(db->sgt->sgl);
+	for_each_sg(db->sgt->sgl, sg, db->sgt->nents, i) {
+		if (sg_dma_address(sg) != next) {
+			r = -EINVAL;
+			goto fail_unmap;
+		}
+		next += sg_dma_len(sg);
+	}
+
+	db->dbuf = dbuf;
+	db->paddr = sg_dma_address(db->sgt->sgl);
+	list_add(&db->q, &dmabuf_cache);
+	dmabuf_cached++;
+found:
+	list_move(&db->q, &dmabuf_cache);
+	db->refs++;
+	return db;
+
+fail_unmap:
+	dma_buf_unmap_attachment(db->attach, db->sgt, DMA_TO_DEVICE);
+fail_detach:
+	dma_buf_detach(dbuf, db->attach);
+fail_free:
+	kfree(db);
+fail_put:
+	dma_buf_put(dbuf);
+	return ERR_PTR(r);
+}
+
+static void put_dmabufs(struct dsscomp_gralloc_t *gsync)
+{
+	while (gsync->num_dmabufs)
+		gsync->dmabufs[--gsync->num_dmabufs]->refs--;
+}
+
+/* number of TILER 1D pages needed to map a layer */
+static u32 ovl_1d_pages(struct dss2_ovl_info *oi)
+{
+	u32 size = oi->cfg.stride * oi->cfg.height;
+
+	if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
+		size += size >> 2;
+	return DIV_ROUND_UP(size, PAGE_SIZE);
 }
 
+/*
+ * Scan out a layer that could not be mapped into TILER 1D directly from
+ * its pages, if they happen to be physically contiguous.
+ */
+static bool map_phys_fallback(struct dss2_ovl_info *oi,
+			      struct tiler_pa_info *pa, u32 size)
+{
+	u32 i;
+
+	if (pa->num_pg < size)
+		return false;
+	for (i = 1; i < size; i++)
+		if (pa->mem[i] != pa->mem[0] + (i << PAGE_SHIFT))
+			return false;
+
+	oi->ba = pa->mem[0] + (oi->ba & ~PAGE_MASK);
+	if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
+		oi->uv = oi->ba + oi->cfg.stride * oi->cfg.height;
+	return true;
+}
+
+static int gralloc_queue(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			bool early_callback,
+			struct sync_fence *acquire,
+			struct sync_fence **release,
+			void (*cb_fn)(void *, int), void *cb_arg);
+
 static void dsscomp_gralloc_cb(void *data, int status)
 {
 	struct dsscomp_gralloc_t *gsync = data, *gsync_;
 	bool early_cbs = true;
+	u32 release;
 	LIST_HEAD(done);
 
+	if (status & DSS_COMPLETION_DISPLAYED)
+		omap_input_boost_frame();
+
 	mutex_lock(&mtx);
 	if (gsync->early_callback && status == DSS_COMPLETION_PROGRAMMED)
 		gsync->programmed = true;
 
 	if (status & DSS_COMPLETION_RELEASED) {
-		if (atomic_dec_and_test(&gsync->refs))
+		if (atomic_dec_and_test(&gsync->refs)) {
 			unpin_tiler_blocks(&gsync->slots);
+			put_dmabufs(gsync);
+		}
 
 		log_event(0, 0, gsync, "--refs=%d on %s",
 				atomic_read(&gsync->refs),
@@ -124,8 +750,18 @@ static void dsscomp_gralloc_cb(void *data, int status)
 		if (gsync->refs.counter == 0)
 			list_move_tail(&gsync->q, &done);
 	}
+
+	/* advance release timeline up to the oldest composition in use */
+	release = (list_empty(&flip_queue) ? release_queued :
+		   list_first_entry(&flip_queue, typeof(*gsync), q)->seq - 1) -
+		  release_signaled;
+	release_signaled += release;
+	clone_free_retired(false);
 	mutex_unlock(&mtx);
 
+	if (release && release_timeline)
+		sw_sync_timeline_inc(release_timeline, release);
+
 	/* call back for completed composition with mutex unlocked */
 	list_for_each_entry_safe(gsync, gsync_, &done, q) {
 		if (debug & DEBUG_GRALLOC_PHASES)
@@ -140,10 +776,35 @@ static void dsscomp_gralloc_cb(void *data, int status)
 	}
 }
 
+static void dsscomp_gralloc_clone_cb(void *data, int status)
+{
+	struct dsscomp_gralloc_t *gsync = data;
+
+	mutex_lock(&mtx);
+	if ((status & DSS_COMPLETION_DISPLAYED) && !gsync->clone_displayed) {
+		u32 us = ktime_to_us(ktime_sub(ktime_get(), gsync->queued));
+
+		gsync->clone_displayed = true;
+		if (!clone_stats.lat_count || us < clone_stats.lat_min_us)
+			clone_stats.lat_min_us = us;
+		clone_stats.lat_max_us = max(clone_stats.lat_max_us, us);
+		clone_stats.lat_total_us += us;
+		clone_stats.lat_count++;
+	} else if ((status & DSS_COMPLETION_RELEASED) &&
+		   !gsync->clone_displayed) {
+		clone_stats.dropped++;
+	}
+	mutex_unlock(&mtx);
+
+	dsscomp_gralloc_cb(data, status);
+}
+
 /* This is just test code for now that does the setup + apply.
    It still uses userspace virtual addresses, but maps non
    TILER buffers into 1D */
-int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
+int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d,
+				struct sync_fence *acquire,
+				struct sync_fence **release)
 {
 	struct tiler_pa_info *pas[MAX_OVERLAYS];
 	s32 ret;
@@ -156,6 +817,10 @@ int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
 
 		pas[i] = NULL;
 
+		/* dma-bufs are resolved when queued */
+		if (oi->addressing == OMAP_DSS_BUFADDR_DMABUF)
+			continue;
+
 		/* only supporting DIRECT buffer types */
 
 		/* assume virtual NV12 for now */
@@ -172,7 +837,7 @@ int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
 				PAGE_ALIGN(oi->cfg.height * oi->cfg.stride +
 					(addr & ~PAGE_MASK)) >> PAGE_SHIFT);
 	}
-	ret = dsscomp_gralloc_queue(d, pas, false, NULL, NULL);
+	ret = gralloc_queue(d, pas, false, acquire, release, NULL, NULL);
 	for (i = 0; i < d->num_ovls; i++)
 		tiler_pa_free(pas[i]);
 	return ret;
@@ -211,9 +876,29 @@ bool dsscomp_check_mflag(struct dsscomp_setup_dispc_data *d)
 	return true;
 }
 
-int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
+static struct sync_fence *release_fence(u32 seq)
+{
+	struct sync_pt *pt;
+	struct sync_fence *fence;
+
+	if (!release_timeline)
+		return NULL;
+
+	pt = sw_sync_pt_create(release_timeline, seq);
+	if (!pt)
+		return NULL;
+
+	fence = sync_fence_create("dsscomp_release", pt);
+	if (!fence)
+		sync_pt_free(pt);
+	return fence;
+}
+
+static int gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			struct tiler_pa_info **pas,
 			bool early_callback,
+			struct sync_fence *acquire,
+			struct sync_fence **release,
 			void (*cb_fn)(void *, int), void *cb_arg)
 {
 	u32 i;
@@ -226,7 +911,8 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	u32 mgr_set_mask = 0;
 	u32 ovl_set_mask = 0;
 	struct tiler1d_slot *slot = NULL;
-	u32 slot_used = 0;
+	bool slot_failed = false;
+	u32 slot_used = 0, slot_need = 0;
 #ifdef CONFIG_DEBUG_FS
 	u32 ms = ktime_to_ms(ktime_get());
 #endif
@@ -235,6 +921,9 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	struct dsscomp_gralloc_t *gsync;
 	struct dss2_rect_t win = { .w = 0 };
 	bool use_mflag = false;
+	struct tiler_pa_info *clone_pas[MAX_OVERLAYS] = { NULL };
+	int clone_ix;
+	u32 clone_ch = MAX_MANAGERS;
 
 	/* reserve tiler areas if not already done so */
 	dsscomp_gralloc_init(cdev);
@@ -253,6 +942,8 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	gsync->cb_fn = cb_fn;
 	gsync->refs.counter = 1;
 	gsync->early_callback = early_callback;
+	gsync->seq = ++release_queued;
+	gsync->queued = ktime_get();
 	INIT_LIST_HEAD(&gsync->slots);
 	list_add_tail(&gsync->q, &flip_queue);
 	if (debug & DEBUG_GRALLOC_PHASES)
@@ -272,14 +963,31 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 
 	mutex_unlock(&mtx);
 
+	if (release)
+		*release = release_fence(gsync->seq);
+
 	d->num_mgrs = min_t(u16, d->num_mgrs, ARRAY_SIZE(d->mgrs));
 	d->num_ovls = min_t(u16, d->num_ovls, ARRAY_SIZE(d->ovls));
 
 	memset(comp, 0, sizeof(comp));
 	memset(ovl_new_use_mask, 0, sizeof(ovl_new_use_mask));
 
-	if (skip || !dsscomp_is_any_device_active())
+	if (skip || !dsscomp_is_any_device_active()) {
+		memset(last_valid, 0, sizeof(last_valid));
+		/* buffers are released right away, so they must be ready */
+		if (acquire)
+			sync_fence_wait(acquire, ACQUIRE_TIMEOUT_MS);
 		goto skip_comp;
+	}
+
+	/* layers added for the clone are not mapped, so have no pa info */
+	if (pas) {
+		memcpy(clone_pas, pas, sizeof(*pas) * d->num_ovls);
+		pas = clone_pas;
+	}
+	clone_ix = clone_setup(d, !pas);
+	if (clone_ix >= 0)
+		clone_ch = cdev->displays[clone_ix]->manager->id;
 
 	d->mode = DSSCOMP_SETUP_DISPLAY;
 
@@ -313,6 +1021,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	for (ch = 0; ch < MAX_MANAGERS; ch++) {
 		u32 display_ix;
 		struct omap_dss_device *dssdev;
+		struct dss2_rect_t upd;
 
 		if (!(mgr_set_mask & (1 << ch)))
 			continue;
@@ -342,7 +1051,11 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		if (((win.w - win.x) * (win.h - win.y)) >= FULLHD_RESOLUTION)
 			use_mflag = dsscomp_check_mflag(d);
 
-		r = dsscomp_setup(comp[ch], d->mode, win);
+		upd = win;
+		if (dssdev_manually_updated(dssdev))
+			upd = get_damage(d, ch, display_ix, dssdev);
+
+		r = dsscomp_setup(comp[ch], d->mode, upd);
 		if (r)
 			dev_err(DEV(cdev), "failed to setup comp (%d)\n", r);
 	}
@@ -355,6 +1068,15 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			dev_err(DEV(cdev), "failed to set mgr%d (%d)\n", ch, r);
 	}
 
+	/* size the TILER 1D slot for all layers that need to be mapped */
+	for (i = 0; pas && i < d->num_ovls; i++) {
+		struct dss2_ovl_info *oi = d->ovls + i;
+
+		if (pas[i] && oi->cfg.enabled &&
+		    oi->addressing == OMAP_DSS_BUFADDR_DIRECT)
+			slot_need += ovl_1d_pages(oi);
+	}
+
 	/* NOTE: none of the dsscomp sets should fail as composition is new */
 	for (i = 0; i < d->num_ovls; i++) {
 		struct dss2_ovl_info *oi = d->ovls + i;
@@ -417,6 +1139,41 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			oi->ba += fbi->fix.smem_start;
 			oi->uv += fbi_uv->fix.smem_start;
 			goto skip_map1d;
+		} else if (oi->addressing == OMAP_DSS_BUFADDR_DMABUF) {
+			/* ba is the fd, uv the offset of the uv plane */
+			struct dsscomp_dmabuf *db;
+			size_t hs_size = oi->cfg.height * oi->cfg.stride;
+
+			if (!oi->cfg.enabled)
+				goto skip_map1d;
+
+			mutex_lock(&mtx);
+			db = get_dmabuf(oi->ba);
+			if (!IS_ERR(db))
+				gsync->dmabufs[gsync->num_dmabufs++] = db;
+			mutex_unlock(&mtx);
+
+			if (IS_ERR(db)) {
+				dev_err(DEV(cdev), "cannot scan out dma-buf "
+					"%d (%ld)\n", oi->ba, PTR_ERR(db));
+				goto skip_buffer;
+			}
+
+			if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12) {
+				if (!oi->uv)
+					oi->uv = hs_size;
+				hs_size = max_t(size_t, hs_size,
+						oi->uv + (hs_size >> 1));
+			}
+			if (hs_size > db->dbuf->size) {
+				WARN(1, "image outside of dma-buf");
+				goto skip_buffer;
+			}
+
+			oi->ba = db->paddr;
+			if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
+				oi->uv += db->paddr;
+			goto skip_map1d;
 		} else if (oi->addressing != OMAP_DSS_BUFADDR_DIRECT) {
 			goto skip_buffer;
 		}
@@ -427,35 +1184,41 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		if (!pas[i] || !oi->cfg.enabled)
 			goto skip_map1d;
 
-		if (!slot) {
+		if (!slot && !slot_failed) {
+			int order = TILER1D_SLOT_ORDERS - 1;
+
+			/* use the smallest slot that fits all layers */
+			while (order && slot_need >
+			       (tiler1d_slot_size(cdev) >> PAGE_SHIFT) >> order)
+				order--;
+
 			mutex_lock(&mtx);
-			/* separate comp for tv means presentation mode */
-			if (d->num_mgrs == 1 && d->mgrs[0].ix == 1)
-				presentation_mode = true;
-			else if (d->num_mgrs == 2)
-				presentation_mode = false;
-
-			slot = alloc_tiler_slot();
-			if (IS_ERR_OR_NULL(slot)) {
-				dev_warn(DEV(cdev), "could not obtain "
-							"tiler slot");
+			slot = alloc_tiler_slot(order);
+			if (IS_ERR(slot)) {
 				slot = NULL;
-				mutex_unlock(&mtx);
-				goto skip_buffer;
+				slot_failed = true;
+			} else {
+				list_move(&slot->q, &gsync->slots);
 			}
-			list_move(&slot->q, &gsync->slots);
 			mutex_unlock(&mtx);
 		}
 
-		size = oi->cfg.stride * oi->cfg.height;
-		if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
-			size += size >> 2;
-		size = DIV_ROUND_UP(size, PAGE_SIZE);
+		size = ovl_1d_pages(oi);
+
+		if (!slot || slot_used + size > slot->size) {
+			if (map_phys_fallback(oi, pas[i], size)) {
+				slot_stats.fallbacks++;
+				goto skip_map1d;
+			}
 
-		if (slot_used + size > slot->size) {
-			dev_err(DEV(cdev), "tiler slot not big enough for "
-					"frame %d + %d > %d", slot_used, size,
-					slot->size);
+			slot_stats.dropped++;
+			if (slot)
+				dev_err(DEV(cdev), "tiler slot not big enough "
+					"for frame %d + %d > %d", slot_used,
+					size, slot->size);
+			else
+				dev_warn(DEV(cdev), "could not obtain "
+							"tiler slot");
 			goto skip_buffer;
 		}
 
@@ -487,12 +1250,12 @@ skip_map1d:
 	}
 
 	if (slot && slot_used) {
-		r = tiler_pin_phys(slot->block_handle, slot->page_map,
-						slot_used);
+		r = tiler_pin_phys_range(slot->block_handle, slot->offset,
+					 slot->page_map, slot_used);
 		if (r)
 			dev_err(DEV(cdev), "failed to pin %d pages into"
 				" %d-pg slots (%d)\n", slot_used,
-				tiler1d_slot_size(cdev) >> PAGE_SHIFT, r);
+				slot->size, r);
 	}
 
 	for (ch = 0; ch < MAX_MANAGERS; ch++) {
@@ -513,17 +1276,24 @@ skip_map1d:
 		}
 
 		/* associate dsscomp objects with this gralloc composition */
-		comp[ch]->extra_cb = dsscomp_gralloc_cb;
+		comp[ch]->extra_cb = ch == clone_ch ?
+			dsscomp_gralloc_clone_cb : dsscomp_gralloc_cb;
 		comp[ch]->extra_cb_data = gsync;
+		if (acquire) {
+			get_file(acquire->file);
+			comp[ch]->acquire = acquire;
+		}
 		atomic_inc(&gsync->refs);
 		log_event(0, ms, gsync, "++refs=%d for [%p]",
 				atomic_read(&gsync->refs), (u32) comp[ch]);
 
 		r = dsscomp_delayed_apply(comp[ch]);
-		if (r)
+		if (r) {
 			dev_err(DEV(cdev), "failed to apply comp (%d)\n", r);
-		else
+			last_valid[ch] = false;
+		} else {
 			ovl_use_mask[ch] = ovl_new_use_mask[ch];
+		}
 	}
 skip_comp:
 	/* release sync object ref - this completes unapplied compositions */
@@ -533,8 +1303,31 @@ skip_comp:
 
 	return r;
 }
+
+int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			bool early_callback,
+			void (*cb_fn)(void *, int), void *cb_arg)
+{
+	return gralloc_queue(d, pas, early_callback, NULL, NULL, cb_fn, cb_arg);
+}
 EXPORT_SYMBOL(dsscomp_gralloc_queue);
 
+/*
+ * Queues a composition that is applied once acquire is signaled, without
+ * blocking the caller.  The caller keeps its reference to acquire.  A
+ * release fence is returned in *release if it could be created.
+ */
+int dsscomp_gralloc_queue_fence(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			struct sync_fence *acquire,
+			struct sync_fence **release,
+			void (*cb_fn)(void *, int), void *cb_arg)
+{
+	return gralloc_queue(d, pas, false, acquire, release, cb_fn, cb_arg);
+}
+EXPORT_SYMBOL(dsscomp_gralloc_queue_fence);
+
 #ifdef CONFIG_EARLYSUSPEND
 static int blank_complete;
 static DECLARE_WAIT_QUEUE_HEAD(early_suspend_wq);
@@ -600,16 +1393,45 @@ void dsscomp_dbg_gralloc(struct seq_file *s)
 	struct dsscomp_gralloc_t *g;
 	struct tiler1d_slot *t;
 	struct dsscomp *c;
-#ifdef CONFIG_DSSCOMP_DEBUG_LOG
-		int i;
-#endif
+	int i;
+
+	mutex_lock(&mtx);
+	seq_printf(s, "TILER1D SLOTS\n\n  free=[");
+	for (i = 0; free_slots[0].next && i < TILER1D_SLOT_ORDERS; i++) {
+		list_for_each_entry(t, &free_slots[i], q)
+			seq_printf(s, " %08x+%u", t->phys, t->size);
+	}
+	mutex_unlock(&mtx);
+	seq_printf(s, " ]\n  allocs=%u splits=%u merges=%u exhausted=%u "
+		   "fallbacks=%u dropped=%u\n\n", slot_stats.allocs,
+		   slot_stats.splits, slot_stats.merges, slot_stats.exhausted,
+		   slot_stats.fallbacks, slot_stats.dropped);
+
+	seq_printf(s, "RELEASE TIMELINE\n\n  queued=%u signaled=%u\n\n",
+		   release_queued, release_signaled);
+
+	mutex_lock(&mtx);
+	seq_printf(s, "CLONE\n\n  display%d => display%d%s\n"
+		   "  ovl_frames=%u wb_frames=%u dropped=%u\n",
+		   clone_src, clone_dst, clone_wb ? " (wb)" : "",
+		   clone_stats.ovl_frames, clone_stats.wb_frames,
+		   clone_stats.dropped);
+	if (clone_stats.lat_count)
+		seq_printf(s, "  latency min=%uus avg=%lluus max=%uus\n",
+			   clone_stats.lat_min_us,
+			   div_u64(clone_stats.lat_total_us,
+				   clone_stats.lat_count),
+			   clone_stats.lat_max_us);
+	seq_printf(s, "  wb_bufs=%zu bytes retiring=%zu bytes\n\n",
+		   clone_bufs.size, clone_bufs.retired_size);
+	mutex_unlock(&mtx);
 
 	mutex_lock(&dbg_mtx);
 	seq_printf(s, "ACTIVE GRALLOC FLIPS\n\n");
 	list_for_each_entry(g, &flip_queue, q) {
 		char *sep = "";
-		seq_printf(s, "  [%p] (refs=%d)\n"
-			   "    slots=[", g, atomic_read(&g->refs));
+		seq_printf(s, "  [%p] (refs=%d seq=%u)\n"
+			   "    slots=[", g, atomic_read(&g->refs), g->seq);
 		list_for_each_entry(t, &g->slots, q) {
 			seq_printf(s, "%s%08x", sep, t->phys);
 			sep = ", ";
@@ -672,15 +1494,20 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 	if (!cdev) {
 		cdev = cdev_;
 
+		release_timeline = sw_sync_timeline_create("dsscomp");
+		if (!release_timeline)
+			pr_err("could not create release timeline\n");
+
+		omap_vram_register_client(&clone_vram_client);
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 		register_early_suspend(&early_suspend_info);
 #endif
 	}
 
-	if (!free_slots.next) {
-		INIT_LIST_HEAD(&free_slots);
-		for (i = 0; i < MAX_NUM_TILER1D_SLOTS; i++)
-			slots[i].id = -1;
+	if (!free_slots[0].next) {
+		for (i = 0; i < TILER1D_SLOT_ORDERS; i++)
+			INIT_LIST_HEAD(&free_slots[i]);
 
 		for (i = 0; i < NUM_TILER1D_SLOTS; i++) {
 			struct tiler_block *block_handle =
@@ -699,9 +1526,8 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 				tiler_unpin(block_handle);
 				break;
 			}
-			slots[i].id = i;
-			list_add(&slots[i].q, &free_slots);
-			up(&free_slots_sem);
+			slots[i].free = true;
+			list_add(&slots[i].q, &free_slots[0]);
 		}
 		/* reset free_slots if no TILER memory could be reserved */
 		if (!i)
@@ -709,118 +1535,135 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 	}
 }
 
-static struct tiler1d_slot *alloc_tiler_slot(void)
+/*
+ * Split a slot that is on no list into two buddies.  The second half goes on
+ * the free list and the first one is returned.  Caller must hold mtx.
+ */
+static struct tiler1d_slot *split_slot(struct tiler1d_slot *slot)
 {
-	struct tiler1d_slot *slot, *ret;
-	if (down_timeout(&free_slots_sem,
-			msecs_to_jiffies(100))) {
-		return ERR_PTR(-ETIME);
-	}
-	slot = list_first_entry(&free_slots, typeof(*slot), q);
-	if (presentation_mode && needs_split(slot)) {
-		ret = split_slots(slot);
-		if (IS_ERR_OR_NULL(ret))
-			goto err;
-		dev_dbg(DEV(cdev),
-			"slot split, size %u block 0x%x\n",
-			slot->size, slot->phys);
-	} else if (!presentation_mode && !needs_split(slot)) {
-		ret = merge_slots(slot);
-		if (IS_ERR_OR_NULL(ret))
-			goto err;
-		dev_dbg(DEV(cdev),
-			"slot merged, size %u ptr 0x%x\n",
-			slot->size, slot->phys);
+	struct tiler1d_slot *half;
+	int i;
+
+	half = kzalloc(2 * sizeof(*half), GFP_KERNEL);
+	if (!half)
+		return NULL;
+
+	for (i = 0; i < 2; i++) {
+		INIT_LIST_HEAD(&half[i].q);
+		half[i].block_handle = slot->block_handle;
+		half[i].parent = slot;
+		half[i].buddy = &half[!i];
+		half[i].order = slot->order + 1;
+		half[i].size = slot->size >> 1;
+		half[i].offset = slot->offset + i * half[i].size;
+		half[i].phys = slot->phys + ((i * half[i].size) << PAGE_SHIFT);
+		half[i].page_map = slot->page_map + i * half[i].size;
 	}
+	half[1].free = true;
+	list_add(&half[1].q, &free_slots[half[1].order]);
+	slot_stats.splits++;
 
-	return slot;
-err:
-	up(&free_slots_sem);
-	return ret;
+	dev_dbg(DEV(cdev), "slot split, size %u block 0x%x\n",
+		slot->size, slot->phys);
+	return &half[0];
 }
 
-static struct tiler1d_slot *merge_slots(struct tiler1d_slot *slot)
+/* Merge all free buddies back into their parents.  Caller must hold mtx. */
+static int merge_free_slots(void)
 {
-	struct tiler1d_slot *slot2free;
-	u32 new_size = tiler1d_slot_size(cdev);
-
-	list_for_each_entry(slot2free, &free_slots, q)
-		if (!needs_split(slot2free) && slot2free != slot)
-			break;
-
-	if (&slot2free->q == &free_slots || slot2free->id == -1) {
-		dev_err(DEV(cdev), "%s: no free slot to megre\n", __func__);
-		return ERR_PTR(-EINVAL);
+	struct tiler1d_slot *slot, *buddy, *parent;
+	int order, merged = 0;
+
+	for (order = TILER1D_SLOT_ORDERS - 1; order > 0; order--) {
+restart:
+		list_for_each_entry(slot, &free_slots[order], q) {
+			buddy = slot->buddy;
+			if (!buddy->free)
+				continue;
+
+			parent = slot->parent;
+			list_del(&slot->q);
+			list_del(&buddy->q);
+			kfree(min(slot, buddy));
+
+			parent->free = true;
+			list_add_tail(&parent->q, &free_slots[order - 1]);
+			dev_dbg(DEV(cdev), "slot merged, size %u ptr 0x%x\n",
+				parent->size, parent->phys);
+			merged++;
+			goto restart;
+		}
 	}
+	slot_stats.merges += merged;
 
-	down(&free_slots_sem);
-	list_del(&slot2free->q);
-
-	dev_dbg(DEV(cdev), "%s: merging with %d id\n", __func__,
-						slot2free->id);
-	/*FIXME: potentially unsafe, as tiler1d space
-	 * might be overtaken before we claim it again.
-	 * Will be fixed later with tiler slot splitting API
-	*/
-	tiler_release(slot->block_handle);
+	return merged;
+}
 
-	tiler_release(slot2free->block_handle);
+static void merge_slots_work(struct work_struct *work)
+{
+	mutex_lock(&mtx);
+	merge_free_slots();
+	mutex_unlock(&mtx);
+}
 
-	slot->size = new_size >> PAGE_SHIFT;
-	slot->block_handle = tiler_reserve_1d(new_size);
+/*
+ * Find the smallest free slot of at most 'order', or with 'fit' false the
+ * largest smaller one.
+ */
+static struct tiler1d_slot *find_free_slot(int order, bool fit)
+{
+	int o;
 
-	if (IS_ERR_OR_NULL(slot->block_handle)) {
-		dev_err(DEV(cdev), "%s: failed to allocate slot\n", __func__);
-		return ERR_PTR(-ENOMEM);
+	if (fit) {
+		for (o = order; o >= 0; o--)
+			if (!list_empty(&free_slots[o]))
+				break;
+	} else {
+		for (o = order + 1; o < TILER1D_SLOT_ORDERS; o++)
+			if (!list_empty(&free_slots[o]))
+				break;
 	}
+	if (o < 0 || o >= TILER1D_SLOT_ORDERS)
+		return NULL;
 
-	slot->phys = tiler_ssptr(slot->block_handle);
-
-	vfree(slot2free->page_map);
-	slot2free->id = -1;
-
-	return slot;
+	return list_first_entry(&free_slots[o], struct tiler1d_slot, q);
 }
 
-static struct tiler1d_slot *split_slots(struct tiler1d_slot *slot)
+/*
+ * Get a free slot of 'order', splitting a larger one if needed.  Falls back
+ * to a smaller slot, so that at least some layers can be mapped, and fails
+ * with -EBUSY without waiting if no slot is free.  Caller must hold mtx.
+ */
+static struct tiler1d_slot *alloc_tiler_slot(int order)
 {
-	int i;
-	u32 new_size = tiler1d_slot_size(cdev)/2;
-
-	/*FIXME: potentially unsafe, as tiler1d space
-	 * might be overtaken before we claim it again.
-	 * Will be fixed later with tiler slot splitting API
-	*/
-	tiler_release(slot->block_handle);
-	for (i = 0; i < MAX_NUM_TILER1D_SLOTS; i++)
-		if (slots[i].id == -1)
-			break;
-
-	if (i == MAX_NUM_TILER1D_SLOTS) {
-		dev_err(DEV(cdev), "%s: all slots allocated\n", __func__);
-		return ERR_PTR(-EINVAL);
+	struct tiler1d_slot *slot, *half;
+
+	/* no TILER memory could be reserved */
+	if (!free_slots[0].next)
+		return ERR_PTR(-ENODEV);
+
+	slot = find_free_slot(order, true);
+	if (!slot && merge_free_slots())
+		slot = find_free_slot(order, true);
+	if (!slot)
+		slot = find_free_slot(order, false);
+	if (!slot) {
+		slot_stats.exhausted++;
+		return ERR_PTR(-EBUSY);
 	}
 
-	dev_dbg(DEV(cdev), "%s: splitting to %d id\n", __func__, i);
-	slot->size = slots[i].size = new_size >> PAGE_SHIFT;
-	slots[i].page_map = vmalloc(sizeof(*slots[i].page_map) *
-				slots[i].size*2);
-	slot->block_handle = tiler_reserve_1d(new_size);
-	slots[i].block_handle = tiler_reserve_1d(new_size);
+	list_del_init(&slot->q);
+	slot->free = false;
 
-	if (IS_ERR_OR_NULL(slot->block_handle) ||
-		IS_ERR_OR_NULL(slots[i].block_handle)) {
-		dev_err(DEV(cdev), "%s: failed to allocate slot\n", __func__);
-		return ERR_PTR(-ENOMEM);
+	while (slot->order < order) {
+		half = split_slot(slot);
+		if (!half)
+			break;
+		slot = half;
 	}
+	slot_stats.allocs++;
 
-	slot->phys = tiler_ssptr(slot->block_handle);
-	slots[i].phys = tiler_ssptr(slots[i].block_handle);
-	slots[i].id = i;
-	list_add(&slots[i].q, &free_slots);
-	up(&free_slots_sem);
-
-	return &slots[i];
+	return slot;
 }
 
 void dsscomp_gralloc_exit(void)
@@ -831,9 +1674,39 @@ void dsscomp_gralloc_exit(void)
 	unregister_early_suspend(&early_suspend_info);
 #endif
 
-	list_for_each_entry(slot, &free_slots, q) {
+	cancel_work_sync(&merge_work);
+
+	if (release_timeline) {
+		sync_timeline_destroy(&release_timeline->obj);
+		release_timeline = NULL;
+	}
+
+	mutex_lock(&mtx);
+	clone_free_retired(true);
+	if (clone_bufs.size) {
+		int i;
+
+		for (i = 0; i < CLONE_WB_BUFS; i++)
+			omap_vram_free(clone_bufs.paddr[i], clone_bufs.size);
+		clone_bufs.size = 0;
+	}
+	mutex_unlock(&mtx);
+
+	if (cdev)
+		omap_vram_unregister_client(&clone_vram_client);
+
+	if (!free_slots[0].next)
+		return;
+
+	mutex_lock(&mtx);
+	while (!list_empty(&dmabuf_cache))
+		free_dmabuf(list_first_entry(&dmabuf_cache,
+					     struct dsscomp_dmabuf, q));
+	merge_free_slots();
+	list_for_each_entry(slot, &free_slots[0], q) {
 		vfree(slot->page_map);
 		tiler_unpin(slot->block_handle);
 	}
-	INIT_LIST_HEAD(&free_slots);
+	INIT_LIST_HEAD(&free_slots[0]);
+	mutex_unlock(&mtx);
 }
@@ -24,6 +24,9 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/ratelimit.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/sync.h>
 
 #include <video/omapdss.h>
 #include <video/dsscomp.h>
@@ -32,6 +35,10 @@
 #include <linux/debugfs.h>
 
 #include "dsscomp.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/dsscomp.h>
+
 /* queue state */
 
 static DEFINE_MUTEX(mtx);
@@ -42,20 +49,39 @@ struct maskref {
 	u32 refs[MAX_OVERLAYS];
 };
 
+struct dsscomp_lat_stat {
+	u32 count;
+	u32 max_us;
+	u32 last_us;
+	u64 total_us;
+};
+
+/*
+ * Buffer release callbacks run on a real-time kthread of their own manager,
+ * so that a slow display cannot delay buffer recycling on the others.
+ */
+#define DSSCOMP_CB_PRIO		(MAX_RT_PRIO / 2)
+
 static struct {
 	struct workqueue_struct *apply_workq;
+	struct kthread_worker cb_worker;	/* callback worker */
+	struct task_struct *cb_task;
 
 	u32 ovl_mask;			/* overlays used on this display */
 	struct maskref ovl_qmask;	/* overlays queued to this display */
 	bool blanking;
+
+#ifdef CONFIG_DEBUG_FS
+	struct dsscomp_lat_stat lat[DSSCOMP_LAT_NUM];
+#endif
 } mgrq[MAX_MANAGERS];
 
-static struct workqueue_struct *cb_wkq;		/* callback work queue */
 static struct dsscomp_dev *cdev;
 
 #ifdef CONFIG_DEBUG_FS
 LIST_HEAD(dbg_comps);
 DEFINE_MUTEX(dbg_mtx); /* Mutex for debug operations */
+static DEFINE_SPINLOCK(dbg_lat_lock); /* protects mgrq[].lat */
 #endif
 
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
@@ -77,6 +103,40 @@ static inline void __log_state(struct dsscomp *c, void *fn, u32 ev)
 }
 #define log_state(c, fn, ev) DO_IF_DEBUG_FS(__log_state(c, fn, ev))
 
+#ifdef CONFIG_DEBUG_FS
+static void lat_account(u32 ix, enum dsscomp_lat lat, ktime_t delta)
+{
+	struct dsscomp_lat_stat *st = &mgrq[ix].lat[lat];
+	u32 us = (u32) ktime_to_us(delta);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dbg_lat_lock, flags);
+	st->count++;
+	st->total_us += us;
+	st->last_us = us;
+	if (us > st->max_us)
+		st->max_us = us;
+	spin_unlock_irqrestore(&dbg_lat_lock, flags);
+}
+
+/* account the time since the previous latency point of a composition */
+static inline void log_lat(struct dsscomp *c, enum dsscomp_lat lat)
+{
+	ktime_t now = ktime_get();
+
+	lat_account(c->ix, lat, ktime_sub(now, c->dbg_lat_t));
+	c->dbg_lat_t = now;
+}
+
+static inline void log_lat_start(struct dsscomp *c)
+{
+	c->dbg_lat_t = ktime_get();
+}
+#else
+static inline void log_lat(struct dsscomp *c, enum dsscomp_lat lat) {}
+static inline void log_lat_start(struct dsscomp *c) {}
+#endif
+
 static inline void maskref_incbit(struct maskref *om, u32 ix)
 {
 	om->refs[ix]++;
@@ -99,9 +159,25 @@ static void maskref_decmask(struct maskref *om, u32 mask)
  * ===========================================================================
  */
 
+/* tear down the apply and callback threads of the first 'num' managers */
+static void dsscomp_mgrq_destroy(u32 num)
+{
+	while (num--) {
+		/* pending applies may still queue callbacks */
+		if (mgrq[num].apply_workq)
+			destroy_workqueue(mgrq[num].apply_workq);
+		if (mgrq[num].cb_task) {
+			flush_kthread_worker(&mgrq[num].cb_worker);
+			kthread_stop(mgrq[num].cb_task);
+		}
+	}
+}
+
 /* Initialize queue structures, and set up state of the displays */
 int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 {
+	struct sched_param param = { .sched_priority = DSSCOMP_CB_PRIO };
+	struct task_struct *task;
 	u32 i, j;
 	cdev = cdev_;
 
@@ -116,6 +192,14 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 		if (!mgrq[i].apply_workq)
 			goto error;
 
+		init_kthread_worker(&mgrq[i].cb_worker);
+		task = kthread_run(kthread_worker_fn, &mgrq[i].cb_worker,
+				   "dsscomp_cb%u", i);
+		if (IS_ERR(task))
+			goto error;
+		sched_setscheduler(task, SCHED_FIFO, &param);
+		mgrq[i].cb_task = task;
+
 		/* record overlays on this display */
 		mgr = cdev->mgrs[i];
 		for (j = 0; j < cdev->num_ovls; j++) {
@@ -129,14 +213,9 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 				mgrq[i].ovl_mask |= 1 << OMAP_DSS_WB;
 	}
 
-	cb_wkq = create_singlethread_workqueue("dsscomp_cb");
-	if (!cb_wkq)
-		goto error;
-
 	return 0;
 error:
-	while (i--)
-		destroy_workqueue(mgrq[i].apply_workq);
+	dsscomp_mgrq_destroy(i + 1);
 	return -ENOMEM;
 }
 
@@ -349,6 +428,7 @@ int dsscomp_setup(struct dsscomp *comp, enum dsscomp_setup_mode mode,
 
 	comp->frm.mode = mode;
 	comp->frm.win = win;
+	trace_dsscomp_setup(comp, comp->ix, comp->ovl_mask);
 
 	mutex_unlock(&mtx);
 
@@ -373,24 +453,33 @@ void dsscomp_drop(struct dsscomp *comp)
 
 	DO_IF_DEBUG_FS(list_del(&comp->dbg_q));
 
+	if (comp->acquire)
+		sync_fence_put(comp->acquire);
 	kfree(comp);
 }
 EXPORT_SYMBOL(dsscomp_drop);
 
 struct dsscomp_cb_work {
-	struct work_struct work;
+	struct kthread_work work;
 	struct dsscomp *comp;
 	int status;
+#ifdef CONFIG_DEBUG_FS
+	ktime_t queued;
+#endif
 };
 
-static void dsscomp_mgr_delayed_cb(struct work_struct *work)
+static void dsscomp_mgr_delayed_cb(struct kthread_work *work)
 {
 	struct dsscomp_cb_work *wk = container_of(work, typeof(*wk), work);
 	struct dsscomp *comp = wk->comp;
 	int status = wk->status;
 	u32 ix;
 
-	kfree(work);
+#ifdef CONFIG_DEBUG_FS
+	lat_account(comp->ix, DSSCOMP_LAT_CB,
+		    ktime_sub(ktime_get(), wk->queued));
+#endif
+	kfree(wk);
 
 	mutex_lock(&mtx);
 
@@ -405,6 +494,7 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 	if (status == DSS_COMPLETION_PROGRAMMED) {
 		comp->state = DSSCOMP_STATE_PROGRAMMED;
 		log_state(comp, dsscomp_mgr_delayed_cb, status);
+		log_lat(comp, DSSCOMP_LAT_GO);
 
 		/* update used overlay mask */
 		mgrq[ix].ovl_mask = comp->ovl_mask & ~comp->ovl_dmask;
@@ -417,6 +507,7 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 		/* composition is 1st displayed */
 		comp->state = DSSCOMP_STATE_DISPLAYED;
 		log_state(comp, dsscomp_mgr_delayed_cb, status);
+		log_lat(comp, DSSCOMP_LAT_VSYNC);
 		if (debug & DEBUG_PHASES)
 			dev_info(DEV(cdev), "[%p] displayed\n", comp);
 	} else if (status & DSS_COMPLETION_RELEASED) {
@@ -437,22 +528,35 @@ static u32 dsscomp_mgr_callback(void *data, int id, int status)
 	    (status == DSS_COMPLETION_DISPLAYED &&
 	     comp->state != DSSCOMP_STATE_DISPLAYED) ||
 	    (status & DSS_COMPLETION_RELEASED)) {
-		struct dsscomp_cb_work *wk = kzalloc(sizeof(*wk), GFP_ATOMIC);
+		struct dsscomp_cb_work *wk;
+
+		if (status == DSS_COMPLETION_PROGRAMMED)
+			trace_dsscomp_go(comp, comp->ix, comp->ovl_mask);
+		else if (status == DSS_COMPLETION_DISPLAYED)
+			trace_dsscomp_vsync(comp, comp->ix, comp->ovl_mask);
+		else
+			trace_dsscomp_release(comp, comp->ix, comp->ovl_mask,
+					      status);
+
+		wk = kzalloc(sizeof(*wk), GFP_ATOMIC);
+		if (!wk) {
+			dev_err(DEV(cdev), "[%p] dropped callback %d\n", comp,
+				status);
+			return ~status;
+		}
 		wk->comp = comp;
 		wk->status = status;
-		INIT_WORK(&wk->work, dsscomp_mgr_delayed_cb);
-		queue_work(cb_wkq, &wk->work);
+#ifdef CONFIG_DEBUG_FS
+		wk->queued = ktime_get();
+#endif
+		init_kthread_work(&wk->work, dsscomp_mgr_delayed_cb);
+		queue_kthread_work(&mgrq[comp->ix].cb_worker, &wk->work);
 	}
 
 	/* get each callback only once */
 	return ~status;
 }
 
-static inline bool dssdev_manually_updated(struct omap_dss_device *dev)
-{
-	return dev->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE;
-}
-
 /* apply composition */
 /* at this point the composition is not on any queue */
 static int dsscomp_apply(struct dsscomp *comp)
@@ -479,6 +583,7 @@ static int dsscomp_apply(struct dsscomp *comp)
 	};
 
 	BUG_ON(comp->state != DSSCOMP_STATE_APPLYING);
+	log_lat(comp, DSSCOMP_LAT_QUEUE);
 
 	/* check if the display is valid and used */
 	r = -ENODEV;
@@ -672,6 +777,7 @@ skip_ovl_set:
 	/* no need for mutex as no callbacks are scheduled yet */
 	comp->state = DSSCOMP_STATE_APPLIED;
 	log_state(comp, dsscomp_apply, 0);
+	trace_dsscomp_apply(comp, comp->ix, comp->ovl_mask);
 
 	if (wb_apply) {
 		struct omap_writeback_info wb_info;
@@ -713,6 +819,8 @@ skip_ovl_set:
 			dev_err(DEV(cdev),
 					"failed while applying mgr[%d] r:%d\n",
 								mgr->id, r);
+		else
+			log_lat(comp, DSSCOMP_LAT_APPLY);
 		/* keep error if set_mgr_info failed */
 		if (!r && !cb_programmed)
 			r = -EINVAL;
@@ -819,12 +927,26 @@ int dsscomp_state_notifier(struct notifier_block *nb,
 }
 
 
+/*
+ * Compositions wait for their acquire fence on the apply queue of their
+ * manager, so later compositions stay behind them.
+ */
 static void dsscomp_do_apply(struct work_struct *work)
 {
 	struct dsscomp_apply_work *wk = container_of(work, typeof(*wk), work);
+	struct dsscomp *comp = wk->comp;
+
+	if (comp->acquire) {
+		if (sync_fence_wait(comp->acquire, ACQUIRE_TIMEOUT_MS))
+			dev_warn(DEV(cdev), "[%p] acquire fence timed out\n",
+					comp);
+		sync_fence_put(comp->acquire);
+		comp->acquire = NULL;
+	}
+
 	/* complete compositions that failed to apply */
-	if (dsscomp_apply(wk->comp))
-		dsscomp_mgr_callback(wk->comp, -1, DSS_COMPLETION_ECLIPSED_SET);
+	if (dsscomp_apply(comp))
+		dsscomp_mgr_callback(comp, -1, DSS_COMPLETION_ECLIPSED_SET);
 	kfree(wk);
 }
 
@@ -840,6 +962,7 @@ int dsscomp_delayed_apply(struct dsscomp *comp)
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	comp->state = DSSCOMP_STATE_APPLYING;
 	log_state(comp, dsscomp_delayed_apply, 0);
+	log_lat_start(comp);
 
 	if (debug & DEBUG_PHASES)
 		dev_info(DEV(cdev), "[%p] applying\n", comp);
@@ -851,6 +974,13 @@ int dsscomp_delayed_apply(struct dsscomp *comp)
 }
 EXPORT_SYMBOL(dsscomp_delayed_apply);
 
+/* wait until the compositions queued to a manager have been applied */
+void dsscomp_flush_mgr(u32 ix)
+{
+	if (ix < cdev->num_mgrs)
+		flush_workqueue(mgrq[ix].apply_workq);
+}
+
 /*
  * ===========================================================================
  *		DEBUGFS
@@ -913,6 +1043,33 @@ static void seq_print_comp(struct seq_file *s, struct dsscomp *c)
 	else
 		seq_printf(s, "    gsync=[%p] (called)\n\n", c->extra_cb_data);
 }
+
+static void seq_print_lat(struct seq_file *s, u32 ix)
+{
+	static const char * const names[DSSCOMP_LAT_NUM] = {
+		[DSSCOMP_LAT_QUEUE]	= "queue",
+		[DSSCOMP_LAT_APPLY]	= "apply",
+		[DSSCOMP_LAT_GO]	= "go",
+		[DSSCOMP_LAT_VSYNC]	= "vsync",
+		[DSSCOMP_LAT_CB]	= "callback",
+	};
+	struct dsscomp_lat_stat lat[DSSCOMP_LAT_NUM];
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dbg_lat_lock, flags);
+	memcpy(lat, mgrq[ix].lat, sizeof(lat));
+	spin_unlock_irqrestore(&dbg_lat_lock, flags);
+
+	seq_printf(s, "  latency (us)      count      avg      max     last\n");
+	for (i = 0; i < DSSCOMP_LAT_NUM; i++)
+		seq_printf(s, "    %-10s %12u %8u %8u %8u\n", names[i],
+			   lat[i].count,
+			   lat[i].count ?
+			   (u32) div_u64(lat[i].total_us, lat[i].count) : 0,
+			   lat[i].max_us, lat[i].last_us);
+	seq_printf(s, "\n");
+}
 #endif
 
 void dsscomp_dbg_comps(struct seq_file *s)
@@ -925,6 +1082,7 @@ void dsscomp_dbg_comps(struct seq_file *s)
 	for (i = 0; i < cdev->num_mgrs; i++) {
 		struct omap_overlay_manager *mgr = cdev->mgrs[i];
 		seq_printf(s, "ACTIVE COMPOSITIONS on %s\n\n", mgr->name);
+		seq_print_lat(s, i);
 		list_for_each_entry(c, &dbg_comps, dbg_q) {
 			struct dss2_mgr_info *mi = &c->frm.mgr;
 			if (mi->ix < cdev->num_displays &&
@@ -969,10 +1127,7 @@ void dsscomp_dbg_events(struct seq_file *s)
 void dsscomp_queue_exit(void)
 {
 	if (cdev) {
-		int i;
-		for (i = 0; i < cdev->num_displays; i++)
-			destroy_workqueue(mgrq[i].apply_workq);
-		destroy_workqueue(cb_wkq);
+		dsscomp_mgrq_destroy(cdev->num_mgrs);
 		cdev = NULL;
 	}
 }
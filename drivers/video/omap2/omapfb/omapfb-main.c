@@ -1163,6 +1163,8 @@ static int omapfb_set_par(struct fb_info *fbi)
 
 	DBG("set_par(%d)\n", FB2OFB(fbi)->id);
 
+	omapfb_flush_flip_queue(fbi);
+
 	omapfb_get_mem_region(ofbi->region);
 
 	set_fb_fix(fbi);
@@ -1179,6 +1181,188 @@ static int omapfb_set_par(struct fb_info *fbi)
 	return r;
 }
 
+/*
+ * Queued panning.  With a flip queue depth set through sysfs, pan requests
+ * return right away and are applied one per frame: the next pan is only
+ * written once DSS reports the previous one as programmed, so every pan
+ * gets latched at its own vsync instead of overwriting the one before it.
+ */
+static u32 omapfb_flip_cb(void *data, int id, int status)
+{
+	struct omapfb_info *ofbi = data;
+	struct omapfb_flip_queue *q = &ofbi->flip;
+	unsigned long flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	q->busy = false;
+	if (q->count)
+		schedule_work(&q->work);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	/* programmed or dropped, either way the next pan can go */
+	return 0;
+}
+
+/*
+ * Points the overlays of the fb at the given offsets, leaving everything
+ * else as it is.  Returns 1 if omapfb_flip_cb() will be called, 0 if no
+ * overlay is enabled to report back.
+ */
+static int omapfb_apply_pan(struct fb_info *fbi, u32 xoffset, u32 yoffset)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct fb_var_screeninfo var = fbi->var;
+	struct omap_overlay_info info;
+	struct omap_overlay *ovl;
+	bool cb_set = false;
+	int r = 0;
+	int i;
+
+	var.xoffset = xoffset;
+	var.yoffset = yoffset;
+
+	omapfb_get_mem_region(ofbi->region);
+
+	if (ofbi->region->size == 0)
+		goto out;
+
+	for (i = 0; i < ofbi->num_overlays; i++) {
+		int rotation = (var.rotate + ofbi->rotation[i]) % 4;
+
+		ovl = ofbi->overlays[i];
+		if (!ovl->manager)
+			continue;
+
+		ovl->get_overlay_info(ovl, &info);
+		omapfb_calc_addr(ofbi, &var, &fbi->fix, rotation, &info.paddr);
+
+		if (!cb_set && ovl->is_enabled(ovl)) {
+			info.cb.fn = omapfb_flip_cb;
+			info.cb.data = ofbi;
+			info.cb.mask = DSS_COMPLETION_PROGRAMMED |
+				DSS_COMPLETION_RELEASED;
+			cb_set = true;
+		}
+
+		r = ovl->set_overlay_info(ovl, &info);
+		if (r)
+			goto out;
+
+		r = ovl->manager->apply(ovl->manager);
+		if (r)
+			goto out;
+	}
+	r = cb_set;
+out:
+	omapfb_put_mem_region(ofbi->region);
+
+	return r;
+}
+
+static void omapfb_flip_work(struct work_struct *work)
+{
+	struct omapfb_flip_queue *q =
+		container_of(work, struct omapfb_flip_queue, work);
+	struct omapfb_info *ofbi = container_of(q, struct omapfb_info, flip);
+	struct fb_info *fbi = ofbi->fbdev->fbs[ofbi->id];
+	unsigned long flags;
+	u32 xoffset, yoffset;
+	int r;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (q->busy || !q->count) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		return;
+	}
+	xoffset = q->pans[q->head].xoffset;
+	yoffset = q->pans[q->head].yoffset;
+	q->head = (q->head + 1) % OMAPFB_MAX_FLIP_QUEUE;
+	q->count--;
+	q->busy = true;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	DBG("flip(%d) %u,%u\n", ofbi->id, xoffset, yoffset);
+
+	r = omapfb_apply_pan(fbi, xoffset, yoffset);
+	if (r > 0)
+		return;
+
+	if (r)
+		dev_err(ofbi->fbdev->dev, "queued pan failed: %d\n", r);
+
+	/* nothing will complete this one, move on to the next */
+	spin_lock_irqsave(&q->lock, flags);
+	q->busy = false;
+	if (q->count)
+		schedule_work(&q->work);
+	spin_unlock_irqrestore(&q->lock, flags);
+}
+
+static int omapfb_queue_pan(struct fb_info *fbi, struct fb_var_screeninfo *var)
+{
+	struct omapfb_flip_queue *q = &FB2OFB(fbi)->flip;
+	unsigned long flags;
+	unsigned tail;
+	int r = 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (q->count >= q->depth) {
+		r = -EBUSY;
+	} else {
+		tail = (q->head + q->count) % OMAPFB_MAX_FLIP_QUEUE;
+		q->pans[tail].xoffset = var->xoffset;
+		q->pans[tail].yoffset = var->yoffset;
+		q->count++;
+		if (!q->busy)
+			schedule_work(&q->work);
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return r;
+}
+
+/* drops the pending pans, returns how many there were */
+static unsigned omapfb_flush_flip_queue(struct fb_info *fbi)
+{
+	struct omapfb_flip_queue *q = &FB2OFB(fbi)->flip;
+	unsigned long flags;
+	unsigned count;
+
+	spin_lock_irqsave(&q->lock, flags);
+	count = q->count;
+	q->count = 0;
+	q->busy = false;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	cancel_work_sync(&q->work);
+
+	return count;
+}
+
+/* call with the fb_info locked */
+int omapfb_set_flip_queue(struct fb_info *fbi, unsigned depth)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	unsigned long flags;
+	int r = 0;
+
+	if (depth > OMAPFB_MAX_FLIP_QUEUE)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ofbi->flip.lock, flags);
+	ofbi->flip.depth = depth;
+	spin_unlock_irqrestore(&ofbi->flip.lock, flags);
+
+	/* show the last pan right away instead of the ones queued before */
+	if (omapfb_flush_flip_queue(fbi)) {
+		omapfb_get_mem_region(ofbi->region);
+		r = omapfb_apply_changes(fbi, 0);
+		omapfb_put_mem_region(ofbi->region);
+	}
+
+	return r;
+}
+
 static int omapfb_pan_display(struct fb_var_screeninfo *var,
 		struct fb_info *fbi)
 {
@@ -1192,6 +1376,10 @@ static int omapfb_pan_display(struct fb_var_screeninfo *var,
 	    var->yoffset == fbi->var.yoffset)
 		return 0;
 
+	/* fbmem updates fbi->var once we return */
+	if (ACCESS_ONCE(ofbi->flip.depth))
+		return omapfb_queue_pan(fbi, var);
+
 	new_var = fbi->var;
 	new_var.xoffset = var->xoffset;
 	new_var.yoffset = var->yoffset;
@@ -1419,6 +1607,8 @@ static int omapfb_blank(int blank, struct fb_info *fbi)
 	case FB_BLANK_HSYNC_SUSPEND:
 	case FB_BLANK_POWERDOWN:
 
+		omapfb_flush_flip_queue(fbi);
+
 		if (fbdev->vsync_active)
 			omapfb_enable_vsync(fbdev, display->channel, false);
 
@@ -1528,6 +1718,86 @@ static int omapfb_free_all_fbmem(struct omapfb2_device *fbdev)
 	return 0;
 }
 
+/*
+ * VRAM may move a framebuffer that is neither mmapped nor scanned out to
+ * make room for a larger allocation.  This is called from inside VRAM
+ * allocations, possibly made for another framebuffer, so never wait for
+ * the region.  On success the region stays locked until the move is done.
+ */
+static int omapfb_prepare_move_fbmem(void *data, unsigned long paddr)
+{
+	struct omapfb2_mem_region *rg = data;
+	struct omapfb2_device *fbdev =
+		container_of(rg - rg->id, struct omapfb2_device, regions[0]);
+	int i, j;
+
+	if (!down_write_trylock(&rg->lock))
+		return -EBUSY;
+
+	if (atomic_read(&rg->map_count) || !rg->vaddr)
+		goto busy;
+
+	for (i = 0; i < fbdev->num_fbs; i++) {
+		struct omapfb_info *ofbi = FB2OFB(fbdev->fbs[i]);
+
+		if (ofbi->region != rg)
+			continue;
+
+		if (ofbi->rotation_type == OMAP_DSS_ROT_VRFB)
+			goto busy;
+
+		for (j = 0; j < ofbi->num_overlays; j++) {
+			struct omap_overlay *ovl = ofbi->overlays[j];
+
+			if (ovl->is_enabled(ovl))
+				goto busy;
+		}
+	}
+
+	rg->move_vaddr = ioremap_wc(paddr, rg->size);
+	if (!rg->move_vaddr)
+		goto busy;
+
+	atomic_inc(&rg->lock_count);
+	return 0;
+busy:
+	up_write(&rg->lock);
+	return -EBUSY;
+}
+
+/* paddr is the old address if the move failed */
+static void omapfb_finish_move_fbmem(void *data, unsigned long paddr)
+{
+	struct omapfb2_mem_region *rg = data;
+	struct omapfb2_device *fbdev =
+		container_of(rg - rg->id, struct omapfb2_device, regions[0]);
+	int i;
+
+	if (paddr == rg->paddr) {
+		iounmap(rg->move_vaddr);
+	} else {
+		DBG("moved fb memory %x => %lx\n", rg->paddr, paddr);
+
+		iounmap(rg->vaddr);
+		rg->vaddr = rg->move_vaddr;
+		rg->paddr = paddr;
+
+		for (i = 0; i < fbdev->num_fbs; i++)
+			if (FB2OFB(fbdev->fbs[i])->region == rg)
+				set_fb_fix(fbdev->fbs[i]);
+	}
+	rg->move_vaddr = NULL;
+
+	atomic_dec(&rg->lock_count);
+	up_write(&rg->lock);
+}
+
+static struct omap_vram_client omapfb_vram_client = {
+	.name		= "omapfb",
+	.prepare_move	= omapfb_prepare_move_fbmem,
+	.finish_move	= omapfb_finish_move_fbmem,
+};
+
 static int omapfb_alloc_fbmem(struct fb_info *fbi, unsigned long size,
 		unsigned long paddr)
 {
@@ -1551,7 +1821,10 @@ static int omapfb_alloc_fbmem(struct fb_info *fbi, unsigned long size,
 
 	if (!paddr) {
 		DBG("allocating %lu bytes for fb %d\n", size, ofbi->id);
-		r = omap_vram_alloc(size, &paddr);
+		/* VRFB contexts point at the memory, so it cannot move */
+		r = omap_vram_alloc_client(&omapfb_vram_client, size, &paddr,
+				ofbi->rotation_type != OMAP_DSS_ROT_VRFB ?
+				rg : NULL);
 	} else {
 		DBG("reserving %lu bytes at %lx for fb %d\n", size, paddr,
 				ofbi->id);
@@ -1985,6 +2258,7 @@ err:
 
 static void fbinfo_cleanup(struct omapfb2_device *fbdev, struct fb_info *fbi)
 {
+	omapfb_flush_flip_queue(fbi);
 	fb_dealloc_cmap(&fbi->cmap);
 }
 
@@ -2004,6 +2278,8 @@ static void omapfb_free_resources(struct omapfb2_device *fbdev)
 	/* free the reserved fbmem */
 	omapfb_free_all_fbmem(fbdev);
 
+	omap_vram_unregister_client(&omapfb_vram_client);
+
 	for (i = 0; i < fbdev->num_fbs; i++) {
 		fbinfo_cleanup(fbdev, fbdev->fbs[i]);
 		framebuffer_release(fbdev->fbs[i]);
@@ -2070,6 +2346,9 @@ static int omapfb_create_framebuffers(struct omapfb2_device *fbdev)
 			OMAP_DSS_ROT_DMA;
 		ofbi->mirror = def_mirror;
 
+		spin_lock_init(&ofbi->flip.lock);
+		INIT_WORK(&ofbi->flip.work, omapfb_flip_work);
+
 		fbdev->num_fbs++;
 	}
 
@@ -2500,6 +2779,8 @@ static void omapfb_vsync_isr(void *data, u32 mask)
 {
 	struct omapfb2_device *fbdev = data;
 	fbdev->vsync_timestamp = ktime_get();
+	if (fbdev->vsync_sd)
+		sysfs_notify_dirent(fbdev->vsync_sd);
 	schedule_work(&fbdev->vsync_work);
 }
 
@@ -2567,6 +2848,8 @@ static int omapfb_probe(struct platform_device *pdev)
 	fbdev->dev = &pdev->dev;
 	platform_set_drvdata(pdev, fbdev);
 
+	omap_vram_register_client(&omapfb_vram_client);
+
 	r = 0;
 	fbdev->num_displays = 0;
 	dssdev = NULL;
@@ -551,6 +551,37 @@ static ssize_t store_upd_mode(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static ssize_t show_flip_queue(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", ofbi->flip.depth);
+}
+
+static ssize_t store_flip_queue(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	unsigned depth;
+	int r;
+
+	r = kstrtouint(buf, 0, &depth);
+	if (r)
+		return r;
+
+	if (!lock_fb_info(fbi))
+		return -ENODEV;
+
+	r = omapfb_set_flip_queue(fbi, depth);
+
+	unlock_fb_info(fbi);
+
+	return r ? r : count;
+}
+
 static struct device_attribute omapfb_attrs[] = {
 	__ATTR(rotate_type, S_IRUGO | S_IWUSR, show_rotate_type,
 			store_rotate_type),
@@ -562,8 +593,22 @@ static struct device_attribute omapfb_attrs[] = {
 	__ATTR(phys_addr, S_IRUGO, show_phys, NULL),
 	__ATTR(virt_addr, S_IRUGO, show_virt, NULL),
 	__ATTR(update_mode, S_IRUGO | S_IWUSR, show_upd_mode, store_upd_mode),
+	__ATTR(flip_queue, S_IRUGO | S_IWUSR, show_flip_queue,
+			store_flip_queue),
 };
 
+/* last vsync seen with OMAPFB_ENABLEVSYNC on, poll() to wait for the next */
+static ssize_t show_vsync_event(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct omapfb2_device *fbdev = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "VSYNC=%llu\n",
+			ktime_to_ns(fbdev->vsync_timestamp));
+}
+
+static DEVICE_ATTR(vsync_event, S_IRUGO, show_vsync_event, NULL);
+
 int omapfb_create_sysfs(struct omapfb2_device *fbdev)
 {
 	int i;
@@ -584,6 +629,14 @@ int omapfb_create_sysfs(struct omapfb2_device *fbdev)
 		}
 	}
 
+	r = device_create_file(fbdev->dev, &dev_attr_vsync_event);
+	if (r) {
+		dev_err(fbdev->dev, "failed to create sysfs file\n");
+		return r;
+	}
+	fbdev->vsync_sd = sysfs_get_dirent(fbdev->dev->kobj.sd, NULL,
+			"vsync_event");
+
 	return 0;
 }
 
@@ -592,6 +645,14 @@ void omapfb_remove_sysfs(struct omapfb2_device *fbdev)
 	int i, t;
 
 	DBG("remove sysfs for fbs\n");
+	if (fbdev->vsync_sd) {
+		struct sysfs_dirent *sd = fbdev->vsync_sd;
+
+		fbdev->vsync_sd = NULL;
+		sysfs_put(sd);
+	}
+	device_remove_file(fbdev->dev, &dev_attr_vsync_event);
+
 	for (i = 0; i < fbdev->num_fbs; i++) {
 		for (t = 0; t < ARRAY_SIZE(omapfb_attrs); t++)
 			device_remove_file(fbdev->fbs[i]->dev,
@@ -28,6 +28,8 @@
 #endif
 
 #include <linux/rwsem.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include <video/omapdss.h>
 
@@ -59,6 +61,24 @@ struct omapfb2_mem_region {
 	atomic_t	map_count;
 	struct rw_semaphore lock;
 	atomic_t	lock_count;
+	void __iomem	*move_vaddr;	/* new mapping while VRAM moves it */
+};
+
+/* max number of pans that can wait in a flip queue */
+#define OMAPFB_MAX_FLIP_QUEUE 4
+
+/* pans waiting to be applied one per frame, see omapfb_queue_pan() */
+struct omapfb_flip_queue {
+	spinlock_t lock;
+	unsigned depth;		/* 0: pan synchronously */
+	unsigned head;
+	unsigned count;
+	struct {
+		u32 xoffset;
+		u32 yoffset;
+	} pans[OMAPFB_MAX_FLIP_QUEUE];
+	bool busy;		/* a pan is applied but not programmed yet */
+	struct work_struct work;
 };
 
 /* appended to fb_info */
@@ -71,6 +91,7 @@ struct omapfb_info {
 	enum omap_dss_rotation_type rotation_type;
 	u8 rotation[OMAPFB_MAX_OVL_PER_FB];
 	bool mirror;
+	struct omapfb_flip_queue flip;
 };
 
 struct omapfb_display_data {
@@ -111,6 +132,7 @@ struct omapfb2_device {
 	bool vsync_active;
 	ktime_t vsync_timestamp;
 	struct work_struct vsync_work;
+	struct sysfs_dirent *vsync_sd;
 };
 
 struct omapfb_colormode {
@@ -127,6 +149,7 @@ void set_fb_fix(struct fb_info *fbi);
 int check_fb_var(struct fb_info *fbi, struct fb_var_screeninfo *var);
 int omapfb_realloc_fbmem(struct fb_info *fbi, unsigned long size, int type);
 int omapfb_apply_changes(struct fb_info *fbi, int init);
+int omapfb_set_flip_queue(struct fb_info *fbi, unsigned depth);
 
 int omapfb_create_sysfs(struct omapfb2_device *fbdev);
 void omapfb_remove_sysfs(struct omapfb2_device *fbdev);
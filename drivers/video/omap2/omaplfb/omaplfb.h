@@ -316,8 +316,10 @@ IMG_BOOL OMAPLFBInitBlt(void);
 OMAPLFB_ERROR OMAPLFBInitBltFBs(OMAPLFB_DEVINFO *psDevInfo);
 void OMAPLFBDeInitBltFBs(OMAPLFB_DEVINFO *psDevInfo);
 void OMAPLFBGetBltFBsBvHndl(OMAPLFB_FBINFO *psPVRFBInfo, IMG_UINTPTR_T *ppPhysAddr);
+struct sync_fence;
 void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos,
-		    struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos);
+		    struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos,
+		    struct sync_fence **ppsFence);
 
 #if defined(DEBUG)
 void OMAPLFBPrintInfo(OMAPLFB_DEVINFO *psDevInfo);
@@ -397,7 +397,7 @@ static void OMAPLFBSetNV12Params(struct bvsurfgeom *geom, struct bvbuffdesc *des
 		geom->virtstride = (desc->length * 2) / (geom->width * 3);
 }
 
-void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos)
+void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos, struct sync_fence **ppsFence)
 {
 	struct rgz_blt_entry *entry_list;
 	struct bventry *bv_entry = &gsBvInterface;
@@ -406,6 +406,17 @@ void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struc
 	int j;
 	void* lastBatch = NULL;
 	unsigned int batchFlags;
+	struct bvbltparams **blts = NULL;
+	unsigned int blt_count = 0;
+
+	*ppsFence = NULL;
+
+#if defined(CONFIG_GCBV)
+	/* Submit all the blits at once if possible, without waiting for
+	 * them; the fence tells when they are done */
+	if (rgz_items > 0)
+		blts = kmalloc(rgz_items * sizeof(*blts), GFP_KERNEL);
+#endif
 
 	/* DSS pipes are setup up to this point, we can begin blitting here */
 	entry_list = (struct rgz_blt_entry *) (blit_data->rgz_blts);
@@ -509,6 +520,12 @@ void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struc
 			print_bvparams(&entry->bp, iSrc1DescInfo, iSrc2DescInfo);
 		}
 
+		if (blts)
+		{
+			blts[blt_count++] = &entry->bp;
+			continue;
+		}
+
 		batchFlags = entry->bp.flags & BVFLAG_BATCH_MASK;
 		switch (batchFlags) {
 		case BVFLAG_BATCH_CONTINUE:
@@ -529,6 +546,18 @@ void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struc
 			lastBatch = entry->bp.batch;
 		}
 	}
+
+#if defined(CONFIG_GCBV)
+	if (blts)
+	{
+		enum bverror bv_error = gcbv_blt_batch(blts, blt_count,
+						       ppsFence);
+		if (bv_error)
+			printk(KERN_ERR "%s: blit batch failed %d\n",
+					__func__, bv_error);
+		kfree(blts);
+	}
+#endif
 }
 
 OMAPLFB_ERROR OMAPLFBInitBltFBs(OMAPLFB_DEVINFO *psDevInfo)
@@ -31,6 +31,7 @@
 #include <linux/module.h>
 #include <linux/string.h>
 #include <linux/notifier.h>
+#include <linux/sync.h>
 #include <plat/sgx_omaplfb.h>
 
 #include "img_defs.h"
@@ -764,8 +765,9 @@ void OMAPLFBGetBltFBsBvHndl(OMAPLFB_FBINFO *psPVRFBInfo, IMG_UINTPTR_T *ppPhysAd
 	*ppPhysAddr = 0;
 }
 
-void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos)
+void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos, struct sync_fence **ppsFence)
 {
+	*ppsFence = NULL;
 }
 #endif /* CONFIG_GCBV */
 static OMAPLFB_BOOL WaitForVSyncSettle(OMAPLFB_DEVINFO *psDevInfo)
@@ -934,6 +936,7 @@ static IMG_BOOL ProcessFlipV2(IMG_HANDLE hCmdCookie,
 	struct dsscomp_setup_dispc_data *psDssData = &(psHwcData->dsscomp_data);
 	int iMemIdx = 0;
 	int iUseBltFB;
+	struct sync_fence *psBltFence = NULL;
 #ifdef CONFIG_DRM_OMAP_DMM_TILER
 	enum tiler_fmt fmt;
 #endif
@@ -1100,16 +1103,24 @@ static IMG_BOOL ProcessFlipV2(IMG_HANDLE hCmdCookie,
 
 	if (rgz_items > 0)
 	{
-		OMAPLFBDoBlits(psDevInfo, ppsMemInfos, &psHwcData->blit_data, ui32NumMemInfos);
+		OMAPLFBDoBlits(psDevInfo, ppsMemInfos, &psHwcData->blit_data, ui32NumMemInfos, &psBltFence);
 	}
 
+	/* Blits run behind the flip; dsscomp applies it once they are done */
 	if (psDssData->num_ovls == 0)
+	{
+		if (psBltFence)
+			sync_fence_wait(psBltFence, 1000);
 		dsscomp_proxy_cmdcomplete((void *)hCmdCookie, IMG_TRUE);
+	}
 	else
-		dsscomp_gralloc_queue(psDssData, apsTilerPAs, false,
-						dsscomp_proxy_cmdcomplete,
+		dsscomp_gralloc_queue_fence(psDssData, apsTilerPAs, psBltFence,
+						NULL, dsscomp_proxy_cmdcomplete,
 						(void *)hCmdCookie);
 
+	if (psBltFence)
+		sync_fence_put(psBltFence);
+
 	for(i = 0; i < ARRAY_SIZE(asMemInfo); i++)
 	{
 		tiler_pa_free(asMemInfo[i].psTilerInfo);
@@ -23,6 +23,7 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/seq_file.h>
 #include <linux/memblock.h>
@@ -53,73 +54,309 @@ static struct {
 	size_t size;
 } postponed_regions[MAX_POSTPONED_REGIONS];
 
-struct vram_alloc {
+/*
+ * Free space is kept as holes, indexed both by address (to merge neighbours
+ * on free) and by size (for best-fit allocation).  Allocations are indexed
+ * by address.  A hole never spans two regions.
+ */
+struct vram_region {
 	struct list_head list;
 	unsigned long paddr;
 	unsigned pages;
 };
 
-struct vram_region {
-	struct list_head list;
-	struct list_head alloc_list;
+struct vram_hole {
+	struct rb_node addr_node;
+	struct rb_node size_node;
+	struct vram_region *region;
+	unsigned long paddr;
+	unsigned pages;
+};
+
+struct vram_alloc {
+	struct rb_node node;
+	struct vram_region *region;
 	unsigned long paddr;
 	unsigned pages;
+	struct omap_vram_client *client;
+	void *data;		/* movable if set, passed to the client */
 };
 
 static DEFINE_MUTEX(region_mutex);
 static LIST_HEAD(region_list);
+static LIST_HEAD(client_list);
+static struct rb_root hole_addr_tree = RB_ROOT;
+static struct rb_root hole_size_tree = RB_ROOT;
+static struct rb_root alloc_tree = RB_ROOT;
+
+/* allocations made without a client */
+static struct omap_vram_client vram_other_client = {
+	.name = "other",
+};
+
+static struct {
+	unsigned compactions;
+	unsigned failures;
+} vram_stats;
 
-static struct vram_region *omap_vram_create_region(unsigned long paddr,
+static void hole_insert_size(struct vram_hole *h)
+{
+	struct rb_node **p = &hole_size_tree.rb_node, *parent = NULL;
+
+	while (*p) {
+		struct vram_hole *e;
+
+		parent = *p;
+		e = rb_entry(parent, struct vram_hole, size_node);
+		if (h->pages < e->pages ||
+		    (h->pages == e->pages && h->paddr < e->paddr))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&h->size_node, parent, p);
+	rb_insert_color(&h->size_node, &hole_size_tree);
+}
+
+static void hole_insert(struct vram_hole *h)
+{
+	struct rb_node **p = &hole_addr_tree.rb_node, *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (h->paddr < rb_entry(parent, struct vram_hole,
+					addr_node)->paddr)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&h->addr_node, parent, p);
+	rb_insert_color(&h->addr_node, &hole_addr_tree);
+
+	hole_insert_size(h);
+}
+
+static void hole_remove(struct vram_hole *h)
+{
+	rb_erase(&h->addr_node, &hole_addr_tree);
+	rb_erase(&h->size_node, &hole_size_tree);
+	kfree(h);
+}
+
+/* smallest hole of at least @pages */
+static struct vram_hole *hole_best_fit(unsigned pages)
+{
+	struct rb_node *n = hole_size_tree.rb_node;
+	struct vram_hole *best = NULL;
+
+	while (n) {
+		struct vram_hole *h = rb_entry(n, struct vram_hole, size_node);
+
+		if (h->pages >= pages) {
+			best = h;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	return best;
+}
+
+/* hole containing [paddr, paddr + pages) */
+static struct vram_hole *hole_find(unsigned long paddr, unsigned pages)
+{
+	struct rb_node *n = hole_addr_tree.rb_node;
+
+	while (n) {
+		struct vram_hole *h = rb_entry(n, struct vram_hole, addr_node);
+
+		if (paddr < h->paddr)
+			n = n->rb_left;
+		else if (paddr >= h->paddr + (h->pages << PAGE_SHIFT))
+			n = n->rb_right;
+		else if (paddr + (pages << PAGE_SHIFT) <=
+			 h->paddr + (h->pages << PAGE_SHIFT))
+			return h;
+		else
+			return NULL;
+	}
+	return NULL;
+}
+
+/* take [paddr, paddr + pages) out of hole @h */
+static int hole_carve(struct vram_hole *h, unsigned long paddr,
 		unsigned pages)
 {
-	struct vram_region *rm;
+	unsigned long end = paddr + (pages << PAGE_SHIFT);
+	unsigned long h_end = h->paddr + (h->pages << PAGE_SHIFT);
+	struct vram_hole *tail = NULL;
 
-	rm = kzalloc(sizeof(*rm), GFP_KERNEL);
+	if (end < h_end && paddr > h->paddr) {
+		tail = kzalloc(sizeof(*tail), GFP_KERNEL);
+		if (!tail)
+			return -ENOMEM;
+	}
 
-	if (rm) {
-		INIT_LIST_HEAD(&rm->alloc_list);
-		rm->paddr = paddr;
-		rm->pages = pages;
+	rb_erase(&h->size_node, &hole_size_tree);
+
+	if (paddr == h->paddr && end == h_end) {
+		rb_erase(&h->addr_node, &hole_addr_tree);
+		kfree(h);
+		return 0;
 	}
 
-	return rm;
+	if (paddr == h->paddr) {
+		/* the address order of the holes does not change */
+		h->paddr = end;
+		h->pages = (h_end - end) >> PAGE_SHIFT;
+	} else {
+		h->pages = (paddr - h->paddr) >> PAGE_SHIFT;
+		if (tail) {
+			tail->region = h->region;
+			tail->paddr = end;
+			tail->pages = (h_end - end) >> PAGE_SHIFT;
+			hole_insert(tail);
+		}
+	}
+	hole_insert_size(h);
+	return 0;
 }
 
-#if 0
-static void omap_vram_free_region(struct vram_region *vr)
+/* return [paddr, paddr + pages) to the free space, merging neighbours */
+static void hole_release(struct vram_region *vr, unsigned long paddr,
+		unsigned pages)
 {
-	list_del(&vr->list);
-	kfree(vr);
+	struct rb_node *n = hole_addr_tree.rb_node, *prev_n = NULL;
+	struct vram_hole *prev = NULL, *next = NULL, *h;
+	unsigned long end = paddr + (pages << PAGE_SHIFT);
+
+	/* find the last hole below paddr */
+	while (n) {
+		h = rb_entry(n, struct vram_hole, addr_node);
+		if (h->paddr < paddr) {
+			prev_n = n;
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
+		}
+	}
+
+	if (prev_n) {
+		prev = rb_entry(prev_n, struct vram_hole, addr_node);
+		n = rb_next(prev_n);
+	} else {
+		n = rb_first(&hole_addr_tree);
+	}
+	if (n)
+		next = rb_entry(n, struct vram_hole, addr_node);
+
+	if (prev && (prev->region != vr ||
+		     prev->paddr + (prev->pages << PAGE_SHIFT) != paddr))
+		prev = NULL;
+	if (next && (next->region != vr || next->paddr != end))
+		next = NULL;
+
+	if (prev) {
+		rb_erase(&prev->size_node, &hole_size_tree);
+		prev->pages += pages;
+		if (next) {
+			prev->pages += next->pages;
+			hole_remove(next);
+		}
+		hole_insert_size(prev);
+		return;
+	}
+
+	if (next) {
+		rb_erase(&next->size_node, &hole_size_tree);
+		next->paddr = paddr;
+		next->pages += pages;
+		hole_insert_size(next);
+		return;
+	}
+
+	h = kzalloc(sizeof(*h), GFP_KERNEL);
+	if (!h) {
+		/* the pages are lost until the region is recreated */
+		pr_err("VRAM: lost %u pages at %08lx\n", pages, paddr);
+		return;
+	}
+	h->region = vr;
+	h->paddr = paddr;
+	h->pages = pages;
+	hole_insert(h);
 }
-#endif
 
-static struct vram_alloc *omap_vram_create_allocation(struct vram_region *vr,
-		unsigned long paddr, unsigned pages)
+static void alloc_insert(struct vram_alloc *va)
 {
-	struct vram_alloc *va;
-	struct vram_alloc *new;
+	struct rb_node **p = &alloc_tree.rb_node, *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (va->paddr < rb_entry(parent, struct vram_alloc,
+					 node)->paddr)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&va->node, parent, p);
+	rb_insert_color(&va->node, &alloc_tree);
+}
 
-	new = kzalloc(sizeof(*va), GFP_KERNEL);
+static struct vram_alloc *alloc_find(unsigned long paddr)
+{
+	struct rb_node *n = alloc_tree.rb_node;
 
-	if (!new)
-		return NULL;
+	while (n) {
+		struct vram_alloc *va = rb_entry(n, struct vram_alloc, node);
 
-	new->paddr = paddr;
-	new->pages = pages;
+		if (paddr < va->paddr)
+			n = n->rb_left;
+		else if (paddr > va->paddr)
+			n = n->rb_right;
+		else
+			return va;
+	}
+	return NULL;
+}
+
+/* allocate [paddr, paddr + pages) out of hole @h */
+static struct vram_alloc *omap_vram_create_allocation(struct vram_hole *h,
+		unsigned long paddr, unsigned pages,
+		struct omap_vram_client *client, void *data)
+{
+	struct vram_region *vr = h->region;
+	struct vram_alloc *va;
+
+	va = kzalloc(sizeof(*va), GFP_KERNEL);
+	if (!va)
+		return NULL;
 
-	list_for_each_entry(va, &vr->alloc_list, list) {
-		if (va->paddr > new->paddr)
-			break;
+	if (hole_carve(h, paddr, pages)) {
+		kfree(va);
+		return NULL;
 	}
 
-	list_add_tail(&new->list, &va->list);
+	va->region = vr;
+	va->paddr = paddr;
+	va->pages = pages;
+	va->client = client ? client : &vram_other_client;
+	va->data = data;
+	alloc_insert(va);
+
+	va->client->used += pages << PAGE_SHIFT;
+	va->client->allocs++;
 
-	return new;
+	return va;
 }
 
 static void omap_vram_free_allocation(struct vram_alloc *va)
 {
-	list_del(&va->list);
+	rb_erase(&va->node, &alloc_tree);
+	hole_release(va->region, va->paddr, va->pages);
+
+	va->client->used -= va->pages << PAGE_SHIFT;
+	va->client->allocs--;
 	kfree(va);
 }
 
@@ -135,11 +372,17 @@ int omap_vram_add_region(unsigned long paddr, size_t size)
 		size &= PAGE_MASK;
 		pages = size >> PAGE_SHIFT;
 
-		rm = omap_vram_create_region(paddr, pages);
+		rm = kzalloc(sizeof(*rm), GFP_KERNEL);
 		if (rm == NULL)
 			return -ENOMEM;
 
+		rm->paddr = paddr;
+		rm->pages = pages;
+
+		mutex_lock(&region_mutex);
 		list_add(&rm->list, &region_list);
+		hole_release(rm, paddr, pages);
+		mutex_unlock(&region_mutex);
 	} else {
 		if (postponed_cnt == MAX_POSTPONED_REGIONS)
 			return -ENOMEM;
@@ -152,82 +395,79 @@ int omap_vram_add_region(unsigned long paddr, size_t size)
 	return 0;
 }
 
-int omap_vram_free(unsigned long paddr, size_t size)
+int omap_vram_register_client(struct omap_vram_client *client)
 {
-	struct vram_region *rm;
-	struct vram_alloc *alloc;
-	unsigned start, end;
+	mutex_lock(&region_mutex);
+	client->used = 0;
+	client->allocs = 0;
+	client->moves = 0;
+	list_add_tail(&client->list, &client_list);
+	mutex_unlock(&region_mutex);
 
-	DBG("free mem paddr %08lx size %d\n", paddr, size);
+	return 0;
+}
+EXPORT_SYMBOL(omap_vram_register_client);
 
-	size = PAGE_ALIGN(size);
+void omap_vram_unregister_client(struct omap_vram_client *client)
+{
+	struct rb_node *n;
 
 	mutex_lock(&region_mutex);
+	WARN_ON(client->allocs);
 
-	list_for_each_entry(rm, &region_list, list) {
-		list_for_each_entry(alloc, &rm->alloc_list, list) {
-			start = alloc->paddr;
-			end = alloc->paddr + (alloc->pages >> PAGE_SHIFT);
+	/* keep accounting whatever the client left behind */
+	for (n = rb_first(&alloc_tree); n; n = rb_next(n)) {
+		struct vram_alloc *va = rb_entry(n, struct vram_alloc, node);
 
-			if (start >= paddr && end < paddr + size)
-				goto found;
+		if (va->client == client) {
+			va->client = &vram_other_client;
+			va->data = NULL;
+			vram_other_client.used += va->pages << PAGE_SHIFT;
+			vram_other_client.allocs++;
 		}
 	}
-
-	mutex_unlock(&region_mutex);
-	return -EINVAL;
-
-found:
-	omap_vram_free_allocation(alloc);
-
+	list_del(&client->list);
 	mutex_unlock(&region_mutex);
-	return 0;
 }
-EXPORT_SYMBOL(omap_vram_free);
+EXPORT_SYMBOL(omap_vram_unregister_client);
 
-static int _omap_vram_reserve(unsigned long paddr, unsigned pages)
+int omap_vram_free(unsigned long paddr, size_t size)
 {
-	struct vram_region *rm;
 	struct vram_alloc *alloc;
-	size_t size;
 
-	size = pages << PAGE_SHIFT;
-
-	list_for_each_entry(rm, &region_list, list) {
-		unsigned long start, end;
-
-		DBG("checking region %lx %d\n", rm->paddr, rm->pages);
+	DBG("free mem paddr %08lx size %d\n", paddr, size);
 
-		start = rm->paddr;
-		end = start + (rm->pages << PAGE_SHIFT) - 1;
-		if (start > paddr || end < paddr + size - 1)
-			continue;
+	size = PAGE_ALIGN(size);
 
-		DBG("block ok, checking allocs\n");
+	mutex_lock(&region_mutex);
 
-		list_for_each_entry(alloc, &rm->alloc_list, list) {
-			end = alloc->paddr - 1;
+	alloc = alloc_find(paddr);
+	if (!alloc) {
+		mutex_unlock(&region_mutex);
+		return -EINVAL;
+	}
 
-			if (start <= paddr && end >= paddr + size - 1)
-				goto found;
+	omap_vram_free_allocation(alloc);
 
-			start = alloc->paddr + (alloc->pages << PAGE_SHIFT);
-		}
+	mutex_unlock(&region_mutex);
+	return 0;
+}
+EXPORT_SYMBOL(omap_vram_free);
 
-		end = rm->paddr + (rm->pages << PAGE_SHIFT) - 1;
+static int _omap_vram_reserve(unsigned long paddr, unsigned pages)
+{
+	struct vram_hole *h;
 
-		if (!(start <= paddr && end >= paddr + size - 1))
-			continue;
-found:
-		DBG("found area start %lx, end %lx\n", start, end);
+	h = hole_find(paddr, pages);
+	if (!h)
+		return -ENOMEM;
 
-		if (omap_vram_create_allocation(rm, paddr, pages) == NULL)
-			return -ENOMEM;
+	DBG("found hole start %lx, %u pages\n", h->paddr, h->pages);
 
-		return 0;
-	}
+	if (omap_vram_create_allocation(h, paddr, pages, NULL, NULL) == NULL)
+		return -ENOMEM;
 
-	return -ENOMEM;
+	return 0;
 }
 
 int omap_vram_reserve(unsigned long paddr, size_t size)
@@ -256,7 +496,8 @@ static void _omap_vram_dma_cb(int lch, u16 ch_status, void *data)
 	complete(compl);
 }
 
-static int _omap_vram_clear(u32 paddr, unsigned pages)
+/* fill with zeroes if src is 0, otherwise copy from src */
+static int _omap_vram_dma(u32 paddr, u32 src, unsigned pages)
 {
 	struct completion compl;
 	unsigned elem_count;
@@ -270,7 +511,8 @@ static int _omap_vram_clear(u32 paddr, unsigned pages)
 			_omap_vram_dma_cb,
 			&compl, &lch);
 	if (r) {
-		pr_err("VRAM: request_dma failed for memory clear\n");
+		pr_err("VRAM: request_dma failed for memory %s\n",
+				src ? "copy" : "clear");
 		return -EBUSY;
 	}
 
@@ -285,13 +527,18 @@ static int _omap_vram_clear(u32 paddr, unsigned pages)
 	omap_set_dma_dest_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
 			paddr, 0, 0);
 
-	omap_set_dma_color_mode(lch, OMAP_DMA_CONSTANT_FILL, 0x000000);
+	if (src)
+		omap_set_dma_src_params(lch, 0, OMAP_DMA_AMODE_POST_INC,
+				src, 0, 0);
+	else
+		omap_set_dma_color_mode(lch, OMAP_DMA_CONSTANT_FILL, 0x000000);
 
 	omap_start_dma(lch);
 
 	if (wait_for_completion_timeout(&compl, msecs_to_jiffies(1000)) == 0) {
 		omap_stop_dma(lch);
-		pr_err("VRAM: dma timeout while clearing memory\n");
+		pr_err("VRAM: dma timeout while %s memory\n",
+				src ? "copying" : "clearing");
 		r = -EIO;
 		goto err;
 	}
@@ -303,68 +550,145 @@ err:
 	return r;
 }
 
-static int _omap_vram_alloc(unsigned pages, unsigned long *paddr)
+static int _omap_vram_clear(u32 paddr, unsigned pages)
 {
-	struct vram_region *rm;
-	struct vram_alloc *alloc;
+	return _omap_vram_dma(paddr, 0, pages);
+}
 
-	list_for_each_entry(rm, &region_list, list) {
-		unsigned long start, end;
+/*
+ * Move movable allocations, highest first, into the lowest hole below
+ * them that fits, until a hole of @pages exists.  Holes are free, so a
+ * move never copies onto itself.
+ */
+static void omap_vram_compact(unsigned pages)
+{
+	struct rb_node *n, *prev;
+
+	vram_stats.compactions++;
 
-		DBG("checking region %lx %d\n", rm->paddr, rm->pages);
+	for (n = rb_last(&alloc_tree); n; n = prev) {
+		struct vram_alloc *va = rb_entry(n, struct vram_alloc, node);
+		const struct omap_vram_client *c = va->client;
+		struct vram_region *old_vr = va->region, *new_vr;
+		unsigned long old = va->paddr, new;
+		struct vram_hole *h = NULL;
+		struct rb_node *hn;
+		int r;
 
-		start = rm->paddr;
+		prev = rb_prev(n);
 
-		list_for_each_entry(alloc, &rm->alloc_list, list) {
-			end = alloc->paddr;
+		if (hole_best_fit(pages))
+			return;
 
-			if (end - start >= pages << PAGE_SHIFT)
-				goto found;
+		if (!va->data || !c->prepare_move || !c->finish_move)
+			continue;
 
-			start = alloc->paddr + (alloc->pages << PAGE_SHIFT);
+		for (hn = rb_first(&hole_addr_tree); hn; hn = rb_next(hn)) {
+			h = rb_entry(hn, struct vram_hole, addr_node);
+			if (h->paddr > old) {
+				h = NULL;
+				break;
+			}
+			if (h->pages >= va->pages)
+				break;
+			h = NULL;
 		}
+		if (!h)
+			continue;
 
-		end = rm->paddr + (rm->pages << PAGE_SHIFT);
-found:
-		if (end - start < pages << PAGE_SHIFT)
+		new_vr = h->region;
+		new = h->paddr;
+
+		if (c->prepare_move(va->data, new))
 			continue;
 
-		DBG("found %lx, end %lx\n", start, end);
+		r = _omap_vram_dma(new, old, va->pages);
+		if (r || hole_carve(h, new, va->pages)) {
+			c->finish_move(va->data, old);
+			continue;
+		}
 
-		alloc = omap_vram_create_allocation(rm, start, pages);
-		if (alloc == NULL)
-			return -ENOMEM;
+		rb_erase(&va->node, &alloc_tree);
+		va->region = new_vr;
+		va->paddr = new;
+		alloc_insert(va);
+		hole_release(old_vr, old, va->pages);
+		va->client->moves++;
 
-		*paddr = start;
+		DBG("moved %s %lx => %lx, %u pages\n", c->name, old,
+				va->paddr, va->pages);
 
-		_omap_vram_clear(start, pages);
+		c->finish_move(va->data, va->paddr);
+	}
+}
 
-		return 0;
+static int _omap_vram_alloc(unsigned pages, unsigned long *paddr,
+		struct omap_vram_client *client, void *data)
+{
+	struct vram_hole *h;
+	unsigned long start;
+
+	h = hole_best_fit(pages);
+	if (!h) {
+		omap_vram_compact(pages);
+		h = hole_best_fit(pages);
+	}
+	if (!h) {
+		vram_stats.failures++;
+		return -ENOMEM;
 	}
 
-	return -ENOMEM;
+	start = h->paddr;
+
+	DBG("found %lx, %u pages\n", start, h->pages);
+
+	if (omap_vram_create_allocation(h, start, pages, client, data) == NULL)
+		return -ENOMEM;
+
+	*paddr = start;
+
+	_omap_vram_clear(start, pages);
+
+	return 0;
 }
 
-int omap_vram_alloc(size_t size, unsigned long *paddr)
+/*
+ * Allocate VRAM on behalf of @client.  If @data is not NULL and the client
+ * has move callbacks, the allocation may be moved to make room for a
+ * larger one: prepare_move(data, paddr) is called with the new address
+ * and returns 0 only if the memory is idle, then the contents are copied
+ * and finish_move(data, paddr) is called with the new address, or with
+ * the old one if the move failed.  Both are called with the VRAM lock
+ * held, so they must not call back into VRAM.
+ */
+int omap_vram_alloc_client(struct omap_vram_client *client, size_t size,
+		unsigned long *paddr, void *data)
 {
 	unsigned pages;
 	int r;
 
 	BUG_ON(!size);
 
-	DBG("alloc mem size %d\n", size);
+	DBG("alloc mem size %d for %s\n", size,
+			client ? client->name : "other");
 
 	size = PAGE_ALIGN(size);
 	pages = size >> PAGE_SHIFT;
 
 	mutex_lock(&region_mutex);
 
-	r = _omap_vram_alloc(pages, paddr);
+	r = _omap_vram_alloc(pages, paddr, client, data);
 
 	mutex_unlock(&region_mutex);
 
 	return r;
 }
+EXPORT_SYMBOL(omap_vram_alloc_client);
+
+int omap_vram_alloc(size_t size, unsigned long *paddr)
+{
+	return omap_vram_alloc_client(NULL, size, paddr, NULL);
+}
 EXPORT_SYMBOL(omap_vram_alloc);
 
 void omap_vram_get_info(unsigned long *vram,
@@ -372,7 +696,7 @@ void omap_vram_get_info(unsigned long *vram,
 		unsigned long *largest_free_block)
 {
 	struct vram_region *vr;
-	struct vram_alloc *va;
+	struct rb_node *n;
 
 	*vram = 0;
 	*free_vram = 0;
@@ -380,27 +704,20 @@ void omap_vram_get_info(unsigned long *vram,
 
 	mutex_lock(&region_mutex);
 
-	list_for_each_entry(vr, &region_list, list) {
-		unsigned free;
-		unsigned long pa;
-
-		pa = vr->paddr;
+	list_for_each_entry(vr, &region_list, list)
 		*vram += vr->pages << PAGE_SHIFT;
 
-		list_for_each_entry(va, &vr->alloc_list, list) {
-			free = va->paddr - pa;
-			*free_vram += free;
-			if (free > *largest_free_block)
-				*largest_free_block = free;
-			pa = va->paddr + (va->pages << PAGE_SHIFT);
-		}
+	for (n = rb_first(&hole_addr_tree); n; n = rb_next(n)) {
+		struct vram_hole *h = rb_entry(n, struct vram_hole, addr_node);
 
-		free = vr->paddr + (vr->pages << PAGE_SHIFT) - pa;
-		*free_vram += free;
-		if (free > *largest_free_block)
-			*largest_free_block = free;
+		*free_vram += h->pages << PAGE_SHIFT;
 	}
 
+	n = rb_last(&hole_size_tree);
+	if (n)
+		*largest_free_block = rb_entry(n, struct vram_hole,
+				size_node)->pages << PAGE_SHIFT;
+
 	mutex_unlock(&region_mutex);
 }
 EXPORT_SYMBOL(omap_vram_get_info);
@@ -408,9 +725,11 @@ EXPORT_SYMBOL(omap_vram_get_info);
 #if defined(CONFIG_DEBUG_FS)
 static int vram_debug_show(struct seq_file *s, void *unused)
 {
+	struct omap_vram_client *c;
 	struct vram_region *vr;
-	struct vram_alloc *va;
-	unsigned size;
+	struct rb_node *n;
+	unsigned size, holes = 0;
+	unsigned long free = 0, largest = 0;
 
 	mutex_lock(&region_mutex);
 
@@ -419,15 +738,41 @@ static int vram_debug_show(struct seq_file *s, void *unused)
 		seq_printf(s, "%08lx-%08lx (%d bytes)\n",
 				vr->paddr, vr->paddr + size - 1,
 				size);
+	}
 
-		list_for_each_entry(va, &vr->alloc_list, list) {
-			size = va->pages << PAGE_SHIFT;
-			seq_printf(s, "    %08lx-%08lx (%d bytes)\n",
-					va->paddr, va->paddr + size - 1,
-					size);
-		}
+	for (n = rb_first(&alloc_tree); n; n = rb_next(n)) {
+		struct vram_alloc *va = rb_entry(n, struct vram_alloc, node);
+
+		size = va->pages << PAGE_SHIFT;
+		seq_printf(s, "    %08lx-%08lx (%d bytes) %s%s\n",
+				va->paddr, va->paddr + size - 1,
+				size, va->client->name,
+				va->data ? " movable" : "");
 	}
 
+	for (n = rb_first(&hole_addr_tree); n; n = rb_next(n)) {
+		struct vram_hole *h = rb_entry(n, struct vram_hole, addr_node);
+
+		free += h->pages << PAGE_SHIFT;
+		largest = max(largest, (unsigned long)h->pages << PAGE_SHIFT);
+		holes++;
+	}
+
+	seq_printf(s, "\nfree %lu bytes in %u holes, largest %lu bytes, "
+			"fragmentation %lu%%\n", free, holes, largest,
+			free ? 100 - largest * 100 / free : 0);
+	seq_printf(s, "compactions %u, failed allocations %u\n\n",
+			vram_stats.compactions, vram_stats.failures);
+
+	seq_printf(s, "%-16s %10s %6s %6s\n", "client", "bytes", "allocs",
+			"moves");
+	list_for_each_entry(c, &client_list, list)
+		seq_printf(s, "%-16s %10zu %6u %6u\n", c->name, c->used,
+				c->allocs, c->moves);
+	c = &vram_other_client;
+	seq_printf(s, "%-16s %10zu %6u %6u\n", c->name, c->used, c->allocs,
+			c->moves);
+
 	mutex_unlock(&region_mutex);
 
 	return 0;
@@ -34,19 +34,13 @@
 #include <linux/file.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
 #include <asm/unaligned.h>
 #include "ecryptfs_kernel.h"
 
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
+#define DECRYPT		0
+#define ENCRYPT		1
 
 /**
  * ecryptfs_to_hex
@@ -243,7 +237,7 @@ void ecryptfs_destroy_crypt_stat(struct ecryptfs_crypt_stat *crypt_stat)
 	struct ecryptfs_key_sig *key_sig, *key_sig_tmp;
 
 	if (crypt_stat->tfm)
-		crypto_free_blkcipher(crypt_stat->tfm);
+		crypto_free_ablkcipher(crypt_stat->tfm);
 	if (crypt_stat->hash_tfm)
 		crypto_free_hash(crypt_stat->hash_tfm);
 	list_for_each_entry_safe(key_sig, key_sig_tmp,
@@ -323,25 +317,15 @@ int virt_to_scatterlist(const void *addr, int size, struct scatterlist *sg,
 }
 
 /**
- * encrypt_scatterlist
- * @crypt_stat: Pointer to the crypt_stat struct to initialize.
- * @dest_sg: Destination of encrypted data
- * @src_sg: Data to be encrypted
- * @size: Length of data to be encrypted
- * @iv: iv to use during encryption
+ * ecryptfs_set_tfm_key
+ * @crypt_stat: Cryptographic context
+ *
+ * Set the file's key on its tfm, the first time it is needed.
  *
- * Returns the number of bytes encrypted; negative value on error
+ * Returns zero on success; negative value on error
  */
-static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
+static int ecryptfs_set_tfm_key(struct ecryptfs_crypt_stat *crypt_stat)
 {
-	struct blkcipher_desc desc = {
-		.tfm = crypt_stat->tfm,
-		.info = iv,
-		.flags = CRYPTO_TFM_REQ_MAY_SLEEP
-	};
 	int rc = 0;
 
 	BUG_ON(!crypt_stat || !crypt_stat->tfm
@@ -352,27 +336,171 @@ static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
 		ecryptfs_dump_hex(crypt_stat->key,
 				  crypt_stat->key_size);
 	}
-	/* Consider doing this once, when the file is opened */
 	mutex_lock(&crypt_stat->cs_tfm_mutex);
 	if (!(crypt_stat->flags & ECRYPTFS_KEY_SET)) {
-		rc = crypto_blkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
-					     crypt_stat->key_size);
-		crypt_stat->flags |= ECRYPTFS_KEY_SET;
+		rc = crypto_ablkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
+					      crypt_stat->key_size);
+		if (!rc)
+			crypt_stat->flags |= ECRYPTFS_KEY_SET;
 	}
+	mutex_unlock(&crypt_stat->cs_tfm_mutex);
 	if (rc) {
 		ecryptfs_printk(KERN_ERR, "Error setting key; rc = [%d]\n",
 				rc);
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
 		rc = -EINVAL;
-		goto out;
 	}
-	ecryptfs_printk(KERN_DEBUG, "Encrypting [%d] bytes.\n", size);
-	crypto_blkcipher_encrypt_iv(&desc, dest_sg, src_sg, size);
-	mutex_unlock(&crypt_stat->cs_tfm_mutex);
-out:
 	return rc;
 }
 
+/*
+ * The extents of a batch of pages are handed to the cipher all at once
+ * and waited for together, so that asynchronous implementations can
+ * work on them back to back.  Every extent has its own IV, so they
+ * cannot be merged into one request.
+ */
+struct ecryptfs_crypt_batch {
+	atomic_t pending;
+	struct completion done;
+	int rc;
+};
+
+struct ecryptfs_extent_req {
+	u8 iv[ECRYPTFS_MAX_IV_BYTES];
+	struct scatterlist src_sg;
+	struct scatterlist dst_sg;
+	struct ecryptfs_crypt_batch *batch;
+	struct ablkcipher_request req;	/* followed by the tfm's context */
+};
+
+static void ecryptfs_extent_done(struct crypto_async_request *areq, int err)
+{
+	struct ecryptfs_extent_req *er = areq->data;
+	struct ecryptfs_crypt_batch *batch = er->batch;
+
+	/* a backlogged request was started */
+	if (err == -EINPROGRESS)
+		return;
+	if (err)
+		batch->rc = err;
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+/**
+ * ecryptfs_crypt_pages
+ * @crypt_stat: Cryptographic context of the file
+ * @pages: eCryptfs pages whose index determines the extent IVs
+ * @dst_pages: Pages to encrypt or decrypt into
+ * @src_pages: Pages to encrypt or decrypt from; may be @dst_pages
+ * @nr_pages: Number of pages in each array
+ * @op: ENCRYPT or DECRYPT
+ *
+ * Returns zero on success; negative value on error
+ */
+static int ecryptfs_crypt_pages(struct ecryptfs_crypt_stat *crypt_stat,
+				struct page **pages, struct page **dst_pages,
+				struct page **src_pages, int nr_pages, int op)
+{
+	struct crypto_ablkcipher *tfm = crypt_stat->tfm;
+	int extents_per_page = PAGE_CACHE_SIZE / crypt_stat->extent_size;
+	int nr = nr_pages * extents_per_page;
+	struct ecryptfs_crypt_batch batch;
+	size_t stride;
+	char *reqs;
+	int i, rc;
+
+	rc = ecryptfs_set_tfm_key(crypt_stat);
+	if (rc)
+		return rc;
+
+	stride = ALIGN(sizeof(struct ecryptfs_extent_req)
+		       + crypto_ablkcipher_reqsize(tfm), ARCH_KMALLOC_MINALIGN);
+	reqs = kmalloc(nr * stride, GFP_NOFS);
+	if (!reqs)
+		return -ENOMEM;
+
+	atomic_set(&batch.pending, 1);
+	init_completion(&batch.done);
+	batch.rc = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct ecryptfs_extent_req *er = (void *)(reqs + i * stride);
+		int p = i / extents_per_page;
+		unsigned long extent_offset = i % extents_per_page;
+		loff_t extent_num = ((loff_t)pages[p]->index
+				     * extents_per_page) + extent_offset;
+		unsigned int offset = extent_offset * crypt_stat->extent_size;
+
+		rc = ecryptfs_derive_iv(er->iv, crypt_stat, extent_num);
+		if (rc) {
+			ecryptfs_printk(KERN_ERR, "Error attempting to derive "
+					"IV for extent [0x%.16llx]; "
+					"rc = [%d]\n",
+					(unsigned long long)extent_num, rc);
+			break;
+		}
+		sg_init_table(&er->src_sg, 1);
+		sg_set_page(&er->src_sg, src_pages[p], crypt_stat->extent_size,
+			    offset);
+		sg_init_table(&er->dst_sg, 1);
+		sg_set_page(&er->dst_sg, dst_pages[p], crypt_stat->extent_size,
+			    offset);
+		er->batch = &batch;
+
+		ablkcipher_request_set_tfm(&er->req, tfm);
+		ablkcipher_request_set_callback(&er->req,
+				CRYPTO_TFM_REQ_MAY_BACKLOG |
+				CRYPTO_TFM_REQ_MAY_SLEEP,
+				ecryptfs_extent_done, er);
+		ablkcipher_request_set_crypt(&er->req, &er->src_sg,
+					     &er->dst_sg,
+					     crypt_stat->extent_size, er->iv);
+
+		atomic_inc(&batch.pending);
+		if (op == ENCRYPT)
+			rc = crypto_ablkcipher_encrypt(&er->req);
+		else
+			rc = crypto_ablkcipher_decrypt(&er->req);
+		if (rc == -EINPROGRESS || rc == -EBUSY) {
+			rc = 0;
+			continue;
+		}
+		/* done synchronously, without calling back */
+		ecryptfs_extent_done(&er->req.base, rc);
+		if (rc) {
+			ecryptfs_printk(KERN_ERR, "Error %scrypting extent "
+					"[0x%.16llx]; rc = [%d]\n",
+					op == ENCRYPT ? "en" : "de",
+					(unsigned long long)extent_num, rc);
+			break;
+		}
+	}
+
+	if (!atomic_dec_and_test(&batch.pending))
+		wait_for_completion(&batch.done);
+	kfree(reqs);
+
+	return rc ? rc : batch.rc;
+}
+
+static void ecryptfs_account_crypt(struct inode *ecryptfs_inode, int nr_pages,
+				   int op, ktime_t start)
+{
+	struct ecryptfs_mount_crypt_stat *mount_crypt_stat =
+		&ecryptfs_superblock_to_private(
+			ecryptfs_inode->i_sb)->mount_crypt_stat;
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 bytes = (u64)nr_pages << PAGE_CACHE_SHIFT;
+
+	if (op == ENCRYPT) {
+		atomic64_add(bytes, &mount_crypt_stat->bytes_encrypted);
+		atomic64_add(ns, &mount_crypt_stat->encrypt_ns);
+	} else {
+		atomic64_add(bytes, &mount_crypt_stat->bytes_decrypted);
+		atomic64_add(ns, &mount_crypt_stat->decrypt_ns);
+	}
+}
+
 /**
  * ecryptfs_lower_offset_for_extent
  *
@@ -385,110 +513,74 @@ static void ecryptfs_lower_offset_for_extent(loff_t *offset, loff_t extent_num,
 		    + (crypt_stat->extent_size * extent_num);
 }
 
-/**
- * ecryptfs_encrypt_extent
- * @enc_extent_page: Allocated page into which to encrypt the data in
- *                   @page
- * @crypt_stat: crypt_stat containing cryptographic context for the
- *              encryption operation
- * @page: Page containing plaintext data extent to encrypt
- * @extent_offset: Page extent offset for use in generating IV
- *
- * Encrypts one extent of data.
- *
- * Return zero on success; non-zero otherwise
- */
-static int ecryptfs_encrypt_extent(struct page *enc_extent_page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *page,
-				   unsigned long extent_offset)
+static loff_t ecryptfs_lower_offset_for_page(struct page *page,
+				struct ecryptfs_crypt_stat *crypt_stat)
 {
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
+	loff_t offset;
 
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
-		goto out;
-	}
-	rc = ecryptfs_encrypt_page_offset(crypt_stat, enc_extent_page, 0,
-					  page, (extent_offset
-						 * crypt_stat->extent_size),
-					  crypt_stat->extent_size, extent_iv);
-	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to encrypt page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
-		goto out;
-	}
-	rc = 0;
-out:
-	return rc;
+	ecryptfs_lower_offset_for_extent(&offset,
+		((loff_t)page->index) * (PAGE_CACHE_SIZE
+					 / crypt_stat->extent_size),
+		crypt_stat);
+	return offset;
 }
 
 /**
- * ecryptfs_encrypt_page
- * @page: Page mapped from the eCryptfs inode for the file; contains
- *        decrypted content that needs to be encrypted (to a temporary
- *        page; not in place) and written out to the lower file
+ * ecryptfs_encrypt_pages
+ * @pages: Pages mapped from the eCryptfs inode for one file; contain
+ *         decrypted content that needs to be encrypted (to temporary
+ *         pages; not in place) and written out to the lower file
+ * @nr_pages: Number of pages, at most ECRYPTFS_BATCH_PAGES
  *
- * Encrypt an eCryptfs page. This is done on a per-extent basis. Note
- * that eCryptfs pages may straddle the lower pages -- for instance,
- * if the file was created on a machine with an 8K page size
- * (resulting in an 8K header), and then the file is copied onto a
- * host with a 32K page size, then when reading page 0 of the eCryptfs
- * file, 24K of page 0 of the lower file will be read and decrypted,
- * and then 8K of page 1 of the lower file will be read and decrypted.
+ * Encrypt eCryptfs pages.  The extents of all pages go to the cipher as
+ * one batch, then every page is written out to the lower file with one
+ * write.  Note that eCryptfs pages may straddle the lower pages -- for
+ * instance, if the file was created on a machine with an 8K page size
+ * (resulting in an 8K header), and then the file is copied onto a host
+ * with a 32K page size, then when reading page 0 of the eCryptfs file,
+ * 24K of page 0 of the lower file will be read and decrypted, and then
+ * 8K of page 1 of the lower file will be read and decrypted.
  *
  * Returns zero on success; negative on error
  */
-int ecryptfs_encrypt_page(struct page *page)
+int ecryptfs_encrypt_pages(struct page **pages, int nr_pages)
 {
 	struct inode *ecryptfs_inode;
 	struct ecryptfs_crypt_stat *crypt_stat;
-	char *enc_extent_virt;
-	struct page *enc_extent_page = NULL;
-	loff_t extent_offset;
+	struct page *enc_pages[ECRYPTFS_BATCH_PAGES];
+	ktime_t start = ktime_get();
+	int i, nr_enc = 0;
 	int rc = 0;
 
-	ecryptfs_inode = page->mapping->host;
+	BUG_ON(nr_pages > ECRYPTFS_BATCH_PAGES);
+	ecryptfs_inode = pages[0]->mapping->host;
 	crypt_stat =
 		&(ecryptfs_inode_to_private(ecryptfs_inode)->crypt_stat);
 	BUG_ON(!(crypt_stat->flags & ECRYPTFS_ENCRYPTED));
-	enc_extent_page = alloc_page(GFP_USER);
-	if (!enc_extent_page) {
-		rc = -ENOMEM;
-		ecryptfs_printk(KERN_ERR, "Error allocating memory for "
-				"encrypted extent\n");
+	for (nr_enc = 0; nr_enc < nr_pages; nr_enc++) {
+		enc_pages[nr_enc] = alloc_page(GFP_USER);
+		if (!enc_pages[nr_enc]) {
+			rc = -ENOMEM;
+			ecryptfs_printk(KERN_ERR, "Error allocating memory for "
+					"encrypted extent\n");
+			goto out;
+		}
+	}
+	rc = ecryptfs_crypt_pages(crypt_stat, pages, enc_pages, pages,
+				  nr_pages, ENCRYPT);
+	if (rc) {
+		printk(KERN_ERR "%s: Error encrypting extent; "
+		       "rc = [%d]\n", __func__, rc);
 		goto out;
 	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
+	for (i = 0; i < nr_pages; i++) {
+		char *enc_extent_virt = kmap(enc_pages[i]);
 
-		rc = ecryptfs_encrypt_extent(enc_extent_page, crypt_stat, page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((((loff_t)page->index)
-				   * (PAGE_CACHE_SIZE
-				      / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
 		rc = ecryptfs_write_lower(ecryptfs_inode, enc_extent_virt,
-					  offset, crypt_stat->extent_size);
+				ecryptfs_lower_offset_for_page(pages[i],
+							       crypt_stat),
+				PAGE_CACHE_SIZE);
+		kunmap(enc_pages[i]);
 		if (rc < 0) {
 			ecryptfs_printk(KERN_ERR, "Error attempting "
 					"to write lower page; rc = [%d]"
@@ -497,222 +589,99 @@ int ecryptfs_encrypt_page(struct page *page)
 		}
 	}
 	rc = 0;
+	ecryptfs_account_crypt(ecryptfs_inode, nr_pages, ENCRYPT, start);
 out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
+	while (nr_enc--)
+		__free_page(enc_pages[nr_enc]);
 	return rc;
 }
 
-static int ecryptfs_decrypt_extent(struct page *page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *enc_extent_page,
-				   unsigned long extent_offset)
+/**
+ * ecryptfs_encrypt_page
+ * @page: Page mapped from the eCryptfs inode for the file; contains
+ *        decrypted content that needs to be encrypted (to a temporary
+ *        page; not in place) and written out to the lower file
+ *
+ * Returns zero on success; negative on error
+ */
+int ecryptfs_encrypt_page(struct page *page)
 {
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
-
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
-		goto out;
-	}
-	rc = ecryptfs_decrypt_page_offset(crypt_stat, page,
-					  (extent_offset
-					   * crypt_stat->extent_size),
-					  enc_extent_page, 0,
-					  crypt_stat->extent_size, extent_iv);
-	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to decrypt to page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
-		goto out;
-	}
-	rc = 0;
-out:
-	return rc;
+	return ecryptfs_encrypt_pages(&page, 1);
 }
 
 /**
- * ecryptfs_decrypt_page
- * @page: Page mapped from the eCryptfs inode for the file; data read
- *        and decrypted from the lower file will be written into this
- *        page
+ * ecryptfs_decrypt_pages
+ * @pages: Pages mapped from the eCryptfs inode for one file; data read
+ *         and decrypted from the lower file will be written into these
+ * @nr_pages: Number of pages
  *
- * Decrypt an eCryptfs page. This is done on a per-extent basis. Note
- * that eCryptfs pages may straddle the lower pages -- for instance,
- * if the file was created on a machine with an 8K page size
- * (resulting in an 8K header), and then the file is copied onto a
- * host with a 32K page size, then when reading page 0 of the eCryptfs
- * file, 24K of page 0 of the lower file will be read and decrypted,
- * and then 8K of page 1 of the lower file will be read and decrypted.
+ * Decrypt eCryptfs pages.  The lower data is read straight into the
+ * pages and decrypted in place, all extents as one batch.  The lower
+ * file's copy of the data is dropped from the page cache afterwards:
+ * it would only be read again if the decrypted page were evicted, and
+ * keeping both doubles the memory used by the file.  See
+ * ecryptfs_encrypt_pages() about pages that straddle lower pages.
  *
  * Returns zero on success; negative on error
  */
-int ecryptfs_decrypt_page(struct page *page)
+int ecryptfs_decrypt_pages(struct page **pages, int nr_pages)
 {
 	struct inode *ecryptfs_inode;
 	struct ecryptfs_crypt_stat *crypt_stat;
-	char *enc_extent_virt;
-	struct page *enc_extent_page = NULL;
-	unsigned long extent_offset;
+	struct address_space *lower_mapping;
+	ktime_t start = ktime_get();
+	loff_t offset = 0;
+	int i;
 	int rc = 0;
 
-	ecryptfs_inode = page->mapping->host;
+	ecryptfs_inode = pages[0]->mapping->host;
 	crypt_stat =
 		&(ecryptfs_inode_to_private(ecryptfs_inode)->crypt_stat);
 	BUG_ON(!(crypt_stat->flags & ECRYPTFS_ENCRYPTED));
-	enc_extent_page = alloc_page(GFP_USER);
-	if (!enc_extent_page) {
-		rc = -ENOMEM;
-		ecryptfs_printk(KERN_ERR, "Error allocating memory for "
-				"encrypted extent\n");
-		goto out;
-	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
-
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((page->index * (PAGE_CACHE_SIZE
-						  / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
-		rc = ecryptfs_read_lower(enc_extent_virt, offset,
-					 crypt_stat->extent_size,
+	lower_mapping = ecryptfs_inode_to_lower(ecryptfs_inode)->i_mapping;
+	for (i = 0; i < nr_pages; i++) {
+		char *page_virt = kmap(pages[i]);
+
+		offset = ecryptfs_lower_offset_for_page(pages[i], crypt_stat);
+		rc = ecryptfs_read_lower(page_virt, offset, PAGE_CACHE_SIZE,
 					 ecryptfs_inode);
+		kunmap(pages[i]);
 		if (rc < 0) {
 			ecryptfs_printk(KERN_ERR, "Error attempting "
 					"to read lower page; rc = [%d]"
 					"\n", rc);
 			goto out;
 		}
-		rc = ecryptfs_decrypt_extent(page, crypt_stat, enc_extent_page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
+		invalidate_mapping_pages(lower_mapping,
+					 offset >> PAGE_CACHE_SHIFT,
+					 (offset + PAGE_CACHE_SIZE - 1)
+					 >> PAGE_CACHE_SHIFT);
 	}
-out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
-	return rc;
-}
-
-/**
- * decrypt_scatterlist
- * @crypt_stat: Cryptographic context
- * @dest_sg: The destination scatterlist to decrypt into
- * @src_sg: The source scatterlist to decrypt from
- * @size: The number of bytes to decrypt
- * @iv: The initialization vector to use for the decryption
- *
- * Returns the number of bytes decrypted; negative value on error
- */
-static int decrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
-{
-	struct blkcipher_desc desc = {
-		.tfm = crypt_stat->tfm,
-		.info = iv,
-		.flags = CRYPTO_TFM_REQ_MAY_SLEEP
-	};
-	int rc = 0;
-
-	/* Consider doing this once, when the file is opened */
-	mutex_lock(&crypt_stat->cs_tfm_mutex);
-	rc = crypto_blkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
-				     crypt_stat->key_size);
+	rc = ecryptfs_crypt_pages(crypt_stat, pages, pages, pages,
+				  nr_pages, DECRYPT);
 	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error setting key; rc = [%d]\n",
-				rc);
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
-		rc = -EINVAL;
-		goto out;
-	}
-	ecryptfs_printk(KERN_DEBUG, "Decrypting [%d] bytes.\n", size);
-	rc = crypto_blkcipher_decrypt_iv(&desc, dest_sg, src_sg, size);
-	mutex_unlock(&crypt_stat->cs_tfm_mutex);
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error decrypting; rc = [%d]\n",
-				rc);
+		printk(KERN_ERR "%s: Error decrypting extent; "
+		       "rc = [%d]\n", __func__, rc);
 		goto out;
 	}
-	rc = size;
+	for (i = 0; i < nr_pages; i++)
+		flush_dcache_page(pages[i]);
+	ecryptfs_account_crypt(ecryptfs_inode, nr_pages, DECRYPT, start);
 out:
 	return rc;
 }
 
 /**
- * ecryptfs_encrypt_page_offset
- * @crypt_stat: The cryptographic context
- * @dst_page: The page to encrypt into
- * @dst_offset: The offset in the page to encrypt into
- * @src_page: The page to encrypt from
- * @src_offset: The offset in the page to encrypt from
- * @size: The number of bytes to encrypt
- * @iv: The initialization vector to use for the encryption
- *
- * Returns the number of bytes encrypted
- */
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
-{
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_init_table(&dst_sg, 1);
-
-	sg_set_page(&src_sg, src_page, size, src_offset);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-	return encrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
-}
-
-/**
- * ecryptfs_decrypt_page_offset
- * @crypt_stat: The cryptographic context
- * @dst_page: The page to decrypt into
- * @dst_offset: The offset in the page to decrypt into
- * @src_page: The page to decrypt from
- * @src_offset: The offset in the page to decrypt from
- * @size: The number of bytes to decrypt
- * @iv: The initialization vector to use for the decryption
+ * ecryptfs_decrypt_page
+ * @page: Page mapped from the eCryptfs inode for the file; data read
+ *        and decrypted from the lower file will be written into this
+ *        page
  *
- * Returns the number of bytes decrypted
+ * Returns zero on success; negative on error
  */
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
+int ecryptfs_decrypt_page(struct page *page)
 {
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_set_page(&src_sg, src_page, size, src_offset);
-
-	sg_init_table(&dst_sg, 1);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-
-	return decrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
+	return ecryptfs_decrypt_pages(&page, 1);
 }
 
 #define ECRYPTFS_MAX_SCATTERLIST_LEN 4
@@ -749,8 +718,7 @@ int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat)
 						    crypt_stat->cipher, "cbc");
 	if (rc)
 		goto out_unlock;
-	crypt_stat->tfm = crypto_alloc_blkcipher(full_alg_name, 0,
-						 CRYPTO_ALG_ASYNC);
+	crypt_stat->tfm = crypto_alloc_ablkcipher(full_alg_name, 0, 0);
 	kfree(full_alg_name);
 	if (IS_ERR(crypt_stat->tfm)) {
 		rc = PTR_ERR(crypt_stat->tfm);
@@ -760,7 +728,7 @@ int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat)
 				crypt_stat->cipher);
 		goto out_unlock;
 	}
-	crypto_blkcipher_set_flags(crypt_stat->tfm, CRYPTO_TFM_REQ_WEAK_KEY);
+	crypto_ablkcipher_set_flags(crypt_stat->tfm, CRYPTO_TFM_REQ_WEAK_KEY);
 	rc = 0;
 out_unlock:
 	mutex_unlock(&crypt_stat->cs_tfm_mutex);
@@ -79,6 +79,75 @@ out:
 	return rc;
 }
 
+/* locked pages gathered by writepages and readpages */
+struct ecryptfs_page_batch {
+	struct page *pages[ECRYPTFS_BATCH_PAGES];
+	int nr;
+};
+
+static void ecryptfs_end_batch(struct ecryptfs_page_batch *batch, int rc)
+{
+	int i;
+
+	for (i = 0; i < batch->nr; i++) {
+		if (rc)
+			ClearPageUptodate(batch->pages[i]);
+		else
+			SetPageUptodate(batch->pages[i]);
+		unlock_page(batch->pages[i]);
+	}
+	batch->nr = 0;
+}
+
+static int ecryptfs_write_batch(struct ecryptfs_page_batch *batch)
+{
+	int rc;
+
+	if (!batch->nr)
+		return 0;
+	rc = ecryptfs_encrypt_pages(batch->pages, batch->nr);
+	if (rc)
+		ecryptfs_printk(KERN_WARNING, "Error encrypting "
+				"pages (upper index [0x%.16lx] + %d)\n",
+				batch->pages[0]->index, batch->nr);
+	ecryptfs_end_batch(batch, rc);
+	return rc;
+}
+
+static int ecryptfs_writepages_fill(struct page *page,
+				    struct writeback_control *wbc, void *data)
+{
+	struct ecryptfs_page_batch *batch = data;
+
+	batch->pages[batch->nr++] = page;
+	if (batch->nr == ECRYPTFS_BATCH_PAGES)
+		return ecryptfs_write_batch(batch);
+	return 0;
+}
+
+/**
+ * ecryptfs_writepages
+ *
+ * Like ecryptfs_writepage(), but encrypts up to ECRYPTFS_BATCH_PAGES
+ * dirty pages at a time.  The pages stay locked until their batch is
+ * written.
+ */
+static int ecryptfs_writepages(struct address_space *mapping,
+			       struct writeback_control *wbc)
+{
+	struct ecryptfs_page_batch batch = { .nr = 0 };
+	int rc;
+
+	rc = write_cache_pages(mapping, wbc, ecryptfs_writepages_fill, &batch);
+	if (batch.nr) {
+		int err = ecryptfs_write_batch(&batch);
+
+		if (!rc)
+			rc = err;
+	}
+	return rc;
+}
+
 static void strip_xattr_flag(char *page_virt,
 			     struct ecryptfs_crypt_stat *crypt_stat)
 {
@@ -243,6 +312,57 @@ out:
 	return rc;
 }
 
+static int ecryptfs_read_batch(struct ecryptfs_page_batch *batch)
+{
+	int rc;
+
+	if (!batch->nr)
+		return 0;
+	rc = ecryptfs_decrypt_pages(batch->pages, batch->nr);
+	if (rc)
+		ecryptfs_printk(KERN_ERR, "Error decrypting pages; "
+				"rc = [%d]\n", rc);
+	ecryptfs_end_batch(batch, rc);
+	return rc;
+}
+
+static int ecryptfs_readpages_fill(void *data, struct page *page)
+{
+	struct ecryptfs_page_batch *batch = data;
+	struct ecryptfs_crypt_stat *crypt_stat =
+		&ecryptfs_inode_to_private(page->mapping->host)->crypt_stat;
+
+	if (!(crypt_stat->flags & ECRYPTFS_ENCRYPTED)
+	    || (crypt_stat->flags & ECRYPTFS_VIEW_AS_ENCRYPTED))
+		return ecryptfs_readpage(NULL, page);
+
+	batch->pages[batch->nr++] = page;
+	if (batch->nr == ECRYPTFS_BATCH_PAGES)
+		return ecryptfs_read_batch(batch);
+	return 0;
+}
+
+/**
+ * ecryptfs_readpages
+ *
+ * Readahead: decrypt up to ECRYPTFS_BATCH_PAGES pages at a time.
+ */
+static int ecryptfs_readpages(struct file *file, struct address_space *mapping,
+			      struct list_head *pages, unsigned nr_pages)
+{
+	struct ecryptfs_page_batch batch = { .nr = 0 };
+	int rc;
+
+	rc = read_cache_pages(mapping, pages, ecryptfs_readpages_fill, &batch);
+	if (batch.nr) {
+		int err = ecryptfs_read_batch(&batch);
+
+		if (!rc)
+			rc = err;
+	}
+	return rc;
+}
+
 /**
  * Called with lower inode mutex held.
  */
@@ -546,7 +666,9 @@ static sector_t ecryptfs_bmap(struct address_space *mapping, sector_t block)
 
 const struct address_space_operations ecryptfs_aops = {
 	.writepage = ecryptfs_writepage,
+	.writepages = ecryptfs_writepages,
 	.readpage = ecryptfs_readpage,
+	.readpages = ecryptfs_readpages,
 	.write_begin = ecryptfs_write_begin,
 	.write_end = ecryptfs_write_end,
 	.bmap = ecryptfs_bmap,
@@ -32,6 +32,7 @@
 #include <linux/crypto.h>
 #include <linux/statfs.h>
 #include <linux/magic.h>
+#include <linux/math64.h>
 #include "ecryptfs_kernel.h"
 
 struct kmem_cache *ecryptfs_inode_info_cache;
@@ -181,11 +182,40 @@ static int ecryptfs_show_options(struct seq_file *m, struct dentry *root)
 	return 0;
 }
 
+static u64 ecryptfs_kib_per_sec(u64 bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * (NSEC_PER_SEC >> 10), ns) : 0;
+}
+
+/*
+ * Data encrypted and written out, and read in and decrypted, with the
+ * time spent, lower file I/O included.  Shown in /proc/self/mountstats.
+ */
+static int ecryptfs_show_stats(struct seq_file *m, struct dentry *root)
+{
+	struct ecryptfs_mount_crypt_stat *mount_crypt_stat =
+		&ecryptfs_superblock_to_private(root->d_sb)->mount_crypt_stat;
+	u64 enc_bytes = atomic64_read(&mount_crypt_stat->bytes_encrypted);
+	u64 enc_ns = atomic64_read(&mount_crypt_stat->encrypt_ns);
+	u64 dec_bytes = atomic64_read(&mount_crypt_stat->bytes_decrypted);
+	u64 dec_ns = atomic64_read(&mount_crypt_stat->decrypt_ns);
+
+	seq_printf(m, "\n\tencrypt: %llu bytes %llu us %llu KiB/s",
+		   enc_bytes, div_u64(enc_ns, NSEC_PER_USEC),
+		   ecryptfs_kib_per_sec(enc_bytes, enc_ns));
+	seq_printf(m, "\n\tdecrypt: %llu bytes %llu us %llu KiB/s",
+		   dec_bytes, div_u64(dec_ns, NSEC_PER_USEC),
+		   ecryptfs_kib_per_sec(dec_bytes, dec_ns));
+
+	return 0;
+}
+
 const struct super_operations ecryptfs_sops = {
 	.alloc_inode = ecryptfs_alloc_inode,
 	.destroy_inode = ecryptfs_destroy_inode,
 	.statfs = ecryptfs_statfs,
 	.remount_fs = NULL,
 	.evict_inode = ecryptfs_evict_inode,
-	.show_options = ecryptfs_show_options
+	.show_options = ecryptfs_show_options,
+	.show_stats = ecryptfs_show_stats
 };
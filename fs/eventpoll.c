@@ -33,6 +33,7 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/hrtimer.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 #include <asm/mman.h>
@@ -87,7 +88,12 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+
+#define EPOLLINOUT_BITS (POLLIN | POLLOUT)
+
+#define EPOLLEXCLUSIVE_OK_BITS (EPOLLINOUT_BITS | POLLERR | POLLHUP | \
+				EPOLLET | EPOLLEXCLUSIVE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -202,6 +208,15 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+	/* Wakeup batching, see struct epoll_batch; all under ->lock */
+	unsigned int batch_min;
+	unsigned int batch_usec;
+	unsigned int batch_events;	/* ready since the waiters slept */
+	bool batch_expired;
+	struct hrtimer batch_timer;
+
+	struct epoll_stats stats;
 };
 
 /* Wait structure used by the poll hooks */
@@ -704,6 +719,7 @@ static void ep_free(struct eventpoll *ep)
 	}
 
 	mutex_unlock(&epmutex);
+	hrtimer_cancel(&ep->batch_timer);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	kfree(ep);
@@ -769,10 +785,50 @@ static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
 	return pollflags != -1 ? pollflags : 0;
 }
 
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+	void __user *uarg = (void __user *)arg;
+	struct epoll_batch batch;
+	struct epoll_stats stats;
+
+	switch (cmd) {
+	case EPIOC_SET_BATCH:
+		if (copy_from_user(&batch, uarg, sizeof(batch)))
+			return -EFAULT;
+		if (batch.timeout_us > USEC_PER_SEC)
+			return -EINVAL;
+		spin_lock_irq(&ep->lock);
+		ep->batch_min = batch.min_events;
+		ep->batch_usec = batch.timeout_us;
+		/* let current waiters go, they slept under other rules */
+		ep->batch_expired = true;
+		if (waitqueue_active(&ep->wq) && ep_events_available(ep))
+			wake_up_locked(&ep->wq);
+		spin_unlock_irq(&ep->lock);
+		return 0;
+	case EPIOC_GET_BATCH:
+		spin_lock_irq(&ep->lock);
+		batch.min_events = ep->batch_min;
+		batch.timeout_us = ep->batch_usec;
+		spin_unlock_irq(&ep->lock);
+		return copy_to_user(uarg, &batch, sizeof(batch)) ? -EFAULT : 0;
+	case EPIOC_GET_STATS:
+		spin_lock_irq(&ep->lock);
+		stats = ep->stats;
+		spin_unlock_irq(&ep->lock);
+		return copy_to_user(uarg, &stats, sizeof(stats)) ? -EFAULT : 0;
+	}
+
+	return -ENOTTY;
+}
+
 /* File callbacks that implement the eventpoll file behaviour */
 static const struct file_operations eventpoll_fops = {
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
 	.llseek		= noop_llseek,
 };
 
@@ -835,6 +891,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->batch_timer.function = ep_batch_timeout;
 
 	*pep = ep;
 
@@ -874,14 +932,49 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+/*
+ * Must be called with "ep->lock" held.  Returns true while a waiter
+ * should be left sleeping to collect more events.
+ */
+static inline bool ep_batch_pending(struct eventpoll *ep)
+{
+	return ep->batch_min > 1 && !ep->batch_expired &&
+		ep->batch_events < ep->batch_min;
+}
+
+static enum hrtimer_restart ep_batch_timeout(struct hrtimer *timer)
+{
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    batch_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (!ep->batch_expired) {
+		ep->batch_expired = true;
+		ep->stats.batch_timeouts++;
+		if (waitqueue_active(&ep->wq)) {
+			ep->stats.wakeups++;
+			wake_up_locked(&ep->wq);
+		}
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
+ *
+ * For EPOLLEXCLUSIVE items the return value tells __wake_up_common()
+ * whether this epoll consumed the exclusive wakeup, i.e. it woke one of
+ * its waiters for an event the item asked for.
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
 	int pwake = 0;
+	int ewake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -932,15 +1025,47 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	}
 
 	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink))
+	if (!ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
+		ep->batch_events++;
+	}
+	ep->stats.callbacks++;
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list.  A batching waiter is only woken once enough events
+	 * have been collected, the timer bounds how long the first of them
+	 * waits.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->wq)) {
+		if (ep_batch_pending(ep)) {
+			ep->stats.batched++;
+			if (ep->batch_events == 1 && ep->batch_usec)
+				hrtimer_start(&ep->batch_timer,
+					ns_to_ktime((u64)ep->batch_usec *
+						    NSEC_PER_USEC),
+					HRTIMER_MODE_REL);
+		} else {
+			if ((epi->event.events & EPOLLEXCLUSIVE) &&
+			    !((unsigned long)key & POLLFREE)) {
+				switch ((unsigned long)key & EPOLLINOUT_BITS) {
+				case POLLIN:
+					if (epi->event.events & POLLIN)
+						ewake = 1;
+					break;
+				case POLLOUT:
+					if (epi->event.events & POLLOUT)
+						ewake = 1;
+					break;
+				case 0:
+					ewake = 1;
+					break;
+				}
+			}
+			ep->stats.wakeups++;
+			wake_up_locked(&ep->wq);
+		}
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -951,7 +1076,10 @@ out_unlock:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
-	return 1;
+	if (!(epi->event.events & EPOLLEXCLUSIVE))
+		ewake = 1;
+
+	return ewake;
 }
 
 /*
@@ -968,7 +1096,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1348,11 +1479,20 @@ static int ep_send_events(struct eventpoll *ep,
 			  struct epoll_event __user *events, int maxevents)
 {
 	struct ep_send_events_data esed;
+	unsigned long flags;
+	int res;
 
 	esed.maxevents = maxevents;
 	esed.events = events;
 
-	return ep_scan_ready_list(ep, ep_send_events_proc, &esed, 0);
+	res = ep_scan_ready_list(ep, ep_send_events_proc, &esed, 0);
+	if (res > 0) {
+		spin_lock_irqsave(&ep->lock, flags);
+		ep->stats.events += res;
+		spin_unlock_irqrestore(&ep->lock, flags);
+	}
+
+	return res;
 }
 
 static inline struct timespec ep_set_mstimeout(long ms)
@@ -1419,6 +1559,11 @@ fetch_events:
 		 */
 		init_waitqueue_entry(&wait, current);
 		__add_wait_queue_exclusive(&ep->wq, &wait);
+		ep->stats.waits++;
+
+		/* Batch what becomes ready from now on */
+		ep->batch_events = 0;
+		ep->batch_expired = false;
 
 		for (;;) {
 			/*
@@ -1427,7 +1572,8 @@ fetch_events:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (ep_events_available(ep) || timed_out)
+			if (timed_out || (ep_events_available(ep) &&
+					  !ep_batch_pending(ep)))
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
@@ -1441,6 +1587,8 @@ fetch_events:
 			spin_lock_irqsave(&ep->lock, flags);
 		}
 		__remove_wait_queue(&ep->wq, &wait);
+		if (ep->batch_min > 1)
+			hrtimer_try_to_cancel(&ep->batch_timer);
 
 		set_current_state(TASK_RUNNING);
 	}
@@ -1658,6 +1806,19 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (file == tfile || !is_file_epoll(file))
 		goto error_tgt_fput;
 
+	/*
+	 * EPOLLEXCLUSIVE only makes sense on EPOLL_CTL_ADD, with a subset
+	 * of the events, and not for epoll targets: nested wakeups are not
+	 * exclusive.
+	 */
+	if (ep_op_has_event(op) && (epds.events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			goto error_tgt_fput;
+		if (is_file_epoll(tfile) ||
+		    (epds.events & ~EPOLLEXCLUSIVE_OK_BITS))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * At this point it is safe to assume that the "private_data" contains
 	 * our own data structure.
@@ -1718,8 +1879,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds.events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, &epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
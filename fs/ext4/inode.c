@@ -2268,6 +2268,17 @@ static int ext4_da_writepages(struct address_space *mapping,
 	} else
 		desired_nr_to_write = ext4_num_dirty_pages(inode, index,
 							   max_pages);
+	/*
+	 * Hand the allocator whole stripes (erase blocks on flash) where
+	 * possible, it aligns requests that are multiples of them.
+	 */
+	if (sbi->s_stripe && desired_nr_to_write != LONG_MAX) {
+		long stripe_pages = max_t(long, 1, sbi->s_stripe >>
+			(PAGE_CACHE_SHIFT - inode->i_sb->s_blocksize_bits));
+
+		desired_nr_to_write = roundup(desired_nr_to_write,
+					      stripe_pages);
+	}
 	if (desired_nr_to_write > max_pages)
 		desired_nr_to_write = max_pages;
 
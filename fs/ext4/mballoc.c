@@ -2560,6 +2560,13 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_bal_2orders),
 				atomic_read(&sbi->s_bal_breaks),
 				atomic_read(&sbi->s_mb_lost_chunks));
+		if (sbi->s_stripe)
+			ext4_msg(sb, KERN_INFO,
+			       "mballoc: stripe %lu, %u stripe reqs, "
+				"%u aligned",
+				sbi->s_stripe,
+				atomic_read(&sbi->s_bal_stripe_reqs),
+				atomic_read(&sbi->s_bal_stripe_hits));
 		ext4_msg(sb, KERN_INFO,
 		       "mballoc: %lu generated and it took %Lu",
 				sbi->s_mb_buddies_generated,
@@ -2941,6 +2948,17 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	size = size >> bsbits;
 	start = start_off >> bsbits;
 
+	/*
+	 * Cover whole stripes (erase blocks on flash) so that the request
+	 * can be satisfied by an aligned extent.
+	 */
+	if (sbi->s_stripe && size >= sbi->s_stripe &&
+	    size + sbi->s_stripe <= EXT4_CLUSTERS_PER_GROUP(ac->ac_sb)) {
+		end = roundup(start + size, sbi->s_stripe);
+		start = rounddown(start, sbi->s_stripe);
+		size = end - start;
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -3059,6 +3077,15 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 			atomic_inc(&sbi->s_bal_goals);
 		if (ac->ac_found > sbi->s_mb_max_to_scan)
 			atomic_inc(&sbi->s_bal_breaks);
+		if (sbi->s_stripe && ac->ac_status == AC_STATUS_FOUND &&
+		    !(ac->ac_g_ex.fe_len % sbi->s_stripe)) {
+			ext4_fsblk_t block;
+
+			atomic_inc(&sbi->s_bal_stripe_reqs);
+			block = ext4_grp_offs_to_block(ac->ac_sb, &ac->ac_b_ex);
+			if (do_div(block, sbi->s_stripe) == 0)
+				atomic_inc(&sbi->s_bal_stripe_hits);
+		}
 	}
 
 	if (ac->ac_op == EXT4_MB_HISTORY_ALLOC)
@@ -3925,6 +3952,20 @@ static inline void ext4_mb_show_ac(struct ext4_allocation_context *ac)
 }
 #endif
 
+/* spread the block groups over the per cpu locality groups */
+static struct ext4_locality_group *
+ext4_mb_dir_locality_group(struct ext4_sb_info *sbi, struct inode *inode)
+{
+	unsigned int n = EXT4_I(inode)->i_block_group % num_possible_cpus();
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (n-- == 0)
+			break;
+
+	return per_cpu_ptr(sbi->s_locality_groups, cpu);
+}
+
 /*
  * We use locality group preallocation for small size file. The size of the
  * file is determined by the current size or the resulting size after
@@ -3971,9 +4012,15 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 	/*
 	 * locality group prealloc space are per cpu. The reason for having
 	 * per cpu locality group is to reduce the contention between block
-	 * request from multiple CPUs.
+	 * request from multiple CPUs.  With s_mb_group_by_dir the group is
+	 * picked from the inode's block group instead, which is the one of
+	 * its directory in most cases, so that the small files of one
+	 * directory share preallocations whichever CPU writes them.
 	 */
-	ac->ac_lg = __this_cpu_ptr(sbi->s_locality_groups);
+	if (sbi->s_mb_group_by_dir)
+		ac->ac_lg = ext4_mb_dir_locality_group(sbi, ac->ac_inode);
+	else
+		ac->ac_lg = __this_cpu_ptr(sbi->s_locality_groups);
 
 	/* we're going to use group allocation */
 	ac->ac_flags |= EXT4_MB_HINT_GROUP_ALLOC;
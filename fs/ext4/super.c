@@ -2324,6 +2324,30 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return ret;
 }
 
+/*
+ * ext4_get_erase_size: Get the erase block size of a flash device.
+ * @sb: super block
+ *
+ * Flash drivers (mmc) report their erase block as the optimal I/O size,
+ * allocating in multiples of it keeps the device from moving data around
+ * on its own.  Returns 0 if it isn't known or doesn't fit in a group.
+ */
+static unsigned long ext4_get_erase_size(struct super_block *sb)
+{
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	unsigned int io_opt = queue_io_opt(q);
+	unsigned long ret;
+
+	if (!blk_queue_nonrot(q) || io_opt & (sb->s_blocksize - 1))
+		return 0;
+
+	ret = io_opt >> sb->s_blocksize_bits;
+	if (ret <= 1 || ret > EXT4_SB(sb)->s_blocks_per_group)
+		return 0;
+
+	return ret;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2381,6 +2405,14 @@ static ssize_t lifetime_write_kbytes_show(struct ext4_attr *a,
 			  EXT4_SB(sb)->s_sectors_written_start) >> 1)));
 }
 
+static ssize_t mb_stripe_stats_show(struct ext4_attr *a,
+				    struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%lu %u %u\n", sbi->s_stripe,
+			atomic_read(&sbi->s_bal_stripe_reqs),
+			atomic_read(&sbi->s_bal_stripe_hits));
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2438,6 +2470,7 @@ static struct ext4_attr ext4_attr_##name = __ATTR(name, mode, show, store)
 EXT4_RO_ATTR(delayed_allocation_blocks);
 EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
+EXT4_RO_ATTR(mb_stripe_stats);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2447,6 +2480,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_group_by_dir, s_mb_group_by_dir);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2461,6 +2495,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_group_by_dir),
+	ATTR_LIST(mb_stripe_stats),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3558,6 +3594,12 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	if (!sbi->s_stripe) {
+		sbi->s_stripe = ext4_get_erase_size(sb);
+		/* keep the small files of a directory in the same blocks */
+		if (sbi->s_stripe)
+			sbi->s_mb_group_by_dir = 1;
+	}
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
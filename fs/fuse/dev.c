@@ -209,6 +209,9 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		if (req->passthrough_filp)
+			fput(req->passthrough_filp);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -1707,6 +1710,49 @@ static int copy_out_args(struct fuse_copy_state *cs, struct fuse_out *out,
  * it from the list and copy the rest of the buffer to the request.
  * The request is finished by calling request_end()
  */
+/*
+ * Look up the lower file of an OPEN or CREATE reply.  This runs in the
+ * context of the filesystem daemon writing the reply, so passthrough_fd
+ * is one of its descriptors.
+ */
+static void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *filp;
+
+	if (req->out.h.error)
+		return;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough)
+		return;
+
+	filp = fget(outarg->passthrough_fd);
+	if (!filp)
+		return;
+
+	/* no stacking on top of fuse, and regular files only */
+	if (filp->f_dentry->d_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !S_ISREG(filp->f_dentry->d_inode->i_mode) ||
+	    !filp->f_op || !filp->f_op->aio_read || !filp->f_op->aio_write) {
+		fput(filp);
+		return;
+	}
+
+	outarg->open_flags |= FOPEN_PASSTHROUGH;
+	req->passthrough_filp = filp;
+}
+
 static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 				 struct fuse_copy_state *cs, size_t nbytes)
 {
@@ -1781,6 +1827,8 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
+	if (!err)
+		fuse_setup_passthrough(fc, req);
 
 	spin_lock(&fc->lock);
 	req->locked = 0;
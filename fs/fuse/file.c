@@ -15,11 +15,16 @@
 #include <linux/module.h>
 #include <linux/compat.h>
 #include <linux/swap.h>
+#include <linux/file.h>
+#include <linux/aio.h>
+#include <linux/fsnotify.h>
+#include <linux/security.h>
 
 static const struct file_operations fuse_direct_io_file_operations;
 
 static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
-			  int opcode, struct fuse_open_out *outargp)
+			  int opcode, struct fuse_open_out *outargp,
+			  struct fuse_file *ff)
 {
 	struct fuse_open_in inarg;
 	struct fuse_req *req;
@@ -43,6 +48,8 @@ static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	req->out.args[0].value = outargp;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
 	fuse_put_request(fc, req);
 
 	return err;
@@ -65,6 +72,7 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 
 	INIT_LIST_HEAD(&ff->write_entry);
 	atomic_set(&ff->count, 0);
+	ff->passthrough_filp = NULL;
 	RB_CLEAR_NODE(&ff->polled_node);
 	init_waitqueue_head(&ff->poll_wait);
 
@@ -77,6 +85,8 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 
 void fuse_file_free(struct fuse_file *ff)
 {
+	if (ff->passthrough_filp)
+		fput(ff->passthrough_filp);
 	fuse_request_free(ff->reserved_req);
 	kfree(ff);
 }
@@ -133,6 +143,8 @@ static void fuse_file_put(struct fuse_file *ff, bool sync)
 			req->end = fuse_release_end;
 			fuse_request_send_background(ff->fc, req);
 		}
+		if (ff->passthrough_filp)
+			fput(ff->passthrough_filp);
 		kfree(ff);
 	}
 }
@@ -149,7 +161,7 @@ int fuse_do_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	if (!ff)
 		return -ENOMEM;
 
-	err = fuse_send_open(fc, nodeid, file, opcode, &outarg);
+	err = fuse_send_open(fc, nodeid, file, opcode, &outarg, ff);
 	if (err) {
 		fuse_file_free(ff);
 		return err;
@@ -699,10 +711,129 @@ out:
 	return err;
 }
 
+/*
+ * Read or write the lower file of a FOPEN_PASSTHROUGH open directly, the
+ * filesystem daemon is not involved.
+ */
+static ssize_t fuse_passthrough_rw(struct file *lower, int rw,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t *ppos)
+{
+	size_t len = iov_length(iov, nr_segs);
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!(lower->f_mode & (rw == READ ? FMODE_READ : FMODE_WRITE)))
+		return -EBADF;
+
+	ret = security_file_permission(lower, rw == READ ? MAY_READ :
+						       MAY_WRITE);
+	if (ret)
+		return ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = *ppos;
+	kiocb.ki_left = len;
+	kiocb.ki_nbytes = len;
+
+	if (rw == READ)
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	else
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	*ppos = kiocb.ki_pos;
+
+	if (ret > 0) {
+		if (rw == READ)
+			fsnotify_access(lower);
+		else
+			fsnotify_modify(lower);
+	}
+
+	return ret;
+}
+
+static ssize_t fuse_passthrough_read(struct kiocb *iocb,
+				     const struct iovec *iov,
+				     unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct address_space *mapping = file->f_mapping;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	/* pages dirtied through mmap are only in the fuse page cache */
+	if (mapping->nrpages) {
+		ret = filemap_write_and_wait_range(mapping, pos,
+						   pos + count - 1);
+		if (ret)
+			return ret;
+	}
+
+	ret = fuse_passthrough_rw(ff->passthrough_filp, READ, iov, nr_segs,
+				  &pos);
+	if (ret >= 0)
+		iocb->ki_pos = pos;
+
+	return ret;
+}
+
+static ssize_t fuse_passthrough_write(struct kiocb *iocb,
+				      const struct iovec *iov,
+				      unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	mutex_lock(&inode->i_mutex);
+
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(lower->f_mapping->host);
+
+	if (mapping->nrpages) {
+		ret = filemap_write_and_wait_range(mapping, pos,
+						   pos + count - 1);
+		if (ret)
+			goto out;
+	}
+
+	ret = fuse_passthrough_rw(lower, WRITE, iov, nr_segs, &pos);
+	if (ret > 0) {
+		iocb->ki_pos = pos;
+		fuse_write_update_size(inode, pos);
+		if (mapping->nrpages)
+			invalidate_inode_pages2_range(mapping,
+				(pos - ret) >> PAGE_CACHE_SHIFT,
+				(pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+out:
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
+}
+
 static ssize_t fuse_file_aio_read(struct kiocb *iocb, const struct iovec *iov,
 				  unsigned long nr_segs, loff_t pos)
 {
 	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+
+	if (ff->passthrough_filp)
+		return fuse_passthrough_read(iocb, iov, nr_segs, pos);
 
 	if (pos + iov_length(iov, nr_segs) > i_size_read(inode)) {
 		int err;
@@ -935,9 +1066,13 @@ static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	ssize_t err;
 	struct iov_iter i;
 	loff_t endbyte = 0;
+	struct fuse_file *ff = file->private_data;
 
 	WARN_ON(iocb->ki_pos != pos);
 
+	if (ff->passthrough_filp)
+		return fuse_passthrough_write(iocb, iov, nr_segs, pos);
+
 	ocount = 0;
 	err = generic_segment_checks(iov, &nr_segs, &ocount, VERIFY_READ);
 	if (err)
@@ -23,6 +23,8 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
@@ -141,6 +143,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** File reads and writes are forwarded to (or NULL) */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -313,6 +318,9 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file returned by an OPEN or CREATE reply (or NULL) */
+	struct file *passthrough_filp;
 };
 
 /**
@@ -481,6 +489,9 @@ struct fuse_conn {
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
+	/** May files be opened with FOPEN_PASSTHROUGH? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -81,6 +81,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/ptrace.h>
 #include <linux/tracehook.h>
+#include <linux/math64.h>
 
 #include <asm/pgtable.h>
 #include <asm/processor.h>
@@ -556,3 +557,38 @@ int proc_pid_statm(struct seq_file *m, struct pid_namespace *ns,
 
 	return 0;
 }
+
+/*
+ * Below this many samples reclaim has not looked at the task enough to
+ * tell, so the whole resident set is reported as being in use.
+ */
+#define WSS_MIN_SAMPLES	64
+
+int proc_pid_wss(struct seq_file *m, struct pid_namespace *ns,
+			struct pid *pid, struct task_struct *task)
+{
+	unsigned long rss = 0, sampled = 0, referenced = 0, wss;
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (mm) {
+		rss = get_mm_rss(mm);
+		sampled = ACCESS_ONCE(mm->wss_sampled);
+		referenced = min(ACCESS_ONCE(mm->wss_referenced), sampled);
+		mmput(mm);
+	}
+
+	wss = rss;
+	if (sampled >= WSS_MIN_SAMPLES)
+		wss = div_u64((u64)rss * referenced, sampled);
+
+	seq_printf(m,
+		"Rss:\t%8lu kB\n"
+		"Wss:\t%8lu kB\n"
+		"Sampled:\t%lu\n"
+		"Referenced:\t%lu\n",
+		rss << (PAGE_SHIFT - 10),
+		wss << (PAGE_SHIFT - 10),
+		sampled, referenced);
+
+	return 0;
+}
@@ -354,6 +354,35 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+#ifdef CONFIG_CPU_FREQ_ENERGY
+/*
+ * Provides /proc/PID/energy, the estimated energy used in uJ
+ */
+static int proc_tid_energy(struct task_struct *task, char *buffer)
+{
+	return sprintf(buffer, "%llu\n",
+			(unsigned long long)task->cpu_energy);
+}
+
+static int proc_tgid_energy(struct task_struct *task, char *buffer)
+{
+	unsigned long long energy = task->cpu_energy;
+	unsigned long flags;
+
+	if (lock_task_sighand(task, &flags)) {
+		struct task_struct *t = task;
+
+		energy += task->signal->cpu_energy;
+		while_each_thread(task, t)
+			energy += t->cpu_energy;
+
+		unlock_task_sighand(task, &flags);
+	}
+
+	return sprintf(buffer, "%llu\n", energy);
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -970,6 +999,7 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	lowmem_adj_index_update(task->signal);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1096,6 +1126,7 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	lowmem_adj_index_update(task->signal);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1377,6 +1408,71 @@ static const struct file_operations proc_pid_sched_autogroup_operations = {
 
 #endif /* CONFIG_SCHED_AUTOGROUP */
 
+#ifdef CONFIG_SCHED_RT_RESERVATION
+static int sched_reservation_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_rt_reservation_show(p, m);
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+/* "<runtime_us> <period_us>", "0 0" drops the reservation */
+static ssize_t
+sched_reservation_write(struct file *file, const char __user *buf,
+	    size_t count, loff_t *offset)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct task_struct *p;
+	char buffer[2 * PROC_NUMBUF];
+	unsigned long long runtime, period;
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	if (sscanf(buffer, "%llu %llu", &runtime, &period) != 2 ||
+	    runtime > period || period > USEC_PER_SEC)
+		return -EINVAL;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	err = proc_sched_rt_reservation_set(p, runtime * NSEC_PER_USEC,
+					    period * NSEC_PER_USEC);
+	if (err)
+		count = err;
+
+	put_task_struct(p);
+
+	return count;
+}
+
+static int sched_reservation_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_reservation_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_reservation_operations = {
+	.open		= sched_reservation_open,
+	.read		= seq_read,
+	.write		= sched_reservation_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_SCHED_RT_RESERVATION */
+
 static ssize_t comm_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *offset)
 {
@@ -3000,6 +3096,10 @@ static const struct pid_entry tgid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHED_AUTOGROUP
 	REG("autogroup",  S_IRUGO|S_IWUSR, proc_pid_sched_autogroup_operations),
+#endif
+#ifdef CONFIG_SCHED_RT_RESERVATION
+	REG("sched_reservation", S_IRUGO|S_IWUSR,
+	    proc_pid_sched_reservation_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
@@ -3008,6 +3108,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 	INF("cmdline",    S_IRUGO, proc_pid_cmdline),
 	ONE("stat",       S_IRUGO, proc_tgid_stat),
 	ONE("statm",      S_IRUGO, proc_pid_statm),
+	ONE("wss",        S_IRUGO, proc_pid_wss),
 	REG("maps",       S_IRUGO, proc_pid_maps_operations),
 #ifdef CONFIG_NUMA
 	REG("numa_maps",  S_IRUGO, proc_pid_numa_maps_operations),
@@ -3022,6 +3123,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_PROC_PAGE_MONITOR
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
+	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
 	REG("pagemap",    S_IRUGO, proc_pagemap_operations),
 #endif
 #ifdef CONFIG_SECURITY
@@ -3036,6 +3138,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_CPU_FREQ_ENERGY
+	INF("energy",     S_IRUGO, proc_tgid_energy),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3359,6 +3464,10 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("limits",	 S_IRUGO, proc_pid_limits),
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",     S_IRUGO|S_IWUSR, proc_pid_sched_operations),
+#endif
+#ifdef CONFIG_SCHED_RT_RESERVATION
+	REG("sched_reservation", S_IRUGO|S_IWUSR,
+	    proc_pid_sched_reservation_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
@@ -3367,6 +3476,7 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("cmdline",   S_IRUGO, proc_pid_cmdline),
 	ONE("stat",      S_IRUGO, proc_tid_stat),
 	ONE("statm",     S_IRUGO, proc_pid_statm),
+	ONE("wss",       S_IRUGO, proc_pid_wss),
 	REG("maps",      S_IRUGO, proc_tid_maps_operations),
 #ifdef CONFIG_NUMA
 	REG("numa_maps", S_IRUGO, proc_tid_numa_maps_operations),
@@ -3394,6 +3504,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_CPU_FREQ_ENERGY
+	INF("energy",    S_IRUGO, proc_tid_energy),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
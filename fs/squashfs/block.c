@@ -93,7 +93,7 @@ int squashfs_read_data(struct super_block *sb, void **buffer, u64 index,
 	struct buffer_head **bh;
 	int offset = index & ((1 << msblk->devblksize_log2) - 1);
 	u64 cur_index = index >> msblk->devblksize_log2;
-	int bytes, compressed, b = 0, k = 0, page = 0, avail;
+	int bytes, compressed, b = 0, k = 0, page = 0, avail, i;
 
 	bh = kcalloc(((srclength + msblk->devblksize - 1)
 		>> msblk->devblksize_log2) + 1, sizeof(*bh), GFP_KERNEL);
@@ -158,6 +158,15 @@ int squashfs_read_data(struct super_block *sb, void **buffer, u64 index,
 		ll_rw_block(READ, b - 1, bh + 1);
 	}
 
+	/*
+	 * Wait for the whole block here, the decompressors must not sleep.
+	 */
+	for (i = 0; i < b; i++) {
+		wait_on_buffer(bh[i]);
+		if (!buffer_uptodate(bh[i]))
+			goto block_release;
+	}
+
 	if (compressed) {
 		length = squashfs_decompress(msblk, buffer, bh, b, offset,
 			 length, srclength, pages);
@@ -167,13 +176,7 @@ int squashfs_read_data(struct super_block *sb, void **buffer, u64 index,
 		/*
 		 * Block is uncompressed.
 		 */
-		int i, in, pg_offset = 0;
-
-		for (i = 0; i < b; i++) {
-			wait_on_buffer(bh[i]);
-			if (!buffer_uptodate(bh[i]))
-				goto block_release;
-		}
+		int in, pg_offset = 0;
 
 		for (bytes = length; k < b; k++) {
 			in = min(bytes, msblk->devblksize - offset);
@@ -209,3 +212,38 @@ read_failure:
 	kfree(bh);
 	return -EIO;
 }
+
+
+/*
+ * Start reading a datablock without waiting for it, so that it is in the
+ * buffer cache by the time squashfs_read_data() gets to it.
+ */
+void squashfs_readahead_data(struct super_block *sb, u64 index, int length)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct buffer_head **bh;
+	int offset = index & ((1 << msblk->devblksize_log2) - 1);
+	u64 cur_index = index >> msblk->devblksize_log2;
+	int bytes = -offset, b, i;
+
+	length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+	if (length <= 0 || (index + length) > msblk->bytes_used)
+		return;
+
+	bh = kcalloc(((length + offset + msblk->devblksize - 1)
+		>> msblk->devblksize_log2), sizeof(*bh), GFP_NOFS);
+	if (bh == NULL)
+		return;
+
+	for (b = 0; bytes < length; b++, cur_index++) {
+		bh[b] = sb_getblk(sb, cur_index);
+		if (bh[b] == NULL)
+			break;
+		bytes += msblk->devblksize;
+	}
+	ll_rw_block(READA, b, bh);
+
+	for (i = 0; i < b; i++)
+		put_bh(bh[i]);
+	kfree(bh);
+}
@@ -47,6 +47,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/highmem.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,6 +372,100 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Largest datablock decompressed straight into the page cache, each page
+ * of the block stays kmapped while it is decompressed.
+ */
+#define SQUASHFS_DIRECT_MAX_SIZE	(128 * 1024)
+
+/*
+ * Decompress a datablock directly into the page cache pages it covers,
+ * saving the copy through the read cache.  Returns -EAGAIN if one of the
+ * pages can't be grabbed or is already uptodate, the caller then falls
+ * back to squashfs_get_datablock().  On success target_page is uptodate
+ * and unlocked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, bytes, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (msblk->block_size > SQUASHFS_DIRECT_MAX_SIZE)
+		return -EAGAIN;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (n = 0; n < pages; n++) {
+		int index = start_index + n;
+
+		page[n] = index == target_page->index ? target_page :
+			grab_cache_page_nowait(target_page->mapping, index);
+		if (page[n] == NULL)
+			goto release;
+		if (page[n] != target_page && PageUptodate(page[n])) {
+			unlock_page(page[n]);
+			page_cache_release(page[n]);
+			goto release;
+		}
+		pageaddr[n] = kmap(page[n]);
+	}
+
+	bytes = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (bytes < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		res = -EIO;
+	} else
+		res = 0;
+
+	for (i = 0; i < pages; i++, bytes -= PAGE_CACHE_SIZE) {
+		if (res == 0) {
+			int avail = clamp_t(int, bytes, 0, PAGE_CACHE_SIZE);
+
+			memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		kunmap(page[i]);
+		if (page[i] == target_page && res)
+			continue;
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+	goto out;
+
+release:
+	for (i = 0; i < n; i++) {
+		kunmap(page[i]);
+		if (page[i] != target_page) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+	}
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -410,8 +505,15 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if possible.
 			 */
+			int res = squashfs_readpage_block(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -496,6 +598,51 @@ out:
 }
 
 
+static int squashfs_readpages_filler(void *data, struct page *page)
+{
+	return squashfs_readpage(data, page);
+}
+
+
+/*
+ * Start the I/O of all the datablocks in the readahead window before
+ * decompressing the first one, then read the pages in one by one.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int last = -1;
+	struct page *page;
+
+	list_for_each_entry_reverse(page, pages, lru) {
+		int index = page->index >> shift;
+		u64 block = 0;
+		int bsize;
+
+		if (index == last)
+			continue;
+		last = index;
+
+		if (index >= file_end && squashfs_i(inode)->fragment_block !=
+						SQUASHFS_INVALID_BLK)
+			break;
+
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize <= 0)
+			continue;
+		squashfs_readahead_data(inode->i_sb, block, bsize);
+	}
+
+	return read_cache_pages(mapping, pages, squashfs_readpages_filler,
+		file);
+}
+
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readpages = squashfs_readpages
 };
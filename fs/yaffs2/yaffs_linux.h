@@ -18,6 +18,17 @@
 
 #include "yportenv.h"
 
+/* gross_lock statistics, updated under gross_lock */
+struct yaffs_lock_stats {
+	u32 n_locks;
+	u32 n_contended;
+	u64 wait_ns;
+	u64 max_wait_ns;
+	u64 hold_ns;
+	u64 max_hold_ns;
+	u32 n_bg_yields;
+};
+
 struct yaffs_linux_context {
 	struct list_head context_list;	/* List of these we have mounted */
 	struct yaffs_dev *dev;
@@ -25,6 +36,9 @@ struct yaffs_linux_context {
 	struct task_struct *bg_thread;	/* Background thread for this device */
 	int bg_running;
 	struct mutex gross_lock;	/* Gross locking mutex*/
+	atomic_t gross_lock_waiters;	/* Tasks waiting for gross_lock */
+	u64 gross_lock_start;		/* When gross_lock was taken (ns) */
+	struct yaffs_lock_stats lock_stats;
 	u8 *spare_buffer;	/* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
 				 */
@@ -54,6 +54,8 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/freezer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <asm/div64.h>
 
@@ -123,15 +125,47 @@ static unsigned yaffs_gc_control_callback(struct yaffs_dev *dev)
 
 static void yaffs_gross_lock(struct yaffs_dev *dev)
 {
+	struct yaffs_linux_context *lc = yaffs_dev_to_lc(dev);
+	struct yaffs_lock_stats *stats = &lc->lock_stats;
+	u64 wait = 0;
+
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locking %p", current);
-	mutex_lock(&(yaffs_dev_to_lc(dev)->gross_lock));
+	if (!mutex_trylock(&lc->gross_lock)) {
+		u64 start = ktime_to_ns(ktime_get());
+
+		/* the background thread backs off while this is non zero */
+		atomic_inc(&lc->gross_lock_waiters);
+		mutex_lock(&lc->gross_lock);
+		atomic_dec(&lc->gross_lock_waiters);
+
+		wait = ktime_to_ns(ktime_get()) - start;
+		stats->n_contended++;
+		stats->wait_ns += wait;
+		if (wait > stats->max_wait_ns)
+			stats->max_wait_ns = wait;
+	}
+	stats->n_locks++;
+	lc->gross_lock_start = ktime_to_ns(ktime_get());
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locked %p", current);
 }
 
 static void yaffs_gross_unlock(struct yaffs_dev *dev)
 {
+	struct yaffs_linux_context *lc = yaffs_dev_to_lc(dev);
+	struct yaffs_lock_stats *stats = &lc->lock_stats;
+	u64 hold = ktime_to_ns(ktime_get()) - lc->gross_lock_start;
+
+	stats->hold_ns += hold;
+	if (hold > stats->max_hold_ns)
+		stats->max_hold_ns = hold;
+
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs unlocking %p", current);
-	mutex_unlock(&(yaffs_dev_to_lc(dev)->gross_lock));
+	mutex_unlock(&lc->gross_lock);
+}
+
+static int yaffs_gross_lock_contended(struct yaffs_dev *dev)
+{
+	return atomic_read(&yaffs_dev_to_lc(dev)->gross_lock_waiters) > 0;
 }
 
 static void yaffs_fill_inode_from_obj(struct inode *inode,
@@ -1604,12 +1638,18 @@ static int yaffs_do_sync_fs(struct super_block *sb, int request_checkpoint)
  * yaffs_bg_start() launches the background thread.
  * yaffs_bg_stop() cleans up the background thread.
  *
+ * The thread yields to foreground I/O: gc is put off while tasks wait
+ * for gross_lock unless space is getting tight, and when it does run it
+ * only keeps the lock for up to YAFFS_BG_GC_STEPS passive gc steps.
+ *
  * NB: 
  * The thread should only run after the yaffs is initialised
  * The thread should be stopped before yaffs is unmounted.
  * The thread should not do any writing while the fs is in read only.
  */
 
+#define YAFFS_BG_GC_STEPS	4
+
 void yaffs_background_waker(unsigned long data)
 {
 	wake_up_process((struct task_struct *)data);
@@ -1626,6 +1666,7 @@ static int yaffs_bg_thread_fn(void *data)
 	unsigned int urgency;
 
 	int gc_result;
+	int i;
 	struct timer_list timer;
 
 	yaffs_trace(YAFFS_TRACE_BACKGROUND,
@@ -1653,7 +1694,20 @@ static int yaffs_bg_thread_fn(void *data)
 		if (time_after(now, next_gc) && yaffs_bg_enable) {
 			if (!dev->is_checkpointed) {
 				urgency = yaffs_bg_gc_urgency(dev);
-				gc_result = yaffs_bg_gc(dev, urgency);
+				if (urgency < 2 &&
+				    yaffs_gross_lock_contended(dev)) {
+					/* let them in, try again soon */
+					context->lock_stats.n_bg_yields++;
+					urgency = 1;
+				} else {
+					for (i = 0; i < YAFFS_BG_GC_STEPS; i++) {
+						gc_result = yaffs_bg_gc(dev,
+								urgency);
+						if (gc_result || !urgency ||
+						    yaffs_gross_lock_contended(dev))
+							break;
+					}
+				}
 				if (urgency > 1)
 					next_gc = now + HZ / 20 + 1;
 				else if (urgency > 0)
@@ -2496,6 +2550,28 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	return buf;
 }
 
+static char *yaffs_dump_dev_lock(char *buf, struct yaffs_dev *dev)
+{
+	struct yaffs_lock_stats *stats = &yaffs_dev_to_lc(dev)->lock_stats;
+	u32 n_locks = stats->n_locks ? stats->n_locks : 1;
+	u32 n_contended = stats->n_contended ? stats->n_contended : 1;
+
+	buf += sprintf(buf, "\n");
+	buf += sprintf(buf, "n_locks............... %u\n", stats->n_locks);
+	buf += sprintf(buf, "n_contended........... %u\n", stats->n_contended);
+	buf += sprintf(buf, "avg_wait_us........... %llu\n",
+		div_u64(stats->wait_ns, n_contended) / 1000);
+	buf += sprintf(buf, "max_wait_us........... %llu\n",
+		div_u64(stats->max_wait_ns, 1000));
+	buf += sprintf(buf, "avg_hold_us........... %llu\n",
+		div_u64(stats->hold_ns, n_locks) / 1000);
+	buf += sprintf(buf, "max_hold_us........... %llu\n",
+		div_u64(stats->max_hold_ns, 1000));
+	buf += sprintf(buf, "n_bg_yields........... %u\n", stats->n_bg_yields);
+
+	return buf;
+}
+
 static int yaffs_proc_read(char *page,
 			   char **start,
 			   off_t offset, int count, int *eof, void *data)
@@ -2541,6 +2617,7 @@ static int yaffs_proc_read(char *page,
 				buf = yaffs_dump_dev_part0(buf, dev);
 			} else {
 				buf = yaffs_dump_dev_part1(buf, dev);
+				buf = yaffs_dump_dev_lock(buf, dev);
                         }
 
 			break;
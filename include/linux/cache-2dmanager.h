@@ -58,5 +58,17 @@ void c2dm_l1cache(int count, struct c2dmrgn rgns[], int dir);
  */
 void c2dm_l2cache(int count, struct c2dmrgn rgns[], int dir);
 
+/*
+ *	c2dm_cache(count, rgns, dir)
+ *
+ *	L1 and L2 Cache operations in 2D, in the order the direction needs
+ *
+ *	- count  - number of regions
+ *	- rgns   - array of regions
+ *	- dir	 - cache operation direction
+ *
+ */
+void c2dm_cache(int count, struct c2dmrgn rgns[], int dir);
+
 
 #endif /* CACHE_2DMANAGER_H_ */
@@ -369,6 +369,21 @@ extern struct cpufreq_governor cpufreq_gov_interactive;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_interactive)
 #endif
 
+#if defined(CONFIG_CPU_FREQ_GOV_INTERACTIVE) || \
+	defined(CONFIG_CPU_FREQ_GOV_INTERACTIVE_MODULE)
+int cpufreq_interactive_boostpulse(unsigned int duration_us);
+bool cpufreq_interactive_is_busy(void);
+#else
+static inline int cpufreq_interactive_boostpulse(unsigned int duration_us)
+{
+	return -ENODEV;
+}
+static inline bool cpufreq_interactive_is_busy(void)
+{
+	return false;
+}
+#endif
+
 
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
@@ -0,0 +1,48 @@
+/*
+ *  linux/include/linux/cpufreq_energy.h
+ *
+ *  Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef _LINUX_CPUFREQ_ENERGY_H
+#define _LINUX_CPUFREQ_ENERGY_H
+
+#include <linux/types.h>
+#include <asm/cputime.h>
+
+struct task_struct;
+
+/**
+ * struct cpufreq_power_table - power drawn by a busy CPU
+ * @frequency: CPU frequency in kHz
+ * @power: power drawn by one CPU running at @frequency in mW
+ */
+struct cpufreq_power_table {
+	unsigned int frequency;
+	unsigned int power;
+};
+
+#ifdef CONFIG_CPU_FREQ_ENERGY
+int cpufreq_energy_register_table(const struct cpufreq_power_table *table,
+				  int count);
+void cpufreq_energy_account(struct task_struct *p, cputime_t cputime);
+void cpufreq_energy_task_release(struct task_struct *p);
+#else
+static inline int cpufreq_energy_register_table(
+		const struct cpufreq_power_table *table, int count)
+{
+	return 0;
+}
+static inline void cpufreq_energy_account(struct task_struct *p,
+					  cputime_t cputime)
+{
+}
+static inline void cpufreq_energy_task_release(struct task_struct *p)
+{
+}
+#endif
+
+#endif /* _LINUX_CPUFREQ_ENERGY_H */
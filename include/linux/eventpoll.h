@@ -17,6 +17,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -26,6 +27,9 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/* Set exclusive wakeup mode for the target file descriptor */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
@@ -49,6 +53,31 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * Wakeup batching for an epoll instance: a sleeping epoll_wait() is
+ * only woken once @min_events descriptors became ready, or @timeout_us
+ * after the first of them, whichever comes first.  The epoll_wait()
+ * timeout still applies.  min_events <= 1 turns batching off.
+ */
+struct epoll_batch {
+	__u32 min_events;
+	__u32 timeout_us;
+};
+
+struct epoll_stats {
+	__u64 waits;		/* epoll_wait() calls that slept */
+	__u64 wakeups;		/* waiters woken by ready events */
+	__u64 batched;		/* ready events that did not wake */
+	__u64 batch_timeouts;	/* batch flushed by timeout_us */
+	__u64 callbacks;	/* ready notifications from targets */
+	__u64 events;		/* events returned to userspace */
+};
+
+#define EPOLL_IOC_TYPE		0x8A
+#define EPIOC_SET_BATCH		_IOW(EPOLL_IOC_TYPE, 0x10, struct epoll_batch)
+#define EPIOC_GET_BATCH		_IOR(EPOLL_IOC_TYPE, 0x11, struct epoll_batch)
+#define EPIOC_GET_STATS		_IOR(EPOLL_IOC_TYPE, 0x12, struct epoll_stats)
+
 #ifdef __KERNEL__
 
 /* Forward declarations to avoid compiler errors */
@@ -17,6 +17,13 @@
 
 #include "bltsville.h"
 
+struct sync_fence;
+
 void gcbv_init(struct bventry *entry);
 
+/* Execute an array of blits as a single batch and submission; optionally
+ * returns a fence signaled when the GPU completes the batch. */
+enum bverror gcbv_blt_batch(struct bvbltparams **bltparams,
+			    unsigned int count, struct sync_fence **fence);
+
 #endif
@@ -24,6 +24,20 @@ void gc_caps(struct gcicaps *gcicaps);
 /* Command buffer submission. */
 void gc_commit(struct gcicommit *gcicommit, bool fromuser);
 
+/* GPU activity since the previous profiled commit. Exact when nothing
+ * else was executing between the two commits. */
+struct gcprofile {
+	unsigned int cycles;		/* Total GPU cycles. */
+	unsigned int idle;		/* Cycles the GPU was idle. */
+	unsigned int reads;		/* Memory reads in 64-bit units. */
+	unsigned int writes;		/* Memory writes in 64-bit units. */
+};
+
+/* Kernel command buffer submission sampling the GPU activity counters;
+ * the counters are only sampled for synchronous commits. */
+void gc_commit_profile(struct gcicommit *gcicommit,
+		       struct gcprofile *gcprofile);
+
 /* Client memory mapping. */
 void gc_map(struct gcimap *gcimap, bool fromuser);
 void gc_unmap(struct gcimap *gcimap, bool fromuser);
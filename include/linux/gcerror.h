@@ -132,6 +132,9 @@ enum gcerror {
 	GCERR_CMD_THREAD		/* Thread initialization. */
 	= GCERR_GROUP(0x02090),
 
+	GCERR_CMD_FENCE			/* Fence creation. */
+	= GCERR_GROUP(0x020A0),
+
 	/**** MMU errors. */
 	GCERR_MMU_CTXT_BAD		/* Invalid context. */
 	= GCERR_GROUP(0x03000),
@@ -68,6 +68,8 @@ enum gcpipe {
 	GCPIPE_3D
 };
 
+struct sync_fence;
+
 /* Commit header; contains pointers to the head and the tail of a linked list
    of command buffers to execute. */
 struct gcicommit {
@@ -101,6 +103,15 @@ struct gcicommit {
 
 	/* Scheduled unmappings (gcschedunmap). */
 	struct list_head unmap;
+
+	/* If fence is set to true, a sync fence is created that is signaled
+	 * when the GPU completes execution of all buffers specified in this
+	 * call. User mode callers receive its file descriptor in fencefd,
+	 * kernel callers receive the fence itself in syncfence and own the
+	 * reference to it. */
+	bool fence;
+	int fencefd;
+	struct sync_fence *syncfence;
 };
 
 /* Command buffer header. */
@@ -55,6 +55,8 @@
 #define CS_GET_HSI_LATENCY	CS_IOW(20, unsigned int)
 #define CS_SET_MPU_LATENCY	CS_IOR(21, unsigned int)
 #define CS_GET_MPU_LATENCY	CS_IOW(22, unsigned int)
+#define CS_MMAP_SETUP		CS_IOWR(23, struct hsi_mmap_config)
+#define CS_MMAP_KICK		CS_IO(24)
 
 
 #define HSI_MODE_SLEEP		0
@@ -107,6 +109,50 @@ struct hsi_rx_config {
 			  /* SSI: FT[8..0] */
 };
 
+/* most slots in each direction of the mmap ring */
+#define HSI_MMAP_MAX_SLOTS	64
+
+/**
+ * struct hsi_mmap_config - HSI mmap ring geometry, for CS_MMAP_SETUP
+ * @slot_size: size in bytes of each slot, multiple of 4
+ * @tx_slots: number of slots for outgoing frames
+ * @rx_slots: number of slots for incoming frames
+ * @rx_frame: size in bytes read into each RX slot, multiple of 4
+ * @size: returned with the length of the region to mmap
+ */
+struct hsi_mmap_config {
+	__u32 slot_size;
+	__u32 tx_slots;
+	__u32 rx_slots;
+	__u32 rx_frame;
+	__u32 size;
+};
+
+/**
+ * struct hsi_mmap_ring - one direction of the HSI mmap ring
+ * @head: index of the next slot the producer fills
+ * @tail: index of the next slot the consumer releases
+ * @offset: offset of the first slot in the mapping (set by the driver)
+ * @len: length of the frame in each slot, in bytes
+ *
+ * Indexes are free running, slot n is at offset + (n % slots) * slot_size.
+ * Userspace produces TX frames and consumes RX ones, the driver the other
+ * way round. New TX frames and released RX slots are picked up by poll()
+ * and CS_MMAP_KICK, and completions advance the driver side at once.
+ */
+struct hsi_mmap_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 offset;
+	__u32 len[HSI_MMAP_MAX_SLOTS];
+};
+
+/* first page of the mapping, followed by the TX then the RX slots */
+struct hsi_mmap_ctrl {
+	struct hsi_mmap_ring tx;
+	struct hsi_mmap_ring rx;
+};
+
 struct hsi_char_platform_data {
 	unsigned int port;
 	unsigned int num_channels;
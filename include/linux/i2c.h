@@ -35,6 +35,7 @@
 #include <linux/mutex.h>
 #include <linux/of.h>		/* for struct device_node */
 #include <linux/swab.h>		/* for swab16 */
+#include <linux/workqueue.h>	/* for async transfers */
 
 extern struct bus_type i2c_bus_type;
 extern struct device_type i2c_adapter_type;
@@ -69,6 +70,29 @@ extern int i2c_master_recv(const struct i2c_client *client, char *buf,
 extern int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
 			int num);
 
+/**
+ * struct i2c_async_xfer - a transfer queued with i2c_transfer_async()
+ * @msgs: messages to transfer; they and their buffers must stay valid
+ *	until @complete is called
+ * @num: number of messages
+ * @complete: called in process context with the result i2c_transfer()
+ *	would have returned
+ * @context: for use by the caller
+ * @node: queue entry, internal to i2c-core
+ */
+struct i2c_async_xfer {
+	struct i2c_msg *msgs;
+	int num;
+	void (*complete)(struct i2c_async_xfer *xfer, int ret);
+	void *context;
+	struct list_head node;
+};
+
+/* Queue a transfer and return without waiting for it to happen.
+ */
+extern int i2c_transfer_async(struct i2c_adapter *adap,
+			      struct i2c_async_xfer *xfer);
+
 /* This is the very generalized SMBus access routine. You probably do not
    want to use this, though; one of the functions below may be much easier,
    and probably just as fast.
@@ -389,6 +413,11 @@ struct i2c_adapter {
 
 	struct mutex userspace_clients_lock;
 	struct list_head userspace_clients;
+
+	/* i2c_transfer_async() queue */
+	spinlock_t async_lock;
+	struct list_head async_queue;
+	struct work_struct async_work;
 };
 #define to_i2c_adapter(d) container_of(d, struct i2c_adapter, dev)
 
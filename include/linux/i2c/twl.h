@@ -199,6 +199,13 @@ int twl_i2c_read_u8(u8 mod_no, u8 *val, u8 reg);
 int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 int twl_i2c_read(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 
+/*
+ * Declare registers whose value only changes through the calls above,
+ * so reads of them can be answered from a shadow copy.
+ */
+int twl_i2c_cache_regs(u8 mod_no, u8 reg, unsigned num_regs);
+void twl_i2c_cache_invalidate(u8 mod_no, u8 reg, unsigned num_regs);
+
 int twl_get_type(void);
 int twl_get_version(void);
 
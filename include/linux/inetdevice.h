@@ -38,6 +38,11 @@ enum
 	IPV4_DEVCONF_ACCEPT_LOCAL,
 	IPV4_DEVCONF_SRC_VMARK,
 	IPV4_DEVCONF_PROXY_ARP_PVLAN,
+	IPV4_DEVCONF_TCP_RMEM_DEF,
+	IPV4_DEVCONF_TCP_RMEM_MAX,
+	IPV4_DEVCONF_TCP_WMEM_DEF,
+	IPV4_DEVCONF_TCP_WMEM_MAX,
+	IPV4_DEVCONF_TCP_INITRWND,
 	__IPV4_DEVCONF_MAX
 };
 
@@ -49,6 +54,15 @@ struct ipv4_devconf {
 	DECLARE_BITMAP(state, IPV4_DEVCONF_MAX);
 };
 
+/* buffer sizes TCP connections leaving through the device ended with */
+struct in_dev_tcp_stats {
+	atomic_t		conns;
+	atomic_t		rcvbuf_capped;	/* grew up to the ceiling */
+	atomic_t		sndbuf_capped;
+	atomic64_t		rcvbuf_sum;
+	atomic64_t		sndbuf_sum;
+};
+
 struct in_device {
 	struct net_device	*dev;
 	atomic_t		refcnt;
@@ -69,6 +83,7 @@ struct in_device {
 
 	struct neigh_parms	*arp_parms;
 	struct ipv4_devconf	cnf;
+	struct in_dev_tcp_stats	tcp_stats;
 	struct rcu_head		rcu_head;
 };
 
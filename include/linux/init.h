@@ -145,8 +145,16 @@ extern initcall_t __security_initcall_start[], __security_initcall_end[];
 /* Used for contructor calls. */
 typedef void (*ctor_fn_t)(void);
 
+struct deferred_initcall {
+	struct deferred_initcall *next;
+	initcall_t fn;
+};
+
 /* Defined in init/main.c */
 extern int do_one_initcall(initcall_t fn);
+extern int async_initcall_schedule(initcall_t fn);
+extern void deferred_initcall_add(struct deferred_initcall *call);
+extern void run_deferred_initcalls(void);
 extern char __initdata boot_command_line[];
 extern char *saved_command_line;
 extern unsigned int reset_devices;
@@ -212,6 +220,39 @@ extern bool initcall_debug;
 
 #define __initcall(fn) device_initcall(fn)
 
+/*
+ * Async initcalls are handed to the async framework and run in parallel
+ * with the rest of their level.  All of them have returned before the
+ * next level starts, so only initcalls that nothing else in the same
+ * level depends on may use these.
+ */
+#define __define_async_initcall(level,fn,id) \
+	static int __init __async_initcall_##fn(void) \
+	{ return async_initcall_schedule(fn); } \
+	__define_initcall(level,__async_initcall_##fn,id)
+
+#define subsys_initcall_async(fn)	__define_async_initcall("4",fn,4)
+#define device_initcall_async(fn)	__define_async_initcall("6",fn,6)
+#define late_initcall_async(fn)		__define_async_initcall("7",fn,7)
+
+/*
+ * Deferred initcalls are for drivers that are not needed to bring up
+ * the first frame.  They run once userspace writes to
+ * /proc/deferred_initcalls, or deferred_initcall_delay seconds after
+ * the late initcalls otherwise.  They run after init memory has been
+ * freed, so the function and everything it calls must not be __init.
+ */
+#define deferred_initcall(fn) \
+	static struct deferred_initcall __deferred_initcall_##fn = { \
+		.fn = fn, \
+	}; \
+	static int __init __deferred_initcall_add_##fn(void) \
+	{ \
+		deferred_initcall_add(&__deferred_initcall_##fn); \
+		return 0; \
+	} \
+	__define_initcall("7",__deferred_initcall_add_##fn,7)
+
 #define __exitcall(fn) \
 	static exitcall_t __exitcall_##fn __exit_call = fn
 
@@ -290,6 +331,11 @@ void __init parse_early_options(char *cmdline);
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
 
+#define subsys_initcall_async(fn)	module_init(fn)
+#define device_initcall_async(fn)	module_init(fn)
+#define late_initcall_async(fn)		module_init(fn)
+#define deferred_initcall(fn)		module_init(fn)
+
 #define security_initcall(fn)		module_init(fn)
 
 /* Each module must use one module_init(). */
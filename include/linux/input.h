@@ -158,6 +158,9 @@ struct input_keymap_entry {
 #define EVIOCSSUSPENDBLOCK	_IOW('E', 0x91, int)			/* set suspend block enable */
 
 #define EVIOCSCLOCKID		_IOW('E', 0xa0, int)			/* Set clockid to be used for timestamps */
+#define EVIOCGBUFSIZE		_IOR('E', 0xa1, unsigned int)		/* get client buffer size, in events */
+#define EVIOCSBUFSIZE		_IOW('E', 0xa1, unsigned int)		/* set client buffer size, in events */
+#define EVIOCGDROPPED		_IOR('E', 0xa2, unsigned int)		/* get events dropped on overflow */
 
 /*
  * Device properties and quirks
@@ -1245,6 +1248,9 @@ struct ff_effect {
  * @going_away: marks devices that are in a middle of unregistering and
  *	causes input_open_device*() fail with -ENODEV.
  * @sync: set to %true when there were no new events since last EV_SYN
+ * @timestamp: time the hardware sampled the frame being reported, set by
+ *	the driver with input_set_timestamp(), or zero to timestamp events
+ *	when they are reported. Cleared on every EV_SYN/SYN_REPORT
  * @dev: driver model's view of this device
  * @h_list: list of input handles associated with the device. When
  *	accessing the list dev->mutex must be held
@@ -1314,6 +1320,8 @@ struct input_dev {
 
 	bool sync;
 
+	ktime_t timestamp;
+
 	struct device dev;
 
 	struct list_head	h_list;
@@ -1540,6 +1548,22 @@ static inline void input_mt_sync(struct input_dev *dev)
 	input_event(dev, EV_SYN, SYN_MT_REPORT, 0);
 }
 
+/**
+ * input_set_timestamp() - set the time of the next event frame
+ * @dev: input device
+ * @timestamp: CLOCK_MONOTONIC time the frame was sampled, typically
+ *	taken in the hard interrupt handler of the device
+ *
+ * Events up to the next input_sync() are stamped with @timestamp rather
+ * than with the time they are reported, which for devices read over a
+ * slow bus can be milliseconds later.
+ */
+static inline void input_set_timestamp(struct input_dev *dev,
+				       ktime_t timestamp)
+{
+	dev->timestamp = timestamp;
+}
+
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
 
 /**
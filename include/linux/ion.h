@@ -63,6 +63,7 @@ struct ion_buffer;
  * @name:	used for debug purposes
  * @base:	base address of heap in physical memory if applicable
  * @size:	size of the heap in bytes if applicable
+ * @priv:	heap specific data, e.g. the device owning a CMA area
  *
  * Provided by the board file.
  */
@@ -72,6 +73,7 @@ struct ion_platform_heap {
 	const char *name;
 	ion_phys_addr_t base;
 	size_t size;
+	void *priv;
 };
 
 /**
@@ -222,6 +224,40 @@ struct ion_handle *ion_import(struct ion_client *client,
  * the handle to use to refer to it further.
  */
 struct ion_handle *ion_import_fd(struct ion_client *client, int fd);
+
+struct dma_buf;
+
+/**
+ * ion_share_dma_buf() - export a buffer as a dma-buf
+ * @client:	this blocks client
+ * @handle:	the handle of the buffer to export
+ *
+ * The dma-buf holds a reference on the buffer, so the handle can be freed
+ * right away.  It can be imported back with ion_import_dma_buf() or
+ * ion_import_fd(), or by any dma-buf user.
+ */
+struct dma_buf *ion_share_dma_buf(struct ion_client *client,
+				  struct ion_handle *handle);
+
+/**
+ * ion_import_dma_buf() - import a dma-buf exported by ion
+ * @client:	this blocks client
+ * @fd:		the dma-buf fd
+ *
+ * Returns the handle to the buffer, or ERR_PTR(-EINVAL) if the dma-buf
+ * was exported by someone else.
+ */
+struct ion_handle *ion_import_dma_buf(struct ion_client *client, int fd);
+
+/**
+ * ion_tgid_usage() - ion memory charged to a process
+ * @tgid:	the process' thread group id
+ *
+ * Buffers are charged to the process whose client allocated them, until
+ * they are freed.  Returns the number of bytes, and can be called from
+ * atomic context.
+ */
+size_t ion_tgid_usage(pid_t tgid);
 #endif /* __KERNEL__ */
 
 /**
@@ -304,6 +340,42 @@ struct ion_cached_user_buf_data {
 	size_t size;
 };
 
+/**
+ * struct ion_sync_range - a region of a buffer to make coherent
+ * @offset:	offset of the region from the start of the buffer
+ * @size:	size of the region in bytes
+ */
+struct ion_sync_range {
+	unsigned long offset;
+	size_t size;
+};
+
+#define ION_SYNC_TO_DEVICE	1	/* cpu wrote, device will read */
+#define ION_SYNC_FROM_DEVICE	2	/* device wrote, cpu will read */
+#define ION_SYNC_BIDIRECTIONAL	3
+
+#define ION_SYNC_MAX_RANGES	64
+
+/**
+ * struct ion_sync_data - dirty regions of a cacheable mapping
+ * @handle:	a handle
+ * @vaddr:	user address the buffer is mapped at, as returned by mmap
+ * @direction:	one of ION_SYNC_*
+ * @nr_ranges:	number of entries in @ranges, at most ION_SYNC_MAX_RANGES
+ * @ranges:	array of regions relative to the start of the buffer
+ *
+ * For ION_IOC_SYNC only the listed regions are cleaned (to device),
+ * invalidated (from device) or both.  Small regions are rounded out to
+ * whole cache lines and overlapping ones are merged.
+ */
+struct ion_sync_data {
+	struct ion_handle *handle;
+	unsigned long vaddr;
+	unsigned int direction;
+	unsigned int nr_ranges;
+	struct ion_sync_range *ranges;
+};
+
 #define ION_IOC_MAGIC		'I'
 
 /**
@@ -365,4 +437,21 @@ struct ion_cached_user_buf_data {
 #define ION_IOC_INVAL_CACHED	_IOWR(ION_IOC_MAGIC, 8, \
 					struct ion_cached_user_buf_data)
 
+/**
+ * DOC: ION_IOC_SYNC - cache maintenance on parts of a buffer
+ *
+ * Takes an ion_sync_data struct describing the dirty regions of a
+ * cacheable mapping of the buffer and the direction of the transfer.
+ */
+#define ION_IOC_SYNC		_IOWR(ION_IOC_MAGIC, 9, struct ion_sync_data)
+
+/**
+ * DOC: ION_IOC_SHARE_DMA_BUF - shares an allocation as a dma-buf
+ *
+ * Like ION_IOC_SHARE, but the fd returned is a dma-buf, which other
+ * drivers (drm, v4l2, dsscomp, ...) can import without copying.  It can
+ * also be imported back with ION_IOC_IMPORT.
+ */
+#define ION_IOC_SHARE_DMA_BUF	_IOWR(ION_IOC_MAGIC, 10, struct ion_fd_data)
+
 #endif /* _LINUX_ION_H */
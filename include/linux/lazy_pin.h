@@ -0,0 +1,48 @@
+#ifndef _LINUX_LAZY_PIN_H
+#define _LINUX_LAZY_PIN_H
+/*
+ * Incremental pinning of user buffers for drivers.
+ *
+ * lazy_pin_init() only records the range, so registering a buffer is
+ * cheap.  The driver then pins the pages it is about to hand to its device
+ * with lazy_pin_pages(), and can have the rest pinned in batches from a
+ * workqueue with lazy_pin_background().  None of these may be called with
+ * the mmap_sem of the buffer's mm held.
+ */
+
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+struct mm_struct;
+struct page;
+
+struct lazy_pin {
+	struct mm_struct *mm;
+	unsigned long start;		/* page aligned user address */
+	unsigned int nr_pages;
+	unsigned int nr_pinned;
+	unsigned int next;		/* where the background pinning is */
+	int write;
+	struct page **pages;		/* NULL until pinned */
+	struct mutex lock;
+	struct work_struct work;
+};
+
+extern int lazy_pin_init(struct lazy_pin *pin, unsigned long start,
+			 unsigned int nr_pages, int write);
+extern int lazy_pin_pages(struct lazy_pin *pin, unsigned int first,
+			  unsigned int nr);
+extern void lazy_pin_background(struct lazy_pin *pin);
+extern void lazy_pin_release(struct lazy_pin *pin);
+
+static inline bool lazy_pin_complete(struct lazy_pin *pin)
+{
+	return ACCESS_ONCE(pin->nr_pinned) == pin->nr_pages;
+}
+
+static inline int lazy_pin_all(struct lazy_pin *pin)
+{
+	return lazy_pin_pages(pin, 0, pin->nr_pages);
+}
+
+#endif /* _LINUX_LAZY_PIN_H */
@@ -191,6 +191,10 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 u64 mem_cgroup_get_limit(struct mem_cgroup *memcg);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
+void mem_cgroup_count_reclaim(struct mem_cgroup *memcg,
+			      unsigned long nr_reclaimed);
+bool mem_cgroup_soft_limit_exceeded(struct mem_cgroup *root,
+				    struct mem_cgroup *memcg);
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 void mem_cgroup_split_huge_fixup(struct page *head);
 #endif
@@ -397,6 +401,17 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline void mem_cgroup_count_reclaim(struct mem_cgroup *memcg,
+					    unsigned long nr_reclaimed)
+{
+}
+
+static inline bool mem_cgroup_soft_limit_exceeded(struct mem_cgroup *root,
+						  struct mem_cgroup *memcg)
+{
+	return true;
+}
+
 static inline
 u64 mem_cgroup_get_limit(struct mem_cgroup *memcg)
 {
@@ -265,6 +265,8 @@ struct twl6040 {
 int twl6040_reg_read(struct twl6040 *twl6040, unsigned int reg);
 int twl6040_reg_write(struct twl6040 *twl6040, unsigned int reg,
 		      u8 val);
+int twl6040_reg_bulk_write(struct twl6040 *twl6040, unsigned int reg,
+			   const u8 *val, size_t count);
 int twl6040_set_bits(struct twl6040 *twl6040, unsigned int reg,
 		     u8 mask);
 int twl6040_clear_bits(struct twl6040 *twl6040, unsigned int reg,
@@ -294,6 +296,12 @@ static inline int twl6040_reg_write(struct twl6040 *twl6040, unsigned int reg,
 {
 	return -EINVAL;
 }
+static inline int twl6040_reg_bulk_write(struct twl6040 *twl6040,
+					 unsigned int reg, const u8 *val,
+					 size_t count)
+{
+	return -EINVAL;
+}
 static inline int twl6040_set_bits(struct twl6040 *twl6040, unsigned int reg,
 				   u8 mask)
 {
@@ -1117,6 +1117,26 @@ static inline void update_hiwater_rss(struct mm_struct *mm)
 		(mm)->hiwater_rss = _rss;
 }
 
+/*
+ * Every pte reclaim looks at is a sample of whether the page it maps is
+ * still being used; a page brought back in by a major fault is a sample
+ * that definitely is.  The window decays so the estimate follows what
+ * the task does now rather than what it did since exec.
+ */
+#define MM_WSS_WINDOW	4096
+
+static inline void mm_wss_sample(struct mm_struct *mm, bool referenced,
+				 unsigned long nr_pages)
+{
+	if (unlikely(mm->wss_sampled >= MM_WSS_WINDOW)) {
+		mm->wss_sampled >>= 1;
+		mm->wss_referenced >>= 1;
+	}
+	mm->wss_sampled += nr_pages;
+	if (referenced)
+		mm->wss_referenced += nr_pages;
+}
+
 static inline void update_hiwater_vm(struct mm_struct *mm)
 {
 	if (mm->hiwater_vm < mm->total_vm)
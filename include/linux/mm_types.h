@@ -262,6 +262,10 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	/* last swap fault address | readahead window, see swap_state.c */
+	atomic_long_t swap_readahead_info;
+#endif
 };
 
 struct core_thread {
@@ -347,6 +351,16 @@ struct mm_struct {
 	 */
 	struct mm_rss_stat rss_stat;
 
+	/*
+	 * Working set sampling, fed by reclaim and major faults and
+	 * read through /proc/PID/wss.  Racy updates are fine here.
+	 */
+	unsigned long wss_sampled;
+	unsigned long wss_referenced;
+#ifdef CONFIG_READAHEAD_TRACE
+	struct ratrace __rcu *ra_trace;	/* see mm/ratrace.c */
+#endif
+
 	struct linux_binfmt *binfmt;
 
 	cpumask_var_t cpu_vm_mask_var;
@@ -13,6 +13,8 @@
 #include <linux/device.h>
 #include <linux/mmc/core.h>
 #include <linux/mod_devicetable.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 
 struct mmc_cid {
 	unsigned int		manfid;
@@ -74,6 +76,12 @@ struct mmc_ext_csd {
 	unsigned int		hpi_cmd;		/* cmd used as HPI */
 	unsigned int            data_sector_size;       /* 512 bytes or 4KB */
 	unsigned int            data_tag_unit_size;     /* DATA TAG UNIT size */
+	u8			packed_event_en;	/* packed failure events */
+	unsigned int		max_packed_writes;
+	unsigned int		max_packed_reads;
+	bool			bkops;		/* background support bit */
+	bool			bkops_en;	/* background enable bit */
+	u8			raw_bkops_status;	/* 246 */
 	unsigned int		boot_ro_lock;		/* ro lock support */
 	bool			boot_ro_lockable;
 	u8			raw_partition_support;	/* 160 */
@@ -95,6 +103,31 @@ struct mmc_ext_csd {
 #define MMC_DISCARD_FEATURE	BIT(0)                  /* CMD38 feature */
 };
 
+/**
+ * struct mmc_bkops_info - background operations of an eMMC
+ * @dw: starts BKOPS once the card has been idle for @delay_ms
+ * @delay_ms: idle time before BKOPS are started
+ * @cancel: a request came in, do not start BKOPS
+ * @start: when the running BKOPS were started
+ * @level: times each BKOPS_STATUS level was seen before starting
+ * @starts: BKOPS started while idle
+ * @urgent: BKOPS run on an urgent exception event
+ * @hpi: BKOPS interrupted by a request
+ * @time_us: time spent doing BKOPS
+ */
+struct mmc_bkops_info {
+	struct delayed_work	dw;
+	u32			delay_ms;
+#define MMC_BKOPS_DELAY_MS	2000
+	bool			cancel;
+	ktime_t			start;
+	unsigned int		level[4];
+	unsigned int		starts;
+	unsigned int		urgent;
+	unsigned int		hpi;
+	u64			time_us;
+};
+
 struct sd_scr {
 	unsigned char		sda_vsn;
 	unsigned char		sda_spec3;
@@ -221,6 +254,7 @@ struct mmc_card {
 #define MMC_CARD_REMOVED	(1<<7)		/* card has been removed */
 #define MMC_STATE_HIGHSPEED_200	(1<<8)		/* card is in HS200 mode */
 #define MMC_STATE_SLEEP		(1<<9)		/* card is in sleep state */
+#define MMC_STATE_DOING_BKOPS	(1<<10)		/* card is doing BKOPS */
 	unsigned int		quirks; 	/* card quirks */
 #define MMC_QUIRK_LENIENT_FN0	(1<<0)		/* allow SDIO FN0 writes outside of the VS CCCR range */
 #define MMC_QUIRK_BLKSZ_FOR_BYTE_MODE (1<<1)	/* use func->cur_blksize */
@@ -271,6 +305,8 @@ struct mmc_card {
 	struct dentry		*debugfs_root;
 	struct mmc_part	part[MMC_NUM_PHY_PARTITION]; /* physical partitions */
 	unsigned int    nr_parts;
+
+	struct mmc_bkops_info	bkops_info;
 };
 
 /*
@@ -388,6 +424,7 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_ext_capacity(c) ((c)->state & MMC_CARD_SDXC)
 #define mmc_card_removed(c)	((c) && ((c)->state & MMC_CARD_REMOVED))
 #define mmc_card_is_sleep(c)	((c)->state & MMC_STATE_SLEEP)
+#define mmc_card_doing_bkops(c)	((c)->state & MMC_STATE_DOING_BKOPS)
 
 #define mmc_card_set_present(c)	((c)->state |= MMC_STATE_PRESENT)
 #define mmc_card_set_readonly(c) ((c)->state |= MMC_STATE_READONLY)
@@ -400,8 +437,10 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_set_ext_capacity(c) ((c)->state |= MMC_CARD_SDXC)
 #define mmc_card_set_removed(c) ((c)->state |= MMC_CARD_REMOVED)
 #define mmc_card_set_sleep(c)	((c)->state |= MMC_STATE_SLEEP)
+#define mmc_card_set_doing_bkops(c)	((c)->state |= MMC_STATE_DOING_BKOPS)
 
 #define mmc_card_clr_sleep(c)	((c)->state &= ~MMC_STATE_SLEEP)
+#define mmc_card_clr_doing_bkops(c)	((c)->state &= ~MMC_STATE_DOING_BKOPS)
 /*
  * Quirk add/remove for MMC products.
  */
@@ -0,0 +1,23 @@
+#ifndef _XT_UIDSET_H
+#define _XT_UIDSET_H
+
+#include <linux/types.h>
+
+enum {
+	XT_UIDSET_INVERT = 1 << 0,
+	XT_UIDSET_MASK   = 0x01,
+};
+
+#define XT_UIDSET_NAME_LEN	16
+
+struct xt_uidset;
+
+struct xt_uidset_mtinfo {
+	char name[XT_UIDSET_NAME_LEN];
+	__u8 flags;
+
+	/* Used internally by the kernel */
+	struct xt_uidset *set __attribute__((aligned(8)));
+};
+
+#endif /* _XT_UIDSET_H */
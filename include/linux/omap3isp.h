@@ -73,6 +73,56 @@ struct omap3isp_stat_event_status {
 	__u32 frame_number;
 	__u16 config_counter;
 	__u8 buf_err;
+	__u8 buf_index;
+};
+
+/*
+ * Statistics ring
+ *
+ * Once a statistics module is configured, its buffers can be mapped read-only
+ * from its subdev node instead of being copied by VIDIOC_OMAP3ISP_STAT_REQ.
+ * The page at offset 0 holds a struct omap3isp_stat_ring, the buffers follow
+ * from offset OMAP3ISP_STAT_RING_DATA, each at the offset given in its
+ * descriptor. The index of the buffer holding the statistics is reported in
+ * the buf_index field of the event.
+ *
+ * The sequence number of a buffer is odd while the module writes to it.
+ * Readers must check that it is even before reading data, and unchanged
+ * after, as buffers are recycled oldest first.
+ */
+
+#define OMAP3ISP_STAT_MAX_BUFS		5
+#define OMAP3ISP_STAT_RING_DATA		4096
+
+/**
+ * struct omap3isp_stat_ring_buf - Statistics buffer descriptor
+ * @sequence: Incremented when the module starts and stops writing the buffer
+ * @frame_number: Frame number of the statistics
+ * @offset: mmap offset of the buffer
+ * @buf_size: Size of the statistics data
+ * @config_counter: Number of the configuration associated with the data
+ * @ts: Timestamp of the statistics
+ */
+struct omap3isp_stat_ring_buf {
+	__u32 sequence;
+	__u32 frame_number;
+	__u32 offset;
+	__u32 buf_size;
+	__u16 config_counter;
+	__u16 reserved;
+	struct timeval ts;
+};
+
+/**
+ * struct omap3isp_stat_ring - Statistics ring header
+ * @num_bufs: Number of buffers in the ring
+ * @latest: Index of the most recently completed buffer
+ * @bufs: Buffer descriptors
+ */
+struct omap3isp_stat_ring {
+	__u32 num_bufs;
+	__u32 latest;
+	struct omap3isp_stat_ring_buf bufs[OMAP3ISP_STAT_MAX_BUFS];
 };
 
 /* AE/AWB related structures and flags*/
@@ -0,0 +1,67 @@
+/*
+ * OMAP power allocation thermal governor
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+*/
+
+#ifndef __LINUX_OMAP_POWER_GOVERNOR_H__
+#define __LINUX_OMAP_POWER_GOVERNOR_H__
+
+#include <linux/types.h>
+
+/**
+ * struct omap_power_actor_data - power model of a throttled device
+ * @domain: thermal domain of the cooling agents throttling the device
+ * @hwmod: hwmod name of the device, its OPPs are the throttling steps
+ * @capacitance: dynamic power coefficient in uW/(MHz.V^2), used to build
+ *		 the power table from the OPPs when @power is NULL
+ * @power: power drawn at each OPP in mW, lowest OPP first
+ * @nr_power: number of entries in @power, must match the number of OPPs
+ * @weight: share of the budget relative to the other devices, 256 is 1
+ */
+struct omap_power_actor_data {
+	const char *domain;
+	const char *hwmod;
+	u32 capacitance;
+	const u32 *power;
+	int nr_power;
+	u32 weight;
+};
+
+/**
+ * struct omap_power_governor_pdata - platform data for the power governor
+ * @actors: the devices the power budget is shared between
+ * @nr_actors: number of entries in @actors
+ * @sustainable_power: power in mW the device can dissipate at the control
+ *		       temperatures, 0 for the default
+ * @control_temp: hot spot temperature to regulate to in mC, 0 for the default
+ * @case_control_temp: case temperature to regulate to in mC, 0 for the default
+ */
+struct omap_power_governor_pdata {
+	struct omap_power_actor_data *actors;
+	int nr_actors;
+	u32 sustainable_power;
+	int control_temp;
+	int case_control_temp;
+};
+
+#ifdef CONFIG_OMAP_POWER_GOVERNOR
+void omap_power_governor_register_pdata(struct omap_power_governor_pdata *pdata);
+#else
+static inline void omap_power_governor_register_pdata(struct
+					omap_power_governor_pdata *pdata)
+{
+}
+#endif
+
+#endif /* __LINUX_OMAP_POWER_GOVERNOR_H__ */
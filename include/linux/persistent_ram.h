@@ -19,8 +19,10 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 
 struct persistent_ram_buffer;
+struct persistent_ram_store;
 
 struct persistent_ram_descriptor {
 	const char	*name;
@@ -55,6 +57,22 @@ struct persistent_ram_zone {
 	int ecc_symsize;
 	int ecc_poly;
 
+	/* Ring plus compressed store, the part covered by ECC */
+	size_t data_size;
+
+	/* LZO compression of sealed chunks, ring is data[0..buffer_size) */
+	bool compress;
+	struct persistent_ram_store *store;
+	size_t store_offset;
+	size_t store_size;
+	size_t store_pos;
+	atomic_t written;
+	u32 sealed;
+	void *chunk_buf;
+	void *comp_buf;
+	void *wrkmem;
+	struct delayed_work compress_work;
+
 	char *old_log;
 	size_t old_log_size;
 	size_t old_log_footer_size;
@@ -65,6 +83,8 @@ int persistent_ram_early_init(struct persistent_ram *ram);
 
 struct persistent_ram_zone *persistent_ram_init_ringbuffer(struct device *dev,
 		bool ecc);
+struct persistent_ram_zone *persistent_ram_init_compressed(struct device *dev,
+		bool ecc);
 
 int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 	unsigned int count);
@@ -654,4 +654,35 @@ struct tc_qfq_stats {
 	__u32 lmax;
 };
 
+/* BATCH */
+enum {
+	TCA_BATCH_UNSPEC,
+	TCA_BATCH_PARMS,
+	__TCA_BATCH_MAX,
+};
+
+#define TCA_BATCH_MAX (__TCA_BATCH_MAX - 1)
+
+/*
+ * A packet can be held if bit skb->priority of prio_mask is set, or if
+ * mark_mask is non zero and (skb->mark & mark_mask) == mark.
+ */
+struct tc_batch_qopt {
+	__u32	limit;		/* max packets in the qdisc */
+	__u32	window;		/* longest a packet is held, in ms */
+	__u32	active;		/* the link is awake for this long after a packet, in ms */
+	__u32	defer_limit;	/* held packets that force a flush */
+	__u32	prio_mask;
+	__u32	mark;
+	__u32	mark_mask;
+};
+
+struct tc_batch_xstats {
+	__u32	wakeups;	/* packets sent while the link was idle */
+	__u32	deferred;	/* packets held */
+	__u32	flush_active;	/* held packets sent along with other traffic */
+	__u32	flush_timeout;	/* held packets sent when their window ran out */
+	__u32	flush_limit;	/* held packets sent because too many were held */
+};
+
 #endif
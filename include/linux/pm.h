@@ -503,6 +503,8 @@ struct pm_subsys_data {
 #endif
 };
 
+struct pm_autosuspend_stats;
+
 struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned int		can_wakeup:1;
@@ -547,6 +549,7 @@ struct dev_pm_info {
 	ktime_t			suspend_time;
 	s64			max_time_suspended_ns;
 	struct dev_pm_qos_request *pq_req;
+	struct pm_autosuspend_stats *autosuspend_stats;
 #endif
 	struct pm_subsys_data	*subsys_data;  /* Owned by the subsystem. */
 	struct pm_qos_constraints *constraints;
@@ -124,4 +124,10 @@
 #define PR_SET_CHILD_SUBREAPER 36
 #define PR_GET_CHILD_SUBREAPER 37
 
+/*
+ * Record the page cache misses of the process into a readahead trace,
+ * returns a file descriptor for the trace.  See linux/ratrace.h.
+ */
+#define PR_RA_TRACE_START 38
+
 #endif /* _LINUX_PRCTL_H */
@@ -15,6 +15,11 @@ struct ratelimit_state {
 	int		printed;
 	int		missed;
 	unsigned long	begin;
+
+	/* Lifetime suppression report, see /sys/kernel/debug/ratelimit */
+	unsigned long	suppressed;
+	const char	*func;
+	struct ratelimit_state *next;
 };
 
 #define DEFINE_RATELIMIT_STATE(name, interval_init, burst_init)		\
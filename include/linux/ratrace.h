@@ -0,0 +1,81 @@
+#ifndef _LINUX_RATRACE_H
+#define _LINUX_RATRACE_H
+/*
+ * Readahead traces: record the page cache misses of a process while it
+ * starts up and replay them as readahead the next time it is launched.
+ *
+ * prctl(PR_RA_TRACE_START, nr_entries) starts recording for the calling
+ * process and returns a file descriptor for the trace.  The fd can be
+ * handed to the launcher, which controls the trace with the ioctls below.
+ */
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* one record as returned by read() on a stopped trace */
+struct ratrace_record {
+	__u64	ino;
+	__u64	index;		/* first page cache page of the miss */
+	__u32	dev;		/* new_encode_dev() of the superblock */
+	__u32	nr_pages;
+};
+
+struct ratrace_stats {
+	__u32	entries;	/* recorded misses, after merging */
+	__u32	dropped;	/* misses that did not fit the trace */
+	__u64	pages;		/* pages the misses covered */
+	__u64	replay_pages;	/* pages submitted for read by replays */
+	__u64	replay_cached;	/* pages a replay found already cached */
+};
+
+#define RATRACE_IOC_MAGIC	0xB4
+
+#define RATRACE_IOC_STOP	_IO(RATRACE_IOC_MAGIC, 0)
+#define RATRACE_IOC_REPLAY	_IO(RATRACE_IOC_MAGIC, 1)
+#define RATRACE_IOC_STATS	_IOR(RATRACE_IOC_MAGIC, 2, struct ratrace_stats)
+
+#ifdef __KERNEL__
+
+#include <linux/sched.h>
+
+struct file;
+
+#ifdef CONFIG_READAHEAD_TRACE
+extern int ratrace_start(unsigned long nr_entries);
+extern void __ratrace_exit(struct mm_struct *mm);
+extern void __ratrace_record(struct mm_struct *mm, struct file *filp,
+			     pgoff_t index, unsigned long nr_pages);
+
+static inline void ratrace_exit(struct mm_struct *mm)
+{
+	if (unlikely(rcu_access_pointer(mm->ra_trace)))
+		__ratrace_exit(mm);
+}
+
+static inline void ratrace_record(struct file *filp, pgoff_t index,
+				  unsigned long nr_pages)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (unlikely(mm && rcu_access_pointer(mm->ra_trace)) && filp)
+		__ratrace_record(mm, filp, index, nr_pages);
+}
+#else
+static inline int ratrace_start(unsigned long nr_entries)
+{
+	return -EINVAL;
+}
+
+static inline void ratrace_exit(struct mm_struct *mm)
+{
+}
+
+static inline void ratrace_record(struct file *filp, pgoff_t index,
+				  unsigned long nr_pages)
+{
+}
+#endif /* CONFIG_READAHEAD_TRACE */
+
+#endif /* __KERNEL__ */
+
+#endif /* _LINUX_RATRACE_H */
@@ -43,6 +43,10 @@
 #include <linux/completion.h>
 #include <linux/idr.h>
 #include <linux/pm_qos.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+
+struct firmware;
 
 /**
  * struct resource_table - firmware resource table header
@@ -475,6 +479,64 @@ enum rproc_err {
 	RPROC_ERR_WATCHDOG	= 2,
 };
 
+/**
+ * struct rproc_boot_stats - duration of the phases of the last boot
+ * @count: number of successful boots
+ * @fw_cached: the last boot used the cached firmware image
+ * @request_us: time spent getting the firmware image, in usecs
+ * @rsc_us: time spent parsing and handling the boot resources
+ * @load_us: time spent loading the ELF segments
+ * @iommu_us: time spent enabling and programming the iommu
+ * @start_us: time spent powering up the remote processor
+ * @total_us: duration of the whole boot
+ */
+struct rproc_boot_stats {
+	unsigned int count;
+	bool fw_cached;
+	u32 request_us;
+	u32 rsc_us;
+	u32 load_us;
+	u32 iommu_us;
+	u32 start_us;
+	u32 total_us;
+};
+
+/**
+ * struct rproc_pm - adaptive autosuspend state and runtime pm statistics
+ * @lock: protects the traffic history and the statistics
+ * @work: hands a new autosuspend delay over to the pm core
+ * @last_activity: time of the last message exchanged with the rproc
+ * @suspended_at: time of the last runtime suspend
+ * @avg_gap: moving average of the idle gaps between bursts, in msecs
+ * @delay: autosuspend delay currently in use, in msecs
+ * @holds: number of rproc_pm_hold() calls keeping the rproc resident
+ * @held: the holds own a runtime pm reference
+ * @user_hold: userspace asked for the rproc to stay resident
+ * @suspends: number of runtime suspends
+ * @resumes: number of runtime resumes
+ * @bounces: resumes coming less than an autosuspend delay after the suspend
+ * @resume_us: duration of the last runtime resume, in usecs
+ * @resume_avg_us: moving average of the runtime resume duration
+ * @resume_max_us: longest runtime resume
+ */
+struct rproc_pm {
+	spinlock_t lock;
+	struct work_struct work;
+	ktime_t last_activity;
+	ktime_t suspended_at;
+	u32 avg_gap;
+	int delay;
+	unsigned int holds;
+	bool held;
+	bool user_hold;
+	unsigned int suspends;
+	unsigned int resumes;
+	unsigned int bounces;
+	u32 resume_us;
+	u32 resume_avg_us;
+	u32 resume_max_us;
+};
+
 /**
  * struct rproc - represents a physical remote processor device
  * @node: klist node of this rproc object
@@ -509,6 +571,9 @@ enum rproc_err {
  * @auto_suspend_timeout: store the auto suspend timeout for a rproc in msecs
  * @need resume: if true a resume is needed in the system resume callback
  * @system_suspended: true if a system suspend has happened
+ * @cached_fw: firmware image kept across boots and recoveries
+ * @boot_stats: timing of the last boot
+ * @pm: adaptive autosuspend state
  */
 struct rproc {
 	struct klist_node node;
@@ -543,6 +608,9 @@ struct rproc {
 	bool need_resume;
 	bool system_suspended;
 	char *fw_version;
+	const struct firmware *cached_fw;
+	struct rproc_boot_stats boot_stats;
+	struct rproc_pm pm;
 };
 
 /* we currently support only two vrings per rvdev */
@@ -608,6 +676,8 @@ int rproc_set_constraints(struct device *dev, struct rproc *rproc,
 			  enum rproc_constraint type, long v);
 void *rproc_da_to_va(struct rproc *rproc, u64 da, int len);
 int rproc_pa_to_da(struct rproc *rproc, phys_addr_t pa, u64 *da);
+void rproc_pm_hold(struct rproc *rproc);
+void rproc_pm_release(struct rproc *rproc);
 
 static inline struct rproc_vdev *vdev_to_rvdev(struct virtio_device *vdev)
 {
@@ -65,6 +65,26 @@ struct rpmsg_hdr {
 	u8 data[0];
 } __packed;
 
+/* rpmsg_hdr flags */
+#define RPMSG_HDR_F_SHARED	(1 << 0) /* payload is a rpmsg_shared_desc */
+
+/**
+ * struct rpmsg_shared_desc - descriptor of a payload passed by reference
+ * @da: device address of the payload, as seen by the remote processor
+ * @len: length of the payload (in bytes)
+ * @reserved: reserved for future use
+ *
+ * Messages flagged with RPMSG_HDR_F_SHARED carry this descriptor instead
+ * of their payload, which is left in a buffer shared with the remote
+ * processor (see struct rpmsg_shared_buf). This avoids both copying large
+ * payloads and splitting them across several messages.
+ */
+struct rpmsg_shared_desc {
+	u32 da;
+	u32 len;
+	u32 reserved;
+} __packed;
+
 /**
  * struct rpmsg_ns_msg - dynamic name service announcement message
  * @name: name of remote service that is published
@@ -96,6 +116,20 @@ enum rpmsg_ns_flags {
 
 #define RPMSG_ADDR_ANY		0xFFFFFFFF
 
+/**
+ * struct rpmsg_rx_stats - rx coalescing statistics of a virtual processor
+ * @callbacks: number of times the rx vring callback was invoked
+ * @msgs: number of messages received
+ * @kicks: number of times rx buffers were handed back to the remote
+ * @budget_hits: number of rx batches that hit the polling budget
+ */
+struct rpmsg_rx_stats {
+	unsigned long callbacks;
+	unsigned long msgs;
+	unsigned long kicks;
+	unsigned long budget_hits;
+};
+
 /**
  * struct virtproc_info - virtual remote processor state
  * @vdev:	the virtio device
@@ -108,11 +142,18 @@ enum rpmsg_ns_flags {
  * @tx_lock:	protects svq, sbufs and sleepers, to allow concurrent senders.
  *		sending a message might require waking up a dozing remote
  *		processor, which involves sleeping, hence the mutex.
- * @rx_lock:	protects rvq, to allow concurrent receive threads.
+ * @rx_lock:	protects rvq and rx_stats, to allow concurrent receive threads.
  * @endpoints:	idr of local endpoints, allows fast retrieval
  * @endpoints_lock: lock of the endpoints set
  * @sendq:	wait queue of sending contexts waiting for a tx buffers
  * @sleepers:	number of senders that are waiting for a tx buffer
+ * @sbuf_free:	stack of recycled tx buffers
+ * @num_free:	number of buffers in @sbuf_free
+ * @sbuf_owner:	endpoint each in-flight tx buffer is accounted to, if any
+ * @tx_reserved: total number of tx buffers reserved by endpoints
+ * @tx_held:	reserved tx buffers not in flight, only given to their owners
+ * @rx_stats:	rx coalescing statistics
+ * @dbg_stats:	debugfs entry exposing the statistics
  * @ns_ept:	the bus's name service endpoint
  * @id:		unique system-wide index id for this vproc
  * @use_carveout: flag for using carveout for vring buffers.
@@ -134,6 +175,13 @@ struct virtproc_info {
 	struct mutex endpoints_lock;
 	wait_queue_head_t sendq;
 	atomic_t sleepers;
+	void **sbuf_free;
+	int num_free;
+	struct rpmsg_endpoint **sbuf_owner;
+	int tx_reserved;
+	int tx_held;
+	struct rpmsg_rx_stats rx_stats;
+	struct dentry *dbg_stats;
 	struct rpmsg_endpoint *ns_ept;
 	int id;
 	int use_carveout;
@@ -169,6 +217,8 @@ typedef void (*rpmsg_rx_cb_t)(struct rpmsg_channel *, void *, int, void *, u32);
  * @cb_lock: must be taken before accessing/changing @cb
  * @addr: local rpmsg address
  * @priv: private data for the driver's use
+ * @tx_reserved: number of tx buffers reserved for this endpoint
+ * @tx_inflight: number of tx buffers sent from this endpoint still in use
  *
  * In essence, an rpmsg endpoint represents a listener on the rpmsg bus, as
  * it binds an rpmsg address with an rx callback handler.
@@ -191,6 +241,8 @@ struct rpmsg_endpoint {
 	struct mutex cb_lock;
 	u32 addr;
 	void *priv;
+	int tx_reserved;
+	int tx_inflight;
 };
 
 /**
@@ -218,6 +270,52 @@ struct rpmsg_endpoint *rpmsg_create_ept(struct rpmsg_channel *,
 				rpmsg_rx_cb_t cb, void *priv, u32 addr);
 int
 rpmsg_send_offchannel_raw(struct rpmsg_channel *, u32, u32, void *, int, bool);
+int rpmsg_send_offchannel_flags(struct rpmsg_channel *, u32, u32, void *, int,
+								u16, bool);
+int rpmsg_reserve_tx_bufs(struct rpmsg_endpoint *ept, int count);
+
+/**
+ * struct rpmsg_shared_buf - physically contiguous buffer shared with a remote
+ * @rpdev: channel the buffer is shared over
+ * @pa: physical address of the buffer
+ * @da: device address of the buffer, as seen by the remote processor
+ * @size: size of the buffer (in bytes)
+ * @cached: whether the buffer is in kernel managed, cacheable memory
+ * @remote: set while the remote processor owns the buffer
+ * @offset: offset of the payload last sent to the remote processor
+ * @len: length of the payload last sent to the remote processor
+ *
+ * Ownership of the buffer moves to the remote processor with
+ * rpmsg_send_shared(), and back to the CPU with rpmsg_shared_buf_reclaim()
+ * once the remote processor is done with it (which is signalled by the
+ * protocol of the channel). Cache maintenance is done on both transitions,
+ * so the CPU must not access the payload in between.
+ *
+ * Users must serialize the operations on a given buffer.
+ */
+struct rpmsg_shared_buf {
+	struct rpmsg_channel *rpdev;
+	phys_addr_t pa;
+	u32 da;
+	size_t size;
+	bool cached;
+	bool remote;
+	size_t offset;
+	size_t len;
+};
+
+struct ion_client;
+struct ion_handle;
+
+int rpmsg_shared_buf_init(struct rpmsg_shared_buf *buf,
+			  struct rpmsg_channel *rpdev, phys_addr_t pa,
+			  size_t size);
+int rpmsg_shared_buf_import(struct rpmsg_shared_buf *buf,
+			    struct rpmsg_channel *rpdev,
+			    struct ion_client *client, struct ion_handle *handle);
+int rpmsg_send_shared(struct rpmsg_shared_buf *buf, u32 src, u32 dst,
+		      size_t offset, size_t len, bool wait);
+int rpmsg_shared_buf_reclaim(struct rpmsg_shared_buf *buf);
 
 /**
  * rpmsg_send() - send a message across to the remote processor
@@ -617,6 +617,9 @@ struct signal_struct {
 	unsigned long inblock, oublock, cinblock, coublock;
 	unsigned long maxrss, cmaxrss;
 	struct task_io_accounting ioac;
+#ifdef CONFIG_CPU_FREQ_ENERGY
+	u64 cpu_energy;		/* estimated uJ used by dead threads */
+#endif
 
 	/*
 	 * Cumulative ns of schedule CPU time fo dead threads in the
@@ -664,6 +667,10 @@ struct signal_struct {
 	int oom_score_adj;	/* OOM kill score adjustment */
 	int oom_score_adj_min;	/* OOM kill score adjustment minimum value.
 				 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	struct hlist_node lmk_node;	/* lowmemorykiller oom_score_adj bucket */
+	int lmk_adj;		/* bucket lmk_node is currently on */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -1201,6 +1208,21 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+	u64			nr_wakeups_packed;
+	u64			nr_wakeups_pack_full;
+	u64			nr_failed_migrations_packed;
+};
+#endif
+
+#ifdef CONFIG_SMP
+/*
+ * Share of the recent time a task was runnable, or a cpu busy: both sums
+ * are in ~us and are halved each time the period reaches ~32ms.
+ */
+struct sched_avg {
+	u64			last_update;
+	u32			runnable_sum;
+	u32			period;
 };
 #endif
 
@@ -1228,7 +1250,38 @@ struct sched_entity {
 	/* rq "owned" by this entity/group: */
 	struct cfs_rq		*my_q;
 #endif
+
+#ifdef CONFIG_SMP
+	struct sched_avg	runnable_avg;
+#endif
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* cpu demand of a task, for the frequency governor */
+	u64			demand_window_start;
+	u32			demand_sum;
+	u32			demand;
+#endif
+};
+
+#ifdef CONFIG_SCHED_RT_RESERVATION
+/*
+ * A realtime task may reserve @runtime ns of CPU every @period ns.
+ * Once it has used up its runtime it is left off the runqueue until
+ * the next period starts, so it cannot starve anything else.
+ */
+struct sched_rt_reservation {
+	u64			runtime;
+	u64			period;
+	u64			bw;		/* share, 1 << 20 = 1 cpu */
+	u64			used;		/* in this period */
+	u64			period_end;	/* rq->clock */
+	struct hrtimer		timer;		/* ends throttling */
+	unsigned int		throttled:1;
+	unsigned int		overrun:1;	/* throttled in this period */
+	u64			nr_periods;
+	u64			nr_overruns;
 };
+#endif
 
 struct sched_rt_entity {
 	struct list_head run_list;
@@ -1244,6 +1297,9 @@ struct sched_rt_entity {
 	/* rq "owned" by this entity/group: */
 	struct rt_rq		*my_q;
 #endif
+#ifdef CONFIG_SCHED_RT_RESERVATION
+	struct sched_rt_reservation resv;
+#endif
 };
 
 /*
@@ -1521,6 +1577,9 @@ struct task_struct {
 	unsigned long ptrace_message;
 	siginfo_t *last_siginfo; /* For ptrace use.  */
 	struct task_io_accounting ioac;
+#ifdef CONFIG_CPU_FREQ_ENERGY
+	u64 cpu_energy;		/* estimated uJ, see cpufreq_energy.c */
+#endif
 #if defined(CONFIG_TASK_XACCT)
 	u64 acct_rss_mem1;	/* accumulated rss usage */
 	u64 acct_vm_mem1;	/* accumulated virtual memory usage */
@@ -1644,6 +1703,14 @@ struct task_struct {
 #define MAX_PRIO		(MAX_RT_PRIO + 40)
 #define DEFAULT_PRIO		(MAX_RT_PRIO + 20)
 
+/*
+ * Convert user-nice values [ -20 ... 0 ... 19 ]
+ * to static priority [ MAX_RT_PRIO..MAX_PRIO-1 ],
+ * and back.
+ */
+#define NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
+#define PRIO_TO_NICE(prio)	((prio) - MAX_RT_PRIO - 20)
+
 static inline int rt_prio(int prio)
 {
 	if (unlikely(prio < MAX_RT_PRIO))
@@ -2015,6 +2082,33 @@ static inline void disable_sched_clock_irqtime(void) {}
 extern unsigned long long
 task_sched_runtime(struct task_struct *task);
 
+/*
+ * Scheduler inputs to the cpufreq governor: the demand of a cpu is the
+ * share of the cpu its fair tasks ran for recently, SCHED_DEMAND_SCALE
+ * being all of it. The notifiers are called with the events below and a
+ * struct sched_freq_event, from atomic context but without any runqueue
+ * lock held.
+ */
+#define SCHED_DEMAND_SHIFT	10
+#define SCHED_DEMAND_SCALE	(1UL << SCHED_DEMAND_SHIFT)
+
+#define SCHED_FREQ_WAKEUP	1	/* a task woke up on the cpu */
+#define SCHED_FREQ_MIGRATION	2	/* tasks were moved to/from the cpu */
+
+struct sched_freq_event {
+	int cpu;
+	/* lower bound on the demand of @cpu, it may not be accounted yet */
+	unsigned long demand;
+};
+
+struct notifier_block;
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+extern unsigned long sched_get_cpu_demand(int cpu);
+extern int register_sched_freq_notifier(struct notifier_block *nb);
+extern int unregister_sched_freq_notifier(struct notifier_block *nb);
+#endif
+
 /* sched_exec is called by processes performing an exec */
 #ifdef CONFIG_SMP
 extern void sched_exec(void);
@@ -2056,6 +2150,8 @@ extern unsigned int sysctl_sched_nr_migrate;
 extern unsigned int sysctl_sched_time_avg;
 extern unsigned int sysctl_timer_migration;
 extern unsigned int sysctl_sched_shares_window;
+extern unsigned int sysctl_sched_pack_util;
+extern unsigned int sysctl_sched_pack_task_util;
 
 int sched_proc_update_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *length,
@@ -2079,6 +2175,13 @@ int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
 
+#if defined(CONFIG_SCHED_RT_RESERVATION) && defined(CONFIG_PROC_FS)
+extern void proc_sched_rt_reservation_show(struct task_struct *p,
+					   struct seq_file *m);
+extern int proc_sched_rt_reservation_set(struct task_struct *p,
+					 u64 runtime, u64 period);
+#endif
+
 #ifdef CONFIG_SCHED_AUTOGROUP
 extern unsigned int sysctl_sched_autogroup_enabled;
 
@@ -41,14 +41,26 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	FREE_REMOTE,		/* Free queued for a batched slowpath free */
+	FREE_REMOTE_FLUSH,	/* Batch of queued frees flushed */
+	FREE_REMOTE_SLABS,	/* Slabs the flushed batches were freed to */
 	NR_SLUB_STAT_ITEMS };
 
+/*
+ * Frees of objects that are not in the cpu slab are queued per cpu and
+ * handed back to their slabs this many at a time, one slowpath free per
+ * slab in the batch.
+ */
+#define SLUB_REMOTE_BATCH	16
+
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to next available object */
 	unsigned long tid;	/* Globally unique transaction id */
 	struct page *page;	/* The slab from which we are allocating */
 	struct page *partial;	/* Partially allocated frozen slabs */
 	int node;		/* The node of the page (or -1 for debug) */
+	int nr_remote;		/* Objects queued in remote[] */
+	void *remote[SLUB_REMOTE_BATCH];
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
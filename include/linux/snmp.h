@@ -235,6 +235,9 @@ enum
 	LINUX_MIB_TCPRCVCOALESCE,			/* TCPRcvCoalesce */
 	LINUX_MIB_TCPCHALLENGEACK,		/* TCPChallengeACK */
 	LINUX_MIB_TCPSYNCHALLENGE,		/* TCPSYNChallenge */
+	LINUX_MIB_IPEARLYDEMUXSOCK,		/* IPEarlyDemuxSock */
+	LINUX_MIB_IPEARLYDEMUXDST,		/* IPEarlyDemuxDst */
+	LINUX_MIB_IPEARLYDEMUXMISS,		/* IPEarlyDemuxMiss */
 	__LINUX_MIB_MAX
 };
 
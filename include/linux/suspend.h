@@ -7,6 +7,7 @@
 #include <linux/pm.h>
 #include <linux/mm.h>
 #include <linux/freezer.h>
+#include <linux/ktime.h>
 #include <asm/errno.h>
 
 #ifdef CONFIG_VT
@@ -441,4 +442,38 @@ static inline void page_key_write(void *address) {}
 
 #endif /* !CONFIG_ARCH_SAVE_PAGE_KEYS */
 
+#ifdef CONFIG_SUSPEND_TIME
+extern void suspend_time_device_resumed(struct device *dev, ktime_t start);
+extern void suspend_time_resume_done(void);
+extern void suspend_time_aborted(const char *source, ktime_t start);
+extern void suspend_time_backoff(unsigned int msecs);
+#else
+static inline void suspend_time_device_resumed(struct device *dev,
+					       ktime_t start) {}
+static inline void suspend_time_resume_done(void) {}
+static inline void suspend_time_aborted(const char *source,
+					ktime_t start) {}
+static inline void suspend_time_backoff(unsigned int msecs) {}
+#endif
+
+#ifdef CONFIG_WAKEUP_REASON
+extern void log_wakeup_reason(int irq);
+extern void wakeup_reason_wake_lock(const char *name);
+#ifdef CONFIG_WAKELOCK
+extern bool wakeup_reason_wake_lock_timeout(long timeout);
+#else
+static inline bool wakeup_reason_wake_lock_timeout(long timeout)
+{
+	return false;
+}
+#endif
+#else
+static inline void log_wakeup_reason(int irq) {}
+static inline void wakeup_reason_wake_lock(const char *name) {}
+static inline bool wakeup_reason_wake_lock_timeout(long timeout)
+{
+	return false;
+}
+#endif
+
 #endif /* _LINUX_SUSPEND_H */
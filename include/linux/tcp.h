@@ -453,6 +453,11 @@ struct tcp_sock {
 		u32	time;
 	} rcvq_space;
 
+	/* Autotuning ceilings, from the egress device if it sets them */
+	int	rcvbuf_max;
+	int	sndbuf_max;
+	int	tune_ifindex;	/* device they came from, 0 if none */
+
 /* TCP-specific MTU probe information. */
 	struct {
 		u32		  probe_seq_start;
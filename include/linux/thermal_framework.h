@@ -103,6 +103,8 @@ struct thermal_cooling_action {
  * @temp_sensor: Pointer to temp_sensor of the domain.
  * @avg_sensor_temp_work: delayed_work structure for the stats computation.
  * @pm_notifier: pm notofier to start and stop the work function.
+ * @polling: Flag which tells if the work function is periodically sampling.
+ * @poll_count: Number of samples taken by the work function.
  */
 
 struct stats_thermal {
@@ -126,6 +128,8 @@ struct stats_thermal {
 	struct thermal_dev		*temp_sensor;
 	struct delayed_work		avg_sensor_temp_work;
 	struct notifier_block		pm_notifier;
+	bool				polling;
+	u32				poll_count;
 };
 
 /**
@@ -219,10 +223,13 @@ extern int thermal_lookup_avg(const char *domain_name);
 extern int thermal_lookup_trend(const char *domain_name);
 extern int thermal_lookup_slope(const char *domain_name, const char *rel);
 extern int thermal_lookup_offset(const char *domain_name, const char *rel);
+extern int thermal_cool_domain(const char *domain_name, int level);
 extern int thermal_sensor_set_temp(struct thermal_dev *tdev);
 extern int thermal_get_slope(struct thermal_dev *tdev, const char *rel);
 extern int thermal_get_offset(struct thermal_dev *tdev, const char *rel);
 extern int thermal_set_avg_period(struct thermal_dev *temp_sensor, int rate);
+extern int thermal_set_stats_polling(struct thermal_dev *temp_sensor,
+				     bool enable);
 /* Registration and unregistration calls for the thermal devices */
 extern int thermal_sensor_dev_register(struct thermal_dev *tdev);
 extern void thermal_sensor_dev_unregister(struct thermal_dev *tdev);
@@ -266,6 +273,11 @@ static inline int thermal_set_avg_period(struct thermal_dev *temp_sensor,
 {
 	return 0;
 }
+static inline int thermal_set_stats_polling(struct thermal_dev *temp_sensor,
+					    bool enable)
+{
+	return 0;
+}
 static inline int thermal_lookup_temp(const char *domain_name)
 {
 	return 0;
@@ -288,6 +300,10 @@ inline int thermal_lookup_offset(const char *domain_name, const char *rel)
 {
 	return 0;
 }
+static inline int thermal_cool_domain(const char *domain_name, int level)
+{
+	return -ENODEV;
+}
 static inline int thermal_sensor_set_temp(struct thermal_dev *tdev)
 {
 	return 0;
@@ -101,6 +101,22 @@ extern long st_unregister(struct st_proto_s *);
 #define ST_REG_PENDING		3
 #define ST_WAITING_FOR_RESP	4
 
+/**
+ * struct st_rx_stats - per channel receive accounting
+ * @frames: frames handed to the protocol driver
+ * @bytes: bytes in those frames, header included
+ * @whole: frames that arrived in a single tty buffer and were copied out
+ *	in one go instead of going through the rx state machine
+ * @dropped: frames lost to allocation failures, oversize lengths or a
+ *	protocol driver refusing them
+ */
+struct st_rx_stats {
+	unsigned long frames;
+	unsigned long bytes;
+	unsigned long whole;
+	unsigned long dropped;
+};
+
 /**
  * struct st_data_s - ST core internal structure
  * @st_state: different states of ST like initializing, registration
@@ -136,6 +152,8 @@ extern long st_unregister(struct st_proto_s *);
  * @ll_state: the various PM states the chip can be, the states are notified
  *	to us, when the chip sends relevant PM packets(SLEEP_IND, WAKE_IND).
  * @kim_data: reference to the parent encapsulating structure.
+ * @rx_stats: receive counters of each channel, protected by @lock.
+ * @rx_junk: bytes dropped because they did not start a known frame.
  *
  */
 struct st_data_s {
@@ -156,6 +174,8 @@ struct st_data_s {
 	unsigned long ll_state;
 	void *kim_data;
 	struct tty_struct *tty;
+	struct st_rx_stats rx_stats[ST_MAX_CHANNELS];
+	unsigned long rx_junk;
 };
 
 /*
@@ -282,6 +302,7 @@ long st_kim_stop(void *);
 void st_kim_recv(void *, const unsigned char *, long count);
 void st_kim_complete(void *);
 void kim_st_list_protocols(struct st_data_s *, void *);
+void kim_st_rx_stats(struct st_data_s *, void *);
 
 /*
  * BTS headers
@@ -237,9 +237,14 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_WAKEUP		0x2
 
 extern void init_timer_stats(void);
 
+extern void timer_stats_idle_irq_enter(void);
+extern void timer_stats_idle_irq_exit(void);
+extern int timer_stats_idle_wakeup(void);
+
 extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 				     void *timerf, char *comm,
 				     unsigned int timer_flag);
@@ -263,6 +268,14 @@ static inline void init_timer_stats(void)
 {
 }
 
+static inline void timer_stats_idle_irq_enter(void)
+{
+}
+
+static inline void timer_stats_idle_irq_exit(void)
+{
+}
+
 static inline void timer_stats_timer_set_start_info(struct timer_list *timer)
 {
 }
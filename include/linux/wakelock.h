@@ -18,6 +18,7 @@
 
 #include <linux/list.h>
 #include <linux/ktime.h>
+#include <linux/timer.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
  * states when active. If the type is set to WAKE_LOCK_SUSPEND, the wake_lock
@@ -38,6 +39,7 @@ struct wake_lock {
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
+	struct timer_list   timer;
 #ifdef CONFIG_WAKELOCK_STAT
 	struct {
 		int             count;
@@ -47,6 +49,7 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		ktime_t         sleep_wait_start;
 	} stat;
 #endif
 #endif
@@ -68,8 +71,8 @@ int wake_lock_active(struct wake_lock *lock);
 
 /* has_wake_lock returns 0 if no wake locks of the specified type are active,
  * and non-zero if one or more wake locks are held. Specifically it returns
- * -1 if one or more wake locks with no timeout are active or the
- * number of jiffies until all active wake locks time out.
+ * -1 if one or more wake locks with no timeout are active or an upper bound
+ * on the number of jiffies until all active wake locks time out.
  */
 long has_wake_lock(int type);
 
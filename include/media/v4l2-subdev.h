@@ -492,12 +492,15 @@ struct v4l2_subdev_ops {
  * open: called when the subdev device node is opened by an application.
  *
  * close: called when the subdev device node is closed.
+ *
+ * mmap: called when the subdev device node is memory mapped by an application.
  */
 struct v4l2_subdev_internal_ops {
 	int (*registered)(struct v4l2_subdev *sd);
 	void (*unregistered)(struct v4l2_subdev *sd);
 	int (*open)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh);
 	int (*close)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh);
+	int (*mmap)(struct v4l2_subdev *sd, struct vm_area_struct *vma);
 };
 
 #define V4L2_SUBDEV_NAME_SIZE 32
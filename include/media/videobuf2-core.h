@@ -16,6 +16,7 @@
 #include <linux/mutex.h>
 #include <linux/poll.h>
 #include <linux/videodev2.h>
+#include <linux/dma-buf.h>
 
 struct vb2_alloc_ctx;
 struct vb2_fileio_data;
@@ -52,9 +53,29 @@ struct vb2_fileio_data;
  *		it) is the only user
  * @mmap:	setup a userspace mapping for a given memory buffer under
  *		the provided virtual memory region
+ * @attach_dmabuf: attach a shared struct dma_buf for a hardware operation;
+ *		   used for DMABUF memory types; alloc_ctx is the alloc context
+ *		   dbuf is the shared dma_buf; returns NULL on failure;
+ *		   allocator private per-buffer structure on success;
+ *		   this needs to be used for further accesses to the buffer
+ * @detach_dmabuf: inform the exporter of the buffer that the current DMABUF
+ *		   buffer is no longer used; the buf_priv argument is the
+ *		   allocator private per-buffer structure previously returned
+ *		   from the attach_dmabuf callback
+ * @map_dmabuf: request for access to the dmabuf from allocator; the allocator
+ *		of dmabuf is informed that this driver is going to use the
+ *		dmabuf
+ * @unmap_dmabuf: releases access control to the dmabuf - allocator is notified
+ *		  that this driver is done using the dmabuf for now
+ * @sync_for_device: write back CPU caches before the device accesses the
+ *		     buffer; called only if the CPU may have written to it
+ * @sync_for_cpu: discard CPU caches after the device wrote to the buffer;
+ *		  called only if userspace did not opt out of it
  *
  * Required ops for USERPTR types: get_userptr, put_userptr.
  * Required ops for MMAP types: alloc, put, num_users, mmap.
+ * Required ops for DMABUF types: attach_dmabuf, detach_dmabuf, map_dmabuf,
+ *				  unmap_dmabuf.
  * Required ops for read/write access types: alloc, put, num_users, vaddr
  */
 struct vb2_mem_ops {
@@ -65,6 +86,15 @@ struct vb2_mem_ops {
 					unsigned long size, int write);
 	void		(*put_userptr)(void *buf_priv);
 
+	void		*(*attach_dmabuf)(void *alloc_ctx, struct dma_buf *dbuf,
+				unsigned long size, int write);
+	void		(*detach_dmabuf)(void *buf_priv);
+	int		(*map_dmabuf)(void *buf_priv);
+	void		(*unmap_dmabuf)(void *buf_priv);
+
+	void		(*sync_for_device)(void *buf_priv);
+	void		(*sync_for_cpu)(void *buf_priv);
+
 	void		*(*vaddr)(void *buf_priv);
 	void		*(*cookie)(void *buf_priv);
 
@@ -73,8 +103,25 @@ struct vb2_mem_ops {
 	int		(*mmap)(void *buf_priv, struct vm_area_struct *vma);
 };
 
+/**
+ * enum vb2_cache_state - CPU cache state of a plane
+ * @VB2_CACHE_CLEAN:		the CPU caches hold no data for the plane that
+ *				differs from memory
+ * @VB2_CACHE_CPU_DIRTY:	the CPU may have written to the plane
+ * @VB2_CACHE_DEVICE_DIRTY:	the device may have written to the plane, CPU
+ *				cache lines may be stale
+ */
+enum vb2_cache_state {
+	VB2_CACHE_CLEAN,
+	VB2_CACHE_CPU_DIRTY,
+	VB2_CACHE_DEVICE_DIRTY,
+};
+
 struct vb2_plane {
 	void			*mem_priv;
+	struct dma_buf		*dbuf;
+	unsigned int		dbuf_mapped;
+	enum vb2_cache_state	cache_state;
 };
 
 /**
@@ -83,12 +130,14 @@ struct vb2_plane {
  * @VB2_USERPTR:	driver supports USERPTR with streaming API
  * @VB2_READ:		driver supports read() style access
  * @VB2_WRITE:		driver supports write() style access
+ * @VB2_DMABUF:		driver supports DMABUF with streaming API
  */
 enum vb2_io_modes {
 	VB2_MMAP	= (1 << 0),
 	VB2_USERPTR	= (1 << 1),
 	VB2_READ	= (1 << 2),
 	VB2_WRITE	= (1 << 3),
+	VB2_DMABUF	= (1 << 4),
 };
 
 /**
@@ -41,5 +41,10 @@ int vb2_mmap_pfn_range(struct vm_area_struct *vma, unsigned long paddr,
 struct vm_area_struct *vb2_get_vma(struct vm_area_struct *vma);
 void vb2_put_vma(struct vm_area_struct *vma);
 
+bool vb2_vma_is_cached(struct vm_area_struct *vma);
+void vb2_sync_contig_userptr(struct vm_area_struct *vma, unsigned long vaddr,
+			     dma_addr_t paddr, unsigned long size,
+			     enum dma_data_direction dir);
+
 
 #endif
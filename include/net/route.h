@@ -310,6 +310,35 @@ static inline int inet_iif(const struct sk_buff *skb)
 	return skb_rtable(skb)->rt_iif;
 }
 
+/* Remember the input route of @skb for early demux of the next packets. */
+static inline void inet_sk_rx_dst_set(struct sock *sk,
+				      const struct sk_buff *skb)
+{
+	struct dst_entry *dst = skb_dst(skb);
+
+	if (likely(ACCESS_ONCE(sk->sk_rx_dst) == dst) || !dst)
+		return;
+
+	dst_hold(dst);
+	dst_release(xchg(&sk->sk_rx_dst, dst));
+}
+
+/*
+ * Give @skb the input route remembered on @sk, if it is still valid and
+ * came in on the same device.  Called from early demux, under rcu.
+ */
+static inline bool inet_sk_rx_dst_use(struct sock *sk, struct sk_buff *skb)
+{
+	struct dst_entry *dst = ACCESS_ONCE(sk->sk_rx_dst);
+
+	if (!dst || !dst_check(dst, 0) ||
+	    ((struct rtable *)dst)->rt_iif != skb->dev->ifindex)
+		return false;
+
+	skb_dst_set_noref(skb, dst);
+	return true;
+}
+
 extern int sysctl_ip_default_ttl;
 
 static inline int ip4_dst_hoplimit(const struct dst_entry *dst)
@@ -325,6 +325,7 @@ extern void tcp_v4_err(struct sk_buff *skb, u32);
 
 extern void tcp_shutdown (struct sock *sk, int how);
 
+extern void tcp_v4_early_demux(struct sk_buff *skb);
 extern int tcp_v4_rcv(struct sk_buff *skb);
 
 extern struct inet_peer *tcp_v4_get_peer(struct sock *sk, bool *release_it);
@@ -1000,6 +1001,10 @@ extern void tcp_select_initial_window(int __space, __u32 mss,
 				      int wscale_ok, __u8 *rcv_wscale,
 				      __u32 init_rcv_wnd);
 
+/* Per device buffer sizes, net/ipv4/conf/<dev>/tcp_[rw]mem_{def,max} */
+extern void tcp_init_buffer_limits(struct sock *sk);
+extern void tcp_tune_account(struct sock *sk);
+
 static inline int tcp_win_from_space(int space)
 {
 	return sysctl_tcp_adv_win_scale<=0 ?
@@ -0,0 +1,47 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+/* prio is the kernel priority: 0..99 realtime, 100..139 nice -20..19 */
+TRACE_EVENT(binder_set_priority,
+
+	TP_PROTO(int proc, int thread, unsigned int old_policy, int old_prio,
+		 unsigned int new_policy, int new_prio, int desired_prio),
+
+	TP_ARGS(proc, thread, old_policy, old_prio, new_policy, new_prio,
+		desired_prio),
+
+	TP_STRUCT__entry(
+		__field(	int,		proc		)
+		__field(	int,		thread		)
+		__field(	unsigned int,	old_policy	)
+		__field(	int,		old_prio	)
+		__field(	unsigned int,	new_policy	)
+		__field(	int,		new_prio	)
+		__field(	int,		desired_prio	)
+	),
+
+	TP_fast_assign(
+		__entry->proc = proc;
+		__entry->thread = thread;
+		__entry->old_policy = old_policy;
+		__entry->old_prio = old_prio;
+		__entry->new_policy = new_policy;
+		__entry->new_prio = new_prio;
+		__entry->desired_prio = desired_prio;
+	),
+
+	TP_printk("proc=%d thread=%d old=%u:%d => new=%u:%d desired=%d",
+		  __entry->proc, __entry->thread, __entry->old_policy,
+		  __entry->old_prio, __entry->new_policy, __entry->new_prio,
+		  __entry->desired_prio)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
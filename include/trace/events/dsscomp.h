@@ -0,0 +1,92 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dsscomp
+
+#if !defined(_TRACE_DSSCOMP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DSSCOMP_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Life of a composition: @comp identifies it across the events, @mgr is
+ * the overlay manager it is queued on and @ovl_mask the overlays it uses.
+ */
+DECLARE_EVENT_CLASS(dsscomp,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask),
+
+	TP_ARGS(comp, mgr, ovl_mask),
+
+	TP_STRUCT__entry(
+		__field(	const void *,	comp		)
+		__field(	u32,		mgr		)
+		__field(	u32,		ovl_mask	)
+	),
+
+	TP_fast_assign(
+		__entry->comp = comp;
+		__entry->mgr = mgr;
+		__entry->ovl_mask = ovl_mask;
+	),
+
+	TP_printk("comp=%p mgr=%u ovl_mask=0x%x", __entry->comp,
+		  __entry->mgr, __entry->ovl_mask)
+);
+
+DEFINE_EVENT(dsscomp, dsscomp_setup,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask),
+
+	TP_ARGS(comp, mgr, ovl_mask)
+);
+
+DEFINE_EVENT(dsscomp, dsscomp_apply,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask),
+
+	TP_ARGS(comp, mgr, ovl_mask)
+);
+
+/* the composition was latched by the GO bit */
+DEFINE_EVENT(dsscomp, dsscomp_go,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask),
+
+	TP_ARGS(comp, mgr, ovl_mask)
+);
+
+/* first vsync the composition was on screen */
+DEFINE_EVENT(dsscomp, dsscomp_vsync,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask),
+
+	TP_ARGS(comp, mgr, ovl_mask)
+);
+
+TRACE_EVENT(dsscomp_release,
+
+	TP_PROTO(const void *comp, u32 mgr, u32 ovl_mask, u32 status),
+
+	TP_ARGS(comp, mgr, ovl_mask, status),
+
+	TP_STRUCT__entry(
+		__field(	const void *,	comp		)
+		__field(	u32,		mgr		)
+		__field(	u32,		ovl_mask	)
+		__field(	u32,		status		)
+	),
+
+	TP_fast_assign(
+		__entry->comp = comp;
+		__entry->mgr = mgr;
+		__entry->ovl_mask = ovl_mask;
+		__entry->status = status;
+	),
+
+	TP_printk("comp=%p mgr=%u ovl_mask=0x%x status=0x%x", __entry->comp,
+		  __entry->mgr, __entry->ovl_mask, __entry->status)
+);
+
+#endif /* _TRACE_DSSCOMP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,95 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dvfs
+
+#if !defined(_TRACE_DVFS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DVFS_H
+
+#include <linux/tracepoint.h>
+
+/* a voltage domain is moving from @old_uv to @new_uv */
+TRACE_EVENT(dvfs_voltage,
+
+	TP_PROTO(const char *domain, unsigned long old_uv,
+		 unsigned long new_uv),
+
+	TP_ARGS(domain, old_uv, new_uv),
+
+	TP_STRUCT__entry(
+		__string(	domain,		domain		)
+		__field(	unsigned long,	old_uv		)
+		__field(	unsigned long,	new_uv		)
+	),
+
+	TP_fast_assign(
+		__assign_str(domain, domain);
+		__entry->old_uv = old_uv;
+		__entry->new_uv = new_uv;
+	),
+
+	TP_printk("domain=%s old_uv=%lu new_uv=%lu", __get_str(domain),
+		  __entry->old_uv, __entry->new_uv)
+);
+
+/*
+ * a voltage transition of a domain settled: @done_us after it was issued
+ * the PMIC had the command, @total_us after it was issued it had slewed
+ */
+TRACE_EVENT(dvfs_voltage_settle,
+
+	TP_PROTO(const char *domain, unsigned long old_uv,
+		 unsigned long new_uv, s64 done_us, s64 total_us),
+
+	TP_ARGS(domain, old_uv, new_uv, done_us, total_us),
+
+	TP_STRUCT__entry(
+		__string(	domain,		domain		)
+		__field(	unsigned long,	old_uv		)
+		__field(	unsigned long,	new_uv		)
+		__field(	s64,		done_us		)
+		__field(	s64,		total_us	)
+	),
+
+	TP_fast_assign(
+		__assign_str(domain, domain);
+		__entry->old_uv = old_uv;
+		__entry->new_uv = new_uv;
+		__entry->done_us = done_us;
+		__entry->total_us = total_us;
+	),
+
+	TP_printk("domain=%s old_uv=%lu new_uv=%lu done_us=%lld total_us=%lld",
+		  __get_str(domain), __entry->old_uv, __entry->new_uv,
+		  __entry->done_us, __entry->total_us)
+);
+
+/* a device of a voltage domain was set from @old_hz to @new_hz */
+TRACE_EVENT(dvfs_frequency,
+
+	TP_PROTO(const char *domain, const char *dev, unsigned long old_hz,
+		 unsigned long new_hz),
+
+	TP_ARGS(domain, dev, old_hz, new_hz),
+
+	TP_STRUCT__entry(
+		__string(	domain,		domain		)
+		__string(	dev,		dev		)
+		__field(	unsigned long,	old_hz		)
+		__field(	unsigned long,	new_hz		)
+	),
+
+	TP_fast_assign(
+		__assign_str(domain, domain);
+		__assign_str(dev, dev);
+		__entry->old_hz = old_hz;
+		__entry->new_hz = new_hz;
+	),
+
+	TP_printk("domain=%s dev=%s old_hz=%lu new_hz=%lu",
+		  __get_str(domain), __get_str(dev), __entry->old_hz,
+		  __entry->new_hz)
+);
+
+#endif /* _TRACE_DVFS_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,59 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gcx
+
+#if !defined(_TRACE_GCX_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_GCX_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * A command buffer was queued to the GPU. @interrupt is the signal raised
+ * when the GPU is done with it, ~0 if it has none.
+ */
+TRACE_EVENT(gcx_submit,
+
+	TP_PROTO(u32 physical, u32 size, u32 interrupt, bool asynchronous),
+
+	TP_ARGS(physical, size, interrupt, asynchronous),
+
+	TP_STRUCT__entry(
+		__field(	u32,		physical	)
+		__field(	u32,		size		)
+		__field(	u32,		interrupt	)
+		__field(	bool,		asynchronous	)
+	),
+
+	TP_fast_assign(
+		__entry->physical = physical;
+		__entry->size = size;
+		__entry->interrupt = interrupt;
+		__entry->asynchronous = asynchronous;
+	),
+
+	TP_printk("physical=0x%08x size=%u interrupt=%d async=%d",
+		  __entry->physical, __entry->size, (int)__entry->interrupt,
+		  __entry->asynchronous)
+);
+
+/* the GPU raised the signals in @triggered */
+TRACE_EVENT(gcx_complete,
+
+	TP_PROTO(u32 triggered),
+
+	TP_ARGS(triggered),
+
+	TP_STRUCT__entry(
+		__field(	u32,		triggered	)
+	),
+
+	TP_fast_assign(
+		__entry->triggered = triggered;
+	),
+
+	TP_printk("triggered=0x%08x", __entry->triggered)
+);
+
+#endif /* _TRACE_GCX_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,37 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM input
+
+#if !defined(_TRACE_INPUT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_INPUT_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * An event frame (up to EV_SYN/SYN_REPORT) handed to the evdev clients.
+ * @latency_us is the time since the driver's input_set_timestamp(), i.e.
+ * the touch to evdev latency, or 0 if the device was not timestamped.
+ */
+TRACE_EVENT(input_frame,
+
+	TP_PROTO(const char *name, s64 latency_us),
+
+	TP_ARGS(name, latency_us),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	s64,		latency_us	)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("dev=%s latency_us=%lld", __get_str(name),
+		  __entry->latency_us)
+);
+
+#endif /* _TRACE_INPUT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,71 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ion
+
+#if !defined(_TRACE_ION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ION_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(ion_buffer,
+
+	TP_PROTO(const char *heap, const void *buffer, size_t len),
+
+	TP_ARGS(heap, buffer, len),
+
+	TP_STRUCT__entry(
+		__string(	heap,		heap		)
+		__field(	const void *,	buffer		)
+		__field(	size_t,		len		)
+	),
+
+	TP_fast_assign(
+		__assign_str(heap, heap);
+		__entry->buffer = buffer;
+		__entry->len = len;
+	),
+
+	TP_printk("heap=%s buffer=%p len=%zu", __get_str(heap),
+		  __entry->buffer, __entry->len)
+);
+
+DEFINE_EVENT(ion_buffer, ion_alloc_buffer,
+
+	TP_PROTO(const char *heap, const void *buffer, size_t len),
+
+	TP_ARGS(heap, buffer, len)
+);
+
+/* the last reference to the buffer is gone */
+DEFINE_EVENT(ion_buffer, ion_free_buffer,
+
+	TP_PROTO(const char *heap, const void *buffer, size_t len),
+
+	TP_ARGS(heap, buffer, len)
+);
+
+TRACE_EVENT(ion_alloc_fail,
+
+	TP_PROTO(size_t len, unsigned int flags, long error),
+
+	TP_ARGS(len, flags, error),
+
+	TP_STRUCT__entry(
+		__field(	size_t,		len		)
+		__field(	unsigned int,	flags		)
+		__field(	long,		error		)
+	),
+
+	TP_fast_assign(
+		__entry->len = len;
+		__entry->flags = flags;
+		__entry->error = error;
+	),
+
+	TP_printk("len=%zu flags=0x%x error=%ld", __entry->len,
+		  __entry->flags, __entry->error)
+);
+
+#endif /* _TRACE_ION_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
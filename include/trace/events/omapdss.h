@@ -0,0 +1,54 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM omapdss
+
+#if !defined(_TRACE_OMAPDSS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_OMAPDSS_H
+
+#include <linux/tracepoint.h>
+#include <video/omapdss.h>
+
+DECLARE_EVENT_CLASS(dispc_error,
+
+	TP_PROTO(u32 irqstatus),
+
+	TP_ARGS(irqstatus),
+
+	TP_STRUCT__entry(
+		__field(	u32,		irqstatus	)
+	),
+
+	TP_fast_assign(
+		__entry->irqstatus = irqstatus;
+	),
+
+	TP_printk("irqstatus=0x%08x %s", __entry->irqstatus,
+		  __print_flags(__entry->irqstatus, "|",
+			{ DISPC_IRQ_GFX_FIFO_UNDERFLOW,	"gfx" },
+			{ DISPC_IRQ_VID1_FIFO_UNDERFLOW, "vid1" },
+			{ DISPC_IRQ_VID2_FIFO_UNDERFLOW, "vid2" },
+			{ DISPC_IRQ_VID3_FIFO_UNDERFLOW, "vid3" },
+			{ DISPC_IRQ_SYNC_LOST,		"lcd" },
+			{ DISPC_IRQ_SYNC_LOST_DIGIT,	"digit" },
+			{ DISPC_IRQ_SYNC_LOST2,		"lcd2" }))
+);
+
+/* @irqstatus holds the overlays whose FIFO underflowed */
+DEFINE_EVENT(dispc_error, dispc_fifo_underflow,
+
+	TP_PROTO(u32 irqstatus),
+
+	TP_ARGS(irqstatus)
+);
+
+/* @irqstatus holds the channels that lost sync */
+DEFINE_EVENT(dispc_error, dispc_sync_lost,
+
+	TP_PROTO(u32 irqstatus),
+
+	TP_ARGS(irqstatus)
+);
+
+#endif /* _TRACE_OMAPDSS_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -254,6 +254,70 @@ DEFINE_EVENT(power_domain, power_domain_target,
 
 	TP_ARGS(name, state, cpu_id)
 );
+
+/* a power domain was found to have gone through @state */
+DEFINE_EVENT(power_domain, power_domain_state,
+
+	TP_PROTO(const char *name, unsigned int state, unsigned int cpu_id),
+
+	TP_ARGS(name, state, cpu_id)
+);
+
+/* hardware supervised idle of a clock domain allowed (1) or denied (0) */
+DEFINE_EVENT(power_domain, clock_domain_idle,
+
+	TP_PROTO(const char *name, unsigned int state, unsigned int cpu_id),
+
+	TP_ARGS(name, state, cpu_id)
+);
+
+/*
+ * A power domain woke up from a shallower state than it was programmed
+ * for.  With clock_domain_usecount this tells which module kept it up.
+ */
+TRACE_EVENT(power_domain_missed,
+
+	TP_PROTO(const char *name, unsigned int target, unsigned int reached),
+
+	TP_ARGS(name, target, reached),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	u32,		target		)
+		__field(	u32,		reached		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->target = target;
+		__entry->reached = reached;
+	),
+
+	TP_printk("%s target=%u reached=%u", __get_str(name),
+		  __entry->target, __entry->reached)
+);
+
+TRACE_EVENT(clock_domain_usecount,
+
+	TP_PROTO(const char *name, const char *user, int usecount),
+
+	TP_ARGS(name, user, usecount),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__string(	user,		user		)
+		__field(	int,		usecount	)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__assign_str(user, user);
+		__entry->usecount = usecount;
+	),
+
+	TP_printk("%s user=%s usecount=%d", __get_str(name),
+		  __get_str(user), __entry->usecount)
+);
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
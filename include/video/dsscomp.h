@@ -399,6 +399,7 @@ enum omapdss_buffer_addressing_type {
 	OMAP_DSS_BUFADDR_OVL_IX,	/* using a prior overlay */
 	OMAP_DSS_BUFADDR_LAYER_IX,	/* using a Post2 layer */
 	OMAP_DSS_BUFADDR_FB,		/* using framebuffer memory */
+	OMAP_DSS_BUFADDR_DMABUF,	/* using a dma-buf fd, uv is offset */
 };
 
 struct dss2_ovl_info {
@@ -604,6 +605,53 @@ struct dsscomp_wb_copy_data {
 	struct dss2_ovl_info ovl, wb;
 };
 
+/*
+ * ioctl: DSSCIOC_WB_COMPOSE, struct dsscomp_wb_compose_data
+ *
+ * Composes layers that do not fit on the overlays of a display through the
+ * WB pipeline, instead of on the GPU.  The layers in wb_ovls are composed
+ * on the manager of display wb_mgr.ix in mem-to-mem mode into the buffer
+ * described by wb.  This call blocks until that frame is written, then
+ * queues dispc, which is expected to show the buffer as one of its layers.
+ *
+ * Requirements:
+ *	wb.cfg.ix must be OMAP_DSS_WB.
+ *	wb_mgr.ix must not be an active display.
+ *	the overlays in wb_ovls must not be used by any other display.
+ *	dispc.sync_id must increase with every call.
+ *
+ * Returns 0 on success, and the time taken by the WB pass in wb_time_us.
+ * Returns -EBUSY if the WB manager or the overlays are in use.
+ */
+struct dsscomp_wb_compose_data {
+	struct dss2_mgr_info wb_mgr;	/* manager composing the wb_ovls */
+	struct dss2_ovl_info wb;	/* intermediate buffer */
+	__u16 num_wb_ovls;
+	struct dss2_ovl_info wb_ovls[4];
+	struct dsscomp_setup_dispc_data dispc;	/* composition to display */
+	__u32 wb_time_us;		/* out: WB pass duration */
+};
+
+/*
+ * ioctl: DSSCIOC_QUEUE_FENCED, struct dsscomp_fenced_dispc_data
+ *
+ * Queues dispc like DSSCIOC_SETUP_DISPC, but without waiting for the
+ * buffers to be rendered.  acquire_fd is a sync fence, such as a gcx blit
+ * fence or several fences merged into one, after which the composition is
+ * applied; or -1 to apply it right away.  The fence is not consumed.
+ *
+ * On success, release_fd is set to a sync fence that is signaled once the
+ * buffers of this and all earlier compositions are no longer scanned out,
+ * or to -1 if no fence could be created.
+ *
+ * Returns 0 on success, non-0 error value on failure.
+ */
+struct dsscomp_fenced_dispc_data {
+	__s32 acquire_fd;	/* in: fence to wait for, or -1 */
+	__s32 release_fd;	/* out: fence signaled on release, or -1 */
+	struct dsscomp_setup_dispc_data dispc;
+};
+
 /*
  * ioctl: DSSCIOC_QUERY_DISPLAY, struct dsscomp_display_info
  *
@@ -734,4 +782,7 @@ struct dsscomp_platform_info {
 
 /*HACK: used as temporary solution to wait for writeback frame to complete */
 #define DSSCIOC_WB_DONE		_IOW('O', 136, __u32)
+#define DSSCIOC_WB_COMPOSE	_IOWR('O', 137, struct dsscomp_wb_compose_data)
+#define DSSCIOC_QUEUE_FENCED	\
+			_IOWR('O', 138, struct dsscomp_fenced_dispc_data)
 #endif
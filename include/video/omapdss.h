@@ -320,6 +320,10 @@ struct omap_dss_dsi_videomode_data {
 
 	bool ddr_clk_always_on;
 	int window_sync;
+
+	/* send the active line at the full HS rate and go to LP for the
+	 * rest of the line, if the panel supports burst mode */
+	bool burst_mode;
 };
 
 void dsi_bus_lock(struct omap_dss_device *dssdev);
@@ -358,6 +362,7 @@ void dsi_disable_video_output(struct omap_dss_device *dssdev, int channel);
 /* Board specific data */
 struct omap_dss_board_info {
 	int (*get_context_loss_count)(struct device *dev);
+	bool (*context_lost)(struct device *dev);
 	int num_devices;
 	struct omap_dss_device **devices;
 	struct omap_dss_device *default_device;
@@ -919,7 +924,10 @@ void omapdss_dsi_vc_enable_hs(struct omap_dss_device *dssdev, int channel,
 		bool enable);
 int omapdss_dsi_enable_te(struct omap_dss_device *dssdev, bool enable);
 
+int omap_dsi_prepare_update(struct omap_dss_device *dssdev,
+		u16 *x, u16 *y, u16 *w, u16 *h);
 int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
+		u16 x, u16 y, u16 w, u16 h,
 		void (*callback)(int, void *), void *data);
 int omap_dsi_request_vc(struct omap_dss_device *dssdev, int *channel);
 int omap_dsi_set_vc_id(struct omap_dss_device *dssdev, int channel, int vc_id);
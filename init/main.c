@@ -68,6 +68,9 @@
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -653,9 +656,57 @@ static void __init do_ctors(void)
 bool initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
-static char msgbuf[64];
+/*
+ * With initcall_timeline every initcall, async, deferred and module init
+ * call is recorded and the result is reported in /proc/initcall_timeline.
+ */
+static bool initcall_timeline;
+core_param(initcall_timeline, initcall_timeline, bool, 0444);
+
+#define INITCALL_TIMELINE_MAX	2048
+
+#define INITCALL_ASYNC		0x1
+#define INITCALL_DEFERRED	0x2
 
-static int __init_or_module do_one_initcall_debug(initcall_t fn)
+/* Levels are stored offset by one: 0 is early, 9 anything after boot */
+#define INITCALL_LEVEL_EARLY	(-1)
+#define INITCALL_LEVEL_POST	8
+
+struct initcall_record {
+	initcall_t fn;
+	s64 start_us;
+	u32 duration_us;
+	int ret;
+	u8 level;
+	u8 flags;
+};
+
+static struct initcall_record *initcall_records;
+static atomic_t initcall_nr_records;
+static int initcall_cur_level = INITCALL_LEVEL_EARLY;
+
+static void initcall_record(initcall_t fn, ktime_t start, ktime_t end,
+			    int ret, int flags)
+{
+	struct initcall_record *rec;
+	int i;
+
+	i = atomic_inc_return(&initcall_nr_records) - 1;
+	if (i >= INITCALL_TIMELINE_MAX)
+		return;
+
+	rec = &initcall_records[i];
+	rec->start_us = ktime_to_us(start);
+	rec->duration_us = ktime_us_delta(end, start);
+	rec->ret = ret;
+	rec->level = initcall_cur_level + 1;
+	rec->flags = flags;
+	/* readers skip records whose fn is not set yet */
+	smp_wmb();
+	rec->fn = fn;
+}
+
+static int do_one_initcall_debug(initcall_t fn)
 {
 	ktime_t calltime, delta, rettime;
 	unsigned long long duration;
@@ -673,16 +724,30 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	return ret;
 }
 
-int __init_or_module do_one_initcall(initcall_t fn)
+/*
+ * Not __init_or_module: deferred initcalls come through here after init
+ * memory has been freed.
+ */
+static int __do_one_initcall(initcall_t fn, int flags)
 {
 	int count = preempt_count();
+	ktime_t start = ktime_set(0, 0), end;
+	char msgbuf[64];
 	int ret;
 
+	if (initcall_records)
+		start = ktime_get();
+
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
 	else
 		ret = fn();
 
+	if (initcall_records) {
+		end = ktime_get();
+		initcall_record(fn, start, end, ret, flags);
+	}
+
 	msgbuf[0] = 0;
 
 	if (ret && ret != -ENODEV && initcall_debug)
@@ -703,6 +768,176 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	return ret;
 }
 
+int __init_or_module do_one_initcall(initcall_t fn)
+{
+	return __do_one_initcall(fn, 0);
+}
+
+static LIST_HEAD(initcall_async_domain);
+
+static void __init async_initcall_run(void *data, async_cookie_t cookie)
+{
+	__do_one_initcall((initcall_t)data, INITCALL_ASYNC);
+}
+
+/* Called by the stubs device_initcall_async() and friends generate */
+int __init async_initcall_schedule(initcall_t fn)
+{
+	async_schedule_domain(async_initcall_run, (void *)fn,
+			      &initcall_async_domain);
+	return 0;
+}
+
+static struct deferred_initcall *deferred_initcalls;
+static struct deferred_initcall **deferred_initcalls_tail =
+	&deferred_initcalls;
+static DEFINE_MUTEX(deferred_initcalls_lock);
+static bool deferred_initcalls_done;
+
+static unsigned int deferred_initcall_delay = 30;
+core_param(deferred_initcall_delay, deferred_initcall_delay, uint, 0644);
+
+void __init deferred_initcall_add(struct deferred_initcall *call)
+{
+	call->next = NULL;
+	*deferred_initcalls_tail = call;
+	deferred_initcalls_tail = &call->next;
+}
+
+/* Run the deferred initcalls, in link order; only the first call does */
+void run_deferred_initcalls(void)
+{
+	struct deferred_initcall *call;
+
+	mutex_lock(&deferred_initcalls_lock);
+	if (!deferred_initcalls_done) {
+		deferred_initcalls_done = true;
+		for (call = deferred_initcalls; call; call = call->next)
+			__do_one_initcall(call->fn, INITCALL_DEFERRED);
+	}
+	mutex_unlock(&deferred_initcalls_lock);
+}
+
+static void deferred_initcalls_timeout(struct work_struct *work)
+{
+	run_deferred_initcalls();
+}
+
+static DECLARE_DELAYED_WORK(deferred_initcalls_work,
+			    deferred_initcalls_timeout);
+
+static int deferred_initcalls_show(struct seq_file *s, void *unused)
+{
+	struct deferred_initcall *call;
+
+	mutex_lock(&deferred_initcalls_lock);
+	seq_printf(s, "%s\n", deferred_initcalls_done ? "done" : "pending");
+	for (call = deferred_initcalls; call; call = call->next)
+		seq_printf(s, "%pF\n", call->fn);
+	mutex_unlock(&deferred_initcalls_lock);
+
+	return 0;
+}
+
+static int deferred_initcalls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, deferred_initcalls_show, NULL);
+}
+
+/* Any write from userspace, e.g. once the first frame is up, runs them */
+static ssize_t deferred_initcalls_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	cancel_delayed_work_sync(&deferred_initcalls_work);
+	run_deferred_initcalls();
+	return count;
+}
+
+static const struct file_operations deferred_initcalls_fops = {
+	.open		= deferred_initcalls_open,
+	.read		= seq_read,
+	.write		= deferred_initcalls_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const char *const initcall_timeline_levels[] = {
+	"early", "pure", "core", "postcore", "arch",
+	"subsys", "fs", "device", "late", "post",
+};
+
+static void *initcall_timeline_start(struct seq_file *s, loff_t *pos)
+{
+	int nr = min(atomic_read(&initcall_nr_records), INITCALL_TIMELINE_MAX);
+
+	if (*pos == 0) {
+		seq_printf(s, "%10s %10s %-8s %-5s %5s %s\n", "start_us",
+			   "usecs", "level", "flags", "ret", "function");
+	}
+	return *pos < nr ? &initcall_records[*pos] : NULL;
+}
+
+static void *initcall_timeline_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	int nr = min(atomic_read(&initcall_nr_records), INITCALL_TIMELINE_MAX);
+
+	++*pos;
+	return *pos < nr ? &initcall_records[*pos] : NULL;
+}
+
+static void initcall_timeline_stop(struct seq_file *s, void *v)
+{
+}
+
+static int initcall_timeline_show(struct seq_file *s, void *v)
+{
+	struct initcall_record *rec = v;
+	initcall_t fn = ACCESS_ONCE(rec->fn);
+
+	if (!fn)
+		return 0;
+	smp_rmb();
+
+	seq_printf(s, "%10lld %10u %-8s %-5s %5d %pF\n", rec->start_us,
+		   rec->duration_us, initcall_timeline_levels[rec->level],
+		   rec->flags & INITCALL_ASYNC ? "async" :
+		   rec->flags & INITCALL_DEFERRED ? "defer" : "-",
+		   rec->ret, fn);
+
+	return 0;
+}
+
+static const struct seq_operations initcall_timeline_sops = {
+	.start	= initcall_timeline_start,
+	.next	= initcall_timeline_next,
+	.stop	= initcall_timeline_stop,
+	.show	= initcall_timeline_show,
+};
+
+static int initcall_timeline_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &initcall_timeline_sops);
+}
+
+static const struct file_operations initcall_timeline_fops = {
+	.open		= initcall_timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init initcall_proc_init(void)
+{
+	if (deferred_initcalls)
+		proc_create("deferred_initcalls", S_IRUGO | S_IWUSR, NULL,
+			    &deferred_initcalls_fops);
+	if (initcall_records)
+		proc_create("initcall_timeline", S_IRUGO, NULL,
+			    &initcall_timeline_fops);
+	return 0;
+}
+late_initcall_sync(initcall_proc_init);
 
 extern initcall_t __initcall_start[];
 extern initcall_t __initcall0_start[];
@@ -750,16 +985,31 @@ static void __init do_initcall_level(int level)
 		   level, level,
 		   repair_env_string);
 
+	initcall_cur_level = level;
 	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
 		do_one_initcall(*fn);
+
+	/* async initcalls of this level must be done before the next one */
+	async_synchronize_full_domain(&initcall_async_domain);
 }
 
 static void __init do_initcalls(void)
 {
 	int level;
 
-	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++)
+	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++) {
+		ktime_t start = ktime_get();
+
 		do_initcall_level(level);
+		if (initcall_records)
+			pr_info("initcall level %d done after %lld usecs\n",
+				level, ktime_us_delta(ktime_get(), start));
+	}
+	initcall_cur_level = INITCALL_LEVEL_POST;
+
+	if (deferred_initcalls)
+		schedule_delayed_work(&deferred_initcalls_work,
+				      deferred_initcall_delay * HZ);
 }
 
 /*
@@ -785,6 +1035,11 @@ static void __init do_pre_smp_initcalls(void)
 {
 	initcall_t *fn;
 
+	if (initcall_timeline)
+		initcall_records = kcalloc(INITCALL_TIMELINE_MAX,
+					   sizeof(*initcall_records),
+					   GFP_KERNEL);
+
 	for (fn = __initcall_start; fn < __initcall0_start; fn++)
 		do_one_initcall(*fn);
 }
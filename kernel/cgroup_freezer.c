@@ -21,6 +21,11 @@
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <asm/tlbflush.h>
 
 enum freezer_state {
 	CGROUP_THAWED = 0,
@@ -31,7 +36,21 @@ enum freezer_state {
 struct freezer {
 	struct cgroup_subsys_state css;
 	enum freezer_state state;
-	spinlock_t lock; /* protects _writes_ to state */
+	spinlock_t lock; /* protects _writes_ to state and the stats */
+
+	/* age the anonymous memory of the tasks once they are frozen */
+	bool age_memory;
+	struct work_struct age_work;
+
+	/* freezer.stats, latencies in usecs */
+	ktime_t freeze_start;
+	u64 nr_freeze;
+	u64 nr_thaw;
+	u64 last_freeze_us;
+	u64 max_freeze_us;
+	u64 last_thaw_us;
+	u64 max_thaw_us;
+	u64 aged_pages;
 };
 
 static inline struct freezer *cgroup_freezer(
@@ -122,12 +141,22 @@ struct cgroup_subsys freezer_subsys;
  * freezer_write() (unfreeze):
  * cgroup_mutex
  *  freezer->lock
- *   write_lock css_set_lock (cgroup iterator start)
- *    task->alloc_lock
  *   read_lock css_set_lock (cgroup iterator start)
  *    task->alloc_lock (inside __thaw_task(), prevents race with refrigerator())
  *     sighand->siglock
+ *
+ * cgroup_freezer_frozen() (a task entered the refrigerator):
+ * freezer->lock
+ *  write_lock css_set_lock (cgroup iterator start)
+ *   task->alloc_lock
+ *  read_lock css_set_lock (cgroup iterator start)
+ *
+ * freezer_age_work():
+ * read_lock css_set_lock (cgroup_scan_tasks)
+ * mm->mmap_sem (tasks are processed with css_set_lock dropped)
  */
+static void freezer_age_work(struct work_struct *work);
+
 static struct cgroup_subsys_state *freezer_create(struct cgroup *cgroup)
 {
 	struct freezer *freezer;
@@ -137,6 +166,7 @@ static struct cgroup_subsys_state *freezer_create(struct cgroup *cgroup)
 		return ERR_PTR(-ENOMEM);
 
 	spin_lock_init(&freezer->lock);
+	INIT_WORK(&freezer->age_work, freezer_age_work);
 	freezer->state = CGROUP_THAWED;
 	return &freezer->css;
 }
@@ -145,6 +175,7 @@ static void freezer_destroy(struct cgroup *cgroup)
 {
 	struct freezer *freezer = cgroup_freezer(cgroup);
 
+	cancel_work_sync(&freezer->age_work);
 	if (freezer->state != CGROUP_THAWED)
 		atomic_dec(&system_freezing_cnt);
 	kfree(freezer);
@@ -234,8 +265,15 @@ static void update_if_frozen(struct cgroup *cgroup,
 	if (old_state == CGROUP_THAWED) {
 		BUG_ON(nfrozen > 0);
 	} else if (old_state == CGROUP_FREEZING) {
-		if (nfrozen == ntotal)
+		if (nfrozen == ntotal) {
+			u64 us = ktime_us_delta(ktime_get(),
+						freezer->freeze_start);
+
 			freezer->state = CGROUP_FROZEN;
+			freezer->last_freeze_us = us;
+			if (us > freezer->max_freeze_us)
+				freezer->max_freeze_us = us;
+		}
 	} else { /* old_state == CGROUP_FROZEN */
 		BUG_ON(nfrozen != ntotal);
 	}
@@ -243,6 +281,134 @@ static void update_if_frozen(struct cgroup *cgroup,
 	cgroup_iter_end(cgroup, &it);
 }
 
+/**
+ * cgroup_freezer_frozen - a task has just entered the refrigerator
+ * @task: the task, always current
+ *
+ * The last task of a freezing cgroup to get there completes the transition
+ * to FROZEN, so the state and the freeze latency are up to date without
+ * waiting for the next read of freezer.state.
+ */
+void cgroup_freezer_frozen(struct task_struct *task)
+{
+	struct freezer *freezer;
+	unsigned long flags;
+
+	/* the task can't leave a freezing cgroup, see freezer_can_attach() */
+	rcu_read_lock();
+	freezer = task_freezer(task);
+	rcu_read_unlock();
+
+	if (!freezer->css.cgroup->parent ||
+	    freezer->state != CGROUP_FREEZING)
+		return;
+
+	spin_lock_irqsave(&freezer->lock, flags);
+	if (freezer->state == CGROUP_FREEZING)
+		update_if_frozen(freezer->css.cgroup, freezer);
+	spin_unlock_irqrestore(&freezer->lock, flags);
+}
+
+/*
+ * Clear the accessed bits of the anonymous pages, like clear_refs does, so
+ * that reclaim finds the frozen tasks' memory cold and swaps it out before
+ * the memory of the running ones.
+ */
+struct freezer_age {
+	struct vm_area_struct *vma;
+	unsigned long aged;
+};
+
+static int freezer_age_pte_range(pmd_t *pmd, unsigned long addr,
+				 unsigned long end, struct mm_walk *walk)
+{
+	struct freezer_age *age = walk->private;
+	struct vm_area_struct *vma = age->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+
+	split_huge_page_pmd(walk->mm, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || !PageAnon(page))
+			continue;
+
+		ptep_test_and_clear_young(vma, addr, pte);
+		ClearPageReferenced(page);
+		age->aged++;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	cond_resched();
+	return 0;
+}
+
+static unsigned long freezer_age_mm(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct freezer_age age = { .aged = 0 };
+	struct mm_walk age_walk = {
+		.pmd_entry = freezer_age_pte_range,
+		.mm = mm,
+		.private = &age,
+	};
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_file || is_vm_hugetlb_page(vma))
+			continue;
+		age.vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &age_walk);
+	}
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+
+	return age.aged;
+}
+
+static void freezer_age_task(struct task_struct *task,
+			     struct cgroup_scanner *scan)
+{
+	struct freezer *freezer = scan->data;
+	struct mm_struct *mm;
+	unsigned long aged;
+
+	/* threads share the mm of their leader */
+	if (!thread_group_leader(task) || freezer->state == CGROUP_THAWED)
+		return;
+
+	mm = get_task_mm(task);
+	if (!mm)
+		return;
+
+	aged = freezer_age_mm(mm);
+	mmput(mm);
+
+	spin_lock_irq(&freezer->lock);
+	freezer->aged_pages += aged;
+	spin_unlock_irq(&freezer->lock);
+}
+
+static void freezer_age_work(struct work_struct *work)
+{
+	struct freezer *freezer = container_of(work, struct freezer, age_work);
+	struct cgroup_scanner scan = {
+		.cg = freezer->css.cgroup,
+		.process_task = freezer_age_task,
+		.data = freezer,
+	};
+
+	cgroup_scan_tasks(&scan);
+}
+
 static int freezer_read(struct cgroup *cgroup, struct cftype *cft,
 			struct seq_file *m)
 {
@@ -310,20 +476,39 @@ static int freezer_change_state(struct cgroup *cgroup,
 
 	spin_lock_irq(&freezer->lock);
 
-	update_if_frozen(cgroup, freezer);
-
 	switch (goal_state) {
 	case CGROUP_THAWED:
-		if (freezer->state != CGROUP_THAWED)
+		/*
+		 * Thawing only wakes up the tasks, there is no need to walk
+		 * the cgroup for its current state first.
+		 */
+		if (freezer->state != CGROUP_THAWED) {
+			ktime_t start = ktime_get();
+			u64 us;
+
 			atomic_dec(&system_freezing_cnt);
-		freezer->state = CGROUP_THAWED;
-		unfreeze_cgroup(cgroup, freezer);
+			freezer->state = CGROUP_THAWED;
+			unfreeze_cgroup(cgroup, freezer);
+
+			us = ktime_us_delta(ktime_get(), start);
+			freezer->nr_thaw++;
+			freezer->last_thaw_us = us;
+			if (us > freezer->max_thaw_us)
+				freezer->max_thaw_us = us;
+		}
 		break;
 	case CGROUP_FROZEN:
-		if (freezer->state == CGROUP_THAWED)
+		update_if_frozen(cgroup, freezer);
+		if (freezer->state == CGROUP_THAWED) {
 			atomic_inc(&system_freezing_cnt);
-		freezer->state = CGROUP_FREEZING;
-		retval = try_to_freeze_cgroup(cgroup, freezer);
+			freezer->freeze_start = ktime_get();
+			freezer->nr_freeze++;
+			freezer->state = CGROUP_FREEZING;
+			if (freezer->age_memory)
+				schedule_work(&freezer->age_work);
+		}
+		if (freezer->state == CGROUP_FREEZING)
+			retval = try_to_freeze_cgroup(cgroup, freezer);
 		break;
 	default:
 		BUG();
@@ -355,12 +540,62 @@ static int freezer_write(struct cgroup *cgroup,
 	return retval;
 }
 
+static int freezer_stats_read(struct cgroup *cgroup, struct cftype *cft,
+			      struct cgroup_map_cb *cb)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	u64 stats[7];
+
+	spin_lock_irq(&freezer->lock);
+	stats[0] = freezer->nr_freeze;
+	stats[1] = freezer->nr_thaw;
+	stats[2] = freezer->last_freeze_us;
+	stats[3] = freezer->max_freeze_us;
+	stats[4] = freezer->last_thaw_us;
+	stats[5] = freezer->max_thaw_us;
+	stats[6] = freezer->aged_pages;
+	spin_unlock_irq(&freezer->lock);
+
+	cb->fill(cb, "freeze_count", stats[0]);
+	cb->fill(cb, "thaw_count", stats[1]);
+	cb->fill(cb, "last_freeze_us", stats[2]);
+	cb->fill(cb, "max_freeze_us", stats[3]);
+	cb->fill(cb, "last_thaw_us", stats[4]);
+	cb->fill(cb, "max_thaw_us", stats[5]);
+	cb->fill(cb, "aged_pages", stats[6]);
+	return 0;
+}
+
+static u64 freezer_age_memory_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_freezer(cgroup)->age_memory;
+}
+
+static int freezer_age_memory_write(struct cgroup *cgroup, struct cftype *cft,
+				    u64 val)
+{
+	if (val > 1)
+		return -EINVAL;
+
+	cgroup_freezer(cgroup)->age_memory = val;
+	return 0;
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
 	},
+	{
+		.name = "stats",
+		.read_map = freezer_stats_read,
+	},
+	{
+		.name = "age_memory",
+		.read_u64 = freezer_age_memory_read,
+		.write_u64 = freezer_age_memory_write,
+	},
 };
 
 static int freezer_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
@@ -53,6 +53,7 @@
 #include <linux/oom.h>
 #include <linux/writeback.h>
 #include <linux/shm.h>
+#include <linux/cpufreq_energy.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -134,6 +135,9 @@ static void __exit_signal(struct task_struct *tsk)
 		sig->oublock += task_io_get_oublock(tsk);
 		task_io_accounting_add(&sig->ioac, &tsk->ioac);
 		sig->sum_sched_runtime += tsk->se.sum_exec_runtime;
+#ifdef CONFIG_CPU_FREQ_ENERGY
+		sig->cpu_energy += tsk->cpu_energy;
+#endif
 	}
 
 	sig->nr_threads--;
@@ -176,6 +180,8 @@ repeat:
 	atomic_dec(&__task_cred(p)->user->processes);
 	rcu_read_unlock();
 
+	cpufreq_energy_task_release(p);
+
 	proc_flush_task(p);
 
 	write_lock_irq(&tasklist_lock);
@@ -969,6 +975,7 @@ void do_exit(long code)
 		exit_itimers(tsk->signal);
 		if (tsk->mm)
 			setmax_mm_hiwater_rss(&tsk->signal->maxrss, tsk->mm);
+		lowmem_adj_index_del(tsk->signal);
 	}
 	acct_collect(code, group_dead);
 	if (group_dead)
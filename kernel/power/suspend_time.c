@@ -15,16 +15,133 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/device.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+/*
+ * The devices that took longest in their resume callback, slowest first.
+ * Async resume makes the devices report concurrently, hence the lock.
+ */
+#define SLOW_RESUME_DEVS	8
+
+struct slow_resume_dev {
+	char	name[24];
+	s64	usecs;
+};
+
+static struct slow_resume_dev slow_resume[SLOW_RESUME_DEVS];
+static struct slow_resume_dev slow_resume_last[SLOW_RESUME_DEVS];
+static s64 resume_usecs_total, resume_usecs_last;
+static unsigned int resume_devs, resume_devs_last;
+static DEFINE_SPINLOCK(slow_resume_lock);
+
+/*
+ * Aborted suspend attempts: who is blamed for them, most frequent first
+ * wins a slot, and how long the attempts ran before being abandoned.
+ * Reported from any context, a wake lock may be taken from irq.
+ */
+#define ABORT_SOURCES		8
+
+struct abort_source {
+	char		name[24];
+	unsigned int	count;
+};
+
+static struct abort_source abort_sources[ABORT_SOURCES];
+static unsigned int abort_msecs_bins[32];
+static unsigned int aborts, backoffs, backoff_msecs_last;
+static DEFINE_SPINLOCK(abort_lock);
+
+void suspend_time_aborted(const char *source, ktime_t start)
+{
+	s64 msecs = ktime_to_ms(ktime_sub(ktime_get(), start));
+	struct abort_source *slot = NULL;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&abort_lock, flags);
+	aborts++;
+	abort_msecs_bins[fls(min_t(s64, msecs, INT_MAX))]++;
+	for (i = 0; i < ABORT_SOURCES; i++) {
+		if (!strncmp(abort_sources[i].name, source,
+			     sizeof(abort_sources[i].name) - 1)) {
+			slot = &abort_sources[i];
+			break;
+		}
+		/* a new source replaces the least frequent one */
+		if (!slot || abort_sources[i].count < slot->count)
+			slot = &abort_sources[i];
+	}
+	if (i == ABORT_SOURCES) {
+		strlcpy(slot->name, source, sizeof(slot->name));
+		slot->count = 0;
+	}
+	slot->count++;
+	spin_unlock_irqrestore(&abort_lock, flags);
+}
+
+void suspend_time_backoff(unsigned int msecs)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&abort_lock, flags);
+	backoffs++;
+	backoff_msecs_last = msecs;
+	spin_unlock_irqrestore(&abort_lock, flags);
+}
+
+void suspend_time_device_resumed(struct device *dev, ktime_t start)
+{
+	s64 usecs = ktime_to_us(ktime_sub(ktime_get(), start));
+	int i;
+
+	spin_lock(&slow_resume_lock);
+	resume_usecs_total += usecs;
+	resume_devs++;
+	for (i = 0; i < SLOW_RESUME_DEVS; i++)
+		if (usecs > slow_resume[i].usecs)
+			break;
+	if (i < SLOW_RESUME_DEVS) {
+		memmove(&slow_resume[i + 1], &slow_resume[i],
+			(SLOW_RESUME_DEVS - i - 1) * sizeof(slow_resume[0]));
+		strlcpy(slow_resume[i].name, dev_name(dev),
+			sizeof(slow_resume[i].name));
+		slow_resume[i].usecs = usecs;
+	}
+	spin_unlock(&slow_resume_lock);
+}
+
+void suspend_time_resume_done(void)
+{
+	int i;
+
+	spin_lock(&slow_resume_lock);
+	memcpy(slow_resume_last, slow_resume, sizeof(slow_resume));
+	memset(slow_resume, 0, sizeof(slow_resume));
+	resume_usecs_last = resume_usecs_total;
+	resume_devs_last = resume_devs;
+	resume_usecs_total = 0;
+	resume_devs = 0;
+	spin_unlock(&slow_resume_lock);
+
+	pr_info("%u devices resumed in %lld usecs of callbacks, slowest:\n",
+		resume_devs_last, resume_usecs_last);
+	for (i = 0; i < SLOW_RESUME_DEVS && slow_resume_last[i].usecs; i++)
+		pr_info("  %-24s %8lld usecs\n", slow_resume_last[i].name,
+			slow_resume_last[i].usecs);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -38,6 +155,41 @@ static int suspend_time_debug_show(struct seq_file *s, void *data)
 			bin ? 1 << (bin - 1) : 0, 1 << bin,
 				time_in_suspend_bins[bin]);
 	}
+
+	spin_lock(&slow_resume_lock);
+	seq_printf(s, "\nlast resume: %u devices, %lld usecs of callbacks\n",
+		   resume_devs_last, resume_usecs_last);
+	seq_printf(s, "device                      usecs\n");
+	seq_printf(s, "---------------------------------\n");
+	for (bin = 0; bin < SLOW_RESUME_DEVS; bin++) {
+		if (!slow_resume_last[bin].usecs)
+			break;
+		seq_printf(s, "%-24s %8lld\n", slow_resume_last[bin].name,
+			   slow_resume_last[bin].usecs);
+	}
+	spin_unlock(&slow_resume_lock);
+
+	spin_lock_irq(&abort_lock);
+	seq_printf(s, "\naborted: %u, backoffs: %u, last backoff %u msecs\n",
+		   aborts, backoffs, backoff_msecs_last);
+	seq_printf(s, "abort after (msecs)  count\n");
+	seq_printf(s, "--------------------------\n");
+	for (bin = 0; bin < 32; bin++) {
+		if (abort_msecs_bins[bin] == 0)
+			continue;
+		seq_printf(s, "%6d - %6d %8u\n",
+			   bin ? 1 << (bin - 1) : 0, 1 << bin,
+			   abort_msecs_bins[bin]);
+	}
+	seq_printf(s, "abort source                count\n");
+	seq_printf(s, "---------------------------------\n");
+	for (bin = 0; bin < ABORT_SOURCES; bin++) {
+		if (!abort_sources[bin].count)
+			continue;
+		seq_printf(s, "%-24s %8u\n", abort_sources[bin].name,
+			   abort_sources[bin].count);
+	}
+	spin_unlock_irq(&abort_lock);
 	return 0;
 }
 
@@ -38,11 +38,20 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_INITIALIZED            (1U << 8)
 #define WAKE_LOCK_ACTIVE                 (1U << 9)
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
-#define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * The lists are only walked to print stats and debug output.  Whether a
+ * type is held is answered from the counters, and each timed lock expires
+ * from its own timer, so locking and unlocking don't depend on how many
+ * wake locks exist.  All of it is protected by list_lock.
+ */
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static int nr_active[WAKE_LOCK_TYPE_COUNT];
+static int nr_active_untimed[WAKE_LOCK_TYPE_COUNT];
+/* latest expiry of the timed locks, may be stale once they are unlocked */
+static unsigned long max_expires[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -50,16 +59,57 @@ suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
 static struct wake_lock unknown_wakeup;
 static struct wake_lock suspend_backoff_lock;
 
+/*
+ * Let the expiry of timed locks slip by up to this many jiffies, so that
+ * the timers of locks taken around the same time expire together.
+ */
+#define WAKE_LOCK_TIMER_SLACK		(HZ / 10)
+
 #define SUSPEND_BACKOFF_THRESHOLD	10
 #define SUSPEND_BACKOFF_INTERVAL	10000
+#define SUSPEND_BACKOFF_MAX_INTERVAL	80000
 
 static unsigned suspend_short_count;
+/* doubled each time the aborts keep coming back right after a backoff */
+static unsigned int suspend_backoff_interval = SUSPEND_BACKOFF_INTERVAL;
+static unsigned long suspend_backoff_end;
+
+/*
+ * The first suspend wake lock taken while an attempt is in progress, to
+ * blame if the attempt is aborted.  Protected by list_lock.
+ */
+static bool suspend_attempt;
+static char suspend_blocker[24];
 
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Total time the main wake lock was released, i.e. the time the system
+ * would have suspended if no other suspend lock had been held.  A lock's
+ * sleep_time is how much this grew while the lock was active.
+ */
+static ktime_t sleep_wait_total;
+static ktime_t sleep_wait_since;
+static bool sleep_waiting;
+
+static ktime_t sleep_wait_time_locked(ktime_t now)
+{
+	if (!sleep_waiting)
+		return sleep_wait_total;
+	return ktime_add(sleep_wait_total, ktime_sub(now, sleep_wait_since));
+}
+
+static void set_sleep_waiting_locked(bool waiting)
+{
+	ktime_t now = ktime_get();
+
+	sleep_wait_total = sleep_wait_time_locked(now);
+	sleep_wait_since = now;
+	sleep_waiting = waiting;
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -104,9 +154,10 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		else
 			expire_count++;
 		total_time = ktime_add(total_time, add_time);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND)
 			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+					ktime_sub(sleep_wait_time_locked(now),
+						  lock->stat.sleep_wait_start));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -159,52 +210,59 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND) {
+		duration = ktime_sub(sleep_wait_time_locked(now),
+				     lock->stat.sleep_wait_start);
 		lock->stat.prevent_suspend_time = ktime_add(
 			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void wake_lock_stat_start_locked(struct wake_lock *lock)
 {
-	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
-	last_sleep_time_update = now;
+	lock->stat.last_time = ktime_get();
+	lock->stat.sleep_wait_start =
+		sleep_wait_time_locked(lock->stat.last_time);
 }
 #endif
 
+static void suspend(struct work_struct *work);
+static DECLARE_WORK(suspend_work, suspend);
 
-static void expire_wake_lock(struct wake_lock *lock)
+/* Move an active lock to the inactive list, caller holds list_lock */
+static void wake_lock_deactivate_locked(struct wake_lock *lock, int expired)
 {
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
+	wake_unlock_stat_locked(lock, expired);
 #endif
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE))
+		nr_active_untimed[type]--;
+	nr_active[type]--;
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
-	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
-		pr_info("expired wake lock %s\n", lock->name);
+	list_move(&lock->link, &inactive_locks);
+
+	if (type == WAKE_LOCK_SUSPEND && !nr_active[type])
+		queue_work(suspend_work_queue, &suspend_work);
+}
+
+static void expire_wake_lock(unsigned long data)
+{
+	struct wake_lock *lock = (struct wake_lock *)data;
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	/* the lock may have been unlocked or re-armed since the timer fired */
+	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
+	    (long)(lock->expires - jiffies) <= 0) {
+		if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
+			pr_info("expired wake lock %s\n", lock->name);
+		wake_lock_deactivate_locked(lock, 1);
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
 /* Caller must acquire the list_lock spinlock */
@@ -232,21 +290,16 @@ static void print_active_locks(int type)
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	long timeout;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
-	}
-	return max_timeout;
+	if (!nr_active[type])
+		return 0;
+	if (nr_active_untimed[type])
+		return -1;
+	/* timed locks only, their timers have not run yet */
+	timeout = max_expires[type] - jiffies;
+	return timeout > 0 ? timeout : 1;
 }
 
 long has_wake_lock(int type)
@@ -263,16 +316,70 @@ long has_wake_lock(int type)
 
 static void suspend_backoff(void)
 {
-	pr_info("suspend: too many immediate wakeups, back off\n");
+	/* still aborting within one interval of the last backoff ending */
+	if (suspend_backoff_end && time_before(jiffies, suspend_backoff_end +
+			msecs_to_jiffies(suspend_backoff_interval)))
+		suspend_backoff_interval = min_t(unsigned int,
+						 suspend_backoff_interval * 2,
+						 SUSPEND_BACKOFF_MAX_INTERVAL);
+	else
+		suspend_backoff_interval = SUSPEND_BACKOFF_INTERVAL;
+
+	pr_info("suspend: too many immediate wakeups, back off %u msecs\n",
+		suspend_backoff_interval);
+	suspend_time_backoff(suspend_backoff_interval);
+	suspend_backoff_end = jiffies +
+		msecs_to_jiffies(suspend_backoff_interval);
 	wake_lock_timeout(&suspend_backoff_lock,
-			  msecs_to_jiffies(SUSPEND_BACKOFF_INTERVAL));
+			  msecs_to_jiffies(suspend_backoff_interval));
+}
+
+static void suspend_attempt_begin(void)
+{
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	suspend_attempt = true;
+	suspend_blocker[0] = '\0';
+	spin_unlock_irqrestore(&list_lock, irqflags);
+}
+
+/*
+ * Blame an aborted attempt on the wake lock that was taken during it, or
+ * else on the device whose callback failed, as recorded in suspend_stats.
+ */
+static void suspend_attempt_end(int ret, int failed_dev, ktime_t start)
+{
+	char source[sizeof(suspend_blocker)];
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	suspend_attempt = false;
+	strlcpy(source, suspend_blocker, sizeof(source));
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	if (!ret)
+		return;
+	if (!source[0] && failed_dev != suspend_stats.last_failed_dev) {
+		failed_dev = (suspend_stats.last_failed_dev + REC_FAILED_NUM - 1)
+				% REC_FAILED_NUM;
+		strlcpy(source, suspend_stats.failed_devs[failed_dev],
+			sizeof(source));
+	}
+	if (!source[0])
+		strlcpy(source, "unknown", sizeof(source));
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("suspend: aborted by %s\n", source);
+	suspend_time_aborted(source, start);
 }
 
 static void suspend(struct work_struct *work)
 {
 	int ret;
 	int entry_event_num;
+	int failed_dev;
 	struct timespec ts_entry, ts_exit;
+	ktime_t start;
 
 	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		if (debug_mask & DEBUG_SUSPEND)
@@ -285,7 +392,11 @@ static void suspend(struct work_struct *work)
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
 	getnstimeofday(&ts_entry);
+	failed_dev = suspend_stats.last_failed_dev;
+	start = ktime_get();
+	suspend_attempt_begin();
 	ret = pm_suspend(requested_suspend_state);
+	suspend_attempt_end(ret, failed_dev, start);
 	getnstimeofday(&ts_exit);
 
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
@@ -311,28 +422,10 @@ static void suspend(struct work_struct *work)
 	if (current_event_num == entry_event_num) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: pm_suspend returned with no event\n");
-		wake_lock_timeout(&unknown_wakeup, HZ / 2);
+		if (!wakeup_reason_wake_lock_timeout(HZ / 2))
+			wake_lock_timeout(&unknown_wakeup, HZ / 2);
 	}
 }
-static DECLARE_WORK(suspend_work, suspend);
-
-static void expire_wake_locks(unsigned long data)
-{
-	long has_lock;
-	unsigned long irqflags;
-	if (debug_mask & DEBUG_EXPIRE)
-		pr_info("expire_wake_locks: start\n");
-	spin_lock_irqsave(&list_lock, irqflags);
-	if (debug_mask & DEBUG_SUSPEND)
-		print_active_locks(WAKE_LOCK_SUSPEND);
-	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
-	if (debug_mask & DEBUG_EXPIRE)
-		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
-	if (has_lock == 0)
-		queue_work(suspend_work_queue, &suspend_work);
-	spin_unlock_irqrestore(&list_lock, irqflags);
-}
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -375,8 +468,11 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	lock->stat.sleep_wait_start = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
+	setup_timer(&lock->timer, expire_wake_lock, (unsigned long)lock);
+	set_timer_slack(&lock->timer, WAKE_LOCK_TIMER_SLACK);
 
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
@@ -391,6 +487,7 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
+	wake_lock_deactivate_locked(lock, 0);
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
@@ -409,6 +506,8 @@ void wake_lock_destroy(struct wake_lock *lock)
 #endif
 	list_del(&lock->link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
+	/* the timer sees the lock inactive, but may still be running */
+	del_timer_sync(&lock->timer);
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
@@ -417,7 +516,6 @@ static void wake_lock_internal(
 {
 	int type;
 	unsigned long irqflags;
-	long expire_in;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
@@ -429,60 +527,53 @@ static void wake_lock_internal(
 			pr_info("wakeup wake lock: %s\n", lock->name);
 		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
-	}
-	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
-	    (long)(lock->expires - jiffies) <= 0) {
-		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
+		wakeup_reason_wake_lock(lock->name);
 	}
 #endif
+	/* account a timeout that ran out before its timer got to run */
+	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
+	    (long)(lock->expires - jiffies) <= 0)
+		wake_lock_deactivate_locked(lock, 1);
+
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
-		lock->flags |= WAKE_LOCK_ACTIVE;
+		lock->flags |= WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE;
+		nr_active[type]++;
+		list_move(&lock->link, &active_wake_locks[type]);
 #ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start_locked(lock);
 #endif
+	} else if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		nr_active_untimed[type]--;
+		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
 	}
-	list_del(&lock->link);
+
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
 				lock->name, type, timeout / HZ,
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
-		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		if (nr_active[type] == 1 ||
+		    time_after(lock->expires, max_expires[type]))
+			max_expires[type] = lock->expires;
+		mod_timer(&lock->timer, lock->expires);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		nr_active_untimed[type]++;
+		del_timer(&lock->timer);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
+		if (suspend_attempt && !suspend_blocker[0])
+			strlcpy(suspend_blocker, lock->name,
+				sizeof(suspend_blocker));
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			set_sleep_waiting_locked(false);
 #endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -501,40 +592,19 @@ EXPORT_SYMBOL(wake_lock_timeout);
 
 void wake_unlock(struct wake_lock *lock)
 {
-	int type;
 	unsigned long irqflags;
 	spin_lock_irqsave(&list_lock, irqflags);
-	type = lock->flags & WAKE_LOCK_TYPE_MASK;
-#ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 0);
-#endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
-	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
-		if (lock == &main_wake_lock) {
-			if (debug_mask & DEBUG_SUSPEND)
-				print_active_locks(WAKE_LOCK_SUSPEND);
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		del_timer(&lock->timer);
+	wake_lock_deactivate_locked(lock, 0);
+	if (lock == &main_wake_lock) {
+		if (debug_mask & DEBUG_SUSPEND)
+			print_active_locks(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+		set_sleep_waiting_locked(true);
 #endif
-		}
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
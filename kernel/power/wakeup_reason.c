@@ -0,0 +1,274 @@
+/*
+ * kernel/power/wakeup_reason.c - what woke the system from suspend
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The platform reports the interrupts that were pending when the system
+ * woke up with log_wakeup_reason(), from the wakeup controller and from
+ * the chained handlers which demultiplex it further (I/O pad wakeups for
+ * instance).  The reasons of the last resume and the number of resumes
+ * each interrupt caused are in /sys/kernel/wakeup_reasons.
+ *
+ * A resume which nobody takes a wake lock for holds the wake lock of its
+ * first wakeup interrupt for a moment, instead of the anonymous
+ * "unknown_wakeups" one, so that the wake lock statistics tell which
+ * interrupt keeps waking the system for nothing.
+ */
+
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
+#include <linux/syscore_ops.h>
+#include <linux/wakelock.h>
+
+#define MAX_LAST_WAKEUP_IRQS	8
+#define MAX_WAKEUP_SOURCES	32
+
+struct wakeup_irq_source {
+	int irq;
+	char name[24];
+	unsigned long count;
+#ifdef CONFIG_WAKELOCK
+	bool lock_ready;
+	char lock_name[32];
+	struct wake_lock lock;
+#endif
+};
+
+/* sources are never freed, an irq keeps its slot once it woke us */
+static struct wakeup_irq_source sources[MAX_WAKEUP_SOURCES];
+static int nr_sources;
+static unsigned long sources_overflow;
+
+static int last_irqs[MAX_LAST_WAKEUP_IRQS];
+static int nr_last_irqs;
+static char last_wake_lock[32];
+static bool capture;
+
+static DEFINE_SPINLOCK(wakeup_reason_lock);
+/* serialises the setup of the per source wake locks */
+static DEFINE_MUTEX(wakeup_reason_mutex);
+
+static struct wakeup_irq_source *find_source(int irq)
+{
+	int i;
+
+	for (i = 0; i < nr_sources; i++)
+		if (sources[i].irq == irq)
+			return &sources[i];
+
+	return NULL;
+}
+
+/**
+ * log_wakeup_reason() - record an interrupt which woke the system
+ * @irq: the interrupt
+ *
+ * Only has an effect from the late suspend of the system core until the
+ * end of the resume, so it may be called from interrupt handlers which
+ * also run at other times.
+ */
+void log_wakeup_reason(int irq)
+{
+	struct wakeup_irq_source *src;
+	struct irq_desc *desc;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	if (!capture)
+		goto out;
+
+	for (i = 0; i < nr_last_irqs; i++)
+		if (last_irqs[i] == irq)
+			goto out;
+	if (nr_last_irqs < MAX_LAST_WAKEUP_IRQS)
+		last_irqs[nr_last_irqs++] = irq;
+
+	src = find_source(irq);
+	if (!src) {
+		if (nr_sources == MAX_WAKEUP_SOURCES) {
+			sources_overflow++;
+			goto out;
+		}
+		src = &sources[nr_sources++];
+		src->irq = irq;
+		desc = irq_to_desc(irq);
+		strlcpy(src->name, desc && desc->action && desc->action->name ?
+			desc->action->name : "unknown", sizeof(src->name));
+	}
+	src->count++;
+out:
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+}
+
+/**
+ * wakeup_reason_wake_lock() - report the wake lock a resume led to
+ * @name: the first wake lock taken after the resume
+ */
+void wakeup_reason_wake_lock(const char *name)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	strlcpy(last_wake_lock, name, sizeof(last_wake_lock));
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+}
+
+#ifdef CONFIG_WAKELOCK
+/**
+ * wakeup_reason_wake_lock_timeout() - hold the system up for a wakeup
+ * @timeout: how long, in jiffies
+ *
+ * Takes the wake lock of the first interrupt which woke the system.
+ * Returns false if no interrupt was reported for the last resume.
+ * Must be called from process context.
+ */
+bool wakeup_reason_wake_lock_timeout(long timeout)
+{
+	struct wakeup_irq_source *src = NULL;
+	unsigned long flags;
+
+	mutex_lock(&wakeup_reason_mutex);
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	if (nr_last_irqs)
+		src = find_source(last_irqs[0]);
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+
+	if (src) {
+		if (!src->lock_ready) {
+			snprintf(src->lock_name, sizeof(src->lock_name),
+				 "wakeup_irq_%d_%s", src->irq, src->name);
+			wake_lock_init(&src->lock, WAKE_LOCK_SUSPEND,
+				       src->lock_name);
+			src->lock_ready = true;
+		}
+		wake_lock_timeout(&src->lock, timeout);
+	}
+	mutex_unlock(&wakeup_reason_mutex);
+
+	return src != NULL;
+}
+#endif
+
+static ssize_t last_resume_reason_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	struct wakeup_irq_source *src;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	for (i = 0; i < nr_last_irqs; i++) {
+		src = find_source(last_irqs[i]);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %s\n",
+				 last_irqs[i], src ? src->name : "unknown");
+	}
+	if (last_wake_lock[0])
+		len += scnprintf(buf + len, PAGE_SIZE - len, "wake_lock %s\n",
+				 last_wake_lock);
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+
+	return len;
+}
+
+static ssize_t wakeup_counts_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	for (i = 0; i < nr_sources; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %s %lu\n",
+				 sources[i].irq, sources[i].name,
+				 sources[i].count);
+	if (sources_overflow)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "overflow %lu\n", sources_overflow);
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+
+	return len;
+}
+
+static struct kobj_attribute last_resume_reason =
+	__ATTR_RO(last_resume_reason);
+static struct kobj_attribute wakeup_counts = __ATTR_RO(wakeup_counts);
+
+static struct attribute *wakeup_reason_attrs[] = {
+	&last_resume_reason.attr,
+	&wakeup_counts.attr,
+	NULL,
+};
+
+static struct attribute_group wakeup_reason_attr_group = {
+	.attrs = wakeup_reason_attrs,
+};
+
+/* the interrupts pending at the time of the suspend did not wake us */
+static int wakeup_reason_suspend(void)
+{
+	spin_lock(&wakeup_reason_lock);
+	nr_last_irqs = 0;
+	last_wake_lock[0] = '\0';
+	capture = true;
+	spin_unlock(&wakeup_reason_lock);
+
+	return 0;
+}
+
+static struct syscore_ops wakeup_reason_syscore_ops = {
+	.suspend = wakeup_reason_suspend,
+};
+
+static int wakeup_reason_pm_event(struct notifier_block *notifier,
+				  unsigned long pm_event, void *unused)
+{
+	unsigned long flags;
+
+	if (pm_event == PM_POST_SUSPEND) {
+		spin_lock_irqsave(&wakeup_reason_lock, flags);
+		capture = false;
+		spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block wakeup_reason_pm_notifier = {
+	.notifier_call = wakeup_reason_pm_event,
+};
+
+static int __init wakeup_reason_init(void)
+{
+	struct kobject *kobj;
+	int ret;
+
+	kobj = kobject_create_and_add("wakeup_reasons", kernel_kobj);
+	if (!kobj)
+		return -ENOMEM;
+
+	ret = sysfs_create_group(kobj, &wakeup_reason_attr_group);
+	if (ret) {
+		kobject_put(kobj);
+		return ret;
+	}
+
+	register_syscore_ops(&wakeup_reason_syscore_ops);
+	register_pm_notifier(&wakeup_reason_pm_notifier);
+
+	return 0;
+}
+late_initcall(wakeup_reason_init);
@@ -41,6 +41,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -149,6 +150,18 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Console output is normally left to the printk kthread, so that callers
+ * do not spin for milliseconds behind a slow serial console.  It is
+ * written out by the caller itself before the thread is up, for
+ * KERN_EMERG and KERN_ALERT messages, during an oops or panic, once the
+ * system is going down and whenever printk.synchronous is set.
+ */
+static bool printk_synchronous;
+module_param_named(synchronous, printk_synchronous, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_thread;
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -878,6 +891,14 @@ static int console_trylock_for_printk(unsigned int cpu)
 	raw_spin_unlock(&logbuf_lock);
 	return retval;
 }
+static void printk_kick_output(void);
+
+static inline bool printk_defer_output(int level)
+{
+	return printk_thread && !printk_synchronous && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING && level > 1;
+}
+
 static const char recursion_bug_msg [] =
 		KERN_CRIT "BUG: recent printk recursion!\n";
 static int recursion_bug;
@@ -1030,8 +1051,16 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The console_trylock_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * Deferred output only flags this CPU: the printk tick wakes
+	 * the printk thread, as waking it from here could deadlock
+	 * on the runqueue lock.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_defer_output(current_log_level)) {
+		printk_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		printk_kick_output();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -1288,10 +1317,18 @@ int is_console_locked(void)
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_OUTPUT	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
 
+#ifdef CONFIG_PRINTK
+static void printk_kick_output(void)
+{
+	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+}
+#endif
+
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
@@ -1302,6 +1339,8 @@ void printk_tick(void)
 		}
 		if (pending & PRINTK_PENDING_WAKEUP)
 			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up_process(printk_thread);
 	}
 }
 
@@ -1690,6 +1729,40 @@ int unregister_console(struct console *console)
 }
 EXPORT_SYMBOL(unregister_console);
 
+#ifdef CONFIG_PRINTK
+static int printk_output_thread(void *unused)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (ACCESS_ONCE(con_start) == ACCESS_ONCE(log_end))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static void __init printk_output_thread_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_output_thread, NULL, "printk");
+	if (IS_ERR(thread)) {
+		printk(KERN_ERR "printk: no output thread, printing "
+		       "synchronously\n");
+		return;
+	}
+	printk_thread = thread;
+}
+#else
+static inline void printk_output_thread_init(void)
+{
+}
+#endif
+
 static int __init printk_late_init(void)
 {
 	struct console *con;
@@ -1702,6 +1775,7 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+	printk_output_thread_init();
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -72,6 +72,7 @@
 #include <linux/slab.h>
 #include <linux/init_task.h>
 #include <linux/binfmts.h>
+#include <linux/cpufreq_energy.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -308,41 +309,12 @@ static inline struct rq *__task_rq_lock(struct task_struct *p)
 	}
 }
 
-/*
- * task_rq_lock - lock p->pi_lock and lock the rq @p resides on.
- */
-static struct rq *task_rq_lock(struct task_struct *p, unsigned long *flags)
-	__acquires(p->pi_lock)
-	__acquires(rq->lock)
-{
-	struct rq *rq;
-
-	for (;;) {
-		raw_spin_lock_irqsave(&p->pi_lock, *flags);
-		rq = task_rq(p);
-		raw_spin_lock(&rq->lock);
-		if (likely(rq == task_rq(p)))
-			return rq;
-		raw_spin_unlock(&rq->lock);
-		raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
-	}
-}
-
 static void __task_rq_unlock(struct rq *rq)
 	__releases(rq->lock)
 {
 	raw_spin_unlock(&rq->lock);
 }
 
-static inline void
-task_rq_unlock(struct rq *rq, struct task_struct *p, unsigned long *flags)
-	__releases(rq->lock)
-	__releases(p->pi_lock)
-{
-	raw_spin_unlock(&rq->lock);
-	raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
-}
-
 /*
  * this_rq_lock - lock this runqueue and disable interrupts.
  */
@@ -1580,7 +1552,7 @@ static void ttwu_queue(struct task_struct *p, int cpu)
 static int
 try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 {
-	unsigned long flags;
+	unsigned long flags, demand = 0;
 	int cpu, success = 0;
 
 	smp_wmb();
@@ -1633,11 +1605,15 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 #endif /* CONFIG_SMP */
 
 	ttwu_queue(p, cpu);
+	demand = task_demand_hint(p, cpu);
 stat:
 	ttwu_stat(p, cpu, wake_flags);
 out:
 	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
 
+	if (demand)
+		sched_freq_notify(cpu, SCHED_FREQ_WAKEUP, demand);
+
 	return success;
 }
 
@@ -1718,11 +1694,24 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	p->se.runnable_avg.last_update	= 0;
+	p->se.runnable_avg.runnable_sum	= 0;
+	p->se.runnable_avg.period	= 0;
+#endif
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	p->se.demand_window_start	= 0;
+	p->se.demand_sum		= 0;
+	p->se.demand			= 0;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
+	init_rt_reservation(p);
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
@@ -1978,6 +1967,7 @@ static void finish_task_switch(struct rq *rq, struct task_struct *prev)
 		 * task and put them back on the free list.
 		 */
 		kprobe_flush_task(prev);
+		exit_rt_reservation(prev);
 		put_task_struct(prev);
 	}
 }
@@ -2811,6 +2801,9 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 	/* Add user time to cpustat. */
 	task_group_account_field(p, index, (__force u64) cputime);
 
+	/* Account for the energy used */
+	cpufreq_energy_account(p, cputime);
+
 	/* Account for user time used */
 	acct_update_integrals(p);
 }
@@ -2861,6 +2854,9 @@ void __account_system_time(struct task_struct *p, cputime_t cputime,
 	/* Add system time to cpustat. */
 	task_group_account_field(p, index, (__force u64) cputime);
 
+	/* Account for the energy used */
+	cpufreq_energy_account(p, cputime);
+
 	/* Account for system time used */
 	acct_update_integrals(p);
 }
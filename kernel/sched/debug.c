@@ -279,6 +279,10 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(cpu_load[2]);
 	P(cpu_load[3]);
 	P(cpu_load[4]);
+#ifdef CONFIG_SMP
+	P(runnable_avg.runnable_sum);
+	P(runnable_avg.period);
+#endif
 #undef P
 #undef PN
 
@@ -445,6 +449,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_failed_migrations_running);
 	P(se.statistics.nr_failed_migrations_hot);
 	P(se.statistics.nr_forced_migrations);
+	P(se.statistics.nr_failed_migrations_packed);
 	P(se.statistics.nr_wakeups);
 	P(se.statistics.nr_wakeups_sync);
 	P(se.statistics.nr_wakeups_migrate);
@@ -454,6 +459,8 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_wakeups_affine_attempts);
 	P(se.statistics.nr_wakeups_passive);
 	P(se.statistics.nr_wakeups_idle);
+	P(se.statistics.nr_wakeups_packed);
+	P(se.statistics.nr_wakeups_pack_full);
 
 	{
 		u64 avg_atom, avg_per_cpu;
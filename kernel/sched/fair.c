@@ -89,6 +89,14 @@ unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+/*
+ * With PACK_SMALL_TASKS, tasks runnable for less than sched_pack_task_util
+ * percent of the time are packed on the first cpu of their cache domain
+ * until it is busy for sched_pack_util percent of the time.
+ */
+const_debug unsigned int sysctl_sched_pack_util = 80;
+const_debug unsigned int sysctl_sched_pack_task_util = 20;
+
 /*
  * The exponential sliding  window over which load is averaged for shares
  * distribution.
@@ -656,6 +664,164 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 static void update_cfs_load(struct cfs_rq *cfs_rq, int global_update);
 static void update_cfs_shares(struct cfs_rq *cfs_rq);
 
+#ifdef CONFIG_SMP
+/*
+ * The runnable average of a task is the share of the recent time it spent
+ * on a runqueue, that of a cpu the share it was not idle. It is kept in
+ * ~us (ns >> 10) and the history is halved every RUNNABLE_AVG_PERIOD, so
+ * that it follows a change of behaviour within a few periods.
+ */
+#define RUNNABLE_AVG_PERIOD	32768	/* ~32ms */
+#define RUNNABLE_AVG_MIN	4096	/* history needed to trust the average */
+
+static void __update_runnable_avg(struct sched_avg *sa, u64 now, int runnable)
+{
+	u64 delta;
+
+	/* new, or last updated with the clock of another cpu */
+	if (unlikely(!sa->last_update || (s64)(now - sa->last_update) < 0)) {
+		sa->last_update = now;
+		return;
+	}
+
+	delta = (now - sa->last_update) >> 10;
+	if (!delta)
+		return;
+	sa->last_update += delta << 10;
+
+	delta = min_t(u64, delta, RUNNABLE_AVG_PERIOD);
+	sa->period += delta;
+	if (runnable)
+		sa->runnable_sum += delta;
+	while (sa->period >= RUNNABLE_AVG_PERIOD) {
+		sa->period >>= 1;
+		sa->runnable_sum >>= 1;
+	}
+}
+
+/*
+ * Runnable share of @sa in 1/1024, counting the time since its last
+ * update as @runnable. Used without the runqueue lock, a racing update
+ * only gives a slightly off estimate.
+ */
+static unsigned long runnable_avg_util(struct sched_avg *sa, u64 now,
+				       int runnable)
+{
+	u32 sum = sa->runnable_sum, period = sa->period;
+	u64 last = sa->last_update;
+	u32 delta = 0;
+
+	if (last && (s64)(now - last) > 0)
+		delta = min_t(u64, (now - last) >> 10, RUNNABLE_AVG_PERIOD);
+
+	period += delta;
+	if (runnable)
+		sum += delta;
+
+	return (sum << 10) / (period + 1);
+}
+
+void update_rq_runnable_avg(struct rq *rq, int runnable)
+{
+	__update_runnable_avg(&rq->runnable_avg, rq->clock, runnable);
+}
+#endif
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * The demand of a task is the share of the last window it spent running.
+ * It rises to a new peak at once but only halves for every window after
+ * that, so that a periodic task keeps its demand over its sleeps. The
+ * demand of a runqueue is the sum of the demands of its fair tasks and
+ * follows them as they wake up, sleep and migrate.
+ */
+#define SCHED_DEMAND_WINDOW_SHIFT	24	/* ~16.8ms */
+#define SCHED_DEMAND_WINDOW		(1ULL << SCHED_DEMAND_WINDOW_SHIFT)
+
+static ATOMIC_NOTIFIER_HEAD(sched_freq_notifier_head);
+
+static void update_entity_demand(struct cfs_rq *cfs_rq,
+				 struct sched_entity *se, u64 now,
+				 unsigned long delta_exec)
+{
+	u64 windows;
+	u32 demand = se->demand, util;
+
+	/* the window was started with the clock of another cpu */
+	if (unlikely(now < se->demand_window_start))
+		se->demand_window_start = now;
+
+	windows = (now - se->demand_window_start) >> SCHED_DEMAND_WINDOW_SHIFT;
+	if (windows) {
+		util = se->demand_sum >>
+			(SCHED_DEMAND_WINDOW_SHIFT - SCHED_DEMAND_SHIFT);
+		demand = max(util, (demand + util) / 2);
+		demand >>= min_t(u64, windows - 1, 31);
+		se->demand_window_start += windows << SCHED_DEMAND_WINDOW_SHIFT;
+		se->demand_sum = 0;
+	}
+
+	se->demand_sum = min_t(u64, se->demand_sum + delta_exec,
+			       SCHED_DEMAND_WINDOW);
+
+	if (se->on_rq)
+		rq_of(cfs_rq)->demand += (long)demand - (long)se->demand;
+	se->demand = demand;
+}
+
+/*
+ * Demand of a task that is being woken up on @cpu, as far as it can be
+ * told without its runqueue lock: forgotten once it slept a full window.
+ */
+unsigned long task_demand_hint(struct task_struct *p, int cpu)
+{
+	u64 now = cpu_rq(cpu)->clock_task;
+
+	if (p->sched_class != &fair_sched_class)
+		return 0;
+	if (now - p->se.demand_window_start > 2 * SCHED_DEMAND_WINDOW)
+		return 0;
+	return p->se.demand;
+}
+
+/**
+ * sched_get_cpu_demand() - recent cpu demand of the fair tasks on a cpu
+ * @cpu: the cpu
+ *
+ * Returns the demand in SCHED_DEMAND_SCALE units, capped to the full cpu.
+ */
+unsigned long sched_get_cpu_demand(int cpu)
+{
+	return min_t(unsigned long, ACCESS_ONCE(cpu_rq(cpu)->demand),
+		     SCHED_DEMAND_SCALE);
+}
+EXPORT_SYMBOL_GPL(sched_get_cpu_demand);
+
+int register_sched_freq_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&sched_freq_notifier_head, nb);
+}
+EXPORT_SYMBOL_GPL(register_sched_freq_notifier);
+
+int unregister_sched_freq_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&sched_freq_notifier_head, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_sched_freq_notifier);
+
+/* must be called without any runqueue lock held */
+void sched_freq_notify(int cpu, unsigned long event, unsigned long demand)
+{
+	struct sched_freq_event ev = { .cpu = cpu, .demand = demand };
+
+	atomic_notifier_call_chain(&sched_freq_notifier_head, event, &ev);
+}
+#else
+static inline void update_entity_demand(struct cfs_rq *cfs_rq,
+					struct sched_entity *se, u64 now,
+					unsigned long delta_exec) { }
+#endif
+
 /*
  * Update the current task's runtime statistics. Skip current tasks that
  * are not in our scheduling class.
@@ -708,6 +874,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+		update_entity_demand(cfs_rq, curr, now, delta_exec);
 	}
 
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
@@ -783,8 +950,18 @@ account_entity_enqueue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	if (!parent_entity(se))
 		update_load_add(&rq_of(cfs_rq)->load, se->load.weight);
 #ifdef CONFIG_SMP
-	if (entity_is_task(se))
+	if (entity_is_task(se)) {
+		/* the task was asleep, or on its way here, until now */
+		__update_runnable_avg(&se->runnable_avg, rq_of(cfs_rq)->clock, 0);
 		list_add(&se->group_node, &rq_of(cfs_rq)->cfs_tasks);
+	}
+#endif
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	if (entity_is_task(se)) {
+		/* let the demand decay over the sleep first */
+		update_entity_demand(cfs_rq, se, rq_of(cfs_rq)->clock_task, 0);
+		rq_of(cfs_rq)->demand += se->demand;
+	}
 #endif
 	cfs_rq->nr_running++;
 }
@@ -797,6 +974,14 @@ account_entity_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		update_load_sub(&rq_of(cfs_rq)->load, se->load.weight);
 	if (entity_is_task(se))
 		list_del_init(&se->group_node);
+#ifdef CONFIG_SMP
+	if (entity_is_task(se))
+		__update_runnable_avg(&se->runnable_avg, rq_of(cfs_rq)->clock, 1);
+#endif
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	if (entity_is_task(se))
+		rq_of(cfs_rq)->demand -= se->demand;
+#endif
 	cfs_rq->nr_running--;
 }
 
@@ -2681,6 +2866,82 @@ done:
 	return target;
 }
 
+/*
+ * The first cpu of the cache domain of @cpu, on which small tasks are
+ * packed, or -1 if @cpu is not attached to a domain.
+ */
+static int pack_cpu(int cpu)
+{
+	struct sched_domain *sd;
+	int pack = -1;
+
+	rcu_read_lock();
+	sd = rcu_dereference(per_cpu(sd_llc, cpu));
+	if (sd)
+		pack = cpumask_first(sched_domain_span(sd));
+	rcu_read_unlock();
+
+	return pack;
+}
+
+/*
+ * Is @p small enough to be packed? @util is set to its runnable share, the
+ * time since it was last updated is counted as @runnable.
+ */
+static int task_small(struct task_struct *p, int runnable,
+		      unsigned long *util)
+{
+	struct sched_avg *sa = &p->se.runnable_avg;
+
+	if (sa->period < RUNNABLE_AVG_MIN)
+		return 0;
+
+	*util = runnable_avg_util(sa, sched_clock_cpu(task_cpu(p)), runnable);
+
+	return *util * 100 <= sysctl_sched_pack_task_util * SCHED_POWER_SCALE;
+}
+
+/* would @cpu stay below the packing threshold with @extra more load? */
+static int pack_cpu_has_room(int cpu, unsigned long extra)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long util;
+
+	util = runnable_avg_util(&rq->runnable_avg, sched_clock_cpu(cpu),
+				 rq->curr != rq->idle);
+
+	return (util + extra) * 100 < sysctl_sched_pack_util * SCHED_POWER_SCALE;
+}
+
+/*
+ * The cpu a small task waking up after running on @prev_cpu is packed on,
+ * or -1 to place it as usual. Keeping the small tasks together lets the
+ * other cpus of the domain reach the states they can only enter together.
+ */
+static int select_pack_cpu(struct task_struct *p, int prev_cpu)
+{
+	unsigned long util;
+	int cpu = pack_cpu(prev_cpu);
+
+	if (cpu < 0 || !cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+		return -1;
+
+	if (!task_small(p, 0, &util))
+		return -1;
+
+	/* what it ran there already counts in the average of the cpu */
+	if (prev_cpu == cpu)
+		util = 0;
+
+	if (!pack_cpu_has_room(cpu, util)) {
+		schedstat_inc(p, se.statistics.nr_wakeups_pack_full);
+		return -1;
+	}
+
+	schedstat_inc(p, se.statistics.nr_wakeups_packed);
+	return cpu;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -2706,6 +2967,13 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	if (p->rt.nr_cpus_allowed == 1)
 		return prev_cpu;
 
+	if (sched_feat(PACK_SMALL_TASKS) && (sd_flag & SD_BALANCE_WAKE)) {
+		new_cpu = select_pack_cpu(p, prev_cpu);
+		if (new_cpu >= 0)
+			return new_cpu;
+		new_cpu = cpu;
+	}
+
 	if (sd_flag & SD_BALANCE_WAKE) {
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
 			want_affine = 1;
@@ -3134,6 +3402,17 @@ task_hot(struct task_struct *p, u64 now, struct sched_domain *sd)
 	return delta < (s64)sysctl_sched_migration_cost;
 }
 
+/* is @p a small task packed on the cpu it would be pulled from? */
+static int task_packed(struct task_struct *p, struct lb_env *env)
+{
+	unsigned long util;
+
+	if (pack_cpu(env->dst_cpu) != env->src_cpu)
+		return 0;
+
+	return task_small(p, 1, &util) && pack_cpu_has_room(env->src_cpu, 0);
+}
+
 /*
  * can_migrate_task - may task p from runqueue rq be migrated to this_cpu?
  */
@@ -3151,6 +3430,15 @@ int can_migrate_task(struct task_struct *p, struct lb_env *env)
 		schedstat_inc(p, se.statistics.nr_failed_migrations_affine);
 		return 0;
 	}
+
+	/*
+	 * Small tasks stay on the pack cpu while it has room. They count as
+	 * pinned, so that no active balance is kicked to move them either.
+	 */
+	if (sched_feat(PACK_SMALL_TASKS) && task_packed(p, env)) {
+		schedstat_inc(p, se.statistics.nr_failed_migrations_packed);
+		return 0;
+	}
 	env->flags &= ~LBF_ALL_PINNED;
 
 	if (task_running(env->src_rq, p)) {
@@ -4466,6 +4754,11 @@ more_balance:
 			goto more_balance;
 		}
 
+		if (ld_moved) {
+			sched_freq_notify(this_cpu, SCHED_FREQ_MIGRATION, 0);
+			sched_freq_notify(busiest->cpu, SCHED_FREQ_MIGRATION, 0);
+		}
+
 		/*
 		 * some other cpu did the load balance for us.
 		 */
@@ -4635,6 +4928,7 @@ static int active_load_balance_cpu_stop(void *data)
 	int target_cpu = busiest_rq->push_cpu;
 	struct rq *target_rq = cpu_rq(target_cpu);
 	struct sched_domain *sd;
+	bool moved = false;
 
 	raw_spin_lock_irq(&busiest_rq->lock);
 
@@ -4677,7 +4971,8 @@ static int active_load_balance_cpu_stop(void *data)
 
 		schedstat_inc(sd, alb_count);
 
-		if (move_one_task(&env))
+		moved = move_one_task(&env);
+		if (moved)
 			schedstat_inc(sd, alb_pushed);
 		else
 			schedstat_inc(sd, alb_failed);
@@ -4687,6 +4982,11 @@ static int active_load_balance_cpu_stop(void *data)
 out_unlock:
 	busiest_rq->active_balance = 0;
 	raw_spin_unlock_irq(&busiest_rq->lock);
+
+	if (moved) {
+		sched_freq_notify(target_cpu, SCHED_FREQ_MIGRATION, 0);
+		sched_freq_notify(busiest_cpu, SCHED_FREQ_MIGRATION, 0);
+	}
 	return 0;
 }
 
@@ -5071,6 +5371,11 @@ static inline int nohz_kick_needed(struct rq *rq, int cpu)
 	if (time_before(now, nohz.next_balance))
 		return 0;
 
+	/* the idle cpus are left asleep while the pack cpu has room */
+	if (sched_feat(PACK_SMALL_TASKS) && pack_cpu(cpu) == cpu &&
+	    pack_cpu_has_room(cpu, 0))
+		return 0;
+
 	if (rq->nr_running >= 2)
 		goto need_kick;
 
@@ -5168,6 +5473,11 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+#ifdef CONFIG_SMP
+	__update_runnable_avg(&curr->se.runnable_avg, rq->clock, 1);
+	update_rq_runnable_avg(rq, 1);
+#endif
 }
 
 /*
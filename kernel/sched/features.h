@@ -69,3 +69,9 @@ SCHED_FEAT(TTWU_QUEUE, true)
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
+
+/*
+ * Pack the small tasks on the first cpu of their cache domain while it
+ * has room, so that the other cpus can stay in their deepest idle states.
+ */
+SCHED_FEAT(PACK_SMALL_TASKS, false)
@@ -6,6 +6,8 @@
 #include "sched.h"
 
 #include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
 
 static int do_sched_rt_period_timer(struct rt_bandwidth *rt_b, int overrun);
 
@@ -890,6 +892,268 @@ static int sched_rt_runtime_exceeded(struct rt_rq *rt_rq)
 	return 0;
 }
 
+#ifdef CONFIG_SCHED_RT_RESERVATION
+/*
+ * Per task CPU reservations: a SCHED_FIFO/SCHED_RR task gets @runtime
+ * every @period at its static priority.  When the budget is used up
+ * the task is taken off the rt_rq, though it stays on_rq for the core
+ * code, and a per task hrtimer puts it back at the next period.  The
+ * total of all reservations is admitted against the global RT limit
+ * (sched_rt_runtime_us / sched_rt_period_us) over the online cpus.
+ *
+ * A task boosted by priority inheritance is not throttled, the lock it
+ * holds matters more than its budget.
+ */
+static DEFINE_RAW_SPINLOCK(rt_resv_lock);
+static u64 rt_resv_total_bw;
+
+#define RT_RESV_BW_SHIFT	20
+
+static inline u64 rt_resv_bw(u64 runtime, u64 period)
+{
+	return div64_u64(runtime << RT_RESV_BW_SHIFT, period);
+}
+
+static inline bool rt_resv_throttled(struct task_struct *p)
+{
+	return p->rt.resv.throttled && p->prio == p->normal_prio;
+}
+
+static void rt_resv_new_period(struct sched_rt_reservation *resv, u64 now)
+{
+	if (resv->period_end) {
+		resv->nr_periods++;
+		if (now - resv->period_end < resv->period) {
+			resv->period_end += resv->period;
+			goto out;
+		}
+	}
+	resv->period_end = now + resv->period;
+out:
+	resv->used = 0;
+	resv->overrun = 0;
+}
+
+static void rt_resv_replenish(struct sched_rt_reservation *resv, u64 now)
+{
+	if (!resv->throttled && (s64)(now - resv->period_end) >= 0)
+		rt_resv_new_period(resv, now);
+}
+
+static void rt_resv_account(struct rq *rq, struct task_struct *p, u64 delta)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+
+	if (!resv->runtime || resv->throttled)
+		return;
+
+	rt_resv_replenish(resv, rq->clock);
+	resv->used += delta;
+	if (resv->used < resv->runtime || p->prio != p->normal_prio)
+		return;
+
+	resv->throttled = 1;
+	resv->overrun = 1;
+	resv->nr_overruns++;
+	dequeue_rt_entity(&p->rt);
+	hrtimer_start(&resv->timer,
+		      ns_to_ktime(max_t(s64, resv->period_end - rq->clock, 0)),
+		      HRTIMER_MODE_REL);
+	resched_task(p);
+}
+
+static void enqueue_rt_entity(struct sched_rt_entity *rt_se, bool head);
+static void dequeue_rt_entity(struct sched_rt_entity *rt_se);
+
+static enum hrtimer_restart rt_resv_timer(struct hrtimer *timer)
+{
+	struct sched_rt_reservation *resv =
+		container_of(timer, struct sched_rt_reservation, timer);
+	struct task_struct *p =
+		container_of(resv, struct task_struct, rt.resv);
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+	if (!resv->throttled)
+		goto out;
+
+	update_rq_clock(rq);
+	resv->throttled = 0;
+	rt_resv_new_period(resv, rq->clock);
+
+	if (p->on_rq && p->sched_class == &rt_sched_class &&
+	    !on_rt_rq(&p->rt)) {
+		enqueue_rt_entity(&p->rt, false);
+		if (!task_current(rq, p) && p->rt.nr_cpus_allowed > 1)
+			enqueue_pushable_task(rq, p);
+		if (p->prio < rq->curr->prio)
+			resched_task(rq->curr);
+	}
+out:
+	task_rq_unlock(rq, p, &flags);
+
+	return HRTIMER_NORESTART;
+}
+
+void init_rt_reservation(struct task_struct *p)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+
+	memset(resv, 0, sizeof(*resv));
+	hrtimer_init(&resv->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	resv->timer.function = rt_resv_timer;
+}
+
+static void rt_resv_release(struct sched_rt_reservation *resv)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rt_resv_lock, flags);
+	rt_resv_total_bw -= resv->bw;
+	resv->bw = 0;
+	raw_spin_unlock_irqrestore(&rt_resv_lock, flags);
+}
+
+/* Called with rq->lock held when @p leaves the RT class. */
+static void rt_resv_drop(struct task_struct *p)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+
+	if (!resv->runtime)
+		return;
+
+	/* the timer copes with a task that is no longer throttled */
+	hrtimer_try_to_cancel(&resv->timer);
+	resv->throttled = 0;
+	resv->runtime = 0;
+	rt_resv_release(resv);
+}
+
+void exit_rt_reservation(struct task_struct *p)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+
+	if (!resv->bw)
+		return;
+
+	hrtimer_cancel(&resv->timer);
+	rt_resv_release(resv);
+}
+
+#ifdef CONFIG_PROC_FS
+void proc_sched_rt_reservation_show(struct task_struct *p, struct seq_file *m)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+	u64 runtime, period, periods, overruns;
+	unsigned int throttled;
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+	runtime = resv->runtime;
+	period = resv->period;
+	periods = resv->nr_periods;
+	overruns = resv->nr_overruns;
+	throttled = resv->throttled;
+	task_rq_unlock(rq, p, &flags);
+
+	seq_printf(m, "runtime_us %llu\nperiod_us %llu\n",
+		   div_u64(runtime, NSEC_PER_USEC),
+		   div_u64(period, NSEC_PER_USEC));
+	seq_printf(m, "periods %llu\nmet %llu\noverruns %llu\n"
+		   "throttled %u\n", periods,
+		   periods - min(periods, overruns), overruns, throttled);
+}
+
+/*
+ * Reserve @runtime of every @period, both in ns, for the realtime task
+ * @p; a zero @runtime drops the reservation.  Returns -EBUSY if the
+ * reservation does not fit next to the existing ones.
+ */
+int proc_sched_rt_reservation_set(struct task_struct *p, u64 runtime,
+				  u64 period)
+{
+	struct sched_rt_reservation *resv = &p->rt.resv;
+	u64 bw = 0, limit;
+	unsigned long flags;
+	struct rq *rq;
+	int ret = 0;
+
+	if (!capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	if (runtime) {
+		if (period < NSEC_PER_MSEC || period > NSEC_PER_SEC ||
+		    runtime < 10 * NSEC_PER_USEC || runtime > period)
+			return -EINVAL;
+		if (p->policy != SCHED_FIFO && p->policy != SCHED_RR)
+			return -EINVAL;
+		bw = rt_resv_bw(runtime, period);
+	}
+
+	if (global_rt_runtime() == RUNTIME_INF)
+		limit = 1ULL << RT_RESV_BW_SHIFT;
+	else
+		limit = rt_resv_bw(global_rt_runtime(), global_rt_period());
+	limit *= num_online_cpus();
+
+	raw_spin_lock_irq(&rt_resv_lock);
+	if (rt_resv_total_bw - resv->bw + bw > limit) {
+		ret = -EBUSY;
+	} else {
+		rt_resv_total_bw += bw - resv->bw;
+		resv->bw = bw;
+	}
+	raw_spin_unlock_irq(&rt_resv_lock);
+	if (ret)
+		return ret;
+
+	rq = task_rq_lock(p, &flags);
+	if (runtime && p->sched_class != &rt_sched_class) {
+		task_rq_unlock(rq, p, &flags);
+		rt_resv_release(resv);
+		return -EINVAL;
+	}
+
+	hrtimer_try_to_cancel(&resv->timer);
+	if (resv->throttled) {
+		resv->throttled = 0;
+		if (p->on_rq && !on_rt_rq(&p->rt)) {
+			enqueue_rt_entity(&p->rt, false);
+			if (!task_current(rq, p) && p->rt.nr_cpus_allowed > 1)
+				enqueue_pushable_task(rq, p);
+			resched_task(rq->curr);
+		}
+	}
+	resv->runtime = runtime;
+	resv->period = period;
+	resv->used = 0;
+	resv->period_end = 0;
+	resv->overrun = 0;
+	resv->nr_periods = 0;
+	resv->nr_overruns = 0;
+	task_rq_unlock(rq, p, &flags);
+
+	return 0;
+}
+#endif /* CONFIG_PROC_FS */
+#else
+static inline bool rt_resv_throttled(struct task_struct *p)
+{
+	return false;
+}
+
+static inline void rt_resv_account(struct rq *rq, struct task_struct *p,
+				   u64 delta)
+{
+}
+
+static inline void rt_resv_drop(struct task_struct *p)
+{
+}
+#endif /* CONFIG_SCHED_RT_RESERVATION */
+
 /*
  * Update the current task's runtime statistics. Skip current tasks that
  * are not in our scheduling class.
@@ -919,6 +1183,8 @@ static void update_curr_rt(struct rq *rq)
 
 	sched_rt_avg_update(rq, delta_exec);
 
+	rt_resv_account(rq, curr, delta_exec);
+
 	if (!rt_bandwidth_enabled())
 		return;
 
@@ -1159,6 +1425,17 @@ enqueue_task_rt(struct rq *rq, struct task_struct *p, int flags)
 	if (flags & ENQUEUE_WAKEUP)
 		rt_se->timeout = 0;
 
+#ifdef CONFIG_SCHED_RT_RESERVATION
+	if (rt_se->resv.runtime) {
+		rt_resv_replenish(&rt_se->resv, rq->clock);
+		/* stays off the rt_rq until rt_resv_timer() */
+		if (rt_resv_throttled(p)) {
+			inc_nr_running(rq);
+			return;
+		}
+	}
+#endif
+
 	enqueue_rt_entity(rt_se, flags & ENQUEUE_HEAD);
 
 	if (!task_current(rq, p) && p->rt.nr_cpus_allowed > 1)
@@ -1865,12 +2142,17 @@ static void rq_offline_rt(struct rq *rq)
 	cpupri_set(&rq->rd->cpupri, rq->cpu, CPUPRI_INVALID);
 }
 
+#endif /* CONFIG_SMP */
+
 /*
  * When switch from the rt queue, we bring ourselves to a position
  * that we might want to pull RT tasks from other runqueues.
  */
 static void switched_from_rt(struct rq *rq, struct task_struct *p)
 {
+	rt_resv_drop(p);
+
+#ifdef CONFIG_SMP
 	/*
 	 * If there are other RT tasks then we will reschedule
 	 * and the scheduling of the other RT tasks will handle
@@ -1880,8 +2162,10 @@ static void switched_from_rt(struct rq *rq, struct task_struct *p)
 	 */
 	if (p->on_rq && !rq->rt.rt_nr_running)
 		pull_rt_task(rq);
+#endif
 }
 
+#ifdef CONFIG_SMP
 void init_sched_rt_class(void)
 {
 	unsigned int i;
@@ -2055,8 +2339,8 @@ const struct sched_class rt_sched_class = {
 	.pre_schedule		= pre_schedule_rt,
 	.post_schedule		= post_schedule_rt,
 	.task_woken		= task_woken_rt,
-	.switched_from		= switched_from_rt,
 #endif
+	.switched_from		= switched_from_rt,
 
 	.set_curr_task          = set_curr_task_rt,
 	.task_tick		= task_tick_rt,
@@ -8,13 +8,6 @@
 
 extern __read_mostly int scheduler_running;
 
-/*
- * Convert user-nice values [ -20 ... 0 ... 19 ]
- * to static priority [ MAX_RT_PRIO..MAX_PRIO-1 ],
- * and back.
- */
-#define NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
-#define PRIO_TO_NICE(prio)	((prio) - MAX_RT_PRIO - 20)
 #define TASK_NICE(p)		PRIO_TO_NICE((p)->static_prio)
 
 /*
@@ -357,6 +350,10 @@ struct rq {
 	#define CPU_LOAD_IDX_MAX 5
 	unsigned long cpu_load[CPU_LOAD_IDX_MAX];
 	unsigned long last_load_update_tick;
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* sum of the demands of the fair tasks queued here */
+	unsigned long demand;
+#endif
 #ifdef CONFIG_NO_HZ
 	u64 nohz_stamp;
 	unsigned long nohz_flags;
@@ -418,6 +415,9 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* share of the recent time this cpu was not idle */
+	struct sched_avg runnable_avg;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -482,6 +482,36 @@ DECLARE_PER_CPU(struct rq, runqueues);
 #define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
 #define raw_rq()		(&__raw_get_cpu_var(runqueues))
 
+/*
+ * task_rq_lock - lock p->pi_lock and lock the rq @p resides on.
+ */
+static inline struct rq *task_rq_lock(struct task_struct *p,
+				      unsigned long *flags)
+	__acquires(p->pi_lock)
+	__acquires(rq->lock)
+{
+	struct rq *rq;
+
+	for (;;) {
+		raw_spin_lock_irqsave(&p->pi_lock, *flags);
+		rq = task_rq(p);
+		raw_spin_lock(&rq->lock);
+		if (likely(rq == task_rq(p)))
+			return rq;
+		raw_spin_unlock(&rq->lock);
+		raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
+	}
+}
+
+static inline void
+task_rq_unlock(struct rq *rq, struct task_struct *p, unsigned long *flags)
+	__releases(rq->lock)
+	__releases(p->pi_lock)
+{
+	raw_spin_unlock(&rq->lock);
+	raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
+}
+
 #ifdef CONFIG_SMP
 
 #define rcu_dereference_check_sched_domain(p) \
@@ -845,11 +875,25 @@ extern const struct sched_class rt_sched_class;
 extern const struct sched_class fair_sched_class;
 extern const struct sched_class idle_sched_class;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+extern void sched_freq_notify(int cpu, unsigned long event,
+			      unsigned long demand);
+extern unsigned long task_demand_hint(struct task_struct *p, int cpu);
+#else
+static inline void sched_freq_notify(int cpu, unsigned long event,
+				     unsigned long demand) { }
+static inline unsigned long task_demand_hint(struct task_struct *p, int cpu)
+{
+	return 0;
+}
+#endif
+
 
 #ifdef CONFIG_SMP
 
 extern void trigger_load_balance(struct rq *rq, int cpu);
 extern void idle_balance(int this_cpu, struct rq *this_rq);
+extern void update_rq_runnable_avg(struct rq *rq, int runnable);
 
 #else	/* CONFIG_SMP */
 
@@ -857,6 +901,10 @@ static inline void idle_balance(int cpu, struct rq *rq)
 {
 }
 
+static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
+{
+}
+
 #endif
 
 extern void sysrq_sched_debug_show(void);
@@ -873,6 +921,14 @@ extern void resched_cpu(int cpu);
 extern struct rt_bandwidth def_rt_bandwidth;
 extern void init_rt_bandwidth(struct rt_bandwidth *rt_b, u64 period, u64 runtime);
 
+#ifdef CONFIG_SCHED_RT_RESERVATION
+extern void init_rt_reservation(struct task_struct *p);
+extern void exit_rt_reservation(struct task_struct *p);
+#else
+static inline void init_rt_reservation(struct task_struct *p) { }
+static inline void exit_rt_reservation(struct task_struct *p) { }
+#endif
+
 extern void update_cpu_load(struct rq *this_rq);
 
 #ifdef CONFIG_CGROUP_CPUACCT
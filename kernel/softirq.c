@@ -336,6 +336,8 @@ void irq_exit(void)
 	sub_preempt_count(IRQ_EXIT_OFFSET);
 	if (!in_interrupt() && local_softirq_pending())
 		invoke_softirq();
+	if (!in_interrupt())
+		timer_stats_idle_irq_exit();
 
 #ifdef CONFIG_NO_HZ
 	/* Make sure that timer wheel updates are propagated */
@@ -762,6 +762,7 @@ void tick_check_idle(int cpu)
 {
 	tick_check_oneshot_broadcast(cpu);
 	tick_check_nohz(cpu);
+	timer_stats_idle_irq_enter();
 }
 
 /*
@@ -31,6 +31,9 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * Display which of these timers woke a CPU up from idle, and how often:
+ * # cat /proc/timer_wakeups
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -65,9 +68,10 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and of those which woke a CPU from idle:
 	 */
 	unsigned long		count;
+	unsigned long		wakeups;
 	unsigned int		timer_flag;
 
 	/*
@@ -103,6 +107,33 @@ int __read_mostly timer_stats_active;
  */
 static ktime_t time_start, time_stop;
 
+/*
+ * Set while an interrupt which woke the CPU from idle is being handled:
+ * the first non-deferrable timer expiring on the way out of it is the
+ * one the CPU woke up for.
+ */
+static DEFINE_PER_CPU(int, tstats_idle_wakeup);
+
+void timer_stats_idle_irq_enter(void)
+{
+	if (unlikely(timer_stats_active))
+		__this_cpu_write(tstats_idle_wakeup, 1);
+}
+
+void timer_stats_idle_irq_exit(void)
+{
+	if (unlikely(__this_cpu_read(tstats_idle_wakeup)))
+		__this_cpu_write(tstats_idle_wakeup, 0);
+}
+
+int timer_stats_idle_wakeup(void)
+{
+	if (likely(!__this_cpu_read(tstats_idle_wakeup)))
+		return 0;
+	__this_cpu_write(tstats_idle_wakeup, 0);
+	return 1;
+}
+
 /*
  * tstat entry structs only get allocated while collection is
  * active and never freed during that time - this simplifies
@@ -204,6 +235,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->wakeups = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -251,16 +283,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_WAKEUP;
 
 	raw_spin_lock_irqsave(lock, flags);
 	if (!timer_stats_active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_WAKEUP)
+			entry->wakeups++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -338,6 +372,58 @@ static int tstats_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+static int twakeups_show(struct seq_file *m, void *v)
+{
+	struct timespec period;
+	struct entry *entry;
+	unsigned long ms;
+	long wakeups = 0;
+	ktime_t time;
+	int i;
+
+	mutex_lock(&show_mutex);
+	if (timer_stats_active)
+		time_stop = ktime_get();
+
+	time = ktime_sub(time_stop, time_start);
+
+	period = ktime_to_timespec(time);
+	ms = period.tv_nsec / 1000000;
+
+	seq_puts(m, "Timer Wakeup Stats Version: v0.1\n");
+	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
+
+	for (i = 0; i < nr_entries; i++) {
+		entry = entries + i;
+		if (!entry->wakeups)
+			continue;
+
+		seq_printf(m, " %4lu, %5d %-16s ",
+			   entry->wakeups, entry->pid, entry->comm);
+		print_name_offset(m, (unsigned long)entry->start_func);
+		seq_puts(m, " (");
+		print_name_offset(m, (unsigned long)entry->expire_func);
+		seq_puts(m, ")\n");
+
+		wakeups += entry->wakeups;
+	}
+
+	ms += period.tv_sec * 1000;
+	if (!ms)
+		ms = 1;
+
+	if (wakeups && period.tv_sec)
+		seq_printf(m, "%ld total wakeups, %ld.%03ld wakeups/sec\n",
+			   wakeups, wakeups * 1000 / ms,
+			   (wakeups * 1000000 / ms) % 1000);
+	else
+		seq_printf(m, "%ld total wakeups\n", wakeups);
+
+	mutex_unlock(&show_mutex);
+
+	return 0;
+}
+
 /*
  * After a state change, make sure all concurrent lookup/update
  * activities have stopped:
@@ -405,6 +491,19 @@ static const struct file_operations tstats_fops = {
 	.release	= single_release,
 };
 
+static int twakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, twakeups_show, NULL);
+}
+
+static const struct file_operations twakeups_fops = {
+	.open		= twakeups_open,
+	.read		= seq_read,
+	.write		= tstats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void __init init_timer_stats(void)
 {
 	int cpu;
@@ -418,6 +517,9 @@ static int __init init_tstats_procfs(void)
 	struct proc_dir_entry *pe;
 
 	pe = proc_create("timer_stats", 0644, NULL, &tstats_fops);
+	if (!pe)
+		return -ENOMEM;
+	pe = proc_create("timer_wakeups", 0644, NULL, &twakeups_fops);
 	if (!pe)
 		return -ENOMEM;
 	return 0;
@@ -393,6 +393,8 @@ static void timer_stats_account_timer(struct timer_list *timer)
 		return;
 	if (unlikely(tbase_get_deferrable(timer->base)))
 		flag |= TIMER_STATS_FLAG_DEFERRABLE;
+	else if (timer_stats_idle_wakeup())
+		flag |= TIMER_STATS_FLAG_WAKEUP;
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
@@ -41,6 +41,10 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -254,16 +258,194 @@ struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
 struct workqueue_struct *system_nrt_freezable_wq __read_mostly;
+struct workqueue_struct *system_highpri_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+EXPORT_SYMBOL_GPL(system_highpri_wq);
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
 
+#ifdef CONFIG_WORKQUEUE_STATS
+/*
+ * Per work function execution time and queueing delay, in power of two
+ * microsecond buckets: bucket 0 is below 2us, the last one is 32ms and
+ * above.  Collection is off until 1 is written to the debugfs file.
+ */
+#define WQ_STATS_SLOTS		128
+#define WQ_STATS_BUCKETS	15
+
+struct wq_stat {
+	work_func_t		func;
+	unsigned long		count;
+	u64			exec_total;	/* ns */
+	u32			exec_max;	/* us */
+	u32			delay_max;	/* us */
+	u32			exec[WQ_STATS_BUCKETS];
+	u32			delay[WQ_STATS_BUCKETS];
+};
+
+static struct wq_stat wq_stats[WQ_STATS_SLOTS];
+static unsigned long wq_stats_dropped;
+static DEFINE_RAW_SPINLOCK(wq_stats_lock);
+static bool wq_stats_active __read_mostly;
+
+static inline void wq_stats_queued(struct work_struct *work)
+{
+	if (wq_stats_active)
+		work->queued = local_clock();
+	else
+		work->queued = 0;
+}
+
+static unsigned int wq_stats_bucket(u32 us)
+{
+	return min_t(unsigned int, fls(us >> 1), WQ_STATS_BUCKETS - 1);
+}
+
+static struct wq_stat *wq_stats_slot(work_func_t func)
+{
+	unsigned int i = hash_ptr(func, ilog2(WQ_STATS_SLOTS));
+	unsigned int n;
+
+	for (n = 0; n < WQ_STATS_SLOTS; n++, i = (i + 1) % WQ_STATS_SLOTS) {
+		if (wq_stats[i].func == func)
+			return &wq_stats[i];
+		if (!wq_stats[i].func) {
+			wq_stats[i].func = func;
+			return &wq_stats[i];
+		}
+	}
+	return NULL;
+}
+
+static void wq_stats_account(work_func_t func, u64 queued, u64 start,
+			     u64 end)
+{
+	struct wq_stat *st;
+	unsigned long flags;
+	u64 exec = end - start;
+	u32 exec_us = min_t(u64, div_u64(exec, NSEC_PER_USEC), UINT_MAX);
+	u32 delay_us = 0;
+
+	if (queued && start > queued)
+		delay_us = min_t(u64, div_u64(start - queued, NSEC_PER_USEC),
+				 UINT_MAX);
+
+	raw_spin_lock_irqsave(&wq_stats_lock, flags);
+	st = wq_stats_slot(func);
+	if (st) {
+		st->count++;
+		st->exec_total += exec;
+		st->exec_max = max(st->exec_max, exec_us);
+		st->exec[wq_stats_bucket(exec_us)]++;
+		if (queued) {
+			st->delay_max = max(st->delay_max, delay_us);
+			st->delay[wq_stats_bucket(delay_us)]++;
+		}
+	} else {
+		wq_stats_dropped++;
+	}
+	raw_spin_unlock_irqrestore(&wq_stats_lock, flags);
+}
+
+static int wq_stats_show(struct seq_file *s, void *unused)
+{
+	struct wq_stat *st;
+	int i, b;
+
+	seq_printf(s, "Workqueue statistics (%s), dropped %lu\n",
+		   wq_stats_active ? "active" : "inactive", wq_stats_dropped);
+	seq_printf(s, "buckets are power of two microseconds, from <2us\n");
+
+	st = kmalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	for (i = 0; i < WQ_STATS_SLOTS; i++) {
+		raw_spin_lock_irq(&wq_stats_lock);
+		*st = wq_stats[i];
+		raw_spin_unlock_irq(&wq_stats_lock);
+
+		if (!st->func || !st->count)
+			continue;
+
+		seq_printf(s, "\n%pf: count %lu avg %lluus max %uus "
+			   "max delay %uus\n  exec ", st->func, st->count,
+			   div64_u64(st->exec_total,
+				     (u64)st->count * NSEC_PER_USEC),
+			   st->exec_max, st->delay_max);
+		for (b = 0; b < WQ_STATS_BUCKETS; b++)
+			seq_printf(s, " %u", st->exec[b]);
+		seq_printf(s, "\n  delay");
+		for (b = 0; b < WQ_STATS_BUCKETS; b++)
+			seq_printf(s, " %u", st->delay[b]);
+		seq_putc(s, '\n');
+	}
+
+	kfree(st);
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_show, NULL);
+}
+
+/* "1" clears and starts collection, "0" stops it */
+static ssize_t wq_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	char c;
+
+	if (!count)
+		return 0;
+	if (get_user(c, buf))
+		return -EFAULT;
+
+	switch (c) {
+	case '0':
+		wq_stats_active = false;
+		break;
+	case '1':
+		raw_spin_lock_irq(&wq_stats_lock);
+		memset(wq_stats, 0, sizeof(wq_stats));
+		wq_stats_dropped = 0;
+		raw_spin_unlock_irq(&wq_stats_lock);
+		wq_stats_active = true;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.write		= wq_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	debugfs_create_file("workqueue_stats", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &wq_stats_fops);
+	return 0;
+}
+late_initcall(wq_stats_init);
+#else
+static inline void wq_stats_queued(struct work_struct *work)
+{
+}
+#endif
+
 #define for_each_busy_worker(worker, i, pos, gcwq)			\
 	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)			\
 		hlist_for_each_entry(worker, pos, &gcwq->busy_hash[i], hentry)
@@ -924,6 +1106,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	wq_stats_queued(work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1807,6 +1990,10 @@ __acquires(&gcwq->lock)
 	work_func_t f = work->func;
 	int work_color;
 	struct worker *collision;
+#ifdef CONFIG_WORKQUEUE_STATS
+	u64 queued = work->queued;
+	u64 start = 0;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -1870,7 +2057,15 @@ __acquires(&gcwq->lock)
 	lock_map_acquire_read(&cwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	trace_workqueue_execute_start(work);
+#ifdef CONFIG_WORKQUEUE_STATS
+	if (wq_stats_active)
+		start = local_clock();
+#endif
 	f(work);
+#ifdef CONFIG_WORKQUEUE_STATS
+	if (start)
+		wq_stats_account(f, queued, start, local_clock());
+#endif
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -3860,9 +4055,10 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_highpri_wq = alloc_workqueue("events_highpri", WQ_HIGHPRI, 0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_highpri_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
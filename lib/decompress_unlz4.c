@@ -0,0 +1,167 @@
+/*
+ * Wrapper for decompressing LZ4-compressed kernel, initramfs, and initrd
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The input is in the legacy format written by "lz4c -l": a little endian
+ * magic number, then blocks of up to 8 MiB of data, each preceded by its
+ * little endian compressed size.  Concatenated streams start over with
+ * the magic.  Kbuild appends the uncompressed size to kernel images, whose
+ * last four bytes are therefore not a block.
+ */
+
+#ifdef STATIC
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+#include <linux/compiler.h>
+
+#include <asm/unaligned.h>
+
+#define LZ4_LEGACY_MAGIC	0x184c2102
+#define LZ4_LEGACY_BLOCK_SIZE	(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error) (char *x))
+{
+	int ret = -1;
+	size_t chunksize = 0;
+	size_t uncomp_chunksize = LZ4_LEGACY_BLOCK_SIZE;
+	u8 *inp;
+	u8 *inp_start;
+	u8 *outp;
+	int size = in_len;
+	size_t out_len;
+
+	if (output) {
+		outp = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit_0;
+	} else {
+		outp = large_malloc(uncomp_chunksize);
+		if (!outp) {
+			error("Could not allocate output buffer");
+			goto exit_0;
+		}
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided, don't know what to do");
+		goto exit_1;
+	} else if (input) {
+		inp = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		inp = large_malloc(lz4_compressbound(uncomp_chunksize));
+		if (!inp) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+	}
+	inp_start = inp;
+
+	if (posp)
+		*posp = 0;
+
+	if (fill) {
+		size = fill(inp, 4);
+		if (size < 4) {
+			error("data corrupted");
+			goto exit_2;
+		}
+	}
+
+	if (get_unaligned_le32(inp) != LZ4_LEGACY_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	inp += 4;
+	size -= 4;
+	if (posp)
+		*posp += 4;
+
+	for (;;) {
+		if (fill) {
+			inp = inp_start;
+			size = fill(inp, 4);
+			/* end of the stream */
+			if (size == 0)
+				break;
+			if (size < 4) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		} else if (size <= 4) {
+			/* end of input, or the size appended by kbuild */
+			break;
+		}
+
+		chunksize = get_unaligned_le32(inp);
+		inp += 4;
+		size -= 4;
+		if (posp)
+			*posp += 4;
+
+		if (chunksize == LZ4_LEGACY_MAGIC)
+			continue;
+
+		if (chunksize > lz4_compressbound(uncomp_chunksize)) {
+			error("chunk length is longer than allowed");
+			goto exit_2;
+		}
+
+		if (fill) {
+			size = fill(inp, chunksize);
+			if (size < (int)chunksize) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		} else if (chunksize > (size_t)size) {
+			error("data corrupted");
+			goto exit_2;
+		}
+
+		out_len = uncomp_chunksize;
+		if (lz4_decompress_unknownoutputsize(inp, chunksize,
+						     outp, &out_len) < 0) {
+			error("Decoding failed");
+			goto exit_2;
+		}
+
+		if (flush && flush(outp, out_len) != out_len)
+			goto exit_2;
+		if (output)
+			outp += out_len;
+		if (posp)
+			*posp += chunksize;
+
+		inp += chunksize;
+		size -= chunksize;
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(inp_start);
+exit_1:
+	if (!output)
+		large_free(outp);
+exit_0:
+	return ret;
+}
+
+#define decompress unlz4
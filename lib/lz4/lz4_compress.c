@@ -0,0 +1,174 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Greedy single pass compressor for the LZ4 block format.  Positions of
+ * the 4 byte sequences seen so far are kept in a small hash table; a hit
+ * that really matches is extended as far as it goes, and the search steps
+ * further ahead the longer it goes without a hit, so that incompressible
+ * data is skipped over quickly.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const u8 *p)
+{
+	return (LZ4_READ32(p) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/*
+ * Look up the previous occurrence of the sequence at @ip and make @ip
+ * the latest one.  The table holds offsets from @base; it is not cleared
+ * between calls, so entries are only trusted if they point back into the
+ * window of this input.
+ */
+static inline const u8 *lz4_find(u32 *table, const u8 *base, const u8 *ip)
+{
+	u32 h = lz4_hash(ip);
+	u32 pos = ip - base;
+	u32 ref = table[h];
+
+	table[h] = pos;
+	if (ref >= pos || pos - ref > MAX_DISTANCE)
+		return NULL;
+	if (LZ4_READ32(base + ref) != LZ4_READ32(ip))
+		return NULL;
+	return base + ref;
+}
+
+static inline u8 *lz4_put_length(u8 *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+static u8 *lz4_put_literals(u8 *op, u8 *token, const u8 *anchor, size_t len)
+{
+	if (len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*token = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	return op + len;
+}
+
+static inline const u8 *lz4_extend(const u8 *ip, const u8 *ref,
+				   const u8 *limit)
+{
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(__LITTLE_ENDIAN)
+	while (ip + 4 <= limit) {
+		u32 diff = LZ4_READ32(ip) ^ LZ4_READ32(ref);
+
+		if (diff)
+			return ip + (__ffs(diff) >> 3);
+		ip += 4;
+		ref += 4;
+	}
+#endif
+	while (ip < limit && *ip == *ref) {
+		ip++;
+		ref++;
+	}
+	return ip;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	const u8 *const iend = src + src_len;
+	const u8 *const mflimit = iend - MFLIMIT;
+	const u8 *const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst;
+	u32 *table = wrkmem;
+	const u8 *ref;
+	u8 *token;
+
+	if (src_len < MIN_LENGTH)
+		goto last_literals;
+
+	/* positions are kept as u32 offsets from src */
+	if (src_len > (size_t)0xffffffffU - MAX_DISTANCE)
+		return -1;
+
+	lz4_find(table, src, ip++);
+
+	for (;;) {
+		unsigned int attempts = 1 << SKIP_STRENGTH;
+		const u8 *forward = ip;
+		size_t len;
+
+		/* find a match */
+		do {
+			ip = forward;
+			forward += attempts++ >> SKIP_STRENGTH;
+			if (unlikely(forward > mflimit))
+				goto last_literals;
+			ref = lz4_find(table, src, ip);
+		} while (!ref);
+
+		/* match backwards into the pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		token = op++;
+		op = lz4_put_literals(op, token, anchor, ip - anchor);
+
+next_match:
+		/* offset, then the match itself */
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		anchor = ip;
+		ip = lz4_extend(ip + MINMATCH, ref + MINMATCH, matchlimit);
+		len = ip - anchor - MINMATCH;
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token += len;
+		}
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		/* fill the table and try right away for another match */
+		lz4_find(table, src, ip - 2);
+		ref = lz4_find(table, src, ip);
+		if (ref) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		ip++;
+	}
+
+last_literals:
+	token = op++;
+	op = lz4_put_literals(op, token, anchor, iend - anchor);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
@@ -0,0 +1,142 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Every length and offset is checked against the input and output
+ * buffers, so corrupted or malicious blocks are rejected rather than
+ * read or written out of bounds.  This file is also built into boot
+ * decompressors through lib/decompress_unlz4.c, hence STATIC.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+#include <linux/compiler.h>
+#include <linux/types.h>
+#include <linux/lz4.h>
+
+#include "lz4defs.h"
+
+/*
+ * Copy a match @offset bytes back.  Source and destination overlap when
+ * the match is longer than the offset, which word copies handle as long
+ * as the offset is at least a word: every word read was written before.
+ */
+static inline u8 *lz4_copy_match(u8 *op, const u8 *ref, size_t len,
+				 size_t offset)
+{
+	u8 *const end = op + len;
+
+	if (offset >= 4) {
+		while (end - op >= 4) {
+			LZ4_WRITE32(LZ4_READ32(ref), op);
+			op += 4;
+			ref += 4;
+		}
+	}
+	while (op < end)
+		*op++ = *ref++;
+
+	return end;
+}
+
+static inline int lz4_get_length(const u8 **ip, const u8 *iend, size_t *len)
+{
+	const u8 *p = *ip;
+	unsigned int s;
+
+	do {
+		if (unlikely(p >= iend))
+			return -1;
+		s = *p++;
+		*len += s;
+	} while (s == 255);
+
+	*ip = p;
+	return 0;
+}
+
+static int lz4_uncompress(const u8 *src, size_t src_len,
+			  u8 *dest, size_t *dest_len)
+{
+	const u8 *ip = src;
+	const u8 *const iend = src + src_len;
+	u8 *op = dest;
+	u8 *const oend = dest + *dest_len;
+
+	for (;;) {
+		unsigned int token;
+		size_t len, offset;
+
+		if (unlikely(ip >= iend))
+			return -1;
+		token = *ip++;
+
+		/* literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_get_length(&ip, iend, &len))
+			return -1;
+		if (unlikely(len > (size_t)(iend - ip) ||
+			     len > (size_t)(oend - op)))
+			return -1;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence ends with its literals */
+		if (ip == iend)
+			break;
+
+		/* match */
+		if (unlikely(iend - ip < 2))
+			return -1;
+		offset = LZ4_READ16_LE(ip);
+		ip += 2;
+		if (unlikely(!offset || offset > (size_t)(op - dest)))
+			return -1;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_get_length(&ip, iend, &len))
+			return -1;
+		len += MINMATCH;
+		if (unlikely(len > (size_t)(oend - op)))
+			return -1;
+		op = lz4_copy_match(op, op - offset, len, offset);
+	}
+
+	*dest_len = op - dest;
+	return 0;
+}
+
+int lz4_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t actual_dest_len)
+{
+	size_t len = actual_dest_len;
+
+	if (lz4_uncompress(src, src_len, dest, &len) < 0 ||
+	    len != actual_dest_len)
+		return -1;
+
+	return 0;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress);
+#endif
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	return lz4_uncompress(src, src_len, dest, dest_len);
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
@@ -0,0 +1,46 @@
+/*
+ * lz4defs.h -- architecture specific defines
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/unaligned.h>
+
+/*
+ * Format of an LZ4 block: a sequence of
+ *
+ *	token | [literal length bytes] | literals | offset | [match length bytes]
+ *
+ * The high nibble of the token is the literal count and the low nibble the
+ * match length minus MINMATCH; a nibble of 15 is extended by the following
+ * bytes, each added to it, up to the first one that is not 255.  The offset
+ * is little endian and counts back from the output position.  The last
+ * sequence of a block has literals only, and the format keeps the last
+ * LASTLITERALS bytes literal and starts no match within the last MFLIMIT
+ * bytes, so decoders can copy in words near the end.
+ */
+#define MINMATCH	4
+#define LASTLITERALS	5
+#define MFLIMIT		(8 + MINMATCH)
+#define MIN_LENGTH	(MFLIMIT + 1)
+
+#define MAX_DISTANCE	((1 << 16) - 1)
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define LZ4_HASH_LOG	12
+#define LZ4_HASH_SIZE	(1 << LZ4_HASH_LOG)
+
+/* the search step grows by one every 1 << SKIP_STRENGTH misses */
+#define SKIP_STRENGTH	6
+
+#define LZ4_READ32(p)		get_unaligned((const u32 *)(p))
+#define LZ4_WRITE32(v, p)	put_unaligned((v), (u32 *)(p))
+#define LZ4_READ16_LE(p)	get_unaligned_le16(p)
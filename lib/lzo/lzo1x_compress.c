@@ -17,6 +17,22 @@
 #include <asm/unaligned.h>
 #include "lzodefs.h"
 
+static inline unsigned char *lzo_copy_literals(unsigned char *op,
+		const unsigned char *ii, size_t t)
+{
+#ifdef LZO_FAST_UNALIGNED
+	for (; t >= 4; t -= 4, op += 4, ii += 4)
+		COPY4(op, ii);
+	if (!t)
+		return op;
+#endif
+	do {
+		*op++ = *ii++;
+	} while (--t > 0);
+
+	return op;
+}
+
 static noinline size_t
 _lzo1x_1_do_compress(const unsigned char *in, size_t in_len,
 		unsigned char *out, size_t *out_len, void *wrkmem)
@@ -93,9 +109,8 @@ match:
 				}
 				*op++ = tt;
 			}
-			do {
-				*op++ = *ii++;
-			} while (--t > 0);
+			op = lzo_copy_literals(op, ii, t);
+			ii += t;
 		}
 
 		ip += 3;
@@ -125,6 +140,20 @@ match:
 			end = in_end;
 			m = m_pos + M2_MAX_LEN + 1;
 
+#if defined(LZO_FAST_UNALIGNED) && defined(__LITTLE_ENDIAN)
+			while (end - ip >= 4) {
+				u32 diff = lzo_load32(m) ^ lzo_load32(ip);
+
+				if (diff) {
+					/* lowest differing byte comes first */
+					ip += __ffs(diff) >> 3;
+					m += __ffs(diff) >> 3;
+					break;
+				}
+				m += 4;
+				ip += 4;
+			}
+#endif
 			while (ip < end && *m == *ip) {
 				m++;
 				ip++;
@@ -207,9 +236,7 @@ int lzo1x_1_compress(const unsigned char *in, size_t in_len, unsigned char *out,
 
 			*op++ = tt;
 		}
-		do {
-			*op++ = *ii++;
-		} while (--t > 0);
+		op = lzo_copy_literals(op, ii, t);
 	}
 
 	*op++ = M4_MARKER | 1;
@@ -24,8 +24,12 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+/*
+ * With fast unaligned accesses, runs are copied a word at a time when the
+ * buffers have room for the last word to overshoot the run by up to three
+ * bytes.  The bytes written past the end of a run are overwritten by the
+ * next one, or lie past *out_len if the run was the last.
+ */
 
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
@@ -72,6 +76,22 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
+#ifdef LZO_FAST_UNALIGNED
+		if (!HAVE_OP(t + 3 + 3, op_end, op) &&
+		    !HAVE_IP(t + 4 + 3, ip_end, ip)) {
+			unsigned char * const end = op + t + 3;
+
+			do {
+				COPY4(op, ip);
+				op += 4;
+				ip += 4;
+			} while (op < end);
+			ip -= op - end;
+			op = end;
+			goto first_literal_run;
+		}
+#endif
+
 		COPY4(op, ip);
 		op += 4;
 		ip += 4;
@@ -183,6 +203,22 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
+#ifdef LZO_FAST_UNALIGNED
+			/* a word never reads bytes it writes if 4 apart */
+			if ((op - m_pos) >= 4 &&
+			    !HAVE_OP(t + 3 - 1 + 3, op_end, op)) {
+				unsigned char * const end = op + t + 3 - 1;
+
+				do {
+					COPY4(op, m_pos);
+					op += 4;
+					m_pos += 4;
+				} while (op < end);
+				op = end;
+				goto match_done;
+			}
+#endif
+
 			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
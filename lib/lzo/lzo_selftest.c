@@ -0,0 +1,197 @@
+/*
+ * lib/lzo/lzo_selftest.c - boot time check and benchmark of the LZO code
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Round trips buffers of zeroes, random bytes and LZ friendly data of
+ * assorted lengths and alignments through lzo1x_1_compress() and
+ * lzo1x_decompress_safe(), checks that truncated input and short output
+ * buffers are caught without writing past the output buffer, then reports
+ * the compression and decompression speed on 4 KiB pages, as zram sees it.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#define LZO_TEST_SIZE	65536
+#define LZO_TEST_GUARD	16
+#define LZO_TEST_LOOPS	16
+
+/* where the speed test keeps the compressed page at @off */
+#define LZO_TEST_SLOT(off) \
+	((off) / PAGE_SIZE * lzo1x_worst_compress(PAGE_SIZE))
+
+enum { LZO_TEST_ZERO, LZO_TEST_RANDOM, LZO_TEST_TEXT, LZO_TEST_PATTERNS };
+
+static const char * const lzo_test_names[LZO_TEST_PATTERNS] = {
+	"zero", "random", "text",
+};
+
+static const size_t lzo_test_lens[] = {
+	1, 3, 4, 17, 18, 19, 64, 238, 239, 1000, 4095, 4096, LZO_TEST_SIZE,
+};
+
+/* src, compressed and decompressed buffers, with room to misalign */
+static unsigned char *src, *cmp, *dec;
+static void *wrkmem;
+
+static void __init lzo_test_fill(int pattern, struct rnd_state *rnd)
+{
+	size_t i, dist, len;
+
+	switch (pattern) {
+	case LZO_TEST_ZERO:
+		memset(src, 0, LZO_TEST_SIZE + 4);
+		break;
+	case LZO_TEST_RANDOM:
+		for (i = 0; i < LZO_TEST_SIZE + 4; i++)
+			src[i] = prandom32(rnd);
+		break;
+	case LZO_TEST_TEXT:
+		/* literals from a small alphabet, and copies from the past */
+		for (i = 0; i < LZO_TEST_SIZE + 4; ) {
+			u32 r = prandom32(rnd);
+
+			dist = 1 + (r >> 16) % min_t(size_t, i ? i : 1, 0xbfff);
+			len = 1 + (r & 0xff) % 40;
+			if (i < 64 || (r & 0x300) == 0) {
+				src[i++] = 'a' + (r >> 8) % 16;
+				continue;
+			}
+			while (len-- && i < LZO_TEST_SIZE + 4) {
+				src[i] = src[i - dist];
+				i++;
+			}
+		}
+		break;
+	}
+}
+
+static int __init lzo_test_one(const unsigned char *in, size_t len,
+			       unsigned int dec_align)
+{
+	unsigned char *out = dec + dec_align;
+	size_t cmp_len, dec_len;
+	int ret, errors = 0;
+
+	ret = lzo1x_1_compress(in, len, cmp, &cmp_len, wrkmem);
+	if (ret != LZO_E_OK || cmp_len > lzo1x_worst_compress(len))
+		return 1;
+
+	memset(out, 0xa5, len + LZO_TEST_GUARD);
+	dec_len = len;
+	ret = lzo1x_decompress_safe(cmp, cmp_len, out, &dec_len);
+	if (ret != LZO_E_OK || dec_len != len || memcmp(in, out, len))
+		errors++;
+	if (memchr_inv(out + len, 0xa5, LZO_TEST_GUARD))
+		errors++;
+
+	/* one byte short of input */
+	dec_len = len;
+	ret = lzo1x_decompress_safe(cmp, cmp_len - 1, out, &dec_len);
+	if (ret == LZO_E_OK)
+		errors++;
+
+	/* one byte short of output, which must not be written past */
+	memset(out, 0xa5, len + LZO_TEST_GUARD);
+	dec_len = len - 1;
+	ret = lzo1x_decompress_safe(cmp, cmp_len, out, &dec_len);
+	if (ret != LZO_E_OUTPUT_OVERRUN ||
+	    memchr_inv(out + len - 1, 0xa5, LZO_TEST_GUARD))
+		errors++;
+
+	return errors;
+}
+
+static u64 __init lzo_test_speed(const unsigned char *in, bool decompress)
+{
+	size_t cmp_lens[LZO_TEST_SIZE / PAGE_SIZE];
+	size_t off, dec_len;
+	ktime_t start;
+	int i;
+
+	for (off = 0; off < LZO_TEST_SIZE; off += PAGE_SIZE)
+		lzo1x_1_compress(in + off, PAGE_SIZE,
+				 cmp + LZO_TEST_SLOT(off),
+				 &cmp_lens[off / PAGE_SIZE], wrkmem);
+
+	start = ktime_get();
+	for (i = 0; i < LZO_TEST_LOOPS; i++) {
+		for (off = 0; off < LZO_TEST_SIZE; off += PAGE_SIZE) {
+			if (decompress) {
+				dec_len = PAGE_SIZE;
+				lzo1x_decompress_safe(
+					cmp + LZO_TEST_SLOT(off),
+					cmp_lens[off / PAGE_SIZE],
+					dec + off, &dec_len);
+			} else {
+				lzo1x_1_compress(in + off, PAGE_SIZE,
+					cmp + LZO_TEST_SLOT(off),
+					&cmp_lens[off / PAGE_SIZE], wrkmem);
+			}
+		}
+	}
+
+	/* MB/s */
+	return div64_u64((u64)LZO_TEST_LOOPS * LZO_TEST_SIZE * NSEC_PER_USEC,
+			 max_t(s64, 1, ktime_to_ns(ktime_sub(ktime_get(),
+							     start))));
+}
+
+static int __init lzo_selftest(void)
+{
+	struct rnd_state rnd;
+	int pattern, errors = 0;
+	unsigned int i, align;
+
+	src = vmalloc(LZO_TEST_SIZE + 4);
+	cmp = vmalloc(LZO_TEST_SLOT(LZO_TEST_SIZE));
+	dec = vmalloc(LZO_TEST_SIZE + 4 + LZO_TEST_GUARD);
+	wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	if (!src || !cmp || !dec || !wrkmem) {
+		pr_warn("lzo: no memory for the self test\n");
+		goto out;
+	}
+
+	prandom32_seed(&rnd, 0x4c5a4f31);
+
+	for (pattern = 0; pattern < LZO_TEST_PATTERNS; pattern++) {
+		lzo_test_fill(pattern, &rnd);
+
+		for (i = 0; i < ARRAY_SIZE(lzo_test_lens); i++)
+			for (align = 0; align < 4; align++)
+				errors += lzo_test_one(src + align,
+						lzo_test_lens[i], 3 - align);
+
+		/* the random data is only there to break the compressor */
+		if (pattern == LZO_TEST_RANDOM)
+			continue;
+		pr_info("lzo: %s data: compress %llu MB/s, decompress %llu MB/s\n",
+			lzo_test_names[pattern], lzo_test_speed(src, false),
+			lzo_test_speed(src, true));
+	}
+
+	if (errors)
+		pr_warn("lzo: %d self tests failed\n", errors);
+	else
+		pr_info("lzo: self tests passed\n");
+
+out:
+	vfree(wrkmem);
+	vfree(dec);
+	vfree(cmp);
+	vfree(src);
+	return 0;
+}
+late_initcall(lzo_selftest);
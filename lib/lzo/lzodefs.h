@@ -41,3 +41,35 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * 32-bit loads and stores at any alignment.  ARMv6 and later handle
+ * unaligned ldr/str in hardware once alignment_init() has cleared SCTLR.A,
+ * which the boot decompressor (STATIC) cannot rely on; as GCC only emits
+ * unaligned word accesses for packed structures from 4.7 onwards, say it
+ * explicitly.  Elsewhere fall back to get/put_unaligned(), byte by byte
+ * where the architecture has no efficient unaligned access.
+ */
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+static inline u32 lzo_load32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lzo_store32(void *p, u32 v)
+{
+	asm volatile("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+#define LZO_FAST_UNALIGNED	1
+#else
+#define lzo_load32(p)		get_unaligned((const u32 *)(p))
+#define lzo_store32(p, v)	put_unaligned((v), (u32 *)(p))
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+#define LZO_FAST_UNALIGNED	1
+#endif
+#endif
+
+#define COPY4(dst, src)		lzo_store32((dst), lzo_load32(src))
@@ -12,6 +12,31 @@
 #include <linux/ratelimit.h>
 #include <linux/jiffies.h>
 #include <linux/export.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+/*
+ * Built-in ratelimit states that have suppressed something, most recent
+ * first.  States in modules or dynamic memory may go away and are only
+ * counted, not listed.
+ */
+static DEFINE_RAW_SPINLOCK(ratelimit_list_lock);
+static struct ratelimit_state *ratelimit_list;
+
+static void ratelimit_account(struct ratelimit_state *rs, const char *func)
+{
+	rs->suppressed++;
+	if (rs->func || !core_kernel_data((unsigned long)rs))
+		return;
+
+	raw_spin_lock(&ratelimit_list_lock);
+	rs->func = func;
+	rs->next = ratelimit_list;
+	ratelimit_list = rs;
+	raw_spin_unlock(&ratelimit_list_lock);
+}
 
 /*
  * __ratelimit - rate limiting
@@ -58,6 +83,7 @@ int ___ratelimit(struct ratelimit_state *rs, const char *func)
 		ret = 1;
 	} else {
 		rs->missed++;
+		ratelimit_account(rs, func);
 		ret = 0;
 	}
 	raw_spin_unlock_irqrestore(&rs->lock, flags);
@@ -65,3 +91,38 @@ int ___ratelimit(struct ratelimit_state *rs, const char *func)
 	return ret;
 }
 EXPORT_SYMBOL(___ratelimit);
+
+#ifdef CONFIG_DEBUG_FS
+static int ratelimit_show(struct seq_file *s, void *unused)
+{
+	struct ratelimit_state *rs;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&ratelimit_list_lock, flags);
+	for (rs = ratelimit_list; rs; rs = rs->next)
+		seq_printf(s, "%10lu %s\n", rs->suppressed, rs->func);
+	raw_spin_unlock_irqrestore(&ratelimit_list_lock, flags);
+
+	return 0;
+}
+
+static int ratelimit_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ratelimit_show, NULL);
+}
+
+static const struct file_operations ratelimit_fops = {
+	.open		= ratelimit_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ratelimit_debugfs_init(void)
+{
+	debugfs_create_file("ratelimit", S_IRUGO, NULL, NULL,
+			    &ratelimit_fops);
+	return 0;
+}
+late_initcall(ratelimit_debugfs_init);
+#endif
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpufreq.h>
 #include "internal.h"
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -555,6 +558,24 @@ static u32 isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+/* Free blocks of at least @order in @zone, counted in units of @order */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long nr = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		nr += zone->free_area[o].nr_free << (o - order);
+	return nr;
+}
+
+/* Background compaction gives way to anything the user is waiting for */
+static bool kcompactd_should_yield(void)
+{
+	return kthread_should_stop() || freezing(current) ||
+	       cpufreq_interactive_is_busy();
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -568,6 +589,16 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	if (cc->proactive_blocks) {
+		if (kcompactd_should_yield()) {
+			count_vm_event(COMPACTPROACTIVEYIELD);
+			return COMPACT_PARTIAL;
+		}
+		if (zone_free_blocks(zone, cc->order) >= cc->proactive_blocks)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -650,7 +681,9 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 
-	ret = compaction_suitable(zone, cc->order);
+	/* kcompactd has already checked the zone against its own target */
+	ret = cc->proactive_blocks ? COMPACT_CONTINUE :
+				     compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -691,6 +724,9 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
+		if (cc->proactive_blocks)
+			count_vm_events(COMPACTPROACTIVEPAGES,
+					nr_migrate - nr_remaining);
 		if (nr_remaining)
 			count_vm_events(COMPACTPAGEFAILED, nr_remaining);
 		trace_mm_compaction_migratepages(nr_migrate - nr_remaining,
@@ -874,6 +910,130 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd: keep a supply of free blocks of sysctl_compact_proactive_order
+ * in every zone, so that high-order allocations (ion, skbs of the wireless
+ * drivers) find one without stalling in direct compaction.  It is woken
+ * by high-order allocations entering the slow path and by kswapd, and
+ * only compacts a zone when it is short of blocks but has the free memory
+ * to make them, i.e. when the shortage is fragmentation.  Compaction is
+ * asynchronous and gives way to foreground activity; a zone that could
+ * not be brought up to the target makes kcompactd back off exponentially,
+ * up to a minute, before it tries again.
+ */
+int sysctl_compact_proactive_order = 4;
+int sysctl_compact_proactive_blocks = 16;
+
+#define KCOMPACTD_MAX_BACKOFF_SHIFT	6
+
+static struct task_struct *kcompactd_task;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_pending;
+static unsigned long kcompactd_next_run;
+static unsigned int kcompactd_backoff_shift;
+
+static bool kcompactd_zone_needed(struct zone *zone, int order,
+				  unsigned long blocks)
+{
+	unsigned long free;
+
+	if (zone_free_blocks(zone, order) >= blocks)
+		return false;
+
+	/* room for the blocks and for the copies made while migrating */
+	free = zone_page_state(zone, NR_FREE_PAGES);
+	return free >= low_wmark_pages(zone) + ((2 * blocks) << order);
+}
+
+static void kcompactd_do_work(void)
+{
+	int order = sysctl_compact_proactive_order;
+	unsigned long blocks = sysctl_compact_proactive_blocks;
+	bool short_of_blocks = false;
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = false,
+			.proactive_blocks = blocks,
+		};
+
+		if (!kcompactd_zone_needed(zone, order, blocks))
+			continue;
+		if (kcompactd_should_yield())
+			break;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		count_vm_event(COMPACTPROACTIVE);
+		compact_zone(zone, &cc);
+
+		if (zone_free_blocks(zone, order) < blocks)
+			short_of_blocks = true;
+	}
+
+	if (short_of_blocks) {
+		if (kcompactd_backoff_shift < KCOMPACTD_MAX_BACKOFF_SHIFT)
+			kcompactd_backoff_shift++;
+	} else {
+		kcompactd_backoff_shift = 0;
+	}
+	kcompactd_next_run = jiffies + (HZ << kcompactd_backoff_shift);
+}
+
+static int kcompactd(void *unused)
+{
+	set_freezable();
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(kcompactd_wait,
+				kcompactd_pending || kthread_should_stop());
+		kcompactd_pending = false;
+		if (kthread_should_stop())
+			break;
+		if (sysctl_compact_proactive_blocks)
+			kcompactd_do_work();
+	}
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - let kcompactd check the supply of high-order blocks
+ *
+ * Cheap enough for the allocator slow path; can be called from atomic
+ * context.
+ */
+void wakeup_kcompactd(void)
+{
+	if (!kcompactd_task || !sysctl_compact_proactive_blocks)
+		return;
+	if (kcompactd_pending || time_before(jiffies, kcompactd_next_run))
+		return;
+	if (!waitqueue_active(&kcompactd_wait))
+		return;
+	kcompactd_pending = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("kcompactd: creating kthread failed\n");
+		return PTR_ERR(task);
+	}
+	kcompactd_next_run = jiffies;
+	kcompactd_task = task;
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -36,6 +36,8 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/cpufreq.h>
+#include <linux/earlysuspend.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -129,6 +131,8 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @age: number of scans since the page was last merged
+ * @remaining_skips: how many more scans will pass over this page
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -139,6 +143,8 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	u8 age;
+	u8 remaining_skips;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -189,6 +195,17 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Skip pages which keep failing to merge, see should_skip_rmap_item() */
+static bool ksm_smart_scan = true;
+
+/* The number of pages passed over by the smart scan */
+static unsigned long ksm_pages_skipped;
+
+/* Leave the CPU to the user while the screen is on or it is busy */
+static bool ksm_defer_screen_on = true;
+static bool ksm_defer_busy = true;
+static bool ksm_screen_on;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -1150,11 +1167,54 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
  * rmap_items hanging off a given node of the stable tree, all sharing
  * the same ksm page.
  */
+/*
+ * The longer a page has gone without merging, the more full scans pass
+ * over it, up to 8.  Pages whose content keeps changing never get past
+ * the checksum test, so they age and fall behind the same way.  Merged
+ * pages are not skipped: they are cheap to look at, and a COW breaking
+ * their sharing is worth noticing early.
+ */
+static unsigned int skip_age(u8 age)
+{
+	if (age <= 3)
+		return 1;
+	if (age <= 5)
+		return 2;
+	if (age <= 8)
+		return 4;
+	return 8;
+}
+
+static bool should_skip_rmap_item(struct page *page,
+				  struct rmap_item *rmap_item)
+{
+	u8 age;
+
+	if (!ksm_smart_scan || PageKsm(page))
+		return false;
+
+	age = rmap_item->age;
+	if (age != (u8)~0)
+		rmap_item->age++;
+	if (age < 3)
+		return false;
+
+	if (rmap_item->remaining_skips) {
+		rmap_item->remaining_skips--;
+		ksm_pages_skipped++;
+		return true;
+	}
+	rmap_item->remaining_skips = skip_age(age);
+	return false;
+}
+
 static void stable_tree_append(struct rmap_item *rmap_item,
 			       struct stable_node *stable_node)
 {
 	rmap_item->head = stable_node;
 	rmap_item->address |= STABLE_FLAG;
+	rmap_item->age = 0;
+	rmap_item->remaining_skips = 0;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
 
 	if (rmap_item->hlist.next)
@@ -1351,6 +1411,12 @@ next_mm:
 					ksm_scan.rmap_list =
 							&rmap_item->rmap_list;
 					ksm_scan.address += PAGE_SIZE;
+					if (should_skip_rmap_item(*page,
+								  rmap_item)) {
+						put_page(*page);
+						cond_resched();
+						continue;
+					}
 				} else
 					put_page(*page);
 				up_read(&mm->mmap_sem);
@@ -1429,6 +1495,8 @@ static void ksm_do_scan(unsigned int scan_npages)
 
 static int ksmd_should_run(void)
 {
+	if (ksm_defer_screen_on && ksm_screen_on)
+		return 0;
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
@@ -1439,7 +1507,8 @@ static int ksm_scan_thread(void *nothing)
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run() &&
+		    !(ksm_defer_busy && cpufreq_interactive_is_busy()))
 			ksm_do_scan(ksm_thread_pages_to_scan);
 		mutex_unlock(&ksm_thread_mutex);
 
@@ -1456,6 +1525,25 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_screen_on = false;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_screen_on = true;
+}
+
+static struct early_suspend ksm_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+	.suspend = ksm_early_suspend,
+	.resume = ksm_late_resume,
+};
+#endif
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1926,6 +2014,37 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 KSM_ATTR(run);
 
+#define KSM_ATTR_BOOL(_name, _var) \
+static ssize_t _name##_show(struct kobject *kobj, \
+			    struct kobj_attribute *attr, char *buf) \
+{ \
+	return sprintf(buf, "%u\n", _var); \
+} \
+static ssize_t _name##_store(struct kobject *kobj, \
+			     struct kobj_attribute *attr, \
+			     const char *buf, size_t count) \
+{ \
+	unsigned long val; \
+\
+	if (strict_strtoul(buf, 10, &val) || val > 1) \
+		return -EINVAL; \
+	_var = val; \
+	wake_up_interruptible(&ksm_thread_wait); \
+	return count; \
+} \
+KSM_ATTR(_name)
+
+KSM_ATTR_BOOL(smart_scan, ksm_smart_scan);
+KSM_ATTR_BOOL(defer_screen_on, ksm_defer_screen_on);
+KSM_ATTR_BOOL(defer_busy, ksm_defer_busy);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -1980,6 +2099,10 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&smart_scan_attr.attr,
+	&pages_skipped_attr.attr,
+	&defer_screen_on_attr.attr,
+	&defer_busy_attr.attr,
 	NULL,
 };
 
@@ -2023,6 +2146,10 @@ static int __init ksm_init(void)
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	ksm_screen_on = true;
+	register_early_suspend(&ksm_early_suspend_desc);
 #endif
 	return 0;
 
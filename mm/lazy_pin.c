@@ -0,0 +1,266 @@
+/*
+ * mm/lazy_pin.c - incremental pinning of user buffers for drivers
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Drivers that map user buffers for their device usually get_user_pages()
+ * the whole buffer when it is registered, faulting in and pinning pages
+ * the device may only touch much later, if at all.  A lazy_pin records
+ * the range instead and pins it piecewise: on demand for the pages the
+ * device is about to access, and in batches from a workqueue for the rest.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/lazy_pin.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#define LAZY_PIN_BATCH	64
+
+/* protected by lazy_pin_stats_lock */
+static struct {
+	unsigned long	buffers;
+	unsigned long	demand_pages;
+	unsigned long	background_pages;
+	unsigned long	calls;
+	u64		time_ns;
+	u64		time_max_ns;
+} lazy_pin_stats;
+static DEFINE_SPINLOCK(lazy_pin_stats_lock);
+
+static void lazy_pin_account(unsigned long nr, bool background, u64 ns)
+{
+	spin_lock(&lazy_pin_stats_lock);
+	if (background)
+		lazy_pin_stats.background_pages += nr;
+	else
+		lazy_pin_stats.demand_pages += nr;
+	lazy_pin_stats.calls++;
+	lazy_pin_stats.time_ns += ns;
+	if (ns > lazy_pin_stats.time_max_ns)
+		lazy_pin_stats.time_max_ns = ns;
+	spin_unlock(&lazy_pin_stats_lock);
+}
+
+/*
+ * Pin the pages in [first, first + nr) that are not pinned yet, one
+ * get_user_pages() call per run of missing pages.  Called with pin->lock.
+ */
+static int __lazy_pin_pages(struct lazy_pin *pin, unsigned int first,
+			    unsigned int nr, bool background)
+{
+	struct mm_struct *mm = pin->mm;
+	unsigned int end = first + nr;
+	unsigned int i = first;
+	int ret = 0;
+
+	/* the buffer's mm may have exited under a background pin */
+	if (!atomic_inc_not_zero(&mm->mm_users))
+		return -EFAULT;
+
+	while (i < end) {
+		unsigned int run;
+		ktime_t start;
+
+		if (pin->pages[i]) {
+			i++;
+			continue;
+		}
+		for (run = 1; i + run < end && !pin->pages[i + run]; run++)
+			;
+
+		start = ktime_get();
+		down_read(&mm->mmap_sem);
+		ret = get_user_pages(background ? NULL : current, mm,
+				     pin->start + i * PAGE_SIZE, run,
+				     pin->write, 0, &pin->pages[i], NULL);
+		up_read(&mm->mmap_sem);
+		if (ret <= 0) {
+			ret = ret ? ret : -EFAULT;
+			break;
+		}
+		lazy_pin_account(ret, background,
+				 ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+		pin->nr_pinned += ret;
+		i += ret;
+		ret = 0;
+	}
+
+	mmput(mm);
+
+	return ret;
+}
+
+static void lazy_pin_work(struct work_struct *work)
+{
+	struct lazy_pin *pin = container_of(work, struct lazy_pin, work);
+	unsigned int nr;
+	int ret;
+
+	mutex_lock(&pin->lock);
+	nr = min_t(unsigned int, LAZY_PIN_BATCH, pin->nr_pages - pin->next);
+	ret = __lazy_pin_pages(pin, pin->next, nr, true);
+	if (!ret)
+		pin->next += nr;
+	mutex_unlock(&pin->lock);
+
+	/* one batch at a time, so the worker doesn't hog the mmap_sem */
+	if (!ret && pin->next < pin->nr_pages)
+		queue_work(system_unbound_wq, &pin->work);
+}
+
+/**
+ * lazy_pin_init() - register a user buffer for incremental pinning
+ * @pin:	the lazy_pin to set up
+ * @start:	page aligned start of the buffer in current's address space
+ * @nr_pages:	size of the buffer
+ * @write:	whether the device writes to the buffer
+ *
+ * Does not fault in or pin anything.
+ */
+int lazy_pin_init(struct lazy_pin *pin, unsigned long start,
+		  unsigned int nr_pages, int write)
+{
+	if (!current->mm || (start & ~PAGE_MASK) || !nr_pages)
+		return -EINVAL;
+
+	pin->pages = kcalloc(nr_pages, sizeof(struct page *), GFP_KERNEL);
+	if (!pin->pages)
+		return -ENOMEM;
+
+	pin->mm = current->mm;
+	atomic_inc(&pin->mm->mm_count);
+	pin->start = start;
+	pin->nr_pages = nr_pages;
+	pin->nr_pinned = 0;
+	pin->next = 0;
+	pin->write = write;
+	mutex_init(&pin->lock);
+	INIT_WORK(&pin->work, lazy_pin_work);
+
+	spin_lock(&lazy_pin_stats_lock);
+	lazy_pin_stats.buffers++;
+	spin_unlock(&lazy_pin_stats_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lazy_pin_init);
+
+/**
+ * lazy_pin_pages() - make sure a part of the buffer is pinned
+ * @pin:	the buffer
+ * @first:	first page needed by the device
+ * @nr:		number of pages needed
+ *
+ * Typically called right before the device accesses the pages, or when
+ * the device faults on them.  pin->pages[first .. first + nr - 1] are
+ * valid on success.
+ */
+int lazy_pin_pages(struct lazy_pin *pin, unsigned int first, unsigned int nr)
+{
+	int ret;
+
+	if (first >= pin->nr_pages || nr > pin->nr_pages - first)
+		return -EINVAL;
+
+	mutex_lock(&pin->lock);
+	ret = __lazy_pin_pages(pin, first, nr, false);
+	mutex_unlock(&pin->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lazy_pin_pages);
+
+/**
+ * lazy_pin_background() - pin the rest of the buffer from a workqueue
+ * @pin:	the buffer
+ *
+ * Pages are pinned LAZY_PIN_BATCH at a time.  The worker stops at the
+ * first page that cannot be pinned; lazy_pin_pages() then reports the
+ * error to the driver when it needs that page.
+ */
+void lazy_pin_background(struct lazy_pin *pin)
+{
+	queue_work(system_unbound_wq, &pin->work);
+}
+EXPORT_SYMBOL_GPL(lazy_pin_background);
+
+/**
+ * lazy_pin_release() - unpin whatever was pinned and forget the buffer
+ * @pin:	the buffer
+ */
+void lazy_pin_release(struct lazy_pin *pin)
+{
+	unsigned int i;
+
+	cancel_work_sync(&pin->work);
+
+	for (i = 0; i < pin->nr_pages; i++) {
+		struct page *page = pin->pages[i];
+
+		if (!page)
+			continue;
+		if (pin->write)
+			set_page_dirty_lock(page);
+		put_page(page);
+	}
+
+	kfree(pin->pages);
+	pin->pages = NULL;
+	mmdrop(pin->mm);
+}
+EXPORT_SYMBOL_GPL(lazy_pin_release);
+
+#ifdef CONFIG_DEBUG_FS
+static int lazy_pin_stats_show(struct seq_file *s, void *unused)
+{
+	u64 avg;
+
+	spin_lock(&lazy_pin_stats_lock);
+	avg = lazy_pin_stats.calls ?
+		div_u64(lazy_pin_stats.time_ns, lazy_pin_stats.calls) : 0;
+	seq_printf(s, "buffers %lu\n"
+		   "demand_pages %lu\n"
+		   "background_pages %lu\n"
+		   "calls %lu\n"
+		   "avg_us %llu\n"
+		   "max_us %llu\n",
+		   lazy_pin_stats.buffers, lazy_pin_stats.demand_pages,
+		   lazy_pin_stats.background_pages, lazy_pin_stats.calls,
+		   div_u64(avg, NSEC_PER_USEC),
+		   div_u64(lazy_pin_stats.time_max_ns, NSEC_PER_USEC));
+	spin_unlock(&lazy_pin_stats_lock);
+
+	return 0;
+}
+
+static int lazy_pin_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lazy_pin_stats_show, inode->i_private);
+}
+
+static const struct file_operations lazy_pin_stats_fops = {
+	.open = lazy_pin_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init lazy_pin_debugfs_init(void)
+{
+	debugfs_create_file("lazy_pin", 0444, NULL, NULL,
+			    &lazy_pin_stats_fops);
+	return 0;
+}
+late_initcall(lazy_pin_debugfs_init);
+#endif
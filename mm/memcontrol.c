@@ -98,6 +98,8 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_COUNT,	/* # of pages paged in/out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_PGREFAULT,	/* # of pages read back from swap */
+	MEM_CGROUP_EVENTS_PGSTEAL,	/* # of pages reclaimed */
 	MEM_CGROUP_EVENTS_NSTATS,
 };
 /*
@@ -1002,12 +1004,43 @@ void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
 	case PGMAJFAULT:
 		this_cpu_inc(memcg->stat->events[MEM_CGROUP_EVENTS_PGMAJFAULT]);
 		break;
+	case PSWPIN:
+		this_cpu_inc(memcg->stat->events[MEM_CGROUP_EVENTS_PGREFAULT]);
+		break;
 	default:
 		BUG();
 	}
 out:
 	rcu_read_unlock();
 }
+
+void mem_cgroup_count_reclaim(struct mem_cgroup *memcg,
+			      unsigned long nr_reclaimed)
+{
+	if (!memcg || !nr_reclaimed)
+		return;
+	this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGSTEAL],
+		     nr_reclaimed);
+}
+
+/*
+ * Returns true if @memcg, or one of its parents below @root, is using
+ * more than its soft limit.
+ */
+bool mem_cgroup_soft_limit_exceeded(struct mem_cgroup *root,
+				    struct mem_cgroup *memcg)
+{
+	if (mem_cgroup_disabled())
+		return true;
+
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		if (res_counter_soft_limit_excess(&memcg->res))
+			return true;
+		if (memcg == root)
+			break;
+	}
+	return false;
+}
 EXPORT_SYMBOL(mem_cgroup_count_vm_event);
 
 /**
@@ -4055,6 +4088,8 @@ enum {
 	MCS_SWAP,
 	MCS_PGFAULT,
 	MCS_PGMAJFAULT,
+	MCS_PGREFAULT,
+	MCS_PGSTEAL,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -4079,6 +4114,8 @@ struct {
 	{"swap", "total_swap"},
 	{"pgfault", "total_pgfault"},
 	{"pgmajfault", "total_pgmajfault"},
+	{"pgrefault", "total_pgrefault"},
+	{"pgsteal", "total_pgsteal"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -4111,6 +4148,10 @@ mem_cgroup_get_local_stat(struct mem_cgroup *memcg, struct mcs_total_stat *s)
 	s->stat[MCS_PGFAULT] += val;
 	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGMAJFAULT);
 	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGREFAULT);
+	s->stat[MCS_PGREFAULT] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGSTEAL);
+	s->stat[MCS_PGSTEAL] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_nr_lru_pages(memcg, BIT(LRU_INACTIVE_ANON));
@@ -202,21 +202,8 @@ static int __mlock_posix_error_return(long retval)
 	return retval;
 }
 
-/**
- * mlock_vma_pages_range() - mlock pages in specified vma range.
- * @vma - the vma containing the specfied address range
- * @start - starting address in @vma to mlock
- * @end   - end address [+1] in @vma to mlock
- *
- * For mmap()/mremap()/expansion of mlocked vma.
- *
- * return 0 on success for "normal" vmas.
- *
- * return number of pages [> 0] to be removed from locked_vm on success
- * of "special" vmas.
- */
-long mlock_vma_pages_range(struct vm_area_struct *vma,
-			unsigned long start, unsigned long end)
+static long __mlock_vma_range(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end, bool populate)
 {
 	int nr_pages = (end - start) / PAGE_SIZE;
 	BUG_ON(!(vma->vm_flags & VM_LOCKED));
@@ -231,7 +218,8 @@ long mlock_vma_pages_range(struct vm_area_struct *vma,
 			is_vm_hugetlb_page(vma) ||
 			vma == get_gate_vma(current->mm))) {
 
-		__mlock_vma_pages_range(vma, start, end, NULL);
+		if (populate)
+			__mlock_vma_pages_range(vma, start, end, NULL);
 
 		/* Hide errors from mmap() and other callers */
 		return 0;
@@ -252,6 +240,40 @@ no_mlock:
 	return nr_pages;		/* error or pages NOT mlocked */
 }
 
+/**
+ * mlock_vma_pages_range() - mlock pages in specified vma range.
+ * @vma - the vma containing the specfied address range
+ * @start - starting address in @vma to mlock
+ * @end   - end address [+1] in @vma to mlock
+ *
+ * For mmap()/mremap()/expansion of mlocked vma.
+ *
+ * return 0 on success for "normal" vmas.
+ *
+ * return number of pages [> 0] to be removed from locked_vm on success
+ * of "special" vmas.
+ */
+long mlock_vma_pages_range(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end)
+{
+	return __mlock_vma_range(vma, start, end, true);
+}
+
+/**
+ * mlock_vma_pages_range_lazy() - mlock a vma range without faulting it in.
+ *
+ * For mmap(MAP_LOCKED | MAP_NONBLOCK).  The vma is VM_LOCKED, so once
+ * a page is faulted in, reclaim never evicts it: the first time reclaim
+ * finds the page it moves it to the unevictable list.  Big mappings like
+ * the JIT code cache only cost what is actually touched.  Returns like
+ * mlock_vma_pages_range().
+ */
+long mlock_vma_pages_range_lazy(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end)
+{
+	return __mlock_vma_range(vma, start, end, false);
+}
+
 /*
  * munlock_vma_pages_range() - munlock all pages in the vma range.'
  * @vma - vma containing range to be munlock()ed.
@@ -1371,7 +1371,14 @@ out:
 	mm->total_vm += len >> PAGE_SHIFT;
 	vm_stat_account(mm, vm_flags, file, len >> PAGE_SHIFT);
 	if (vm_flags & VM_LOCKED) {
-		if (!mlock_vma_pages_range(vma, addr, addr + len))
+		long nr_special;
+
+		if (flags & MAP_NONBLOCK)
+			nr_special = mlock_vma_pages_range_lazy(vma, addr,
+								addr + len);
+		else
+			nr_special = mlock_vma_pages_range(vma, addr, addr + len);
+		if (!nr_special)
 			mm->locked_vm += (len >> PAGE_SHIFT);
 	} else if ((flags & MAP_POPULATE) && !(flags & MAP_NONBLOCK))
 		make_pages_present(addr, addr + len);
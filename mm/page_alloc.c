@@ -2315,6 +2315,8 @@ restart:
 	if (!(gfp_mask & __GFP_NO_KSWAPD))
 		wake_all_kswapd(order, zonelist, high_zoneidx,
 						zone_idx(preferred_zone));
+	if (order)
+		wakeup_kcompactd();
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -0,0 +1,317 @@
+/*
+ * mm/ratrace.c - record and replay the page cache misses of app launches
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A cold app launch reads its dex, odex, resources and libraries in a
+ * scattered order that on-demand readahead cannot predict, yet is the same
+ * from one launch to the next.  While a trace is attached to an mm, every
+ * synchronous page cache miss of the process is appended to it, holding a
+ * reference on the file.  Once stopped, the trace can be replayed as one
+ * plugged batch of readahead ahead of the next launch.
+ */
+
+#include <linux/anon_inodes.h>
+#include <linux/blkdev.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/ratrace.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#define RATRACE_DEFAULT_ENTRIES	4096
+#define RATRACE_MAX_ENTRIES	65536
+
+struct ratrace_entry {
+	struct file *file;
+	pgoff_t index;
+	unsigned long nr_pages;
+};
+
+struct ratrace {
+	spinlock_t lock;		/* protects the entries while recording */
+	struct mutex replay_mutex;
+	struct mm_struct *mm;		/* recorded mm, NULL once stopped */
+	unsigned int max_entries;
+	unsigned int nr_entries;
+	struct ratrace_stats stats;
+	struct ratrace_entry entries[0];
+};
+
+/* serialises attaching and detaching traces from their mm */
+static DEFINE_MUTEX(ratrace_mutex);
+
+static bool ratrace_stopped(struct ratrace *trace)
+{
+	bool stopped;
+
+	spin_lock(&trace->lock);
+	stopped = !trace->mm;
+	spin_unlock(&trace->lock);
+
+	return stopped;
+}
+
+void __ratrace_record(struct mm_struct *mm, struct file *filp,
+		      pgoff_t index, unsigned long nr_pages)
+{
+	struct ratrace *trace;
+	struct ratrace_entry *last;
+
+	rcu_read_lock();
+	trace = rcu_dereference(mm->ra_trace);
+	if (!trace)
+		goto out;
+
+	spin_lock(&trace->lock);
+	if (!trace->mm)
+		goto out_unlock;
+
+	trace->stats.pages += nr_pages;
+
+	/* fold sequential misses on the same file into one entry */
+	if (trace->nr_entries) {
+		last = &trace->entries[trace->nr_entries - 1];
+		if (last->file == filp && index >= last->index &&
+		    index <= last->index + last->nr_pages) {
+			last->nr_pages = max(last->nr_pages,
+					     index + nr_pages - last->index);
+			goto out_unlock;
+		}
+	}
+
+	if (trace->nr_entries == trace->max_entries) {
+		trace->stats.dropped++;
+		goto out_unlock;
+	}
+
+	last = &trace->entries[trace->nr_entries++];
+	get_file(filp);
+	last->file = filp;
+	last->index = index;
+	last->nr_pages = nr_pages;
+out_unlock:
+	spin_unlock(&trace->lock);
+out:
+	rcu_read_unlock();
+}
+
+static void ratrace_detach(struct ratrace *trace)
+{
+	struct mm_struct *mm;
+
+	lockdep_assert_held(&ratrace_mutex);
+
+	spin_lock(&trace->lock);
+	mm = trace->mm;
+	trace->mm = NULL;
+	spin_unlock(&trace->lock);
+
+	if (mm) {
+		rcu_assign_pointer(mm->ra_trace, NULL);
+		/* wait for recorders still looking at the trace */
+		synchronize_rcu();
+	}
+}
+
+void __ratrace_exit(struct mm_struct *mm)
+{
+	struct ratrace *trace;
+
+	mutex_lock(&ratrace_mutex);
+	trace = rcu_dereference_protected(mm->ra_trace,
+					  lockdep_is_held(&ratrace_mutex));
+	if (trace)
+		ratrace_detach(trace);
+	mutex_unlock(&ratrace_mutex);
+}
+
+static long ratrace_replay(struct ratrace *trace)
+{
+	struct blk_plug plug;
+	unsigned int i;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < trace->nr_entries; i++) {
+		struct ratrace_entry *entry = &trace->entries[i];
+		struct address_space *mapping = entry->file->f_mapping;
+		int ret;
+
+		if (fatal_signal_pending(current))
+			break;
+
+		ret = force_page_cache_readahead(mapping, entry->file,
+						 entry->index, entry->nr_pages);
+		if (ret < 0)
+			continue;
+
+		spin_lock(&trace->lock);
+		trace->stats.replay_pages += ret;
+		if (ret < entry->nr_pages)
+			trace->stats.replay_cached += entry->nr_pages - ret;
+		spin_unlock(&trace->lock);
+	}
+	blk_finish_plug(&plug);
+
+	return 0;
+}
+
+static long ratrace_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct ratrace *trace = file->private_data;
+	struct ratrace_stats stats;
+	long ret = 0;
+
+	switch (cmd) {
+	case RATRACE_IOC_STOP:
+		mutex_lock(&ratrace_mutex);
+		ratrace_detach(trace);
+		mutex_unlock(&ratrace_mutex);
+		break;
+	case RATRACE_IOC_REPLAY:
+		/* the entries only stop changing once recording is over */
+		if (!ratrace_stopped(trace))
+			return -EBUSY;
+		mutex_lock(&trace->replay_mutex);
+		ret = ratrace_replay(trace);
+		mutex_unlock(&trace->replay_mutex);
+		break;
+	case RATRACE_IOC_STATS:
+		spin_lock(&trace->lock);
+		stats = trace->stats;
+		stats.entries = trace->nr_entries;
+		spin_unlock(&trace->lock);
+		if (copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+			ret = -EFAULT;
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+
+	return ret;
+}
+
+static ssize_t ratrace_read(struct file *file, char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct ratrace *trace = file->private_data;
+	struct ratrace_record rec;
+	unsigned long i = *ppos / sizeof(rec);
+	ssize_t done = 0;
+
+	if (*ppos % sizeof(rec))
+		return -EINVAL;
+
+	if (!ratrace_stopped(trace))
+		return -EBUSY;
+
+	while (i < trace->nr_entries && count >= sizeof(rec)) {
+		struct ratrace_entry *entry = &trace->entries[i];
+		struct inode *inode = entry->file->f_mapping->host;
+
+		rec.ino = inode->i_ino;
+		rec.dev = new_encode_dev(inode->i_sb->s_dev);
+		rec.index = entry->index;
+		rec.nr_pages = entry->nr_pages;
+		if (copy_to_user(buf + done, &rec, sizeof(rec))) {
+			if (!done)
+				done = -EFAULT;
+			break;
+		}
+		done += sizeof(rec);
+		count -= sizeof(rec);
+		i++;
+	}
+	if (done > 0)
+		*ppos += done;
+
+	return done;
+}
+
+static int ratrace_release(struct inode *inode, struct file *file)
+{
+	struct ratrace *trace = file->private_data;
+	unsigned int i;
+
+	mutex_lock(&ratrace_mutex);
+	ratrace_detach(trace);
+	mutex_unlock(&ratrace_mutex);
+
+	for (i = 0; i < trace->nr_entries; i++)
+		fput(trace->entries[i].file);
+	vfree(trace);
+
+	return 0;
+}
+
+static const struct file_operations ratrace_fops = {
+	.read		= ratrace_read,
+	.unlocked_ioctl	= ratrace_ioctl,
+	.release	= ratrace_release,
+	.llseek		= no_llseek,
+};
+
+int ratrace_start(unsigned long nr_entries)
+{
+	struct mm_struct *mm = current->mm;
+	struct ratrace *trace;
+	struct file *file;
+	int fd;
+
+	if (!mm)
+		return -EINVAL;
+	if (!nr_entries)
+		nr_entries = RATRACE_DEFAULT_ENTRIES;
+	if (nr_entries > RATRACE_MAX_ENTRIES)
+		return -EINVAL;
+
+	trace = vzalloc(sizeof(*trace) +
+			nr_entries * sizeof(struct ratrace_entry));
+	if (!trace)
+		return -ENOMEM;
+	spin_lock_init(&trace->lock);
+	mutex_init(&trace->replay_mutex);
+	trace->max_entries = nr_entries;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		vfree(trace);
+		return fd;
+	}
+
+	file = anon_inode_getfile("[ratrace]", &ratrace_fops, trace, O_RDONLY);
+	if (IS_ERR(file)) {
+		put_unused_fd(fd);
+		vfree(trace);
+		return PTR_ERR(file);
+	}
+
+	mutex_lock(&ratrace_mutex);
+	if (rcu_access_pointer(mm->ra_trace)) {
+		mutex_unlock(&ratrace_mutex);
+		put_unused_fd(fd);
+		/* releasing the file frees the trace */
+		fput(file);
+		return -EBUSY;
+	}
+	trace->mm = mm;
+	rcu_assign_pointer(mm->ra_trace, trace);
+	mutex_unlock(&ratrace_mutex);
+
+	fd_install(fd, file);
+
+	return fd;
+}
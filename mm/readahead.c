@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/ratrace.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -504,6 +505,8 @@ void page_cache_sync_readahead(struct address_space *mapping,
 			       struct file_ra_state *ra, struct file *filp,
 			       pgoff_t offset, unsigned long req_size)
 {
+	ratrace_record(filp, offset, req_size);
+
 	/* no read-ahead */
 	if (!ra->ra_pages)
 		return;
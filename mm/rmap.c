@@ -722,10 +722,12 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		/* go ahead even if the pmd is pmd_trans_splitting() */
 		if (pmdp_clear_flush_young_notify(vma, address, pmd))
 			referenced++;
+		mm_wss_sample(mm, referenced, hpage_nr_pages(page));
 		spin_unlock(&mm->page_table_lock);
 	} else {
 		pte_t *pte;
 		spinlock_t *ptl;
+		int young;
 
 		/*
 		 * rmap might return false positives; we must filter
@@ -742,7 +744,8 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 			goto out;
 		}
 
-		if (ptep_clear_flush_young_notify(vma, address, pte)) {
+		young = ptep_clear_flush_young_notify(vma, address, pte);
+		if (young) {
 			/*
 			 * Don't treat a reference through a sequentially read
 			 * mapping as such.  If the page has been used in
@@ -753,6 +756,7 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 			if (likely(!VM_SequentialReadHint(vma)))
 				referenced++;
 		}
+		mm_wss_sample(mm, young, 1);
 		pte_unmap_unlock(pte, ptl);
 	}
 
@@ -2014,6 +2014,39 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+static void __slab_free(struct kmem_cache *s, struct page *page,
+			void *head, void *tail, int cnt, unsigned long addr);
+
+/*
+ * Hand a batch of queued frees back to their slabs.  The objects of each
+ * slab are chained into one freelist, so the slab is updated once for
+ * all of them.  @objs is reordered in the process.
+ */
+static void slab_free_remote_batch(struct kmem_cache *s, void **objs, int nr)
+{
+	stat(s, FREE_REMOTE_FLUSH);
+
+	while (nr) {
+		void *head = objs[--nr];
+		void *tail = head;
+		struct page *page = virt_to_head_page(head);
+		int cnt = 1;
+		int i;
+
+		/* entries above i have been looked at, swap them in */
+		for (i = nr - 1; i >= 0; i--) {
+			if (virt_to_head_page(objs[i]) != page)
+				continue;
+			set_freepointer(s, objs[i], head);
+			head = objs[i];
+			cnt++;
+			objs[i] = objs[--nr];
+		}
+		stat(s, FREE_REMOTE_SLABS);
+		__slab_free(s, page, head, tail, cnt, _RET_IP_);
+	}
+}
+
 /*
  * Flush cpu slab.
  *
@@ -2024,6 +2057,13 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
 	if (likely(c)) {
+		if (c->nr_remote) {
+			int nr = c->nr_remote;
+
+			c->nr_remote = 0;
+			slab_free_remote_batch(s, c->remote, nr);
+		}
+
 		if (c->page)
 			flush_slab(s, c);
 
@@ -2043,7 +2083,7 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || c->partial;
+	return c->page || c->partial || c->nr_remote;
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -2435,10 +2475,11 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
  * handling required then we can return immediately.
  */
 static void __slab_free(struct kmem_cache *s, struct page *page,
-			void *x, unsigned long addr)
+			void *head, void *tail, int cnt, unsigned long addr)
 {
 	void *prior;
-	void **object = (void *)x;
+	void **object = head;
+	void *tail_obj = tail ? : head;
 	int was_frozen;
 	int inuse;
 	struct page new;
@@ -2448,16 +2489,17 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	stat(s, FREE_SLOWPATH);
 
-	if (kmem_cache_debug(s) && !free_debug_processing(s, page, x, addr))
+	if (kmem_cache_debug(s) &&
+	    !free_debug_processing(s, page, head, addr))
 		return;
 
 	do {
 		prior = page->freelist;
 		counters = page->counters;
-		set_freepointer(s, object, prior);
+		set_freepointer(s, tail_obj, prior);
 		new.counters = counters;
 		was_frozen = new.frozen;
-		new.inuse--;
+		new.inuse -= cnt;
 		if ((!new.inuse || !prior) && !was_frozen && !n) {
 
 			if (!kmem_cache_debug(s) && !prior)
@@ -2548,6 +2590,36 @@ slab_empty:
 	discard_slab(s, page);
 }
 
+/*
+ * Queue a free that missed the cpu slab.  Such frees typically come from
+ * another cpu than the one that allocated the objects, and each of them
+ * would otherwise be a cmpxchg_double_slab() on the slab, which without
+ * a native cmpxchg_double (ARM) means taking the slab lock.  Batching them
+ * takes the lock once per slab instead, and the queued objects stay warm
+ * in this cpu's cache until then.
+ */
+static void slab_free_remote(struct kmem_cache *s, void *x)
+{
+	void *objs[SLUB_REMOTE_BATCH];
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	int nr = 0;
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	c->remote[c->nr_remote++] = x;
+	if (c->nr_remote == SLUB_REMOTE_BATCH) {
+		nr = c->nr_remote;
+		memcpy(objs, c->remote, nr * sizeof(void *));
+		c->nr_remote = 0;
+	}
+	local_irq_restore(flags);
+
+	stat(s, FREE_REMOTE);
+	if (nr)
+		slab_free_remote_batch(s, objs, nr);
+}
+
 /*
  * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
  * can perform fastpath freeing without additional function calls.
@@ -2592,8 +2664,10 @@ redo:
 			goto redo;
 		}
 		stat(s, FREE_FASTPATH);
-	} else
-		__slab_free(s, page, x, addr);
+	} else if (!kmem_cache_debug(s))
+		slab_free_remote(s, x);
+	else
+		__slab_free(s, page, x, NULL, 1, addr);
 
 }
 
@@ -5094,6 +5168,9 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(FREE_REMOTE, free_remote);
+STAT_ATTR(FREE_REMOTE_FLUSH, free_remote_flush);
+STAT_ATTR(FREE_REMOTE_SLABS, free_remote_slabs);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5161,6 +5238,9 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&free_remote_attr.attr,
+	&free_remote_flush_attr.attr,
+	&free_remote_slabs_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -20,6 +20,12 @@
 
 #include <asm/pgtable.h>
 
+/* Tells swap_vma_readahead() to read around the fault address */
+int swap_ra_vma = 1;
+
+/* Read-ahead pages faulted on, consumed by swap_ra_window() */
+static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
+
 /*
  * swapper_space is a fiction, retained to simplify the path through
  * vmscan's shrink_page_list.
@@ -264,8 +270,13 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			atomic_inc(&swapin_readahead_hits);
+			count_vm_event(SWAP_RA_HIT);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -277,12 +288,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, bool *allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -333,6 +346,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -350,6 +364,35 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+}
+
+/*
+ * Start reading a page ahead of its fault.  Pages which actually had to
+ * be read are marked, so that lookup_swap_cache() can tell a read-ahead
+ * hit from a page which was in the swap cache anyway.
+ */
+static void swap_readahead_page(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	bool allocated;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+	if (!page)
+		return;
+	if (allocated) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -385,12 +428,130 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (offset != swp_offset(entry)) {
+			swap_readahead_page(swp_entry(swp_type(entry), offset),
+					    gfp_mask, vma, addr);
 			continue;
-		page_cache_release(page);
+		}
+		page = read_swap_cache_async(entry, gfp_mask, vma, addr);
+		if (page)
+			page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * The window of the VMA based readahead grows with the number of
+ * read-ahead pages faulted on since the last swap-in fault, and falls
+ * back to no readahead at all when there were none and the faults are
+ * not sequential.  It never shrinks by more than half at a time.
+ */
+#define SWAP_RA_WIN_MAX		32
+
+static unsigned int swap_ra_window(unsigned long faddr, unsigned long prev,
+				   unsigned int prev_win)
+{
+	unsigned int hits, win, max_win;
+
+	max_win = min(1U << ACCESS_ONCE(page_cluster), SWAP_RA_WIN_MAX);
+	if (max_win <= 1)
+		return 1;
+
+	hits = atomic_xchg(&swapin_readahead_hits, 0);
+	win = hits + 2;
+	if (win == 2) {
+		if (faddr != prev + PAGE_SIZE && faddr + PAGE_SIZE != prev)
+			win = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < win)
+			roundup <<= 1;
+		win = roundup;
+	}
+	if (win < prev_win / 2)
+		win = prev_win / 2;
+	return min(win, max_win);
+}
+
+/**
+ * swap_vma_readahead - swap in the pages mapped around a swap fault
+ * @fentry: swap entry of the faulting pte
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the fault is in
+ * @addr: faulting address
+ * @pmd: the pmd mapping @addr
+ *
+ * With swap on a device without seek cost (zram), the neighbours of a slot
+ * on the device are mostly unrelated to the faulting page, while the
+ * neighbours in the address space are likely to be faulted on next.  So
+ * read ahead through the swap entries in the ptes around @addr, staying
+ * within @vma and the page table of @addr, in the direction the faults
+ * are going.  The mmap_sem held by the caller keeps the page table around;
+ * the ptes are only a hint and read without the pte lock.
+ *
+ * Returns the struct page for @fentry, like swapin_readahead().
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	swp_entry_t entries[SWAP_RA_WIN_MAX];
+	unsigned long addrs[SWAP_RA_WIN_MAX];
+	unsigned long faddr = addr & PAGE_MASK;
+	unsigned long info, prev, start, end, lo, hi, a;
+	unsigned int win, nr = 0, i;
+	pte_t *pte, *orig_pte;
+
+	if (!swap_ra_vma)
+		return swapin_readahead(fentry, gfp_mask, vma, addr);
+
+	info = atomic_long_read(&vma->swap_readahead_info);
+	prev = info & PAGE_MASK;
+	win = swap_ra_window(faddr, prev, info & ~PAGE_MASK);
+	atomic_long_set(&vma->swap_readahead_info, faddr | win);
+	if (win == 1)
+		goto skip;
+
+	lo = max(vma->vm_start, faddr & PMD_MASK);
+	hi = min(vma->vm_end, (faddr & PMD_MASK) + PMD_SIZE);
+	if (faddr == prev + PAGE_SIZE) {
+		start = faddr;
+		end = faddr + win * PAGE_SIZE;
+	} else if (faddr + PAGE_SIZE == prev) {
+		start = faddr - (win - 1) * PAGE_SIZE;
+		end = faddr + PAGE_SIZE;
+	} else {
+		start = faddr - (win / 2) * PAGE_SIZE;
+		end = start + win * PAGE_SIZE;
+	}
+	/* the comparisons against faddr catch wrap-around */
+	if (start < lo || start > faddr)
+		start = lo;
+	if (end > hi || end <= faddr)
+		end = hi;
+
+	orig_pte = pte = pte_offset_map(pmd, start);
+	for (a = start; a < end; a += PAGE_SIZE, pte++) {
+		pte_t pteval = *pte;
+		swp_entry_t entry;
+
+		if (a == faddr || pte_none(pteval) || pte_present(pteval) ||
+		    pte_file(pteval))
+			continue;
+		entry = pte_to_swp_entry(pteval);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		entries[nr] = entry;
+		addrs[nr] = a;
+		nr++;
+	}
+	pte_unmap(orig_pte);
+
+	for (i = 0; i < nr; i++)
+		swap_readahead_page(entries[i], gfp_mask, vma, addrs[i]);
+	lru_add_drain();
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
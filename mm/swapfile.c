@@ -616,6 +616,24 @@ static inline int page_swapcount(struct page *page)
 	return count;
 }
 
+/*
+ * How many references to a swap entry there are, for reporting the share
+ * of it a process is charged. Continued counts are not followed.
+ */
+int swp_swapcount(swp_entry_t entry)
+{
+	int count = 0;
+	struct swap_info_struct *p;
+
+	p = swap_info_get(entry);
+	if (p) {
+		count = swap_count(p->swap_map[swp_offset(entry)]) &
+			~COUNT_CONTINUED;
+		spin_unlock(&swap_lock);
+	}
+	return count;
+}
+
 /*
  * We can write to an anon page without COW if there are no other references
  * to it.  And as a side-effect, free up its swap: because the old content
@@ -2142,15 +2142,31 @@ static void shrink_zone(int priority, struct zone *zone,
 		.priority = priority,
 	};
 	struct mem_cgroup *memcg;
+	/*
+	 * The first global passes over a zone only take from the groups
+	 * that are over their soft limit, so that background apps given
+	 * one are pushed back before the foreground app loses its pages.
+	 */
+	bool soft_only = global_reclaim(sc) && priority >= DEF_PRIORITY - 2;
+	bool shrunk = false;
 
+again:
 	memcg = mem_cgroup_iter(root, NULL, &reclaim);
 	do {
 		struct mem_cgroup_zone mz = {
 			.mem_cgroup = memcg,
 			.zone = zone,
 		};
+		unsigned long nr_reclaimed = sc->nr_reclaimed;
+
+		if (soft_only && !mem_cgroup_soft_limit_exceeded(root, memcg)) {
+			memcg = mem_cgroup_iter(root, memcg, &reclaim);
+			continue;
+		}
 
 		shrink_mem_cgroup_zone(priority, &mz, sc);
+		mem_cgroup_count_reclaim(memcg, sc->nr_reclaimed - nr_reclaimed);
+		shrunk = true;
 		/*
 		 * Limit reclaim has historically picked one memcg and
 		 * scanned it with decreasing priority levels until
@@ -2167,6 +2183,12 @@ static void shrink_zone(int priority, struct zone *zone,
 		}
 		memcg = mem_cgroup_iter(root, memcg, &reclaim);
 	} while (memcg);
+
+	/* nobody is over their soft limit, reclaim from everybody */
+	if (soft_only && !shrunk) {
+		soft_only = false;
+		goto again;
+	}
 }
 
 /* Returns true if compaction should go ahead for a high-order request */
@@ -3126,6 +3148,8 @@ static int kswapd(void *p)
 			balanced_classzone_idx = classzone_idx;
 			balanced_order = balance_pgdat(pgdat, order,
 						&balanced_classzone_idx);
+			/* reclaim leaves free memory scattered behind */
+			wakeup_kcompactd();
 		}
 	}
 
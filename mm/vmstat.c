@@ -767,6 +767,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_proactive",
+	"compact_proactive_pages_moved",
+	"compact_proactive_yield",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -782,6 +785,11 @@ const char * const vmstat_text[] = {
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
 
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	"thp_fault_alloc",
 	"thp_fault_fallback",
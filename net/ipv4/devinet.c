@@ -1620,6 +1620,11 @@ static struct devinet_sysctl_table {
 		DEVINET_SYSCTL_RW_ENTRY(ARP_ACCEPT, "arp_accept"),
 		DEVINET_SYSCTL_RW_ENTRY(ARP_NOTIFY, "arp_notify"),
 		DEVINET_SYSCTL_RW_ENTRY(PROXY_ARP_PVLAN, "proxy_arp_pvlan"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_RMEM_DEF, "tcp_rmem_def"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_RMEM_MAX, "tcp_rmem_max"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_WMEM_DEF, "tcp_wmem_def"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_WMEM_MAX, "tcp_wmem_max"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_INITRWND, "tcp_initrwnd"),
 
 		DEVINET_SYSCTL_FLUSHING_ENTRY(NOXFRM, "disable_xfrm"),
 		DEVINET_SYSCTL_FLUSHING_ENTRY(NOPOLICY, "disable_policy"),
@@ -315,11 +315,44 @@ drop:
 	return true;
 }
 
+int sysctl_ip_early_demux __read_mostly = 1;
+
+/*
+ *	Look up the established socket of a unicast packet before routing it,
+ *	so that the input route the socket kept from its previous packets can
+ *	be used instead of a route lookup, and the protocol handler doesn't
+ *	have to look the socket up again.
+ */
+static void ip_early_demux(struct sk_buff *skb)
+{
+	const struct net_protocol *ipprot;
+	struct net *net = dev_net(skb->dev);
+
+	rcu_read_lock();
+	ipprot = rcu_dereference(inet_protos[ip_hdr(skb)->protocol]);
+	if (ipprot && ipprot->early_demux) {
+		ipprot->early_demux(skb);
+		if (skb_dst(skb))
+			NET_INC_STATS_BH(net, LINUX_MIB_IPEARLYDEMUXDST);
+		else if (skb->sk)
+			NET_INC_STATS_BH(net, LINUX_MIB_IPEARLYDEMUXSOCK);
+		else
+			NET_INC_STATS_BH(net, LINUX_MIB_IPEARLYDEMUXMISS);
+	}
+	rcu_read_unlock();
+}
+
 static int ip_rcv_finish(struct sk_buff *skb)
 {
-	const struct iphdr *iph = ip_hdr(skb);
+	const struct iphdr *iph;
 	struct rtable *rt;
 
+	if (sysctl_ip_early_demux && !skb_dst(skb) && !skb->sk &&
+	    !ip_is_fragment(ip_hdr(skb)))
+		ip_early_demux(skb);
+
+	iph = ip_hdr(skb);
+
 	/*
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
@@ -0,0 +1,554 @@
+/*
+ * Forwarding fast path for established NAT flows
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * When the device routes for tethered clients, each forwarded packet goes
+ * through defrag, conntrack, the nat and filter tables and a route lookup.
+ * Once conntrack has seen a NATed TCP or UDP flow established, this caches
+ * per direction the translation and the output route, and the packets of
+ * the flow are translated and sent straight from the first PRE_ROUTING
+ * hook, skipping the PRE_ROUTING, FORWARD and conntrack work.  They still
+ * go through POST_ROUTING.
+ *
+ * An entry is dropped when its conntrack entry dies, its route goes stale,
+ * a TCP packet with SYN, FIN or RST shows up (conntrack gets to see the
+ * state change) or the flow had no traffic for idle_timeout seconds.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/rculist.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/dst.h>
+#include <net/checksum.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_conntrack_zones.h>
+
+#define FLOW_CACHE_HASH_SIZE	1024
+#define FLOW_CACHE_GC_INTERVAL	(2 * HZ)
+
+static unsigned int max_flows __read_mostly = 4096;
+module_param(max_flows, uint, 0644);
+MODULE_PARM_DESC(max_flows, "Maximum number of cached flows");
+
+static unsigned int idle_timeout __read_mostly = 30;
+module_param(idle_timeout, uint, 0644);
+MODULE_PARM_DESC(idle_timeout, "Seconds without traffic before a flow is dropped");
+
+struct flow_cache_tuple {
+	__be32			saddr;
+	__be32			daddr;
+	__be16			sport;
+	__be16			dport;
+	u8			protonum;
+	int			iif;
+};
+
+struct flow_cache_entry {
+	struct hlist_node	hnode;
+	struct rcu_head		rcu;
+	struct flow_cache_tuple	tuple;	/* the packets as they come in */
+
+	/* what they are translated to */
+	__be32			saddr;
+	__be32			daddr;
+	__be16			sport;
+	__be16			dport;
+
+	struct nf_conn		*ct;
+	enum ip_conntrack_info	ctinfo;
+	unsigned long		timeout;
+	struct dst_entry	*dst;
+
+	unsigned long		last_used;
+	/* updated without locking, from any cpu: close enough for stats */
+	u64			packets;
+	u64			bytes;
+};
+
+struct flow_cache_stat {
+	unsigned int		hits;
+	unsigned int		misses;
+	unsigned int		invalidated;
+};
+
+static struct hlist_head flow_cache_hash[FLOW_CACHE_HASH_SIZE];
+static DEFINE_SPINLOCK(flow_cache_lock);
+static unsigned int flow_cache_count;
+static unsigned int flow_cache_learned;
+static unsigned int flow_cache_expired;
+static u32 flow_cache_rnd __read_mostly;
+static struct flow_cache_stat __percpu *flow_cache_stats;
+static struct delayed_work flow_cache_gc_work;
+
+static u32 flow_cache_hashfn(const struct flow_cache_tuple *t)
+{
+	return jhash_3words((__force u32)t->saddr,
+			    (__force u32)t->daddr ^ t->iif,
+			    ((__force u32)t->sport << 16 | (__force u32)t->dport) ^
+			    t->protonum, flow_cache_rnd) &
+	       (FLOW_CACHE_HASH_SIZE - 1);
+}
+
+static bool flow_cache_tuple_equal(const struct flow_cache_tuple *a,
+				   const struct flow_cache_tuple *b)
+{
+	return a->saddr == b->saddr && a->daddr == b->daddr &&
+	       a->sport == b->sport && a->dport == b->dport &&
+	       a->protonum == b->protonum && a->iif == b->iif;
+}
+
+static struct flow_cache_entry *
+flow_cache_lookup(const struct flow_cache_tuple *t)
+{
+	struct flow_cache_entry *fe;
+	struct hlist_node *n;
+
+	hlist_for_each_entry_rcu(fe, n, &flow_cache_hash[flow_cache_hashfn(t)],
+				 hnode)
+		if (flow_cache_tuple_equal(&fe->tuple, t))
+			return fe;
+
+	return NULL;
+}
+
+static void flow_cache_free_rcu(struct rcu_head *head)
+{
+	struct flow_cache_entry *fe = container_of(head, struct flow_cache_entry,
+						   rcu);
+
+	dst_release(fe->dst);
+	nf_ct_put(fe->ct);
+	kfree(fe);
+}
+
+/* called with flow_cache_lock held */
+static void __flow_cache_unlink(struct flow_cache_entry *fe)
+{
+	if (hlist_unhashed(&fe->hnode))
+		return;
+
+	hlist_del_init_rcu(&fe->hnode);
+	flow_cache_count--;
+	call_rcu(&fe->rcu, flow_cache_free_rcu);
+}
+
+static void flow_cache_kill(struct flow_cache_entry *fe)
+{
+	spin_lock_bh(&flow_cache_lock);
+	__flow_cache_unlink(fe);
+	spin_unlock_bh(&flow_cache_lock);
+
+	this_cpu_inc(flow_cache_stats->invalidated);
+}
+
+static bool flow_cache_stale(const struct flow_cache_entry *fe)
+{
+	return nf_ct_is_dying(fe->ct) || !dst_check(fe->dst, 0);
+}
+
+static void flow_cache_nat(struct sk_buff *skb, struct iphdr *iph,
+			   const struct flow_cache_entry *fe)
+{
+	__be16 *ports = (__be16 *)((void *)iph + sizeof(*iph));
+	__sum16 *check;
+
+	if (iph->protocol == IPPROTO_TCP)
+		check = &((struct tcphdr *)ports)->check;
+	else
+		check = &((struct udphdr *)ports)->check;
+
+	/* a zero udp checksum means there is none */
+	if (iph->protocol == IPPROTO_TCP || *check) {
+		inet_proto_csum_replace4(check, skb, iph->saddr, fe->saddr, 1);
+		inet_proto_csum_replace4(check, skb, iph->daddr, fe->daddr, 1);
+		inet_proto_csum_replace2(check, skb, ports[0], fe->sport, 0);
+		inet_proto_csum_replace2(check, skb, ports[1], fe->dport, 0);
+		if (iph->protocol == IPPROTO_UDP && !*check)
+			*check = CSUM_MANGLED_0;
+	}
+	ports[0] = fe->sport;
+	ports[1] = fe->dport;
+
+	csum_replace4(&iph->check, iph->saddr, fe->saddr);
+	csum_replace4(&iph->check, iph->daddr, fe->daddr);
+	iph->saddr = fe->saddr;
+	iph->daddr = fe->daddr;
+}
+
+static unsigned int flow_cache_in(unsigned int hooknum, struct sk_buff *skb,
+				  const struct net_device *in,
+				  const struct net_device *out,
+				  int (*okfn)(struct sk_buff *))
+{
+	struct flow_cache_entry *fe;
+	struct flow_cache_tuple t;
+	struct iphdr *iph;
+	unsigned int hdrlen;
+	__be16 *ports;
+
+	if (skb->pkt_type != PACKET_HOST || !net_eq(dev_net(in), &init_net))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	if (iph->ihl != 5 || ip_is_fragment(iph))
+		return NF_ACCEPT;
+
+	if (iph->protocol == IPPROTO_TCP)
+		hdrlen = sizeof(struct tcphdr);
+	else if (iph->protocol == IPPROTO_UDP)
+		hdrlen = sizeof(struct udphdr);
+	else
+		return NF_ACCEPT;
+
+	if (!pskb_may_pull(skb, sizeof(*iph) + hdrlen))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	ports = (__be16 *)((void *)iph + sizeof(*iph));
+
+	t.saddr = iph->saddr;
+	t.daddr = iph->daddr;
+	t.sport = ports[0];
+	t.dport = ports[1];
+	t.protonum = iph->protocol;
+	t.iif = in->ifindex;
+
+	fe = flow_cache_lookup(&t);
+	if (!fe) {
+		this_cpu_inc(flow_cache_stats->misses);
+		return NF_ACCEPT;
+	}
+
+	if (flow_cache_stale(fe) ||
+	    (iph->protocol == IPPROTO_TCP &&
+	     (tcp_flag_word((struct tcphdr *)ports) &
+	      (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST)))) {
+		flow_cache_kill(fe);
+		return NF_ACCEPT;
+	}
+
+	/* let the slow path send the icmp errors */
+	if (iph->ttl <= 1 ||
+	    (skb->len > dst_mtu(fe->dst) && !skb_is_gso(skb)))
+		return NF_ACCEPT;
+
+	if (!skb_make_writable(skb, sizeof(*iph) + hdrlen))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	nf_ct_refresh_acct(fe->ct, fe->ctinfo, skb, fe->timeout);
+	flow_cache_nat(skb, iph, fe);
+	ip_decrease_ttl(iph);
+
+	fe->last_used = jiffies;
+	fe->packets++;
+	fe->bytes += skb->len;
+	this_cpu_inc(flow_cache_stats->hits);
+
+	skb->priority = rt_tos2priority(iph->tos);
+	skb_forward_csum(skb);
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst_clone(fe->dst));
+
+	IP_INC_STATS_BH(&init_net, IPSTATS_MIB_OUTFORWDATAGRAMS);
+	dst_output(skb);
+	return NF_STOLEN;
+}
+
+static bool flow_cache_has_helper(const struct nf_conn *ct)
+{
+	const struct nf_conn_help *help = nfct_help(ct);
+
+	return help && rcu_dereference(help->helper);
+}
+
+static void flow_cache_learn(struct nf_conn *ct, enum ip_conntrack_info ctinfo,
+			     int iif, struct dst_entry *dst)
+{
+	enum ip_conntrack_dir dir = CTINFO2DIR(ctinfo);
+	const struct nf_conntrack_tuple *orig = &ct->tuplehash[dir].tuple;
+	const struct nf_conntrack_tuple *rev = &ct->tuplehash[!dir].tuple;
+	struct flow_cache_entry *fe;
+	struct flow_cache_tuple t;
+	long timeout;
+
+	t.saddr = orig->src.u3.ip;
+	t.daddr = orig->dst.u3.ip;
+	t.sport = orig->src.u.all;
+	t.dport = orig->dst.u.all;
+	t.protonum = orig->dst.protonum;
+	t.iif = iif;
+
+	/* what refreshing conntrack gave it just now */
+	timeout = (long)(ct->timeout.expires - jiffies);
+	if (timeout <= 0)
+		return;
+
+	/* most packets of a flow the cache can't take get here */
+	if (ACCESS_ONCE(flow_cache_count) >= max_flows || flow_cache_lookup(&t))
+		return;
+
+	spin_lock_bh(&flow_cache_lock);
+	if (flow_cache_lookup(&t) || flow_cache_count >= max_flows)
+		goto out;
+
+	fe = kzalloc(sizeof(*fe), GFP_ATOMIC);
+	if (!fe)
+		goto out;
+
+	fe->tuple = t;
+	fe->saddr = rev->dst.u3.ip;
+	fe->daddr = rev->src.u3.ip;
+	fe->sport = rev->dst.u.all;
+	fe->dport = rev->src.u.all;
+	nf_conntrack_get(&ct->ct_general);
+	fe->ct = ct;
+	fe->ctinfo = ctinfo;
+	fe->timeout = timeout;
+	dst_hold(dst);
+	fe->dst = dst;
+	fe->last_used = jiffies;
+
+	hlist_add_head_rcu(&fe->hnode, &flow_cache_hash[flow_cache_hashfn(&t)]);
+	flow_cache_count++;
+	flow_cache_learned++;
+out:
+	spin_unlock_bh(&flow_cache_lock);
+}
+
+/* learn the flows after SNAT, when the packets look like the cache will make them */
+static unsigned int flow_cache_out(unsigned int hooknum, struct sk_buff *skb,
+				   const struct net_device *in,
+				   const struct net_device *out,
+				   int (*okfn)(struct sk_buff *))
+{
+	enum ip_conntrack_info ctinfo;
+	struct dst_entry *dst = skb_dst(skb);
+	struct nf_conn *ct;
+
+	if (!(IPCB(skb)->flags & IPSKB_FORWARDED) ||
+	    !net_eq(dev_net(out), &init_net) || !dst || dst->xfrm)
+		return NF_ACCEPT;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || (ctinfo != IP_CT_ESTABLISHED &&
+		    ctinfo != IP_CT_ESTABLISHED_REPLY))
+		return NF_ACCEPT;
+
+	if (!test_bit(IPS_ASSURED_BIT, &ct->status) ||
+	    !(ct->status & IPS_NAT_MASK) || nf_ct_zone(ct) ||
+	    flow_cache_has_helper(ct))
+		return NF_ACCEPT;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return NF_ACCEPT;
+		/*
+		 * conntrack no longer sees the sequence numbers, don't let
+		 * it find the FIN or RST outside of the window later
+		 */
+		spin_lock_bh(&ct->lock);
+		ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		spin_unlock_bh(&ct->lock);
+		break;
+	case IPPROTO_UDP:
+		break;
+	default:
+		return NF_ACCEPT;
+	}
+
+	flow_cache_learn(ct, ctinfo, ((struct rtable *)dst)->rt_iif, dst);
+	return NF_ACCEPT;
+}
+
+static struct nf_hook_ops flow_cache_ops[] __read_mostly = {
+	{
+		.hook		= flow_cache_in,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_CONNTRACK_DEFRAG - 1,
+	},
+	{
+		.hook		= flow_cache_out,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_POST_ROUTING,
+		.priority	= NF_IP_PRI_NAT_SRC + 1,
+	},
+};
+
+static void flow_cache_flush(bool all)
+{
+	unsigned long idle = idle_timeout * HZ;
+	struct flow_cache_entry *fe;
+	struct hlist_node *n, *tmp;
+	int i;
+
+	spin_lock_bh(&flow_cache_lock);
+	for (i = 0; i < FLOW_CACHE_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(fe, n, tmp, &flow_cache_hash[i],
+					  hnode) {
+			if (all || flow_cache_stale(fe) ||
+			    time_after(jiffies, fe->last_used + idle)) {
+				__flow_cache_unlink(fe);
+				flow_cache_expired++;
+			}
+		}
+	spin_unlock_bh(&flow_cache_lock);
+}
+
+static void flow_cache_gc(struct work_struct *work)
+{
+	flow_cache_flush(false);
+	schedule_delayed_work(&flow_cache_gc_work, FLOW_CACHE_GC_INTERVAL);
+}
+
+/* the routes hold the devices, let go of them */
+static int flow_cache_netdev_event(struct notifier_block *this,
+				   unsigned long event, void *ptr)
+{
+	if (event == NETDEV_DOWN || event == NETDEV_UNREGISTER)
+		flow_cache_flush(true);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block flow_cache_netdev_notifier = {
+	.notifier_call	= flow_cache_netdev_event,
+};
+
+static int flow_cache_seq_show(struct seq_file *seq, void *v)
+{
+	struct flow_cache_stat sum = { 0 };
+	struct flow_cache_entry *fe;
+	struct hlist_node *n;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		const struct flow_cache_stat *st = per_cpu_ptr(flow_cache_stats,
+							       cpu);
+
+		sum.hits += st->hits;
+		sum.misses += st->misses;
+		sum.invalidated += st->invalidated;
+	}
+
+	seq_printf(seq, "flows %u learned %u expired %u invalidated %u\n",
+		   flow_cache_count, flow_cache_learned, flow_cache_expired,
+		   sum.invalidated);
+	seq_printf(seq, "hits %u misses %u\n", sum.hits, sum.misses);
+
+	rcu_read_lock();
+	for (i = 0; i < FLOW_CACHE_HASH_SIZE; i++)
+		hlist_for_each_entry_rcu(fe, n, &flow_cache_hash[i], hnode)
+			seq_printf(seq, "%s %pI4:%u %pI4:%u iif %d -> "
+				   "%pI4:%u %pI4:%u %s packets %llu bytes %llu "
+				   "idle %u\n",
+				   fe->tuple.protonum == IPPROTO_TCP ?
+					"tcp" : "udp",
+				   &fe->tuple.saddr, ntohs(fe->tuple.sport),
+				   &fe->tuple.daddr, ntohs(fe->tuple.dport),
+				   fe->tuple.iif,
+				   &fe->saddr, ntohs(fe->sport),
+				   &fe->daddr, ntohs(fe->dport),
+				   fe->dst->dev->name, fe->packets, fe->bytes,
+				   jiffies_to_msecs(jiffies - fe->last_used));
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int flow_cache_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, flow_cache_seq_show, NULL);
+}
+
+static const struct file_operations flow_cache_seq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= flow_cache_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init flow_cache_init(void)
+{
+	int ret;
+
+	get_random_bytes(&flow_cache_rnd, sizeof(flow_cache_rnd));
+
+	flow_cache_stats = alloc_percpu(struct flow_cache_stat);
+	if (!flow_cache_stats)
+		return -ENOMEM;
+
+	if (!proc_net_fops_create(&init_net, "nf_flow_cache", S_IRUGO,
+				  &flow_cache_seq_fops)) {
+		ret = -ENOMEM;
+		goto err_proc;
+	}
+
+	ret = register_netdevice_notifier(&flow_cache_netdev_notifier);
+	if (ret)
+		goto err_notifier;
+
+	ret = nf_register_hooks(flow_cache_ops, ARRAY_SIZE(flow_cache_ops));
+	if (ret)
+		goto err_hooks;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&flow_cache_gc_work, flow_cache_gc);
+	schedule_delayed_work(&flow_cache_gc_work, FLOW_CACHE_GC_INTERVAL);
+
+	return 0;
+
+err_hooks:
+	unregister_netdevice_notifier(&flow_cache_netdev_notifier);
+err_notifier:
+	proc_net_remove(&init_net, "nf_flow_cache");
+err_proc:
+	free_percpu(flow_cache_stats);
+	return ret;
+}
+
+static void __exit flow_cache_exit(void)
+{
+	nf_unregister_hooks(flow_cache_ops, ARRAY_SIZE(flow_cache_ops));
+	cancel_delayed_work_sync(&flow_cache_gc_work);
+	unregister_netdevice_notifier(&flow_cache_netdev_notifier);
+	proc_net_remove(&init_net, "nf_flow_cache");
+
+	flow_cache_flush(true);
+	rcu_barrier();
+	free_percpu(flow_cache_stats);
+}
+
+module_init(flow_cache_init);
+module_exit(flow_cache_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IPv4 forwarding fast path for established NAT flows");
@@ -43,6 +43,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/export.h>
+#include <linux/math64.h>
 #include <net/sock.h>
 #include <net/raw.h>
 
@@ -259,6 +260,9 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TCPRcvCoalesce", LINUX_MIB_TCPRCVCOALESCE),
 	SNMP_MIB_ITEM("TCPChallengeACK", LINUX_MIB_TCPCHALLENGEACK),
 	SNMP_MIB_ITEM("TCPSYNChallenge", LINUX_MIB_TCPSYNCHALLENGE),
+	SNMP_MIB_ITEM("IPEarlyDemuxSock", LINUX_MIB_IPEARLYDEMUXSOCK),
+	SNMP_MIB_ITEM("IPEarlyDemuxDst", LINUX_MIB_IPEARLYDEMUXDST),
+	SNMP_MIB_ITEM("IPEarlyDemuxMiss", LINUX_MIB_IPEARLYDEMUXMISS),
 	SNMP_MIB_SENTINEL
 };
 
@@ -461,6 +465,67 @@ static const struct file_operations netstat_seq_fops = {
 	.release = single_release_net,
 };
 
+/*
+ *	Report the buffer sizes the TCP connections of each device ended
+ *	with, and how many of them autotuning took to the device's ceiling.
+ */
+static int tcp_autotune_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq->private;
+	struct net_device *dev;
+	struct in_device *in_dev;
+
+	seq_puts(seq, "Iface     Conns RcvbufAvg RcvbufCapped RcvbufMax "
+		      "SndbufAvg SndbufCapped SndbufMax\n");
+
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		struct in_dev_tcp_stats *stats;
+		u64 rcvbuf_avg = 0, sndbuf_avg = 0;
+		int conns, rmem_max, wmem_max;
+
+		in_dev = __in_dev_get_rcu(dev);
+		if (!in_dev)
+			continue;
+
+		stats = &in_dev->tcp_stats;
+		conns = atomic_read(&stats->conns);
+		if (conns) {
+			rcvbuf_avg = div_u64(atomic64_read(&stats->rcvbuf_sum),
+					     conns);
+			sndbuf_avg = div_u64(atomic64_read(&stats->sndbuf_sum),
+					     conns);
+		}
+		rmem_max = IN_DEV_CONF_GET(in_dev, TCP_RMEM_MAX) ? :
+			   sysctl_tcp_rmem[2];
+		wmem_max = IN_DEV_CONF_GET(in_dev, TCP_WMEM_MAX) ? :
+			   sysctl_tcp_wmem[2];
+
+		seq_printf(seq, "%-9s %5d %9llu %12d %9d %9llu %12d %9d\n",
+			   dev->name, conns,
+			   rcvbuf_avg, atomic_read(&stats->rcvbuf_capped),
+			   rmem_max,
+			   sndbuf_avg, atomic_read(&stats->sndbuf_capped),
+			   wmem_max);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int tcp_autotune_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open_net(inode, file, tcp_autotune_seq_show);
+}
+
+static const struct file_operations tcp_autotune_seq_fops = {
+	.owner	 = THIS_MODULE,
+	.open	 = tcp_autotune_seq_open,
+	.read	 = seq_read,
+	.llseek	 = seq_lseek,
+	.release = single_release_net,
+};
+
 static __net_init int ip_proc_init_net(struct net *net)
 {
 	if (!proc_net_fops_create(net, "sockstat", S_IRUGO, &sockstat_seq_fops))
@@ -469,9 +534,14 @@ static __net_init int ip_proc_init_net(struct net *net)
 		goto out_netstat;
 	if (!proc_net_fops_create(net, "snmp", S_IRUGO, &snmp_seq_fops))
 		goto out_snmp;
+	if (!proc_net_fops_create(net, "tcp_autotune", S_IRUGO,
+				  &tcp_autotune_seq_fops))
+		goto out_tcp_autotune;
 
 	return 0;
 
+out_tcp_autotune:
+	proc_net_remove(net, "snmp");
 out_snmp:
 	proc_net_remove(net, "netstat");
 out_netstat:
@@ -482,6 +552,7 @@ out_sockstat:
 
 static __net_exit void ip_proc_exit_net(struct net *net)
 {
+	proc_net_remove(net, "tcp_autotune");
 	proc_net_remove(net, "snmp");
 	proc_net_remove(net, "netstat");
 	proc_net_remove(net, "sockstat");
@@ -68,6 +68,7 @@
 #include <linux/module.h>
 #include <linux/sysctl.h>
 #include <linux/kernel.h>
+#include <linux/inetdevice.h>
 #include <net/dst.h>
 #include <net/tcp.h>
 #include <net/inet_common.h>
@@ -274,7 +275,7 @@ static void tcp_fixup_sndbuf(struct sock *sk)
 
 	sndmem *= TCP_INIT_CWND;
 	if (sk->sk_sndbuf < sndmem)
-		sk->sk_sndbuf = min(sndmem, sysctl_tcp_wmem[2]);
+		sk->sk_sndbuf = min(sndmem, tcp_sk(sk)->sndbuf_max);
 }
 
 /* 2. Tuning advertised window (window_clamp, rcv_ssthresh)
@@ -308,7 +309,7 @@ static int __tcp_grow_window(const struct sock *sk, const struct sk_buff *skb)
 	struct tcp_sock *tp = tcp_sk(sk);
 	/* Optimize this! */
 	int truesize = tcp_win_from_space(skb->truesize) >> 1;
-	int window = tcp_win_from_space(sysctl_tcp_rmem[2]) >> 1;
+	int window = tcp_win_from_space(tp->rcvbuf_max) >> 1;
 
 	while (tp->rcv_ssthresh <= window) {
 		if (truesize <= skb->len)
@@ -368,7 +369,74 @@ static void tcp_fixup_rcvbuf(struct sock *sk)
 	rcvmem *= icwnd;
 
 	if (sk->sk_rcvbuf < rcvmem)
-		sk->sk_rcvbuf = min(rcvmem, sysctl_tcp_rmem[2]);
+		sk->sk_rcvbuf = min(rcvmem, tcp_sk(sk)->rcvbuf_max);
+}
+
+/*
+ * Devices can set their own buffer sizes, for links whose bandwidth-delay
+ * product the global tcp_rmem/tcp_wmem don't fit.  The size a connection
+ * starts with and the ceiling autotuning grows it to come from the device
+ * it leaves through, when that device has set them.  Window scaling still
+ * follows the global maximum, which is to be set to the largest one.
+ */
+void tcp_init_buffer_limits(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	const struct dst_entry *dst = __sk_dst_get(sk);
+	struct in_device *in_dev;
+	int val;
+
+	if (!dst)
+		return;
+
+	rcu_read_lock();
+	in_dev = __in_dev_get_rcu(dst->dev);
+	if (in_dev) {
+		val = IN_DEV_CONF_GET(in_dev, TCP_RMEM_MAX);
+		if (val > 0)
+			tp->rcvbuf_max = val;
+		val = IN_DEV_CONF_GET(in_dev, TCP_WMEM_MAX);
+		if (val > 0)
+			tp->sndbuf_max = val;
+
+		val = IN_DEV_CONF_GET(in_dev, TCP_RMEM_DEF);
+		if (val > 0 && !(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
+			sk->sk_rcvbuf = min(val, tp->rcvbuf_max);
+		val = IN_DEV_CONF_GET(in_dev, TCP_WMEM_DEF);
+		if (val > 0 && !(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
+			sk->sk_sndbuf = min(val, tp->sndbuf_max);
+	}
+	rcu_read_unlock();
+}
+
+/* Called as the socket goes, adds its buffer sizes to its device's stats. */
+void tcp_tune_account(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct in_dev_tcp_stats *stats;
+	struct net_device *dev;
+	struct in_device *in_dev;
+
+	if (!tp->tune_ifindex)
+		return;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(sock_net(sk), tp->tune_ifindex);
+	in_dev = dev ? __in_dev_get_rcu(dev) : NULL;
+	if (in_dev) {
+		stats = &in_dev->tcp_stats;
+		atomic_inc(&stats->conns);
+		atomic64_add(sk->sk_rcvbuf, &stats->rcvbuf_sum);
+		atomic64_add(sk->sk_sndbuf, &stats->sndbuf_sum);
+		if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK) &&
+		    sk->sk_rcvbuf >= tp->rcvbuf_max)
+			atomic_inc(&stats->rcvbuf_capped);
+		if (!(sk->sk_userlocks & SOCK_SNDBUF_LOCK) &&
+		    sk->sk_sndbuf >= tp->sndbuf_max)
+			atomic_inc(&stats->sndbuf_capped);
+	}
+	rcu_read_unlock();
+	tp->tune_ifindex = 0;
 }
 
 /* 4. Try to fixup all. It is made immediately after connection enters
@@ -377,8 +445,13 @@ static void tcp_fixup_rcvbuf(struct sock *sk)
 static void tcp_init_buffer_space(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
+	const struct dst_entry *dst = __sk_dst_get(sk);
 	int maxwin;
 
+	tcp_init_buffer_limits(sk);
+	if (dst)
+		tp->tune_ifindex = dst->dev->ifindex;
+
 	if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
 		tcp_fixup_rcvbuf(sk);
 	if (!(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
@@ -415,12 +488,12 @@ static void tcp_clamp_window(struct sock *sk)
 
 	icsk->icsk_ack.quick = 0;
 
-	if (sk->sk_rcvbuf < sysctl_tcp_rmem[2] &&
+	if (sk->sk_rcvbuf < tp->rcvbuf_max &&
 	    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK) &&
 	    !sk_under_memory_pressure(sk) &&
 	    sk_memory_allocated(sk) < sk_prot_mem_limits(sk, 0)) {
 		sk->sk_rcvbuf = min(atomic_read(&sk->sk_rmem_alloc),
-				    sysctl_tcp_rmem[2]);
+				    tp->rcvbuf_max);
 	}
 	if (atomic_read(&sk->sk_rmem_alloc) > sk->sk_rcvbuf)
 		tp->rcv_ssthresh = min(tp->window_clamp, 2U * tp->advmss);
@@ -557,7 +630,7 @@ void tcp_rcv_space_adjust(struct sock *sk)
 			while (tcp_win_from_space(rcvmem) < tp->advmss)
 				rcvmem += 128;
 			space *= rcvmem;
-			space = min(space, sysctl_tcp_rmem[2]);
+			space = min(space, tp->rcvbuf_max);
 			if (space > sk->sk_rcvbuf) {
 				sk->sk_rcvbuf = space;
 
@@ -5051,7 +5124,7 @@ static void tcp_new_space(struct sock *sk)
 				     tp->reordering + 1);
 		sndmem *= 2 * demanded;
 		if (sndmem > sk->sk_sndbuf)
-			sk->sk_sndbuf = min(sndmem, sysctl_tcp_wmem[2]);
+			sk->sk_sndbuf = min(sndmem, tp->sndbuf_max);
 		tp->snd_cwnd_stamp = tcp_time_stamp;
 	}
 
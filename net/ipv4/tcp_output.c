@@ -35,6 +35,7 @@
  */
 
 #include <net/tcp.h>
+#include <linux/inetdevice.h>
 
 #include <linux/compiler.h>
 #include <linux/gfp.h>
@@ -251,6 +252,24 @@ void tcp_select_initial_window(int __space, __u32 mss,
 }
 EXPORT_SYMBOL(tcp_select_initial_window);
 
+/* The route's initrwnd wins over the one its device is configured with. */
+static u32 tcp_dst_initrwnd(const struct dst_entry *dst)
+{
+	struct in_device *in_dev;
+	u32 initrwnd = dst_metric(dst, RTAX_INITRWND);
+
+	if (initrwnd)
+		return initrwnd;
+
+	rcu_read_lock();
+	in_dev = __in_dev_get_rcu(dst->dev);
+	if (in_dev)
+		initrwnd = IN_DEV_CONF_GET(in_dev, TCP_INITRWND);
+	rcu_read_unlock();
+
+	return initrwnd;
+}
+
 /* Chose a new window to advertise, update state in tcp_sock for the
  * socket, and return result with RFC1323 scaling applied.  The return
  * value can be stuffed directly into th->window for an outgoing
@@ -2484,7 +2503,7 @@ struct sk_buff *tcp_make_synack(struct sock *sk, struct dst_entry *dst,
 			&req->window_clamp,
 			ireq->wscale_ok,
 			&rcv_wscale,
-			dst_metric(dst, RTAX_INITRWND));
+			tcp_dst_initrwnd(dst));
 		ireq->rcv_wscale = rcv_wscale;
 	}
 
@@ -2602,6 +2621,7 @@ static void tcp_connect_init(struct sock *sk)
 		tp->advmss = tp->rx_opt.user_mss;
 
 	tcp_initialize_rcv_mss(sk);
+	tcp_init_buffer_limits(sk);
 
 	/* limit the window selection if the user enforce a smaller rx buffer */
 	if (sk->sk_userlocks & SOCK_RCVBUF_LOCK &&
@@ -2614,7 +2634,7 @@ static void tcp_connect_init(struct sock *sk)
 				  &tp->window_clamp,
 				  sysctl_tcp_window_scaling,
 				  &rcv_wscale,
-				  dst_metric(dst, RTAX_INITRWND));
+				  tcp_dst_initrwnd(dst));
 
 	tp->rx_opt.rcv_wscale = rcv_wscale;
 	tp->rcv_ssthresh = tp->rcv_wnd;
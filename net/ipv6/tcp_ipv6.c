@@ -1887,6 +1887,8 @@ static int tcp_v6_init_sock(struct sock *sk)
 	 */
 	sk->sk_sndbuf = sysctl_tcp_wmem[1];
 	sk->sk_rcvbuf = sysctl_tcp_rmem[1];
+	tp->sndbuf_max = sysctl_tcp_wmem[2];
+	tp->rcvbuf_max = sysctl_tcp_rmem[2];
 
 	local_bh_disable();
 	sock_update_memcg(sk);
@@ -15,10 +15,12 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/rculist.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
@@ -187,17 +189,26 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  *     iface_stat_list_lock
  *
  * qtaguid_mt()
+ *   iface_stat_update_from_skb()
+ *     rcu_read_lock
+ *       (iface_stat_list)
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock
+ *         (iface_stat_list)
+ *         get_sock_stat()
+ *           (sock_tag_hash)
+ *         (struct iface_stat->tag_stat_hash)
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             (tag_counter_set_hash)
+ *         struct iface_stat->tag_stat_list_lock
+ *           create_if_tag_stat()
+ *           tag_stat_update()
+ *
+ * The per packet path only takes a lock to add a tag_stat. Entries reachable
+ * through the RCU lists and hashes are freed after a grace period, and
+ * the iface_stat are never freed.
  *
  *
  * qtaguid_ctrl_parse()
@@ -227,9 +238,15 @@ static DEFINE_SPINLOCK(iface_stat_list_lock);
 
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
+/* Same entries as sock_tag_tree, updated under sock_tag_list_lock */
+#define SOCK_TAG_HASH_BITS 8
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+/* Same entries as tag_counter_set_tree */
+#define TAG_COUNTER_SET_HASH_BITS 4
+static struct hlist_head tag_counter_set_hash[1 << TAG_COUNTER_SET_HASH_BITS];
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -337,6 +354,27 @@ static void tag_node_tree_insert(struct tag_node *data, struct rb_root *root)
 	rb_insert_color(&data->node, root);
 }
 
+/* Caller must hold rcu_read_lock or the lock of the hash */
+static struct tag_node *tag_node_hash_search(struct hlist_head *hash,
+					     int bits, tag_t tag)
+{
+	struct tag_node *data;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(data, node, &hash[hash_64(tag, bits)],
+				 hash_node) {
+		if (data->tag == tag)
+			return data;
+	}
+	return NULL;
+}
+
+static void tag_node_hash_insert(struct tag_node *data,
+				 struct hlist_head *hash, int bits)
+{
+	hlist_add_head_rcu(&data->hash_node, &hash[hash_64(data->tag, bits)]);
+}
+
 static void tag_stat_tree_insert(struct tag_stat *data, struct rb_root *root)
 {
 	tag_node_tree_insert(&data->tn, root);
@@ -350,6 +388,18 @@ static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 	return rb_entry(&node->node, struct tag_stat, tn.node);
 }
 
+static struct tag_stat *tag_stat_hash_search(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	struct tag_node *node;
+
+	node = tag_node_hash_search(iface_entry->tag_stat_hash,
+				    TAG_STAT_HASH_BITS, tag);
+	if (!node)
+		return NULL;
+	return container_of(node, struct tag_stat, tn);
+}
+
 static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
@@ -435,7 +485,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -750,23 +800,27 @@ static int get_active_counter_set(tag_t tag)
 {
 	int active_set = 0;
 	struct tag_counter_set *tcs;
+	struct tag_node *node;
 
 	MT_DEBUG("qtaguid: get_active_counter_set(tag=0x%llx)"
 		 " (uid=%u)\n",
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
-	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	rcu_read_lock();
+	node = tag_node_hash_search(tag_counter_set_hash,
+				    TAG_COUNTER_SET_HASH_BITS, tag);
+	if (node) {
+		tcs = container_of(node, struct tag_counter_set, tn);
+		active_set = ACCESS_ONCE(tcs->active_set);
+	}
+	rcu_read_unlock();
 	return active_set;
 }
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -779,7 +833,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -797,6 +851,7 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 	int len;
 	int fmt = (int)data; /* The data is just 1 (old) or 2 (uses fmt) */
 	struct iface_stat *iface_entry;
+	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
 	struct rtnl_link_stats64 dev_stats, *stats;
 	struct rtnl_link_stats64 no_dev_stats = {0};
 
@@ -866,15 +921,16 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 				stats->tx_bytes, stats->tx_packets
 				);
 		} else {
+			iface_stat_fold_skb(iface_entry, totals_via_skb);
 			len = snprintf(
 				outp, char_count,
 				"%s "
 				"%llu %llu %llu %llu\n",
 				iface_entry->ifname,
-				iface_entry->totals_via_skb[IFS_RX].bytes,
-				iface_entry->totals_via_skb[IFS_RX].packets,
-				iface_entry->totals_via_skb[IFS_TX].bytes,
-				iface_entry->totals_via_skb[IFS_TX].packets
+				totals_via_skb[IFS_RX].bytes,
+				totals_via_skb[IFS_RX].packets,
+				totals_via_skb[IFS_TX].bytes,
+				totals_via_skb[IFS_TX].packets
 				);
 		}
 		if (len >= char_count) {
@@ -961,7 +1017,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	struct iface_stat *new_iface;
 	struct iface_stat_work *isw;
 
-	new_iface = kzalloc(sizeof(*new_iface), GFP_ATOMIC);
+	new_iface = kzalloc(sizeof(*new_iface) +
+			    nr_cpu_ids * sizeof(new_iface->cpu[0]), GFP_ATOMIC);
 	if (new_iface == NULL) {
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "iface_stat alloc failed\n", net_dev->name);
@@ -994,7 +1051,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1186,16 +1243,29 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
+static void sock_tag_hash_insert(struct sock_tag *st_entry)
+{
+	hlist_add_head_rcu(&st_entry->hash_node,
+			   &sock_tag_hash[hash_ptr(st_entry->sk,
+						   SOCK_TAG_HASH_BITS)]);
+}
+
+/* Caller must hold rcu_read_lock */
 static struct sock_tag *get_sock_stat(const struct sock *sk)
 {
 	struct sock_tag *sock_tag_entry;
+	struct hlist_node *node;
 	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
 	if (!sk)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	hlist_for_each_entry_rcu(sock_tag_entry, node,
+				 &sock_tag_hash[hash_ptr(sk,
+							 SOCK_TAG_HASH_BITS)],
+				 hash_node) {
+		if (sock_tag_entry->sk == sk)
+			return sock_tag_entry;
+	}
+	return NULL;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1302,6 +1372,7 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 				       struct xt_action_param *par)
 {
 	struct iface_stat *entry;
+	struct iface_stat_cpu *isc;
 	const struct net_device *el_dev;
 	enum ifs_tx_rx direction = par->in ? IFS_RX : IFS_TX;
 	int bytes = skb->len;
@@ -1336,23 +1407,38 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	entry->totals_via_skb[direction].bytes += bytes;
-	entry->totals_via_skb[direction].packets++;
-	spin_unlock_bh(&iface_stat_list_lock);
+	/* Matches run with BH disabled, we stay on this cpu */
+	isc = &entry->cpu[smp_processor_id()];
+	u64_stats_update_begin(&isc->syncp);
+	isc->totals_via_skb[direction].bytes += bytes;
+	isc->totals_via_skb[direction].packets++;
+	u64_stats_update_end(&isc->syncp);
+	rcu_read_unlock();
+}
+
+static void tag_stat_cpu_update(struct tag_stat *tag_entry, int set,
+				enum ifs_tx_rx direction, int proto, int bytes)
+{
+	struct tag_stat_cpu *tsc = &tag_entry->cpu[smp_processor_id()];
+
+	u64_stats_update_begin(&tsc->syncp);
+	data_counters_update(&tsc->counters, set, direction, proto, bytes);
+	u64_stats_update_end(&tsc->syncp);
 }
 
+/* Called with BH disabled, from the match */
 static void tag_stat_update(struct tag_stat *tag_entry,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
@@ -1362,32 +1448,37 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	tag_stat_cpu_update(tag_entry, active_set, direction, proto, bytes);
+	if (tag_entry->parent)
+		tag_stat_cpu_update(tag_entry->parent, active_set,
+				    direction, proto, bytes);
 }
 
 /*
  * Create a new entry for tracking the specified {acct_tag,uid_tag} within
- * the interface.
+ * the interface. It is fully set up before the RCU readers can see it.
  * iface_entry->tag_stat_list_lock should be held.
  */
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+					   tag_t tag, struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
-	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
+	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry) +
+				     nr_cpu_ids *
+				     sizeof(new_tag_stat_entry->cpu[0]),
+				     GFP_ATOMIC);
 	if (!new_tag_stat_entry) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent = parent;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	tag_node_hash_insert(&new_tag_stat_entry->tn,
+			     iface_entry->tag_stat_hash, TAG_STAT_HASH_BITS);
 done:
 	return new_tag_stat_entry;
 }
@@ -1399,7 +1490,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct tag_stat *uid_tag_stat;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
@@ -1407,12 +1498,12 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
 		       ifname);
-		return;
+		goto out;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
@@ -1436,19 +1527,24 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
-
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      tag);
+	/* Look for {acct_tag,uid_tag} under this interface */
+	tag_stat_entry = tag_stat_hash_search(iface_entry, tag);
 	if (tag_stat_entry) {
 		/*
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		goto out;
+	}
+
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	/* Another cpu might have added it meanwhile */
+	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					      tag);
+	if (tag_stat_entry) {
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		goto out_unlock;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1460,16 +1556,17 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * No parent counters. So
 		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
 		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
+		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag, NULL);
+		uid_tag_stat = new_tag_stat;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_stat = tag_stat_entry;
 	}
 
 	if (acct_tag) {
 		/* Create the child {acct_tag, uid_tag} and hook up parent. */
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
+		if (uid_tag_stat)
+			new_tag_stat = create_if_tag_stat(iface_entry, tag,
+							  uid_tag_stat);
 	} else {
 		/*
 		 * For new_tag_stat to be still NULL here would require:
@@ -1477,12 +1574,16 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 *  and {acct_tag, uid_tag} doesn't exist
 		 *  AND acct_tag == 0.
 		 * Impossible. This reassures us that new_tag_stat
-		 * below will always be assigned.
+		 * below is only NULL if the allocation failed.
 		 */
-		BUG_ON(!new_tag_stat);
+		BUG_ON(tag_stat_entry);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
+	if (new_tag_stat)
+		tag_stat_update(new_tag_stat, direction, proto, bytes);
+out_unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+out:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1773,6 +1874,9 @@ static bool qtaguid_mt(const struct sk_buff *skb, struct xt_action_param *par)
 	}
 
 	sk = skb->sk;
+	/* early demux can leave a TIME_WAIT socket on incoming packets */
+	if (sk && sk->sk_state == TCP_TIME_WAIT)
+		sk = NULL;
 	if (sk == NULL) {
 		/*
 		 * A missing sk->sk_socket happens when packets are in-flight
@@ -2095,6 +2199,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			hlist_del_rcu(&st_entry->hash_node);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2127,7 +2232,8 @@ static int ctrl_cmd_delete(const char *input)
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		hlist_del_rcu(&tcs_entry->tn.hash_node);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2158,7 +2264,12 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				hlist_del_rcu(&ts_entry->tn.hash_node);
+				/*
+				 * A parent only goes along with its
+				 * children, so it outlives their readers.
+				 */
+				kfree_rcu(ts_entry, rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2241,11 +2352,13 @@ static int ctrl_cmd_counter_set(const char *input)
 		}
 		tcs->tn.tag = tag;
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		tag_node_hash_insert(&tcs->tn, tag_counter_set_hash,
+				     TAG_COUNTER_SET_HASH_BITS);
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
-	tcs->active_set = counter_set;
+	ACCESS_ONCE(tcs->active_set) = counter_set;
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2324,11 +2437,26 @@ static int ctrl_cmd_tag(const char *input)
 	tag_ref_entry->num_sock_tags++;
 	if (sock_tag_entry) {
 		struct tag_ref *prev_tag_ref_entry;
+		struct sock_tag *prev_sock_tag_entry = sock_tag_entry;
 
 		CT_DEBUG("qtaguid: ctrl_tag(%s): retag for sk=%p "
 			 "st@%p ...->f_count=%ld\n",
 			 input, el_socket->sk, sock_tag_entry,
 			 atomic_long_read(&el_socket->file->f_count));
+		/*
+		 * The matches read the tag without locking, so swap in a
+		 * new entry instead of changing the tag in place.
+		 */
+		sock_tag_entry = kmemdup(prev_sock_tag_entry,
+					 sizeof(*sock_tag_entry), GFP_ATOMIC);
+		if (!sock_tag_entry) {
+			pr_err("qtaguid: ctrl_tag(%s): "
+			       "socket tag alloc failed\n",
+			       input);
+			spin_unlock_bh(&sock_tag_list_lock);
+			res = -ENOMEM;
+			goto err_tag_unref_put;
+		}
 		/*
 		 * This is a re-tagging, so release the sock_fd that was
 		 * locked at the time of the 1st tagging.
@@ -2342,6 +2470,17 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
 		sock_tag_entry->tag = full_tag;
+
+		rb_replace_node(&prev_sock_tag_entry->sock_node,
+				&sock_tag_entry->sock_node, &sock_tag_tree);
+		hlist_replace_rcu(&prev_sock_tag_entry->hash_node,
+				  &sock_tag_entry->hash_node);
+		/* See the list_del() in ctrl_cmd_delete() */
+		if (prev_sock_tag_entry->list.next &&
+		    prev_sock_tag_entry->list.prev)
+			list_replace(&prev_sock_tag_entry->list,
+				     &sock_tag_entry->list);
+		kfree_rcu(prev_sock_tag_entry, rcu);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2381,6 +2520,7 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_hash_insert(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2447,6 +2587,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	hlist_del_rcu(&sock_tag_entry->hash_node);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2483,7 +2624,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2570,7 +2711,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters counters, *cnts = &counters;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2600,7 +2741,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_fold_counters(ppi->ts_entry, cnts);
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2848,6 +2989,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		hlist_del_rcu(&st_entry->hash_node);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
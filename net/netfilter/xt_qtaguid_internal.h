@@ -11,8 +11,11 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -182,28 +185,47 @@ struct data_counters {
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
 	struct rb_node node;
+	/* For the RCU lookups done per packet, unused by tag_ref */
+	struct hlist_node hash_node;
 	tag_t tag;
 };
 
+/*
+ * The counters are only ever updated by the CPU they belong to, with BH
+ * disabled. The readers add up all the CPUs.
+ */
+struct tag_stat_cpu {
+	struct data_counters counters;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+#define TAG_STAT_HASH_BITS 6
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct rcu_head rcu;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/* nr_cpu_ids entries */
+	struct tag_stat_cpu cpu[0];
 };
 
+struct iface_stat_cpu {
+	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
 struct iface_stat {
-	struct list_head list;  /* in iface_stat_list */
+	struct list_head list;  /* in iface_stat_list, RCU for the readers */
 	char *ifname;
 	bool active;
 	/* net_dev is only valid for active iface_stat */
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -219,7 +241,12 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
+	/* Same entries as tag_stat_tree, looked up under RCU per packet */
+	struct hlist_head tag_stat_hash[1 << TAG_STAT_HASH_BITS];
 	spinlock_t tag_stat_list_lock;
+
+	/* totals_via_skb, nr_cpu_ids entries */
+	struct iface_stat_cpu cpu[0];
 };
 
 /* This is needed to create proc_dir_entries from atomic context. */
@@ -236,6 +263,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* in sock_tag_hash, for the per packet lookups */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -243,6 +273,7 @@ struct sock_tag {
 	struct list_head list;   /* in proc_qtu_data.sock_tag_list */
 	pid_t pid;
 
+	/* Never changes, a retag replaces the whole sock_tag */
 	tag_t tag;
 };
 
@@ -281,6 +312,7 @@ struct qtaguid_event_counts {
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
+	struct rcu_head rcu;
 	int active_set;
 };
 
@@ -329,5 +361,60 @@ struct proc_qtu_data {
 	/* No spinlock_t sock_tag_list_lock; use the global one. */
 };
 
+/*----------------------------------------------*/
+/*
+ * Add up the per cpu counters for reporting.
+ * The caller must have BH disabled, typically by holding a _bh lock.
+ */
+static inline void tag_stat_fold_counters(const struct tag_stat *ts,
+					  struct data_counters *dc)
+{
+	const struct tag_stat_cpu *tsc;
+	const struct byte_packet_counters *src;
+	struct byte_packet_counters *dst;
+	unsigned int start;
+	uint64_t bytes, packets;
+	int cpu, i;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		tsc = &ts->cpu[cpu];
+		src = &tsc->counters.bpc[0][0][0];
+		dst = &dc->bpc[0][0][0];
+		for (i = 0; i < sizeof(dc->bpc) / sizeof(*dst); i++) {
+			do {
+				start = u64_stats_fetch_begin(&tsc->syncp);
+				bytes = src[i].bytes;
+				packets = src[i].packets;
+			} while (u64_stats_fetch_retry(&tsc->syncp, start));
+			dst[i].bytes += bytes;
+			dst[i].packets += packets;
+		}
+	}
+}
+
+static inline void iface_stat_fold_skb(const struct iface_stat *is,
+				       struct byte_packet_counters *totals)
+{
+	const struct iface_stat_cpu *isc;
+	unsigned int start;
+	uint64_t bytes, packets;
+	int cpu, dir;
+
+	memset(totals, 0, sizeof(*totals) * IFS_MAX_DIRECTIONS);
+	for_each_possible_cpu(cpu) {
+		isc = &is->cpu[cpu];
+		for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++) {
+			do {
+				start = u64_stats_fetch_begin(&isc->syncp);
+				bytes = isc->totals_via_skb[dir].bytes;
+				packets = isc->totals_via_skb[dir].packets;
+			} while (u64_stats_fetch_retry(&isc->syncp, start));
+			totals[dir].bytes += bytes;
+			totals[dir].packets += packets;
+		}
+	}
+}
+
 /*----------------------------------------------*/
 #endif  /* ifndef __XT_QTAGUID_INTERNAL_H__ */
@@ -0,0 +1,567 @@
+/*
+ * xt_uidset - match the owner of local sockets against a named set of uids
+ *
+ * One rule stands in for a whole chain of xt_owner rules: single uids live
+ * in an open addressed hash and uid ranges in a sorted array, so a lookup
+ * costs about the same however large the set grows.  All rules naming the
+ * same set share it, and /proc/net/xt_uidset/<name> edits it in place
+ * without touching the ruleset:
+ *
+ *	+<uid>[-<uid>]	add a uid or an inclusive range of uids
+ *	-<uid>[-<uid>]	remove them
+ *	/		flush the set
+ *
+ * Commands are separated by white space; all the commands of one write()
+ * take effect together, so "/ +10001 +10005-10010" replaces a set without
+ * packets ever seeing it empty.  Reading the file gives the hit and lookup
+ * counters followed by the members, one per line.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License; either
+ *	version 2 of the License, as published by the Free Software Foundation.
+ */
+#include <linux/file.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <net/sock.h>
+
+#include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_uidset.h>
+
+/* no uid is ever (uid_t)-1, so it marks the free hash slots */
+#define UIDSET_EMPTY	((u32)-1)
+#define UIDSET_MAX_WRITE	(64 * 1024)
+
+struct uidset_range {
+	u32 min;
+	u32 max;
+};
+
+/*
+ * Replaced as a whole on every update, so readers only need rcu.  @ranges
+ * points behind @slots and is sorted, without overlaps.
+ */
+struct uidset_table {
+	struct rcu_head rcu;
+	unsigned int hash_bits;
+	unsigned int nr_ranges;
+	struct uidset_range *ranges;
+	u32 slots[0];
+};
+
+struct uidset_stats {
+	u64 lookups;
+	u64 hits;
+};
+
+struct xt_uidset {
+	struct list_head list;
+	unsigned int ref;
+	char name[XT_UIDSET_NAME_LEN];
+	struct uidset_table __rcu *table;
+	struct uidset_stats __percpu *stats;
+	struct proc_dir_entry *procfs_entry;
+};
+
+/* scratch list of ranges an update is applied to */
+struct uidset_list {
+	struct uidset_range *r;
+	unsigned int nr;
+	unsigned int max;
+};
+
+/*
+ * uidset_sets_mutex covers the list of sets, their refcounts and proc
+ * entries; uidset_mutex serializes the updates of the tables.  They are
+ * separate because removing a proc entry waits for its writers.
+ */
+static DEFINE_MUTEX(uidset_sets_mutex);
+static DEFINE_MUTEX(uidset_mutex);
+static LIST_HEAD(uidset_sets);
+
+static struct proc_dir_entry *proc_xt_uidset;
+static unsigned int uidset_perms = S_IRUGO | S_IWUSR;
+static unsigned int uidset_uid   = 0;
+static unsigned int uidset_gid   = 0;
+module_param_named(perms, uidset_perms, uint, S_IRUGO | S_IWUSR);
+module_param_named(uid, uidset_uid, uint, S_IRUGO | S_IWUSR);
+module_param_named(gid, uidset_gid, uint, S_IRUGO | S_IWUSR);
+
+static bool uidset_table_lookup(const struct uidset_table *t, u32 uid)
+{
+	unsigned int mask = (1U << t->hash_bits) - 1;
+	unsigned int i = hash_32(uid, t->hash_bits);
+	unsigned int lo = 0, hi = t->nr_ranges;
+
+	for (; t->slots[i] != UIDSET_EMPTY; i = (i + 1) & mask)
+		if (t->slots[i] == uid)
+			return true;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (uid < t->ranges[mid].min)
+			hi = mid;
+		else if (uid > t->ranges[mid].max)
+			lo = mid + 1;
+		else
+			return true;
+	}
+	return false;
+}
+
+/* @l must be sorted and merged, see uidset_list_normalize() */
+static struct uidset_table *uidset_table_build(const struct uidset_list *l)
+{
+	struct uidset_table *t;
+	unsigned int i, j, nr_single = 0, bits, mask;
+
+	for (i = 0; i < l->nr; i++)
+		if (l->r[i].min == l->r[i].max)
+			nr_single++;
+
+	/* at most half full, so probe sequences stay short */
+	bits = max(ilog2(roundup_pow_of_two(2 * nr_single + 1)), 1);
+	mask = (1U << bits) - 1;
+
+	t = kmalloc(sizeof(*t) + (mask + 1) * sizeof(u32) +
+		    (l->nr - nr_single) * sizeof(struct uidset_range),
+		    GFP_KERNEL);
+	if (t == NULL)
+		return NULL;
+
+	t->hash_bits = bits;
+	t->nr_ranges = 0;
+	t->ranges = (struct uidset_range *)&t->slots[mask + 1];
+	memset(t->slots, 0xff, (mask + 1) * sizeof(u32));
+
+	for (i = 0; i < l->nr; i++) {
+		if (l->r[i].min != l->r[i].max) {
+			t->ranges[t->nr_ranges++] = l->r[i];
+			continue;
+		}
+		for (j = hash_32(l->r[i].min, bits);
+		     t->slots[j] != UIDSET_EMPTY; j = (j + 1) & mask)
+			;
+		t->slots[j] = l->r[i].min;
+	}
+	return t;
+}
+
+static int uidset_list_add(struct uidset_list *l, u32 min, u32 max)
+{
+	if (l->nr == l->max) {
+		unsigned int n = max(2 * l->max, 16U);
+		struct uidset_range *r;
+
+		r = krealloc(l->r, n * sizeof(*r), GFP_KERNEL);
+		if (r == NULL)
+			return -ENOMEM;
+		l->r = r;
+		l->max = n;
+	}
+	l->r[l->nr].min = min;
+	l->r[l->nr].max = max;
+	l->nr++;
+	return 0;
+}
+
+static int uidset_list_remove(struct uidset_list *l, u32 min, u32 max)
+{
+	unsigned int i, nr = l->nr;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		struct uidset_range *r = &l->r[i];
+
+		if (r->max < min || r->min > max)
+			continue;
+		if (r->min < min && r->max > max) {
+			/* punch a hole: keep the tail as a new range */
+			ret = uidset_list_add(l, max + 1, l->r[i].max);
+			if (ret < 0)
+				return ret;
+			l->r[i].max = min - 1;
+		} else if (r->min < min) {
+			r->max = min - 1;
+		} else if (r->max > max) {
+			r->min = max + 1;
+		} else {
+			/* dead, dropped by uidset_list_normalize() */
+			r->min = 1;
+			r->max = 0;
+		}
+	}
+	return 0;
+}
+
+static int uidset_range_cmp(const void *a, const void *b)
+{
+	const struct uidset_range *ra = a, *rb = b;
+
+	if (ra->min != rb->min)
+		return ra->min < rb->min ? -1 : 1;
+	return 0;
+}
+
+/* sort, drop the dead ranges and merge the overlapping or adjacent ones */
+static void uidset_list_normalize(struct uidset_list *l)
+{
+	unsigned int i, n = 0;
+
+	sort(l->r, l->nr, sizeof(*l->r), uidset_range_cmp, NULL);
+	for (i = 0; i < l->nr; i++) {
+		if (l->r[i].min > l->r[i].max)
+			continue;
+		if (n > 0 && l->r[i].min <= l->r[n - 1].max + 1) {
+			l->r[n - 1].max = max(l->r[n - 1].max, l->r[i].max);
+			continue;
+		}
+		l->r[n++] = l->r[i];
+	}
+	l->nr = n;
+}
+
+static int uidset_table_to_list(const struct uidset_table *t,
+				struct uidset_list *l)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < (1U << t->hash_bits); i++) {
+		if (t->slots[i] == UIDSET_EMPTY)
+			continue;
+		ret = uidset_list_add(l, t->slots[i], t->slots[i]);
+		if (ret < 0)
+			return ret;
+	}
+	for (i = 0; i < t->nr_ranges; i++) {
+		ret = uidset_list_add(l, t->ranges[i].min, t->ranges[i].max);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+/* "<uid>" or "<uid>-<uid>" */
+static int uidset_parse_range(char *s, u32 *min, u32 *max)
+{
+	char *dash = strchr(s, '-');
+	int ret;
+
+	if (dash != NULL)
+		*dash++ = '\0';
+	ret = kstrtou32(s, 10, min);
+	if (ret < 0)
+		return ret;
+	if (dash == NULL) {
+		*max = *min;
+	} else {
+		ret = kstrtou32(dash, 10, max);
+		if (ret < 0)
+			return ret;
+	}
+	if (*min > *max || *max == UIDSET_EMPTY)
+		return -EINVAL;
+	return 0;
+}
+
+static int uidset_apply(struct uidset_list *l, char *buf)
+{
+	char *tok;
+	u32 min, max;
+	int ret;
+
+	while ((tok = strsep(&buf, " \t\n")) != NULL) {
+		switch (*tok) {
+		case '\0':
+			continue;
+		case '/':
+			if (tok[1] != '\0')
+				return -EINVAL;
+			l->nr = 0;
+			continue;
+		case '+':
+		case '-':
+			ret = uidset_parse_range(tok + 1, &min, &max);
+			if (ret < 0)
+				return ret;
+			if (*tok == '+')
+				ret = uidset_list_add(l, min, max);
+			else
+				ret = uidset_list_remove(l, min, max);
+			if (ret < 0)
+				return ret;
+			continue;
+		default:
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static ssize_t uidset_proc_write(struct file *file, const char __user *input,
+				 size_t size, loff_t *loff)
+{
+	struct xt_uidset *set = PDE(file->f_path.dentry->d_inode)->data;
+	struct uidset_list l = { NULL, 0, 0 };
+	struct uidset_table *old, *new;
+	char *buf;
+	int ret;
+
+	if (size > UIDSET_MAX_WRITE)
+		return -EFBIG;
+
+	buf = kmalloc(size + 1, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+	if (copy_from_user(buf, input, size)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+	buf[size] = '\0';
+
+	mutex_lock(&uidset_mutex);
+	old = rcu_dereference_protected(set->table,
+					lockdep_is_held(&uidset_mutex));
+	ret = uidset_table_to_list(old, &l);
+	if (ret == 0)
+		ret = uidset_apply(&l, buf);
+	if (ret == 0) {
+		uidset_list_normalize(&l);
+		new = uidset_table_build(&l);
+		if (new == NULL) {
+			ret = -ENOMEM;
+		} else {
+			rcu_assign_pointer(set->table, new);
+			kfree_rcu(old, rcu);
+		}
+	}
+	mutex_unlock(&uidset_mutex);
+
+	kfree(l.r);
+	kfree(buf);
+	return ret < 0 ? ret : size;
+}
+
+static int uidset_proc_show(struct seq_file *m, void *v)
+{
+	struct xt_uidset *set = m->private;
+	struct uidset_list l = { NULL, 0, 0 };
+	u64 lookups = 0, hits = 0;
+	unsigned int i;
+	int cpu, ret;
+
+	for_each_possible_cpu(cpu) {
+		const struct uidset_stats *s = per_cpu_ptr(set->stats, cpu);
+
+		lookups += s->lookups;
+		hits += s->hits;
+	}
+	seq_printf(m, "hits %llu\nlookups %llu\n", hits, lookups);
+
+	mutex_lock(&uidset_mutex);
+	ret = uidset_table_to_list(rcu_dereference_protected(set->table,
+				   lockdep_is_held(&uidset_mutex)), &l);
+	mutex_unlock(&uidset_mutex);
+	if (ret < 0)
+		goto out;
+
+	uidset_list_normalize(&l);
+	for (i = 0; i < l.nr; i++) {
+		if (l.r[i].min == l.r[i].max)
+			seq_printf(m, "%u\n", l.r[i].min);
+		else
+			seq_printf(m, "%u-%u\n", l.r[i].min, l.r[i].max);
+	}
+out:
+	kfree(l.r);
+	return ret;
+}
+
+static int uidset_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uidset_proc_show, PDE(inode)->data);
+}
+
+static const struct file_operations uidset_proc_fops = {
+	.owner		= THIS_MODULE,
+	.open		= uidset_proc_open,
+	.read		= seq_read,
+	.write		= uidset_proc_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void uidset_free(struct xt_uidset *set)
+{
+	kfree(rcu_dereference_protected(set->table, 1));
+	free_percpu(set->stats);
+	kfree(set);
+}
+
+static struct xt_uidset *uidset_alloc(const char *name)
+{
+	struct uidset_list empty = { NULL, 0, 0 };
+	struct xt_uidset *set;
+
+	set = kzalloc(sizeof(*set), GFP_KERNEL);
+	if (set == NULL)
+		return NULL;
+
+	strlcpy(set->name, name, sizeof(set->name));
+	set->ref = 1;
+	set->stats = alloc_percpu(struct uidset_stats);
+	RCU_INIT_POINTER(set->table, uidset_table_build(&empty));
+	if (set->stats == NULL || set->table == NULL)
+		goto err;
+
+	set->procfs_entry = proc_create_data(set->name, uidset_perms,
+					     proc_xt_uidset, &uidset_proc_fops,
+					     set);
+	if (set->procfs_entry == NULL)
+		goto err;
+	set->procfs_entry->uid = uidset_uid;
+	set->procfs_entry->gid = uidset_gid;
+	return set;
+
+err:
+	uidset_free(set);
+	return NULL;
+}
+
+static struct xt_uidset *uidset_get(const char *name)
+{
+	struct xt_uidset *set;
+
+	mutex_lock(&uidset_sets_mutex);
+	list_for_each_entry(set, &uidset_sets, list) {
+		if (strcmp(set->name, name) == 0) {
+			set->ref++;
+			goto out;
+		}
+	}
+
+	set = uidset_alloc(name);
+	if (set != NULL)
+		list_add_tail(&set->list, &uidset_sets);
+out:
+	mutex_unlock(&uidset_sets_mutex);
+	return set;
+}
+
+static int uidset_mt_check(const struct xt_mtchk_param *par)
+{
+	struct xt_uidset_mtinfo *info = par->matchinfo;
+
+	if (info->flags & ~XT_UIDSET_MASK)
+		return -EINVAL;
+
+	info->name[sizeof(info->name) - 1] = '\0';
+	if (*info->name == '\0' || *info->name == '.' ||
+	    strchr(info->name, '/') != NULL) {
+		pr_err("xt_uidset: illegal name\n");
+		return -EINVAL;
+	}
+
+	info->set = uidset_get(info->name);
+	if (info->set == NULL) {
+		pr_err("xt_uidset: memory alloc failure\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void uidset_mt_destroy(const struct xt_mtdtor_param *par)
+{
+	struct xt_uidset_mtinfo *info = par->matchinfo;
+	struct xt_uidset *set = info->set;
+
+	mutex_lock(&uidset_sets_mutex);
+	if (--set->ref > 0) {
+		mutex_unlock(&uidset_sets_mutex);
+		return;
+	}
+	list_del(&set->list);
+	/* waits for the readers and writers of the file to go away */
+	remove_proc_entry(set->name, proc_xt_uidset);
+	mutex_unlock(&uidset_sets_mutex);
+	uidset_free(set);
+}
+
+static bool uidset_mt(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	const struct xt_uidset_mtinfo *info = par->matchinfo;
+	struct xt_uidset *set = info->set;
+	bool invert = info->flags & XT_UIDSET_INVERT;
+	const struct file *filp;
+	bool hit;
+
+	if (skb->sk == NULL || skb->sk->sk_socket == NULL)
+		return invert;
+
+	filp = skb->sk->sk_socket->file;
+	if (filp == NULL)
+		return invert;
+
+	rcu_read_lock();
+	hit = uidset_table_lookup(rcu_dereference(set->table),
+				  filp->f_cred->fsuid);
+	rcu_read_unlock();
+
+	this_cpu_inc(set->stats->lookups);
+	if (hit)
+		this_cpu_inc(set->stats->hits);
+	return hit ^ invert;
+}
+
+static struct xt_match uidset_mt_reg __read_mostly = {
+	.name       = "uidset",
+	.revision   = 0,
+	.family     = NFPROTO_UNSPEC,
+	.checkentry = uidset_mt_check,
+	.match      = uidset_mt,
+	.destroy    = uidset_mt_destroy,
+	.matchsize  = sizeof(struct xt_uidset_mtinfo),
+	.hooks      = (1 << NF_INET_LOCAL_OUT) |
+		      (1 << NF_INET_POST_ROUTING),
+	.me         = THIS_MODULE,
+};
+
+static int __init uidset_mt_init(void)
+{
+	int ret;
+
+	proc_xt_uidset = proc_mkdir("xt_uidset", init_net.proc_net);
+	if (proc_xt_uidset == NULL)
+		return -EACCES;
+
+	ret = xt_register_match(&uidset_mt_reg);
+	if (ret < 0)
+		remove_proc_entry("xt_uidset", init_net.proc_net);
+	return ret;
+}
+
+static void __exit uidset_mt_exit(void)
+{
+	xt_unregister_match(&uidset_mt_reg);
+	remove_proc_entry("xt_uidset", init_net.proc_net);
+}
+
+module_init(uidset_mt_init);
+module_exit(uidset_mt_exit);
+MODULE_DESCRIPTION("Xtables: socket owner matching against a set of uids");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ipt_uidset");
+MODULE_ALIAS("ip6t_uidset");
@@ -0,0 +1,466 @@
+/*
+ * net/sched/sch_batch.c	Hold background traffic until the link is awake
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * On cellular and wifi links every packet sent while the radio is idle
+ * wakes it up, and it then stays in a high power state for a few seconds.
+ * Background traffic (keepalives, syncs) sent at unaligned times keeps
+ * waking the radio for a handful of bytes each time.
+ *
+ * This qdisc holds such packets, selected by skb->priority or skb->mark,
+ * for up to "window" while the link is idle.  They are sent as soon as
+ * any other packet goes out, since the radio is up anyway, or when the
+ * oldest of them has waited for "window", or when "defer_limit" of them
+ * are held.  The link counts as awake for "active" after each packet.
+ *
+ * Packets sent while the link was idle count as wakeups.  The wakeups and
+ * held packets are counted per uid of the sending socket, and reported in
+ * /proc/net/sch_batch.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
+#include <linux/file.h>
+#include <linux/cred.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/rtnetlink.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sock.h>
+
+#define BATCH_UID_HASH_BITS	5
+#define BATCH_UID_HASH_SIZE	(1 << BATCH_UID_HASH_BITS)
+#define BATCH_MAX_UIDS		256
+
+struct batch_uid_stats {
+	struct hlist_node	node;
+	uid_t			uid;
+	u32			packets;
+	u64			bytes;
+	u32			wakeups;
+	u32			deferred;
+	u64			delay_us;	/* total time held */
+};
+
+struct batch_sched_data {
+	u32			limit;
+	psched_time_t		window;
+	psched_time_t		active;
+	u32			defer_limit;
+	u32			prio_mask;
+	u32			mark;
+	u32			mark_mask;
+
+	struct sk_buff_head	urgent;
+	struct sk_buff_head	deferred;
+	psched_time_t		last_tx;
+	struct qdisc_watchdog	watchdog;
+
+	struct tc_batch_xstats	stats;
+	struct hlist_head	uids[BATCH_UID_HASH_SIZE];
+	int			nr_uids;
+
+	struct list_head	list;
+	struct Qdisc		*sch;
+};
+
+struct batch_skb_cb {
+	psched_time_t		time;
+	uid_t			uid;
+};
+
+/* all the batch qdiscs, for the proc file, protected by rtnl */
+static LIST_HEAD(batch_list);
+
+static inline struct batch_skb_cb *batch_skb_cb(struct sk_buff *skb)
+{
+	qdisc_cb_private_validate(skb, sizeof(struct batch_skb_cb));
+	return (struct batch_skb_cb *)qdisc_skb_cb(skb)->data;
+}
+
+static uid_t batch_skb_uid(const struct sk_buff *skb)
+{
+	const struct sock *sk = skb->sk;
+	const struct file *filp;
+
+	if (!sk || !sk->sk_socket)
+		return 0;
+
+	filp = sk->sk_socket->file;
+	return filp ? filp->f_cred->fsuid : 0;
+}
+
+static struct batch_uid_stats *batch_uid_stats(struct batch_sched_data *q,
+					       uid_t uid)
+{
+	struct hlist_head *head = &q->uids[hash_32(uid, BATCH_UID_HASH_BITS)];
+	struct batch_uid_stats *us;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(us, n, head, node)
+		if (us->uid == uid)
+			return us;
+
+	if (q->nr_uids >= BATCH_MAX_UIDS)
+		return NULL;
+
+	us = kzalloc(sizeof(*us), GFP_ATOMIC);
+	if (!us)
+		return NULL;
+
+	us->uid = uid;
+	hlist_add_head(&us->node, head);
+	q->nr_uids++;
+	return us;
+}
+
+static bool batch_link_idle(const struct batch_sched_data *q,
+			    psched_time_t now)
+{
+	return !q->last_tx || now - q->last_tx >= q->active;
+}
+
+static bool batch_can_defer(const struct batch_sched_data *q,
+			    const struct sk_buff *skb)
+{
+	if (skb->priority <= TC_PRIO_MAX &&
+	    (q->prio_mask & (1 << skb->priority)))
+		return true;
+
+	return q->mark_mask && (skb->mark & q->mark_mask) == q->mark;
+}
+
+static int batch_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	struct batch_skb_cb *cb = batch_skb_cb(skb);
+
+	if (unlikely(sch->q.qlen >= q->limit))
+		return qdisc_drop(skb, sch);
+
+	cb->time = psched_get_time();
+	cb->uid = batch_skb_uid(skb);
+
+	/* nothing to save once the radio is up */
+	if (batch_can_defer(q, skb) && batch_link_idle(q, cb->time)) {
+		__skb_queue_tail(&q->deferred, skb);
+		q->stats.deferred++;
+	} else {
+		__skb_queue_tail(&q->urgent, skb);
+	}
+
+	sch->q.qlen++;
+	sch->qstats.backlog += qdisc_pkt_len(skb);
+	return NET_XMIT_SUCCESS;
+}
+
+static void batch_account(struct batch_sched_data *q, struct sk_buff *skb,
+			  psched_time_t now, bool deferred)
+{
+	struct batch_skb_cb *cb = batch_skb_cb(skb);
+	struct batch_uid_stats *us = batch_uid_stats(q, cb->uid);
+	bool wakeup = batch_link_idle(q, now);
+
+	if (wakeup)
+		q->stats.wakeups++;
+	q->last_tx = now;
+
+	if (!us)
+		return;
+
+	us->packets++;
+	us->bytes += qdisc_pkt_len(skb);
+	if (wakeup)
+		us->wakeups++;
+	if (deferred) {
+		us->deferred++;
+		us->delay_us += div_u64(PSCHED_TICKS2NS(now - cb->time),
+					NSEC_PER_USEC);
+	}
+}
+
+static struct sk_buff *batch_dequeue(struct Qdisc *sch)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	psched_time_t now = psched_get_time();
+	struct sk_buff *skb;
+	bool deferred = false;
+
+	skb = __skb_dequeue(&q->urgent);
+	if (!skb) {
+		skb = skb_peek(&q->deferred);
+		if (!skb)
+			return NULL;
+
+		if (!batch_link_idle(q, now)) {
+			q->stats.flush_active++;
+		} else if (now - batch_skb_cb(skb)->time >= q->window) {
+			q->stats.flush_timeout++;
+		} else if (skb_queue_len(&q->deferred) >= q->defer_limit) {
+			q->stats.flush_limit++;
+		} else {
+			qdisc_watchdog_schedule(&q->watchdog,
+					batch_skb_cb(skb)->time + q->window);
+			return NULL;
+		}
+
+		__skb_unlink(skb, &q->deferred);
+		deferred = true;
+	}
+
+	batch_account(q, skb, now, deferred);
+
+	sch->q.qlen--;
+	sch->qstats.backlog -= qdisc_pkt_len(skb);
+	qdisc_unthrottled(sch);
+	qdisc_bstats_update(sch, skb);
+	return skb;
+}
+
+static unsigned int batch_drop(struct Qdisc *sch)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb;
+	unsigned int len;
+
+	/* the packets nobody is waiting for go first */
+	skb = __skb_dequeue_tail(&q->deferred);
+	if (!skb)
+		skb = __skb_dequeue_tail(&q->urgent);
+	if (!skb)
+		return 0;
+
+	len = qdisc_pkt_len(skb);
+	sch->q.qlen--;
+	sch->qstats.backlog -= len;
+	sch->qstats.drops++;
+	kfree_skb(skb);
+	return len;
+}
+
+static void batch_reset(struct Qdisc *sch)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+
+	__skb_queue_purge(&q->urgent);
+	__skb_queue_purge(&q->deferred);
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+	qdisc_watchdog_cancel(&q->watchdog);
+}
+
+static const struct nla_policy batch_policy[TCA_BATCH_MAX + 1] = {
+	[TCA_BATCH_PARMS]	= { .len = sizeof(struct tc_batch_qopt) },
+};
+
+static const struct tc_batch_qopt batch_default_ops = {
+	.window		= 2 * MSEC_PER_SEC,
+	.active		= 2 * MSEC_PER_SEC,
+	.defer_limit	= 64,
+	.prio_mask	= 1 << TC_PRIO_BULK,
+};
+
+static int batch_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	struct nlattr *tb[TCA_BATCH_MAX + 1];
+	const struct tc_batch_qopt *ctl = &batch_default_ops;
+	int err;
+
+	if (opt) {
+		err = nla_parse_nested(tb, TCA_BATCH_MAX, opt, batch_policy);
+		if (err < 0)
+			return err;
+
+		if (tb[TCA_BATCH_PARMS] == NULL)
+			return -EINVAL;
+
+		ctl = nla_data(tb[TCA_BATCH_PARMS]);
+	}
+
+	sch_tree_lock(sch);
+
+	q->limit = ctl->limit ? : max_t(u32, qdisc_dev(sch)->tx_queue_len, 1);
+	q->window = PSCHED_NS2TICKS((u64)ctl->window * NSEC_PER_MSEC);
+	q->active = PSCHED_NS2TICKS((u64)ctl->active * NSEC_PER_MSEC);
+	q->defer_limit = ctl->defer_limit ? : 1;
+	q->prio_mask = ctl->prio_mask;
+	q->mark = ctl->mark;
+	q->mark_mask = ctl->mark_mask;
+
+	while (sch->q.qlen > q->limit)
+		batch_drop(sch);
+
+	sch_tree_unlock(sch);
+
+	/* the new window may already be over */
+	if (q->sch)
+		__netif_schedule(qdisc_root(sch));
+	return 0;
+}
+
+static int batch_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	int err;
+
+	skb_queue_head_init(&q->urgent);
+	skb_queue_head_init(&q->deferred);
+	qdisc_watchdog_init(&q->watchdog, sch);
+
+	err = batch_change(sch, opt);
+	if (err)
+		return err;
+
+	ASSERT_RTNL();
+	q->sch = sch;
+	list_add_tail(&q->list, &batch_list);
+	return 0;
+}
+
+static void batch_destroy(struct Qdisc *sch)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	struct batch_uid_stats *us;
+	struct hlist_node *n, *tmp;
+	int i;
+
+	qdisc_watchdog_cancel(&q->watchdog);
+
+	/* init failed before the qdisc was listed */
+	if (!q->sch)
+		return;
+
+	ASSERT_RTNL();
+	list_del(&q->list);
+
+	for (i = 0; i < BATCH_UID_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(us, n, tmp, &q->uids[i], node)
+			kfree(us);
+}
+
+static int batch_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+	struct nlattr *opts;
+	struct tc_batch_qopt opt = {
+		.limit = q->limit,
+		.window = div_u64(PSCHED_TICKS2NS(q->window), NSEC_PER_MSEC),
+		.active = div_u64(PSCHED_TICKS2NS(q->active), NSEC_PER_MSEC),
+		.defer_limit = q->defer_limit,
+		.prio_mask = q->prio_mask,
+		.mark = q->mark,
+		.mark_mask = q->mark_mask,
+	};
+
+	opts = nla_nest_start(skb, TCA_OPTIONS);
+	if (opts == NULL)
+		goto nla_put_failure;
+	NLA_PUT(skb, TCA_BATCH_PARMS, sizeof(opt), &opt);
+	return nla_nest_end(skb, opts);
+
+nla_put_failure:
+	nla_nest_cancel(skb, opts);
+	return -EMSGSIZE;
+}
+
+static int batch_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
+{
+	struct batch_sched_data *q = qdisc_priv(sch);
+
+	return gnet_stats_copy_app(d, &q->stats, sizeof(q->stats));
+}
+
+static struct Qdisc_ops batch_qdisc_ops __read_mostly = {
+	.id		=	"batch",
+	.priv_size	=	sizeof(struct batch_sched_data),
+	.enqueue	=	batch_enqueue,
+	.dequeue	=	batch_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.drop		=	batch_drop,
+	.init		=	batch_init,
+	.reset		=	batch_reset,
+	.destroy	=	batch_destroy,
+	.change		=	batch_change,
+	.dump		=	batch_dump,
+	.dump_stats	=	batch_dump_stats,
+	.owner		=	THIS_MODULE,
+};
+
+static int batch_proc_show(struct seq_file *seq, void *v)
+{
+	struct batch_sched_data *q;
+	struct batch_uid_stats *us;
+	struct hlist_node *n;
+	int i;
+
+	seq_puts(seq, "iface uid packets bytes wakeups deferred delay_ms\n");
+
+	rtnl_lock();
+	list_for_each_entry(q, &batch_list, list) {
+		spinlock_t *root_lock = qdisc_root_sleeping_lock(q->sch);
+
+		spin_lock_bh(root_lock);
+		for (i = 0; i < BATCH_UID_HASH_SIZE; i++)
+			hlist_for_each_entry(us, n, &q->uids[i], node)
+				seq_printf(seq, "%s %u %u %llu %u %u %llu\n",
+					   qdisc_dev(q->sch)->name, us->uid,
+					   us->packets, us->bytes, us->wakeups,
+					   us->deferred,
+					   div_u64(us->delay_us, USEC_PER_MSEC));
+		spin_unlock_bh(root_lock);
+	}
+	rtnl_unlock();
+
+	return 0;
+}
+
+static int batch_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, batch_proc_show, NULL);
+}
+
+static const struct file_operations batch_proc_fops = {
+	.owner		= THIS_MODULE,
+	.open		= batch_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init batch_module_init(void)
+{
+	int err;
+
+	if (!proc_net_fops_create(&init_net, "sch_batch", S_IRUGO,
+				  &batch_proc_fops))
+		return -ENOMEM;
+
+	err = register_qdisc(&batch_qdisc_ops);
+	if (err)
+		proc_net_remove(&init_net, "sch_batch");
+	return err;
+}
+
+static void __exit batch_module_exit(void)
+{
+	unregister_qdisc(&batch_qdisc_ops);
+	proc_net_remove(&init_net, "sch_batch");
+}
+module_init(batch_module_init)
+module_exit(batch_module_exit)
+MODULE_LICENSE("GPL");
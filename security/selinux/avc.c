@@ -22,6 +22,8 @@
 #include <linux/init.h>
 #include <linux/skbuff.h>
 #include <linux/percpu.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <net/sock.h>
 #include <linux/un.h>
 #include <net/af_unix.h>
@@ -33,15 +35,20 @@
 #include "avc_ss.h"
 #include "classmap.h"
 
-#define AVC_CACHE_SLOTS			512
-#define AVC_DEF_CACHE_THRESHOLD		512
+#define AVC_MIN_CACHE_SLOTS		512
+#define AVC_MAX_CACHE_SLOTS		8192
 #define AVC_CACHE_RECLAIM		16
 
-#ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
-#define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
-#else
-#define avc_cache_stats_incr(field)	do {} while (0)
-#endif
+/*
+ * The threshold grows by a quarter, up to AVC_CACHE_MAX_CHAIN entries per
+ * slot, whenever more than threshold / AVC_CACHE_THRASH entries had to be
+ * reclaimed within a second: the working set does not fit the cache.
+ */
+#define AVC_CACHE_MAX_CHAIN		4
+#define AVC_CACHE_THRASH		8
+
+/* small direct mapped per-CPU cache in front of the hash table */
+#define AVC_PCPU_SLOTS			16
 
 struct avc_entry {
 	u32			ssid;
@@ -57,11 +64,28 @@ struct avc_node {
 };
 
 struct avc_cache {
-	struct hlist_head	slots[AVC_CACHE_SLOTS]; /* head for avc_node->list */
-	spinlock_t		slots_lock[AVC_CACHE_SLOTS]; /* lock for writes */
+	struct hlist_head	*slots; /* head for avc_node->list */
+	spinlock_t		*slots_lock; /* lock for writes */
+	unsigned int		nr_slots;
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
+	unsigned long		reclaim_window;	/* start of the thrash window */
+	atomic_t		window_reclaims;
+	atomic_t		generation;	/* bumped when decisions change */
+};
+
+/*
+ * Copies of recently used decisions.  An entry is only valid as long as
+ * no cached decision was changed or flushed since it was filled, which
+ * is what its copy of avc_cache.generation tells.
+ */
+struct avc_pcpu_entry {
+	u32			ssid;
+	u32			tsid;
+	u16			tclass;
+	u32			generation;
+	struct av_decision	avd;
 };
 
 struct avc_callback_node {
@@ -77,7 +101,8 @@ struct avc_callback_node {
 };
 
 /* Exported via selinufs */
-unsigned int avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
+unsigned int avc_cache_threshold;
+bool avc_cache_autoscale = true;
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
@@ -86,10 +111,82 @@ DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
 static struct avc_cache avc_cache;
 static struct avc_callback_node *avc_callbacks;
 static struct kmem_cache *avc_node_cachep;
+static DEFINE_PER_CPU(struct avc_pcpu_entry [AVC_PCPU_SLOTS], avc_pcpu_cache);
+
+/* 0 picks a size from the amount of memory */
+static unsigned int avc_cache_slots_param __initdata;
+
+static int __init avc_cache_slots_setup(char *str)
+{
+	avc_cache_slots_param = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+__setup("avc_cache_slots=", avc_cache_slots_setup);
 
 static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
 {
-	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
+	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (avc_cache.nr_slots - 1);
+}
+
+static inline int avc_pcpu_hash(u32 ssid, u32 tsid, u16 tclass)
+{
+	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_PCPU_SLOTS - 1);
+}
+
+/**
+ * avc_cache_generation - Tell whether cached decisions may have changed.
+ *
+ * The value changes whenever a decision held by the AVC is changed or
+ * dropped for another reason than reclaim, in particular on policy loads
+ * and enforcing mode changes.  Callers keeping decisions of their own can
+ * use it to check that these are still current.
+ */
+u32 avc_cache_generation(void)
+{
+	return atomic_read(&avc_cache.generation);
+}
+
+static void avc_cache_invalidate(void)
+{
+	/* order the decision changes before the per-CPU copies go stale */
+	smp_wmb();
+	atomic_inc(&avc_cache.generation);
+}
+
+static bool avc_pcpu_lookup(u32 ssid, u32 tsid, u16 tclass,
+			    struct av_decision *avd)
+{
+	struct avc_pcpu_entry *e;
+	unsigned long flags;
+	bool hit = false;
+
+	/* checks also come from softirqs, which must not see a torn entry */
+	local_irq_save(flags);
+	e = &__get_cpu_var(avc_pcpu_cache)[avc_pcpu_hash(ssid, tsid, tclass)];
+	if (e->ssid == ssid && e->tsid == tsid && e->tclass == tclass &&
+	    e->generation == avc_cache_generation()) {
+		memcpy(avd, &e->avd, sizeof(*avd));
+		hit = true;
+	}
+	local_irq_restore(flags);
+
+	return hit;
+}
+
+static void avc_pcpu_fill(u32 ssid, u32 tsid, u16 tclass,
+			  struct av_decision *avd, u32 generation)
+{
+	struct avc_pcpu_entry *e;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	e = &__get_cpu_var(avc_pcpu_cache)[avc_pcpu_hash(ssid, tsid, tclass)];
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	e->generation = generation;
+	memcpy(&e->avd, avd, sizeof(e->avd));
+	local_irq_restore(flags);
 }
 
 /**
@@ -166,14 +263,41 @@ static void avc_dump_query(struct audit_buffer *ab, u32 ssid, u32 tsid, u16 tcla
  */
 void __init avc_init(void)
 {
+	unsigned int slots = avc_cache_slots_param;
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	/* one slot per MB of memory by default */
+	if (!slots)
+		slots = totalram_pages >> (20 - PAGE_SHIFT);
+	slots = clamp_t(unsigned int, slots, AVC_MIN_CACHE_SLOTS,
+			AVC_MAX_CACHE_SLOTS);
+	slots = rounddown_pow_of_two(slots);
+
+	for (; slots >= AVC_MIN_CACHE_SLOTS; slots >>= 1) {
+		avc_cache.slots = kcalloc(slots, sizeof(*avc_cache.slots),
+					  GFP_KERNEL);
+		avc_cache.slots_lock = kcalloc(slots,
+					       sizeof(*avc_cache.slots_lock),
+					       GFP_KERNEL);
+		if (avc_cache.slots && avc_cache.slots_lock)
+			break;
+		kfree(avc_cache.slots);
+		kfree(avc_cache.slots_lock);
+	}
+	if (slots < AVC_MIN_CACHE_SLOTS)
+		panic("SELinux: cannot allocate the AVC\n");
+	avc_cache.nr_slots = slots;
+
+	for (i = 0; i < slots; i++) {
 		INIT_HLIST_HEAD(&avc_cache.slots[i]);
 		spin_lock_init(&avc_cache.slots_lock[i]);
 	}
 	atomic_set(&avc_cache.active_nodes, 0);
 	atomic_set(&avc_cache.lru_hint, 0);
+	atomic_set(&avc_cache.window_reclaims, 0);
+	/* generation 0 never matches, so zeroed copies are invalid */
+	atomic_set(&avc_cache.generation, 1);
+	avc_cache_threshold = slots;
 
 	avc_node_cachep = kmem_cache_create("avc_node", sizeof(struct avc_node),
 					     0, SLAB_PANIC, NULL);
@@ -191,7 +315,7 @@ int avc_get_hash_stats(char *page)
 
 	slots_used = 0;
 	max_chain_len = 0;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache.nr_slots; i++) {
 		head = &avc_cache.slots[i];
 		if (!hlist_empty(head)) {
 			struct hlist_node *next;
@@ -208,9 +332,11 @@ int avc_get_hash_stats(char *page)
 	rcu_read_unlock();
 
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
-			 "longest chain: %d\n",
+			 "longest chain: %d\nthreshold: %u%s\n",
 			 atomic_read(&avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, avc_cache.nr_slots, max_chain_len,
+			 avc_cache_threshold,
+			 avc_cache_autoscale ? " (auto)" : "");
 }
 
 static void avc_node_free(struct rcu_head *rhead)
@@ -239,6 +365,7 @@ static void avc_node_replace(struct avc_node *new, struct avc_node *old)
 	hlist_replace_rcu(&old->list, &new->list);
 	call_rcu(&old->rhead, avc_node_free);
 	atomic_dec(&avc_cache.active_nodes);
+	avc_cache_invalidate();
 }
 
 static inline int avc_reclaim_node(void)
@@ -250,8 +377,9 @@ static inline int avc_reclaim_node(void)
 	struct hlist_node *next;
 	spinlock_t *lock;
 
-	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&avc_cache.lru_hint) & (AVC_CACHE_SLOTS - 1);
+	for (try = 0, ecx = 0; try < avc_cache.nr_slots; try++) {
+		hvalue = atomic_inc_return(&avc_cache.lru_hint) &
+			 (avc_cache.nr_slots - 1);
 		head = &avc_cache.slots[hvalue];
 		lock = &avc_cache.slots_lock[hvalue];
 
@@ -276,6 +404,30 @@ out:
 	return ecx;
 }
 
+static void avc_cache_scale(int reclaimed)
+{
+	unsigned int threshold = avc_cache_threshold;
+	unsigned int max = avc_cache.nr_slots * AVC_CACHE_MAX_CHAIN;
+	unsigned long now = jiffies;
+
+	if (!avc_cache_autoscale || threshold >= max)
+		return;
+
+	if (time_after(now, avc_cache.reclaim_window + HZ)) {
+		avc_cache.reclaim_window = now;
+		atomic_set(&avc_cache.window_reclaims, reclaimed);
+		return;
+	}
+
+	if (atomic_add_return(reclaimed, &avc_cache.window_reclaims) <=
+	    threshold / AVC_CACHE_THRASH)
+		return;
+
+	avc_cache_threshold = min(threshold + threshold / 4 + 1, max);
+	avc_cache.reclaim_window = now;
+	atomic_set(&avc_cache.window_reclaims, 0);
+}
+
 static struct avc_node *avc_alloc_node(void)
 {
 	struct avc_node *node;
@@ -288,7 +440,7 @@ static struct avc_node *avc_alloc_node(void)
 	avc_cache_stats_incr(allocations);
 
 	if (atomic_inc_return(&avc_cache.active_nodes) > avc_cache_threshold)
-		avc_reclaim_node();
+		avc_cache_scale(avc_reclaim_node());
 
 out:
 	return node;
@@ -701,7 +853,7 @@ static void avc_flush(void)
 	unsigned long flag;
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache.nr_slots; i++) {
 		head = &avc_cache.slots[i];
 		lock = &avc_cache.slots_lock[i];
 
@@ -716,6 +868,7 @@ static void avc_flush(void)
 		rcu_read_unlock();
 		spin_unlock_irqrestore(lock, flag);
 	}
+	avc_cache_invalidate();
 }
 
 /**
@@ -806,17 +959,34 @@ inline int avc_has_perm_noaudit(u32 ssid, u32 tsid,
 {
 	struct avc_node *node;
 	int rc = 0;
-	u32 denied;
+	u32 denied, generation;
 
 	BUG_ON(!requested);
 
+	if (avc_pcpu_lookup(ssid, tsid, tclass, avd)) {
+		avc_cache_stats_incr(lookups);
+		avc_cache_stats_incr(pcpu_hits);
+		denied = requested & ~(avd->allowed);
+		if (unlikely(denied))
+			rc = avc_denied(ssid, tsid, tclass, requested, flags,
+					avd);
+		return rc;
+	}
+
+	/* a copy made from a decision about to change must not be valid */
+	generation = avc_cache_generation();
+	smp_rmb();
+
 	rcu_read_lock();
 
 	node = avc_lookup(ssid, tsid, tclass);
 	if (unlikely(!node)) {
 		node = avc_compute_av(ssid, tsid, tclass, avd);
+		if (node)
+			avc_pcpu_fill(ssid, tsid, tclass, avd, generation);
 	} else {
 		memcpy(avd, &node->ae.avd, sizeof(*avd));
+		avc_pcpu_fill(ssid, tsid, tclass, avd, generation);
 		avd = &node->ae.avd;
 	}
 
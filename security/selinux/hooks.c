@@ -242,6 +242,7 @@ static int file_alloc_security(struct file *file)
 
 	fsec->sid = sid;
 	fsec->fown_sid = sid;
+	seqlock_init(&fsec->perm_lock);
 	file->f_security = fsec;
 
 	return 0;
@@ -2943,17 +2944,91 @@ static void selinux_inode_getsecid(const struct inode *inode, u32 *secid)
 
 /* file security operations */
 
+/*
+ * Reads and writes on a file opened by another domain, typically passed
+ * over binder or a socket, are checked against the policy every time.
+ * The last decision granting such accesses is kept with the file, and
+ * reused for as long as the task, the inode label and the AVC contents
+ * stay the same.
+ */
+static bool file_perm_cached(struct file *file, u32 sid, u32 av)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct file_security_struct *fsec = file->f_security;
+	struct inode_security_struct *isec = inode->i_security;
+	unsigned int seq;
+	bool hit;
+
+	do {
+		seq = read_seqbegin(&fsec->perm_lock);
+		hit = fsec->perm_sid == sid &&
+		      fsec->perm_isid == isec->sid &&
+		      fsec->perm_gen == avc_cache_generation() &&
+		      !(av & ~fsec->perm_av);
+	} while (read_seqretry(&fsec->perm_lock, seq));
+
+	if (hit)
+		avc_cache_stats_incr(file_hits);
+	return hit;
+}
+
+static void file_perm_cache(struct file *file, u32 sid, u32 av)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct file_security_struct *fsec = file->f_security;
+	struct inode_security_struct *isec = inode->i_security;
+	u32 generation = avc_cache_generation();
+	u32 isid = isec->sid;
+	struct av_decision avd;
+
+	/*
+	 * Only plain grants can be cached: accesses the policy wants audited,
+	 * or only lets through because of permissive mode, must keep going
+	 * through the AVC.
+	 */
+	if (sid != fsec->sid) {
+		if (avc_has_perm_noaudit(sid, fsec->sid, SECCLASS_FD, FD__USE,
+					 0, &avd) ||
+		    (avd.auditallow & FD__USE) || !(avd.allowed & FD__USE))
+			return;
+	}
+	if (av) {
+		if (avc_has_perm_noaudit(sid, isid, isec->sclass, av, 0, &avd) ||
+		    (avd.auditallow & av) || (av & ~avd.allowed))
+			return;
+	}
+
+	write_seqlock(&fsec->perm_lock);
+	if (fsec->perm_sid == sid && fsec->perm_isid == isid &&
+	    fsec->perm_gen == generation)
+		av |= fsec->perm_av;
+	fsec->perm_sid = sid;
+	fsec->perm_isid = isid;
+	fsec->perm_av = av;
+	fsec->perm_gen = generation;
+	write_sequnlock(&fsec->perm_lock);
+}
+
 static int selinux_revalidate_file_permission(struct file *file, int mask)
 {
 	const struct cred *cred = current_cred();
 	struct inode *inode = file->f_path.dentry->d_inode;
+	u32 sid = cred_sid(cred);
+	u32 av;
+	int rc;
 
 	/* file_mask_to_av won't add FILE__WRITE if MAY_APPEND is set */
 	if ((file->f_flags & O_APPEND) && (mask & MAY_WRITE))
 		mask |= MAY_APPEND;
 
-	return file_has_perm(cred, file,
-			     file_mask_to_av(inode->i_mode, mask));
+	av = file_mask_to_av(inode->i_mode, mask);
+	if (file_perm_cached(file, sid, av))
+		return 0;
+
+	rc = file_has_perm(cred, file, av);
+	if (!rc)
+		file_perm_cache(file, sid, av);
+	return rc;
 }
 
 static int selinux_file_permission(struct file *file, int mask)
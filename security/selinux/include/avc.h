@@ -44,6 +44,8 @@ struct avc_cache_stats {
 	unsigned int allocations;
 	unsigned int reclaims;
 	unsigned int frees;
+	unsigned int pcpu_hits;		/* lookups served by the per-CPU cache */
+	unsigned int file_hits;		/* file checks served by the file */
 };
 
 /*
@@ -102,6 +104,7 @@ static inline int avc_has_perm(u32 ssid, u32 tsid,
 }
 
 u32 avc_policy_seqno(void);
+u32 avc_cache_generation(void);
 
 #define AVC_CALLBACK_GRANT		1
 #define AVC_CALLBACK_TRY_REVOKE		2
@@ -121,12 +124,16 @@ int avc_add_callback(int (*callback)(u32 event, u32 ssid, u32 tsid,
 /* Exported to selinuxfs */
 int avc_get_hash_stats(char *page);
 extern unsigned int avc_cache_threshold;
+extern bool avc_cache_autoscale;
 
 /* Attempt to free avc node cache */
 void avc_disable(void);
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 DECLARE_PER_CPU(struct avc_cache_stats, avc_cache_stats);
+#define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
+#else
+#define avc_cache_stats_incr(field)	do {} while (0)
 #endif
 
 #endif /* _SELINUX_AVC_H_ */
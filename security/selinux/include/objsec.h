@@ -24,6 +24,7 @@
 #include <linux/binfmts.h>
 #include <linux/in.h>
 #include <linux/spinlock.h>
+#include <linux/seqlock.h>
 #include "flask.h"
 #include "avc.h"
 
@@ -51,6 +52,11 @@ struct file_security_struct {
 	u32 fown_sid;		/* SID of file owner (for SIGIO) */
 	u32 isid;		/* SID of inode at the time of file open */
 	u32 pseqno;		/* Policy seqno at the time of file open */
+	seqlock_t perm_lock;	/* protects the cached decision below */
+	u32 perm_sid;		/* SID of the task the decision was made for */
+	u32 perm_isid;		/* SID of the inode at that time */
+	u32 perm_av;		/* file permissions granted */
+	u32 perm_gen;		/* avc_cache_generation() of the decision */
 };
 
 struct superblock_security_struct {
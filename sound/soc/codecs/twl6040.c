@@ -202,21 +202,9 @@ static const u8 twl6040_reg_supply[TWL6040_CACHEREGNUM] = {
 	TWL6040_NO_SUPPLY,  /* REG_SW_SHADOW	*/
 };
 
-/* List of registers to be restored after power up */
-static const int twl6040_restore_list[] = {
-	TWL6040_REG_MICLCTL,
-	TWL6040_REG_MICRCTL,
-	TWL6040_REG_MICGAIN,
-	TWL6040_REG_LINEGAIN,
-	TWL6040_REG_HSLCTL,
-	TWL6040_REG_HSRCTL,
-	TWL6040_REG_HSGAIN,
-	TWL6040_REG_EARCTL,
-	TWL6040_REG_HFLCTL,
-	TWL6040_REG_HFLGAIN,
-	TWL6040_REG_HFRCTL,
-	TWL6040_REG_HFRGAIN,
-};
+/* Registers to be restored after power up: MICLCTL to HFRGAIN */
+#define TWL6040_RESTORE_FIRST	TWL6040_REG_MICLCTL
+#define TWL6040_RESTORE_LAST	TWL6040_REG_HFRGAIN
 
 /* set of rates for each pll: low-power and high-performance */
 static unsigned int lp_rates[] = {
@@ -328,6 +316,42 @@ static int twl6040_write(struct snd_soc_codec *codec,
 	return ret;
 }
 
+/*
+ * write a block of adjacent vdd/vss registers from the register cache
+ */
+static int twl6040_write_block(struct snd_soc_codec *codec,
+			       unsigned int reg, unsigned int count)
+{
+	struct twl6040 *twl6040 = codec->control_data;
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+	u8 *cache = codec->reg_cache;
+	unsigned int i;
+	int ret;
+
+	if (reg + count > TWL6040_REG_SW_SHADOW)
+		return -EIO;
+
+	if (!priv->codec_powered) {
+		dev_dbg(codec->dev,
+			"deferring register 0x%02x-0x%02x write\n",
+			reg, reg + count - 1);
+		return 0;
+	}
+
+	/* one burst, so the registers also change together */
+	ret = twl6040_reg_bulk_write(twl6040, reg, &cache[reg], count);
+	if (!ret)
+		return 0;
+
+	for (i = reg; i < reg + count; i++) {
+		ret = twl6040_reg_write(twl6040, i, cache[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static void twl6040_init_chip(struct snd_soc_codec *codec)
 {
 	struct twl6040 *twl6040 = codec->control_data;
@@ -362,13 +386,8 @@ static void twl6040_init_chip(struct snd_soc_codec *codec)
 
 static void twl6040_restore_regs(struct snd_soc_codec *codec)
 {
-	u8 *cache = codec->reg_cache;
-	int reg, i;
-
-	for (i = 0; i < ARRAY_SIZE(twl6040_restore_list); i++) {
-		reg = twl6040_restore_list[i];
-		twl6040_write(codec, reg, cache[reg]);
-	}
+	twl6040_write_block(codec, TWL6040_RESTORE_FIRST,
+			    TWL6040_RESTORE_LAST - TWL6040_RESTORE_FIRST + 1);
 }
 
 /* set headset dac and driver power mode */
@@ -388,10 +407,10 @@ static int headset_power_mode(struct snd_soc_codec *codec, int high_perf)
 		hsrctl |= mask;
 	}
 
-	twl6040_write(codec, TWL6040_REG_HSLCTL, hslctl);
-	twl6040_write(codec, TWL6040_REG_HSRCTL, hsrctl);
+	twl6040_write_reg_cache(codec, TWL6040_REG_HSLCTL, hslctl);
+	twl6040_write_reg_cache(codec, TWL6040_REG_HSRCTL, hsrctl);
 
-	return 0;
+	return twl6040_write_block(codec, TWL6040_REG_HSLCTL, 2);
 }
 
 static int twl6040_adc_event(struct snd_soc_dapm_widget *w,
@@ -438,8 +457,9 @@ static int twl6040_hs_dac_event(struct snd_soc_dapm_widget *w,
 		hslctl &= ~TWL6040_HSDACENA;
 		hsrctl &= ~TWL6040_HSDACENA;
 	}
-	twl6040_write(codec, TWL6040_REG_HSLCTL, hslctl);
-	twl6040_write(codec, TWL6040_REG_HSRCTL, hsrctl);
+	twl6040_write_reg_cache(codec, TWL6040_REG_HSLCTL, hslctl);
+	twl6040_write_reg_cache(codec, TWL6040_REG_HSRCTL, hsrctl);
+	twl6040_write_block(codec, TWL6040_REG_HSLCTL, 2);
 
 	msleep(1);
 	return 0;
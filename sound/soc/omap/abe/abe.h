@@ -247,6 +247,8 @@ struct omap_aess_dma {
 
 
 int omap_aess_set_opp_processing(struct omap_aess *abe, u32 opp);
+u32 omap_aess_get_task_opp(struct omap_aess *abe, const u16 *tasks,
+			   int count);
 int omap_aess_connect_debug_trace(struct omap_aess *abe,
 				 struct omap_aess_dma *dma2);
 
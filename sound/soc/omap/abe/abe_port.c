@@ -181,6 +181,69 @@ void omap_aess_build_scheduler_table(struct omap_aess *abe)
 		(u32 *) aUplinkMuxing);
 }
 
+static int omap_aess_is_init_task(int frame, int slot, u16 task)
+{
+	int i;
+
+	for (i = 0; i < aess_init_table.nb_task; i++) {
+		struct omap_aess_task *t = &aess_init_table.task[i];
+
+		if (t->frame == frame && t->slot == slot &&
+		    ABE_TASK_ID(t->task) == task)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * omap_aess_get_task_opp - lowest OPP running the given firmware tasks
+ * @abe: Pointer on abe handle
+ * @tasks: C_ABE_FW_TASK_* ids of the processing in use
+ * @count: number of @tasks
+ *
+ * At each OPP the firmware only runs the first DOPPMODE32_OPPxx bytes of
+ * task ids of every slot of the multiframe.  The last slot holding either
+ * one of @tasks or a task that is not part of the default scheduling
+ * table, i.e. the I/O and ASRC tasks of the running ports at their
+ * current rates, gives the OPP the current use case needs.
+ *
+ * Returns ABE_OPP25, ABE_OPP50 or ABE_OPP100.
+ */
+u32 omap_aess_get_task_opp(struct omap_aess *abe, const u16 *tasks,
+			   int count)
+{
+	int frame, slot, i, last = -1;
+	u32 bytes;
+
+	for (frame = 0; frame < ARRAY_SIZE(abe->MultiFrame); frame++) {
+		for (slot = ARRAY_SIZE(abe->MultiFrame[0]) - 1; slot > last;
+		     slot--) {
+			u16 task = abe->MultiFrame[frame][slot];
+
+			if (!task)
+				continue;
+			if (!omap_aess_is_init_task(frame, slot, task))
+				break;
+			for (i = 0; i < count; i++)
+				if (task == ABE_TASK_ID(tasks[i]))
+					break;
+			if (i < count)
+				break;
+		}
+		if (slot > last)
+			last = slot;
+	}
+
+	bytes = (last + 1) * sizeof(abe->MultiFrame[0][0]);
+	if (bytes <= DOPPMODE32_OPP25)
+		return ABE_OPP25;
+	if (bytes <= DOPPMODE32_OPP50)
+		return ABE_OPP50;
+	return ABE_OPP100;
+}
+EXPORT_SYMBOL(omap_aess_get_task_opp);
+
 /**
  * abe_clean_temporay buffers
  *
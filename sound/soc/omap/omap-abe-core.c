@@ -385,6 +385,8 @@ static int __devinit abe_engine_probe(struct platform_device *pdev)
 	mutex_init(&abe->opp.mutex);
 	mutex_init(&abe->opp.req_mutex);
 	INIT_LIST_HEAD(&abe->opp.req);
+	abe->opp.auto_select = 1;
+	init_waitqueue_head(&abe->mmap.wait);
 
 	get_device(abe->dev);
 	abe->dev->dma_mask = &omap_abe_dmamask;
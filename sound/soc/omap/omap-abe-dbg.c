@@ -28,6 +28,8 @@
 #include <linux/pm_runtime.h>
 #include <linux/dma-mapping.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include <plat/dma.h>
 #include <plat/dma-44xx.h>
@@ -264,6 +266,89 @@ static const struct file_operations omap_abe_fops = {
 	.release = abe_release_data,
 };
 
+/*
+ * The host writes into one ping-pong buffer while the ABE plays the
+ * other one, so a sample reaches the mixer two periods plus one 250us
+ * processing loop after being written.
+ */
+static int abe_mmap_latency_show(struct seq_file *m, void *v)
+{
+	struct omap_abe *abe = m->private;
+	struct omap_abe_mmap_stats stats = abe->mmap.stats;
+	u32 avg = 0;
+
+	if (stats.irqs > 1)
+		avg = (u32)div_u64(stats.total_us, stats.irqs - 1);
+
+	seq_printf(m, "period_us:      %u\n", stats.period_us);
+	seq_printf(m, "latency_us:     %u\n",
+		   stats.period_us ? 2 * stats.period_us + 250 : 0);
+	seq_printf(m, "irqs:           %u\n", stats.irqs);
+	seq_printf(m, "late:           %u\n", stats.late);
+	seq_printf(m, "interval_us:    %u\n", stats.last_us);
+	seq_printf(m, "interval_min:   %u\n", stats.min_us);
+	seq_printf(m, "interval_max:   %u\n", stats.max_us);
+	seq_printf(m, "interval_avg:   %u\n", avg);
+	seq_printf(m, "jitter_max_us:  %u\n", stats.jitter_max_us);
+
+	return 0;
+}
+
+static int abe_mmap_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, abe_mmap_latency_show, inode->i_private);
+}
+
+static const struct file_operations omap_abe_mmap_fops = {
+	.open = abe_mmap_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int abe_opp_residency_show(struct seq_file *m, void *v)
+{
+	static const int levels[OMAP_ABE_OPP_COUNT] = { 25, 50, 100 };
+	struct omap_abe *abe = m->private;
+	u64 residency[OMAP_ABE_OPP_COUNT];
+	int i, level, stats_level;
+	u32 transitions;
+	ktime_t since;
+
+	mutex_lock(&abe->opp.mutex);
+	memcpy(residency, abe->opp.residency_us, sizeof(residency));
+	level = abe->opp.level;
+	stats_level = abe->opp.stats_level;
+	transitions = abe->opp.transitions;
+	since = abe->opp.last_change;
+	mutex_unlock(&abe->opp.mutex);
+
+	seq_printf(m, "level:          %d\n", level);
+	seq_printf(m, "auto:           %u\n", abe->opp.auto_select);
+	seq_printf(m, "transitions:    %u\n", transitions);
+	for (i = 0; i < OMAP_ABE_OPP_COUNT; i++) {
+		u64 us = residency[i];
+
+		if (stats_level == levels[i])
+			us += ktime_us_delta(ktime_get(), since);
+		seq_printf(m, "OPP%-3d us:      %llu\n", levels[i], us);
+	}
+
+	return 0;
+}
+
+static int abe_opp_residency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, abe_opp_residency_show, inode->i_private);
+}
+
+static const struct file_operations omap_abe_opp_fops = {
+	.open = abe_opp_residency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void abe_init_debugfs(struct omap_abe *abe)
 {
 	abe->debugfs.d_root = debugfs_create_dir("omap-abe", NULL);
@@ -320,6 +405,24 @@ void abe_init_debugfs(struct omap_abe *abe)
 	if (!abe->debugfs.d_opp)
 		dev_err(abe->dev, "Failed to create OPP level debugfs file\n");
 
+	abe->debugfs.d_opp_auto = debugfs_create_bool("opp_auto", 0644,
+						 abe->debugfs.d_root,
+						 &abe->opp.auto_select);
+	if (!abe->debugfs.d_opp_auto)
+		dev_err(abe->dev, "Failed to create OPP auto debugfs file\n");
+
+	abe->debugfs.d_opp_stats = debugfs_create_file("opp_residency", 0444,
+						 abe->debugfs.d_root,
+						 abe, &omap_abe_opp_fops);
+	if (!abe->debugfs.d_opp_stats)
+		dev_err(abe->dev, "Failed to create OPP residency debugfs file\n");
+
+	abe->debugfs.d_mmap = debugfs_create_file("mmap_latency", 0444,
+						 abe->debugfs.d_root,
+						 abe, &omap_abe_mmap_fops);
+	if (!abe->debugfs.d_mmap)
+		dev_err(abe->dev, "Failed to create mmap latency debugfs file\n");
+
 	init_waitqueue_head(&abe->debugfs.wait);
 }
 
@@ -330,7 +433,50 @@ void abe_cleanup_debugfs(struct omap_abe *abe)
 
 #else
 
-inline void abe_init_debugfs(struct omap_abe *abe)
+inline static int abe_opp_residency_show(struct seq_file *m, void *v)
+{
+	static const int levels[OMAP_ABE_OPP_COUNT] = { 25, 50, 100 };
+	struct omap_abe *abe = m->private;
+	u64 residency[OMAP_ABE_OPP_COUNT];
+	int i, level, stats_level;
+	u32 transitions;
+	ktime_t since;
+
+	mutex_lock(&abe->opp.mutex);
+	memcpy(residency, abe->opp.residency_us, sizeof(residency));
+	level = abe->opp.level;
+	stats_level = abe->opp.stats_level;
+	transitions = abe->opp.transitions;
+	since = abe->opp.last_change;
+	mutex_unlock(&abe->opp.mutex);
+
+	seq_printf(m, "level:          %d\n", level);
+	seq_printf(m, "auto:           %u\n", abe->opp.auto_select);
+	seq_printf(m, "transitions:    %u\n", transitions);
+	for (i = 0; i < OMAP_ABE_OPP_COUNT; i++) {
+		u64 us = residency[i];
+
+		if (stats_level == levels[i])
+			us += ktime_us_delta(ktime_get(), since);
+		seq_printf(m, "OPP%-3d us:      %llu\n", levels[i], us);
+	}
+
+	return 0;
+}
+
+static int abe_opp_residency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, abe_opp_residency_show, inode->i_private);
+}
+
+static const struct file_operations omap_abe_opp_fops = {
+	.open = abe_opp_residency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void abe_init_debugfs(struct omap_abe *abe)
 {
 }
 
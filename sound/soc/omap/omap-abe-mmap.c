@@ -24,7 +24,7 @@
  */
 
 #include <linux/pm_runtime.h>
-
+#include <linux/math64.h>
 
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -45,13 +45,38 @@ static const struct snd_pcm_hardware omap_abe_hardware = {
 				  SNDRV_PCM_INFO_RESUME,
 	.formats		= SNDRV_PCM_FMTBIT_S16_LE |
 				  SNDRV_PCM_FMTBIT_S32_LE,
-	.period_bytes_min	= 4 * 1024,
+	.period_bytes_min	= 192,	/* 1ms of 48kHz S16_LE stereo */
 	.period_bytes_max	= 24 * 1024,
 	.periods_min		= 4,
 	.periods_max		= 4,
 	.buffer_bytes_max	= 24 * 1024 * 2,
 };
 
+/* account the time between two ping-pong IRQs, called from the IRQ */
+static void abe_mmap_irq_stats(struct omap_abe *abe)
+{
+	struct omap_abe_mmap_stats *stats = &abe->mmap.stats;
+	ktime_t now = ktime_get();
+	u32 interval, jitter;
+
+	if (stats->irqs++) {
+		interval = (u32)ktime_us_delta(now, abe->mmap.last_irq);
+		jitter = abs((int)interval - (int)stats->period_us);
+
+		stats->last_us = interval;
+		stats->total_us += interval;
+		if (!stats->min_us || interval < stats->min_us)
+			stats->min_us = interval;
+		if (interval > stats->max_us)
+			stats->max_us = interval;
+		if (jitter > stats->jitter_max_us)
+			stats->jitter_max_us = jitter;
+		if (interval > stats->period_us + stats->period_us / 2)
+			stats->late++;
+	}
+	abe->mmap.last_irq = now;
+}
+
 static void abe_irq_pingpong_subroutine(u32 *sub, u32 *data)
 {
 
@@ -62,6 +87,9 @@ static void abe_irq_pingpong_subroutine(u32 *sub, u32 *data)
 	omap_aess_read_next_ping_pong_buffer(abe->aess, OMAP_ABE_MM_DL_PORT, &dst, &n_bytes);
 	omap_aess_set_ping_pong_buffer(abe->aess, OMAP_ABE_MM_DL_PORT, n_bytes);
 
+	abe_mmap_irq_stats(abe);
+	wake_up(&abe->mmap.wait);
+
 	/* 1st IRQ does not signal completed period */
 	if (abe->mmap.first_irq) {
 		abe->mmap.first_irq = 0;
@@ -113,8 +141,16 @@ static int aess_open(struct snd_pcm_substream *substream)
 		break;
 	case OMAP_ABE_FRONTEND_DAI_LP_MEDIA:
 		snd_soc_set_runtime_hwparams(substream, &omap_abe_hardware);
-		ret = snd_pcm_hw_constraint_step(substream->runtime, 0,
-					 SNDRV_PCM_HW_PARAM_BUFFER_BYTES, 1024);
+		/*
+		 * Periods are played straight from the DMEM ping-pong
+		 * buffers so they still have to match the processing loop,
+		 * down to 1ms for the low latency users.
+		 */
+		ret = snd_pcm_hw_rule_add(substream->runtime, 0,
+					SNDRV_PCM_HW_PARAM_PERIOD_SIZE,
+					omap_abe_hwrule_period_step,
+					NULL,
+					SNDRV_PCM_HW_PARAM_PERIOD_SIZE, -1);
 		break;
 	default:
 		/*
@@ -201,6 +237,10 @@ static int aess_hw_params(struct snd_pcm_substream *substream,
 	omap_aess_set_ping_pong_buffer(abe->aess, OMAP_ABE_MM_DL_PORT, period_size);
 	abe->mmap.first_irq = 1;
 
+	memset(&abe->mmap.stats, 0, sizeof(abe->mmap.stats));
+	abe->mmap.stats.period_us = div_u64((u64)params_period_size(params) *
+					    USEC_PER_SEC, params_rate(params));
+
 out:
 	mutex_unlock(&abe->mutex);
 	return ret;
@@ -28,10 +28,147 @@
 #include <linux/slab.h>
 #include <linux/export.h>
 #include <linux/delay.h>
+#include <linux/wait.h>
 
 #include <sound/soc.h>
 
 #include "omap-abe-priv.h"
+#include "abe/abe_taskid.h"
+
+/*
+ * Firmware processing tasks of the default scheduling table each widget
+ * needs while powered.  The I/O and ASRC tasks of the ports are added to
+ * the table when the ports start, at their sample rate, and are always
+ * accounted for.
+ */
+static const struct {
+	int widget;
+	u16 task;
+} abe_opp_widget_tasks[] = {
+	{ OMAP_ABE_MIXER_DL1, C_ABE_FW_TASK_DL1Mixer },
+	{ OMAP_ABE_MIXER_DL1, C_ABE_FW_TASK_DL1_GAIN },
+	{ OMAP_ABE_MIXER_DL1, C_ABE_FW_TASK_DL1_EQ },
+	{ OMAP_ABE_VOLUME_DL1, C_ABE_FW_TASK_DL1_GAIN },
+	{ OMAP_ABE_MIXER_DL2, C_ABE_FW_TASK_DL2Mixer },
+	{ OMAP_ABE_MIXER_DL2, C_ABE_FW_TASK_DL2_GAIN },
+	{ OMAP_ABE_MIXER_DL2, C_ABE_FW_TASK_DL2_EQ },
+	{ OMAP_ABE_MIXER_SDT, C_ABE_FW_TASK_SDTMixer },
+	{ OMAP_ABE_MIXER_SDT, C_ABE_FW_TASK_SideTone },
+	{ OMAP_ABE_MIXER_VX_REC, C_ABE_FW_TASK_VXRECMixer },
+	{ OMAP_ABE_MIXER_VX_REC, C_ABE_FW_TASK_VXREC_SPLIT },
+	{ OMAP_ABE_AIF_VXREC, C_ABE_FW_TASK_VXREC_SPLIT },
+	{ OMAP_ABE_MIXER_ECHO, C_ABE_FW_TASK_EchoMixer },
+	{ OMAP_ABE_AIF_ECHO, C_ABE_FW_TASK_EchoMixer },
+	{ OMAP_ABE_AIF_ECHO, C_ABE_FW_TASK_ECHO_REF_SPLIT },
+	{ OMAP_ABE_MIXER_AUDIO_UL, C_ABE_FW_TASK_ULMixer },
+	{ OMAP_ABE_MUX_VX00, C_ABE_FW_TASK_VX_UL_ROUTING },
+	{ OMAP_ABE_MUX_VX01, C_ABE_FW_TASK_VX_UL_ROUTING },
+	{ OMAP_ABE_AIF_VX_UL, C_ABE_FW_TASK_VX_UL_ROUTING },
+	{ OMAP_ABE_AIF_VX_UL, C_ABE_FW_TASK_ULMixer },
+	{ OMAP_ABE_AIF_VX_UL, C_ABE_FW_TASK_VX_UL_48_8 },
+	{ OMAP_ABE_AIF_VX_UL, C_ABE_FW_TASK_ASRC_VX_UL_8 },
+	{ OMAP_ABE_AIF_MODEM_UL, C_ABE_FW_TASK_VX_UL_ROUTING },
+	{ OMAP_ABE_AIF_MODEM_UL, C_ABE_FW_TASK_ULMixer },
+	{ OMAP_ABE_AIF_MODEM_UL, C_ABE_FW_TASK_VX_UL_48_8 },
+	{ OMAP_ABE_AIF_MODEM_UL, C_ABE_FW_TASK_ASRC_VX_UL_8 },
+	{ OMAP_ABE_AIF_VX_DL, C_ABE_FW_TASK_VX_DL_8_48_FIR },
+	{ OMAP_ABE_AIF_VX_DL, C_ABE_FW_TASK_ASRC_VX_DL_8 },
+	{ OMAP_ABE_AIF_MODEM_DL, C_ABE_FW_TASK_VX_DL_8_48_FIR },
+	{ OMAP_ABE_AIF_MODEM_DL, C_ABE_FW_TASK_ASRC_VX_DL_8 },
+	{ OMAP_ABE_AIF_MM_UL2, C_ABE_FW_TASK_MM_UL2_ROUTING },
+	{ OMAP_ABE_AIF_PDM_DL1, C_ABE_FW_TASK_EARP_48_96_LP },
+	{ OMAP_ABE_AIF_PDM_DL2, C_ABE_FW_TASK_IHF_48_96_LP },
+	{ OMAP_ABE_AIF_VIB_DL, C_ABE_FW_TASK_VIBRA1 },
+	{ OMAP_ABE_AIF_VIB_DL, C_ABE_FW_TASK_VIBRA2 },
+	{ OMAP_ABE_AIF_VIB_DL, C_ABE_FW_TASK_VIBRA_SPLIT },
+	{ OMAP_ABE_AIF_VIB_DL, C_ABE_FW_TASK_VIBRA_PACK },
+	{ OMAP_ABE_AIF_PDM_VIB, C_ABE_FW_TASK_VIBRA1 },
+	{ OMAP_ABE_AIF_PDM_VIB, C_ABE_FW_TASK_VIBRA2 },
+	{ OMAP_ABE_AIF_PDM_VIB, C_ABE_FW_TASK_VIBRA_SPLIT },
+	{ OMAP_ABE_AIF_PDM_VIB, C_ABE_FW_TASK_VIBRA_PACK },
+	{ OMAP_ABE_AIF_PDM_UL1, C_ABE_FW_TASK_AMIC_96_48_LP },
+	{ OMAP_ABE_AIF_PDM_UL1, C_ABE_FW_TASK_AMIC_SPLIT },
+	{ OMAP_ABE_AIF_DMIC0, C_ABE_FW_TASK_DMIC1_96_48_LP },
+	{ OMAP_ABE_AIF_DMIC0, C_ABE_FW_TASK_DMIC1_SPLIT },
+	{ OMAP_ABE_AIF_DMIC1, C_ABE_FW_TASK_DMIC2_96_48_LP },
+	{ OMAP_ABE_AIF_DMIC1, C_ABE_FW_TASK_DMIC2_SPLIT },
+	{ OMAP_ABE_AIF_DMIC2, C_ABE_FW_TASK_DMIC3_96_48_LP },
+	{ OMAP_ABE_AIF_DMIC2, C_ABE_FW_TASK_DMIC3_SPLIT },
+	{ OMAP_ABE_AIF_BT_VX_UL, C_ABE_FW_TASK_BT_UL_8_48 },
+	{ OMAP_ABE_AIF_BT_VX_UL, C_ABE_FW_TASK_BT_UL_SPLIT },
+	{ OMAP_ABE_AIF_BT_VX_DL, C_ABE_FW_TASK_BT_DL_48_8_FIR_FW_COMPAT },
+	{ OMAP_ABE_AIF_MM_EXT_UL, C_ABE_FW_TASK_MM_EXT_IN_SPLIT },
+	{ OMAP_ABE_AIF_MM_EXT_DL, C_ABE_FW_TASK_MM_EXT_IN_SPLIT },
+};
+
+static int abe_opp_index(int opp)
+{
+	switch (opp) {
+	case 25:
+		return OMAP_ABE_OPP_25;
+	case 50:
+		return OMAP_ABE_OPP_50;
+	case 100:
+		return OMAP_ABE_OPP_100;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* lowest OPP at which the firmware runs all the tasks of the active widgets */
+static int abe_opp_get_task_level(struct omap_abe *abe)
+{
+	u16 tasks[ARRAY_SIZE(abe_opp_widget_tasks)];
+	int i, count = 0;
+
+	for (i = 0; i < ARRAY_SIZE(abe_opp_widget_tasks); i++)
+		if (abe->opp.widget[abe_opp_widget_tasks[i].widget])
+			tasks[count++] = abe_opp_widget_tasks[i].task;
+
+	switch (omap_aess_get_task_opp(abe->aess, tasks, count)) {
+	case ABE_OPP25:
+		return 25;
+	case ABE_OPP50:
+		return 50;
+	default:
+		return 100;
+	}
+}
+
+/*
+ * The firmware takes a new OPP into account from its next multiframe.  When
+ * the ping-pong stream runs, switch just after one of its IRQs so that the
+ * change never straddles a buffer swap.
+ */
+static void abe_opp_wait_pingpong(struct omap_abe *abe)
+{
+	struct omap_abe_port *port = abe->dai.port[OMAP_ABE_FE_PORT_MM_DL_LP];
+	u32 period_us = abe->mmap.stats.period_us;
+	u32 irqs = abe->mmap.stats.irqs;
+
+	if (!port || !period_us || !omap_abe_port_is_enabled(abe->aess, port))
+		return;
+
+	wait_event_timeout(abe->mmap.wait,
+			   ACCESS_ONCE(abe->mmap.stats.irqs) != irqs,
+			   usecs_to_jiffies(2 * period_us) + 1);
+}
+
+/*
+ * Charge the time since the last update to the OPP the ABE ran at, and
+ * start charging @opp, 0 meaning the ABE is shut down.
+ */
+void abe_opp_update_residency(struct omap_abe *abe, int opp)
+{
+	ktime_t now = ktime_get();
+	int idx = abe_opp_index(abe->opp.stats_level);
+
+	if (idx >= 0)
+		abe->opp.residency_us[idx] +=
+			ktime_us_delta(now, abe->opp.last_change);
+	abe->opp.last_change = now;
+	abe->opp.stats_level = opp;
+}
 
 static struct abe_opp_req *abe_opp_lookup_requested(struct omap_abe *abe,
 					struct device *dev)
@@ -177,6 +314,7 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 		/* Decrease OPP mode - no need of OPP100% */
 		switch (opp) {
 		case 25:
+			abe_opp_wait_pingpong(abe);
 			omap_aess_set_opp_processing(abe->aess, ABE_OPP25);
 			udelay(250);
 			if (abe->device_scale) {
@@ -188,6 +326,7 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 			break;
 		case 50:
 		default:
+			abe_opp_wait_pingpong(abe);
 			omap_aess_set_opp_processing(abe->aess, ABE_OPP50);
 			udelay(250);
 			if (abe->device_scale) {
@@ -208,6 +347,7 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 				if (ret)
 					goto err_up_scale;
 			}
+			abe_opp_wait_pingpong(abe);
 			omap_aess_set_opp_processing(abe->aess, ABE_OPP25);
 			break;
 		case 50:
@@ -217,6 +357,7 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 				if (ret)
 					goto err_up_scale;
 			}
+			abe_opp_wait_pingpong(abe);
 			omap_aess_set_opp_processing(abe->aess, ABE_OPP50);
 			break;
 		case 100:
@@ -227,10 +368,14 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 				if (ret)
 					goto err_up_scale;
 			}
+			abe_opp_wait_pingpong(abe);
 			omap_aess_set_opp_processing(abe->aess, ABE_OPP100);
 			break;
 		}
 	}
+	if (abe->opp.level != opp)
+		abe->opp.transitions++;
+	abe_opp_update_residency(abe, opp);
 	abe->opp.level = opp;
 	dev_dbg(abe->dev, "opp: new OPP level is %d\n", opp);
 
@@ -275,6 +420,14 @@ int abe_opp_recalc_level(struct omap_abe *abe)
 	}
 	opp = (1 << (fls(opp) - 1)) * 25;
 
+	/* the widget OPPs are worst cases, the firmware tasks tell better */
+	if (opp && abe->opp.auto_select) {
+		int task_opp = abe_opp_get_task_level(abe);
+
+		dev_dbg(abe->dev, "opp: widgets %d tasks %d\n", opp, task_opp);
+		opp = task_opp;
+	}
+
 	/* OPP requested outside ABE driver (e.g. McPDM) */
 	requested_opp = abe_opp_get_requested(abe);
 	dev_dbg(abe->dev, "opp: calculated %d requested %d selected %d\n",
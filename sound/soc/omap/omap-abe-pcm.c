@@ -1284,6 +1284,7 @@ static void omap_abe_dai_shutdown(struct snd_pcm_substream *substream,
 	if (!abe->active && !omap_aess_check_activity(abe->aess)) {
 		omap_aess_set_opp_processing(abe->aess, ABE_OPP25);
 		abe->opp.level = 25;
+		abe_opp_update_residency(abe, 0);
 		omap_aess_stop_event_generator(abe->aess);
 		udelay(250);
 		if (abe->device_scale) {
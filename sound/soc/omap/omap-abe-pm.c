@@ -79,6 +79,7 @@ void omap_abe_pm_shutdown(struct snd_soc_platform *platform)
 
 	omap_aess_set_opp_processing(abe->aess, ABE_OPP25);
 	abe->opp.level = 25;
+	abe_opp_update_residency(abe, 0);
 
 	omap_aess_stop_event_generator(abe->aess);
 	udelay(250);
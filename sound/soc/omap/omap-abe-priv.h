@@ -26,6 +26,8 @@
 
 #include <sound/soc.h>
 #include <linux/irqreturn.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 
 #include "abe/abe.h"
 #include "abe/abe_gain.h"
@@ -253,6 +255,9 @@ struct omap_abe_debugfs {
 	struct dentry *d_circ;
 	struct dentry *d_elem_bytes;
 	struct dentry *d_opp;
+	struct dentry *d_opp_auto;
+	struct dentry *d_opp_stats;
+	struct dentry *d_mmap;
 };
 
 struct omap_abe_dc_offset {
@@ -272,6 +277,15 @@ struct omap_abe_opp {
 	u32 widget[OMAP_ABE_NUM_DAPM_REG + 1];
 	struct list_head req;
 	int req_count;
+
+	/* pick the OPP from the firmware tasks in use, not the widget OPPs */
+	u32 auto_select;
+
+	/* time spent at each OPP, up to last_change */
+	u64 residency_us[OMAP_ABE_OPP_COUNT];
+	ktime_t last_change;
+	int stats_level;
+	u32 transitions;
 };
 
 struct omap_abe_modem {
@@ -279,8 +293,23 @@ struct omap_abe_modem {
 	struct snd_soc_dai *dai;
 };
 
+/* ping-pong IRQ timing of the mmap (MM_LP) stream, in us */
+struct omap_abe_mmap_stats {
+	u32 period_us;
+	u32 irqs;
+	u32 late;
+	u32 last_us;
+	u32 min_us;
+	u32 max_us;
+	u32 jitter_max_us;
+	u64 total_us;
+};
+
 struct omap_abe_mmap {
 	int first_irq;
+	ktime_t last_irq;
+	struct omap_abe_mmap_stats stats;
+	wait_queue_head_t wait;		/* woken on each ping-pong IRQ */
 };
 
 struct omap_abe_equ {
@@ -400,6 +429,7 @@ int abe_opp_recalc_level(struct omap_abe *abe);
 /* omap-abe-opp.c */
 int abe_opp_init_initial_opp(struct omap_abe *abe);
 int abe_opp_set_level(struct omap_abe *abe, int opp);
+void abe_opp_update_residency(struct omap_abe *abe, int opp);
 int abe_opp_stream_event(struct snd_soc_dapm_context *dapm, int event);
 
 /* omap-abe-dbg.c */
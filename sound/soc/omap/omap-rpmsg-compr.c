@@ -0,0 +1,701 @@
+/*
+ * omap-rpmsg-compr.c  --  Compressed audio offload to a remote processor
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ * MP3 and AAC streams are written by the application into a ring buffer
+ * shared with the remote processor, which decodes and renders them. The
+ * ring is handed over one fragment at a time with rpmsg_send_shared()
+ * and the remote gives every fragment back once decoded, along with the
+ * frames decoded and rendered so far. With large fragments the MPU is
+ * only woken up every few seconds.
+ *
+ * The consumed bytes and rendered frames reported at each fragment
+ * boundary make the stream timestamps, so the application can tell
+ * where a track ends (gapless playback) and where to restart after a
+ * seek, which is a stop and a new start.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/dma-mapping.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/virtio.h>
+#include <linux/rpmsg.h>
+
+#include <sound/core.h>
+#include <sound/initval.h>
+#include <sound/compress_params.h>
+#include <sound/compress_offload.h>
+#include <sound/compress_driver.h>
+
+#define OMAP_COMPR_MIN_FRAGMENT_SIZE	(4 * 1024)
+#define OMAP_COMPR_MAX_FRAGMENT_SIZE	(64 * 1024)
+#define OMAP_COMPR_MIN_FRAGMENTS	2
+#define OMAP_COMPR_MAX_FRAGMENTS	8
+
+#define OMAP_COMPR_REPLY_TIMEOUT	msecs_to_jiffies(1000)
+
+/* messages exchanged with the remote decoder */
+enum omap_compr_msg_type {
+	OMAP_COMPR_MSG_OPEN,
+	OMAP_COMPR_MSG_CLOSE,
+	OMAP_COMPR_MSG_START,
+	OMAP_COMPR_MSG_STOP,
+	OMAP_COMPR_MSG_PAUSE,
+	OMAP_COMPR_MSG_RESUME,
+	OMAP_COMPR_MSG_DRAIN,
+	/* from the remote */
+	OMAP_COMPR_MSG_REPLY,
+	OMAP_COMPR_MSG_CONSUMED,
+	OMAP_COMPR_MSG_DRAINED,
+};
+
+struct omap_compr_msg {
+	u32 type;
+	s32 status;
+	union {
+		/* OPEN */
+		struct {
+			u32 codec;
+			u32 ch_in;
+			u32 ch_out;
+			u32 sample_rate;
+			u32 bit_rate;
+			u32 profile;
+			u32 format;
+		} open;
+		/* CONSUMED: fragment at @da is decoded */
+		struct {
+			u32 da;
+			u32 pcm_frames;
+			u32 pcm_io_frames;
+		} consumed;
+	};
+} __packed;
+
+struct omap_compr_frag {
+	struct rpmsg_shared_buf buf;
+	bool done;
+};
+
+struct omap_compr {
+	struct rpmsg_channel *rpdev;
+	struct snd_card *card;
+	struct snd_compr compr;
+	struct snd_compr_stream *stream;
+	struct device *dma_dev;
+
+	struct mutex mutex;
+	struct snd_codec codec;
+	void *buffer;
+	dma_addr_t buffer_dma;
+	u32 buffer_size;
+	u32 fragment_size;
+
+	/* fragments owned by the remote, oldest first */
+	struct omap_compr_frag frags[OMAP_COMPR_MAX_FRAGMENTS];
+	int nfrags;
+	int head;
+	int count;
+
+	u64 written;
+	u64 queued;
+	bool running;
+	bool draining;
+	bool drain_sent;
+	bool drained;
+
+	/* protected by lock, updated from the rpmsg callback */
+	spinlock_t lock;
+	u64 consumed;
+	u32 pcm_frames;
+	u32 pcm_io_frames;
+
+	struct work_struct work;
+	struct completion reply;
+	int reply_status;
+};
+
+static int omap_compr_send(struct omap_compr *omap, struct omap_compr_msg *msg)
+{
+	int ret;
+
+	INIT_COMPLETION(omap->reply);
+	ret = rpmsg_send(omap->rpdev, msg, sizeof(*msg));
+	if (ret)
+		return ret;
+
+	if (!wait_for_completion_timeout(&omap->reply,
+					 OMAP_COMPR_REPLY_TIMEOUT)) {
+		dev_err(&omap->rpdev->dev, "no reply to message %u\n",
+			msg->type);
+		return -ETIMEDOUT;
+	}
+
+	return omap->reply_status;
+}
+
+static int omap_compr_cmd(struct omap_compr *omap, u32 type)
+{
+	struct omap_compr_msg msg = { .type = type };
+
+	return omap_compr_send(omap, &msg);
+}
+
+/* take back the fragments the remote is done with, in order */
+static void omap_compr_reclaim(struct omap_compr *omap, bool all)
+{
+	struct omap_compr_frag *frag;
+	unsigned long flags;
+
+	while (omap->count) {
+		frag = &omap->frags[omap->head];
+
+		spin_lock_irqsave(&omap->lock, flags);
+		if (!frag->done && !all) {
+			spin_unlock_irqrestore(&omap->lock, flags);
+			break;
+		}
+		frag->done = false;
+		spin_unlock_irqrestore(&omap->lock, flags);
+
+		rpmsg_shared_buf_reclaim(&frag->buf);
+
+		/* only now the application may write over it */
+		spin_lock_irqsave(&omap->lock, flags);
+		omap->consumed += frag->buf.len;
+		spin_unlock_irqrestore(&omap->lock, flags);
+
+		omap->head = (omap->head + 1) % omap->nfrags;
+		omap->count--;
+	}
+}
+
+/* hand full fragments (or what is left, when draining) to the remote */
+static void omap_compr_queue(struct omap_compr *omap)
+{
+	struct omap_compr_frag *frag;
+	u64 pending, offset;
+	u32 pos, len;
+	int ret;
+
+	while (omap->running && omap->count < omap->nfrags) {
+		pending = omap->written - omap->queued;
+		if (!pending || (pending < omap->fragment_size &&
+				 !omap->draining))
+			break;
+
+		offset = omap->queued;
+		pos = do_div(offset, omap->buffer_size);
+		len = min_t(u64, pending, omap->fragment_size);
+		len = min(len, omap->buffer_size - pos);
+
+		frag = &omap->frags[(omap->head + omap->count) % omap->nfrags];
+		ret = rpmsg_send_shared(&frag->buf, omap->rpdev->src,
+					omap->rpdev->dst, pos, len, true);
+		if (ret) {
+			dev_err(&omap->rpdev->dev, "failed to queue %u bytes: %d\n",
+				len, ret);
+			break;
+		}
+
+		omap->queued += len;
+		omap->count++;
+	}
+
+	if (omap->draining && !omap->drain_sent &&
+	    omap->queued == omap->written) {
+		if (!omap_compr_cmd(omap, OMAP_COMPR_MSG_DRAIN))
+			omap->drain_sent = true;
+	}
+}
+
+static void omap_compr_work(struct work_struct *work)
+{
+	struct omap_compr *omap = container_of(work, struct omap_compr, work);
+	struct snd_compr_stream *stream;
+	bool drained;
+
+	mutex_lock(&omap->mutex);
+	stream = omap->stream;
+	omap_compr_reclaim(omap, false);
+	omap_compr_queue(omap);
+	drained = omap->drained;
+	if (drained) {
+		omap->drained = false;
+		omap->draining = false;
+		omap->drain_sent = false;
+		omap->running = false;
+	}
+	mutex_unlock(&omap->mutex);
+
+	if (!stream)
+		return;
+
+	if (drained) {
+		/* end of drain moves the stream back to setup */
+		mutex_lock(&omap->compr.lock);
+		if (stream->runtime->state == SNDRV_PCM_STATE_DRAINING)
+			stream->runtime->state = SNDRV_PCM_STATE_SETUP;
+		mutex_unlock(&omap->compr.lock);
+	}
+
+	snd_compr_fragment_elapsed(stream);
+}
+
+static void omap_compr_cb(struct rpmsg_channel *rpdev, void *data, int len,
+			  void *priv, u32 src)
+{
+	struct omap_compr *omap = dev_get_drvdata(&rpdev->dev);
+	struct omap_compr_msg *msg = data;
+	struct omap_compr_frag *frag;
+	unsigned long flags;
+	int i;
+
+	if (len < sizeof(*msg)) {
+		dev_err(&rpdev->dev, "short message: %d bytes\n", len);
+		return;
+	}
+
+	switch (msg->type) {
+	case OMAP_COMPR_MSG_REPLY:
+		omap->reply_status = msg->status;
+		complete(&omap->reply);
+		break;
+	case OMAP_COMPR_MSG_CONSUMED:
+		spin_lock_irqsave(&omap->lock, flags);
+		for (i = 0; i < omap->nfrags; i++) {
+			frag = &omap->frags[i];
+			if (frag->buf.remote &&
+			    frag->buf.da + frag->buf.offset == msg->consumed.da) {
+				frag->done = true;
+				break;
+			}
+		}
+		omap->pcm_frames = msg->consumed.pcm_frames;
+		omap->pcm_io_frames = msg->consumed.pcm_io_frames;
+		spin_unlock_irqrestore(&omap->lock, flags);
+
+		if (i == omap->nfrags)
+			dev_err(&rpdev->dev, "unknown fragment 0x%x\n",
+				msg->consumed.da);
+		schedule_work(&omap->work);
+		break;
+	case OMAP_COMPR_MSG_DRAINED:
+		omap->drained = true;
+		schedule_work(&omap->work);
+		break;
+	default:
+		dev_err(&rpdev->dev, "unexpected message %u\n", msg->type);
+		break;
+	}
+}
+
+static void omap_compr_free_buffer(struct omap_compr *omap)
+{
+	if (!omap->buffer)
+		return;
+
+	dma_free_coherent(omap->dma_dev, omap->buffer_size, omap->buffer,
+			  omap->buffer_dma);
+	omap->buffer = NULL;
+}
+
+static int omap_compr_open(struct snd_compr_stream *stream)
+{
+	struct omap_compr *omap = stream->private_data;
+	int ret = 0;
+
+	mutex_lock(&omap->mutex);
+	if (omap->stream) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	omap->stream = stream;
+	omap->written = 0;
+	omap->queued = 0;
+	omap->head = 0;
+	omap->count = 0;
+	omap->consumed = 0;
+	omap->pcm_frames = 0;
+	omap->pcm_io_frames = 0;
+out:
+	mutex_unlock(&omap->mutex);
+	return ret;
+}
+
+static int omap_compr_free(struct snd_compr_stream *stream)
+{
+	struct omap_compr *omap = stream->private_data;
+
+	mutex_lock(&omap->mutex);
+	if (omap->running)
+		omap_compr_cmd(omap, OMAP_COMPR_MSG_STOP);
+	omap->running = false;
+	omap->draining = false;
+	omap->drain_sent = false;
+	omap->drained = false;
+	if (omap->buffer)
+		omap_compr_cmd(omap, OMAP_COMPR_MSG_CLOSE);
+	mutex_unlock(&omap->mutex);
+
+	cancel_work_sync(&omap->work);
+
+	mutex_lock(&omap->mutex);
+	omap_compr_reclaim(omap, true);
+	omap_compr_free_buffer(omap);
+	omap->stream = NULL;
+	mutex_unlock(&omap->mutex);
+
+	return 0;
+}
+
+static int omap_compr_set_params(struct snd_compr_stream *stream,
+				 struct snd_compr_params *params)
+{
+	struct omap_compr *omap = stream->private_data;
+	struct snd_codec *codec = &params->codec;
+	struct omap_compr_msg msg = { .type = OMAP_COMPR_MSG_OPEN };
+	u32 fragment_size = params->buffer.fragment_size;
+	u32 fragments = params->buffer.fragments;
+	int i, ret;
+
+	if (codec->id != SND_AUDIOCODEC_MP3 && codec->id != SND_AUDIOCODEC_AAC)
+		return -EINVAL;
+
+	if (fragment_size < OMAP_COMPR_MIN_FRAGMENT_SIZE ||
+	    fragment_size > OMAP_COMPR_MAX_FRAGMENT_SIZE ||
+	    fragments < OMAP_COMPR_MIN_FRAGMENTS ||
+	    fragments > OMAP_COMPR_MAX_FRAGMENTS)
+		return -EINVAL;
+
+	mutex_lock(&omap->mutex);
+
+	omap->buffer_size = fragment_size * fragments;
+	omap->buffer = dma_alloc_coherent(omap->dma_dev, omap->buffer_size,
+					  &omap->buffer_dma, GFP_KERNEL);
+	if (!omap->buffer) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* every fragment may cover any part of the ring */
+	for (i = 0; i < fragments; i++) {
+		ret = rpmsg_shared_buf_init(&omap->frags[i].buf, omap->rpdev,
+					    omap->buffer_dma,
+					    omap->buffer_size);
+		if (ret) {
+			dev_err(&omap->rpdev->dev,
+				"ring not visible from the remote: %d\n", ret);
+			goto err;
+		}
+		omap->frags[i].done = false;
+	}
+	omap->nfrags = fragments;
+	omap->fragment_size = fragment_size;
+
+	msg.open.codec = codec->id;
+	msg.open.ch_in = codec->ch_in;
+	msg.open.ch_out = codec->ch_out;
+	msg.open.sample_rate = codec->sample_rate;
+	msg.open.bit_rate = codec->bit_rate;
+	msg.open.profile = codec->profile;
+	msg.open.format = codec->format;
+	ret = omap_compr_send(omap, &msg);
+	if (ret) {
+		dev_err(&omap->rpdev->dev, "remote decoder open failed: %d\n",
+			ret);
+		goto err;
+	}
+
+	omap->codec = *codec;
+	mutex_unlock(&omap->mutex);
+	return 0;
+
+err:
+	omap_compr_free_buffer(omap);
+out:
+	mutex_unlock(&omap->mutex);
+	return ret;
+}
+
+static int omap_compr_get_params(struct snd_compr_stream *stream,
+				 struct snd_codec *params)
+{
+	struct omap_compr *omap = stream->private_data;
+
+	mutex_lock(&omap->mutex);
+	*params = omap->codec;
+	mutex_unlock(&omap->mutex);
+
+	return 0;
+}
+
+static int omap_compr_trigger(struct snd_compr_stream *stream, int cmd)
+{
+	struct omap_compr *omap = stream->private_data;
+	unsigned long flags;
+	int ret = 0;
+
+	mutex_lock(&omap->mutex);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+		ret = omap_compr_cmd(omap, OMAP_COMPR_MSG_START);
+		if (ret)
+			break;
+		omap->running = true;
+		omap_compr_queue(omap);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+		ret = omap_compr_cmd(omap, OMAP_COMPR_MSG_STOP);
+		if (ret)
+			break;
+
+		/* the remote drops whatever it was given */
+		omap->running = false;
+		omap->draining = false;
+		omap->drain_sent = false;
+		omap->drained = false;
+		omap_compr_reclaim(omap, true);
+
+		spin_lock_irqsave(&omap->lock, flags);
+		omap->consumed = omap->written;
+		spin_unlock_irqrestore(&omap->lock, flags);
+		omap->queued = omap->written;
+		break;
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		ret = omap_compr_cmd(omap, OMAP_COMPR_MSG_PAUSE);
+		break;
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		ret = omap_compr_cmd(omap, OMAP_COMPR_MSG_RESUME);
+		break;
+	case SND_COMPR_TRIGGER_DRAIN:
+		omap->draining = true;
+		omap_compr_queue(omap);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	mutex_unlock(&omap->mutex);
+	return ret;
+}
+
+static int omap_compr_pointer(struct snd_compr_stream *stream,
+			      struct snd_compr_tstamp *tstamp)
+{
+	struct omap_compr *omap = stream->private_data;
+	unsigned long flags;
+	u64 consumed;
+
+	spin_lock_irqsave(&omap->lock, flags);
+	consumed = omap->consumed;
+	tstamp->pcm_frames = omap->pcm_frames;
+	tstamp->pcm_io_frames = omap->pcm_io_frames;
+	spin_unlock_irqrestore(&omap->lock, flags);
+
+	tstamp->copied_total = (u32)consumed;
+	tstamp->byte_offset = omap->buffer_size ?
+				do_div(consumed, omap->buffer_size) : 0;
+	tstamp->sampling_rate = omap->codec.sample_rate;
+
+	return 0;
+}
+
+static int omap_compr_copy(struct snd_compr_stream *stream,
+			   const char __user *buf, size_t count)
+{
+	struct omap_compr *omap = stream->private_data;
+	u64 written;
+	size_t copy;
+	u32 pos;
+	int ret = count;
+
+	mutex_lock(&omap->mutex);
+
+	written = omap->written;
+	pos = do_div(written, omap->buffer_size);
+
+	copy = min_t(size_t, count, omap->buffer_size - pos);
+	if (copy_from_user(omap->buffer + pos, buf, copy) ||
+	    copy_from_user(omap->buffer, buf + copy, count - copy)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	omap->written += count;
+	stream->runtime->app_pointer = (pos + count) % omap->buffer_size;
+	omap_compr_queue(omap);
+out:
+	mutex_unlock(&omap->mutex);
+	return ret;
+}
+
+static int omap_compr_get_caps(struct snd_compr_stream *stream,
+			       struct snd_compr_caps *caps)
+{
+	memset(caps, 0, sizeof(*caps));
+	caps->direction = SND_COMPRESS_PLAYBACK;
+	caps->min_fragment_size = OMAP_COMPR_MIN_FRAGMENT_SIZE;
+	caps->max_fragment_size = OMAP_COMPR_MAX_FRAGMENT_SIZE;
+	caps->min_fragments = OMAP_COMPR_MIN_FRAGMENTS;
+	caps->max_fragments = OMAP_COMPR_MAX_FRAGMENTS;
+	caps->num_codecs = 2;
+	caps->codecs[0] = SND_AUDIOCODEC_MP3;
+	caps->codecs[1] = SND_AUDIOCODEC_AAC;
+
+	return 0;
+}
+
+static int omap_compr_get_codec_caps(struct snd_compr_stream *stream,
+				     struct snd_compr_codec_caps *codec)
+{
+	struct snd_codec_desc *desc = &codec->descriptor[0];
+	u32 id = codec->codec;
+
+	memset(codec, 0, sizeof(*codec));
+	codec->codec = id;
+	desc->max_ch = 2;
+	desc->sample_rates = SNDRV_PCM_RATE_8000_48000;
+	desc->min_buffer = OMAP_COMPR_MIN_FRAGMENT_SIZE;
+
+	switch (id) {
+	case SND_AUDIOCODEC_MP3:
+		desc->modes = SND_AUDIOCHANMODE_MP3_STEREO;
+		break;
+	case SND_AUDIOCODEC_AAC:
+		desc->profiles = SND_AUDIOPROFILE_AAC;
+		desc->modes = SND_AUDIOMODE_AAC_LC;
+		desc->formats = SND_AUDIOSTREAMFORMAT_MP4ADTS |
+				SND_AUDIOSTREAMFORMAT_RAW;
+		break;
+	default:
+		return -EINVAL;
+	}
+	codec->num_descriptors = 1;
+
+	return 0;
+}
+
+static struct snd_compr_ops omap_compr_ops = {
+	.open		= omap_compr_open,
+	.free		= omap_compr_free,
+	.set_params	= omap_compr_set_params,
+	.get_params	= omap_compr_get_params,
+	.trigger	= omap_compr_trigger,
+	.pointer	= omap_compr_pointer,
+	.copy		= omap_compr_copy,
+	.get_caps	= omap_compr_get_caps,
+	.get_codec_caps	= omap_compr_get_codec_caps,
+};
+
+static int omap_compr_probe(struct rpmsg_channel *rpdev)
+{
+	struct omap_compr *omap;
+	int ret;
+
+	omap = kzalloc(sizeof(*omap), GFP_KERNEL);
+	if (!omap)
+		return -ENOMEM;
+
+	omap->rpdev = rpdev;
+	/* the device the rpmsg buffers come from is mapped on the remote */
+	omap->dma_dev = rpdev->vrp->vdev->dev.parent->parent;
+	mutex_init(&omap->mutex);
+	spin_lock_init(&omap->lock);
+	INIT_WORK(&omap->work, omap_compr_work);
+	init_completion(&omap->reply);
+	dev_set_drvdata(&rpdev->dev, omap);
+
+	ret = snd_card_create(SNDRV_DEFAULT_IDX1, "OMAPCompr", THIS_MODULE, 0,
+			      &omap->card);
+	if (ret)
+		goto err;
+	snd_card_set_dev(omap->card, &rpdev->dev);
+	strlcpy(omap->card->driver, "omap-compr", sizeof(omap->card->driver));
+	strlcpy(omap->card->shortname, "OMAP compressed offload",
+		sizeof(omap->card->shortname));
+	strlcpy(omap->card->longname, "OMAP compressed offload",
+		sizeof(omap->card->longname));
+
+	omap->compr.name = "OMAP Compressed Playback";
+	omap->compr.dev = &rpdev->dev;
+	omap->compr.ops = &omap_compr_ops;
+	omap->compr.private_data = omap;
+
+	ret = snd_compress_new(omap->card, 0, SND_COMPRESS_PLAYBACK,
+			       &omap->compr);
+	if (ret)
+		goto err_card;
+
+	ret = snd_compress_register(&omap->compr);
+	if (ret)
+		goto err_card;
+
+	dev_info(&rpdev->dev, "compressed offload on channel 0x%x -> 0x%x\n",
+		 rpdev->src, rpdev->dst);
+	return 0;
+
+err_card:
+	snd_card_free(omap->card);
+err:
+	kfree(omap);
+	return ret;
+}
+
+static void __devexit omap_compr_remove(struct rpmsg_channel *rpdev)
+{
+	struct omap_compr *omap = dev_get_drvdata(&rpdev->dev);
+
+	/* frees the card as well */
+	snd_compress_deregister(&omap->compr);
+	cancel_work_sync(&omap->work);
+	kfree(omap);
+}
+
+static struct rpmsg_device_id omap_compr_id_table[] = {
+	{ .name = "rpmsg-audio-compr" },
+	{ },
+};
+MODULE_DEVICE_TABLE(rpmsg, omap_compr_id_table);
+
+static struct rpmsg_driver omap_compr_driver = {
+	.drv.name	= KBUILD_MODNAME,
+	.drv.owner	= THIS_MODULE,
+	.id_table	= omap_compr_id_table,
+	.probe		= omap_compr_probe,
+	.callback	= omap_compr_cb,
+	.remove		= __devexit_p(omap_compr_remove),
+};
+
+static int __init omap_compr_init(void)
+{
+	return register_rpmsg_driver(&omap_compr_driver);
+}
+module_init(omap_compr_init);
+
+static void __exit omap_compr_exit(void)
+{
+	unregister_rpmsg_driver(&omap_compr_driver);
+}
+module_exit(omap_compr_exit);
+
+MODULE_DESCRIPTION("OMAP compressed audio offload over rpmsg");
+MODULE_LICENSE("GPL");
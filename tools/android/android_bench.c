@@ -0,0 +1,975 @@
+/*
+ * android_bench: microbenchmarks for the binder, ion, ashmem and zram paths
+ *
+ * binder	round trips and one-way transactions from N client threads to a
+ *		server process with N looper threads.  The server registers
+ *		with the servicemanager, or becomes the context manager itself
+ *		when there is none.
+ * ion		alloc, map (ION_IOC_MAP and mmap), sync (ION_IOC_SYNC to
+ *		device), unmap and free, for every heap the plain ION_IOC_ALLOC
+ *		works on and several buffer sizes.
+ * ashmem	pin and unpin of a single page and of a whole 1MB region.
+ * zram		read from <debugfs>/android_bench/zram, see
+ *		drivers/staging/android/android_bench.c.
+ *
+ * Every operation is timed on its own.  Results are printed one line per
+ * cpu the operation completed on, plus one for all cpus:
+ *
+ *	<bench> <op> <cpu|all> <count> <mean> <p50> <p90> <p99> <max> <MB/s>
+ *
+ * with times in nanoseconds, so runs can be diffed or fed to a script.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <linux/types.h>
+
+#include "../../drivers/staging/android/binder.h"
+#include "../../drivers/staging/android/ashmem.h"
+#include "../../include/linux/ion.h"
+
+#define KBENCH_DIR		"/sys/kernel/debug/android_bench"
+#define BINDER_VM_SIZE		((1024 - 8) * 1024)
+#define ASHMEM_REGION		(1024 * 1024)
+#define ION_MAX_HEAPS		16
+#define ION_MAX_BYTES		(256 * 1024 * 1024)	/* per heap and size */
+
+/* servicemanager protocol */
+#define SVC_MGR_NAME		"android.os.IServiceManager"
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+
+#define BENCH_CODE_PING		1
+
+static unsigned int iterations = 1000;
+static unsigned int nthreads = 1;
+static unsigned int payload = 32;
+static int pin_threads;
+static int ncpus;
+
+static const size_t ion_sizes[] = { 4096, 65536, 1024 * 1024, 8 * 1024 * 1024 };
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Samples
+ */
+
+struct samples {
+	uint32_t *ns;
+	uint16_t *cpu;
+	unsigned int n;
+	unsigned int max;
+};
+
+static void samples_init(struct samples *s, unsigned int max)
+{
+	s->ns = malloc(max * sizeof(*s->ns));
+	s->cpu = malloc(max * sizeof(*s->cpu));
+	if (!s->ns || !s->cpu)
+		die("malloc");
+	s->n = 0;
+	s->max = max;
+}
+
+static void samples_free(struct samples *s)
+{
+	free(s->ns);
+	free(s->cpu);
+}
+
+static void samples_add(struct samples *s, uint64_t start)
+{
+	uint64_t ns = now_ns() - start;
+
+	if (s->n == s->max)
+		return;
+	s->ns[s->n] = ns > UINT32_MAX ? UINT32_MAX : ns;
+	s->cpu[s->n] = sched_getcpu();
+	s->n++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_dist(const char *bench, const char *op, const char *cpu,
+		       uint32_t *ns, unsigned int n, size_t bytes)
+{
+	uint64_t sum = 0, mean;
+	unsigned int i;
+
+	if (!n)
+		return;
+
+	qsort(ns, n, sizeof(*ns), cmp_u32);
+	for (i = 0; i < n; i++)
+		sum += ns[i];
+	mean = sum / n;
+
+	printf("%s %s %s %u %llu %u %u %u %u %llu\n", bench, op, cpu, n,
+	       (unsigned long long)mean, ns[(n - 1) / 2], ns[n * 90 / 100],
+	       ns[n * 99 / 100], ns[n - 1],
+	       mean ? (unsigned long long)bytes * 1000 / mean : 0ULL);
+}
+
+/* merges the samples of @nr threads and prints them per cpu and overall */
+static void report(const char *bench, const char *op, struct samples *s,
+		   int nr, size_t bytes)
+{
+	unsigned int total = 0, n, i;
+	uint32_t *ns;
+	char name[16];
+	int cpu, t;
+
+	for (t = 0; t < nr; t++)
+		total += s[t].n;
+	ns = malloc((total + 1) * sizeof(*ns));
+	if (!ns)
+		die("malloc");
+
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		n = 0;
+		for (t = 0; t < nr; t++)
+			for (i = 0; i < s[t].n; i++)
+				if (s[t].cpu[i] == cpu)
+					ns[n++] = s[t].ns[i];
+		snprintf(name, sizeof(name), "%d", cpu);
+		print_dist(bench, op, name, ns, n, bytes);
+	}
+
+	n = 0;
+	for (t = 0; t < nr; t++)
+		for (i = 0; i < s[t].n; i++)
+			ns[n++] = s[t].ns[i];
+	print_dist(bench, op, "all", ns, n, bytes);
+	fflush(stdout);
+	free(ns);
+}
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % ncpus, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+/*
+ * Binder
+ */
+
+struct binder_cmd_txn {
+	uint32_t cmd;
+	struct binder_transaction_data txn;
+} __attribute__((packed));
+
+struct parcel {
+	uint8_t data[256];
+	size_t len;
+	size_t offs[2];
+	size_t noffs;
+};
+
+static int binder_fd = -1;
+static void *binder_map;
+static int bench_node;		/* the served object; only its address counts */
+
+static void binder_open(void)
+{
+	struct binder_version vers;
+
+	binder_fd = open("/dev/binder", O_RDWR);
+	if (binder_fd < 0)
+		die("/dev/binder");
+	if (ioctl(binder_fd, BINDER_VERSION, &vers) ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder: protocol version mismatch\n");
+		exit(1);
+	}
+	binder_map = mmap(NULL, BINDER_VM_SIZE, PROT_READ, MAP_PRIVATE,
+			  binder_fd, 0);
+	if (binder_map == MAP_FAILED)
+		die("binder mmap");
+}
+
+static int binder_rw(const void *wbuf, size_t wlen, void *rbuf, size_t rlen,
+		     size_t *consumed)
+{
+	struct binder_write_read bwr;
+	int ret;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = wlen;
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.read_size = rlen;
+	bwr.read_buffer = (unsigned long)rbuf;
+	do {
+		ret = ioctl(binder_fd, BINDER_WRITE_READ, &bwr);
+	} while (ret < 0 && errno == EINTR);
+	if (consumed)
+		*consumed = bwr.read_consumed;
+	return ret;
+}
+
+static void binder_write(const void *buf, size_t len)
+{
+	if (binder_rw(buf, len, NULL, 0, NULL))
+		die("binder write");
+}
+
+static void binder_free_buffer(const void *buffer)
+{
+	struct {
+		uint32_t cmd;
+		const void *buffer;
+	} __attribute__((packed)) w = { BC_FREE_BUFFER, buffer };
+
+	binder_write(&w, sizeof(w));
+}
+
+/* what the last read returned that has not been handled yet */
+static __thread struct {
+	uint32_t buf[64];
+	size_t pos;
+	size_t len;
+} binder_rbuf;
+
+/*
+ * Reads until a transaction, a reply or a transaction result shows up and
+ * returns its code; reference counting requests are answered on the way.
+ */
+static uint32_t binder_read(struct binder_transaction_data *txn)
+{
+	uint8_t *p;
+	uint32_t cmd;
+
+	for (;;) {
+		if (binder_rbuf.pos >= binder_rbuf.len) {
+			if (binder_rw(NULL, 0, binder_rbuf.buf,
+				      sizeof(binder_rbuf.buf),
+				      &binder_rbuf.len))
+				die("binder read");
+			binder_rbuf.pos = 0;
+			continue;
+		}
+
+		p = (uint8_t *)binder_rbuf.buf + binder_rbuf.pos;
+		cmd = *(uint32_t *)p;
+		p += sizeof(uint32_t);
+		binder_rbuf.pos += sizeof(uint32_t) + _IOC_SIZE(cmd);
+
+		switch (cmd) {
+		case BR_NOOP:
+		case BR_OK:
+		case BR_SPAWN_LOOPER:
+		case BR_RELEASE:
+		case BR_DECREFS:
+			break;
+		case BR_INCREFS:
+		case BR_ACQUIRE: {
+			struct {
+				uint32_t cmd;
+				struct binder_ptr_cookie pc;
+			} __attribute__((packed)) w;
+
+			w.cmd = cmd == BR_INCREFS ?
+				BC_INCREFS_DONE : BC_ACQUIRE_DONE;
+			memcpy(&w.pc, p, sizeof(w.pc));
+			binder_write(&w, sizeof(w));
+			break;
+		}
+		case BR_TRANSACTION:
+		case BR_REPLY:
+			memcpy(txn, p, sizeof(*txn));
+			return cmd;
+		case BR_TRANSACTION_COMPLETE:
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+			return cmd;
+		default:
+			fprintf(stderr, "binder: unexpected 0x%x\n", cmd);
+			exit(1);
+		}
+	}
+}
+
+/*
+ * Sends a transaction and waits for its reply, which the caller frees, or
+ * for its completion if it is one-way.  Returns 0 or the failing BR_*.
+ */
+static uint32_t binder_transact(uint32_t handle, uint32_t code,
+				const void *data, size_t len,
+				const size_t *offs, size_t noffs,
+				uint32_t flags,
+				struct binder_transaction_data *reply)
+{
+	struct binder_cmd_txn w;
+	struct binder_transaction_data txn;
+	uint32_t cmd;
+
+	memset(&w, 0, sizeof(w));
+	w.cmd = BC_TRANSACTION;
+	w.txn.target.handle = handle;
+	w.txn.code = code;
+	w.txn.flags = flags;
+	w.txn.data_size = len;
+	w.txn.offsets_size = noffs * sizeof(size_t);
+	w.txn.data.ptr.buffer = data;
+	w.txn.data.ptr.offsets = offs;
+	binder_write(&w, sizeof(w));
+
+	for (;;) {
+		cmd = binder_read(&txn);
+		if (cmd == BR_TRANSACTION_COMPLETE) {
+			if (flags & TF_ONE_WAY)
+				return 0;
+			continue;
+		}
+		if (cmd == BR_REPLY) {
+			if (reply)
+				*reply = txn;
+			else
+				binder_free_buffer(txn.data.ptr.buffer);
+			return 0;
+		}
+		if (cmd == BR_TRANSACTION) {
+			binder_free_buffer(txn.data.ptr.buffer);
+			continue;
+		}
+		return cmd;
+	}
+}
+
+static void parcel_put(struct parcel *p, const void *data, size_t len)
+{
+	size_t padded = (len + 3) & ~3;
+
+	memset(p->data + p->len, 0, padded);
+	memcpy(p->data + p->len, data, len);
+	p->len += padded;
+}
+
+static void parcel_put_u32(struct parcel *p, uint32_t v)
+{
+	parcel_put(p, &v, sizeof(v));
+}
+
+static void parcel_put_str16(struct parcel *p, const char *s)
+{
+	uint16_t str16[64];
+	size_t i, len = strlen(s);
+
+	parcel_put_u32(p, len);
+	for (i = 0; i <= len; i++)
+		str16[i] = s[i];
+	parcel_put(p, str16, (len + 1) * sizeof(uint16_t));
+}
+
+static void parcel_put_binder(struct parcel *p, void *ptr)
+{
+	struct flat_binder_object obj;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.type = BINDER_TYPE_BINDER;
+	obj.flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+	obj.binder = ptr;
+	p->offs[p->noffs++] = p->len;
+	parcel_put(p, &obj, sizeof(obj));
+}
+
+static void parcel_svcmgr(struct parcel *p, const char *name)
+{
+	memset(p, 0, sizeof(*p));
+	parcel_put_u32(p, 0);			/* strict mode policy */
+	parcel_put_str16(p, SVC_MGR_NAME);
+	parcel_put_str16(p, name);
+}
+
+static void *binder_server_loop(void *arg __attribute__((unused)))
+{
+	struct binder_transaction_data txn;
+	struct binder_cmd_txn w;
+	uint32_t cmd = BC_ENTER_LOOPER;
+
+	binder_write(&cmd, sizeof(cmd));
+	for (;;) {
+		if (binder_read(&txn) != BR_TRANSACTION)
+			continue;
+
+		binder_free_buffer(txn.data.ptr.buffer);
+		if (txn.flags & TF_ONE_WAY)
+			continue;
+
+		memset(&w, 0, sizeof(w));
+		w.cmd = BC_REPLY;
+		binder_write(&w, sizeof(w));
+		/* wait for BR_TRANSACTION_COMPLETE of the reply */
+		while (binder_read(&txn) != BR_TRANSACTION_COMPLETE)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * Serves until killed.  Tells the client through @ready whether it became
+ * the context manager ('c') or registered @name with the servicemanager
+ * ('s').
+ */
+static void binder_server(int ready, const char *name)
+{
+	struct binder_transaction_data reply;
+	struct parcel p;
+	pthread_t thread;
+	size_t zero = 0;
+	unsigned int i;
+	char mode = 'c';
+
+	binder_open();
+	ioctl(binder_fd, BINDER_SET_MAX_THREADS, &zero);
+
+	if (ioctl(binder_fd, BINDER_SET_CONTEXT_MGR, 0)) {
+		mode = 's';
+		parcel_svcmgr(&p, name);
+		parcel_put_binder(&p, &bench_node);
+		parcel_put_u32(&p, 0);		/* allow isolated */
+		if (binder_transact(0, SVC_MGR_ADD_SERVICE, p.data, p.len,
+				    p.offs, p.noffs, 0, &reply)) {
+			fprintf(stderr, "binder: can't register %s\n", name);
+			exit(1);
+		}
+		binder_free_buffer(reply.data.ptr.buffer);
+	}
+
+	for (i = 1; i < nthreads; i++)
+		if (pthread_create(&thread, NULL, binder_server_loop, NULL))
+			die("pthread_create");
+
+	if (write(ready, &mode, 1) != 1)
+		die("write");
+	binder_server_loop(NULL);
+}
+
+static uint32_t binder_lookup(const char *name)
+{
+	struct binder_transaction_data reply;
+	const struct flat_binder_object *obj;
+	struct parcel p;
+	struct {
+		uint32_t cmd;
+		uint32_t handle;
+	} __attribute__((packed)) w;
+
+	parcel_svcmgr(&p, name);
+	if (binder_transact(0, SVC_MGR_CHECK_SERVICE, p.data, p.len, NULL, 0,
+			    0, &reply))
+		return 0;
+
+	if (reply.offsets_size < sizeof(size_t)) {
+		binder_free_buffer(reply.data.ptr.buffer);
+		return 0;
+	}
+	obj = (const void *)((const uint8_t *)reply.data.ptr.buffer +
+			     *(const size_t *)reply.data.ptr.offsets);
+
+	/* keep the reference once the reply is freed */
+	w.cmd = BC_ACQUIRE;
+	w.handle = obj->handle;
+	binder_write(&w, sizeof(w));
+	binder_free_buffer(reply.data.ptr.buffer);
+	return w.handle;
+}
+
+struct binder_client {
+	pthread_t thread;
+	int index;
+	uint32_t handle;
+	struct samples rtt;
+	struct samples oneway;
+	unsigned int oneway_failed;
+	pthread_barrier_t *barrier;
+};
+
+static void *binder_client_thread(void *arg)
+{
+	struct binder_client *c = arg;
+	uint8_t *data = calloc(1, payload + 1);
+	uint64_t start;
+	uint32_t ret;
+	unsigned int i;
+
+	if (pin_threads)
+		pin_to_cpu(c->index);
+
+	pthread_barrier_wait(c->barrier);
+	for (i = 0; i < iterations; i++) {
+		start = now_ns();
+		ret = binder_transact(c->handle, BENCH_CODE_PING, data,
+				      payload, NULL, 0, 0, NULL);
+		if (ret) {
+			fprintf(stderr, "binder: transaction failed 0x%x\n",
+				ret);
+			exit(1);
+		}
+		samples_add(&c->rtt, start);
+	}
+
+	pthread_barrier_wait(c->barrier);
+	for (i = 0; i < iterations; i++) {
+		start = now_ns();
+		ret = binder_transact(c->handle, BENCH_CODE_PING, data,
+				      payload, NULL, 0, TF_ONE_WAY, NULL);
+		if (ret) {
+			/* the server's async buffer space is full */
+			c->oneway_failed++;
+			sched_yield();
+			continue;
+		}
+		samples_add(&c->oneway, start);
+	}
+
+	free(data);
+	return NULL;
+}
+
+static void bench_binder(void)
+{
+	struct binder_client *clients;
+	pthread_barrier_t barrier;
+	unsigned int failed = 0, i;
+	struct samples *rtt, *oneway;
+	char name[32], mode;
+	uint64_t start, ns;
+	int ready[2];
+	uint32_t handle;
+	pid_t pid;
+
+	snprintf(name, sizeof(name), "android_bench.%d", getpid());
+	if (pipe(ready))
+		die("pipe");
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(ready[0]);
+		binder_server(ready[1], name);
+		exit(0);
+	}
+
+	close(ready[1]);
+	if (read(ready[0], &mode, 1) != 1) {
+		fprintf(stderr, "binder: server failed to start\n");
+		waitpid(pid, NULL, 0);
+		return;
+	}
+	close(ready[0]);
+
+	binder_open();
+	handle = 0;
+	if (mode == 's') {
+		handle = binder_lookup(name);
+		if (!handle) {
+			fprintf(stderr, "binder: can't find %s\n", name);
+			goto out;
+		}
+	}
+
+	clients = calloc(nthreads, sizeof(*clients));
+	rtt = calloc(nthreads, sizeof(*rtt));
+	oneway = calloc(nthreads, sizeof(*oneway));
+	if (!clients || !rtt || !oneway)
+		die("calloc");
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+
+	for (i = 0; i < nthreads; i++) {
+		clients[i].index = i;
+		clients[i].handle = handle;
+		clients[i].barrier = &barrier;
+		samples_init(&clients[i].rtt, iterations);
+		samples_init(&clients[i].oneway, iterations);
+		if (pthread_create(&clients[i].thread, NULL,
+				   binder_client_thread, &clients[i]))
+			die("pthread_create");
+	}
+
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	pthread_barrier_wait(&barrier);
+	ns = now_ns() - start;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(clients[i].thread, NULL);
+		rtt[i] = clients[i].rtt;
+		oneway[i] = clients[i].oneway;
+		failed += clients[i].oneway_failed;
+	}
+
+	report("binder", "transact", rtt, nthreads, payload);
+	report("binder", "oneway", oneway, nthreads, payload);
+	printf("# binder: %u threads, %u byte payload, %llu round trips/s, "
+	       "%u one-way failed\n", nthreads, payload,
+	       ns ? (unsigned long long)nthreads * iterations *
+	       1000000000ULL / ns : 0ULL, failed);
+
+	for (i = 0; i < nthreads; i++) {
+		samples_free(&rtt[i]);
+		samples_free(&oneway[i]);
+	}
+	pthread_barrier_destroy(&barrier);
+	free(oneway);
+	free(rtt);
+	free(clients);
+out:
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	munmap(binder_map, BINDER_VM_SIZE);
+	close(binder_fd);
+}
+
+/*
+ * ion
+ */
+
+enum { ION_ALLOC, ION_MAP, ION_SYNC, ION_UNMAP, ION_FREE, ION_OPS };
+
+static const char * const ion_op_names[ION_OPS] = {
+	"alloc", "map", "sync", "unmap", "free",
+};
+
+static int bench_ion_heap(int fd, int heap, size_t size)
+{
+	struct samples s[ION_OPS];
+	struct ion_allocation_data alloc;
+	struct ion_handle_data hd;
+	struct ion_fd_data map;
+	struct ion_sync_range range = { 0, size };
+	struct ion_sync_data sync;
+	unsigned int n, i;
+	uint64_t start;
+	char op[48];
+	void *ptr = NULL;
+	int sync_ok = 1, ret = 0;
+
+	n = ION_MAX_BYTES / size;
+	if (n > iterations)
+		n = iterations;
+	for (i = 0; i < ION_OPS; i++)
+		samples_init(&s[i], n);
+
+	for (i = 0; i < n; i++) {
+		memset(&alloc, 0, sizeof(alloc));
+		alloc.len = size;
+		alloc.align = 4096;
+		alloc.flags = 1 << heap;
+		start = now_ns();
+		if (ioctl(fd, ION_IOC_ALLOC, &alloc)) {
+			ret = -errno;
+			break;
+		}
+		samples_add(&s[ION_ALLOC], start);
+
+		memset(&map, 0, sizeof(map));
+		map.handle = alloc.handle;
+		map.cacheable = 1;
+		start = now_ns();
+		if (ioctl(fd, ION_IOC_MAP, &map)) {
+			ret = -errno;
+		} else {
+			ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, map.fd, 0);
+			if (ptr == MAP_FAILED) {
+				ret = -errno;
+				close(map.fd);
+			}
+		}
+		if (!ret) {
+			samples_add(&s[ION_MAP], start);
+			memset(ptr, i, size);
+
+			if (sync_ok) {
+				sync.handle = alloc.handle;
+				sync.vaddr = (unsigned long)ptr;
+				sync.direction = ION_SYNC_TO_DEVICE;
+				sync.nr_ranges = 1;
+				sync.ranges = &range;
+				start = now_ns();
+				if (ioctl(fd, ION_IOC_SYNC, &sync))
+					sync_ok = 0;	/* not on this heap */
+				else
+					samples_add(&s[ION_SYNC], start);
+			}
+
+			start = now_ns();
+			munmap(ptr, size);
+			close(map.fd);
+			samples_add(&s[ION_UNMAP], start);
+		}
+
+		hd.handle = alloc.handle;
+		start = now_ns();
+		ioctl(fd, ION_IOC_FREE, &hd);
+		samples_add(&s[ION_FREE], start);
+		if (ret)
+			break;
+	}
+
+	for (i = 0; i < ION_OPS; i++) {
+		snprintf(op, sizeof(op), "heap%d.%s.%zu", heap,
+			 ion_op_names[i], size);
+		report("ion", op, &s[i], 1, size);
+		samples_free(&s[i]);
+	}
+	return ret;
+}
+
+static void bench_ion(void)
+{
+	struct ion_allocation_data alloc;
+	struct ion_handle_data hd;
+	unsigned int i;
+	int fd, heap, ret;
+
+	fd = open("/dev/ion", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/ion");
+		return;
+	}
+
+	for (heap = 0; heap < ION_MAX_HEAPS; heap++) {
+		/* heaps needing custom allocation ioctls are skipped */
+		memset(&alloc, 0, sizeof(alloc));
+		alloc.len = 4096;
+		alloc.align = 4096;
+		alloc.flags = 1 << heap;
+		if (ioctl(fd, ION_IOC_ALLOC, &alloc))
+			continue;
+		hd.handle = alloc.handle;
+		ioctl(fd, ION_IOC_FREE, &hd);
+
+		for (i = 0; i < sizeof(ion_sizes) / sizeof(ion_sizes[0]); i++) {
+			ret = bench_ion_heap(fd, heap, ion_sizes[i]);
+			if (ret)
+				printf("# ion: heap%d stopped at %zu bytes: "
+				       "%s\n", heap, ion_sizes[i],
+				       strerror(-ret));
+		}
+	}
+	close(fd);
+}
+
+/*
+ * ashmem
+ */
+
+static void bench_ashmem(void)
+{
+	struct samples pin, unpin, pin_all, unpin_all;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t pages = ASHMEM_REGION / page;
+	struct ashmem_pin range;
+	unsigned int i;
+	uint64_t start;
+	char op[32];
+	void *ptr;
+	int fd;
+
+	fd = open("/dev/ashmem", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/ashmem");
+		return;
+	}
+	if (ioctl(fd, ASHMEM_SET_SIZE, ASHMEM_REGION) < 0)
+		die("ASHMEM_SET_SIZE");
+	ptr = mmap(NULL, ASHMEM_REGION, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (ptr == MAP_FAILED)
+		die("ashmem mmap");
+	memset(ptr, 1, ASHMEM_REGION);
+
+	samples_init(&pin, iterations);
+	samples_init(&unpin, iterations);
+	samples_init(&pin_all, iterations);
+	samples_init(&unpin_all, iterations);
+
+	for (i = 0; i < iterations; i++) {
+		range.offset = (i % pages) * page;
+		range.len = page;
+		start = now_ns();
+		ioctl(fd, ASHMEM_UNPIN, &range);
+		samples_add(&unpin, start);
+		start = now_ns();
+		ioctl(fd, ASHMEM_PIN, &range);
+		samples_add(&pin, start);
+
+		range.offset = 0;
+		range.len = 0;			/* to the end */
+		start = now_ns();
+		ioctl(fd, ASHMEM_UNPIN, &range);
+		samples_add(&unpin_all, start);
+		start = now_ns();
+		ioctl(fd, ASHMEM_PIN, &range);
+		samples_add(&pin_all, start);
+	}
+
+	report("ashmem", "unpin.4096", &unpin, 1, page);
+	report("ashmem", "pin.4096", &pin, 1, page);
+	snprintf(op, sizeof(op), "unpin.%d", ASHMEM_REGION);
+	report("ashmem", op, &unpin_all, 1, ASHMEM_REGION);
+	snprintf(op, sizeof(op), "pin.%d", ASHMEM_REGION);
+	report("ashmem", op, &pin_all, 1, ASHMEM_REGION);
+
+	samples_free(&pin);
+	samples_free(&unpin);
+	samples_free(&pin_all);
+	samples_free(&unpin_all);
+	munmap(ptr, ASHMEM_REGION);
+	close(fd);
+}
+
+/*
+ * zram, run by the android_bench module
+ */
+
+static void bench_zram(void)
+{
+	char buf[4096];
+	ssize_t len;
+	int fd;
+
+	fd = open(KBENCH_DIR "/iterations", O_WRONLY);
+	if (fd < 0) {
+		perror(KBENCH_DIR);
+		return;
+	}
+	len = snprintf(buf, sizeof(buf), "%u\n", iterations);
+	if (write(fd, buf, len) != len)
+		perror("iterations");
+	close(fd);
+
+	fd = open(KBENCH_DIR "/zram", O_RDONLY);
+	if (fd < 0) {
+		perror(KBENCH_DIR "/zram");
+		return;
+	}
+	/* the module prints its own header */
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		char *p = buf, *end = buf + len, *nl;
+
+		while (p < end) {
+			nl = memchr(p, '\n', end - p);
+			nl = nl ? nl + 1 : end;
+			if (strncmp(p, "# bench", 7))
+				fwrite(p, 1, nl - p, stdout);
+			p = nl;
+		}
+	}
+	if (len < 0)
+		perror(KBENCH_DIR "/zram");
+	close(fd);
+}
+
+static const struct {
+	const char *name;
+	void (*run)(void);
+} benches[] = {
+	{ "binder", bench_binder },
+	{ "ion", bench_ion },
+	{ "ashmem", bench_ashmem },
+	{ "zram", bench_zram },
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n iterations] [-t threads] [-s payload] [-p] "
+		"[binder|ion|ashmem|zram]...\n"
+		"  -n  operations timed per benchmark, thread and size "
+		"(default %u)\n"
+		"  -t  binder client and server threads (default %u)\n"
+		"  -s  binder transaction payload in bytes (default %u)\n"
+		"  -p  pin binder client thread i to cpu i\n"
+		"With no benchmark named, all are run.\n",
+		prog, iterations, nthreads, payload);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int opt, a;
+
+	while ((opt = getopt(argc, argv, "n:t:s:ph")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nthreads = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			payload = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			pin_threads = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!iterations || !nthreads)
+		usage(argv[0]);
+
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus < 1)
+		ncpus = 1;
+
+	printf("# bench op cpu count mean_ns p50_ns p90_ns p99_ns max_ns "
+	       "MB/s\n");
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		if (optind < argc) {
+			for (a = optind; a < argc; a++)
+				if (!strcmp(argv[a], benches[i].name))
+					break;
+			if (a == argc)
+				continue;
+		}
+		benches[i].run();
+	}
+	return 0;
+}
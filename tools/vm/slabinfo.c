@@ -43,6 +43,7 @@ struct slabinfo {
 	unsigned long cmpxchg_double_cpu_fail, cmpxchg_double_fail;
 	unsigned long alloc_node_mismatch, deactivate_bypass;
 	unsigned long cpu_partial_alloc, cpu_partial_free;
+	unsigned long free_remote, free_remote_flush, free_remote_slabs;
 	int numa[MAX_NODES];
 	int numa_partial[MAX_NODES];
 } slabinfo[MAX_SLABS];
@@ -468,6 +469,14 @@ static void slab_stats(struct slabinfo *s)
 
 	printf("Total                %8lu %8lu\n\n", total_alloc, total_free);
 
+	if (s->free_remote)
+		printf("Remote frees %lu queued, %lu batches, %lu slab updates "
+			"(%lu objects per update)\n",
+			s->free_remote, s->free_remote_flush,
+			s->free_remote_slabs,
+			s->free_remote_slabs ?
+				s->free_remote / s->free_remote_slabs : 0);
+
 	if (s->cpuslab_flush)
 		printf("Flushes %8lu\n", s->cpuslab_flush);
 
@@ -1217,6 +1226,9 @@ static void read_slab_dir(void)
 			slab->cmpxchg_double_fail = get_obj("cmpxchg_double_fail");
 			slab->cpu_partial_alloc = get_obj("cpu_partial_alloc");
 			slab->cpu_partial_free = get_obj("cpu_partial_free");
+			slab->free_remote = get_obj("free_remote");
+			slab->free_remote_flush = get_obj("free_remote_flush");
+			slab->free_remote_slabs = get_obj("free_remote_slabs");
 			slab->alloc_node_mismatch = get_obj("alloc_node_mismatch");
 			slab->deactivate_bypass = get_obj("deactivate_bypass");
 			chdir("..");